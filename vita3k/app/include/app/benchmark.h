@@ -0,0 +1,102 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <renderer/draw_profile.h>
+#include <util/fs.h>
+#include <util/host_cpu.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct EmuEnvState;
+
+namespace app {
+
+// Timings of a host frame of the benchmark mode, the times are in microseconds
+struct BenchmarkFrame {
+    // time since the benchmark started, once the frame is presented
+    uint64_t time = 0;
+    uint64_t present_interval = 0;
+    // CPU time of the render thread (the main thread), and of the guest threads by thread id
+    uint64_t render_thread_cpu = 0;
+    std::vector<std::pair<int, uint64_t>> threads_cpu;
+    // GPU time and count of the scenes which were done during the frame, they were submitted by the previous frames
+    uint64_t gpu_time = 0;
+    uint64_t gpu_scenes = 0;
+    // GPU time of the presentations done during the frame, and time the GPU was running a scene or a presentation
+    uint64_t gpu_present_time = 0;
+    uint64_t gpu_busy = 0;
+    uint64_t vblanks = 0;
+    uint32_t shaders_compiled = 0;
+    uint32_t pipelines_compiled = 0;
+    // CPU time of the render thread by phase of the draws, and the draws, state changes and texture uploads it processed
+    std::array<uint64_t, renderer::DRAW_PROFILE_STAGE_COUNT> draw_stages{};
+    uint64_t draws = 0;
+    uint64_t state_changes = 0;
+    uint64_t texture_uploads = 0;
+    uint64_t upload_bytes = 0;
+    // time spent by the guest threads in the Razor markers of the app, by label
+    std::map<std::string, uint64_t> markers;
+};
+
+// Measures each host frame of an app run with --benchmark-vblanks or --benchmark-seconds until it is done,
+// the report is then written as json to be compared between builds and configurations
+class Benchmark {
+public:
+    // must be created by the main thread once the app displayed its first frame
+    explicit Benchmark(EmuEnvState &emuenv);
+
+    // called by the main thread after each frame is presented
+    void frame();
+    bool is_done() const;
+    bool write_report(const fs::path &path) const;
+
+private:
+    struct ThreadTimes {
+        std::string name;
+        uint64_t last_cpu = 0;
+        uint64_t total_cpu = 0;
+    };
+
+    EmuEnvState &emuenv;
+    util::ThreadCpuClock render_thread_clock;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point last_present;
+    uint64_t start_vblank = 0;
+    uint64_t last_vblank = 0;
+    uint64_t last_render_thread_cpu = 0;
+    uint64_t last_gpu_time_ns = 0;
+    uint64_t last_gpu_scene_count = 0;
+    uint64_t last_gpu_present_time_ns = 0;
+    uint64_t last_gpu_busy_ns = 0;
+    uint32_t last_shaders_compiled = 0;
+    uint32_t last_pipelines_compiled = 0;
+    renderer::DrawProfileTotals last_draw_profile;
+
+    std::map<int, ThreadTimes> threads;
+    std::map<std::string, uint64_t> marker_totals;
+    std::vector<BenchmarkFrame> frames;
+};
+
+} // namespace app
@@ -22,6 +22,8 @@
 #include <display/state.h>
 #include <emuenv/state.h>
 #include <io/state.h>
+#include <kernel/state.h>
+#include <renderer/state.h>
 #include <util/log.h>
 
 #include <SDL.h>
@@ -58,6 +60,64 @@ void calculate_fps(EmuEnvState &emuenv) {
         emuenv.avg_fps = avg_fps / frames_size;
         emuenv.min_fps = uint32_t(*std::min_element(emuenv.fps_values, std::next(emuenv.fps_values, frames_size)));
         emuenv.max_fps = uint32_t(*std::max_element(emuenv.fps_values, std::next(emuenv.fps_values, frames_size)));
+
+        // Set the GPU time of the last second, the timestamp queries are only written when these figures are shown or benchmarked
+        renderer::State &renderer = *emuenv.renderer;
+        renderer.gpu_timing = emuenv.cfg.is_benchmark()
+            || (emuenv.cfg.performance_overlay && (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM));
+        renderer.draw_profile.enabled = renderer.gpu_timing.load();
+        const uint64_t gpu_time_ns = renderer.gpu_time_ns;
+        const uint64_t gpu_scene_count = renderer.gpu_scene_count;
+        const uint64_t gpu_present_time_ns = renderer.gpu_present_time_ns;
+        const uint64_t gpu_busy_ns = renderer.gpu_busy_ns;
+        const uint64_t scenes = gpu_scene_count - emuenv.reported_gpu_scene_count;
+        emuenv.gpu_scene_ms = scenes ? (gpu_time_ns - emuenv.reported_gpu_time_ns) / (scenes * 1'000'000.f) : 0.f;
+        emuenv.gpu_present_ms = (gpu_present_time_ns - emuenv.reported_gpu_present_time_ns) / (frame_count * 1'000'000.f);
+        emuenv.gpu_busy_percent = static_cast<uint32_t>(std::min<uint64_t>((gpu_busy_ns - emuenv.reported_gpu_busy_ns) / (ms * 10'000ULL), 100));
+        emuenv.reported_gpu_time_ns = gpu_time_ns;
+        emuenv.reported_gpu_scene_count = gpu_scene_count;
+        emuenv.reported_gpu_present_time_ns = gpu_present_time_ns;
+        emuenv.reported_gpu_busy_ns = gpu_busy_ns;
+
+        // Set exclusive store failures of the last second, and the thread with the most of them
+        // with the use of the interpreter fallback during that second
+        uint64_t max_thread_failures = 0;
+        uint64_t fallback_time_ns = 0;
+        uint64_t jit_ns = 0;
+        uint64_t hle_ns = 0;
+        uint64_t blocked_ns = 0;
+        emuenv.exclusive_store_failures = 0;
+        emuenv.exclusive_store_failures_thread.clear();
+        emuenv.interpreter_fallbacks = 0;
+        const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+        for (const auto &[_, thread] : emuenv.kernel.threads) {
+            const uint64_t failures = thread->cpu->exclusive_store_failures.exchange(0, std::memory_order_relaxed);
+            emuenv.exclusive_store_failures += failures;
+            if (failures > max_thread_failures) {
+                max_thread_failures = failures;
+                emuenv.exclusive_store_failures_thread = thread->name;
+            }
+            emuenv.interpreter_fallbacks += thread->cpu->interpreter_fallbacks.exchange(0, std::memory_order_relaxed);
+            fallback_time_ns += thread->cpu->interpreter_fallback_time_ns.exchange(0, std::memory_order_relaxed);
+
+            ThreadCpuStats &stats = thread->cpu_stats;
+            const uint64_t jit = stats.jit_ns.load(std::memory_order_relaxed);
+            const uint64_t hle = stats.hle_ns.load(std::memory_order_relaxed);
+            const uint64_t blocked = stats.get_blocked_ns();
+            jit_ns += jit - stats.reported_jit_ns;
+            hle_ns += hle - stats.reported_hle_ns;
+            blocked_ns += blocked - stats.reported_blocked_ns;
+            stats.reported_jit_ns = jit;
+            stats.reported_hle_ns = hle;
+            stats.reported_blocked_ns = blocked;
+        }
+        emuenv.interpreter_fallback_time_us = fallback_time_ns / 1000;
+
+        // Where the guest threads spent their time, to know if the app is bound by its code, the HLE functions or its waits
+        const uint64_t guest_ns = std::max<uint64_t>(jit_ns + hle_ns + blocked_ns, 1);
+        emuenv.guest_jit_percent = static_cast<uint32_t>(jit_ns * 100 / guest_ns);
+        emuenv.guest_hle_percent = static_cast<uint32_t>(hle_ns * 100 / guest_ns);
+        emuenv.guest_blocked_percent = static_cast<uint32_t>(blocked_ns * 100 / guest_ns);
     }
 }
 
@@ -18,6 +18,7 @@
 #include <app/functions.h>
 
 #include <audio/state.h>
+#include <codec/state.h>
 #include <config/functions.h>
 #include <config/state.h>
 #include <config/version.h>
@@ -26,13 +27,16 @@
 #include <gui/imgui_impl_sdl.h>
 #include <io/functions.h>
 #include <kernel/state.h>
+#include <ngs/modules/atrac9.h>
 #include <ngs/state.h>
 #include <renderer/state.h>
 
 #include <nids/functions.h>
 #include <renderer/functions.h>
 #include <rtc/rtc.h>
+#include <util/boot_stages.h>
 #include <util/fs.h>
+#include <util/host_cpu.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -97,7 +101,7 @@ void update_viewport(EmuEnvState &state) {
 
 bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
     const ResumeAudioThread resume_thread = [&state](SceUID thread_id) {
-        const auto thread = lock_and_find(thread_id, state.kernel.threads, state.kernel.mutex);
+        const auto thread = state.kernel.get_thread(thread_id);
         const std::lock_guard<std::mutex> lock(thread->mutex);
         if (thread->status == ThreadStatus::wait) {
             thread->update_status(ThreadStatus::run);
@@ -162,20 +166,37 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
         return false;
     }
 
+    state.mem.huge_pages = state.cfg.huge_pages;
     if (!init(state.mem)) {
         LOG_ERROR("Failed to initialize memory for emulator state!");
         return false;
     }
 
-    if (!state.audio.init(resume_thread, state.cfg.audio_backend)) {
-        LOG_WARN("Failed to init audio! Audio will not work.");
-    }
+    // The audio doesn't depend on the file system or the renderer, with fast boot it is initialized at the same time
+    util::BootStages stages(state.cfg.fast_boot);
+
+    state.audio.host_affinity = util::get_host_core_pinning(state.cfg.host_core_pinning, util::get_host_cpus()).audio;
+    state.audio.latency_ms = state.cfg.audio_latency;
+    set_hardware_video_decode(state.cfg.hardware_video_decode);
+    set_video_decode_threading(state.cfg.video_decode_threads, state.cfg.video_frame_threading);
+    stages.run("audio", [&state, resume_thread]() {
+        if (!state.audio.init(resume_thread, state.cfg.audio_backend)) {
+            LOG_WARN("Failed to init audio! Audio will not work.");
+        }
+    });
 
-    if (!init(state.io, state.base_path, state.pref_path, state.cfg.console)) {
+    bool io_initialized = false;
+    stages.run_here("io", [&state, &io_initialized]() {
+        io_initialized = init(state.io, state.base_path, state.pref_path, state.cfg.console);
+    });
+    if (!io_initialized) {
         LOG_ERROR("Failed to initialize file system for the emulator!");
         return false;
     }
+    if (state.cfg.file_cache_size > 0)
+        state.io.block_cache = std::make_unique<BlockCache>(static_cast<size_t>(state.cfg.file_cache_size) * 1024 * 1024);
 
+    ngs::atrac9::set_decoded_cache_size(static_cast<size_t>(std::max(state.cfg.ngs_atrac9_cache_size, 0)) * 1024 * 1024);
     if (!ngs::init(state.ngs, state.mem)) {
         LOG_ERROR("Failed to initialize ngs.");
         return false;
@@ -187,8 +208,17 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
     }
 #endif
 
+    bool renderer_initialized = false;
+    if (!state.cfg.console) {
+        stages.run_here("renderer", [&state, &renderer_initialized]() {
+            renderer_initialized = renderer::init(state.window.get(), state.renderer, state.backend_renderer, state.cfg, state.base_path.data());
+        });
+    }
+
+    stages.wait();
+
     if (!state.cfg.console) {
-        if (renderer::init(state.window.get(), state.renderer, state.backend_renderer, state.cfg, state.base_path.data())) {
+        if (renderer_initialized) {
             update_viewport(state);
             return true;
         } else {
@@ -0,0 +1,331 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <app/benchmark.h>
+
+#include <config/state.h>
+#include <config/version.h>
+#include <display/state.h>
+#include <emuenv/state.h>
+#include <io/state.h>
+#include <kernel/state.h>
+#include <packages/sfo.h>
+#include <renderer/state.h>
+
+#include <util/log.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace app {
+
+static uint64_t elapsed_us(const std::chrono::steady_clock::time_point &from, const std::chrono::steady_clock::time_point &to) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+static uint64_t counter_delta(const uint64_t value, const uint64_t last) {
+    return value - std::min(value, last);
+}
+
+// names of the draw profile stages in the report
+static const char *const draw_stage_names[renderer::DRAW_PROFILE_STAGE_COUNT] = {
+    "set_state",
+    "texture_hash",
+    "texture_decode",
+    "texture_upload",
+    "pipeline",
+    "descriptors",
+    "vertex_index",
+    "record",
+};
+
+static std::string escape_json(const std::string &str) {
+    std::string res;
+    res.reserve(str.size());
+    for (const unsigned char c : str) {
+        switch (c) {
+        case '"': res += "\\\""; break;
+        case '\\': res += "\\\\"; break;
+        case '\n': res += "\\n"; break;
+        case '\r': res += "\\r"; break;
+        case '\t': res += "\\t"; break;
+        default:
+            if (c < 0x20)
+                res += fmt::format("\\u{:04x}", c);
+            else
+                res += static_cast<char>(c);
+            break;
+        }
+    }
+    return res;
+}
+
+// percentile of the sorted values using the nearest rank
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    const size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+Benchmark::Benchmark(EmuEnvState &emuenv)
+    : emuenv(emuenv)
+    , render_thread_clock(util::ThreadCpuClock::current()) {
+    emuenv.renderer->gpu_timing = true;
+    emuenv.renderer->draw_profile.enabled = true;
+    // the markers pushed before the benchmark are counted in its first frame
+    emuenv.kernel.razor_markers.capturing = true;
+
+    start_time = std::chrono::steady_clock::now();
+    last_present = start_time;
+    start_vblank = emuenv.display.vblank_count;
+    last_vblank = start_vblank;
+    last_render_thread_cpu = render_thread_clock.get_time_us();
+    last_gpu_time_ns = emuenv.renderer->gpu_time_ns;
+    last_gpu_scene_count = emuenv.renderer->gpu_scene_count;
+    last_gpu_present_time_ns = emuenv.renderer->gpu_present_time_ns;
+    last_gpu_busy_ns = emuenv.renderer->gpu_busy_ns;
+    last_shaders_compiled = emuenv.renderer->shaders_count_compiled;
+    last_pipelines_compiled = emuenv.renderer->pipelines_count_compiled;
+    last_draw_profile = emuenv.renderer->draw_profile.get_totals();
+
+    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    for (const auto &[thid, thread] : emuenv.kernel.threads)
+        threads[thid] = { thread->name, thread->host_cpu_clock.get_time_us(), 0 };
+
+    LOG_INFO("Benchmark started, {} vblanks, {} seconds", emuenv.cfg.benchmark_vblanks, emuenv.cfg.benchmark_seconds);
+}
+
+void Benchmark::frame() {
+    const auto now = std::chrono::steady_clock::now();
+
+    BenchmarkFrame frame;
+    frame.time = elapsed_us(start_time, now);
+    frame.present_interval = elapsed_us(last_present, now);
+    last_present = now;
+
+    const uint64_t render_thread_cpu = render_thread_clock.get_time_us();
+    frame.render_thread_cpu = render_thread_cpu - std::min(render_thread_cpu, last_render_thread_cpu);
+    last_render_thread_cpu = render_thread_cpu;
+
+    const uint64_t gpu_time_ns = emuenv.renderer->gpu_time_ns;
+    frame.gpu_time = (gpu_time_ns - last_gpu_time_ns) / 1000;
+    last_gpu_time_ns = gpu_time_ns;
+    const uint64_t gpu_scene_count = emuenv.renderer->gpu_scene_count;
+    frame.gpu_scenes = gpu_scene_count - last_gpu_scene_count;
+    last_gpu_scene_count = gpu_scene_count;
+    const uint64_t gpu_present_time_ns = emuenv.renderer->gpu_present_time_ns;
+    frame.gpu_present_time = (gpu_present_time_ns - last_gpu_present_time_ns) / 1000;
+    last_gpu_present_time_ns = gpu_present_time_ns;
+    const uint64_t gpu_busy_ns = emuenv.renderer->gpu_busy_ns;
+    frame.gpu_busy = (gpu_busy_ns - last_gpu_busy_ns) / 1000;
+    last_gpu_busy_ns = gpu_busy_ns;
+
+    const uint64_t vblank = emuenv.display.vblank_count;
+    frame.vblanks = vblank - last_vblank;
+    last_vblank = vblank;
+
+    const uint32_t shaders_compiled = emuenv.renderer->shaders_count_compiled;
+    const uint32_t pipelines_compiled = emuenv.renderer->pipelines_count_compiled;
+    frame.shaders_compiled = shaders_compiled - last_shaders_compiled;
+    frame.pipelines_compiled = pipelines_compiled - last_pipelines_compiled;
+    last_shaders_compiled = shaders_compiled;
+    last_pipelines_compiled = pipelines_compiled;
+
+    const renderer::DrawProfileTotals draw_profile = emuenv.renderer->draw_profile.get_totals();
+    for (uint32_t i = 0; i < renderer::DRAW_PROFILE_STAGE_COUNT; i++)
+        frame.draw_stages[i] = counter_delta(draw_profile.stage_us[i], last_draw_profile.stage_us[i]);
+    frame.draws = counter_delta(draw_profile.draws, last_draw_profile.draws);
+    frame.state_changes = counter_delta(draw_profile.state_changes, last_draw_profile.state_changes);
+    frame.texture_uploads = counter_delta(draw_profile.texture_uploads, last_draw_profile.texture_uploads);
+    frame.upload_bytes = counter_delta(draw_profile.upload_bytes, last_draw_profile.upload_bytes);
+    last_draw_profile = draw_profile;
+
+    {
+        const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+        frame.threads_cpu.reserve(emuenv.kernel.threads.size());
+        for (const auto &[thid, thread] : emuenv.kernel.threads) {
+            // the clock of an exited thread stays at 0, keep its last time
+            const uint64_t cpu = thread->host_cpu_clock.get_time_us();
+            auto [it, inserted] = threads.try_emplace(thid, ThreadTimes{ thread->name, 0, 0 });
+            if (cpu < it->second.last_cpu)
+                continue;
+            const uint64_t delta = cpu - it->second.last_cpu;
+            it->second.last_cpu = cpu;
+            it->second.total_cpu += delta;
+            frame.threads_cpu.emplace_back(thid, delta);
+        }
+    }
+
+    frame.markers = emuenv.kernel.razor_markers.take();
+    for (const auto &[label, time] : frame.markers)
+        marker_totals[label] += time;
+
+    frames.push_back(std::move(frame));
+}
+
+bool Benchmark::is_done() const {
+    const auto &cfg = emuenv.cfg;
+    if (cfg.benchmark_vblanks && (last_vblank - start_vblank >= cfg.benchmark_vblanks))
+        return true;
+    if ((cfg.benchmark_seconds > 0) && (elapsed_us(start_time, last_present) >= cfg.benchmark_seconds * 1'000'000))
+        return true;
+
+    return false;
+}
+
+bool Benchmark::write_report(const fs::path &path) const {
+    std::vector<uint64_t> intervals;
+    intervals.reserve(frames.size());
+    uint64_t render_thread_cpu = 0;
+    uint64_t gpu_time = 0;
+    uint64_t gpu_scenes = 0;
+    uint64_t gpu_present_time = 0;
+    uint64_t gpu_busy = 0;
+    uint32_t shaders_compiled = 0;
+    uint32_t pipelines_compiled = 0;
+    renderer::DrawProfileTotals draw_profile;
+    for (const auto &frame : frames) {
+        intervals.push_back(frame.present_interval);
+        render_thread_cpu += frame.render_thread_cpu;
+        gpu_time += frame.gpu_time;
+        gpu_scenes += frame.gpu_scenes;
+        gpu_present_time += frame.gpu_present_time;
+        gpu_busy += frame.gpu_busy;
+        shaders_compiled += frame.shaders_compiled;
+        pipelines_compiled += frame.pipelines_compiled;
+        for (uint32_t i = 0; i < renderer::DRAW_PROFILE_STAGE_COUNT; i++)
+            draw_profile.stage_us[i] += frame.draw_stages[i];
+        draw_profile.draws += frame.draws;
+        draw_profile.state_changes += frame.state_changes;
+        draw_profile.texture_uploads += frame.texture_uploads;
+        draw_profile.upload_bytes += frame.upload_bytes;
+    }
+    std::sort(intervals.begin(), intervals.end());
+
+    const uint64_t duration = frames.empty() ? 0 : frames.back().time;
+    const size_t frames_count = std::max<size_t>(frames.size(), 1);
+    const double average_fps = duration ? frames.size() * 1'000'000.0 / duration : 0.0;
+
+    std::string report = "{\n";
+    report += fmt::format("  \"version\": \"{}\",\n", escape_json(window_title));
+    report += fmt::format("  \"title_id\": \"{}\",\n", escape_json(emuenv.io.title_id));
+    report += fmt::format("  \"title\": \"{}\",\n", escape_json(emuenv.current_app_title));
+    report += fmt::format("  \"app_version\": \"{}\",\n", escape_json(emuenv.app_info.app_version));
+    report += "  \"config\": {\n";
+    report += fmt::format("    \"backend_renderer\": \"{}\",\n", escape_json(emuenv.cfg.backend_renderer));
+    report += fmt::format("    \"cpu_backend\": \"{}\",\n", escape_json(emuenv.cfg.current_config.cpu_backend));
+    report += fmt::format("    \"cpu_opt\": {},\n", emuenv.cfg.current_config.cpu_opt);
+    report += fmt::format("    \"cpu_unsafe_opt\": {},\n", emuenv.kernel.cpu_unsafe_opt);
+    report += fmt::format("    \"resolution_multiplier\": {},\n", emuenv.cfg.current_config.resolution_multiplier);
+    report += fmt::format("    \"disable_surface_sync\": {},\n", emuenv.cfg.current_config.disable_surface_sync);
+    report += fmt::format("    \"v_sync\": {},\n", emuenv.cfg.current_config.v_sync);
+    report += fmt::format("    \"frame_skip\": {}\n", emuenv.cfg.current_config.frame_skip);
+    report += "  },\n";
+    report += fmt::format("  \"gpu_timing\": {},\n", emuenv.renderer->supports_gpu_timing());
+    report += fmt::format("  \"duration_us\": {},\n", duration);
+    report += fmt::format("  \"vblanks\": {},\n", last_vblank - start_vblank);
+    report += fmt::format("  \"frames\": {},\n", frames.size());
+    report += "  \"summary\": {\n";
+    report += fmt::format("    \"average_fps\": {:.2f},\n", average_fps);
+    report += fmt::format("    \"present_interval_average_us\": {},\n", duration / frames_count);
+    report += fmt::format("    \"present_interval_p50_us\": {},\n", percentile(intervals, 0.50));
+    report += fmt::format("    \"present_interval_p99_us\": {},\n", percentile(intervals, 0.99));
+    report += fmt::format("    \"present_interval_max_us\": {},\n", intervals.empty() ? 0 : intervals.back());
+    report += fmt::format("    \"render_thread_cpu_average_us\": {},\n", render_thread_cpu / frames_count);
+    report += fmt::format("    \"gpu_time_average_us\": {},\n", gpu_time / frames_count);
+    report += fmt::format("    \"gpu_scene_average_us\": {},\n", gpu_time / std::max<uint64_t>(gpu_scenes, 1));
+    report += fmt::format("    \"gpu_present_average_us\": {},\n", gpu_present_time / frames_count);
+    report += fmt::format("    \"gpu_busy_percent\": {:.1f},\n", duration ? gpu_busy * 100.0 / duration : 0.0);
+    report += fmt::format("    \"shaders_compiled\": {},\n", shaders_compiled);
+    report += fmt::format("    \"pipelines_compiled\": {},\n", pipelines_compiled);
+    // averages per frame, the draws whose cost is over the budget of a frame show up in the stage they spend it in
+    report += "    \"draw_profile\": {\n";
+    report += "      \"stages_average_us\": { ";
+    for (uint32_t i = 0; i < renderer::DRAW_PROFILE_STAGE_COUNT; i++)
+        report += fmt::format("{}\"{}\": {:.1f}", i ? ", " : "", draw_stage_names[i], static_cast<double>(draw_profile.stage_us[i]) / frames_count);
+    report += " },\n";
+    uint64_t draw_profile_total_us = 0;
+    for (const uint64_t stage_us : draw_profile.stage_us)
+        draw_profile_total_us += stage_us;
+    report += fmt::format("      \"draw_cost_average_us\": {:.2f},\n", static_cast<double>(draw_profile_total_us) / std::max<uint64_t>(draw_profile.draws, 1));
+    report += fmt::format("      \"draws_average\": {:.1f},\n", static_cast<double>(draw_profile.draws) / frames_count);
+    report += fmt::format("      \"state_changes_average\": {:.1f},\n", static_cast<double>(draw_profile.state_changes) / frames_count);
+    report += fmt::format("      \"texture_uploads_average\": {:.1f},\n", static_cast<double>(draw_profile.texture_uploads) / frames_count);
+    report += fmt::format("      \"upload_bytes_average\": {}\n", draw_profile.upload_bytes / frames_count);
+    report += "    }\n";
+    report += "  },\n";
+
+    report += "  \"threads\": [\n";
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        report += fmt::format("    {{ \"id\": {}, \"name\": \"{}\", \"cpu_us\": {} }}{}\n", it->first, escape_json(it->second.name),
+            it->second.total_cpu, std::next(it) == threads.end() ? "" : ",");
+    }
+    report += "  ],\n";
+
+    report += "  \"markers\": [\n";
+    for (auto it = marker_totals.begin(); it != marker_totals.end(); ++it) {
+        report += fmt::format("    {{ \"label\": \"{}\", \"total_us\": {}, \"average_us\": {} }}{}\n", escape_json(it->first),
+            it->second, it->second / frames_count, std::next(it) == marker_totals.end() ? "" : ",");
+    }
+    report += "  ],\n";
+
+    report += "  \"frame_list\": [\n";
+    for (size_t i = 0; i < frames.size(); i++) {
+        const auto &frame = frames[i];
+        std::string threads_cpu;
+        for (const auto &[thid, cpu] : frame.threads_cpu) {
+            if (!threads_cpu.empty())
+                threads_cpu += ", ";
+            threads_cpu += fmt::format("\"{}\": {}", thid, cpu);
+        }
+        std::string markers;
+        for (const auto &[label, time] : frame.markers) {
+            if (!markers.empty())
+                markers += ", ";
+            markers += fmt::format("\"{}\": {}", escape_json(label), time);
+        }
+        std::string draw_stages;
+        for (uint32_t s = 0; s < renderer::DRAW_PROFILE_STAGE_COUNT; s++)
+            draw_stages += fmt::format("{}\"{}\": {}", s ? ", " : "", draw_stage_names[s], frame.draw_stages[s]);
+        report += fmt::format("    {{ \"time_us\": {}, \"present_interval_us\": {}, \"vblanks\": {}, \"render_thread_cpu_us\": {}, "
+                              "\"gpu_time_us\": {}, \"gpu_scenes\": {}, \"gpu_present_us\": {}, \"gpu_busy_us\": {}, \"shaders_compiled\": {}, \"pipelines_compiled\": {}, "
+                              "\"draws\": {}, \"state_changes\": {}, \"texture_uploads\": {}, \"upload_bytes\": {}, \"draw_stages_us\": {{ {} }}, \"threads_cpu_us\": {{ {} }}, \"markers_us\": {{ {} }} }}{}\n",
+            frame.time, frame.present_interval, frame.vblanks, frame.render_thread_cpu, frame.gpu_time, frame.gpu_scenes,
+            frame.gpu_present_time, frame.gpu_busy, frame.shaders_compiled,
+            frame.pipelines_compiled, frame.draws, frame.state_changes, frame.texture_uploads, frame.upload_bytes, draw_stages, threads_cpu, markers, i + 1 == frames.size() ? "" : ",");
+    }
+    report += "  ]\n";
+    report += "}\n";
+
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file) {
+        LOG_ERROR("Failed to open the benchmark report: {}", path.string());
+        return false;
+    }
+    file.write(report.data(), report.size());
+    if (!file) {
+        LOG_ERROR("Failed to write the benchmark report: {}", path.string());
+        return false;
+    }
+
+    LOG_INFO("Benchmark report written to {}: {} frames in {:.2f} s, {:.2f} fps on average", path.string(), frames.size(), duration / 1'000'000.0, average_fps);
+    return true;
+}
+
+} // namespace app
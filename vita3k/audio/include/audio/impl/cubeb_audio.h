@@ -39,6 +39,8 @@ struct CubebAudioOutPort : AudioOutPort {
     // position of the next audio buffer to put audio
     int next_audio_buffer = 0;
     int nb_buffers_ready = 0;
+    // counter of the audio state
+    std::atomic<uint32_t> *underruns = nullptr;
 
     // use the destructor to destroy the cubeb stream
     ~CubebAudioOutPort();
@@ -55,4 +57,5 @@ public:
     AudioOutPortPtr open_port(int nb_channels, int freq, int nb_sample) override;
     void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) override;
     void set_volume(AudioOutPort &out_port, float volume) override;
+    float get_latency_ms() override;
 };
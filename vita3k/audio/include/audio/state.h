@@ -17,10 +17,12 @@
 
 #pragma once
 
+#include <threads/spsc_byte_ring.h>
 #include <util/types.h>
 
 #include <SDL_audio.h>
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
@@ -38,15 +40,19 @@ struct AudioOutPort {
     int left_channel_volume = SCE_AUDIO_VOLUME_0DB;
     int right_channel_volume = SCE_AUDIO_VOLUME_0DB;
     // Volume range from 0 to 1
-    float volume = 1.0f;
+    std::atomic<float> volume = 1.0f;
     // length of the buffer for each call
     int len_bytes = 0;
 
     std::mutex mutex;
-    // stream to get the data
+    // stream converting the data to the host format, only used by the threads outputting to the port
     AudioStreamPtr stream;
+    // converted data, read by the audio callback without locking
+    std::unique_ptr<SPSCByteRing> ring;
     // thread currently waiting for the audio to be processed
-    SceUID thread = -1;
+    std::atomic<SceUID> thread = -1;
+    // set by the host callback when it got data from the port, to count the underruns
+    bool was_playing = false;
 };
 
 typedef std::shared_ptr<AudioOutPort> AudioOutPortPtr;
@@ -55,7 +61,15 @@ typedef std::map<int, AudioOutPortPtr> AudioOutPortPtrs;
 struct AudioInPort {
     SDL_AudioDeviceID id;
     bool running = false;
+    // length of the buffer for each call, and the rate of the guest samples
     int len_bytes = 0;
+    int freq = 0;
+    // time the host device may take to give the next samples, a grain is silent once it is exceeded
+    int wait_limit_us = 0;
+    // stream converting the captured samples from the rate of the device, only used by the capture callback
+    AudioStreamPtr stream;
+    // samples at the guest rate, written by the capture callback and read by the inputting thread without locking
+    std::unique_ptr<SPSCByteRing> ring;
 };
 
 struct AudioSpec {
@@ -93,12 +107,20 @@ public:
     virtual AudioOutPortPtr open_port(int nb_channels, int freq, int nb_sample) { return nullptr; }
     virtual void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) {}
     virtual void set_volume(AudioOutPort &out_port, float volume) {}
+    // time between the output of a sample by the guest and its playback by the host
+    virtual float get_latency_ms();
 
     friend struct AudioState;
 };
 
 struct AudioState {
     AudioSpec spec;
+    // copy of the ports read by the audio callback, it never locks the mutex nor changes the ports use count
+    // update_out_ports must be called after out_ports is changed, it is destroyed after the adapter stops the callbacks
+    std::atomic<const std::vector<AudioOutPortPtr> *> out_ports_snapshot = nullptr;
+    std::unique_ptr<const std::vector<AudioOutPortPtr>> out_ports_snapshot_storage;
+    // number of audio callbacks currently reading the snapshot
+    std::atomic<int> callbacks_running = 0;
     // the adapter must be before out_ports for the destructors to work correctly
     std::unique_ptr<AudioAdapter> adapter;
     std::mutex mutex;
@@ -107,10 +129,26 @@ struct AudioState {
     AudioInPort in_port;
     ResumeAudioThread resume_thread;
     std::string audio_backend;
+    // Host cpus the threads of the audio backend are pinned to, 0 to leave them to the OS scheduler
+    uint64_t host_affinity = 0;
+    // latency the host streams are opened with, 0 to use the default of the backend
+    int latency_ms = 0;
+    // times a host callback ran out of data of a port which was playing, including the end of its sound
+    std::atomic<uint32_t> underruns = 0;
 
     bool init(const ResumeAudioThread &resume_thread, const std::string &adapter_name);
     void set_backend(const std::string &adapter_name);
     AudioOutPortPtr open_port(int nb_channels, int freq, int nb_sample);
+    // must be called with the mutex locked (unless no callback can run yet)
+    void update_out_ports();
     void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer);
+    // number of bytes in the host format still to be played by the port
+    int get_rest_bytes(AudioOutPort &out_port);
+    float get_latency_ms();
     void set_volume(AudioOutPort &out_port, float volume);
+    // open the default capture device at its own rate, the samples are given to the guest as mono S16 at freq
+    bool open_in_port(int freq, int nb_samples);
+    void close_in_port();
+    // wait for the next grain captured, it is silent if the device gives nothing in time
+    void audio_input(void *buffer);
 };
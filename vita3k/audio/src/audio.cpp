@@ -24,38 +24,44 @@
 
 #include <kernel/thread/thread_state.h>
 
+#include <util/host_cpu.h>
 #include <util/log.h>
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
+#include <thread>
 
-static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOutPort &port, const ResumeAudioThread &resume_thread) {
+static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOutPort &port, const ResumeAudioThread &resume_thread, std::atomic<uint32_t> &underruns) {
     ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
 
+    if (!port.ring)
+        return;
+
     // How much data is available?
-    std::unique_lock<std::mutex> lock(port.mutex);
-    const int bytes_available = SDL_AudioStreamAvailable(port.stream.get());
-    assert(bytes_available >= 0);
+    const int bytes_available = static_cast<int>(port.ring->size());
 
     // Running out of data?
     // The (len * 3) is according to the value in sceAudioOutOutput
     if (bytes_available < len * 3) {
         // Is there a thread waiting for playback to finish?
-        if (port.thread >= 0) {
+        const SceUID thread = port.thread.exchange(-1);
+        if (thread >= 0) {
             // Wake the thread up.
-            resume_thread(port.thread);
-            port.thread = -1;
+            resume_thread(thread);
         }
     }
 
+    if (bytes_available < len && port.was_playing)
+        underruns++;
+    port.was_playing = bytes_available > 0;
+
     if (bytes_available == 0)
         return;
 
     // Mix as much as we need.
-    const int bytes_to_get = std::min(len, bytes_available);
-    const int bytes_got = SDL_AudioStreamGet(port.stream.get(), temp_buffer, bytes_to_get);
-    lock.unlock();
+    const int bytes_got = static_cast<int>(port.ring->read(temp_buffer, len));
     if (bytes_got > 0) {
         SDL_MixAudioFormat(stream, temp_buffer, AUDIO_S16LSB, bytes_got, static_cast<int>(port.volume * SDL_MIX_MAXVOLUME));
     }
@@ -65,22 +71,56 @@ void AudioAdapter::audio_callback(uint8_t *stream, int len_bytes) {
     tracy::SetThreadName("Host audio thread"); // Tracy - Declare belonging of this function to the audio thread
     ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
 
-    std::vector<AudioOutPortPtr> ports;
+    // Backends may call back from more than one thread
+    thread_local uint64_t pinned_affinity = 0;
+    if ((state.host_affinity != pinned_affinity) && util::set_current_thread_affinity(state.host_affinity))
+        pinned_affinity = state.host_affinity;
+
+    std::memset(stream, state.spec.silence, len_bytes);
+
+    // Read from shared state, the snapshot is not freed until the callbacks are done with it
+    state.callbacks_running.fetch_add(1);
+    const std::vector<AudioOutPortPtr> *ports = state.out_ports_snapshot.load();
+    if (ports) {
+        for (const AudioOutPortPtr &port : *ports) {
+            mix_out_port(stream, temp_buffer.data(), len_bytes, *port, state.resume_thread, state.underruns);
+        }
+    }
+    state.callbacks_running.fetch_sub(1);
+
+    FrameMarkNamed("Audio"); // Tracy - End discontinuous frame for audio rendering
+}
+
+// move the data already converted by the stream of the port to its ring
+static void flush_port_stream(AudioOutPort &port) {
+    uint8_t chunk[4096];
+    while (true) {
+        // keep whole stereo frames
+        const int chunk_size = std::min<int>(sizeof(chunk), static_cast<int>(port.ring->free_space()) & ~3);
+        const int bytes_got = chunk_size > 0 ? SDL_AudioStreamGet(port.stream.get(), chunk, chunk_size) : 0;
+        if (bytes_got <= 0)
+            break;
+
+        port.ring->write(chunk, bytes_got);
+    }
+}
+
+float AudioAdapter::get_latency_ms() {
+    if (state.spec.freq == 0)
+        return 0.0f;
+
+    // a host buffer and the data queued in the port which is the most ahead
+    int queued_bytes = 0;
     {
-        // Read from shared state.
         const std::lock_guard<std::mutex> lock(state.mutex);
-        ports.reserve(state.out_ports.size());
         for (const AudioOutPortPtrs::value_type &port : state.out_ports) {
-            ports.push_back(port.second);
+            if (port.second->ring)
+                queued_bytes = std::max(queued_bytes, static_cast<int>(port.second->ring->size()));
         }
     }
-    std::memset(stream, state.spec.silence, len_bytes);
-
-    for (const AudioOutPortPtr &port : ports) {
-        mix_out_port(stream, temp_buffer.data(), len_bytes, *port.get(), state.resume_thread);
-    }
 
-    FrameMarkNamed("Audio"); // Tracy - End discontinuous frame for audio rendering
+    const int queued_samples = state.spec.nb_samples + queued_bytes / static_cast<int>(2 * sizeof(int16_t));
+    return queued_samples * 1000.0f / state.spec.freq;
 }
 
 bool AudioState::init(const ResumeAudioThread &resume_thread, const std::string &adapter_name) {
@@ -99,6 +139,7 @@ void AudioState::set_backend(const std::string &adapter_name) {
 
     // first delete all ports then delete the backend
     out_ports.clear();
+    update_out_ports();
     adapter.reset();
     if (adapter_name == "SDL") {
         adapter = std::make_unique<SDLAudioAdapter>(*this);
@@ -120,6 +161,21 @@ void AudioState::set_backend(const std::string &adapter_name) {
     adapter->temp_buffer.resize(spec.nb_samples * 2 * sizeof(uint16_t));
 }
 
+void AudioState::update_out_ports() {
+    auto snapshot = std::make_unique<std::vector<AudioOutPortPtr>>();
+    snapshot->reserve(out_ports.size());
+    for (const AudioOutPortPtrs::value_type &port : out_ports)
+        snapshot->push_back(port.second);
+
+    out_ports_snapshot.store(snapshot.get());
+    // a callback may still read the previous snapshot, they never take long
+    while (callbacks_running.load() != 0)
+        std::this_thread::yield();
+
+    // the removed ports are released here, not in the callback
+    out_ports_snapshot_storage = std::move(snapshot);
+}
+
 AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample) {
     if (adapter->single_stream) {
         // handle everything here
@@ -131,6 +187,11 @@ AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample)
         port->len_bytes = nb_sample * nb_channels * sizeof(int16_t);
         port->stream = stream;
 
+        // the outputting thread waits once 3 callbacks worth of data is queued, leave room for it and a converted output
+        const int callback_bytes = spec.nb_samples * 2 * sizeof(int16_t);
+        const int converted_output_bytes = (nb_sample * spec.freq / std::max(freq, 1) + 1) * 2 * sizeof(int16_t);
+        port->ring = std::make_unique<SPSCByteRing>(4 * (callback_bytes + converted_output_bytes));
+
         return port;
     } else {
         // let the adapter open the port
@@ -141,10 +202,11 @@ AudioOutPortPtr AudioState::open_port(int nb_channels, int freq, int nb_sample)
 
 void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) {
     if (adapter->single_stream) {
-        // Put audio to the port's stream and see how much is left to play.
+        // Put audio to the port's stream, pass it to the callback and see how much is left to play.
         std::unique_lock<std::mutex> lock(out_port.mutex);
         SDL_AudioStreamPut(out_port.stream.get(), buffer, out_port.len_bytes);
-        const int available = SDL_AudioStreamAvailable(out_port.stream.get());
+        flush_port_stream(out_port);
+        const int available = static_cast<int>(out_port.ring->size()) + SDL_AudioStreamAvailable(out_port.stream.get());
         lock.unlock();
 
         // If there's lots of audio left to play, stop this thread.
@@ -158,6 +220,7 @@ void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const
             out_port.thread = thread.id;
 
             std::unique_lock<std::mutex> mlock(thread.mutex);
+            thread.wait_reason = ThreadWaitReason::audio;
             thread.update_status(ThreadStatus::wait);
             thread.status_cond.wait(mlock, [&]() { return thread.status == ThreadStatus::run; });
         }
@@ -166,8 +229,116 @@ void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const
     }
 }
 
+int AudioState::get_rest_bytes(AudioOutPort &out_port) {
+    if (!out_port.ring)
+        return 0;
+
+    const std::lock_guard<std::mutex> lock(out_port.mutex);
+    return static_cast<int>(out_port.ring->size()) + SDL_AudioStreamAvailable(out_port.stream.get());
+}
+
+float AudioState::get_latency_ms() {
+    return adapter ? adapter->get_latency_ms() : 0.0f;
+}
+
 void AudioState::set_volume(AudioOutPort &out_port, float volume) {
     out_port.volume = volume;
 
     adapter->set_volume(out_port, volume);
 }
+
+// grains kept in the ring of the input port, the older ones are dropped when the guest reads late
+static constexpr int IN_PORT_QUEUED_GRAINS = 4;
+
+static void audio_in_callback(void *userdata, Uint8 *stream, int len) {
+    ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
+
+    AudioInPort &port = *static_cast<AudioInPort *>(userdata);
+    if (!port.stream) {
+        port.ring->write(stream, len);
+        return;
+    }
+
+    SDL_AudioStreamPut(port.stream.get(), stream, len);
+    uint8_t chunk[4096];
+    while (true) {
+        // keep whole mono frames
+        const int chunk_size = std::min<int>(sizeof(chunk), static_cast<int>(port.ring->free_space()) & ~1);
+        const int bytes_got = chunk_size > 0 ? SDL_AudioStreamGet(port.stream.get(), chunk, chunk_size) : 0;
+        if (bytes_got <= 0)
+            break;
+
+        port.ring->write(chunk, bytes_got);
+    }
+}
+
+bool AudioState::open_in_port(int freq, int nb_samples) {
+    SDL_AudioSpec desired = {};
+    SDL_AudioSpec received = {};
+    desired.freq = freq;
+    desired.format = AUDIO_S16LSB;
+    desired.channels = 1;
+    desired.samples = nb_samples;
+    desired.callback = audio_in_callback;
+    desired.userdata = &in_port;
+
+    // the device keeps its own rate, its samples are converted by the callback instead of the driver
+    in_port.id = SDL_OpenAudioDevice(nullptr, true, &desired, &received, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (in_port.id == 0) {
+        LOG_ERROR("Failed to open the audio capture device: {}", SDL_GetError());
+        return false;
+    }
+
+    in_port.len_bytes = nb_samples * sizeof(int16_t);
+    in_port.freq = freq;
+    in_port.stream.reset();
+    if (received.freq != freq) {
+        in_port.stream = AudioStreamPtr(SDL_NewAudioStream(AUDIO_S16LSB, 1, received.freq, AUDIO_S16LSB, 1, freq), SDL_FreeAudioStream);
+        if (!in_port.stream) {
+            SDL_CloseAudioDevice(in_port.id);
+            return false;
+        }
+    }
+    in_port.ring = std::make_unique<SPSCByteRing>(IN_PORT_QUEUED_GRAINS * in_port.len_bytes);
+    // a grain and a buffer of the device
+    in_port.wait_limit_us = static_cast<int>((static_cast<int64_t>(nb_samples) * 1'000'000 / freq) + (static_cast<int64_t>(received.samples) * 1'000'000 / received.freq));
+
+    SDL_PauseAudioDevice(in_port.id, 0);
+    in_port.running = true;
+    return true;
+}
+
+void AudioState::close_in_port() {
+    in_port.running = false;
+    // the callback is done once the device is closed
+    SDL_CloseAudioDevice(in_port.id);
+    in_port.stream.reset();
+    in_port.ring.reset();
+}
+
+void AudioState::audio_input(void *buffer) {
+    ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
+
+    SPSCByteRing &ring = *in_port.ring;
+    const size_t len_bytes = in_port.len_bytes;
+
+    // only the last grain is given when the guest fell behind, so the capture stays low latency
+    const size_t queued = ring.size();
+    if (queued >= 2 * len_bytes)
+        ring.discard((queued / len_bytes - 1) * len_bytes);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(in_port.wait_limit_us);
+    while (ring.size() < len_bytes) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            std::memset(buffer, 0, len_bytes);
+            return;
+        }
+
+        // sleep until the missing samples should be captured
+        const int64_t missing_samples = static_cast<int64_t>(len_bytes - ring.size()) / sizeof(int16_t);
+        const auto missing_time = std::chrono::microseconds(std::max<int64_t>(missing_samples * 1'000'000 / in_port.freq, 500));
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(missing_time, deadline - now));
+    }
+    ring.read(buffer, len_bytes);
+}
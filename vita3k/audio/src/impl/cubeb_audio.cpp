@@ -33,6 +33,8 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
     const int bytes_to_give = nframes * port->spec.channels * sizeof(uint16_t);
     while (bytes_given < bytes_to_give) {
         if (port->nb_buffers_ready == 0) {
+            if (port->was_playing)
+                (*port->underruns)++;
             // no data available, should we wait for it or return nothing?
             // return nothing for now
             break;
@@ -55,6 +57,7 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
 
         bytes_given += bytes_to_copy;
     }
+    port->was_playing = bytes_given == bytes_to_give;
 
     return nframes;
 }
@@ -103,6 +106,9 @@ AudioOutPortPtr CubebAudioAdapter::open_port(int nb_channels, int freq, int nb_s
 
     uint32_t latency;
     cubeb_get_min_latency(cubeb_ctx, &port->spec, &latency);
+    if (state.latency_ms > 0)
+        latency = std::max<uint32_t>(latency, freq * state.latency_ms / 1000);
+    port->underruns = &state.underruns;
 
     if (cubeb_stream_init(cubeb_ctx, &port->out_stream, "Vita3K audio out", nullptr, nullptr, nullptr,
             &port->spec, latency, impl_cubeb_audio_callback, impl_cubeb_state_callback, port.get())
@@ -151,6 +157,23 @@ void CubebAudioAdapter::audio_output(ThreadState &thread, AudioOutPort &out_port
     port.cond_var.notify_one();
 }
 
+float CubebAudioAdapter::get_latency_ms() {
+    // each port has its own host stream, report the one with the most latency
+    float latency_ms = 0.0f;
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    for (const AudioOutPortPtrs::value_type &out_port : state.out_ports) {
+        const CubebAudioOutPort &port = static_cast<const CubebAudioOutPort &>(*out_port.second);
+        uint32_t stream_latency = 0;
+        if (!port.out_stream || cubeb_stream_get_latency(port.out_stream, &stream_latency) != CUBEB_OK)
+            continue;
+
+        const uint32_t queued_samples = stream_latency + port.nb_buffers_ready * port.len_bytes / (port.spec.channels * sizeof(uint16_t));
+        latency_ms = std::max(latency_ms, queued_samples * 1000.0f / port.spec.rate);
+    }
+
+    return latency_ms;
+}
+
 void CubebAudioAdapter::set_volume(AudioOutPort &out_port, float volume) {
     CubebAudioOutPort &port = static_cast<CubebAudioOutPort &>(out_port);
     cubeb_stream_set_volume(port.out_stream, volume);
@@ -21,6 +21,9 @@
 
 #include "util/log.h"
 
+#include <algorithm>
+#include <bit>
+
 static void SDLCALL sdl_audio_callback(void *userdata, Uint8 *stream, int len) {
     assert(userdata != nullptr);
     assert(stream != nullptr);
@@ -45,6 +48,11 @@ bool SDLAudioAdapter::init() {
     desired.format = AUDIO_S16LSB;
     desired.channels = 2;
     desired.samples = 512;
+    if (state.latency_ms > 0) {
+        // the SDL backends want a power of two
+        const uint32_t samples = desired.freq * state.latency_ms / 1000;
+        desired.samples = static_cast<Uint16>(std::bit_ceil(std::clamp<uint32_t>(samples, 64, 8192)));
+    }
     desired.callback = sdl_audio_callback;
     desired.userdata = this;
 
@@ -62,6 +70,7 @@ bool SDLAudioAdapter::init() {
         .nb_samples = spec.samples,
         .silence = spec.silence
     };
+    LOG_INFO("SDL audio output at {} Hz with {} samples per callback ({:.1f} ms)", spec.freq, spec.samples, spec.samples * 1000.0f / spec.freq);
 
     SDL_PauseAudioDevice(device_id, 0);
 
@@ -0,0 +1,84 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Times the YCbCr to RGBA conversion of the jpeg decoder against its scalar reference on a few image sizes
+// and checks that they give the same result. Returns a non-zero value if they differ.
+
+#include <codec/ycbcr.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+static constexpr int ITERATIONS = 50;
+
+struct ImageSize {
+    uint32_t width;
+    uint32_t height;
+};
+
+// camera preview, screen sized fmv, photos of the camera
+static constexpr ImageSize SIZES[] = { { 320, 240 }, { 480, 272 }, { 640, 480 }, { 960, 544 }, { 1920, 1080 } };
+
+static double time_us(const std::function<void()> &run) {
+    run();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        run();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / ITERATIONS;
+}
+
+int main() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte_dist(0, 255);
+    bool success = true;
+
+    std::printf("Using %s kernel\n", get_ycbcr_convert_isa());
+    std::printf("%-10s %13s %13s %7s\n", "size", "basic", "fast", "speedup");
+    for (const ImageSize &size : SIZES) {
+        const size_t plane_size = static_cast<size_t>(size.width) * size.height;
+        std::vector<uint8_t> ycbcr(plane_size * 3);
+        for (uint8_t &value : ycbcr)
+            value = static_cast<uint8_t>(byte_dist(rng));
+        std::vector<uint8_t> basic_rgba(plane_size * 4);
+        std::vector<uint8_t> fast_rgba(plane_size * 4);
+
+        const auto basic = [&]() {
+            for (uint32_t row = 0; row < size.height; row++) {
+                const size_t offset = static_cast<size_t>(row) * size.width;
+                convert_ycbcr_row_to_rgba_basic(&basic_rgba[offset * 4], &ycbcr[offset], &ycbcr[plane_size + offset], &ycbcr[plane_size * 2 + offset], size.width);
+            }
+        };
+        const auto fast = [&]() { convert_ycbcr_to_rgba(ycbcr.data(), fast_rgba.data(), size.width, size.height, size.width); };
+
+        const double basic_time = time_us(basic);
+        const double fast_time = time_us(fast);
+        const bool same = std::memcmp(basic_rgba.data(), fast_rgba.data(), basic_rgba.size()) == 0;
+        success &= same;
+
+        char name[16];
+        std::snprintf(name, sizeof(name), "%ux%u", size.width, size.height);
+        std::printf("%-10s %10.2f us %10.2f us %6.2fx%s\n", name, basic_time, fast_time, basic_time / fast_time, same ? "" : "  MISMATCH");
+    }
+
+    return success ? 0 : 1;
+}
@@ -18,10 +18,15 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
 struct AVFrame;
 struct AVPacket;
@@ -59,8 +64,31 @@ enum class DecoderQuery {
     AT9_SUPERFRAME_SIZE,
 };
 
+// time spent decoding the frames of a stream, logged when its decoder is closed
+struct DecoderStats {
+    uint64_t frames = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+
+    // steady clock, in microseconds
+    static uint64_t now_us();
+    void add(uint64_t frame_us);
+    void log(const char *stream) const;
+};
+
+// codec and parameters an audio decoder context is opened with, a pooled context is only reused with the same ones
+struct AudioContextKey {
+    int codec_id;
+    uint32_t channels;
+    // 0 when the decoder reads it from the stream
+    uint32_t sample_rate;
+
+    bool operator==(const AudioContextKey &other) const = default;
+};
+
 struct DecoderState {
     AVCodecContext *context{};
+    DecoderStats stats;
 
     virtual uint32_t get(DecoderQuery query);
 
@@ -93,6 +121,9 @@ struct H264DecoderState : public DecoderState {
 
     bool is_stopped = true;
 
+    // time spent in send, added to the stats once the frame is received
+    uint64_t pending_decode_us = 0;
+
     static uint32_t buffer_size(DecoderSize size);
 
     uint32_t get(DecoderQuery query) override;
@@ -108,8 +139,15 @@ struct H264DecoderState : public DecoderState {
 };
 
 struct MjpegDecoderState : public DecoderState {
+    uint64_t pending_decode_us = 0;
+    // guest buffer the frame being decoded can be written in directly, only set during decode
+    uint8_t *output = nullptr;
+    uint32_t output_size = 0;
+
     bool send(const uint8_t *data, uint32_t size) override;
     bool receive(uint8_t *data, DecoderSize *size) override;
+    // decode the jpeg as yuv444p in data, data_size being the size of the buffer
+    bool decode(const uint8_t *jpeg, uint32_t jpeg_size, uint8_t *data, uint32_t data_size, DecoderSize *size);
 
     MjpegDecoderState();
 };
@@ -137,7 +175,12 @@ struct Atrac9DecoderState : public DecoderState {
 
 struct Mp3DecoderState : public DecoderState {
     AVCodec *codec;
+    AudioContextKey context_key;
     uint32_t es_size_used;
+    // reused by each packet sent and frame received
+    AVPacket *packet;
+    AVFrame *frame;
+    std::vector<uint8_t> packet_data;
 
     uint32_t get(DecoderQuery query) override;
     uint32_t get_es_size() override;
@@ -190,7 +233,13 @@ public:
 
 struct AacDecoderState : public DecoderState {
     AVCodec *codec;
+    AudioContextKey context_key;
     AVFrame *frame;
+    AVPacket *packet;
+    // converts the frames to s16, created again only when the channels or the sample rate of the stream change
+    SwrContext *swr = nullptr;
+    uint32_t swr_channels = 0;
+    uint32_t swr_sample_rate = 0;
     uint32_t es_size_used;
     uint32_t get(DecoderQuery query) override;
 
@@ -204,29 +253,75 @@ struct AacDecoderState : public DecoderState {
     ~AacDecoderState();
 };
 
+// frames decoded ahead by the decode thread of a player, the video ones are already in the yuv420p layout given to the guest
+struct PlayerVideoFrame {
+    std::vector<uint8_t> data;
+    DecoderSize size;
+    uint64_t timestamp = 0;
+    // time during which the frame is shown, from its pts or the average frame rate if the stream doesn't give it
+    uint64_t duration_microseconds = 0;
+};
+
+struct PlayerAudioFrame {
+    std::vector<int16_t> data;
+    uint32_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint32_t sample_count = 0;
+};
+
 struct PlayerState {
+    // frames decoded ahead of the guest, the decode thread waits once both queues are full
+    static constexpr size_t MAX_VIDEO_FRAMES = 8;
+    static constexpr size_t MAX_AUDIO_FRAMES = 32;
+
+    // guarded by mutex, the decode thread opens the next queued video once the current one is decoded
     std::string video_playing;
     std::queue<std::string> videos_queue;
 
+    // only used by the decode thread while it runs
     AVFormatContext *format{};
     AVCodecContext *video_context{};
     AVCodecContext *audio_context{};
     int32_t video_stream_id = -1;
     int32_t audio_stream_id = -1;
+    // set once the end of the file has been sent to the video decoder to get the frames it still holds
+    bool video_drained = false;
+    bool video_ended = false;
+    bool audio_ended = false;
+
+    DecoderStats video_stats;
+    DecoderStats audio_stats;
 
     std::queue<AVPacket *> audio_packets;
     std::queue<AVPacket *> video_packets;
 
-    uint64_t time_of_last_frame = 0;
+    std::thread decode_thread;
+    std::mutex mutex;
+    // notified by the decode thread when it queues a frame or has decoded the last video
+    std::condition_variable frame_ready;
+    // notified when the guest takes a frame, queues a video or the decode thread must stop
+    std::condition_variable decode_wake;
+    bool stop_decode = false;
+    // the last queued video has been decoded entirely, playback stops once the guest reaches the end of its frames
+    bool decode_finished = false;
+    std::deque<PlayerVideoFrame> video_frames;
+    std::deque<PlayerAudioFrame> audio_frames;
+    // size and average frame duration of the video opened last, and whether it has an audio stream
+    DecoderSize video_size;
     uint64_t framerate_microseconds = 0;
+    bool has_audio = false;
+
+    uint64_t time_of_last_frame = 0;
 
     uint64_t last_timestamp = 0;
     uint32_t last_channels = 0;
     uint32_t last_sample_rate = 0;
     uint32_t last_sample_count = 0;
 
+    // size and duration of the next video frame, or of the video opened last if no frame is queued
     DecoderSize get_size();
     uint64_t get_framerate_microseconds();
+    bool is_playing();
 
     void pop_video();
     void free_video();
@@ -234,14 +329,42 @@ struct PlayerState {
 
     bool next_packet(int32_t stream_id);
 
+    // wait for the first audio frame to be decoded and set the last audio fields from it, without taking it
+    bool get_audio_info();
+    // take the next decoded frame, empty if the decode thread is behind or the playback is over
     std::vector<int16_t> receive_audio();
     std::vector<uint8_t> receive_video();
 
     void queue(const std::string &path);
 
     ~PlayerState();
+
+private:
+    void open_video(const std::string &path);
+    void close_video();
+    void stop_decode_thread();
+    void decode_loop();
+    void decode_audio_frame();
+    void decode_video_frame();
 };
 
-void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height);
-void copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest);
+// convert a yuv444p image to rgba, rgba_pitch being the width in pixels of the output
+void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, uint32_t rgba_pitch);
+// copy the frame as yuv420p, a frame decoded by the GPU is downloaded first, return false if it can't be converted
+bool copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest);
 std::string codec_error_name(int error);
+
+// take an opened context of the pool, flushed, or open a new one if none was opened with this key
+AVCodecContext *open_audio_decoder_context(const AudioContextKey &key);
+// give the context back to the pool for the next decoder opened with the same key, the oldest one is closed once it is full
+void close_audio_decoder_context(AVCodecContext *&context, const AudioContextKey &key);
+
+// when enabled, the video decoders opened afterwards decode on the GPU if FFmpeg supports a hardware device of the host for them
+void set_hardware_video_decode(bool enable);
+// must be called before opening the context, fall back to software decode if no hardware device can be used
+void init_hardware_video_decode(AVCodecContext *context, const AVCodec *codec);
+// threads used by each software video decoder, 0 picks a count which leaves the cores of the guest cpu, renderer and audio threads
+// frame threading is only used by the decoders which can output their frames late (not the sceVideodec ones, which return one picture per au)
+void set_video_decode_threading(int threads, bool frame_threading);
+// must be called before opening the context and after init_hardware_video_decode, the audio decoders stay single threaded
+void init_video_decode_threading(AVCodecContext *context, const AVCodec *codec, bool allow_frame_threading);
@@ -0,0 +1,45 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The YCbCr to RGBA conversion of the jpeg decoder has SIMD implementations, the one used is picked
+// at runtime according to what the host supports. The basic implementation is the scalar reference.
+#if defined(__x86_64__) || defined(_M_X64)
+#define YCBCR_CONVERT_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define YCBCR_CONVERT_TARGET(isa)
+#else
+#define YCBCR_CONVERT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define YCBCR_CONVERT_NEON
+#endif
+
+// name of the instruction set used by the conversion, for the logs and the benchmark
+const char *get_ycbcr_convert_isa();
+
+// convert count pixels of full range (JFIF) YCbCr planes to RGBA8888 with an opaque alpha
+void convert_ycbcr_row_to_rgba_basic(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count);
+void convert_ycbcr_row_to_rgba(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count);
+
+// convert a YCbCr 4:4:4 image whose planes follow each other, the rows of the large images are split between threads
+void convert_ycbcr_to_rgba(const uint8_t *ycbcr, uint8_t *rgba, uint32_t width, uint32_t height, uint32_t rgba_pitch);
@@ -30,7 +30,7 @@ extern "C" {
 
 #include <util/log.h>
 
-static void convert_f32_to_s16(const float *f32, int16_t *s16, uint32_t channels, uint32_t samples, uint32_t freq) {
+static SwrContext *create_f32_to_s16(uint32_t channels, uint32_t freq) {
     const int channel_type = channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
 
     SwrContext *swr = swr_alloc_set_opts(nullptr,
@@ -39,8 +39,11 @@ static void convert_f32_to_s16(const float *f32, int16_t *s16, uint32_t channels
         0, nullptr);
     swr_init(swr);
 
+    return swr;
+}
+
+static void convert_f32_to_s16(SwrContext *swr, const float *f32, int16_t *s16, uint32_t samples) {
     const int result = swr_convert(swr, (uint8_t **)&s16, samples, (const uint8_t **)(f32), samples);
-    swr_free(&swr);
     assert(result > 0);
 }
 
@@ -55,7 +58,6 @@ uint32_t AacDecoderState::get(DecoderQuery query) {
 }
 
 bool AacDecoderState::send(const uint8_t *data, uint32_t size) {
-    AVPacket *packet = av_packet_alloc();
     packet->data = const_cast<uint8_t *>(data);
     packet->size = size;
 
@@ -65,7 +67,7 @@ bool AacDecoderState::send(const uint8_t *data, uint32_t size) {
     int len = codec->decode(context, frame, &got_frame, packet);
     assert(got_frame);
 
-    av_packet_free(&packet);
+    av_packet_unref(packet);
     if (len < 0) {
         LOG_WARN("Error sending Aac packet: {}.", codec_error_name(len));
         return false;
@@ -80,11 +82,19 @@ bool AacDecoderState::receive(uint8_t *data, DecoderSize *size) {
     assert(frame->format == AV_SAMPLE_FMT_FLTP);
 
     if (data) {
-        convert_f32_to_s16(
+        const uint32_t channels = context->channels;
+        const uint32_t sample_rate = context->sample_rate;
+        if (!swr || (swr_channels != channels) || (swr_sample_rate != sample_rate)) {
+            swr_free(&swr);
+            swr = create_f32_to_s16(channels, sample_rate);
+            swr_channels = channels;
+            swr_sample_rate = sample_rate;
+        }
+
+        convert_f32_to_s16(swr,
             reinterpret_cast<float *>(frame->extended_data),
             reinterpret_cast<int16_t *>(data),
-            context->channels, frame->nb_samples,
-            context->sample_rate);
+            frame->nb_samples);
     }
 
     if (size) {
@@ -102,24 +112,22 @@ void AacDecoderState::clear_context() {
     codec->flush(context);
 }
 
-AacDecoderState::AacDecoderState(uint32_t sample_rate, uint32_t channels) {
+AacDecoderState::AacDecoderState(uint32_t sample_rate, uint32_t channels)
+    : context_key{ AV_CODEC_ID_AAC, channels, sample_rate } {
     codec = avcodec_find_decoder(AV_CODEC_ID_AAC);
     assert(codec);
 
-    context = avcodec_alloc_context3(codec);
+    context = open_audio_decoder_context(context_key);
     assert(context);
 
     frame = av_frame_alloc();
-
-    context->codec_type = AVMEDIA_TYPE_AUDIO;
-    context->channels = channels;
-    context->sample_rate = sample_rate;
-    context->channel_layout = channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
-
-    int err = avcodec_open2(context, codec, nullptr);
-    assert(err == 0);
+    packet = av_packet_alloc();
 }
 
 AacDecoderState::~AacDecoderState() {
+    swr_free(&swr);
+    av_packet_free(&packet);
     av_frame_free(&frame);
+
+    close_audio_decoder_context(context, context_key);
 }
@@ -19,11 +19,18 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
 }
 
+#include <util/host_cpu.h>
 #include <util/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
 
 uint32_t DecoderState::get(DecoderQuery query) {
     return 0;
@@ -39,11 +46,100 @@ void DecoderState::flush() {
     avcodec_flush_buffers(context);
 }
 
+uint64_t DecoderStats::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void DecoderStats::add(uint64_t frame_us) {
+    frames++;
+    total_us += frame_us;
+    max_us = std::max(max_us, frame_us);
+}
+
+void DecoderStats::log(const char *stream) const {
+    if (!frames)
+        return;
+    LOG_INFO("{} stream: {} frames decoded, {:.2f} ms average, {:.2f} ms max.", stream, frames,
+        static_cast<double>(total_us) / frames / 1000.0, static_cast<double>(max_us) / 1000.0);
+}
+
 DecoderState::~DecoderState() {
+    if (context && context->codec)
+        stats.log(context->codec->name);
     avcodec_close(context);
     avcodec_free_context(&context);
 }
 
+// contexts kept opened once their decoder is destroyed, the oldest first
+static constexpr size_t AUDIO_CONTEXT_POOL_SIZE = 16;
+
+struct AudioContextPool {
+    std::mutex mutex;
+    std::vector<std::pair<AudioContextKey, AVCodecContext *>> contexts;
+
+    ~AudioContextPool() {
+        for (auto &[key, context] : contexts)
+            avcodec_free_context(&context);
+    }
+};
+
+static AudioContextPool audio_context_pool;
+
+AVCodecContext *open_audio_decoder_context(const AudioContextKey &key) {
+    {
+        const std::lock_guard<std::mutex> guard(audio_context_pool.mutex);
+        auto &contexts = audio_context_pool.contexts;
+        // the most recent one is the most likely to still be in the cache
+        const auto it = std::find_if(contexts.rbegin(), contexts.rend(), [&](const auto &pooled) { return pooled.first == key; });
+        if (it != contexts.rend()) {
+            AVCodecContext *context = it->second;
+            contexts.erase(std::next(it).base());
+            avcodec_flush_buffers(context);
+            return context;
+        }
+    }
+
+    const AVCodec *codec = avcodec_find_decoder(static_cast<AVCodecID>(key.codec_id));
+    assert(codec);
+
+    AVCodecContext *context = avcodec_alloc_context3(codec);
+    assert(context);
+
+    context->codec_type = AVMEDIA_TYPE_AUDIO;
+    context->channels = key.channels;
+    if (key.sample_rate) {
+        context->sample_rate = key.sample_rate;
+        context->channel_layout = key.channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+    }
+
+    const int err = avcodec_open2(context, codec, nullptr);
+    if (err < 0) {
+        LOG_ERROR("Failed to open the {} decoder: {}.", codec->name, codec_error_name(err));
+        avcodec_free_context(&context);
+    }
+
+    return context;
+}
+
+void close_audio_decoder_context(AVCodecContext *&context, const AudioContextKey &key) {
+    if (!context)
+        return;
+
+    AVCodecContext *oldest = nullptr;
+    {
+        const std::lock_guard<std::mutex> guard(audio_context_pool.mutex);
+        auto &contexts = audio_context_pool.contexts;
+        if (contexts.size() >= AUDIO_CONTEXT_POOL_SIZE) {
+            oldest = contexts.front().second;
+            contexts.erase(contexts.begin());
+        }
+        contexts.emplace_back(key, context);
+    }
+
+    avcodec_free_context(&oldest);
+    context = nullptr;
+}
+
 // Handy to have this in logs, some debuggers dont seem to be able to evaluate there error macros properly.
 std::string codec_error_name(int error) {
     switch (error) {
@@ -61,3 +157,74 @@ std::string codec_error_name(int error) {
         return log_hex(static_cast<uint32_t>(error));
     }
 }
+
+static bool hardware_video_decode = false;
+
+void set_hardware_video_decode(bool enable) {
+    hardware_video_decode = enable;
+}
+
+static AVPixelFormat get_hardware_format(AVCodecContext *context, const AVPixelFormat *formats) {
+    const auto hardware_format = static_cast<AVPixelFormat>(reinterpret_cast<intptr_t>(context->opaque));
+    for (const AVPixelFormat *format = formats; *format != AV_PIX_FMT_NONE; format++) {
+        if (*format == hardware_format)
+            return *format;
+    }
+
+    // the hardware can't decode this stream (profile not supported...), let FFmpeg pick a software format
+    LOG_WARN("The hardware video decoder doesn't support this stream, using software decode.");
+    return avcodec_default_get_format(context, formats);
+}
+
+void init_hardware_video_decode(AVCodecContext *context, const AVCodec *codec) {
+    if (!hardware_video_decode)
+        return;
+
+    // use the first device type of the decoder that exists on this host (VAAPI, D3D11VA, VideoToolbox, Vulkan...)
+    for (int i = 0;; i++) {
+        const AVCodecHWConfig *config = avcodec_get_hw_config(codec, i);
+        if (!config)
+            break;
+
+        if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX))
+            continue;
+
+        AVBufferRef *device = nullptr;
+        if (av_hwdevice_ctx_create(&device, config->device_type, nullptr, nullptr, 0) < 0)
+            continue;
+
+        context->hw_device_ctx = device;
+        context->opaque = reinterpret_cast<void *>(static_cast<intptr_t>(config->pix_fmt));
+        context->get_format = get_hardware_format;
+        LOG_INFO("Decoding {} videos with {}.", codec->name, av_hwdevice_get_type_name(config->device_type));
+        return;
+    }
+
+    LOG_INFO("No hardware device can decode {} videos, using software decode.", codec->name);
+}
+
+static int video_decode_threads = 0;
+static bool video_frame_threading = true;
+
+void set_video_decode_threading(int threads, bool frame_threading) {
+    video_decode_threads = threads;
+    video_frame_threading = frame_threading;
+}
+
+void init_video_decode_threading(AVCodecContext *context, const AVCodec *codec, bool allow_frame_threading) {
+    // the frames of the audio codecs are too small for the threads to help, and a GPU decoder doesn't need them
+    if (codec->type != AVMEDIA_TYPE_VIDEO || context->hw_device_ctx) {
+        context->thread_count = 1;
+        return;
+    }
+
+    int threads = video_decode_threads;
+    if (threads <= 0) {
+        const int host_threads = static_cast<int>(std::thread::hardware_concurrency());
+        threads = std::clamp(host_threads - static_cast<int>(util::GUEST_CORE_COUNT) - 2, 1, 4);
+    }
+    context->thread_count = threads;
+    context->thread_type = FF_THREAD_SLICE;
+    if (allow_frame_threading && video_frame_threading && (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+        context->thread_type |= FF_THREAD_FRAME;
+}
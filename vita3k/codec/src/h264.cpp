@@ -21,23 +21,62 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
 }
 
 #include <cassert>
 
-void copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest) {
-    for (int32_t a = 0; a < frame->height; a++) {
-        memcpy(dest, &frame->data[0][frame->linesize[0] * a], frame->width);
-        dest += frame->width;
+bool copy_yuv_data_from_frame(AVFrame *frame, uint8_t *dest) {
+    AVFrame *source = frame;
+    AVFrame *downloaded = nullptr;
+    if (frame->hw_frames_ctx) {
+        // the frame is in GPU memory, download it (usually as nv12)
+        downloaded = av_frame_alloc();
+        if (av_hwframe_transfer_data(downloaded, frame, 0) < 0) {
+            LOG_WARN("Could not download the frame from the hardware video decoder.");
+            av_frame_free(&downloaded);
+            return false;
+        }
+        downloaded->width = frame->width;
+        downloaded->height = frame->height;
+        source = downloaded;
     }
-    for (int32_t a = 0; a < frame->height / 2; a++) {
-        memcpy(dest, &frame->data[1][frame->linesize[1] * a], frame->width / 2);
-        dest += frame->width / 2;
+
+    if (source->format != AV_PIX_FMT_YUV420P && source->format != AV_PIX_FMT_YUVJ420P && source->format != AV_PIX_FMT_NV12) {
+        LOG_WARN("Unsupported video frame format {}.", source->format);
+        av_frame_free(&downloaded);
+        return false;
     }
-    for (int32_t a = 0; a < frame->height / 2; a++) {
-        memcpy(dest, &frame->data[2][frame->linesize[2] * a], frame->width / 2);
-        dest += frame->width / 2;
+
+    for (int32_t a = 0; a < source->height; a++) {
+        memcpy(dest, &source->data[0][source->linesize[0] * a], source->width);
+        dest += source->width;
+    }
+
+    if (source->format == AV_PIX_FMT_NV12) {
+        // split the interleaved chroma plane straight into the u and v planes of the output
+        uint8_t *dest_u = dest;
+        uint8_t *dest_v = dest + (source->width / 2) * (source->height / 2);
+        for (int32_t a = 0; a < source->height / 2; a++) {
+            const uint8_t *uv = &source->data[1][source->linesize[1] * a];
+            for (int32_t b = 0; b < source->width / 2; b++) {
+                *dest_u++ = uv[b * 2];
+                *dest_v++ = uv[b * 2 + 1];
+            }
+        }
+    } else {
+        for (int32_t a = 0; a < source->height / 2; a++) {
+            memcpy(dest, &source->data[1][source->linesize[1] * a], source->width / 2);
+            dest += source->width / 2;
+        }
+        for (int32_t a = 0; a < source->height / 2; a++) {
+            memcpy(dest, &source->data[2][source->linesize[2] * a], source->width / 2);
+            dest += source->width / 2;
+        }
     }
+
+    av_frame_free(&downloaded);
+    return true;
 }
 
 uint32_t H264DecoderState::buffer_size(DecoderSize size) {
@@ -53,6 +92,7 @@ uint32_t H264DecoderState::get(DecoderQuery query) {
 }
 
 bool H264DecoderState::send(const uint8_t *data, uint32_t size) {
+    const uint64_t start = DecoderStats::now_us();
     int error = 0;
 
     std::vector<uint8_t> au_frame(size + AV_INPUT_BUFFER_PADDING_SIZE);
@@ -81,6 +121,7 @@ bool H264DecoderState::send(const uint8_t *data, uint32_t size) {
 
     error = avcodec_send_packet(context, packet);
     av_packet_free(&packet);
+    pending_decode_us += DecoderStats::now_us() - start;
     if (error < 0) {
         LOG_WARN("Error sending H264 packet: {}.", codec_error_name(error));
         return false;
@@ -90,6 +131,7 @@ bool H264DecoderState::send(const uint8_t *data, uint32_t size) {
 }
 
 bool H264DecoderState::receive(uint8_t *data, DecoderSize *size) {
+    const uint64_t start = DecoderStats::now_us();
     AVFrame *frame = av_frame_alloc();
 
     int error = avcodec_receive_frame(context, frame);
@@ -99,8 +141,9 @@ bool H264DecoderState::receive(uint8_t *data, DecoderSize *size) {
         return false;
     }
 
-    if (data) {
-        copy_yuv_data_from_frame(frame, data);
+    if (data && !copy_yuv_data_from_frame(frame, data)) {
+        av_frame_free(&frame);
+        return false;
     }
 
     if (size) {
@@ -113,6 +156,8 @@ bool H264DecoderState::receive(uint8_t *data, DecoderSize *size) {
     pts_out = frame->pts;
 
     av_frame_free(&frame);
+    stats.add(pending_decode_us + DecoderStats::now_us() - start);
+    pending_decode_us = 0;
     return true;
 }
 
@@ -145,6 +190,9 @@ H264DecoderState::H264DecoderState(uint32_t width, uint32_t height) {
     assert(context);
     context->width = width;
     context->height = height;
+    init_hardware_video_decode(context, codec);
+    // the guest expects a picture for each au, frame threading would return them late
+    init_video_decode_threading(context, codec, false);
 
     int result = avcodec_open2(context, codec, nullptr);
     assert(result == 0);
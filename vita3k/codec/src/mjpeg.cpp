@@ -16,55 +16,92 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <codec/state.h>
+#include <codec/ycbcr.h>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
-#include <libswscale/swscale.h>
+#include <libavutil/cpu.h>
+#include <libavutil/pixdesc.h>
 }
 
 #include <util/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
-void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height) {
-    SwsContext *context = sws_getContext(width, height, AV_PIX_FMT_YUV444P, width, height, AV_PIX_FMT_RGBA,
-        0, nullptr, nullptr, nullptr);
-    assert(context);
+void convert_yuv_to_rgb(const uint8_t *yuv, uint8_t *rgba, uint32_t width, uint32_t height, uint32_t rgba_pitch) {
+    convert_ycbcr_to_rgba(yuv, rgba, width, height, rgba_pitch);
+}
 
-    const uint8_t *slices[] = {
-        &yuv[0], // Y Slice
-        &yuv[width * height], // U Slice
-        &yuv[width * height * 2], // V Slice
-    };
-
-    int strides[] = {
-        static_cast<int>(width),
-        static_cast<int>(width),
-        static_cast<int>(width),
-    };
-
-    uint8_t *dst_slices[] = {
-        rgba,
-    };
-
-    const int dst_strides[] = {
-        static_cast<int>(width * 4),
-    };
-
-    int error = sws_scale(context, slices, strides, 0, height, dst_slices, dst_strides);
-    assert(error == height);
-    sws_freeContext(context);
+static void free_output_buffer(void *opaque, uint8_t *data) {
+    // the guest owns the output
+}
+
+// the 4:4:4 frames whose planes fit the output without padding are decoded directly in it
+static int get_output_buffer(AVCodecContext *context, AVFrame *frame, int flags) {
+    auto *state = static_cast<MjpegDecoderState *>(context->opaque);
+    const int format = frame->format;
+    if (!state->output || ((format != AV_PIX_FMT_YUVJ444P) && (format != AV_PIX_FMT_YUV444P)))
+        return avcodec_default_get_buffer2(context, frame, flags);
+
+    int aligned_width = frame->width;
+    int aligned_height = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS] = {};
+    avcodec_align_dimensions2(context, &aligned_width, &aligned_height, linesize_align);
+    const size_t plane_size = static_cast<size_t>(frame->width) * frame->height;
+    const size_t max_align = av_cpu_max_align();
+    const bool fits = (aligned_width == frame->width) && (aligned_height == frame->height)
+        && (frame->width % std::max<int>(linesize_align[0], max_align) == 0)
+        && (reinterpret_cast<uintptr_t>(state->output) % max_align == 0)
+        && (plane_size * 3 <= state->output_size);
+    if (!fits)
+        return avcodec_default_get_buffer2(context, frame, flags);
+
+    frame->buf[0] = av_buffer_create(state->output, static_cast<int>(plane_size * 3), free_output_buffer, nullptr, 0);
+    if (!frame->buf[0])
+        return AVERROR(ENOMEM);
+    for (int plane = 0; plane < 3; plane++) {
+        frame->data[plane] = &state->output[plane_size * plane];
+        frame->linesize[plane] = frame->width;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+// copy the frame as yuv444p, the subsampled chroma planes are scaled up
+static void copy_yuv444_data_from_frame(const AVFrame *frame, uint8_t *data) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    assert(desc && (desc->nb_components == 3) && (desc->flags & AV_PIX_FMT_FLAG_PLANAR));
+    const size_t plane_size = static_cast<size_t>(frame->width) * frame->height;
+
+    for (int plane = 0; plane < 3; plane++) {
+        const int shift_w = (plane == 0) ? 0 : desc->log2_chroma_w;
+        const int shift_h = (plane == 0) ? 0 : desc->log2_chroma_h;
+        for (int row = 0; row < frame->height; row++) {
+            const uint8_t *src = &frame->data[plane][(row >> shift_h) * frame->linesize[plane]];
+            uint8_t *dst = &data[plane_size * plane + static_cast<size_t>(row) * frame->width];
+            if (shift_w == 0) {
+                std::memcpy(dst, src, frame->width);
+                continue;
+            }
+            for (int x = 0; x < frame->width; x++)
+                dst[x] = src[x >> shift_w];
+        }
+    }
 }
 
 bool MjpegDecoderState::send(const uint8_t *data, uint32_t size) {
     std::vector<uint8_t> jpeg_buffer(size + AV_INPUT_BUFFER_PADDING_SIZE);
     std::memcpy(jpeg_buffer.data(), data, size);
 
+    const uint64_t start = DecoderStats::now_us();
     AVPacket *packet = av_packet_alloc();
     packet->data = jpeg_buffer.data();
     packet->size = size;
     int error = avcodec_send_packet(context, packet);
     av_packet_free(&packet);
+    pending_decode_us += DecoderStats::now_us() - start;
 
     if (error < 0) {
         LOG_WARN("Error sending Mjpeg packet: {}.", codec_error_name(error));
@@ -74,6 +111,7 @@ bool MjpegDecoderState::send(const uint8_t *data, uint32_t size) {
 }
 
 bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
+    const uint64_t start = DecoderStats::now_us();
     AVFrame *frame = av_frame_alloc();
     int error = avcodec_receive_frame(context, frame);
     if (error < 0) {
@@ -82,22 +120,9 @@ bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
         return false;
     }
 
-    if (data) {
-        uint8_t *channels[] = {
-            &data[0], // y
-            &data[frame->width * frame->height], // u
-            &data[frame->width * frame->height * 2], // v
-        };
-
-        assert(frame->format == AV_PIX_FMT_YUVJ444P);
-
-        // Copy YUV444 data.
-        for (uint32_t a = 0; a < 3; a++) {
-            for (int b = 0; b < frame->height; b++) {
-                std::memcpy(&channels[a][b * frame->width], &frame->data[a][b * frame->linesize[a]], frame->width);
-            }
-        }
-    }
+    // nothing to copy if the frame was decoded in the output
+    if (data && (frame->data[0] != data))
+        copy_yuv444_data_from_frame(frame, data);
 
     if (size) {
         size->width = frame->width;
@@ -105,16 +130,32 @@ bool MjpegDecoderState::receive(uint8_t *data, DecoderSize *size) {
     }
 
     av_frame_free(&frame);
+    stats.add(pending_decode_us + DecoderStats::now_us() - start);
+    pending_decode_us = 0;
 
     return true;
 }
 
+bool MjpegDecoderState::decode(const uint8_t *jpeg, uint32_t jpeg_size, uint8_t *data, uint32_t data_size, DecoderSize *size) {
+    output = data;
+    output_size = data_size;
+    const bool success = send(jpeg, jpeg_size) && receive(data, size);
+    output = nullptr;
+    output_size = 0;
+
+    return success;
+}
+
 MjpegDecoderState::MjpegDecoderState() {
     AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
     assert(codec);
 
     context = avcodec_alloc_context3(codec);
     assert(context);
+    context->opaque = this;
+    context->get_buffer2 = get_output_buffer;
+    // each jpeg is decoded synchronously
+    init_video_decode_threading(context, codec, false);
     int error = avcodec_open2(context, codec, nullptr);
     assert(error == 0);
 }
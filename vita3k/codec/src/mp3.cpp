@@ -135,22 +135,21 @@ uint32_t Mp3DecoderState::get(DecoderQuery query) {
 }
 
 bool Mp3DecoderState::send(const uint8_t *data, uint32_t size) {
-    AVPacket *packet = av_packet_alloc();
-
     es_size_used = get_mp3_data_size(data);
     if (es_size_used != 0)
         size = std::min(size, es_size_used);
     else
         es_size_used = size;
 
-    std::vector<uint8_t> temporary(size + AV_INPUT_BUFFER_PADDING_SIZE);
-    memcpy(temporary.data(), data, size);
+    packet_data.resize(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    memcpy(packet_data.data(), data, size);
+    memset(packet_data.data() + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
     packet->size = size;
-    packet->data = temporary.data();
+    packet->data = packet_data.data();
 
     int err = avcodec_send_packet(context, packet);
-    av_packet_free(&packet);
+    av_packet_unref(packet);
     if (err < 0) {
         LOG_WARN("Error sending Mp3 packet: {}.", log_hex(static_cast<uint32_t>(err)));
         return false;
@@ -160,12 +159,9 @@ bool Mp3DecoderState::send(const uint8_t *data, uint32_t size) {
 }
 
 bool Mp3DecoderState::receive(uint8_t *data, DecoderSize *size) {
-    AVFrame *frame = av_frame_alloc();
-
     int err = avcodec_receive_frame(context, frame);
     if (err < 0) {
         LOG_WARN("Error receiving Mp3 frame: {}.", log_hex(static_cast<uint32_t>(err)));
-        av_frame_free(&frame);
         return false;
     }
 
@@ -185,26 +181,25 @@ bool Mp3DecoderState::receive(uint8_t *data, DecoderSize *size) {
         size->samples = frame->nb_samples;
     }
 
-    av_frame_free(&frame);
+    av_frame_unref(frame);
     return true;
 }
 
-Mp3DecoderState::Mp3DecoderState(uint32_t channels) {
+Mp3DecoderState::Mp3DecoderState(uint32_t channels)
+    : context_key{ AV_CODEC_ID_MP3, channels, 0 } {
     codec = avcodec_find_decoder(AV_CODEC_ID_MP3);
     assert(codec);
 
-    context = avcodec_alloc_context3(codec);
+    context = open_audio_decoder_context(context_key);
     assert(context);
 
-    context->channels = channels;
-
-    int err = avcodec_open2(context, codec, nullptr);
-    assert(err == 0);
+    packet = av_packet_alloc();
+    frame = av_frame_alloc();
 }
 
 Mp3DecoderState::~Mp3DecoderState() {
-    avcodec_close(context);
-    av_free(context);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
 
-    context = nullptr;
+    close_audio_decoder_context(context, context_key);
 }
@@ -27,25 +27,61 @@ extern "C" {
 
 #include <cassert>
 #include <chrono>
+#include <utility>
 
 uint64_t PlayerState::get_framerate_microseconds() {
-    AVRational rational = format->streams[video_stream_id]->avg_frame_rate;
-    return static_cast<float>(rational.den) / static_cast<float>(rational.num) * 1000000;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!video_frames.empty())
+        return video_frames.front().duration_microseconds;
+
+    return framerate_microseconds;
 }
 
 DecoderSize PlayerState::get_size() {
-    if (video_context)
-        return { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) };
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!video_frames.empty())
+        return video_frames.front().size;
+
+    return video_size;
+}
 
-    return {};
+bool PlayerState::is_playing() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !video_playing.empty();
 }
 
 void PlayerState::pop_video() {
-    switch_video(videos_queue.front());
-    videos_queue.pop();
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (videos_queue.empty())
+            return;
+        path = videos_queue.front();
+        videos_queue.pop();
+    }
+    switch_video(path);
 }
 
-void PlayerState::free_video() {
+void PlayerState::stop_decode_thread() {
+    if (!decode_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop_decode = true;
+    }
+    decode_wake.notify_all();
+    decode_thread.join();
+    stop_decode = false;
+}
+
+void PlayerState::close_video() {
+    video_stats.log("Player video");
+    audio_stats.log("Player audio");
+    video_stats = {};
+    audio_stats = {};
+    video_drained = false;
+
     if (video_context) {
         avcodec_close(video_context);
         avcodec_free_context(&video_context);
@@ -71,14 +107,20 @@ void PlayerState::free_video() {
         av_packet_free(&packet);
         audio_packets.pop();
     }
+}
 
+void PlayerState::free_video() {
+    stop_decode_thread();
+    close_video();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    video_frames.clear();
+    audio_frames.clear();
+    decode_finished = false;
     video_playing = "";
 }
 
-void PlayerState::switch_video(const std::string &path) {
-    free_video();
-    video_playing = path;
-
+void PlayerState::open_video(const std::string &path) {
     int error;
 
     error = avformat_open_input(&format, path.c_str(), nullptr, nullptr);
@@ -91,12 +133,22 @@ void PlayerState::switch_video(const std::string &path) {
     video_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
     audio_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
 
+    DecoderSize size;
+    uint64_t framerate = 0;
     if (video_stream_id >= 0) {
         AVStream *video_stream = format->streams[video_stream_id];
         AVCodec *video_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
         video_context = avcodec_alloc_context3(video_codec);
         avcodec_parameters_to_context(video_context, video_stream->codecpar);
+        init_hardware_video_decode(video_context, video_codec);
+        // the frames are pulled until one comes out, so they can be decoded ahead on several threads
+        init_video_decode_threading(video_context, video_codec, true);
         avcodec_open2(video_context, video_codec, nullptr);
+
+        size = { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) };
+        const AVRational rational = video_stream->avg_frame_rate;
+        if (rational.num > 0)
+            framerate = static_cast<float>(rational.den) / static_cast<float>(rational.num) * 1000000;
     }
 
     if (audio_stream_id >= 0) {
@@ -106,6 +158,21 @@ void PlayerState::switch_video(const std::string &path) {
         avcodec_parameters_to_context(audio_context, audio_stream->codecpar);
         avcodec_open2(audio_context, audio_codec, nullptr);
     }
+
+    video_ended = video_stream_id < 0;
+    audio_ended = audio_stream_id < 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    video_playing = path;
+    video_size = size;
+    framerate_microseconds = framerate;
+    has_audio = audio_stream_id >= 0;
+}
+
+void PlayerState::switch_video(const std::string &path) {
+    free_video();
+    open_video(path);
+    decode_thread = std::thread(&PlayerState::decode_loop, this);
 }
 
 bool PlayerState::next_packet(int32_t stream_id) {
@@ -132,8 +199,16 @@ bool PlayerState::next_packet(int32_t stream_id) {
         }
 
         AVPacket *packet = av_packet_alloc();
-        if (av_read_frame(format, packet) != 0)
+        if (av_read_frame(format, packet) != 0) {
+            av_packet_free(&packet);
+            // the video decoder still holds the frames decoded ahead or reordered, get them before the end of the stream
+            if (stream_id == video_stream_id && !video_drained) {
+                video_drained = true;
+                avcodec_send_packet(video_context, nullptr);
+                return true;
+            }
             return false;
+        }
 
         if (packet->stream_index == stream_id) {
             this_queue.push(packet);
@@ -143,109 +218,201 @@ bool PlayerState::next_packet(int32_t stream_id) {
     }
 }
 
-std::vector<int16_t> PlayerState::receive_audio() {
-    if (audio_stream_id < 0)
-        return {};
-
-    if (video_playing.empty())
-        return {};
-
-    int error;
+void PlayerState::decode_audio_frame() {
+    const uint64_t start = DecoderStats::now_us();
     AVFrame *frame = av_frame_alloc();
-    std::vector<int16_t> data;
+    int error;
     while (true) {
         error = avcodec_receive_frame(audio_context, frame);
 
         if (error == AVERROR(EAGAIN) && next_packet(audio_stream_id))
             continue;
 
-        if (error != 0) {
-            if (videos_queue.empty()) {
-                // Stop playing videos or
-                video_playing = "";
-                break;
-            } else {
-                // Play the next video (if there is any).
-                switch_video(videos_queue.front());
-                videos_queue.pop();
-                continue;
-            }
-        }
+        break;
+    }
 
-        LOG_WARN_IF(frame->format != AV_SAMPLE_FMT_FLTP, "Unknown audio format {}.", frame->format);
+    if (error != 0) {
+        av_frame_free(&frame);
+        audio_ended = true;
+        return;
+    }
 
-        last_channels = frame->channels;
-        last_sample_count = frame->nb_samples;
-        last_sample_rate = frame->sample_rate;
+    audio_stats.add(DecoderStats::now_us() - start);
+    LOG_WARN_IF(frame->format != AV_SAMPLE_FMT_FLTP, "Unknown audio format {}.", frame->format);
 
-        data.resize(frame->nb_samples * frame->channels);
+    PlayerAudioFrame audio;
+    audio.channels = frame->channels;
+    audio.sample_count = frame->nb_samples;
+    audio.sample_rate = frame->sample_rate;
+    audio.data.resize(frame->nb_samples * frame->channels);
 
-        for (int a = 0; a < frame->nb_samples; a++) {
-            for (int b = 0; b < frame->channels; b++) {
-                auto *frame_data = reinterpret_cast<float *>(frame->data[b]);
-                float current_sample = frame_data[a];
-                int16_t pcm_sample = current_sample * INT16_MAX;
+    for (int a = 0; a < frame->nb_samples; a++) {
+        for (int b = 0; b < frame->channels; b++) {
+            auto *frame_data = reinterpret_cast<float *>(frame->data[b]);
+            float current_sample = frame_data[a];
+            int16_t pcm_sample = current_sample * INT16_MAX;
 
-                data[a * frame->channels + b] = pcm_sample;
-            }
+            audio.data[a * frame->channels + b] = pcm_sample;
         }
-
-        break;
     }
-
     av_frame_free(&frame);
-    return data;
-}
-
-std::vector<uint8_t> PlayerState::receive_video() {
-    if (video_stream_id < 0)
-        return {};
 
-    if (video_playing.empty())
-        return {};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        audio_frames.push_back(std::move(audio));
+    }
+    frame_ready.notify_all();
+}
 
-    int error;
+void PlayerState::decode_video_frame() {
+    const uint64_t start = DecoderStats::now_us();
     AVFrame *frame = av_frame_alloc();
-    std::vector<uint8_t> data;
+    int error;
     while (true) {
         error = avcodec_receive_frame(video_context, frame);
 
         if (error == AVERROR(EAGAIN) && next_packet(video_stream_id))
             continue;
 
-        if (error != 0) {
+        break;
+    }
+
+    if (error != 0) {
+        av_frame_free(&frame);
+        video_ended = true;
+        return;
+    }
+
+    PlayerVideoFrame video;
+    video.size = { static_cast<uint32_t>(frame->width), static_cast<uint32_t>(frame->height) };
+    video.timestamp = frame->best_effort_timestamp;
+    // the pts give the frame duration of the videos without a constant frame rate
+    const AVRational time_base = format->streams[video_stream_id]->time_base;
+    video.duration_microseconds = frame->pkt_duration > 0
+        ? av_rescale_q(frame->pkt_duration, time_base, AVRational{ 1, 1000000 })
+        : 0;
+    video.data.resize(H264DecoderState::buffer_size(video.size));
+    if (!copy_yuv_data_from_frame(frame, video.data.data()))
+        video.data.clear();
+    av_frame_free(&frame);
+    video_stats.add(DecoderStats::now_us() - start);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (video.duration_microseconds == 0)
+            video.duration_microseconds = framerate_microseconds;
+        video_frames.push_back(std::move(video));
+    }
+    frame_ready.notify_all();
+}
+
+void PlayerState::decode_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stop_decode) {
+        if (video_ended && audio_ended) {
             if (videos_queue.empty()) {
-                // Stop playing videos or
-                video_playing = "";
-                break;
-            } else {
-                // Play the next video (if there is any).
-                switch_video(videos_queue.front());
-                videos_queue.pop();
+                decode_finished = true;
+                frame_ready.notify_all();
+                decode_wake.wait(lock, [&] { return stop_decode || !videos_queue.empty(); });
                 continue;
             }
+
+            // Play the next video (if there is any), the frames of the previous one stay queued.
+            const std::string path = videos_queue.front();
+            videos_queue.pop();
+            decode_finished = false;
+            lock.unlock();
+            close_video();
+            open_video(path);
+            lock.lock();
+            continue;
+        }
+
+        // the audio is cheap to keep, it is decoded up to the end once the video is done so the next video can be opened
+        // even when the guest doesn't take the audio frames
+        const bool needs_video = !video_ended && video_frames.size() < MAX_VIDEO_FRAMES;
+        const bool needs_audio = !audio_ended && (audio_frames.size() < MAX_AUDIO_FRAMES || video_ended);
+        if (!needs_video && !needs_audio) {
+            decode_wake.wait(lock);
+            continue;
         }
 
-        last_timestamp = frame->best_effort_timestamp;
+        lock.unlock();
+        if (needs_video)
+            decode_video_frame();
+        if (needs_audio)
+            decode_audio_frame();
+        lock.lock();
+    }
+}
 
-        data.resize(H264DecoderState::buffer_size(
-            { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) }));
-        copy_yuv_data_from_frame(frame, data.data());
+bool PlayerState::get_audio_info() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frame_ready.wait(lock, [&] { return !audio_frames.empty() || !has_audio || decode_finished || video_playing.empty(); });
+    if (audio_frames.empty())
+        return false;
+
+    const PlayerAudioFrame &audio = audio_frames.front();
+    last_channels = audio.channels;
+    last_sample_count = audio.sample_count;
+    last_sample_rate = audio.sample_rate;
+    return true;
+}
 
-        break;
+std::vector<int16_t> PlayerState::receive_audio() {
+    std::vector<int16_t> data;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (audio_frames.empty()) {
+            // Stop playing videos once the last one is over.
+            if (decode_finished)
+                video_playing = "";
+            return {};
+        }
+
+        PlayerAudioFrame &audio = audio_frames.front();
+        last_channels = audio.channels;
+        last_sample_count = audio.sample_count;
+        last_sample_rate = audio.sample_rate;
+        data = std::move(audio.data);
+        audio_frames.pop_front();
     }
+    decode_wake.notify_one();
+    return data;
+}
 
-    av_frame_free(&frame);
+std::vector<uint8_t> PlayerState::receive_video() {
+    std::vector<uint8_t> data;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (video_frames.empty()) {
+            // Stop playing videos once the last one is over.
+            if (decode_finished)
+                video_playing = "";
+            return {};
+        }
+
+        PlayerVideoFrame &video = video_frames.front();
+        last_timestamp = video.timestamp;
+        data = std::move(video.data);
+        video_frames.pop_front();
+    }
+    decode_wake.notify_one();
     return data;
 }
 
 void PlayerState::queue(const std::string &path) {
     if (fs::exists(path)) {
         LOG_INFO("Queued video: '{}'.", path);
-        if (video_playing.empty())
+        if (!is_playing()) {
             switch_video(path);
-        else
-            videos_queue.push(path);
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                videos_queue.push(path);
+            }
+            decode_wake.notify_one();
+        }
     } else {
         LOG_INFO("Cannot find video: {}", path);
     }
@@ -254,6 +421,5 @@ void PlayerState::queue(const std::string &path) {
 PlayerState::~PlayerState() {
     free_video();
 
-    video_playing = "";
     videos_queue = {};
 }
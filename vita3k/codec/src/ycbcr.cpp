@@ -0,0 +1,175 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <codec/ycbcr.h>
+
+#include <threads/job_pool.h>
+#include <util/host_cpu.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(YCBCR_CONVERT_X86)
+#include <emmintrin.h>
+#elif defined(YCBCR_CONVERT_NEON)
+#include <arm_neon.h>
+#endif
+
+// BT.601 full range coefficients in 2.14 fixed point, the SIMD kernels round the same way to give the same result
+static constexpr int32_t CR_TO_R = 22971; // 1.402
+static constexpr int32_t CB_TO_G = -5638; // -0.344136
+static constexpr int32_t CR_TO_G = -11700; // -0.714136
+static constexpr int32_t CB_TO_B = 29032; // 1.772
+static constexpr int32_t FIXED_SHIFT = 14;
+static constexpr int32_t FIXED_ROUND = 1 << (FIXED_SHIFT - 1);
+
+// below this amount of pixels, waking up the threads costs more than it saves
+static constexpr uint32_t PARALLEL_MIN_PIXELS = 640 * 480;
+
+void convert_ycbcr_row_to_rgba_basic(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const int32_t luma = y[i];
+        const int32_t blue_diff = cb[i] - 128;
+        const int32_t red_diff = cr[i] - 128;
+        rgba[i * 4 + 0] = static_cast<uint8_t>(std::clamp(luma + ((red_diff * CR_TO_R + FIXED_ROUND) >> FIXED_SHIFT), 0, 255));
+        rgba[i * 4 + 1] = static_cast<uint8_t>(std::clamp(luma + ((blue_diff * CB_TO_G + red_diff * CR_TO_G + FIXED_ROUND) >> FIXED_SHIFT), 0, 255));
+        rgba[i * 4 + 2] = static_cast<uint8_t>(std::clamp(luma + ((blue_diff * CB_TO_B + FIXED_ROUND) >> FIXED_SHIFT), 0, 255));
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+#if defined(YCBCR_CONVERT_X86)
+// SSE2 is always there on x86-64
+static void convert_ycbcr_row_to_rgba_sse2(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi32(FIXED_ROUND);
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+    // the chroma differences are interleaved (cb, cr) so that a madd gives both products of a channel
+    const __m128i red_coefs = _mm_set1_epi32(CR_TO_R << 16);
+    const __m128i green_coefs = _mm_set1_epi32((CR_TO_G << 16) | (CB_TO_G & 0xFFFF));
+    const __m128i blue_coefs = _mm_set1_epi32(CB_TO_B);
+
+    const auto channel = [&](__m128i luma, __m128i diffs_lo, __m128i diffs_hi, __m128i coefs) {
+        const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(diffs_lo, coefs), round), FIXED_SHIFT);
+        const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(diffs_hi, coefs), round), FIXED_SHIFT);
+        const __m128i value = _mm_add_epi16(luma, _mm_packs_epi32(lo, hi));
+        return _mm_packus_epi16(value, value);
+    };
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i luma = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + i)), zero);
+        const __m128i blue_diff = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cb + i)), zero), bias);
+        const __m128i red_diff = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cr + i)), zero), bias);
+        const __m128i diffs_lo = _mm_unpacklo_epi16(blue_diff, red_diff);
+        const __m128i diffs_hi = _mm_unpackhi_epi16(blue_diff, red_diff);
+
+        const __m128i red = channel(luma, diffs_lo, diffs_hi, red_coefs);
+        const __m128i green = channel(luma, diffs_lo, diffs_hi, green_coefs);
+        const __m128i blue = channel(luma, diffs_lo, diffs_hi, blue_coefs);
+
+        const __m128i red_green = _mm_unpacklo_epi8(red, green);
+        const __m128i blue_alpha = _mm_unpacklo_epi8(blue, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba + i * 4), _mm_unpacklo_epi16(red_green, blue_alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(rgba + i * 4 + 16), _mm_unpackhi_epi16(red_green, blue_alpha));
+    }
+
+    convert_ycbcr_row_to_rgba_basic(rgba + i * 4, y + i, cb + i, cr + i, count - i);
+}
+#elif defined(YCBCR_CONVERT_NEON)
+static void convert_ycbcr_row_to_rgba_neon(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count) {
+    const int16x8_t bias = vdupq_n_s16(128);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t luma = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + i)));
+        const int16x8_t blue_diff = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cb + i))), bias);
+        const int16x8_t red_diff = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(cr + i))), bias);
+
+        // the rounding narrowing shift adds the same half as the scalar reference
+        const int32x4_t red_lo = vmull_n_s16(vget_low_s16(red_diff), CR_TO_R);
+        const int32x4_t red_hi = vmull_n_s16(vget_high_s16(red_diff), CR_TO_R);
+        const int32x4_t green_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(blue_diff), CB_TO_G), vget_low_s16(red_diff), CR_TO_G);
+        const int32x4_t green_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(blue_diff), CB_TO_G), vget_high_s16(red_diff), CR_TO_G);
+        const int32x4_t blue_lo = vmull_n_s16(vget_low_s16(blue_diff), CB_TO_B);
+        const int32x4_t blue_hi = vmull_n_s16(vget_high_s16(blue_diff), CB_TO_B);
+
+        uint8x8x4_t pixels;
+        pixels.val[0] = vqmovun_s16(vaddq_s16(luma, vcombine_s16(vrshrn_n_s32(red_lo, FIXED_SHIFT), vrshrn_n_s32(red_hi, FIXED_SHIFT))));
+        pixels.val[1] = vqmovun_s16(vaddq_s16(luma, vcombine_s16(vrshrn_n_s32(green_lo, FIXED_SHIFT), vrshrn_n_s32(green_hi, FIXED_SHIFT))));
+        pixels.val[2] = vqmovun_s16(vaddq_s16(luma, vcombine_s16(vrshrn_n_s32(blue_lo, FIXED_SHIFT), vrshrn_n_s32(blue_hi, FIXED_SHIFT))));
+        pixels.val[3] = vdup_n_u8(255);
+        vst4_u8(rgba + i * 4, pixels);
+    }
+
+    convert_ycbcr_row_to_rgba_basic(rgba + i * 4, y + i, cb + i, cr + i, count - i);
+}
+#endif
+
+void convert_ycbcr_row_to_rgba(uint8_t *rgba, const uint8_t *y, const uint8_t *cb, const uint8_t *cr, size_t count) {
+#if defined(YCBCR_CONVERT_X86)
+    convert_ycbcr_row_to_rgba_sse2(rgba, y, cb, cr, count);
+#elif defined(YCBCR_CONVERT_NEON)
+    convert_ycbcr_row_to_rgba_neon(rgba, y, cb, cr, count);
+#else
+    convert_ycbcr_row_to_rgba_basic(rgba, y, cb, cr, count);
+#endif
+}
+
+const char *get_ycbcr_convert_isa() {
+#if defined(YCBCR_CONVERT_X86)
+    return "SSE2";
+#elif defined(YCBCR_CONVERT_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// the calling thread converts a band of rows too, the pool leaves the cores of the guest cpu and the renderer
+static uint32_t get_convert_thread_count() {
+    const int host_threads = static_cast<int>(std::thread::hardware_concurrency());
+    return static_cast<uint32_t>(std::clamp(host_threads - static_cast<int>(util::GUEST_CORE_COUNT) - 1, 1, 4));
+}
+
+void convert_ycbcr_to_rgba(const uint8_t *ycbcr, uint8_t *rgba, uint32_t width, uint32_t height, uint32_t rgba_pitch) {
+    const size_t plane_size = static_cast<size_t>(width) * height;
+    const auto convert_rows = [=](uint32_t first_row, uint32_t end_row) {
+        for (uint32_t row = first_row; row < end_row; row++) {
+            const size_t offset = static_cast<size_t>(row) * width;
+            convert_ycbcr_row_to_rgba(&rgba[static_cast<size_t>(row) * rgba_pitch * 4], &ycbcr[offset], &ycbcr[plane_size + offset], &ycbcr[plane_size * 2 + offset], width);
+        }
+    };
+
+    static const uint32_t thread_count = get_convert_thread_count();
+    if ((thread_count == 1) || (plane_size < PARALLEL_MIN_PIXELS)) {
+        convert_rows(0, height);
+        return;
+    }
+
+    static JobPool pool(thread_count - 1);
+    const uint32_t band_rows = (height + thread_count - 1) / thread_count;
+    std::vector<JobPtr> jobs;
+    for (uint32_t first_row = band_rows; first_row < height; first_row += band_rows)
+        jobs.push_back(pool.submit([=]() { convert_rows(first_row, std::min(first_row + band_rows, height)); }));
+    convert_rows(0, std::min(band_rows, height));
+    for (const JobPtr &job : jobs)
+        job->wait();
+}
@@ -20,9 +20,13 @@
 
 #include <emuenv/state.h>
 #include <gui/state.h>
+#include <io/mapped_file.h>
 
 #include <pugixml.hpp>
 
+#include <cstring>
+#include <vector>
+
 namespace compat {
 
 static std::string db_updated_at;
@@ -38,13 +42,137 @@ enum class LabelIdState {
     Playable = 920344019, // 0x36db55d3
 };
 
+// Binary copy of the compatibility database written next to the XML, loading it skips the parsing of the XML at each start.
+// It keeps the size and the write time of the XML it was made from and is rebuilt once the XML is downloaded again
+static constexpr char db_cache_magic[4] = { 'V', '3', 'C', 'D' };
+static const uint32_t db_cache_version = 1;
+
+struct CompatCacheHeader {
+    char magic[4];
+    uint32_t cache_version;
+    uint32_t db_version;
+    uint32_t count;
+    uint64_t xml_size;
+    int64_t xml_time;
+    char db_updated_at[32];
+};
+
+// The entries are sorted by title ID, like the compatibility map
+struct CompatCacheEntry {
+    char title_id[16];
+    uint32_t issue_id;
+    int32_t state;
+    int64_t updated_at;
+};
+
+static_assert(sizeof(CompatCacheHeader) == 64);
+static_assert(sizeof(CompatCacheEntry) == 32);
+
+static bool load_compat_app_db_cache(GuiState &gui, const fs::path &cache_path, const uint64_t xml_size, const int64_t xml_time) {
+    // Small caches are not mapped, they are read at once
+    std::vector<uint8_t> buffer;
+    const auto mapped = MappedFile::create(cache_path);
+    if (!mapped) {
+        fs::ifstream file(cache_path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    const uint8_t *data = mapped ? mapped->data() : buffer.data();
+    const uint64_t size = mapped ? mapped->size() : buffer.size();
+    if (size < sizeof(CompatCacheHeader))
+        return false;
+
+    CompatCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    if ((memcmp(header.magic, db_cache_magic, sizeof(db_cache_magic)) != 0) || (header.cache_version != db_cache_version)
+        || (header.db_version != db_version) || (header.xml_size != xml_size) || (header.xml_time != xml_time)
+        || (size != sizeof(CompatCacheHeader) + static_cast<uint64_t>(header.count) * sizeof(CompatCacheEntry)))
+        return false;
+
+    // Clear old compat database
+    gui.compat.compat_db_loaded = false;
+    gui.compat.app_compat_db.clear();
+
+    db_updated_at.assign(header.db_updated_at, strnlen(header.db_updated_at, sizeof(header.db_updated_at)));
+
+    const uint8_t *entries = data + sizeof(CompatCacheHeader);
+    for (uint32_t i = 0; i < header.count; i++) {
+        CompatCacheEntry entry;
+        memcpy(&entry, entries + i * sizeof(CompatCacheEntry), sizeof(entry));
+        const std::string title_id(entry.title_id, strnlen(entry.title_id, sizeof(entry.title_id)));
+        gui.compat.app_compat_db.emplace_hint(gui.compat.app_compat_db.end(), title_id,
+            Compatibility{ entry.issue_id, static_cast<CompatibilityState>(entry.state), static_cast<time_t>(entry.updated_at) });
+    }
+
+    return !gui.compat.app_compat_db.empty();
+}
+
+static void save_compat_app_db_cache(GuiState &gui, const fs::path &cache_path, const uint64_t xml_size, const int64_t xml_time) {
+    CompatCacheHeader header{};
+    memcpy(header.magic, db_cache_magic, sizeof(db_cache_magic));
+    header.cache_version = db_cache_version;
+    header.db_version = db_version;
+    header.count = static_cast<uint32_t>(gui.compat.app_compat_db.size());
+    header.xml_size = xml_size;
+    header.xml_time = xml_time;
+    if (db_updated_at.size() >= sizeof(header.db_updated_at))
+        return;
+    memcpy(header.db_updated_at, db_updated_at.data(), db_updated_at.size());
+
+    std::vector<CompatCacheEntry> entries;
+    entries.reserve(gui.compat.app_compat_db.size());
+    for (const auto &[title_id, compat] : gui.compat.app_compat_db) {
+        // The database is then only read from the XML
+        if (title_id.size() >= sizeof(CompatCacheEntry::title_id))
+            return;
+
+        CompatCacheEntry entry{};
+        memcpy(entry.title_id, title_id.data(), title_id.size());
+        entry.issue_id = compat.issue_id;
+        entry.state = compat.state;
+        entry.updated_at = compat.updated_at;
+        entries.push_back(entry);
+    }
+
+    // Written aside and renamed, a cache cut by a crash is never read
+    const auto tmp_path = fs::path(cache_path).concat(".tmp");
+    {
+        fs::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(CompatCacheEntry));
+        if (!file) {
+            file.close();
+            fs::remove(tmp_path);
+            return;
+        }
+    }
+
+    boost::system::error_code error;
+    fs::rename(tmp_path, cache_path, error);
+    if (error) {
+        LOG_WARN("Failed to write the compatibility database cache {}: {}", cache_path.string(), error.message());
+        fs::remove(tmp_path, error);
+    }
+}
+
 bool load_compat_app_db(GuiState &gui, EmuEnvState &emuenv) {
     const auto app_compat_db_path = fs::path(emuenv.base_path) / "cache/app_compat_db.xml";
-    if (!fs::exists(app_compat_db_path)) {
+    const auto app_compat_db_cache_path = fs::path(emuenv.base_path) / "cache/app_compat_db.bin";
+    boost::system::error_code error;
+    const auto xml_size = fs::file_size(app_compat_db_path, error);
+    const int64_t xml_time = error ? 0 : fs::last_write_time(app_compat_db_path, error);
+    if (error) {
         LOG_WARN("Compatibility database not found at {}.", app_compat_db_path.string());
         return false;
     }
 
+    if (load_compat_app_db_cache(gui, app_compat_db_cache_path, xml_size, xml_time))
+        return true;
+
     // Parse and load file of compatibility database
     pugi::xml_document doc;
     pugi::xml_parse_result result = doc.load_file(app_compat_db_path.c_str());
@@ -96,7 +224,12 @@ bool load_compat_app_db(GuiState &gui, EmuEnvState &emuenv) {
         gui.compat.app_compat_db[title_id] = { issue_id, state, updated_at };
     }
 
-    return !gui.compat.app_compat_db.empty();
+    if (gui.compat.app_compat_db.empty())
+        return false;
+
+    save_compat_app_db_cache(gui, app_compat_db_cache_path, xml_size, xml_time);
+
+    return true;
 }
 
 static std::string get_string_output(const std::string cmd) {
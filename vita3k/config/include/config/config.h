@@ -28,6 +28,12 @@ enum ModulesMode {
     MANUAL
 };
 
+enum CPUOptimizationProfile {
+    CPU_OPT_AUTOMATIC, // Fast for the apps playable in the compatibility database, safe for the others
+    CPU_OPT_SAFE,
+    CPU_OPT_FAST,
+};
+
 enum PerfomanceOverleyDetail {
     MINIMUM,
     LOW,
@@ -64,14 +70,39 @@ enum PerfomanceOverleyPosition {
     code(int, "gpu-idx", 0, gpu_idx)                                                                    \
     code(int, "resolution-multiplier", 1, resolution_multiplier)                                        \
     code(bool, "disable-surface-sync", false, disable_surface_sync)                                     \
+    code(bool, "pipelined-submission", false, pipelined_submission)                                     \
     code(bool, "enable-fxaa", false, enable_fxaa)                                                       \
     code(bool, "v-sync", true, v_sync)                                                                  \
+    code(int, "vblank-rate-multiplier", 1, vblank_rate_multiplier)                                      \
+    code(bool, "scale-process-time", false, scale_process_time)                                         \
+    code(int, "frame-skip", 0, frame_skip)                                                              \
     code(int, "anisotropic-filtering", 1, anisotropic_filtering)                                        \
     code(bool, "texture-cache", true, texture_cache)                                                    \
     code(bool, "hashless-texture-cache", false, hashless_texture_cache)                                 \
+    code(bool, "async-texture-decode", false, async_texture_decode)                                     \
+    code(bool, "draw-previous-texture-contents", false, draw_previous_texture_contents)                 \
+    code(bool, "gpu-texture-decode", false, gpu_texture_decode)                                         \
+    code(bool, "transcode-pvrtc", false, transcode_pvrtc)                                               \
+    code(bool, "texture-disk-cache", false, texture_disk_cache)                                         \
+    code(int, "texture-cache-capacity", 0, texture_cache_capacity)                                      \
+    code(int, "texture-cache-budget", 0, texture_cache_budget)                                          \
+    code(bool, "async-pipeline-compilation", false, async_pipeline_compilation)                         \
+    code(bool, "pipeline-library", false, pipeline_library)                                             \
+    code(bool, "merge-scenes", false, merge_scenes)                                                     \
+    code(bool, "transfer-queue-uploads", false, transfer_queue_uploads)                                 \
+    code(bool, "fsr-upscale", false, fsr_upscale)                                                       \
+    code(std::string, "present-mode", "auto", present_mode)                                             \
+    code(int, "max-frames-in-flight", 0, max_frames_in_flight)                                          \
     code(bool, "boot-apps-full-screen", false, boot_apps_full_screen)                                   \
     code(std::string, "audio-backend", "SDL", audio_backend)                                            \
+    code(int, "audio-latency", 0, audio_latency)                                                        \
     code(bool, "ngs-enable", true, ngs_enable)                                                          \
+    code(bool, "hardware-video-decode", false, hardware_video_decode)                                   \
+    code(int, "video-decode-threads", 0, video_decode_threads)                                          \
+    code(bool, "video-frame-threading", true, video_frame_threading)                                    \
+    code(bool, "ngs-parallel-voices", false, ngs_parallel_voices)                                       \
+    code(int, "ngs-atrac9-cache-size", 0, ngs_atrac9_cache_size)                                        \
+    code(int, "file-cache-size", 0, file_cache_size)                                                    \
     code(int, "sys-button", static_cast<int>(SCE_SYSTEM_PARAM_ENTER_BUTTON_CROSS), sys_button)          \
     code(int, "sys-lang", static_cast<int>(SCE_SYSTEM_PARAM_LANG_ENGLISH_US), sys_lang)                 \
     code(int, "sys-date-format", (int)SCE_SYSTEM_PARAM_DATE_FORMAT_MMDDYYYY, sys_date_format)           \
@@ -84,6 +115,22 @@ enum PerfomanceOverleyPosition {
     code(int, "log-level", static_cast<int>(spdlog::level::trace), log_level)                           \
     code(std::string, "cpu-backend", "Dynarmic", cpu_backend)                                           \
     code(bool, "cpu-opt", true, cpu_opt)                                                                \
+    code(int, "cpu-opt-profile", static_cast<int>(CPU_OPT_SAFE), cpu_opt_profile)                       \
+    code(bool, "jit-cache", false, jit_cache)                                                           \
+    code(bool, "module-cache", true, module_cache)                                                      \
+    code(bool, "fast-boot", false, fast_boot)                                                           \
+    code(bool, "per-core-exclusive-monitor", false, per_core_exclusive_monitor)                         \
+    code(bool, "huge-pages", false, huge_pages)                                                         \
+    code(bool, "hle-hot-functions", false, hle_hot_functions)                                           \
+    code(int, "scheduler-workers", 0, scheduler_workers)                                                \
+    code(std::string, "host-core-pinning", "off", host_core_pinning)                                    \
+    code(bool, "spin-poll-backoff", false, spin_poll_backoff)                                           \
+    code(std::string, "shared-shader-cache-path", std::string{}, shared_shader_cache_path)              \
+    code(std::string, "video-capture-encoder", "auto", video_capture_encoder)                           \
+    code(int, "video-capture-bitrate", 12000, video_capture_bitrate)                                    \
+    code(int, "video-capture-fps", 60, video_capture_fps)                                               \
+    code(int, "jit-code-cache-size", 32, jit_code_cache_size)                                           \
+    code(bool, "vblank-host-refresh", false, vblank_host_refresh)                                       \
     code(std::string, "pref-path", std::string{}, pref_path)                                            \
     code(bool, "discord-rich-presence", true, discord_rich_presence)                                    \
     code(bool, "wait-for-debugger", false, wait_for_debugger)                                           \
@@ -116,14 +163,17 @@ enum PerfomanceOverleyPosition {
     code(int, "keyboard-rightstick-up", 12, keyboard_rightstick_up)                                     \
     code(int, "keyboard-rightstick-down", 14, keyboard_rightstick_down)                                 \
     code(int, "keyboard-button-psbutton", 19, keyboard_button_psbutton)                                 \
+    code(int, "ctrl-sampling-rate", 1000, ctrl_sampling_rate)                                           \
     code(std::string, "user-id", std::string{}, user_id)                                                \
     code(bool, "user-auto-connect", false, auto_user_login)                                             \
     code(bool, "dump-textures", false, dump_textures)                                                   \
+    code(bool, "dump-shaders", false, dump_shaders)                                                     \
     code(bool, "display-info-message", true, display_info_message)                                      \
     code(bool, "show-welcome", true, show_welcome)                                                      \
     code(bool, "asia-font-support", false, asia_font_support)                                           \
     code(bool, "shader-cache", true, shader_cache)                                                      \
     code(bool, "spirv-shader", false, spirv_shader)                                                     \
+    code(bool, "optimize-shaders", false, optimize_shaders)                                             \
     code(uint64_t, "current-ime-lang", 4, current_ime_lang)                                             \
     code(int, "psn-status", static_cast<int>(SCE_NP_SERVICE_STATE_UNKNOWN), psn_status)                 \
     code(bool, "http-enable", true, http_enable)                                                        \
@@ -140,7 +190,8 @@ enum PerfomanceOverleyPosition {
 #define CONFIG_VECTOR(code)                                                                             \
     code(std::vector<std::string>, "lle-modules", std::vector<std::string>{}, lle_modules)              \
     code(std::vector<uint64_t>, "ime-langs", std::vector<uint64_t>{4}, ime_langs)                       \
-    code(std::vector<std::string>, "tracy-advanced-profiling-modules", std::vector<std::string>{}, tracy_advanced_profiling_modules)
+    code(std::vector<std::string>, "tracy-advanced-profiling-modules", std::vector<std::string>{}, tracy_advanced_profiling_modules) \
+    code(std::vector<std::string>, "tracy-subsystems", std::vector<std::string>{}, tracy_subsystems)
 
 // Parent macro for easier generation
 #define CONFIG_LIST(code)                                                                               \
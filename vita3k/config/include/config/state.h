@@ -68,6 +68,12 @@ private:
             pkg_path = rhs.pkg_path;
         if (rhs.pkg_zrif.has_value())
             pkg_zrif = rhs.pkg_zrif;
+        if (rhs.benchmark_report.has_value())
+            benchmark_report = rhs.benchmark_report;
+        if (rhs.input_replay.has_value())
+            input_replay = rhs.input_replay;
+        if (rhs.capture_path.has_value())
+            capture_path = rhs.capture_path;
 
         if (!rhs.config_path.empty())
             config_path = rhs.config_path;
@@ -80,6 +86,9 @@ private:
         load_app_list = rhs.load_app_list;
         self_path = rhs.self_path;
         shader_cache = rhs.shader_cache;
+        benchmark_vblanks = rhs.benchmark_vblanks;
+        benchmark_seconds = rhs.benchmark_seconds;
+        capture_frame = rhs.capture_frame;
     }
 
 public:
@@ -90,6 +99,9 @@ public:
     std::optional<std::string> delete_title_id;
     std::optional<std::string> pkg_path;
     std::optional<std::string> pkg_zrif;
+    std::optional<fs::path> benchmark_report;
+    std::optional<fs::path> input_replay;
+    std::optional<fs::path> capture_path;
 
     // Setting not present in the YAML file
     fs::path config_path = {};
@@ -100,6 +112,15 @@ public:
     bool fullscreen = false;
     bool console = false;
     bool load_app_list = false;
+    // the app is run without the GUI and stopped after this number of vblanks or seconds, 0 if not limited
+    uint64_t benchmark_vblanks = 0;
+    double benchmark_seconds = 0;
+    // the renderer commands of this frame are written to capture_path for renderer-replay, 0 if no frame is captured
+    uint64_t capture_frame = 0;
+
+    bool is_benchmark() const {
+        return (benchmark_vblanks > 0) || (benchmark_seconds > 0);
+    }
 
     /**
      * @brief Available HLE modules for advanced profiling using Tracy
@@ -169,6 +190,7 @@ public:
     struct CurrentConfig {
         std::string cpu_backend;
         bool cpu_opt = true;
+        int cpu_opt_profile = CPU_OPT_SAFE;
         int modules_mode = ModulesMode::AUTOMATIC;
         std::vector<std::string> lle_modules = {};
         bool pstv_mode = false;
@@ -177,6 +199,11 @@ public:
         bool disable_surface_sync = false;
         bool enable_fxaa = false;
         bool v_sync = true;
+        // for the frame rate patches, the vblanks are this many times faster (the process time too with scale_process_time)
+        int vblank_rate_multiplier = 1;
+        bool scale_process_time = false;
+        // most frames in a row whose scenes are dropped when the renderer is a frame behind the guest, 0 to never drop them
+        int frame_skip = 0;
         int anisotropic_filtering = 1;
         int psn_status = SCE_NP_SERVICE_STATE_UNKNOWN;
     };
@@ -165,6 +165,20 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
     input_pkg->needs(input_zrif);
     input_zrif->needs(input_pkg);
 
+    auto benchmark = app.add_option_group("Benchmark", "Run an installed app without the GUI and report its performance");
+    benchmark->add_option("--benchmark-vblanks", command_line.benchmark_vblanks, "Stop the app after this number of vblanks (60 per second) and write the report")
+        ->check(CLI::PositiveNumber)->group("Benchmark");
+    benchmark->add_option("--benchmark-seconds", command_line.benchmark_seconds, "Stop the app after this number of seconds and write the report")
+        ->check(CLI::PositiveNumber)->group("Benchmark");
+    benchmark->add_option("--benchmark-report", command_line.benchmark_report, "Path of the json report of the benchmark.\nDefault: <Vita3K>/benchmark.json")
+        ->default_str({})->group("Benchmark");
+    benchmark->add_option("--input-replay", command_line.input_replay, "Text file of the inputs of the first controller, one \"<vblank> <buttons> [<lx> <ly> <rx> <ry>]\" line each time they change")
+        ->default_str({})->group("Benchmark");
+    benchmark->add_option("--capture-frame", command_line.capture_frame, "Write the renderer commands of this frame and the memory they use, to be replayed by renderer-replay")
+        ->check(CLI::PositiveNumber)->group("Benchmark");
+    benchmark->add_option("--capture-path", command_line.capture_path, "Path of the frame capture.\nDefault: <Vita3K>/capture.v3kcap")
+        ->default_str({})->group("Benchmark");
+
     auto config = app.add_option_group("Configuration", "Modify Vita3K's config.yml file");
     config->add_flag("--" + cfg[e_archive_log] + ",-A", command_line.archive_log, "Makes a duplicate of the log file with TITLE_ID and Game ID as title")
         ->group("Logging");
@@ -238,6 +252,11 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         return InitConfigFailed;
     }
 
+    if (command_line.is_benchmark() && !command_line.run_app_path) {
+        LOG_ERROR("Benchmark mode needs the installed app to run (--installed-path)");
+        return InitConfigFailed;
+    }
+
     // Get LLE modules from the command line, otherwise get the modules from the YML file
     if (!lle_modules.empty()) {
         if (command_line.load_config) {
@@ -34,6 +34,7 @@ struct MemState;
 struct CPUContext;
 struct CPUInterface;
 struct ThreadState;
+class JitInvalidationLog;
 
 typedef std::function<void(CPUState &cpu, uint32_t, Address)> CallSVC;
 
@@ -44,11 +45,45 @@ typedef void *ExclusiveMonitorPtr;
 
 struct CPUProtocolBase {
     virtual void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) = 0;
+    // Called by the JIT when it reaches a svc, returns false if the svc can't be handled without leaving the JIT
+    virtual bool call_svc_inline(CPUState &cpu, uint32_t svc, Address pc) = 0;
     virtual Address get_watch_memory_addr(Address addr) = 0;
+    virtual void record_translated_block(Address pc, bool thumb) = 0;
+    virtual void record_dispatched_block(Address pc, bool thumb) = 0;
     virtual ExclusiveMonitorPtr get_exlusive_monitor() = 0;
+    // Shared by the JITs of every thread, nullptr if their caches are only invalidated by their own thread
+    virtual JitInvalidationLog *get_jit_invalidation_log() = 0;
     virtual ~CPUProtocolBase() = default;
 };
 
+// Registers preserved across a function call by the AAPCS, with the pc to resume at.
+// Switching between code stopped at function calls, like fibers, only needs them.
+struct CPUCalleeSavedContext {
+    std::array<uint32_t, 8> r4_r11{};
+    uint32_t sp = 0;
+    uint32_t lr = 0;
+    uint32_t pc = 0;
+    uint32_t cpsr = 0;
+    uint32_t fpscr = 0;
+    // d8-d15
+    std::array<uint32_t, 16> s16_s31{};
+
+    bool thumb() const {
+        return cpsr & 0x20;
+    }
+
+    void set_pc(uint32_t val) {
+        if (val & 1) {
+            cpsr |= 0x20;
+            val = val & 0xFFFFFFFE;
+        } else {
+            cpsr &= 0xFFFFFFDF;
+            val = val & 0xFFFFFFFC;
+        }
+        pc = val;
+    }
+};
+
 struct CPUContext {
     CPUContext() = default;
 
@@ -24,3 +24,6 @@ struct DisasmState;
 bool init(DisasmState &state);
 std::string disassemble(DisasmState &state, const uint8_t *code, size_t size, uint64_t address, bool thumb, uint16_t *insn_size = nullptr);
 bool is_returning(DisasmState &state);
+// Returns true if the code at address is a short loop jumping back to address which reads memory but never writes it,
+// calls or returns, i.e. the shape of a loop polling a flag
+bool is_polling_loop(DisasmState &state, const uint8_t *code, size_t size, uint64_t address, bool thumb);
@@ -22,11 +22,24 @@
 
 #include <cpu/common.h>
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <stack>
 
-CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol);
+// Counters of the guest loops polling memory, when spin_poll_backoff is set
+struct PollingLoopStats {
+    // Blocks translated with a check for spinning threads
+    std::atomic<uint64_t> loops_found = 0;
+    // Times a thread was found spinning on one of them
+    std::atomic<uint64_t> spins_detected = 0;
+    // Iterations for which the thread paused, yielded or slept
+    std::atomic<uint64_t> backoffs = 0;
+};
+
+PollingLoopStats &get_polling_loop_stats();
+
+CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, bool cpu_unsafe_opt, bool spin_poll_backoff, uint32_t code_cache_size, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol);
 int run(CPUState &state);
 int step(CPUState &state);
 void stop(CPUState &state);
@@ -47,8 +60,12 @@ void write_tpidruro(CPUState &state, uint32_t value);
 bool is_thumb_mode(CPUState &state);
 CPUContext save_context(CPUState &state);
 void load_context(CPUState &state, CPUContext ctx);
+// Cheaper than a full context switch, for code stopped at a function call
+void save_callee_saved_context(CPUState &state, CPUCalleeSavedContext &ctx);
+void load_callee_saved_context(CPUState &state, const CPUCalleeSavedContext &ctx);
 std::size_t get_processor_id(CPUState &state);
 void invalidate_jit_cache(CPUState &state, Address start, size_t length);
+void precompile_block(CPUState &state, Address pc);
 
 uint32_t read_fpscr(CPUState &state);
 void write_fpscr(CPUState &state, uint32_t value);
@@ -61,6 +78,7 @@ uint32_t stack_free(CPUState &state, size_t size);
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores);
 void free_exclusive_monitor(ExclusiveMonitorPtr monitor);
 void clear_exclusive(ExclusiveMonitorPtr monitor, std::size_t core_num);
+void clear_exclusive(CPUState &state);
 
 // Debugging helpers
 std::string disassemble(CPUState &state, uint64_t at, bool thumb, uint16_t *insn_size = nullptr);
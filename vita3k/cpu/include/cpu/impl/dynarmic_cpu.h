@@ -24,7 +24,9 @@
 
 #include <cpu/functions.h>
 #include <cpu/impl/unicorn_cpu.h>
+#include <cpu/jit_invalidation.h>
 
+#include <array>
 #include <functional>
 #include <memory>
 
@@ -41,6 +43,7 @@ class DynarmicCPU : public CPUInterface {
     std::unique_ptr<ArmDynarmicCallback> cb;
     std::shared_ptr<ArmDynarmicCP15> cp15;
     Dynarmic::ExclusiveMonitor *monitor;
+    std::unique_ptr<Dynarmic::ExclusiveMonitor> local_monitor;
 
     std::size_t core_id = 0;
 
@@ -51,11 +54,35 @@ class DynarmicCPU : public CPUInterface {
     bool log_mem = false;
     bool log_code = false;
     bool cpu_opt;
+    // Only used with cpu_opt, trades the accuracy of the floating point operations for speed
+    bool cpu_unsafe_opt;
+    bool spin_poll_backoff;
+    // Size of the host code cache of the JIT in MiB, 0 for the default of Dynarmic
+    uint32_t code_cache_size;
+
+    // Last iteration of a polling loop, the thread is spinning while the loop starts again with the same registers
+    struct PollingLoop {
+        Address pc = 0;
+        std::array<uint32_t, 16> regs{};
+        uint32_t spins = 0;
+        uint64_t spins_detected = 0;
+    } polling_loop;
+
+    // Totals of the interpreter fallback for this thread, logged when it exits
+    uint64_t fallbacks_total = 0;
+    uint64_t fallback_time_total_ns = 0;
+
+    // Invalidations pushed by all the threads, applied up to invalidation_generation
+    JitInvalidationLog *invalidations = nullptr;
+    uint64_t invalidation_generation = 0;
 
     std::unique_ptr<Dynarmic::A32::Jit> make_jit();
+    void check_polling_loop(Address pc);
+    void apply_invalidations();
+    void watch_code_page(Address addr);
 
 public:
-    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt);
+    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt, bool cpu_unsafe_opt, bool spin_poll_backoff, uint32_t code_cache_size);
     ~DynarmicCPU() override;
     int run() override;
     void stop() override;
@@ -86,6 +113,8 @@ public:
 
     CPUContext save_context() override;
     void load_context(CPUContext context) override;
+    void save_callee_saved_context(CPUCalleeSavedContext &context) override;
+    void load_callee_saved_context(const CPUCalleeSavedContext &context) override;
 
     bool is_thumb_mode() override;
     int step() override;
@@ -99,4 +128,6 @@ public:
 
     std::size_t processor_id() const override;
     void invalidate_jit_cache(Address start, size_t length) override;
+    void precompile_block(Address pc) override;
+    void clear_exclusive() override;
 };
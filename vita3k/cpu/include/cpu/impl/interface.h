@@ -55,7 +55,11 @@ struct CPUInterface {
 
     virtual CPUContext save_context() = 0;
     virtual void load_context(CPUContext context) = 0;
+    virtual void save_callee_saved_context(CPUCalleeSavedContext &context) = 0;
+    virtual void load_callee_saved_context(const CPUCalleeSavedContext &context) = 0;
     virtual void invalidate_jit_cache(Address start, size_t length) {}
+    virtual void precompile_block(Address pc) {}
+    virtual void clear_exclusive() {}
 
     virtual bool is_thumb_mode() = 0;
     virtual int step() = 0;
@@ -97,6 +97,8 @@ public:
 
     CPUContext save_context() override;
     void load_context(CPUContext context) override;
+    void save_callee_saved_context(CPUCalleeSavedContext &context) override;
+    void load_callee_saved_context(const CPUCalleeSavedContext &context) override;
 
     bool hit_breakpoint() override;
     void trigger_breakpoint() override;
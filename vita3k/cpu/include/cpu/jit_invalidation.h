@@ -0,0 +1,76 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <mem/util.h> // Address.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Ranges of guest code invalidated by any thread. Each JIT applies them on its own thread the next time
+// it is entered, instead of having its cache changed while it runs.
+// The pages holding translated code are write protected, a write to one of them invalidates the whole page.
+class JitInvalidationLog {
+public:
+    // Ranges kept for the threads which didn't apply them yet, the ones further behind clear their whole cache
+    static constexpr size_t RANGE_COUNT = 256;
+    // Pages written this many times are no longer protected, they most likely hold data next to the code
+    static constexpr uint8_t MAX_PAGE_WRITES = 8;
+
+    void init(size_t page_size);
+
+    void push(Address start, size_t length);
+
+    uint64_t generation() const {
+        return current.load(std::memory_order_acquire);
+    }
+
+    // Call invalidate for each range pushed since last_generation, or clear if some of them were already overwritten.
+    // Returns the generation to pass the next time.
+    uint64_t collect(uint64_t last_generation, const std::function<void(Address, size_t)> &invalidate, const std::function<void()> &clear);
+
+    // Return true if the page of addr must now be write protected, the JIT translating code from it
+    bool watch_page(Address addr);
+    // Called when a watched page is written, the page must no longer be protected
+    void page_written(Address addr);
+
+    size_t get_page_size() const {
+        return page_size;
+    }
+
+private:
+    static constexpr uint8_t PAGE_WATCHED = 0x80;
+
+    struct Range {
+        Address start = 0;
+        size_t length = 0;
+    };
+
+    std::mutex mutex;
+    std::array<Range, RANGE_COUNT> ranges;
+    std::atomic<uint64_t> current = 0;
+
+    size_t page_size = 0;
+    // Writes counted for each guest page, with PAGE_WATCHED while it is protected
+    std::unique_ptr<std::atomic<uint8_t>[]> pages;
+};
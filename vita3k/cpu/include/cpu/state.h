@@ -21,6 +21,8 @@
 #include <cpu/disasm/state.h>
 #include <cpu/functions.h>
 
+#include <atomic>
+
 struct CPUState {
     CPUState() = default;
 
@@ -35,4 +37,10 @@ struct CPUState {
     CPUInterfacePtr cpu;
     bool svc_called;
     uint32_t svc;
+
+    // Exclusive stores which failed because the memory changed since it was loaded
+    std::atomic<uint64_t> exclusive_store_failures = 0;
+    // Instructions run by the interpreter fallback of the JIT, and the time spent running them in nanoseconds
+    std::atomic<uint64_t> interpreter_fallbacks = 0;
+    std::atomic<uint64_t> interpreter_fallback_time_ns = 0;
 };
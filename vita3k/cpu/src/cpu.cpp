@@ -46,7 +46,12 @@ SceUID get_thread_id(CPUState &state) {
     return state.thread_id;
 }
 
-CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol) {
+PollingLoopStats &get_polling_loop_stats() {
+    static PollingLoopStats stats;
+    return stats;
+}
+
+CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, bool cpu_unsafe_opt, bool spin_poll_backoff, uint32_t code_cache_size, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol) {
     CPUStatePtr state(new CPUState(), delete_cpu_state);
     state->mem = &mem;
     state->protocol = protocol;
@@ -67,7 +72,7 @@ CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::si
     switch (backend) {
     case CPUBackend::Dynarmic: {
         Dynarmic::ExclusiveMonitor *monitor = reinterpret_cast<Dynarmic::ExclusiveMonitor *>(protocol->get_exlusive_monitor());
-        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, cpu_opt);
+        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, cpu_opt, cpu_unsafe_opt, spin_poll_backoff, code_cache_size);
         break;
     }
     case CPUBackend::Unicorn: {
@@ -193,6 +198,14 @@ void invalidate_jit_cache(CPUState &state, Address start, size_t length) {
     state.cpu->invalidate_jit_cache(start, length);
 }
 
+void precompile_block(CPUState &state, Address pc) {
+    state.cpu->precompile_block(pc);
+}
+
+void clear_exclusive(CPUState &state) {
+    state.cpu->clear_exclusive();
+}
+
 std::string disassemble(CPUState &state, uint64_t at, bool thumb, uint16_t *insn_size) {
     MemState &mem = *state.mem;
     const uint8_t *const code = Ptr<const uint8_t>(static_cast<Address>(at)).get(mem);
@@ -213,6 +226,14 @@ void load_context(CPUState &state, CPUContext ctx) {
     state.cpu->load_context(ctx);
 }
 
+void save_callee_saved_context(CPUState &state, CPUCalleeSavedContext &ctx) {
+    state.cpu->save_callee_saved_context(ctx);
+}
+
+void load_callee_saved_context(CPUState &state, const CPUCalleeSavedContext &ctx) {
+    state.cpu->load_callee_saved_context(ctx);
+}
+
 uint32_t stack_alloc(CPUState &state, size_t size) {
     const uint32_t new_sp = read_sp(state) - size;
     write_sp(state, new_sp);
@@ -21,7 +21,10 @@
 
 #include <capstone/capstone.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 static void delete_insn(cs_insn *insn) {
@@ -69,3 +72,51 @@ std::string disassemble(DisasmState &state, const uint8_t *code, size_t size, ui
 bool is_returning(DisasmState &state) {
     return std::string(state.insn->mnemonic).rfind("pop", 0) == 0;
 }
+
+static bool is_branch(const std::string &mnemonic) {
+    static const std::array<const char *, 15> conditions = { "eq", "ne", "hs", "lo", "mi", "pl", "vs", "vc", "hi", "ls", "ge", "lt", "gt", "le", "al" };
+    if ((mnemonic == "cbz") || (mnemonic == "cbnz"))
+        return true;
+    if (mnemonic.empty() || (mnemonic[0] != 'b'))
+        return false;
+
+    std::string suffix = mnemonic.substr(1);
+    if ((suffix.size() >= 2) && (suffix.compare(suffix.size() - 2, 2, ".w") == 0))
+        suffix.resize(suffix.size() - 2);
+    return suffix.empty() || std::any_of(conditions.begin(), conditions.end(), [&](const char *condition) { return suffix == condition; });
+}
+
+bool is_polling_loop(DisasmState &state, const uint8_t *code, size_t size, uint64_t address, bool thumb) {
+    constexpr int MAX_LOOP_INSTRUCTIONS = 8;
+
+    const cs_err err = cs_option(state.csh, CS_OPT_MODE, thumb ? CS_MODE_THUMB : CS_MODE_ARM);
+    assert(err == CS_ERR_OK);
+
+    const uint64_t loop_address = address;
+    bool reads_memory = false;
+    for (int i = 0; i < MAX_LOOP_INSTRUCTIONS; i++) {
+        if (!cs_disasm_iter(state.csh, &code, &size, &address, state.insn.get()))
+            return false;
+
+        const std::string mnemonic = state.insn->mnemonic;
+        const std::string operands = state.insn->op_str;
+        if (is_branch(mnemonic)) {
+            // The target is the last operand, like "#0x81000010"
+            const size_t target_pos = operands.rfind('#');
+            return reads_memory && (target_pos != std::string::npos) && (std::strtoull(operands.c_str() + target_pos + 1, nullptr, 16) == loop_address);
+        }
+
+        // Writes to memory, calls, returns and system calls make the loop progress
+        for (const char *prefix : { "str", "stm", "push", "pop", "vst", "vpush", "vpop", "swp", "bl", "bx", "svc", "ldm", "tb" }) {
+            if (mnemonic.rfind(prefix, 0) == 0)
+                return false;
+        }
+        if (operands.rfind("pc", 0) == 0)
+            return false;
+
+        if ((mnemonic.rfind("ldr", 0) == 0) || (mnemonic.rfind("vldr", 0) == 0))
+            reads_memory = true;
+    }
+
+    return false;
+}
@@ -23,10 +23,45 @@
 #include <set>
 #include <util/log.h>
 
+#include <mem/functions.h>
 #include <mem/ptr.h>
+#include <mem/state.h>
 
 #include <dynarmic/frontend/A32/a32_ir_emitter.h>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// A polling loop starting this many times in a row with the same registers is a thread spinning on memory
+constexpr uint32_t POLLING_LOOP_SPIN_THRESHOLD = 64;
+// Then the thread pauses the host cpu for this many iterations, yields it for as many, and sleeps afterwards
+constexpr uint32_t POLLING_LOOP_PAUSE_COUNT = 64;
+constexpr uint32_t POLLING_LOOP_YIELD_COUNT = 1024;
+constexpr std::chrono::microseconds POLLING_LOOP_SLEEP{ 50 };
+// Bytes of code read at the start of a block to recognize a polling loop
+constexpr size_t POLLING_LOOP_MAX_SIZE = 32;
+
+static void pause_host_cpu() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    __yield();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
 class ArmDynarmicCP15 : public Dynarmic::A32::Coprocessor {
     uint32_t tpidruro;
 
@@ -99,9 +134,17 @@ public:
 
     ~ArmDynarmicCallback() override = default;
 
+    // Once some memory is watched, only the watched pages reach the callbacks, but they may hold other data too
+    bool should_log_access(Dynarmic::A32::VAddr addr) {
+        return cpu->log_mem && (!has_page_watches(*parent->mem) || parent->protocol->get_watch_memory_addr(addr));
+    }
+
     std::optional<std::uint32_t> MemoryReadCode(Dynarmic::A32::VAddr addr) override {
         if (cpu->log_mem)
             LOG_TRACE("Instruction fetch at addr 0x{:X}", addr);
+        // Protected before reading it, a write done meanwhile still invalidates the block
+        if (cpu->invalidations && cpu->invalidations->watch_page(addr))
+            cpu->watch_code_page(addr);
         return MemoryRead32(addr);
     }
 
@@ -117,10 +160,29 @@ public:
         LOG_TRACE("{} ({}): {} {}", log_hex(self_), self.parent->thread_id, log_hex(address), disassembly);
     }
 
+    static void CheckPollingLoop(uint64_t self_, uint64_t pc) {
+        ArmDynarmicCallback &self = *reinterpret_cast<ArmDynarmicCallback *>(self_);
+        self.cpu->check_polling_loop(static_cast<Address>(pc));
+    }
+
+    bool is_polling_loop(bool is_thumb, Dynarmic::A32::VAddr pc) {
+        const Ptr<uint8_t> code{ pc };
+        if (!code.valid(*parent->mem) || !Ptr<uint8_t>{ pc + POLLING_LOOP_MAX_SIZE - 1 }.valid(*parent->mem))
+            return false;
+
+        return ::is_polling_loop(parent->disasm, code.get(*parent->mem), POLLING_LOOP_MAX_SIZE, pc, is_thumb);
+    }
+
     void PreCodeTranslationHook(bool is_thumb, Dynarmic::A32::VAddr pc, Dynarmic::A32::IREmitter &ir) override {
+        parent->protocol->record_translated_block(pc, is_thumb);
         if (cpu->log_code) {
             ir.CallHostFunction(&TraceInstruction, ir.Imm64((uint64_t)this), ir.Imm64(pc), ir.Imm64(is_thumb));
         }
+        // Only short loops reading memory without writing it pay for the check
+        if (cpu->spin_poll_backoff && is_polling_loop(is_thumb, pc)) {
+            get_polling_loop_stats().loops_found++;
+            ir.CallHostFunction(&CheckPollingLoop, ir.Imm64((uint64_t)this), ir.Imm64(pc));
+        }
     }
 
     template <typename T>
@@ -138,7 +200,7 @@ public:
         }
 
         T ret = *ptr.get(*parent->mem);
-        if (cpu->log_mem) {
+        if (should_log_access(addr)) {
             LOG_TRACE("Read uint{}_t at address: 0x{:x}, val = 0x{:x}", sizeof(T) * 8, addr, ret);
         }
         return ret;
@@ -175,7 +237,7 @@ public:
         }
 
         *ptr.get(*parent->mem) = value;
-        if (cpu->log_mem) {
+        if (should_log_access(addr)) {
             LOG_TRACE("Write uint{}_t at addr: 0x{:x}, val = 0x{:x}", sizeof(T) * 8, addr, value);
         }
     }
@@ -211,7 +273,9 @@ public:
         }
 
         auto result = Ptr<T>(addr).atomic_compare_and_swap(*parent->mem, value, expected);
-        if (cpu->log_mem) {
+        if (!result)
+            parent->exclusive_store_failures.fetch_add(1, std::memory_order_relaxed);
+        if (should_log_access(addr)) {
             LOG_TRACE("Write uint{}_t at addr: 0x{:x}, val = 0x{:x}, expected = 0x{:x}", sizeof(T) * 8, addr, value, expected);
         }
         return result;
@@ -233,7 +297,10 @@ public:
         return MemoryWriteExclusive(addr, value, expected); // Ptr<uint64_t>(addr).atomic_compare_and_swap(*parent->mem, value, expected);
     }
 
+    // Only the instructions Dynarmic can't translate are run by Unicorn, the JIT resumes right after them
+    // The Unicorn instance of the thread is kept, only the registers are synchronized with it
     void InterpreterFallback(Dynarmic::A32::VAddr addr, size_t num_insts) override {
+        const auto start = std::chrono::steady_clock::now();
         if (cpu->is_thumb_mode())
             addr |= 1;
 
@@ -245,6 +312,12 @@ public:
         context.cpsr = cpu->get_cpsr();
         context.fpscr = cpu->get_fpscr();
         cpu->load_context(context);
+
+        const uint64_t elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        parent->interpreter_fallbacks.fetch_add(num_insts, std::memory_order_relaxed);
+        parent->interpreter_fallback_time_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+        cpu->fallbacks_total += num_insts;
+        cpu->fallback_time_total_ns += elapsed_ns;
     }
 
     void ExceptionRaised(uint32_t pc, Dynarmic::A32::Exception exception) override {
@@ -292,6 +365,11 @@ public:
     }
 
     void CallSVC(uint32_t svc) override {
+        // The svc is the last instruction of its block, the pc is already after it and the registers are in the JIT state
+        // Logging the code needs the thread loop to see every svc
+        if (!cpu->log_code && parent->protocol->call_svc_inline(*parent, svc, cpu->jit->Regs()[15]))
+            return;
+
         parent->svc_called = true;
         parent->svc = svc;
         cpu->jit->HaltExecution(Dynarmic::HaltReason::UserDefined8);
@@ -304,40 +382,127 @@ public:
     }
 };
 
+static_assert(HOST_PAGE_BITS == Dynarmic::A32::UserConfig::PAGE_BITS);
+
 std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
     Dynarmic::A32::UserConfig config;
     config.arch_version = Dynarmic::A32::ArchVersion::v7;
     config.callbacks = cb.get();
-    config.fastmem_pointer = (log_mem || !cpu_opt) ? nullptr : parent->mem->memory.get();
+    // The page table is the fallback of fastmem, and takes its place when it is off.
+    // Logging every access needs all of them to reach the callbacks, otherwise only the watched pages do:
+    // they are protected by the debugger, so the code using fastmem on them falls back to the page table.
+    const bool log_all_mem = log_mem && !has_page_watches(*parent->mem);
+    config.fastmem_pointer = (log_all_mem || !cpu_opt) ? nullptr : parent->mem->memory.get();
+    config.page_table = log_all_mem ? nullptr : parent->mem->host_page_table.get();
     config.hook_hint_instructions = true;
-    config.global_monitor = monitor;
+    config.global_monitor = local_monitor ? local_monitor.get() : monitor;
     config.coprocessors[15] = cp15;
-    config.page_table = nullptr;
-    config.processor_id = core_id;
+    config.processor_id = local_monitor ? 0 : core_id;
     config.optimizations = cpu_opt ? Dynarmic::all_safe_optimizations : Dynarmic::no_optimizations;
+    // The global monitor and the FPSCR are still honoured, the threads and the flush to zero mode of the games depend on them
+    if (cpu_opt && cpu_unsafe_opt) {
+        config.unsafe_optimizations = true;
+        config.optimizations = config.optimizations | Dynarmic::OptimizationFlag::Unsafe_UnfuseFMA | Dynarmic::OptimizationFlag::Unsafe_ReducedErrorFP | Dynarmic::OptimizationFlag::Unsafe_InaccurateNaN;
+    }
+    // Every guest thread has its own JIT, and Dynarmic reserves a code cache sized for a whole program in each of them.
+    // Most threads only run a small part of the code, the cache is cleared and filled again if one outgrows it.
+    if (code_cache_size)
+        config.code_cache_size = static_cast<std::uint32_t>(MiB(code_cache_size));
 
     return std::make_unique<Dynarmic::A32::Jit>(config);
 }
 
-DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt)
+DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt, bool cpu_unsafe_opt, bool spin_poll_backoff, uint32_t code_cache_size)
     : fallback(state)
     , parent(state)
     , cb(std::make_unique<ArmDynarmicCallback>(*state, *this))
     , cp15(std::make_shared<ArmDynarmicCP15>())
     , monitor(monitor)
     , core_id(processor_id)
-    , cpu_opt(cpu_opt) {
+    , cpu_opt(cpu_opt)
+    , cpu_unsafe_opt(cpu_unsafe_opt)
+    , spin_poll_backoff(spin_poll_backoff)
+    , code_cache_size(code_cache_size) {
+    // Without a shared monitor, every JIT keeps its own reservation and concurrent
+    // exclusive stores are only arbitrated by the compare and swap on guest memory
+    if (!monitor)
+        local_monitor = std::make_unique<Dynarmic::ExclusiveMonitor>(1);
     jit = make_jit();
+
+    invalidations = state->protocol->get_jit_invalidation_log();
+    if (invalidations)
+        invalidation_generation = invalidations->generation();
 }
 
 DynarmicCPU::~DynarmicCPU() {
+    if (polling_loop.spins_detected > 0)
+        LOG_INFO("Thread {} was found spinning on polling loops {} times", parent->thread_id, polling_loop.spins_detected);
+    if (fallbacks_total > 0)
+        LOG_INFO("Thread {} ran {} instructions with the interpreter fallback in {} us", parent->thread_id, fallbacks_total, fallback_time_total_ns / 1000);
+}
+
+// Called at the start of every iteration of a polling loop
+void DynarmicCPU::check_polling_loop(Address pc) {
+    // Without stores, an iteration starting with the same registers as the last one only waits for another thread.
+    // The pc is left out, it isn't always written back between linked blocks
+    const std::array<uint32_t, 16> &regs = jit->Regs();
+    if ((pc != polling_loop.pc) || !std::equal(regs.begin(), regs.begin() + 15, polling_loop.regs.begin())) {
+        polling_loop.pc = pc;
+        polling_loop.regs = regs;
+        polling_loop.spins = 0;
+        return;
+    }
+
+    const uint32_t spins = ++polling_loop.spins;
+    if (spins < POLLING_LOOP_SPIN_THRESHOLD)
+        return;
+
+    PollingLoopStats &stats = get_polling_loop_stats();
+    if (spins == POLLING_LOOP_SPIN_THRESHOLD) {
+        stats.spins_detected++;
+        polling_loop.spins_detected++;
+    }
+    stats.backoffs++;
+
+    const uint32_t backoff = spins - POLLING_LOOP_SPIN_THRESHOLD;
+    if (backoff < POLLING_LOOP_PAUSE_COUNT)
+        pause_host_cpu();
+    else if (backoff < POLLING_LOOP_PAUSE_COUNT + POLLING_LOOP_YIELD_COUNT)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(POLLING_LOOP_SLEEP);
+}
+
+// Write protect a page code is translated from, the first write to it invalidates the code of the page for all the threads
+void DynarmicCPU::watch_code_page(Address addr) {
+    JitInvalidationLog *log = invalidations;
+    const size_t page_size = log->get_page_size();
+    const Address page = addr - (addr % page_size);
+    add_protect(*parent->mem, page, page_size, MEM_PERM_READONLY, [log, page](Address, bool) {
+        log->page_written(page);
+        return true;
+    });
+}
+
+void DynarmicCPU::apply_invalidations() {
+    if (!invalidations || (invalidations->generation() == invalidation_generation))
+        return;
+
+    invalidation_generation = invalidations->collect(
+        invalidation_generation,
+        [&](Address start, size_t length) { jit->InvalidateCacheRange(start, length); },
+        [&]() { jit->ClearCache(); });
 }
 
 int DynarmicCPU::run() {
+    // Outside of Run, the JIT of this thread can't be executing the code being invalidated
+    apply_invalidations();
     halted = false;
     break_ = false;
     exit_request = false;
     parent->svc_called = false;
+    // Only the blocks Run starts from are seen here, the ones reached by jumps inside the JIT are not
+    parent->protocol->record_dispatched_block(jit->Regs()[15], (jit->Cpsr() & 0x20) != 0);
     jit->Run();
     return halted;
 }
@@ -467,6 +632,29 @@ void DynarmicCPU::load_context(CPUContext ctx) {
     jit->LoadContext(dctx);
 }
 
+// Only the registers are touched, without going through a full Dynarmic context
+void DynarmicCPU::save_callee_saved_context(CPUCalleeSavedContext &ctx) {
+    const auto &regs = jit->Regs();
+    std::copy_n(regs.begin() + 4, ctx.r4_r11.size(), ctx.r4_r11.begin());
+    ctx.sp = regs[13];
+    ctx.lr = regs[14];
+    ctx.pc = regs[15];
+    ctx.cpsr = jit->Cpsr();
+    ctx.fpscr = jit->Fpscr();
+    std::copy_n(jit->ExtRegs().begin() + 16, ctx.s16_s31.size(), ctx.s16_s31.begin());
+}
+
+void DynarmicCPU::load_callee_saved_context(const CPUCalleeSavedContext &ctx) {
+    auto &regs = jit->Regs();
+    std::copy(ctx.r4_r11.begin(), ctx.r4_r11.end(), regs.begin() + 4);
+    regs[13] = ctx.sp;
+    regs[14] = ctx.lr;
+    regs[15] = ctx.pc;
+    jit->SetCpsr(ctx.cpsr);
+    jit->SetFpscr(ctx.fpscr);
+    std::copy(ctx.s16_s31.begin(), ctx.s16_s31.end(), jit->ExtRegs().begin() + 16);
+}
+
 uint32_t DynarmicCPU::get_lr() {
     return jit->Regs()[14];
 }
@@ -491,6 +679,24 @@ void DynarmicCPU::invalidate_jit_cache(Address start, size_t length) {
     jit->InvalidateCacheRange(start, length);
 }
 
+void DynarmicCPU::clear_exclusive() {
+    if (local_monitor)
+        local_monitor->ClearProcessor(0);
+    else
+        monitor->ClearProcessor(core_id);
+}
+
+void DynarmicCPU::precompile_block(Address pc) {
+    const uint32_t current_pc = get_pc();
+    const uint32_t cpsr = get_cpsr();
+    set_pc(pc);
+    // With a halt already requested, Run only looks up (and translates) the block at PC, then returns
+    jit->HaltExecution(Dynarmic::HaltReason::UserDefined7);
+    jit->Run();
+    set_cpsr(cpsr);
+    jit->Regs()[15] = current_pc;
+}
+
 // TODO: proper abstraction
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores) {
     return new Dynarmic::ExclusiveMonitor(max_num_cores);
@@ -0,0 +1,82 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <cpu/jit_invalidation.h>
+
+#include <algorithm>
+#include <vector>
+
+static constexpr uint64_t GUEST_MEMORY_SIZE = 1ULL << 32;
+
+void JitInvalidationLog::init(size_t page_size) {
+    this->page_size = page_size;
+    pages = std::make_unique<std::atomic<uint8_t>[]>(GUEST_MEMORY_SIZE / page_size);
+}
+
+void JitInvalidationLog::push(Address start, size_t length) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t generation = current.load(std::memory_order_relaxed);
+    ranges[generation % RANGE_COUNT] = { start, length };
+    current.store(generation + 1, std::memory_order_release);
+}
+
+uint64_t JitInvalidationLog::collect(uint64_t last_generation, const std::function<void(Address, size_t)> &invalidate, const std::function<void()> &clear) {
+    std::vector<Range> pending;
+    uint64_t generation;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        generation = current.load(std::memory_order_relaxed);
+        if (generation - last_generation <= RANGE_COUNT) {
+            pending.reserve(generation - last_generation);
+            for (uint64_t i = last_generation; i < generation; i++)
+                pending.push_back(ranges[i % RANGE_COUNT]);
+        }
+    }
+
+    if (generation - last_generation > RANGE_COUNT) {
+        clear();
+        return generation;
+    }
+
+    for (const Range &range : pending)
+        invalidate(range.start, range.length);
+
+    return generation;
+}
+
+bool JitInvalidationLog::watch_page(Address addr) {
+    if (!pages)
+        return false;
+
+    std::atomic<uint8_t> &page = pages[addr / page_size];
+    uint8_t state = page.load(std::memory_order_relaxed);
+    if ((state & PAGE_WATCHED) || (state >= MAX_PAGE_WRITES))
+        return false;
+
+    return page.compare_exchange_strong(state, state | PAGE_WATCHED);
+}
+
+void JitInvalidationLog::page_written(Address addr) {
+    std::atomic<uint8_t> &page = pages[addr / page_size];
+    // While the page is watched, nothing else changes its state
+    const uint8_t writes = page.load(std::memory_order_relaxed) & ~PAGE_WATCHED;
+    page.store(std::min<uint8_t>(writes + 1, MAX_PAGE_WRITES), std::memory_order_relaxed);
+
+    const Address page_start = addr - (addr % page_size);
+    push(page_start, page_size);
+}
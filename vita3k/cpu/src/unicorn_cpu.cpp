@@ -20,6 +20,7 @@
 #include <mem/ptr.h>
 #include <util/log.h>
 
+#include <bit>
 #include <cassert>
 #include <cpu/disasm/functions.h>
 
@@ -349,18 +350,43 @@ bool UnicornCPU::is_thumb_mode() {
     return mode & UC_MODE_THUMB;
 }
 
+// Ids of the registers of a CPUContext, the core registers in order then the double registers holding the single ones
+// They are transferred with a single batch, the fallback of Dynarmic loads and saves a context for every instruction it runs
+static constexpr size_t CONTEXT_DOUBLE_REG_COUNT = std::tuple_size_v<decltype(CPUContext::fpu_registers)> / 2;
+static constexpr size_t CONTEXT_REG_COUNT = 16 + CONTEXT_DOUBLE_REG_COUNT;
+
+static std::array<int, CONTEXT_REG_COUNT> context_reg_ids() {
+    std::array<int, CONTEXT_REG_COUNT> ids{};
+    // the core registers are not contiguous in the Unicorn ids after r12
+    for (int i = 0; i < 13; i++)
+        ids[i] = UC_ARM_REG_R0 + i;
+    ids[13] = UC_ARM_REG_SP;
+    ids[14] = UC_ARM_REG_LR;
+    ids[15] = UC_ARM_REG_PC;
+    for (int i = 0; i < static_cast<int>(CONTEXT_DOUBLE_REG_COUNT); i++)
+        ids[16 + i] = UC_ARM_REG_D0 + i;
+
+    return ids;
+}
+
+static std::array<void *, CONTEXT_REG_COUNT> context_reg_values(CPUContext &ctx) {
+    std::array<void *, CONTEXT_REG_COUNT> values{};
+    for (size_t i = 0; i < 16; i++)
+        values[i] = &ctx.cpu_registers[i];
+    for (size_t i = 0; i < CONTEXT_DOUBLE_REG_COUNT; i++)
+        values[16 + i] = &ctx.fpu_registers[i * 2];
+
+    return values;
+}
+
 CPUContext UnicornCPU::save_context() {
-    CPUContext ctx;
-    for (size_t i = 0; i < 13; i++) {
-        ctx.cpu_registers[i] = get_reg(i);
-    }
-    ctx.cpu_registers[13] = get_sp();
-    ctx.cpu_registers[14] = get_lr();
-    ctx.set_pc(is_thumb_mode() ? get_pc() | 1 : get_pc());
+    static std::array<int, CONTEXT_REG_COUNT> ids = context_reg_ids();
 
-    for (size_t i = 0; i < ctx.fpu_registers.size(); i++) {
-        ctx.fpu_registers[i] = get_float_reg(i);
-    }
+    CPUContext ctx;
+    std::array<void *, CONTEXT_REG_COUNT> values = context_reg_values(ctx);
+    const uc_err err = uc_reg_read_batch(uc.get(), ids.data(), values.data(), static_cast<int>(CONTEXT_REG_COUNT));
+    assert(err == UC_ERR_OK);
+    ctx.set_pc(is_thumb_mode() ? ctx.get_pc() | 1 : ctx.get_pc());
 
     // Unicorn doesn't like tweaking cpsr
     // ctx.cpsr = get_cpsr();
@@ -369,21 +395,46 @@ CPUContext UnicornCPU::save_context() {
     return ctx;
 }
 
-void UnicornCPU::load_context(CPUContext ctx) {
-    for (size_t i = 0; i < ctx.fpu_registers.size(); i++) {
-        set_float_reg(i, ctx.fpu_registers[i]);
+void UnicornCPU::save_callee_saved_context(CPUCalleeSavedContext &ctx) {
+    for (size_t i = 0; i < ctx.r4_r11.size(); i++) {
+        ctx.r4_r11[i] = get_reg(i + 4);
     }
+    ctx.sp = get_sp();
+    ctx.lr = get_lr();
+    ctx.set_pc(is_thumb_mode() ? get_pc() | 1 : get_pc());
+
+    for (size_t i = 0; i < ctx.s16_s31.size(); i++) {
+        ctx.s16_s31[i] = std::bit_cast<uint32_t>(get_float_reg(i + 16));
+    }
+}
+
+void UnicornCPU::load_callee_saved_context(const CPUCalleeSavedContext &ctx) {
+    for (size_t i = 0; i < ctx.s16_s31.size(); i++) {
+        set_float_reg(i + 16, std::bit_cast<float>(ctx.s16_s31[i]));
+    }
+
+    // Unicorn doesn't like tweaking cpsr, as in load_context
+    for (size_t i = 0; i < ctx.r4_r11.size(); i++) {
+        set_reg(i + 4, ctx.r4_r11[i]);
+    }
+    set_sp(ctx.sp);
+    set_lr(ctx.lr);
+    set_pc(ctx.thumb() ? ctx.pc | 1 : ctx.pc);
+}
+
+void UnicornCPU::load_context(CPUContext ctx) {
+    static std::array<int, CONTEXT_REG_COUNT> ids = context_reg_ids();
 
     // Unicorn doesn't like tweaking cpsr
     // set_cpsr(ctx.cpsr);
     // set_fpscr(ctx.fpscr);
 
-    for (size_t i = 0; i < 16; i++) {
-        set_reg(i, ctx.cpu_registers[i]);
-    }
-    set_sp(ctx.get_sp());
-    set_lr(ctx.get_lr());
-    set_pc(ctx.thumb() ? ctx.get_pc() | 1 : ctx.get_pc());
+    // Unicorn switches to thumb with the low bit of the pc
+    if (ctx.thumb())
+        ctx.cpu_registers[15] |= 1;
+    std::array<void *, CONTEXT_REG_COUNT> values = context_reg_values(ctx);
+    const uc_err err = uc_reg_write_batch(uc.get(), ids.data(), values.data(), static_cast<int>(CONTEXT_REG_COUNT));
+    assert(err == UC_ERR_OK);
 }
 
 bool UnicornCPU::hit_breakpoint() {
@@ -32,6 +32,8 @@
 #include <aes.h>
 #include <crypto/aes.h>
 
+#include "aes_hw.h"
+
 /*
  * 32-bit integer manipulation macros (little endian)
  */
@@ -577,6 +579,11 @@ int aes_crypt_ecb(aes_context *ctx,
     int i;
     uint32_t *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
 
+    if (aes_hw_available()) {
+        aes_hw_crypt_ecb(ctx->rk, ctx->nr, mode == AES_DECRYPT, input, output, 1);
+        return (0);
+    }
+
     RK = ctx->rk;
 
     GET_UINT32_LE(X0, input, 0);
@@ -645,7 +652,10 @@ int aes_crypt_cbc(aes_context *ctx,
     if (length % 16)
         return (POLARSSL_ERR_AES_INVALID_INPUT_LENGTH);
 
-    if (mode == AES_DECRYPT) {
+    if (mode == AES_DECRYPT && aes_hw_available()) {
+        memcpy(orig_iv, iv, 16);
+        aes_hw_decrypt_cbc(ctx->rk, ctx->nr, orig_iv, input, output, length / 16);
+    } else if (mode == AES_DECRYPT) {
         memcpy(orig_iv, iv, 16);
         while (length > 0) {
             memcpy(temp, input, 16);
@@ -731,6 +741,15 @@ int aes_crypt_ctr(aes_context *ctx,
     int c, i;
     size_t n = *nc_off;
 
+    // the whole blocks are done together when the stream isn't resumed in the middle of a block
+    if (n == 0 && length >= 16 && aes_hw_available()) {
+        const size_t block_count = length / 16;
+        aes_hw_crypt_ctr(ctx->rk, ctx->nr, nonce_counter, input, output, block_count);
+        input += block_count * 16;
+        output += block_count * 16;
+        length -= block_count * 16;
+    }
+
     while (length--) {
         if (n == 0) {
             aes_crypt_ecb(ctx, AES_ENCRYPT, nonce_counter, stream_block);
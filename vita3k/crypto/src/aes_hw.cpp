@@ -0,0 +1,221 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "aes_hw.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AES_HW_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AES_HW_TARGET
+#else
+#include <cpuid.h>
+#define AES_HW_TARGET __attribute__((target("aes,sse2")))
+#endif
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+#define AES_HW_ARM
+#include <arm_neon.h>
+#define AES_HW_TARGET
+#endif
+
+#if defined(AES_HW_X86) || defined(AES_HW_ARM)
+
+// blocks processed together, so the latency of the rounds of one block is hidden by the others
+constexpr size_t INTERLEAVED_BLOCKS = 8;
+constexpr int MAX_ROUNDS = 14;
+
+#ifdef AES_HW_X86
+typedef __m128i Block;
+
+AES_HW_TARGET static inline Block load_block(const void *data) {
+    return _mm_loadu_si128(static_cast<const __m128i *>(data));
+}
+
+AES_HW_TARGET static inline void store_block(void *data, const Block block) {
+    _mm_storeu_si128(static_cast<__m128i *>(data), block);
+}
+
+AES_HW_TARGET static inline Block xor_block(const Block a, const Block b) {
+    return _mm_xor_si128(a, b);
+}
+
+template <size_t N>
+AES_HW_TARGET static inline void encrypt_blocks(Block *blocks, const Block *keys, const int rounds) {
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_xor_si128(blocks[i], keys[0]);
+    for (int round = 1; round < rounds; round++)
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = _mm_aesenc_si128(blocks[i], keys[round]);
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_aesenclast_si128(blocks[i], keys[rounds]);
+}
+
+template <size_t N>
+AES_HW_TARGET static inline void decrypt_blocks(Block *blocks, const Block *keys, const int rounds) {
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_xor_si128(blocks[i], keys[0]);
+    for (int round = 1; round < rounds; round++)
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = _mm_aesdec_si128(blocks[i], keys[round]);
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = _mm_aesdeclast_si128(blocks[i], keys[rounds]);
+}
+
+bool aes_hw_available() {
+    static const bool available = []() {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        return (regs[2] & (1 << 25)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            return false;
+        return (ecx & bit_AES) != 0;
+#endif
+    }();
+    return available;
+}
+#else
+typedef uint8x16_t Block;
+
+static inline Block load_block(const void *data) {
+    return vld1q_u8(static_cast<const uint8_t *>(data));
+}
+
+static inline void store_block(void *data, const Block block) {
+    vst1q_u8(static_cast<uint8_t *>(data), block);
+}
+
+static inline Block xor_block(const Block a, const Block b) {
+    return veorq_u8(a, b);
+}
+
+// aese/aesd do the key addition before the substitution, so the last key is added separately
+template <size_t N>
+static inline void encrypt_blocks(Block *blocks, const Block *keys, const int rounds) {
+    for (int round = 0; round < rounds - 1; round++)
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = vaesmcq_u8(vaeseq_u8(blocks[i], keys[round]));
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = veorq_u8(vaeseq_u8(blocks[i], keys[rounds - 1]), keys[rounds]);
+}
+
+template <size_t N>
+static inline void decrypt_blocks(Block *blocks, const Block *keys, const int rounds) {
+    for (int round = 0; round < rounds - 1; round++)
+        for (size_t i = 0; i < N; i++)
+            blocks[i] = vaesimcq_u8(vaesdq_u8(blocks[i], keys[round]));
+    for (size_t i = 0; i < N; i++)
+        blocks[i] = veorq_u8(vaesdq_u8(blocks[i], keys[rounds - 1]), keys[rounds]);
+}
+
+bool aes_hw_available() {
+    return true;
+}
+#endif
+
+AES_HW_TARGET static inline void load_keys(Block *keys, const uint32_t *round_keys, const int rounds) {
+    for (int round = 0; round <= rounds; round++)
+        keys[round] = load_block(round_keys + round * 4);
+}
+
+AES_HW_TARGET void aes_hw_crypt_ecb(const uint32_t *round_keys, const int rounds, const bool is_decrypt, const uint8_t *input, uint8_t *output, size_t block_count) {
+    Block keys[MAX_ROUNDS + 1];
+    load_keys(keys, round_keys, rounds);
+
+    for (; block_count > 0; block_count--, input += 16, output += 16) {
+        Block block = load_block(input);
+        if (is_decrypt)
+            decrypt_blocks<1>(&block, keys, rounds);
+        else
+            encrypt_blocks<1>(&block, keys, rounds);
+        store_block(output, block);
+    }
+}
+
+AES_HW_TARGET void aes_hw_decrypt_cbc(const uint32_t *round_keys, const int rounds, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t block_count) {
+    Block keys[MAX_ROUNDS + 1];
+    load_keys(keys, round_keys, rounds);
+
+    // the ciphertext is loaded before the output is written, so it also works in place
+    Block previous = load_block(iv);
+    for (; block_count >= INTERLEAVED_BLOCKS; block_count -= INTERLEAVED_BLOCKS, input += 16 * INTERLEAVED_BLOCKS, output += 16 * INTERLEAVED_BLOCKS) {
+        Block ciphertexts[INTERLEAVED_BLOCKS];
+        Block blocks[INTERLEAVED_BLOCKS];
+        for (size_t i = 0; i < INTERLEAVED_BLOCKS; i++)
+            blocks[i] = ciphertexts[i] = load_block(input + i * 16);
+        decrypt_blocks<INTERLEAVED_BLOCKS>(blocks, keys, rounds);
+        for (size_t i = 0; i < INTERLEAVED_BLOCKS; i++) {
+            store_block(output + i * 16, xor_block(blocks[i], previous));
+            previous = ciphertexts[i];
+        }
+    }
+
+    for (; block_count > 0; block_count--, input += 16, output += 16) {
+        const Block ciphertext = load_block(input);
+        Block block = ciphertext;
+        decrypt_blocks<1>(&block, keys, rounds);
+        store_block(output, xor_block(block, previous));
+        previous = ciphertext;
+    }
+
+    store_block(iv, previous);
+}
+
+static inline void increment_counter(uint8_t counter[16]) {
+    for (int i = 15; i >= 0; i--)
+        if (++counter[i] != 0)
+            break;
+}
+
+AES_HW_TARGET void aes_hw_crypt_ctr(const uint32_t *round_keys, const int rounds, uint8_t counter[16], const uint8_t *input, uint8_t *output, size_t block_count) {
+    Block keys[MAX_ROUNDS + 1];
+    load_keys(keys, round_keys, rounds);
+
+    for (; block_count >= INTERLEAVED_BLOCKS; block_count -= INTERLEAVED_BLOCKS, input += 16 * INTERLEAVED_BLOCKS, output += 16 * INTERLEAVED_BLOCKS) {
+        Block blocks[INTERLEAVED_BLOCKS];
+        for (size_t i = 0; i < INTERLEAVED_BLOCKS; i++) {
+            blocks[i] = load_block(counter);
+            increment_counter(counter);
+        }
+        encrypt_blocks<INTERLEAVED_BLOCKS>(blocks, keys, rounds);
+        for (size_t i = 0; i < INTERLEAVED_BLOCKS; i++)
+            store_block(output + i * 16, xor_block(load_block(input + i * 16), blocks[i]));
+    }
+
+    for (; block_count > 0; block_count--, input += 16, output += 16) {
+        Block block = load_block(counter);
+        increment_counter(counter);
+        encrypt_blocks<1>(&block, keys, rounds);
+        store_block(output, xor_block(load_block(input), block));
+    }
+}
+
+#else
+
+bool aes_hw_available() {
+    return false;
+}
+
+void aes_hw_crypt_ecb(const uint32_t *, int, bool, const uint8_t *, uint8_t *, size_t) {}
+void aes_hw_decrypt_cbc(const uint32_t *, int, uint8_t[16], const uint8_t *, uint8_t *, size_t) {}
+void aes_hw_crypt_ctr(const uint32_t *, int, uint8_t[16], const uint8_t *, uint8_t *, size_t) {}
+
+#endif
@@ -0,0 +1,33 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// AES using the AES-NI instructions on x86 or the crypto extension on ARMv8.
+// The round keys are the ones of the software implementation, which are already laid out in the order these instructions expect
+
+// true if the host cpu has the instructions, checked once
+bool aes_hw_available();
+
+void aes_hw_crypt_ecb(const uint32_t *round_keys, int rounds, bool is_decrypt, const uint8_t *input, uint8_t *output, size_t block_count);
+// iv is updated to the last block of input
+void aes_hw_decrypt_cbc(const uint32_t *round_keys, int rounds, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t block_count);
+// counter is a big endian 128-bit integer, incremented once per block
+void aes_hw_crypt_ctr(const uint32_t *round_keys, int rounds, uint8_t counter[16], const uint8_t *input, uint8_t *output, size_t block_count);
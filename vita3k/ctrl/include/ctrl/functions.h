@@ -19,8 +19,14 @@
 
 #include <ctrl/state.h>
 #include <emuenv/state.h>
+#include <util/fs.h>
 
 SceCtrlExternalInputMode get_type_of_controller(const int idx);
 int peek_data(EmuEnvState &emuenv, int port, SceCtrlData *&pad_data, int count, bool negative, bool from_ext_function);
 int peek_data(EmuEnvState &emuenv, int port, SceCtrlData2 *&pad_data, int count, bool negative, bool from_ext_function);
+int read_data(EmuEnvState &emuenv, int port, SceCtrlData *&pad_data, int count, bool negative, bool from_ext_function);
+int read_data(EmuEnvState &emuenv, int port, SceCtrlData2 *&pad_data, int count, bool negative, bool from_ext_function);
 void refresh_controllers(CtrlState &state);
+void start_sampling_thread(EmuEnvState &emuenv);
+void stop_sampling_thread(CtrlState &state);
+bool load_input_replay(CtrlState &state, const fs::path &path);
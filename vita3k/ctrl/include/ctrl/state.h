@@ -18,13 +18,19 @@
 #pragma once
 
 #include <ctrl/ctrl.h>
+#include <threads/sample_ring.h>
 
 #include <SDL_gamecontroller.h>
 #include <SDL_haptic.h>
 #include <SDL_joystick.h>
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 struct _SDL_GameController;
 
@@ -43,11 +49,43 @@ struct ControllerBinding {
 
 typedef std::map<SDL_JoystickGUID, Controller> ControllerList;
 
+// buttons and sticks of a port, with the buttons of both the sceCtrl and the sceCtrl*Ext mappings
+struct CtrlSample {
+    uint64_t ticks = 0;
+    uint32_t buttons = 0;
+    uint32_t buttons_ext = 0;
+    std::array<uint8_t, 4> axes = { 0x80, 0x80, 0x80, 0x80 };
+};
+
+// last samples of a port, pushed by the sampling thread and read without lock by the guest threads
+typedef SampleRing<CtrlSample, 64> CtrlSampleRing;
+
+// inputs of the first port read from a replay file, each event is kept until the vblank of the next one
+struct CtrlReplayEvent {
+    uint64_t vblank = 0;
+    // buttons of the sceCtrl mapping, the triggers are L1 and R1 in the sceCtrl*Ext mapping
+    uint32_t buttons = 0;
+    std::array<uint8_t, 4> axes = { 0x80, 0x80, 0x80, 0x80 };
+};
+
 struct CtrlState {
+    ~CtrlState();
+
+    // guards the controllers, they're refreshed by the sampling thread and the guest threads
+    std::mutex mutex;
     ControllerList controllers;
     int controllers_num = 0;
     const char *controllers_name[SCE_CTRL_MAX_WIRELESS_NUM];
     bool free_ports[SCE_CTRL_MAX_WIRELESS_NUM] = { true, true, true, true };
     SceCtrlPadInputMode input_mode = SCE_CTRL_MODE_DIGITAL;
     SceCtrlPadInputMode input_mode_ext = SCE_CTRL_MODE_DIGITAL;
+
+    // samples the ports at the rate of the config, only exists when the rate isn't 0
+    std::unique_ptr<std::thread> sampling_thread;
+    std::atomic<bool> sampling_abort{ false };
+    uint32_t sampling_period_us = 0;
+    uint64_t sampling_base_ticks = 0;
+    std::array<CtrlSampleRing, SCE_CTRL_MAX_WIRELESS_NUM> samples;
+    // sorted by vblank, loaded before the app starts and replacing the keyboard and controllers of the first port if not empty
+    std::vector<CtrlReplayEvent> replay;
 };
@@ -21,12 +21,19 @@
 
 #include <config/state.h>
 #include <dialog/state.h>
+#include <display/state.h>
+#include <kernel/state.h>
+#include <rtc/rtc.h>
+#include <touch/functions.h>
+#include <touch/state.h>
+#include <util/log.h>
 
 #include <SDL_keyboard.h>
 
+#include <algorithm>
 #include <array>
-
-static uint64_t timestamp;
+#include <chrono>
+#include <sstream>
 
 static constexpr std::array<ControllerBinding, 13> controller_bindings = { {
     { SDL_CONTROLLER_BUTTON_BACK, SCE_CTRL_SELECT },
@@ -84,6 +91,8 @@ static bool operator<(const SDL_JoystickGUID &a, const SDL_JoystickGUID &b) {
 }
 
 void refresh_controllers(CtrlState &state) {
+    const std::lock_guard<std::mutex> guard(state.mutex);
+
     // Remove disconnected controllers
     for (ControllerList::iterator controller = state.controllers.begin(); controller != state.controllers.end();) {
         if (SDL_GameControllerGetAttached(controller->second.controller.get())) {
@@ -229,70 +238,245 @@ static void apply_controller(uint32_t *buttons, float axes[4], SDL_GameControlle
     axes[3] += axis_to_axis(SDL_GameControllerGetAxis(controller, SDL_CONTROLLER_AXIS_RIGHTY));
 }
 
-static int peek_buffer(EmuEnvState &emuenv, int port, bool ext, int count, bool negative, bool from_ext_function, SceUInt64 &timeStamp, SceUInt32 &buttons, SceUInt8 &lx, SceUInt8 &ly, SceUInt8 &rx, SceUInt8 &ry) {
-    if (port == 0) {
-        port++;
-    }
-    CtrlState &state = emuenv.ctrl;
-    refresh_controllers(state);
+static void apply_replay(const std::vector<CtrlReplayEvent> &replay, uint64_t vblank, CtrlSample &sample) {
+    // last event at or before the vblank, nothing is pressed before the first one
+    const auto next = std::upper_bound(replay.begin(), replay.end(), vblank, [](uint64_t vblank, const CtrlReplayEvent &event) {
+        return vblank < event.vblank;
+    });
+    if (next == replay.begin())
+        return;
+
+    const CtrlReplayEvent &event = *std::prev(next);
+    sample.buttons = event.buttons;
+    sample.buttons_ext = event.buttons & ~(SCE_CTRL_LTRIGGER | SCE_CTRL_RTRIGGER);
+    if (event.buttons & SCE_CTRL_LTRIGGER)
+        sample.buttons_ext |= SCE_CTRL_L1;
+    if (event.buttons & SCE_CTRL_RTRIGGER)
+        sample.buttons_ext |= SCE_CTRL_R1;
+    sample.axes = event.axes;
+}
 
-    timeStamp = timestamp++; // TODO Use the real time and units.
+static CtrlSample take_sample(EmuEnvState &emuenv, int port, uint64_t base_ticks) {
+    CtrlSample sample;
+    sample.ticks = rtc_get_ticks(base_ticks);
 
-    if (emuenv.common_dialog.status == SCE_COMMON_DIALOG_STATUS_RUNNING) {
-        return 0;
+    if ((port == 1) && !emuenv.ctrl.replay.empty()) {
+        apply_replay(emuenv.ctrl.replay, emuenv.display.vblank_count.load(), sample);
+        return sample;
     }
 
+    // the axes are the same for both mappings
     std::array<float, 4> axes;
+    std::array<float, 4> axes_ext;
     axes.fill(0);
+    axes_ext.fill(0);
     if (port == 1) {
-        apply_keyboard(&buttons, axes.data(), ext, emuenv);
+        apply_keyboard(&sample.buttons, axes.data(), false, emuenv);
+        apply_keyboard(&sample.buttons_ext, axes_ext.data(), true, emuenv);
+    }
+    {
+        const std::lock_guard<std::mutex> guard(emuenv.ctrl.mutex);
+        for (const auto &controller : emuenv.ctrl.controllers) {
+            if (controller.second.port == port) {
+                apply_controller(&sample.buttons, axes.data(), controller.second.controller.get(), false);
+                apply_controller(&sample.buttons_ext, axes_ext.data(), controller.second.controller.get(), true);
+            }
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        sample.axes[i] = float_to_byte(axes[i]);
+
+    return sample;
+}
+
+static void sampling_thread(EmuEnvState &emuenv) {
+    CtrlState &state = emuenv.ctrl;
+    const auto period = std::chrono::microseconds(state.sampling_period_us);
+    const auto refresh_period = std::chrono::milliseconds(100);
+
+    // the vblanks stop sampling the touch panels once they see the period, the panels are sampled here after the next one
+    emuenv.touch.sampling_period_us = state.sampling_period_us;
+    const uint64_t touch_start_vblank = emuenv.display.vblank_count + 2;
+
+    auto next_sample = std::chrono::steady_clock::now();
+    auto next_refresh = next_sample;
+    while (!state.sampling_abort) {
+        const auto now = std::chrono::steady_clock::now();
+        // the controllers are only checked for hotplug every so often, opening them is slow
+        if (now >= next_refresh) {
+            refresh_controllers(state);
+            next_refresh = now + refresh_period;
+        }
+
+        // read the controllers state now instead of waiting for the main thread to pump the events
+        SDL_GameControllerUpdate();
+        for (int port = 1; port <= SCE_CTRL_MAX_WIRELESS_NUM; port++)
+            state.samples[port - 1].push(take_sample(emuenv, port, state.sampling_base_ticks));
+        if (emuenv.display.vblank_count >= touch_start_vblank)
+            touch_sample(emuenv);
+
+        next_sample = std::max(next_sample + period, now);
+        std::this_thread::sleep_until(next_sample);
+    }
+
+    emuenv.touch.sampling_period_us = 0;
+}
+
+void start_sampling_thread(EmuEnvState &emuenv) {
+    CtrlState &state = emuenv.ctrl;
+    if (state.sampling_thread || (emuenv.cfg.ctrl_sampling_rate <= 0))
+        return;
+
+    state.sampling_period_us = std::max<uint32_t>(1'000'000 / emuenv.cfg.ctrl_sampling_rate, 1);
+    state.sampling_base_ticks = emuenv.kernel.base_tick.tick;
+    state.sampling_abort = false;
+    state.sampling_thread = std::make_unique<std::thread>(sampling_thread, std::ref(emuenv));
+    LOG_INFO("Controllers and touch panels sampled every {} us", state.sampling_period_us);
+}
+
+void stop_sampling_thread(CtrlState &state) {
+    if (!state.sampling_thread)
+        return;
+
+    state.sampling_abort = true;
+    state.sampling_thread->join();
+    state.sampling_thread.reset();
+}
+
+bool load_input_replay(CtrlState &state, const fs::path &path) {
+    fs::ifstream file(path);
+    if (!file) {
+        LOG_ERROR("Could not open the input replay file {}", path.string());
+        return false;
     }
-    for (const auto &controller : state.controllers) {
-        if (controller.second.port == port) {
-            apply_controller(&buttons, axes.data(), controller.second.controller.get(), ext);
+
+    // one "<vblank> <buttons> [<lx> <ly> <rx> <ry>]" event per line, the numbers can be in hexadecimal with 0x
+    std::vector<CtrlReplayEvent> replay;
+    std::string line;
+    for (int line_num = 1; std::getline(file, line); line_num++) {
+        if (line.empty() || (line.front() == '#'))
+            continue;
+
+        std::istringstream fields(line);
+        std::vector<std::string> values;
+        for (std::string value; fields >> value;)
+            values.push_back(value);
+        if (values.empty())
+            continue;
+
+        CtrlReplayEvent event;
+        try {
+            if ((values.size() != 2) && (values.size() != 6))
+                throw std::invalid_argument("wrong number of values");
+            event.vblank = std::stoull(values[0], nullptr, 0);
+            event.buttons = static_cast<uint32_t>(std::stoul(values[1], nullptr, 0));
+            for (size_t i = 2; i < values.size(); i++)
+                event.axes[i - 2] = static_cast<uint8_t>(std::clamp<unsigned long>(std::stoul(values[i], nullptr, 0), 0, 0xFF));
+        } catch (const std::exception &) {
+            LOG_ERROR("Invalid event at line {} of the input replay file {}", line_num, path.string());
+            return false;
         }
+        replay.push_back(event);
     }
 
-    SceCtrlPadInputMode mode = from_ext_function ? state.input_mode_ext : state.input_mode;
+    std::stable_sort(replay.begin(), replay.end(), [](const CtrlReplayEvent &a, const CtrlReplayEvent &b) {
+        return a.vblank < b.vblank;
+    });
+    LOG_INFO("Replaying {} input events from {}", replay.size(), path.string());
+    state.replay = std::move(replay);
+    return true;
+}
+
+CtrlState::~CtrlState() {
+    stop_sampling_thread(*this);
+}
+
+template <typename SceCtrlDataType>
+static void write_sample(EmuEnvState &emuenv, const CtrlSample &sample, SceCtrlDataType &data, bool ext, bool negative, bool from_ext_function) {
+    data = {};
+    data.timeStamp = emuenv.kernel.get_process_time(sample.ticks);
+    data.buttons = ext ? sample.buttons_ext : sample.buttons;
+
+    const SceCtrlPadInputMode mode = from_ext_function ? emuenv.ctrl.input_mode_ext : emuenv.ctrl.input_mode;
     if (mode == SCE_CTRL_MODE_DIGITAL) {
-        lx = 0x80;
-        ly = 0x80;
-        rx = 0x80;
-        ry = 0x80;
+        data.lx = 0x80;
+        data.ly = 0x80;
+        data.rx = 0x80;
+        data.ry = 0x80;
     } else {
-        lx = float_to_byte(axes[0]);
-        ly = float_to_byte(axes[1]);
-        rx = float_to_byte(axes[2]);
-        ry = float_to_byte(axes[3]);
+        data.lx = sample.axes[0];
+        data.ly = sample.axes[1];
+        data.rx = sample.axes[2];
+        data.ry = sample.axes[3];
     }
 
     if (negative) {
-        buttons = 0xFFFFFFFF - buttons;
+        data.buttons = 0xFFFFFFFF - data.buttons;
     }
-
-    return count;
 }
 
-int peek_data(EmuEnvState &emuenv, int port, SceCtrlData *&pad_data, int count, bool negative, bool from_ext_function) {
+// Peeking returns the newest samples, reading the ones that weren't read yet and waits for one if there are none
+template <typename SceCtrlDataType>
+static int get_data(EmuEnvState &emuenv, int port, SceCtrlDataType *pad_data, int count, bool negative, bool from_ext_function, bool read) {
+    constexpr bool ext = std::is_same_v<SceCtrlDataType, SceCtrlData2>;
     memset(pad_data, 0, sizeof(*pad_data));
 
-    count = peek_buffer(emuenv, port, false, count, negative, from_ext_function, pad_data->timeStamp, pad_data->buttons, pad_data->lx, pad_data->ly, pad_data->rx, pad_data->ry);
+    if (port == 0) {
+        port++;
+    }
+    CtrlState &state = emuenv.ctrl;
+
+    if (emuenv.common_dialog.status == SCE_COMMON_DIALOG_STATUS_RUNNING) {
+        return 0;
+    }
+
+    CtrlSampleRing &ring = state.samples[port - 1];
+    if (!state.sampling_thread || (ring.head.load(std::memory_order_acquire) == 0)) {
+        refresh_controllers(state);
+        const CtrlSample sample = take_sample(emuenv, port, emuenv.kernel.base_tick.tick);
+        for (int i = 0; i < count; i++)
+            write_sample(emuenv, sample, pad_data[i], ext, negative, from_ext_function);
+
+        return count;
+    }
 
-    for (int i = 1; i < count; i++) {
-        memcpy(&pad_data[i], &pad_data[0], sizeof(SceCtrlData));
+    std::array<CtrlSample, CtrlSampleRing::CAPACITY> samples;
+    const int max_count = std::clamp<int>(count, 1, CtrlSampleRing::CAPACITY - 1);
+    uint64_t head = 0;
+    int copied = 0;
+    if (read) {
+        const uint64_t first = ring.read_head.load();
+        if (ring.head.load(std::memory_order_acquire) <= first) {
+            // a sample is pushed every period, don't wait longer than that to not stall the guest on a stalled thread
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(state.sampling_period_us * 2);
+            while ((ring.head.load(std::memory_order_acquire) <= first) && (std::chrono::steady_clock::now() < deadline))
+                std::this_thread::sleep_for(std::chrono::microseconds(state.sampling_period_us / 4 + 1));
+        }
+        copied = ring.copy(first, max_count, samples.data(), head);
+        ring.read_head.store(head);
     }
+    if (copied == 0)
+        copied = ring.copy(0, read ? 1 : max_count, samples.data(), head);
 
-    return count;
+    for (int i = 0; i < copied; i++)
+        write_sample(emuenv, samples[i], pad_data[i], ext, negative, from_ext_function);
+
+    return copied;
 }
 
-int peek_data(EmuEnvState &emuenv, int port, SceCtrlData2 *&pad_data, int count, bool negative, bool from_ext_function) {
-    memset(pad_data, 0, sizeof(*pad_data));
+int peek_data(EmuEnvState &emuenv, int port, SceCtrlData *&pad_data, int count, bool negative, bool from_ext_function) {
+    return get_data(emuenv, port, pad_data, count, negative, from_ext_function, false);
+}
 
-    count = peek_buffer(emuenv, port, true, count, negative, from_ext_function, pad_data->timeStamp, pad_data->buttons, pad_data->lx, pad_data->ly, pad_data->rx, pad_data->ry);
+int peek_data(EmuEnvState &emuenv, int port, SceCtrlData2 *&pad_data, int count, bool negative, bool from_ext_function) {
+    return get_data(emuenv, port, pad_data, count, negative, from_ext_function, false);
+}
 
-    for (int i = 1; i < count; i++) {
-        memcpy(&pad_data[i], &pad_data[0], sizeof(SceCtrlData2));
-    }
+int read_data(EmuEnvState &emuenv, int port, SceCtrlData *&pad_data, int count, bool negative, bool from_ext_function) {
+    return get_data(emuenv, port, pad_data, count, negative, from_ext_function, true);
+}
 
-    return count;
+int read_data(EmuEnvState &emuenv, int port, SceCtrlData2 *&pad_data, int count, bool negative, bool from_ext_function) {
+    return get_data(emuenv, port, pad_data, count, negative, from_ext_function, true);
 }
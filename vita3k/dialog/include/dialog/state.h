@@ -63,7 +63,10 @@ struct SavedataState {
     uint32_t btn_val[2];
     uint32_t button_id = SCE_SAVEDATA_DIALOG_BUTTON_ID_INVALID;
 
+    // thumbnails of the slots, either the ux0 path of their file or the icon buffer given by the title,
+    // they are read and decoded by the GUI in the background once icon_loaded is set
     std::vector<vfs::FileBuffer> icon_buffer;
+    std::vector<std::string> icon_path;
     std::vector<bool> icon_loaded;
 
     uint32_t mode;
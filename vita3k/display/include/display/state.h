@@ -18,10 +18,13 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <kernel/callback.h>
+#include <map>
 #include <mem/ptr.h>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <thread>
 #include <vector>
 
@@ -37,6 +40,11 @@ typedef std::shared_ptr<ThreadState> ThreadStatePtr;
 struct DisplayStateVBlankWaitInfo {
     ThreadStatePtr target_thread;
     uint64_t target_vcount;
+
+    // the waiter with the lowest target is at the top of the heap
+    bool operator>(const DisplayStateVBlankWaitInfo &other) const {
+        return target_vcount > other.target_vcount;
+    }
 };
 
 struct DisplayFrameInfo {
@@ -57,7 +65,10 @@ struct DisplayState {
     std::atomic<bool> imgui_render{ true };
     std::atomic<bool> fullscreen{ false };
     std::atomic<std::uint64_t> vblank_count{ 0 };
-    std::vector<DisplayStateVBlankWaitInfo> vblank_wait_infos;
+    // set by the per-app config, for the frame rate patches
+    std::atomic<int> vblank_rate_multiplier{ 1 };
+    // locked by mutex, as the callbacks
+    std::priority_queue<DisplayStateVBlankWaitInfo, std::vector<DisplayStateVBlankWaitInfo>, std::greater<>> vblank_wait_infos;
     std::uint64_t last_setframe_vblank_count = 0;
     std::map<SceUID, CallbackPtr> vblank_callbacks{};
 };
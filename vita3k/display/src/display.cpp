@@ -17,23 +17,58 @@
 
 #include <display/functions.h>
 
+#include <config/state.h>
 #include <display/state.h>
 #include <emuenv/state.h>
 #include <kernel/state.h>
 #include <renderer/state.h>
 
-#include <chrono>
+#include <kernel/timer_wheel.h>
 #include <touch/functions.h>
 #include <util/find.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
 // Code heavily influenced by PPSSSPP's SceDisplay.cpp
 
-static constexpr int TARGET_FPS = 60;
-static constexpr int64_t TARGET_MICRO_PER_FRAME = 1000000LL / TARGET_FPS;
+static constexpr int64_t VBLANK_PERIOD_NS = 1'000'000'000LL / 60;
+// the refresh rate of the host is only followed when it is this close to the one of the Vita (59.94 Hz monitors)
+static constexpr int64_t HOST_PERIOD_TOLERANCE_NS = VBLANK_PERIOD_NS / 100;
+
+typedef std::chrono::steady_clock VblankClock;
+
+// Refresh period of the host estimated from the times the renderer displayed its frames,
+// a game running below 60 fps displays a frame every few host refreshes
+struct HostRefreshEstimate {
+    int64_t last_time_us = 0;
+    int64_t period_ns = VBLANK_PERIOD_NS;
+
+    void update(int64_t host_time_us) {
+        if (host_time_us == last_time_us)
+            return;
+
+        const int64_t interval_ns = (host_time_us - last_time_us) * 1000;
+        last_time_us = host_time_us;
+        const int64_t refreshes = (interval_ns + VBLANK_PERIOD_NS / 2) / VBLANK_PERIOD_NS;
+        if ((refreshes < 1) || (refreshes > 4))
+            return;
+
+        const int64_t sample_ns = interval_ns / refreshes;
+        if (std::abs(sample_ns - VBLANK_PERIOD_NS) <= HOST_PERIOD_TOLERANCE_NS)
+            period_ns += (sample_ns - period_ns) / 16;
+    }
+};
 
 static void vblank_sync_thread(EmuEnvState &emuenv) {
     DisplayState &display = emuenv.display;
+    HostRefreshEstimate host_refresh;
+    std::vector<ThreadStatePtr> woken_threads;
+    std::vector<CallbackPtr> callbacks;
 
+    // the deadlines are absolute so that the sleep overshoots don't add up
+    auto deadline = VblankClock::now();
     while (!display.abort.load()) {
         {
             const std::lock_guard<std::mutex> guard(display.mutex);
@@ -50,28 +85,60 @@ static void vblank_sync_thread(EmuEnvState &emuenv) {
                 }
             }
 
-            // maybe we should also use a mutex for this part, but it shouldn't be an issue
-            touch_vsync_update(emuenv);
-
-            // Notify Vblank callback in each VBLANK start
             for (auto &cb : display.vblank_callbacks)
-                cb.second->event_notify(cb.second->get_notifier_id());
-
-            for (std::size_t i = 0; i < display.vblank_wait_infos.size();) {
-                auto &vblank_wait_info = display.vblank_wait_infos[i];
-                if (vblank_wait_info.target_vcount <= display.vblank_count) {
-                    ThreadStatePtr target_wait = vblank_wait_info.target_thread;
+                callbacks.push_back(cb.second);
 
-                    target_wait->update_status(ThreadStatus::run);
-                    display.vblank_wait_infos.erase(display.vblank_wait_infos.begin() + i);
-                } else {
-                    i++;
-                }
+            while (!display.vblank_wait_infos.empty() && (display.vblank_wait_infos.top().target_vcount <= display.vblank_count)) {
+                woken_threads.push_back(display.vblank_wait_infos.top().target_thread);
+                display.vblank_wait_infos.pop();
             }
         }
-        const auto time_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        const auto time_left = TARGET_MICRO_PER_FRAME - (time_ms % TARGET_MICRO_PER_FRAME);
-        std::this_thread::sleep_for(std::chrono::microseconds(time_left));
+
+        // the threads and the callbacks are woken without the display locked, they can wait for the next vblank right away
+        touch_vsync_update(emuenv);
+        if (emuenv.kernel.debugger.watch_memory)
+            emuenv.kernel.debugger.rearm_watches(emuenv.mem);
+
+        // Notify Vblank callback in each VBLANK start
+        for (const CallbackPtr &cb : callbacks)
+            cb->event_notify(cb->get_notifier_id());
+        callbacks.clear();
+
+        for (const ThreadStatePtr &thread : woken_threads) {
+            const std::lock_guard<std::mutex> thread_lock(thread->mutex);
+            thread->update_status(ThreadStatus::run);
+        }
+        woken_threads.clear();
+
+        const int64_t host_time_us = emuenv.renderer ? emuenv.renderer->host_vblank_time_us.load() : 0;
+        int64_t period_ns = VBLANK_PERIOD_NS;
+        if (host_time_us && emuenv.cfg.vblank_host_refresh) {
+            host_refresh.update(host_time_us);
+            period_ns = host_refresh.period_ns;
+        }
+        // the host vblanks stay in phase with the faster guest ones
+        period_ns /= std::max(display.vblank_rate_multiplier.load(), 1);
+        deadline += std::chrono::nanoseconds(period_ns);
+
+        // start the next vblank in phase with the host display if the renderer knows when it displays the frames
+        if (host_time_us) {
+            const int64_t host_ns = host_time_us * 1000;
+            const int64_t deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+            const int64_t offset_ns = ((deadline_ns - host_ns) % period_ns + period_ns) % period_ns;
+            deadline += std::chrono::nanoseconds((offset_ns > period_ns / 2) ? period_ns - offset_ns : -offset_ns);
+        }
+
+        // the thread was held back (by a debugger for example), don't catch up with a burst of vblanks
+        const auto now = VblankClock::now();
+        if (deadline + std::chrono::nanoseconds(period_ns) < now)
+            deadline = now;
+
+        // sleep until close to the deadline and spin the rest of the way, to not depend on the timer resolution of the host
+        const auto spin_start = deadline - std::chrono::microseconds(TIMER_WHEEL_SPIN);
+        if (spin_start > now)
+            std::this_thread::sleep_until(spin_start);
+        while (VblankClock::now() < deadline)
+            std::this_thread::yield();
     }
 }
 
@@ -93,21 +160,25 @@ void wait_vblank(DisplayState &display, KernelState &kernel, const ThreadStatePt
             if (target_vcount <= display.vblank_count)
                 return;
 
+            wait_thread->wait_reason = ThreadWaitReason::vblank;
             wait_thread->update_status(ThreadStatus::wait);
-            display.vblank_wait_infos.push_back({ wait_thread, target_vcount });
+            display.vblank_wait_infos.push({ wait_thread, target_vcount });
         }
 
         wait_thread->status_cond.wait(thread_lock, [=]() { return wait_thread->status == ThreadStatus::run; });
     }
 
     if (is_cb) {
-        for (auto &callback : display.vblank_callbacks) {
-            CallbackPtr &cb = callback.second;
-            if (cb->get_owner_thread_id() == wait_thread->id) {
-                std::string name = cb->get_name();
-                cb->execute(kernel, [name]() {
-                });
+        std::vector<CallbackPtr> callbacks;
+        {
+            const std::lock_guard<std::mutex> guard(display.mutex);
+            for (auto &callback : display.vblank_callbacks) {
+                if (callback.second->get_owner_thread_id() == wait_thread->id)
+                    callbacks.push_back(callback.second);
             }
         }
+        for (const CallbackPtr &cb : callbacks)
+            cb->queue_execution(*wait_thread, nullptr);
+        wait_thread->run_queued_callbacks();
     }
 }
@@ -21,6 +21,7 @@
 #include <util/types.h>
 
 // forward declarations
+struct IOState;
 typedef uint32_t SceUInt32;
 
 typedef SceUInt32 SceAppUtilBootAttribute;
@@ -176,3 +177,5 @@ enum SceAppUtilErrorCode {
 
 std::string construct_savedata0_path(const std::string &data, const char *ext = "");
 std::string construct_slotparam_path(const unsigned int data);
+// read the slot param of a slot through the savedata file cache, return false if the slot doesn't exist
+bool read_slot_param(IOState &io, const unsigned int slot_id, SceAppUtilSaveDataSlotParam &param, const std::wstring &pref_path, const char *export_name);
@@ -127,6 +127,24 @@ public:
     float fps_values[20] = {};
     uint32_t current_fps_offset = 0;
     uint32_t ms_per_frame = 0;
+    uint64_t exclusive_store_failures = 0;
+    std::string exclusive_store_failures_thread;
+    // instructions run by the interpreter fallback of the JIT during the last second, and the time it took in microseconds
+    uint64_t interpreter_fallbacks = 0;
+    uint64_t interpreter_fallback_time_us = 0;
+    // part of the time of the guest threads spent in the JIT, in HLE functions and blocked during the last second, in percent
+    uint32_t guest_jit_percent = 0;
+    uint32_t guest_hle_percent = 0;
+    uint32_t guest_blocked_percent = 0;
+    // GPU time of the scenes and presentations done during the last second, on average in milliseconds, and part of that second
+    // the GPU was busy in percent, only measured with the maximum performance overlay details or the benchmark mode
+    float gpu_scene_ms = 0.f;
+    float gpu_present_ms = 0.f;
+    uint32_t gpu_busy_percent = 0;
+    uint64_t reported_gpu_time_ns = 0;
+    uint64_t reported_gpu_scene_count = 0;
+    uint64_t reported_gpu_present_time_ns = 0;
+    uint64_t reported_gpu_busy_ns = 0;
     WindowPtr window = WindowPtr(nullptr, nullptr);
     renderer::Backend backend_renderer{};
     RendererPtr renderer{};
@@ -28,6 +28,8 @@ struct FeatureState {
     bool support_rgb_attributes = true; ///< Do the GPU supports RGB (3 components) vertex attribute? If not (AMD GPU), some modifications must be applied to the renderer and the shader recompiler
     bool use_mask_bit = false; ///< Is the mask bit (1 per sample) emulated ? It is only used in homebrews afaik
     bool support_memory_mapping = false; ///< Is the host GPU memory directly mapped with gxm memory?
+    bool support_parallel_shader_compile = false; ///< Can the OpenGL driver compile the shaders and link the programs on its own threads?
+    bool optimize_spirv = false; ///< Run the SPIR-V optimizer on the generated shaders before caching them. The optimized shaders have their own cache version.
 
     bool is_programmable_blending_supported() const {
         return support_shader_interlock || support_texture_barrier || direct_fragcolor;
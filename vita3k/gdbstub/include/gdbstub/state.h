@@ -19,6 +19,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 #include <thread>
 
 #ifdef _WIN32
@@ -48,6 +49,10 @@ struct GDBState {
 
     std::string last_reply = "";
     int thread_info_index = 0;
+    // received data not parsed yet, a packet can be split between several receives
+    std::string receive_buffer;
+    // set by QStartNoAckMode, the packets are then not acknowledged anymore
+    bool no_ack_mode = false;
 
     SceUID inferior_thread = 0;
 
@@ -58,7 +58,9 @@
 
 // Credit to jfhs for their GDB stub for RPCS3 which this stub is based on.
 
-typedef char PacketData[1200];
+// size advertised in qSupported, the replies to the memory reads are limited to it
+constexpr size_t PACKET_SIZE = 0x4000;
+constexpr size_t RECEIVE_SIZE = 0x1000;
 
 struct PacketCommand {
     char *data{};
@@ -124,13 +126,12 @@ static PacketCommand parse_command(char *data, int64_t length) {
     command.data = data;
     command.length = length;
 
-    // TODO: Use std::find() to find packet begin and end.
     if (length > 1)
         command.begin_index = 1;
-    for (int64_t a = 0; a < length; a++) {
-        if (data[a] == '#')
-            command.end_index = a;
-    }
+    // '#' is escaped in the binary data, the first one ends the packet
+    const char *const end = std::find(data, data + length, '#');
+    if (end != data + length)
+        command.end_index = end - data;
 
     command.is_valid = command.begin_index != -1 && command.end_index != -1
         && command.end_index > command.begin_index && command.end_index + 2 < length;
@@ -150,14 +151,15 @@ static PacketCommand parse_command(char *data, int64_t length) {
     return command;
 }
 
-static int64_t server_reply(GDBState &state, const char *data, int64_t length) {
+// the ack of a command is sent along with its reply
+static int64_t server_reply(GDBState &state, const char *data, int64_t length, bool ack = false) {
     uint8_t checksum = make_checksum(data, length);
-    std::string packet_data = fmt::format("${}#{:0>2x}", std::string(data, length), checksum);
+    std::string packet_data = fmt::format("{}${}#{:0>2x}", ack ? "+" : "", std::string(data, length), checksum);
     return send(state.client_socket, &packet_data[0], packet_data.size(), 0);
 }
 
-static int64_t server_reply(GDBState &state, const char *text) {
-    return server_reply(state, text, strlen(text));
+static int64_t server_reply(GDBState &state, const std::string &reply, bool ack = false) {
+    return server_reply(state, reply.data(), reply.size(), ack);
 }
 
 static int64_t server_ack(GDBState &state, char ack = '+') {
@@ -165,8 +167,48 @@ static int64_t server_ack(GDBState &state, char ack = '+') {
 }
 
 static std::string cmd_supported(EmuEnvState &state, PacketCommand &command) {
-    return "multiprocess-;swbreak+;hwbreak-;qRelocInsn-;fork-events-;vfork-events-;"
-           "exec-events-;vContSupported+;QThreadEvents-;no-resumed-;xmlRegisters=arm";
+    return fmt::format("multiprocess-;swbreak+;hwbreak-;qRelocInsn-;fork-events-;vfork-events-;"
+                       "exec-events-;vContSupported+;QThreadEvents-;no-resumed-;xmlRegisters=arm;"
+                       "PacketSize={:x};QStartNoAckMode+;qXfer:threads:read+;binary-upload+",
+        PACKET_SIZE);
+}
+
+static std::string cmd_start_no_ack_mode(EmuEnvState &state, PacketCommand &command) {
+    // the reply to this command is still acknowledged
+    state.gdb.no_ack_mode = true;
+    return "OK";
+}
+
+// '#', '$', '}' and '*' are escaped in the binary data by '}' followed by the byte xor 0x20
+static bool must_escape(const char c) {
+    return (c == '#') || (c == '$') || (c == '}') || (c == '*');
+}
+
+static std::string escape_binary(const uint8_t *data, size_t length) {
+    std::string escaped;
+    escaped.reserve(length + length / 8);
+    for (size_t a = 0; a < length; a++) {
+        const char c = static_cast<char>(data[a]);
+        if (must_escape(c)) {
+            escaped += '}';
+            escaped += static_cast<char>(c ^ 0x20);
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::vector<uint8_t> unescape_binary(const char *data, size_t length) {
+    std::vector<uint8_t> unescaped;
+    unescaped.reserve(length);
+    for (size_t a = 0; a < length; a++) {
+        if ((data[a] == '}') && (a + 1 < length))
+            unescaped.push_back(static_cast<uint8_t>(data[++a] ^ 0x20));
+        else
+            unescaped.push_back(static_cast<uint8_t>(data[a]));
+    }
+    return unescaped;
 }
 
 static std::string cmd_reply_empty(EmuEnvState &state, PacketCommand &command) {
@@ -362,13 +404,34 @@ static std::string cmd_read_memory(EmuEnvState &state, PacketCommand &command) {
     if (!check_memory_region(address, length, state.mem))
         return "EAA";
 
-    std::stringstream stream;
-
-    for (uint32_t a = 0; a < length; a++) {
-        stream << fmt::format("{:0>2x}", static_cast<uint8_t>(state.mem.memory[address + a]));
+    // each byte takes two characters, the client reads the rest with another packet
+    const uint32_t read_length = std::min<uint32_t>(length, PACKET_SIZE / 2);
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string reply(read_length * 2, '0');
+    for (uint32_t a = 0; a < read_length; a++) {
+        const uint8_t byte = static_cast<uint8_t>(state.mem.memory[address + a]);
+        reply[a * 2] = digits[byte >> 4];
+        reply[a * 2 + 1] = digits[byte & 0xF];
     }
 
-    return stream.str();
+    return reply;
+}
+
+static std::string cmd_read_binary(EmuEnvState &state, PacketCommand &command) {
+    const std::string content = content_string(command);
+    const size_t pos = content.find(',');
+
+    const uint32_t address = parse_hex(content.substr(1, pos - 1));
+    const uint32_t length = parse_hex(content.substr(pos + 1));
+
+    if (length == 0)
+        return "b";
+    if (!check_memory_region(address, length, state.mem))
+        return "EAA";
+
+    // the escaped bytes take two characters
+    const uint32_t read_length = std::min<uint32_t>(length, PACKET_SIZE / 2);
+    return "b" + escape_binary(reinterpret_cast<const uint8_t *>(&state.mem.memory[address]), read_length);
 }
 
 static std::string cmd_write_memory(EmuEnvState &state, PacketCommand &command) {
@@ -392,8 +455,6 @@ static std::string cmd_write_memory(EmuEnvState &state, PacketCommand &command)
     return "OK";
 }
 
-// server_next() might not be able to tell the difference between the end of the packet ($) and 0x24 ($).
-// Thus, cmd_write_binary is disabled.
 static std::string cmd_write_binary(EmuEnvState &state, PacketCommand &command) {
     const std::string content = content_string(command);
     const size_t pos_first = content.find(',');
@@ -403,14 +464,14 @@ static std::string cmd_write_binary(EmuEnvState &state, PacketCommand &command)
     const std::string second = content.substr(pos_first + 1, pos_second - pos_first);
     const uint32_t address = parse_hex(first);
     const uint32_t length = parse_hex(second);
-    const char *data = command.content_start + pos_second + 1;
+    const std::vector<uint8_t> data = unescape_binary(command.content_start + pos_second + 1, command.content_length - pos_second - 1);
 
-    if (!check_memory_region(address, length, state.mem))
+    if (length == 0)
+        return "OK";
+    if ((data.size() < length) || !check_memory_region(address, length, state.mem))
         return "EAA";
 
-    for (uint32_t a = 0; a < length; a++) {
-        state.mem.memory[address + a] = data[a];
-    }
+    memcpy(&state.mem.memory[address], data.data(), length);
 
     return "OK";
 }
@@ -438,7 +499,13 @@ static std::string cmd_continue(EmuEnvState &state, PacketCommand &command) {
             bool step = cmd == 's' || cmd == 'S';
 
             // inferior_thread is the thread that trigerred breakpoint before
-            // step or run that thread
+            // step or run that thread, unless the action names another one
+            if (colon != std::string::npos) {
+                const SceUID thread_id = parse_hex(text.substr(colon + 1));
+                const auto guard = std::lock_guard(state.kernel.mutex);
+                if (state.kernel.threads.find(thread_id) != state.kernel.threads.end())
+                    state.gdb.inferior_thread = thread_id;
+            }
 
             if (state.gdb.inferior_thread != 0) {
                 const auto guard = std::lock_guard(state.kernel.mutex);
@@ -581,6 +648,47 @@ static std::string cmd_get_next_thread(EmuEnvState &state, PacketCommand &comman
     return stream.str();
 }
 
+static std::string escape_xml(const std::string &text) {
+    std::string escaped;
+    for (const char c : text) {
+        switch (c) {
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '&': escaped += "&amp;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+// the whole thread list in one transfer, instead of a qsThreadInfo round trip per thread
+static std::string cmd_read_threads(EmuEnvState &state, PacketCommand &command) {
+    const std::string content = content_string(command);
+    const size_t pos = content.rfind(':');
+    const size_t comma = content.find(',', pos);
+    if ((pos == std::string::npos) || (comma == std::string::npos))
+        return "E00";
+
+    const uint32_t offset = parse_hex(content.substr(pos + 1, comma - pos - 1));
+    const uint32_t length = std::min<uint32_t>(parse_hex(content.substr(comma + 1)), PACKET_SIZE - 1);
+
+    std::string xml = "<?xml version=\"1.0\"?>\n<threads>\n";
+    {
+        const auto guard = std::lock_guard(state.kernel.mutex);
+        for (const auto &[id, thread] : state.kernel.threads)
+            xml += fmt::format("<thread id=\"{}\" name=\"{}\"></thread>\n", to_hex(id), escape_xml(thread->name));
+    }
+    xml += "</threads>\n";
+
+    if (offset >= xml.size())
+        return "l";
+
+    const std::string chunk = xml.substr(offset, length);
+    const char last = (offset + chunk.size() >= xml.size()) ? 'l' : 'm';
+    return last + escape_binary(reinterpret_cast<const uint8_t *>(chunk.data()), chunk.size());
+}
+
 static std::string cmd_add_breakpoint(EmuEnvState &state, PacketCommand &command) {
     const std::string content = content_string(command);
 
@@ -646,7 +754,8 @@ const static PacketFunctionBundle functions[] = {
     { "G", cmd_write_registers },
     { "m", cmd_read_memory },
     { "M", cmd_write_memory },
-    { "X", cmd_unimplemented }, // change cmd_unimplemented to cmd_write_binary to enable binary downloading
+    { "x", cmd_read_binary },
+    { "X", cmd_write_binary },
 
     // Query Packets
     { "qfThreadInfo", cmd_get_first_thread },
@@ -655,7 +764,9 @@ const static PacketFunctionBundle functions[] = {
     { "qAttached", cmd_attached },
     { "qTStatus", cmd_thread_status },
     { "qC", cmd_get_current_thread },
+    { "qXfer:threads:read::", cmd_read_threads },
     { "q", cmd_unimplemented },
+    { "QStartNoAckMode", cmd_start_no_ack_mode },
     { "Q", cmd_unimplemented },
 
     // Shutdown
@@ -697,14 +808,30 @@ constexpr bool cmp_less(T t, U u) noexcept {
 }
 
 static bool command_begins_with(PacketCommand &command, const std::string &small_str) {
-    if (!cmp_less(small_str.size(), command.content_length))
+    if (cmp_less(command.content_length, small_str.size()))
         return false;
 
     return std::memcmp(command.content_start, small_str.c_str(), small_str.size()) == 0;
 }
 
+static void server_process(EmuEnvState &state, PacketCommand &command) {
+    for (const auto &function : functions) {
+        if (command_begins_with(command, function.name)) {
+            LOG_GDB("GDB Server Recognized Command as {}. {}", function.name,
+                std::string(command.content_start, command.content_length));
+            const bool ack = !state.gdb.no_ack_mode;
+            state.gdb.last_reply = function.function(state, command);
+            if (state.gdb.server_die)
+                return;
+            server_reply(state.gdb, state.gdb.last_reply, ack);
+            return;
+        }
+    }
+    LOG_GDB("GDB Server Unrecognized Command. {}", std::string(command.content_start, command.content_length));
+}
+
 static int64_t server_next(EmuEnvState &state) {
-    PacketData buffer;
+    char buffer[RECEIVE_SIZE];
 
     // Wait for the server to close or a packet to be received.
     fd_set readSet;
@@ -721,50 +848,53 @@ static int64_t server_next(EmuEnvState &state) {
         LOG_GDB("GDB Server Connection Closed");
         return -1;
     }
-    buffer[length] = '\0';
 
-    for (int64_t a = 0; a < length; a++) {
-        switch (buffer[a]) {
+    // a packet can be split between several receives, or several packets sent in one
+    std::string &received = state.gdb.receive_buffer;
+    received.append(buffer, length);
+
+    size_t a = 0;
+    while (a < received.size() && !state.gdb.server_die) {
+        switch (received[a]) {
         case '+': {
+            a++;
             break; // Cool.
         }
         case '-': {
-            LOG_GDB("GDB Server Transmission Error. {}", std::string(buffer, length));
-            server_reply(state.gdb, state.gdb.last_reply.c_str());
+            a++;
+            if (state.gdb.no_ack_mode)
+                break;
+            LOG_GDB("GDB Server Transmission Error. {}", received);
+            server_reply(state.gdb, state.gdb.last_reply);
             break;
         }
         case '$': {
-            server_ack(state.gdb, '+');
+            // wait for the rest of the packet and its checksum
+            const size_t end = received.find('#', a);
+            if (end == std::string::npos || end + 2 >= received.size()) {
+                received.erase(0, a);
+                return length;
+            }
 
-            PacketCommand command = parse_command(buffer + a, length - a);
+            const size_t packet_length = end + 3 - a;
+            PacketCommand command = parse_command(&received[a], packet_length);
             if (command.is_valid) {
-                for (const auto &function : functions) {
-                    if (command_begins_with(command, function.name)) {
-                        LOG_GDB("GDB Server Recognized Command as {}. {}", function.name,
-                            std::string(command.content_start, command.content_length));
-                        state.gdb.last_reply = function.function(state, command);
-                        if (state.gdb.server_die)
-                            break;
-                        server_reply(state.gdb, state.gdb.last_reply.c_str());
-                        break;
-                    }
-                }
-                LOG_GDB("GDB Server Unrecognized Command. {}", std::string(command.content_start, command.content_length));
-
-                a += command.content_length + 3;
-
-            } else {
+                server_process(state, command);
+            } else if (!state.gdb.no_ack_mode) {
                 server_ack(state.gdb, '-');
 
-                LOG_GDB("GDB Server Invalid Command. {}", std::string(buffer, length));
+                LOG_GDB("GDB Server Invalid Command. {}", received.substr(a, packet_length));
             }
+            a += packet_length;
             break;
         }
-        default: break;
-        }
-        if (state.gdb.server_die)
+        default: {
+            a++;
             break;
+        }
+        }
     }
+    received.erase(0, a);
 
     return length;
 }
@@ -779,6 +909,9 @@ static void server_listen(EmuEnvState &state) {
 
     LOG_INFO("GDB Server Received Connection");
 
+    state.gdb.receive_buffer.clear();
+    state.gdb.no_ack_mode = false;
+
     int64_t status;
 
     do {
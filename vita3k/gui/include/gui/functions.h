@@ -36,6 +36,8 @@ enum GenericDialogState {
     CANCEL_STATE
 };
 
+// releases the textures and the parsed templates of all the live areas, they are parsed again when opened
+void clear_live_areas(GuiState &gui);
 void delete_app(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 size_t get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
@@ -45,7 +47,9 @@ std::vector<std::string>::iterator get_app_open_list_index(GuiState &gui, const
 std::map<DateTime, std::string> get_date_time(GuiState &gui, EmuEnvState &emuenv, const tm &date_time);
 std::string get_unit_size(const size_t &size);
 void get_app_param(GuiState &gui, EmuEnvState &emuenv, const std::string app_path);
+bool get_content_size(GuiState &gui, EmuEnvState &emuenv, const std::string &content_path, uint64_t &size);
 std::string get_cpu_backend(GuiState &gui, EmuEnvState &emuenv, const std::string app_path);
+bool has_custom_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path);
 void get_modules_list(GuiState &gui, EmuEnvState &emuenv);
 void get_notice_list(EmuEnvState &emuenv);
 std::string get_theme_title_from_buffer(const vfs::FileBuffer buffer);
@@ -76,6 +80,7 @@ void init_user_app(GuiState &gui, EmuEnvState &emuenv, const std::string app_pat
 void init_user_apps(GuiState &gui, EmuEnvState &emuenv);
 bool init_user_background(GuiState &gui, EmuEnvState &emuenv, const std::string &user_id, const std::string &background_path);
 bool init_user_start_background(GuiState &gui, const std::string &image_path);
+void invalidate_content_size(GuiState &gui, const std::string &content_path);
 void open_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_path);
 void open_manual(GuiState &gui, EmuEnvState &emuenv, const std::string app_path);
 void open_path(const std::string &path);
@@ -35,17 +35,23 @@
 #include <gui/imgui_impl_sdl_state.h>
 
 #include <glutil/object.h>
+#include <threads/job_pool.h>
+#include <util/fs.h>
 
 #include <atomic>
+#include <deque>
+#include <list>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <set>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
 struct GuiState;
 struct EmuEnvState;
+class MappedFile;
 
 namespace gui {
 
@@ -94,23 +100,154 @@ struct IconData {
     IconData();
 };
 
+// icon0.png file an icon was decoded from, the cached icon is used as long as it's unchanged
+struct IconCacheKey {
+    uint64_t size = 0;
+    int64_t time = 0;
+
+    bool operator==(const IconCacheKey &other) const = default;
+};
+
+struct IconCacheEntry {
+    IconCacheKey key;
+    uint64_t offset = 0;
+};
+
 struct IconAsyncLoader {
     std::mutex mutex;
 
     std::unordered_map<std::string, IconData> icon_data;
 
-    std::thread thread;
+    // paths whose icon is still to load, the ones drawn by the home screen are moved in front
+    std::deque<std::string> pending;
+    std::unique_ptr<JobPool> pool;
+    uint32_t active_workers = 0;
     std::atomic_bool quit = false;
 
+    // decoded icons of the previous sessions, stored uncompressed in ux0/temp/icons.dat
+    fs::path cache_path;
+    std::shared_ptr<const MappedFile> cache_file;
+    std::unordered_map<std::string, IconCacheEntry> cache_index;
+    // icons of this session for the next cache, either still in the mapped one or decoded now
+    std::unordered_map<std::string, IconCacheEntry> cache_hits;
+    std::unordered_map<std::string, std::pair<IconCacheKey, std::vector<uint8_t>>> cache_decoded;
+    bool cache_written = false;
+
     void commit(GuiState &gui);
+    // load the icon of the path before the other ones, called when it's visible
+    void request(const std::string &path);
 
     IconAsyncLoader(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list);
     ~IconAsyncLoader();
 };
 
+// size of a content directory, computed again once the last write time of the directory changes
+struct ContentSize {
+    uint64_t size = 0;
+    int64_t time = 0;
+};
+
+// sizes of the contents, computed in the background and keyed by their path in ux0.
+// The ones of the apps and their additional contents are kept in the apps cache
+struct ContentSizes {
+    std::mutex mutex;
+    std::unordered_map<std::string, ContentSize> sizes;
+    std::set<std::string> pending;
+    // incremented each time a size is computed, the content manager updates its totals when it changes
+    std::atomic<uint32_t> generation = 0;
+    std::atomic_bool quit = false;
+    std::unique_ptr<JobPool> pool;
+
+    ~ContentSizes();
+};
+
+// trophy icon decoded in the background, waiting for its texture
+struct TrophyIcon {
+    // np com id and group id of an icon of the trophy collection, or an empty np com id and the id of a trophy of the trophy list
+    std::string np_com_id;
+    std::string id;
+    // generation of the list it was decoded for, the icons of a list opened again in the meantime are dropped
+    uint32_t generation = 0;
+    IconData data;
+};
+
+// decodes the icons of the trophy collection when it opens and of the trophy list of a group when it is selected,
+// the textures of the decoded ones are created by draw_begin
+struct TrophyIconLoader {
+    std::mutex mutex;
+    std::vector<TrophyIcon> decoded;
+    std::atomic<uint32_t> collection_generation = 0;
+    std::atomic<uint32_t> trophy_list_generation = 0;
+    std::atomic_bool quit = false;
+    std::unique_ptr<JobPool> pool;
+
+    void commit(GuiState &gui);
+    ~TrophyIconLoader();
+};
+
+struct SaveDataThumbnail {
+    uint32_t index = 0;
+    // request it was decoded for, the thumbnails of a slot whose icon changed again in the meantime are dropped
+    uint32_t request = 0;
+    IconData data;
+};
+
+// reads and decodes the thumbnails of the savedata dialog slots once they are drawn, the textures of the decoded ones
+// are created by draw_begin
+struct SaveDataThumbnailLoader {
+    std::mutex mutex;
+    std::vector<SaveDataThumbnail> decoded;
+    // textures and last request of the slots by index, only used by the GUI thread
+    std::vector<ImGui_Texture> textures;
+    std::vector<uint32_t> requests;
+    uint32_t next_request = 0;
+    std::atomic_bool quit = false;
+    std::unique_ptr<JobPool> pool;
+
+    void commit(GuiState &gui);
+    ~SaveDataThumbnailLoader();
+};
+
+struct LiveAreaImage {
+    std::string app_path;
+    // name of the contents, or id of the frame of the live item
+    std::string id;
+    // background or image for a live item, empty for the contents
+    std::string item_type;
+    size_t pos = 0;
+    // the images decoded for textures released in the meantime are dropped
+    uint32_t generation = 0;
+    IconData data;
+};
+
+// reads and decodes the images of a live area once it is opened, the textures of the decoded ones are created by
+// draw_begin. The textures are kept for the titles opened last and released for the others
+struct LiveAreaImageLoader {
+    std::mutex mutex;
+    std::vector<LiveAreaImage> decoded;
+    // generation of the textures of the titles, and the titles by last opened, only used by the GUI thread
+    std::map<std::string, uint32_t> generations;
+    std::list<std::string> recent;
+    uint32_t next_generation = 0;
+    std::atomic_bool quit = false;
+    std::unique_ptr<JobPool> pool;
+
+    void commit(GuiState &gui);
+    ~LiveAreaImageLoader();
+};
+
+// trophy shown by the unlock notification, its icon is decoded by the thread which unlocked it
+struct TrophyUnlockRequest {
+    NpTrophyUnlockCallbackData data;
+    IconData icon;
+};
+
 struct AppsSelector {
     std::vector<App> sys_apps;
     std::vector<App> user_apps;
+    // position of the user apps by path, used by get_app_index
+    std::mutex user_apps_index_mutex;
+    std::unordered_map<std::string, size_t> user_apps_index;
     uint32_t apps_cache_lang;
     AppInfo app_info;
     std::optional<IconAsyncLoader> icon_async_loader;
@@ -118,6 +255,7 @@ struct AppsSelector {
     std::map<std::string, ImGui_Texture> user_apps_icon;
     bool is_app_list_sorted{ false };
     std::map<SortType, SortState> app_list_sorted;
+    ContentSizes content_sizes;
 };
 
 struct VitaAreaState {
@@ -153,6 +291,7 @@ struct DebugMenuState {
     bool allocations_dialog = false;
     bool memory_editor_dialog = false;
     bool disassembly_dialog = false;
+    bool import_stats_dialog = false;
 };
 
 struct ConfigurationMenuState {
@@ -231,7 +370,8 @@ enum ThemePreviewType {
 
 enum ShadersCompiledDisplay {
     Time,
-    Count
+    Count,
+    Pending
 };
 
 static constexpr auto MODULES_MODE_COUNT = 3;
@@ -341,6 +481,9 @@ struct GuiState {
 
     std::map<std::string, std::map<std::string, ImGui_Texture>> trophy_np_com_id_list_icons;
     std::map<std::string, ImGui_Texture> trophy_list;
+    TrophyIconLoader trophy_icon_loader;
+    SaveDataThumbnailLoader savedata_thumbnail_loader;
+    LiveAreaImageLoader live_area_image_loader;
 
     ImGui_Texture start_background;
 
@@ -361,7 +504,7 @@ struct GuiState {
     TrophyAnimationStage trophy_window_frame_stage{ TrophyAnimationStage::SLIDE_IN };
     ImTextureID trophy_window_icon{};
 
-    std::vector<NpTrophyUnlockCallbackData> trophy_unlock_display_requests;
+    std::vector<TrophyUnlockRequest> trophy_unlock_display_requests;
     std::mutex trophy_unlock_display_requests_access_mutex;
 
     ImVec2 trophy_window_pos;
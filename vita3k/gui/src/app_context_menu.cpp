@@ -252,6 +252,8 @@ void delete_app(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
 
         LOG_INFO("Application successfully deleted '{} [{}]'.", title_id, APP_INDEX->title);
 
+        invalidate_content_size(gui, "ux0/app/" + app_path);
+        invalidate_content_size(gui, "ux0/addcont/" + title_id);
         gui.app_selector.user_apps.erase(APP_INDEX);
 
         save_apps_cache(gui, emuenv);
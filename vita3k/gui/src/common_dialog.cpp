@@ -21,9 +21,11 @@
 
 #include <config/state.h>
 #include <gui/imgui_impl_sdl.h>
+#include <util/log.h>
 #include <util/string_utils.h>
 
 #include <SDL.h>
+#include <stb_image.h>
 
 namespace gui {
 static void draw_ime_dialog(DialogState &common_dialog, float FONT_SCALE) {
@@ -158,6 +160,70 @@ static std::string get_save_date_time(SceSystemParamDateFormat date_fromat, cons
     return date_str + fmt::format(" {}:{:0>2d}", date_time.hour, date_time.minute);
 }
 
+static constexpr uint32_t SAVEDATA_THUMBNAIL_WORKERS = 2;
+
+SaveDataThumbnailLoader::~SaveDataThumbnailLoader() {
+    quit = true;
+    pool.reset();
+}
+
+void SaveDataThumbnailLoader::commit(GuiState &gui) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (SaveDataThumbnail &thumbnail : decoded) {
+        if (requests[thumbnail.index] == thumbnail.request)
+            textures[thumbnail.index].init(gui.imgui_state.get(), thumbnail.data.data.get(), thumbnail.data.width, thumbnail.data.height);
+    }
+    decoded.clear();
+}
+
+// Reads and decodes in the background the thumbnail of a slot whose icon changed, its texture is removed until then,
+// or for good if the slot has no icon
+static void request_savedata_thumbnail(GuiState &gui, EmuEnvState &emuenv, const uint32_t index) {
+    SaveDataThumbnailLoader &loader = gui.savedata_thumbnail_loader;
+    if (loader.textures.size() <= index) {
+        loader.textures.resize(index + 1);
+        loader.requests.resize(index + 1, 0);
+    }
+    const uint32_t request = ++loader.next_request;
+    loader.requests[index] = request;
+    loader.textures[index] = ImGui_Texture();
+
+    const SavedataState &savedata = emuenv.common_dialog.savedata;
+    if (savedata.icon_path[index].empty() && savedata.icon_buffer[index].empty())
+        return;
+
+    if (!loader.pool)
+        loader.pool = std::make_unique<JobPool>(SAVEDATA_THUMBNAIL_WORKERS);
+    loader.pool->submit([&loader, &pref_path = emuenv.pref_path, icon_path = savedata.icon_path[index], buffer = savedata.icon_buffer[index], index, request]() mutable {
+        if (loader.quit)
+            return;
+
+        if (!icon_path.empty())
+            vfs::read_file(VitaIoDevice::ux0, buffer, pref_path, icon_path);
+        if (buffer.empty()) {
+            LOG_WARN("Savedata thumbnail: '{}', Not found.", icon_path);
+            return;
+        }
+
+        SaveDataThumbnail thumbnail;
+        thumbnail.index = index;
+        thumbnail.request = request;
+        thumbnail.data.data.reset(stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &thumbnail.data.width, &thumbnail.data.height, nullptr, STBI_rgb_alpha));
+        if (!thumbnail.data.data) {
+            LOG_ERROR("Invalid savedata thumbnail: '{}'.", icon_path);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.decoded.push_back(std::move(thumbnail));
+    });
+}
+
+static ImTextureID get_savedata_thumbnail(GuiState &gui, const uint32_t index) {
+    const SaveDataThumbnailLoader &loader = gui.savedata_thumbnail_loader;
+    return index < loader.textures.size() ? static_cast<ImTextureID>(loader.textures[index]) : nullptr;
+}
+
 static void draw_save_info(GuiState &gui, EmuEnvState &emuenv, float FONT_SCALE, ImVec2 SCALE, int loop_index, const ImTextureID &texture) {
     const ImVec2 THUMBNAIL_SIZE = ImVec2(160.f * SCALE.x, 90.f * SCALE.y);
     const auto display_size = ImGui::GetIO().DisplaySize;
@@ -179,7 +245,7 @@ static void draw_save_info(GuiState &gui, EmuEnvState &emuenv, float FONT_SCALE,
     ImGui::SetCursorPosX(WINDOW_SIZE.x / 2 - ImGui::CalcTextSize(emuenv.common_dialog.savedata.list_title.c_str()).x / 2);
     ImGui::Text("%s", emuenv.common_dialog.savedata.list_title.c_str());
 
-    if (!emuenv.common_dialog.savedata.icon_buffer[loop_index].empty()) {
+    if (texture) {
         ImGui::SetCursorPos(ImVec2(50 * SCALE.x, THUMBNAIL_SIZE.y / 2 + 20 * SCALE.y));
         ImGui::Image(texture, THUMBNAIL_SIZE);
     }
@@ -210,7 +276,7 @@ static void draw_save_info(GuiState &gui, EmuEnvState &emuenv, float FONT_SCALE,
     ImGui::End();
 }
 
-static void draw_savedata_dialog_list(GuiState &gui, EmuEnvState &emuenv, float FONT_SCALE, ImVec2 SCALE, ImVec2 WINDOW_SIZE, ImVec2 THUMBNAIL_SIZE, int loop_index, int save_index, std::vector<ImTextureID> &thumbnails_textures) {
+static void draw_savedata_dialog_list(GuiState &gui, EmuEnvState &emuenv, float FONT_SCALE, ImVec2 SCALE, ImVec2 WINDOW_SIZE, ImVec2 THUMBNAIL_SIZE, int loop_index, int save_index) {
     char selectable_buffer[32];
     char info_button_buffer[32];
     sprintf(selectable_buffer, "###New Saved Data %d", loop_index);
@@ -261,13 +327,12 @@ static void draw_savedata_dialog_list(GuiState &gui, EmuEnvState &emuenv, float
     ImGui::SetWindowFontScale(1.2f * FONT_SCALE);
     ImGui::SameLine();
     if (emuenv.common_dialog.savedata.icon_loaded[loop_index]) {
-        thumbnails_textures[loop_index] = load_image(gui, (const char *)emuenv.common_dialog.savedata.icon_buffer[loop_index].data(),
-            static_cast<int>(emuenv.common_dialog.savedata.icon_buffer[loop_index].size()));
+        request_savedata_thumbnail(gui, emuenv, loop_index);
         emuenv.common_dialog.savedata.icon_loaded[loop_index] = false;
     }
-    if (!emuenv.common_dialog.savedata.icon_buffer[loop_index].empty()) {
+    if (const ImTextureID thumbnail = get_savedata_thumbnail(gui, loop_index)) {
         ImGui::SetCursorPos(ImVec2(10 * SCALE.x, save_index * THUMBNAIL_SIZE.y));
-        ImGui::Image(thumbnails_textures[loop_index], THUMBNAIL_SIZE);
+        ImGui::Image(thumbnail, THUMBNAIL_SIZE);
     }
     ImGui::SameLine();
     if (emuenv.common_dialog.savedata.slot_info[loop_index].isExist == 1) {
@@ -289,7 +354,6 @@ static void draw_savedata_dialog(GuiState &gui, EmuEnvState &emuenv, float FONT_
     const ImVec2 WINDOW_SIZE = ImVec2(ImGui::GetIO().DisplaySize.x / 1.7f, ImGui::GetIO().DisplaySize.y / 1.5f);
 
     int existing_saves_count = 0;
-    static std::vector<ImTextureID> thumbnails_textures{ nullptr };
 
     switch (emuenv.common_dialog.savedata.mode_to_display) {
     case SCE_SAVEDATA_DIALOG_MODE_LIST:
@@ -309,23 +373,22 @@ static void draw_savedata_dialog(GuiState &gui, EmuEnvState &emuenv, float FONT_
         ImGui::SetWindowFontScale(0.9f);
         ImGui::SetNextWindowBgAlpha(0.f);
         ImGui::BeginChild("##Selectables", ImVec2(0, 0), false, ImGuiWindowFlags_NoDecoration);
-        thumbnails_textures.resize(emuenv.common_dialog.savedata.slot_list_size);
         for (std::uint32_t i = 0; i < emuenv.common_dialog.savedata.slot_list_size; i++) {
             switch (emuenv.common_dialog.savedata.display_type) {
             case SCE_SAVEDATA_DIALOG_TYPE_SAVE:
-                draw_savedata_dialog_list(gui, emuenv, FONT_SCALE, SCALE, WINDOW_SIZE, THUMBNAIL_SIZE, i, i, thumbnails_textures);
+                draw_savedata_dialog_list(gui, emuenv, FONT_SCALE, SCALE, WINDOW_SIZE, THUMBNAIL_SIZE, i, i);
                 break;
             case SCE_SAVEDATA_DIALOG_TYPE_LOAD:
             case SCE_SAVEDATA_DIALOG_TYPE_DELETE:
                 if (emuenv.common_dialog.savedata.slot_info[i].isExist == 1) {
-                    draw_savedata_dialog_list(gui, emuenv, FONT_SCALE, SCALE, WINDOW_SIZE, THUMBNAIL_SIZE, i, existing_saves_count, thumbnails_textures);
+                    draw_savedata_dialog_list(gui, emuenv, FONT_SCALE, SCALE, WINDOW_SIZE, THUMBNAIL_SIZE, i, existing_saves_count);
                     existing_saves_count++;
                 }
                 break;
             }
         }
         if (emuenv.common_dialog.savedata.draw_info_window) {
-            draw_save_info(gui, emuenv, FONT_SCALE, SCALE, emuenv.common_dialog.savedata.selected_save, thumbnails_textures[emuenv.common_dialog.savedata.selected_save]);
+            draw_save_info(gui, emuenv, FONT_SCALE, SCALE, emuenv.common_dialog.savedata.selected_save, get_savedata_thumbnail(gui, emuenv.common_dialog.savedata.selected_save));
             return;
         }
         if (emuenv.common_dialog.savedata.display_type != SCE_SAVEDATA_DIALOG_TYPE_SAVE) {
@@ -348,16 +411,14 @@ static void draw_savedata_dialog(GuiState &gui, EmuEnvState &emuenv, float FONT_
         ImGui::Begin("##Savedata Dialog", nullptr, ImGuiWindowFlags_NoDecoration);
         ImGui::SetWindowFontScale(1.2f * FONT_SCALE);
 
-        static ImTextureID THUMBNAIL_TEXTURE = nullptr;
         if (emuenv.common_dialog.savedata.icon_loaded[0]) {
-            THUMBNAIL_TEXTURE = load_image(gui, (const char *)emuenv.common_dialog.savedata.icon_buffer[emuenv.common_dialog.savedata.selected_save].data(),
-                static_cast<int>(emuenv.common_dialog.savedata.icon_buffer[emuenv.common_dialog.savedata.selected_save].size()));
+            request_savedata_thumbnail(gui, emuenv, emuenv.common_dialog.savedata.selected_save);
             emuenv.common_dialog.savedata.icon_loaded[0] = false;
         }
 
-        if (!emuenv.common_dialog.savedata.icon_buffer[emuenv.common_dialog.savedata.selected_save].empty()) {
+        if (const ImTextureID thumbnail = get_savedata_thumbnail(gui, emuenv.common_dialog.savedata.selected_save)) {
             ImGui::SetCursorPos(ImVec2(36 * SCALE.x, 25 * SCALE.y));
-            ImGui::Image(THUMBNAIL_TEXTURE, THUMBNAIL_SIZE);
+            ImGui::Image(thumbnail, THUMBNAIL_SIZE);
         }
         ImGui::SameLine();
         ImGui::BeginGroup();
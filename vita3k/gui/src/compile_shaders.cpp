@@ -83,13 +83,26 @@ void set_shaders_compiled_display(GuiState &gui, EmuEnvState &emuenv) {
         if ((gui.shaders_compiled_display[Time] + 3) <= time)
             gui.shaders_compiled_display.clear();
     }
+
+    // Display the pipelines compiled in the background until they are all done
+    if (emuenv.renderer->pipelines_count_pending) {
+        gui.shaders_compiled_display[Pending] = emuenv.renderer->pipelines_count_pending;
+        gui.shaders_compiled_display[Time] = time;
+    } else {
+        gui.shaders_compiled_display.erase(Pending);
+        if (!gui.shaders_compiled_display.contains(Count))
+            gui.shaders_compiled_display.clear();
+    }
 }
 
 void draw_shaders_count_compiled(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::SetNextWindowPos(ImVec2(emuenv.viewport_pos.x + (2.f * emuenv.dpi_scale), emuenv.viewport_pos.y + emuenv.viewport_size.y - (42.f * emuenv.dpi_scale)));
     ImGui::SetNextWindowBgAlpha(0.6f);
     ImGui::Begin("##shaders_compiled", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_AlwaysAutoResize);
-    ImGui::Text("%lu %s", gui.shaders_compiled_display[Count], gui.lang.compile_shaders["shaders_compiled"].c_str());
+    if (gui.shaders_compiled_display.contains(Count))
+        ImGui::Text("%lu %s", gui.shaders_compiled_display[Count], gui.lang.compile_shaders["shaders_compiled"].c_str());
+    if (gui.shaders_compiled_display.contains(Pending))
+        ImGui::Text("%lu %s", gui.shaders_compiled_display[Pending], gui.lang.compile_shaders["pipelines_compiling"].c_str());
     ImGui::End();
 }
 
@@ -25,16 +25,13 @@ void draw_condvars_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Condition Variables", &gui.debug_menu.condvars_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s %-16s", "ID", "Name", "Attributes", "Waiting Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-
-    for (const auto &condvar : emuenv.kernel.condvars) {
-        std::shared_ptr<Condvar> sema_state = condvar.second;
+    emuenv.kernel.condvars.for_each([&](SceUID uid, const std::shared_ptr<Condvar> &sema_state) {
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d             %02zu",
-            condvar.first,
+            uid,
             sema_state->name,
             sema_state->attr,
             sema_state->waiting_threads->size());
-    }
+    });
     ImGui::End();
 }
 
@@ -42,16 +39,13 @@ void draw_lw_condvars_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Lightweight Condition Variables", &gui.debug_menu.lwcondvars_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s %-16s", "ID", "Name", "Attributes", "Waiting Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-
-    for (const auto &condvar : emuenv.kernel.lwcondvars) {
-        std::shared_ptr<Condvar> sema_state = condvar.second;
+    emuenv.kernel.lwcondvars.for_each([&](SceUID uid, const std::shared_ptr<Condvar> &sema_state) {
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d             %02zu",
-            condvar.first,
+            uid,
             sema_state->name,
             sema_state->attr,
             sema_state->waiting_threads->size());
-    }
+    });
     ImGui::End();
 }
 
@@ -31,6 +31,8 @@
 
 #include <util/safe_time.h>
 
+#include <chrono>
+
 namespace gui {
 namespace {
 template <typename T>
@@ -43,8 +45,93 @@ auto get_recursive_directory_size(const T &path) {
     };
     return boost::accumulate(path_list, boost::uintmax_t{}, pred);
 }
+
+// the sizes are computed by the workers, the errors of a directory iterated while it changes are ignored
+uint64_t compute_directory_size(const fs::path &path) {
+    uint64_t size = 0;
+    boost::system::error_code error;
+    for (fs::recursive_directory_iterator it(path, error), end; !error && (it != end); it.increment(error)) {
+        boost::system::error_code file_error;
+        if (fs::is_regular_file(it->status(file_error)))
+            size += fs::file_size(it->path(), file_error);
+    }
+    return size;
+}
+
+// -1 if the directory doesn't exist
+int64_t get_directory_time(const fs::path &path) {
+    boost::system::error_code error;
+    if (!fs::is_directory(path, error))
+        return -1;
+    const auto time = fs::last_write_time(path, error);
+    return error ? -1 : static_cast<int64_t>(time);
+}
+
+constexpr uint32_t CONTENT_SIZE_WORKERS = 2;
 } // namespace
 
+ContentSizes::~ContentSizes() {
+    quit = true;
+    pool.reset();
+}
+
+bool get_content_size(GuiState &gui, EmuEnvState &emuenv, const std::string &content_path, uint64_t &size) {
+    ContentSizes &sizes = gui.app_selector.content_sizes;
+    const auto path{ fs::path(emuenv.pref_path) / content_path };
+    const int64_t time = get_directory_time(path);
+    if (time < 0) {
+        size = 0;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(sizes.mutex);
+    const auto cached = sizes.sizes.find(content_path);
+    if ((cached != sizes.sizes.end()) && (cached->second.time == time)) {
+        size = cached->second.size;
+        return true;
+    }
+
+    if (sizes.pending.insert(content_path).second) {
+        if (!sizes.pool)
+            sizes.pool = std::make_unique<JobPool>(CONTENT_SIZE_WORKERS);
+        sizes.pool->submit([&sizes, content_path, path, time]() {
+            if (sizes.quit)
+                return;
+
+            const uint64_t size = compute_directory_size(path);
+
+            std::lock_guard<std::mutex> lock(sizes.mutex);
+            sizes.sizes[content_path] = { size, time };
+            sizes.pending.erase(content_path);
+            sizes.generation++;
+        });
+    }
+
+    return false;
+}
+
+void invalidate_content_size(GuiState &gui, const std::string &content_path) {
+    ContentSizes &sizes = gui.app_selector.content_sizes;
+    std::lock_guard<std::mutex> lock(sizes.mutex);
+    sizes.sizes.erase(content_path);
+}
+
+// computed now if the size isn't known yet, for the information of a single content
+static uint64_t get_content_size_now(GuiState &gui, EmuEnvState &emuenv, const std::string &content_path) {
+    uint64_t size = 0;
+    if (get_content_size(gui, emuenv, content_path, size))
+        return size;
+
+    const auto path{ fs::path(emuenv.pref_path) / content_path };
+    const int64_t time = get_directory_time(path);
+    size = compute_directory_size(path);
+
+    ContentSizes &sizes = gui.app_selector.content_sizes;
+    std::lock_guard<std::mutex> lock(sizes.mutex);
+    sizes.sizes[content_path] = { size, time };
+    return size;
+}
+
 void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
     const auto APP_PATH{ fs::path(emuenv.pref_path) / "ux0/app" / app_path };
     gui.app_selector.app_info = {};
@@ -59,16 +146,7 @@ void get_app_info(GuiState &gui, EmuEnvState &emuenv, const std::string &app_pat
 }
 
 size_t get_app_size(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
-    const auto APP_PATH{ fs::path(emuenv.pref_path) / "ux0/app" / app_path };
-    boost::uintmax_t app_size = 0;
-    if (fs::exists(APP_PATH) && !fs::is_empty(APP_PATH)) {
-        app_size += get_recursive_directory_size(APP_PATH);
-    }
-    const auto ADDCONT_PATH{ fs::path(emuenv.pref_path) / "ux0/addcont" / get_app_index(gui, app_path)->title_id };
-    if (fs::exists(ADDCONT_PATH) && !fs::is_empty(ADDCONT_PATH)) {
-        app_size += get_recursive_directory_size(ADDCONT_PATH);
-    }
-    return app_size;
+    return get_content_size_now(gui, emuenv, "ux0/app/" + app_path) + get_content_size_now(gui, emuenv, "ux0/addcont/" + get_app_index(gui, app_path)->title_id);
 }
 
 std::string get_unit_size(const size_t &size) {
@@ -109,8 +187,10 @@ static void get_save_data_list(GuiState &gui, EmuEnvState &emuenv) {
             const auto last_writen = fs::last_write_time(save);
             SAFE_LOCALTIME(&last_writen, &updated_tm);
 
-            const auto size = get_recursive_directory_size(save);
-            save_data_list.push_back({ get_app_index(gui, title_id)->title, title_id, size, updated_tm });
+            // a save is rewritten without changing the time of its directory
+            const auto content_path = fmt::format("ux0/user/{}/savedata/{}", emuenv.io.user_id, title_id);
+            invalidate_content_size(gui, content_path);
+            save_data_list.push_back({ get_app_index(gui, title_id)->title, title_id, 0, updated_tm });
         }
     }
     std::sort(save_data_list.begin(), save_data_list.end(), [](const SaveData &sa, const SaveData &sb) {
@@ -120,6 +200,52 @@ static void get_save_data_list(GuiState &gui, EmuEnvState &emuenv) {
 
 static std::map<std::string, size_t> apps_size;
 static std::map<std::string, std::string> space;
+static uint32_t sizes_generation;
+static std::chrono::steady_clock::time_point sizes_update_time;
+
+// use the sizes known so far, the others are shown once the workers computed them
+static void update_contents_size(GuiState &gui, EmuEnvState &emuenv) {
+    sizes_generation = gui.app_selector.content_sizes.generation;
+    sizes_update_time = std::chrono::steady_clock::now();
+
+    bool apps_complete = true;
+    uint64_t apps_total = 0;
+    apps_size.clear();
+    for (const auto &app : gui.app_selector.user_apps) {
+        uint64_t app_size = 0;
+        uint64_t addcont_size = 0;
+        const bool app_known = get_content_size(gui, emuenv, "ux0/app/" + app.path, app_size);
+        const bool addcont_known = get_content_size(gui, emuenv, "ux0/addcont/" + app.title_id, addcont_size);
+        if (app_known && addcont_known) {
+            apps_size[app.path] = app_size + addcont_size;
+            apps_total += app_size + addcont_size;
+        } else
+            apps_complete = false;
+    }
+
+    bool saves_complete = true;
+    uint64_t saves_total = 0;
+    for (auto &save : save_data_list) {
+        if (get_content_size(gui, emuenv, fmt::format("ux0/user/{}/savedata/{}", emuenv.io.user_id, save.title_id), save.size))
+            saves_total += save.size;
+        else
+            saves_complete = false;
+    }
+
+    const auto get_list_size_or_dash = [](const uint64_t list_size, const bool complete) {
+        return list_size && complete ? get_unit_size(list_size) : "-";
+    };
+
+    space["app"] = get_list_size_or_dash(apps_total, apps_complete);
+    space["savedata"] = get_list_size_or_dash(saves_total, saves_complete);
+
+    // keep the sizes of the apps for the next sessions once they're all known
+    static uint32_t saved_generation;
+    if (apps_complete && (saved_generation != sizes_generation)) {
+        save_apps_cache(gui, emuenv);
+        saved_generation = sizes_generation;
+    }
+}
 
 void init_content_manager(GuiState &gui, EmuEnvState &emuenv) {
     space.clear();
@@ -127,21 +253,6 @@ void init_content_manager(GuiState &gui, EmuEnvState &emuenv) {
     const auto free_size{ fs::space(emuenv.pref_path).free };
     space["free"] = get_unit_size(free_size);
 
-    const auto query_app = [&gui, &emuenv] {
-        const auto &directory_list = gui.app_selector.user_apps;
-        const auto pred = [&](const auto acc, const auto &app) {
-            apps_size[app.path] = get_app_size(gui, emuenv, app.path);
-            return acc + apps_size[app.path];
-        };
-        return boost::accumulate(directory_list, boost::uintmax_t{}, pred);
-    };
-
-    const auto query_savedata = [] {
-        const auto &directory_list = save_data_list;
-        const auto pred = [](const auto acc, const auto &save) { return acc + save.size; };
-        return boost::accumulate(directory_list, boost::uintmax_t{}, pred);
-    };
-
     const auto query_themes = [&emuenv] {
         const auto THEME_PATH{ fs::path(emuenv.pref_path) / "ux0/theme" };
         if (fs::exists(THEME_PATH) && !fs::is_empty(THEME_PATH)) {
@@ -150,15 +261,10 @@ void init_content_manager(GuiState &gui, EmuEnvState &emuenv) {
         return boost::uintmax_t{};
     };
 
-    const auto get_list_size_or_dash = [](const auto query) {
-        const auto list_size = query();
-        return list_size ? get_unit_size(list_size) : "-";
-    };
-
-    space["app"] = get_list_size_or_dash(query_app);
     get_save_data_list(gui, emuenv);
-    space["savedata"] = get_list_size_or_dash(query_savedata);
-    space["themes"] = get_list_size_or_dash(query_themes);
+    update_contents_size(gui, emuenv);
+    const auto themes_size = query_themes();
+    space["themes"] = themes_size ? get_unit_size(themes_size) : "-";
 }
 
 static std::map<std::string, bool> contents_selected;
@@ -193,10 +299,7 @@ struct AddCont {
 static std::map<std::string, AddCont> addcont_info;
 
 static void get_content_info(GuiState &gui, EmuEnvState &emuenv) {
-    const auto APP_PATH{ fs::path(emuenv.pref_path) / "ux0/app" / app_selected };
-    if (fs::exists(APP_PATH) && !fs::is_empty(APP_PATH)) {
-        gui.app_selector.app_info.size = get_recursive_directory_size(APP_PATH);
-    }
+    gui.app_selector.app_info.size = get_content_size_now(gui, emuenv, "ux0/app/" + app_selected);
 
     addcont_info.clear();
     const auto ADDCONT_PATH{ fs::path(emuenv.pref_path) / "ux0/addcont" / app_selected };
@@ -207,7 +310,7 @@ static void get_content_info(GuiState &gui, EmuEnvState &emuenv) {
             const auto last_writen = fs::last_write_time(addcont);
             SAFE_LOCALTIME(&last_writen, &addcont_info[content_id].date);
 
-            const auto addcont_size = get_recursive_directory_size(addcont);
+            const auto addcont_size = get_content_size_now(gui, emuenv, fmt::format("ux0/addcont/{}/{}", app_selected, content_id));
             addcont_info[content_id].size = get_unit_size(addcont_size);
 
             const auto content_path{ fs::path("addcont") / app_selected / content_id };
@@ -228,6 +331,10 @@ static float scroll_pos;
 static ImGuiTextFilter search_bar;
 
 void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
+    // the totals walk all the contents, they're updated a few times per second while the sizes are computed
+    if ((gui.app_selector.content_sizes.generation != sizes_generation) && (std::chrono::steady_clock::now() - sizes_update_time >= std::chrono::milliseconds(250)))
+        update_contents_size(gui, emuenv);
+
     const auto display_size = ImGui::GetIO().DisplaySize;
     const auto RES_SCALE = ImVec2(display_size.x / emuenv.res_width_dpi_scale, display_size.y / emuenv.res_height_dpi_scale);
     const auto SCALE = ImVec2(RES_SCALE.x * emuenv.dpi_scale, RES_SCALE.y * emuenv.dpi_scale);
@@ -355,6 +462,8 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
                     if (menu == "app") {
                         fs::remove_all(fs::path(emuenv.pref_path) / "ux0/app" / content.first);
                         fs::remove_all(fs::path(emuenv.pref_path) / "ux0/addcont" / content.first);
+                        invalidate_content_size(gui, "ux0/app/" + content.first);
+                        invalidate_content_size(gui, "ux0/addcont/" + content.first);
                         gui.app_selector.user_apps.erase(get_app_index(gui, content.first));
                         gui.app_selector.user_apps_icon.erase(content.first);
                     }
@@ -433,7 +542,7 @@ void draw_content_manager(GuiState &gui, EmuEnvState &emuenv) {
                     ImGui::TextColored(GUI_COLOR_TEXT, "%s", app.title.c_str());
                     ImGui::SetCursorPosY(Title_POS + (46.f * SCALE.y));
                     ImGui::SetWindowFontScale(0.8f);
-                    ImGui::TextColored(GUI_COLOR_TEXT, "%s", get_unit_size(apps_size[app.path]).c_str());
+                    ImGui::TextColored(GUI_COLOR_TEXT, "%s", apps_size.contains(app.path) ? get_unit_size(apps_size[app.path]).c_str() : "-");
                     ImGui::NextColumn();
                     ImGui::SetWindowFontScale(1.2f);
                     ImGui::SetCursorPosY(ImGui::GetCursorPosY() + (15.f * SCALE.y));
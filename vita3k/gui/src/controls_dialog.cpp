@@ -157,6 +157,12 @@ void draw_controls_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Text("%-16s    %-16s", lang["toggle_gui_visibility"].c_str(), "G");
     if (ImGui::IsItemHovered())
         ImGui::SetTooltip("Toggles between showing and hiding the GUI at the top of the screen while the app is running.");
+    ImGui::Text("%-16s    %-16s", lang["screenshot"].c_str(), "F12");
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Saves the next frame in the captures folder, only with the Vulkan renderer.");
+    ImGui::Text("%-16s    %-16s", lang["toggle_recording"].c_str(), "F10");
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Starts or stops recording the window to a video in the captures folder, only with the Vulkan renderer.");
 
     const char *error_text = lang["error_duplicate_key"].c_str();
     ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x / 2.f, ImGui::GetIO().DisplaySize.y / 2.f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
@@ -25,17 +25,14 @@ void draw_event_flags_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Event Flags", &gui.debug_menu.eventflags_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s  %-7s   %-8s   %-16s", "ID", "EventFlag Name", "Flags", "Attributes", "Waiting Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-
-    for (const auto &event : emuenv.kernel.eventflags) {
-        std::shared_ptr<EventFlag> event_state = event.second;
+    emuenv.kernel.eventflags.for_each([&](SceUID uid, const std::shared_ptr<EventFlag> &event_state) {
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s  %02d        %01d         %02zu                 ",
-            event.first,
+            uid,
             event_state->name,
             event_state->flags,
             event_state->attr,
             event_state->waiting_threads->size());
-    }
+    });
     ImGui::End();
 }
 
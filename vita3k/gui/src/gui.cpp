@@ -28,10 +28,13 @@
 #include <display/state.h>
 #include <glutil/gl.h>
 #include <io/VitaIoDevice.h>
+#include <io/mapped_file.h>
 #include <io/state.h>
 #include <io/vfs.h>
 #include <lang/functions.h>
 #include <packages/sfo.h>
+#include <util/align.h>
+#include <util/boot_stages.h>
 #include <util/fs.h>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -41,6 +44,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <array>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -300,46 +304,209 @@ void init_app_icon(GuiState &gui, EmuEnvState &emuenv, const std::string app_pat
 IconData::IconData()
     : data(nullptr, stbi_image_free) {}
 
+static constexpr uint32_t ICON_CACHE_MAGIC = 0x4E434956; // VICN
+static constexpr uint32_t ICON_CACHE_VERSION = 1;
+static constexpr int32_t ICON_CACHE_SIZE = 128;
+static constexpr uint64_t ICON_CACHE_DATA_SIZE = ICON_CACHE_SIZE * ICON_CACHE_SIZE * 4;
+// the textures created each frame, to not stall the first frames with hundreds of uploads
+static constexpr size_t ICON_UPLOADS_PER_FRAME = 64;
+
+struct IconCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t index_size;
+};
+
+static fs::path get_icon_cache_path(EmuEnvState &emuenv) {
+    return fs::path(emuenv.pref_path) / "ux0/temp/icons.dat";
+}
+
+static bool get_icon_cache_key(EmuEnvState &emuenv, const std::string &app_path, IconCacheKey &key) {
+    const auto icon_path{ fs::path(emuenv.pref_path) / "ux0/app" / app_path / "sce_sys/icon0.png" };
+    boost::system::error_code error;
+    key.size = fs::file_size(icon_path, error);
+    if (error)
+        return false;
+    key.time = static_cast<int64_t>(fs::last_write_time(icon_path, error));
+    return !error;
+}
+
+// the index is a list of entries: key, offset of the pixels, size of the path and path
+static void read_icon_cache(IconAsyncLoader &loader, const fs::path &cache_path) {
+    loader.cache_file = MappedFile::create(cache_path);
+    if (!loader.cache_file)
+        return;
+
+    const uint8_t *const data = loader.cache_file->data();
+    const uint64_t size = loader.cache_file->size();
+    IconCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    if ((header.magic != ICON_CACHE_MAGIC) || (header.version != ICON_CACHE_VERSION) || (sizeof(header) + header.index_size > size)) {
+        loader.cache_file.reset();
+        return;
+    }
+
+    uint64_t offset = sizeof(header);
+    const uint64_t index_end = sizeof(header) + header.index_size;
+    for (uint32_t i = 0; i < header.count; i++) {
+        IconCacheEntry entry;
+        uint32_t path_size;
+        if (offset + sizeof(entry.key) + sizeof(entry.offset) + sizeof(path_size) > index_end)
+            break;
+        memcpy(&entry.key, data + offset, sizeof(entry.key));
+        offset += sizeof(entry.key);
+        memcpy(&entry.offset, data + offset, sizeof(entry.offset));
+        offset += sizeof(entry.offset);
+        memcpy(&path_size, data + offset, sizeof(path_size));
+        offset += sizeof(path_size);
+        if ((offset + path_size > index_end) || (entry.offset + ICON_CACHE_DATA_SIZE > size))
+            break;
+
+        loader.cache_index.emplace(std::string(reinterpret_cast<const char *>(data + offset), path_size), entry);
+        offset += path_size;
+    }
+}
+
+// written next to the mapped cache, it replaces it once it's unmapped
+static void write_icon_cache(IconAsyncLoader &loader, const fs::path &cache_path) {
+    std::vector<std::pair<std::string, IconCacheEntry>> entries;
+    std::vector<const uint8_t *> pixels;
+    for (const auto &[path, entry] : loader.cache_hits) {
+        entries.emplace_back(path, entry);
+        pixels.push_back(loader.cache_file->data() + entry.offset);
+    }
+    for (const auto &[path, icon] : loader.cache_decoded) {
+        entries.emplace_back(path, IconCacheEntry{ icon.first, 0 });
+        pixels.push_back(icon.second.data());
+    }
+
+    uint32_t index_size = 0;
+    for (const auto &entry : entries)
+        index_size += sizeof(IconCacheKey) + sizeof(uint64_t) + sizeof(uint32_t) + static_cast<uint32_t>(entry.first.size());
+    // the pixels start on a page, so the mapping serves them directly
+    uint64_t offset = align(sizeof(IconCacheHeader) + index_size, 4096);
+    for (auto &entry : entries) {
+        entry.second.offset = offset;
+        offset += ICON_CACHE_DATA_SIZE;
+    }
+
+    fs::ofstream cache(fs::path(cache_path).concat(".tmp"), std::ios::out | std::ios::binary);
+    if (!cache.is_open())
+        return;
+
+    const IconCacheHeader header = { ICON_CACHE_MAGIC, ICON_CACHE_VERSION, static_cast<uint32_t>(entries.size()), index_size };
+    cache.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &[path, entry] : entries) {
+        const uint32_t path_size = static_cast<uint32_t>(path.size());
+        cache.write(reinterpret_cast<const char *>(&entry.key), sizeof(entry.key));
+        cache.write(reinterpret_cast<const char *>(&entry.offset), sizeof(entry.offset));
+        cache.write(reinterpret_cast<const char *>(&path_size), sizeof(path_size));
+        cache.write(path.data(), path_size);
+    }
+    const std::vector<char> padding(entries.empty() ? 0 : entries.front().second.offset - sizeof(header) - index_size, 0);
+    cache.write(padding.data(), padding.size());
+    for (const uint8_t *data : pixels)
+        cache.write(reinterpret_cast<const char *>(data), ICON_CACHE_DATA_SIZE);
+
+    loader.cache_written = cache.good();
+}
+
 void IconAsyncLoader::commit(GuiState &gui) {
     std::lock_guard<std::mutex> lock(mutex);
 
-    for (const auto &pair : icon_data)
-        gui.app_selector.user_apps_icon[pair.first].init(gui.imgui_state.get(), pair.second.data.get(), pair.second.width, pair.second.height);
+    size_t uploads = 0;
+    for (auto it = icon_data.begin(); (it != icon_data.end()) && (uploads < ICON_UPLOADS_PER_FRAME); uploads++) {
+        gui.app_selector.user_apps_icon[it->first].init(gui.imgui_state.get(), it->second.data.get(), it->second.width, it->second.height);
+        it = icon_data.erase(it);
+    }
+}
 
-    icon_data.clear();
+void IconAsyncLoader::request(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = std::find(pending.begin(), pending.end(), path);
+    if ((it == pending.end()) || (it == pending.begin()))
+        return;
+
+    pending.erase(it);
+    pending.push_front(path);
 }
 
 IconAsyncLoader::IconAsyncLoader(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
     // I don't feel comfortable passing app_list down to be iterated by thread.
     // Methods like delete_app might mutate it, so I'd like to copy what I need now.
-    auto paths = [&app_list]() {
-        std::vector<std::string> copy(app_list.size());
-        std::transform(app_list.begin(), app_list.end(), copy.begin(), [](const auto &a) { return a.path; });
+    for (const auto &app : app_list)
+        pending.push_back(app.path);
 
-        return copy;
-    };
+    cache_path = get_icon_cache_path(emuenv);
+    read_icon_cache(*this, cache_path);
 
     quit = false;
-    thread = std::thread([&, paths = paths()]() {
-        for (const auto &path : paths) {
-            if (quit)
-                return;
-
-            // load the actual texture
-            IconData data = load_app_icon(gui, emuenv, path);
-
-            // Duplicate code here from init_app_icon
-            {
+    const uint32_t worker_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+    pool = std::make_unique<JobPool>(worker_count);
+    active_workers = worker_count;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        pool->submit([&]() {
+            while (!quit) {
+                std::string path;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (pending.empty())
+                        break;
+                    path = std::move(pending.front());
+                    pending.pop_front();
+                }
+
+                IconData data;
+                IconCacheKey key;
+                const bool has_key = get_icon_cache_key(emuenv, path, key);
+                const auto cached = cache_index.find(path);
+                if (has_key && (cached != cache_index.end()) && (cached->second.key == key)) {
+                    // the pixels stay mapped as long as the loader, no need to copy them
+                    data.data = std::unique_ptr<void, void (*)(void *)>(const_cast<uint8_t *>(cache_file->data() + cached->second.offset), [](void *) {});
+                    data.width = ICON_CACHE_SIZE;
+                    data.height = ICON_CACHE_SIZE;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cache_hits.emplace(path, cached->second);
+                    icon_data[path] = std::move(data);
+                    continue;
+                }
+
+                // load the actual texture
+                data = load_app_icon(gui, emuenv, path);
+
+                // Duplicate code here from init_app_icon
                 std::lock_guard<std::mutex> lock(mutex);
+                if (has_key && data.data) {
+                    const uint8_t *const pixels = static_cast<const uint8_t *>(data.data.get());
+                    cache_decoded[path] = { key, std::vector<uint8_t>(pixels, pixels + ICON_CACHE_DATA_SIZE) };
+                }
                 icon_data[path] = std::move(data);
             }
-        }
-    });
+
+            // the last worker to finish updates the cache if an icon changed
+            std::lock_guard<std::mutex> lock(mutex);
+            if ((--active_workers == 0) && !quit && (!cache_decoded.empty() || (cache_hits.size() != cache_index.size())))
+                write_icon_cache(*this, cache_path);
+        });
+    }
 }
 
 IconAsyncLoader::~IconAsyncLoader() {
     quit = true;
-    thread.join();
+    pool.reset();
+
+    // unmap the cache before replacing it
+    icon_data.clear();
+    cache_file.reset();
+    if (cache_written) {
+        boost::system::error_code error;
+        fs::rename(fs::path(cache_path).concat(".tmp"), cache_path, error);
+        if (error)
+            LOG_WARN("Failed to replace the icons cache: {}", error.message());
+    }
 }
 
 void init_apps_icon(GuiState &gui, EmuEnvState &emuenv, const std::vector<gui::App> &app_list) {
@@ -383,62 +550,114 @@ std::string get_sys_lang_name(uint32_t lang_id) {
     return current_sys_lang->second;
 }
 
+// Layout of apps.dat: the header, a fixed-size record per app and the table of their strings.
+// The first fields of the header are the ones of the previous versions, to check the version of any
+static constexpr uint32_t APPS_CACHE_VERSION = 3;
+
+// the strings of an app, in the order of its record
+static constexpr std::array<std::string App::*, 10> APPS_CACHE_STRINGS = {
+    &App::app_ver, &App::category, &App::content_id, &App::addcont, &App::savedata,
+    &App::parental_level, &App::stitle, &App::title, &App::title_id, &App::path
+};
+
+struct AppsCacheHeader {
+    uint64_t count;
+    uint32_t version;
+    uint32_t lang;
+    uint32_t record_size;
+    uint32_t strings_size;
+};
+
+struct AppsCacheString {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct AppsCacheContentSize {
+    uint64_t size;
+    int64_t time;
+    uint8_t known;
+    uint8_t padding[7];
+};
+
+struct AppsCacheRecord {
+    AppsCacheString strings[APPS_CACHE_STRINGS.size()];
+    AppsCacheContentSize app_size;
+    AppsCacheContentSize addcont_size;
+};
+
 static bool get_user_apps(GuiState &gui, EmuEnvState &emuenv) {
     const auto apps_cache_path{ fs::path(emuenv.pref_path) / "ux0/temp/apps.dat" };
-    fs::ifstream apps_cache(apps_cache_path, std::ios::in | std::ios::binary);
-    if (apps_cache.is_open()) {
-        gui.app_selector.user_apps.clear();
-        // Read size of apps list
-        size_t size;
-        apps_cache.read((char *)&size, sizeof(size));
-
-        // Check version of cache
-        uint32_t versionInFile;
-        apps_cache.read((char *)&versionInFile, sizeof(uint32_t));
-        if (versionInFile != 1) {
-            LOG_WARN("Current version of cache: {}, is outdated, recreate it.", versionInFile);
-            return false;
-        }
+    if (!fs::exists(apps_cache_path))
+        return false;
 
-        // Read language of cache
-        apps_cache.read((char *)&gui.app_selector.apps_cache_lang, sizeof(uint32_t));
-        if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
-            LOG_WARN("Current lang of cache: {}, is diferent config: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
+    // the cache is mapped when it's big enough, and read at once otherwise
+    const auto mapped_cache = MappedFile::create(apps_cache_path);
+    std::vector<uint8_t> read_cache;
+    if (!mapped_cache) {
+        fs::ifstream apps_cache(apps_cache_path, std::ios::in | std::ios::binary);
+        boost::system::error_code error;
+        read_cache.resize(fs::file_size(apps_cache_path, error));
+        if (error || !apps_cache.read(reinterpret_cast<char *>(read_cache.data()), read_cache.size()))
             return false;
-        }
-
-        // Read App info value
-        for (size_t a = 0; a < size; a++) {
-            auto read = [&apps_cache]() {
-                size_t size;
-
-                apps_cache.read((char *)&size, sizeof(size));
+    }
+    const uint8_t *const cache = mapped_cache ? mapped_cache->data() : read_cache.data();
+    const uint64_t cache_size = mapped_cache ? mapped_cache->size() : read_cache.size();
 
-                std::vector<char> buffer(size); // dont trust std::string to hold buffer enough
-                apps_cache.read(buffer.data(), size);
+    gui.app_selector.user_apps.clear();
 
-                return std::string(buffer.begin(), buffer.end());
-            };
+    // Check version of cache
+    AppsCacheHeader header = {};
+    if (cache_size >= sizeof(header))
+        memcpy(&header, cache, sizeof(header));
+    if (header.version != APPS_CACHE_VERSION) {
+        LOG_WARN("Current version of cache: {}, is outdated, recreate it.", header.version);
+        return false;
+    }
 
-            App app;
+    const uint64_t records_size = header.count * sizeof(AppsCacheRecord);
+    if ((header.record_size != sizeof(AppsCacheRecord)) || (header.count > cache_size / sizeof(AppsCacheRecord))
+        || (sizeof(header) + records_size + header.strings_size != cache_size)) {
+        LOG_WARN("Apps cache is truncated, recreate it.");
+        return false;
+    }
 
-            app.app_ver = read();
-            app.category = read();
-            app.content_id = read();
-            app.addcont = read();
-            app.savedata = read();
-            app.parental_level = read();
-            app.stitle = read();
-            app.title = read();
-            app.title_id = read();
-            app.path = read();
+    // Read language of cache
+    gui.app_selector.apps_cache_lang = header.lang;
+    if (gui.app_selector.apps_cache_lang != emuenv.cfg.sys_lang) {
+        LOG_WARN("Current lang of cache: {}, is diferent config: {}, recreate it.", get_sys_lang_name(gui.app_selector.apps_cache_lang), get_sys_lang_name(emuenv.cfg.sys_lang));
+        return false;
+    }
 
-            gui.app_selector.user_apps.push_back(app);
+    // Read App info value
+    const uint8_t *const records = cache + sizeof(header);
+    const char *const strings = reinterpret_cast<const char *>(records + records_size);
+    gui.app_selector.user_apps.resize(header.count);
+    for (uint64_t a = 0; a < header.count; a++) {
+        AppsCacheRecord record;
+        memcpy(&record, records + a * sizeof(record), sizeof(record));
+
+        App &app = gui.app_selector.user_apps[a];
+        for (size_t i = 0; i < APPS_CACHE_STRINGS.size(); i++) {
+            const AppsCacheString &string = record.strings[i];
+            if (static_cast<uint64_t>(string.offset) + string.size > header.strings_size) {
+                LOG_WARN("Apps cache is corrupted, recreate it.");
+                gui.app_selector.user_apps.clear();
+                return false;
+            }
+            (app.*APPS_CACHE_STRINGS[i]).assign(strings + string.offset, string.size);
         }
 
-        init_apps_icon(gui, emuenv, gui.app_selector.user_apps);
+        // the sizes computed in a previous session, if they were
+        std::lock_guard<std::mutex> lock(gui.app_selector.content_sizes.mutex);
+        if (record.app_size.known)
+            gui.app_selector.content_sizes.sizes["ux0/app/" + app.path] = { record.app_size.size, record.app_size.time };
+        if (record.addcont_size.known)
+            gui.app_selector.content_sizes.sizes["ux0/addcont/" + app.title_id] = { record.addcont_size.size, record.addcont_size.time };
     }
 
+    init_apps_icon(gui, emuenv, gui.app_selector.user_apps);
+
     return !gui.app_selector.user_apps.empty();
 }
 
@@ -447,40 +666,42 @@ void save_apps_cache(GuiState &gui, EmuEnvState &emuenv) {
     if (!fs::exists(temp_path))
         fs::create_directory(temp_path);
 
-    fs::ofstream apps_cache(temp_path / "apps.dat", std::ios::out | std::ios::binary);
-    if (apps_cache.is_open()) {
-        // Write Size of apps list
-        const auto size = gui.app_selector.user_apps.size();
-        apps_cache.write((char *)&size, sizeof(size));
+    // Build the records and the string table in memory, the cache is then written at once
+    std::vector<AppsCacheRecord> records(gui.app_selector.user_apps.size());
+    std::string strings;
+    for (size_t a = 0; a < records.size(); a++) {
+        const App &app = gui.app_selector.user_apps[a];
+        AppsCacheRecord &record = records[a];
+        memset(&record, 0, sizeof(record));
+        for (size_t i = 0; i < APPS_CACHE_STRINGS.size(); i++) {
+            const std::string &string = app.*APPS_CACHE_STRINGS[i];
+            record.strings[i] = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+            strings += string;
+        }
 
-        // Write version of cache
-        const uint32_t versionInFile = 1;
-        apps_cache.write((char *)&versionInFile, sizeof(uint32_t));
+        // the sizes of the app and its additional contents are only written once they're known
+        const auto get_content_size = [&](const std::string &content_path, AppsCacheContentSize &content_size) {
+            const auto cached = gui.app_selector.content_sizes.sizes.find(content_path);
+            if (cached == gui.app_selector.content_sizes.sizes.end())
+                return;
+            content_size.size = cached->second.size;
+            content_size.time = cached->second.time;
+            content_size.known = 1;
+        };
+        std::lock_guard<std::mutex> lock(gui.app_selector.content_sizes.mutex);
+        get_content_size("ux0/app/" + app.path, record.app_size);
+        get_content_size("ux0/addcont/" + app.title_id, record.addcont_size);
+    }
 
-        // Write language of cache
+    fs::ofstream apps_cache(temp_path / "apps.dat", std::ios::out | std::ios::binary);
+    if (apps_cache.is_open()) {
         gui.app_selector.apps_cache_lang = emuenv.cfg.sys_lang;
-        apps_cache.write((char *)&gui.app_selector.apps_cache_lang, sizeof(uint32_t));
-
-        // Write Apps list
-        for (const App &app : gui.app_selector.user_apps) {
-            auto write = [&apps_cache](const std::string &i) {
-                const auto size = i.length();
-
-                apps_cache.write((char *)&size, sizeof(size));
-                apps_cache.write(i.c_str(), size);
-            };
-
-            write(app.app_ver);
-            write(app.category);
-            write(app.content_id);
-            write(app.addcont);
-            write(app.savedata);
-            write(app.parental_level);
-            write(app.stitle);
-            write(app.title);
-            write(app.title_id);
-            write(app.path);
-        }
+        const AppsCacheHeader header = { records.size(), APPS_CACHE_VERSION, gui.app_selector.apps_cache_lang,
+            sizeof(AppsCacheRecord), static_cast<uint32_t>(strings.size()) };
+
+        apps_cache.write((char *)&header, sizeof(header));
+        apps_cache.write((char *)records.data(), records.size() * sizeof(AppsCacheRecord));
+        apps_cache.write(strings.data(), strings.size());
         apps_cache.close();
     }
 }
@@ -522,6 +743,10 @@ void init_user_app(GuiState &gui, EmuEnvState &emuenv, const std::string app_pat
     get_app_param(gui, emuenv, app_path);
     init_app_icon(gui, emuenv, app_path);
 
+    // installed or updated, the time of the directories doesn't change with the files replaced
+    invalidate_content_size(gui, "ux0/app/" + app_path);
+    invalidate_content_size(gui, "ux0/addcont/" + get_app_index(gui, app_path)->title_id);
+
     const auto TIME_APP_INDEX = get_time_app_index(gui, emuenv, app_path);
     if (TIME_APP_INDEX != gui.time_apps[emuenv.io.user_id].end())
         get_app_index(gui, app_path)->last_time = TIME_APP_INDEX->last_time_used;
@@ -540,11 +765,31 @@ std::map<std::string, ImGui_Texture>::const_iterator get_app_icon(GuiState &gui,
 
 std::vector<App>::iterator get_app_index(GuiState &gui, const std::string app_path) {
     auto &app_type = app_path.find("NPXS") != std::string::npos ? gui.app_selector.sys_apps : gui.app_selector.user_apps;
-    const auto app_index = std::find_if(app_type.begin(), app_type.end(), [&](const App &a) {
-        return a.path == app_path;
-    });
+    if (&app_type == &gui.app_selector.sys_apps) {
+        return std::find_if(app_type.begin(), app_type.end(), [&](const App &a) {
+            return a.path == app_path;
+        });
+    }
+
+    // The list is sorted, added to and erased from in many places, so the index is checked instead of being kept up to date.
+    // It is rebuilt when it points to another app, or when the app isn't in it
+    std::lock_guard<std::mutex> lock(gui.app_selector.user_apps_index_mutex);
+    auto &index = gui.app_selector.user_apps_index;
+    const auto is_valid = [&](const auto indexed) {
+        return (indexed != index.end()) && (indexed->second < app_type.size()) && (app_type[indexed->second].path == app_path);
+    };
+
+    auto indexed = index.find(app_path);
+    if (!is_valid(indexed)) {
+        index.clear();
+        for (size_t i = 0; i < app_type.size(); i++)
+            index.emplace(app_type[i].path, i);
+        indexed = index.find(app_path);
+        if (!is_valid(indexed))
+            return app_type.end();
+    }
 
-    return app_index;
+    return app_type.begin() + indexed->second;
 }
 
 void get_app_param(GuiState &gui, EmuEnvState &emuenv, const std::string app_path) {
@@ -670,13 +915,23 @@ ImTextureID load_image(GuiState &gui, const char *data, const std::uint32_t size
 
 void pre_init(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::CreateContext();
-    gui.imgui_state.reset(ImGui_ImplSdl_Init(emuenv.renderer.get(), emuenv.window.get(), emuenv.base_path));
 
-    assert(gui.imgui_state);
+    // The font atlas (with the big CJK ranges) is only built on the CPU, with fast boot
+    // it is done while the backend is created and the languages are loaded
+    util::BootStages stages(emuenv.cfg.fast_boot);
+    stages.run("font atlas", [&gui, &emuenv]() {
+        init_font(gui, emuenv);
+    });
+    stages.run_here("gui backend", [&gui, &emuenv]() {
+        gui.imgui_state.reset(ImGui_ImplSdl_Init(emuenv.renderer.get(), emuenv.window.get(), emuenv.base_path));
+        init_style(emuenv);
+    });
+    stages.run_here("languages", [&gui, &emuenv]() {
+        lang::init_lang(gui.lang, emuenv);
+    });
+    stages.wait();
 
-    init_style(emuenv);
-    init_font(gui, emuenv);
-    lang::init_lang(gui.lang, emuenv);
+    assert(gui.imgui_state);
 
     bool result = ImGui_ImplSdl_CreateDeviceObjects(gui.imgui_state.get());
     assert(result);
@@ -697,22 +952,43 @@ void init(GuiState &gui, EmuEnvState &emuenv) {
     });
     load_and_update_compat_db_thread.detach();
 
-    get_modules_list(gui, emuenv);
-    get_notice_list(emuenv);
-    get_users_list(gui, emuenv);
-    get_time_apps(gui, emuenv);
+    // The modules and the notices lists are only parsed from files, the users need the renderer for their avatars
+    util::BootStages stages(emuenv.cfg.fast_boot);
+    stages.run("modules list", [&gui, &emuenv]() {
+        get_modules_list(gui, emuenv);
+    });
+    stages.run("notice list", [&emuenv]() {
+        get_notice_list(emuenv);
+    });
+    stages.run_here("users", [&gui, &emuenv]() {
+        get_users_list(gui, emuenv);
+        get_time_apps(gui, emuenv);
+    });
 
     if (emuenv.cfg.show_welcome)
         gui.help_menu.welcome_dialog = true;
 
-    get_sys_apps_title(gui, emuenv);
+    stages.run_here("system apps", [&gui, &emuenv]() {
+        get_sys_apps_title(gui, emuenv);
+    });
 
-    init_home(gui, emuenv);
+    // the notices of the user are read when it is logged in
+    stages.wait();
+    stages.run_here("home", [&gui, &emuenv]() {
+        init_home(gui, emuenv);
+    });
 
     // Initialize trophy callback
     emuenv.np.trophy_state.trophy_unlock_callback = [&gui](NpTrophyUnlockCallbackData &callback_data) {
+        // decode the icon here, the notification only has to create its texture
+        TrophyUnlockRequest request;
+        request.icon.data.reset(stbi_load_from_memory(callback_data.icon_buf.data(), static_cast<int>(callback_data.icon_buf.size()),
+            &request.icon.width, &request.icon.height, nullptr, STBI_rgb_alpha));
+        callback_data.icon_buf.clear();
+        request.data = std::move(callback_data);
+
         const std::lock_guard<std::mutex> guard(gui.trophy_unlock_display_requests_access_mutex);
-        gui.trophy_unlock_display_requests.insert(gui.trophy_unlock_display_requests.begin(), callback_data);
+        gui.trophy_unlock_display_requests.insert(gui.trophy_unlock_display_requests.begin(), std::move(request));
     };
 }
 
@@ -724,6 +1000,9 @@ void draw_begin(GuiState &gui, EmuEnvState &emuenv) {
     // cant bind opengl context outside main thread on macos now
     if (gui.app_selector.icon_async_loader)
         gui.app_selector.icon_async_loader->commit(gui);
+    gui.trophy_icon_loader.commit(gui);
+    gui.savedata_thumbnail_loader.commit(gui);
+    gui.live_area_image_loader.commit(gui);
 }
 
 void draw_end(GuiState &gui, SDL_Window *window) {
@@ -830,6 +1109,8 @@ void draw_ui(GuiState &gui, EmuEnvState &emuenv) {
         draw_allocations_dialog(gui, emuenv);
     if (gui.debug_menu.disassembly_dialog)
         draw_disassembly_dialog(gui, emuenv);
+    if (gui.debug_menu.import_stats_dialog)
+        draw_import_stats_dialog(gui, emuenv);
 
     if (gui.configuration_menu.custom_settings_dialog || gui.configuration_menu.settings_dialog)
         draw_settings_dialog(gui, emuenv);
@@ -40,8 +40,7 @@ void init_user_apps(GuiState &gui, EmuEnvState &emuenv) {
     gui.apps_list_opened.clear();
     gui.app_selector.user_apps_icon.clear();
     gui.current_app_selected = -1;
-    gui.live_area_contents.clear();
-    gui.live_items.clear();
+    clear_live_areas(gui);
     if (gui.app_selector.icon_async_loader)
         gui.app_selector.icon_async_loader->quit = true;
 
@@ -103,8 +102,6 @@ void update_apps_list_opened(GuiState &gui, EmuEnvState &emuenv, const std::stri
     gui.current_app_selected = 0;
     if (gui.apps_list_opened.size() > 6) {
         const auto last_app = gui.apps_list_opened.back() == emuenv.io.app_path ? gui.apps_list_opened[gui.apps_list_opened.size() - 2] : gui.apps_list_opened.back();
-        gui.live_area_contents.erase(last_app);
-        gui.live_items.erase(last_app);
         gui.apps_list_opened.erase(get_app_open_list_index(gui, last_app));
     }
 }
@@ -611,8 +608,11 @@ void draw_home_screen(GuiState &gui, EmuEnvState &emuenv) {
                     const auto POS_MIN = ImGui::GetCursorScreenPos();
                     const ImVec2 POS_MAX(POS_MIN.x + ICON_SIZE.x, POS_MIN.y + ICON_SIZE.y);
                     ImGui::GetWindowDrawList()->AddImageRounded(apps_icon[app.path], POS_MIN, POS_MAX, ImVec2(0, 0), ImVec2(1, 1), IM_COL32_WHITE, ICON_SIZE.x * SCALE.x, ImDrawFlags_RoundCornersAll);
+                } else if (is_not_sys_app && gui.app_selector.icon_async_loader) {
+                    // the visible icons are loaded first
+                    gui.app_selector.icon_async_loader->request(app.path);
                 }
-                const auto IS_CUSTOM_CONFIG = fs::exists(fs::path(emuenv.base_path) / "config" / fmt::format("config_{}.xml", app.path));
+                const auto IS_CUSTOM_CONFIG = has_custom_config(gui, emuenv, app.path);
                 if (IS_CUSTOM_CONFIG) {
                     if (emuenv.cfg.apps_list_grid)
                         ImGui::SetCursorPosX(GRID_ICON_POS);
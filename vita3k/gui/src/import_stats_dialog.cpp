@@ -0,0 +1,127 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "private.h"
+
+#include <nids/import_stats.h>
+#include <util/fs.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace gui {
+
+enum ImportStatsColumn {
+    IMPORT_STATS_NAME,
+    IMPORT_STATS_NID,
+    IMPORT_STATS_CALLS,
+    IMPORT_STATS_TOTAL,
+    IMPORT_STATS_MEAN,
+    IMPORT_STATS_P50,
+    IMPORT_STATS_P99,
+    IMPORT_STATS_MAX,
+};
+
+static double get_column_value(const ImportStats &stats, int column) {
+    switch (column) {
+    case IMPORT_STATS_NID: return stats.nid;
+    case IMPORT_STATS_CALLS: return static_cast<double>(stats.calls);
+    case IMPORT_STATS_TOTAL: return static_cast<double>(stats.total_ns);
+    case IMPORT_STATS_MEAN: return static_cast<double>(stats.total_ns) / static_cast<double>(stats.calls);
+    case IMPORT_STATS_P50: return static_cast<double>(stats.get_percentile(0.5));
+    case IMPORT_STATS_P99: return static_cast<double>(stats.get_percentile(0.99));
+    case IMPORT_STATS_MAX: return static_cast<double>(stats.max_ns);
+    default: return 0;
+    }
+}
+
+static void save_import_stats_json(EmuEnvState &emuenv) {
+    const fs::path log_directory = fs::path(emuenv.base_path) / "logs";
+    fs::create_directories(log_directory);
+    const fs::path path = log_directory / (emuenv.io.title_id + " - hle_stats.json");
+    if (save_import_stats(path.string()))
+        LOG_INFO("HLE function stats saved to {}", path.string());
+    else
+        LOG_ERROR("Failed to save HLE function stats to {}", path.string());
+}
+
+void draw_import_stats_dialog(GuiState &gui, EmuEnvState &emuenv) {
+    ImGui::Begin("HLE Functions", &gui.debug_menu.import_stats_dialog, ImGuiWindowFlags_MenuBar);
+
+    if (ImGui::BeginMenuBar()) {
+        if (ImGui::BeginMenu("Stats")) {
+            if (ImGui::MenuItem("Save as JSON"))
+                save_import_stats_json(emuenv);
+            if (ImGui::MenuItem("Reset"))
+                reset_import_stats();
+            ImGui::EndMenu();
+        }
+        ImGui::EndMenuBar();
+    }
+
+    std::vector<ImportStats> stats = get_import_stats();
+    constexpr ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter;
+    if (ImGui::BeginTable("import_stats", 8, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Function", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("NID");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total (ms)", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("Mean (us)", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("p50 (us)", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("p99 (us)", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn("Max (us)", ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableHeadersRow();
+
+        // The stats change every frame, so they are sorted every frame
+        if (const ImGuiTableSortSpecs *sort_specs = ImGui::TableGetSortSpecs(); sort_specs && (sort_specs->SpecsCount > 0)) {
+            const ImGuiTableColumnSortSpecs &spec = sort_specs->Specs[0];
+            const bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+            std::sort(stats.begin(), stats.end(), [&](const ImportStats &a, const ImportStats &b) {
+                if (spec.ColumnIndex == IMPORT_STATS_NAME) {
+                    const int order = std::strcmp(a.name, b.name);
+                    return ascending ? (order < 0) : (order > 0);
+                }
+                const double value_a = get_column_value(a, spec.ColumnIndex);
+                const double value_b = get_column_value(b, spec.ColumnIndex);
+                return ascending ? (value_a < value_b) : (value_a > value_b);
+            });
+        }
+
+        for (const ImportStats &function_stats : stats) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(function_stats.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%08X", function_stats.nid);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(function_stats.calls));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", get_column_value(function_stats, IMPORT_STATS_TOTAL) / 1e6);
+            for (const int column : { IMPORT_STATS_MEAN, IMPORT_STATS_P50, IMPORT_STATS_P99, IMPORT_STATS_MAX }) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", get_column_value(function_stats, column) / 1e3);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+} // namespace gui
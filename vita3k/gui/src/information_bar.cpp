@@ -277,7 +277,7 @@ void update_notice_info(GuiState &gui, EmuEnvState &emuenv, const std::string &t
         info.content_id = emuenv.app_info.app_content_id;
         info.group = emuenv.app_info.app_category;
     } else {
-        const auto trophy_data = gui.trophy_unlock_display_requests.back();
+        const auto &trophy_data = gui.trophy_unlock_display_requests.back().data;
         info.id = trophy_data.np_com_id;
         info.content_id = trophy_data.trophy_id;
         info.group = std::to_string(int(trophy_data.trophy_kind));
@@ -32,8 +32,10 @@
 
 #include <pugixml.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <stb_image.h>
+#include <tuple>
 
 namespace gui {
 
@@ -63,6 +65,144 @@ static std::map<std::string, std::map<std::string, uint64_t>> current_item, last
 static std::map<std::string, std::string> type;
 static std::map<std::string, int32_t> sku_flag;
 
+// image of a live area found by its template, read again each time the textures of the title are created
+struct LiveAreaImageSource {
+    // name of the contents, or id of the frame of the live item
+    std::string id;
+    // background or image for a live item, empty for the contents
+    std::string item_type;
+    size_t pos = 0;
+    VitaIoDevice device = VitaIoDevice::ux0;
+    std::string path;
+    // only the titles which should have their images warn when one is missing
+    bool warn_missing = false;
+};
+
+struct LiveAreaLayout {
+    std::vector<LiveAreaImageSource> images;
+    // live items of the frames by type, with the ones whose image is missing
+    std::map<std::string, std::map<std::string, size_t>> item_counts;
+};
+
+// parsed templates of the titles, kept for the session so opening a live area again only decodes its images
+static std::map<std::string, LiveAreaLayout> layouts;
+
+static constexpr uint32_t LIVE_AREA_IMAGE_WORKERS = 2;
+// the textures created each frame, the backgrounds are large so they are uploaded over a few frames
+static constexpr size_t LIVE_AREA_IMAGE_UPLOADS_PER_FRAME = 4;
+// titles whose textures are kept, the opened ones are never released
+static constexpr size_t LIVE_AREA_CACHED_APPS = 10;
+
+LiveAreaImageLoader::~LiveAreaImageLoader() {
+    quit = true;
+    pool.reset();
+}
+
+void LiveAreaImageLoader::commit(GuiState &gui) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t uploads = 0;
+    auto it = decoded.begin();
+    for (; (it != decoded.end()) && (uploads < LIVE_AREA_IMAGE_UPLOADS_PER_FRAME); ++it) {
+        const auto generation = generations.find(it->app_path);
+        if ((generation == generations.end()) || (generation->second != it->generation))
+            continue;
+        if (it->item_type.empty())
+            gui.live_area_contents[it->app_path][it->id].init(gui.imgui_state.get(), it->data.data.get(), it->data.width, it->data.height);
+        else {
+            auto &textures = gui.live_items[it->app_path][it->id][it->item_type];
+            if (it->pos >= textures.size())
+                continue;
+            items[it->app_path][it->id][it->item_type]["size"] = ImVec2(float(it->data.width), float(it->data.height));
+            textures[it->pos].init(gui.imgui_state.get(), it->data.data.get(), it->data.width, it->data.height);
+        }
+        uploads++;
+    }
+    decoded.erase(decoded.begin(), it);
+}
+
+static void release_live_area(GuiState &gui, const std::string &app_path) {
+    gui.live_area_image_loader.generations.erase(app_path);
+    gui.live_area_contents.erase(app_path);
+    gui.live_items.erase(app_path);
+}
+
+void clear_live_areas(GuiState &gui) {
+    LiveAreaImageLoader &loader = gui.live_area_image_loader;
+    loader.generations.clear();
+    loader.recent.clear();
+    gui.live_area_contents.clear();
+    gui.live_items.clear();
+    layouts.clear();
+}
+
+// Creates the textures of the live area of the title from its parsed template, the images are decoded in the background
+// and drawn once their textures are created. The textures of the titles neither opened nor used recently are released
+static void request_live_area_images(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    LiveAreaImageLoader &loader = gui.live_area_image_loader;
+    loader.recent.remove(app_path);
+    loader.recent.push_front(app_path);
+    while (loader.recent.size() > LIVE_AREA_CACHED_APPS) {
+        const auto last = std::find_if(loader.recent.rbegin(), loader.recent.rend(), [&](const std::string &app) {
+            return get_app_open_list_index(gui, app) == gui.apps_list_opened.end();
+        });
+        if (last == loader.recent.rend())
+            break;
+        release_live_area(gui, *last);
+        loader.recent.erase(std::next(last).base());
+    }
+
+    if (loader.generations.contains(app_path))
+        return;
+
+    const uint32_t generation = ++loader.next_generation;
+    loader.generations[app_path] = generation;
+    gui.live_area_contents[app_path].clear();
+    auto &live_items = gui.live_items[app_path];
+    live_items.clear();
+
+    const LiveAreaLayout &layout = layouts[app_path];
+    for (const auto &[frame, counts] : layout.item_counts) {
+        for (const auto &[item_type, count] : counts)
+            live_items[frame][item_type].resize(count);
+    }
+
+    if (layout.images.empty())
+        return;
+    if (!loader.pool)
+        loader.pool = std::make_unique<JobPool>(LIVE_AREA_IMAGE_WORKERS);
+
+    for (const auto &source : layout.images) {
+        loader.pool->submit([&loader, &emuenv, app_path, source, generation]() {
+            if (loader.quit)
+                return;
+
+            vfs::FileBuffer buffer;
+            vfs::read_file(source.device, buffer, emuenv.pref_path, source.path);
+            if (buffer.empty()) {
+                if (source.warn_missing)
+                    LOG_WARN("Live Area {} {}, Name: '{}', Not found for title {}.", source.item_type.empty() ? "contents" : source.item_type, source.id, source.path, app_path);
+                return;
+            }
+
+            LiveAreaImage image;
+            image.app_path = app_path;
+            image.id = source.id;
+            image.item_type = source.item_type;
+            image.pos = source.pos;
+            image.generation = generation;
+            image.data.data.reset(stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &image.data.width, &image.data.height, nullptr, STBI_rgb_alpha));
+            if (!image.data.data) {
+                LOG_ERROR("Id: {}, Invalid Live Area Contents for title {}.", source.id, app_path);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(loader.mutex);
+            loader.decoded.push_back(std::move(image));
+        });
+    }
+}
+
 void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_path) {
     // Init type
     if (items_pos.empty()) {
@@ -145,7 +285,7 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
     if (is_ps_app && !sku_flag.contains(app_path))
         sku_flag[app_path] = get_license_sku_flag(emuenv, APP_INDEX->content_id);
 
-    if (!gui.live_area_contents.contains(app_path)) {
+    if (!layouts.contains(app_path)) {
         auto default_contents = false;
         const auto fw_path{ fs::path(emuenv.pref_path) / "vs0" };
         const auto default_fw_contents{ fw_path / "data/internal/livearea/default/sce_sys/livearea/contents/template.xml" };
@@ -169,6 +309,15 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
             }
         }
 
+        LiveAreaLayout layout;
+        const auto warn_missing = is_ps_app || is_sys_app;
+        // the images of the live items are in the contents of the title, only the default contents are elsewhere
+        const auto contents_source = [&](const std::string &image_name) -> std::pair<VitaIoDevice, std::string> {
+            if (app_device == VitaIoDevice::vs0)
+                return { VitaIoDevice::vs0, "app/" + app_path + "/sce_sys/livearea/contents/" + image_name };
+            return { VitaIoDevice::ux0, (fs::path("app") / app_path / (live_area_path.string() + "/contents/" + image_name)).string() };
+        };
+
         if (doc.load_file(template_xml.c_str())) {
             std::map<std::string, std::string> name;
 
@@ -227,35 +376,19 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
             name["livearea-background"].erase(remove_if(name["livearea-background"].begin(), name["livearea-background"].end(), isspace), name["livearea-background"].end());
 
             for (const auto &contents : name) {
-                int32_t width = 0;
-                int32_t height = 0;
-                vfs::FileBuffer buffer;
-
                 if (contents.second.empty()) {
                     LOG_WARN("Content '{}' is empty for title {} [{}].", contents.first, app_path, APP_INDEX->title);
                     continue;
                 }
 
-                if (default_contents)
-                    vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path, "data/internal/livearea/default/sce_sys/livearea/contents/" + contents.second);
-                else if (app_device == VitaIoDevice::vs0)
-                    vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path, "app/" + app_path + "/sce_sys/livearea/contents/" + contents.second);
-                else
-                    vfs::read_app_file(buffer, emuenv.pref_path, app_path, live_area_path.string() + "/contents/" + contents.second);
-
-                if (buffer.empty()) {
-                    if (is_ps_app || is_sys_app)
-                        LOG_WARN("Contents {} '{}' Not found for title {} [{}].", contents.first, contents.second, app_path, APP_INDEX->title);
-                    continue;
-                }
-                stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                if (!data) {
-                    LOG_ERROR("Invalid Live Area Contents for title {} [{}].", app_path, APP_INDEX->title);
-                    continue;
-                }
-
-                gui.live_area_contents[app_path][contents.first].init(gui.imgui_state.get(), data, width, height);
-                stbi_image_free(data);
+                LiveAreaImageSource source{ contents.first };
+                if (default_contents) {
+                    source.device = VitaIoDevice::vs0;
+                    source.path = "data/internal/livearea/default/sce_sys/livearea/contents/" + contents.second;
+                } else
+                    std::tie(source.device, source.path) = contents_source(contents.second);
+                source.warn_missing = warn_missing;
+                layout.images.push_back(std::move(source));
             }
 
             std::map<std::string, std::map<std::string, std::vector<std::string>>> items_name;
@@ -415,14 +548,10 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
 
             for (auto &item : items_name) {
                 current_item[app_path][item.first] = 0;
-                if (!item.second["background"].empty()) {
-                    for (auto &bg_name : item.second["background"])
-                        gui.live_items[app_path][item.first]["background"].push_back({});
-                }
-                if (!item.second["image"].empty()) {
-                    for (auto &img_name : item.second["image"])
-                        gui.live_items[app_path][item.first]["image"].push_back({});
-                }
+                if (!item.second["background"].empty())
+                    layout.item_counts[item.first]["background"] = item.second["background"].size();
+                if (!item.second["image"].empty())
+                    layout.item_counts[item.first]["image"] = item.second["image"].size();
             }
 
             auto pos = 0;
@@ -441,29 +570,8 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
                                 bg_name.erase(remove(bg_name.begin(), bg_name.end(), '\n'), bg_name.end());
                             bg_name.erase(remove_if(bg_name.begin(), bg_name.end(), isspace), bg_name.end());
 
-                            int32_t width = 0;
-                            int32_t height = 0;
-                            vfs::FileBuffer buffer;
-
-                            if (app_device == VitaIoDevice::vs0)
-                                vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path, "app/" + app_path + "/sce_sys/livearea/contents/" + bg_name);
-                            else
-                                vfs::read_app_file(buffer, emuenv.pref_path, app_path, live_area_path.string() + "/contents/" + bg_name);
-
-                            if (buffer.empty()) {
-                                if (is_ps_app || is_sys_app)
-                                    LOG_WARN("background, Id: {}, Name: '{}', Not found for title: {} [{}].", item.first, bg_name, app_path, APP_INDEX->title);
-                                continue;
-                            }
-                            stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                            if (!data) {
-                                LOG_ERROR("Frame: {}, Invalid Live Area Contents for title: {} [{}].", item.first, app_path, APP_INDEX->title);
-                                continue;
-                            }
-
-                            items[app_path][item.first]["background"]["size"] = ImVec2(float(width), float(height));
-                            gui.live_items[app_path][item.first]["background"][pos].init(gui.imgui_state.get(), data, width, height);
-                            stbi_image_free(data);
+                            auto [device, path] = contents_source(bg_name);
+                            layout.images.push_back({ item.first, "background", size_t(pos), device, std::move(path), warn_missing });
                         }
                     }
 
@@ -479,35 +587,18 @@ void init_live_area(GuiState &gui, EmuEnvState &emuenv, const std::string app_pa
                                 img_name.erase(remove(img_name.begin(), img_name.end(), '\n'), img_name.end());
                             img_name.erase(remove_if(img_name.begin(), img_name.end(), isspace), img_name.end());
 
-                            int32_t width = 0;
-                            int32_t height = 0;
-                            vfs::FileBuffer buffer;
-
-                            if (app_device == VitaIoDevice::vs0)
-                                vfs::read_file(VitaIoDevice::vs0, buffer, emuenv.pref_path, "app/" + app_path + "/sce_sys/livearea/contents/" + img_name);
-                            else
-                                vfs::read_app_file(buffer, emuenv.pref_path, app_path, live_area_path.string() + "/contents/" + img_name);
-
-                            if (buffer.empty()) {
-                                if (is_ps_app || is_sys_app)
-                                    LOG_WARN("Image, Id: {} Name: '{}', Not found for title {} [{}].", item.first, img_name, app_path, APP_INDEX->title);
-                                continue;
-                            }
-                            stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                            if (!data) {
-                                LOG_ERROR("Frame: {}, Invalid Live Area Contents for title: {} [{}].", item.first, app_path, APP_INDEX->title);
-                                continue;
-                            }
-
-                            items[app_path][item.first]["image"]["size"] = ImVec2(float(width), float(height));
-                            gui.live_items[app_path][item.first]["image"][pos].init(gui.imgui_state.get(), data, width, height);
-                            stbi_image_free(data);
+                            auto [device, path] = contents_source(img_name);
+                            layout.images.push_back({ item.first, "image", size_t(pos), device, std::move(path), warn_missing });
                         }
                     }
                 }
             }
         }
+
+        layouts[app_path] = std::move(layout);
     }
+    request_live_area_images(gui, emuenv, app_path);
+
     if (type[app_path].empty())
         type[app_path] = "a1";
 }
@@ -525,10 +616,10 @@ void open_search(const std::string title) {
 }
 
 void update_app(GuiState &gui, EmuEnvState &emuenv, const std::string app_path) {
-    if (gui.live_area_contents.contains(app_path))
-        gui.live_area_contents.erase(app_path);
-    if (gui.live_items.contains(app_path))
-        gui.live_items.erase(app_path);
+    // the template may have changed with the update
+    release_live_area(gui, app_path);
+    gui.live_area_image_loader.recent.remove(app_path);
+    layouts.erase(app_path);
 
     init_user_app(gui, emuenv, app_path);
     save_apps_cache(gui, emuenv);
@@ -71,6 +71,7 @@ static void draw_debug_menu(DebugMenuState &state) {
         ImGui::MenuItem("Event Flags", nullptr, &state.eventflags_dialog);
         ImGui::MenuItem("Memory Allocations", nullptr, &state.allocations_dialog);
         ImGui::MenuItem("Disassembly", nullptr, &state.disassembly_dialog);
+        ImGui::MenuItem("HLE Functions", nullptr, &state.import_stats_dialog);
         ImGui::EndMenu();
     }
 }
@@ -26,39 +26,38 @@ namespace gui {
 
 void draw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Mutexes", &gui.debug_menu.mutexes_dialog);
-    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s   %-16s   %-16s", "ID", "Mutex Name", "Status", "Attributes", "Waiting Threads", "Owner");
+    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s   %-16s   %-11s   %-16s", "ID", "Mutex Name", "Status", "Attributes", "Waiting Threads", "Contentions", "Owner");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-
-    for (const auto &mutex : emuenv.kernel.mutexes) {
-        std::shared_ptr<Mutex> mutex_state = mutex.second;
-        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d            %02zu                 %s",
-            mutex.first,
+    emuenv.kernel.mutexes.for_each([&](SceUID uid, const std::shared_ptr<Mutex> &mutex_state) {
+        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d            %02zu                 %-11u   %s",
+            uid,
             mutex_state->name,
             mutex_state->lock_count,
             mutex_state->attr,
             mutex_state->waiting_threads->size(),
+            mutex_state->contention_count.load(),
             mutex_state->owner == nullptr ? "not owned" : mutex_state->owner->name.c_str());
-    }
+    });
     ImGui::End();
 }
 
 void draw_lw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Lightweight Mutexes", &gui.debug_menu.lwmutexes_dialog);
-    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s  %-16s   %-16s", "ID", "LwMutex Name", "Status", "Attributes", "Waiting Threads", "Owner");
-
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
+    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s  %-16s   %-11s   %-16s", "ID", "LwMutex Name", "Status", "Attributes", "Waiting Threads", "Contentions", "Owner");
 
-    for (const auto &mutex : emuenv.kernel.lwmutexes) {
-        std::shared_ptr<Mutex> mutex_state = mutex.second;
-        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d           %02zu                 %s",
-            mutex.first,
+    emuenv.kernel.lwmutexes.for_each([&](SceUID uid, const std::shared_ptr<Mutex> &mutex_state) {
+        // The state of lightweight mutexes is kept in their work area
+        const SceKernelLwMutexWork *workarea = mutex_state->workarea.get(emuenv.mem);
+        const ThreadStatePtr owner = emuenv.kernel.get_thread(static_cast<SceUID>(workarea->owner & ~LW_MUTEX_OWNER_WAITERS));
+        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d           %02zu                 %-11u   %s",
+            uid,
             mutex_state->name,
-            mutex_state->lock_count,
+            workarea->lockCount,
             mutex_state->attr,
             mutex_state->waiting_threads->size(),
-            mutex_state->owner == nullptr ? "not owned" : mutex_state->owner->name.c_str());
-    }
+            mutex_state->contention_count.load(),
+            owner == nullptr ? "not owned" : owner->name.c_str());
+    });
     ImGui::End();
 }
 
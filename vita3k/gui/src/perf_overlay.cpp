@@ -17,7 +17,13 @@
 
 #include "private.h"
 
+#include <audio/state.h>
 #include <config/state.h>
+#include <net/state.h>
+#include <ngs/state.h>
+#include <renderer/state.h>
+
+#include <algorithm>
 
 namespace gui {
 static const ImVec2 PERF_OVERLAY_PAD = ImVec2(12.f, 12.f);
@@ -45,7 +51,7 @@ static ImVec2 get_perf_pos(ImVec2 window_size, EmuEnvState &emuenv) {
 
 static float get_perf_height(EmuEnvState &emuenv) {
     switch (emuenv.cfg.performance_overlay_detail) {
-    case MAXIMUM: return 138.f;
+    case MAXIMUM: return 490.f;
     case MEDIUM: return 80.f;
     case LOW:
     case MINIMUM:
@@ -59,7 +65,8 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     auto lang = gui.lang.performance_overlay;
     const auto MAIN_WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 95.5f : 152.f) * emuenv.dpi_scale, get_perf_height(emuenv) * emuenv.dpi_scale);
     const auto WINDOW_POS = get_perf_pos(MAIN_WINDOW_SIZE, emuenv);
-    const auto WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 72.5f : 130.f) * emuenv.dpi_scale, (emuenv.cfg.performance_overlay_detail <= LOW ? 35.f : 58.f) * emuenv.dpi_scale);
+    const auto WINDOW_HEIGHT = emuenv.cfg.performance_overlay_detail <= LOW ? 35.f : (emuenv.cfg.performance_overlay_detail == MAXIMUM ? 410.f : 58.f);
+    const auto WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 72.5f : 130.f) * emuenv.dpi_scale, WINDOW_HEIGHT * emuenv.dpi_scale);
 
     ImGui::SetNextWindowSize(MAIN_WINDOW_SIZE);
     ImGui::SetNextWindowPos(WINDOW_POS);
@@ -78,13 +85,65 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Separator();
         ImGui::Text("%s: %d %s: %d", lang["min"].c_str(), emuenv.min_fps, lang["max"].c_str(), emuenv.max_fps);
     }
+    if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
+        ImGui::Separator();
+        ImGui::Text("%s: %llu %s", lang["exclusive_fails"].c_str(), static_cast<unsigned long long>(emuenv.exclusive_store_failures), emuenv.exclusive_store_failures_thread.c_str());
+        ImGui::Separator();
+        ImGui::Text("%s: %llu %s: %llu us", lang["interpreter"].c_str(), static_cast<unsigned long long>(emuenv.interpreter_fallbacks), lang["time"].c_str(), static_cast<unsigned long long>(emuenv.interpreter_fallback_time_us));
+        ImGui::Separator();
+        ImGui::Text("%s: %u/%u/%u%%", lang["guest_time"].c_str(), emuenv.guest_jit_percent, emuenv.guest_hle_percent, emuenv.guest_blocked_percent);
+        ImGui::Separator();
+        ImGui::Text("%s: %u", lang["pipeline_collisions"].c_str(), emuenv.renderer->pipeline_key_collisions);
+        ImGui::Separator();
+        ImGui::Text("%s: %u", lang["ring_stalls"].c_str(), emuenv.renderer->ring_buffer_stalls);
+        ImGui::Separator();
+        ImGui::Text("%s: %u/%u", lang["state_sets"].c_str(), emuenv.renderer->state_set_commands_pushed.load(), emuenv.renderer->state_set_commands_filtered.load());
+        ImGui::Separator();
+        // GPU time of a scene on average and of the presentation of a frame, only measured if the backend supports timestamp queries
+        ImGui::Text("%s: %.2f/%.2f ms %u%% %s", lang["gpu_time"].c_str(), emuenv.gpu_scene_ms, emuenv.gpu_present_ms, emuenv.gpu_busy_percent, lang["busy"].c_str());
+        ImGui::Separator();
+        // the GPU memory is only known by the Vulkan backend, in MiB
+        const auto to_mib = [](const std::atomic<uint64_t> &bytes) { return static_cast<unsigned>(bytes.load() >> 20); };
+        ImGui::Text("%s: %u/%u MB %s: %u MB", lang["gpu_memory"].c_str(), to_mib(emuenv.renderer->gpu_memory_usage), to_mib(emuenv.renderer->gpu_memory_budget),
+            lang["evicted"].c_str(), to_mib(emuenv.renderer->gpu_memory_evicted));
+        ImGui::Text("%s: %u/%u/%u MB %u%% %s", lang["gpu_memory_pools"].c_str(), to_mib(emuenv.renderer->gpu_memory_textures), to_mib(emuenv.renderer->gpu_memory_surfaces),
+            to_mib(emuenv.renderer->gpu_memory_staging), emuenv.renderer->gpu_memory_fragmentation.load(), lang["unused"].c_str());
+        // texture cache figures of the last frame, the uploads in KiB
+        ImGui::Text("%s: %u%% %s: %u KB %s: %u", lang["textures"].c_str(), emuenv.renderer->texture_cache_hit_rate.load(), lang["uploaded"].c_str(),
+            static_cast<unsigned>(emuenv.renderer->texture_upload_bytes.load() >> 10), lang["evicted"].c_str(), emuenv.renderer->texture_evictions.load());
+        ImGui::Text("%s: %u %s: %u%%", lang["samplers"].c_str(), emuenv.renderer->sampler_count.load(), lang["hits"].c_str(), emuenv.renderer->sampler_cache_hit_rate.load());
+        ImGui::Separator();
+        ImGui::Text("%s: %.1f ms %s: %u", lang["audio_latency"].c_str(), emuenv.audio.get_latency_ms(), lang["underruns"].c_str(), emuenv.audio.underruns.load());
+        ImGui::Separator();
+        // the NGS figures are sums over the last second, the budget is the duration of the audio the updates produced
+        const ngs::ProfileSnapshot ngs_profile = emuenv.ngs.profile.get_snapshot();
+        ImGui::Text("%s: %.0f%% %s: %.0f us", lang["ngs"].c_str(), ngs_profile.budget_usage * 100.f, lang["ngs_voice"].c_str(), ngs_profile.voice_us);
+        ImGui::Text("%s: %.1f/%.1f/%.1f/%.1f ms", lang["ngs_stages"].c_str(), ngs_profile.stage_ms[ngs::PROFILE_DECODE], ngs_profile.stage_ms[ngs::PROFILE_RESAMPLE],
+            ngs_profile.stage_ms[ngs::PROFILE_MIX], ngs_profile.stage_ms[ngs::PROFILE_CALLBACK]);
+        const auto costliest_module = std::max_element(ngs_profile.module_ms.begin(), ngs_profile.module_ms.end());
+        ImGui::Text("%s: %.1f ms", ngs::get_buss_type_name(static_cast<ngs::BussType>(costliest_module - ngs_profile.module_ms.begin())), *costliest_module);
+        ImGui::Separator();
+        // packets per second, and how many datagrams a host reception gets with the time they wait before the guest reads them
+        const NetStatsSnapshot net_stats = emuenv.net.stats.get_snapshot();
+        ImGui::Text("%s: %.0f/%.0f %s: %.1f %.0f us", lang["net_packets"].c_str(), net_stats.packets_received, net_stats.packets_sent,
+            lang["net_batch"].c_str(), net_stats.datagrams_per_reception, net_stats.datagram_wait_us);
+        ImGui::Separator();
+        // CPU time of the render thread by phase of the draws per frame processed during the last second, in microseconds
+        const renderer::DrawProfileSnapshot draw_profile = emuenv.renderer->draw_profile.get_snapshot();
+        ImGui::Text("%s: %.0f/%.0f/%.0f/%.0f us", lang["draw_textures"].c_str(), draw_profile.stage_us[renderer::DRAW_PROFILE_TEXTURE_HASH],
+            draw_profile.stage_us[renderer::DRAW_PROFILE_TEXTURE_DECODE], draw_profile.stage_us[renderer::DRAW_PROFILE_TEXTURE_UPLOAD], draw_profile.stage_us[renderer::DRAW_PROFILE_SET_STATE]);
+        ImGui::Text("%s: %.0f/%.0f/%.0f/%.0f us", lang["draw_stages"].c_str(), draw_profile.stage_us[renderer::DRAW_PROFILE_PIPELINE],
+            draw_profile.stage_us[renderer::DRAW_PROFILE_DESCRIPTORS], draw_profile.stage_us[renderer::DRAW_PROFILE_VERTEX_INDEX], draw_profile.stage_us[renderer::DRAW_PROFILE_RECORD]);
+        ImGui::Text("%s: %.0f %s: %.0f %s: %.0f %.0f KB", lang["draws"].c_str(), draw_profile.draws, lang["draw_states"].c_str(), draw_profile.state_changes,
+            lang["uploaded"].c_str(), draw_profile.texture_uploads, draw_profile.upload_bytes / 1024.f);
+    }
     ImGui::PopFont();
     ImGui::EndChild();
     ImGui::PopStyleVar();
     ImGui::PopStyleColor();
     if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
         ImGui::SetCursorPosY(ImGui::GetCursorPosY() - (5.f * emuenv.dpi_scale));
-        ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), WINDOW_SIZE);
+        ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), ImVec2(WINDOW_SIZE.x, 58.f * emuenv.dpi_scale));
     }
     ImGui::End();
     ImGui::PopStyleVar();
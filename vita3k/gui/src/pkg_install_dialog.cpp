@@ -27,6 +27,7 @@
 #include <util/log.h>
 #include <util/string_utils.h>
 
+#include <chrono>
 #include <thread>
 
 namespace gui {
@@ -36,6 +37,8 @@ static std::filesystem::path work_path = "";
 static std::string state, title, zRIF;
 static bool draw_file_dialog = true;
 static bool delete_pkg_file, delete_work_file;
+// average speed of the last install, in MB/s of the pkg file
+static std::atomic<float> install_speed = 0.f;
 
 void draw_pkg_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
     host::dialog::filesystem::Result result = host::dialog::filesystem::Result::CANCEL;
@@ -125,7 +128,13 @@ void draw_pkg_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 state = "install";
         } else if (state == "install") {
             std::thread installation([&emuenv]() {
+                const auto install_start = std::chrono::steady_clock::now();
                 if (install_pkg(pkg_path.string(), emuenv, zRIF, progress_callback)) {
+                    const double install_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - install_start).count();
+                    const double pkg_size_mb = static_cast<double>(fs::file_size(fs::path(pkg_path.wstring()))) / (1024.0 * 1024.0);
+                    const float speed = install_seconds > 0.0 ? static_cast<float>(pkg_size_mb / install_seconds) : 0.f;
+                    LOG_INFO("Installed {:.1f} MB in {:.1f} s ({:.1f} MB/s)", pkg_size_mb, install_seconds, speed);
+                    install_speed = speed;
                     std::lock_guard<std::mutex> lock(install_mutex);
                     state = "success";
                 } else {
@@ -140,6 +149,7 @@ void draw_pkg_install_dialog(GuiState &gui, EmuEnvState &emuenv) {
             ImGui::TextColored(GUI_COLOR_TEXT, "%s [%s]", emuenv.app_info.app_title.c_str(), emuenv.app_info.app_title_id.c_str());
             if (emuenv.app_info.app_category.find("gp") != std::string::npos)
                 ImGui::TextColored(GUI_COLOR_TEXT, "%s %s", lang["update_app"].c_str(), emuenv.app_info.app_version.c_str());
+            ImGui::TextColored(GUI_COLOR_TEXT, "%s: %.1f MB/s", lang["install_speed"].c_str(), install_speed.load());
             ImGui::Spacing();
             ImGui::Separator();
             ImGui::Spacing();
@@ -25,17 +25,14 @@ void draw_semaphores_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Semaphores", &gui.debug_menu.semaphores_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-16s   %-16s", "ID", "Semaphore Name", "Status", "Locked Threads");
 
-    const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-
-    for (const auto &semaphore : emuenv.kernel.semaphores) {
-        std::shared_ptr<Semaphore> sema_state = semaphore.second;
+    emuenv.kernel.semaphores.for_each([&](SceUID uid, const std::shared_ptr<Semaphore> &sema_state) {
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d/%02d              %02zu",
-            semaphore.first,
+            uid,
             sema_state->name,
             sema_state->val,
             sema_state->max,
             sema_state->waiting_threads->size());
-    }
+    });
     ImGui::End();
 }
 
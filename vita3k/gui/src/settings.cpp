@@ -817,8 +817,7 @@ void draw_settings(GuiState &gui, EmuEnvState &emuenv) {
                             }
                             const auto live_area_state = get_app_open_list_index(gui, "NPXS10015") != gui.apps_list_opened.end();
                             gui.apps_list_opened.clear();
-                            gui.live_area_contents.clear();
-                            gui.live_items.clear();
+                            clear_live_areas(gui);
                             init_notice_info(gui, emuenv);
                             if (live_area_state) {
                                 update_apps_list_opened(gui, emuenv, "NPXS10015");
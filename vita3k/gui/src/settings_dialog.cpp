@@ -40,11 +40,14 @@
 #include <util/fs.h>
 #include <util/log.h>
 #include <util/string_utils.h>
+#include <util/tracy_zones.h>
 
 #include <SDL.h>
 
 #include <algorithm>
+#include <map>
 #include <pugixml.hpp>
+#include <set>
 #include <sstream>
 
 namespace gui {
@@ -121,6 +124,105 @@ static void change_emulator_path(GuiState &gui, EmuEnvState &emuenv) {
 
 static CPUBackend config_cpu_backend;
 
+// Custom config parsed from the file of an app, the file is parsed again once its size or its last write time changes
+struct CustomConfigCache {
+    uintmax_t size = 0;
+    std::time_t time = 0;
+    Config::CurrentConfig config;
+};
+
+static std::map<std::string, CustomConfigCache> custom_configs;
+
+static bool parse_custom_config(const fs::path &custom_config_path, Config::CurrentConfig &custom) {
+    pugi::xml_document custom_config_xml;
+    if (!custom_config_xml.load_file(custom_config_path.c_str()) || custom_config_xml.child("config").empty())
+        return false;
+
+    // Config
+    const auto config_child = custom_config_xml.child("config");
+
+    // Load Core Config
+    if (!config_child.child("core").empty()) {
+        const auto core_child = config_child.child("core");
+        custom.modules_mode = core_child.attribute("modules-mode").as_int();
+        for (auto &m : core_child.child("lle-modules"))
+            custom.lle_modules.push_back(m.text().as_string());
+    }
+
+    // Load CPU Config
+    if (!config_child.child("cpu").empty()) {
+        const auto cpu_child = config_child.child("cpu");
+        custom.cpu_backend = cpu_child.attribute("cpu-backend").as_string();
+        custom.cpu_opt = cpu_child.attribute("cpu-opt").as_bool();
+        custom.cpu_opt_profile = cpu_child.attribute("cpu-opt-profile").as_int(CPU_OPT_SAFE);
+    }
+
+    // Load GPU Config
+    if (!config_child.child("gpu").empty()) {
+        const auto gpu_child = config_child.child("gpu");
+        custom.resolution_multiplier = gpu_child.attribute("resolution-multiplier").as_int();
+        custom.disable_surface_sync = gpu_child.attribute("disable-surface-sync").as_bool();
+        custom.enable_fxaa = gpu_child.attribute("enable-fxaa").as_bool();
+        custom.v_sync = gpu_child.attribute("v-sync").as_bool();
+        custom.vblank_rate_multiplier = gpu_child.attribute("vblank-rate-multiplier").as_int(1);
+        custom.scale_process_time = gpu_child.attribute("scale-process-time").as_bool();
+        custom.frame_skip = gpu_child.attribute("frame-skip").as_int();
+        custom.anisotropic_filtering = gpu_child.attribute("anisotropic-filtering").as_int();
+    }
+
+    // Load System Config
+    const auto system_child = config_child.child("system");
+    if (!system_child.empty())
+        custom.pstv_mode = system_child.attribute("pstv-mode").as_bool();
+
+    // Load Emulator Config
+    if (!config_child.child("emulator").empty()) {
+        const auto emulator_child = config_child.child("emulator");
+        custom.ngs_enable = emulator_child.attribute("enable-ngs").as_bool();
+    }
+
+    // Load Network Config
+    if (!config_child.child("network").empty()) {
+        const auto network_child = config_child.child("network");
+        custom.psn_status = network_child.attribute("psn-status").as_int();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find the custom config of an app, parsed once and kept until its file changes
+ *
+ * @param emuenv State of the emulated PlayStation Vita environment
+ * @param app_path Path to the app or game to get the custom config for
+ * @return The settings of the custom config of the app, null if it has none or if it's corrupted or invalid.
+ */
+static const Config::CurrentConfig *find_custom_config(EmuEnvState &emuenv, const std::string &app_path) {
+    const auto CUSTOM_CONFIG_PATH{ fs::path(emuenv.base_path) / "config" / fmt::format("config_{}.xml", app_path) };
+
+    boost::system::error_code error;
+    const auto size = fs::file_size(CUSTOM_CONFIG_PATH, error);
+    const auto time = error ? 0 : fs::last_write_time(CUSTOM_CONFIG_PATH, error);
+    if (error) {
+        custom_configs.erase(app_path);
+        return nullptr;
+    }
+
+    const auto cached = custom_configs.find(app_path);
+    if ((cached != custom_configs.end()) && (cached->second.size == size) && (cached->second.time == time))
+        return &cached->second.config;
+
+    CustomConfigCache custom_config{ size, time };
+    if (!parse_custom_config(CUSTOM_CONFIG_PATH, custom_config.config)) {
+        LOG_ERROR("Custom config XML found is corrupted or invalid in path: {}", CUSTOM_CONFIG_PATH.string());
+        fs::remove(CUSTOM_CONFIG_PATH);
+        custom_configs.erase(app_path);
+        return nullptr;
+    }
+
+    return &(custom_configs[app_path] = std::move(custom_config)).config;
+}
+
 /**
  * @brief Set up `config` with the values contained in the custom config file of a certain PlayStation Vita application
  *
@@ -136,66 +238,12 @@ static CPUBackend config_cpu_backend;
  * but it's corrupted or invalid.
  */
 static bool get_custom_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
-    const auto CUSTOM_CONFIG_PATH{ fs::path(emuenv.base_path) / "config" / fmt::format("config_{}.xml", app_path) };
-
-    if (fs::exists(CUSTOM_CONFIG_PATH)) {
-        pugi::xml_document custom_config_xml;
-        if (custom_config_xml.load_file(CUSTOM_CONFIG_PATH.c_str()) && !custom_config_xml.child("config").empty()) {
-            config = {};
-            // Config
-            const auto config_child = custom_config_xml.child("config");
-
-            // Load Core Config
-            if (!config_child.child("core").empty()) {
-                const auto core_child = config_child.child("core");
-                config.modules_mode = core_child.attribute("modules-mode").as_int();
-                for (auto &m : core_child.child("lle-modules"))
-                    config.lle_modules.push_back(m.text().as_string());
-            }
-
-            // Load CPU Config
-            if (!config_child.child("cpu").empty()) {
-                const auto cpu_child = config_child.child("cpu");
-                config.cpu_backend = cpu_child.attribute("cpu-backend").as_string();
-                config.cpu_opt = cpu_child.attribute("cpu-opt").as_bool();
-            }
-
-            // Load GPU Config
-            if (!config_child.child("gpu").empty()) {
-                const auto gpu_child = config_child.child("gpu");
-                config.resolution_multiplier = gpu_child.attribute("resolution-multiplier").as_int();
-                config.disable_surface_sync = gpu_child.attribute("disable-surface-sync").as_bool();
-                config.enable_fxaa = gpu_child.attribute("enable-fxaa").as_bool();
-                config.v_sync = gpu_child.attribute("v-sync").as_bool();
-                config.anisotropic_filtering = gpu_child.attribute("anisotropic-filtering").as_int();
-            }
-
-            // Load System Config
-            const auto system_child = config_child.child("system");
-            if (!system_child.empty())
-                config.pstv_mode = system_child.attribute("pstv-mode").as_bool();
-
-            // Load Emulator Config
-            if (!config_child.child("emulator").empty()) {
-                const auto emulator_child = config_child.child("emulator");
-                config.ngs_enable = emulator_child.attribute("enable-ngs").as_bool();
-            }
+    const auto custom_config = find_custom_config(emuenv, app_path);
+    if (!custom_config)
+        return false;
 
-            // Load Network Config
-            if (!config_child.child("network").empty()) {
-                const auto network_child = config_child.child("network");
-                config.psn_status = network_child.attribute("psn-status").as_int();
-            }
-
-            return true;
-        } else {
-            LOG_ERROR("Custom config XML found is corrupted or invalid in path: {}", CUSTOM_CONFIG_PATH.string());
-            fs::remove(CUSTOM_CONFIG_PATH);
-            return false;
-        }
-    }
-
-    return false;
+    config = *custom_config;
+    return true;
 }
 
 static CPUBackend set_cpu_backend(std::string &cpu_backend) {
@@ -217,12 +265,16 @@ void init_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path
     if (!get_custom_config(gui, emuenv, app_path)) {
         config.cpu_backend = emuenv.cfg.cpu_backend;
         config.cpu_opt = emuenv.cfg.cpu_opt;
+        config.cpu_opt_profile = emuenv.cfg.cpu_opt_profile;
         config.modules_mode = emuenv.cfg.modules_mode;
         config.lle_modules = emuenv.cfg.lle_modules;
         config.resolution_multiplier = emuenv.cfg.resolution_multiplier;
         config.disable_surface_sync = emuenv.cfg.disable_surface_sync;
         config.enable_fxaa = emuenv.cfg.enable_fxaa;
         config.v_sync = emuenv.cfg.v_sync;
+        config.vblank_rate_multiplier = emuenv.cfg.vblank_rate_multiplier;
+        config.scale_process_time = emuenv.cfg.scale_process_time;
+        config.frame_skip = emuenv.cfg.frame_skip;
         config.anisotropic_filtering = emuenv.cfg.anisotropic_filtering;
         config.pstv_mode = emuenv.cfg.pstv_mode;
         config.ngs_enable = emuenv.cfg.ngs_enable;
@@ -273,6 +325,7 @@ static void save_config(GuiState &gui, EmuEnvState &emuenv) {
         auto cpu_child = config_child.append_child("cpu");
         cpu_child.append_attribute("cpu-backend") = config.cpu_backend.c_str();
         cpu_child.append_attribute("cpu-opt") = config.cpu_opt;
+        cpu_child.append_attribute("cpu-opt-profile") = config.cpu_opt_profile;
 
         // GPU
         auto gpu_child = config_child.append_child("gpu");
@@ -280,6 +333,9 @@ static void save_config(GuiState &gui, EmuEnvState &emuenv) {
         gpu_child.append_attribute("disable-surface-sync") = config.disable_surface_sync;
         gpu_child.append_attribute("enable-fxaa") = config.enable_fxaa;
         gpu_child.append_attribute("v-sync") = config.v_sync;
+        gpu_child.append_attribute("vblank-rate-multiplier") = config.vblank_rate_multiplier;
+        gpu_child.append_attribute("scale-process-time") = config.scale_process_time;
+        gpu_child.append_attribute("frame-skip") = config.frame_skip;
         gpu_child.append_attribute("anisotropic-filtering") = config.anisotropic_filtering;
 
         // System
@@ -294,12 +350,15 @@ static void save_config(GuiState &gui, EmuEnvState &emuenv) {
         auto network_child = config_child.append_child("network");
         network_child.append_attribute("psn-status") = config.psn_status;
 
+        // the file can be written again within the resolution of its write time
+        custom_configs.erase(emuenv.app_path);
         const auto save_xml = custom_config_xml.save_file(CUSTOM_CONFIG_PATH.c_str());
         if (!save_xml)
             LOG_ERROR("Failed to save custom config xml for app path: {}, in path: {}", emuenv.app_path, CONFIG_PATH.string());
     } else {
         emuenv.cfg.cpu_backend = config.cpu_backend;
         emuenv.cfg.cpu_opt = config.cpu_opt;
+        emuenv.cfg.cpu_opt_profile = config.cpu_opt_profile;
         emuenv.cfg.modules_mode = config.modules_mode;
         emuenv.cfg.lle_modules = config.lle_modules;
         emuenv.cfg.pstv_mode = config.pstv_mode;
@@ -307,6 +366,9 @@ static void save_config(GuiState &gui, EmuEnvState &emuenv) {
         emuenv.cfg.disable_surface_sync = config.disable_surface_sync;
         emuenv.cfg.enable_fxaa = config.enable_fxaa;
         emuenv.cfg.v_sync = config.v_sync;
+        emuenv.cfg.vblank_rate_multiplier = config.vblank_rate_multiplier;
+        emuenv.cfg.scale_process_time = config.scale_process_time;
+        emuenv.cfg.frame_skip = config.frame_skip;
         emuenv.cfg.anisotropic_filtering = config.anisotropic_filtering;
         emuenv.cfg.ngs_enable = config.ngs_enable;
         emuenv.cfg.psn_status = config.psn_status;
@@ -315,10 +377,48 @@ static void save_config(GuiState &gui, EmuEnvState &emuenv) {
 }
 
 std::string get_cpu_backend(GuiState &gui, EmuEnvState &emuenv, const std::string app_path) {
-    if (!get_custom_config(gui, emuenv, app_path))
-        return emuenv.cfg.cpu_backend;
+    // read from the cache, the config edited by the settings dialog is left as it is
+    const auto custom_config = find_custom_config(emuenv, app_path);
+    return custom_config ? custom_config->cpu_backend : emuenv.cfg.cpu_backend;
+}
+
+// apps with a custom config file, listed again once the last write time of the config directory changes
+static std::set<std::string> custom_config_apps;
+static std::time_t custom_config_dir_time = -1;
+static int custom_config_dir_frame = -1;
 
-    return config.cpu_backend;
+bool has_custom_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    // the directory is only checked once per frame, for all the apps drawn
+    if (custom_config_dir_frame != ImGui::GetFrameCount()) {
+        custom_config_dir_frame = ImGui::GetFrameCount();
+
+        const auto CONFIG_PATH{ fs::path(emuenv.base_path) / "config" };
+        boost::system::error_code error;
+        const auto time = fs::is_directory(CONFIG_PATH, error) ? fs::last_write_time(CONFIG_PATH, error) : -1;
+        if (error || (time != custom_config_dir_time)) {
+            custom_config_dir_time = error ? -1 : time;
+            custom_config_apps.clear();
+            if (custom_config_dir_time != -1) {
+                for (const auto &file : fs::directory_iterator(CONFIG_PATH, error)) {
+                    const auto name = file.path().filename().string();
+                    if (name.starts_with("config_") && name.ends_with(".xml"))
+                        custom_config_apps.insert(name.substr(7, name.size() - 11));
+                }
+            }
+        }
+    }
+
+    return custom_config_apps.contains(app_path);
+}
+
+// The unsafe optimizations only break some games, the ones known to be playable are assumed to not depend on them
+static bool use_unsafe_cpu_opt(GuiState &gui, int cpu_opt_profile, const std::string &app_path) {
+    if (cpu_opt_profile != CPU_OPT_AUTOMATIC)
+        return cpu_opt_profile == CPU_OPT_FAST;
+
+    const auto app = get_app_index(gui, app_path);
+    const auto &apps = app_path.find("NPXS") != std::string::npos ? gui.app_selector.sys_apps : gui.app_selector.user_apps;
+    return (app != apps.end()) && (app->compat == Playable);
 }
 
 static void set_vsync_state(const bool &state) {
@@ -351,6 +451,7 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
         // Else inherit the values from the global emulator config
         emuenv.cfg.current_config.cpu_backend = emuenv.cfg.cpu_backend;
         emuenv.cfg.current_config.cpu_opt = emuenv.cfg.cpu_opt;
+        emuenv.cfg.current_config.cpu_opt_profile = emuenv.cfg.cpu_opt_profile;
         emuenv.cfg.current_config.modules_mode = emuenv.cfg.modules_mode;
         emuenv.cfg.current_config.lle_modules = emuenv.cfg.lle_modules;
         emuenv.cfg.current_config.pstv_mode = emuenv.cfg.pstv_mode;
@@ -358,6 +459,9 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
         emuenv.cfg.current_config.disable_surface_sync = emuenv.cfg.disable_surface_sync;
         emuenv.cfg.current_config.enable_fxaa = emuenv.cfg.enable_fxaa;
         emuenv.cfg.current_config.v_sync = emuenv.cfg.v_sync;
+        emuenv.cfg.current_config.vblank_rate_multiplier = emuenv.cfg.vblank_rate_multiplier;
+        emuenv.cfg.current_config.scale_process_time = emuenv.cfg.scale_process_time;
+        emuenv.cfg.current_config.frame_skip = emuenv.cfg.frame_skip;
         emuenv.cfg.current_config.anisotropic_filtering = emuenv.cfg.anisotropic_filtering;
         emuenv.cfg.current_config.ngs_enable = emuenv.cfg.ngs_enable;
         emuenv.cfg.current_config.psn_status = emuenv.cfg.psn_status;
@@ -381,11 +485,15 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
 
     emuenv.renderer->res_multiplier = emuenv.cfg.current_config.resolution_multiplier;
     emuenv.renderer->set_anisotropic_filtering(emuenv.cfg.current_config.anisotropic_filtering);
+    emuenv.display.vblank_rate_multiplier = std::clamp(emuenv.cfg.current_config.vblank_rate_multiplier, 1, 4);
 
     // No change it if app already running
     if (emuenv.io.title_id.empty()) {
         emuenv.kernel.cpu_backend = set_cpu_backend(emuenv.cfg.current_config.cpu_backend);
         emuenv.kernel.cpu_opt = emuenv.cfg.current_config.cpu_opt;
+        emuenv.kernel.cpu_unsafe_opt = use_unsafe_cpu_opt(gui, emuenv.cfg.current_config.cpu_opt_profile, app_path);
+        // the process time can't jump once the app runs
+        emuenv.kernel.process_time_scale = emuenv.cfg.current_config.scale_process_time ? emuenv.display.vblank_rate_multiplier.load() : 1;
         emuenv.audio.set_backend(emuenv.cfg.audio_backend);
     }
 }
@@ -484,6 +592,12 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
             ImGui::Checkbox("Enable optimizations", &config.cpu_opt);
             if (ImGui::IsItemHovered())
                 ImGui::SetTooltip("Check the box to enable additional CPU JIT optimizations.");
+            if (config.cpu_opt) {
+                static const char *LIST_CPU_OPT_PROFILE[] = { "Automatic", "Safe", "Fast" };
+                ImGui::Combo("Optimization profile", &config.cpu_opt_profile, LIST_CPU_OPT_PROFILE, IM_ARRAYSIZE(LIST_CPU_OPT_PROFILE));
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("Fast also enables unsafe floating point optimizations, which break some games.\nAutomatic uses it for the games playable in the compatibility database.");
+            }
         }
         ImGui::EndTabItem();
     } else
@@ -528,6 +642,18 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 ImGui::SetTooltip("Disabling V-Sync can fix the speed issue in some games.\nIt is recommended to keep it enabled to avoid visual tearing.");
         }
         ImGui::Spacing();
+        ImGui::SliderInt("Vblank rate multiplier", &config.vblank_rate_multiplier, 1, 4, "x%d");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Makes the vblanks of the Vita this many times faster.\nTo be used with the frame rate patches of the games locked to the vblank rate, other games will run too fast.");
+        ImGui::SameLine();
+        ImGui::Checkbox("Scale process time", &config.scale_process_time);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Speeds up the process time of the game with the vblank rate, for the games which time their frames with it.\nApplied when the game starts.");
+        ImGui::Spacing();
+        ImGui::SliderInt("Frame skip", &config.frame_skip, 0, 4, config.frame_skip ? "%d" : "Off");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("When the GPU is a frame behind the game, the scenes of the next frame are not drawn\nso the game keeps its full speed, at most this many frames in a row.\nThe frames skipped are not displayed.");
+        ImGui::Spacing();
         ImGui::Checkbox("Enable anti-aliasing (FXAA)", &config.enable_fxaa);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Anti-aliasing is a technique for smoothing out jagged edges.\n FXAA comes at almost no performance cost but makes games look slightly blurry.");
@@ -638,6 +764,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                                   "and not all GPUs are compatible with this.");
             }
         }
+        ImGui::Checkbox("Optimize shaders", &emuenv.cfg.optimize_shaders);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Check the box to optimize the generated shaders before caching them.\nThey are translated again with a new cache, and the GPU runs them faster.\nRequires a restart of the game and a build with the SPIR-V optimizer.");
         const auto shaders_cache_path{ fs::path(emuenv.base_path) / "cache/shaders" };
         if (fs::exists(shaders_cache_path) && !fs::is_empty(shaders_cache_path)) {
             ImGui::Spacing();
@@ -684,6 +813,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
             emuenv.cfg.audio_backend = LIST_BACKEND_AUDIO[audio_backend_idx];
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Select your preferred audio backend.");
+        ImGui::SliderInt("Audio Latency", &emuenv.cfg.audio_latency, 0, 100, emuenv.cfg.audio_latency == 0 ? "Default" : "%d ms");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Latency the host audio streams are opened with, lower values can crackle on slow hosts.\nThe measured latency and the underruns are shown in the maximum performance overlay.\nRequires a restart of the emulator.");
 
         if (!emuenv.io.app_path.empty())
             ImGui::EndDisabled();
@@ -691,6 +823,17 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Checkbox("Enable NGS support", &config.ngs_enable);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Uncheck the box to disable support for advanced audio library NGS.");
+        ImGui::BeginDisabled(!config.ngs_enable);
+        ImGui::Checkbox("Parallel NGS voices", &emuenv.cfg.ngs_parallel_voices);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Check the box to process the NGS voices on several threads.\nHelps the games playing many sounds at the same time, their callbacks are run after the voices are processed.");
+        ImGui::SliderInt("ATRAC9 Cache", &emuenv.cfg.ngs_atrac9_cache_size, 0, 128, emuenv.cfg.ngs_atrac9_cache_size == 0 ? "Off" : "%d MB");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Memory kept for the decoded ATRAC9 music of the NGS voices, so the looped music is only decoded once.\nRequires a restart of the emulator.");
+        ImGui::EndDisabled();
+        ImGui::SliderInt("File Cache", &emuenv.cfg.file_cache_size, 0, 512, emuenv.cfg.file_cache_size == 0 ? "Off" : "%d MB");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Memory kept for the blocks read from the game files, the next blocks are read ahead in the background while a file is read sequentially.\nHelps the games streaming their data from a slow drive or a network share.\nRequires a restart of the emulator.");
         ImGui::Spacing();
         ImGui::Separator();
         ImGui::Spacing();
@@ -958,6 +1101,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Checkbox("ELF dumping", &emuenv.kernel.debugger.dump_elfs);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Dump loaded code as ELFs");
+        ImGui::Checkbox("Shader dumping", &emuenv.cfg.dump_shaders);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Dump generated shaders and their disassembly to files, applied on the next game boot");
         ImGui::Spacing();
         if (ImGui::Button(emuenv.kernel.debugger.watch_code ? "Unwatch Code" : "Watch Code")) {
             emuenv.kernel.debugger.watch_code = !emuenv.kernel.debugger.watch_code;
@@ -997,6 +1143,24 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                               "in a PC with at least 12GB (Linux) or 16GB (Windows) of RAM.");
         }
 
+        // Subsystems whose zones are recorded, the other zones only cost a branch
+        ImGui::Text("Subsystems");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Only the zones of the enabled subsystems are sent to Tracy.\n"
+                              "The subsystems of the modules enabled for advanced profiling are always enabled.");
+        for (const TracySubsystemName &subsystem : tracy_subsystem_names) {
+            const auto enabled_subsystem = std::find(emuenv.cfg.tracy_subsystems.begin(), emuenv.cfg.tracy_subsystems.end(), subsystem.name);
+            bool is_enabled = enabled_subsystem != emuenv.cfg.tracy_subsystems.end();
+            ImGui::SameLine();
+            if (ImGui::Checkbox(subsystem.name, &is_enabled)) {
+                if (is_enabled)
+                    emuenv.cfg.tracy_subsystems.push_back(subsystem.name);
+                else
+                    emuenv.cfg.tracy_subsystems.erase(enabled_subsystem);
+                update_tracy_subsystems(emuenv.cfg.tracy_subsystems, emuenv.cfg.tracy_advanced_profiling_modules);
+            }
+        }
+
         // ImGui::Text("The Tracy profiler is not available in Release builds, please compile Vita3K\nfrom source using"
         // " either the RelWithDebInfo or Debug builds in order to use it.");
 
@@ -1032,6 +1196,7 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                     }
                     // Sort the list everytime it changes, this is so that we can use binary search on sce functions
                     std::sort(emuenv.cfg.tracy_advanced_profiling_modules.begin(), emuenv.cfg.tracy_advanced_profiling_modules.end());
+                    update_tracy_subsystems(emuenv.cfg.tracy_subsystems, emuenv.cfg.tracy_advanced_profiling_modules);
                 }
             }
             ImGui::EndListBox();
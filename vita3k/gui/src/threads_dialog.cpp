@@ -26,6 +26,10 @@
 
 namespace gui {
 
+static double to_ms(const std::atomic<uint64_t> &ns) {
+    return static_cast<double>(ns.load(std::memory_order_relaxed)) / 1000000.0;
+}
+
 void draw_thread_details_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ThreadStatePtr &thread = emuenv.kernel.threads[gui.thread_watch_index];
     CPUState &cpu = *thread->cpu;
@@ -56,6 +60,19 @@ void draw_thread_details_dialog(GuiState &gui, EmuEnvState &emuenv) {
     for (int i = 0; i < 15; i++) {
         ImGui::Text("Stack %d: %08x", i, *Ptr<uint32_t>(sp + i * 4).get(emuenv.mem));
     }
+    ImGui::Separator();
+
+    const ThreadCpuStats &stats = thread->cpu_stats;
+    ImGui::Text("JIT: %.1f ms (%llu entries)", to_ms(stats.jit_ns), static_cast<unsigned long long>(stats.jit_entries.load()));
+    ImGui::Text("HLE: %.1f ms (%llu svcs)", to_ms(stats.hle_ns), static_cast<unsigned long long>(stats.svc_calls.load()));
+    for (size_t i = 0; i < THREAD_HLE_LIBRARY_COUNT; i++) {
+        if (stats.hle_library_ns[i].load(std::memory_order_relaxed) > 0)
+            ImGui::Text("    %s: %.1f ms", emuenv.kernel.import_libraries.get_name(i).c_str(), to_ms(stats.hle_library_ns[i]));
+    }
+    static const char *const WAIT_REASON_NAMES[THREAD_WAIT_REASON_COUNT] = { "LwMutex", "Event flag", "VBlank", "Audio", "Other" };
+    ImGui::Text("Blocked: %.1f ms", static_cast<double>(stats.get_blocked_ns()) / 1000000.0);
+    for (size_t i = 0; i < THREAD_WAIT_REASON_COUNT; i++)
+        ImGui::Text("    %s: %.1f ms", WAIT_REASON_NAMES[i], to_ms(stats.blocked_ns[i]));
 
     ImGui::End();
 }
@@ -63,7 +80,7 @@ void draw_thread_details_dialog(GuiState &gui, EmuEnvState &emuenv) {
 void draw_threads_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Threads", &gui.debug_menu.threads_dialog);
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE,
-        "%-16s %-32s   %-16s   %-16s", "ID", "Thread Name", "Status", "Stack Pointer");
+        "%-16s %-32s   %-16s   %-16s   %-10s   %-10s   %-10s", "ID", "Thread Name", "Status", "Stack Pointer", "JIT ms", "HLE ms", "Blocked ms");
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
 
@@ -83,8 +100,9 @@ void draw_threads_dialog(GuiState &gui, EmuEnvState &emuenv) {
         case ThreadStatus::suspend:
             run_state = "Suspended";
         }
-        if (ImGui::Selectable(fmt::format("{:0>8X}         {:<32}   {:<16}   {:0>8X}",
-                thread.first, th_state->name, run_state, th_state->stack.get())
+        const ThreadCpuStats &stats = th_state->cpu_stats;
+        if (ImGui::Selectable(fmt::format("{:0>8X}         {:<32}   {:<16}   {:0>8X}           {:<10.1f}   {:<10.1f}   {:<10.1f}",
+                thread.first, th_state->name, run_state, th_state->stack.get(), to_ms(stats.jit_ns), to_ms(stats.hle_ns), static_cast<double>(stats.get_blocked_ns()) / 1000000.0)
                                   .c_str())) {
             gui.thread_watch_index = thread.first;
             gui.debug_menu.thread_details_dialog = true;
@@ -32,6 +32,15 @@
 namespace gui {
 using namespace np::trophy;
 
+// a trophy of TROP.SFM, the file is parsed once when the trophy collection opens
+struct TrophyConf {
+    std::string gid;
+    std::string name;
+    std::string detail;
+    std::string ttype;
+    std::string hidden;
+};
+
 struct NPComId {
     std::map<std::string, std::string> name;
     std::map<std::string, std::string> detail;
@@ -42,6 +51,7 @@ struct NPComId {
     std::map<std::string, uint32_t> unlocked_count;
     std::map<std::string, uint32_t> progress;
     std::map<std::string, std::map<std::string, std::string>> unlocked_type_count;
+    std::map<std::string, TrophyConf> trophies;
 
     Context context;
 };
@@ -56,6 +66,69 @@ struct NPComIdSort {
 static std::map<std::string, NPComId> np_com_id_info;
 static std::vector<NPComIdSort> np_com_id_list;
 
+static constexpr uint32_t TROPHY_ICON_WORKERS = 2;
+// the textures created each frame, the decoded icons are uploaded over a few frames
+static constexpr size_t TROPHY_ICON_UPLOADS_PER_FRAME = 16;
+
+TrophyIconLoader::~TrophyIconLoader() {
+    quit = true;
+    pool.reset();
+}
+
+void TrophyIconLoader::commit(GuiState &gui) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t uploads = 0;
+    auto it = decoded.begin();
+    for (; (it != decoded.end()) && (uploads < TROPHY_ICON_UPLOADS_PER_FRAME); ++it) {
+        if (it->np_com_id.empty()) {
+            if (it->generation != trophy_list_generation)
+                continue;
+            gui.trophy_list[it->id].init(gui.imgui_state.get(), it->data.data.get(), it->data.width, it->data.height);
+        } else {
+            if (it->generation != collection_generation)
+                continue;
+            gui.trophy_np_com_id_list_icons[it->np_com_id][it->id].init(gui.imgui_state.get(), it->data.data.get(), it->data.width, it->data.height);
+        }
+        uploads++;
+    }
+    decoded.erase(decoded.begin(), it);
+}
+
+// Reads and decodes an icon of the trophy conf of the np com id in the background, for the trophy list or for the collection
+static void request_trophy_icon(GuiState &gui, EmuEnvState &emuenv, const std::string &np_com_id, const std::string &id, const std::string &icon_name, const bool trophy_list) {
+    TrophyIconLoader &loader = gui.trophy_icon_loader;
+    if (!loader.pool)
+        loader.pool = std::make_unique<JobPool>(TROPHY_ICON_WORKERS);
+
+    const uint32_t generation = trophy_list ? loader.trophy_list_generation : loader.collection_generation;
+    const std::string icon_path = "user/" + emuenv.io.user_id + "/trophy/conf/" + np_com_id + "/" + icon_name;
+    loader.pool->submit([&loader, &emuenv, np_com_id = trophy_list ? std::string() : np_com_id, id, icon_path, generation, trophy_list]() {
+        if (loader.quit || (generation != (trophy_list ? loader.trophy_list_generation : loader.collection_generation)))
+            return;
+
+        vfs::FileBuffer buffer;
+        vfs::read_file(VitaIoDevice::ux0, buffer, emuenv.pref_path, icon_path);
+        if (buffer.empty()) {
+            LOG_WARN("Trophy icon: '{}', Not found.", icon_path);
+            return;
+        }
+
+        TrophyIcon icon;
+        icon.np_com_id = np_com_id;
+        icon.id = id;
+        icon.generation = generation;
+        icon.data.data.reset(stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &icon.data.width, &icon.data.height, nullptr, STBI_rgb_alpha));
+        if (!icon.data.data) {
+            LOG_ERROR("Invalid trophy icon: '{}'.", icon_path);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.decoded.push_back(std::move(icon));
+    });
+}
+
 static constexpr uint32_t TROPHY_USR_MAGIC = 0x12D5819A;
 static bool load_trophy_progress(IOState &io, const SceUID &progress_input_file, const std::string &np_com_id) {
     auto read_trophy_progress_file = [&](void *data, uint32_t amount) -> int {
@@ -128,6 +201,7 @@ void init_trophy_collection(GuiState &gui, EmuEnvState &emuenv) {
     const auto TROPHY_CONF_PATH = TROPHY_PATH / "conf";
 
     gui.trophy_np_com_id_list_icons.clear(), np_com_id_info.clear(), np_com_id_list.clear();
+    gui.trophy_icon_loader.collection_generation++;
 
     if (fs::exists(TROPHY_CONF_PATH) && !fs::is_empty(TROPHY_CONF_PATH)) {
         for (const auto &trophy : fs::directory_iterator(TROPHY_CONF_PATH)) {
@@ -186,6 +260,13 @@ void init_trophy_collection(GuiState &gui, EmuEnvState &emuenv) {
                             const std::string gid = conf.attribute("gid").empty() ? "000" : conf.attribute("gid").as_string();
                             const std::string trophy_id = conf.attribute("id").as_string();
                             np_com_id_info[np_com_id].trophy_id_by_group[gid].push_back(trophy_id);
+
+                            auto &trophy_entry = np_com_id_info[np_com_id].trophies[trophy_id];
+                            trophy_entry.gid = gid;
+                            trophy_entry.name = conf.child("name").text().as_string();
+                            trophy_entry.detail = conf.child("detail").text().as_string();
+                            trophy_entry.ttype = conf.attribute("ttype").as_string();
+                            trophy_entry.hidden = conf.attribute("hidden").as_string();
                         }
                     }
                 }
@@ -230,27 +311,8 @@ void init_trophy_collection(GuiState &gui, EmuEnvState &emuenv) {
 
                 np_com_id_list.push_back({ np_com_id, np_com_id_info[np_com_id].name["000"], progress, updated });
 
-                for (const auto &group : np_com_list_name_icons) {
-                    int32_t width = 0;
-                    int32_t height = 0;
-                    vfs::FileBuffer buffer;
-
-                    vfs::read_file(VitaIoDevice::ux0, buffer, emuenv.pref_path, "user/" + emuenv.io.user_id + "/trophy/conf/" + np_com_id + "/" + group.second);
-
-                    if (buffer.empty()) {
-                        LOG_WARN("Icon: '{}', Not found for NPComId: {}.", group.second, np_com_id);
-                        continue;
-                    }
-
-                    stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-                    if (!data) {
-                        LOG_ERROR("Invalid icon: '{}' for NPComId: {}.", group.second, np_com_id);
-                        continue;
-                    }
-
-                    gui.trophy_np_com_id_list_icons[np_com_id][group.first].init(gui.imgui_state.get(), data, width, height);
-                    stbi_image_free(data);
-                }
+                for (const auto &group : np_com_list_name_icons)
+                    request_trophy_icon(gui, emuenv, np_com_id, group.first, group.second, false);
             }
         }
     }
@@ -291,46 +353,26 @@ static void get_trophy_list(GuiState &gui, EmuEnvState &emuenv, const std::strin
     }
 
     gui.trophy_list.clear(), trophy_info.clear(), trophy_list.clear();
-
-    const std::string sfm_name = fs::exists(trophy_conf_id_path / fmt::format("TROP_{:0>2d}.SFM", emuenv.cfg.sys_lang)) ? fmt::format("TROP_{:0>2d}.SFM", emuenv.cfg.sys_lang) : "TROP.SFM";
-
-    pugi::xml_document doc;
-    if (doc.load_file((trophy_conf_id_path / sfm_name).c_str())) {
-        std::string type;
-        for (const auto &conf : doc.child("trophyconf")) {
-            if (conf.name() == std::string("trophy")) {
-                const std::string gid = conf.attribute("gid").empty() ? "000" : conf.attribute("gid").as_string();
-                const std::string trophy_id = conf.attribute("id").as_string();
-                if (group_id == gid) {
-                    trophy_info[trophy_id].name = conf.child("name").text().as_string();
-                    trophy_info[trophy_id].detail = conf.child("detail").text().as_string();
-                    trophy_info[trophy_id].type["general"] = conf.attribute("ttype").as_string();
-                    trophy_info[trophy_id].hidden = conf.attribute("hidden").as_string();
-                }
-            }
+    gui.trophy_icon_loader.trophy_list_generation++;
+
+    for (const auto &[trophy_id, conf] : np_com_id_info[np_com_id].trophies) {
+        if (conf.gid == group_id) {
+            trophy_info[trophy_id].name = conf.name;
+            trophy_info[trophy_id].detail = conf.detail;
+            trophy_info[trophy_id].type["general"] = conf.ttype;
+            trophy_info[trophy_id].hidden = conf.hidden;
         }
     }
 
     for (const auto &trophy : trophy_info) {
-        int32_t width = 0;
-        int32_t height = 0;
-        vfs::FileBuffer buffer;
         const std::string trophy_id = trophy.first;
         const std::string icon_name = fmt::format("TROP{}.PNG", trophy_id);
 
-        vfs::read_file(VitaIoDevice::ux0, buffer, emuenv.pref_path, "user/" + emuenv.io.user_id + "/trophy/conf/" + np_com_id + "/" + icon_name);
-        if (buffer.empty()) {
+        if (!fs::exists(trophy_conf_id_path / icon_name)) {
             LOG_WARN("Trophy icon, Name: '{}', Not found for trophy id: {}.", icon_name, trophy.first);
             continue;
         }
-        stbi_uc *data = stbi_load_from_memory(&buffer[0], static_cast<int>(buffer.size()), &width, &height, nullptr, STBI_rgb_alpha);
-        if (!data) {
-            LOG_ERROR("Invalid trophy icon for trophy id {} [{}].", icon_name, trophy_id);
-            continue;
-        }
-
-        gui.trophy_list[trophy_id].init(gui.imgui_state.get(), data, width, height);
-        stbi_image_free(data);
+        request_trophy_icon(gui, emuenv, np_com_id, trophy_id, icon_name, true);
 
         auto common = gui.lang.common.main;
         const auto trophy_type = np_com_id_info[np_com_id].context.trophy_kinds[std::stoi(trophy_id)];
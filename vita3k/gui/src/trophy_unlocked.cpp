@@ -27,7 +27,8 @@ namespace gui {
 
 static constexpr int TROPHY_WINDOW_STATIC_FRAME_COUNT = 250;
 
-static void draw_trophy_unlocked(GuiState &gui, EmuEnvState &emuenv, NpTrophyUnlockCallbackData &callback_data) {
+static void draw_trophy_unlocked(GuiState &gui, EmuEnvState &emuenv, TrophyUnlockRequest &request) {
+    const NpTrophyUnlockCallbackData &callback_data = request.data;
     const auto display_size = ImGui::GetIO().DisplaySize;
     const auto RES_SCALE = ImVec2(display_size.x / emuenv.res_width_dpi_scale, display_size.y / emuenv.res_height_dpi_scale);
     const auto SCALE = ImVec2(RES_SCALE.x * emuenv.dpi_scale, RES_SCALE.y * emuenv.dpi_scale);
@@ -52,9 +53,9 @@ static void draw_trophy_unlocked(GuiState &gui, EmuEnvState &emuenv, NpTrophyUnl
         if (gui.trophy_window_frame_stage == TrophyAnimationStage::SLIDE_IN && gui.trophy_window_frame_count == 0) {
             gui.trophy_window_pos = ImVec2(ImGui::GetIO().DisplaySize.x + TROPHY_WINDOW_MARGIN_PADDING, TROPHY_WINDOW_Y_POS);
 
-            // Load icon
-            gui.trophy_window_icon = load_image(gui, (const char *)callback_data.icon_buf.data(),
-                static_cast<std::uint32_t>(callback_data.icon_buf.size()));
+            // Create the texture of the icon, decoded when the trophy was unlocked
+            gui.trophy_window_icon = request.icon.data ? ImGui_ImplSdl_CreateTexture(gui.imgui_state.get(), request.icon.data.get(), request.icon.width, request.icon.height) : nullptr;
+            request.icon.data.reset();
         } else if (gui.trophy_window_frame_stage == TrophyAnimationStage::SLIDE_IN && gui.trophy_window_pos.x > target_window_pos.x) {
             gui.trophy_window_pos.x -= TROPHY_MOVE_DELTA;
         } else if (gui.trophy_window_frame_stage == TrophyAnimationStage::SLIDE_OUT && gui.trophy_window_pos.x < target_window_pos.x) {
@@ -78,30 +79,32 @@ static void draw_trophy_unlocked(GuiState &gui, EmuEnvState &emuenv, NpTrophyUnl
     ImGui::Columns(2, nullptr, false);
     ImGui::SetColumnWidth(0, TROPHY_WINDOW_ICON_SIZE + TROPHY_WINDOW_MARGIN_PADDING * 2);
     ImGui::SetCursorPos(ImVec2(TROPHY_WINDOW_MARGIN_PADDING, TROPHY_ICON_MARGIN_PADDING));
-    ImGui::Image((ImTextureID)gui.trophy_window_icon, ImVec2(TROPHY_WINDOW_ICON_SIZE, TROPHY_WINDOW_ICON_SIZE));
+    if (gui.trophy_window_icon)
+        ImGui::Image((ImTextureID)gui.trophy_window_icon, ImVec2(TROPHY_WINDOW_ICON_SIZE, TROPHY_WINDOW_ICON_SIZE));
     ImGui::NextColumn();
 
-    auto common = gui.lang.common.main;
-    std::string trophy_kind_s = "?";
+    // drawn each frame, look the texts up without copying them
+    auto &common = gui.lang.common.main;
+    const char *trophy_kind_s = "?";
 
     switch (callback_data.trophy_kind) {
     case np::trophy::SceNpTrophyGrade::SCE_NP_TROPHY_GRADE_PLATINUM: {
-        trophy_kind_s = common["platinum"];
+        trophy_kind_s = common["platinum"].c_str();
         break;
     }
 
     case np::trophy::SceNpTrophyGrade::SCE_NP_TROPHY_GRADE_GOLD: {
-        trophy_kind_s = common["gold"];
+        trophy_kind_s = common["gold"].c_str();
         break;
     }
 
     case np::trophy::SceNpTrophyGrade::SCE_NP_TROPHY_GRADE_SILVER: {
-        trophy_kind_s = common["silver"];
+        trophy_kind_s = common["silver"].c_str();
         break;
     }
 
     case np::trophy::SceNpTrophyGrade::SCE_NP_TROPHY_GRADE_BRONZE: {
-        trophy_kind_s = common["bronze"];
+        trophy_kind_s = common["bronze"].c_str();
         break;
     }
 
@@ -111,7 +114,7 @@ static void draw_trophy_unlocked(GuiState &gui, EmuEnvState &emuenv, NpTrophyUnl
 
     ImGui::SetWindowFontScale(1.f * RES_SCALE.x);
     ImGui::SetCursorPosY(TROPHY_WINDOW_MARGIN_PADDING);
-    ImGui::TextColored(ImVec4(0.24f, 0.24f, 0.24f, 1.0f), "(%s) %s", trophy_kind_s.c_str(), callback_data.trophy_name.c_str());
+    ImGui::TextColored(ImVec4(0.24f, 0.24f, 0.24f, 1.0f), "(%s) %s", trophy_kind_s, callback_data.trophy_name.c_str());
     ImGui::SetWindowFontScale(0.8f * RES_SCALE.x);
     ImGui::TextColored(ImVec4(0.24f, 0.24f, 0.24f, 1.0f), "%s", gui.lang.indicator["trophy_earned"].c_str());
     ImGui::End();
@@ -137,7 +140,7 @@ void draw_trophies_unlocked(GuiState &gui, EmuEnvState &emuenv) {
             gui.trophy_unlock_display_requests.pop_back();
 
             // Destroy the texture
-            if (gui.trophy_window_frame_count != 0xFFFFFFFF)
+            if ((gui.trophy_window_frame_count != 0xFFFFFFFF) && gui.trophy_window_icon)
                 ImGui_ImplSdl_DeleteTexture(gui.imgui_state.get(), gui.trophy_window_icon);
 
             gui.trophy_window_frame_stage = TrophyAnimationStage::SLIDE_IN;
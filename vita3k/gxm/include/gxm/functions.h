@@ -21,7 +21,11 @@
 
 #include <array>
 #include <bitset>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace gxm {
 // Color.
@@ -94,4 +98,36 @@ int get_uniform_buffer_base(const SceGxmProgram &program, const SceGxmProgramPar
 typedef std::bitset<SCE_GXM_MAX_TEXTURE_UNITS> TextureInfo;
 TextureInfo get_textures_used(const SceGxmProgram &program_gxp);
 
+/**
+ * \brief Metadata of a program, parsed once when the program is registered and never modified after.
+ *        It points into the program, which must outlive it.
+ */
+struct ProgramInfo {
+    const SceGxmProgram *program = nullptr;
+    const SceGxmProgramParameter *parameters = nullptr;
+
+    // indices of the parameters of each category, in the program order
+    std::array<std::vector<uint16_t>, SCE_GXM_PARAMETER_CATEGORY_UNIFORM_BUFFER + 1> parameters_by_category;
+    // indices of the parameters with a semantic, in the program order
+    std::vector<uint16_t> parameters_with_semantic;
+    // raw name of the parameters to their first index
+    std::unordered_map<std::string_view, uint16_t> parameters_by_name;
+
+    // containers by container index, null if the program doesn't have it
+    std::array<const SceGxmProgramParameterContainer *, 20> containers = {};
+    // base of the uniform buffer parameters by resource index, -1 if there's no such parameter
+    std::array<int, SCE_GXM_REAL_MAX_UNIFORM_BUFFER> uniform_buffer_bases;
+
+    TextureInfo textures_used;
+    SceGxmVertexProgramOutputs vertex_outputs;
+    GxmVertexOutputTexCoordInfos coord_infos = {};
+    SceGxmFragmentProgramInputs fragment_inputs;
+
+    const SceGxmProgramParameterContainer *get_container(const std::uint16_t idx) const;
+    const SceGxmProgramParameter *find_parameter(std::string_view name) const;
+    const SceGxmProgramParameter *find_parameter(SceGxmParameterSemantic semantic, uint32_t index) const;
+};
+
+std::shared_ptr<const ProgramInfo> parse_program_info(const SceGxmProgram &program);
+
 } // namespace gxp
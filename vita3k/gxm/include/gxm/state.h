@@ -22,10 +22,16 @@
 #include <threads/queue.h>
 
 #include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 
 struct SDL_Thread;
 
+namespace gxp {
+struct ProgramInfo;
+} // namespace gxp
+
 typedef void SceGxmDisplayQueueCallback(Ptr<const void> callbackData);
 static constexpr std::uint64_t SCENE_TIME_UNDEF = 0xFFFFFFFFFFFFFFFF;
 static constexpr std::uint64_t GPU_SYNCING_DISABLE_SCENE_DELTA = 40;
@@ -84,4 +90,7 @@ struct GxmState {
     std::array<SurfaceSyncingInfo, 40> surface_syncing_infoes;
     std::mutex callback_lock;
     SDL_Thread *sdl_thread;
+    // metadata of the registered programs by program address, used by the program queries
+    std::unordered_map<Address, std::shared_ptr<const gxp::ProgramInfo>> program_infos;
+    std::mutex program_infos_mutex;
 };
@@ -420,4 +420,65 @@ TextureInfo get_textures_used(const SceGxmProgram &program_gxp) {
 
     return textures_used;
 }
+
+const SceGxmProgramParameterContainer *ProgramInfo::get_container(const std::uint16_t idx) const {
+    if (idx < containers.size())
+        return containers[idx];
+
+    return get_container_by_index(*program, idx);
+}
+
+const SceGxmProgramParameter *ProgramInfo::find_parameter(std::string_view name) const {
+    const auto it = parameters_by_name.find(name);
+    if (it == parameters_by_name.end())
+        return nullptr;
+
+    return &parameters[it->second];
+}
+
+const SceGxmProgramParameter *ProgramInfo::find_parameter(SceGxmParameterSemantic semantic, uint32_t index) const {
+    for (const uint16_t parameter_index : parameters_with_semantic) {
+        const SceGxmProgramParameter &parameter = parameters[parameter_index];
+        if ((parameter.semantic == semantic) && (parameter.semantic_index == index))
+            return &parameter;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<const ProgramInfo> parse_program_info(const SceGxmProgram &program) {
+    const std::shared_ptr<ProgramInfo> info = std::make_shared<ProgramInfo>();
+    info->program = &program;
+    info->parameters = program_parameters(program);
+
+    const SceGxmProgramParameterContainer *const containers = get_containers(program);
+    // keep the first container of each index, like get_container_by_index
+    for (uint32_t i = program.container_count; i-- > 0;) {
+        if (containers[i].container_index < info->containers.size())
+            info->containers[containers[i].container_index] = &containers[i];
+    }
+
+    info->uniform_buffer_bases.fill(-1);
+    for (uint32_t i = 0; i < program.parameter_count; ++i) {
+        const SceGxmProgramParameter &parameter = info->parameters[i];
+        const uint16_t index = static_cast<uint16_t>(i);
+        if (parameter.category < info->parameters_by_category.size())
+            info->parameters_by_category[parameter.category].push_back(index);
+
+        if (parameter.semantic != SCE_GXM_PARAMETER_SEMANTIC_NONE)
+            info->parameters_with_semantic.push_back(index);
+
+        const char *const name = reinterpret_cast<const char *>(reinterpret_cast<const uint8_t *>(&parameter) + parameter.name_offset);
+        info->parameters_by_name.emplace(name, index);
+
+        if ((parameter.category == SCE_GXM_PARAMETER_CATEGORY_UNIFORM_BUFFER) && (parameter.resource_index < info->uniform_buffer_bases.size()))
+            info->uniform_buffer_bases[parameter.resource_index] = get_uniform_buffer_base(program, parameter);
+    }
+
+    info->textures_used = get_textures_used(program);
+    info->vertex_outputs = get_vertex_outputs(program, &info->coord_infos);
+    info->fragment_inputs = get_fragment_inputs(program);
+
+    return info;
+}
 } // namespace gxp
@@ -19,6 +19,7 @@
 
 #include <mem/ptr.h>
 
+#include <chrono>
 #include <map>
 #include <string>
 #include <util/types.h>
@@ -223,6 +224,20 @@ struct SceConnection {
     SceBool keepAlive;
     bool isSecure;
     int sockfd;
+    // template id, scheme, host and port, the connections with the same key can share their socket once deleted
+    std::string poolKey;
+};
+
+// socket of a deleted connection kept alive, reused by the next connection with the same pool key
+struct SceIdleConnection {
+    int sockfd;
+    std::chrono::steady_clock::time_point idleSince;
+};
+
+struct SceResolvedHost {
+    // sockaddr of the host
+    std::vector<uint8_t> address;
+    std::chrono::steady_clock::time_point expires;
 };
 
 struct SceRequestResponse {
@@ -261,6 +276,10 @@ struct HTTPState {
     std::map<SceInt, SceTemplate> templates;
     std::map<SceInt, SceConnection> connections;
     std::map<SceInt, SceRequest> requests;
+    // keyed by the pool key of the connections
+    std::map<std::string, std::vector<SceIdleConnection>> idleConnections;
+    // keyed by host:port
+    std::map<std::string, SceResolvedHost> resolvedHosts;
     std::vector<Ptr<void>> guestPointers;
     void *ssl_ctx = nullptr;
 };
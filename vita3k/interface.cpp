@@ -31,17 +31,21 @@
 #include <packages/functions.h>
 #include <packages/pkg.h>
 #include <packages/sfo.h>
+#include <renderer/state.h>
+#include <threads/job_pool.h>
 
 #include <modules/module_parent.h>
 #include <string>
 #include <touch/functions.h>
 #include <touch/touch.h>
 #include <util/find.h>
+#include <util/host_cpu.h>
 #include <util/log.h>
 #include <util/string_utils.h>
 
 #include <gui/imgui_impl_sdl.h>
 
+#include <algorithm>
 #include <regex>
 
 #include <SDL.h>
@@ -412,20 +416,59 @@ uint32_t install_contents(EmuEnvState &emuenv, GuiState *gui, const fs::path &pa
     return installed;
 }
 
-static auto pre_load_module(EmuEnvState &emuenv, const std::vector<std::string> &lib_load_list, const VitaIoDevice &device) {
-    for (const auto &module_path : lib_load_list) {
-        vfs::FileBuffer module_buffer;
-        Ptr<const void> lib_entry_point;
-        bool res;
-        const auto MODULE_PATH_ABS = fmt::format("{}:{}", device._to_string(), module_path);
+// File of a module loaded at boot, with fast boot they are all read at the same time before being loaded in order
+struct PreLoadModule {
+    VitaIoDevice device;
+    std::string path;
+    vfs::FileBuffer buffer;
+    bool found = false;
+    JobPtr read;
+};
+
+static void read_pre_load_module(EmuEnvState &emuenv, PreLoadModule &module) {
+    if (module.device == VitaIoDevice::app0)
+        module.found = vfs::read_app_file(module.buffer, emuenv.pref_path, emuenv.io.app_path, module.path);
+    else
+        module.found = vfs::read_file(module.device, module.buffer, emuenv.pref_path, module.path);
+}
 
-        if (device == VitaIoDevice::app0)
-            res = vfs::read_app_file(module_buffer, emuenv.pref_path, emuenv.io.app_path, module_path);
-        else
-            res = vfs::read_file(device, module_buffer, emuenv.pref_path, module_path);
+static std::vector<PreLoadModule> get_pre_load_modules(const std::vector<std::string> &lib_load_list, const VitaIoDevice &device) {
+    std::vector<PreLoadModule> modules;
+    for (const auto &module_path : lib_load_list)
+        modules.push_back({ device, module_path });
+
+    return modules;
+}
 
-        if (res) {
-            SceUID module_id = load_self(lib_entry_point, emuenv.kernel, emuenv.mem, module_buffer.data(), MODULE_PATH_ABS);
+// Start reading the files of the modules on the pool, they must not be moved until they are loaded
+static void read_pre_load_modules(EmuEnvState &emuenv, JobPool &pool, std::vector<PreLoadModule> &modules) {
+    for (auto &module : modules) {
+        module.read = pool.submit([&emuenv, &module]() {
+            read_pre_load_module(emuenv, module);
+        });
+    }
+}
+
+// Wait for the file of the module if it is read on the pool, or read it now
+static bool get_pre_load_module_file(EmuEnvState &emuenv, PreLoadModule &module) {
+    if (module.read)
+        module.read->wait();
+    else
+        read_pre_load_module(emuenv, module);
+
+    return module.found;
+}
+
+static auto pre_load_module(EmuEnvState &emuenv, std::vector<PreLoadModule> &modules) {
+    for (auto &module_file : modules) {
+        Ptr<const void> lib_entry_point;
+        const auto &module_path = module_file.path;
+        const auto MODULE_PATH_ABS = fmt::format("{}:{}", module_file.device._to_string(), module_path);
+
+        if (get_pre_load_module_file(emuenv, module_file)) {
+            SceUID module_id = load_self(lib_entry_point, emuenv.kernel, emuenv.mem, module_file.buffer.data(), MODULE_PATH_ABS);
+            // the file is no longer needed once the module is loaded
+            module_file.buffer = {};
             if (module_id >= 0) {
                 const auto module = emuenv.kernel.loaded_modules[module_id];
 
@@ -445,13 +488,72 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
     if (path.empty())
         return InvalidApplicationPath;
 
-    const auto call_import = [&emuenv](CPUState &cpu, uint32_t nid, SceUID thread_id) {
-        ::call_import(emuenv, cpu, nid, thread_id);
+    // Pre-loaded libraries, the application ones are used when it has them
+    const auto module_app_path{ fs::path(emuenv.pref_path) / "ux0/app" / emuenv.io.app_path / "sce_module" };
+    const auto is_app = fs::exists(module_app_path) && !fs::is_empty(module_app_path);
+    std::vector<PreLoadModule> app_modules;
+    if (is_app) {
+        // Load application module
+        const std::vector<std::string> lib_load_list = {
+            "sce_module/libc.suprx",
+            "sce_module/libfios2.suprx",
+            "sce_module/libult.suprx",
+        };
+
+        app_modules = get_pre_load_modules(lib_load_list, VitaIoDevice::app0);
+    }
+
+    // Load pre-loaded font fw libraries
+    std::vector<std::string> lib_load_list = {
+        "sys/external/libSceFt2.suprx",
+        "sys/external/libpvf.suprx",
+    };
+
+    if (!is_app) {
+        // Load pre-loaded fw libraries if app libraries not exist
+        const std::vector<std::string> lib_load_list_to_add = {
+            "sys/external/libc.suprx",
+            "sys/external/libfios2.suprx",
+            "sys/external/libult.suprx"
+        };
+
+        lib_load_list.insert(lib_load_list.begin(), lib_load_list_to_add.begin(), lib_load_list_to_add.end());
+    }
+    std::vector<PreLoadModule> fw_modules = get_pre_load_modules(lib_load_list, VitaIoDevice::vs0);
+
+    // Main executable
+    emuenv.self_path = !emuenv.cfg.self_path.empty() ? emuenv.cfg.self_path : EBOOT_PATH;
+    std::vector<PreLoadModule> eboot_module = get_pre_load_modules({ emuenv.self_path }, VitaIoDevice::app0);
+
+    // With fast boot, the files of the modules are read while the kernel is initialized,
+    // loading them is still done in order since it changes the kernel state
+    std::unique_ptr<JobPool> module_read_pool;
+    if (emuenv.cfg.fast_boot) {
+        module_read_pool = std::make_unique<JobPool>(std::clamp(std::thread::hardware_concurrency() / 2, 2u, 4u));
+        read_pre_load_modules(emuenv, *module_read_pool, eboot_module);
+        read_pre_load_modules(emuenv, *module_read_pool, app_modules);
+        read_pre_load_modules(emuenv, *module_read_pool, fw_modules);
+    }
+
+    const auto call_import = [&emuenv](CPUState &cpu, uint32_t svc, uint32_t nid, SceUID thread_id) {
+        ::call_import(emuenv, cpu, svc, nid, thread_id);
     };
-    if (!emuenv.kernel.init(emuenv.mem, call_import, emuenv.kernel.cpu_backend, emuenv.kernel.cpu_opt)) {
+    emuenv.kernel.per_core_exclusive_monitor = emuenv.cfg.per_core_exclusive_monitor;
+    if (!emuenv.kernel.init(emuenv.mem, call_import, ::is_inline_import, emuenv.kernel.cpu_backend, emuenv.kernel.cpu_opt)) {
         LOG_WARN("Failed to init kernel!");
         return KernelInitFailed;
     }
+    emuenv.kernel.jit_cache.init(emuenv.base_path, emuenv.io.title_id, emuenv.cfg.jit_cache && (emuenv.kernel.cpu_backend == CPUBackend::Dynarmic), emuenv.kernel.cpu_opt);
+    emuenv.kernel.module_cache_path = emuenv.cfg.module_cache ? fs::path(emuenv.base_path) / "cache/modules" : fs::path{};
+    emuenv.kernel.hle_replacements.init(emuenv.cfg.hle_hot_functions);
+    emuenv.kernel.scheduler.init(emuenv.cfg.scheduler_workers);
+    emuenv.kernel.spin_poll_backoff = emuenv.cfg.spin_poll_backoff;
+    emuenv.kernel.jit_code_cache_size = static_cast<uint32_t>(std::max(emuenv.cfg.jit_code_cache_size, 0));
+    const util::HostCorePinning pinning = util::get_host_core_pinning(emuenv.cfg.host_core_pinning, util::get_host_cpus());
+    emuenv.kernel.scheduler.set_host_affinity(pinning.guest_cores);
+    // Apps are loaded from the main thread, which is also the one rendering
+    if (util::set_current_thread_affinity(pinning.renderer))
+        LOG_INFO("Renderer thread pinned to host cpus {:#x}", pinning.renderer);
 
     if (emuenv.cfg.archive_log) {
         const fs::path log_directory{ emuenv.base_path + "/logs" };
@@ -464,6 +566,7 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
 
     LOG_INFO("{}: {}", emuenv.cfg[e_cpu_backend], emuenv.cfg.current_config.cpu_backend);
     LOG_INFO_IF(emuenv.kernel.cpu_backend == CPUBackend::Dynarmic, "CPU Optimisation state: {}", emuenv.cfg.current_config.cpu_opt);
+    LOG_INFO_IF((emuenv.kernel.cpu_backend == CPUBackend::Dynarmic) && emuenv.kernel.cpu_opt, "CPU unsafe optimisations: {}", emuenv.kernel.cpu_unsafe_opt);
     LOG_INFO("ngs state: {}", emuenv.cfg.current_config.ngs_enable);
     LOG_INFO("Resolution multiplier: {}", emuenv.cfg.resolution_multiplier);
     refresh_controllers(emuenv.ctrl);
@@ -497,44 +600,14 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
 
     // FIXME: The application EBOOT should be the first module ever loaded in the address space!
 
-    // Load pre-loaded libraries
-    const auto module_app_path{ fs::path(emuenv.pref_path) / "ux0/app" / emuenv.io.app_path / "sce_module" };
-    const auto is_app = fs::exists(module_app_path) && !fs::is_empty(module_app_path);
-    if (is_app) {
-        // Load application module
-        const std::vector<std::string> lib_load_list = {
-            "sce_module/libc.suprx",
-            "sce_module/libfios2.suprx",
-            "sce_module/libult.suprx",
-        };
-
-        pre_load_module(emuenv, lib_load_list, VitaIoDevice::app0);
-    }
-
-    // Load pre-loaded font fw libraries
-    std::vector<std::string> lib_load_list = {
-        "sys/external/libSceFt2.suprx",
-        "sys/external/libpvf.suprx",
-    };
-
-    if (!is_app) {
-        // Load pre-loaded fw libraries if app libraries not exist
-        const std::vector<std::string> lib_load_list_to_add = {
-            "sys/external/libc.suprx",
-            "sys/external/libfios2.suprx",
-            "sys/external/libult.suprx"
-        };
-
-        lib_load_list.insert(lib_load_list.begin(), lib_load_list_to_add.begin(), lib_load_list_to_add.end());
-    }
-
-    pre_load_module(emuenv, lib_load_list, VitaIoDevice::vs0);
+    pre_load_module(emuenv, app_modules);
+    pre_load_module(emuenv, fw_modules);
 
     // Load main executable
-    emuenv.self_path = !emuenv.cfg.self_path.empty() ? emuenv.cfg.self_path : EBOOT_PATH;
-    vfs::FileBuffer eboot_buffer;
-    if (vfs::read_app_file(eboot_buffer, emuenv.pref_path, emuenv.io.app_path, emuenv.self_path)) {
-        SceUID module_id = load_self(entry_point, emuenv.kernel, emuenv.mem, eboot_buffer.data(), "app0:" + emuenv.self_path);
+    PreLoadModule &eboot = eboot_module.front();
+    if (get_pre_load_module_file(emuenv, eboot)) {
+        SceUID module_id = load_self(entry_point, emuenv.kernel, emuenv.mem, eboot.buffer.data(), "app0:" + emuenv.self_path);
+        eboot.buffer = {};
         if (module_id >= 0) {
             const auto module = emuenv.kernel.loaded_modules[module_id];
 
@@ -545,7 +618,10 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
         return FileNotFound;
 
     // Set self name from self path, can contain folder, get file name only
-    emuenv.self_name = fs::path(emuenv.self_path).filename().string();
+    // with fast boot it is already set and used by the renderer reading the shaders cache hashs
+    const auto self_name = fs::path(emuenv.self_path).filename().string();
+    if (emuenv.self_name != self_name)
+        emuenv.self_name = self_name;
 
     return Success;
 }
@@ -583,12 +659,13 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
             if (emuenv.display.vblank_thread) {
                 emuenv.display.vblank_thread->join();
             }
+            stop_sampling_thread(emuenv.ctrl);
             return false;
 
         case SDL_KEYDOWN:
             if (gui.is_capturing_keys && event.key.keysym.scancode) {
                 gui.is_key_capture_dropped = false;
-                if ((event.key.keysym.scancode == SDL_SCANCODE_G) || (event.key.keysym.scancode == SDL_SCANCODE_F11) || (event.key.keysym.scancode == SDL_SCANCODE_T) || (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)) {
+                if ((event.key.keysym.scancode == SDL_SCANCODE_G) || (event.key.keysym.scancode == SDL_SCANCODE_F10) || (event.key.keysym.scancode == SDL_SCANCODE_F11) || (event.key.keysym.scancode == SDL_SCANCODE_F12) || (event.key.keysym.scancode == SDL_SCANCODE_T) || (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)) {
                     LOG_ERROR("Key is reserved!");
                     gui.captured_key = gui.old_captured_key;
                     gui.is_capturing_keys = false;
@@ -616,6 +693,14 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
                 toggle_touchscreen();
             if (event.key.keysym.sym == SDLK_F11 && !gui.is_key_capture_dropped)
                 switch_full_screen(emuenv);
+            if ((event.key.keysym.sym == SDLK_F10 || event.key.keysym.sym == SDLK_F12) && !gui.is_key_capture_dropped && !event.key.repeat) {
+                if (!emuenv.renderer->video_capture)
+                    LOG_WARN("The screenshots and the video recording are only supported by the Vulkan renderer");
+                else if (event.key.keysym.sym == SDLK_F12)
+                    emuenv.renderer->video_capture->request_screenshot();
+                else
+                    emuenv.renderer->video_capture->toggle_recording(emuenv.io.title_id.c_str());
+            }
 
             break;
 
@@ -666,9 +751,19 @@ ExitCode load_app(Ptr<const void> &entry_point, EmuEnvState &emuenv, const std::
         return ModuleLoadFailed;
     }
 
-    if (!emuenv.cfg.show_gui)
+    if (!emuenv.cfg.show_gui || emuenv.cfg.is_benchmark())
         emuenv.display.imgui_render = false;
 
+    if (emuenv.cfg.input_replay && !load_input_replay(emuenv.ctrl, *emuenv.cfg.input_replay)) {
+        app::error_dialog("Failed to load the input replay.\nSee console output for details.", emuenv.window.get());
+        return ModuleLoadFailed;
+    }
+
+    // armed before the app creates its render targets, they are tracked to be created again by the replay
+    if (emuenv.cfg.capture_frame > 0)
+        emuenv.renderer->frame_capture = std::make_unique<renderer::FrameCapture>(emuenv.cfg.capture_frame,
+            emuenv.cfg.capture_path.value_or(fs::path(emuenv.base_path) / "capture.v3kcap"));
+
     if (emuenv.cfg.gdbstub) {
         emuenv.kernel.debugger.wait_for_debugger = true;
         server_open(emuenv);
@@ -739,6 +834,7 @@ ExitCode run_app(EmuEnvState &emuenv, Ptr<const void> &entry_point) {
     }
 
     start_sync_thread(emuenv);
+    start_sampling_thread(emuenv);
 
     if (emuenv.cfg.boot_apps_full_screen && !emuenv.display.fullscreen.load())
         switch_full_screen(emuenv);
@@ -0,0 +1,76 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/filesystem.h>
+#include <io/types.h>
+#include <threads/job_pool.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Cache of the blocks read from the files opened read only, shared by all their fds.
+// The blocks following a sequential read are read ahead by background threads
+class BlockCache {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    // blocks read ahead after a sequential read
+    static constexpr uint32_t READ_AHEAD_BLOCKS = 4;
+    // bigger reads bypass the cache, they would evict everything else
+    static constexpr size_t MAX_CACHED_READ_SIZE = 16 * BLOCK_SIZE;
+
+    explicit BlockCache(size_t max_size);
+
+    // read size bytes at offset of the file, return the size read, which is smaller at the end of the file
+    // the position of file is undefined afterwards
+    size_t read(const fs::path &path, FILE *file, SceOff offset, void *data, size_t size);
+    // read the blocks of the range which are not cached yet in the background
+    void prefetch(const fs::path &path, SceOff offset, size_t size);
+    bool contains(const fs::path &path, SceOff offset, size_t size);
+    // forget the blocks of a file which is written to, truncated or removed
+    void invalidate(const fs::path &path);
+
+private:
+    typedef std::shared_ptr<const std::vector<uint8_t>> BlockData;
+
+    struct Block {
+        std::string path;
+        uint64_t index;
+        BlockData data;
+    };
+    typedef std::list<Block> BlockList;
+
+    BlockData find_block(const std::string &path, uint64_t index);
+    BlockData load_block(const std::string &path, FILE *file, uint64_t index);
+
+    const size_t max_size;
+
+    std::mutex mutex;
+    size_t size = 0;
+    // most recently used block first
+    BlockList lru;
+    std::unordered_map<std::string, std::unordered_map<uint64_t, BlockList::iterator>> files;
+    std::atomic<uint64_t> invalidation_count = 0;
+
+    // declared last so the prefetches are done before the blocks are destroyed
+    JobPool prefetch_pool{ 2 };
+};
@@ -37,8 +37,8 @@ void init_device_paths(IOState &io);
 bool init_savedata_app_path(IOState &io, const fs::path &pref_path);
 bool init(IOState &io, const fs::path &base_path, const fs::path &pref_path, bool redirect_stdout);
 
-bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path);
-fs::path find_in_cache(IOState &io, const std::string &system_path);
+// return the real path of a file of an app or of an addcont whose case differs on a case sensitive filesystem, empty if it is not found
+fs::path find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path);
 
 std::string expand_path(IOState &io, const char *path, const std::wstring &pref_path);
 std::string translate_path(const char *path, VitaIoDevice &device, const IOState::DevicePaths &device_paths);
@@ -75,7 +75,10 @@ SceOff tell_file(IOState &io, const SceUID fd, const char *export_name);
 int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name, SceUID fd = invalid_fd);
 int stat_file_by_fd(IOState &io, const SceUID fd, SceIoStat *statp, const std::wstring &pref_path, const char *export_name);
 int close_file(IOState &io, SceUID fd, const char *export_name);
+int sync_file(IOState &io, SceUID fd, const char *export_name);
 int remove_file(IOState &io, const char *file, const std::wstring &pref_path, const char *export_name);
+// read a whole file of savedata0 with the savedata file cache, return false if it doesn't exist
+bool read_cached_savedata_file(IOState &io, const char *path, std::vector<uint8_t> &data, const std::wstring &pref_path, const char *export_name);
 
 SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, const char *export_name);
 SceUID read_dir(IOState &io, SceUID fd, SceIoDirent *dent, const std::wstring &pref_path, const char *export_name);
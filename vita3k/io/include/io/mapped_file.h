@@ -0,0 +1,57 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <cstdint>
+#include <memory>
+
+// Read only mapping of a whole file, the reads are served by the page cache of the host
+class MappedFile {
+public:
+    // files smaller than this are not worth a mapping
+    static constexpr uint64_t MIN_SIZE = 64 * 1024;
+    // bigger files would exhaust the address space of 32-bit hosts
+    static constexpr uint64_t MAX_SIZE = sizeof(void *) >= 8 ? UINT64_MAX : 256 * 1024 * 1024;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    // return null if the file can't or shouldn't be mapped, the file is then read as usual
+    static std::shared_ptr<const MappedFile> create(const fs::path &path);
+
+    const uint8_t *data() const {
+        return mapped_data;
+    }
+
+    uint64_t size() const {
+        return mapped_size;
+    }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t *mapped_data = nullptr;
+    uint64_t mapped_size = 0;
+#ifdef WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#endif
+};
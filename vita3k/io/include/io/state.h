@@ -17,30 +17,55 @@
 
 #pragma once
 
+#include <io/block_cache.h>
 #include <io/filesystem.h>
+#include <io/mapped_file.h>
 #include <io/types.h>
 #include <io/util.h>
+#include <io/write_back.h>
 
+#include <ctime>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
 
 // Class for all needed information to access files on Vita3K.
 class FileStats : public VitaStats {
     // Shared file pointer
     FilePtr wrapped_file;
+    // set when the file is opened read only and the block cache is enabled
+    BlockCache *block_cache = nullptr;
+    // end of the last read, to detect the sequential reads
+    mutable SceOff last_read_end = -1;
+    // set when the file is opened read only from a read only device, the reads and seeks then don't use wrapped_file
+    std::shared_ptr<const MappedFile> mapped_file;
+    mutable SceOff mapped_position = 0;
+    // set when the file is buffered until it is written back, the file operations then don't use wrapped_file
+    WriteBackFilePtr write_back;
+    mutable SceOff write_back_position = 0;
+
+    void set_file_info(const char *vita, const std::string &t, const fs::path &file, const int open) {
+        file_info.vita_loc = vita;
+        file_info.translated = t;
+        file_info.sys_loc = file;
+        file_info.open_mode = open;
+        file_info.file_mode = SCE_SO_IFREG | SCE_SO_IROTH;
+        file_info.access_mode = SCE_S_IFREG;
+    }
 
 public:
     // Constructor used for files
     // Based on https://codereview.stackexchange.com/questions/4679/
     explicit FileStats(const char *vita, const std::string &t, const fs::path &file, const int open) {
         wrapped_file = create_shared_file(file, open);
+        set_file_info(vita, t, file, open);
+    }
 
-        file_info.vita_loc = vita;
-        file_info.translated = t;
-        file_info.sys_loc = file;
-        file_info.open_mode = open;
-        file_info.file_mode = SCE_SO_IFREG | SCE_SO_IROTH;
-        file_info.access_mode = SCE_S_IFREG;
+    // Constructor used for the files buffered until they are written back
+    explicit FileStats(const char *vita, const std::string &t, const fs::path &file, const int open, WriteBackFilePtr buffer)
+        : write_back(std::move(buffer)) {
+        set_file_info(vita, t, file, open);
     }
 
     bool is_regular_file() const {
@@ -55,6 +80,20 @@ public:
         return can_write(file_info.open_mode);
     }
 
+    void set_block_cache(BlockCache *cache) {
+        block_cache = cache;
+    }
+
+    // return false if the file can't be mapped
+    bool map_file() {
+        mapped_file = MappedFile::create(file_info.sys_loc);
+        return mapped_file != nullptr;
+    }
+
+    const WriteBackFilePtr &get_write_back() const {
+        return write_back;
+    }
+
     // File operations
     FILE *get_file_pointer() const {
         return wrapped_file.get();
@@ -120,11 +159,29 @@ struct IOState {
     StdFiles std_files;
     DirEntries dir_entries;
 
-    std::unordered_map<std::string, std::string> cachemap;
+    // entries of the directories listed by the case-insensitive path finding, keyed by their path
+    struct CaseInsensitiveDir {
+        bool listed = false;
+        std::time_t last_write_time = 0;
+        // lowercased name -> real name
+        std::unordered_map<std::string, std::string> names;
+    };
+    std::mutex case_isens_mutex;
+    std::unordered_map<std::string, CaseInsensitiveDir> case_isens_dirs;
     bool case_isens_find_enabled = false;
 
     std::mutex overlay_mutex;
     SceUID next_overlay_id = 1;
     // overlay in the order they should be applied
     std::vector<FiosOverlay> overlays;
+
+    // null when disabled
+    std::unique_ptr<BlockCache> block_cache;
+    // buffers the files written to savedata0 and the SQLite databases
+    WriteBackFiles write_back;
+
+    // small savedata files read again and again by the HLE modules, like the slot params listed by the savedata dialog,
+    // by system path and empty when the file doesn't exist, a file is dropped once it is opened for writing or removed
+    std::mutex savedata_file_cache_mutex;
+    std::unordered_map<std::string, std::optional<std::vector<uint8_t>>> savedata_file_cache;
 };
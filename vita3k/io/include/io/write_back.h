@@ -0,0 +1,102 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <io/filesystem.h>
+#include <io/types.h>
+#include <threads/job_pool.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Content of a file opened for writing, shared by all its fds until it is written back
+struct WriteBackFile {
+    fs::path path;
+
+    // lock it to access data and dirty, the write back reads them from another thread
+    std::mutex mutex;
+    std::vector<uint8_t> data;
+    // data was changed since it was last written back
+    bool dirty = false;
+    // time of the open or of the last checkpoint
+    std::chrono::steady_clock::time_point last_checkpoint;
+    // read and write calls on the buffer, SQLite reads and writes a page per call
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+};
+
+typedef std::shared_ptr<WriteBackFile> WriteBackFilePtr;
+
+// Totals of all the files buffered since the start
+struct WriteBackStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t checkpoints = 0;
+};
+
+// Buffers in memory the files written by the guest, and writes them back in the background once they are closed.
+// The content is written to a temporary file renamed over the file, so a crash never leaves a partially written file
+class WriteBackFiles {
+public:
+    WriteBackFiles() = default;
+    ~WriteBackFiles();
+
+    // return the buffer of a file opened for writing, or of a file opened read only while it is buffered
+    // return null when the file is read only and isn't buffered, or when it can't be read and isn't created
+    WriteBackFilePtr open(const fs::path &path, int open_mode);
+    // write the file back in the background once it is closed by all its fds
+    void close(const WriteBackFilePtr &file);
+    // called when the guest syncs the file, it is then written back in the background while it stays open
+    // if it wasn't for CHECKPOINT_INTERVAL, so the files kept open are not only written back when the emulation stops
+    void sync(const WriteBackFilePtr &file);
+    // size of the file if it is buffered, -1 otherwise
+    SceOff size(const fs::path &path);
+    // wait for the files closed to be written back
+    void flush();
+    WriteBackStats get_stats();
+
+    static constexpr std::chrono::seconds CHECKPOINT_INTERVAL{ 5 };
+
+private:
+    struct Entry {
+        WriteBackFilePtr file;
+        uint32_t open_count = 0;
+        uint32_t pending_writes = 0;
+    };
+
+    // write the current content of the file in the background
+    void write_back(Entry &entry);
+    // drop the entry once the file is closed and written back, keeping its stats
+    void erase(std::unordered_map<std::string, Entry>::iterator entry);
+
+    std::mutex mutex;
+    // buffered files, keyed by their path, until they are closed and written back
+    std::unordered_map<std::string, Entry> files;
+    // stats of the files already erased
+    WriteBackStats erased_stats;
+    uint64_t checkpoints = 0;
+    // the writes are done in order by a single thread, waiting for the last one waits for all of them
+    JobPtr last_write;
+
+    // declared last so the pending writes are done before the buffers are destroyed
+    JobPool write_pool{ 1 };
+};
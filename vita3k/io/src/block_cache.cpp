@@ -0,0 +1,172 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#define _FILE_OFFSET_BITS 64
+#include <stdio.h>
+#endif
+
+#include <io/block_cache.h>
+
+#include <cstring>
+
+static bool seek_set(FILE *file, const uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+BlockCache::BlockCache(const size_t max_size)
+    : max_size(max_size) {
+}
+
+BlockCache::BlockData BlockCache::find_block(const std::string &path, const uint64_t index) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto file = files.find(path);
+    if (file == files.end())
+        return nullptr;
+
+    const auto block = file->second.find(index);
+    if (block == file->second.end())
+        return nullptr;
+
+    lru.splice(lru.begin(), lru, block->second);
+    return block->second->data;
+}
+
+BlockCache::BlockData BlockCache::load_block(const std::string &path, FILE *file, const uint64_t index) {
+    const uint64_t invalidation_count_before = invalidation_count.load();
+    if (!seek_set(file, index * BLOCK_SIZE))
+        return nullptr;
+
+    auto data = std::make_shared<std::vector<uint8_t>>(BLOCK_SIZE);
+    data->resize(fread(data->data(), 1, BLOCK_SIZE, file));
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto &blocks = files[path];
+    // another thread may have loaded it in the meantime, or the file may have changed while it was read
+    if (blocks.contains(index) || invalidation_count != invalidation_count_before)
+        return data;
+
+    lru.push_front({ path, index, data });
+    blocks.emplace(index, lru.begin());
+    size += BLOCK_SIZE;
+
+    while (size > max_size && lru.size() > 1) {
+        const Block &oldest = lru.back();
+        const auto oldest_file = files.find(oldest.path);
+        oldest_file->second.erase(oldest.index);
+        if (oldest_file->second.empty())
+            files.erase(oldest_file);
+        lru.pop_back();
+        size -= BLOCK_SIZE;
+    }
+
+    return data;
+}
+
+size_t BlockCache::read(const fs::path &path, FILE *file, const SceOff offset, void *data, const size_t size) {
+    if (size > MAX_CACHED_READ_SIZE) {
+        if (!seek_set(file, offset))
+            return 0;
+        return fread(data, 1, size, file);
+    }
+
+    const std::string path_str = path.string();
+    size_t done = 0;
+    while (done < size) {
+        const uint64_t index = (offset + done) / BLOCK_SIZE;
+        const size_t block_offset = (offset + done) % BLOCK_SIZE;
+
+        BlockData block = find_block(path_str, index);
+        if (!block)
+            block = load_block(path_str, file, index);
+        if (!block || block_offset >= block->size())
+            break;
+
+        const size_t copied = std::min(size - done, block->size() - block_offset);
+        memcpy(static_cast<uint8_t *>(data) + done, block->data() + block_offset, copied);
+        done += copied;
+
+        // end of the file
+        if (block->size() < BLOCK_SIZE)
+            break;
+    }
+
+    return done;
+}
+
+void BlockCache::prefetch(const fs::path &path, const SceOff offset, const size_t size) {
+    if (size == 0 || contains(path, offset, size))
+        return;
+
+    prefetch_pool.submit([this, path, offset, size]() {
+        // the fds of the guest are used by its threads, the prefetch has its own
+        const FilePtr file = create_shared_file(path, SCE_O_RDONLY);
+        if (!file)
+            return;
+
+        const std::string path_str = path.string();
+        for (uint64_t index = offset / BLOCK_SIZE; index <= (offset + size - 1) / BLOCK_SIZE; index++) {
+            if (find_block(path_str, index))
+                continue;
+
+            const BlockData block = load_block(path_str, file.get(), index);
+            if (!block || block->size() < BLOCK_SIZE)
+                break;
+        }
+    });
+}
+
+bool BlockCache::contains(const fs::path &path, const SceOff offset, const size_t size) {
+    if (size == 0)
+        return true;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto file = files.find(path.string());
+    if (file == files.end())
+        return false;
+
+    for (uint64_t index = offset / BLOCK_SIZE; index <= (offset + size - 1) / BLOCK_SIZE; index++) {
+        const auto block = file->second.find(index);
+        if (block == file->second.end())
+            return false;
+        // the range goes past the end of the file
+        if (block->second->data->size() < BLOCK_SIZE)
+            return true;
+    }
+
+    return true;
+}
+
+void BlockCache::invalidate(const fs::path &path) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    invalidation_count++;
+    const auto file = files.find(path.string());
+    if (file == files.end())
+        return;
+
+    for (const auto &[index, block] : file->second) {
+        lru.erase(block);
+        size -= BLOCK_SIZE;
+    }
+    files.erase(file);
+}
@@ -36,7 +36,9 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <string>
@@ -158,7 +160,29 @@ bool init_savedata_app_path(IOState &io, const fs::path &pref_path) {
     return true;
 }
 
-bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path) {
+// Find the real name of an entry of a directory, only lists the directory again when it was modified
+static std::string find_case_isens_entry(IOState &io, const fs::path &dir, const std::string &name) {
+    boost::system::error_code error_code{};
+    const std::time_t last_write_time = fs::last_write_time(dir, error_code);
+    if (error_code)
+        return std::string{};
+
+    auto &entries = io.case_isens_dirs[dir.string()];
+    if (!entries.listed || entries.last_write_time != last_write_time) {
+        entries.names.clear();
+        for (const auto &entry : fs::directory_iterator(dir, error_code)) {
+            const std::string entry_name = entry.path().filename().string();
+            entries.names.emplace(string_utils::tolower(entry_name), entry_name);
+        }
+        entries.last_write_time = last_write_time;
+        entries.listed = true;
+    }
+
+    const auto entry = entries.names.find(string_utils::tolower(name));
+    return entry != entries.names.end() ? entry->second : std::string{};
+}
+
+fs::path find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &translated_path, const fs::path &system_path) {
     std::string final_path{};
 
     switch (device) {
@@ -173,28 +197,33 @@ bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &tra
         break;
     }
     default: {
-        return false;
+        return fs::path{};
     }
     }
 
     if (!fs::exists(final_path))
-        return false;
-
-    for (const auto &file : fs::recursive_directory_iterator(final_path)) {
-        io.cachemap.insert(std::make_pair(string_utils::tolower(file.path().string()), file.path().string()));
-    }
+        return fs::path{};
 
-    return true;
-}
+    // Resolve the path one directory at a time, starting from the root of the app or of the addcont
+    const std::lock_guard<std::mutex> lock(io.case_isens_mutex);
+    fs::path found_path{ final_path };
+    for (const auto &name : fs::path(system_path.string().substr(final_path.size()))) {
+        const std::string name_str = name.string();
+        if (name_str.empty() || name_str == "/" || name_str == ".")
+            continue;
 
-fs::path find_in_cache(IOState &io, const std::string &system_path) {
-    const auto find_path = io.cachemap.find(system_path);
+        if (fs::exists(found_path / name)) {
+            found_path /= name;
+            continue;
+        }
 
-    if (find_path != io.cachemap.end()) {
-        return fs::path{ find_path->second.c_str() };
-    } else {
-        return fs::path{};
+        const std::string real_name = find_case_isens_entry(io, found_path, name_str);
+        if (real_name.empty())
+            return fs::path{};
+        found_path /= real_name;
     }
+
+    return found_path;
 }
 
 std::string translate_path(const char *path, VitaIoDevice &device, const IOState::DevicePaths &device_paths) {
@@ -269,6 +298,28 @@ std::string expand_path(IOState &io, const char *path, const std::wstring &pref_
     return device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio).string();
 }
 
+// SQLite databases and their journals are written a page at a time and synced at each transaction
+static bool is_sqlite_file(const fs::path &path) {
+    const std::string name = path.filename().string();
+    if (name.ends_with("-journal") || name.ends_with("-wal"))
+        return true;
+
+    const std::string extension = string_utils::tolower(path.extension().string());
+    if ((extension == ".db") || (extension == ".sqlite") || (extension == ".sqlite3"))
+        return true;
+
+    // the databases of some titles have no extension
+    static constexpr char SQLITE_HEADER[] = "SQLite format 3";
+    char header[sizeof(SQLITE_HEADER)] = {};
+    fs::ifstream file(path, std::ios::in | std::ios::binary);
+    return file.read(header, sizeof(header)) && (memcmp(header, SQLITE_HEADER, sizeof(header)) == 0);
+}
+
+static void drop_cached_savedata_file(IOState &io, const fs::path &system_path) {
+    std::lock_guard<std::mutex> lock(io.savedata_file_cache_mutex);
+    io.savedata_file_cache.erase(system_path.string());
+}
+
 SceUID open_file(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name) {
     auto device = device::get_device(path);
     auto device_for_icase = device;
@@ -306,19 +357,12 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
             if (io.case_isens_find_enabled) {
                 // Attempt a case-insensitive file search.
                 const auto original_system_path = system_path;
-                const auto cached_path = find_in_cache(io, string_utils::tolower(system_path.string()));
-                if (!cached_path.empty()) {
-                    system_path = cached_path;
-                    LOG_TRACE("Found cached filepath at {}", system_path.string());
+                system_path = find_case_isens_path(io, device_for_icase, translated_path, system_path);
+                if (!system_path.empty()) {
+                    LOG_TRACE("Found file on case-sensitive filesystem at {}", system_path.string());
                 } else {
-                    const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, system_path);
-                    system_path = find_in_cache(io, string_utils::tolower(system_path.string()));
-                    if (!system_path.empty() && path_found) {
-                        LOG_TRACE("Found file on case-sensitive filesystem at {}", system_path.string());
-                    } else {
-                        LOG_ERROR("Missing file at {} (target path: {})", original_system_path.string(), path);
-                        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                    }
+                    LOG_ERROR("Missing file at {} (target path: {})", original_system_path.string(), path);
+                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
                 }
             } else {
                 LOG_ERROR("Missing file at {} (target path: {})", system_path.string(), path);
@@ -334,7 +378,24 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
 
     const auto normalized_path = device::construct_normalized_path(device, translated_path);
 
-    FileStats f{ path, normalized_path, system_path, flags };
+    // the files of the read only devices are mapped, unless the block cache reads them ahead
+    const bool is_read_only_device = (device_for_icase == VitaIoDevice::app0) || (device_for_icase == VitaIoDevice::addcont0) || (device_for_icase == VitaIoDevice::vs0);
+    // translate_path redirects savedata0 to ux0, device_for_icase is still the device of the path
+    const bool is_savedata = (device_for_icase == VitaIoDevice::savedata0) || (device_for_icase == VitaIoDevice::savedata1);
+    if (is_savedata && can_write(flags))
+        drop_cached_savedata_file(io, system_path);
+    // the savedata and the SQLite databases are buffered while they are written, and written back once closed
+    const bool buffered = is_savedata || (!is_read_only_device && is_sqlite_file(system_path));
+    WriteBackFilePtr write_back = buffered ? io.write_back.open(system_path, flags) : nullptr;
+    FileStats f = write_back ? FileStats{ path, normalized_path, system_path, flags, std::move(write_back) } : FileStats{ path, normalized_path, system_path, flags };
+    if (is_read_only_device && !can_write(flags) && !io.block_cache)
+        f.map_file();
+    if (io.block_cache) {
+        if (can_write(flags))
+            io.block_cache->invalidate(system_path);
+        else
+            f.set_block_cache(io.block_cache.get());
+    }
     const auto fd = io.next_fd++;
     io.std_files.emplace(fd, f);
 
@@ -403,6 +464,8 @@ int write_file(SceUID fd, const void *data, const SceSize size, const IOState &i
     }
 
     if (file->second.can_write_file()) {
+        if (io.block_cache)
+            io.block_cache->invalidate(file->second.get_system_location());
         const auto written = file->second.write(data, 1, size);
         LOG_TRACE_IF(log_file_op, "{}: Writing to fd: {}, size: {}", export_name, log_hex(fd), size);
         return static_cast<int>(written);
@@ -418,6 +481,8 @@ int truncate_file(const SceUID fd, unsigned long long length, const IOState &io,
     const auto file = io.std_files.find(fd);
     if (file == io.std_files.end())
         return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+    if (io.block_cache)
+        io.block_cache->invalidate(file->second.get_system_location());
     auto trunc = file->second.truncate(length);
     LOG_TRACE_IF(log_file_op, "{}: Truncating fd: {}, to size: {}", export_name, log_hex(fd), length);
     return trunc;
@@ -485,19 +550,12 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
             if (io.case_isens_find_enabled) {
                 // Attempt a case-insensitive file search.
                 const auto original_file_path = file_path;
-                const auto cached_path = find_in_cache(io, string_utils::tolower(file_path.string()));
-                if (!cached_path.empty()) {
-                    file_path = cached_path;
-                    LOG_TRACE("Found cached filepath at {}", file_path.string());
+                file_path = find_case_isens_path(io, device_for_icase, translated_path, file_path);
+                if (!file_path.empty()) {
+                    LOG_TRACE("Found file on case-sensitive filesystem at {}", file_path.string());
                 } else {
-                    const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, file_path);
-                    file_path = find_in_cache(io, string_utils::tolower(file_path.string()));
-                    if (!file_path.empty() && path_found) {
-                        LOG_TRACE("Found file on case-sensitive filesystem at {}", file_path.string());
-                    } else {
-                        LOG_ERROR("Missing file at {} (target path: {})", original_file_path.string(), file);
-                        return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                    }
+                    LOG_ERROR("Missing file at {} (target path: {})", original_file_path.string(), file);
+                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
                 }
             } else {
                 LOG_ERROR("Missing file at {} (target path: {})", file_path.string(), file);
@@ -543,7 +601,9 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
     statp->st_mode = SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH | SCE_S_IXUSR | SCE_S_IXGRP | SCE_S_IXOTH;
 
     if (fs::is_regular_file(file_path)) {
-        statp->st_size = fs::file_size(file_path);
+        // the file may be buffered and not written back yet
+        const SceOff buffered_size = io.write_back.size(file_path);
+        statp->st_size = (buffered_size >= 0) ? buffered_size : fs::file_size(file_path);
         statp->st_attr = SCE_SO_IFREG;
         statp->st_mode |= SCE_S_IFREG;
     }
@@ -578,7 +638,35 @@ int close_file(IOState &io, const SceUID fd, const char *export_name) {
     LOG_TRACE_IF(log_file_op, "{}: Closing file fd: {}", export_name, log_hex(fd));
 
     io.tty_files.erase(fd);
-    io.std_files.erase(fd);
+    const auto file = io.std_files.find(fd);
+    if (file != io.std_files.end()) {
+        if (file->second.get_write_back()) {
+            io.write_back.close(file->second.get_write_back());
+            // it could have been read while it was written
+            if (file->second.can_write_file())
+                drop_cached_savedata_file(io, file->second.get_system_location());
+        }
+        io.std_files.erase(file);
+    }
+
+    return 0;
+}
+
+int sync_file(IOState &io, const SceUID fd, const char *export_name) {
+    if (io.tty_files.contains(fd))
+        return 0;
+
+    const auto file = io.std_files.find(fd);
+    if (file == io.std_files.end())
+        return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+
+    LOG_TRACE_IF(log_file_op, "{}: Syncing file fd: {}", export_name, log_hex(fd));
+
+    // the buffered files are only checkpointed from time to time, SQLite syncs them at each transaction
+    if (file->second.get_write_back())
+        io.write_back.sync(file->second.get_write_back());
+    else if (file->second.get_file_pointer())
+        fflush(file->second.get_file_pointer());
 
     return 0;
 }
@@ -589,6 +677,7 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
         LOG_ERROR("Cannot find device for path: {}", file);
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
+    const bool is_savedata = (device == VitaIoDevice::savedata0) || (device == VitaIoDevice::savedata1);
 
     const auto translated_path = translate_path(file, device, io.device_paths);
     if (translated_path.empty()) {
@@ -603,6 +692,14 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
 
     LOG_TRACE_IF(log_file_op, "{}: Removing file {} ({})", export_name, file, device::construct_normalized_path(device, translated_path));
 
+    if (io.block_cache)
+        io.block_cache->invalidate(emulated_path);
+    // a pending write back would create the file again
+    if (is_savedata || (io.write_back.size(emulated_path) >= 0))
+        io.write_back.flush();
+    if (is_savedata)
+        drop_cached_savedata_file(io, emulated_path);
+
     boost::system::error_code error_code{};
     auto res = fs::detail::remove(emulated_path, &error_code);
 
@@ -615,6 +712,32 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
     return 0;
 }
 
+bool read_cached_savedata_file(IOState &io, const char *path, std::vector<uint8_t> &data, const std::wstring &pref_path, const char *export_name) {
+    const std::string system_path = expand_path(io, path, pref_path);
+    std::lock_guard<std::mutex> lock(io.savedata_file_cache_mutex);
+    auto file = io.savedata_file_cache.find(system_path);
+    if (file == io.savedata_file_cache.end()) {
+        // read through open_file, the content of a file not written back yet is then found
+        std::optional<std::vector<uint8_t>> content;
+        const auto fd = open_file(io, path, SCE_O_RDONLY, pref_path, export_name);
+        if (fd >= 0) {
+            const SceOff size = seek_file(fd, 0, SCE_SEEK_END, io, export_name);
+            seek_file(fd, 0, SCE_SEEK_SET, io, export_name);
+            content.emplace(std::max<SceOff>(size, 0));
+            const int read = read_file(content->data(), io, fd, static_cast<SceSize>(content->size()), export_name);
+            content->resize(std::max(read, 0));
+            close_file(io, fd, export_name);
+        }
+        file = io.savedata_file_cache.emplace(system_path, std::move(content)).first;
+    }
+
+    if (!file->second)
+        return false;
+
+    data = *file->second;
+    return true;
+}
+
 SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, const char *export_name) {
     auto device = device::get_device(path);
     auto device_for_icase = device;
@@ -625,19 +748,12 @@ SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, co
         if (io.case_isens_find_enabled) {
             // Attempt a case-insensitive file search.
             const auto original_dir_path = dir_path;
-            const auto cached_path = find_in_cache(io, string_utils::tolower(dir_path.string()));
-            if (!cached_path.empty()) {
-                dir_path = cached_path;
-                LOG_TRACE("Found cached directory path at {}", dir_path.string());
+            dir_path = find_case_isens_path(io, device_for_icase, translated_path, dir_path);
+            if (!dir_path.empty()) {
+                LOG_TRACE("Found directory on case-sensitive filesystem at {}", dir_path.string());
             } else {
-                const bool path_found = find_case_isens_path(io, device_for_icase, translated_path, dir_path);
-                dir_path = find_in_cache(io, string_utils::tolower(dir_path.string().substr(0, dir_path.string().size() - 1)));
-                if (!dir_path.empty() && path_found) {
-                    LOG_TRACE("Found directory on case-sensitive filesystem at {}", dir_path.string());
-                } else {
-                    LOG_ERROR("Directory does not exist at {} (target path: {})", original_dir_path.string(), path);
-                    return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
-                }
+                LOG_ERROR("Directory does not exist at {} (target path: {})", original_dir_path.string(), path);
+                return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
             }
         } else {
             LOG_ERROR("Directory does not exist at: {} (target path: {})", dir_path.string(), path);
@@ -783,6 +899,7 @@ int remove_dir(IOState &io, const char *dir, const std::wstring &pref_path, cons
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
+    const bool is_savedata = (device == VitaIoDevice::savedata0) || (device == VitaIoDevice::savedata1);
     const auto translated_path = translate_path(dir, device, io.device_paths);
     if (translated_path.empty()) {
         LOG_ERROR("Cannot translate path: {}", dir);
@@ -791,6 +908,12 @@ int remove_dir(IOState &io, const char *dir, const std::wstring &pref_path, cons
 
     LOG_TRACE_IF(log_file_op, "{}: Removing dir {} ({})", export_name, dir, device::construct_normalized_path(device, translated_path));
 
+    if (is_savedata) {
+        io.write_back.flush();
+        std::lock_guard<std::mutex> lock(io.savedata_file_cache_mutex);
+        io.savedata_file_cache.clear();
+    }
+
     if (!fs::remove_all(device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio))) {
         LOG_ERROR("Cannot remove dir: {} ({})", dir, device::construct_normalized_path(device, translated_path));
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
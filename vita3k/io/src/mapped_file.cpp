@@ -0,0 +1,87 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/mapped_file.h>
+
+#include <util/log.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const MappedFile> MappedFile::create(const fs::path &path) {
+    boost::system::error_code error_code{};
+    const uint64_t size = fs::file_size(path, error_code);
+    if (error_code || size < MIN_SIZE || size > MAX_SIZE)
+        return nullptr;
+
+    std::shared_ptr<MappedFile> file{ new MappedFile() };
+#ifdef WIN32
+    file->file_handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file_handle == INVALID_HANDLE_VALUE) {
+        file->file_handle = nullptr;
+        return nullptr;
+    }
+
+    file->mapping_handle = CreateFileMappingW(file->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->mapping_handle) {
+        LOG_WARN("CreateFileMappingW failed for {}: {}", path.string(), log_hex(GetLastError()));
+        return nullptr;
+    }
+
+    file->mapped_data = static_cast<const uint8_t *>(MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!file->mapped_data) {
+        LOG_WARN("MapViewOfFile failed for {}: {}", path.string(), log_hex(GetLastError()));
+        return nullptr;
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    void *const data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid once the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG_WARN("mmap failed for {}", path.string());
+        return nullptr;
+    }
+    file->mapped_data = static_cast<const uint8_t *>(data);
+#endif
+    file->mapped_size = size;
+
+    return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef WIN32
+    if (mapped_data)
+        UnmapViewOfFile(mapped_data);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+#else
+    if (mapped_data)
+        munmap(const_cast<uint8_t *>(mapped_data), mapped_size);
+#endif
+}
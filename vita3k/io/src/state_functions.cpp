@@ -26,21 +26,81 @@
 
 #include <io/state.h>
 
+#include <algorithm>
+#include <cstring>
+
 SceOff FileStats::read(void *input_data, const int element_size, const SceSize element_count) const {
+    if (write_back) {
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        const uint64_t size = static_cast<uint64_t>(element_size) * element_count;
+        const uint64_t position = std::min<uint64_t>(write_back_position, write_back->data.size());
+        const uint64_t read = (std::min(size, write_back->data.size() - position) / element_size) * element_size;
+        memcpy(input_data, write_back->data.data() + position, read);
+        write_back_position = position + read;
+        write_back->reads++;
+        return read / element_size;
+    }
+
     if (!wrapped_file)
         return -1;
 
-    return fread(input_data, element_size, element_count, wrapped_file.get());
+    if (mapped_file) {
+        const uint64_t size = static_cast<uint64_t>(element_size) * element_count;
+        const uint64_t position = std::min<uint64_t>(mapped_position, mapped_file->size());
+        // fread only returns complete elements
+        const uint64_t read = (std::min(size, mapped_file->size() - position) / element_size) * element_size;
+        memcpy(input_data, mapped_file->data() + position, read);
+        mapped_position += read;
+        return read / element_size;
+    }
+
+    if (!block_cache)
+        return fread(input_data, element_size, element_count, wrapped_file.get());
+
+    const SceOff offset = tell();
+    if (offset < 0)
+        return -1;
+
+    const size_t read = block_cache->read(file_info.sys_loc, wrapped_file.get(), offset, input_data, static_cast<size_t>(element_size) * element_count);
+    seek(offset + read, SCE_SEEK_SET);
+
+    if (offset == last_read_end)
+        block_cache->prefetch(file_info.sys_loc, offset + read, BlockCache::READ_AHEAD_BLOCKS * BlockCache::BLOCK_SIZE);
+    last_read_end = offset + read;
+
+    return read / element_size;
 }
 
 SceOff FileStats::write(const void *data, const SceSize size, const int count) const {
     if (!can_write_file())
         return -1;
 
+    if (write_back) {
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        const size_t bytes = static_cast<size_t>(size) * count;
+        // like fopen with "ab", the writes are always done at the end of the file
+        if (file_info.open_mode & SCE_O_APPEND)
+            write_back_position = write_back->data.size();
+        if (write_back_position + bytes > write_back->data.size())
+            write_back->data.resize(write_back_position + bytes);
+        memcpy(write_back->data.data() + write_back_position, data, bytes);
+        write_back_position += bytes;
+        write_back->dirty = true;
+        write_back->writes++;
+        return count;
+    }
+
     return fwrite(data, size, count, get_file_pointer());
 }
 
 int FileStats::truncate(const SceSize size) const {
+    if (write_back) {
+        const std::lock_guard<std::mutex> lock(write_back->mutex);
+        write_back->data.resize(size);
+        write_back->dirty = true;
+        return 0;
+    }
+
 #ifdef _WIN32
     return _chsize_s(_fileno(get_file_pointer()), size);
 #else
@@ -49,6 +109,22 @@ int FileStats::truncate(const SceSize size) const {
 }
 
 bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
+    if (write_back) {
+        SceOff position = offset;
+        if (seek_mode == SCE_SEEK_CUR)
+            position += write_back_position;
+        else if (seek_mode == SCE_SEEK_END) {
+            const std::lock_guard<std::mutex> lock(write_back->mutex);
+            position += write_back->data.size();
+        } else if (seek_mode != SCE_SEEK_SET)
+            return false;
+        if (position < 0)
+            return false;
+
+        write_back_position = position;
+        return true;
+    }
+
     if (!wrapped_file)
         return false;
 
@@ -67,6 +143,19 @@ bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
         return false;
     }
 
+    if (mapped_file) {
+        SceOff position = offset;
+        if (seek_mode == SCE_SEEK_CUR)
+            position += mapped_position;
+        else if (seek_mode == SCE_SEEK_END)
+            position += mapped_file->size();
+        if (position < 0)
+            return false;
+
+        mapped_position = position;
+        return true;
+    }
+
 #ifdef _WIN32
     return _fseeki64(wrapped_file.get(), offset, base) == 0;
 #else
@@ -75,9 +164,15 @@ bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
 }
 
 SceOff FileStats::tell() const {
+    if (write_back)
+        return write_back_position;
+
     if (!wrapped_file)
         return -1;
 
+    if (mapped_file)
+        return mapped_position;
+
 #ifdef _WIN32
     return _ftelli64(wrapped_file.get());
 #else
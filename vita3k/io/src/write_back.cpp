@@ -0,0 +1,195 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/util.h>
+#include <io/write_back.h>
+
+#include <util/log.h>
+
+#include <fstream>
+
+// write the content to a temporary file next to the file, then rename it over the file
+static bool write_file_atomically(const fs::path &path, const std::vector<uint8_t> &data) {
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+
+    {
+        fs::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        file.close();
+        if (!file)
+            return false;
+    }
+
+    boost::system::error_code error_code{};
+    fs::rename(temp_path, path, error_code);
+    return !error_code;
+}
+
+WriteBackFiles::~WriteBackFiles() {
+    // the files still open when the emulation stops are never closed by the guest
+    const std::lock_guard<std::mutex> lock(mutex);
+    WriteBackStats stats = erased_stats;
+    for (const auto &[path, entry] : files) {
+        const std::lock_guard<std::mutex> file_lock(entry.file->mutex);
+        stats.reads += entry.file->reads;
+        stats.writes += entry.file->writes;
+        if (entry.open_count == 0)
+            continue;
+
+        if (entry.file->dirty && !write_file_atomically(entry.file->path, entry.file->data))
+            LOG_ERROR("Failed to write back file {}", entry.file->path.string());
+    }
+
+    if (stats.reads || stats.writes)
+        LOG_INFO("Buffered files: {} reads, {} writes, {} checkpoints", stats.reads, stats.writes, checkpoints);
+}
+
+WriteBackFilePtr WriteBackFiles::open(const fs::path &path, const int open_mode) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto entry = files.find(path.string());
+    if (entry != files.end()) {
+        entry->second.open_count++;
+        return entry->second.file;
+    }
+
+    if (!can_write(open_mode))
+        return nullptr;
+
+    auto write_back = std::make_shared<WriteBackFile>();
+    write_back->path = path;
+
+    fs::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        write_back->data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(write_back->data.data()), write_back->data.size());
+        if (!file)
+            return nullptr;
+    } else if (open_mode & SCE_O_CREAT) {
+        // the file doesn't exist yet, it is created by its first write back even if nothing is written
+        write_back->dirty = true;
+    } else {
+        return nullptr;
+    }
+
+    write_back->last_checkpoint = std::chrono::steady_clock::now();
+    files[path.string()] = { write_back, 1, 0 };
+    return write_back;
+}
+
+void WriteBackFiles::write_back(Entry &entry) {
+    entry.pending_writes++;
+    last_write = write_pool.submit([this, file = entry.file]() {
+        {
+            // the file may have been opened and written again since, the latest content is written
+            const std::lock_guard<std::mutex> file_lock(file->mutex);
+            if (file->dirty) {
+                if (!write_file_atomically(file->path, file->data))
+                    LOG_ERROR("Failed to write back file {}", file->path.string());
+                file->dirty = false;
+            }
+        }
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto entry = files.find(file->path.string());
+        if ((--entry->second.pending_writes == 0) && (entry->second.open_count == 0))
+            erase(entry);
+    });
+}
+
+void WriteBackFiles::erase(std::unordered_map<std::string, Entry>::iterator entry) {
+    {
+        const std::lock_guard<std::mutex> file_lock(entry->second.file->mutex);
+        erased_stats.reads += entry->second.file->reads;
+        erased_stats.writes += entry->second.file->writes;
+    }
+    files.erase(entry);
+}
+
+void WriteBackFiles::close(const WriteBackFilePtr &file) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto entry = files.find(file->path.string());
+    if ((entry == files.end()) || (--entry->second.open_count > 0))
+        return;
+
+    bool dirty;
+    {
+        const std::lock_guard<std::mutex> file_lock(file->mutex);
+        dirty = file->dirty;
+    }
+    if (!dirty) {
+        if (entry->second.pending_writes == 0)
+            erase(entry);
+        return;
+    }
+
+    write_back(entry->second);
+}
+
+void WriteBackFiles::sync(const WriteBackFilePtr &file) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto entry = files.find(file->path.string());
+    if (entry == files.end())
+        return;
+
+    {
+        const std::lock_guard<std::mutex> file_lock(file->mutex);
+        const auto now = std::chrono::steady_clock::now();
+        if (!file->dirty || (now - file->last_checkpoint < CHECKPOINT_INTERVAL))
+            return;
+        file->last_checkpoint = now;
+    }
+
+    checkpoints++;
+    write_back(entry->second);
+}
+
+SceOff WriteBackFiles::size(const fs::path &path) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto entry = files.find(path.string());
+    if (entry == files.end())
+        return -1;
+
+    const std::lock_guard<std::mutex> file_lock(entry->second.file->mutex);
+    return static_cast<SceOff>(entry->second.file->data.size());
+}
+
+void WriteBackFiles::flush() {
+    JobPtr job;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        job = last_write;
+    }
+    if (job)
+        job->wait();
+}
+
+WriteBackStats WriteBackFiles::get_stats() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    WriteBackStats stats = erased_stats;
+    for (const auto &[path, entry] : files) {
+        const std::lock_guard<std::mutex> file_lock(entry.file->mutex);
+        stats.reads += entry.file->reads;
+        stats.writes += entry.file->writes;
+    }
+    stats.checkpoints = checkpoints;
+    return stats;
+}
@@ -0,0 +1,149 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Times the queues the threads wait in: the wait queues of the sync primitives with more and more waiting threads,
+// and the queue passing requests between host threads, alone and between a producer and a consumer.
+// Returns a non-zero value if a queue gives back the items in the wrong order.
+
+#include <kernel/thread/thread_data_queue.h>
+#include <kernel/thread/thread_state.h>
+#include <mem/state.h>
+#include <threads/queue.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+static constexpr int ITERATIONS = 100000;
+
+static constexpr std::size_t WAITING_THREAD_COUNTS[] = { 1, 8, 64, 256 };
+
+static constexpr int PRODUCED_ITEMS = 200000;
+
+// time of one run in nanoseconds, on average
+static double time_ns(const std::function<void()> &run, const int iterations = ITERATIONS) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        run();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// the threads wait with random priorities, the most urgent one is woken up and waits again
+template <typename Queue>
+static bool bench_wait_queue(const char *name, const std::vector<ThreadStatePtr> &threads, std::mt19937 &rng) {
+    // only the priority queue sorts the threads
+    constexpr bool is_sorted = std::is_same_v<Queue, PriorityThreadDataQueue<WaitingThreadData>>;
+    std::uniform_int_distribution<int32_t> priority_dist(64, 191);
+    bool success = true;
+    for (const std::size_t thread_count : WAITING_THREAD_COUNTS) {
+        Queue queue;
+        for (std::size_t i = 0; i < thread_count; i++) {
+            WaitingThreadData data{};
+            data.thread = threads[i];
+            data.priority = priority_dist(rng);
+            queue.push(data);
+        }
+
+        const double push_pop = time_ns([&]() {
+            WaitingThreadData data = *queue.begin();
+            queue.pop();
+            data.priority = priority_dist(rng);
+            queue.push(data);
+        });
+
+        // a thread leaving the queue when its wait times out, it is found from its own node
+        std::uniform_int_distribution<std::size_t> thread_dist(0, thread_count - 1);
+        const double erase = time_ns([&]() {
+            const ThreadStatePtr &thread = threads[thread_dist(rng)];
+            const auto it = queue.find(thread);
+            WaitingThreadData data = *it;
+            queue.erase(it);
+            queue.push(data);
+        });
+
+        // the waiting threads are woken up in order
+        int32_t last_priority = -1;
+        bool ordered = true;
+        for (const WaitingThreadData &data : queue) {
+            if (data.priority < last_priority)
+                ordered = false;
+            last_priority = data.priority;
+        }
+        if (!is_sorted)
+            ordered = true;
+        success &= ordered;
+
+        std::printf("%-16s %8zu %10.1f ns %10.1f ns%s\n", name, thread_count, push_pop, erase, ordered ? "" : "  WRONG ORDER");
+    }
+
+    return success;
+}
+
+static bool bench_request_queue() {
+    ::Queue<int> queue;
+    // the cost of the lock and of the allocations when the queue is not contended
+    const double alone = time_ns([&]() {
+        queue.push(1);
+        queue.pop();
+    });
+    std::printf("%-24s %10.1f ns\n", "push/pop same thread", alone);
+
+    bool ordered = true;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        for (int i = 0; i < PRODUCED_ITEMS; i++) {
+            const auto item = queue.pop();
+            if (!item || (*item != i))
+                ordered = false;
+        }
+    });
+    for (int i = 0; i < PRODUCED_ITEMS; i++)
+        queue.push(i);
+    consumer.join();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%-24s %10.1f ns %10.1f items/ms%s\n", "producer to consumer", elapsed_ns / PRODUCED_ITEMS,
+        PRODUCED_ITEMS * 1'000'000.0 / elapsed_ns, ordered ? "" : "  WRONG ORDER");
+
+    return ordered;
+}
+
+int main() {
+    std::mt19937 rng(42);
+    bool success = true;
+
+    // the threads are never run, their state only holds the wait nodes
+    MemState mem;
+    std::vector<ThreadStatePtr> threads;
+    for (std::size_t i = 0; i < WAITING_THREAD_COUNTS[std::size(WAITING_THREAD_COUNTS) - 1]; i++)
+        threads.push_back(std::make_shared<ThreadState>(static_cast<SceUID>(i + 1), mem));
+
+    std::printf("%-16s %8s %13s %13s\n", "wait queue", "threads", "wake/wait", "timeout");
+    success &= bench_wait_queue<PriorityThreadDataQueue<WaitingThreadData>>("priority", threads, rng);
+    success &= bench_wait_queue<FIFOThreadDataQueue<WaitingThreadData>>("fifo", threads, rng);
+
+    std::printf("\n");
+    success &= bench_request_queue();
+
+    return success ? 0 : 1;
+}
@@ -113,6 +113,14 @@ struct Callback {
      */
     void execute(KernelState &kernel, std::function<void()> deleter);
 
+    /**
+     * @brief Queues the callback on the callback queue of thread, to be run by ThreadState::run_queued_callbacks
+     * @param result Where the value returned by the callback is written, non-zero if it requested to be deleted
+     * @return true if the callback was notified and has been queued, false otherwise
+     * @note This should be called only in the creator thread
+     */
+    bool queue_execution(ThreadState &thread, uint32_t *result);
+
 private:
     void reset();
     bool is_notified() const;
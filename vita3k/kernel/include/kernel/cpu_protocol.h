@@ -21,17 +21,26 @@
 
 struct KernelState;
 
-typedef std::function<void(CPUState &cpu, uint32_t nid, SceUID thread_id)> CallImportFunc;
+// Set in the svc of an import stub once it is resolved to a HLE function, the lower bits being its index in the dispatch table
+constexpr uint32_t IMPORT_DISPATCH_SVC_FLAG = 0x800000;
+
+typedef std::function<void(CPUState &cpu, uint32_t svc, uint32_t nid, SceUID thread_id)> CallImportFunc;
+typedef std::function<bool(uint32_t svc)> IsInlineImportFunc;
 
 struct CPUProtocol : public CPUProtocolBase {
-    CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func);
+    CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func, const IsInlineImportFunc &is_inline_func);
     ~CPUProtocol() override = default;
     void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override;
+    bool call_svc_inline(CPUState &cpu, uint32_t svc, Address pc) override;
     Address get_watch_memory_addr(Address addr) override;
+    void record_translated_block(Address pc, bool thumb) override;
+    void record_dispatched_block(Address pc, bool thumb) override;
     ExclusiveMonitorPtr get_exlusive_monitor() override;
+    JitInvalidationLog *get_jit_invalidation_log() override;
 
 private:
     CallImportFunc call_import;
+    IsInlineImportFunc is_inline_import;
     KernelState *kernel;
     MemState *mem;
 };
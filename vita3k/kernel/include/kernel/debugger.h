@@ -17,7 +17,9 @@
 
 #pragma once
 #include <cpu/state.h>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mem/state.h>
 #include <mem/util.h>
 
@@ -46,6 +48,8 @@ struct Breakpoint {
 struct WatchMemory {
     Address start;
     size_t size;
+    // set while the pages are protected, the first access releases them until the watches are armed again
+    std::shared_ptr<std::atomic<bool>> armed;
 };
 
 typedef std::map<Address, WatchMemory> WatchMemoryAddrs;
@@ -65,8 +69,8 @@ struct Debugger {
     bool log_exports = false;
     bool dump_elfs = false;
 
-    void add_watch_memory_addr(Address addr, size_t size);
-    void remove_watch_memory_addr(KernelState &state, Address addr);
+    void add_watch_memory_addr(MemState &mem, Address addr, size_t size);
+    void remove_watch_memory_addr(MemState &mem, Address addr);
     void add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode);
     void remove_breakpoint(MemState &mem, uint32_t addr);
     void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback);
@@ -74,6 +78,8 @@ struct Debugger {
     void remove_trampoline(MemState &mem, uint32_t addr);
     Address get_watch_memory_addr(Address addr);
     void update_watches();
+    // protect again the pages of the watches released by an access, called at each vblank while the memory is watched
+    void rearm_watches(MemState &mem);
 
 private:
     std::mutex mutex;
@@ -0,0 +1,71 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cpu/state.h>
+#include <mem/state.h>
+#include <mem/util.h>
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <vector>
+
+constexpr uint32_t HLE_REPLACEMENT_SVC = 0x55;
+
+// Number of bytes from the start of a function which are compared to recognize it
+constexpr size_t HLE_SIGNATURE_SIZE = 64;
+// Number of bytes replaced at the start of a patched function
+constexpr size_t HLE_PATCH_SIZE = 12;
+
+enum class HleFunction : uint32_t {
+    Memcpy,
+    Memmove,
+    Memset,
+    Strlen,
+    Strcmp,
+    Count
+};
+
+// Code of a libc routine learnt from the exports of a LLE module, searched in the code of the modules loaded after it
+struct HleSignature {
+    HleFunction function;
+    bool thumb_mode;
+    std::array<uint8_t, HLE_SIGNATURE_SIZE> code;
+};
+
+struct HleReplacementState {
+    bool enabled = false;
+
+    std::mutex mutex;
+    std::vector<HleSignature> signatures;
+    // Original code of the patched functions
+    std::map<Address, std::array<uint8_t, HLE_PATCH_SIZE>> patched_functions;
+
+    void init(bool enabled);
+    // Learn the routines exported by a module, and patch them
+    void add_exports(MemState &mem, uint32_t nid, Address address);
+    // Patch every known routine found in [start, start + size)
+    void patch_module(MemState &mem, Address start, uint32_t size);
+    // Put back the guest code of the function patched at address, return false if it is not patched anymore
+    bool restore_function(MemState &mem, Address address);
+};
+
+// Call the host version of the routine whose svc is just before pc
+// Return false without running it if its arguments are not valid guest memory, its guest code must then be run instead
+bool call_hle_replacement(CPUState &cpu, MemState &mem, Address pc);
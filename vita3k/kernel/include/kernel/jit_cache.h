@@ -0,0 +1,68 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/util.h>
+#include <util/fs.h>
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Bump it whenever the JIT or the way guest code is translated changes, to drop outdated caches
+constexpr uint32_t JIT_CACHE_VERSION = 2;
+
+// Blocks reaching the dispatcher are only profiled for this long after boot, to catch the boot-to-menu path
+constexpr std::chrono::seconds JIT_PROFILE_DURATION{ 60 };
+
+// Entry points of the blocks the JIT translated in the code of one loaded module.
+// Dynarmic can't serialize its host code, so the blocks are translated again on the next boot,
+// but ahead of time instead of the first time the guest reaches them.
+// Blocks are stored as (offset from text_base << 1) | thumb.
+struct JitCacheModule {
+    std::string name;
+    uint32_t module_nid = 0;
+    Address text_base = 0;
+    uint32_t text_size = 0;
+    std::set<uint32_t> blocks;
+    // Blocks which reached the dispatcher during the last profiled boot, in the order they did
+    std::vector<uint32_t> hot_blocks;
+    std::set<uint32_t> profiled_blocks;
+    std::vector<uint32_t> profiled_order;
+    bool dirty = false;
+};
+
+struct JitCacheState {
+    bool enabled = false;
+    bool cpu_opt = false;
+    fs::path cache_path;
+    std::chrono::steady_clock::time_point profile_end;
+
+    std::mutex mutex;
+    std::vector<JitCacheModule> modules;
+
+    void init(const fs::path &base_path, const std::string &title_id, bool enabled, bool cpu_opt);
+    void load_module(const std::string &name, uint32_t module_nid, Address text_base, uint32_t text_size);
+    void record_block(Address pc, bool thumb);
+    void record_dispatched_block(Address pc, bool thumb);
+    // Guest addresses of every cached block, hot ones first, with the thumb bit set in bit 0
+    std::vector<Address> get_blocks();
+    void save();
+};
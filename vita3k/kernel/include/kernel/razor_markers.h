@@ -0,0 +1,50 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// Time spent by the guest threads in the Razor user markers of the app (sceRazorCpuPushMarker/PopMarker), by label.
+// Only measured while capturing is set, by the benchmark mode, which takes the times of each frame
+struct RazorMarkerStats {
+    std::atomic<bool> capturing = false;
+
+    // called by the guest thread popping a marker, nested markers are counted in their parent too
+    void add(const std::string &label, uint64_t time_us) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        times_us[label] += time_us;
+    }
+
+    // times since the previous call
+    std::map<std::string, uint64_t> take() {
+        std::map<std::string, uint64_t> times;
+        const std::lock_guard<std::mutex> lock(mutex);
+        std::swap(times, times_us);
+        return times;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, uint64_t> times_us;
+};
@@ -0,0 +1,92 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <util/host_cpu.h>
+
+struct ThreadState;
+
+constexpr int MAX_SCHEDULER_WORKERS = 64;
+
+// A thread which can't get a worker for this long runs without one, so that guest threads spinning on each other can't deadlock
+constexpr std::chrono::milliseconds SCHEDULER_MAX_WAIT{ 2 };
+
+// Limits the number of guest threads running guest code at the same time to a fixed number of workers,
+// worker i standing for the core i % 4 of the Vita.
+// A thread owns a worker while it runs guest code, and parks it whenever it goes back to the host (svc, wait, ...).
+// Taking a parked worker back is a single atomic operation, unless a ready thread took it meanwhile:
+// a parked or free worker goes to the waiting thread with the highest priority whose affinity mask allows its core.
+// Guest threads are also pinned to the host cpus of the guest cores they run on, if host pinning is set.
+struct ThreadScheduler {
+    // Disabled if worker_count is 0
+    void init(int worker_count);
+    // Host cpus mask of each guest core, null masks leave the threads to the OS scheduler
+    void set_host_affinity(const std::array<uint64_t, util::GUEST_CORE_COUNT> &guest_cores);
+
+    // Must be called by the thread before it runs guest code
+    void enter_guest(ThreadState &thread);
+    // Must be called by the thread when it goes back to the host
+    void leave_guest(ThreadState &thread);
+    // Must be called once the thread can't run guest code anymore
+    void remove_thread(ThreadState &thread);
+
+    bool is_enabled() const {
+        return !workers.empty();
+    }
+
+    // Number of times a thread waited for a worker, and ran without one after SCHEDULER_MAX_WAIT
+    std::atomic<uint64_t> wait_count = 0;
+    std::atomic<uint64_t> overflow_count = 0;
+
+private:
+    struct ReadyThread {
+        const ThreadState *thread;
+        int priority;
+        uint32_t cores;
+        uint64_t order;
+        int worker = -1;
+        std::condition_variable cond;
+    };
+
+    uint32_t get_cores(const ThreadState &thread) const;
+    void pin_thread(ThreadState &thread, uint32_t cores);
+    bool take_worker(int worker, uint32_t owner);
+    int take_available_worker(uint32_t cores, uint32_t owner);
+    void hand_off(int worker);
+
+    std::unique_ptr<std::atomic<uint32_t>[]> worker_owners;
+    // Guest core of every worker
+    std::vector<uint32_t> workers;
+    uint32_t all_cores = 0;
+    std::array<uint64_t, util::GUEST_CORE_COUNT> host_affinity{};
+    bool host_pinning = false;
+
+    std::mutex mutex;
+    std::vector<ReadyThread *> ready_threads;
+    std::atomic<uint32_t> ready_count = 0;
+    uint64_t next_order = 0;
+};
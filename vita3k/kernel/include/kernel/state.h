@@ -18,18 +18,28 @@
 #pragma once
 
 #include <cpu/functions.h>
+#include <cpu/jit_invalidation.h>
 #include <kernel/callback.h>
 #include <kernel/cpu_protocol.h>
 #include <kernel/debugger.h>
+#include <kernel/hle_replacement.h>
+#include <kernel/jit_cache.h>
+#include <kernel/razor_markers.h>
+#include <kernel/scheduler.h>
+#include <kernel/timer_wheel.h>
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
+#include <kernel/uid_table.h>
 #include <mem/allocator.h>
+#include <mem/block.h>
 #include <mem/ptr.h>
 #include <mem/util.h>
 #include <rtc/rtc.h>
 #include <util/pool.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <kernel/object_store.h>
 #include <map>
 #include <mutex>
@@ -59,9 +69,23 @@ typedef std::shared_ptr<SDL_Thread> ThreadPtr;
 typedef std::map<SceUID, ThreadPtr> ThreadPtrs;
 typedef std::shared_ptr<SceKernelModuleInfo> SceKernelModuleInfoPtr;
 typedef std::map<SceUID, SceKernelModuleInfoPtr> SceKernelModuleInfoPtrs;
-typedef std::map<SceUID, CallbackPtr> CallbackPtrs;
+typedef UidTable<Callback> CallbackPtrs;
 typedef std::unordered_map<uint32_t, Address> ExportNids;
+typedef std::unordered_map<uint32_t, std::vector<Address>> ImportDispatchStubs;
 typedef std::map<Address, uint32_t> NotFoundVars;
+
+// Libraries the loaded modules import functions from, to break down the HLE time of the threads
+struct ImportLibraries {
+    void add(const std::string &name, const uint32_t *nids, size_t count);
+    // Index in the HLE time of the threads, the last one for the unknown libraries and the ones past the others
+    size_t find(uint32_t nid);
+    std::string get_name(size_t index);
+
+private:
+    std::shared_mutex mutex;
+    std::vector<std::string> names;
+    std::unordered_map<uint32_t, uint32_t> by_nid;
+};
 typedef std::unique_ptr<CPUProtocol> CPUProtocolPtr;
 
 struct CodecEngineBlock {
@@ -122,8 +146,27 @@ typedef std::multimap<uint32_t, late_binding_info> VarLateBindingInfos;
 
 typedef std::map<uint32_t, uint32_t> ModuleUidByNid;
 
+// Host threads whose guest thread was deleted, they run the next threads created instead of exiting for a while
+// Shared with the host threads, so it outlives the kernel
+struct ParkedHostThreads {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<ThreadStatePtr> pending;
+    uint32_t idle = 0;
+    bool quit = false;
+};
+
+// Stacks of the deleted threads, the next threads created with the same stack size reuse them instead of committing new pages
+// Shared with the stack blocks, which are freed as usual once the kernel is gone
+struct ThreadStackPool {
+    std::mutex mutex;
+    std::multimap<int, Address> stacks;
+    size_t bytes = 0;
+};
+
 struct KernelState {
     KernelState();
+    ~KernelState();
 
     std::mutex mutex;
     CodecEngineBlocks codec_blocks;
@@ -143,44 +186,77 @@ struct KernelState {
     MsgPipePtrs msgpipes;
     CallbackPtrs callbacks;
 
+    // Iterate over threads with mutex locked, and look them up with get_thread
     ThreadStatePtrs threads;
+    UidTable<ThreadState> thread_table;
 
     SceKernelModuleInfoPtrs loaded_modules;
     LoadedSysmodules loaded_sysmodules;
     ExportNids export_nids;
+    // Import stubs patched to call a HLE function directly, by NID
+    ImportDispatchStubs import_dispatch_stubs;
+    ImportLibraries import_libraries;
     std::shared_mutex export_nids_mutex;
     VarLateBindingInfos late_binding_infos;
     ModuleUidByNid module_uid_by_nid;
 
     bool cpu_opt;
+    // Unsafe floating point optimizations of the JIT, with the fast optimization profile
+    bool cpu_unsafe_opt = false;
+    // Back off the host cpu when a guest thread spins on a loop polling memory
+    bool spin_poll_backoff = false;
+    // Host code cache of the JIT of each guest thread in MiB, the JIT clears it once it is full, 0 keeps the size of Dynarmic
+    uint32_t jit_code_cache_size = 0;
     CPUBackend cpu_backend;
     CorenumAllocator corenum_allocator;
     CPUProtocolPtr cpu_protocol;
     ExclusiveMonitorPtr exclusive_monitor;
+    bool per_core_exclusive_monitor = false;
+    JitInvalidationLog jit_invalidations;
 
     ObjectStore obj_store;
 
     uint64_t start_tick;
     SceRtcTick base_tick;
+    // the process time runs this many times faster, with the vblank rate multiplier
+    uint64_t process_time_scale = 1;
     TimerStates timers;
     Ptr<SceProcessParam> process_param;
 
     Debugger debugger;
+    JitCacheState jit_cache;
+    // folder of the segments of the modules inflated by the previous boots, empty when this cache is disabled
+    fs::path module_cache_path;
+    HleReplacementState hle_replacements;
+    ThreadScheduler scheduler;
+    TimerWheel timer_wheel;
+    RazorMarkerStats razor_markers;
+    std::shared_ptr<ParkedHostThreads> parked_host_threads = std::make_shared<ParkedHostThreads>();
+    std::shared_ptr<ThreadStackPool> thread_stack_pool = std::make_shared<ThreadStackPool>();
 
     SceUID get_next_uid() {
         return next_uid++;
     }
 
-    bool init(MemState &mem, CallImportFunc call_import, CPUBackend cpu_backend, bool cpu_opt);
+    // time since the process started in microseconds, tick being a rtc tick
+    uint64_t get_process_time(uint64_t tick) const {
+        return (tick - start_tick) * process_time_scale;
+    }
+
+    bool init(MemState &mem, CallImportFunc call_import, IsInlineImportFunc is_inline_import, CPUBackend cpu_backend, bool cpu_opt);
     void load_process_param(MemState &mem, Ptr<uint32_t> ptr);
     ThreadStatePtr create_thread(MemState &mem, const char *name, Ptr<const void> entry_point = Ptr<const void>(0));
     ThreadStatePtr create_thread(MemState &mem, const char *name, Ptr<const void> entry_point, int init_priority, SceInt32 affinity_mask, int stack_size, const SceKernelThreadOptParam *option);
 
-    ThreadStatePtr get_thread(SceUID thread_id);
+    // Reuse the stack of a deleted thread of the same size if there is one, its content is then left as it was
+    Block alloc_thread_stack(MemState &mem, int stack_size, const char *name);
+
+    ThreadStatePtr get_thread(SceUID thread_id) const;
     Ptr<Ptr<void>> get_thread_tls_addr(MemState &mem, SceUID thread_id, int key);
     void exit_delete_all_threads();
 
     void set_memory_watch(bool enabled);
+    // Applied by each thread the next time it enters the JIT
     void invalidate_jit_cache(Address start, size_t length);
     std::shared_ptr<SceKernelModuleInfo> find_module_by_addr(Address address);
 
@@ -19,60 +19,13 @@
 
 #include <cpu/common.h>
 #include <kernel/thread/thread_data_queue.h>
+#include <kernel/thread/thread_state.h>
 #include <kernel/types.h>
+#include <kernel/uid_table.h>
 #include <util/byte_ring_buffer.h>
 
 struct KernelState;
 
-struct WaitingThreadData {
-    ThreadStatePtr thread;
-    int32_t priority;
-    bool *was_canceled;
-
-    // additional fields for each primitive
-    union {
-        struct { // mutex
-            int32_t lock_count;
-        };
-        struct { // rwlock
-            bool is_write;
-        };
-        struct { // semaphore
-            int32_t signal;
-        };
-        struct { // simple events
-            int32_t pattern;
-            uint32_t *result_pattern;
-            uint64_t *user_data;
-        };
-        struct { // event flags
-            int32_t wait;
-            int32_t flags;
-            uint32_t *outBits;
-        };
-        // struct { }; // condvar
-        struct { // msgpipe
-            SceSize request_size;
-        } mp;
-    };
-
-    bool operator<(const WaitingThreadData &rhs) const {
-        return priority < rhs.priority;
-    }
-
-    bool operator>(const WaitingThreadData &rhs) const {
-        return priority > rhs.priority;
-    }
-
-    bool operator==(const WaitingThreadData &rhs) const {
-        return thread == rhs.thread;
-    }
-
-    bool operator==(const ThreadStatePtr &rhs) const {
-        return thread == rhs;
-    }
-};
-
 typedef std::unique_ptr<ThreadDataQueue<WaitingThreadData>> WaitingThreadQueuePtr;
 
 // NOTE: uid is copied to sync primitives here for debugging,
@@ -101,7 +54,7 @@ struct SimpleEvent : SyncPrimitive {
 };
 
 typedef std::shared_ptr<SimpleEvent> SimpleEventPtr;
-typedef std::map<SceUID, SimpleEventPtr> SimpleEventPtrs;
+typedef UidTable<SimpleEvent> SimpleEventPtrs;
 
 struct Semaphore : SyncPrimitive {
     WaitingThreadQueuePtr waiting_threads;
@@ -112,20 +65,26 @@ struct Semaphore : SyncPrimitive {
 };
 
 typedef std::shared_ptr<Semaphore> SemaphorePtr;
-typedef std::map<SceUID, SemaphorePtr> SemaphorePtrs;
+typedef UidTable<Semaphore> SemaphorePtrs;
 
+// Set in the owner of a lightweight mutex work area while threads are waiting for it
+constexpr uint32_t LW_MUTEX_OWNER_WAITERS = 0x80000000;
+
+// For lightweight mutexes, the owner and lock count are only kept in the work area
 struct Mutex : SyncPrimitive {
     int init_count;
     int lock_count;
     ThreadStatePtr owner;
     WaitingThreadQueuePtr waiting_threads;
     Ptr<SceKernelLwMutexWork> workarea;
+    // Number of times a thread had to wait for it
+    std::atomic<uint32_t> contention_count = 0;
 
     ~Mutex() override = default;
 };
 
 typedef std::shared_ptr<Mutex> MutexPtr;
-typedef std::map<SceUID, MutexPtr> MutexPtrs;
+typedef UidTable<Mutex> MutexPtrs;
 
 enum class RWLockState {
     Unlocked,
@@ -145,7 +104,7 @@ struct RWLock : SyncPrimitive {
 };
 
 typedef std::shared_ptr<RWLock> RWLockPtr;
-typedef std::map<SceUID, RWLockPtr> RWLockPtrs;
+typedef UidTable<RWLock> RWLockPtrs;
 
 struct EventFlag : SyncPrimitive {
     WaitingThreadQueuePtr waiting_threads;
@@ -155,7 +114,7 @@ struct EventFlag : SyncPrimitive {
 };
 
 typedef std::shared_ptr<EventFlag> EventFlagPtr;
-typedef std::map<SceUID, EventFlagPtr> EventFlagPtrs;
+typedef UidTable<EventFlag> EventFlagPtrs;
 
 struct Condvar : SyncPrimitive {
     struct SignalTarget {
@@ -181,7 +140,7 @@ struct Condvar : SyncPrimitive {
     ~Condvar() override = default;
 };
 typedef std::shared_ptr<Condvar> CondvarPtr;
-typedef std::map<SceUID, CondvarPtr> CondvarPtrs;
+typedef UidTable<Condvar> CondvarPtrs;
 
 struct MsgPipe : SyncPrimitive {
     MsgPipe(std::size_t bufSize)
@@ -198,7 +157,7 @@ struct MsgPipe : SyncPrimitive {
 };
 
 typedef std::shared_ptr<MsgPipe> MsgPipePtr;
-typedef std::map<SceUID, MsgPipePtr> MsgPipePtrs;
+typedef UidTable<MsgPipe> MsgPipePtrs;
 
 enum class SyncWeight {
     Light, // lightweight
@@ -220,6 +179,10 @@ int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id,
 int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
 MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
 
+// Lightweight mutex, uncontended locks and unlocks only touch the work area
+int lwmutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *timeout, bool only_try);
+int lwmutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int unlock_count);
+
 // RWLock
 SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr);
 SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, uint32_t *timeout, bool is_write);
@@ -17,43 +17,91 @@
 
 #pragma once
 
-#include <kernel/thread/thread_state.h>
-#include <list>
-#include <set>
+#include <kernel/types.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <vector>
+
+struct ThreadState;
+typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+
+struct WaitingThreadData {
+    ThreadStatePtr thread;
+    int32_t priority;
+    bool *was_canceled;
+
+    // additional fields for each primitive
+    union {
+        struct { // mutex
+            int32_t lock_count;
+        };
+        struct { // rwlock
+            bool is_write;
+        };
+        struct { // semaphore
+            int32_t signal;
+        };
+        struct { // simple events
+            int32_t pattern;
+            uint32_t *result_pattern;
+            uint64_t *user_data;
+        };
+        struct { // event flags
+            int32_t wait;
+            int32_t flags;
+            uint32_t *outBits;
+        };
+        // struct { }; // condvar
+        struct { // msgpipe
+            SceSize request_size;
+        } mp;
+    };
+
+    bool operator<(const WaitingThreadData &rhs) const {
+        return priority < rhs.priority;
+    }
+
+    bool operator>(const WaitingThreadData &rhs) const {
+        return priority > rhs.priority;
+    }
+
+    bool operator==(const WaitingThreadData &rhs) const {
+        return thread == rhs.thread;
+    }
+
+    bool operator==(const ThreadStatePtr &rhs) const {
+        return thread == rhs;
+    }
+};
 
 template <typename T>
-class ThreadDataQueueInteratorBase {
-public:
-    virtual ~ThreadDataQueueInteratorBase() = default;
-    virtual bool operator==(const ThreadDataQueueInteratorBase &rhs) const = 0;
-    virtual ThreadDataQueueInteratorBase<T> &operator++() = 0;
-    virtual ThreadDataQueueInteratorBase<T> *clone() const = 0;
-    virtual T operator*() = 0;
+class ThreadDataQueue;
+
+// A thread waits on one sync primitive at a time, so the node linking it in the wait queue
+// of that primitive is embedded in its ThreadState, and waiting never allocates.
+// While linked, data.thread keeps the thread alive.
+template <typename T>
+struct ThreadWaitNode {
+    T data{};
+    ThreadWaitNode *prev = nullptr;
+    ThreadWaitNode *next = nullptr;
+    ThreadDataQueue<T> *queue = nullptr;
+    uint32_t level = 0;
 };
 
 template <typename T>
 class ThreadDataQueueInterator {
 public:
-    ThreadDataQueueInterator(ThreadDataQueueInteratorBase<T> *base)
-        : _base(base) {
-    }
-
-    ~ThreadDataQueueInterator() {
-        delete _base;
-    }
-
-    ThreadDataQueueInterator(const ThreadDataQueueInterator<T> &o)
-        : _base(o._base->clone()) {
-    }
-
-    ThreadDataQueueInterator<T> &operator=(const ThreadDataQueueInterator<T> &o) {
-        delete _base;
-        _base = o._base->clone();
-        return *this;
+    ThreadDataQueueInterator(const ThreadDataQueue<T> *queue, ThreadWaitNode<T> *node)
+        : _queue(queue)
+        , _node(node) {
     }
 
     bool operator==(const ThreadDataQueueInterator<T> &rhs) const {
-        return *_base == *rhs._base;
+        return _node == rhs._node;
     }
 
     bool operator!=(const ThreadDataQueueInterator<T> &rhs) const {
@@ -61,208 +109,204 @@ public:
     }
 
     ThreadDataQueueInterator<T> &operator++() {
-        ++(*_base);
+        _node = _queue->next_node(_node);
         return *this;
     }
 
     ThreadDataQueueInterator<T> operator++(int) {
-        auto last = _base->clone();
-        _base->operator++();
-        return ThreadDataQueueInterator<T>(last);
+        const ThreadDataQueueInterator<T> last = *this;
+        ++(*this);
+        return last;
+    }
+
+    T &operator*() const {
+        return _node->data;
     }
 
-    T operator*() {
-        return **_base;
+    T *operator->() const {
+        return &_node->data;
     }
 
-    ThreadDataQueueInteratorBase<T> *base() const {
-        return _base;
+    ThreadWaitNode<T> *node() const {
+        return _node;
     }
 
 private:
-    ThreadDataQueueInteratorBase<T> *_base;
+    const ThreadDataQueue<T> *_queue;
+    ThreadWaitNode<T> *_node;
 };
 
+// Threads waiting on a sync primitive, in the order they must be woken up.
+// Every priority level of the Vita (0 is the highest) has its own FIFO list of nodes, and a bitmap of the non-empty
+// levels finds the first waiting thread, so push, pop and erase are all O(1).
+// A FIFO queue puts every thread on the same level.
 template <typename T>
 class ThreadDataQueue {
 public:
-    virtual ThreadDataQueueInterator<T> begin() = 0;
-    virtual ThreadDataQueueInterator<T> end() = 0;
-    virtual void erase(const ThreadDataQueueInterator<T> &it) = 0;
-    virtual ThreadDataQueueInterator<T> push(const T &val) = 0;
-    virtual void pop() = 0;
-    virtual bool empty() = 0;
-    virtual size_t size() = 0;
-
-    virtual ThreadDataQueueInterator<T> find(const T &val) = 0;
-    virtual ThreadDataQueueInterator<T> find(const ThreadStatePtr &val) = 0;
-    virtual ~ThreadDataQueue() = default;
-};
+    static constexpr uint32_t PRIORITY_LEVELS = 256;
 
-template <typename T>
-class FIFOThreadDataQueueInteratorBase : public ThreadDataQueueInteratorBase<T> {
-public:
-    FIFOThreadDataQueueInteratorBase(typename std::list<T>::iterator it)
-        : it(it) {
+    explicit ThreadDataQueue(bool priority_order)
+        : priority_order(priority_order)
+        , levels(priority_order ? PRIORITY_LEVELS : 1) {
     }
 
-    ~FIFOThreadDataQueueInteratorBase() override = default;
+    ThreadDataQueue(const ThreadDataQueue &) = delete;
+    ThreadDataQueue &operator=(const ThreadDataQueue &) = delete;
 
-    bool operator==(const ThreadDataQueueInteratorBase<T> &rhs) const override {
-        auto casted = static_cast<const FIFOThreadDataQueueInteratorBase<T> &>(rhs);
-        return it == casted.it;
+    virtual ~ThreadDataQueue() {
+        while (!empty())
+            pop();
     }
 
-    ThreadDataQueueInteratorBase<T> &operator++() override {
-        ++it;
-        return *this;
+    ThreadDataQueueInterator<T> begin() {
+        return make_iterator(first_node());
     }
 
-    ThreadDataQueueInteratorBase<T> *clone() const override {
-        return new FIFOThreadDataQueueInteratorBase<T>(it);
+    ThreadDataQueueInterator<T> end() {
+        return make_iterator(nullptr);
     }
 
-    T operator*() override {
-        return *it;
+    void erase(const ThreadDataQueueInterator<T> &it) {
+        ThreadWaitNode<T> *const node = it.node();
+        if (node && (node->queue == this))
+            unlink(node);
     }
 
-    typename std::list<T>::iterator it;
-};
-
-template <typename T>
-class FIFOThreadDataQueue : public ThreadDataQueue<T> {
-public:
-    FIFOThreadDataQueue() = default;
+    ThreadDataQueueInterator<T> push(const T &val) {
+        ThreadWaitNode<T> &node = get_node(val.thread);
+        if (node.queue)
+            node.queue->unlink(&node);
 
-    ThreadDataQueueInterator<T> begin() override {
-        return make_iterator(c.begin());
-    }
+        node.data = val;
+        node.level = get_level(val.priority);
+        node.queue = this;
 
-    ThreadDataQueueInterator<T> end() override {
-        return make_iterator(c.end());
-    }
+        Level &level = levels[node.level];
+        node.prev = level.tail;
+        node.next = nullptr;
+        if (level.tail)
+            level.tail->next = &node;
+        else
+            level.head = &node;
+        level.tail = &node;
 
-    void erase(const ThreadDataQueueInterator<T> &it) override {
-        auto base = dynamic_cast<const FIFOThreadDataQueueInteratorBase<T> *>(it.base());
-        c.erase(base->it);
-    }
+        bitmap[node.level / 64] |= 1ULL << (node.level % 64);
+        ++count;
 
-    ThreadDataQueueInterator<T> push(const T &val) override {
-        c.push_back(val);
-        return make_iterator(--c.end());
+        return make_iterator(&node);
     }
 
-    void pop() override {
-        c.erase(c.begin());
+    void pop() {
+        if (ThreadWaitNode<T> *const node = first_node())
+            unlink(node);
     }
 
-    size_t size() override {
-        return c.size();
+    size_t size() const {
+        return count;
     }
 
-    bool empty() override {
-        return c.empty();
+    bool empty() const {
+        return count == 0;
     }
 
-    ThreadDataQueueInterator<T> find(const T &val) override {
-        auto it = std::find(c.begin(), c.end(), val);
-        return make_iterator(it);
+    ThreadDataQueueInterator<T> find(const T &val) {
+        return find(val.thread);
     }
 
-    ThreadDataQueueInterator<T> find(const ThreadStatePtr &val) override {
-        auto it = std::find(c.begin(), c.end(), val);
-        return make_iterator(it);
-    }
+    ThreadDataQueueInterator<T> find(const ThreadStatePtr &val) {
+        if (!val)
+            return end();
 
-private:
-    ThreadDataQueueInterator<T> make_iterator(typename std::list<T>::iterator it) {
-        auto base = new FIFOThreadDataQueueInteratorBase<T>(it);
-        return ThreadDataQueueInterator<T>(base);
+        ThreadWaitNode<T> &node = get_node(val);
+        return make_iterator(node.queue == this ? &node : nullptr);
     }
 
-    std::list<T> c;
-};
+    ThreadWaitNode<T> *next_node(const ThreadWaitNode<T> *node) const {
+        if (node->next)
+            return node->next;
 
-template <typename T>
-class PriorityThreadDataQueueInteratorBase : public ThreadDataQueueInteratorBase<T> {
-public:
-    PriorityThreadDataQueueInteratorBase(typename std::multiset<T, std::greater<T>>::iterator it)
-        : it(it) {
+        return first_node_from(node->level + 1);
     }
 
-    ~PriorityThreadDataQueueInteratorBase() override = default;
-
-    bool operator==(const ThreadDataQueueInteratorBase<T> &rhs) const override {
-        auto casted = static_cast<const PriorityThreadDataQueueInteratorBase<T> &>(rhs);
-        return it == casted.it;
-    }
+private:
+    struct Level {
+        ThreadWaitNode<T> *head = nullptr;
+        ThreadWaitNode<T> *tail = nullptr;
+    };
 
-    ThreadDataQueueInteratorBase<T> &operator++() override {
-        ++it;
-        return *this;
+    // The node is taken through a template so it is only looked up once ThreadState is complete
+    template <typename Thread>
+    static ThreadWaitNode<T> &get_node(const Thread &thread) {
+        return thread->wait_node;
     }
 
-    ThreadDataQueueInteratorBase<T> *clone() const override {
-        return new PriorityThreadDataQueueInteratorBase<T>(it);
-    }
+    uint32_t get_level(int32_t priority) const {
+        if (!priority_order)
+            return 0;
 
-    T operator*() override {
-        return *it;
+        return static_cast<uint32_t>(std::clamp<int32_t>(priority, 0, PRIORITY_LEVELS - 1));
     }
 
-    typename std::multiset<T>::iterator it;
-};
-
-template <typename T>
-class PriorityThreadDataQueue : public ThreadDataQueue<T> {
-public:
-    PriorityThreadDataQueue() = default;
-
-    ThreadDataQueueInterator<T> begin() override {
-        return make_iterator(c.begin());
+    ThreadWaitNode<T> *first_node() const {
+        return first_node_from(0);
     }
 
-    ThreadDataQueueInterator<T> end() override {
-        return make_iterator(c.end());
-    }
+    ThreadWaitNode<T> *first_node_from(uint32_t level) const {
+        for (uint32_t word = level / 64; word < bitmap.size(); word++) {
+            uint64_t bits = bitmap[word];
+            if (word == level / 64)
+                bits &= ~0ULL << (level % 64);
+            if (bits)
+                return levels[word * 64 + std::countr_zero(bits)].head;
+        }
 
-    void erase(const ThreadDataQueueInterator<T> &it) override {
-        auto base = dynamic_cast<const PriorityThreadDataQueueInteratorBase<T> *>(it.base());
-        c.erase(base->it);
+        return nullptr;
     }
 
-    ThreadDataQueueInterator<T> push(const T &val) override {
-        auto it = c.insert(val);
-        return make_iterator(it);
-    }
+    void unlink(ThreadWaitNode<T> *node) {
+        Level &level = levels[node->level];
+        if (node->prev)
+            node->prev->next = node->next;
+        else
+            level.head = node->next;
+        if (node->next)
+            node->next->prev = node->prev;
+        else
+            level.tail = node->prev;
 
-    void pop() override {
-        c.erase(c.begin());
-    }
+        if (!level.head)
+            bitmap[node->level / 64] &= ~(1ULL << (node->level % 64));
+        --count;
 
-    size_t size() override {
-        return c.size();
+        node->prev = nullptr;
+        node->next = nullptr;
+        node->queue = nullptr;
+        // Drop the reference the node holds on its own thread last, as it may be the one keeping the node alive
+        const ThreadStatePtr thread = std::move(node->data.thread);
     }
 
-    bool empty() override {
-        return c.empty();
+    ThreadDataQueueInterator<T> make_iterator(ThreadWaitNode<T> *node) const {
+        return ThreadDataQueueInterator<T>(this, node);
     }
 
-    ThreadDataQueueInterator<T> find(const T &val) override {
-        auto it = std::find(c.begin(), c.end(), val);
-        return make_iterator(it);
-    }
+    bool priority_order;
+    std::vector<Level> levels;
+    std::array<uint64_t, PRIORITY_LEVELS / 64> bitmap{};
+    size_t count = 0;
+};
 
-    ThreadDataQueueInterator<T> find(const ThreadStatePtr &val) override {
-        auto it = std::find(c.begin(), c.end(), val);
-        return make_iterator(it);
+template <typename T>
+class FIFOThreadDataQueue : public ThreadDataQueue<T> {
+public:
+    FIFOThreadDataQueue()
+        : ThreadDataQueue<T>(false) {
     }
+};
 
-private:
-    ThreadDataQueueInterator<T> make_iterator(typename std::multiset<T, std::greater<T>>::iterator it) {
-        auto base = new PriorityThreadDataQueueInteratorBase<T>(it);
-        return ThreadDataQueueInterator<T>(base);
+template <typename T>
+class PriorityThreadDataQueue : public ThreadDataQueue<T> {
+public:
+    PriorityThreadDataQueue()
+        : ThreadDataQueue<T>(true) {
     }
-
-    std::multiset<T> c;
 };
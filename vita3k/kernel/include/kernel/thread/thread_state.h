@@ -17,9 +17,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <condition_variable>
 #include <cpu/state.h>
+#include <initializer_list>
 #include <kernel/callback.h>
+#include <kernel/thread/thread_data_queue.h>
+#include <kernel/timer_wheel.h>
 #include <kernel/types.h>
 #include <list>
 #include <mem/block.h>
@@ -27,12 +34,14 @@
 #include <mutex>
 #include <optional>
 #include <string>
+#include <util/host_cpu.h>
 
 struct CPUState;
 struct CPUContext;
 
 struct ThreadState;
 struct ThreadParams;
+struct ThreadScheduler;
 struct KernelState;
 
 typedef std::unique_ptr<CPUState, std::function<void(CPUState *)>> CPUStatePtr;
@@ -59,6 +68,48 @@ private:
     bool signaled = false;
 };
 
+// What a waiting thread waits for, to break down the time it is blocked
+enum class ThreadWaitReason {
+    lwmutex,
+    eventflag,
+    vblank,
+    audio,
+    other,
+};
+
+constexpr size_t THREAD_WAIT_REASON_COUNT = 5;
+// Import libraries the HLE time of a thread is counted for, the last one holding all the others
+constexpr size_t THREAD_HLE_LIBRARY_COUNT = 64;
+
+// Host time a thread spent running guest code, in HLE functions and blocked, in nanoseconds.
+// Updated by the thread itself, and read by the threads dialog and the performance overlay
+struct ThreadCpuStats {
+    std::atomic<uint64_t> jit_ns = 0;
+    // Without the time blocked or running guest callbacks inside the HLE functions
+    std::atomic<uint64_t> hle_ns = 0;
+    std::array<std::atomic<uint64_t>, THREAD_WAIT_REASON_COUNT> blocked_ns{};
+    std::array<std::atomic<uint64_t>, THREAD_HLE_LIBRARY_COUNT> hle_library_ns{};
+    // Times the thread entered the JIT, and left it for a svc
+    std::atomic<uint64_t> jit_entries = 0;
+    std::atomic<uint64_t> svc_calls = 0;
+
+    // Totals already shown by the performance overlay, only used by it
+    uint64_t reported_jit_ns = 0;
+    uint64_t reported_hle_ns = 0;
+    uint64_t reported_blocked_ns = 0;
+
+    uint64_t get_blocked_ns() const {
+        uint64_t total = 0;
+        for (const std::atomic<uint64_t> &ns : blocked_ns)
+            total += ns.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t get_total_ns() const {
+        return jit_ns.load(std::memory_order_relaxed) + hle_ns.load(std::memory_order_relaxed) + get_blocked_ns();
+    }
+};
+
 // Internal
 enum class ThreadToDo {
     remove,
@@ -68,6 +119,29 @@ enum class ThreadToDo {
     wait,
 };
 
+constexpr size_t MAX_CALLBACK_ARGS = 8;
+constexpr size_t CALLBACK_QUEUE_SIZE = 32;
+
+// Arguments of a guest callback, the first 4 are passed in registers and the others on the stack
+struct CallbackArgs {
+    std::array<uint32_t, MAX_CALLBACK_ARGS> values{};
+    size_t count = 0;
+
+    CallbackArgs() = default;
+    CallbackArgs(std::initializer_list<uint32_t> args)
+        : count(args.size()) {
+        assert(args.size() <= MAX_CALLBACK_ARGS);
+        std::copy_n(args.begin(), std::min(args.size(), MAX_CALLBACK_ARGS), values.begin());
+    }
+};
+
+struct QueuedCallback {
+    Address address;
+    CallbackArgs args;
+    // Where to write the value returned by the callback, can be null
+    uint32_t *result;
+};
+
 struct ThreadState {
     std::mutex mutex;
     std::string name;
@@ -80,6 +154,12 @@ struct ThreadState {
 
     int priority;
     SceInt32 affinity_mask;
+    // Worker of the scheduler this thread last ran guest code on, -1 if none
+    int scheduler_worker = -1;
+    // Host cpus the thread is pinned to, 0 if it is not
+    uint64_t host_affinity = 0;
+    // CPU time of the host thread running it, set by the thread when it starts and read with the kernel mutex locked
+    util::ThreadCpuClock host_cpu_clock;
     uint64_t start_tick;
     uint64_t last_vblank_waited;
     // set to true if thread is processing kernel callbacks
@@ -93,6 +173,13 @@ struct ThreadState {
     std::condition_variable status_cond;
     std::vector<std::shared_ptr<ThreadState>> waiting_threads;
     uint32_t returned_value = 0;
+    // Links the thread in the wait queue of the sync primitive it is waiting on
+    ThreadWaitNode<WaitingThreadData> wait_node;
+    // Timeout of the wait or delay the thread is doing, expired by the timer wheel of the kernel
+    ThreadTimer timer;
+    ThreadCpuStats cpu_stats;
+    // Set before the status is updated to wait, the time blocked is then counted for it
+    ThreadWaitReason wait_reason = ThreadWaitReason::other;
 
     ThreadState() = delete;
     explicit ThreadState(SceUID id, MemState &mem);
@@ -110,19 +197,29 @@ struct ThreadState {
     void raise_waiting_threads();
 
     // this function must be called from the thread itself (inside a svc call)
-    uint32_t run_callback(Address callback_address, const std::vector<uint32_t> &args);
+    uint32_t run_callback(Address callback_address, const CallbackArgs &args);
+
+    // callbacks queued by the thread itself are run together by run_queued_callbacks,
+    // which saves and restores the context of the thread once for the whole batch.
+    // The queue is run first if it is full
+    void queue_callback(Address callback_address, const CallbackArgs &args, uint32_t *result = nullptr);
+    void run_queued_callbacks();
 
     // this function is called from another thread when this one is dormant
     // it is only used for module loading and gxm display queue right now
     // support one argument
     uint32_t run_guest_function(KernelState &kernel, Address callback_address, uint32_t arg = 0);
+    // same as run_guest_function, but the code starts from a saved context, it returns once it goes back to the halt instruction
+    // used by the ult workers to resume the ulthreads suspended on them
+    uint32_t run_guest_context(KernelState &kernel, const CPUCalleeSavedContext &ctx, uint32_t arg);
 
     void suspend();
     void resume(bool step = false);
     std::string log_stack_traceback(KernelState &kernel) const;
 
 private:
-    void push_arguments(Address callback_address, const std::vector<uint32_t> &args);
+    void push_arguments(Address sp, const CallbackArgs &args);
+    void stop_jit_prewarm();
 
     CPUContext init_cpu_ctx;
     ThreadToDo to_do = ThreadToDo::wait;
@@ -136,6 +233,15 @@ private:
     int call_level = 0;
 
     MemState &mem;
-};
+    ThreadScheduler *scheduler = nullptr;
 
-typedef std::shared_ptr<ThreadState> ThreadStatePtr;
+    // Steady clock time at which the thread started waiting, in nanoseconds
+    uint64_t wait_start_ns = 0;
+
+    std::array<QueuedCallback, CALLBACK_QUEUE_SIZE> callback_queue;
+    size_t callback_queue_size = 0;
+
+    // blocks of the JIT cache translated while the thread waits to be started, cleared once it starts
+    std::vector<Address> jit_prewarm_blocks;
+    size_t jit_prewarm_next = 0;
+};
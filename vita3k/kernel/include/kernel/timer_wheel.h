@@ -0,0 +1,137 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Duration of a slot of the first level of the wheel, in microseconds
+constexpr uint64_t TIMER_WHEEL_TICK = 16;
+
+// The wheel thread sleeps until this long before a deadline and spins the rest of the way,
+// to not depend on the timer resolution of the host
+#ifdef _WIN32
+constexpr uint64_t TIMER_WHEEL_SPIN = 1000;
+#else
+constexpr uint64_t TIMER_WHEEL_SPIN = 100;
+#endif
+
+enum class ThreadTimerState {
+    idle,
+    armed,
+    // Expired, waiting for the wheel to lock the mutex of its waiter
+    firing,
+};
+
+// Timeout of the wait a thread is doing. A thread waits for one thing at a time, so it is embedded in ThreadState
+struct ThreadTimer {
+    ThreadTimer *prev = nullptr;
+    ThreadTimer *next = nullptr;
+    // Tick at which the timer expires
+    uint64_t deadline = 0;
+    // Slot of the wheel the timer is linked in while armed
+    ThreadTimer **slot = nullptr;
+    uint32_t level = 0;
+    ThreadTimerState state = ThreadTimerState::idle;
+    // Set by the wheel with mutex locked
+    bool timed_out = false;
+
+    std::mutex *mutex = nullptr;
+    std::condition_variable *cond = nullptr;
+};
+
+// Hierarchical timer wheel expiring the timeouts of every thread from a single host thread.
+// Each of the WHEEL_LEVELS levels has WHEEL_SLOTS slots, a slot of the first level lasting TIMER_WHEEL_TICK and a slot of
+// a level lasting a full turn of the level below. Timers are cascaded down a level each time the level below wraps.
+// Expired timers are fired by locking the mutex of their waiter with try_lock, so that a waiter can cancel its timer
+// while holding its own mutex without deadlocking against the wheel thread.
+class TimerWheel {
+public:
+    TimerWheel();
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+    ~TimerWheel();
+
+    // Waits on cond with lock until pred is true, or until timeout_us microseconds passed.
+    // Returns the last value of pred, like std::condition_variable::wait_for
+    template <typename Predicate>
+    bool wait_for(ThreadTimer &timer, std::unique_lock<std::mutex> &lock, std::condition_variable &cond, uint64_t timeout_us, Predicate pred) {
+        if (pred())
+            return true;
+
+        arm(timer, *lock.mutex(), cond, now() + timeout_us);
+        cond.wait(lock, [&] { return timer.timed_out || pred(); });
+        cancel(timer);
+
+        return pred();
+    }
+
+    // Sleeps for timeout_us microseconds, waiting on cond with lock
+    void sleep_for(ThreadTimer &timer, std::unique_lock<std::mutex> &lock, std::condition_variable &cond, uint64_t timeout_us) {
+        wait_for(timer, lock, cond, timeout_us, [] { return false; });
+    }
+
+private:
+    static constexpr uint32_t WHEEL_LEVELS = 4;
+    static constexpr uint32_t WHEEL_SLOT_BITS = 8;
+    static constexpr uint32_t WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+
+    typedef std::array<ThreadTimer *, WHEEL_SLOTS> Level;
+
+    // Microseconds since the wheel was created
+    uint64_t now() const;
+
+    // Both assume the mutex of the timer is locked
+    void arm(ThreadTimer &timer, std::mutex &timer_mutex, std::condition_variable &cond, uint64_t deadline_us);
+    void cancel(ThreadTimer &timer);
+
+    // The functions below assume mutex is locked
+    bool is_empty() const;
+    void insert(ThreadTimer &timer);
+    void unlink(ThreadTimer &timer);
+    void advance(uint64_t tick);
+    void cascade(uint32_t level);
+    // Returns true if some expired timers could not be fired yet
+    bool fire_expired();
+    // Earliest tick at which a timer can expire or needs to be cascaded, UINT64_MAX if there are no timers
+    uint64_t get_next_tick() const;
+
+    void run();
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::mutex mutex;
+    std::condition_variable wheel_cond;
+    std::thread thread;
+    bool stopping = false;
+    // Time the wheel thread is sleeping until, in microseconds. It is woken up if an earlier timer is armed
+    std::atomic<uint64_t> wake_deadline = UINT64_MAX;
+
+    std::array<Level, WHEEL_LEVELS> levels{};
+    std::array<uint32_t, WHEEL_LEVELS> level_counts{};
+    // Last tick whose timers expired
+    uint64_t current_tick = 0;
+    // Expired timers whose waiter's mutex was locked
+    std::vector<ThreadTimer *> firing;
+};
@@ -0,0 +1,219 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/types.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Kernel objects of one type, indexed by their UID.
+// UIDs are never reused, so the slot of a UID is found directly from its value, in chunks which are
+// attached when the first object of their range is added. A chunk whose range is behind the last added UID
+// goes back to the free list of the table once it is empty, to be reused for a later range.
+// Lookups take no lock: a slot is only returned if it still holds the requested UID after its object was read,
+// which also makes lookups through a chunk that was meanwhile recycled fail safely.
+template <typename T>
+class UidTable {
+public:
+    typedef std::shared_ptr<T> ObjectPtr;
+
+    UidTable() = default;
+    UidTable(const UidTable &) = delete;
+    UidTable &operator=(const UidTable &) = delete;
+
+    ObjectPtr get(SceUID uid) const {
+        const Chunk *const chunk = get_chunk(uid);
+        if (!chunk)
+            return nullptr;
+
+        const Slot &slot = chunk->slots[uid & SLOT_MASK];
+        if (slot.uid.load(std::memory_order_acquire) != uid)
+            return nullptr;
+
+        ObjectPtr object = std::atomic_load_explicit(&slot.object, std::memory_order_acquire);
+        if (slot.uid.load(std::memory_order_acquire) != uid)
+            return nullptr;
+
+        return object;
+    }
+
+    bool contains(SceUID uid) const {
+        return get(uid) != nullptr;
+    }
+
+    // Fails if the uid is already used or is past the last uid the table can hold
+    [[nodiscard]] bool emplace(SceUID uid, const ObjectPtr &object) {
+        if ((uid <= 0) || (uid >= MAX_UID) || !object)
+            return false;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        Chunk *chunk = directory[uid >> CHUNK_BITS].load(std::memory_order_relaxed);
+        if (!chunk)
+            chunk = attach_chunk(uid & ~SLOT_MASK);
+
+        Slot &slot = chunk->slots[uid & SLOT_MASK];
+        if (slot.uid.load(std::memory_order_relaxed) == uid)
+            return false;
+
+        std::atomic_store_explicit(&slot.object, object, std::memory_order_release);
+        slot.uid.store(uid, std::memory_order_release);
+        ++chunk->count;
+        ++count;
+        if (uid > last_uid)
+            last_uid = uid;
+
+        recycle_chunks();
+        return true;
+    }
+
+    bool erase(SceUID uid) {
+        if ((uid <= 0) || (uid >= MAX_UID))
+            return false;
+
+        ObjectPtr object;
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            Chunk *const chunk = directory[uid >> CHUNK_BITS].load(std::memory_order_relaxed);
+            if (!chunk)
+                return false;
+
+            Slot &slot = chunk->slots[uid & SLOT_MASK];
+            if (slot.uid.load(std::memory_order_relaxed) != uid)
+                return false;
+
+            slot.uid.store(0, std::memory_order_release);
+            // Destroy the object outside the lock
+            object = std::atomic_exchange_explicit(&slot.object, ObjectPtr(), std::memory_order_acq_rel);
+            --chunk->count;
+            --count;
+
+            recycle_chunks();
+        }
+
+        return true;
+    }
+
+    size_t size() const {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Calls f(uid, object) for every object, in increasing UID order. Objects can't be added or removed from f.
+    template <typename F>
+    void for_each(F f) const {
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (const Chunk *chunk : used_chunks) {
+            for (const Slot &slot : chunk->slots) {
+                const SceUID uid = slot.uid.load(std::memory_order_relaxed);
+                if (uid != 0)
+                    f(uid, std::atomic_load_explicit(&slot.object, std::memory_order_relaxed));
+            }
+        }
+    }
+
+    void clear() {
+        std::vector<ObjectPtr> objects;
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (Chunk *chunk : used_chunks) {
+            for (Slot &slot : chunk->slots) {
+                if (slot.uid.load(std::memory_order_relaxed) == 0)
+                    continue;
+
+                slot.uid.store(0, std::memory_order_release);
+                objects.push_back(std::atomic_exchange_explicit(&slot.object, ObjectPtr(), std::memory_order_acq_rel));
+            }
+            chunk->count = 0;
+        }
+        count = 0;
+        recycle_chunks();
+    }
+
+private:
+    static constexpr uint32_t CHUNK_BITS = 10;
+    static constexpr uint32_t SLOT_MASK = (1 << CHUNK_BITS) - 1;
+    static constexpr uint32_t DIRECTORY_BITS = 14;
+    static constexpr SceUID MAX_UID = 1 << (CHUNK_BITS + DIRECTORY_BITS);
+
+    struct Slot {
+        std::atomic<SceUID> uid = 0;
+        ObjectPtr object;
+    };
+
+    struct Chunk {
+        std::array<Slot, 1 << CHUNK_BITS> slots;
+        SceUID base = 0;
+        uint32_t count = 0;
+    };
+
+    const Chunk *get_chunk(SceUID uid) const {
+        if ((uid <= 0) || (uid >= MAX_UID))
+            return nullptr;
+
+        return directory[uid >> CHUNK_BITS].load(std::memory_order_acquire);
+    }
+
+    // Assumes mutex is locked
+    Chunk *attach_chunk(SceUID base) {
+        Chunk *chunk;
+        if (free_chunks.empty()) {
+            chunks.push_back(std::make_unique<Chunk>());
+            chunk = chunks.back().get();
+        } else {
+            chunk = free_chunks.back();
+            free_chunks.pop_back();
+        }
+
+        chunk->base = base;
+        const auto position = std::lower_bound(used_chunks.begin(), used_chunks.end(), base, [](const Chunk *c, SceUID b) { return c->base < b; });
+        used_chunks.insert(position, chunk);
+        directory[base >> CHUNK_BITS].store(chunk, std::memory_order_release);
+
+        return chunk;
+    }
+
+    // Detach the empty chunks which won't get new objects. Assumes mutex is locked
+    void recycle_chunks() {
+        for (auto it = used_chunks.begin(); it != used_chunks.end();) {
+            Chunk *const chunk = *it;
+            if ((chunk->count == 0) && (chunk->base + static_cast<SceUID>(SLOT_MASK) < last_uid)) {
+                directory[chunk->base >> CHUNK_BITS].store(nullptr, std::memory_order_release);
+                free_chunks.push_back(chunk);
+                it = used_chunks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::array<std::atomic<Chunk *>, 1 << DIRECTORY_BITS> directory{};
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<Chunk *> used_chunks;
+    std::vector<Chunk *> free_chunks;
+    size_t count = 0;
+    SceUID last_uid = 0;
+};
@@ -15,6 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <array>
 #include <kernel/callback.h>
 #include <kernel/state.h>
 #include <kernel/thread/thread_state.h>
@@ -29,15 +30,29 @@ uint32_t process_callbacks(KernelState &kernel, SceUID thread_id) {
 
     thread->is_processing_callbacks = true;
     uint32_t num_callbacks_processed = 0;
+    // Run the notified callbacks by batches, with the context of the thread saved once per batch
+    std::array<Callback *, CALLBACK_QUEUE_SIZE> batch;
+    std::array<uint32_t, CALLBACK_QUEUE_SIZE> results;
+    size_t batch_size = 0;
+    const auto run_batch = [&]() {
+        thread->run_queued_callbacks();
+        for (size_t i = 0; i < batch_size; i++) {
+            if (results[i] != 0)
+                LOG_WARN("Callback with name {} requested to be deleted, but this is not supported yet!", batch[i]->get_name());
+        }
+        batch_size = 0;
+    };
+
     for (CallbackPtr &cb : thread->callbacks) {
-        if (cb->is_executable()) {
-            std::string name = cb->get_name();
-            cb->execute(kernel, [name]() {
-                LOG_WARN("Callback with name {} requested to be deleted, but this is not supported yet!", name);
-            });
+        if (cb->queue_execution(*thread, &results[batch_size])) {
+            batch[batch_size++] = cb.get();
             num_callbacks_processed++;
+            if (batch_size == batch.size())
+                run_batch();
         }
     }
+    if (batch_size > 0)
+        run_batch();
     thread->is_processing_callbacks = false;
 
     return num_callbacks_processed;
@@ -86,16 +101,26 @@ uint32_t Callback::get_num_notifications() {
 }
 
 void Callback::execute(KernelState &kernel, std::function<void()> deleter) {
-    std::lock_guard lock(this->_mutex);
-    if (!this->is_notified())
+    const ThreadStatePtr thread = kernel.get_thread(this->thread_id);
+    uint32_t ret = 0;
+    if (!queue_execution(*thread, &ret))
         return;
 
-    std::vector<uint32_t> args = { (uint32_t)(this->notifier_id), this->num_notifications, (uint32_t)this->notification_arg, this->userdata.address() };
-    int ret = kernel.get_thread(this->thread_id)->run_callback(this->cb_func.address(), args);
+    thread->run_queued_callbacks();
     if (ret != 0) {
         deleter();
     }
+}
+
+bool Callback::queue_execution(ThreadState &thread, uint32_t *result) {
+    std::lock_guard lock(this->_mutex);
+    if (!this->is_notified())
+        return false;
+
+    thread.queue_callback(this->cb_func.address(), { (uint32_t)(this->notifier_id), this->num_notifications, (uint32_t)this->notification_arg, this->userdata.address() }, result);
     this->reset(); // Callbacks return to their default state after running
+
+    return true;
 }
 
 /** Private methods **/
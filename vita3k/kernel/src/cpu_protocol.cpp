@@ -16,11 +16,16 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <kernel/cpu_protocol.h>
+#include <kernel/hle_replacement.h>
 #include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
 #include <util/lock_and_find.h>
 
-CPUProtocol::CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func)
+#include <chrono>
+
+CPUProtocol::CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func, const IsInlineImportFunc &is_inline_func)
     : call_import(func)
+    , is_inline_import(is_inline_func)
     , kernel(&kernel)
     , mem(&mem) {
 }
@@ -48,20 +53,73 @@ void CPUProtocol::call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState
         return;
     }
 
+    // 3. Call the host version of a replaced libc routine
+    if (svc == HLE_REPLACEMENT_SVC) {
+        if (!call_hle_replacement(cpu, *mem, pc)) {
+            // the guest code handles the invalid memory the same way as without the replacement
+            const bool thumb_mode = is_thumb_mode(cpu);
+            const Address entry = pc - (thumb_mode ? 2 : 4);
+            if (kernel->hle_replacements.restore_function(*mem, entry))
+                kernel->invalidate_jit_cache(entry, HLE_PATCH_SIZE);
+            write_pc(cpu, entry | (thumb_mode ? 1 : 0));
+        }
+        return;
+    }
+
     // This is usual service call
     uint32_t nid = *Ptr<uint32_t>(pc + 4).get(*mem);
+    ThreadCpuStats &stats = thread.cpu_stats;
+    stats.svc_calls.fetch_add(1, std::memory_order_relaxed);
+    // The time spent blocked or running guest callbacks meanwhile is already counted
+    const uint64_t counted_before = stats.get_total_ns();
+    const auto start = std::chrono::steady_clock::now();
     // TODO: just supply ThreadStatePtr to call_import
     // the only benefit of using thread_id instead--namely less locking-- has been gone for long
-    call_import(cpu, nid, thread.id);
+    call_import(cpu, svc, nid, thread.id);
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t counted = stats.get_total_ns() - counted_before;
+    if (elapsed > counted) {
+        stats.hle_ns.fetch_add(elapsed - counted, std::memory_order_relaxed);
+        stats.hle_library_ns[kernel->import_libraries.find(nid)].fetch_add(elapsed - counted, std::memory_order_relaxed);
+    }
 
     // ARM recommends claering exclusive state inside interrupt handler
-    clear_exclusive(kernel->exclusive_monitor, get_processor_id(cpu));
+    clear_exclusive(cpu);
+}
+
+// The replaced libc routines and the HLE functions which can't block or reschedule the thread are called
+// right away, the JIT only stops to go through the thread loop for the other ones
+bool CPUProtocol::call_svc_inline(CPUState &cpu, uint32_t svc, Address pc) {
+    // the thread loop runs the guest code instead if the host version can't be called
+    if (svc == HLE_REPLACEMENT_SVC)
+        return call_hle_replacement(cpu, *mem, pc);
+
+    if (!is_inline_import(svc))
+        return false;
+
+    const uint32_t nid = *Ptr<uint32_t>(pc + 4).get(*mem);
+    call_import(cpu, svc, nid, cpu.thread_id);
+    clear_exclusive(cpu);
+
+    return true;
 }
 
 Address CPUProtocol::get_watch_memory_addr(Address addr) {
     return kernel->debugger.get_watch_memory_addr(addr);
 }
 
+void CPUProtocol::record_translated_block(Address pc, bool thumb) {
+    kernel->jit_cache.record_block(pc, thumb);
+}
+
+void CPUProtocol::record_dispatched_block(Address pc, bool thumb) {
+    kernel->jit_cache.record_dispatched_block(pc, thumb);
+}
+
 ExclusiveMonitorPtr CPUProtocol::get_exlusive_monitor() {
     return kernel->exclusive_monitor;
 }
+
+JitInvalidationLog *CPUProtocol::get_jit_invalidation_log() {
+    return &kernel->jit_invalidations;
+}
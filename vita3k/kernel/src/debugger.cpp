@@ -17,6 +17,7 @@
 
 #include <kernel/debugger.h>
 #include <kernel/state.h>
+#include <mem/functions.h>
 #include <util/align.h>
 #include <util/arm.h>
 #include <util/log.h>
@@ -124,14 +125,37 @@ Debugger::Debugger(KernelState &kernel)
     : parent(kernel) {
 }
 
-void Debugger::add_watch_memory_addr(Address addr, size_t size) {
+// The JIT keeps fastmem while only some pages are watched, the pages are protected so the code accessing them is compiled again
+// without fastmem, its accesses to these pages then reach the callbacks which log them. The first access releases the pages,
+// the code reaching them until they are armed again is only caught from the next time they are
+static void arm_watch(MemState &mem, const WatchMemory &watch) {
+    if (watch.armed->exchange(true))
+        return;
+
+    add_protect(mem, watch.start, watch.size, MEM_PERM_NONE, [armed = watch.armed](Address, bool) {
+        armed->store(false);
+        return true;
+    });
+}
+
+void Debugger::add_watch_memory_addr(MemState &mem, Address addr, size_t size) {
     std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+    const auto [it, inserted] = watch_memory_addrs.emplace(addr, WatchMemory{ addr, size, std::make_shared<std::atomic<bool>>(false) });
+    if (inserted) {
+        add_page_watch(mem, addr, size);
+        if (watch_memory)
+            arm_watch(mem, it->second);
+    }
 }
 
-void Debugger::remove_watch_memory_addr(KernelState &state, Address addr) {
+// the pages still armed are released by their next access
+void Debugger::remove_watch_memory_addr(MemState &mem, Address addr) {
     std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.erase(addr);
+    const auto it = watch_memory_addrs.find(addr);
+    if (it != watch_memory_addrs.end()) {
+        remove_page_watch(mem, it->second.start, it->second.size);
+        watch_memory_addrs.erase(it);
+    }
 }
 
 // TODO use boost icl or interval tree instead if this turns out to be a significant bottleneck
@@ -148,3 +172,12 @@ Address Debugger::get_watch_memory_addr(Address addr) {
 void Debugger::update_watches() {
     parent.set_memory_watch(watch_memory);
 }
+
+void Debugger::rearm_watches(MemState &mem) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!watch_memory)
+        return;
+
+    for (const auto &item : watch_memory_addrs)
+        arm_watch(mem, item.second);
+}
@@ -0,0 +1,220 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/hle_replacement.h>
+
+#include <cpu/functions.h>
+#include <mem/functions.h>
+#include <util/align.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+
+struct HleExport {
+    uint32_t nid;
+    HleFunction function;
+};
+
+// SceLibc exports which have a host replacement
+static constexpr HleExport HLE_EXPORTS[] = {
+    { 0x7205BFDB, HleFunction::Memcpy },
+    { 0xAF5C218D, HleFunction::Memmove },
+    { 0x6DC1F0D8, HleFunction::Memset },
+    { 0x8AECC873, HleFunction::Strlen },
+    { 0x1B58FA3B, HleFunction::Strcmp },
+};
+
+static const char *get_function_name(HleFunction function) {
+    switch (function) {
+    case HleFunction::Memcpy: return "memcpy";
+    case HleFunction::Memmove: return "memmove";
+    case HleFunction::Memset: return "memset";
+    case HleFunction::Strlen: return "strlen";
+    case HleFunction::Strcmp: return "strcmp";
+    default: return "unknown";
+    }
+}
+
+// Replace the start of the function by: svc HLE_REPLACEMENT_SVC, bx lr, padding, function index
+static void patch_function(HleReplacementState &state, MemState &mem, Address address, bool thumb_mode, HleFunction function) {
+    uint8_t *const code = Ptr<uint8_t>(address).get(mem);
+    auto &original = state.patched_functions[address];
+    memcpy(original.data(), code, HLE_PATCH_SIZE);
+
+    if (thumb_mode) {
+        const uint16_t insts[4] = { 0xDF00 | HLE_REPLACEMENT_SVC, 0x4770, 0xBF00, 0xBF00 };
+        memcpy(code, insts, sizeof(insts));
+    } else {
+        const uint32_t insts[2] = { 0xEF000000 | HLE_REPLACEMENT_SVC, 0xE12FFF1E };
+        memcpy(code, insts, sizeof(insts));
+    }
+
+    const uint32_t index = static_cast<uint32_t>(function);
+    memcpy(code + 8, &index, sizeof(index));
+}
+
+void HleReplacementState::init(bool enabled) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    this->enabled = enabled;
+    signatures.clear();
+    patched_functions.clear();
+}
+
+void HleReplacementState::add_exports(MemState &mem, uint32_t nid, Address address) {
+    if (!enabled)
+        return;
+
+    const auto hle_export = std::find_if(std::begin(HLE_EXPORTS), std::end(HLE_EXPORTS), [&](const HleExport &e) { return e.nid == nid; });
+    if (hle_export == std::end(HLE_EXPORTS))
+        return;
+
+    const bool thumb_mode = address & 1;
+    const Address function_address = address & ~1;
+    if (!is_valid_addr_range(mem, function_address, function_address + HLE_SIGNATURE_SIZE))
+        return;
+
+    HleSignature signature{ hle_export->function, thumb_mode, {} };
+    memcpy(signature.code.data(), Ptr<uint8_t>(function_address).get(mem), HLE_SIGNATURE_SIZE);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    const bool known = std::any_of(signatures.begin(), signatures.end(), [&](const HleSignature &s) {
+        return (s.thumb_mode == thumb_mode) && (s.code == signature.code);
+    });
+    if (!known)
+        signatures.push_back(signature);
+
+    patch_function(*this, mem, function_address, thumb_mode, hle_export->function);
+    LOG_INFO("Replaced exported {} at {} by its host version", get_function_name(hle_export->function), log_hex(function_address));
+}
+
+void HleReplacementState::patch_module(MemState &mem, Address start, uint32_t size) {
+    if (!enabled)
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    uint8_t *const begin = Ptr<uint8_t>(start).get(mem);
+    uint8_t *const end = begin + size;
+    for (const HleSignature &signature : signatures) {
+        const std::boyer_moore_horspool_searcher searcher(signature.code.begin(), signature.code.end());
+        const Address alignment = signature.thumb_mode ? 2 : 4;
+        uint8_t *it = begin;
+        while ((it = std::search(it, end, searcher)) != end) {
+            const Address address = start + static_cast<Address>(it - begin);
+            if (address % alignment == 0) {
+                patch_function(*this, mem, address, signature.thumb_mode, signature.function);
+                LOG_INFO("Replaced {} found at {} by its host version", get_function_name(signature.function), log_hex(address));
+                it += HLE_SIGNATURE_SIZE;
+            } else {
+                it++;
+            }
+        }
+    }
+}
+
+bool HleReplacementState::restore_function(MemState &mem, Address address) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = patched_functions.find(address);
+    if (it == patched_functions.end())
+        return false;
+
+    // the svc is removed before the function index, see call_hle_replacement
+    uint8_t *const code = Ptr<uint8_t>(address).get(mem);
+    memcpy(code, it->second.data(), 8);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(code + 8, it->second.data() + 8, HLE_PATCH_SIZE - 8);
+    patched_functions.erase(it);
+    return true;
+}
+
+static bool is_patched(const MemState &mem, Address address, bool thumb_mode) {
+    if (thumb_mode)
+        return *Ptr<uint16_t>(address).get(mem) == (0xDF00 | HLE_REPLACEMENT_SVC);
+    return *Ptr<uint32_t>(address).get(mem) == (0xEF000000 | HLE_REPLACEMENT_SVC);
+}
+
+static bool is_valid_range(const MemState &mem, Address start, uint32_t size) {
+    return (size == 0) || (start && (static_cast<uint64_t>(start) + size < (1ULL << 32)) && is_valid_addr_range(mem, start, start + size));
+}
+
+// Length of the string at address, or -1 if it is not terminated inside valid memory
+static int64_t guest_strlen(const MemState &mem, Address address) {
+    uint64_t current = address;
+    while (current < (1ULL << 32)) {
+        if (!is_valid_addr(mem, static_cast<Address>(current)))
+            return -1;
+
+        const uint64_t page_end = align_down(current, mem.page_size) + mem.page_size;
+        const void *const terminator = memchr(&mem.memory[current], 0, page_end - current);
+        if (terminator)
+            return static_cast<const uint8_t *>(terminator) - &mem.memory[address];
+
+        current = page_end;
+    }
+
+    return -1;
+}
+
+bool call_hle_replacement(CPUState &cpu, MemState &mem, Address pc) {
+    const bool thumb_mode = is_thumb_mode(cpu);
+    const Address entry = pc - (thumb_mode ? 2 : 4);
+    const HleFunction function = static_cast<HleFunction>(*Ptr<uint32_t>(entry + 8).get(mem));
+    // another thread may still run the patched code after restore_function, the index is only valid while the svc is there
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!is_patched(mem, entry, thumb_mode))
+        return false;
+
+    const Address r0 = read_reg(cpu, 0);
+    const Address r1 = read_reg(cpu, 1);
+    const uint32_t r2 = read_reg(cpu, 2);
+    switch (function) {
+    case HleFunction::Memcpy:
+    case HleFunction::Memmove:
+        if (!is_valid_range(mem, r0, r2) || !is_valid_range(mem, r1, r2))
+            break;
+        if (r2 != 0)
+            memmove(&mem.memory[r0], &mem.memory[r1], r2);
+        return true;
+    case HleFunction::Memset:
+        if (!is_valid_range(mem, r0, r2))
+            break;
+        if (r2 != 0)
+            memset(&mem.memory[r0], static_cast<uint8_t>(r1), r2);
+        return true;
+    case HleFunction::Strlen: {
+        const int64_t length = guest_strlen(mem, r0);
+        if (length < 0)
+            break;
+        write_reg(cpu, 0, static_cast<uint32_t>(length));
+        return true;
+    }
+    case HleFunction::Strcmp: {
+        if ((guest_strlen(mem, r0) < 0) || (guest_strlen(mem, r1) < 0))
+            break;
+        const int result = strcmp(reinterpret_cast<const char *>(&mem.memory[r0]), reinterpret_cast<const char *>(&mem.memory[r1]));
+        write_reg(cpu, 0, static_cast<uint32_t>((result > 0) - (result < 0)));
+        return true;
+    }
+    default:
+        break;
+    }
+
+    LOG_WARN("Invalid memory access in host {} (r0: {}, r1: {}, r2: {}), running its guest code instead", get_function_name(function), log_hex(r0), log_hex(r1), log_hex(r2));
+    return false;
+}
@@ -0,0 +1,184 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/jit_cache.h>
+
+#include <util/log.h>
+
+#include <spdlog/fmt/fmt.h>
+
+constexpr uint32_t JIT_CACHE_MAGIC = 0x4354494A; // JITC
+
+struct JitCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t module_nid;
+    uint32_t text_base;
+    uint32_t text_size;
+    uint32_t cpu_opt;
+    uint32_t block_count;
+    uint32_t hot_block_count;
+};
+
+static JitCacheModule *find_module(std::vector<JitCacheModule> &modules, Address pc) {
+    for (JitCacheModule &module : modules) {
+        if ((pc >= module.text_base) && (pc - module.text_base < module.text_size))
+            return &module;
+    }
+
+    return nullptr;
+}
+
+static fs::path get_module_cache_path(const JitCacheState &state, uint32_t module_nid) {
+    return state.cache_path / fmt::format("{:08X}.dat", module_nid);
+}
+
+void JitCacheState::init(const fs::path &base_path, const std::string &title_id, bool enabled, bool cpu_opt) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    this->enabled = enabled;
+    this->cpu_opt = cpu_opt;
+    cache_path = base_path / "cache/jit" / title_id;
+    profile_end = std::chrono::steady_clock::now() + JIT_PROFILE_DURATION;
+    modules.clear();
+}
+
+void JitCacheState::load_module(const std::string &name, uint32_t module_nid, Address text_base, uint32_t text_size) {
+    if (!enabled)
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    JitCacheModule &module = modules.emplace_back();
+    module.name = name;
+    module.module_nid = module_nid;
+    module.text_base = text_base;
+    module.text_size = text_size;
+
+    fs::ifstream cache_file(get_module_cache_path(*this, module_nid), std::ios::in | std::ios::binary);
+    if (!cache_file.is_open())
+        return;
+
+    JitCacheHeader header{};
+    cache_file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    // The cached offsets are only meaningful for the same code, loaded at the same place and translated the same way
+    if (!cache_file || (header.magic != JIT_CACHE_MAGIC) || (header.version != JIT_CACHE_VERSION) || (header.module_nid != module_nid)
+        || (header.text_base != text_base) || (header.text_size != text_size) || (header.cpu_opt != static_cast<uint32_t>(cpu_opt)) || (header.block_count > text_size) || (header.hot_block_count > header.block_count)) {
+        LOG_INFO("JIT cache of module {} is outdated, recreate it.", name);
+        module.dirty = true;
+        return;
+    }
+
+    std::vector<uint32_t> blocks(header.block_count);
+    cache_file.read(reinterpret_cast<char *>(blocks.data()), blocks.size() * sizeof(uint32_t));
+    module.hot_blocks.resize(header.hot_block_count);
+    cache_file.read(reinterpret_cast<char *>(module.hot_blocks.data()), module.hot_blocks.size() * sizeof(uint32_t));
+    if (!cache_file) {
+        module.hot_blocks.clear();
+        LOG_WARN("JIT cache of module {} is truncated, recreate it.", name);
+        module.dirty = true;
+        return;
+    }
+
+    module.blocks.insert(blocks.begin(), blocks.end());
+    LOG_INFO("Loaded {} cached JIT blocks ({} hot) for module {}", module.blocks.size(), module.hot_blocks.size(), name);
+}
+
+void JitCacheState::record_block(Address pc, bool thumb) {
+    if (!enabled)
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    JitCacheModule *module = find_module(modules, pc);
+    if (module && module->blocks.insert(((pc - module->text_base) << 1) | static_cast<uint32_t>(thumb)).second)
+        module->dirty = true;
+}
+
+void JitCacheState::record_dispatched_block(Address pc, bool thumb) {
+    if (!enabled || (std::chrono::steady_clock::now() > profile_end))
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    JitCacheModule *module = find_module(modules, pc);
+    if (!module)
+        return;
+
+    const uint32_t block = ((pc - module->text_base) << 1) | static_cast<uint32_t>(thumb);
+    if (module->profiled_blocks.insert(block).second) {
+        module->profiled_order.push_back(block);
+        module->dirty = true;
+    }
+}
+
+std::vector<Address> JitCacheState::get_blocks() {
+    std::vector<Address> blocks;
+    if (!enabled)
+        return blocks;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto to_address = [](const JitCacheModule &module, uint32_t block) {
+        return (module.text_base + (block >> 1)) | (block & 1);
+    };
+    for (const JitCacheModule &module : modules) {
+        for (const uint32_t block : module.hot_blocks) {
+            blocks.push_back(to_address(module, block));
+        }
+    }
+    for (const JitCacheModule &module : modules) {
+        const std::set<uint32_t> hot_blocks(module.hot_blocks.begin(), module.hot_blocks.end());
+        for (const uint32_t block : module.blocks) {
+            if (!hot_blocks.contains(block))
+                blocks.push_back(to_address(module, block));
+        }
+    }
+
+    return blocks;
+}
+
+void JitCacheState::save() {
+    if (!enabled)
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    for (JitCacheModule &module : modules) {
+        if (!module.dirty)
+            continue;
+
+        if (!fs::exists(cache_path))
+            fs::create_directories(cache_path);
+
+        fs::ofstream cache_file(get_module_cache_path(*this, module.module_nid), std::ios::out | std::ios::binary);
+        if (!cache_file.is_open()) {
+            LOG_ERROR("Failed to save JIT cache of module {}", module.name);
+            continue;
+        }
+
+        // Keep the order of this boot, then what the previous profile had and this one did not reach
+        std::vector<uint32_t> hot_blocks = module.profiled_order;
+        for (const uint32_t block : module.hot_blocks) {
+            if (!module.profiled_blocks.contains(block))
+                hot_blocks.push_back(block);
+        }
+        std::erase_if(hot_blocks, [&](uint32_t block) { return !module.blocks.contains(block); });
+
+        const JitCacheHeader header{ JIT_CACHE_MAGIC, JIT_CACHE_VERSION, module.module_nid, module.text_base, module.text_size, static_cast<uint32_t>(cpu_opt), static_cast<uint32_t>(module.blocks.size()), static_cast<uint32_t>(hot_blocks.size()) };
+        cache_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const std::vector<uint32_t> blocks(module.blocks.begin(), module.blocks.end());
+        cache_file.write(reinterpret_cast<const char *>(blocks.data()), blocks.size() * sizeof(uint32_t));
+        cache_file.write(reinterpret_cast<const char *>(hot_blocks.data()), hot_blocks.size() * sizeof(uint32_t));
+        module.dirty = false;
+    }
+}
@@ -24,6 +24,7 @@
 #include <kernel/thread/thread_state.h>
 
 #include <cpu/functions.h>
+#include <mem/functions.h>
 #include <mem/ptr.h>
 #include <util/align.h>
 #include <util/arm.h>
@@ -51,33 +52,71 @@ void CorenumAllocator::set_max_core_count(const std::size_t max) {
     alloc.set_maximum(max);
 }
 
+// Time a host thread waits for a new guest thread to run once its guest thread is deleted
+static constexpr auto HOST_THREAD_PARK_TIME = std::chrono::seconds(5);
+// Stacks kept for the next threads
+static constexpr size_t THREAD_STACK_POOL_COUNT = 16;
+static constexpr size_t THREAD_STACK_POOL_BYTES = MiB(16);
+
 // TODO implement cross platform debug thread name setter and eliminate SDL thread
 struct ThreadParams {
     KernelState *kernel = nullptr;
     SceUID thid = SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    std::shared_ptr<ParkedHostThreads> parked;
     std::shared_ptr<SDL_semaphore> host_may_destroy_params = std::shared_ptr<SDL_semaphore>(SDL_CreateSemaphore(0), SDL_DestroySemaphore);
 };
 
 static int SDLCALL thread_function(void *data) {
     assert(data != nullptr);
     const ThreadParams params = *static_cast<const ThreadParams *>(data);
+    KernelState &kernel = *params.kernel;
+    const std::shared_ptr<ParkedHostThreads> parked = params.parked;
+    ThreadStatePtr thread = kernel.get_thread(params.thid);
+    // the creating thread holds the kernel mutex until the params are released
+    thread->host_cpu_clock = util::ThreadCpuClock::current();
     SDL_SemPost(params.host_may_destroy_params.get());
-    const ThreadStatePtr thread = lock_and_find(params.thid, params.kernel->threads, params.kernel->mutex);
+
+    uint32_t r0 = 0;
+    while (true) {
 #ifdef TRACY_ENABLE
-    if (!thread->name.empty()) {
-        tracy::SetThreadName(thread->name.c_str());
-    } else {
-        std::string th_name = "TID:" + std::to_string(thread->id);
-        tracy::SetThreadName(th_name.c_str());
-    }
+        if (!thread->name.empty()) {
+            tracy::SetThreadName(thread->name.c_str());
+        } else {
+            std::string th_name = "TID:" + std::to_string(thread->id);
+            tracy::SetThreadName(th_name.c_str());
+        }
 #endif
 
-    thread->run_loop();
-    const uint32_t r0 = read_reg(*thread->cpu, 0);
+        thread->run_loop();
+        r0 = read_reg(*thread->cpu, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(kernel.mutex);
+            kernel.threads.erase(thread->id);
+            kernel.thread_table.erase(thread->id);
+            kernel.scheduler.remove_thread(*thread);
+            kernel.corenum_allocator.free_corenum(get_processor_id(*thread->cpu));
+        }
+
+        // a host thread pinned to some cpus would pass its affinity to the next guest thread
+        if (thread->host_affinity != 0)
+            break;
+        thread.reset();
 
-    std::lock_guard<std::mutex> lock(params.kernel->mutex);
-    params.kernel->threads.erase(thread->id);
-    params.kernel->corenum_allocator.free_corenum(get_processor_id(*thread->cpu));
+        // the threads spawned for short tasks then don't pay for a new host thread each time
+        std::unique_lock<std::mutex> lock(parked->mutex);
+        parked->idle++;
+        const bool woken = parked->cond.wait_for(lock, HOST_THREAD_PARK_TIME, [&]() { return parked->quit || !parked->pending.empty(); });
+        parked->idle--;
+        if (!woken || parked->quit)
+            break;
+        thread = std::move(parked->pending.front());
+        parked->pending.pop_front();
+        lock.unlock();
+
+        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
+        thread->host_cpu_clock = util::ThreadCpuClock::current();
+    }
 
     return r0;
 }
@@ -86,14 +125,21 @@ KernelState::KernelState()
     : debugger(*this) {
 }
 
-bool KernelState::init(MemState &mem, CallImportFunc call_import, CPUBackend cpu_backend, bool cpu_opt) {
+KernelState::~KernelState() {
+    const std::lock_guard<std::mutex> lock(parked_host_threads->mutex);
+    parked_host_threads->quit = true;
+    parked_host_threads->cond.notify_all();
+}
+
+bool KernelState::init(MemState &mem, CallImportFunc call_import, IsInlineImportFunc is_inline_import, CPUBackend cpu_backend, bool cpu_opt) {
     constexpr std::size_t MAX_CORE_COUNT = 150;
 
     corenum_allocator.set_max_core_count(MAX_CORE_COUNT);
-    exclusive_monitor = new_exclusive_monitor(MAX_CORE_COUNT);
+    exclusive_monitor = per_core_exclusive_monitor ? nullptr : new_exclusive_monitor(MAX_CORE_COUNT);
+    jit_invalidations.init(mem.page_size);
     start_tick = rtc_get_ticks(rtc_base_ticks());
     base_tick = { rtc_base_ticks() };
-    cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import);
+    cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import, is_inline_import);
     this->cpu_backend = cpu_backend;
     this->cpu_opt = cpu_opt;
 
@@ -123,15 +169,62 @@ void KernelState::set_memory_watch(bool enabled) {
     }
 }
 
+void ImportLibraries::add(const std::string &name, const uint32_t *nids, size_t count) {
+    const std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = std::find(names.begin(), names.end(), name);
+    if ((it == names.end()) && (names.size() < THREAD_HLE_LIBRARY_COUNT - 1))
+        it = names.insert(names.end(), name);
+
+    const uint32_t index = (it == names.end()) ? THREAD_HLE_LIBRARY_COUNT - 1 : static_cast<uint32_t>(it - names.begin());
+    for (size_t i = 0; i < count; i++)
+        by_nid.emplace(nids[i], index);
+}
+
+size_t ImportLibraries::find(uint32_t nid) {
+    const std::shared_lock<std::shared_mutex> lock(mutex);
+    const auto it = by_nid.find(nid);
+    return (it == by_nid.end()) ? THREAD_HLE_LIBRARY_COUNT - 1 : it->second;
+}
+
+std::string ImportLibraries::get_name(size_t index) {
+    const std::shared_lock<std::shared_mutex> lock(mutex);
+    return (index < names.size()) ? names[index] : "Other";
+}
+
 void KernelState::invalidate_jit_cache(Address start, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (auto thread : threads) {
-        ::invalidate_jit_cache(*thread.second->cpu, start, length);
+    jit_invalidations.push(start, length);
+}
+
+Block KernelState::alloc_thread_stack(MemState &mem, const int stack_size, const char *name) {
+    Address address = 0;
+    {
+        const std::lock_guard<std::mutex> lock(thread_stack_pool->mutex);
+        const auto pooled = thread_stack_pool->stacks.find(stack_size);
+        if (pooled != thread_stack_pool->stacks.end()) {
+            address = pooled->second;
+            thread_stack_pool->bytes -= stack_size;
+            thread_stack_pool->stacks.erase(pooled);
+        }
     }
+    if (!address)
+        address = alloc(mem, stack_size, name);
+
+    const std::weak_ptr<ThreadStackPool> weak_pool = thread_stack_pool;
+    return Block(address, [&mem, weak_pool, stack_size](Address stack) {
+        if (const auto pool = weak_pool.lock()) {
+            const std::lock_guard<std::mutex> lock(pool->mutex);
+            if ((pool->stacks.size() < THREAD_STACK_POOL_COUNT) && (pool->bytes + stack_size <= THREAD_STACK_POOL_BYTES)) {
+                pool->stacks.emplace(stack_size, stack);
+                pool->bytes += stack_size;
+                return;
+            }
+        }
+        free(mem, stack);
+    });
 }
 
-ThreadStatePtr KernelState::get_thread(SceUID thread_id) {
-    return lock_and_find(thread_id, threads, mutex);
+ThreadStatePtr KernelState::get_thread(SceUID thread_id) const {
+    return thread_table.get(thread_id);
 }
 
 ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<const void> entry_point) {
@@ -144,11 +237,25 @@ ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<c
     if (thread->init(*this, name, entry_point, init_priority, affinity_mask, stack_size, option) < 0)
         return nullptr;
     const auto lock = std::lock_guard(mutex);
+    if (!thread_table.emplace(thread->id, thread)) {
+        LOG_ERROR("Could not add thread {} to the thread table", thread->id);
+        return nullptr;
+    }
     threads.emplace(thread->id, thread);
 
+    {
+        const std::lock_guard<std::mutex> parked_lock(parked_host_threads->mutex);
+        if (parked_host_threads->idle > parked_host_threads->pending.size()) {
+            parked_host_threads->pending.push_back(thread);
+            parked_host_threads->cond.notify_one();
+            return thread;
+        }
+    }
+
     ThreadParams params;
     params.kernel = this;
     params.thid = thread->id;
+    params.parked = parked_host_threads;
 
     SDL_CreateThread(&thread_function, thread->name.c_str(), &params);
     SDL_SemWait(params.host_may_destroy_params.get());
@@ -172,6 +279,7 @@ void KernelState::exit_delete_all_threads() {
     for (auto [_, thread] : threads) {
         thread->exit_delete();
     }
+    jit_cache.save();
 }
 
 std::shared_ptr<SceKernelModuleInfo> KernelState::find_module_by_addr(Address address) {
@@ -35,12 +35,15 @@
 // clang-format on
 #include <miniz.h>
 #include <self.h>
+#include <xxh3.h>
 
 #include <cassert>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <optional>
 
 #define NID_MODULE_STOP 0x79F8E492
 #define NID_MODULE_EXIT 0x913482A9
@@ -180,9 +183,8 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
             var_entry_table = long_imports->var_entry_table;
         }
 
-        std::string lib_name;
+        const std::string lib_name = library_name ? Ptr<const char>(library_name).get(mem) : "unknown";
         if (kernel.debugger.log_imports) {
-            lib_name = Ptr<const char>(library_name).get(mem);
             LOG_INFO("Loading func imports from {}", lib_name);
         }
 
@@ -190,6 +192,7 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
         const Ptr<uint32_t> *const entries = Ptr<Ptr<uint32_t>>(func_entry_table).get(mem);
 
         const size_t num_syms_funcs = imports->num_syms_funcs;
+        kernel.import_libraries.add(lib_name, nids, num_syms_funcs);
         if (!load_func_imports(nids, entries, num_syms_funcs, kernel, mem)) {
             return false;
         }
@@ -211,7 +214,7 @@ static bool load_imports(const sce_module_info_raw &module, Ptr<const void> segm
     return true;
 }
 
-static bool load_func_exports(Ptr<const void> &entry_point, const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, KernelState &kernel) {
+static bool load_func_exports(Ptr<const void> &entry_point, const uint32_t *nids, const Ptr<uint32_t> *entries, size_t count, KernelState &kernel, MemState &mem) {
     for (size_t i = 0; i < count; ++i) {
         const uint32_t nid = nids[i];
         const Ptr<uint32_t> entry = entries[i];
@@ -224,11 +227,25 @@ static bool load_func_exports(Ptr<const void> &entry_point, const uint32_t *nids
         if (nid == NID_MODULE_STOP || nid == NID_MODULE_EXIT)
             continue;
 
+        std::vector<Address> dispatch_stubs;
         {
             const std::unique_lock<std::shared_mutex> lock(kernel.export_nids_mutex);
             kernel.export_nids.emplace(nid, entry.address());
+            const ImportDispatchStubs::iterator stubs = kernel.import_dispatch_stubs.find(nid);
+            if (stubs != kernel.import_dispatch_stubs.end()) {
+                dispatch_stubs = std::move(stubs->second);
+                kernel.import_dispatch_stubs.erase(stubs);
+            }
+        }
+
+        // Imports already dispatched to the HLE function go through call_import again, to be linked to this export
+        for (const Address stub : dispatch_stubs) {
+            *Ptr<uint32_t>(stub).get(mem) = 0xef000000; // svc #0 - Call our interrupt hook.
+            kernel.invalidate_jit_cache(stub, 4);
         }
 
+        kernel.hle_replacements.add_exports(mem, nid, entry.address());
+
         if (kernel.debugger.log_exports) {
             const char *const name = import_name(nid);
 
@@ -283,12 +300,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
                     auto &late_binding_info_v = i->second;
                     if (late_binding_info_v.size > 0) {
                         if (last_module_nid != late_binding_info_v.module_nid) {
-                            // TODO: uncomment when invalidate_jit_cache will be thread safe
-                            /* if (!seg.empty()) {
-                                for (const auto &[key, value] : seg) {
-                                    kernel.invalidate_jit_cache(value.addr, value.size);
-                                }
-                            }*/
+                            for (const auto &[key, value] : seg) {
+                                kernel.invalidate_jit_cache(value.addr, value.size);
+                            }
                             seg.clear();
                             const auto module_info = kernel.loaded_modules[kernel.module_uid_by_nid[late_binding_info_v.module_nid]];
                             if (!module_info) {
@@ -319,14 +333,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
             }
         }
     }
-    // TODO: uncomment when invalidate_jit_cache will be thread safe
-    /*
-    if (!seg.empty()) {
-        for (const auto &[key, value] : seg) {
-            kernel.invalidate_jit_cache(value.addr, value.size);
-        }
+    for (const auto &[key, value] : seg) {
+        kernel.invalidate_jit_cache(value.addr, value.size);
     }
-    */
     return true;
 }
 
@@ -344,7 +353,7 @@ static bool load_exports(Ptr<const void> &entry_point, const sce_module_info_raw
 
         const uint32_t *const nids = Ptr<const uint32_t>(exports->nid_table).get(mem);
         const Ptr<uint32_t> *const entries = Ptr<Ptr<uint32_t>>(exports->entry_table).get(mem);
-        if (!load_func_exports(entry_point, nids, entries, exports->num_syms_funcs, kernel)) {
+        if (!load_func_exports(entry_point, nids, entries, exports->num_syms_funcs, kernel, mem)) {
             return false;
         }
 
@@ -362,6 +371,187 @@ static bool load_exports(Ptr<const void> &entry_point, const sce_module_info_raw
     return true;
 }
 
+constexpr uint32_t INFLATED_CACHE_MAGIC = 0x464E4953; // SINF
+constexpr uint32_t INFLATED_CACHE_VERSION = 1;
+
+constexpr uint32_t RELOCATED_CACHE_MAGIC = 0x4C455253; // SREL
+constexpr uint32_t RELOCATED_CACHE_VERSION = 1;
+
+struct ModuleCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t segment_count;
+};
+
+struct InflatedCacheSegment {
+    uint32_t index;
+    uint32_t size;
+};
+
+// Segments of a module already inflated by a previous boot, keyed by the hash of all its compressed segments
+struct InflatedSegments {
+    fs::path path;
+    bool loaded = false;
+    std::vector<uint8_t> data;
+    // segment index -> offset and size in data
+    std::map<uint32_t, std::pair<size_t, uint32_t>> segments;
+    // segments inflated during this load, written once the module is loaded
+    std::map<uint32_t, std::vector<uint8_t>> inflated;
+
+    const uint8_t *find(const uint32_t index, const uint32_t size) const {
+        const auto segment = segments.find(index);
+        if ((segment == segments.end()) || (segment->second.second != size))
+            return nullptr;
+        return data.data() + segment->second.first;
+    }
+};
+
+static void read_inflated_segments(InflatedSegments &cache) {
+    fs::ifstream file(cache.path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    ModuleCacheHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || (header.magic != INFLATED_CACHE_MAGIC) || (header.version != INFLATED_CACHE_VERSION))
+        return;
+
+    for (uint32_t i = 0; i < header.segment_count; i++) {
+        InflatedCacheSegment segment{};
+        file.read(reinterpret_cast<char *>(&segment), sizeof(segment));
+        if (!file)
+            return;
+
+        const size_t offset = cache.data.size();
+        cache.data.resize(offset + segment.size);
+        file.read(reinterpret_cast<char *>(cache.data.data() + offset), segment.size);
+        if (!file) {
+            cache.segments.clear();
+            return;
+        }
+        cache.segments[segment.index] = { offset, segment.size };
+    }
+    cache.loaded = true;
+}
+
+static void write_inflated_segments(const InflatedSegments &cache) {
+    fs::create_directories(cache.path.parent_path());
+    fs::ofstream file(cache.path, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    const ModuleCacheHeader header{ INFLATED_CACHE_MAGIC, INFLATED_CACHE_VERSION, static_cast<uint32_t>(cache.inflated.size()) };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &[index, data] : cache.inflated) {
+        const InflatedCacheSegment segment{ index, static_cast<uint32_t>(data.size()) };
+        file.write(reinterpret_cast<const char *>(&segment), sizeof(segment));
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    }
+}
+
+struct RelocatedCacheSegment {
+    uint32_t index;
+    Address address;
+    uint32_t size;
+};
+
+// Loadable segments of a module as relocated by a previous boot, keyed by the hash of the whole module
+// The relocations only depend on the segments content and their load addresses, so they can be replayed
+// as long as every segment is loaded at the same address again
+struct RelocatedSegments {
+    fs::path path;
+    std::vector<RelocatedCacheSegment> segments;
+    std::vector<uint8_t> data;
+
+    bool matches(const SegmentInfosForReloc &infos) const {
+        if (segments.empty() || (segments.size() != infos.size()))
+            return false;
+        for (const RelocatedCacheSegment &segment : segments) {
+            const auto info = infos.find(segment.index);
+            if ((info == infos.end()) || (info->second.addr != segment.address) || (segment.size > info->second.size))
+                return false;
+        }
+        return true;
+    }
+
+    void replay(MemState &mem) const {
+        size_t offset = 0;
+        for (const RelocatedCacheSegment &segment : segments) {
+            memcpy(Ptr<uint8_t>(segment.address).get(mem), data.data() + offset, segment.size);
+            offset += segment.size;
+        }
+    }
+};
+
+static void read_relocated_segments(RelocatedSegments &cache) {
+    fs::ifstream file(cache.path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    ModuleCacheHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || (header.magic != RELOCATED_CACHE_MAGIC) || (header.version != RELOCATED_CACHE_VERSION))
+        return;
+
+    for (uint32_t i = 0; i < header.segment_count; i++) {
+        RelocatedCacheSegment segment{};
+        file.read(reinterpret_cast<char *>(&segment), sizeof(segment));
+        if (!file)
+            break;
+
+        const size_t offset = cache.data.size();
+        cache.data.resize(offset + segment.size);
+        file.read(reinterpret_cast<char *>(cache.data.data() + offset), segment.size);
+        if (!file)
+            break;
+        cache.segments.push_back(segment);
+    }
+
+    if (cache.segments.size() != header.segment_count) {
+        cache.segments.clear();
+        cache.data.clear();
+    }
+}
+
+// record the loadable segments once relocated, up to their last non zero byte as the memory is allocated zeroed
+static void write_relocated_segments(const RelocatedSegments &cache, const SegmentInfosForReloc &infos, const MemState &mem) {
+    fs::create_directories(cache.path.parent_path());
+    fs::ofstream file(cache.path, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    const ModuleCacheHeader header{ RELOCATED_CACHE_MAGIC, RELOCATED_CACHE_VERSION, static_cast<uint32_t>(infos.size()) };
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &[index, info] : infos) {
+        const uint8_t *const bytes = Ptr<const uint8_t>(info.addr).get(mem);
+        uint32_t size = static_cast<uint32_t>(info.size);
+        while ((size > 0) && (bytes[size - 1] == 0))
+            size--;
+
+        const RelocatedCacheSegment segment{ index, info.addr, size };
+        file.write(reinterpret_cast<const char *>(&segment), sizeof(segment));
+        file.write(reinterpret_cast<const char *>(bytes), size);
+    }
+}
+
+// inflate a compressed segment, or copy it from the cache of the previous boots
+static bool inflate_segment(InflatedSegments *cache, const uint32_t index, uint8_t *dest, const uint32_t size, const uint8_t *compressed, const uint64_t compressed_size) {
+    if (cache) {
+        if (const uint8_t *cached = cache->find(index, size)) {
+            memcpy(dest, cached, size);
+            return true;
+        }
+    }
+
+    mz_ulong dest_bytes = size;
+    if (mz_uncompress(dest, &dest_bytes, compressed, static_cast<mz_ulong>(compressed_size)) != MZ_OK)
+        return false;
+
+    if (cache)
+        cache->inflated[index].assign(dest, dest + size);
+    return true;
+}
+
 /**
  * \return Negative on failure
  */
@@ -462,6 +652,36 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
 
     SegmentInfosForReloc segment_reloc_info;
 
+    std::optional<InflatedSegments> inflated_segments;
+    if (!kernel.module_cache_path.empty()) {
+        uint64_t hash = 0;
+        bool has_compressed_segments = false;
+        for (Elf_Half seg_index = 0; seg_index < elf.e_phnum; ++seg_index) {
+            if (seg_infos[seg_index].compression == 2) {
+                hash = XXH_INLINE_XXH3_64bits_withSeed(self_bytes + seg_infos[seg_index].offset, seg_infos[seg_index].length, hash);
+                has_compressed_segments = true;
+            }
+        }
+
+        if (has_compressed_segments) {
+            inflated_segments.emplace();
+            inflated_segments->path = kernel.module_cache_path / fmt::format("{}-{:016X}.dat", fs::path(self_path).filename().stem().string(), hash);
+            read_inflated_segments(*inflated_segments);
+        }
+    }
+    InflatedSegments *const inflated_cache = inflated_segments ? &*inflated_segments : nullptr;
+
+    std::optional<RelocatedSegments> relocated_cache;
+    if (!kernel.module_cache_path.empty()) {
+        const uint64_t hash = XXH_INLINE_XXH3_64bits(self_bytes, self_header.self_filesize);
+        relocated_cache.emplace();
+        relocated_cache->path = kernel.module_cache_path / fmt::format("{}-{:016X}-reloc.dat", fs::path(self_path).filename().stem().string(), hash);
+        read_relocated_segments(*relocated_cache);
+    }
+    // set once the relocations were applied or replayed, a module can have several relocation segments
+    bool relocations_applied = false;
+    bool relocations_replayed = false;
+
     auto free_all_segments = [](MemState &mem, SegmentInfosForReloc &segs_info) {
         for (auto _seg : segs_info) {
             const SegmentInfoForReloc &segment = _seg.second;
@@ -520,11 +740,10 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
 
                 const Ptr<uint8_t> seg_ptr(segment_address);
                 if (seg_infos[seg_index].compression == 2) {
-                    unsigned long dest_bytes = seg_header.p_filesz;
                     const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
 
-                    int res = mz_uncompress(reinterpret_cast<uint8_t *>(seg_ptr.get(mem)), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                    assert(res == MZ_OK);
+                    const bool res = inflate_segment(inflated_cache, seg_index, seg_ptr.get(mem), seg_header.p_filesz, compressed_segment_bytes, seg_infos[seg_index].length);
+                    assert(res);
                 } else {
                     memcpy(seg_ptr.get(mem), seg_bytes, seg_header.p_filesz);
                 }
@@ -532,13 +751,20 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
                 segment_reloc_info[seg_index] = { segment_address, seg_header.p_vaddr, seg_header.p_memsz };
             }
         } else if (seg_header.p_type == PT_SCE_RELA) {
-            if (seg_infos[seg_index].compression == 2) {
-                unsigned long dest_bytes = seg_header.p_filesz;
+            if (!relocations_applied && relocated_cache && relocated_cache->matches(segment_reloc_info)) {
+                relocated_cache->replay(mem);
+                relocations_replayed = true;
+            }
+            relocations_applied = true;
+
+            if (relocations_replayed) {
+                // Already done by the replay.
+            } else if (seg_infos[seg_index].compression == 2) {
                 const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
-                std::unique_ptr<uint8_t[]> uncompressed(new uint8_t[dest_bytes]);
+                std::unique_ptr<uint8_t[]> uncompressed(new uint8_t[seg_header.p_filesz]);
 
-                int res = mz_uncompress(uncompressed.get(), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                assert(res == MZ_OK);
+                const bool res = inflate_segment(inflated_cache, seg_index, uncompressed.get(), seg_header.p_filesz, compressed_segment_bytes, seg_infos[seg_index].length);
+                assert(res);
                 if (!relocate(uncompressed.get(), seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
@@ -556,6 +782,14 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
         }
     }
 
+    // only written when the cache was missing or outdated
+    if (inflated_cache && !inflated_cache->inflated.empty())
+        write_inflated_segments(*inflated_cache);
+
+    // only written when the module was relocated without the record, before the imports are linked
+    if (relocated_cache && relocations_applied && !relocations_replayed)
+        write_relocated_segments(*relocated_cache, segment_reloc_info, mem);
+
     if (kernel.debugger.dump_elfs) {
         // Dump elf
         std::vector<uint8_t> dump_elf(self_bytes + self_header.header_len, self_bytes + self_header.self_filesize);
@@ -640,12 +874,18 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
 
     sceKernelModuleInfo->state = module_info->type;
 
+    // The module info always lives in the text segment
+    const SegmentInfoForReloc &text_segment = segment_reloc_info[module_info_segment_index];
+    kernel.jit_cache.load_module(module_info->name, module_info->module_nid, text_segment.addr, static_cast<uint32_t>(text_segment.size));
+
     LOG_INFO("Linking SELF {}...", self_path);
 
     if (!load_exports(entry_point, *module_info, module_info_segment_address, kernel, mem)) {
         return -1;
     }
 
+    kernel.hle_replacements.patch_module(mem, text_segment.addr, static_cast<uint32_t>(text_segment.size));
+
     if (!load_imports(*module_info, module_info_segment_address, segment_reloc_info, kernel, mem)) {
         return -1;
     }
@@ -0,0 +1,181 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/scheduler.h>
+
+#include <kernel/thread/thread_state.h>
+
+#include <util/host_cpu.h>
+#include <util/log.h>
+
+#include <algorithm>
+
+// A worker owner is 0 when the worker is free, else the id of its thread, with this flag while the worker is parked
+constexpr uint32_t WORKER_PARKED = 0x80000000;
+
+void ThreadScheduler::init(int worker_count) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    worker_count = std::clamp(worker_count, 0, MAX_SCHEDULER_WORKERS);
+    workers.clear();
+    all_cores = 0;
+    worker_owners = std::make_unique<std::atomic<uint32_t>[]>(worker_count);
+    for (int i = 0; i < worker_count; i++) {
+        workers.push_back(i % util::GUEST_CORE_COUNT);
+        all_cores |= 1 << (i % util::GUEST_CORE_COUNT);
+        worker_owners[i] = 0;
+    }
+
+    if (worker_count > 0)
+        LOG_INFO("Guest threads are scheduled on {} workers", worker_count);
+}
+
+void ThreadScheduler::set_host_affinity(const std::array<uint64_t, util::GUEST_CORE_COUNT> &guest_cores) {
+    host_affinity = guest_cores;
+    host_pinning = std::any_of(guest_cores.begin(), guest_cores.end(), [](uint64_t mask) { return mask != 0; });
+}
+
+uint32_t ThreadScheduler::get_cores(const ThreadState &thread) const {
+    // Bits 16 to 19 of the affinity mask are the allowed cores, and no core means any of them
+    const uint32_t available_cores = is_enabled() ? all_cores : (1 << util::GUEST_CORE_COUNT) - 1;
+    const uint32_t cores = (static_cast<uint32_t>(thread.affinity_mask) >> 16) & available_cores;
+    return cores ? cores : available_cores;
+}
+
+// Must be called by the thread itself
+void ThreadScheduler::pin_thread(ThreadState &thread, uint32_t cores) {
+    if (!host_pinning)
+        return;
+
+    uint64_t mask = 0;
+    for (uint32_t core = 0; core < util::GUEST_CORE_COUNT; core++) {
+        if (cores & (1 << core))
+            mask |= host_affinity[core];
+    }
+
+    if ((mask != 0) && (mask != thread.host_affinity) && util::set_current_thread_affinity(mask))
+        thread.host_affinity = mask;
+}
+
+bool ThreadScheduler::take_worker(int worker, uint32_t owner) {
+    std::atomic<uint32_t> &worker_owner = worker_owners[worker];
+    uint32_t current = worker_owner.load();
+    // A worker can only be taken while nobody runs guest code on it
+    while ((current == 0) || (current & WORKER_PARKED)) {
+        if (worker_owner.compare_exchange_weak(current, owner))
+            return true;
+    }
+
+    return false;
+}
+
+// Assumes mutex is locked
+int ThreadScheduler::take_available_worker(uint32_t cores, uint32_t owner) {
+    // Prefer free workers, to leave parked ones to their thread
+    for (const bool parked : { false, true }) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (!(cores & (1 << workers[i])))
+                continue;
+
+            const uint32_t current = worker_owners[i].load();
+            const bool available = parked ? ((current & WORKER_PARKED) != 0) : (current == 0);
+            if (available && take_worker(static_cast<int>(i), owner))
+                return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+}
+
+// Gives the worker to the best ready thread allowed to use it. Assumes mutex is locked
+void ThreadScheduler::hand_off(int worker) {
+    ReadyThread *best = nullptr;
+    for (ReadyThread *ready : ready_threads) {
+        if ((ready->worker >= 0) || !(ready->cores & (1 << workers[worker])))
+            continue;
+        if (!best || (ready->priority < best->priority) || ((ready->priority == best->priority) && (ready->order < best->order)))
+            best = ready;
+    }
+
+    if (best && take_worker(worker, static_cast<uint32_t>(best->thread->id))) {
+        best->worker = worker;
+        best->cond.notify_one();
+    }
+}
+
+void ThreadScheduler::enter_guest(ThreadState &thread) {
+    if (!is_enabled()) {
+        pin_thread(thread, get_cores(thread));
+        return;
+    }
+
+    const uint32_t owner = static_cast<uint32_t>(thread.id);
+    if (thread.scheduler_worker >= 0) {
+        uint32_t parked = owner | WORKER_PARKED;
+        if (worker_owners[thread.scheduler_worker].compare_exchange_strong(parked, owner))
+            return;
+
+        // Another thread took the worker while this one was in the host
+        thread.scheduler_worker = -1;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ReadyThread ready{ &thread, thread.priority, get_cores(thread), next_order++ };
+    ready_threads.push_back(&ready);
+    // Workers parked from now on are handed off by leave_guest, the ones parked before are found here
+    ready_count++;
+    ready.worker = take_available_worker(ready.cores, owner);
+    if (ready.worker < 0) {
+        wait_count++;
+        if (!ready.cond.wait_for(lock, SCHEDULER_MAX_WAIT, [&] { return ready.worker >= 0; }))
+            overflow_count++;
+    }
+
+    ready_count--;
+    ready_threads.erase(std::find(ready_threads.begin(), ready_threads.end(), &ready));
+    thread.scheduler_worker = ready.worker;
+    lock.unlock();
+
+    pin_thread(thread, (ready.worker >= 0) ? (1 << workers[ready.worker]) : ready.cores);
+}
+
+void ThreadScheduler::leave_guest(ThreadState &thread) {
+    if (!is_enabled() || (thread.scheduler_worker < 0))
+        return;
+
+    worker_owners[thread.scheduler_worker] = static_cast<uint32_t>(thread.id) | WORKER_PARKED;
+    if (ready_count > 0) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        hand_off(thread.scheduler_worker);
+    }
+}
+
+void ThreadScheduler::remove_thread(ThreadState &thread) {
+    if (!is_enabled() || (thread.scheduler_worker < 0))
+        return;
+
+    const int worker = thread.scheduler_worker;
+    thread.scheduler_worker = -1;
+
+    uint32_t parked = static_cast<uint32_t>(thread.id) | WORKER_PARKED;
+    if (!worker_owners[worker].compare_exchange_strong(parked, 0))
+        return;
+
+    if (ready_count > 0) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        hand_off(worker);
+    }
+}
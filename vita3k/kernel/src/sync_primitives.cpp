@@ -20,6 +20,7 @@
 #include <kernel/sync_primitives.h>
 
 #include <kernel/types.h>
+#include <mem/atomic.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
@@ -51,7 +52,7 @@ inline CondvarPtrs &get_condvars(KernelState &kernel, SyncWeight weight) {
 
 inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState &kernel, const char *export_name, SceUID mutexid, SyncWeight weight) {
     MutexPtrs &mutexes = get_mutexes(kernel, weight);
-    mutex_out = lock_and_find(mutexid, mutexes, kernel.mutex);
+    mutex_out = mutexes.get(mutexid);
     if (!mutex_out) {
         return unknown_mutex_id(export_name, weight);
     }
@@ -64,7 +65,7 @@ inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState
 
 inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, KernelState &kernel, const char *export_name, SceUID condid, SyncWeight weight) {
     CondvarPtrs &condvars = get_condvars(kernel, weight);
-    condvar_out = lock_and_find(condid, condvars, kernel.mutex);
+    condvar_out = condvars.get(condid);
     if (!condvar_out) {
         return unknown_cond_id(export_name, weight);
     }
@@ -77,7 +78,7 @@ inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, Ker
 
 // TODO: Write remaining time to timeout ptr when it's successfully signaled
 // Assumes primitive_lock is locked and thread_lock is unlocked
-inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
+inline int handle_timeout(KernelState &kernel, const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
     std::unique_lock<std::mutex> &primitive_lock, WaitingThreadQueuePtr &queue,
     const WaitingThreadData &data, const ThreadDataQueueInterator<WaitingThreadData> &data_it,
     const char *export_name, SceUInt *const timeout) {
@@ -85,7 +86,7 @@ inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mu
         bool status = false;
         auto start = std::chrono::steady_clock::now();
         if (*timeout > 0) {
-            status = thread->status_cond.wait_for(primitive_lock, std::chrono::microseconds{ *timeout }, [&] { return thread->status == ThreadStatus::run; });
+            status = kernel.timer_wheel.wait_for(thread->timer, primitive_lock, thread->status_cond, *timeout, [&] { return thread->status == ThreadStatus::run; });
         }
 
         if (!status) {
@@ -145,14 +146,14 @@ SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *expor
     event->auto_reset = (event->attr & SCE_KERNEL_EVENT_ATTR_AUTO_RESET);
     event->cb_wakeup_only = (event->attr & SCE_KERNEL_ATTR_NOTIFY_CB_WAKEUP_ONLY);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.simple_events.emplace(uid, event);
+    if (!kernel.simple_events.emplace(uid, event))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     return uid;
 }
 
 SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 wait_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const SimpleEventPtr event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -196,7 +197,7 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        const int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        const int err = handle_timeout(kernel, thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0) {
             // set it only if a timeout occurs
             // otherwise set in simple_event_setorpulse
@@ -212,7 +213,7 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
 }
 
 SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const SimpleEventPtr event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -269,7 +270,7 @@ SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, S
 }
 
 SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const SimpleEventPtr event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -287,7 +288,7 @@ SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID
 }
 
 SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const SimpleEventPtr event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -298,8 +299,7 @@ SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUI
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-        kernel.eventflags.erase(event_id);
+        kernel.simple_events.erase(event_id);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -333,7 +333,7 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     mutex->attr = attr;
     mutex->owner = nullptr;
     if (init_count > 0) {
-        const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+        const ThreadStatePtr thread = kernel.get_thread(thread_id);
         mutex->owner = thread;
     }
     if (mutex->attr & SCE_KERNEL_ATTR_TH_PRIO) {
@@ -345,14 +345,13 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     if (weight == SyncWeight::Light) {
         SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
         workarea_mem->lockCount = init_count;
-        if (workarea_mem->lockCount)
-            workarea_mem->owner = thread_id;
+        workarea_mem->owner = init_count ? thread_id : 0;
         workarea_mem->attr = attr;
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
     auto &mutexes = get_mutexes(kernel, weight);
-    mutexes.emplace(uid, mutex);
+    if (!mutexes.emplace(uid, mutex))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} init_count: {}",
@@ -373,7 +372,7 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
             mutex->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
 
     std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
 
@@ -385,9 +384,6 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         if (mutex->owner == thread) {
             if (is_recursive) {
                 mutex->lock_count += lock_count;
-                if (weight == SyncWeight::Light)
-                    mutex->workarea.get(mem)->lockCount += lock_count;
-
                 return SCE_KERNEL_OK;
             }
             if (weight == SyncWeight::Light)
@@ -416,17 +412,9 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
 
         const auto data_it = mutex->waiting_threads->push(data);
         thread_lock.unlock();
+        ++mutex->contention_count;
 
-        int res = handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
-
-        if (weight == SyncWeight::Light) {
-            mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-            if (mutex->owner == thread) {
-                mutex->workarea.get(mem)->owner = thread_id;
-            }
-        }
-
-        return res;
+        return handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
     }
     // Not owned
     // Take ownership!
@@ -434,13 +422,6 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
     mutex->lock_count += lock_count;
     mutex->owner = thread;
 
-    if (weight == SyncWeight::Light) {
-        mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-        if (mutex->owner == thread) {
-            mutex->workarea.get(mem)->owner = thread_id;
-        }
-    }
-
     return SCE_KERNEL_OK;
 }
 
@@ -465,7 +446,7 @@ int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name,
 }
 
 inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex) {
-    const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr current_thread = kernel.get_thread(thread_id);
 
     const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
 
@@ -528,7 +509,6 @@ int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id,
     }
 
     if (mutex->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
         mutexes->erase(mutexid);
     } else {
         // TODO:
@@ -554,6 +534,136 @@ MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_i
     return mutex;
 }
 
+// ***********************
+// * Lightweight mutexes *
+// ***********************
+
+// The owner word of the work area is the thread id of the owner, 0 when not owned.
+// Taking an unowned mutex is a CAS of the owner word, so the kernel object is only used to queue
+// waiting threads. Waiters set LW_MUTEX_OWNER_WAITERS so that the owner hands the mutex over to them on unlock.
+
+static void store_lwmutex_owner(volatile uint32_t *owner, uint32_t value) {
+    uint32_t current;
+    do {
+        current = *owner;
+    } while (!atomic_compare_and_swap(owner, value, current));
+}
+
+int lwmutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *timeout, bool only_try) {
+    SceKernelLwMutexWork *const workarea_mem = workarea.get(mem);
+    volatile uint32_t *const owner = &workarea_mem->owner;
+    const uint32_t self = static_cast<uint32_t>(thread_id);
+
+    const uint32_t current_owner = *owner;
+    if ((current_owner & ~LW_MUTEX_OWNER_WAITERS) == self) {
+        if (!(workarea_mem->attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE))
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
+
+        workarea_mem->lockCount += lock_count;
+        return SCE_KERNEL_OK;
+    }
+
+    if ((current_owner == 0) && atomic_compare_and_swap(owner, self, 0)) {
+        workarea_mem->lockCount = lock_count;
+        return SCE_KERNEL_OK;
+    }
+
+    if (only_try)
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
+
+    // Contended, wait in the kernel object
+    MutexPtr mutex;
+    if (auto error = find_mutex(mutex, nullptr, kernel, export_name, workarea_mem->uid, SyncWeight::Light))
+        return error;
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} timeout: {} waiting_threads: {}",
+            export_name, mutex->uid, thread_id, mutex->name, mutex->attr, workarea_mem->lockCount, timeout ? *timeout : 0,
+            mutex->waiting_threads->size());
+    }
+
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
+
+    std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
+
+    while (true) {
+        const uint32_t current = *owner;
+        if ((current & ~LW_MUTEX_OWNER_WAITERS) == 0) {
+            // Released meanwhile
+            if (atomic_compare_and_swap(owner, self | (current & LW_MUTEX_OWNER_WAITERS), current)) {
+                workarea_mem->lockCount = lock_count;
+                return SCE_KERNEL_OK;
+            }
+        } else if ((current & LW_MUTEX_OWNER_WAITERS) || atomic_compare_and_swap(owner, current | LW_MUTEX_OWNER_WAITERS, current)) {
+            break;
+        }
+    }
+
+    // Sleep thread!
+    std::unique_lock<std::mutex> thread_lock(thread->mutex);
+    thread->wait_reason = ThreadWaitReason::lwmutex;
+    thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+
+    WaitingThreadData data;
+    data.thread = thread;
+    data.lock_count = lock_count;
+    data.priority = thread->priority;
+
+    const auto data_it = mutex->waiting_threads->push(data);
+    thread_lock.unlock();
+    ++mutex->contention_count;
+
+    // When woken up, the unlocking thread already made us the owner
+    return handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
+}
+
+int lwmutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
+    SceKernelLwMutexWork *const workarea_mem = workarea.get(mem);
+    volatile uint32_t *const owner = &workarea_mem->owner;
+    const uint32_t self = static_cast<uint32_t>(thread_id);
+
+    if ((*owner & ~LW_MUTEX_OWNER_WAITERS) != self)
+        return SCE_KERNEL_OK;
+
+    if (unlock_count > static_cast<int>(workarea_mem->lockCount))
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_UNLOCK_UDF);
+
+    workarea_mem->lockCount -= unlock_count;
+    if ((workarea_mem->lockCount > 0) || atomic_compare_and_swap(owner, 0, self))
+        return SCE_KERNEL_OK;
+
+    // Threads are waiting, hand the mutex over to the first one
+    MutexPtr mutex;
+    if (auto error = find_mutex(mutex, nullptr, kernel, export_name, workarea_mem->uid, SyncWeight::Light))
+        return error;
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} unlock_count: {} waiting_threads: {}",
+            export_name, mutex->uid, thread_id, mutex->name, mutex->attr, unlock_count,
+            mutex->waiting_threads->size());
+    }
+
+    const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
+
+    // Waiters which timed out leave the flag set
+    if (mutex->waiting_threads->empty()) {
+        store_lwmutex_owner(owner, 0);
+        return SCE_KERNEL_OK;
+    }
+
+    const auto waiting_thread_data = *mutex->waiting_threads->begin();
+    const auto waiting_thread = waiting_thread_data.thread;
+    mutex->waiting_threads->pop();
+
+    workarea_mem->lockCount = waiting_thread_data.lock_count;
+    store_lwmutex_owner(owner, static_cast<uint32_t>(waiting_thread->id) | (mutex->waiting_threads->empty() ? 0 : LW_MUTEX_OWNER_WAITERS));
+
+    const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
+    waiting_thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+
+    return SCE_KERNEL_OK;
+}
+
 // **************
 // * RWLock *
 // **************
@@ -575,8 +685,8 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
         rwlock->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.rwlocks.emplace(uid, rwlock);
+    if (!kernel.rwlocks.emplace(uid, rwlock))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
@@ -588,7 +698,7 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
 
 SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, uint32_t *timeout, bool is_write) {
     const ThreadStatePtr thread = kernel.get_thread(thread_id);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    const RWLockPtr rwlock = kernel.rwlocks.get(lock_id);
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -636,13 +746,13 @@ SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name
         const auto data_it = rwlock->waiting_threads->push(data);
         thread_lock.unlock();
 
-        return handle_timeout(thread, thread_lock, rwlock_lock, rwlock->waiting_threads, data, data_it, export_name, timeout);
+        return handle_timeout(kernel, thread, thread_lock, rwlock_lock, rwlock->waiting_threads, data, data_it, export_name, timeout);
     }
 }
 
 SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, bool is_write) {
-    const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    const ThreadStatePtr current_thread = kernel.get_thread(thread_id);
+    const RWLockPtr rwlock = kernel.rwlocks.get(lock_id);
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -704,7 +814,7 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
 
 SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id) {
     const ThreadStatePtr thread = kernel.get_thread(thread_id);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    const RWLockPtr rwlock = kernel.rwlocks.get(lock_id);
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -716,7 +826,6 @@ SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_na
     }
 
     if (rwlock->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
         kernel.rwlocks.erase(lock_id);
     } else {
         // TODO:
@@ -755,8 +864,8 @@ SceUID semaphore_create(KernelState &kernel, const char *export_name, const char
             export_name, uid, thread_id, name, attr, init_val, max_val);
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.semaphores.emplace(uid, semaphore);
+    if (!kernel.semaphores.emplace(uid, semaphore))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     return uid;
 }
@@ -765,7 +874,7 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
     assert(semaId >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaId, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = kernel.semaphores.get(semaId);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -776,7 +885,7 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
             pTimeout ? *pTimeout : 0, semaphore->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
 
     std::unique_lock<std::mutex> semaphore_lock(semaphore->mutex);
 
@@ -795,7 +904,7 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
         const auto data_it = semaphore->waiting_threads->push(data);
         thread_lock.unlock();
 
-        auto res = handle_timeout(thread, thread_lock, semaphore_lock, semaphore->waiting_threads, data, data_it, export_name, pTimeout);
+        auto res = handle_timeout(kernel, thread, thread_lock, semaphore_lock, semaphore->waiting_threads, data, data_it, export_name, pTimeout);
         if (was_canceled)
             res = SCE_KERNEL_ERROR_WAIT_CANCEL;
         return res;
@@ -810,7 +919,7 @@ int semaphore_signal(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -853,7 +962,7 @@ int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -865,7 +974,6 @@ int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread
     }
 
     if (semaphore->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         kernel.semaphores.erase(semaid);
     } else {
         // TODO:
@@ -879,7 +987,7 @@ int semaphore_cancel(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const SemaphorePtr semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -952,9 +1060,9 @@ SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_n
         condvar->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
     auto &condvars = get_condvars(kernel, weight);
-    condvars.emplace(uid, condvar);
+    if (!condvars.emplace(uid, condvar))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     if (uid_out)
         *uid_out = uid;
@@ -975,12 +1083,16 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
             timeout ? *timeout : 0, condvar->waiting_threads->size());
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
 
     std::unique_lock<std::mutex> condition_variable_lock(condvar->mutex);
 
-    if (auto error = mutex_unlock_impl(kernel, export_name, thread_id, 1, condvar->associated_mutex))
+    if (weight == SyncWeight::Light) {
+        if (auto error = lwmutex_unlock(kernel, mem, export_name, thread_id, condvar->associated_mutex->workarea, 1))
+            return error;
+    } else if (auto error = mutex_unlock_impl(kernel, export_name, thread_id, 1, condvar->associated_mutex)) {
         return error;
+    }
 
     std::unique_lock<std::mutex> thread_lock(thread->mutex);
     thread->update_status(ThreadStatus::wait, ThreadStatus::run);
@@ -992,10 +1104,13 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
     const auto data_it = condvar->waiting_threads->push(data);
     thread_lock.unlock();
 
-    if (auto error = handle_timeout(thread, thread_lock, condition_variable_lock, condvar->waiting_threads, data, data_it, export_name, timeout))
+    if (auto error = handle_timeout(kernel, thread, thread_lock, condition_variable_lock, condvar->waiting_threads, data, data_it, export_name, timeout))
         return error;
 
     condition_variable_lock.unlock();
+    if (weight == SyncWeight::Light)
+        return lwmutex_lock(kernel, mem, export_name, thread_id, condvar->associated_mutex->workarea, 1, timeout, false);
+
     return mutex_lock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex, weight, timeout, false);
 }
 
@@ -1019,7 +1134,7 @@ int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_i
     auto &waiting_threads = condvar->waiting_threads;
 
     if (target_type == Condvar::SignalTarget::Type::Specific) {
-        ThreadStatePtr waiting_thread = lock_and_find(signal_target.thread_id, kernel.threads, kernel.mutex);
+        ThreadStatePtr waiting_thread = kernel.get_thread(signal_target.thread_id);
         // Search for specified waiting thread
         auto waiting_thread_iter = waiting_threads->find(waiting_thread);
         if (waiting_thread_iter != waiting_threads->end()) {
@@ -1061,7 +1176,6 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
     }
 
     if (condvar->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         condvars->erase(condid);
     } else {
         // TODO:
@@ -1076,7 +1190,7 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
 // **************
 
 SceUID eventflag_clear(KernelState &kernel, const char *export_name, SceUID evfId, SceUInt32 bitPattern) {
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = kernel.eventflags.get(evfId);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1116,8 +1230,8 @@ SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thr
         event->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.eventflags.emplace(uid, event);
+    if (!kernel.eventflags.emplace(uid, event))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     return uid;
 }
@@ -1126,7 +1240,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
     assert(event_id >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = kernel.eventflags.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1142,7 +1256,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         return RET_ERROR(SCE_KERNEL_ERROR_EVF_MULTI);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
 
     std::unique_lock<std::mutex> event_lock(event->mutex);
 
@@ -1169,6 +1283,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         return SCE_KERNEL_OK;
     } else if (dowait) {
         std::unique_lock<std::mutex> thread_lock(thread->mutex);
+        thread->wait_reason = ThreadWaitReason::eventflag;
         thread->update_status(ThreadStatus::wait, ThreadStatus::run);
 
         WaitingThreadData data;
@@ -1184,7 +1299,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        int err = handle_timeout(kernel, thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0 && outBits) {
             // set it only if a timeout occurs
             // otherwise set in eventflag_set
@@ -1211,7 +1326,7 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
     assert(evfId >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = kernel.eventflags.get(evfId);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1267,7 +1382,7 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
 SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = kernel.eventflags.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1308,7 +1423,7 @@ SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID t
 int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const EventFlagPtr event = kernel.eventflags.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1319,7 +1434,6 @@ int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         kernel.eventflags.erase(event_id);
     } else {
         // TODO:
@@ -1360,22 +1474,22 @@ SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *
     // TODO do senders respect priority?
     msgpipe->senders = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.msgpipes.emplace(uid, msgpipe);
+    if (!kernel.msgpipes.emplace(uid, msgpipe))
+        return RET_ERROR(SCE_KERNEL_ERROR_NO_MEMORY);
 
     return uid;
 }
 
 SceUID msgpipe_find(KernelState &kernel, const char *export_name, const char *name) {
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-
     // TODO use another map
-    const auto it = std::find_if(kernel.msgpipes.begin(), kernel.msgpipes.end(), [=](auto it) {
-        return strcmp(it.second->name, name) == 0;
+    SceUID uid = 0;
+    kernel.msgpipes.for_each([&](SceUID msgpipe_id, const MsgPipePtr &msgpipe) {
+        if (!uid && (strcmp(msgpipe->name, name) == 0))
+            uid = msgpipe_id;
     });
 
-    if (it != kernel.msgpipes.end()) {
-        return it->first;
+    if (uid) {
+        return uid;
     }
 
     return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
@@ -1386,7 +1500,7 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgPipeId, kernel.msgpipes, kernel.mutex);
+    const MsgPipePtr msgpipe = kernel.msgpipes.get(msgPipeId);
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
@@ -1409,7 +1523,7 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
         }
     };
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
     std::unique_lock msgpipe_lock(msgpipe->mutex);
 
     const auto wakeup_senders = [&] {
@@ -1469,7 +1583,7 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
 
             return finish();
         } else { // There's a timeout - wait until we can fill buffer or timeout
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
+            auto status = kernel.timer_wheel.wait_for(thread->timer, thread_lock, thread->status_cond, *pTimeout, [&] { return thread->status == ThreadStatus::run; });
             if (msgpipe->beingDeleted) {
                 std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
                 return SCE_KERNEL_ERROR_WAIT_DELETE;
@@ -1477,6 +1591,8 @@ SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread
 
             if (!status) { // Timed out and buffer hasn't been touched
                 thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+                msgpipe_lock.lock();
+                msgpipe->receivers->erase(msgpipe->receivers->find(thread));
                 return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
             }
 
@@ -1491,7 +1607,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgPipeId, kernel.msgpipes, kernel.mutex);
+    const MsgPipePtr msgpipe = kernel.msgpipes.get(msgPipeId);
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
@@ -1519,7 +1635,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
         }
     };
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
     std::unique_lock<std::mutex> msgpipe_lock(msgpipe->mutex);
 
     // FIXME implement SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT (for now, all requests are handled synchronously)
@@ -1569,7 +1685,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 
             return finish();
         } else { // There's a timeout - wait until we can fill buffer or timeout
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
+            auto status = kernel.timer_wheel.wait_for(thread->timer, thread_lock, thread->status_cond, *pTimeout, [&] { return thread->status == ThreadStatus::run; });
             if (msgpipe->beingDeleted) {
                 std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
                 return SCE_KERNEL_ERROR_WAIT_DELETE;
@@ -1577,6 +1693,8 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 
             if (!status) { // Timed out and buffer hasn't been touched
                 thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+                msgpipe_lock.lock();
+                msgpipe->senders->erase(msgpipe->senders->find(thread));
                 return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
             }
 
@@ -1588,7 +1706,7 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 SceUID msgpipe_delete(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUID msgpipe_id) {
     assert(msgpipe_id >= 0);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgpipe_id, kernel.msgpipes, kernel.mutex);
+    const MsgPipePtr msgpipe = kernel.msgpipes.get(msgpipe_id);
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1605,17 +1723,18 @@ SceUID msgpipe_delete(KernelState &kernel, const char *export_name, const char *
         std::atomic_thread_fence(std::memory_order_release);
 
         // Wake up every thread
-        for (auto it = msgpipe->senders->begin(); it != msgpipe->senders->end(); it++) {
-            (*it).thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+        while (!msgpipe->senders->empty()) {
+            msgpipe->senders->begin()->thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            msgpipe->senders->pop();
         }
-        for (auto it = msgpipe->receivers->begin(); it != msgpipe->receivers->end(); it++) {
-            (*it).thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+        while (!msgpipe->receivers->empty()) {
+            msgpipe->receivers->begin()->thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            msgpipe->receivers->pop();
         }
         while (std::atomic_load(&msgpipe->remainingThreads) != 0) // FIXME busy loop bad
             ;
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
     kernel.msgpipes.erase(msgpipe->uid);
 
     return SCE_KERNEL_OK;
@@ -18,6 +18,7 @@
 #include <cpu/functions.h>
 #include <kernel/thread/thread_state.h>
 
+#include <kernel/scheduler.h>
 #include <kernel/state.h>
 #include <mem/ptr.h>
 #include <util/align.h>
@@ -30,6 +31,7 @@
 #include <util/log.h>
 
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <memory>
 #include <sstream>
@@ -69,11 +71,12 @@ int ThreadState::init(KernelState &kernel, const char *name, Ptr<const void> ent
         priority = init_priority;
     }
     this->affinity_mask = affinity_mask;
+    scheduler = &kernel.scheduler;
     this->stack_size = stack_size;
     start_tick = rtc_get_ticks(kernel.base_tick.tick);
     last_vblank_waited = 0;
 
-    cpu = init_cpu(kernel.cpu_backend, kernel.cpu_opt, id, static_cast<std::size_t>(core_num), mem, kernel.cpu_protocol.get());
+    cpu = init_cpu(kernel.cpu_backend, kernel.cpu_opt, kernel.cpu_unsafe_opt, kernel.spin_poll_backoff, kernel.jit_code_cache_size, id, static_cast<std::size_t>(core_num), mem, kernel.cpu_protocol.get());
     if (!cpu) {
         return SCE_KERNEL_ERROR_ERROR;
     }
@@ -85,8 +88,11 @@ int ThreadState::init(KernelState &kernel, const char *name, Ptr<const void> ent
     }
 
     std::string alloc_name = fmt::format("Stack for thread {} (#{})", name, id);
-    stack = alloc_block(mem, stack_size, alloc_name.c_str());
+    stack = kernel.alloc_thread_stack(mem, stack_size, alloc_name.c_str());
+#ifndef NDEBUG
+    // makes the uninitialized stack variables stand out, the pages are already cleared otherwise
     memset(stack.get_ptr<void>().get(mem), 0xcc, stack_size);
+#endif
 
     alloc_name = fmt::format("TLS for thread {} (#{})", name, id);
     const size_t tls_size = KERNEL_TLS_SIZE + kernel.tls_msize;
@@ -111,9 +117,18 @@ int ThreadState::init(KernelState &kernel, const char *name, Ptr<const void> ent
     }
     this->init_cpu_ctx = ctx;
 
+    // The cached blocks are translated, hot ones first, by the thread itself while it waits to be started
+    jit_prewarm_blocks = kernel.jit_cache.get_blocks();
+    jit_prewarm_next = 0;
+
     return 0;
 }
 
+void ThreadState::stop_jit_prewarm() {
+    jit_prewarm_blocks.clear();
+    jit_prewarm_next = 0;
+}
+
 void ThreadState::raise_waiting_threads() {
     for (auto t : waiting_threads) {
         const std::unique_lock<std::mutex> lock(t->mutex);
@@ -128,6 +143,7 @@ int ThreadState::start(KernelState &kernel, SceSize arglen, const Ptr<void> &arg
     if (status == ThreadStatus::run || call_level > 0)
         return SCE_KERNEL_ERROR_RUNNING;
     std::unique_lock<std::mutex> thread_lock(mutex);
+    stop_jit_prewarm();
 
     call_level = 1;
     load_context(*cpu, init_cpu_ctx);
@@ -194,16 +210,23 @@ bool ThreadState::run_loop() {
 
             // Run the cpu
             lock.unlock();
-            if (to_do == ThreadToDo::step) {
-                res = step(*cpu);
-                to_do = ThreadToDo::suspend;
-
-            } else
-                res = run(*cpu);
+            scheduler->enter_guest(*this);
+            {
+                const auto jit_start = std::chrono::steady_clock::now();
+                if (to_do == ThreadToDo::step) {
+                    res = step(*cpu);
+                    to_do = ThreadToDo::suspend;
+
+                } else
+                    res = run(*cpu);
+                cpu_stats.jit_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - jit_start).count(), std::memory_order_relaxed);
+                cpu_stats.jit_entries.fetch_add(1, std::memory_order_relaxed);
+            }
+            scheduler->leave_guest(*this);
 
             // handle svc call if this was what stopped the cpu
             if (cpu->svc_called) {
-                cpu->protocol->call_svc(*cpu, cpu->svc_called, read_pc(*cpu), *this);
+                cpu->protocol->call_svc(*cpu, cpu->svc, read_pc(*cpu), *this);
             }
 
             lock.lock();
@@ -240,6 +263,14 @@ bool ThreadState::run_loop() {
             }
             break;
         case ThreadToDo::wait:
+            // the JIT can only be used by its own thread, so the prewarm is done here one block at a time,
+            // with the thread mutex held start() waits for the current block only
+            if (jit_prewarm_next < jit_prewarm_blocks.size()) {
+                precompile_block(*cpu, jit_prewarm_blocks[jit_prewarm_next++]);
+                if (jit_prewarm_next == jit_prewarm_blocks.size())
+                    stop_jit_prewarm();
+                break;
+            }
             something_to_do.wait(lock);
             break;
         case ThreadToDo::suspend:
@@ -248,38 +279,70 @@ bool ThreadState::run_loop() {
     }
 }
 
-void ThreadState::push_arguments(Address callback_address, const std::vector<uint32_t> &args) {
-    Address sp = read_sp(*cpu);
-    for (size_t i = 0; i < std::min(args.size(), static_cast<size_t>(4)); i++) {
-        write_reg(*cpu, i, args[i]);
+void ThreadState::push_arguments(Address sp, const CallbackArgs &args) {
+    for (size_t i = 0; i < std::min(args.count, static_cast<size_t>(4)); i++) {
+        write_reg(*cpu, i, args.values[i]);
     }
-    if (args.size() > 4) {
+    if (args.count > 4) {
         // TODO align to 16 bytes
-        const size_t remain_size = args.size() - 4;
+        const size_t remain_size = args.count - 4;
         sp -= 4 * remain_size;
-        memcpy(Ptr<uint32_t>(sp).get(mem), &args[4], remain_size * 4);
+        memcpy(Ptr<uint32_t>(sp).get(mem), &args.values[4], remain_size * 4);
     }
     write_sp(*cpu, sp);
 }
 
-uint32_t ThreadState::run_callback(Address callback_address, const std::vector<uint32_t> &args) {
+uint32_t ThreadState::run_callback(Address callback_address, const CallbackArgs &args) {
+    uint32_t result = 0;
+    queue_callback(callback_address, args, &result);
+    run_queued_callbacks();
+
+    return result;
+}
+
+void ThreadState::queue_callback(Address callback_address, const CallbackArgs &args, uint32_t *result) {
+    if (callback_queue_size == callback_queue.size())
+        run_queued_callbacks();
+
+    callback_queue[callback_queue_size++] = { callback_address, args, result };
+}
+
+void ThreadState::run_queued_callbacks() {
+    if (callback_queue_size == 0)
+        return;
+
+    // take the batch, callbacks run inside these ones start their own
+    std::array<QueuedCallback, CALLBACK_QUEUE_SIZE> batch;
+    const size_t batch_size = callback_queue_size;
+    std::copy_n(callback_queue.begin(), batch_size, batch.begin());
+    callback_queue_size = 0;
+
     // first save the current context
     const CPUContext previous_ctx = save_context(*cpu);
     const uint32_t previous_tpidruro = read_tpidruro(*cpu);
+    const Address sp = read_sp(*cpu);
 
-    std::unique_lock<std::mutex> thread_lock(mutex);
-    call_level++;
-    // we shouldn't have to clean the context I believe
-    write_pc(*cpu, callback_address);
-    write_lr(*cpu, cpu->halt_instruction_pc);
-    push_arguments(callback_address, args);
-    thread_lock.unlock();
+    for (size_t i = 0; i < batch_size; i++) {
+        const QueuedCallback &callback = batch[i];
 
-    // unlock but then immediatly lock back in the run_loop function
-    // shouldn't cause an issue, but maybe we could use a recursive mutex instead
-    run_loop();
+        std::unique_lock<std::mutex> thread_lock(mutex);
+        call_level++;
+        // we shouldn't have to clean the context I believe
+        write_pc(*cpu, callback.address);
+        write_lr(*cpu, cpu->halt_instruction_pc);
+        push_arguments(sp, callback.args);
+        thread_lock.unlock();
 
-    thread_lock.lock();
+        // unlock but then immediatly lock back in the run_loop function
+        // shouldn't cause an issue, but maybe we could use a recursive mutex instead
+        run_loop();
+
+        thread_lock.lock();
+        if (callback.result)
+            *callback.result = returned_value;
+    }
+
+    const std::lock_guard<std::mutex> thread_lock(mutex);
 
     // restore the previous context
     // actually, in most case I don't think this is necessary as the caller
@@ -287,8 +350,6 @@ uint32_t ThreadState::run_callback(Address callback_address, const std::vector<u
     // but do it just in case
     load_context(*cpu, previous_ctx);
     write_tpidruro(*cpu, previous_tpidruro);
-
-    return returned_value;
 }
 
 uint32_t ThreadState::run_guest_function(KernelState &kernel, Address callback_address, uint32_t arg) {
@@ -312,6 +373,33 @@ uint32_t ThreadState::run_guest_function(KernelState &kernel, Address callback_a
     return returned_value;
 }
 
+uint32_t ThreadState::run_guest_context(KernelState &kernel, const CPUCalleeSavedContext &ctx, uint32_t arg) {
+    if (status == ThreadStatus::run || call_level > 0)
+        return SCE_KERNEL_ERROR_RUNNING;
+    {
+        std::unique_lock<std::mutex> thread_lock(mutex);
+        stop_jit_prewarm();
+
+        call_level = 1;
+        load_context(*cpu, init_cpu_ctx);
+        load_callee_saved_context(*cpu, ctx);
+        write_reg(*cpu, 0, arg);
+        to_do = ThreadToDo::run;
+        something_to_do.notify_one();
+    }
+    {
+        // wait for the code to halt
+        std::unique_lock<std::mutex> lock(mutex);
+        if (status != ThreadStatus::dormant || to_do == ThreadToDo::run) {
+            status_cond.wait(lock, [&]() {
+                return status == ThreadStatus::dormant && to_do != ThreadToDo::run;
+            });
+        }
+    }
+
+    return returned_value;
+}
+
 void ThreadState::stop_loop() {
     std::lock_guard<std::mutex> lock(mutex);
     const ThreadToDo last_to_do = to_do;
@@ -332,6 +420,17 @@ void ThreadState::update_status(ThreadStatus status, std::optional<ThreadStatus>
     if (expected)
         assert(expected.value() == this->status);
 
+    const bool was_waiting = this->status == ThreadStatus::wait;
+    if (was_waiting != (status == ThreadStatus::wait)) {
+        const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (was_waiting) {
+            cpu_stats.blocked_ns[static_cast<size_t>(wait_reason)].fetch_add(now - wait_start_ns, std::memory_order_relaxed);
+            wait_reason = ThreadWaitReason::other;
+        } else {
+            wait_start_ns = now;
+        }
+    }
+
     this->status = status;
     status_cond.notify_all();
 
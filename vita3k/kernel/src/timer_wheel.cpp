@@ -0,0 +1,222 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/timer_wheel.h>
+
+#include <algorithm>
+
+TimerWheel::TimerWheel() {
+    thread = std::thread(&TimerWheel::run, this);
+}
+
+TimerWheel::~TimerWheel() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wheel_cond.notify_one();
+    thread.join();
+}
+
+uint64_t TimerWheel::now() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TimerWheel::arm(ThreadTimer &timer, std::mutex &timer_mutex, std::condition_variable &cond, uint64_t deadline_us) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (is_empty())
+        // No need to go through the ticks an empty wheel slept through
+        current_tick = std::max(current_tick, now() / TIMER_WHEEL_TICK);
+
+    timer.mutex = &timer_mutex;
+    timer.cond = &cond;
+    timer.timed_out = false;
+    // The slot of the current tick already expired
+    timer.deadline = std::max((deadline_us + TIMER_WHEEL_TICK - 1) / TIMER_WHEEL_TICK, current_tick + 1);
+    timer.state = ThreadTimerState::armed;
+    insert(timer);
+
+    if (deadline_us < wake_deadline) {
+        wake_deadline = deadline_us;
+        wheel_cond.notify_one();
+    }
+}
+
+void TimerWheel::cancel(ThreadTimer &timer) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (timer.state == ThreadTimerState::armed)
+        unlink(timer);
+    else if (timer.state == ThreadTimerState::firing)
+        firing.erase(std::find(firing.begin(), firing.end(), &timer));
+
+    timer.state = ThreadTimerState::idle;
+    timer.timed_out = false;
+}
+
+bool TimerWheel::is_empty() const {
+    return std::all_of(level_counts.begin(), level_counts.end(), [](uint32_t count) { return count == 0; });
+}
+
+void TimerWheel::insert(ThreadTimer &timer) {
+    const uint64_t delta = timer.deadline - std::min(timer.deadline, current_tick);
+    uint32_t level = 0;
+    while ((level < WHEEL_LEVELS - 1) && (delta >= (1ULL << (WHEEL_SLOT_BITS * (level + 1)))))
+        level++;
+
+    uint64_t slot = timer.deadline >> (WHEEL_SLOT_BITS * level);
+    if (delta >= (1ULL << (WHEEL_SLOT_BITS * WHEEL_LEVELS)))
+        // Too far for the wheel, put it in the last slot of the last level to be reached and cascade it again from there
+        slot = (current_tick >> (WHEEL_SLOT_BITS * level)) - 1;
+
+    ThreadTimer *&head = levels[level][slot & (WHEEL_SLOTS - 1)];
+    timer.prev = nullptr;
+    timer.next = head;
+    if (head)
+        head->prev = &timer;
+    head = &timer;
+    timer.slot = &head;
+    timer.level = level;
+    level_counts[level]++;
+}
+
+void TimerWheel::unlink(ThreadTimer &timer) {
+    if (timer.prev)
+        timer.prev->next = timer.next;
+    else
+        *timer.slot = timer.next;
+    if (timer.next)
+        timer.next->prev = timer.prev;
+
+    timer.prev = nullptr;
+    timer.next = nullptr;
+    timer.slot = nullptr;
+    level_counts[timer.level]--;
+}
+
+void TimerWheel::cascade(uint32_t level) {
+    ThreadTimer *timer = levels[level][(current_tick >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1)];
+    while (timer) {
+        ThreadTimer *const next = timer->next;
+        unlink(*timer);
+        insert(*timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t tick) {
+    if (is_empty()) {
+        current_tick = std::max(current_tick, tick);
+        return;
+    }
+
+    while (current_tick < tick) {
+        if (level_counts[0] == 0) {
+            // Nothing can expire before the next cascade
+            const uint64_t next_cascade = (current_tick | (WHEEL_SLOTS - 1)) + 1;
+            if (next_cascade > tick) {
+                current_tick = tick;
+                return;
+            }
+            current_tick = next_cascade - 1;
+        }
+
+        current_tick++;
+        for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+            if (current_tick & ((1ULL << (WHEEL_SLOT_BITS * level)) - 1))
+                break;
+            cascade(level);
+        }
+
+        // Timers of the first level expire at the tick of their slot
+        ThreadTimer *&head = levels[0][current_tick & (WHEEL_SLOTS - 1)];
+        while (head) {
+            ThreadTimer *const timer = head;
+            unlink(*timer);
+            timer->state = ThreadTimerState::firing;
+            firing.push_back(timer);
+        }
+    }
+}
+
+bool TimerWheel::fire_expired() {
+    const auto fired = std::remove_if(firing.begin(), firing.end(), [](ThreadTimer *timer) {
+        // The waiter may be holding its mutex to cancel the timer, which it can't do before the wheel mutex is unlocked
+        if (!timer->mutex->try_lock())
+            return false;
+
+        timer->timed_out = true;
+        timer->state = ThreadTimerState::idle;
+        timer->cond->notify_all();
+        timer->mutex->unlock();
+        return true;
+    });
+    firing.erase(fired, firing.end());
+
+    return !firing.empty();
+}
+
+uint64_t TimerWheel::get_next_tick() const {
+    uint64_t next_tick = UINT64_MAX;
+    if (level_counts[0] > 0) {
+        for (uint64_t tick = current_tick + 1; tick <= current_tick + WHEEL_SLOTS; tick++) {
+            if (levels[0][tick & (WHEEL_SLOTS - 1)]) {
+                next_tick = tick;
+                break;
+            }
+        }
+    }
+
+    for (uint32_t level = 1; level < WHEEL_LEVELS; level++) {
+        if (level_counts[level] > 0) {
+            const uint32_t shift = WHEEL_SLOT_BITS * level;
+            return std::min(next_tick, ((current_tick >> shift) + 1) << shift);
+        }
+    }
+
+    return next_tick;
+}
+
+void TimerWheel::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        advance(now() / TIMER_WHEEL_TICK);
+        if (fire_expired()) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+            continue;
+        }
+
+        const uint64_t next_tick = get_next_tick();
+        if (next_tick == UINT64_MAX) {
+            wake_deadline = UINT64_MAX;
+            wheel_cond.wait(lock);
+            continue;
+        }
+
+        wake_deadline = next_tick * TIMER_WHEEL_TICK;
+        const uint64_t time = now();
+        if (wake_deadline > time + TIMER_WHEEL_SPIN) {
+            wheel_cond.wait_for(lock, std::chrono::microseconds{ wake_deadline - time - TIMER_WHEEL_SPIN });
+        } else {
+            lock.unlock();
+            while (now() < wake_deadline)
+                std::this_thread::yield();
+            lock.lock();
+        }
+    }
+}
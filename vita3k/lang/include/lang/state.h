@@ -183,7 +183,8 @@ struct LangState {
     Compatibility compatibility;
     std::map<std::string, std::string> compile_shaders = {
         { "compiling_shaders", "Compiling Shaders" },
-        { "shaders_compiled", "shaders compiled" }
+        { "shaders_compiled", "shaders compiled" },
+        { "pipelines_compiling", "pipelines compiling" }
     };
     struct ContentManager {
         std::map<std::string, std::string> main = {
@@ -246,6 +247,8 @@ struct LangState {
         { "full_screen", "Full Screen" },
         { "toggle_touch", "Toggle Touch" },
         { "toggle_gui_visibility", "Toggle GUI Visibility" },
+        { "screenshot", "Screenshot" },
+        { "toggle_recording", "Toggle Recording" },
         { "error", "Error" },
         { "error_duplicate_key", "The key is used for other bindings or it is reserved." }
     };
@@ -313,7 +316,8 @@ struct LangState {
             { "copy_paste_zrif", "Ctrl (Cmd) + C to copy, Ctrl (Cmd) + V to paste." },
             { "delete_pkg", "Delete the pkg file?" },
             { "delete_work", "Delete the work.bin file?" },
-            { "check_log", "Please check the log for more details." }
+            { "check_log", "Please check the log for more details." },
+            { "install_speed", "Install speed" }
         };
         std::map<std::string, std::string> archive_install = {
             { "select_install_type", "Select install type" },
@@ -375,7 +379,35 @@ struct LangState {
         { "fps", "FPS" },
         { "avg", "Avg" },
         { "min", "Min" },
-        { "max", "Max" }
+        { "max", "Max" },
+        { "exclusive_fails", "Excl. fails" },
+        { "interpreter", "Interp. insts" },
+        { "time", "time" },
+        { "guest_time", "JIT/HLE/Wait" },
+        { "pipeline_collisions", "Pipe. collisions" },
+        { "ring_stalls", "Ring stalls" },
+        { "state_sets", "States set/filtered" },
+        { "gpu_time", "GPU scene/present" },
+        { "busy", "busy" },
+        { "gpu_memory", "VRAM" },
+        { "evicted", "Evicted" },
+        { "gpu_memory_pools", "Tex/Surf/Stg" },
+        { "unused", "unused" },
+        { "textures", "Tex. hits" },
+        { "uploaded", "up" },
+        { "samplers", "Samplers" },
+        { "hits", "hits" },
+        { "audio_latency", "Audio" },
+        { "underruns", "Xruns" },
+        { "ngs", "NGS" },
+        { "ngs_voice", "voice" },
+        { "ngs_stages", "Dec/Res/Mix/Cb" },
+        { "net_packets", "Net rx/tx" },
+        { "net_batch", "batch" },
+        { "draw_textures", "Hash/Dec/Upl/State" },
+        { "draw_stages", "Pipe/Desc/Vtx/Rec" },
+        { "draws", "Draws" },
+        { "draw_states", "states" }
     };
     struct Settings {
         std::map<std::string, std::string> main = { { "title", "Settings" } };
@@ -17,6 +17,7 @@
 
 #include "interface.h"
 
+#include <app/benchmark.h>
 #include <app/functions.h>
 #include <config/functions.h>
 #include <config/version.h>
@@ -34,8 +35,10 @@
 #include <renderer/shaders.h>
 #include <renderer/state.h>
 #include <shader/spirv_recompiler.h>
+#include <util/boot_stages.h>
 #include <util/log.h>
 #include <util/string_utils.h>
+#include <util/tracy_zones.h>
 
 #if USE_DISCORD
 #include <app/discord.h>
@@ -150,6 +153,8 @@ int main(int argc, char *argv[]) {
         return InitConfigFailed;
     }
 
+    update_tracy_subsystems(cfg.tracy_subsystems, cfg.tracy_advanced_profiling_modules);
+
 #ifdef WIN32
     auto res = CoInitializeEx(NULL, COINIT_MULTITHREADED);
     LOG_ERROR_IF(res == S_FALSE, "Failed to initialize COM Library");
@@ -351,29 +356,59 @@ int main(int argc, char *argv[]) {
             ImGui::GetBackgroundDrawList()->AddImage(gui.user_backgrounds[gui.users[emuenv.io.user_id].backgrounds[0]], pos_min, pos_max);
     };
 
+    const auto set_renderer_app = [&emuenv]() {
+        emuenv.renderer->base_path = emuenv.base_path.c_str();
+        emuenv.renderer->title_id = emuenv.io.title_id.c_str();
+        emuenv.renderer->self_name = emuenv.self_name.c_str();
+    };
+
+    // With fast boot, the shaders cache hashs are read while the modules are loaded, the name of the self is known before it is loaded
+    util::BootStages stages(emuenv.cfg.fast_boot);
+    bool has_shaders_cache_hashs = false;
+    if (stages.is_parallel()) {
+        emuenv.self_name = fs::path(!emuenv.cfg.self_path.empty() ? emuenv.cfg.self_path : EBOOT_PATH).filename().string();
+        set_renderer_app();
+        stages.run("shaders cache hashs", [&emuenv, &has_shaders_cache_hashs]() {
+            has_shaders_cache_hashs = renderer::get_shaders_cache_hashs(*emuenv.renderer);
+        });
+    }
+
     Ptr<const void> entry_point;
-    if (const auto err = load_app(entry_point, emuenv, string_utils::utf_to_wide(emuenv.io.app_path)) != Success)
-        return err;
+    ExitCode load_err = Success;
+    stages.run_here("modules", [&]() {
+        load_err = load_app(entry_point, emuenv, string_utils::utf_to_wide(emuenv.io.app_path));
+    });
+    stages.wait();
+    if (load_err != Success)
+        return load_err;
 
     gui.vita_area.information_bar = false;
 
     // Pre-Compile Shaders
-    emuenv.renderer->base_path = emuenv.base_path.c_str();
-    emuenv.renderer->title_id = emuenv.io.title_id.c_str();
-    emuenv.renderer->self_name = emuenv.self_name.c_str();
-    if (renderer::get_shaders_cache_hashs(*emuenv.renderer) && cfg.shader_cache) {
+    if (!stages.is_parallel()) {
+        set_renderer_app();
+        has_shaders_cache_hashs = renderer::get_shaders_cache_hashs(*emuenv.renderer);
+    }
+    if (cfg.texture_disk_cache)
+        renderer::open_texture_disk_cache(*emuenv.renderer);
+    if (has_shaders_cache_hashs && cfg.shader_cache) {
         SDL_SetWindowTitle(emuenv.window.get(), fmt::format("{} | {} ({}) | Please wait, compiling shaders...", window_title, emuenv.current_app_title, emuenv.io.title_id).c_str());
-        for (const auto &hash : emuenv.renderer->shaders_cache_hashs) {
+        for (const auto &hash : emuenv.renderer->shaders_cache_hashs)
+            emuenv.renderer->precompile_shader(hash);
+
+        bool precompile_done = false;
+        while (!precompile_done) {
             handle_events(emuenv, gui);
             gui::draw_begin(gui, emuenv);
             draw_app_background(gui, emuenv);
 
-            emuenv.renderer->precompile_shader(hash);
+            precompile_done = emuenv.renderer->update_precompiled_shaders();
             gui::draw_pre_compiling_shaders_progress(gui, emuenv, uint32_t(emuenv.renderer->shaders_cache_hashs.size()));
 
             gui::draw_end(gui, emuenv.window.get());
             emuenv.renderer->swap_window(emuenv.window.get());
         }
+        emuenv.renderer->prewarm_pipelines();
     }
 
     if (const auto err = run_app(emuenv, entry_point) != Success)
@@ -386,11 +421,21 @@ int main(int argc, char *argv[]) {
         // Driver acto!
         renderer::process_batches(*emuenv.renderer.get(), emuenv.renderer->features, emuenv.mem, emuenv.cfg);
 
+        bool is_frame_skipped;
         {
             const std::lock_guard<std::mutex> guard(emuenv.display.display_info_mutex);
-            const SceFVector2 viewport_pos = { emuenv.viewport_pos.x, emuenv.viewport_pos.y };
-            const SceFVector2 viewport_size = { emuenv.viewport_size.x, emuenv.viewport_size.y };
-            emuenv.renderer->render_frame(viewport_pos, viewport_size, emuenv.display, emuenv.gxm, emuenv.mem);
+            is_frame_skipped = renderer::is_surface_skipped(*emuenv.renderer, emuenv.display.frame.base.address());
+            if (!is_frame_skipped) {
+                const SceFVector2 viewport_pos = { emuenv.viewport_pos.x, emuenv.viewport_pos.y };
+                const SceFVector2 viewport_size = { emuenv.viewport_size.x, emuenv.viewport_size.y };
+                emuenv.renderer->render_frame(viewport_pos, viewport_size, emuenv.display, emuenv.gxm, emuenv.mem);
+            }
+        }
+
+        // the scenes of this frame were dropped by the frame skip, the previous one stays on the screen
+        if (is_frame_skipped) {
+            emuenv.renderer->should_display = false;
+            continue;
         }
 
         gui::draw_begin(gui, emuenv);
@@ -402,6 +447,11 @@ int main(int argc, char *argv[]) {
         FrameMark; // Tracy - Frame end mark for game loading loop
     }
 
+    // measures the frames from the first one displayed by the app
+    std::unique_ptr<app::Benchmark> benchmark;
+    if (emuenv.cfg.is_benchmark())
+        benchmark = std::make_unique<app::Benchmark>(emuenv);
+
     while (handle_events(emuenv, gui) && !emuenv.load_exec) {
         ZoneScopedN("Game rendering"); // Tracy - Track game rendering loop scope
         // Driver acto!
@@ -422,9 +472,10 @@ int main(int argc, char *argv[]) {
 
         gui::draw_begin(gui, emuenv);
         gui::draw_common_dialog(gui, emuenv);
-        gui::draw_vita_area(gui, emuenv);
+        if (!benchmark)
+            gui::draw_vita_area(gui, emuenv);
 
-        if (emuenv.cfg.performance_overlay && !gui.vita_area.home_screen && !gui.vita_area.live_area_screen && !gui.vita_area.start_screen && gui::get_sys_apps_state(gui))
+        if (!benchmark && emuenv.cfg.performance_overlay && !gui.vita_area.home_screen && !gui.vita_area.live_area_screen && !gui.vita_area.start_screen && gui::get_sys_apps_state(gui))
             gui::draw_perf_overlay(gui, emuenv);
 
         if (emuenv.display.imgui_render) {
@@ -434,8 +485,17 @@ int main(int argc, char *argv[]) {
         gui::draw_end(gui, emuenv.window.get());
         emuenv.renderer->swap_window(emuenv.window.get());
         FrameMark; // Tracy - Frame end mark for game rendering loop
+
+        if (benchmark) {
+            benchmark->frame();
+            if (benchmark->is_done())
+                break;
+        }
     }
 
+    if (benchmark)
+        benchmark->write_report(emuenv.cfg.benchmark_report.value_or(fs::path(emuenv.base_path) / "benchmark.json"));
+
 #ifdef WIN32
     CoUninitialize();
 #endif
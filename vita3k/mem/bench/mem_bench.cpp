@@ -0,0 +1,256 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Times the allocators of the guest memory and the dispatch of the protection faults, so the changes to these
+// structures can be compared before and after. The maps are fragmented before they are timed, like after a game
+// has been running for a while. Returns a non-zero value if an allocation fails.
+
+#include <mem/allocator.h>
+#include <mem/functions.h>
+#include <mem/mempool.h>
+#include <mem/state.h>
+#include <util/align.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+static constexpr int ITERATIONS = 100000;
+
+// bits of the bitmap, a page of the guest memory each
+static constexpr std::size_t BITMAP_SIZE = 1 << 18;
+static constexpr int BITMAP_MAX_RUN = 64;
+
+static constexpr std::uint32_t MEMSPACE_SIZE = MiB(64);
+static constexpr std::uint32_t MEMSPACE_MAX_BLOCK = KiB(16);
+
+static constexpr unsigned THREAD_COUNTS[] = { 1, 2, 4, 8 };
+static constexpr int ALLOCS_PER_THREAD = 2000;
+
+// protection blocks put on the same page before the fault, like textures and surfaces sharing it
+static constexpr int PROTECT_BLOCK_COUNTS[] = { 1, 4, 16 };
+
+// time of one run in nanoseconds, on average
+static double time_ns(const std::function<void()> &run, const int iterations = ITERATIONS) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        run();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// allocates the whole bitmap with runs of random sizes and frees every other one
+static void fragment_bitmap(BitmapAllocator &allocator, std::mt19937 &rng) {
+    std::uniform_int_distribution<int> run_dist(1, BITMAP_MAX_RUN);
+    std::vector<std::pair<int, int>> runs;
+    while (true) {
+        int size = run_dist(rng);
+        const int offset = allocator.allocate_from(0, size);
+        if (offset < 0)
+            break;
+        runs.emplace_back(offset, size);
+    }
+    for (std::size_t i = 0; i < runs.size(); i += 2)
+        allocator.free(runs[i].first, runs[i].second);
+}
+
+static bool bench_bitmap_allocator(std::mt19937 &rng) {
+    bool success = true;
+    for (const bool best_fit : { false, true }) {
+        BitmapAllocator allocator(BITMAP_SIZE);
+        fragment_bitmap(allocator, rng);
+
+        std::uniform_int_distribution<int> size_dist(1, BITMAP_MAX_RUN);
+        const double time = time_ns([&]() {
+            int size = size_dist(rng);
+            const int requested = size;
+            const int offset = allocator.allocate_from(0, size, best_fit);
+            if (offset < 0) {
+                success = false;
+                return;
+            }
+            allocator.free(offset, requested);
+        });
+        std::printf("%-32s %10.1f ns  %zu bits free\n", best_fit ? "bitmap allocate/free best fit" : "bitmap allocate/free first fit",
+            time, allocator.total_free_slot_count());
+    }
+
+    return success;
+}
+
+// one free bit every 8 bits of a bitmap the size of the guest page allocator, then a long free run at its end
+// the allocations are all kept until the end so each one has to look further
+static bool bench_fragmented_map() {
+    constexpr int MAP_SIZE = GiB(4) / KiB(4);
+    constexpr int ALLOC_COUNT = 5000;
+
+    BitmapAllocator allocator(MAP_SIZE);
+    for (int offset = 0; offset < MAP_SIZE - KiB(64); offset += 8)
+        allocator.allocate_at(offset, 7);
+
+    bool success = true;
+    for (const bool best_fit : { false, true }) {
+        for (const int size : { 1, 4 }) {
+            std::vector<int> offsets;
+            offsets.reserve(ALLOC_COUNT);
+            const double time = time_ns([&]() {
+                int alloc_size = size;
+                offsets.push_back(allocator.allocate_from(0, alloc_size, best_fit));
+            },
+                ALLOC_COUNT);
+
+            for (const int offset : offsets) {
+                if (offset < 0) {
+                    success = false;
+                    continue;
+                }
+                allocator.free(offset, size);
+            }
+            std::printf("%-32s %10.1f ns  size %d\n", best_fit ? "fragmented map best fit" : "fragmented map first fit", time, size);
+        }
+    }
+
+    return success;
+}
+
+static bool bench_memspace_allocator(std::mt19937 &rng) {
+    MemspaceBlockAllocator allocator(MEMSPACE_SIZE);
+    std::uniform_int_distribution<std::uint32_t> size_dist(4, MEMSPACE_MAX_BLOCK);
+
+    // fill the memspace then free half of the blocks at random
+    std::vector<std::uint32_t> live;
+    while (true) {
+        const std::uint32_t offset = allocator.alloc(size_dist(rng));
+        if (offset == 0xFFFFFFFF)
+            break;
+        live.push_back(offset);
+    }
+    std::shuffle(live.begin(), live.end(), rng);
+    for (std::size_t i = live.size() / 2; i < live.size(); i++)
+        allocator.free(live[i]);
+    live.resize(live.size() / 2);
+
+    // replace a random live block with a new one
+    bool success = true;
+    const double time = time_ns([&]() {
+        std::uniform_int_distribution<std::size_t> live_dist(0, live.size() - 1);
+        std::uint32_t &block = live[live_dist(rng)];
+        allocator.free(block);
+        block = allocator.alloc(size_dist(rng));
+        if (block == 0xFFFFFFFF)
+            success = false;
+    });
+    std::printf("%-32s %10.1f ns  %zu blocks %u%% fragmented\n", "memspace free/alloc", time, allocator.blocks.size(), allocator.fragmentation());
+
+    return success;
+}
+
+static bool bench_alloc_contention(MemState &mem) {
+    bool success = true;
+    std::printf("\n%-8s %13s %13s\n", "threads", "per alloc", "allocs/ms");
+    for (const unsigned thread_count : THREAD_COUNTS) {
+        std::atomic<bool> failed = false;
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < thread_count; t++) {
+            threads.emplace_back([&, t]() {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> size_dist(KiB(4), KiB(64));
+                std::vector<Address> addresses;
+                addresses.reserve(ALLOCS_PER_THREAD);
+                for (int i = 0; i < ALLOCS_PER_THREAD; i++) {
+                    const Address address = alloc(mem, size_dist(rng), "bench");
+                    if (!address) {
+                        failed = true;
+                        break;
+                    }
+                    addresses.push_back(address);
+                    // keep a few blocks alive so the next allocations search around them
+                    if (addresses.size() > 16) {
+                        free(mem, addresses.front());
+                        addresses.erase(addresses.begin());
+                    }
+                }
+                for (const Address address : addresses)
+                    free(mem, address);
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        const auto end = std::chrono::steady_clock::now();
+
+        const double total_allocs = static_cast<double>(thread_count) * ALLOCS_PER_THREAD;
+        const double elapsed_ns = std::chrono::duration<double, std::nano>(end - start).count();
+        std::printf("%-8u %10.1f ns %13.1f\n", thread_count, elapsed_ns / total_allocs, total_allocs * 1'000'000.0 / elapsed_ns);
+        success &= !failed;
+    }
+
+    return success;
+}
+
+static bool bench_access_violation(MemState &mem) {
+    const Address address = alloc(mem, mem.page_size, "protected");
+    if (!address)
+        return false;
+    uint8_t *const host_address = Ptr<uint8_t>(address).get(mem);
+
+    std::printf("\n%-8s %13s\n", "blocks", "per fault");
+    for (const int block_count : PROTECT_BLOCK_COUNTS) {
+        // the fault is handled as the exception handler would, the protections are put back before each one
+        int released = 0;
+        const double time = time_ns([&]() {
+            for (int i = 0; i < block_count; i++) {
+                add_protect(mem, address + i * 16, 16, MEM_PERM_NONE, [&](Address, bool) {
+                    released++;
+                    return true;
+                });
+            }
+            handle_access_violation(mem, host_address, true);
+        },
+            ITERATIONS / 10);
+        std::printf("%-8d %10.1f ns%s\n", block_count, time, released == block_count * (ITERATIONS / 10) ? "" : "  CALLBACKS MISSED");
+    }
+
+    free(mem, address);
+    return true;
+}
+
+int main() {
+    std::mt19937 rng(42);
+    bool success = true;
+
+    success &= bench_bitmap_allocator(rng);
+    success &= bench_fragmented_map();
+    success &= bench_memspace_allocator(rng);
+
+    MemState mem;
+    if (!init(mem)) {
+        std::fprintf(stderr, "Failed to initialize the guest memory\n");
+        return 1;
+    }
+    success &= bench_alloc_contention(mem);
+    success &= bench_access_violation(mem);
+
+    if (!success)
+        std::fprintf(stderr, "An allocation failed\n");
+    return success ? 0 : 1;
+}
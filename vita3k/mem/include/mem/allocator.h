@@ -23,11 +23,32 @@
 
 struct BitmapAllocator {
     std::vector<std::uint32_t> words;
-    std::size_t max_offset;
+    std::size_t max_offset = 0;
 
 protected:
+    // Free bits summary of a span of the bitmap. Leaves cover 64 bits (two words) each,
+    // and every other node covers the span of its two children.
+    struct SummaryNode {
+        std::uint32_t free_count = 0;
+        std::uint32_t prefix_free = 0; // Free bits at the start of the span
+        std::uint32_t suffix_free = 0; // Free bits at the end of the span
+        std::uint32_t longest_free = 0; // Longest run of free bits in the span
+    };
+
+    struct RunSearch;
+
+    std::vector<SummaryNode> summary;
+    std::size_t leaf_count = 0;
+
     int force_fill(const std::uint32_t offset, const int size, const bool or_mode = false);
 
+    static void combine_summary(SummaryNode &node, const SummaryNode &left, const SummaryNode &right, const std::uint32_t child_length);
+
+    SummaryNode make_leaf(const std::size_t block) const;
+    std::uint64_t node_length(const std::size_t node) const;
+    void update_summary(const std::uint32_t offset, const int size);
+    bool find_free_run(const std::size_t node, const std::uint64_t pos, RunSearch &search) const;
+
 public:
     BitmapAllocator() = default;
     explicit BitmapAllocator(const std::size_t total_bits);
@@ -39,6 +60,12 @@ public:
     void free(const std::uint32_t offset, const int size);
     void reset();
 
+    // Recompute the summary, must be called after modifying words directly
+    void rebuild_summary();
+
     // Count free bits in [offset, offset_end) (exclusive)
     int free_slot_count(const std::uint32_t offset, const std::uint32_t offset_end) const;
+
+    // Count all free bits below max_offset
+    std::size_t total_free_slot_count() const;
 };
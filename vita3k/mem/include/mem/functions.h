@@ -22,8 +22,6 @@
 
 struct MemState;
 
-typedef std::function<bool(uint8_t *addr, bool write)> AccessViolationHandler;
-
 enum {
     MEM_PERM_NONE = 0,
     MEM_PERM_READONLY = 1 << 0,
@@ -37,15 +35,28 @@ Address alloc(MemState &state, size_t size, const char *name, unsigned int align
 void protect_inner(MemState &state, Address addr, size_t size, const std::uint32_t perm);
 void unprotect_inner(MemState &state, Address addr, size_t size);
 bool add_protect(MemState &state, Address addr, const size_t size, const std::uint32_t perm, ProtectCallback callback);
+// Same as add_protect, the block returned can then be removed by the host with remove_protect
+ProtectBlockPtr add_protect_block(MemState &state, Address addr, const size_t size, const std::uint32_t perm, ProtectCallback callback);
+// Drop a block without running its callback, its pages stay protected for the other blocks covering them
+void remove_protect(MemState &state, const ProtectBlockPtr &block);
+// Called by a protection callback to wait once the protection locks are released, before the access is done again.
+// The callback then returns false, the block must be removed by whoever the access waits for.
+void defer_protect_wait(std::function<void()> wait);
 void open_access_parent_protect_segment(MemState &mem, Address addr);
 void close_access_parent_protect_segment(MemState &mem, Address addr);
 bool is_protecting(MemState &state, Address addr, std::uint32_t *perm = nullptr);
 bool is_valid_addr(const MemState &state, Address addr);
 bool is_valid_addr_range(const MemState &state, Address start, Address end);
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept;
+// Run the protection callbacks of the pages of the range the host is about to access, instead of
+// taking a fault for each of them. Only the pages where the access would fault are handled.
+void prepare_host_access(MemState &state, Address addr, size_t size, bool write);
 Block alloc_block(MemState &mem, size_t size, const char *name);
 Address alloc_at(MemState &state, Address address, size_t size, const char *name);
 Address try_alloc_at(MemState &state, Address address, size_t size, const char *name);
 void free(MemState &state, Address address);
 uint32_t mem_available(MemState &state);
 const char *mem_name(Address address, MemState &state);
+void add_page_watch(MemState &state, Address addr, size_t size);
+void remove_page_watch(MemState &state, Address addr, size_t size);
+bool has_page_watches(const MemState &state);
@@ -20,14 +20,24 @@
 #include <mem/ptr.h>
 #include <util/align.h>
 
+#include <map>
+#include <set>
+#include <utility>
+
+// Allocates the ranges of a memspace: the blocks are kept by offset, with the neighbours of a block found from its
+// position, and the free blocks are also kept by size to take the smallest which fits. Alloc and free are O(log n),
+// a freed block is merged with its free neighbours.
 struct MemspaceBlockAllocator {
     struct Block {
         std::uint32_t size;
-        std::uint32_t offset;
         bool free;
     };
 
-    std::vector<Block> blocks; /// All block sorted by size
+    // all the blocks by offset, they cover the whole memspace
+    std::map<std::uint32_t, Block> blocks;
+    // the free blocks by size then offset
+    std::set<std::pair<std::uint32_t, std::uint32_t>> free_blocks;
+    std::uint32_t free_size = 0;
 
     explicit MemspaceBlockAllocator() = default;
     explicit MemspaceBlockAllocator(const std::uint32_t memspace_size) {
@@ -35,59 +45,78 @@ struct MemspaceBlockAllocator {
     }
 
     void init(const std::uint32_t memspace_size) {
-        Block main_block = {};
-        main_block.offset = 0;
-        main_block.size = memspace_size;
-        main_block.free = true;
-
-        blocks.push_back(main_block);
+        blocks.clear();
+        free_blocks.clear();
+        free_size = 0;
+        if (memspace_size == 0)
+            return;
+
+        blocks.emplace(0, Block{ memspace_size, true });
+        free_blocks.emplace(memspace_size, 0);
+        free_size = memspace_size;
     }
 
     std::uint32_t alloc(const std::uint32_t size) {
-        std::uint32_t aligned_size = static_cast<std::uint32_t>(align(size, 4));
-        for (std::size_t i = 0; i < blocks.size(); i++) {
-            if (blocks[i].free && blocks[i].size >= aligned_size) {
-                // Case 1: Equals. Assign it and returns
-                if (blocks[i].size == aligned_size) {
-                    blocks[i].free = false;
-                    return blocks[i].offset;
-                } else {
-                    // Create new block
-                    Block division;
-                    division.offset = blocks[i].offset + aligned_size;
-                    division.size = blocks[i].size - aligned_size;
-                    division.free = true;
-
-                    blocks[i].free = false;
-                    blocks[i].size = aligned_size;
-
-                    const std::uint32_t offset = blocks[i].offset;
-
-                    if (blocks.capacity() == blocks.size()) {
-                        blocks.resize(blocks.size() + 1);
-                    }
-
-                    blocks.insert(blocks.begin() + i + 1, division);
-
-                    return offset;
-                }
-            }
+        const std::uint32_t aligned_size = static_cast<std::uint32_t>(align(size, 4));
+        const auto fit = free_blocks.lower_bound({ aligned_size, 0 });
+        if ((aligned_size == 0) || (fit == free_blocks.end()))
+            return 0xFFFFFFFF;
+
+        const auto [block_size, offset] = *fit;
+        free_blocks.erase(fit);
+        free_size -= aligned_size;
+
+        Block &block = blocks[offset];
+        block.free = false;
+        if (block_size > aligned_size) {
+            // the rest stays free after the allocation
+            block.size = aligned_size;
+            blocks.emplace(offset + aligned_size, Block{ block_size - aligned_size, true });
+            free_blocks.emplace(block_size - aligned_size, offset + aligned_size);
         }
 
-        return 0xFFFFFFFF;
+        return offset;
     }
 
     bool free(const std::uint32_t offset) {
-        auto ite = std::lower_bound(blocks.begin(), blocks.end(), offset, [](const Block &lhs, const std::uint32_t rhs) {
-            return lhs.offset < rhs;
-        });
+        auto block = blocks.find(offset);
+        if ((block == blocks.end()) || block->second.free)
+            return false;
+
+        free_size += block->second.size;
+        block->second.free = true;
 
-        if (ite != blocks.end() && ite->offset == offset) {
-            ite->free = true;
-            return true;
+        // merge with the next block then the previous one
+        const auto next = std::next(block);
+        if ((next != blocks.end()) && next->second.free) {
+            free_blocks.erase({ next->second.size, next->first });
+            block->second.size += next->second.size;
+            blocks.erase(next);
+        }
+        if (block != blocks.begin()) {
+            const auto previous = std::prev(block);
+            if (previous->second.free) {
+                free_blocks.erase({ previous->second.size, previous->first });
+                previous->second.size += block->second.size;
+                blocks.erase(block);
+                block = previous;
+            }
         }
 
-        return false;
+        free_blocks.emplace(block->second.size, block->first);
+        return true;
+    }
+
+    std::uint32_t largest_free_block() const {
+        return free_blocks.empty() ? 0 : free_blocks.rbegin()->first;
+    }
+
+    // part of the free memory which is not in the largest free block, in percent, for debugging
+    std::uint32_t fragmentation() const {
+        if (free_size == 0)
+            return 0;
+
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(free_size - largest_free_block()) * 100) / free_size);
     }
 };
 
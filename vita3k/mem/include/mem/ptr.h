@@ -22,6 +22,8 @@
 #include <mem/functions.h>
 #include <mem/state.h>
 
+#include <type_traits>
+
 template <class T>
 class Ptr {
 public:
@@ -58,14 +60,31 @@ public:
         return Ptr<U>(addr);
     }
 
+    // With VITA3K_CHECKED_PTR, the address is asserted to be allocated
     T *get(const MemState &mem) const {
         if (addr == 0) {
             return nullptr;
         } else {
-            return reinterpret_cast<T *>(&mem.memory[addr]);
+#ifdef VITA3K_CHECKED_PTR
+            assert(is_valid_addr(mem, addr));
+#endif
+            return reinterpret_cast<T *>(mem.memory.get() + addr);
         }
     }
 
+    // Only an add, for the addresses already known to be valid and not null
+    T *get_unchecked(const MemState &mem) const {
+        return reinterpret_cast<T *>(mem.memory.get() + addr);
+    }
+
+    // For the count elements at this address, checked once instead of for each of them with VITA3K_CHECKED_PTR
+    T *get_range(const MemState &mem, size_t count) const {
+#ifdef VITA3K_CHECKED_PTR
+        assert(valid_range(mem, count));
+#endif
+        return get_unchecked(mem);
+    }
+
     template <class U>
     bool atomic_compare_and_swap(MemState &mem, U value, U expected) {
         static_assert(std::is_arithmetic_v<U>);
@@ -78,6 +97,12 @@ public:
         return is_valid_addr(mem, addr);
     }
 
+    // True if the count elements at this address are all allocated, to check the arrays given to a HLE function once
+    bool valid_range(const MemState &mem, size_t count) const {
+        const uint64_t end = static_cast<uint64_t>(addr) + count * sizeof(std::conditional_t<std::is_void_v<T>, uint8_t, T>);
+        return (addr != 0) && (end < (1ULL << 32)) && is_valid_addr_range(mem, addr, static_cast<Address>(end));
+    }
+
     void reset() {
         addr = 0;
     }
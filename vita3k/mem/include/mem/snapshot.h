@@ -0,0 +1,54 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <mem/util.h>
+
+#include <iosfwd>
+
+struct MemState;
+
+// Snapshots of the guest memory, written as a deflate stream of the allocated regions and of their content.
+// A full snapshot has the content of every allocated page. While the dirty tracking is on, the pages are
+// write protected once saved and an incremental snapshot only has the pages written or allocated since
+// the previous snapshot, restoring it requires the previous snapshots of its chain to be restored first.
+// The guest threads must not run while a snapshot is saved or restored.
+enum class SnapshotMode {
+    Full,
+    Incremental,
+};
+
+struct SnapshotStats {
+    uint32_t region_count = 0;
+    // pages whose content is in the snapshot
+    uint32_t page_count = 0;
+    // uncompressed size of the pages content, in bytes
+    uint64_t data_size = 0;
+};
+
+void start_dirty_tracking(MemState &state);
+void stop_dirty_tracking(MemState &state);
+bool is_dirty_tracking(const MemState &state);
+// Called when pages get allocated while the dirty tracking is on, their content is then in the next snapshot
+void mark_dirty_pages(MemState &state, size_t first_page, size_t page_count);
+
+// An incremental snapshot is saved as a full one if the dirty tracking is off
+bool save_snapshot(MemState &state, std::ostream &out, SnapshotMode mode, SnapshotStats *stats = nullptr);
+// The regions of the snapshot must either be allocated the same way or be free, the free ones are allocated
+bool load_snapshot(MemState &state, std::istream &in, SnapshotStats *stats = nullptr);
@@ -21,9 +21,12 @@
 #include <mem/util.h>
 
 #include <array>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <vector>
 
 struct MemPage {
     uint32_t allocated : 4;
@@ -40,44 +43,85 @@ struct ProtectBlockInfo {
     Address addr = 0;
     size_t size = 0;
     ProtectCallback callback;
-
-    bool operator<(const ProtectBlockInfo &other) const {
-        return this->addr < other.addr;
-    }
+    std::uint32_t perm = 0;
+    // Set once the callback accepted the access, the block is then dropped from every page it covers
+    std::atomic<bool> removed = false;
 };
 
-struct ProtectSegmentInfo {
-    Address addr = 0;
-    size_t size = 0;
-    std::set<ProtectBlockInfo> blocks;
+struct ProtectPageInfo {
+    std::vector<ProtectBlockPtr> blocks;
     std::int32_t ref_count = 0; // When reference count is active, we don't interfere protection.
     std::uint32_t perm = 0;
+};
+
+constexpr size_t PROTECT_CHUNK_PAGE_COUNT = 4096;
+constexpr size_t PROTECT_LOCK_COUNT = 64;
+
+struct ProtectPageChunk {
+    std::array<ProtectPageInfo, PROTECT_CHUNK_PAGE_COUNT> pages;
+};
 
-    ProtectSegmentInfo() = delete;
-    explicit ProtectSegmentInfo(Address addr)
-        : addr(addr) {}
-    explicit ProtectSegmentInfo(Address addr, size_t size, std::uint32_t perm)
-        : addr(addr)
-        , size(size)
-        , perm(perm) {
-    }
-
-    bool operator<(const ProtectSegmentInfo &other) const {
-        return this->addr < other.addr;
-    }
+// Protection info of every guest page. Chunks of pages are only allocated once something
+// gets protected in them, and a page is guarded by the lock at (page index % PROTECT_LOCK_COUNT).
+struct ProtectPageTable {
+    std::vector<std::atomic<ProtectPageChunk *>> chunks;
+    std::mutex chunk_mutex;
+    std::array<std::mutex, PROTECT_LOCK_COUNT> locks;
+
+    ProtectPageTable() = default;
+    ~ProtectPageTable();
+
+    ProtectPageTable(const ProtectPageTable &) = delete;
+    ProtectPageTable &operator=(const ProtectPageTable &) = delete;
+
+    void init(size_t page_count);
+    ProtectPageInfo *get(size_t page) const;
+    ProtectPageInfo &get_or_create(size_t page);
+};
+
+// Small page ranges freed by a thread are kept here, so they can be handed back
+// to the next allocation of the same size without going through the bitmap allocator.
+// Each slot is either 0 or (first page << 32 | page count).
+struct FreeRangeCache {
+    std::array<std::atomic<uint64_t>, 8> ranges{};
 };
 
-typedef std::set<ProtectSegmentInfo> ProtectSegmentTrees;
+constexpr size_t FREE_RANGE_CACHE_COUNT = 16;
+typedef std::array<FreeRangeCache, FREE_RANGE_CACHE_COUNT> FreeRangeCaches;
+
+// Host address of every 4 KiB guest page, laid out the way Dynarmic reads its page table.
+// Unallocated and watched pages are null, so the CPU goes through its memory callbacks for them.
+constexpr size_t HOST_PAGE_BITS = 12;
+constexpr size_t HOST_PAGE_SIZE = 1 << HOST_PAGE_BITS;
+typedef std::array<uint8_t *, (1ULL << (32 - HOST_PAGE_BITS))> HostPageTable;
 
 struct MemState {
     std::mutex generation_mutex;
-    std::mutex protect_mutex;
 
     size_t page_size = 0;
+    // Back the guest memory with transparent huge pages, read by init
+    bool huge_pages = false;
     Memory memory;
     PageTable page_table;
     BitmapAllocator allocator;
-    ProtectSegmentTrees protect_tree;
+    ProtectPageTable protect_table;
+    FreeRangeCaches free_range_caches;
+    std::atomic<int64_t> cached_page_count = 0;
+    // One bit per page held by a free range cache, these pages are still reserved in the bitmap but they are not valid
+    std::unique_ptr<std::atomic<uint64_t>[]> cached_pages;
+    std::unique_ptr<HostPageTable> host_page_table;
+
+    // Number of memory watches on every watched host page
+    std::mutex page_watch_mutex;
+    std::map<uint32_t, uint32_t> page_watches;
+    std::atomic<uint32_t> page_watch_count = 0;
 
     PageNameMap page_name_map;
+
+    // One bit for every page written or allocated since it was last in a snapshot, see mem/snapshot.h
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_pages;
+    std::atomic<bool> dirty_tracking = false;
+    // Snapshots chain and position in it of the last snapshot saved or restored
+    uint64_t snapshot_chain = 0;
+    uint32_t snapshot_sequence = 0;
 };
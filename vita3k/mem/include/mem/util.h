@@ -29,6 +29,9 @@ struct MemState;
 typedef uint32_t Address;
 typedef std::function<bool(Address, bool)> ProtectCallback;
 
+struct ProtectBlockInfo;
+typedef std::shared_ptr<ProtectBlockInfo> ProtectBlockPtr;
+
 // Powers of 10
 constexpr size_t KB(size_t kb) {
     return kb * 1000;
@@ -17,9 +17,53 @@
 
 #include <mem/allocator.h>
 
+#include <algorithm>
+#include <bit>
+
+constexpr std::uint64_t SUMMARY_LEAF_BITS = 64;
+
+struct BitmapAllocator::RunSearch {
+    std::uint64_t start = 0;
+    std::uint64_t size = 0;
+    bool best_fit = false;
+
+    // Length of the free run ending at the current position
+    std::uint64_t run = 0;
+
+    std::int64_t found_offset = -1;
+    std::uint64_t found_length = UINT64_MAX;
+
+    // Returns true when the search is over
+    bool close_run(const std::uint64_t end) {
+        const std::uint64_t length = run;
+        run = 0;
+
+        if (length < size || length >= found_length) {
+            return false;
+        }
+
+        found_offset = static_cast<std::int64_t>(end - length);
+        found_length = length;
+        return !best_fit || (length == size);
+    }
+
+    // Returns true when the search is over
+    bool extend_run(const std::uint64_t end, const std::uint64_t length) {
+        run += length;
+        if (!best_fit && run >= size) {
+            found_offset = static_cast<std::int64_t>(end - run);
+            found_length = run;
+            return true;
+        }
+
+        return false;
+    }
+};
+
 BitmapAllocator::BitmapAllocator(const std::size_t total_bits)
     : words((total_bits >> 5) + ((total_bits % 32 != 0) ? 1 : 0), 0xFFFFFFFF)
     , max_offset(total_bits) {
+    rebuild_summary();
 }
 
 void BitmapAllocator::set_maximum(const std::size_t total_bits) {
@@ -35,10 +79,109 @@ void BitmapAllocator::set_maximum(const std::size_t total_bits) {
     }
 
     max_offset = total_bits;
+    rebuild_summary();
 }
 
 void BitmapAllocator::reset() {
     words.clear();
+    summary.clear();
+    leaf_count = 0;
+}
+
+BitmapAllocator::SummaryNode BitmapAllocator::make_leaf(const std::size_t block) const {
+    const std::size_t first_word = block * 2;
+    if (first_word >= words.size()) {
+        return {};
+    }
+
+    std::uint64_t bits = static_cast<std::uint64_t>(words[first_word]) << 32;
+    if (first_word + 1 < words.size()) {
+        bits |= words[first_word + 1];
+    }
+
+    // Bits past the maximum offset are never free
+    const std::uint64_t block_start = block * SUMMARY_LEAF_BITS;
+    if (block_start + SUMMARY_LEAF_BITS > max_offset) {
+        const std::uint64_t valid_bits = max_offset > block_start ? max_offset - block_start : 0;
+        bits &= valid_bits == 0 ? 0 : (~0ULL << (SUMMARY_LEAF_BITS - valid_bits));
+    }
+
+    SummaryNode leaf;
+    leaf.free_count = std::popcount(bits);
+    leaf.prefix_free = std::countl_one(bits);
+    leaf.suffix_free = std::countr_one(bits);
+
+    std::uint32_t cursor = 0;
+    while (cursor < SUMMARY_LEAF_BITS) {
+        const std::uint64_t remaining = bits << cursor;
+        if (remaining == 0) {
+            break;
+        }
+
+        cursor += std::countl_zero(remaining);
+        const std::uint32_t run = std::countl_one(bits << cursor);
+        leaf.longest_free = std::max(leaf.longest_free, run);
+        cursor += run;
+    }
+
+    return leaf;
+}
+
+std::uint64_t BitmapAllocator::node_length(const std::size_t node) const {
+    const int depth = std::bit_width(node) - 1;
+    return (leaf_count >> depth) * SUMMARY_LEAF_BITS;
+}
+
+void BitmapAllocator::combine_summary(SummaryNode &node, const SummaryNode &left, const SummaryNode &right, const std::uint32_t child_length) {
+    node.free_count = left.free_count + right.free_count;
+    node.prefix_free = (left.prefix_free == child_length) ? child_length + right.prefix_free : left.prefix_free;
+    node.suffix_free = (right.suffix_free == child_length) ? child_length + left.suffix_free : right.suffix_free;
+    node.longest_free = std::max({ left.longest_free, right.longest_free, left.suffix_free + right.prefix_free });
+}
+
+void BitmapAllocator::rebuild_summary() {
+    const std::size_t block_count = (words.size() + 1) / 2;
+    leaf_count = std::bit_ceil(std::max<std::size_t>(block_count, 1));
+    summary.assign(leaf_count * 2, {});
+
+    for (std::size_t i = 0; i < block_count; i++) {
+        summary[leaf_count + i] = make_leaf(i);
+    }
+
+    for (std::size_t i = leaf_count - 1; i >= 1; i--) {
+        combine_summary(summary[i], summary[i * 2], summary[i * 2 + 1], static_cast<std::uint32_t>(node_length(i) / 2));
+    }
+}
+
+void BitmapAllocator::update_summary(const std::uint32_t offset, const int size) {
+    if (summary.empty() || size <= 0) {
+        return;
+    }
+
+    const std::size_t block_count = (words.size() + 1) / 2;
+    const std::size_t first_block = offset / SUMMARY_LEAF_BITS;
+    const std::size_t last_block = std::min<std::size_t>((static_cast<std::uint64_t>(offset) + size - 1) / SUMMARY_LEAF_BITS, block_count - 1);
+    if (first_block > last_block) {
+        return;
+    }
+
+    for (std::size_t i = first_block; i <= last_block; i++) {
+        summary[leaf_count + i] = make_leaf(i);
+    }
+
+    std::size_t first_node = (leaf_count + first_block) / 2;
+    std::size_t last_node = (leaf_count + last_block) / 2;
+    std::uint32_t child_length = SUMMARY_LEAF_BITS;
+
+    while (first_node >= 1) {
+        for (std::size_t i = first_node; i <= last_node; i++) {
+            combine_summary(summary[i], summary[i * 2], summary[i * 2 + 1], child_length);
+        }
+
+        first_node /= 2;
+        last_node /= 2;
+        child_length *= 2;
+    }
 }
 
 int BitmapAllocator::force_fill(const std::uint32_t offset, const int size, const bool or_mode) {
@@ -94,86 +237,106 @@ void BitmapAllocator::free(const std::uint32_t offset, const int size) {
     }
 
     force_fill(offset, size, true);
+    update_summary(offset, size);
 }
 
-int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size, const bool best_fit) {
-    if (words.empty()) {
-        return -1;
+bool BitmapAllocator::find_free_run(const std::size_t node, const std::uint64_t pos, RunSearch &search) const {
+    const std::uint64_t length = node_length(node);
+    if (pos + length <= search.start) {
+        return false;
     }
 
-    std::uint32_t *word = &words[0] + (start_offset >> 5);
-
-    // We have arrived at le word that still have free position (bit 1)
-    std::uint32_t *word_end = &words[words.size() - 1];
-
-    int bflmin = 0xFFFFFF;
-    int bofmin = -1;
-    std::uint32_t *wordmin = nullptr;
-
-    // Keep finding
-    while (word <= word_end) {
-        std::uint32_t wv = *word;
-
-        if (wv != 0) {
-            // Still have free stuff
-            int bflen = 0;
-            int boff = 0;
-            std::uint32_t *bword = nullptr;
-
-            int cursor = 31;
-
-            while (cursor >= 0) {
-                if (((wv >> cursor) & 1) == 1) {
-                    boff = cursor;
-                    bflen = 0;
-                    bword = word;
-
-                    while (cursor >= 0 && (((wv >> cursor) & 1) == 1)) {
-                        bflen++;
-                        cursor--;
-
-                        if (cursor < 0 && (word + 1 <= word_end)) {
-                            cursor = 31;
-                            word++;
-                            wv = *word;
-                        }
-                    }
-
-                    if (bflen >= size) {
-                        if (!best_fit) {
-                            // Force allocate and then return
-                            const int offset = static_cast<int>(31 - boff + ((bword - &words[0]) << 5));
-                            if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-                                size = force_fill(static_cast<const std::uint32_t>(offset), size, false);
-                                return offset;
-                            }
-                        } else {
-                            if (bflen < bflmin) {
-                                bflmin = bflen;
-                                bofmin = boff;
-                                wordmin = bword;
-                            }
-                        }
-                    }
-                }
-
-                cursor--;
-            }
+    const SummaryNode &info = summary[node];
+    const bool has_skipped_part = pos < search.start;
+
+    if (!has_skipped_part && info.longest_free < search.size) {
+        // No run big enough lies inside the span, only the ones crossing its borders matter
+        if (info.prefix_free == length) {
+            return search.extend_run(pos + length, length);
         }
 
-        word++;
+        if (search.extend_run(pos + info.prefix_free, info.prefix_free) || search.close_run(pos + info.prefix_free)) {
+            return true;
+        }
+
+        search.run = info.suffix_free;
+        return false;
     }
 
-    if (best_fit && bofmin != -1) {
-        // Force allocate and then return
-        const int offset = static_cast<int>(31 - bofmin + ((wordmin - &words[0]) << 5));
-        if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-            size = force_fill(static_cast<std::uint32_t>(offset), size, false);
-            return offset;
+    if (node < leaf_count) {
+        return find_free_run(node * 2, pos, search) || find_free_run(node * 2 + 1, pos + length / 2, search);
+    }
+
+    const std::size_t block = node - leaf_count;
+    std::uint64_t bits = 0;
+    if (block * 2 < words.size()) {
+        bits = static_cast<std::uint64_t>(words[block * 2]) << 32;
+        if (block * 2 + 1 < words.size()) {
+            bits |= words[block * 2 + 1];
         }
     }
 
-    return -1;
+    if (pos + SUMMARY_LEAF_BITS > max_offset) {
+        const std::uint64_t valid_bits = max_offset > pos ? max_offset - pos : 0;
+        bits &= valid_bits == 0 ? 0 : (~0ULL << (SUMMARY_LEAF_BITS - valid_bits));
+    }
+
+    if (has_skipped_part) {
+        bits &= ~0ULL >> (search.start - pos);
+    }
+
+    std::uint32_t cursor = 0;
+    while (cursor < SUMMARY_LEAF_BITS) {
+        const std::uint32_t run = std::countl_one(bits << cursor);
+        if (run != 0) {
+            cursor += run;
+            if (search.extend_run(pos + cursor, run)) {
+                return true;
+            }
+
+            if (cursor >= SUMMARY_LEAF_BITS) {
+                break;
+            }
+        }
+
+        if (search.close_run(pos + cursor)) {
+            return true;
+        }
+
+        const std::uint64_t remaining = bits << cursor;
+        if (remaining == 0) {
+            break;
+        }
+
+        cursor += std::countl_zero(remaining);
+    }
+
+    return false;
+}
+
+int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size, const bool best_fit) {
+    if (words.empty() || size <= 0) {
+        return -1;
+    }
+
+    RunSearch search;
+    // The search begins at the word holding the start offset
+    search.start = (start_offset >> 5) << 5;
+    search.size = static_cast<std::uint64_t>(size);
+    search.best_fit = best_fit;
+
+    if (!find_free_run(1, 0, search)) {
+        search.close_run(leaf_count * SUMMARY_LEAF_BITS);
+    }
+
+    if (search.found_offset < 0) {
+        return -1;
+    }
+
+    const int offset = static_cast<int>(search.found_offset);
+    size = force_fill(static_cast<std::uint32_t>(offset), size, false);
+    update_summary(static_cast<std::uint32_t>(offset), size);
+    return offset;
 }
 
 int BitmapAllocator::allocate_at(const std::uint32_t start_offset, int size) {
@@ -182,6 +345,7 @@ int BitmapAllocator::allocate_at(const std::uint32_t start_offset, int size) {
     }
 
     force_fill(start_offset, size, false);
+    update_summary(start_offset, size);
     return 0;
 }
 
@@ -191,6 +355,23 @@ static int number_of_set_bits(std::uint32_t i) {
     return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
 }
 
+static std::uint32_t count_free_bits(const std::vector<std::uint32_t> &words, std::uint32_t start_bit, const std::uint32_t end_bit) {
+    std::uint32_t free_count = 0;
+
+    while (start_bit < end_bit) {
+        const std::uint32_t next_end_bit = std::min<std::uint32_t>(((start_bit + 32) >> 5) << 5, end_bit);
+
+        const int left_shift = start_bit & 31;
+        const int right_shift = (31 - (next_end_bit - 1) & 31);
+        std::uint32_t word_to_scan = words[start_bit >> 5] << left_shift >> right_shift >> left_shift;
+        free_count += number_of_set_bits(word_to_scan);
+
+        start_bit = next_end_bit;
+    }
+
+    return free_count;
+}
+
 int BitmapAllocator::free_slot_count(const std::uint32_t offset, const std::uint32_t offset_end) const {
     if (offset >= offset_end) {
         return -1;
@@ -203,21 +384,36 @@ int BitmapAllocator::free_slot_count(const std::uint32_t offset, const std::uint
         return -1;
     }
 
-    std::uint32_t start_bit = offset;
+    const std::uint32_t start_bit = offset;
     const std::uint32_t end_bit = end_off >= words.size() ? max_offset : offset_end;
 
-    std::uint32_t free_count = 0;
+    // Whole leaves in the middle are counted from the summary
+    const std::uint64_t first_block = (static_cast<std::uint64_t>(start_bit) + SUMMARY_LEAF_BITS - 1) / SUMMARY_LEAF_BITS;
+    const std::uint64_t last_block = std::min<std::uint64_t>(end_bit, max_offset) / SUMMARY_LEAF_BITS;
 
-    while (start_bit < end_bit) {
-        const std::uint32_t next_end_bit = std::min<std::uint32_t>(((start_bit + 32) >> 5) << 5, end_bit);
+    if (first_block >= last_block) {
+        return count_free_bits(words, start_bit, end_bit);
+    }
 
-        const int left_shift = start_bit & 31;
-        const int right_shift = (31 - (next_end_bit - 1) & 31);
-        std::uint32_t word_to_scan = words[start_bit >> 5] << left_shift >> right_shift >> left_shift;
-        free_count += number_of_set_bits(word_to_scan);
+    std::uint32_t free_count = count_free_bits(words, start_bit, static_cast<std::uint32_t>(first_block * SUMMARY_LEAF_BITS));
+    free_count += count_free_bits(words, static_cast<std::uint32_t>(last_block * SUMMARY_LEAF_BITS), end_bit);
 
-        start_bit = next_end_bit;
+    std::size_t left = leaf_count + first_block;
+    std::size_t right = leaf_count + last_block;
+    while (left < right) {
+        if (left & 1) {
+            free_count += summary[left++].free_count;
+        }
+        if (right & 1) {
+            free_count += summary[--right].free_count;
+        }
+        left /= 2;
+        right /= 2;
     }
 
     return free_count;
 }
+
+std::size_t BitmapAllocator::total_free_slot_count() const {
+    return summary.empty() ? 0 : summary[1].free_count;
+}
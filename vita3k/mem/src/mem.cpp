@@ -16,15 +16,18 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <mem/functions.h>
+#include <mem/snapshot.h>
 #include <mem/state.h>
 
 #include <util/align.h>
 #include <util/log.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <mutex>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -36,16 +39,34 @@
 #endif
 
 constexpr size_t STANDARD_PAGE_SIZE = 4096;
+constexpr size_t HUGE_PAGE_SIZE = MiB(2);
 constexpr size_t TOTAL_MEM_SIZE = GiB(4);
 constexpr bool LOG_PROTECT = false;
 constexpr bool PAGE_NAME_TRACKING = false;
-
-// TODO: support multiple handlers
-static AccessViolationHandler access_violation_handler;
-static void register_access_violation_handler(AccessViolationHandler handler);
+// Keep small freed ranges in per-thread caches instead of giving them back to the bitmap allocator right away
+constexpr bool PAGE_FREE_CACHE = true;
+constexpr int FREE_RANGE_CACHE_MAX_PAGES = 16;
+
+// Guest memories of the emulator instances living in this process, the fault handler gives an access
+// violation to the one whose memory holds the address. The handler reads them without taking a lock.
+constexpr size_t MAX_MEMORY_INSTANCES = 16;
+struct AccessViolationTarget {
+    std::atomic<uint8_t *> memory = nullptr;
+    std::atomic<MemState *> state = nullptr;
+};
+static std::array<AccessViolationTarget, MAX_MEMORY_INSTANCES> access_violation_targets;
+static std::mutex access_violation_targets_mutex;
+
+static bool register_access_violation_handler(MemState &state);
+static void unregister_access_violation_handler(uint8_t *memory);
+static void install_exception_handler();
 
 static Address alloc_inner(MemState &state, uint32_t start_page, int page_count, const char *name, const bool force);
+static void map_host_pages(MemState &state, Address addr, size_t size, bool mapped);
 static void delete_memory(uint8_t *memory);
+#ifndef WIN32
+static bool init_huge_pages(MemState &state);
+#endif
 static void delete_pagetable(MemPage *page_table);
 
 bool init(MemState &state) {
@@ -73,6 +94,10 @@ bool init(MemState &state) {
             return false;
         }
     }
+
+    // The large pages of Windows must be committed when they are reserved and can't be protected one small page at a time
+    if (state.huge_pages)
+        LOG_WARN("Huge pages are not supported on Windows, the guest memory uses {} KiB pages", state.page_size / 1024);
 #else
     // http://man7.org/linux/man-pages/man2/mmap.2.html
     const int prot = PROT_NONE;
@@ -85,6 +110,9 @@ bool init(MemState &state) {
         LOG_CRITICAL("mmap failed");
         return false;
     }
+
+    if (state.huge_pages && !init_huge_pages(state))
+        LOG_WARN("The guest memory can't be backed by huge pages, it uses {} KiB pages", state.page_size / 1024);
 #endif
 
     const size_t table_length = TOTAL_MEM_SIZE / state.page_size;
@@ -92,11 +120,14 @@ bool init(MemState &state) {
     memset(state.page_table.get(), 0, sizeof(MemPage) * table_length);
 
     state.allocator.set_maximum(table_length);
+    state.cached_pages = std::make_unique<std::atomic<uint64_t>[]>((table_length + 63) / 64);
+    state.protect_table.init(table_length);
+    state.host_page_table = std::make_unique<HostPageTable>();
 
-    const auto handler = [&state](uint8_t *addr, bool write) noexcept {
-        return handle_access_violation(state, addr, write);
-    };
-    register_access_violation_handler(handler);
+    if (!register_access_violation_handler(state)) {
+        LOG_CRITICAL("Too many guest memories in this process, at most {} are supported", MAX_MEMORY_INSTANCES);
+        return false;
+    }
 
     const Address null_address = alloc_inner(state, 0, 1, "null", true);
     assert(null_address == 0);
@@ -107,12 +138,46 @@ bool init(MemState &state) {
 #else
     mprotect(state.memory.get(), state.page_size, PROT_NONE);
 #endif
+    map_host_pages(state, null_address, state.page_size, false);
 
     return true;
 }
 
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+// The pages committed by the guest can then be backed by 2 MiB pages, which saves TLB misses for the JIT accesses
+// A range whose protection changes at a smaller granularity (the protected textures and surfaces) is split back into
+// small pages by the kernel
+static bool init_huge_pages(MemState &state) {
+    uint8_t *memory = state.memory.get();
+    if (reinterpret_cast<uintptr_t>(memory) % HUGE_PAGE_SIZE != 0) {
+        // A huge page can only back an aligned range, reserve more to get one
+        uint8_t *const reserved = static_cast<uint8_t *>(mmap(nullptr, TOTAL_MEM_SIZE + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0));
+        if (reserved == MAP_FAILED)
+            return false;
+
+        uint8_t *const aligned = reinterpret_cast<uint8_t *>(align(reinterpret_cast<uintptr_t>(reserved), HUGE_PAGE_SIZE));
+        if (aligned != reserved)
+            munmap(reserved, aligned - reserved);
+        munmap(aligned + TOTAL_MEM_SIZE, (reserved + HUGE_PAGE_SIZE) - aligned);
+        state.memory = Memory(aligned, delete_memory);
+        memory = aligned;
+    }
+
+    if (madvise(memory, TOTAL_MEM_SIZE, MADV_HUGEPAGE) != 0)
+        return false;
+
+    LOG_INFO("The guest memory is backed by transparent huge pages");
+    return true;
+}
+#elif !defined(WIN32)
+static bool init_huge_pages(MemState &state) {
+    return false;
+}
+#endif
+
 static void delete_memory(uint8_t *memory) {
     if (memory != nullptr) {
+        unregister_access_violation_handler(memory);
 #ifdef WIN32
         const BOOL ret = VirtualFree(memory, 0, MEM_RELEASE);
         assert(ret);
@@ -126,33 +191,132 @@ static void delete_pagetable(MemPage *page_table) {
     delete[] page_table;
 }
 
+// True if one of the pages of [start_page, end_page) was freed into a free range cache
+static bool has_cached_pages(const MemState &state, uint32_t start_page, uint32_t end_page) {
+    if (state.cached_page_count.load(std::memory_order_relaxed) <= 0) {
+        return false;
+    }
+
+    for (uint32_t page = start_page; page < end_page; page++) {
+        if (state.cached_pages[page / 64].load(std::memory_order_acquire) & (1ULL << (page % 64))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void mark_cached_pages(MemState &state, uint32_t page_num, uint32_t page_count, bool cached) {
+    for (uint32_t page = page_num; page < page_num + page_count; page++) {
+        const uint64_t bit = 1ULL << (page % 64);
+        if (cached) {
+            state.cached_pages[page / 64].fetch_or(bit, std::memory_order_release);
+        } else {
+            state.cached_pages[page / 64].fetch_and(~bit, std::memory_order_release);
+        }
+    }
+}
+
 bool is_valid_addr(const MemState &state, Address addr) {
     const size_t page_num = addr / state.page_size;
-    return addr && state.allocator.free_slot_count(page_num, page_num + 1) == 0;
+    return addr && state.allocator.free_slot_count(page_num, page_num + 1) == 0 && !has_cached_pages(state, page_num, page_num + 1);
 }
 
 bool is_valid_addr_range(const MemState &state, Address start, Address end) {
     const uint32_t start_page = start / state.page_size;
     const uint32_t end_page = (end + state.page_size - 1) / state.page_size;
-    return state.allocator.free_slot_count(start_page, end_page) == 0;
+    return state.allocator.free_slot_count(start_page, end_page) == 0 && !has_cached_pages(state, start_page, end_page);
 }
 
-static Address alloc_inner(MemState &state, uint32_t start_page, int page_count, const char *name, const bool force) {
-    int page_num;
-    if (force) {
-        if (state.allocator.allocate_at(start_page, page_count) < 0) {
-            LOG_CRITICAL("Failed to allocate at specific page");
+static FreeRangeCache &get_thread_free_range_cache(MemState &state) {
+    static std::atomic<uint32_t> next_cache = 0;
+    thread_local const uint32_t cache_index = next_cache++ % FREE_RANGE_CACHE_COUNT;
+    return state.free_range_caches[cache_index];
+}
+
+static bool cache_free_range(MemState &state, uint32_t page_num, uint32_t page_count) {
+    if (page_count > FREE_RANGE_CACHE_MAX_PAGES) {
+        return false;
+    }
+
+    // the pages are marked before the range is published, so they are never seen valid while another thread can take them
+    mark_cached_pages(state, page_num, page_count, true);
+    state.cached_page_count += page_count;
+
+    FreeRangeCache &cache = get_thread_free_range_cache(state);
+    const uint64_t range = (static_cast<uint64_t>(page_num) << 32) | page_count;
+    for (auto &slot : cache.ranges) {
+        uint64_t expected = 0;
+        if (slot.compare_exchange_strong(expected, range, std::memory_order_release, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+
+    state.cached_page_count -= page_count;
+    mark_cached_pages(state, page_num, page_count, false);
+    return false;
+}
+
+static int take_cached_range(MemState &state, uint32_t page_count) {
+    if (page_count > FREE_RANGE_CACHE_MAX_PAGES) {
+        return -1;
+    }
+
+    FreeRangeCache &cache = get_thread_free_range_cache(state);
+    for (auto &slot : cache.ranges) {
+        uint64_t range = slot.load(std::memory_order_relaxed);
+        if ((range != 0) && (static_cast<uint32_t>(range) == page_count) && slot.compare_exchange_strong(range, 0, std::memory_order_acquire, std::memory_order_relaxed)) {
+            const uint32_t page_num = static_cast<uint32_t>(range >> 32);
+            mark_cached_pages(state, page_num, page_count, false);
+            state.cached_page_count -= page_count;
+            return static_cast<int>(page_num);
+        }
+    }
+
+    return -1;
+}
+
+// Give every cached range back to the bitmap allocator, generation_mutex must be held
+static bool flush_free_range_caches(MemState &state) {
+    bool flushed = false;
+    for (auto &cache : state.free_range_caches) {
+        for (auto &slot : cache.ranges) {
+            const uint64_t range = slot.exchange(0, std::memory_order_acquire);
+            if (range != 0) {
+                const uint32_t page_num = static_cast<uint32_t>(range >> 32);
+                const uint32_t page_count = static_cast<uint32_t>(range);
+                state.allocator.free(page_num, page_count);
+                mark_cached_pages(state, page_num, page_count, false);
+                state.cached_page_count -= page_count;
+                flushed = true;
+            }
         }
-        page_num = start_page;
-    } else {
-        page_num = state.allocator.allocate_from(start_page, page_count, false);
-        if (page_num < 0)
-            return 0;
     }
 
+    return flushed;
+}
+
+// Point the host page table entries of [addr, addr + size) to guest memory, or clear them
+static void map_host_pages(MemState &state, Address addr, size_t size, bool mapped) {
+    HostPageTable &table = *state.host_page_table;
+    const uint64_t first_page = addr >> HOST_PAGE_BITS;
+    const uint64_t end_page = (static_cast<uint64_t>(addr) + size + HOST_PAGE_SIZE - 1) >> HOST_PAGE_BITS;
+    if (!mapped || (state.page_watch_count == 0)) {
+        for (uint64_t page = first_page; page < end_page; page++) {
+            table[page] = mapped ? &state.memory[page << HOST_PAGE_BITS] : nullptr;
+        }
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(state.page_watch_mutex);
+    for (uint64_t page = first_page; page < end_page; page++) {
+        table[page] = state.page_watches.contains(page) ? nullptr : &state.memory[page << HOST_PAGE_BITS];
+    }
+}
+
+static void commit_pages(MemState &state, uint32_t page_num, int page_count, const char *name) {
     const int size = page_count * state.page_size;
-    const Address addr = page_num * state.page_size;
-    uint8_t *const memory = &state.memory[addr];
+    uint8_t *const memory = &state.memory[page_num * state.page_size];
 
     // Make memory chunck available to access
 #ifdef WIN32
@@ -162,17 +326,42 @@ static Address alloc_inner(MemState &state, uint32_t start_page, int page_count,
     mprotect(memory, size, PROT_READ | PROT_WRITE);
 #endif
     std::memset(memory, 0, size);
+    map_host_pages(state, page_num * state.page_size, size, true);
 
     MemPage &page = state.page_table[page_num];
     assert(!page.allocated);
     page.allocated = 1;
     page.size = page_count;
 
+    if (state.dirty_tracking.load(std::memory_order_acquire)) {
+        mark_dirty_pages(state, page_num, page_count);
+    }
+
     if (PAGE_NAME_TRACKING) {
         state.page_name_map.emplace(page_num, name);
     }
+}
 
-    return addr;
+static Address alloc_inner(MemState &state, uint32_t start_page, int page_count, const char *name, const bool force) {
+    int page_num;
+    if (force) {
+        if (state.allocator.allocate_at(start_page, page_count) < 0) {
+            // The wanted range may only be held by a free range cache
+            if (!flush_free_range_caches(state) || (state.allocator.allocate_at(start_page, page_count) < 0)) {
+                LOG_CRITICAL("Failed to allocate at specific page");
+            }
+        }
+        page_num = start_page;
+    } else {
+        page_num = state.allocator.allocate_from(start_page, page_count, false);
+        if ((page_num < 0) && flush_free_range_caches(state))
+            page_num = state.allocator.allocate_from(start_page, page_count, false);
+        if (page_num < 0)
+            return 0;
+    }
+
+    commit_pages(state, page_num, page_count, name);
+    return page_num * state.page_size;
 }
 
 Address alloc(MemState &state, size_t size, const char *name, unsigned int alignment) {
@@ -191,6 +380,7 @@ Address alloc(MemState &state, size_t size, const char *name, unsigned int align
         MemPage &align_page = state.page_table[align_page_num];
         const size_t remnant_front = align_page_num - page_num;
         state.allocator.free(page_num, remnant_front);
+        map_host_pages(state, addr, remnant_front * state.page_size, false);
         page.allocated = 0;
         align_page.allocated = 1;
         align_page.size = page.size - remnant_front;
@@ -199,22 +389,6 @@ Address alloc(MemState &state, size_t size, const char *name, unsigned int align
     return align_addr;
 }
 
-static void align_to_page(MemState &state, ProtectSegmentInfo &protect) {
-    const Address end = align(protect.addr + protect.size, state.page_size);
-    const Address addr = align_down(protect.addr, state.page_size);
-    const size_t size = end - addr;
-    protect.addr = addr;
-    protect.size = size;
-}
-
-static bool overlap_in_page(MemState &state, const ProtectSegmentInfo &a, const ProtectSegmentInfo &b) {
-    const Address a_start = align_down(a.addr, state.page_size);
-    const Address a_end = align(a.addr + a.size, state.page_size);
-    const Address b_start = align_down(b.addr, state.page_size);
-    const Address b_end = align(b.addr + b.size, state.page_size);
-    return a_start <= b_end && b_start <= a_end;
-}
-
 void unprotect_inner(MemState &state, Address addr, size_t size) {
     if (LOG_PROTECT) {
         fmt::print("Unprotect: {} {}\n", log_hex(addr), size);
@@ -239,11 +413,131 @@ void protect_inner(MemState &state, Address addr, size_t size, const std::uint32
 #endif
 }
 
-static ProtectSegmentTrees::iterator find_protect_segment(ProtectSegmentTrees &tree, Address addr) {
-    if (tree.empty()) {
-        return tree.end();
+ProtectPageTable::~ProtectPageTable() {
+    for (auto &chunk : chunks) {
+        delete chunk.load();
     }
-    return --tree.upper_bound(ProtectSegmentInfo(addr));
+}
+
+void ProtectPageTable::init(size_t page_count) {
+    chunks = std::vector<std::atomic<ProtectPageChunk *>>((page_count + PROTECT_CHUNK_PAGE_COUNT - 1) / PROTECT_CHUNK_PAGE_COUNT);
+}
+
+ProtectPageInfo *ProtectPageTable::get(size_t page) const {
+    ProtectPageChunk *chunk = chunks[page / PROTECT_CHUNK_PAGE_COUNT].load(std::memory_order_acquire);
+    return chunk ? &chunk->pages[page % PROTECT_CHUNK_PAGE_COUNT] : nullptr;
+}
+
+ProtectPageInfo &ProtectPageTable::get_or_create(size_t page) {
+    std::atomic<ProtectPageChunk *> &chunk = chunks[page / PROTECT_CHUNK_PAGE_COUNT];
+    if (!chunk.load(std::memory_order_acquire)) {
+        const std::lock_guard<std::mutex> lock(chunk_mutex);
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new ProtectPageChunk(), std::memory_order_release);
+        }
+    }
+
+    return chunk.load(std::memory_order_relaxed)->pages[page % PROTECT_CHUNK_PAGE_COUNT];
+}
+
+// Locks every page lock needed by a page range, always in the same order
+class ProtectRangeLock {
+    ProtectPageTable &table;
+    uint64_t mask = 0;
+
+public:
+    ProtectRangeLock(ProtectPageTable &table, size_t first_page, size_t last_page)
+        : table(table) {
+        if (last_page - first_page + 1 >= PROTECT_LOCK_COUNT) {
+            mask = ~0ULL;
+        } else {
+            for (size_t page = first_page; page <= last_page; page++) {
+                mask |= 1ULL << (page % PROTECT_LOCK_COUNT);
+            }
+        }
+
+        for (size_t i = 0; i < PROTECT_LOCK_COUNT; i++) {
+            if (mask & (1ULL << i)) {
+                table.locks[i].lock();
+            }
+        }
+    }
+
+    ~ProtectRangeLock() {
+        for (size_t i = 0; i < PROTECT_LOCK_COUNT; i++) {
+            if (mask & (1ULL << i)) {
+                table.locks[i].unlock();
+            }
+        }
+    }
+
+    ProtectRangeLock(const ProtectRangeLock &) = delete;
+    ProtectRangeLock &operator=(const ProtectRangeLock &) = delete;
+};
+
+static bool has_live_block(ProtectPageInfo &info) {
+    std::erase_if(info.blocks, [](const ProtectBlockPtr &block) { return block->removed.load(std::memory_order_relaxed); });
+    return !info.blocks.empty();
+}
+
+// Calls the action on every run of consecutive pages of [first_page, last_page] matching the predicate
+template <typename Predicate, typename Action>
+static void for_each_page_run(size_t first_page, size_t last_page, Predicate predicate, Action action) {
+    size_t run_start = 0;
+    bool in_run = false;
+    for (size_t page = first_page; page <= last_page; page++) {
+        if (predicate(page)) {
+            if (!in_run) {
+                run_start = page;
+                in_run = true;
+            }
+        } else if (in_run) {
+            action(run_start, page - run_start);
+            in_run = false;
+        }
+    }
+
+    if (in_run) {
+        action(run_start, last_page + 1 - run_start);
+    }
+}
+
+// Unprotect the pages of a removed block which are not covered by any other block
+static void release_block_pages(MemState &state, const ProtectBlockInfo &block, size_t skipped_page) {
+    const size_t first_page = block.addr / state.page_size;
+    const size_t last_page = (block.addr + std::max<size_t>(block.size, 1) - 1) / state.page_size;
+
+    const ProtectRangeLock lock(state.protect_table, first_page, last_page);
+    const auto can_unprotect = [&](size_t page) {
+        ProtectPageInfo *info = state.protect_table.get(page);
+        return (page != skipped_page) && info && !has_live_block(*info) && (info->ref_count == 0);
+    };
+    for_each_page_run(first_page, last_page, can_unprotect, [&](size_t page, size_t count) {
+        unprotect_inner(state, page * state.page_size, count * state.page_size);
+    });
+}
+
+// Protect again the pages of [first_page, last_page] which still have blocks
+static void reprotect_pages(MemState &state, size_t first_page, size_t last_page) {
+    const ProtectRangeLock lock(state.protect_table, first_page, last_page);
+    for (std::uint32_t perm : { MEM_PERM_NONE, MEM_PERM_READONLY, MEM_PERM_READWRITE }) {
+        const auto must_protect = [&](size_t page) {
+            ProtectPageInfo *info = state.protect_table.get(page);
+            return info && (info->perm == perm) && (info->ref_count == 0) && has_live_block(*info);
+        };
+        for_each_page_run(first_page, last_page, must_protect, [&](size_t page, size_t count) {
+            protect_inner(state, page * state.page_size, count * state.page_size, perm);
+        });
+    }
+}
+
+static void access_protected_page(MemState &state, Address vaddr, bool write, bool only_faulting);
+
+// Waits requested by the protection callbacks run by this thread, done once the protection locks are released
+static thread_local std::vector<std::function<void()>> deferred_protect_waits;
+
+void defer_protect_wait(std::function<void()> wait) {
+    deferred_protect_waits.push_back(std::move(wait));
 }
 
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept {
@@ -260,99 +554,147 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
         fmt::print("Access: {}\n", log_hex(vaddr));
     }
 
-    const std::unique_lock<std::mutex> lock(state.protect_mutex);
-    const auto it = find_protect_segment(state.protect_tree, vaddr);
-    if (it == state.protect_tree.end()) {
-        // HACK: keep going
-        unprotect_inner(state, vaddr, 4);
-        LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
-        return true;
-    }
+    access_protected_page(state, vaddr, write, false);
+    return true;
+}
 
-    if (vaddr < it->addr || vaddr >= it->addr + it->size) {
-        // HACK: keep going
-        unprotect_inner(state, vaddr, 4);
-        LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
-        return true;
-    }
+// Run the callbacks of the blocks protecting the page of vaddr, as a fault at vaddr would.
+// With only_faulting, the page is left alone if the access would not have faulted.
+static void access_protected_page(MemState &state, Address vaddr, bool write, bool only_faulting) {
+    const size_t page = vaddr / state.page_size;
+    std::vector<ProtectBlockPtr> removed_blocks;
+    {
+        const std::lock_guard<std::mutex> lock(state.protect_table.locks[page % PROTECT_LOCK_COUNT]);
+        ProtectPageInfo *info = state.protect_table.get(page);
+        if (only_faulting) {
+            if (!info || (info->ref_count > 0) || !has_live_block(*info)) {
+                return;
+            }
+            if (!write && (info->perm & MEM_PERM_READONLY)) {
+                return;
+            }
+        }
+        if (!info || info->blocks.empty()) {
+            // HACK: keep going
+            unprotect_inner(state, vaddr, 4);
+            LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
+            return;
+        }
+
+        std::erase_if(info->blocks, [&](const ProtectBlockPtr &block) {
+            if (block->removed.load(std::memory_order_relaxed)) {
+                return true;
+            }
 
-    Address previous_beg = it->addr;
+            if (block->callback(vaddr, write)) {
+                // Another page of the block may be faulting at the same time, only one of them releases it
+                if (!block->removed.exchange(true)) {
+                    removed_blocks.push_back(block);
+                }
+                return true;
+            }
 
-    for (auto ite = it->blocks.begin(); ite != it->blocks.end();) {
-        if (ite->callback(vaddr, write)) {
-            Address beg_unpr = align_down(ite->addr, state.page_size);
-            Address end_unpr = align(ite->addr + ite->size, state.page_size);
-            unprotect_inner(state, beg_unpr, end_unpr - beg_unpr);
+            return false;
+        });
 
-            ite = const_cast<std::set<ProtectBlockInfo> &>(it->blocks).erase(ite);
-        } else {
-            ite++;
+        if (info->blocks.empty() && (info->ref_count == 0)) {
+            unprotect_inner(state, page * state.page_size, state.page_size);
         }
     }
 
-    if ((it->blocks.size() == 0) && (it->ref_count == 0)) {
-        unprotect_inner(state, it->addr, it->size);
-        state.protect_tree.erase(it);
-    } else {
-        Address beg_region = it->blocks.begin()->addr;
-        Address end_region = it->blocks.rbegin()->addr + it->blocks.rbegin()->size;
-
-        beg_region = align_down(beg_region, state.page_size);
-        end_region = align(end_region, state.page_size);
-
-        if (beg_region != previous_beg) {
-            ProtectSegmentInfo info = std::move(*it);
-            info.addr = beg_region;
-            info.size = end_region - beg_region;
+    for (const ProtectBlockPtr &block : removed_blocks) {
+        release_block_pages(state, *block, page);
+    }
 
-            state.protect_tree.erase(it);
-            state.protect_tree.emplace(std::move(info));
-        } else {
-            const_cast<std::size_t &>(it->size) = end_region - beg_region;
+    if (!deferred_protect_waits.empty()) {
+        const std::vector<std::function<void()>> waits = std::move(deferred_protect_waits);
+        deferred_protect_waits.clear();
+        for (const std::function<void()> &wait : waits) {
+            wait();
         }
     }
+}
 
-    return true;
+void prepare_host_access(MemState &state, Address addr, size_t size, bool write) {
+    if (size == 0) {
+        return;
+    }
+
+    const size_t first_page = addr / state.page_size;
+    const size_t last_page = (static_cast<size_t>(addr) + size - 1) / state.page_size;
+    for (size_t page = first_page; page <= last_page; page++) {
+        const Address page_addr = std::max<Address>(addr, page * state.page_size);
+        access_protected_page(state, page_addr, write, true);
+    }
 }
 
 bool add_protect(MemState &state, Address addr, const size_t size, const std::uint32_t perm, ProtectCallback callback) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    ProtectSegmentInfo protect(addr, size, perm);
-    align_to_page(state, protect);
+    return add_protect_block(state, addr, size, perm, std::move(callback)) != nullptr;
+}
 
-    ProtectBlockInfo block;
-    block.addr = addr;
-    block.size = size;
-    block.callback = callback;
+ProtectBlockPtr add_protect_block(MemState &state, Address addr, const size_t size, const std::uint32_t perm, ProtectCallback callback) {
+    const ProtectBlockPtr block = std::make_shared<ProtectBlockInfo>();
+    block->addr = addr;
+    block->size = size;
+    block->callback = std::move(callback);
+    block->perm = perm;
+
+    const size_t first_page = addr / state.page_size;
+    const size_t last_page = (addr + std::max<size_t>(size, 1) - 1) / state.page_size;
+
+    const ProtectRangeLock lock(state.protect_table, first_page, last_page);
+    for (size_t page = first_page; page <= last_page; page++) {
+        ProtectPageInfo &info = state.protect_table.get_or_create(page);
+        has_live_block(info);
+        info.blocks.push_back(block);
+        info.perm = perm;
+    }
 
-    protect.blocks.emplace(block);
+    const auto is_closed = [&](size_t page) {
+        return state.protect_table.get(page)->ref_count == 0;
+    };
+    for_each_page_run(first_page, last_page, is_closed, [&](size_t page, size_t count) {
+        protect_inner(state, page * state.page_size, count * state.page_size, perm);
+    });
 
-    auto it = find_protect_segment(state.protect_tree, protect.addr);
-    while (it != state.protect_tree.end() && overlap_in_page(state, *it, protect)) {
-        const Address start = std::min(it->addr, protect.addr);
-        protect.size = std::max(it->addr + it->size, protect.addr + protect.size) - start;
-        protect.addr = start;
-        protect.ref_count = it->ref_count; // Transfer access count to new block
-        protect.blocks.insert(it->blocks.begin(), it->blocks.end());
+    return block;
+}
 
-        state.protect_tree.erase(it++);
+void remove_protect(MemState &state, const ProtectBlockPtr &block) {
+    if (!block || block->removed.exchange(true)) {
+        return;
     }
 
-    if (protect.ref_count == 0) {
-        protect_inner(state, protect.addr, protect.size, perm);
+    const size_t first_page = block->addr / state.page_size;
+    const size_t last_page = (block->addr + std::max<size_t>(block->size, 1) - 1) / state.page_size;
+    {
+        // The pages left with other blocks get the most restrictive permission of these blocks
+        const ProtectRangeLock lock(state.protect_table, first_page, last_page);
+        for (size_t page = first_page; page <= last_page; page++) {
+            ProtectPageInfo *info = state.protect_table.get(page);
+            if (!info || !has_live_block(*info)) {
+                continue;
+            }
+
+            info->perm = MEM_PERM_READWRITE;
+            for (const ProtectBlockPtr &other : info->blocks) {
+                info->perm &= other->perm;
+            }
+        }
     }
 
-    state.protect_tree.emplace(protect);
-    return true;
+    release_block_pages(state, *block, SIZE_MAX);
+    reprotect_pages(state, first_page, last_page);
 }
 
 bool is_protecting(MemState &state, Address addr, std::uint32_t *perm) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = find_protect_segment(state.protect_tree, addr);
+    const size_t page = addr / state.page_size;
+    const std::lock_guard<std::mutex> lock(state.protect_table.locks[page % PROTECT_LOCK_COUNT]);
+    ProtectPageInfo *info = state.protect_table.get(page);
 
-    if ((ite != state.protect_tree.end()) && (addr >= ite->addr) && (addr < ite->addr + ite->size)) {
+    if (info && has_live_block(*info)) {
         if (perm) {
-            *perm = ite->perm;
+            *perm = info->perm;
         }
 
         return true;
@@ -362,41 +704,53 @@ bool is_protecting(MemState &state, Address addr, std::uint32_t *perm) {
 }
 
 void open_access_parent_protect_segment(MemState &state, Address addr) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = find_protect_segment(state.protect_tree, addr);
-
-    if ((ite != state.protect_tree.end()) && (addr >= ite->addr) && (addr < ite->addr + ite->size)) {
-        const_cast<std::int32_t &>(ite->ref_count)++;
-    } else {
-        ProtectSegmentInfo protect(align_down(addr, state.page_size), 0, 0);
-        protect.ref_count = 1;
-
-        state.protect_tree.emplace(protect);
-    }
+    const size_t page = addr / state.page_size;
+    const std::lock_guard<std::mutex> lock(state.protect_table.locks[page % PROTECT_LOCK_COUNT]);
+    state.protect_table.get_or_create(page).ref_count++;
 }
 
 void close_access_parent_protect_segment(MemState &state, Address addr) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = find_protect_segment(state.protect_tree, addr);
+    const size_t page = addr / state.page_size;
+    Address protect_begin = 0;
+    Address protect_end = 0;
+    {
+        const std::lock_guard<std::mutex> lock(state.protect_table.locks[page % PROTECT_LOCK_COUNT]);
+        ProtectPageInfo *info = state.protect_table.get(page);
+        if (!info) {
+            return;
+        }
 
-    if (ite != state.protect_tree.end()) {
-        if (ite->ref_count > 0) {
-            const_cast<std::int32_t &>(ite->ref_count)--;
+        if (info->ref_count > 0) {
+            info->ref_count--;
         }
 
-        if (ite->ref_count == 0) {
-            if ((ite->blocks.size() == 0) || (ite->size == 0)) {
-                state.protect_tree.erase(ite);
-            } else {
-                protect_inner(state, ite->addr, ite->size, ite->perm);
-            }
+        if ((info->ref_count != 0) || !has_live_block(*info)) {
+            return;
+        }
+
+        // Protect again everything covered by the blocks of this page
+        protect_begin = info->blocks.front()->addr;
+        protect_end = protect_begin;
+        for (const ProtectBlockPtr &block : info->blocks) {
+            protect_begin = std::min(protect_begin, block->addr);
+            protect_end = std::max<Address>(protect_end, block->addr + std::max<size_t>(block->size, 1));
         }
     }
+
+    reprotect_pages(state, protect_begin / state.page_size, (protect_end - 1) / state.page_size);
 }
 
 Address alloc(MemState &state, size_t size, const char *name) {
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
     const size_t page_count = align(size, state.page_size) / state.page_size;
+    if (PAGE_FREE_CACHE && !PAGE_NAME_TRACKING) {
+        const int page_num = take_cached_range(state, page_count);
+        if (page_num > 0) {
+            commit_pages(state, page_num, page_count, name);
+            return page_num * state.page_size;
+        }
+    }
+
+    const std::lock_guard<std::mutex> lock(state.generation_mutex);
     const Address addr = alloc_inner(state, 0, page_count, name, false);
     return addr;
 }
@@ -415,7 +769,11 @@ Address try_alloc_at(MemState &state, Address address, size_t size, const char *
     size += address % state.page_size;
     const size_t page_count = align(size, state.page_size) / state.page_size;
     if (state.allocator.free_slot_count(wanted_page, wanted_page + page_count) != page_count) {
-        return 0;
+        // The range may only be held by a free range cache
+        const std::lock_guard<std::mutex> lock(state.generation_mutex);
+        if (!flush_free_range_caches(state) || (state.allocator.free_slot_count(wanted_page, wanted_page + page_count) != page_count)) {
+            return 0;
+        }
     }
     (void)alloc_inner(state, wanted_page, page_count, name, true);
     return address;
@@ -429,7 +787,6 @@ Block alloc_block(MemState &mem, size_t size, const char *name) {
 }
 
 void free(MemState &state, Address address) {
-    const std::lock_guard<std::mutex> lock(state.generation_mutex);
     const size_t page_num = address / state.page_size;
     assert(page_num >= 0);
 
@@ -438,24 +795,33 @@ void free(MemState &state, Address address) {
         LOG_CRITICAL("Freeing unallocated page");
     }
     page.allocated = 0;
+    const uint32_t page_count = page.size;
 
-    state.allocator.free(page_num, page.size);
-    if (PAGE_NAME_TRACKING) {
-        state.page_name_map.erase(page_num);
-    }
-
+    // The pages must be decommitted before they can be handed to someone else
     uint8_t *const memory = &state.memory[page_num * state.page_size];
+    map_host_pages(state, page_num * state.page_size, page_count * state.page_size, false);
 
 #ifdef WIN32
-    const BOOL ret = VirtualFree(memory, page.size * state.page_size, MEM_DECOMMIT);
+    const BOOL ret = VirtualFree(memory, page_count * state.page_size, MEM_DECOMMIT);
     assert(ret);
 #else
-    mprotect(memory, page.size * state.page_size, PROT_NONE);
+    mprotect(memory, page_count * state.page_size, PROT_NONE);
 #endif
+
+    if (PAGE_FREE_CACHE && !PAGE_NAME_TRACKING && cache_free_range(state, page_num, page_count)) {
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    state.allocator.free(page_num, page_count);
+    if (PAGE_NAME_TRACKING) {
+        state.page_name_map.erase(page_num);
+    }
 }
 
 uint32_t mem_available(MemState &state) {
-    return state.allocator.free_slot_count(0, state.allocator.max_offset) * state.page_size;
+    const int64_t cached_page_count = std::max<int64_t>(state.cached_page_count, 0);
+    return (state.allocator.total_free_slot_count() + cached_page_count) * state.page_size;
 }
 
 const char *mem_name(Address address, MemState &state) {
@@ -465,6 +831,80 @@ const char *mem_name(Address address, MemState &state) {
     return "";
 }
 
+void add_page_watch(MemState &state, Address addr, size_t size) {
+    HostPageTable &table = *state.host_page_table;
+    const uint64_t first_page = addr >> HOST_PAGE_BITS;
+    const uint64_t end_page = (static_cast<uint64_t>(addr) + std::max<size_t>(size, 1) + HOST_PAGE_SIZE - 1) >> HOST_PAGE_BITS;
+
+    const std::lock_guard<std::mutex> lock(state.page_watch_mutex);
+    for (uint64_t page = first_page; page < end_page; page++) {
+        if (state.page_watches[page]++ == 0) {
+            table[page] = nullptr;
+        }
+    }
+    state.page_watch_count = state.page_watches.size();
+}
+
+void remove_page_watch(MemState &state, Address addr, size_t size) {
+    HostPageTable &table = *state.host_page_table;
+    const uint64_t first_page = addr >> HOST_PAGE_BITS;
+    const uint64_t end_page = (static_cast<uint64_t>(addr) + std::max<size_t>(size, 1) + HOST_PAGE_SIZE - 1) >> HOST_PAGE_BITS;
+
+    const std::lock_guard<std::mutex> lock(state.page_watch_mutex);
+    for (uint64_t page = first_page; page < end_page; page++) {
+        const auto watch = state.page_watches.find(page);
+        if ((watch == state.page_watches.end()) || (--watch->second != 0)) {
+            continue;
+        }
+
+        state.page_watches.erase(watch);
+        if (is_valid_addr(state, page << HOST_PAGE_BITS)) {
+            table[page] = &state.memory[page << HOST_PAGE_BITS];
+        }
+    }
+    state.page_watch_count = state.page_watches.size();
+}
+
+bool has_page_watches(const MemState &state) {
+    return state.page_watch_count != 0;
+}
+
+static bool register_access_violation_handler(MemState &state) {
+    static std::once_flag installed;
+    std::call_once(installed, install_exception_handler);
+
+    const std::lock_guard<std::mutex> lock(access_violation_targets_mutex);
+    for (AccessViolationTarget &target : access_violation_targets) {
+        if (target.state.load(std::memory_order_relaxed) == nullptr) {
+            target.state.store(&state, std::memory_order_relaxed);
+            target.memory.store(state.memory.get(), std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void unregister_access_violation_handler(uint8_t *memory) {
+    const std::lock_guard<std::mutex> lock(access_violation_targets_mutex);
+    for (AccessViolationTarget &target : access_violation_targets) {
+        if (target.memory.load(std::memory_order_relaxed) == memory) {
+            target.memory.store(nullptr, std::memory_order_release);
+            target.state.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool dispatch_access_violation(uint8_t *addr, bool write) noexcept {
+    for (AccessViolationTarget &target : access_violation_targets) {
+        uint8_t *const memory = target.memory.load(std::memory_order_acquire);
+        if ((memory != nullptr) && (addr >= memory) && (addr < memory + TOTAL_MEM_SIZE)) {
+            MemState *const state = target.state.load(std::memory_order_relaxed);
+            return (state != nullptr) && handle_access_violation(*state, addr, write);
+        }
+    }
+    return false;
+}
+
 #ifdef WIN32
 
 static LONG WINAPI exception_handler(PEXCEPTION_POINTERS pExp) noexcept {
@@ -476,7 +916,7 @@ static LONG WINAPI exception_handler(PEXCEPTION_POINTERS pExp) noexcept {
     const bool is_executing = pExp->ExceptionRecord->ExceptionInformation[0] == 8;
 
     if (pExp->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && !is_executing) {
-        if (access_violation_handler(ptr, is_writing)) {
+        if (dispatch_access_violation(ptr, is_writing)) {
             return EXCEPTION_CONTINUE_EXECUTION;
         }
     }
@@ -484,8 +924,7 @@ static LONG WINAPI exception_handler(PEXCEPTION_POINTERS pExp) noexcept {
     return EXCEPTION_CONTINUE_SEARCH;
 }
 
-static void register_access_violation_handler(AccessViolationHandler handler) {
-    access_violation_handler = handler;
+static void install_exception_handler() {
     if (!AddVectoredExceptionHandler(1, (PVECTORED_EXCEPTION_HANDLER)exception_handler)) {
         LOG_CRITICAL("Failed to register an exception handler");
     }
@@ -506,7 +945,7 @@ static void signal_handler(int sig, siginfo_t *info, void *uct) noexcept {
     const bool is_writing = err & 0x2;
 
     if (!is_executing) {
-        if (access_violation_handler(reinterpret_cast<uint8_t *>(info->si_addr), is_writing)) {
+        if (dispatch_access_violation(reinterpret_cast<uint8_t *>(info->si_addr), is_writing)) {
             return;
         }
     }
@@ -515,8 +954,7 @@ static void signal_handler(int sig, siginfo_t *info, void *uct) noexcept {
     return;
 }
 
-static void register_access_violation_handler(AccessViolationHandler handler) {
-    access_violation_handler = handler;
+static void install_exception_handler() {
     struct sigaction sa;
     sa.sa_flags = SA_SIGINFO;
     sigemptyset(&sa.sa_mask);
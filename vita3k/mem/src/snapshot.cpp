@@ -0,0 +1,387 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <mem/functions.h>
+#include <mem/snapshot.h>
+#include <mem/state.h>
+
+#include <util/log.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <array>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x4D4B3356; // V3KM
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+// Largest range of pages in a record, and protected with a single block once saved
+constexpr size_t SNAPSHOT_BLOCK_SIZE = KiB(64);
+constexpr uint64_t GUEST_MEM_SIZE = 1ULL << 32;
+
+struct SnapshotHeader {
+    uint32_t magic = SNAPSHOT_MAGIC;
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t page_size = 0;
+    uint32_t mode = 0;
+    uint64_t chain = 0;
+    uint32_t sequence = 0;
+    uint32_t region_count = 0;
+};
+
+// A range of allocated memory, or when in a record of the stream a range of pages followed by its content.
+// The stream of records ends with an empty one.
+struct SnapshotRange {
+    Address addr = 0;
+    uint32_t size = 0;
+};
+
+namespace {
+
+class DeflateWriter {
+    std::ostream &out;
+    mz_stream stream = {};
+    std::array<uint8_t, KiB(64)> buffer;
+    bool ok = false;
+
+    bool flush(int flush_mode) {
+        int ret = MZ_OK;
+        do {
+            stream.next_out = buffer.data();
+            stream.avail_out = buffer.size();
+            ret = mz_deflate(&stream, flush_mode);
+            if ((ret != MZ_OK) && (ret != MZ_STREAM_END) && (ret != MZ_BUF_ERROR)) {
+                LOG_ERROR("Failed to compress the snapshot: {}", ret);
+                return false;
+            }
+            out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() - stream.avail_out);
+        } while ((stream.avail_out == 0) || ((flush_mode == MZ_FINISH) && (ret != MZ_STREAM_END)));
+        return out.good();
+    }
+
+public:
+    explicit DeflateWriter(std::ostream &out)
+        : out(out) {
+        ok = mz_deflateInit(&stream, MZ_BEST_SPEED) == MZ_OK;
+    }
+
+    ~DeflateWriter() {
+        mz_deflateEnd(&stream);
+    }
+
+    bool write(const void *data, size_t size) {
+        stream.next_in = static_cast<const uint8_t *>(data);
+        stream.avail_in = size;
+        ok = ok && flush(MZ_NO_FLUSH);
+        return ok;
+    }
+
+    bool finish() {
+        stream.next_in = nullptr;
+        stream.avail_in = 0;
+        ok = ok && flush(MZ_FINISH);
+        return ok;
+    }
+};
+
+class InflateReader {
+    std::istream &in;
+    mz_stream stream = {};
+    std::array<uint8_t, KiB(64)> buffer;
+    bool ok = false;
+
+public:
+    explicit InflateReader(std::istream &in)
+        : in(in) {
+        ok = mz_inflateInit(&stream) == MZ_OK;
+    }
+
+    ~InflateReader() {
+        mz_inflateEnd(&stream);
+    }
+
+    bool read(void *data, size_t size) {
+        stream.next_out = static_cast<uint8_t *>(data);
+        stream.avail_out = size;
+        while (ok && (stream.avail_out > 0)) {
+            if (stream.avail_in == 0) {
+                in.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+                stream.next_in = buffer.data();
+                stream.avail_in = in.gcount();
+            }
+            const int ret = mz_inflate(&stream, MZ_NO_FLUSH);
+            if ((ret == MZ_STREAM_END) && (stream.avail_out > 0)) {
+                LOG_ERROR("The snapshot is truncated");
+                ok = false;
+            } else if ((ret != MZ_OK) && (ret != MZ_STREAM_END)) {
+                LOG_ERROR("Failed to decompress the snapshot: {}", ret);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+};
+
+} // namespace
+
+static size_t get_page_count(const MemState &state) {
+    return GUEST_MEM_SIZE / state.page_size;
+}
+
+static bool is_dirty(const MemState &state, size_t page) {
+    return state.dirty_pages[page / 64].load(std::memory_order_relaxed) & (1ULL << (page % 64));
+}
+
+static void clear_dirty(MemState &state, size_t page) {
+    state.dirty_pages[page / 64].fetch_and(~(1ULL << (page % 64)), std::memory_order_relaxed);
+}
+
+void mark_dirty_pages(MemState &state, size_t first_page, size_t page_count) {
+    for (size_t page = first_page; page < first_page + page_count; page++) {
+        state.dirty_pages[page / 64].fetch_or(1ULL << (page % 64), std::memory_order_relaxed);
+    }
+}
+
+void start_dirty_tracking(MemState &state) {
+    if (state.dirty_tracking) {
+        return;
+    }
+
+    // Nothing is protected yet, so every page is in the next snapshot
+    const size_t word_count = get_page_count(state) / 64;
+    if (!state.dirty_pages) {
+        state.dirty_pages = std::make_unique<std::atomic<uint64_t>[]>(word_count);
+    }
+    for (size_t i = 0; i < word_count; i++) {
+        state.dirty_pages[i].store(~0ULL, std::memory_order_relaxed);
+    }
+    state.dirty_tracking.store(true, std::memory_order_release);
+}
+
+void stop_dirty_tracking(MemState &state) {
+    // The pages still protected are released on their next write
+    state.dirty_tracking = false;
+    state.snapshot_chain = 0;
+}
+
+bool is_dirty_tracking(const MemState &state) {
+    return state.dirty_tracking;
+}
+
+// Every page of a block is marked dirty when it is written, so the pages still clean are always protected
+static void protect_saved_pages(MemState &state, size_t first_page, size_t page_count) {
+    add_protect(state, first_page * state.page_size, page_count * state.page_size, MEM_PERM_READONLY, [&state, first_page, page_count](Address, bool) {
+        mark_dirty_pages(state, first_page, page_count);
+        return true;
+    });
+}
+
+static std::vector<SnapshotRange> get_allocated_regions(const MemState &state) {
+    std::vector<SnapshotRange> regions;
+    // The first page is the null page, it is never accessible
+    size_t page = 1;
+    const size_t page_count = get_page_count(state);
+    while (page < page_count) {
+        const MemPage &info = state.page_table[page];
+        if (info.allocated) {
+            regions.push_back({ static_cast<Address>(page * state.page_size), static_cast<uint32_t>(info.size * state.page_size) });
+            page += info.size;
+        } else {
+            page++;
+        }
+    }
+    return regions;
+}
+
+// Call action on every run of consecutive pages of [first_page, end_page) for which predicate holds
+template <typename Predicate, typename Action>
+static void for_each_run(size_t first_page, size_t end_page, Predicate predicate, Action action) {
+    size_t page = first_page;
+    while (page < end_page) {
+        if (!predicate(page)) {
+            page++;
+            continue;
+        }
+        const size_t run_begin = page;
+        while ((page < end_page) && predicate(page)) {
+            page++;
+        }
+        action(run_begin, page - run_begin);
+    }
+}
+
+bool save_snapshot(MemState &state, std::ostream &out, SnapshotMode mode, SnapshotStats *stats) {
+    const bool tracking = state.dirty_tracking;
+    if ((mode == SnapshotMode::Incremental) && (!tracking || !state.snapshot_chain)) {
+        mode = SnapshotMode::Full;
+    }
+
+    const std::vector<SnapshotRange> regions = get_allocated_regions(state);
+
+    SnapshotHeader header;
+    header.page_size = state.page_size;
+    header.mode = static_cast<uint32_t>(mode);
+    header.region_count = regions.size();
+    if (mode == SnapshotMode::Full) {
+        std::random_device random;
+        header.chain = (static_cast<uint64_t>(random()) << 32) | random() | 1;
+        header.sequence = 0;
+    } else {
+        header.chain = state.snapshot_chain;
+        header.sequence = state.snapshot_sequence + 1;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    DeflateWriter writer(out);
+    writer.write(regions.data(), regions.size() * sizeof(SnapshotRange));
+
+    SnapshotStats saved;
+    saved.region_count = regions.size();
+    const size_t block_page_count = std::max<size_t>(SNAPSHOT_BLOCK_SIZE / state.page_size, 1);
+    const auto write_pages = [&](size_t first_page, size_t page_count) {
+        const SnapshotRange record = { static_cast<Address>(first_page * state.page_size), static_cast<uint32_t>(page_count * state.page_size) };
+        // Let the other protections of the pages know they are read
+        prepare_host_access(state, record.addr, record.size, false);
+        writer.write(&record, sizeof(record));
+        writer.write(&state.memory[record.addr], record.size);
+        saved.page_count += page_count;
+        saved.data_size += record.size;
+    };
+    const auto is_saved = [&](size_t page) {
+        return (mode == SnapshotMode::Full) || is_dirty(state, page);
+    };
+    const auto can_protect = [&](size_t page) {
+        // A read protection of someone else can't be weakened, these pages stay dirty
+        uint32_t perm = 0;
+        return is_dirty(state, page) && !(is_protecting(state, page * state.page_size, &perm) && (perm == MEM_PERM_NONE));
+    };
+
+    for (const SnapshotRange &region : regions) {
+        const size_t region_begin = region.addr / state.page_size;
+        const size_t region_end = region_begin + region.size / state.page_size;
+        for (size_t block = region_begin; block < region_end;) {
+            const size_t block_end = std::min(region_end, (block / block_page_count + 1) * block_page_count);
+            for_each_run(block, block_end, is_saved, write_pages);
+            if (tracking) {
+                for_each_run(block, block_end, can_protect, [&](size_t first_page, size_t page_count) {
+                    for (size_t page = first_page; page < first_page + page_count; page++) {
+                        clear_dirty(state, page);
+                    }
+                    protect_saved_pages(state, first_page, page_count);
+                });
+            }
+            block = block_end;
+        }
+    }
+
+    const SnapshotRange end_record;
+    writer.write(&end_record, sizeof(end_record));
+    if (!writer.finish()) {
+        LOG_ERROR("Failed to write the memory snapshot");
+        // The pages saved in it are clean already, the next snapshot must have them all
+        state.snapshot_chain = 0;
+        return false;
+    }
+
+    state.snapshot_chain = tracking ? header.chain : 0;
+    state.snapshot_sequence = header.sequence;
+    if (stats) {
+        *stats = saved;
+    }
+    return true;
+}
+
+bool load_snapshot(MemState &state, std::istream &in, SnapshotStats *stats) {
+    SnapshotHeader header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || (header.magic != SNAPSHOT_MAGIC) || (header.version != SNAPSHOT_VERSION)) {
+        LOG_ERROR("Not a memory snapshot, or from another version");
+        return false;
+    }
+    if (header.page_size != state.page_size) {
+        LOG_ERROR("The memory snapshot was saved with pages of {} bytes, they are of {} bytes on this host", header.page_size, state.page_size);
+        return false;
+    }
+    const auto mode = static_cast<SnapshotMode>(header.mode);
+    if ((mode == SnapshotMode::Incremental) && ((header.chain != state.snapshot_chain) || (header.sequence != state.snapshot_sequence + 1))) {
+        LOG_ERROR("The incremental memory snapshot {} doesn't follow the last snapshot restored", header.sequence);
+        return false;
+    }
+
+    InflateReader reader(in);
+    std::vector<SnapshotRange> regions(header.region_count);
+    if (!reader.read(regions.data(), regions.size() * sizeof(SnapshotRange))) {
+        return false;
+    }
+
+    // The regions allocated since the snapshot are left alone, the guest has no pointer to them once restored
+    for (const SnapshotRange &region : regions) {
+        const size_t page = region.addr / state.page_size;
+        if ((region.addr % state.page_size) || (region.size % state.page_size) || ((page + region.size / state.page_size) > get_page_count(state))) {
+            LOG_ERROR("Invalid region in the memory snapshot: {} ({} bytes)", log_hex(region.addr), region.size);
+            return false;
+        }
+        const MemPage &info = state.page_table[page];
+        if (info.allocated && (info.size * state.page_size == region.size)) {
+            continue;
+        }
+        if (!try_alloc_at(state, region.addr, region.size, "snapshot")) {
+            LOG_ERROR("The region {} ({} bytes) of the memory snapshot overlaps the current allocations", log_hex(region.addr), region.size);
+            return false;
+        }
+    }
+
+    SnapshotStats loaded;
+    loaded.region_count = regions.size();
+    while (true) {
+        SnapshotRange record;
+        if (!reader.read(&record, sizeof(record))) {
+            return false;
+        }
+        if (!record.size) {
+            break;
+        }
+        const bool in_region = std::any_of(regions.begin(), regions.end(), [&](const SnapshotRange &region) {
+            return (record.addr >= region.addr) && (static_cast<uint64_t>(record.addr) + record.size <= static_cast<uint64_t>(region.addr) + region.size);
+        });
+        if (!in_region) {
+            LOG_ERROR("The memory snapshot has pages outside of its regions: {} ({} bytes)", log_hex(record.addr), record.size);
+            return false;
+        }
+        // Let the protections know the pages are written, the caches of their content get invalidated
+        prepare_host_access(state, record.addr, record.size, true);
+        if (!reader.read(&state.memory[record.addr], record.size)) {
+            return false;
+        }
+        if (state.dirty_tracking) {
+            mark_dirty_pages(state, record.addr / state.page_size, record.size / state.page_size);
+        }
+        loaded.page_count += record.size / state.page_size;
+        loaded.data_size += record.size;
+    }
+
+    state.snapshot_chain = header.chain;
+    state.snapshot_sequence = header.sequence;
+    if (stats) {
+        *stats = loaded;
+    }
+    return true;
+}
@@ -17,10 +17,13 @@
 
 #include <list>
 #include <mem/allocator.h>
+#include <mem/mempool.h>
 #include <mem/util.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 TEST(bitmap_allocator, one_bit_allocation) {
     BitmapAllocator allocator(KiB(5));
 
@@ -157,6 +160,7 @@ TEST(bitmap_allocator, no_best_fit_only_one_fit) {
 
     // Bitmap:              1000 0101 0001 0001 0101 0001 00[11 1]001
     alloc.words[0] = 0b10000101000100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 26);
@@ -171,6 +175,7 @@ TEST(bitmap_allocator, no_best_fit_multiple_fit) {
 
     // Bitmap 1:            1000 0[111] 1001 0001 0101 0001 0011 1001
     alloc.words[0] = 0b10000111100100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 5);
@@ -185,6 +190,7 @@ TEST(bitmap_allocator, no_best_fit_alloc_across) {
 
     alloc.words[0] = 0b111;
     alloc.words[1] = 0b11100000000000000000000000000000;
+    alloc.rebuild_summary();
 
     int to_alloc = 5;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 29);
@@ -199,6 +205,7 @@ TEST(bitmap_allocator, best_fit_multiple_fit) {
 
     // Bitmap 1:            1000 0111 1001 0001 0101 0001 00[11 1]001
     alloc.words[0] = 0b10000111100100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc, true), 26);
@@ -219,6 +226,7 @@ TEST(bitmap_allocator, count_bit_aligned) {
 
     // Bitmap 3: 12 bits on
     alloc.words[2] = 0x00F00F0F;
+    alloc.rebuild_summary();
 
     ASSERT_EQ(alloc.free_slot_count(0, 32 * 3), 56);
     ASSERT_EQ(alloc.free_slot_count(0, 32 * 3 - 1), 55);
@@ -239,7 +247,133 @@ TEST(bitmap_allocator, count_unaligned) {
     //                          ^ ignored
     // 5 valid bits on
     alloc.words[2] = 0b10101110001111;
+    alloc.rebuild_summary();
 
     // 4 valid bits + 12 bits + 5 valid bits = 21
     ASSERT_EQ(alloc.free_slot_count(22, 92), 21);
 }
+
+static int linear_scan_allocate(const std::vector<bool> &bits, const int start_offset, const int size, const bool best_fit) {
+    int best_offset = -1;
+    int best_length = INT32_MAX;
+
+    int offset = (start_offset >> 5) << 5;
+    while (offset < static_cast<int>(bits.size())) {
+        if (!bits[offset]) {
+            offset++;
+            continue;
+        }
+
+        int length = 0;
+        while (offset + length < static_cast<int>(bits.size()) && bits[offset + length]) {
+            length++;
+        }
+
+        if (length >= size) {
+            if (!best_fit) {
+                return offset;
+            }
+            if (length < best_length) {
+                best_offset = offset;
+                best_length = length;
+            }
+        }
+
+        offset += length;
+    }
+
+    return best_offset;
+}
+
+TEST(bitmap_allocator, fragmented_matches_linear_scan) {
+    srand(time(0));
+    constexpr int MEM_SIZE = KiB(64) + 17;
+
+    BitmapAllocator allocator(MEM_SIZE);
+    std::vector<bool> bits(MEM_SIZE, true);
+
+    // Fragment the map with small holes of random size
+    for (int offset = 0; offset < MEM_SIZE;) {
+        const int size = std::min(rand() % 40 + 1, MEM_SIZE - offset);
+        if (rand() % 3 != 0) {
+            ASSERT_EQ(allocator.allocate_at(offset, size), 0);
+            std::fill_n(bits.begin() + offset, size, false);
+        }
+        offset += size;
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        const int start = rand() % MEM_SIZE;
+        const bool best_fit = rand() % 2;
+        int size = rand() % 64 + 1;
+
+        const int expected = linear_scan_allocate(bits, start, size, best_fit);
+        const int ret = allocator.allocate_from(start, size, best_fit);
+        ASSERT_EQ(ret, expected);
+
+        if (ret >= 0) {
+            std::fill_n(bits.begin() + ret, size, false);
+            if (rand() % 2) {
+                allocator.free(ret, size);
+                std::fill_n(bits.begin() + ret, size, true);
+            }
+        }
+
+        ASSERT_EQ(allocator.total_free_slot_count(), static_cast<std::size_t>(std::count(bits.begin(), bits.end(), true)));
+    }
+}
+
+TEST(memspace_block_allocator, alloc_aligns_and_fails_when_full) {
+    MemspaceBlockAllocator allocator(64);
+
+    ASSERT_EQ(allocator.alloc(3), 0);
+    ASSERT_EQ(allocator.alloc(4), 4);
+    ASSERT_EQ(allocator.alloc(56), 8);
+    ASSERT_EQ(allocator.alloc(1), 0xFFFFFFFF);
+    ASSERT_EQ(allocator.free_size, 0);
+}
+
+TEST(memspace_block_allocator, free_coalesces_neighbours) {
+    MemspaceBlockAllocator allocator(64);
+
+    const std::uint32_t a = allocator.alloc(16);
+    const std::uint32_t b = allocator.alloc(16);
+    const std::uint32_t c = allocator.alloc(16);
+    ASSERT_EQ(allocator.alloc(16), 48);
+
+    ASSERT_TRUE(allocator.free(a));
+    ASSERT_TRUE(allocator.free(c));
+    ASSERT_EQ(allocator.largest_free_block(), 16);
+    ASSERT_EQ(allocator.fragmentation(), 50);
+
+    // merged with both neighbours
+    ASSERT_TRUE(allocator.free(b));
+    ASSERT_EQ(allocator.largest_free_block(), 48);
+    ASSERT_EQ(allocator.fragmentation(), 0);
+    ASSERT_EQ(allocator.blocks.size(), 2);
+    ASSERT_EQ(allocator.alloc(48), 0);
+}
+
+TEST(memspace_block_allocator, free_rejects_unknown_and_double_free) {
+    MemspaceBlockAllocator allocator(64);
+
+    const std::uint32_t a = allocator.alloc(8);
+    ASSERT_FALSE(allocator.free(a + 4));
+    ASSERT_TRUE(allocator.free(a));
+    ASSERT_FALSE(allocator.free(a));
+    ASSERT_EQ(allocator.free_size, 64);
+}
+
+TEST(memspace_block_allocator, takes_the_smallest_fit) {
+    MemspaceBlockAllocator allocator(128);
+
+    const std::uint32_t big = allocator.alloc(32);
+    allocator.alloc(4);
+    const std::uint32_t small = allocator.alloc(8);
+    allocator.alloc(84);
+
+    ASSERT_TRUE(allocator.free(big));
+    ASSERT_TRUE(allocator.free(small));
+    ASSERT_EQ(allocator.alloc(8), small);
+    ASSERT_EQ(allocator.alloc(8), big);
+}
@@ -0,0 +1,165 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <mem/functions.h>
+#include <mem/snapshot.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+static void fill(MemState &mem, Address addr, size_t size, uint8_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        mem.memory[addr + i] = static_cast<uint8_t>(seed + i * 7);
+    }
+}
+
+static std::vector<uint8_t> read(MemState &mem, Address addr, size_t size) {
+    return std::vector<uint8_t>(&mem.memory[addr], &mem.memory[addr] + size);
+}
+
+TEST(mem_snapshot, full_round_trip) {
+    MemState mem;
+    ASSERT_TRUE(init(mem));
+    const Address addr = alloc(mem, KiB(512), "snapshot test");
+    ASSERT_NE(addr, 0);
+    fill(mem, addr, KiB(512), 3);
+    const std::vector<uint8_t> expected = read(mem, addr, KiB(512));
+
+    std::stringstream stream;
+    SnapshotStats saved;
+    ASSERT_TRUE(save_snapshot(mem, stream, SnapshotMode::Full, &saved));
+    ASSERT_EQ(saved.data_size % mem.page_size, 0);
+    ASSERT_GE(saved.data_size, KiB(512));
+    // Most of this memory is one repeating pattern
+    ASSERT_LT(stream.str().size(), KiB(64));
+
+    std::memset(&mem.memory[addr], 0xFF, KiB(512));
+    SnapshotStats loaded;
+    ASSERT_TRUE(load_snapshot(mem, stream, &loaded));
+    ASSERT_EQ(loaded.page_count, saved.page_count);
+    ASSERT_EQ(read(mem, addr, KiB(512)), expected);
+}
+
+TEST(mem_snapshot, incremental_only_has_written_pages) {
+    MemState mem;
+    ASSERT_TRUE(init(mem));
+    start_dirty_tracking(mem);
+    const Address first = alloc(mem, KiB(256), "snapshot test");
+    const Address second = alloc(mem, KiB(256), "snapshot test");
+
+    std::stringstream full;
+    SnapshotStats stats;
+    ASSERT_TRUE(save_snapshot(mem, full, SnapshotMode::Full, &stats));
+    ASSERT_EQ(stats.page_count, KiB(512) / mem.page_size);
+
+    std::stringstream nothing;
+    ASSERT_TRUE(save_snapshot(mem, nothing, SnapshotMode::Incremental, &stats));
+    ASSERT_EQ(stats.page_count, 0);
+
+    mem.memory[first + 10] = 1;
+    mem.memory[second + KiB(128)] = 2;
+    mem.memory[second + KiB(128) + 1] = 3;
+    std::stringstream written;
+    ASSERT_TRUE(save_snapshot(mem, written, SnapshotMode::Incremental, &stats));
+    // The pages are protected by blocks of 64 KiB, each write makes a whole block dirty
+    ASSERT_GE(stats.page_count, 2);
+    ASSERT_LE(stats.page_count, 2 * KiB(64) / mem.page_size);
+
+    // Allocated pages are in the next snapshot
+    const Address third = alloc(mem, KiB(64), "snapshot test");
+    ASSERT_NE(third, 0);
+    std::stringstream allocated;
+    ASSERT_TRUE(save_snapshot(mem, allocated, SnapshotMode::Incremental, &stats));
+    ASSERT_EQ(stats.page_count, KiB(64) / mem.page_size);
+    ASSERT_EQ(stats.region_count, 3);
+}
+
+TEST(mem_snapshot, incremental_chain_restore) {
+    MemState mem;
+    ASSERT_TRUE(init(mem));
+    start_dirty_tracking(mem);
+    const Address addr = alloc(mem, KiB(256), "snapshot test");
+    fill(mem, addr, KiB(256), 1);
+
+    std::stringstream base;
+    ASSERT_TRUE(save_snapshot(mem, base, SnapshotMode::Full));
+    fill(mem, addr + KiB(64), KiB(16), 9);
+    std::stringstream first;
+    ASSERT_TRUE(save_snapshot(mem, first, SnapshotMode::Incremental));
+    fill(mem, addr + KiB(200), 100, 42);
+    std::stringstream second;
+    ASSERT_TRUE(save_snapshot(mem, second, SnapshotMode::Incremental));
+    const std::vector<uint8_t> expected = read(mem, addr, KiB(256));
+
+    std::memset(&mem.memory[addr], 0, KiB(256));
+    ASSERT_TRUE(load_snapshot(mem, base));
+    // Nothing restored can be skipped
+    std::stringstream wrong_order(second.str());
+    ASSERT_FALSE(load_snapshot(mem, wrong_order));
+    ASSERT_TRUE(load_snapshot(mem, first));
+    ASSERT_TRUE(load_snapshot(mem, second));
+    ASSERT_EQ(read(mem, addr, KiB(256)), expected);
+}
+
+TEST(mem_snapshot, restore_allocates_free_regions) {
+    MemState mem;
+    ASSERT_TRUE(init(mem));
+    const Address addr = alloc(mem, KiB(128), "snapshot test");
+    fill(mem, addr, KiB(128), 5);
+    const std::vector<uint8_t> expected = read(mem, addr, KiB(128));
+
+    std::stringstream stream;
+    ASSERT_TRUE(save_snapshot(mem, stream, SnapshotMode::Full));
+    free(mem, addr);
+
+    ASSERT_TRUE(load_snapshot(mem, stream));
+    ASSERT_TRUE(is_valid_addr(mem, addr));
+    ASSERT_EQ(read(mem, addr, KiB(128)), expected);
+}
+
+TEST(mem_snapshot, instances_track_their_own_writes) {
+    MemState first;
+    ASSERT_TRUE(init(first));
+    MemState second;
+    ASSERT_TRUE(init(second));
+    start_dirty_tracking(first);
+    start_dirty_tracking(second);
+    const Address first_addr = alloc(first, KiB(128), "snapshot test");
+    const Address second_addr = alloc(second, KiB(128), "snapshot test");
+
+    SnapshotStats stats;
+    std::stringstream first_full, second_full;
+    ASSERT_TRUE(save_snapshot(first, first_full, SnapshotMode::Full, &stats));
+    ASSERT_TRUE(save_snapshot(second, second_full, SnapshotMode::Full, &stats));
+
+    // The fault of each write is handled by the memory it hits
+    second.memory[second_addr + 10] = 1;
+    std::stringstream first_written, second_written;
+    ASSERT_TRUE(save_snapshot(first, first_written, SnapshotMode::Incremental, &stats));
+    ASSERT_EQ(stats.page_count, 0);
+    ASSERT_TRUE(save_snapshot(second, second_written, SnapshotMode::Incremental, &stats));
+    ASSERT_GE(stats.page_count, 1);
+
+    first.memory[first_addr + 10] = 2;
+    EXPECT_EQ(first.memory[first_addr + 10], 2);
+    EXPECT_EQ(second.memory[second_addr + 10], 1);
+}
@@ -30,8 +30,12 @@
 #include <config/state.h>
 #include <emuenv/state.h>
 
+#include <bit>
+
 using ImportFn = std::function<void(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id)>;
 using ImportVarFactory = std::function<Address(EmuEnvState &emuenv)>;
+// Leaf imports only take and return floating-point values, all of them in VFP registers
+using LeafImportFn = void (*)(CPUState &cpu);
 
 // Function returns a value that is written to CPU registers.
 template <typename Ret, typename... Args, size_t... indices>
@@ -61,3 +65,55 @@ ImportFn bridge(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...),
         call(export_fn, export_name, std::get<0>(args_layout), std::get<1>(args_layout), Indices(), thread_id, cpu, emuenv);
     };
 }
+
+// Read the floating-point argument at index, doubles are in pairs of single registers.
+template <typename T>
+T read_vfp_arg(CPUState &cpu, size_t index) {
+    if constexpr (std::is_same_v<T, float>) {
+        return read_float_reg(cpu, index);
+    } else {
+        static_assert(std::is_same_v<T, double>);
+        const uint64_t lo32 = std::bit_cast<uint32_t>(read_float_reg(cpu, index * 2));
+        const uint64_t hi32 = std::bit_cast<uint32_t>(read_float_reg(cpu, index * 2 + 1));
+        return std::bit_cast<double>(lo32 | (hi32 << 32));
+    }
+}
+
+template <typename T>
+void write_vfp_return(CPUState &cpu, T ret) {
+    if constexpr (std::is_same_v<T, float>) {
+        write_float_reg(cpu, 0, ret);
+    } else {
+        static_assert(std::is_same_v<T, double>);
+        const uint64_t both = std::bit_cast<uint64_t>(ret);
+        write_float_reg(cpu, 0, std::bit_cast<float>(static_cast<uint32_t>(both)));
+        write_float_reg(cpu, 1, std::bit_cast<float>(static_cast<uint32_t>(both >> 32)));
+    }
+}
+
+template <auto export_fn>
+struct LeafBridge;
+
+// Calls a leaf export with its arguments read straight from the registers.
+// Mixing floats and doubles would need the AAPCS back-filling of the registers, leaf exports only use one of them.
+template <typename Ret, typename... Args, Ret (*export_fn)(Args...)>
+struct LeafBridge<export_fn> {
+    static_assert(std::is_floating_point_v<Ret> && (std::is_same_v<Args, Ret> && ...), "Leaf exports only take and return floats or doubles");
+
+    static void call(CPUState &cpu) {
+        call(cpu, std::index_sequence_for<Args...>());
+    }
+
+    template <size_t... indices>
+    static void call(CPUState &cpu, std::index_sequence<indices...>) {
+        write_vfp_return(cpu, export_fn(read_vfp_arg<Args>(cpu, indices)...));
+    }
+};
+
+// Import used before the stub is linked to the dispatch table
+template <auto export_fn>
+ImportFn leaf_bridge() {
+    return [](EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
+        LeafBridge<export_fn>::call(cpu);
+    };
+}
@@ -34,6 +34,17 @@ int stubbed_impl(const char *name, const char *info);
 
 #define EXPORT(ret, name, ...) ret export_##name(EmuEnvState &emuenv, SceUID thread_id, const char *export_name, ##__VA_ARGS__)
 
+// Leaf exports don't get the emulator state, and are called by the import dispatch without going through the
+// argument layout, tracing or the import stats. They must also be listed in modules/leaf_import_list.inc.
+#define LEAF_BRIDGE_DECL(name)          \
+    extern const ImportFn import_##name; \
+    extern const LeafImportFn leaf_import_##name;
+#define LEAF_BRIDGE_IMPL(name)                                         \
+    const ImportFn import_##name = leaf_bridge<&leaf_export_##name>(); \
+    const LeafImportFn leaf_import_##name = &LeafBridge<&leaf_export_##name>::call;
+
+#define LEAF_EXPORT(ret, name, ...) ret leaf_export_##name(__VA_ARGS__)
+
 #define VAR_BRIDGE_DECL(name) extern const ImportVarFactory import_##name;
 #define VAR_BRIDGE_IMPL(name) const ImportVarFactory import_##name = export_##name;
 
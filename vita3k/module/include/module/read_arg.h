@@ -58,7 +58,7 @@ T read(CPUState &cpu, const ArgLayout &arg, const MemState &mem) {
     case ArgLocation::stack: {
         const Address sp = read_sp(cpu);
         const Address address_on_stack = static_cast<Address>(sp + arg.offset);
-        return *Ptr<T>(address_on_stack).get(mem);
+        return *Ptr<T>(address_on_stack).get_unchecked(mem);
     }
     case ArgLocation::fp:
         if constexpr (std::is_same_v<T, float>)
@@ -31,6 +31,7 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cstring>
 
 TRACY_MODULE_NAME(SceAppUtil);
@@ -241,6 +242,17 @@ std::string construct_slotparam_path(const unsigned int data) {
     return construct_savedata0_path("SlotParam_" + std::to_string(data), "bin");
 }
 
+bool read_slot_param(IOState &io, const unsigned int slot_id, SceAppUtilSaveDataSlotParam &param, const std::wstring &pref_path, const char *export_name) {
+    // the slots are listed each time the savedata dialog opens or the title searches them, they are read once until they are written
+    std::vector<uint8_t> data;
+    if (!read_cached_savedata_file(io, construct_slotparam_path(slot_id).c_str(), data, pref_path, export_name))
+        return false;
+
+    memset(&param, 0, sizeof(SceAppUtilSaveDataSlotParam));
+    memcpy(&param, data.data(), std::min(data.size(), sizeof(SceAppUtilSaveDataSlotParam)));
+    return true;
+}
+
 EXPORT(int, sceAppUtilSaveDataDataRemove, SceAppUtilSaveDataFileSlot *slot, SceAppUtilSaveDataRemoveItem *files, unsigned int fileNum, SceAppUtilMountPoint *mountPoint) {
     TRACY_FUNC(sceAppUtilSaveDataDataRemove, slot, files, fileNum, mountPoint);
     for (unsigned int i = 0; i < fileNum; i++) {
@@ -307,6 +319,9 @@ EXPORT(int, sceAppUtilSaveDataDataSave, SceAppUtilSaveDataFileSlot *slot, SceApp
         close_file(emuenv.io, fd, export_name);
     }
 
+    // the save is complete once its files are written back
+    emuenv.io.write_back.flush();
+
     return 0;
 }
 
@@ -338,11 +353,8 @@ EXPORT(int, sceAppUtilSaveDataSlotDelete, unsigned int slotId, SceAppUtilMountPo
 
 EXPORT(int, sceAppUtilSaveDataSlotGetParam, unsigned int slotId, SceAppUtilSaveDataSlotParam *param, SceAppUtilMountPoint *mountPoint) {
     TRACY_FUNC(sceAppUtilSaveDataSlotGetParam, slotId, param, mountPoint);
-    const auto fd = open_file(emuenv.io, construct_slotparam_path(slotId).c_str(), SCE_O_RDONLY, emuenv.pref_path, export_name);
-    if (fd < 0)
+    if (!read_slot_param(emuenv.io, slotId, *param, emuenv.pref_path, export_name))
         return RET_ERROR(SCE_APPUTIL_ERROR_SAVEDATA_SLOT_NOT_FOUND);
-    read_file(param, emuenv.io, fd, sizeof(SceAppUtilSaveDataSlotParam), export_name);
-    close_file(emuenv.io, fd, export_name);
     param->status = 0;
     return 0;
 }
@@ -368,14 +380,12 @@ EXPORT(SceInt32, sceAppUtilSaveDataSlotSearch, SceAppUtilWorkBuffer *workBuf, co
             slotList[i].emptyParam = Ptr<SceAppUtilSaveDataSlotEmptyParam>(0);
         }
 
-        const auto fd = open_file(emuenv.io, construct_slotparam_path(i).c_str(), SCE_O_RDONLY, emuenv.pref_path, export_name);
+        SceAppUtilSaveDataSlotParam param;
+        const bool exists = read_slot_param(emuenv.io, i, param, emuenv.pref_path, export_name);
         switch (cond->type) {
         case SCE_APPUTIL_SAVEDATA_SLOT_SEARCH_TYPE_EXIST_SLOT:
-            if (fd > 0) {
+            if (exists) {
                 if (slotList) {
-                    SceAppUtilSaveDataSlotParam param;
-                    memset(&param, 0, sizeof(SceAppUtilSaveDataSlotParam));
-                    read_file(&param, emuenv.io, fd, sizeof(SceAppUtilSaveDataSlotParam), export_name);
                     slotList[result->hitNum].userParam = param.userParam;
                     slotList[result->hitNum].status = param.status;
                     slotList[result->hitNum].id = i;
@@ -384,7 +394,7 @@ EXPORT(SceInt32, sceAppUtilSaveDataSlotSearch, SceAppUtilWorkBuffer *workBuf, co
             }
             break;
         case SCE_APPUTIL_SAVEDATA_SLOT_SEARCH_TYPE_EMPTY_SLOT:
-            if (fd < 0) {
+            if (!exists) {
                 if (slotList)
                     slotList[result->hitNum].id = i;
                 result->hitNum++;
@@ -392,9 +402,6 @@ EXPORT(SceInt32, sceAppUtilSaveDataSlotSearch, SceAppUtilWorkBuffer *workBuf, co
             break;
         default: break;
         }
-
-        if (fd > 0)
-            close_file(emuenv.io, fd, export_name);
     }
 
     return 0;
@@ -130,6 +130,7 @@ EXPORT(int, sceAudioOutOpenPort, SceAudioOutPortType type, int len, int freq, Sc
     const std::lock_guard<std::mutex> lock(emuenv.audio.mutex);
     const int port_id = emuenv.audio.next_port_id++;
     emuenv.audio.out_ports.emplace(port_id, port);
+    emuenv.audio.update_out_ports();
 
     return port_id;
 }
@@ -141,7 +142,7 @@ EXPORT(int, sceAudioOutOutput, int port, const void *buf) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     if (!thread) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
@@ -158,7 +159,7 @@ EXPORT(int, sceAudioOutGetRestSample, int port) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
 
-    const int bytes_available = SDL_AudioStreamAvailable(prt->stream.get());
+    const int bytes_available = emuenv.audio.get_rest_bytes(*prt);
 
     // we have the number of bytes left, we can convert it back to the number of samples left
     return bytes_available / (2 * sizeof(int16_t));
@@ -175,6 +176,7 @@ EXPORT(int, sceAudioOutReleasePort, int port) {
     if (!emuenv.audio.out_ports.erase(port)) {
         return RET_ERROR(SCE_AUDIO_OUT_ERROR_INVALID_PORT);
     }
+    emuenv.audio.update_out_ports();
 
     return 0;
 }
@@ -115,8 +115,7 @@ EXPORT(int, sceAudioInInput, int port, void *destPtr) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_INVALID_PORT_PARAM);
     }
 
-    while (SDL_DequeueAudio(emuenv.audio.in_port.id, destPtr, emuenv.audio.in_port.len_bytes) > 0) {
-    }
+    emuenv.audio.audio_input(destPtr);
     return 0;
 }
 
@@ -153,24 +152,10 @@ EXPORT(int, sceAudioInOpenPort, SceAudioInPortType portType, int grain, int freq
         }
     }
 
-    SDL_AudioSpec desired = {};
-    SDL_AudioSpec received = {};
-    desired.freq = freq;
-    desired.format = AUDIO_S16LSB;
-    desired.channels = 1;
-    desired.samples = grain;
-    desired.callback = nullptr;
-    desired.userdata = nullptr;
-
-    emuenv.audio.in_port.id = SDL_OpenAudioDevice(nullptr, true, &desired, &received, 0);
-    if (emuenv.audio.in_port.id == 0) {
+    if (!emuenv.audio.open_in_port(freq, grain)) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_FATAL);
     }
 
-    SDL_PauseAudioDevice(emuenv.audio.in_port.id, 0);
-
-    emuenv.audio.in_port.len_bytes = grain * 2;
-    emuenv.audio.in_port.running = true;
     return PORT_ID;
 }
 
@@ -187,9 +172,7 @@ EXPORT(int, sceAudioInReleasePort, int port) {
     if (!emuenv.audio.in_port.running) {
         return RET_ERROR(SCE_AUDIO_IN_ERROR_NOT_OPENED);
     }
-    emuenv.audio.in_port.running = false;
-    SDL_PauseAudioDevice(emuenv.audio.in_port.id, 1);
-    SDL_CloseAudioDevice(emuenv.audio.in_port.id);
+    emuenv.audio.close_in_port();
     return 0;
 }
 
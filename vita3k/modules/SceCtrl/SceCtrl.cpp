@@ -178,7 +178,7 @@ EXPORT(int, sceCtrlReadBufferNegative, int port, SceCtrlData *pad_data, int coun
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, true, false);
+    return read_data(emuenv, port, pad_data, count, true, false);
 }
 
 EXPORT(int, sceCtrlReadBufferNegative2, int port, SceCtrlData2 *pad_data, int count) {
@@ -186,7 +186,7 @@ EXPORT(int, sceCtrlReadBufferNegative2, int port, SceCtrlData2 *pad_data, int co
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, true, false);
+    return read_data(emuenv, port, pad_data, count, true, false);
 }
 
 EXPORT(int, sceCtrlReadBufferPositive, int port, SceCtrlData *pad_data, int count) {
@@ -194,7 +194,7 @@ EXPORT(int, sceCtrlReadBufferPositive, int port, SceCtrlData *pad_data, int coun
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, false, false);
+    return read_data(emuenv, port, pad_data, count, false, false);
 }
 
 EXPORT(int, sceCtrlReadBufferPositive2, int port, SceCtrlData2 *pad_data, int count) {
@@ -202,7 +202,7 @@ EXPORT(int, sceCtrlReadBufferPositive2, int port, SceCtrlData2 *pad_data, int co
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, false, false);
+    return read_data(emuenv, port, pad_data, count, false, false);
 }
 
 EXPORT(int, sceCtrlReadBufferPositiveExt, int port, SceCtrlData *pad_data, int count) {
@@ -210,7 +210,7 @@ EXPORT(int, sceCtrlReadBufferPositiveExt, int port, SceCtrlData *pad_data, int c
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, false, true);
+    return read_data(emuenv, port, pad_data, count, false, true);
 }
 
 EXPORT(int, sceCtrlReadBufferPositiveExt2, int port, SceCtrlData2 *pad_data, int count) {
@@ -218,7 +218,7 @@ EXPORT(int, sceCtrlReadBufferPositiveExt2, int port, SceCtrlData2 *pad_data, int
     if (port > 1 && !emuenv.cfg.current_config.pstv_mode) {
         return RET_ERROR(SCE_CTRL_ERROR_NO_DEVICE);
     }
-    return peek_data(emuenv, port, pad_data, count, false, true);
+    return read_data(emuenv, port, pad_data, count, false, true);
 }
 
 EXPORT(int, sceCtrlRegisterBdRMCCallback) {
@@ -240,6 +240,7 @@ EXPORT(int, sceCtrlSetActuator, int port, const SceCtrlActuator *pState) {
     CtrlState &state = emuenv.ctrl;
     refresh_controllers(state);
 
+    const std::lock_guard<std::mutex> guard(state.mutex);
     for (const auto &controller : state.controllers) {
         if (controller.second.port == port) {
             SDL_GameControllerRumble(controller.second.controller.get(), pState->small * 655.35f, pState->large * 655.35f, SDL_HAPTIC_INFINITY);
@@ -185,10 +185,11 @@ EXPORT(int, sceDisplayGetVcountInternal) {
 
 EXPORT(SceInt32, sceDisplayRegisterVblankStartCallback, SceUID uid) {
     TRACY_FUNC(sceDisplayRegisterVblankStartCallback, uid);
-    const auto cb = lock_and_find(uid, emuenv.kernel.callbacks, emuenv.kernel.mutex);
+    const auto cb = emuenv.kernel.callbacks.get(uid);
     if (!cb)
         return RET_ERROR(SCE_DISPLAY_ERROR_INVALID_VALUE);
 
+    const std::lock_guard<std::mutex> guard(emuenv.display.mutex);
     emuenv.display.vblank_callbacks[uid] = cb;
 
     return 0;
@@ -196,6 +197,7 @@ EXPORT(SceInt32, sceDisplayRegisterVblankStartCallback, SceUID uid) {
 
 EXPORT(SceInt32, sceDisplayUnregisterVblankStartCallback, SceUID uid) {
     TRACY_FUNC(sceDisplayUnregisterVblankStartCallback, uid);
+    const std::lock_guard<std::mutex> guard(emuenv.display.mutex);
     if (emuenv.display.vblank_callbacks.find(uid) == emuenv.display.vblank_callbacks.end())
         return RET_ERROR(SCE_DISPLAY_ERROR_INVALID_VALUE);
 
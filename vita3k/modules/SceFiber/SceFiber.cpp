@@ -20,7 +20,9 @@
 #include <cpu/functions.h>
 #include <kernel/state.h>
 
+#include <deque>
 #include <sstream>
+#include <unordered_map>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
@@ -29,10 +31,21 @@ TRACY_MODULE_NAME(SceFiber);
 
 const static int DEFAULT_FIBER_STACK_SIZE = 4096;
 
+// Fibers are only switched inside the calls of the library, so they only need the registers preserved across a call
+struct FiberThread {
+    // Fiber running on the thread, null when it runs its own code
+    SceFiber *fiber = nullptr;
+    // Context of the thread where it started running fibers
+    CPUCalleeSavedContext context;
+    Ptr<SceUInt32> argOnReturn;
+};
+
 struct FiberState {
     std::mutex mutex;
-    std::map<SceUID, SceFiber *> thread_fibers;
-    std::map<SceUID, CPUContext> thread_contexts;
+    std::unordered_map<SceUID, FiberThread> threads;
+    // Context slots of the fibers, the deque keeps them in place when it grows
+    std::deque<CPUCalleeSavedContext> contexts;
+    std::vector<uint32_t> free_contexts;
 };
 
 LIBRARY_INIT_IMPL(SceFiber) {
@@ -42,89 +55,111 @@ LIBRARY_INIT_REGISTER(SceFiber)
 
 constexpr bool LOG_FIBER = false;
 
-void set_thread_fiber(FiberState &state, const SceUID &tid, SceFiber *fiber) {
-    state.thread_fibers[tid] = fiber;
-}
-
-SceFiber *get_thread_fiber(FiberState &state, const SceUID &tid) {
-    if (state.thread_fibers.find(tid) == state.thread_fibers.end()) {
-        return nullptr;
+static uint32_t alloc_fiber_context(FiberState &state) {
+    if (state.free_contexts.empty()) {
+        state.contexts.emplace_back();
+        return static_cast<uint32_t>(state.contexts.size() - 1);
     }
-    return state.thread_fibers[tid];
+
+    const uint32_t context = state.free_contexts.back();
+    state.free_contexts.pop_back();
+    return context;
 }
 
-void set_thread_context(FiberState &state, const SceUID &tid, const CPUContext &ctx) {
-    state.thread_contexts[tid] = ctx;
+static CPUCalleeSavedContext &get_fiber_context(FiberState &state, const SceFiber *fiber) {
+    return state.contexts[fiber->context];
 }
 
-CPUContext get_thread_context(FiberState &state, const SceUID &tid) {
-    return state.thread_contexts[tid];
+static std::string describe_context(const CPUCalleeSavedContext &ctx) {
+    std::stringstream ss;
+    ss << fmt::format("PC: 0x{:0>8x},   SP: 0x{:0>8x},   LR: 0x{:0>8x}\n", ctx.pc, ctx.sp, ctx.lr);
+    for (size_t a = 0; a < 4; a++) {
+        ss << fmt::format("r{: <2}: 0x{:0>8x}   r{: <2}: 0x{:0>8x}\n", a + 4, ctx.r4_r11[a], a + 8, ctx.r4_r11[a + 4]);
+    }
+    ss << fmt::format("Thumb: {}\n", ctx.thumb());
+    return ss.str();
 }
 
-std::string describe_fiber(FiberState &state, ThreadStatePtr thread, SceFiber *fiber) {
+static std::string describe_fiber(FiberState &state, ThreadStatePtr thread, SceFiber *fiber) {
     std::stringstream ss;
     ss << fmt::format("Fiber (name: {})\n", fiber->name);
-    ss << fmt::format("entry: {}\n", log_hex(fiber->cpu->get_pc()), log_hex(fiber->entry.address()));
+    ss << fmt::format("entry: {}\n", log_hex(fiber->entry.address()));
     ss << "CPU Context:\n";
-    ss << fiber->cpu->description();
+    ss << describe_context(get_fiber_context(state, fiber));
     ss << "Referenced from " << thread->id << "\n";
     ss << "CPU Context:\n";
-    auto ctx = get_thread_context(state, thread->id);
-    ss << ctx.description();
+    ss << describe_context(state.threads[thread->id].context);
     return ss.str();
 }
 
-void log_fiber(FiberState &state, ThreadStatePtr thread, SceFiber *fiber, const std::string &function_name) {
+static void log_fiber(FiberState &state, ThreadStatePtr thread, SceFiber *fiber, const std::string &function_name) {
     std::string log_msg = function_name + "\n";
     log_msg += describe_fiber(state, thread, fiber);
     LOG_INFO("{}", log_msg);
 }
 
-void setup_fiber_to_run(EmuEnvState &emuenv, const ThreadStatePtr thread, SceFiber *fiber, uint32_t thread_sp, const uint32_t &argOnRunTo) {
+// Saves the fiber running on the thread, it resumes returning SCE_FIBER_OK
+static void suspend_fiber(CPUState &cpu, FiberState &state, SceFiber *fiber, Ptr<SceUInt32> argOnRun) {
+    save_callee_saved_context(cpu, get_fiber_context(state, fiber));
+    fiber->status = FiberStatus::SUSPEND;
+    fiber->argOnRun = argOnRun;
+}
+
+// Starts or resumes the fiber on the thread, returns the value to give it in r0
+static SceUInt32 run_fiber(EmuEnvState &emuenv, CPUState &cpu, FiberState &state, SceFiber *fiber, uint32_t thread_sp, SceUInt32 argOnRunTo) {
     assert(fiber->status != FiberStatus::RUN);
+    CPUCalleeSavedContext &ctx = get_fiber_context(state, fiber);
     if (!fiber->addrContext) {
-        fiber->cpu->set_sp(thread_sp);
+        ctx.sp = thread_sp;
         fiber->status = FiberStatus::INIT;
     }
 
+    SceUInt32 ret = SCE_FIBER_OK;
     if (fiber->status == FiberStatus::INIT) {
-        fiber->cpu->cpu_registers[0] = fiber->argOnInitialize;
-        fiber->cpu->cpu_registers[1] = argOnRunTo;
-        fiber->cpu->set_pc(fiber->entry.address());
-    } else {
-        if (fiber->argOnRun) {
-            *fiber->argOnRun.get(emuenv.mem) = argOnRunTo;
-        }
+        ctx.set_pc(fiber->entry.address());
+        ctx.lr = 0xDEADBEAF;
+        write_reg(cpu, 1, argOnRunTo);
+        ret = fiber->argOnInitialize;
+    } else if (fiber->argOnRun) {
+        *fiber->argOnRun.get(emuenv.mem) = argOnRunTo;
     }
     fiber->status = FiberStatus::RUN;
+
+    load_callee_saved_context(cpu, ctx);
+    return ret;
 }
 
-void initialize_fiber(EmuEnvState &emuenv, const ThreadStatePtr thread, SceFiber *fiber, const char *name, Ptr<SceFiberEntry> entry, SceUInt32 argOnInitialize, Ptr<void> addrContext, SceSize sizeContext, SceFiberOptParam *params) {
+static void initialize_fiber(EmuEnvState &emuenv, const ThreadStatePtr thread, SceFiber *fiber, const char *name, Ptr<SceFiberEntry> entry, SceUInt32 argOnInitialize, Ptr<void> addrContext, SceSize sizeContext, SceFiberOptParam *params) {
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
     fiber->entry = entry;
     strncpy(fiber->name, name, 32);
     fiber->argOnInitialize = argOnInitialize;
     fiber->argOnRun = nullptr;
     fiber->addrContext = addrContext.address();
     fiber->sizeContext = sizeContext;
-    fiber->cpu = new CPUContext;
+    fiber->context = alloc_fiber_context(*state);
     fiber->status = FiberStatus::INIT;
-    *fiber->cpu = save_context(*thread->cpu);
 
+    // keeps the status and floating-point control registers of the thread
+    CPUCalleeSavedContext &ctx = get_fiber_context(*state, fiber);
+    save_callee_saved_context(*thread->cpu, ctx);
     if (addrContext && sizeContext > 0) {
         memset(addrContext.get(emuenv.mem), 0xCC, sizeContext);
-        fiber->cpu->set_sp(addrContext.address() + sizeContext);
+        ctx.sp = addrContext.address() + sizeContext;
     }
-    fiber->cpu->set_lr(0xDEADBEAF);
+    ctx.lr = 0xDEADBEAF;
 }
 
-EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext, SceSize sizeContext, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnRun) {
-    TRACY_FUNC(_sceFiberAttachContextAndRun, fiber, addrContext, sizeContext, argOnRunTo, argOnRun);
+EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext, SceSize sizeContext, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnReturn) {
+    TRACY_FUNC(_sceFiberAttachContextAndRun, fiber, addrContext, sizeContext, argOnRunTo, argOnReturn);
     // Maybe Need more check on real hw
     STUBBED("Todo: not sure for now");
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    assert(!get_thread_fiber(*state, thread->id));
+    const auto thread = emuenv.kernel.get_thread(thread_id);
+    FiberThread &fiber_thread = state->threads[thread->id];
+    assert(!fiber_thread.fiber);
     assert(!fiber->addrContext);
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Attach context and run");
@@ -133,15 +168,13 @@ EXPORT(int, _sceFiberAttachContextAndRun, SceFiber *fiber, Address addrContext,
     fiber->addrContext = addrContext;
     fiber->sizeContext = sizeContext;
     if (addrContext && sizeContext > 0) {
-        fiber->cpu->set_sp(addrContext + sizeContext);
+        get_fiber_context(*state, fiber).sp = addrContext + sizeContext;
     }
 
-    setup_fiber_to_run(emuenv, thread, fiber, read_sp(*thread->cpu), argOnRunTo);
-    set_thread_context(*state, thread->id, save_context(*thread->cpu));
-    set_thread_fiber(*state, thread->id, fiber);
-
-    load_context(*thread->cpu, *fiber->cpu);
-    return fiber->cpu->cpu_registers[0];
+    save_callee_saved_context(*thread->cpu, fiber_thread.context);
+    fiber_thread.argOnReturn = argOnReturn;
+    fiber_thread.fiber = fiber;
+    return run_fiber(emuenv, *thread->cpu, *state, fiber, fiber_thread.context.sp, argOnRunTo);
 }
 
 EXPORT(int, _sceFiberAttachContextAndSwitch, SceFiber *fiber, Address addrContext, SceSize sizeContext, SceUInt32 argOnRunTo, Ptr<SceUInt32> argOnRun) {
@@ -150,9 +183,9 @@ EXPORT(int, _sceFiberAttachContextAndSwitch, SceFiber *fiber, Address addrContex
     STUBBED("Todo: not sure for now");
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto ctx = get_thread_context(*state, thread->id);
-    SceFiber *thread_fiber = get_thread_fiber(*state, thread->id);
+    const auto thread = emuenv.kernel.get_thread(thread_id);
+    FiberThread &fiber_thread = state->threads[thread->id];
+    SceFiber *thread_fiber = fiber_thread.fiber;
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Attach context and switch");
     }
@@ -162,18 +195,12 @@ EXPORT(int, _sceFiberAttachContextAndSwitch, SceFiber *fiber, Address addrContex
     fiber->addrContext = addrContext;
     fiber->sizeContext = sizeContext;
     if (addrContext && sizeContext > 0) {
-        fiber->cpu->set_sp(addrContext + sizeContext);
+        get_fiber_context(*state, fiber).sp = addrContext + sizeContext;
     }
 
-    *thread_fiber->cpu = save_context(*thread->cpu);
-    setup_fiber_to_run(emuenv, thread, fiber, ctx.get_sp(), argOnRunTo);
-    thread_fiber->status = FiberStatus::SUSPEND;
-    thread_fiber->argOnRun = argOnRun;
-    thread_fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
-    set_thread_fiber(*state, thread->id, fiber);
-    load_context(*thread->cpu, *fiber->cpu);
-
-    return fiber->cpu->cpu_registers[0];
+    suspend_fiber(*thread->cpu, *state, thread_fiber, argOnRun);
+    fiber_thread.fiber = fiber;
+    return run_fiber(emuenv, *thread->cpu, *state, fiber, fiber_thread.context.sp, argOnRunTo);
 }
 
 EXPORT(SceInt32, _sceFiberInitializeImpl, SceFiber *fiber, const char *name, Ptr<SceFiberEntry> entry, SceUInt32 argOnInitialize, Ptr<void> addrContext, SceSize sizeContext, SceFiberOptParam *params) {
@@ -190,7 +217,7 @@ EXPORT(SceInt32, _sceFiberInitializeImpl, SceFiber *fiber, const char *name, Ptr
         return RET_ERROR(SCE_FIBER_ERROR_INVALID);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     if (!thread) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
     }
@@ -214,7 +241,7 @@ EXPORT(int, _sceFiberInitializeWithInternalOptionImpl, SceFiber *fiber, const ch
         return RET_ERROR(SCE_FIBER_ERROR_INVALID);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     if (!thread) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID);
     }
@@ -234,8 +261,12 @@ EXPORT(SceInt32, sceFiberFinalize, SceFiber *fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_STATE);
     }
 
-    delete fiber->cpu;
-    fiber->cpu = nullptr;
+    const auto state = emuenv.kernel.obj_store.get<FiberState>();
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (fiber->context != SCE_FIBER_NO_CONTEXT) {
+        state->free_contexts.push_back(fiber->context);
+        fiber->context = SCE_FIBER_NO_CONTEXT;
+    }
     return 0;
 }
 
@@ -251,10 +282,10 @@ EXPORT(SceUInt32, sceFiberGetSelf, Ptr<SceFiber> *fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    SceFiber *thread_fiber = get_thread_fiber(*state, thread->id);
-    if (thread_fiber)
-        *fiber = Ptr<SceFiber>(thread_fiber, emuenv.mem);
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    const auto fiber_thread = state->threads.find(thread_id);
+    if ((fiber_thread != state->threads.end()) && fiber_thread->second.fiber)
+        *fiber = Ptr<SceFiber>(fiber_thread->second.fiber, emuenv.mem);
     else
         *fiber = Ptr<SceFiber>(0);
 
@@ -285,28 +316,25 @@ EXPORT(SceInt32, sceFiberReturnToThread, uint32_t argOnReturnTo, Ptr<uint32_t> a
     TRACY_FUNC(sceFiberReturnToThread, argOnReturnTo, argOnRun);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    SceFiber *fiber = get_thread_fiber(*state, thread->id);
-    if (!fiber) {
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    const auto it = state->threads.find(thread->id);
+    if ((it == state->threads.end()) || !it->second.fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_PERMISSION);
     }
 
-    CPUContext thread_context = get_thread_context(*state, thread->id);
+    FiberThread &fiber_thread = it->second;
+    SceFiber *fiber = fiber_thread.fiber;
     assert(fiber->status == FiberStatus::RUN);
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Return to thread");
     }
 
-    *fiber->cpu = save_context(*thread->cpu);
-    fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
-    fiber->status = FiberStatus::SUSPEND;
-    fiber->argOnRun = argOnRun;
-    set_thread_fiber(*state, thread->id, nullptr);
+    suspend_fiber(*thread->cpu, *state, fiber, argOnRun);
+    fiber_thread.fiber = nullptr;
 
-    load_context(*thread->cpu, thread_context);
-    Address argOnReturn = thread_context.cpu_registers[2];
-    if (argOnReturn) {
-        *(Ptr<uint32_t>(argOnReturn).get(emuenv.mem)) = argOnReturnTo;
+    load_callee_saved_context(*thread->cpu, fiber_thread.context);
+    if (fiber_thread.argOnReturn) {
+        *fiber_thread.argOnReturn.get(emuenv.mem) = argOnReturnTo;
     }
 
     return SCE_FIBER_OK;
@@ -316,7 +344,7 @@ EXPORT(SceUInt32, sceFiberRun, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUIn
     TRACY_FUNC(sceFiberRun, fiber, argOnRunTo, argOnReturn);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     if (!fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
@@ -325,7 +353,8 @@ EXPORT(SceUInt32, sceFiberRun, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUIn
         return RET_ERROR(SCE_FIBER_ERROR_STATE);
     }
 
-    if (get_thread_fiber(*state, thread->id)) {
+    FiberThread &fiber_thread = state->threads[thread->id];
+    if (fiber_thread.fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_PERMISSION);
     }
 
@@ -333,12 +362,10 @@ EXPORT(SceUInt32, sceFiberRun, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<SceUIn
         log_fiber(*state, thread, fiber, "Run");
     }
 
-    setup_fiber_to_run(emuenv, thread, fiber, read_sp(*thread->cpu), argOnRunTo);
-    set_thread_context(*state, thread->id, save_context(*thread->cpu));
-    set_thread_fiber(*state, thread->id, fiber);
-
-    load_context(*thread->cpu, *fiber->cpu);
-    return fiber->cpu->cpu_registers[0];
+    save_callee_saved_context(*thread->cpu, fiber_thread.context);
+    fiber_thread.argOnReturn = argOnReturn;
+    fiber_thread.fiber = fiber;
+    return run_fiber(emuenv, *thread->cpu, *state, fiber, fiber_thread.context.sp, argOnRunTo);
 }
 
 EXPORT(int, sceFiberStartContextSizeCheck) {
@@ -355,8 +382,7 @@ EXPORT(SceUInt32, sceFiberSwitch, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<Sce
     TRACY_FUNC(sceFiberSwitch, fiber, argOnRunTo, argOnRun);
     const auto state = emuenv.kernel.obj_store.get<FiberState>();
     const std::lock_guard<std::mutex> lock(state->mutex);
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
-    auto ctx = get_thread_context(*state, thread->id);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     if (!fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_NULL);
     }
@@ -365,24 +391,19 @@ EXPORT(SceUInt32, sceFiberSwitch, SceFiber *fiber, SceUInt32 argOnRunTo, Ptr<Sce
         return RET_ERROR(SCE_FIBER_ERROR_STATE);
     }
 
-    SceFiber *thread_fiber = get_thread_fiber(*state, thread->id);
-    if (!thread_fiber) {
+    const auto it = state->threads.find(thread->id);
+    if ((it == state->threads.end()) || !it->second.fiber) {
         return RET_ERROR(SCE_FIBER_ERROR_PERMISSION);
     }
 
+    FiberThread &fiber_thread = it->second;
     if (LOG_FIBER) {
         log_fiber(*state, thread, fiber, "Switch");
     }
 
-    *thread_fiber->cpu = save_context(*thread->cpu);
-    thread_fiber->status = FiberStatus::SUSPEND;
-    thread_fiber->argOnRun = argOnRun;
-    thread_fiber->cpu->cpu_registers[0] = SCE_FIBER_OK;
-    set_thread_fiber(*state, thread->id, fiber);
-    setup_fiber_to_run(emuenv, thread, fiber, ctx.get_sp(), argOnRunTo);
-    load_context(*thread->cpu, *fiber->cpu);
-
-    return fiber->cpu->cpu_registers[0];
+    suspend_fiber(*thread->cpu, *state, fiber_thread.fiber, argOnRun);
+    fiber_thread.fiber = fiber;
+    return run_fiber(emuenv, *thread->cpu, *state, fiber, fiber_thread.context.sp, argOnRunTo);
 }
 
 BRIDGE_IMPL(_sceFiberAttachContextAndRun)
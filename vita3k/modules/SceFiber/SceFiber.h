@@ -47,12 +47,16 @@ enum class FiberStatus {
     RUN
 };
 
+// Context slot of a finalized fiber
+constexpr uint32_t SCE_FIBER_NO_CONTEXT = 0xFFFFFFFF;
+
 typedef struct SceFiber {
     Ptr<SceFiberEntry> entry;
     Address addrContext;
     SceSize sizeContext;
     char name[32];
-    CPUContext *cpu;
+    // Index of the slot of the fiber context in the library state
+    uint32_t context;
     SceUInt32 argOnInitialize;
     Ptr<uint32_t> argOnRun;
     FiberStatus status;
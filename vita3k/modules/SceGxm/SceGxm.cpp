@@ -31,6 +31,7 @@
 #include <SDL.h>
 #include <io/state.h>
 #include <mem/allocator.h>
+#include <mem/functions.h>
 #include <mem/mempool.h>
 #include <renderer/functions.h>
 #include <renderer/state.h>
@@ -890,7 +891,7 @@ static Ptr<void> gxmRunDeferredMemoryCallback(KernelState &kernel, const MemStat
     const std::uint32_t size, const SceUID thread_id) {
     const std::lock_guard<std::mutex> guard(global_lock);
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
     const Address final_size_addr = stack_alloc(*thread->cpu, 4);
 
     Ptr<void> result(static_cast<Address>(thread->run_callback(callback.address(),
@@ -930,6 +931,24 @@ struct SceGxmCommandList {
 // Seems on real vita, this is the maximum size, I got stack corrupt if try to write more
 static_assert(sizeof(SceGxmCommandList) - sizeof(std::stack<CommandListRange>) <= 32);
 
+// vertex buffer sizes computed by a precomputed draw, replayed while the draw, its program and its indices are unchanged
+struct PrecomputedDrawCache {
+    SceGxmPrecomputedDraw draw;
+    Ptr<const SceGxmVertexProgram> vertex_program;
+    uint64_t program_key_hash = 0;
+    std::array<size_t, SCE_GXM_MAX_VERTEX_STREAMS> max_data_length = {};
+    uint32_t stream_used = 0;
+
+    // cleared by the protection of the indices when they are written
+    std::shared_ptr<std::atomic<bool>> valid;
+    // the indices stop being protected once they have been written too many times, they are then scanned at each draw
+    uint32_t invalidation_count = 0;
+};
+
+// drop all the cached draws once there are that many of them, titles usually build a few precomputed draws once
+static constexpr size_t PRECOMPUTED_DRAW_CACHE_SIZE = 4096;
+static constexpr uint32_t PRECOMPUTED_DRAW_MAX_INVALIDATIONS = 4;
+
 struct SceGxmContext {
     GxmContextState state;
 
@@ -941,7 +960,6 @@ struct SceGxmContext {
     uint8_t *alloc_space = nullptr;
     uint8_t *alloc_space_end = nullptr;
 
-    BitmapAllocator command_allocator;
     bool last_precomputed = false;
 
     // this is used for deferred contexts
@@ -953,6 +971,9 @@ struct SceGxmContext {
     gxp::TextureInfo is_vert_texture_dirty;
     gxp::TextureInfo is_frag_texture_dirty;
 
+    // keyed by the address of the precomputed draw, only used without memory mapping
+    std::unordered_map<Address, PrecomputedDrawCache> precomputed_draws;
+
     explicit SceGxmContext(std::mutex &callback_lock_)
         : callback_lock(callback_lock_) {
     }
@@ -1039,10 +1060,7 @@ struct SceGxmContext {
             alloc_space = state.vdm_buffer.cast<std::uint8_t>().get(mem);
             actual_size = state.vdm_buffer_size;
 
-            if (state.type == SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
-                command_allocator.reset();
-                command_allocator.set_maximum(state.vdm_buffer_size / sizeof(renderer::Command));
-            } else {
+            if (state.type != SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
                 // setting the vdm buffer size to 0 means we are using it
                 state.vdm_buffer_size = 0;
             }
@@ -1091,44 +1109,16 @@ struct SceGxmContext {
         return reinterpret_cast<T *>(linearly_allocate(kern, mem, thread_id, sizeof(T)));
     }
 
+    // only used by deferred contexts, the immediate context allocates its commands from the arena of the renderer
     renderer::Command *allocate_new_command(KernelState &kern, const MemState &mem, SceUID current_thread_id) {
         const std::lock_guard<std::mutex> guard(lock);
-        renderer::Command *new_command = nullptr;
-
-        if (state.type == SCE_GXM_CONTEXT_TYPE_IMMEDIATE) {
-            int size = 1;
+        renderer::Command *new_command = linearly_allocate<renderer::Command>(kern, mem, current_thread_id);
 
-            int offset = command_allocator.allocate_from(0, size);
-
-            if (offset < 0) {
-                new_command = new renderer::Command;
-                new_command->flags |= renderer::Command::FLAG_FROM_HOST;
-            } else {
-                new_command = reinterpret_cast<renderer::Command *>(alloc_space) + offset;
-                new (new_command) renderer::Command;
-            }
-        } else {
-            new_command = linearly_allocate<renderer::Command>(kern, mem, current_thread_id);
-
-            new (new_command) renderer::Command;
-            new_command->flags |= renderer::Command::FLAG_NO_FREE;
-        }
+        new (new_command) renderer::Command;
+        new_command->flags |= renderer::Command::FLAG_NO_FREE;
 
         return new_command;
     }
-
-    void free_new_command(renderer::Command *cmd) {
-        if (!(cmd->flags & renderer::Command::FLAG_NO_FREE)) {
-            if (cmd->flags & renderer::Command::FLAG_FROM_HOST) {
-                delete cmd;
-            } else {
-                const std::lock_guard<std::mutex> guard(lock);
-
-                const std::uint32_t offset = static_cast<std::uint32_t>(cmd - reinterpret_cast<renderer::Command *>(alloc_space));
-                command_allocator.free(offset, 1);
-            }
-        }
-    }
 };
 
 struct SceGxmRenderTarget {
@@ -1139,21 +1129,26 @@ struct SceGxmRenderTarget {
     SceUID driverMemBlock;
 };
 
-typedef std::uint32_t VertexCacheHash;
+// The programs created by the shader patcher are cached by the XXH3 hash of their key, which is kept in the program
+// as key_hash. The entries with the same hash are told apart by comparing the whole key.
+// The key of a vertex program is its program, attributes and streams, compared with the ones in the program object
+typedef std::unordered_multimap<uint64_t, Ptr<SceGxmVertexProgram>> VertexProgramCache;
 
-struct VertexProgramCacheKey {
-    SceGxmRegisteredProgram vertex_program;
-    VertexCacheHash hash;
+struct FragmentProgramCacheKey {
+    Ptr<const SceGxmProgram> program;
+    SceGxmOutputRegisterFormat output_format;
+    SceGxmMultisampleMode multisample_mode;
+    SceGxmBlendInfo blend_info;
 };
 
-typedef std::map<VertexProgramCacheKey, Ptr<SceGxmVertexProgram>> VertexProgramCache;
+static_assert(sizeof(FragmentProgramCacheKey) == 16, "The key is hashed as bytes, it must not have padding.");
 
-struct FragmentProgramCacheKey {
-    SceGxmRegisteredProgram fragment_program;
-    SceGxmBlendInfo blend_info;
+struct FragmentProgramCacheEntry {
+    FragmentProgramCacheKey key;
+    Ptr<SceGxmFragmentProgram> program;
 };
 
-typedef std::map<FragmentProgramCacheKey, Ptr<SceGxmFragmentProgram>> FragmentProgramCache;
+typedef std::unordered_multimap<uint64_t, FragmentProgramCacheEntry> FragmentProgramCache;
 
 struct SceGxmShaderPatcher {
     VertexProgramCache vertex_program_cache;
@@ -1184,37 +1179,16 @@ static const uint8_t mask_gxp[] = {
 
 static constexpr std::uint32_t DEFAULT_RING_SIZE = 4096;
 
-static VertexCacheHash hash_data(const void *data, size_t size) {
-    auto hash = XXH_INLINE_XXH3_64bits(data, size);
-    return VertexCacheHash(hash);
-}
-
-static bool operator<(const SceGxmRegisteredProgram &a, const SceGxmRegisteredProgram &b) {
-    return a.program < b.program;
-}
-
-static bool operator<(const VertexProgramCacheKey &a, const VertexProgramCacheKey &b) {
-    if (a.vertex_program < b.vertex_program) {
-        return true;
-    }
-    if (b.vertex_program < a.vertex_program) {
-        return false;
-    }
-    return b.hash < a.hash;
-}
-
-static bool operator<(const SceGxmBlendInfo &a, const SceGxmBlendInfo &b) {
-    return memcmp(&a, &b, sizeof(a)) < 0;
+static uint64_t hash_vertex_program_key(Ptr<const SceGxmProgram> program, const SceGxmVertexAttribute *attributes, uint32_t attribute_count, const SceGxmVertexStream *streams, uint32_t stream_count) {
+    const uint64_t attributes_hash = XXH_INLINE_XXH3_64bits_withSeed(attributes, attributes ? sizeof(SceGxmVertexAttribute) * attribute_count : 0, program.address());
+    return XXH_INLINE_XXH3_64bits_withSeed(streams, streams ? sizeof(SceGxmVertexStream) * stream_count : 0, attributes_hash);
 }
 
-static bool operator<(const FragmentProgramCacheKey &a, const FragmentProgramCacheKey &b) {
-    if (a.fragment_program < b.fragment_program) {
-        return true;
-    }
-    if (b.fragment_program < a.fragment_program) {
-        return false;
-    }
-    return b.blend_info < a.blend_info;
+template <typename T>
+static bool is_same_array(const std::vector<T> &values, const T *data, uint32_t count) {
+    if (!data)
+        count = 0;
+    return (values.size() == count) && ((count == 0) || (memcmp(values.data(), data, sizeof(T) * count) == 0));
 }
 
 static int init_texture_base(const char *export_name, SceGxmTexture *texture, Ptr<const void> data, SceGxmTextureFormat tex_format, uint32_t width, uint32_t height, uint32_t mipCount,
@@ -1341,6 +1315,8 @@ static void gxmContextStateRestore(renderer::State &state, MemState &mem, SceGxm
         context->state.back_stencil.write_mask);
     renderer::set_stencil_ref(state, context->renderer.get(), true, context->state.front_stencil.ref);
     renderer::set_stencil_ref(state, context->renderer.get(), false, context->state.back_stencil.ref);
+    renderer::set_side_fragment_program_enable(state, context->renderer.get(), true, context->state.front_side_fragment_program_mode);
+    renderer::set_side_fragment_program_enable(state, context->renderer.get(), false, context->state.back_side_fragment_program_mode);
 
     if (context->state.vertex_program) {
         renderer::set_program(state, context->renderer.get(), context->state.vertex_program, false);
@@ -1404,14 +1380,11 @@ EXPORT(int, sceGxmBeginCommandList, SceGxmContext *deferredContext) {
     KernelState *kernel = &emuenv.kernel;
     MemState *mem = &emuenv.mem;
 
+    // commands are not freed after being processed, they will be deleted when they are overwritten
     deferredContext->renderer->alloc_func = [deferredContext, kernel, mem, thread_id]() {
         return deferredContext->allocate_new_command(*kernel, *mem, thread_id);
     };
 
-    deferredContext->renderer->free_func = [](renderer::Command *cmd) {
-        // do not delete here, commands will be deleted when they are overwritten
-    };
-
     // Begin the command list by white washing previous command list, and restoring deferred state
     renderer::reset_command_list(deferredContext->renderer->command_list);
     gxmContextStateRestore(*emuenv.renderer, emuenv.mem, deferredContext, false);
@@ -1713,18 +1686,7 @@ EXPORT(int, sceGxmCreateContext, const SceGxmContextParams *params, Ptr<SceGxmCo
 
     ctx->make_new_alloc_space(emuenv.kernel, emuenv.mem, thread_id);
 
-    // Set command allocate functions
-    // The command buffer will not be reallocated, so this is fine to use this thread ID
-    KernelState *kernel = &emuenv.kernel;
-    MemState *mem = &emuenv.mem;
-
-    ctx->renderer->alloc_func = [ctx, kernel, mem, thread_id]() {
-        return ctx->allocate_new_command(*kernel, *mem, thread_id);
-    };
-
-    ctx->renderer->free_func = [ctx](renderer::Command *cmd) {
-        return ctx->free_new_command(cmd);
-    };
+    ctx->renderer->command_arena = &emuenv.renderer->command_arena;
 
     return 0;
 }
@@ -1976,7 +1938,9 @@ EXPORT(int, sceGxmDisplayQueueAddEntry, Ptr<SceGxmSyncObject> oldBuffer, Ptr<Sce
     // function may be blocking here (expected behavior)
     emuenv.gxm.display_queue.push(display_callback);
 
+    emuenv.renderer->frames_queued++;
     renderer::send_single_command(*emuenv.renderer, nullptr, renderer::CommandOpcode::NewFrame, false);
+    emuenv.renderer->command_arena.end_frame();
 
     return 0;
 }
@@ -2047,9 +2011,6 @@ static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, c
 
     if (context->last_precomputed) {
         // Need to re-set the data
-        const auto frag_paramters = gxp::program_parameters(fragment_program_gxp);
-        const auto vert_paramters = gxp::program_parameters(vertex_program_gxp);
-
         renderer::set_program(*emuenv.renderer, context->renderer.get(), context->state.vertex_program, false);
         renderer::set_program(*emuenv.renderer, context->renderer.get(), context->state.fragment_program, true);
 
@@ -2181,9 +2142,24 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
 
     // Update vertex data. We should stores a copy of the data to pass it to GPU later, since another scene
     // may start to overwrite stuff when this scene is being processed in our queue (in case of OpenGL).
+    // we don't need to get the vertex buffer size with memory mapping
+    const bool compute_data_length = !emuenv.renderer->features.support_memory_mapping;
+    const Address draw_address = Ptr<SceGxmPrecomputedDraw>(draw, emuenv.mem).address();
+    PrecomputedDrawCache *cached_draw = nullptr;
+    bool cached_draw_valid = false;
+    if (compute_data_length) {
+        if (context->precomputed_draws.size() >= PRECOMPUTED_DRAW_CACHE_SIZE && !context->precomputed_draws.contains(draw_address))
+            context->precomputed_draws.clear();
+
+        cached_draw = &context->precomputed_draws[draw_address];
+        cached_draw_valid = cached_draw->valid && cached_draw->valid->load()
+            && memcmp(&cached_draw->draw, draw, sizeof(SceGxmPrecomputedDraw)) == 0
+            && cached_draw->vertex_program == vertex_program_gptr
+            && cached_draw->program_key_hash == vertex_program->key_hash;
+    }
+
     uint32_t max_index = 0;
-    if (!emuenv.renderer->features.support_memory_mapping) {
-        // we don't need to get the vertex buffer size with memory mapping
+    if (compute_data_length && !cached_draw_valid) {
         if (draw->index_format == SCE_GXM_INDEX_FORMAT_U16) {
             const uint16_t *const data = draw->index_data.cast<const uint16_t>().get(emuenv.mem);
             max_index = *std::max_element(&data[0], &data[draw->vertex_count]);
@@ -2212,18 +2188,48 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
 
     size_t max_data_length[SCE_GXM_MAX_VERTEX_STREAMS] = {};
     std::uint32_t stream_used = 0;
-    for (const SceGxmVertexAttribute &attribute : vertex_program->attributes) {
-        if (!emuenv.renderer->features.support_memory_mapping) {
-            const SceGxmAttributeFormat attribute_format = static_cast<SceGxmAttributeFormat>(attribute.format);
-            const size_t attribute_size = gxm::attribute_format_size(attribute_format) * attribute.componentCount;
-            const SceGxmVertexStream &stream = vertex_program->streams[attribute.streamIndex];
-            const SceGxmIndexSource index_source = static_cast<SceGxmIndexSource>(stream.indexSource);
-            const size_t data_passed_length = gxm::is_stream_instancing(index_source) ? ((draw->instance_count - 1) * stream.stride) : (max_index * stream.stride);
-            const size_t data_length = attribute.offset + data_passed_length + attribute_size;
-            max_data_length[attribute.streamIndex] = std::max<size_t>(max_data_length[attribute.streamIndex], data_length);
+    if (cached_draw_valid) {
+        std::copy(cached_draw->max_data_length.begin(), cached_draw->max_data_length.end(), max_data_length);
+        stream_used = cached_draw->stream_used;
+    } else {
+        for (const SceGxmVertexAttribute &attribute : vertex_program->attributes) {
+            if (compute_data_length) {
+                const SceGxmAttributeFormat attribute_format = static_cast<SceGxmAttributeFormat>(attribute.format);
+                const size_t attribute_size = gxm::attribute_format_size(attribute_format) * attribute.componentCount;
+                const SceGxmVertexStream &stream = vertex_program->streams[attribute.streamIndex];
+                const SceGxmIndexSource index_source = static_cast<SceGxmIndexSource>(stream.indexSource);
+                const size_t data_passed_length = gxm::is_stream_instancing(index_source) ? ((draw->instance_count - 1) * stream.stride) : (max_index * stream.stride);
+                const size_t data_length = attribute.offset + data_passed_length + attribute_size;
+                max_data_length[attribute.streamIndex] = std::max<size_t>(max_data_length[attribute.streamIndex], data_length);
+            }
+
+            stream_used |= (1 << attribute.streamIndex);
         }
+    }
 
-        stream_used |= (1 << attribute.streamIndex);
+    if (cached_draw && !cached_draw_valid) {
+        // the indices of the draw have been written since it was cached
+        if (cached_draw->valid && !cached_draw->valid->load())
+            cached_draw->invalidation_count++;
+
+        memcpy(&cached_draw->draw, draw, sizeof(SceGxmPrecomputedDraw));
+        cached_draw->vertex_program = vertex_program_gptr;
+        cached_draw->program_key_hash = vertex_program->key_hash;
+        std::copy(std::begin(max_data_length), std::end(max_data_length), cached_draw->max_data_length.begin());
+        cached_draw->stream_used = stream_used;
+
+        if (cached_draw->invalidation_count < PRECOMPUTED_DRAW_MAX_INVALIDATIONS) {
+            // the draw is replayed as long as its indices are not written
+            const std::shared_ptr<std::atomic<bool>> valid = std::make_shared<std::atomic<bool>>(true);
+            cached_draw->valid = valid;
+            const size_t index_size = (draw->index_format == SCE_GXM_INDEX_FORMAT_U16) ? sizeof(uint16_t) : sizeof(uint32_t);
+            add_protect(emuenv.mem, draw->index_data.address(), draw->vertex_count * index_size, MEM_PERM_READONLY, [valid](Address, bool) {
+                valid->store(false);
+                return true;
+            });
+        } else {
+            cached_draw->valid.reset();
+        }
     }
 
     auto stream_data = draw->stream_data.get(emuenv.mem);
@@ -2833,14 +2839,11 @@ EXPORT(int, sceGxmPrecomputedFragmentStateSetAllAuxiliarySurfaces) {
 
 EXPORT(int, sceGxmPrecomputedFragmentStateSetAllTextures, SceGxmPrecomputedFragmentState *state, Ptr<const SceGxmTexture> textures) {
     TRACY_FUNC(sceGxmPrecomputedFragmentStateSetAllTextures, state, textures);
-    if (!state || !textures) {
+    if (!state || !textures.valid_range(emuenv.mem, state->texture_count)) {
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
     }
 
-    const auto state_textures = state->textures.get(emuenv.mem);
-    for (int i = 0; i < state->texture_count; ++i) {
-        state_textures[i] = textures.get(emuenv.mem)[i];
-    }
+    std::copy_n(textures.get_unchecked(emuenv.mem), state->texture_count, state->textures.get_range(emuenv.mem, state->texture_count));
 
     return 0;
 }
@@ -2942,14 +2945,11 @@ EXPORT(int, sceGxmPrecomputedVertexStateInit, SceGxmPrecomputedVertexState *stat
 
 EXPORT(int, sceGxmPrecomputedVertexStateSetAllTextures, SceGxmPrecomputedVertexState *precomputedState, Ptr<const SceGxmTexture> textureArray) {
     TRACY_FUNC(sceGxmPrecomputedVertexStateSetAllTextures, precomputedState, textureArray);
-    if (!precomputedState || !textureArray) {
+    if (!precomputedState || !textureArray.valid_range(emuenv.mem, precomputedState->texture_count)) {
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
     }
 
-    const auto state_textures = precomputedState->textures.get(emuenv.mem);
-    for (int i = 0; i < precomputedState->texture_count; ++i) {
-        state_textures[i] = textureArray.get(emuenv.mem)[i];
-    }
+    std::copy_n(textureArray.get_unchecked(emuenv.mem), precomputedState->texture_count, precomputedState->textures.get_range(emuenv.mem, precomputedState->texture_count));
 
     return 0;
 }
@@ -3030,6 +3030,17 @@ EXPORT(int, sceGxmProgramCheck, const SceGxmProgram *program) {
     return 0;
 }
 
+// metadata of the program if it is registered, the queries walk the program otherwise
+static std::shared_ptr<const gxp::ProgramInfo> find_program_info(GxmState &gxm, const SceGxmProgram *program, const MemState &mem) {
+    const Address address = Ptr<const SceGxmProgram>(program, mem).address();
+    const std::lock_guard<std::mutex> guard(gxm.program_infos_mutex);
+    const auto it = gxm.program_infos.find(address);
+    if (it == gxm.program_infos.end())
+        return nullptr;
+
+    return it->second;
+}
+
 EXPORT(Ptr<SceGxmProgramParameter>, sceGxmProgramFindParameterByName, const SceGxmProgram *program, const char *name) {
     TRACY_FUNC(sceGxmProgramFindParameterByName, program, name);
     const MemState &mem = emuenv.mem;
@@ -3037,6 +3048,11 @@ EXPORT(Ptr<SceGxmProgramParameter>, sceGxmProgramFindParameterByName, const SceG
     if (!program || !name)
         return Ptr<SceGxmProgramParameter>();
 
+    if (const auto info = find_program_info(emuenv.gxm, program, mem)) {
+        const SceGxmProgramParameter *const parameter = info->find_parameter(name);
+        return parameter ? Ptr<SceGxmProgramParameter>(parameter, mem) : Ptr<SceGxmProgramParameter>();
+    }
+
     const SceGxmProgramParameter *const parameters = reinterpret_cast<const SceGxmProgramParameter *>(reinterpret_cast<const uint8_t *>(&program->parameters_offset) + program->parameters_offset);
     for (uint32_t i = 0; i < program->parameter_count; ++i) {
         const SceGxmProgramParameter *const parameter = &parameters[i];
@@ -3063,6 +3079,11 @@ EXPORT(Ptr<SceGxmProgramParameter>, sceGxmProgramFindParameterBySemantic, const
     if (!program)
         return Ptr<SceGxmProgramParameter>();
 
+    if (const auto info = find_program_info(emuenv.gxm, program, mem)) {
+        const SceGxmProgramParameter *const parameter = info->find_parameter(semantic, index);
+        return parameter ? Ptr<SceGxmProgramParameter>(parameter, mem) : Ptr<SceGxmProgramParameter>();
+    }
+
     const SceGxmProgramParameter *const parameters = reinterpret_cast<const SceGxmProgramParameter *>(reinterpret_cast<const uint8_t *>(&program->parameters_offset) + program->parameters_offset);
     for (uint32_t i = 0; i < program->parameter_count; ++i) {
         const SceGxmProgramParameter *const parameter = &parameters[i];
@@ -3089,6 +3110,8 @@ EXPORT(uint32_t, sceGxmProgramGetDefaultUniformBufferSize, const SceGxmProgram *
 EXPORT(uint32_t, sceGxmProgramGetFragmentProgramInputs, Ptr<const SceGxmProgram> program_) {
     TRACY_FUNC(sceGxmProgramGetFragmentProgramInputs, program_);
     const auto program = program_.get(emuenv.mem);
+    if (const auto info = find_program_info(emuenv.gxm, program, emuenv.mem))
+        return static_cast<uint32_t>(info->fragment_inputs);
 
     return static_cast<uint32_t>(gxp::get_fragment_inputs(*program));
 }
@@ -3138,6 +3161,8 @@ EXPORT(SceGxmProgramType, sceGxmProgramGetType, const SceGxmProgram *program) {
 EXPORT(uint32_t, sceGxmProgramGetVertexProgramOutputs, Ptr<const SceGxmProgram> program_) {
     TRACY_FUNC(sceGxmProgramGetVertexProgramOutputs, program_);
     const auto program = program_.get(emuenv.mem);
+    if (const auto info = find_program_info(emuenv.gxm, program, emuenv.mem))
+        return static_cast<uint32_t>(info->vertex_outputs);
 
     return static_cast<uint32_t>(gxp::get_vertex_outputs(*program));
 }
@@ -3377,6 +3402,8 @@ EXPORT(void, sceGxmSetBackDepthBias, SceGxmContext *context, int32_t factor, int
         if (context->alloc_space) {
             renderer::set_depth_bias(*emuenv.renderer, context->renderer.get(), false, factor, units);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3388,6 +3415,8 @@ EXPORT(void, sceGxmSetBackDepthFunc, SceGxmContext *context, SceGxmDepthFunc dep
         if (context->alloc_space) {
             renderer::set_depth_func(*emuenv.renderer, context->renderer.get(), false, depthFunc);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3399,12 +3428,19 @@ EXPORT(void, sceGxmSetBackDepthWriteEnable, SceGxmContext *context, SceGxmDepthW
         if (context->alloc_space) {
             renderer::set_depth_write_enable_mode(*emuenv.renderer, context->renderer.get(), false, enable);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
 EXPORT(void, sceGxmSetBackFragmentProgramEnable, SceGxmContext *context, SceGxmFragmentProgramMode enable) {
     TRACY_FUNC(sceGxmSetBackFragmentProgramEnable, context, enable);
-    renderer::set_side_fragment_program_enable(*emuenv.renderer, context->renderer.get(), false, enable);
+    if (context->state.back_side_fragment_program_mode != enable) {
+        context->state.back_side_fragment_program_mode = enable;
+        renderer::set_side_fragment_program_enable(*emuenv.renderer, context->renderer.get(), false, enable);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
+    }
 }
 
 EXPORT(void, sceGxmSetBackLineFillLastPixelEnable, SceGxmContext *context, SceGxmLineFillLastPixelMode enable) {
@@ -3420,6 +3456,8 @@ EXPORT(void, sceGxmSetBackPointLineWidth, SceGxmContext *context, uint32_t width
         if (context->alloc_space) {
             renderer::set_point_line_width(*emuenv.renderer, context->renderer.get(), false, width);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3431,6 +3469,8 @@ EXPORT(void, sceGxmSetBackPolygonMode, SceGxmContext *context, SceGxmPolygonMode
         if (context->alloc_space) {
             renderer::set_polygon_mode(*emuenv.renderer, context->renderer.get(), false, mode);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3455,6 +3495,8 @@ EXPORT(void, sceGxmSetBackStencilFunc, SceGxmContext *context, SceGxmStencilFunc
         if (context->alloc_space) {
             renderer::set_stencil_func(*emuenv.renderer, context->renderer.get(), false, func, stencilFail, depthFail, depthPass, compare_mask, write_mask);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3465,6 +3507,8 @@ EXPORT(void, sceGxmSetBackStencilRef, SceGxmContext *context, uint8_t sref) {
 
         if (context->alloc_space)
             renderer::set_stencil_ref(*emuenv.renderer, context->renderer.get(), false, sref);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3490,6 +3534,8 @@ EXPORT(void, sceGxmSetCullMode, SceGxmContext *context, SceGxmCullMode mode) {
 
         if (context->alloc_space)
             renderer::set_cull_mode(*emuenv.renderer, context->renderer.get(), mode);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3592,6 +3638,12 @@ EXPORT(void, sceGxmSetFragmentProgram, SceGxmContext *context, Ptr<const SceGxmF
     if (!context || !fragmentProgram)
         return;
 
+    // already set, the draws following a precomputed one send it again anyway
+    if (context->state.fragment_program == fragmentProgram) {
+        emuenv.renderer->state_set_commands_filtered++;
+        return;
+    }
+
     context->state.fragment_program = fragmentProgram;
     renderer::set_program(*emuenv.renderer, context->renderer.get(), fragmentProgram, true);
 }
@@ -3633,6 +3685,8 @@ EXPORT(void, sceGxmSetFrontDepthBias, SceGxmContext *context, int32_t factor, in
 
         if (context->alloc_space)
             renderer::set_depth_bias(*emuenv.renderer, context->renderer.get(), true, factor, units);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3644,6 +3698,8 @@ EXPORT(void, sceGxmSetFrontDepthFunc, SceGxmContext *context, SceGxmDepthFunc de
         if (context->alloc_space) {
             renderer::set_depth_func(*emuenv.renderer, context->renderer.get(), true, depthFunc);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3655,12 +3711,19 @@ EXPORT(void, sceGxmSetFrontDepthWriteEnable, SceGxmContext *context, SceGxmDepth
         if (context->alloc_space) {
             renderer::set_depth_write_enable_mode(*emuenv.renderer, context->renderer.get(), true, enable);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
 EXPORT(void, sceGxmSetFrontFragmentProgramEnable, SceGxmContext *context, SceGxmFragmentProgramMode enable) {
     TRACY_FUNC(sceGxmSetFrontFragmentProgramEnable, context, enable);
-    renderer::set_side_fragment_program_enable(*emuenv.renderer, context->renderer.get(), true, enable);
+    if (context->state.front_side_fragment_program_mode != enable) {
+        context->state.front_side_fragment_program_mode = enable;
+        renderer::set_side_fragment_program_enable(*emuenv.renderer, context->renderer.get(), true, enable);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
+    }
 }
 
 EXPORT(void, sceGxmSetFrontLineFillLastPixelEnable, SceGxmContext *context, SceGxmLineFillLastPixelMode enable) {
@@ -3676,6 +3739,8 @@ EXPORT(void, sceGxmSetFrontPointLineWidth, SceGxmContext *context, uint32_t widt
         if (context->alloc_space) {
             renderer::set_point_line_width(*emuenv.renderer, context->renderer.get(), true, width);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3687,6 +3752,8 @@ EXPORT(void, sceGxmSetFrontPolygonMode, SceGxmContext *context, SceGxmPolygonMod
         if (context->alloc_space) {
             renderer::set_polygon_mode(*emuenv.renderer, context->renderer.get(), true, mode);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3710,6 +3777,8 @@ EXPORT(void, sceGxmSetFrontStencilFunc, SceGxmContext *context, SceGxmStencilFun
 
         if (context->alloc_space)
             renderer::set_stencil_func(*emuenv.renderer, context->renderer.get(), true, func, stencilFail, depthFail, depthPass, compare_mask, write_mask);
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3720,6 +3789,8 @@ EXPORT(void, sceGxmSetFrontStencilRef, SceGxmContext *context, uint8_t sref) {
         if (context->alloc_space) {
             renderer::set_stencil_ref(*emuenv.renderer, context->renderer.get(), true, sref);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3777,7 +3848,9 @@ EXPORT(void, sceGxmSetRegionClip, SceGxmContext *context, SceGxmRegionClipMode m
         change_detected = true;
     }
 
-    if (change_detected && context->alloc_space)
+    if (!change_detected)
+        emuenv.renderer->state_set_commands_filtered++;
+    else if (context->alloc_space)
         renderer::set_region_clip(*emuenv.renderer, context->renderer.get(), mode, xMin, xMax, yMin, yMax);
 }
 
@@ -3789,6 +3862,8 @@ EXPORT(void, sceGxmSetTwoSidedEnable, SceGxmContext *context, SceGxmTwoSidedMode
         if (context->alloc_space) {
             renderer::set_two_sided_enable(*emuenv.renderer, context->renderer.get(), mode);
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -3955,6 +4030,12 @@ EXPORT(void, sceGxmSetVertexProgram, SceGxmContext *context, Ptr<const SceGxmVer
     if (!context || !vertexProgram)
         return;
 
+    // already set, the draws following a precomputed one send it again anyway
+    if (context->state.vertex_program == vertexProgram) {
+        emuenv.renderer->state_set_commands_filtered++;
+        return;
+    }
+
     context->state.vertex_program = vertexProgram;
     renderer::set_program(*emuenv.renderer, context->renderer.get(), vertexProgram, false);
 }
@@ -4024,6 +4105,8 @@ EXPORT(void, sceGxmSetViewport, SceGxmContext *context, float xOffset, float xSc
                 renderer::set_viewport_flat(*emuenv.renderer, context->renderer.get());
             }
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -4042,6 +4125,8 @@ EXPORT(void, sceGxmSetViewportEnable, SceGxmContext *context, SceGxmViewportMode
                     context->state.viewport.scale.z);
             }
         }
+    } else {
+        emuenv.renderer->state_set_commands_filtered++;
     }
 }
 
@@ -4178,15 +4263,21 @@ EXPORT(int, sceGxmShaderPatcherCreateFragmentProgram, SceGxmShaderPatcher *shade
         SCE_GXM_BLEND_FACTOR_ONE,
         SCE_GXM_BLEND_FACTOR_ZERO
     };
-    const FragmentProgramCacheKey key = {
-        *programId,
-        (blendInfo != nullptr) ? *blendInfo : default_blend_info
-    };
-    FragmentProgramCache::const_iterator cached = shaderPatcher->fragment_program_cache.find(key);
-    if (cached != shaderPatcher->fragment_program_cache.end()) {
-        ++cached->second.get(mem)->reference_count;
-        *fragmentProgram = cached->second;
-        return 0;
+    FragmentProgramCacheKey key;
+    memset(&key, 0, sizeof(key));
+    key.program = programId->program;
+    key.output_format = outputFormat;
+    key.multisample_mode = multisampleMode;
+    key.blend_info = (blendInfo != nullptr) ? *blendInfo : default_blend_info;
+    const uint64_t key_hash = XXH_INLINE_XXH3_64bits(&key, sizeof(key));
+
+    const auto [first, last] = shaderPatcher->fragment_program_cache.equal_range(key_hash);
+    for (auto cached = first; cached != last; ++cached) {
+        if (memcmp(&cached->second.key, &key, sizeof(key)) == 0) {
+            ++cached->second.program.get(mem)->reference_count;
+            *fragmentProgram = cached->second.program;
+            return 0;
+        }
     }
 
     *fragmentProgram = alloc_callbacked<SceGxmFragmentProgram>(emuenv, thread_id, shaderPatcher);
@@ -4198,12 +4289,13 @@ EXPORT(int, sceGxmShaderPatcherCreateFragmentProgram, SceGxmShaderPatcher *shade
     SceGxmFragmentProgram *const fp = fragmentProgram->get(mem);
     fp->is_maskupdate = false;
     fp->program = programId->program;
+    fp->key_hash = key_hash;
 
-    if (!renderer::create(fp->renderer_data, *emuenv.renderer, *programId->program.get(mem), blendInfo, emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
+    if (!renderer::create(fp->renderer_data, *emuenv.renderer, *programId->info, blendInfo, emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
         return RET_ERROR(SCE_GXM_ERROR_DRIVER);
     }
 
-    shaderPatcher->fragment_program_cache.emplace(key, *fragmentProgram);
+    shaderPatcher->fragment_program_cache.emplace(key_hash, FragmentProgramCacheEntry{ key, *fragmentProgram });
 
     return 0;
 }
@@ -4226,7 +4318,8 @@ EXPORT(int, sceGxmShaderPatcherCreateMaskUpdateFragmentProgram, SceGxmShaderPatc
     fp->program = Ptr<const SceGxmProgram>(alloc_callbacked(emuenv, thread_id, shaderPatcher->params, size_mask_gxp));
     memcpy(const_cast<SceGxmProgram *>(fp->program.get(mem)), mask_gxp, size_mask_gxp);
 
-    if (!renderer::create(fp->renderer_data, *emuenv.renderer, *fp->program.get(mem), nullptr, emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
+    const auto program_info = gxp::parse_program_info(*fp->program.get(mem));
+    if (!renderer::create(fp->renderer_data, *emuenv.renderer, *program_info, nullptr, emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
         return RET_ERROR(SCE_GXM_ERROR_DRIVER);
     }
 
@@ -4240,24 +4333,16 @@ EXPORT(int, sceGxmShaderPatcherCreateVertexProgram, SceGxmShaderPatcher *shaderP
     if (!shaderPatcher || !programId || !vertexProgram)
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
-    VertexProgramCacheKey key = {
-        *programId,
-        0
-    };
-
-    if (attributes) {
-        key.hash = hash_data(attributes, sizeof(SceGxmVertexAttribute) * attributeCount);
-    }
-
-    if (streams) {
-        key.hash ^= hash_data(streams, sizeof(SceGxmVertexStream) * streamCount);
-    }
-
-    VertexProgramCache::const_iterator cached = shaderPatcher->vertex_program_cache.find(key);
-    if (cached != shaderPatcher->vertex_program_cache.end()) {
-        ++cached->second.get(mem)->reference_count;
-        *vertexProgram = cached->second;
-        return 0;
+    const uint64_t key_hash = hash_vertex_program_key(programId->program, attributes, attributeCount, streams, streamCount);
+    const auto [first, last] = shaderPatcher->vertex_program_cache.equal_range(key_hash);
+    for (auto cached = first; cached != last; ++cached) {
+        SceGxmVertexProgram *const cached_vp = cached->second.get(mem);
+        if ((cached_vp->program == programId->program) && is_same_array(cached_vp->attributes, attributes, attributeCount)
+            && is_same_array(cached_vp->streams, streams, streamCount)) {
+            ++cached_vp->reference_count;
+            *vertexProgram = cached->second;
+            return 0;
+        }
     }
 
     *vertexProgram = alloc_callbacked<SceGxmVertexProgram>(emuenv, thread_id, shaderPatcher);
@@ -4268,7 +4353,7 @@ EXPORT(int, sceGxmShaderPatcherCreateVertexProgram, SceGxmShaderPatcher *shaderP
 
     SceGxmVertexProgram *const vp = vertexProgram->get(mem);
     vp->program = programId->program;
-    vp->key_hash = key.hash;
+    vp->key_hash = key_hash;
 
     if (streams && streamCount > 0) {
         vp->streams.insert(vp->streams.end(), &streams[0], &streams[streamCount]);
@@ -4278,11 +4363,11 @@ EXPORT(int, sceGxmShaderPatcherCreateVertexProgram, SceGxmShaderPatcher *shaderP
         vp->attributes.insert(vp->attributes.end(), &attributes[0], &attributes[attributeCount]);
     }
 
-    if (!renderer::create(vp->renderer_data, *emuenv.renderer, *programId->program.get(mem), emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
+    if (!renderer::create(vp->renderer_data, *emuenv.renderer, *programId->info, emuenv.renderer->gxp_ptr_map, emuenv.base_path.c_str(), emuenv.io.title_id.c_str())) {
         return RET_ERROR(SCE_GXM_ERROR_DRIVER);
     }
 
-    shaderPatcher->vertex_program_cache.emplace(key, *vertexProgram);
+    shaderPatcher->vertex_program_cache.emplace(key_hash, *vertexProgram);
 
     return 0;
 }
@@ -4372,6 +4457,11 @@ EXPORT(int, sceGxmShaderPatcherRegisterProgram, SceGxmShaderPatcher *shaderPatch
 
     SceGxmRegisteredProgram *const rp = programId->get(emuenv.mem);
     rp->program = programHeader;
+    // parse the program once, the program creations and queries then only read it
+    rp->info = gxp::parse_program_info(*programHeader.get(emuenv.mem));
+
+    const std::lock_guard<std::mutex> guard(emuenv.gxm.program_infos_mutex);
+    emuenv.gxm.program_infos[programHeader.address()] = rp->info;
 
     return 0;
 }
@@ -4384,8 +4474,9 @@ EXPORT(int, sceGxmShaderPatcherReleaseFragmentProgram, SceGxmShaderPatcher *shad
     SceGxmFragmentProgram *const fp = fragmentProgram.get(emuenv.mem);
     --fp->reference_count;
     if (fp->reference_count == 0) {
-        for (FragmentProgramCache::const_iterator it = shaderPatcher->fragment_program_cache.begin(); it != shaderPatcher->fragment_program_cache.end(); ++it) {
-            if (it->second == fragmentProgram) {
+        const auto [first, last] = shaderPatcher->fragment_program_cache.equal_range(fp->key_hash);
+        for (auto it = first; it != last; ++it) {
+            if (it->second.program == fragmentProgram) {
                 shaderPatcher->fragment_program_cache.erase(it);
                 break;
             }
@@ -4404,7 +4495,8 @@ EXPORT(int, sceGxmShaderPatcherReleaseVertexProgram, SceGxmShaderPatcher *shader
     SceGxmVertexProgram *const vp = vertexProgram.get(emuenv.mem);
     --vp->reference_count;
     if (vp->reference_count == 0) {
-        for (VertexProgramCache::const_iterator it = shaderPatcher->vertex_program_cache.begin(); it != shaderPatcher->vertex_program_cache.end(); ++it) {
+        const auto [first, last] = shaderPatcher->vertex_program_cache.equal_range(vp->key_hash);
+        for (auto it = first; it != last; ++it) {
             if (it->second == vertexProgram) {
                 shaderPatcher->vertex_program_cache.erase(it);
                 break;
@@ -4436,7 +4528,15 @@ EXPORT(int, sceGxmShaderPatcherUnregisterProgram, SceGxmShaderPatcher *shaderPat
         return RET_ERROR(SCE_GXM_ERROR_INVALID_POINTER);
 
     SceGxmRegisteredProgram *const rp = programId.get(emuenv.mem);
+    {
+        // the program may have been registered again by another shader patcher
+        const std::lock_guard<std::mutex> guard(emuenv.gxm.program_infos_mutex);
+        const auto it = emuenv.gxm.program_infos.find(rp->program.address());
+        if ((it != emuenv.gxm.program_infos.end()) && (it->second == rp->info))
+            emuenv.gxm.program_infos.erase(it);
+    }
     rp->program.reset();
+    rp->info.reset();
 
     free_callbacked(emuenv, thread_id, shaderPatcher, programId);
 
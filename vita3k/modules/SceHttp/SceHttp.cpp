@@ -25,6 +25,7 @@
 #define read(x, y, z) _read(x, y, z)
 #else
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
 #endif
 
@@ -36,6 +37,9 @@
 #include <util/net_utils.h>
 #include <util/tracy.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <string>
 #include <thread>
 
@@ -111,6 +115,127 @@ std::string to_debug_str<SceHttpsFlags>(const MemState &mem, SceHttpsFlags type)
     return out;
 }
 
+// deleted connections whose socket is kept alive for the next connections to the same host
+constexpr size_t MAX_IDLE_CONNECTIONS_PER_HOST = 4;
+constexpr auto IDLE_CONNECTION_TIMEOUT = std::chrono::seconds(30);
+// getaddrinfo doesn't give the TTL of the records
+constexpr auto RESOLVED_HOST_TTL = std::chrono::seconds(60);
+
+static bool is_idle_connection_alive(const int sockfd) {
+#ifdef WIN32
+    WSAPOLLFD fd{};
+    fd.fd = sockfd;
+    fd.events = POLLRDNORM;
+    const int ret = WSAPoll(&fd, 1, 0);
+#else
+    pollfd fd{ sockfd, POLLIN, 0 };
+    const int ret = poll(&fd, 1, 0);
+#endif
+    // an idle connection which can be read was closed by the server, or has data no request is waiting for
+    return ret == 0;
+}
+
+static void close_expired_connections(std::vector<SceIdleConnection> &idle) {
+    const auto now = std::chrono::steady_clock::now();
+    std::erase_if(idle, [&](const SceIdleConnection &conn) {
+        if (now - conn.idleSince < IDLE_CONNECTION_TIMEOUT)
+            return false;
+        close(conn.sockfd);
+        return true;
+    });
+}
+
+// return the socket of an idle connection which can be reused for the connection, or -1
+static int take_idle_connection(HTTPState &http, const std::string &pool_key, const SceTemplate &tmpl, const bool is_secure) {
+    const auto it = http.idleConnections.find(pool_key);
+    if (it == http.idleConnections.end())
+        return -1;
+
+    close_expired_connections(it->second);
+    while (!it->second.empty()) {
+        // the most recently used one is the most likely to still be open
+        const int sockfd = it->second.back().sockfd;
+        it->second.pop_back();
+        // the session of the template has to still be the one of the socket
+        const bool session_valid = !is_secure || (SSL_get_fd((SSL *)tmpl.ssl) == sockfd);
+        if (session_valid && is_idle_connection_alive(sockfd))
+            return sockfd;
+        close(sockfd);
+    }
+    return -1;
+}
+
+static void add_idle_connection(HTTPState &http, const std::string &pool_key, const int sockfd) {
+    auto &idle = http.idleConnections[pool_key];
+    close_expired_connections(idle);
+    if (idle.size() >= MAX_IDLE_CONNECTIONS_PER_HOST) {
+        close(idle.front().sockfd);
+        idle.erase(idle.begin());
+    }
+    idle.push_back({ sockfd, std::chrono::steady_clock::now() });
+}
+
+static void close_idle_connections(HTTPState &http, const std::string &pool_key_prefix) {
+    for (auto it = http.idleConnections.begin(); it != http.idleConnections.end();) {
+        if (it->first.starts_with(pool_key_prefix)) {
+            for (const SceIdleConnection &conn : it->second)
+                close(conn.sockfd);
+            it = http.idleConnections.erase(it);
+        } else
+            ++it;
+    }
+}
+
+static std::string get_template_pool_key(const SceInt tmplId) {
+    return std::to_string(tmplId) + "|";
+}
+
+// resolve the address of the host, it is cached for RESOLVED_HOST_TTL
+static int resolve_host(HTTPState &http, const std::string &hostname, const std::string &port, std::vector<uint8_t> &address) {
+    const std::string host = hostname + ":" + port;
+    const auto now = std::chrono::steady_clock::now();
+    const auto cached = http.resolvedHosts.find(host);
+    if ((cached != http.resolvedHosts.end()) && (now < cached->second.expires)) {
+        address = cached->second.address;
+        return 0;
+    }
+
+    const addrinfo hints = {
+        AI_PASSIVE, /* For wildcard IP address */
+        AF_UNSPEC, /* Allow IPv4 or IPv6 */
+        SOCK_DGRAM, /* Datagram socket */
+        0, /* Any protocol */
+    };
+    addrinfo *result = { 0 };
+
+    const auto ret = getaddrinfo(hostname.c_str(), port.c_str(), &hints, &result);
+    if (ret != 0)
+        return ret;
+
+    const uint8_t *const addr = reinterpret_cast<const uint8_t *>(result->ai_addr);
+    address.assign(addr, addr + result->ai_addrlen);
+    freeaddrinfo(result);
+
+    http.resolvedHosts[host] = { address, now + RESOLVED_HOST_TTL };
+    return 0;
+}
+
+// the server closes the connection after its response when it doesn't keep it alive
+static void update_keep_alive(SceConnection &conn, const SceRequestResponse &res) {
+    std::string connection_header;
+    for (const auto &[name, value] : res.headers) {
+        if ((name.size() == 10) && std::equal(name.begin(), name.end(), "connection", [](const char a, const char b) { return std::tolower(static_cast<unsigned char>(a)) == b; })) {
+            connection_header = value;
+            std::transform(connection_header.begin(), connection_header.end(), connection_header.begin(), [](const unsigned char c) { return std::tolower(c); });
+        }
+    }
+
+    // HTTP/1.0 connections are only kept alive when asked for
+    const bool is_http_1_0 = res.httpVer == "HTTP/1.0";
+    if ((connection_header.find("close") != std::string::npos) || (is_http_1_0 && (connection_header.find("keep-alive") == std::string::npos)))
+        conn.keepAlive = false;
+}
+
 EXPORT(int, sceHttpAbortRequest) {
     TRACY_FUNC(sceHttpAbortRequest);
     return UNIMPLEMENTED();
@@ -239,6 +364,16 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
         port = parsed.port;
     // If fifth character is an s (meaning https) use 443, else 80
 
+    const std::string poolKey = get_template_pool_key(tmplId) + parsed.scheme + "://" + parsed.hostname + ":" + port;
+    if (emuenv.cfg.http_enable && enableKeepalive) {
+        const int idleSockfd = take_idle_connection(emuenv.http, poolKey, tmpl->second, isSecure);
+        if (idleSockfd >= 0) {
+            LOG_TRACE("Reusing the kept alive connection to {}", url);
+            emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, idleSockfd, poolKey });
+            return connId;
+        }
+    }
+
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     assert(sockfd);
     if (sockfd < 0) {
@@ -248,25 +383,19 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
 
     if (!emuenv.cfg.http_enable) {
         // Need to push the connection here so the id exists when "sending" the request
-        emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
+        emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd, poolKey });
         return 0;
     }
 
-    const addrinfo hints = {
-        AI_PASSIVE, /* For wildcard IP address */
-        AF_UNSPEC, /* Allow IPv4 or IPv6 */
-        SOCK_DGRAM, /* Datagram socket */
-        0, /* Any protocol */
-    };
-    addrinfo *result = { 0 };
-
-    auto ret = getaddrinfo(parsed.hostname.c_str(), port.c_str(), &hints, &result);
-    if (ret < 0) {
+    std::vector<uint8_t> address;
+    auto ret = resolve_host(emuenv.http, parsed.hostname, port, address);
+    if (ret != 0) {
         LOG_ERROR("getaddrinfo({},{},...) = {}", url, port, ret);
+        close(sockfd);
         return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENODNS);
     }
 
-    ret = connect(sockfd, result->ai_addr, result->ai_addrlen);
+    ret = connect(sockfd, reinterpret_cast<const sockaddr *>(address.data()), static_cast<socklen_t>(address.size()));
     if (ret < 0) {
         LOG_ERROR("connect({},...) = {}, errno={}({})", sockfd, ret, errno, strerror(errno));
         return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENOHOST);
@@ -295,7 +424,7 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
             LOG_ERROR("Certificate verification error ({}) but continuing...\n", (int)verify_flag);
     }
 
-    emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
+    emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd, poolKey });
 
     return connId;
 }
@@ -533,7 +662,11 @@ EXPORT(SceInt, sceHttpDeleteConnection, SceInt connId) {
 
     auto connIt = emuenv.http.connections.find(connId);
 
-    close(connIt->second.sockfd);
+    // the next connection to the same host can reuse the socket, and its TLS session
+    if (connIt->second.keepAlive && emuenv.cfg.http_enable)
+        add_idle_connection(emuenv.http, connIt->second.poolKey, connIt->second.sockfd);
+    else
+        close(connIt->second.sockfd);
 
     emuenv.http.connections.erase(connIt);
 
@@ -569,6 +702,7 @@ EXPORT(SceInt, sceHttpDeleteTemplate, SceInt tmplId) {
 
     auto it = emuenv.http.templates.find(tmplId);
 
+    close_idle_connections(emuenv.http, get_template_pool_key(tmplId));
     SSL_free((SSL *)it->second.ssl);
 
     emuenv.http.templates.erase(it);
@@ -1049,6 +1183,7 @@ EXPORT(SceInt, sceHttpSendRequest, SceInt reqId, const char *postData, SceSize s
 
         // partialResponse is now the contents of the headers, we should parse them
         net_utils::parseResponse(reqResponseHeaders, req->second.res);
+        update_keep_alive(conn->second, req->second.res);
 
         break;
     }
@@ -1231,6 +1366,7 @@ EXPORT(SceInt, sceHttpSendRequest, SceInt reqId, const char *postData, SceSize s
 
         // partialResponse is now the contents of the headers, we should parse them
         net_utils::parseResponse(reqResponseHeaders, req->second.res);
+        update_keep_alive(conn->second, req->second.res);
 
         break;
     }
@@ -1425,6 +1561,9 @@ EXPORT(SceInt, sceHttpTerm) {
         free(emuenv.mem, pointer.address());
     }
 
+    close_idle_connections(emuenv.http, "");
+    emuenv.http.resolvedHosts.clear();
+
     return 0;
 }
 
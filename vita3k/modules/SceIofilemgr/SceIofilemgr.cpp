@@ -18,11 +18,107 @@
 #include "SceIofilemgr.h"
 
 #include <io/functions.h>
+#include <kernel/state.h>
+#include <kernel/sync_primitives.h>
 #include <kernel/types.h>
+#include <threads/job_pool.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <thread>
 
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceIofilemgr);
 
+// event pattern set once an asynchronous operation is done
+constexpr SceUInt32 IO_ASYNC_DONE_PATTERN = 1;
+
+struct IoAsyncOp {
+    SceUID id;
+    SceUID thread_id;
+    Ptr<SceIoAsyncParam> param;
+    std::function<int()> func;
+};
+
+// Asynchronous operations are run by a pool of host threads.
+// The ones using the same fd are run one after the other in the order they were submitted
+struct IoAsyncState {
+    std::mutex mutex;
+    // operations of each fd not done yet, the first one is running
+    std::map<SceUID, std::deque<IoAsyncOp>> fd_queues;
+    // operations not done yet
+    std::set<SceUID> pending;
+    // declared last so the workers are joined before the queues are destroyed
+    std::unique_ptr<JobPool> pool;
+};
+
+LIBRARY_INIT_IMPL(SceIofilemgr) {
+    emuenv.kernel.obj_store.create<IoAsyncState>();
+    const uint32_t thread_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+    emuenv.kernel.obj_store.get<IoAsyncState>()->pool = std::make_unique<JobPool>(thread_count);
+}
+LIBRARY_INIT_REGISTER(SceIofilemgr)
+
+static void finish_async_op(EmuEnvState &emuenv, IoAsyncState &state, const IoAsyncOp &op, const int result) {
+    if (op.param)
+        op.param.get(emuenv.mem)->result = result;
+
+    {
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        state.pending.erase(op.id);
+    }
+    simple_event_setorpulse(emuenv.kernel, "IoAsync", op.thread_id, op.id, IO_ASYNC_DONE_PATTERN, static_cast<SceUInt64>(result), true);
+}
+
+static void run_fd_queue(EmuEnvState &emuenv, IoAsyncState &state, const SceUID fd) {
+    while (true) {
+        IoAsyncOp op;
+        {
+            const std::lock_guard<std::mutex> lock(state.mutex);
+            op = state.fd_queues[fd].front();
+        }
+
+        finish_async_op(emuenv, state, op, op.func());
+
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        auto &queue = state.fd_queues[fd];
+        queue.pop_front();
+        if (queue.empty()) {
+            state.fd_queues.erase(fd);
+            return;
+        }
+    }
+}
+
+// Returns the uid of the event set once the operation is done, an operation without fd is run as soon as a thread is available
+static SceUID submit_async_op(EmuEnvState &emuenv, const char *export_name, const SceUID thread_id, const std::optional<SceUID> fd, const Ptr<SceIoAsyncParam> param, std::function<int()> func) {
+    const SceUID id = simple_event_create(emuenv.kernel, emuenv.mem, export_name, "SceIoAsync", thread_id, 0, 0);
+    if (id < 0)
+        return id;
+
+    IoAsyncState &state = *emuenv.kernel.obj_store.get<IoAsyncState>();
+    IoAsyncOp op{ id, thread_id, param, std::move(func) };
+
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    state.pending.insert(id);
+    if (!fd) {
+        state.pool->submit([&emuenv, &state, op = std::move(op)]() {
+            finish_async_op(emuenv, state, op, op.func());
+        });
+        return id;
+    }
+
+    auto &queue = state.fd_queues[*fd];
+    queue.push_back(std::move(op));
+    // otherwise the job already draining the queue of this fd runs it
+    if (queue.size() == 1)
+        state.pool->submit([&emuenv, &state, fd = *fd]() { run_fd_queue(emuenv, state, fd); });
+
+    return id;
+}
+
 EXPORT(int, _sceIoChstat) {
     TRACY_FUNC(_sceIoChstat);
     return UNIMPLEMENTED();
@@ -96,9 +192,15 @@ EXPORT(SceOff, _sceIoLseek, const SceUID fd, Ptr<_sceIoLseekOpt> opt) {
     return seek_file(fd, opt.get(emuenv.mem)->offset, opt.get(emuenv.mem)->whence, emuenv.io, export_name);
 }
 
-EXPORT(int, _sceIoLseekAsync) {
-    TRACY_FUNC(_sceIoLseekAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoLseekAsync, const SceUID fd, Ptr<_sceIoLseekOpt> opt, Ptr<SceIoAsyncParam> async_param) {
+    TRACY_FUNC(_sceIoLseekAsync, fd, opt, async_param);
+    if (!opt)
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    const SceOff offset = opt.get(emuenv.mem)->offset;
+    const SceIoSeekMode whence = opt.get(emuenv.mem)->whence;
+    return submit_async_op(emuenv, export_name, thread_id, fd, async_param, [&emuenv, fd, offset, whence]() {
+        return static_cast<int>(seek_file(fd, offset, whence, emuenv.io, "_sceIoLseekAsync"));
+    });
 }
 
 EXPORT(int, _sceIoMkdir, const char *dir, const SceMode mode) {
@@ -120,9 +222,15 @@ EXPORT(int, _sceIoOpen, const char *file, const int flags, const SceMode mode) {
     return open_file(emuenv.io, file, flags, emuenv.pref_path, export_name);
 }
 
-EXPORT(int, _sceIoOpenAsync) {
-    TRACY_FUNC(_sceIoOpenAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, _sceIoOpenAsync, const char *file, const int flags, const SceMode mode, Ptr<SceIoAsyncParam> async_param) {
+    TRACY_FUNC(_sceIoOpenAsync, file, flags, mode, async_param);
+    if (file == nullptr) {
+        return RET_ERROR(SCE_ERROR_ERRNO_EINVAL);
+    }
+    LOG_INFO("Opening file asynchronously: {}", file);
+    return submit_async_op(emuenv, export_name, thread_id, std::nullopt, async_param, [&emuenv, path = std::string(file), flags]() {
+        return open_file(emuenv.io, path.c_str(), flags, emuenv.pref_path, "_sceIoOpenAsync");
+    });
 }
 
 EXPORT(int, _sceIoPread) {
@@ -185,9 +293,36 @@ EXPORT(int, _sceIoSyncAsync) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceIoCancel) {
-    TRACY_FUNC(sceIoCancel);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoCancel, const SceUID async_id) {
+    TRACY_FUNC(sceIoCancel, async_id);
+    IoAsyncState &state = *emuenv.kernel.obj_store.get<IoAsyncState>();
+    IoAsyncOp cancelled_op;
+    {
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.pending.contains(async_id)) {
+            if (!emuenv.kernel.simple_events.get(async_id))
+                return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
+            // already done
+            return RET_ERROR(SCE_ERROR_ERRNO_EBUSY);
+        }
+
+        // only the operations still waiting behind another one of the same fd can be cancelled
+        bool found = false;
+        for (auto &[fd, queue] : state.fd_queues) {
+            const auto it = std::find_if(std::next(queue.begin()), queue.end(), [&](const IoAsyncOp &op) { return op.id == async_id; });
+            if (it != queue.end()) {
+                cancelled_op = std::move(*it);
+                queue.erase(it);
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return RET_ERROR(SCE_ERROR_ERRNO_EBUSY);
+    }
+
+    finish_async_op(emuenv, state, cancelled_op, SCE_ERROR_ERRNO_ECANCELED);
+    return 0;
 }
 
 EXPORT(int, sceIoChstatByFdAsync) {
@@ -200,14 +335,22 @@ EXPORT(int, sceIoClose, const SceUID fd) {
     return close_file(emuenv.io, fd, export_name);
 }
 
-EXPORT(int, sceIoCloseAsync) {
-    TRACY_FUNC(sceIoCloseAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoCloseAsync, const SceUID fd, Ptr<SceIoAsyncParam> async_param) {
+    TRACY_FUNC(sceIoCloseAsync, fd, async_param);
+    return submit_async_op(emuenv, export_name, thread_id, fd, async_param, [&emuenv, fd]() {
+        return close_file(emuenv.io, fd, "sceIoCloseAsync");
+    });
 }
 
-EXPORT(int, sceIoComplete) {
-    TRACY_FUNC(sceIoComplete);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoComplete, const SceUID async_id) {
+    TRACY_FUNC(sceIoComplete, async_id);
+    IoAsyncState &state = *emuenv.kernel.obj_store.get<IoAsyncState>();
+    {
+        const std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.pending.contains(async_id))
+            return RET_ERROR(SCE_ERROR_ERRNO_EBUSY);
+    }
+    return simple_event_delete(emuenv.kernel, export_name, thread_id, async_id);
 }
 
 EXPORT(int, sceIoDclose, const SceUID fd) {
@@ -275,9 +418,11 @@ EXPORT(int, sceIoRead, const SceUID fd, void *data, const SceSize size) {
     return read_file(data, emuenv.io, fd, size, export_name);
 }
 
-EXPORT(int, sceIoReadAsync) {
-    TRACY_FUNC(sceIoReadAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoReadAsync, const SceUID fd, void *data, const SceSize size, Ptr<SceIoAsyncParam> async_param) {
+    TRACY_FUNC(sceIoReadAsync, fd, data, size, async_param);
+    return submit_async_op(emuenv, export_name, thread_id, fd, async_param, [&emuenv, fd, data, size]() {
+        return read_file(data, emuenv.io, fd, size, "sceIoReadAsync");
+    });
 }
 
 EXPORT(int, sceIoSetPriority) {
@@ -305,9 +450,9 @@ EXPORT(int, sceIoSetThreadDefaultPriorityForSystem) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceIoSyncByFd) {
-    TRACY_FUNC(sceIoSyncByFd);
-    return UNIMPLEMENTED();
+EXPORT(int, sceIoSyncByFd, const SceUID fd, int flag) {
+    TRACY_FUNC(sceIoSyncByFd, fd, flag);
+    return sync_file(emuenv.io, fd, export_name);
 }
 
 EXPORT(int, sceIoSyncByFdAsync) {
@@ -320,9 +465,11 @@ EXPORT(int, sceIoWrite, const SceUID fd, const void *data, const SceSize size) {
     return write_file(fd, data, size, emuenv.io, export_name);
 }
 
-EXPORT(int, sceIoWriteAsync) {
-    TRACY_FUNC(sceIoWriteAsync);
-    return UNIMPLEMENTED();
+EXPORT(SceUID, sceIoWriteAsync, const SceUID fd, const void *data, const SceSize size, Ptr<SceIoAsyncParam> async_param) {
+    TRACY_FUNC(sceIoWriteAsync, fd, data, size, async_param);
+    return submit_async_op(emuenv, export_name, thread_id, fd, async_param, [&emuenv, fd, data, size]() {
+        return write_file(fd, data, size, emuenv.io, "sceIoWriteAsync");
+    });
 }
 
 BRIDGE_IMPL(_sceIoChstat)
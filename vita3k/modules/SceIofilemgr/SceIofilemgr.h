@@ -19,6 +19,7 @@
 
 #include <io/types.h>
 #include <module/module.h>
+#include <modules/module_parent.h>
 
 typedef struct _sceIoLseekOpt {
     SceOff offset;
@@ -26,12 +27,27 @@ typedef struct _sceIoLseekOpt {
     uint32_t unk;
 } _sceIoLseekOpt;
 
+// filled by the asynchronous operations once they are done
+typedef struct SceIoAsyncParam {
+    SceInt32 result; // uid, size read or written, offset or error code of the operation
+    SceInt32 unk_04;
+    SceInt32 unk_08;
+    SceInt32 unk_0C;
+    SceInt32 unk_10;
+    SceInt32 unk_14;
+} SceIoAsyncParam;
+
+constexpr int SCE_ERROR_ERRNO_EBUSY = 0x80010010; // The operation is still running
+constexpr int SCE_ERROR_ERRNO_ECANCELED = 0x8001008C; // The operation was cancelled before it started
+
 EXPORT(int, _sceIoDopen, const char *dir);
 EXPORT(int, _sceIoDread, const SceUID fd, SceIoDirent *dir);
 EXPORT(int, _sceIoMkdir, const char *dir, const SceMode mode);
 EXPORT(SceOff, _sceIoLseek, const SceUID fd, Ptr<_sceIoLseekOpt> opt);
 EXPORT(int, _sceIoGetstat, const char *file, SceIoStat *stat);
 
+LIBRARY_INIT_DECL(SceIofilemgr)
+
 BRIDGE_DECL(_sceIoChstat)
 BRIDGE_DECL(_sceIoChstatAsync)
 BRIDGE_DECL(_sceIoChstatByFd)
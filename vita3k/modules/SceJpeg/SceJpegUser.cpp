@@ -20,14 +20,16 @@
 #include <codec/state.h>
 #include <kernel/state.h>
 
+#include <algorithm>
+
 #include <util/tracy.h>
 TRACY_MODULE_NAME(SceJpegUser);
 
-typedef std::shared_ptr<DecoderState> DecoderPtr;
+typedef std::shared_ptr<MjpegDecoderState> MjpegDecoderPtr;
 
 struct MJpegState {
     bool initialized = false;
-    DecoderPtr decoder;
+    MjpegDecoderPtr decoder;
 };
 
 struct SceJpegMJpegInitInfo {
@@ -73,8 +75,7 @@ EXPORT(int, sceJpegDecodeMJpegYCbCr, const uint8_t *jpeg_data, uint32_t jpeg_siz
 
     DecoderSize size = {};
 
-    state->decoder->send(jpeg_data, jpeg_size);
-    state->decoder->receive(output, &size);
+    state->decoder->decode(jpeg_data, jpeg_size, output, output_size, &size);
 
     // Top 16 bits = width, bottom 16 bits = height.
     return (size.width << 16u) | size.height;
@@ -135,7 +136,8 @@ EXPORT(int, sceJpegMJpegCsc, uint8_t *rgba, const uint8_t *yuv,
     uint32_t width = size >> 16u;
     uint32_t height = size & (~0u >> 16u);
 
-    convert_yuv_to_rgb(yuv, rgba, width, height);
+    // image_width is the pitch of the output in pixels
+    convert_yuv_to_rgb(yuv, rgba, width, height, std::max<uint32_t>(image_width, width));
 
     return 0;
 }
@@ -17,12 +17,40 @@
 
 #include "SceDmacmgr.h"
 
-EXPORT(int, sceDmacMemcpy) {
-    return UNIMPLEMENTED();
+#include <mem/functions.h>
+#include <util/log.h>
+#include <util/tracy.h>
+
+#include <cstring>
+
+TRACY_MODULE_NAME(SceDmacmgr);
+
+// The transfers are blocking for the caller, so they are done right away on the calling thread.
+// The protected pages of the ranges are handled once before the copy instead of faulting on each of them.
+
+EXPORT(Ptr<void>, sceDmacMemcpy, Ptr<void> dst, Ptr<const void> src, SceSize size) {
+    TRACY_FUNC(sceDmacMemcpy, dst, src, size);
+    if (!is_valid_addr_range(emuenv.mem, src.address(), src.address() + size) || !is_valid_addr_range(emuenv.mem, dst.address(), dst.address() + size)) {
+        LOG_ERROR("Invalid range, dst: {}, src: {}, size: {}", log_hex(dst.address()), log_hex(src.address()), log_hex(size));
+        return Ptr<void>();
+    }
+
+    prepare_host_access(emuenv.mem, src.address(), size, false);
+    prepare_host_access(emuenv.mem, dst.address(), size, true);
+    memmove(dst.get(emuenv.mem), src.get(emuenv.mem), size);
+    return dst;
 }
 
-EXPORT(int, sceDmacMemset) {
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, sceDmacMemset, Ptr<void> dst, int c, SceSize size) {
+    TRACY_FUNC(sceDmacMemset, dst, c, size);
+    if (!is_valid_addr_range(emuenv.mem, dst.address(), dst.address() + size)) {
+        LOG_ERROR("Invalid range, dst: {}, size: {}", log_hex(dst.address()), log_hex(size));
+        return Ptr<void>();
+    }
+
+    prepare_host_access(emuenv.mem, dst.address(), size, true);
+    memset(dst.get(emuenv.mem), c, size);
+    return dst;
 }
 
 BRIDGE_IMPL(sceDmacMemcpy)
@@ -23,13 +23,152 @@
 #include <util/log.h>
 #include <util/tracy.h>
 
+#include <util/batched_sort.h>
+
 #include <dlmalloc.h>
 #include <v3kprintf.h>
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 TRACY_MODULE_NAME(SceLibc);
 
 Ptr<void> g_dso;
 
+// Small allocations are served by dlmalloc mspaces living inside page-allocated arenas,
+// so that they don't need to go through the page allocator each time.
+constexpr SceSize LIBC_HEAP_ARENA_SIZE = MiB(4);
+constexpr SceSize LIBC_HEAP_SMALL_SIZE_MAX = KiB(64);
+
+struct LibcHeapArena {
+    Address base;
+    SceSize size;
+    mspace space;
+};
+
+struct LibcHeapState {
+    std::mutex mutex;
+    // Sorted by base address, so the arena owning an address can be found quickly
+    std::map<Address, LibcHeapArena> arenas;
+    LibcHeapArena *last_arena = nullptr;
+};
+
+LIBRARY_INIT_IMPL(SceLibc) {
+    emuenv.kernel.obj_store.create<LibcHeapState>();
+}
+LIBRARY_INIT_REGISTER(SceLibc)
+
+static mspace create_guest_mspace(void *base, SceSize capacity) {
+    mspace space = create_mspace_with_base(base, capacity, 0);
+    // Do not let dlmalloc grow the space with host memory
+    if (space)
+        mspace_set_footprint_limit(space, capacity);
+
+    return space;
+}
+
+static LibcHeapArena *find_heap_arena(LibcHeapState &state, Address addr) {
+    auto it = state.arenas.upper_bound(addr);
+    if (it == state.arenas.begin())
+        return nullptr;
+
+    --it;
+    if (addr >= it->second.base + it->second.size)
+        return nullptr;
+
+    return &it->second;
+}
+
+static Address heap_alloc(EmuEnvState &emuenv, LibcHeapState &state, SceSize size, SceSize alignment, const char *name) {
+    if ((size > LIBC_HEAP_SMALL_SIZE_MAX) || (alignment > emuenv.mem.page_size))
+        return alignment ? alloc(emuenv.mem, size, name, alignment) : alloc(emuenv.mem, size, name);
+
+    const auto alloc_from_arena = [&](LibcHeapArena &arena) -> Address {
+        void *ptr = alignment ? mspace_memalign(arena.space, alignment, size) : mspace_malloc(arena.space, size);
+        if (!ptr)
+            return 0;
+
+        state.last_arena = &arena;
+        return Ptr<void>(ptr, emuenv.mem).address();
+    };
+
+    if (state.last_arena) {
+        if (const Address addr = alloc_from_arena(*state.last_arena))
+            return addr;
+    }
+
+    for (auto &[base, arena] : state.arenas) {
+        if (&arena == state.last_arena)
+            continue;
+
+        if (const Address addr = alloc_from_arena(arena))
+            return addr;
+    }
+
+    // Every arena is full, carve out a new one
+    const Address base = alloc(emuenv.mem, LIBC_HEAP_ARENA_SIZE, "SceLibc heap");
+    if (!base)
+        return 0;
+
+    mspace space = create_guest_mspace(Ptr<void>(base).get(emuenv.mem), LIBC_HEAP_ARENA_SIZE);
+    if (!space) {
+        free(emuenv.mem, base);
+        return 0;
+    }
+
+    LibcHeapArena &arena = state.arenas.emplace(base, LibcHeapArena{ base, LIBC_HEAP_ARENA_SIZE, space }).first->second;
+    return alloc_from_arena(arena);
+}
+
+static void heap_free(EmuEnvState &emuenv, LibcHeapState &state, Address addr) {
+    if (!addr)
+        return;
+
+    if (LibcHeapArena *arena = find_heap_arena(state, addr))
+        mspace_free(arena->space, Ptr<void>(addr).get(emuenv.mem));
+    else
+        free(emuenv.mem, addr);
+}
+
+static SceSize heap_usable_size(EmuEnvState &emuenv, LibcHeapState &state, Address addr) {
+    if (!addr)
+        return 0;
+
+    if (find_heap_arena(state, addr))
+        return static_cast<SceSize>(mspace_usable_size(Ptr<void>(addr).get(emuenv.mem)));
+
+    const MemPage &page = emuenv.mem.page_table[addr / emuenv.mem.page_size];
+    return static_cast<SceSize>(page.size * emuenv.mem.page_size - addr % emuenv.mem.page_size);
+}
+
+static Address heap_realloc(EmuEnvState &emuenv, LibcHeapState &state, Address addr, SceSize size, SceSize alignment, const char *name) {
+    if (!addr)
+        return heap_alloc(emuenv, state, size, alignment, name);
+
+    if (size == 0) {
+        heap_free(emuenv, state, addr);
+        return 0;
+    }
+
+    if ((alignment == 0) && (size <= LIBC_HEAP_SMALL_SIZE_MAX)) {
+        if (LibcHeapArena *arena = find_heap_arena(state, addr)) {
+            if (void *ptr = mspace_realloc(arena->space, Ptr<void>(addr).get(emuenv.mem), size))
+                return Ptr<void>(ptr, emuenv.mem).address();
+        }
+    }
+
+    const Address new_addr = heap_alloc(emuenv, state, size, alignment, name);
+    if (!new_addr)
+        return 0;
+
+    const SceSize copy_size = std::min(size, heap_usable_size(emuenv, state, addr));
+    memcpy(Ptr<void>(new_addr).get(emuenv.mem), Ptr<void>(addr).get(emuenv.mem), copy_size);
+    heap_free(emuenv, state, addr);
+
+    return new_addr;
+}
+
 EXPORT(int, _Assert) {
     TRACY_FUNC(_Assert);
     return UNIMPLEMENTED();
@@ -309,9 +448,25 @@ EXPORT(int, atoll) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, bsearch) {
-    TRACY_FUNC(bsearch);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, bsearch, Ptr<const void> key, Ptr<const void> base, SceSize nmemb, SceSize size, Ptr<void> compar) {
+    TRACY_FUNC(bsearch, key, base, nmemb, size, compar);
+    // each probe depends on the previous one, the comparisons can't be batched
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    SceSize low = 0;
+    SceSize high = nmemb;
+    while (low < high) {
+        const SceSize middle = low + (high - low) / 2;
+        const Address element = base.address() + middle * size;
+        const auto result = static_cast<int32_t>(thread->run_callback(compar.address(), { key.address(), element }));
+        if (result == 0)
+            return Ptr<void>(element);
+        if (result < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    return Ptr<void>();
 }
 
 EXPORT(int, bsearch_s) {
@@ -334,9 +489,21 @@ EXPORT(int, c32rtomb) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, calloc) {
-    TRACY_FUNC(calloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, calloc, SceSize num, SceSize size) {
+    TRACY_FUNC(calloc, num, size);
+    if (size && (num > std::numeric_limits<SceSize>::max() / size))
+        return Ptr<void>();
+
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    const SceSize total_size = num * size;
+    const Address addr = heap_alloc(emuenv, *state, total_size, 0, export_name);
+    // Pages coming from the page allocator are already cleared
+    if (addr && find_heap_arena(*state, addr))
+        memset(Ptr<void>(addr).get(emuenv.mem), 0, total_size);
+
+    return Ptr<void>(addr);
 }
 
 EXPORT(int, clearerr) {
@@ -477,7 +644,10 @@ EXPORT(int, fread) {
 
 EXPORT(void, free, Address mem) {
     TRACY_FUNC(free, mem);
-    free(emuenv.mem, mem);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    heap_free(emuenv, *state, mem);
 }
 
 EXPORT(int, freopen) {
@@ -760,9 +930,12 @@ EXPORT(int, longjmp) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, malloc, SceSize size) {
+EXPORT(Ptr<void>, malloc, SceSize size) {
     TRACY_FUNC(malloc, size);
-    return alloc(emuenv.mem, size, __FUNCTION__);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    return Ptr<void>(heap_alloc(emuenv, *state, size, 0, export_name));
 }
 
 EXPORT(int, malloc_stats) {
@@ -775,9 +948,12 @@ EXPORT(int, malloc_stats_fast) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, malloc_usable_size) {
-    TRACY_FUNC(malloc_usable_size);
-    return UNIMPLEMENTED();
+EXPORT(SceSize, malloc_usable_size, Address mem) {
+    TRACY_FUNC(malloc_usable_size, mem);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    return heap_usable_size(emuenv, *state, mem);
 }
 
 EXPORT(int, mblen) {
@@ -837,22 +1013,25 @@ EXPORT(int, mbtowc) {
 
 EXPORT(Ptr<void>, memalign, uint32_t alignment, uint32_t size) {
     TRACY_FUNC(memalign, alignment, size);
-    Address address = alloc(emuenv.mem, size, "memalign", alignment);
-
-    STUBBED("No actual alignment.");
-    LOG_WARN_IF(address % alignment != 0, "Address {} does not fit alignment of {}.", log_hex(address), alignment);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
 
-    return Ptr<void>(address);
+    return Ptr<void>(heap_alloc(emuenv, *state, size, alignment, export_name));
 }
 
-EXPORT(int, memchr) {
-    TRACY_FUNC(memchr);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, memchr, Ptr<const void> str, int c, SceSize n) {
+    TRACY_FUNC(memchr, str, c, n);
+    const uint8_t *host_str = str.cast<const uint8_t>().get_range(emuenv.mem, n);
+    const void *found = memchr(host_str, c, n);
+    if (!found)
+        return Ptr<void>();
+
+    return Ptr<void>(str.address() + static_cast<Address>(static_cast<const uint8_t *>(found) - host_str));
 }
 
-EXPORT(int, memcmp) {
-    TRACY_FUNC(memcmp);
-    return UNIMPLEMENTED();
+EXPORT(int, memcmp, const void *str1, const void *str2, SceSize num) {
+    TRACY_FUNC(memcmp, str1, str2, num);
+    return memcmp(str1, str2, num);
 }
 
 EXPORT(void, memcpy, void *destination, const void *source, uint32_t num) {
@@ -877,7 +1056,7 @@ EXPORT(int, memmove_s) {
 
 EXPORT(void, memset, Ptr<void> str, int c, uint32_t n) {
     TRACY_FUNC(memset, str, c, n);
-    memset(str.get(emuenv.mem), c, n);
+    memset(str.get_range(emuenv.mem, n), c, n);
 }
 
 EXPORT(int, mktime) {
@@ -885,14 +1064,22 @@ EXPORT(int, mktime) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_calloc) {
-    TRACY_FUNC(mspace_calloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_calloc, Ptr<void> space, SceSize num, SceSize size) {
+    TRACY_FUNC(mspace_calloc, space, num, size);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    void *address = mspace_calloc(space.get(emuenv.mem), num, size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
-EXPORT(int, mspace_create) {
-    TRACY_FUNC(mspace_create);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_create, Ptr<void> base, SceSize capacity) {
+    TRACY_FUNC(mspace_create, base, capacity);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    mspace space = create_guest_mspace(base.get(emuenv.mem), capacity);
+    return Ptr<void>(space, emuenv.mem);
 }
 
 EXPORT(int, mspace_create_internal) {
@@ -900,19 +1087,30 @@ EXPORT(int, mspace_create_internal) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_create_with_flag) {
-    TRACY_FUNC(mspace_create_with_flag);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_create_with_flag, Ptr<void> base, SceSize capacity, SceUInt32 flag) {
+    TRACY_FUNC(mspace_create_with_flag, base, capacity, flag);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    STUBBED("ignore flag");
+    mspace space = create_guest_mspace(base.get(emuenv.mem), capacity);
+    return Ptr<void>(space, emuenv.mem);
 }
 
-EXPORT(int, mspace_destroy) {
-    TRACY_FUNC(mspace_destroy);
-    return UNIMPLEMENTED();
+EXPORT(SceSize, mspace_destroy, Ptr<void> space) {
+    TRACY_FUNC(mspace_destroy, space);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    return static_cast<SceSize>(destroy_mspace(space.get(emuenv.mem)));
 }
 
-EXPORT(int, mspace_free) {
-    TRACY_FUNC(mspace_free);
-    return UNIMPLEMENTED();
+EXPORT(void, mspace_free, Ptr<void> space, Ptr<void> address) {
+    TRACY_FUNC(mspace_free, space, address);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    mspace_free(space.get(emuenv.mem), address.get(emuenv.mem));
 }
 
 EXPORT(int, mspace_is_heap_empty) {
@@ -920,9 +1118,13 @@ EXPORT(int, mspace_is_heap_empty) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_malloc) {
-    TRACY_FUNC(mspace_malloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_malloc, Ptr<void> space, SceSize size) {
+    TRACY_FUNC(mspace_malloc, space, size);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    void *address = mspace_malloc(space.get(emuenv.mem), size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
 EXPORT(int, mspace_malloc_stats) {
@@ -935,19 +1137,30 @@ EXPORT(int, mspace_malloc_stats_fast) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, mspace_malloc_usable_size) {
-    TRACY_FUNC(mspace_malloc_usable_size);
-    return UNIMPLEMENTED();
+EXPORT(SceSize, mspace_malloc_usable_size, Ptr<void> address) {
+    TRACY_FUNC(mspace_malloc_usable_size, address);
+    if (!address)
+        return 0;
+
+    return static_cast<SceSize>(mspace_usable_size(address.get(emuenv.mem)));
 }
 
-EXPORT(int, mspace_memalign) {
-    TRACY_FUNC(mspace_memalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_memalign, Ptr<void> space, SceSize alignment, SceSize size) {
+    TRACY_FUNC(mspace_memalign, space, alignment, size);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    void *address = mspace_memalign(space.get(emuenv.mem), alignment, size);
+    return Ptr<void>(address, emuenv.mem);
 }
 
-EXPORT(int, mspace_realloc) {
-    TRACY_FUNC(mspace_realloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, mspace_realloc, Ptr<void> space, Ptr<void> address, SceSize size) {
+    TRACY_FUNC(mspace_realloc, space, address, size);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    void *new_address = mspace_realloc(space.get(emuenv.mem), address.get(emuenv.mem), size);
+    return Ptr<void>(new_address, emuenv.mem);
 }
 
 EXPORT(int, mspace_reallocalign) {
@@ -965,7 +1178,7 @@ EXPORT(int, printf, const char *format, module::vargs args) {
     // TODO: add args to tracy func
     std::vector<char> buffer(1024);
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
 
     if (!thread) {
         return SCE_KERNEL_ERROR_UNKNOWN_THREAD_ID;
@@ -1012,9 +1225,27 @@ EXPORT(int, putwchar) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, qsort) {
-    TRACY_FUNC(qsort);
-    return UNIMPLEMENTED();
+EXPORT(void, qsort, Ptr<void> base, SceSize nmemb, SceSize size, Ptr<void> compar) {
+    TRACY_FUNC(qsort, base, nmemb, size, compar);
+    if ((nmemb < 2) || (size == 0))
+        return;
+
+    // the elements stay in place while they are compared, so the comparator always gets pointers into the array,
+    // and the comparisons are queued on the thread to switch to the guest once per batch
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    const Address address = base.address();
+    const std::vector<uint32_t> order = util::batched_merge_sort(
+        nmemb,
+        [&](uint32_t a, uint32_t b, int32_t *result) {
+            thread->queue_callback(compar.address(), { address + a * size, address + b * size }, reinterpret_cast<uint32_t *>(result));
+        },
+        [&]() { thread->run_queued_callbacks(); });
+
+    uint8_t *elements = base.cast<uint8_t>().get_range(emuenv.mem, static_cast<size_t>(nmemb) * size);
+    std::vector<uint8_t> sorted(static_cast<size_t>(nmemb) * size);
+    for (SceSize i = 0; i < nmemb; i++)
+        memcpy(&sorted[static_cast<size_t>(i) * size], elements + static_cast<size_t>(order[i]) * size, size);
+    memcpy(elements, sorted.data(), sorted.size());
 }
 
 EXPORT(int, qsort_s) {
@@ -1037,14 +1268,20 @@ EXPORT(int, rand_r) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, realloc) {
-    TRACY_FUNC(realloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, realloc, Address mem, SceSize size) {
+    TRACY_FUNC(realloc, mem, size);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    return Ptr<void>(heap_realloc(emuenv, *state, mem, size, 0, export_name));
 }
 
-EXPORT(int, reallocalign) {
-    TRACY_FUNC(reallocalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, reallocalign, Address mem, SceSize size, SceSize alignment) {
+    TRACY_FUNC(reallocalign, mem, size, alignment);
+    const auto state = emuenv.kernel.obj_store.get<LibcHeapState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+
+    return Ptr<void>(heap_realloc(emuenv, *state, mem, size, alignment, export_name));
 }
 
 EXPORT(int, remove) {
@@ -1169,7 +1406,7 @@ EXPORT(int, strcasecmp) {
 
 EXPORT(Ptr<char>, strcat, Ptr<char> destination, Ptr<char> source) {
     TRACY_FUNC(strcat, destination, source);
-    strcat(destination.get(emuenv.mem), source.get(emuenv.mem));
+    strcat(destination.get_unchecked(emuenv.mem), source.get_unchecked(emuenv.mem));
     return destination;
 }
 
@@ -1178,14 +1415,19 @@ EXPORT(int, strcat_s) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, strchr) {
-    TRACY_FUNC(strchr);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<char>, strchr, Ptr<const char> str, int c) {
+    TRACY_FUNC(strchr, str, c);
+    const char *host_str = str.get_unchecked(emuenv.mem);
+    const char *found = strchr(host_str, c);
+    if (!found)
+        return Ptr<char>();
+
+    return Ptr<char>(str.address() + static_cast<Address>(found - host_str));
 }
 
-EXPORT(int, strcmp) {
-    TRACY_FUNC(strcmp);
-    return UNIMPLEMENTED();
+EXPORT(int, strcmp, const char *str1, const char *str2) {
+    TRACY_FUNC(strcmp, str1, str2);
+    return strcmp(str1, str2);
 }
 
 EXPORT(int, strcoll) {
@@ -1195,7 +1437,7 @@ EXPORT(int, strcoll) {
 
 EXPORT(Ptr<char>, strcpy, Ptr<char> destination, Ptr<char> source) {
     TRACY_FUNC(strcpy, destination, source);
-    strcpy(destination.get(emuenv.mem), source.get(emuenv.mem));
+    strcpy(destination.get_unchecked(emuenv.mem), source.get_unchecked(emuenv.mem));
     return destination;
 }
 
@@ -1261,7 +1503,7 @@ EXPORT(int, strncmp, const char *str1, const char *str2, SceSize num) {
 
 EXPORT(Ptr<char>, strncpy, Ptr<char> destination, Ptr<char> source, SceSize size) {
     TRACY_FUNC(strncpy, destination, source, size);
-    strncpy(destination.get(emuenv.mem), source.get(emuenv.mem), size);
+    strncpy(destination.get_range(emuenv.mem, size), source.get_unchecked(emuenv.mem), size);
     return destination;
 }
 
@@ -1282,17 +1524,12 @@ EXPORT(int, strpbrk) {
 
 EXPORT(Ptr<char>, strrchr, Ptr<char> str, char ch) {
     TRACY_FUNC(strrchr, str, ch);
-    Ptr<char> res = Ptr<char>();
-    char *_str = str.get(emuenv.mem);
-    for (int i = static_cast<int>(strlen(_str) - 1); i >= 0; i--) {
-        const char ch1 = _str[i];
-        if (ch1 == ch) {
-            res = str + i * sizeof(char);
-            break;
-        }
-    }
+    const char *host_str = str.get_unchecked(emuenv.mem);
+    const char *found = strrchr(host_str, ch);
+    if (!found)
+        return Ptr<char>();
 
-    return res;
+    return Ptr<char>(str.address() + static_cast<Address>(found - host_str));
 }
 
 EXPORT(int, strspn) {
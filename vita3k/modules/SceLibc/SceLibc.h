@@ -18,6 +18,7 @@
 #pragma once
 
 #include <module/module.h>
+#include <modules/module_parent.h>
 
 BRIDGE_DECL(_Assert)
 BRIDGE_DECL(_Btowc)
@@ -18,8 +18,14 @@
 #include "SceLibm.h"
 
 #include <util/tracy.h>
+
+#include <cmath>
+
 TRACY_MODULE_NAME(SceLibm);
 
+// The math functions taking and returning only floating-point values are leaf exports, called straight from
+// the import dispatch. long double is the same as double on the Vita, the l functions use the double ones.
+
 EXPORT(int, _Cosh) {
     return UNIMPLEMENTED();
 }
@@ -144,292 +150,292 @@ EXPORT(int, _Sinx) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, acos) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, acos, double x) {
+    return acos(x);
 }
 
-EXPORT(int, acosf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, acosf, float x) {
+    return acosf(x);
 }
 
-EXPORT(int, acosh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, acosh, double x) {
+    return acosh(x);
 }
 
-EXPORT(int, acoshf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, acoshf, float x) {
+    return acoshf(x);
 }
 
-EXPORT(int, acoshl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, acoshl, double x) {
+    return acosh(x);
 }
 
-EXPORT(int, acosl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, acosl, double x) {
+    return acos(x);
 }
 
-EXPORT(int, asin) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, asin, double x) {
+    return asin(x);
 }
 
-EXPORT(int, asinf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, asinf, float x) {
+    return asinf(x);
 }
 
-EXPORT(int, asinh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, asinh, double x) {
+    return asinh(x);
 }
 
-EXPORT(int, asinhf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, asinhf, float x) {
+    return asinhf(x);
 }
 
-EXPORT(int, asinhl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, asinhl, double x) {
+    return asinh(x);
 }
 
-EXPORT(int, asinl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, asinl, double x) {
+    return asin(x);
 }
 
-EXPORT(int, atan) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atan, double x) {
+    return atan(x);
 }
 
-EXPORT(int, atan2) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atan2, double x, double y) {
+    return atan2(x, y);
 }
 
-EXPORT(int, atan2f) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, atan2f, float x, float y) {
+    return atan2f(x, y);
 }
 
-EXPORT(int, atan2l) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atan2l, double x, double y) {
+    return atan2(x, y);
 }
 
-EXPORT(int, atanf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, atanf, float x) {
+    return atanf(x);
 }
 
-EXPORT(int, atanh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atanh, double x) {
+    return atanh(x);
 }
 
-EXPORT(int, atanhf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, atanhf, float x) {
+    return atanhf(x);
 }
 
-EXPORT(int, atanhl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atanhl, double x) {
+    return atanh(x);
 }
 
-EXPORT(int, atanl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, atanl, double x) {
+    return atan(x);
 }
 
-EXPORT(int, cbrt) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, cbrt, double x) {
+    return cbrt(x);
 }
 
-EXPORT(int, cbrtf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, cbrtf, float x) {
+    return cbrtf(x);
 }
 
-EXPORT(int, cbrtl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, cbrtl, double x) {
+    return cbrt(x);
 }
 
-EXPORT(int, ceil) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, ceil, double x) {
+    return ceil(x);
 }
 
-EXPORT(int, ceilf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, ceilf, float x) {
+    return ceilf(x);
 }
 
-EXPORT(int, ceill) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, ceill, double x) {
+    return ceil(x);
 }
 
-EXPORT(int, copysign) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, copysign, double x, double y) {
+    return copysign(x, y);
 }
 
-EXPORT(int, copysignf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, copysignf, float x, float y) {
+    return copysignf(x, y);
 }
 
-EXPORT(int, copysignl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, copysignl, double x, double y) {
+    return copysign(x, y);
 }
 
-EXPORT(int, cos) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, cos, double x) {
+    return cos(x);
 }
 
-EXPORT(int, cosf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, cosf, float x) {
+    return cosf(x);
 }
 
-EXPORT(int, cosh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, cosh, double x) {
+    return cosh(x);
 }
 
-EXPORT(int, coshf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, coshf, float x) {
+    return coshf(x);
 }
 
-EXPORT(int, coshl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, coshl, double x) {
+    return cosh(x);
 }
 
-EXPORT(int, cosl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, cosl, double x) {
+    return cos(x);
 }
 
-EXPORT(int, erf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, erf, double x) {
+    return erf(x);
 }
 
-EXPORT(int, erfc) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, erfc, double x) {
+    return erfc(x);
 }
 
-EXPORT(int, erfcf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, erfcf, float x) {
+    return erfcf(x);
 }
 
-EXPORT(int, erfcl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, erfcl, double x) {
+    return erfc(x);
 }
 
-EXPORT(int, erff) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, erff, float x) {
+    return erff(x);
 }
 
-EXPORT(int, erfl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, erfl, double x) {
+    return erf(x);
 }
 
-EXPORT(int, exp) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, exp, double x) {
+    return exp(x);
 }
 
-EXPORT(int, exp2) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, exp2, double x) {
+    return exp2(x);
 }
 
-EXPORT(int, exp2f) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, exp2f, float x) {
+    return exp2f(x);
 }
 
-EXPORT(int, exp2l) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, exp2l, double x) {
+    return exp2(x);
 }
 
-EXPORT(int, expf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, expf, float x) {
+    return expf(x);
 }
 
-EXPORT(int, expl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, expl, double x) {
+    return exp(x);
 }
 
-EXPORT(int, expm1) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, expm1, double x) {
+    return expm1(x);
 }
 
-EXPORT(int, expm1f) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, expm1f, float x) {
+    return expm1f(x);
 }
 
-EXPORT(int, expm1l) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, expm1l, double x) {
+    return expm1(x);
 }
 
-EXPORT(int, fabs) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fabs, double x) {
+    return fabs(x);
 }
 
-EXPORT(int, fabsf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fabsf, float x) {
+    return fabsf(x);
 }
 
-EXPORT(int, fabsl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fabsl, double x) {
+    return fabs(x);
 }
 
-EXPORT(int, fdim) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fdim, double x, double y) {
+    return fdim(x, y);
 }
 
-EXPORT(int, fdimf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fdimf, float x, float y) {
+    return fdimf(x, y);
 }
 
-EXPORT(int, fdiml) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fdiml, double x, double y) {
+    return fdim(x, y);
 }
 
-EXPORT(int, floor) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, floor, double x) {
+    return floor(x);
 }
 
-EXPORT(int, floorf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, floorf, float x) {
+    return floorf(x);
 }
 
-EXPORT(int, floorl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, floorl, double x) {
+    return floor(x);
 }
 
-EXPORT(int, fma) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fma, double x, double y, double z) {
+    return fma(x, y, z);
 }
 
-EXPORT(int, fmaf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fmaf, float x, float y, float z) {
+    return fmaf(x, y, z);
 }
 
-EXPORT(int, fmal) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmal, double x, double y, double z) {
+    return fma(x, y, z);
 }
 
-EXPORT(int, fmax) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmax, double x, double y) {
+    return fmax(x, y);
 }
 
-EXPORT(int, fmaxf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fmaxf, float x, float y) {
+    return fmaxf(x, y);
 }
 
-EXPORT(int, fmaxl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmaxl, double x, double y) {
+    return fmax(x, y);
 }
 
-EXPORT(int, fmin) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmin, double x, double y) {
+    return fmin(x, y);
 }
 
-EXPORT(int, fminf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fminf, float x, float y) {
+    return fminf(x, y);
 }
 
-EXPORT(int, fminl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fminl, double x, double y) {
+    return fmin(x, y);
 }
 
-EXPORT(int, fmod) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmod, double x, double y) {
+    return fmod(x, y);
 }
 
-EXPORT(int, fmodf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, fmodf, float x, float y) {
+    return fmodf(x, y);
 }
 
-EXPORT(int, fmodl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, fmodl, double x, double y) {
+    return fmod(x, y);
 }
 
 EXPORT(int, frexp) {
@@ -444,16 +450,16 @@ EXPORT(int, frexpl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, hypot) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, hypot, double x, double y) {
+    return hypot(x, y);
 }
 
-EXPORT(int, hypotf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, hypotf, float x, float y) {
+    return hypotf(x, y);
 }
 
-EXPORT(int, hypotl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, hypotl, double x, double y) {
+    return hypot(x, y);
 }
 
 EXPORT(int, ilogb) {
@@ -480,16 +486,16 @@ EXPORT(int, ldexpl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, lgamma) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, lgamma, double x) {
+    return lgamma(x);
 }
 
-EXPORT(int, lgammaf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, lgammaf, float x) {
+    return lgammaf(x);
 }
 
-EXPORT(int, lgammal) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, lgammal, double x) {
+    return lgamma(x);
 }
 
 EXPORT(int, llrint) {
@@ -516,64 +522,64 @@ EXPORT(int, llroundl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, log) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log, double x) {
+    return log(x);
 }
 
-EXPORT(int, log10) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log10, double x) {
+    return log10(x);
 }
 
-EXPORT(int, log10f) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, log10f, float x) {
+    return log10f(x);
 }
 
-EXPORT(int, log10l) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log10l, double x) {
+    return log10(x);
 }
 
-EXPORT(int, log1p) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log1p, double x) {
+    return log1p(x);
 }
 
-EXPORT(int, log1pf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, log1pf, float x) {
+    return log1pf(x);
 }
 
-EXPORT(int, log1pl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log1pl, double x) {
+    return log1p(x);
 }
 
-EXPORT(int, log2) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log2, double x) {
+    return log2(x);
 }
 
-EXPORT(int, log2f) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, log2f, float x) {
+    return log2f(x);
 }
 
-EXPORT(int, log2l) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, log2l, double x) {
+    return log2(x);
 }
 
-EXPORT(int, logb) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, logb, double x) {
+    return logb(x);
 }
 
-EXPORT(int, logbf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, logbf, float x) {
+    return logbf(x);
 }
 
-EXPORT(int, logbl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, logbl, double x) {
+    return logb(x);
 }
 
-EXPORT(int, logf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, logf, float x) {
+    return logf(x);
 }
 
-EXPORT(int, logl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, logl, double x) {
+    return log(x);
 }
 
 EXPORT(int, lrint) {
@@ -624,28 +630,28 @@ EXPORT(int, nanl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, nearbyint) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, nearbyint, double x) {
+    return nearbyint(x);
 }
 
-EXPORT(int, nearbyintf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, nearbyintf, float x) {
+    return nearbyintf(x);
 }
 
-EXPORT(int, nearbyintl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, nearbyintl, double x) {
+    return nearbyint(x);
 }
 
-EXPORT(int, nextafter) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, nextafter, double x, double y) {
+    return nextafter(x, y);
 }
 
-EXPORT(int, nextafterf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, nextafterf, float x, float y) {
+    return nextafterf(x, y);
 }
 
-EXPORT(int, nextafterl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, nextafterl, double x, double y) {
+    return nextafter(x, y);
 }
 
 EXPORT(int, nexttoward) {
@@ -660,28 +666,28 @@ EXPORT(int, nexttowardl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, pow) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, pow, double x, double y) {
+    return pow(x, y);
 }
 
-EXPORT(int, powf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, powf, float x, float y) {
+    return powf(x, y);
 }
 
-EXPORT(int, powl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, powl, double x, double y) {
+    return pow(x, y);
 }
 
-EXPORT(int, remainder) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, remainder, double x, double y) {
+    return remainder(x, y);
 }
 
-EXPORT(int, remainderf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, remainderf, float x, float y) {
+    return remainderf(x, y);
 }
 
-EXPORT(int, remainderl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, remainderl, double x, double y) {
+    return remainder(x, y);
 }
 
 EXPORT(int, remquo) {
@@ -696,28 +702,28 @@ EXPORT(int, remquol) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, rint) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, rint, double x) {
+    return rint(x);
 }
 
-EXPORT(int, rintf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, rintf, float x) {
+    return rintf(x);
 }
 
-EXPORT(int, rintl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, rintl, double x) {
+    return rint(x);
 }
 
-EXPORT(int, round) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, round, double x) {
+    return round(x);
 }
 
-EXPORT(int, roundf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, roundf, float x) {
+    return roundf(x);
 }
 
-EXPORT(int, roundl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, roundl, double x) {
+    return round(x);
 }
 
 EXPORT(int, scalbln) {
@@ -744,88 +750,88 @@ EXPORT(int, scalbnl) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sin) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sin, double x) {
+    return sin(x);
 }
 
-EXPORT(int, sinf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, sinf, float x) {
+    return sinf(x);
 }
 
-EXPORT(int, sinh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sinh, double x) {
+    return sinh(x);
 }
 
-EXPORT(int, sinhf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, sinhf, float x) {
+    return sinhf(x);
 }
 
-EXPORT(int, sinhl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sinhl, double x) {
+    return sinh(x);
 }
 
-EXPORT(int, sinl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sinl, double x) {
+    return sin(x);
 }
 
-EXPORT(int, sqrt) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sqrt, double x) {
+    return sqrt(x);
 }
 
-EXPORT(int, sqrtf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, sqrtf, float x) {
+    return sqrtf(x);
 }
 
-EXPORT(int, sqrtl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, sqrtl, double x) {
+    return sqrt(x);
 }
 
-EXPORT(int, tan) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tan, double x) {
+    return tan(x);
 }
 
-EXPORT(int, tanf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, tanf, float x) {
+    return tanf(x);
 }
 
-EXPORT(int, tanh) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tanh, double x) {
+    return tanh(x);
 }
 
-EXPORT(int, tanhf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, tanhf, float x) {
+    return tanhf(x);
 }
 
-EXPORT(int, tanhl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tanhl, double x) {
+    return tanh(x);
 }
 
-EXPORT(int, tanl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tanl, double x) {
+    return tan(x);
 }
 
-EXPORT(int, tgamma) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tgamma, double x) {
+    return tgamma(x);
 }
 
-EXPORT(int, tgammaf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, tgammaf, float x) {
+    return tgammaf(x);
 }
 
-EXPORT(int, tgammal) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, tgammal, double x) {
+    return tgamma(x);
 }
 
-EXPORT(int, trunc) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, trunc, double x) {
+    return trunc(x);
 }
 
-EXPORT(int, truncf) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(float, truncf, float x) {
+    return truncf(x);
 }
 
-EXPORT(int, truncl) {
-    return UNIMPLEMENTED();
+LEAF_EXPORT(double, truncl, double x) {
+    return trunc(x);
 }
 
 BRIDGE_IMPL(_Cosh)
@@ -858,114 +864,114 @@ BRIDGE_IMPL(_Log)
 BRIDGE_IMPL(_Sin)
 BRIDGE_IMPL(_Sinh)
 BRIDGE_IMPL(_Sinx)
-BRIDGE_IMPL(acos)
-BRIDGE_IMPL(acosf)
-BRIDGE_IMPL(acosh)
-BRIDGE_IMPL(acoshf)
-BRIDGE_IMPL(acoshl)
-BRIDGE_IMPL(acosl)
-BRIDGE_IMPL(asin)
-BRIDGE_IMPL(asinf)
-BRIDGE_IMPL(asinh)
-BRIDGE_IMPL(asinhf)
-BRIDGE_IMPL(asinhl)
-BRIDGE_IMPL(asinl)
-BRIDGE_IMPL(atan)
-BRIDGE_IMPL(atan2)
-BRIDGE_IMPL(atan2f)
-BRIDGE_IMPL(atan2l)
-BRIDGE_IMPL(atanf)
-BRIDGE_IMPL(atanh)
-BRIDGE_IMPL(atanhf)
-BRIDGE_IMPL(atanhl)
-BRIDGE_IMPL(atanl)
-BRIDGE_IMPL(cbrt)
-BRIDGE_IMPL(cbrtf)
-BRIDGE_IMPL(cbrtl)
-BRIDGE_IMPL(ceil)
-BRIDGE_IMPL(ceilf)
-BRIDGE_IMPL(ceill)
-BRIDGE_IMPL(copysign)
-BRIDGE_IMPL(copysignf)
-BRIDGE_IMPL(copysignl)
-BRIDGE_IMPL(cos)
-BRIDGE_IMPL(cosf)
-BRIDGE_IMPL(cosh)
-BRIDGE_IMPL(coshf)
-BRIDGE_IMPL(coshl)
-BRIDGE_IMPL(cosl)
-BRIDGE_IMPL(erf)
-BRIDGE_IMPL(erfc)
-BRIDGE_IMPL(erfcf)
-BRIDGE_IMPL(erfcl)
-BRIDGE_IMPL(erff)
-BRIDGE_IMPL(erfl)
-BRIDGE_IMPL(exp)
-BRIDGE_IMPL(exp2)
-BRIDGE_IMPL(exp2f)
-BRIDGE_IMPL(exp2l)
-BRIDGE_IMPL(expf)
-BRIDGE_IMPL(expl)
-BRIDGE_IMPL(expm1)
-BRIDGE_IMPL(expm1f)
-BRIDGE_IMPL(expm1l)
-BRIDGE_IMPL(fabs)
-BRIDGE_IMPL(fabsf)
-BRIDGE_IMPL(fabsl)
-BRIDGE_IMPL(fdim)
-BRIDGE_IMPL(fdimf)
-BRIDGE_IMPL(fdiml)
-BRIDGE_IMPL(floor)
-BRIDGE_IMPL(floorf)
-BRIDGE_IMPL(floorl)
-BRIDGE_IMPL(fma)
-BRIDGE_IMPL(fmaf)
-BRIDGE_IMPL(fmal)
-BRIDGE_IMPL(fmax)
-BRIDGE_IMPL(fmaxf)
-BRIDGE_IMPL(fmaxl)
-BRIDGE_IMPL(fmin)
-BRIDGE_IMPL(fminf)
-BRIDGE_IMPL(fminl)
-BRIDGE_IMPL(fmod)
-BRIDGE_IMPL(fmodf)
-BRIDGE_IMPL(fmodl)
+LEAF_BRIDGE_IMPL(acos)
+LEAF_BRIDGE_IMPL(acosf)
+LEAF_BRIDGE_IMPL(acosh)
+LEAF_BRIDGE_IMPL(acoshf)
+LEAF_BRIDGE_IMPL(acoshl)
+LEAF_BRIDGE_IMPL(acosl)
+LEAF_BRIDGE_IMPL(asin)
+LEAF_BRIDGE_IMPL(asinf)
+LEAF_BRIDGE_IMPL(asinh)
+LEAF_BRIDGE_IMPL(asinhf)
+LEAF_BRIDGE_IMPL(asinhl)
+LEAF_BRIDGE_IMPL(asinl)
+LEAF_BRIDGE_IMPL(atan)
+LEAF_BRIDGE_IMPL(atan2)
+LEAF_BRIDGE_IMPL(atan2f)
+LEAF_BRIDGE_IMPL(atan2l)
+LEAF_BRIDGE_IMPL(atanf)
+LEAF_BRIDGE_IMPL(atanh)
+LEAF_BRIDGE_IMPL(atanhf)
+LEAF_BRIDGE_IMPL(atanhl)
+LEAF_BRIDGE_IMPL(atanl)
+LEAF_BRIDGE_IMPL(cbrt)
+LEAF_BRIDGE_IMPL(cbrtf)
+LEAF_BRIDGE_IMPL(cbrtl)
+LEAF_BRIDGE_IMPL(ceil)
+LEAF_BRIDGE_IMPL(ceilf)
+LEAF_BRIDGE_IMPL(ceill)
+LEAF_BRIDGE_IMPL(copysign)
+LEAF_BRIDGE_IMPL(copysignf)
+LEAF_BRIDGE_IMPL(copysignl)
+LEAF_BRIDGE_IMPL(cos)
+LEAF_BRIDGE_IMPL(cosf)
+LEAF_BRIDGE_IMPL(cosh)
+LEAF_BRIDGE_IMPL(coshf)
+LEAF_BRIDGE_IMPL(coshl)
+LEAF_BRIDGE_IMPL(cosl)
+LEAF_BRIDGE_IMPL(erf)
+LEAF_BRIDGE_IMPL(erfc)
+LEAF_BRIDGE_IMPL(erfcf)
+LEAF_BRIDGE_IMPL(erfcl)
+LEAF_BRIDGE_IMPL(erff)
+LEAF_BRIDGE_IMPL(erfl)
+LEAF_BRIDGE_IMPL(exp)
+LEAF_BRIDGE_IMPL(exp2)
+LEAF_BRIDGE_IMPL(exp2f)
+LEAF_BRIDGE_IMPL(exp2l)
+LEAF_BRIDGE_IMPL(expf)
+LEAF_BRIDGE_IMPL(expl)
+LEAF_BRIDGE_IMPL(expm1)
+LEAF_BRIDGE_IMPL(expm1f)
+LEAF_BRIDGE_IMPL(expm1l)
+LEAF_BRIDGE_IMPL(fabs)
+LEAF_BRIDGE_IMPL(fabsf)
+LEAF_BRIDGE_IMPL(fabsl)
+LEAF_BRIDGE_IMPL(fdim)
+LEAF_BRIDGE_IMPL(fdimf)
+LEAF_BRIDGE_IMPL(fdiml)
+LEAF_BRIDGE_IMPL(floor)
+LEAF_BRIDGE_IMPL(floorf)
+LEAF_BRIDGE_IMPL(floorl)
+LEAF_BRIDGE_IMPL(fma)
+LEAF_BRIDGE_IMPL(fmaf)
+LEAF_BRIDGE_IMPL(fmal)
+LEAF_BRIDGE_IMPL(fmax)
+LEAF_BRIDGE_IMPL(fmaxf)
+LEAF_BRIDGE_IMPL(fmaxl)
+LEAF_BRIDGE_IMPL(fmin)
+LEAF_BRIDGE_IMPL(fminf)
+LEAF_BRIDGE_IMPL(fminl)
+LEAF_BRIDGE_IMPL(fmod)
+LEAF_BRIDGE_IMPL(fmodf)
+LEAF_BRIDGE_IMPL(fmodl)
 BRIDGE_IMPL(frexp)
 BRIDGE_IMPL(frexpf)
 BRIDGE_IMPL(frexpl)
-BRIDGE_IMPL(hypot)
-BRIDGE_IMPL(hypotf)
-BRIDGE_IMPL(hypotl)
+LEAF_BRIDGE_IMPL(hypot)
+LEAF_BRIDGE_IMPL(hypotf)
+LEAF_BRIDGE_IMPL(hypotl)
 BRIDGE_IMPL(ilogb)
 BRIDGE_IMPL(ilogbf)
 BRIDGE_IMPL(ilogbl)
 BRIDGE_IMPL(ldexp)
 BRIDGE_IMPL(ldexpf)
 BRIDGE_IMPL(ldexpl)
-BRIDGE_IMPL(lgamma)
-BRIDGE_IMPL(lgammaf)
-BRIDGE_IMPL(lgammal)
+LEAF_BRIDGE_IMPL(lgamma)
+LEAF_BRIDGE_IMPL(lgammaf)
+LEAF_BRIDGE_IMPL(lgammal)
 BRIDGE_IMPL(llrint)
 BRIDGE_IMPL(llrintf)
 BRIDGE_IMPL(llrintl)
 BRIDGE_IMPL(llround)
 BRIDGE_IMPL(llroundf)
 BRIDGE_IMPL(llroundl)
-BRIDGE_IMPL(log)
-BRIDGE_IMPL(log10)
-BRIDGE_IMPL(log10f)
-BRIDGE_IMPL(log10l)
-BRIDGE_IMPL(log1p)
-BRIDGE_IMPL(log1pf)
-BRIDGE_IMPL(log1pl)
-BRIDGE_IMPL(log2)
-BRIDGE_IMPL(log2f)
-BRIDGE_IMPL(log2l)
-BRIDGE_IMPL(logb)
-BRIDGE_IMPL(logbf)
-BRIDGE_IMPL(logbl)
-BRIDGE_IMPL(logf)
-BRIDGE_IMPL(logl)
+LEAF_BRIDGE_IMPL(log)
+LEAF_BRIDGE_IMPL(log10)
+LEAF_BRIDGE_IMPL(log10f)
+LEAF_BRIDGE_IMPL(log10l)
+LEAF_BRIDGE_IMPL(log1p)
+LEAF_BRIDGE_IMPL(log1pf)
+LEAF_BRIDGE_IMPL(log1pl)
+LEAF_BRIDGE_IMPL(log2)
+LEAF_BRIDGE_IMPL(log2f)
+LEAF_BRIDGE_IMPL(log2l)
+LEAF_BRIDGE_IMPL(logb)
+LEAF_BRIDGE_IMPL(logbf)
+LEAF_BRIDGE_IMPL(logbl)
+LEAF_BRIDGE_IMPL(logf)
+LEAF_BRIDGE_IMPL(logl)
 BRIDGE_IMPL(lrint)
 BRIDGE_IMPL(lrintf)
 BRIDGE_IMPL(lrintl)
@@ -978,54 +984,54 @@ BRIDGE_IMPL(modfl)
 BRIDGE_IMPL(nan)
 BRIDGE_IMPL(nanf)
 BRIDGE_IMPL(nanl)
-BRIDGE_IMPL(nearbyint)
-BRIDGE_IMPL(nearbyintf)
-BRIDGE_IMPL(nearbyintl)
-BRIDGE_IMPL(nextafter)
-BRIDGE_IMPL(nextafterf)
-BRIDGE_IMPL(nextafterl)
+LEAF_BRIDGE_IMPL(nearbyint)
+LEAF_BRIDGE_IMPL(nearbyintf)
+LEAF_BRIDGE_IMPL(nearbyintl)
+LEAF_BRIDGE_IMPL(nextafter)
+LEAF_BRIDGE_IMPL(nextafterf)
+LEAF_BRIDGE_IMPL(nextafterl)
 BRIDGE_IMPL(nexttoward)
 BRIDGE_IMPL(nexttowardf)
 BRIDGE_IMPL(nexttowardl)
-BRIDGE_IMPL(pow)
-BRIDGE_IMPL(powf)
-BRIDGE_IMPL(powl)
-BRIDGE_IMPL(remainder)
-BRIDGE_IMPL(remainderf)
-BRIDGE_IMPL(remainderl)
+LEAF_BRIDGE_IMPL(pow)
+LEAF_BRIDGE_IMPL(powf)
+LEAF_BRIDGE_IMPL(powl)
+LEAF_BRIDGE_IMPL(remainder)
+LEAF_BRIDGE_IMPL(remainderf)
+LEAF_BRIDGE_IMPL(remainderl)
 BRIDGE_IMPL(remquo)
 BRIDGE_IMPL(remquof)
 BRIDGE_IMPL(remquol)
-BRIDGE_IMPL(rint)
-BRIDGE_IMPL(rintf)
-BRIDGE_IMPL(rintl)
-BRIDGE_IMPL(round)
-BRIDGE_IMPL(roundf)
-BRIDGE_IMPL(roundl)
+LEAF_BRIDGE_IMPL(rint)
+LEAF_BRIDGE_IMPL(rintf)
+LEAF_BRIDGE_IMPL(rintl)
+LEAF_BRIDGE_IMPL(round)
+LEAF_BRIDGE_IMPL(roundf)
+LEAF_BRIDGE_IMPL(roundl)
 BRIDGE_IMPL(scalbln)
 BRIDGE_IMPL(scalblnf)
 BRIDGE_IMPL(scalblnl)
 BRIDGE_IMPL(scalbn)
 BRIDGE_IMPL(scalbnf)
 BRIDGE_IMPL(scalbnl)
-BRIDGE_IMPL(sin)
-BRIDGE_IMPL(sinf)
-BRIDGE_IMPL(sinh)
-BRIDGE_IMPL(sinhf)
-BRIDGE_IMPL(sinhl)
-BRIDGE_IMPL(sinl)
-BRIDGE_IMPL(sqrt)
-BRIDGE_IMPL(sqrtf)
-BRIDGE_IMPL(sqrtl)
-BRIDGE_IMPL(tan)
-BRIDGE_IMPL(tanf)
-BRIDGE_IMPL(tanh)
-BRIDGE_IMPL(tanhf)
-BRIDGE_IMPL(tanhl)
-BRIDGE_IMPL(tanl)
-BRIDGE_IMPL(tgamma)
-BRIDGE_IMPL(tgammaf)
-BRIDGE_IMPL(tgammal)
-BRIDGE_IMPL(trunc)
-BRIDGE_IMPL(truncf)
-BRIDGE_IMPL(truncl)
+LEAF_BRIDGE_IMPL(sin)
+LEAF_BRIDGE_IMPL(sinf)
+LEAF_BRIDGE_IMPL(sinh)
+LEAF_BRIDGE_IMPL(sinhf)
+LEAF_BRIDGE_IMPL(sinhl)
+LEAF_BRIDGE_IMPL(sinl)
+LEAF_BRIDGE_IMPL(sqrt)
+LEAF_BRIDGE_IMPL(sqrtf)
+LEAF_BRIDGE_IMPL(sqrtl)
+LEAF_BRIDGE_IMPL(tan)
+LEAF_BRIDGE_IMPL(tanf)
+LEAF_BRIDGE_IMPL(tanh)
+LEAF_BRIDGE_IMPL(tanhf)
+LEAF_BRIDGE_IMPL(tanhl)
+LEAF_BRIDGE_IMPL(tanl)
+LEAF_BRIDGE_IMPL(tgamma)
+LEAF_BRIDGE_IMPL(tgammaf)
+LEAF_BRIDGE_IMPL(tgammal)
+LEAF_BRIDGE_IMPL(trunc)
+LEAF_BRIDGE_IMPL(truncf)
+LEAF_BRIDGE_IMPL(truncl)
@@ -49,114 +49,114 @@ BRIDGE_DECL(_Log)
 BRIDGE_DECL(_Sin)
 BRIDGE_DECL(_Sinh)
 BRIDGE_DECL(_Sinx)
-BRIDGE_DECL(acos)
-BRIDGE_DECL(acosf)
-BRIDGE_DECL(acosh)
-BRIDGE_DECL(acoshf)
-BRIDGE_DECL(acoshl)
-BRIDGE_DECL(acosl)
-BRIDGE_DECL(asin)
-BRIDGE_DECL(asinf)
-BRIDGE_DECL(asinh)
-BRIDGE_DECL(asinhf)
-BRIDGE_DECL(asinhl)
-BRIDGE_DECL(asinl)
-BRIDGE_DECL(atan)
-BRIDGE_DECL(atan2)
-BRIDGE_DECL(atan2f)
-BRIDGE_DECL(atan2l)
-BRIDGE_DECL(atanf)
-BRIDGE_DECL(atanh)
-BRIDGE_DECL(atanhf)
-BRIDGE_DECL(atanhl)
-BRIDGE_DECL(atanl)
-BRIDGE_DECL(cbrt)
-BRIDGE_DECL(cbrtf)
-BRIDGE_DECL(cbrtl)
-BRIDGE_DECL(ceil)
-BRIDGE_DECL(ceilf)
-BRIDGE_DECL(ceill)
-BRIDGE_DECL(copysign)
-BRIDGE_DECL(copysignf)
-BRIDGE_DECL(copysignl)
-BRIDGE_DECL(cos)
-BRIDGE_DECL(cosf)
-BRIDGE_DECL(cosh)
-BRIDGE_DECL(coshf)
-BRIDGE_DECL(coshl)
-BRIDGE_DECL(cosl)
-BRIDGE_DECL(erf)
-BRIDGE_DECL(erfc)
-BRIDGE_DECL(erfcf)
-BRIDGE_DECL(erfcl)
-BRIDGE_DECL(erff)
-BRIDGE_DECL(erfl)
-BRIDGE_DECL(exp)
-BRIDGE_DECL(exp2)
-BRIDGE_DECL(exp2f)
-BRIDGE_DECL(exp2l)
-BRIDGE_DECL(expf)
-BRIDGE_DECL(expl)
-BRIDGE_DECL(expm1)
-BRIDGE_DECL(expm1f)
-BRIDGE_DECL(expm1l)
-BRIDGE_DECL(fabs)
-BRIDGE_DECL(fabsf)
-BRIDGE_DECL(fabsl)
-BRIDGE_DECL(fdim)
-BRIDGE_DECL(fdimf)
-BRIDGE_DECL(fdiml)
-BRIDGE_DECL(floor)
-BRIDGE_DECL(floorf)
-BRIDGE_DECL(floorl)
-BRIDGE_DECL(fma)
-BRIDGE_DECL(fmaf)
-BRIDGE_DECL(fmal)
-BRIDGE_DECL(fmax)
-BRIDGE_DECL(fmaxf)
-BRIDGE_DECL(fmaxl)
-BRIDGE_DECL(fmin)
-BRIDGE_DECL(fminf)
-BRIDGE_DECL(fminl)
-BRIDGE_DECL(fmod)
-BRIDGE_DECL(fmodf)
-BRIDGE_DECL(fmodl)
+LEAF_BRIDGE_DECL(acos)
+LEAF_BRIDGE_DECL(acosf)
+LEAF_BRIDGE_DECL(acosh)
+LEAF_BRIDGE_DECL(acoshf)
+LEAF_BRIDGE_DECL(acoshl)
+LEAF_BRIDGE_DECL(acosl)
+LEAF_BRIDGE_DECL(asin)
+LEAF_BRIDGE_DECL(asinf)
+LEAF_BRIDGE_DECL(asinh)
+LEAF_BRIDGE_DECL(asinhf)
+LEAF_BRIDGE_DECL(asinhl)
+LEAF_BRIDGE_DECL(asinl)
+LEAF_BRIDGE_DECL(atan)
+LEAF_BRIDGE_DECL(atan2)
+LEAF_BRIDGE_DECL(atan2f)
+LEAF_BRIDGE_DECL(atan2l)
+LEAF_BRIDGE_DECL(atanf)
+LEAF_BRIDGE_DECL(atanh)
+LEAF_BRIDGE_DECL(atanhf)
+LEAF_BRIDGE_DECL(atanhl)
+LEAF_BRIDGE_DECL(atanl)
+LEAF_BRIDGE_DECL(cbrt)
+LEAF_BRIDGE_DECL(cbrtf)
+LEAF_BRIDGE_DECL(cbrtl)
+LEAF_BRIDGE_DECL(ceil)
+LEAF_BRIDGE_DECL(ceilf)
+LEAF_BRIDGE_DECL(ceill)
+LEAF_BRIDGE_DECL(copysign)
+LEAF_BRIDGE_DECL(copysignf)
+LEAF_BRIDGE_DECL(copysignl)
+LEAF_BRIDGE_DECL(cos)
+LEAF_BRIDGE_DECL(cosf)
+LEAF_BRIDGE_DECL(cosh)
+LEAF_BRIDGE_DECL(coshf)
+LEAF_BRIDGE_DECL(coshl)
+LEAF_BRIDGE_DECL(cosl)
+LEAF_BRIDGE_DECL(erf)
+LEAF_BRIDGE_DECL(erfc)
+LEAF_BRIDGE_DECL(erfcf)
+LEAF_BRIDGE_DECL(erfcl)
+LEAF_BRIDGE_DECL(erff)
+LEAF_BRIDGE_DECL(erfl)
+LEAF_BRIDGE_DECL(exp)
+LEAF_BRIDGE_DECL(exp2)
+LEAF_BRIDGE_DECL(exp2f)
+LEAF_BRIDGE_DECL(exp2l)
+LEAF_BRIDGE_DECL(expf)
+LEAF_BRIDGE_DECL(expl)
+LEAF_BRIDGE_DECL(expm1)
+LEAF_BRIDGE_DECL(expm1f)
+LEAF_BRIDGE_DECL(expm1l)
+LEAF_BRIDGE_DECL(fabs)
+LEAF_BRIDGE_DECL(fabsf)
+LEAF_BRIDGE_DECL(fabsl)
+LEAF_BRIDGE_DECL(fdim)
+LEAF_BRIDGE_DECL(fdimf)
+LEAF_BRIDGE_DECL(fdiml)
+LEAF_BRIDGE_DECL(floor)
+LEAF_BRIDGE_DECL(floorf)
+LEAF_BRIDGE_DECL(floorl)
+LEAF_BRIDGE_DECL(fma)
+LEAF_BRIDGE_DECL(fmaf)
+LEAF_BRIDGE_DECL(fmal)
+LEAF_BRIDGE_DECL(fmax)
+LEAF_BRIDGE_DECL(fmaxf)
+LEAF_BRIDGE_DECL(fmaxl)
+LEAF_BRIDGE_DECL(fmin)
+LEAF_BRIDGE_DECL(fminf)
+LEAF_BRIDGE_DECL(fminl)
+LEAF_BRIDGE_DECL(fmod)
+LEAF_BRIDGE_DECL(fmodf)
+LEAF_BRIDGE_DECL(fmodl)
 BRIDGE_DECL(frexp)
 BRIDGE_DECL(frexpf)
 BRIDGE_DECL(frexpl)
-BRIDGE_DECL(hypot)
-BRIDGE_DECL(hypotf)
-BRIDGE_DECL(hypotl)
+LEAF_BRIDGE_DECL(hypot)
+LEAF_BRIDGE_DECL(hypotf)
+LEAF_BRIDGE_DECL(hypotl)
 BRIDGE_DECL(ilogb)
 BRIDGE_DECL(ilogbf)
 BRIDGE_DECL(ilogbl)
 BRIDGE_DECL(ldexp)
 BRIDGE_DECL(ldexpf)
 BRIDGE_DECL(ldexpl)
-BRIDGE_DECL(lgamma)
-BRIDGE_DECL(lgammaf)
-BRIDGE_DECL(lgammal)
+LEAF_BRIDGE_DECL(lgamma)
+LEAF_BRIDGE_DECL(lgammaf)
+LEAF_BRIDGE_DECL(lgammal)
 BRIDGE_DECL(llrint)
 BRIDGE_DECL(llrintf)
 BRIDGE_DECL(llrintl)
 BRIDGE_DECL(llround)
 BRIDGE_DECL(llroundf)
 BRIDGE_DECL(llroundl)
-BRIDGE_DECL(log)
-BRIDGE_DECL(log10)
-BRIDGE_DECL(log10f)
-BRIDGE_DECL(log10l)
-BRIDGE_DECL(log1p)
-BRIDGE_DECL(log1pf)
-BRIDGE_DECL(log1pl)
-BRIDGE_DECL(log2)
-BRIDGE_DECL(log2f)
-BRIDGE_DECL(log2l)
-BRIDGE_DECL(logb)
-BRIDGE_DECL(logbf)
-BRIDGE_DECL(logbl)
-BRIDGE_DECL(logf)
-BRIDGE_DECL(logl)
+LEAF_BRIDGE_DECL(log)
+LEAF_BRIDGE_DECL(log10)
+LEAF_BRIDGE_DECL(log10f)
+LEAF_BRIDGE_DECL(log10l)
+LEAF_BRIDGE_DECL(log1p)
+LEAF_BRIDGE_DECL(log1pf)
+LEAF_BRIDGE_DECL(log1pl)
+LEAF_BRIDGE_DECL(log2)
+LEAF_BRIDGE_DECL(log2f)
+LEAF_BRIDGE_DECL(log2l)
+LEAF_BRIDGE_DECL(logb)
+LEAF_BRIDGE_DECL(logbf)
+LEAF_BRIDGE_DECL(logbl)
+LEAF_BRIDGE_DECL(logf)
+LEAF_BRIDGE_DECL(logl)
 BRIDGE_DECL(lrint)
 BRIDGE_DECL(lrintf)
 BRIDGE_DECL(lrintl)
@@ -169,54 +169,54 @@ BRIDGE_DECL(modfl)
 BRIDGE_DECL(nan)
 BRIDGE_DECL(nanf)
 BRIDGE_DECL(nanl)
-BRIDGE_DECL(nearbyint)
-BRIDGE_DECL(nearbyintf)
-BRIDGE_DECL(nearbyintl)
-BRIDGE_DECL(nextafter)
-BRIDGE_DECL(nextafterf)
-BRIDGE_DECL(nextafterl)
+LEAF_BRIDGE_DECL(nearbyint)
+LEAF_BRIDGE_DECL(nearbyintf)
+LEAF_BRIDGE_DECL(nearbyintl)
+LEAF_BRIDGE_DECL(nextafter)
+LEAF_BRIDGE_DECL(nextafterf)
+LEAF_BRIDGE_DECL(nextafterl)
 BRIDGE_DECL(nexttoward)
 BRIDGE_DECL(nexttowardf)
 BRIDGE_DECL(nexttowardl)
-BRIDGE_DECL(pow)
-BRIDGE_DECL(powf)
-BRIDGE_DECL(powl)
-BRIDGE_DECL(remainder)
-BRIDGE_DECL(remainderf)
-BRIDGE_DECL(remainderl)
+LEAF_BRIDGE_DECL(pow)
+LEAF_BRIDGE_DECL(powf)
+LEAF_BRIDGE_DECL(powl)
+LEAF_BRIDGE_DECL(remainder)
+LEAF_BRIDGE_DECL(remainderf)
+LEAF_BRIDGE_DECL(remainderl)
 BRIDGE_DECL(remquo)
 BRIDGE_DECL(remquof)
 BRIDGE_DECL(remquol)
-BRIDGE_DECL(rint)
-BRIDGE_DECL(rintf)
-BRIDGE_DECL(rintl)
-BRIDGE_DECL(round)
-BRIDGE_DECL(roundf)
-BRIDGE_DECL(roundl)
+LEAF_BRIDGE_DECL(rint)
+LEAF_BRIDGE_DECL(rintf)
+LEAF_BRIDGE_DECL(rintl)
+LEAF_BRIDGE_DECL(round)
+LEAF_BRIDGE_DECL(roundf)
+LEAF_BRIDGE_DECL(roundl)
 BRIDGE_DECL(scalbln)
 BRIDGE_DECL(scalblnf)
 BRIDGE_DECL(scalblnl)
 BRIDGE_DECL(scalbn)
 BRIDGE_DECL(scalbnf)
 BRIDGE_DECL(scalbnl)
-BRIDGE_DECL(sin)
-BRIDGE_DECL(sinf)
-BRIDGE_DECL(sinh)
-BRIDGE_DECL(sinhf)
-BRIDGE_DECL(sinhl)
-BRIDGE_DECL(sinl)
-BRIDGE_DECL(sqrt)
-BRIDGE_DECL(sqrtf)
-BRIDGE_DECL(sqrtl)
-BRIDGE_DECL(tan)
-BRIDGE_DECL(tanf)
-BRIDGE_DECL(tanh)
-BRIDGE_DECL(tanhf)
-BRIDGE_DECL(tanhl)
-BRIDGE_DECL(tanl)
-BRIDGE_DECL(tgamma)
-BRIDGE_DECL(tgammaf)
-BRIDGE_DECL(tgammal)
-BRIDGE_DECL(trunc)
-BRIDGE_DECL(truncf)
-BRIDGE_DECL(truncl)
+LEAF_BRIDGE_DECL(sin)
+LEAF_BRIDGE_DECL(sinf)
+LEAF_BRIDGE_DECL(sinh)
+LEAF_BRIDGE_DECL(sinhf)
+LEAF_BRIDGE_DECL(sinhl)
+LEAF_BRIDGE_DECL(sinl)
+LEAF_BRIDGE_DECL(sqrt)
+LEAF_BRIDGE_DECL(sqrtf)
+LEAF_BRIDGE_DECL(sqrtl)
+LEAF_BRIDGE_DECL(tan)
+LEAF_BRIDGE_DECL(tanf)
+LEAF_BRIDGE_DECL(tanh)
+LEAF_BRIDGE_DECL(tanhf)
+LEAF_BRIDGE_DECL(tanhl)
+LEAF_BRIDGE_DECL(tanl)
+LEAF_BRIDGE_DECL(tgamma)
+LEAF_BRIDGE_DECL(tgammaf)
+LEAF_BRIDGE_DECL(tgammal)
+LEAF_BRIDGE_DECL(trunc)
+LEAF_BRIDGE_DECL(truncf)
+LEAF_BRIDGE_DECL(truncl)
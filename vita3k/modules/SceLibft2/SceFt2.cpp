@@ -17,6 +17,8 @@
 
 #include "SceFt2.h"
 
+// libSceFt2 and libpvf are preloaded from vs0 (see load_app_impl) and run LLE, so the glyphs are loaded and rendered
+// by guest code. These exports are only reached when the firmware isn't installed.
 EXPORT(int, FT_Activate_Size) {
     return UNIMPLEMENTED();
 }
@@ -18,6 +18,7 @@
 #include "SceNet.h"
 
 #include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
 #include <net/functions.h>
 #include <net/state.h>
 #include <net/types.h>
@@ -110,18 +111,28 @@ std::string to_debug_str<SceNetSocketOption>(const MemState &mem, SceNetSocketOp
     return std::to_string(socketOption);
 }
 
+// the socket calls which may block park the guest thread until the host socket is ready, the wait can be aborted
+template <typename Call>
+static auto call_socket(EmuEnvState &emuenv, const SceUID thread_id, Call call) {
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    thread->update_status(ThreadStatus::wait);
+    const auto res = call();
+    thread->update_status(ThreadStatus::run);
+    return res;
+}
+
 EXPORT(int, sceNetAccept, int sid, SceNetSockaddr *addr, unsigned int *addrlen) {
     TRACY_FUNC(sceNetAccept, sid, addr, addrlen);
     auto sock = lock_and_find(sid, emuenv.net.socks, emuenv.kernel.mutex);
     if (!sock) {
         return -1;
     }
-    auto newsock = sock->accept(addr, addrlen);
+    auto newsock = call_socket(emuenv, thread_id, [&]() { return sock->accept(addr, addrlen); });
     if (!newsock) {
         return -1;
     }
     auto id = ++emuenv.net.next_id;
-    emuenv.net.socks.emplace(id, sock);
+    emuenv.net.socks.emplace(id, newsock);
     return id;
 }
 
@@ -145,7 +156,7 @@ EXPORT(int, sceNetConnect, int sid, const SceNetSockaddr *addr, unsigned int add
     if (!sock) {
         return -1;
     }
-    return sock->connect(addr, addrlen);
+    return call_socket(emuenv, thread_id, [&]() { return sock->connect(addr, addrlen); });
 }
 
 EXPORT(int, sceNetDumpAbort) {
@@ -203,7 +214,7 @@ EXPORT(int, sceNetEpollControl, int eid, SceNetEpollControlFlag op, int id, SceN
 
     switch (op) {
     case SCE_NET_EPOLL_CTL_ADD:
-        return epoll->add(id, posixSocket->sock, ev);
+        return epoll->add(id, *posixSocket, ev);
     case SCE_NET_EPOLL_CTL_DEL:
         return epoll->del(id, posixSocket->sock, ev);
     case SCE_NET_EPOLL_CTL_MOD:
@@ -411,7 +422,7 @@ EXPORT(int, sceNetRecv, int sid, void *buf, unsigned int len, int flags) {
     if (!sock) {
         return -1;
     }
-    return sock->recv_packet(buf, len, flags, nullptr, 0);
+    return call_socket(emuenv, thread_id, [&]() { return sock->recv_packet(buf, len, flags, nullptr, 0); });
 }
 
 EXPORT(int, sceNetRecvfrom, int sid, void *buf, unsigned int len, int flags, SceNetSockaddr *from, unsigned int *fromlen) {
@@ -420,7 +431,7 @@ EXPORT(int, sceNetRecvfrom, int sid, void *buf, unsigned int len, int flags, Sce
     if (!sock) {
         return -1;
     }
-    return sock->recv_packet(buf, len, flags, from, fromlen);
+    return call_socket(emuenv, thread_id, [&]() { return sock->recv_packet(buf, len, flags, from, fromlen); });
 }
 
 EXPORT(int, sceNetRecvmsg) {
@@ -468,7 +479,7 @@ EXPORT(int, sceNetSend, int sid, const void *msg, unsigned int len, int flags) {
     if (!sock) {
         return -1;
     }
-    return sock->send_packet(msg, len, flags, nullptr, 0);
+    return call_socket(emuenv, thread_id, [&]() { return sock->send_packet(msg, len, flags, nullptr, 0); });
 }
 
 EXPORT(int, sceNetSendmsg) {
@@ -482,7 +493,7 @@ EXPORT(int, sceNetSendto, int sid, const void *msg, unsigned int len, int flags,
     if (!sock) {
         return -1;
     }
-    return sock->send_packet(msg, len, flags, to, tolen);
+    return call_socket(emuenv, thread_id, [&]() { return sock->send_packet(msg, len, flags, to, tolen); });
 }
 
 EXPORT(int, sceNetSetDnsInfo) {
@@ -534,14 +545,19 @@ EXPORT(int, sceNetSocket, const char *name, int domain, SceNetSocketType type, S
     } else {
         sock = std::make_shared<PosixSocket>(domain, type, protocol);
     }
+    sock->stats = &emuenv.net.stats;
     auto id = ++emuenv.net.next_id;
     emuenv.net.socks.emplace(id, sock);
     return id;
 }
 
-EXPORT(int, sceNetSocketAbort) {
-    TRACY_FUNC(sceNetSocketAbort);
-    return UNIMPLEMENTED();
+EXPORT(int, sceNetSocketAbort, int sid, int flags) {
+    TRACY_FUNC(sceNetSocketAbort, sid, flags);
+    auto sock = lock_and_find(sid, emuenv.net.socks, emuenv.kernel.mutex);
+    if (!sock) {
+        return -1;
+    }
+    return sock->abort();
 }
 
 EXPORT(int, sceNetSocketClose, int sid) {
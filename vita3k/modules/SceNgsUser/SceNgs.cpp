@@ -366,7 +366,7 @@ EXPORT(SceUInt32, sceNgsSystemUpdate, SceNgsSynthSystemHandle handle) {
     }
 
     ngs::System *sys = handle.get(emuenv.mem);
-    sys->voice_scheduler.update(emuenv.kernel, emuenv.mem, thread_id);
+    sys->voice_scheduler.update(emuenv.kernel, emuenv.mem, thread_id, emuenv.cfg.ngs_parallel_voices);
 
     return SCE_NGS_OK;
 }
@@ -56,7 +56,7 @@ EXPORT(int, sceNpCheckCallback) {
 
     emuenv.np.state = emuenv.cfg.current_config.psn_status;
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
     for (auto &callback : emuenv.np.cbs) {
         thread->run_callback(callback.second.pc, { (uint32_t)emuenv.np.state, 0, callback.second.data });
     }
@@ -17,6 +17,85 @@
 
 #include "ScePerf.h"
 
+#include <kernel/state.h>
+#include <kernel/types.h>
+#include <util/tracy.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the timebase of the Vita is the global timer of the cpu, clocked at half the 444 MHz of the cores
+constexpr SceUInt32 SCE_PERF_TIMEBASE_FREQUENCY = 222'000'000;
+constexpr uint64_t SCE_PERF_CPU_FREQUENCY = 444'000'000;
+
+constexpr SceUID SCE_PERF_ARM_PMON_THREAD_ID_SELF = 0;
+constexpr SceUInt32 SCE_PERF_ARM_PMON_COUNTER_COUNT = 6;
+constexpr SceUInt32 SCE_PERF_ARM_PMON_CYCLE_COUNTER = 31;
+
+enum ScePerfArmPmonEvent : SceUInt8 {
+    SCE_PERF_ARM_PMON_SOFT_INCREMENT = 0x00,
+    SCE_PERF_ARM_PMON_CPU_CYCLES = 0x11,
+};
+
+static uint64_t get_elapsed_ns() {
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+// Marker pushed by a guest thread, each guest thread has its own host thread
+struct RazorMarker {
+    std::string label;
+    uint64_t start_ns;
+#ifdef TRACY_ENABLE
+    std::unique_ptr<tracy::ScopedZone> zone;
+#endif
+};
+
+static thread_local std::vector<RazorMarker> razor_markers;
+
+// Performance monitor of the calling thread. Only the cycles and the software increments can be counted on the host,
+// the counters of the other events keep the value they were set to
+struct PmonCounters {
+    bool running = false;
+    uint64_t last_update_ns = 0;
+    uint64_t cycles = 0;
+    std::array<SceUInt8, SCE_PERF_ARM_PMON_COUNTER_COUNT> events{};
+    std::array<SceUInt32, SCE_PERF_ARM_PMON_COUNTER_COUNT> values{};
+
+    void update() {
+        const uint64_t now = get_elapsed_ns();
+        if (running) {
+            const uint64_t elapsed_cycles = (now - last_update_ns) * SCE_PERF_CPU_FREQUENCY / 1'000'000'000;
+            cycles += elapsed_cycles;
+            for (SceUInt32 counter = 0; counter < SCE_PERF_ARM_PMON_COUNTER_COUNT; counter++) {
+                if (events[counter] == SCE_PERF_ARM_PMON_CPU_CYCLES)
+                    values[counter] += static_cast<SceUInt32>(elapsed_cycles);
+            }
+        }
+        last_update_ns = now;
+    }
+};
+
+static thread_local PmonCounters pmon_counters;
+
+static bool is_pmon_thread(SceUID thid, SceUID thread_id) {
+    // the counters of the other threads aren't emulated
+    return (thid == SCE_PERF_ARM_PMON_THREAD_ID_SELF) || (thid == thread_id);
+}
+
+static void push_razor_marker(const char *label) {
+    RazorMarker &marker = razor_markers.emplace_back();
+    marker.label = label ? label : "";
+    marker.start_ns = get_elapsed_ns();
+#ifdef TRACY_ENABLE
+    static constexpr char source[] = "ScePerf";
+    marker.zone = std::make_unique<tracy::ScopedZone>(0, source, sizeof(source) - 1, source, sizeof(source) - 1, marker.label.c_str(), marker.label.size());
+#endif
+}
+
 VAR_EXPORT(_pLibPerfCaptureFlagPtr) {
     auto ptr = Ptr<uint32_t>(alloc(emuenv.mem, 4, "_pLibPerfCaptureFlagPtr"));
     auto flag = Ptr<uint32_t>(alloc(emuenv.mem, 4, "_pLibPerfCaptureFlag"));
@@ -41,40 +120,87 @@ EXPORT(int, _sceRazorCpuWriteFiberUltPkt) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, scePerfArmPmonGetCounterValue) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonGetCounterValue, SceUID thid, SceUInt32 counter, SceUInt32 *value) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+    if (((counter >= SCE_PERF_ARM_PMON_COUNTER_COUNT) && (counter != SCE_PERF_ARM_PMON_CYCLE_COUNTER)) || !value)
+        return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
+
+    pmon_counters.update();
+    *value = (counter == SCE_PERF_ARM_PMON_CYCLE_COUNTER) ? static_cast<SceUInt32>(pmon_counters.cycles) : pmon_counters.values[counter];
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonReset) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonReset, SceUID thid) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+
+    pmon_counters.update();
+    pmon_counters.cycles = 0;
+    pmon_counters.values.fill(0);
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonSelectEvent) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonSelectEvent, SceUID thid, SceUInt32 counter, SceUInt8 event_code) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+    if (counter >= SCE_PERF_ARM_PMON_COUNTER_COUNT)
+        return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
+
+    pmon_counters.update();
+    pmon_counters.events[counter] = event_code;
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonSetCounterValue) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonSetCounterValue, SceUID thid, SceUInt32 counter, SceUInt32 value) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+    if ((counter >= SCE_PERF_ARM_PMON_COUNTER_COUNT) && (counter != SCE_PERF_ARM_PMON_CYCLE_COUNTER))
+        return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
+
+    pmon_counters.update();
+    if (counter == SCE_PERF_ARM_PMON_CYCLE_COUNTER)
+        pmon_counters.cycles = value;
+    else
+        pmon_counters.values[counter] = value;
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonSoftwareIncrement) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonSoftwareIncrement, SceUInt32 mask) {
+    if (!pmon_counters.running)
+        return 0;
+
+    for (SceUInt32 counter = 0; counter < SCE_PERF_ARM_PMON_COUNTER_COUNT; counter++) {
+        if ((mask & (1u << counter)) && (pmon_counters.events[counter] == SCE_PERF_ARM_PMON_SOFT_INCREMENT))
+            pmon_counters.values[counter]++;
+    }
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonStart) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonStart, SceUID thid) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+
+    pmon_counters.update();
+    pmon_counters.running = true;
+    return 0;
 }
 
-EXPORT(int, scePerfArmPmonStop) {
-    return UNIMPLEMENTED();
+EXPORT(int, scePerfArmPmonStop, SceUID thid) {
+    if (!is_pmon_thread(thid, thread_id))
+        return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID);
+
+    pmon_counters.update();
+    pmon_counters.running = false;
+    return 0;
 }
 
-EXPORT(int, scePerfGetTimebaseFrequency) {
-    return UNIMPLEMENTED();
+EXPORT(SceUInt32, scePerfGetTimebaseFrequency) {
+    return SCE_PERF_TIMEBASE_FREQUENCY;
 }
 
-EXPORT(int, scePerfGetTimebaseValue) {
-    return UNIMPLEMENTED();
+EXPORT(SceUInt64, scePerfGetTimebaseValue) {
+    return get_elapsed_ns() * (SCE_PERF_TIMEBASE_FREQUENCY / 1'000'000) / 1'000;
 }
 
 EXPORT(int, sceRazorCpuGetActivityMonitorTraceBuffer) {
@@ -90,15 +216,25 @@ EXPORT(int, sceRazorCpuIsCapturing) {
 }
 
 EXPORT(int, sceRazorCpuPopMarker) {
-    return UNIMPLEMENTED();
+    if (razor_markers.empty())
+        return 0;
+
+    RazorMarker &marker = razor_markers.back();
+    auto &stats = emuenv.kernel.razor_markers;
+    if (stats.capturing.load(std::memory_order_relaxed))
+        stats.add(marker.label, (get_elapsed_ns() - marker.start_ns) / 1'000);
+    razor_markers.pop_back();
+    return 0;
 }
 
-EXPORT(int, sceRazorCpuPushMarker) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceRazorCpuPushMarker, const char *label) {
+    push_razor_marker(label);
+    return 0;
 }
 
-EXPORT(int, sceRazorCpuPushMarkerWithHud) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceRazorCpuPushMarkerWithHud, const char *label, int color, int flags) {
+    push_razor_marker(label);
+    return 0;
 }
 
 EXPORT(int, sceRazorCpuStartActivityMonitor) {
@@ -17,6 +17,8 @@
 
 #include "ScePvf.h"
 
+// libSceFt2 and libpvf are preloaded from vs0 (see load_app_impl) and run LLE, so the glyphs are loaded and rendered
+// by guest code. These exports are only reached when the firmware isn't installed.
 EXPORT(int, __scePvfSetFt2DoneLibCHook) {
     return UNIMPLEMENTED();
 }
@@ -17,136 +17,495 @@
 
 #include "SceSas.h"
 
-EXPORT(int, sceSasCore) {
-    return UNIMPLEMENTED();
+#include <kernel/state.h>
+#include <ngs/sas.h>
+
+#include <charconv>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+#include <util/tracy.h>
+TRACY_MODULE_NAME(SceSas);
+
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_GRAIN = 0x80420001;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_MAX_VOICES = 0x80420002;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_OUTPUT_MODE = 0x80420003;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_ADDRESS = 0x80420005;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_VOICE = 0x80420010;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_NOISE_CLOCK = 0x80420011;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_PITCH = 0x80420012;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_ADSR_CURVE_MODE = 0x80420013;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_PARAMETER = 0x80420014;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_VOLUME = 0x80420018;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_ADSR_RATE = 0x80420019;
+static constexpr SceUInt32 SCE_SAS_ERROR_INVALID_SIZE = 0x8042001A;
+static constexpr SceUInt32 SCE_SAS_ERROR_NOT_INIT = 0x80420100;
+static constexpr SceUInt32 SCE_SAS_ERROR_ALREADY_INIT = 0x80420101;
+
+// the mixer state is kept on the host, the buffer given to the init only has to be of this size
+static constexpr SceSize SAS_BASE_MEMORY_SIZE = 0x400;
+static constexpr SceSize SAS_VOICE_MEMORY_SIZE = 0x100;
+static constexpr SceSize SAS_REVERB_MEMORY_SIZE = 0x10000;
+
+struct SasConfig {
+    SceUInt32 grain = ngs::sas::DEFAULT_GRAIN;
+    SceUInt32 voices = ngs::sas::MAX_VOICES;
+    SceUInt32 reverbs = 1;
+};
+
+struct SasState {
+    std::mutex mutex;
+    std::unique_ptr<ngs::sas::Core> core;
+};
+
+LIBRARY_INIT_IMPL(SceSas) {
+    emuenv.kernel.obj_store.create<SasState>();
+}
+LIBRARY_INIT_REGISTER(SceSas)
+
+// the config lists the options separated by spaces, like "numGrains=256 numVoices=32 numReverbs=1"
+static bool parse_config(const char *config, SasConfig &result) {
+    if (!config)
+        return false;
+
+    std::string_view options(config);
+    while (!options.empty()) {
+        const std::size_t end = options.find(' ');
+        const std::string_view option = options.substr(0, end);
+        options = (end == std::string_view::npos) ? std::string_view() : options.substr(end + 1);
+        if (option.empty())
+            continue;
+
+        const std::size_t equal = option.find('=');
+        if (equal == std::string_view::npos)
+            return false;
+        const std::string_view key = option.substr(0, equal);
+        const std::string_view value = option.substr(equal + 1);
+        SceUInt32 number;
+        if (std::from_chars(value.data(), value.data() + value.size(), number).ec != std::errc())
+            return false;
+
+        if (key == "numGrains")
+            result.grain = number;
+        else if (key == "numVoices")
+            result.voices = number;
+        else if (key == "numReverbs")
+            result.reverbs = number;
+        else
+            LOG_WARN("Unknown sas config option {}", key);
+    }
+
+    return true;
+}
+
+static bool is_valid_grain(SceUInt32 grain) {
+    return (grain >= ngs::sas::MIN_GRAIN) && (grain <= ngs::sas::MAX_GRAIN) && ((grain % 32) == 0);
+}
+
+static ngs::sas::Voice *get_voice(SasState &state, SceInt32 voice_num) {
+    if (!state.core || (voice_num < 0) || (static_cast<std::size_t>(voice_num) >= state.core->voices.size()))
+        return nullptr;
+    return &state.core->voices[voice_num];
+}
+
+// lock the state and find the voice, return the error of the export if there is none
+#define SAS_GET_VOICE(voice_num)                                 \
+    const auto state = emuenv.kernel.obj_store.get<SasState>();  \
+    const std::lock_guard<std::mutex> guard(state->mutex);       \
+    if (!state->core)                                            \
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);                \
+    ngs::sas::Voice *const voice = get_voice(*state, voice_num); \
+    if (!voice)                                                  \
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOICE);
+
+static SceInt32 init_sas(EmuEnvState &emuenv, const char *export_name, const char *config, const SceUInt32 *grain) {
+    SasConfig sas_config;
+    if (!parse_config(config, sas_config))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+    if (grain)
+        sas_config.grain = *grain;
+    if (!is_valid_grain(sas_config.grain))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_GRAIN);
+    if ((sas_config.voices == 0) || (sas_config.voices > ngs::sas::MAX_VOICES))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_MAX_VOICES);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (state->core)
+        return RET_ERROR(SCE_SAS_ERROR_ALREADY_INIT);
+
+    state->core = std::make_unique<ngs::sas::Core>(sas_config.voices, sas_config.grain);
+    return 0;
+}
+
+static void get_peak(const std::int32_t peak[2], SceInt32 *left, SceInt32 *right) {
+    if (left)
+        *left = peak[0];
+    if (right)
+        *right = peak[1];
+}
+
+EXPORT(SceInt32, sceSasCore, SceInt16 *out) {
+    TRACY_FUNC(sceSasCore, out);
+    if (!out)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADDRESS);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->process(out);
+    return 0;
 }
 
-EXPORT(int, sceSasCoreWithMix) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasCoreWithMix, SceInt16 *inOut, SceInt32 lvol, SceInt32 rvol) {
+    TRACY_FUNC(sceSasCoreWithMix, inOut, lvol, rvol);
+    if (!inOut)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADDRESS);
+    if ((lvol < 0) || (lvol > ngs::sas::VOLUME_MAX) || (rvol < 0) || (rvol > ngs::sas::VOLUME_MAX))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOLUME);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    // the input is read before the output is written
+    state->core->process(inOut, inOut, lvol, rvol);
+    return 0;
 }
 
-EXPORT(int, sceSasExit) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasExit, void *buffer, SceSize bufferSize) {
+    TRACY_FUNC(sceSasExit, buffer, bufferSize);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core.reset();
+    return 0;
 }
 
-EXPORT(int, sceSasGetDryPeak) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetDryPeak, SceInt32 *left, SceInt32 *right) {
+    TRACY_FUNC(sceSasGetDryPeak, left, right);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    get_peak(state->core->dry_peak, left, right);
+    return 0;
 }
 
-EXPORT(int, sceSasGetEndState) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetEndState, SceInt32 iVoiceNum) {
+    TRACY_FUNC(sceSasGetEndState, iVoiceNum);
+    SAS_GET_VOICE(iVoiceNum);
+    return voice->is_ended() ? 1 : 0;
 }
 
-EXPORT(int, sceSasGetEnvelope) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetEnvelope, SceInt32 iVoiceNum) {
+    TRACY_FUNC(sceSasGetEnvelope, iVoiceNum);
+    SAS_GET_VOICE(iVoiceNum);
+    return voice->envelope.height;
 }
 
-EXPORT(int, sceSasGetGrain) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetGrain) {
+    TRACY_FUNC(sceSasGetGrain);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    return static_cast<SceInt32>(state->core->grain);
 }
 
-EXPORT(int, sceSasGetNeededMemorySize) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetNeededMemorySize, const char *config, SceSize *outSize) {
+    TRACY_FUNC(sceSasGetNeededMemorySize, config, outSize);
+    if (!outSize)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADDRESS);
+
+    SasConfig sas_config;
+    if (!parse_config(config, sas_config))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+    if ((sas_config.voices == 0) || (sas_config.voices > ngs::sas::MAX_VOICES))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_MAX_VOICES);
+
+    *outSize = SAS_BASE_MEMORY_SIZE + sas_config.voices * SAS_VOICE_MEMORY_SIZE + sas_config.reverbs * SAS_REVERB_MEMORY_SIZE;
+    return 0;
 }
 
-EXPORT(int, sceSasGetOutputmode) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetOutputmode) {
+    TRACY_FUNC(sceSasGetOutputmode);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    return static_cast<SceInt32>(state->core->output_mode);
 }
 
-EXPORT(int, sceSasGetPauseState) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetPauseState, SceInt32 iVoiceNum) {
+    TRACY_FUNC(sceSasGetPauseState, iVoiceNum);
+    SAS_GET_VOICE(iVoiceNum);
+    return voice->paused ? 1 : 0;
 }
 
-EXPORT(int, sceSasGetPreMasterPeak) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetPreMasterPeak, SceInt32 *left, SceInt32 *right) {
+    TRACY_FUNC(sceSasGetPreMasterPeak, left, right);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    get_peak(state->core->pre_master_peak, left, right);
+    return 0;
 }
 
-EXPORT(int, sceSasGetWetPeak) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasGetWetPeak, SceInt32 *left, SceInt32 *right) {
+    TRACY_FUNC(sceSasGetWetPeak, left, right);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    // the effects are not applied, the wet path stays silent
+    const std::int32_t silent[2] = {};
+    get_peak(silent, left, right);
+    return 0;
 }
 
-EXPORT(int, sceSasInit) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasInit, const char *config, void *buffer, SceSize bufferSize) {
+    TRACY_FUNC(sceSasInit, config, buffer, bufferSize);
+    return init_sas(emuenv, export_name, config, nullptr);
 }
 
-EXPORT(int, sceSasInitWithGrain) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasInitWithGrain, const char *config, SceUInt32 grain, void *buffer, SceSize bufferSize) {
+    TRACY_FUNC(sceSasInitWithGrain, config, grain, buffer, bufferSize);
+    return init_sas(emuenv, export_name, config, &grain);
 }
 
-EXPORT(int, sceSasSetADSR) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetADSR, SceInt32 iVoiceNum, SceUInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r) {
+    TRACY_FUNC(sceSasSetADSR, iVoiceNum, flag, a, d, s, r);
+    const SceUInt32 rates[ngs::sas::ENVELOPE_PHASE_COUNT] = { a, d, s, r };
+    for (std::uint32_t phase = 0; phase < ngs::sas::ENVELOPE_PHASE_COUNT; phase++) {
+        if ((flag & (1 << phase)) && (rates[phase] > 0x7FFFFFFF))
+            return RET_ERROR(SCE_SAS_ERROR_INVALID_ADSR_RATE);
+    }
+
+    SAS_GET_VOICE(iVoiceNum);
+    for (std::uint32_t phase = 0; phase < ngs::sas::ENVELOPE_PHASE_COUNT; phase++) {
+        if (flag & (1 << phase))
+            voice->envelope.rates[phase] = static_cast<std::int32_t>(rates[phase]);
+    }
+    return 0;
 }
 
-EXPORT(int, sceSasSetADSRmode) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetADSRmode, SceInt32 iVoiceNum, SceUInt32 flag, SceUInt32 a, SceUInt32 d, SceUInt32 s, SceUInt32 r) {
+    TRACY_FUNC(sceSasSetADSRmode, iVoiceNum, flag, a, d, s, r);
+    const SceUInt32 curves[ngs::sas::ENVELOPE_PHASE_COUNT] = { a, d, s, r };
+    for (std::uint32_t phase = 0; phase < ngs::sas::ENVELOPE_PHASE_COUNT; phase++) {
+        if ((flag & (1 << phase)) && (curves[phase] > static_cast<SceUInt32>(ngs::sas::EnvelopeCurve::Direct)))
+            return RET_ERROR(SCE_SAS_ERROR_INVALID_ADSR_CURVE_MODE);
+    }
+
+    SAS_GET_VOICE(iVoiceNum);
+    for (std::uint32_t phase = 0; phase < ngs::sas::ENVELOPE_PHASE_COUNT; phase++) {
+        if (flag & (1 << phase))
+            voice->envelope.curves[phase] = static_cast<ngs::sas::EnvelopeCurve>(curves[phase]);
+    }
+    return 0;
 }
 
-EXPORT(int, sceSasSetDistortion) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetDistortion, SceInt32 iVoiceNum, SceInt32 gain) {
+    TRACY_FUNC(sceSasSetDistortion, iVoiceNum, gain);
+    SAS_GET_VOICE(iVoiceNum);
+    voice->distortion = gain;
+    return STUBBED("the distortion is not applied");
 }
 
-EXPORT(int, sceSasSetEffect) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetEffect, SceInt32 drySwitch, SceInt32 wetSwitch) {
+    TRACY_FUNC(sceSasSetEffect, drySwitch, wetSwitch);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->dry_enabled = drySwitch != 0;
+    state->core->wet_enabled = wetSwitch != 0;
+    return 0;
 }
 
-EXPORT(int, sceSasSetEffectParam) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetEffectParam, SceInt32 delay, SceInt32 feedback) {
+    TRACY_FUNC(sceSasSetEffectParam, delay, feedback);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->effect_delay = delay;
+    state->core->effect_feedback = feedback;
+    return 0;
 }
 
-EXPORT(int, sceSasSetEffectType) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetEffectType, SceInt32 type) {
+    TRACY_FUNC(sceSasSetEffectType, type);
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->effect_type = type;
+    return STUBBED("the effects are not applied");
 }
 
-EXPORT(int, sceSasSetEffectVolume) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetEffectVolume, SceInt32 left, SceInt32 right) {
+    TRACY_FUNC(sceSasSetEffectVolume, left, right);
+    if ((std::abs(left) > ngs::sas::VOLUME_MAX) || (std::abs(right) > ngs::sas::VOLUME_MAX))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_VOLUME);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->effect_volumes[0] = left;
+    state->core->effect_volumes[1] = right;
+    return 0;
 }
 
-EXPORT(int, sceSasSetGrain) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetGrain, SceUInt32 grain) {
+    TRACY_FUNC(sceSasSetGrain, grain);
+    if (!is_valid_grain(grain))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_GRAIN);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->grain = grain;
+    return 0;
 }
 
-EXPORT(int, sceSasSetKeyOff) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetKeyOff, SceInt32 iVoiceNum) {
+    TRACY_FUNC(sceSasSetKeyOff, iVoiceNum);
+    SAS_GET_VOICE(iVoiceNum);
+    voice->key_off();
+    return 0;
 }
 
-EXPORT(int, sceSasSetKeyOn) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetKeyOn, SceInt32 iVoiceNum) {
+    TRACY_FUNC(sceSasSetKeyOn, iVoiceNum);
+    SAS_GET_VOICE(iVoiceNum);
+    voice->key_on();
+    return 0;
 }
 
-EXPORT(int, sceSasSetNoise) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetNoise, SceInt32 iVoiceNum, SceUInt32 uClk) {
+    TRACY_FUNC(sceSasSetNoise, iVoiceNum, uClk);
+    if (uClk > ngs::sas::NOISE_CLOCK_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_NOISE_CLOCK);
+
+    SAS_GET_VOICE(iVoiceNum);
+    voice->type = ngs::sas::SourceType::Noise;
+    voice->noise_clock = uClk;
+    return 0;
 }
 
-EXPORT(int, sceSasSetOutputmode) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetOutputmode, SceUInt32 outputmode) {
+    TRACY_FUNC(sceSasSetOutputmode, outputmode);
+    if (outputmode > static_cast<SceUInt32>(ngs::sas::OutputMode::Mono))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_OUTPUT_MODE);
+
+    const auto state = emuenv.kernel.obj_store.get<SasState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!state->core)
+        return RET_ERROR(SCE_SAS_ERROR_NOT_INIT);
+
+    state->core->output_mode = static_cast<ngs::sas::OutputMode>(outputmode);
+    return 0;
 }
 
-EXPORT(int, sceSasSetPause) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetPause, SceInt32 iVoiceNum, SceUInt32 pauseFlag) {
+    TRACY_FUNC(sceSasSetPause, iVoiceNum, pauseFlag);
+    SAS_GET_VOICE(iVoiceNum);
+    voice->paused = pauseFlag != 0;
+    return 0;
 }
 
-EXPORT(int, sceSasSetPitch) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetPitch, SceInt32 iVoiceNum, SceInt32 pitch) {
+    TRACY_FUNC(sceSasSetPitch, iVoiceNum, pitch);
+    if ((pitch <= 0) || (pitch > ngs::sas::PITCH_MAX))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PITCH);
+
+    SAS_GET_VOICE(iVoiceNum);
+    voice->pitch = pitch;
+    return 0;
 }
 
-EXPORT(int, sceSasSetSL) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetSL, SceInt32 iVoiceNum, SceUInt32 sl) {
+    TRACY_FUNC(sceSasSetSL, iVoiceNum, sl);
+    if (sl > ngs::sas::ENVELOPE_HEIGHT_MAX)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_PARAMETER);
+
+    SAS_GET_VOICE(iVoiceNum);
+    voice->envelope.sustain_level = static_cast<std::int32_t>(sl);
+    return 0;
 }
 
-EXPORT(int, sceSasSetSimpleADSR) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetSimpleADSR, SceInt32 iVoiceNum, SceUInt16 adsr1, SceUInt16 adsr2) {
+    TRACY_FUNC(sceSasSetSimpleADSR, iVoiceNum, adsr1, adsr2);
+    SAS_GET_VOICE(iVoiceNum);
+    ngs::sas::set_simple_adsr(voice->envelope, adsr1, adsr2);
+    return 0;
 }
 
-EXPORT(int, sceSasSetVoice) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetVoice, SceInt32 iVoiceNum, const void *vagBuf, SceSize size, SceUInt32 loopflag) {
+    TRACY_FUNC(sceSasSetVoice, iVoiceNum, vagBuf, size, loopflag);
+    if (!vagBuf)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADDRESS);
+    if ((size == 0) || (size % 16 != 0))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_SIZE);
+
+    SAS_GET_VOICE(iVoiceNum);
+    // a playing voice keeps its position, the new data is read from there
+    voice->type = ngs::sas::SourceType::ADPCM;
+    voice->data = static_cast<const std::uint8_t *>(vagBuf);
+    voice->size = size;
+    voice->loop = loopflag != 0;
+    return 0;
 }
 
-EXPORT(int, sceSasSetVoicePCM) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetVoicePCM, SceInt32 iVoiceNum, const void *pcmBuf, SceSize size, SceInt32 loopsize) {
+    TRACY_FUNC(sceSasSetVoicePCM, iVoiceNum, pcmBuf, size, loopsize);
+    if (!pcmBuf)
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_ADDRESS);
+    if ((size == 0) || (size % sizeof(SceInt16) != 0) || (loopsize > static_cast<SceInt32>(size)))
+        return RET_ERROR(SCE_SAS_ERROR_INVALID_SIZE);
+
+    SAS_GET_VOICE(iVoiceNum);
+    voice->type = ngs::sas::SourceType::PCM;
+    voice->data = static_cast<const std::uint8_t *>(pcmBuf);
+    voice->size = size;
+    // the last loopsize bytes are looped, none if it is not positive
+    voice->loop = loopsize > 0;
+    voice->pcm_loop_start = voice->loop ? (size - loopsize) / sizeof(SceInt16) : 0;
+    return 0;
 }
 
-EXPORT(int, sceSasSetVolume) {
-    return UNIMPLEMENTED();
+EXPORT(SceInt32, sceSasSetVolume, SceInt32 iVoiceNum, SceInt32 l, SceInt32 r, SceInt32 wl, SceInt32 wr) {
+    TRACY_FUNC(sceSasSetVolume, iVoiceNum, l, r, wl, wr);
+    for (const SceInt32 volume : { l, r, wl, wr }) {
+        if (std::abs(volume) > ngs::sas::VOLUME_MAX)
+            return RET_ERROR(SCE_SAS_ERROR_INVALID_VOLUME);
+    }
+
+    SAS_GET_VOICE(iVoiceNum);
+    voice->volumes = { l, r, wl, wr };
+    return 0;
 }
 
 BRIDGE_IMPL(sceSasCore)
@@ -17,92 +17,671 @@
 
 #include "SceUlt.h"
 
-EXPORT(int, _sceUltConditionVariableCreate) {
-    return UNIMPLEMENTED();
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <util/align.h>
+#include <util/log.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+#include <util/tracy.h>
+TRACY_MODULE_NAME(SceUlt);
+
+static constexpr SceInt32 SCE_ULT_OK = 0;
+static constexpr SceUInt32 SCE_ULT_ERROR_NULL = 0x80574001;
+static constexpr SceUInt32 SCE_ULT_ERROR_RANGE = 0x80574003;
+static constexpr SceUInt32 SCE_ULT_ERROR_INVALID = 0x80574004;
+static constexpr SceUInt32 SCE_ULT_ERROR_PERMISSION = 0x80574005;
+static constexpr SceUInt32 SCE_ULT_ERROR_STATE = 0x80574006;
+static constexpr SceUInt32 SCE_ULT_ERROR_BUSY = 0x80574007;
+static constexpr SceUInt32 SCE_ULT_ERROR_AGAIN = 0x80574008;
+static constexpr SceUInt32 SCE_ULT_ERROR_FATAL = 0x80574009;
+
+// The option parameters all have the same size, they are only cleared as none of their options is supported
+static constexpr SceSize SCE_ULT_OPT_PARAM_SIZE = 128;
+static constexpr SceUInt32 SCE_ULT_MAX_WORKER_THREADS = 32;
+
+// The objects of the library live on the host, indexed by the address of their guest structure,
+// the work areas given by the guest are only asked for a valid size and left untouched
+
+struct Ulthread;
+struct UltWorker;
+
+// A caller blocked on an object of the library. A ulthread is switched out of its worker, which runs the
+// next ready ulthread meanwhile, another thread sleeps on the state condition
+// The waiter is woken with the object already granted to it, the result is what the blocking call returns
+struct UltWaiter {
+    Ulthread *ulthread = nullptr;
+    // mutex and reader writer lock owner of the caller
+    uint64_t owner = 0;
+    bool woken = false;
+    SceInt32 result = SCE_ULT_OK;
+    // semaphore resources requested, reader writer lock mode and queue data of the call
+    SceInt32 count = 0;
+    bool write = false;
+    Address data = 0;
+};
+
+enum class UlthreadStatus {
+    ready,
+    running,
+    waiting,
+    finished,
+};
+
+struct UltRuntime {
+    std::string name;
+    SceUInt32 max_ulthreads = 0;
+    SceUInt32 ulthread_count = 0;
+    std::vector<std::unique_ptr<UltWorker>> workers;
+    // worker given the ulthreads created from outside of the runtime
+    uint32_t next_worker = 0;
+    bool exiting = false;
+};
+
+struct Ulthread {
+    std::string name;
+    UltRuntime *runtime = nullptr;
+    // worker it last ran on, it is woken there
+    UltWorker *worker = nullptr;
+    UlthreadStatus status = UlthreadStatus::ready;
+    bool started = false;
+    SceUInt32 arg = 0;
+    // registers preserved across a call, ulthreads are only switched inside the calls of the library like the fibers
+    CPUCalleeSavedContext context;
+    // given back in r0 when it resumes, the result of the call which suspended it
+    SceInt32 resume_value = SCE_ULT_OK;
+    SceInt32 exit_status = 0;
+    UltWaiter waiter;
+    std::vector<UltWaiter *> joiners;
+    bool joined = false;
+};
+
+struct UltWorker {
+    UltRuntime *runtime = nullptr;
+    ThreadStatePtr thread;
+    std::thread host_thread;
+    // ulthreads ready to run: the worker takes the most recent one, the idle workers steal the oldest one
+    std::deque<Ulthread *> ready;
+    // ulthread whose context is loaded on the worker thread, null when it waits for work
+    Ulthread *current = nullptr;
+};
+
+struct UltWaitingQueuePool {
+    SceUInt32 max_threads = 0;
+    SceUInt32 max_sync_objects = 0;
+};
+
+struct UltQueueDataPool {
+    SceSize data_size = 0;
+    // slots left for the data of all the queues using the pool
+    SceUInt32 free_data = 0;
+    SceUInt32 max_queues = 0;
+    SceUInt32 queues = 0;
+};
+
+struct UltSemaphore {
+    Address pool = 0;
+    SceInt32 count = 0;
+    std::deque<UltWaiter *> waiters;
+};
+
+struct UltMutex {
+    Address pool = 0;
+    uint64_t owner = 0;
+    std::deque<UltWaiter *> waiters;
+};
+
+struct UltConditionVariable {
+    Address mutex = 0;
+    std::deque<UltWaiter *> waiters;
+};
+
+struct UltReaderWriterLock {
+    Address pool = 0;
+    SceUInt32 readers = 0;
+    uint64_t writer = 0;
+    std::deque<UltWaiter *> waiters;
+};
+
+struct UltQueue {
+    Address pool = 0;
+    Address data_pool = 0;
+    SceSize data_size = 0;
+    std::deque<std::vector<uint8_t>> data;
+    std::deque<UltWaiter *> pushers;
+    std::deque<UltWaiter *> poppers;
+};
+
+struct UltState {
+    std::mutex mutex;
+    // signaled when a ulthread becomes ready or a thread outside of the runtimes is woken
+    std::condition_variable cond;
+    std::map<Address, std::unique_ptr<UltRuntime>> runtimes;
+    std::map<Address, std::unique_ptr<Ulthread>> ulthreads;
+    std::unordered_map<SceUID, UltWorker *> workers;
+    std::map<Address, UltWaitingQueuePool> waiting_queue_pools;
+    std::map<Address, UltQueueDataPool> queue_data_pools;
+    std::map<Address, UltSemaphore> semaphores;
+    std::map<Address, UltMutex> mutexes;
+    std::map<Address, UltConditionVariable> condition_variables;
+    std::map<Address, UltReaderWriterLock> rwlocks;
+    std::map<Address, UltQueue> queues;
+
+    ~UltState() {
+        // the runtimes still there at exit have their workers running
+        {
+            const std::lock_guard<std::mutex> guard(mutex);
+            for (const auto &[address, runtime] : runtimes)
+                runtime->exiting = true;
+            cond.notify_all();
+        }
+        for (const auto &[address, runtime] : runtimes) {
+            for (const auto &worker : runtime->workers) {
+                worker->thread->exit_delete();
+                worker->host_thread.join();
+            }
+        }
+    }
+};
+
+LIBRARY_INIT_IMPL(SceUlt) {
+    emuenv.kernel.obj_store.create<UltState>();
 }
+LIBRARY_INIT_REGISTER(SceUlt)
 
-EXPORT(int, _sceUltConditionVariableOptParamInitialize) {
-    return UNIMPLEMENTED();
+template <typename T>
+static T *find_object(std::map<Address, T> &objects, Ptr<void> object) {
+    const auto it = objects.find(object.address());
+    return it == objects.end() ? nullptr : &it->second;
 }
 
-EXPORT(int, _sceUltMutexCreate) {
-    return UNIMPLEMENTED();
+static UltWorker *find_worker(UltState &state, SceUID thread_id) {
+    const auto it = state.workers.find(thread_id);
+    return it == state.workers.end() ? nullptr : it->second;
 }
 
-EXPORT(int, _sceUltMutexOptParamInitialize) {
-    return UNIMPLEMENTED();
+// Ulthread running the call, null for the threads outside of the runtimes
+static Ulthread *current_ulthread(UltState &state, SceUID thread_id) {
+    const UltWorker *worker = find_worker(state, thread_id);
+    return worker ? worker->current : nullptr;
 }
 
-EXPORT(int, _sceUltQueueCreate) {
-    return UNIMPLEMENTED();
+// Owner of the locks taken by the caller: the ulthread, or the thread when it is not one
+static uint64_t current_owner(UltState &state, SceUID thread_id) {
+    if (const Ulthread *ulthread = current_ulthread(state, thread_id))
+        return reinterpret_cast<uintptr_t>(ulthread);
+    return (uint64_t(1) << 63) | static_cast<uint32_t>(thread_id);
 }
 
-EXPORT(int, _sceUltQueueDataResourcePoolCreate) {
-    return UNIMPLEMENTED();
+// Waiter of the caller, a thread not running a ulthread waits on its own stack with the given one
+static UltWaiter &init_waiter(UltState &state, SceUID thread_id, UltWaiter &thread_waiter) {
+    Ulthread *ulthread = current_ulthread(state, thread_id);
+    UltWaiter &waiter = ulthread ? ulthread->waiter : thread_waiter;
+    waiter = UltWaiter{};
+    waiter.ulthread = ulthread;
+    waiter.owner = current_owner(state, thread_id);
+    return waiter;
 }
 
-EXPORT(int, _sceUltQueueDataResourcePoolOptParamInitialize) {
-    return UNIMPLEMENTED();
+static void push_ready(UltState &state, Ulthread &ulthread, UltWorker &worker, bool front = false) {
+    ulthread.status = UlthreadStatus::ready;
+    if (front)
+        worker.ready.push_front(&ulthread);
+    else
+        worker.ready.push_back(&ulthread);
+    state.cond.notify_all();
 }
 
-EXPORT(int, _sceUltQueueOptParamInitialize) {
-    return UNIMPLEMENTED();
+static void wake(UltState &state, UltWaiter &waiter, SceInt32 result) {
+    waiter.result = result;
+    waiter.woken = true;
+    if (Ulthread *ulthread = waiter.ulthread) {
+        ulthread->resume_value = result;
+        push_ready(state, *ulthread, *ulthread->worker);
+    } else {
+        state.cond.notify_all();
+    }
 }
 
-EXPORT(int, _sceUltReaderWriterLockCreate) {
-    return UNIMPLEMENTED();
+// Takes the next ulthread to run on the worker, from its own queue first then from the other workers of the runtime
+static Ulthread *take_ready(UltWorker &worker) {
+    if (!worker.ready.empty()) {
+        Ulthread *ulthread = worker.ready.back();
+        worker.ready.pop_back();
+        return ulthread;
+    }
+    for (const auto &victim : worker.runtime->workers) {
+        if (victim->ready.empty())
+            continue;
+        Ulthread *ulthread = victim->ready.front();
+        victim->ready.pop_front();
+        return ulthread;
+    }
+    return nullptr;
 }
 
-EXPORT(int, _sceUltReaderWriterLockOptParamInitialize) {
-    return UNIMPLEMENTED();
+// Makes the ulthread the one running on the worker, returns the value to give it in r0
+static SceUInt32 prepare_resume(UltWorker &worker, Ulthread &ulthread, Address halt_pc) {
+    worker.current = &ulthread;
+    ulthread.worker = &worker;
+    ulthread.status = UlthreadStatus::running;
+    if (!ulthread.started) {
+        // the entry returns to the halt instruction, back to the worker loop which finishes the ulthread
+        ulthread.started = true;
+        ulthread.context.lr = halt_pc;
+        return ulthread.arg;
+    }
+    return ulthread.resume_value;
 }
 
-EXPORT(int, _sceUltSemaphoreCreate) {
-    return UNIMPLEMENTED();
+// Leaves the ulthread running on the worker for the next ready one, or halts back to the worker loop when there is none
+// Returns the value the call gives in r0 to the code it switches to
+static SceUInt32 switch_ulthread(CPUState &cpu, UltWorker &worker) {
+    Ulthread *next = take_ready(worker);
+    if (!next) {
+        worker.current = nullptr;
+        CPUCalleeSavedContext ctx;
+        save_callee_saved_context(cpu, ctx);
+        ctx.set_pc(cpu.halt_instruction_pc);
+        load_callee_saved_context(cpu, ctx);
+        return SCE_ULT_OK;
+    }
+
+    const SceUInt32 ret = prepare_resume(worker, *next, cpu.halt_instruction_pc);
+    load_callee_saved_context(cpu, next->context);
+    return ret;
 }
 
-EXPORT(int, _sceUltSemaphoreOptParamInitialize) {
-    return UNIMPLEMENTED();
+// Blocks the caller until its waiter, already queued on an object, is woken. Returns the value of the call
+static SceInt32 block(EmuEnvState &emuenv, SceUID thread_id, std::unique_lock<std::mutex> &lock, UltState &state, UltWaiter &waiter) {
+    if (Ulthread *ulthread = waiter.ulthread) {
+        CPUState &cpu = *emuenv.kernel.get_thread(thread_id)->cpu;
+        save_callee_saved_context(cpu, ulthread->context);
+        ulthread->status = UlthreadStatus::waiting;
+        return switch_ulthread(cpu, *ulthread->worker);
+    }
+
+    state.cond.wait(lock, [&] { return waiter.woken; });
+    return waiter.result;
 }
 
-EXPORT(int, _sceUltUlthreadCreate) {
-    return UNIMPLEMENTED();
+static void finish_ulthread(MemState &mem, UltState &state, Ulthread &ulthread, SceInt32 exit_status) {
+    ulthread.status = UlthreadStatus::finished;
+    ulthread.exit_status = exit_status;
+    ulthread.runtime->ulthread_count--;
+    for (UltWaiter *joiner : ulthread.joiners) {
+        if (joiner->data)
+            *Ptr<SceInt32>(joiner->data).get(mem) = exit_status;
+        wake(state, *joiner, SCE_ULT_OK);
+    }
+    if (!ulthread.joiners.empty())
+        ulthread.joined = true;
+    ulthread.joiners.clear();
 }
 
-EXPORT(int, _sceUltUlthreadOptParamInitialize) {
-    return UNIMPLEMENTED();
+// Host side of a worker: runs the ready ulthreads on its guest thread while none of them can switch to the next one by itself,
+// it only gets back here when the ulthread it ran returned from its entry or blocked with nothing else to run
+static void run_worker(EmuEnvState &emuenv, UltState &state, UltWorker &worker) {
+    const ThreadStatePtr thread = worker.thread;
+    const Address halt_pc = thread->cpu->halt_instruction_pc;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (true) {
+        Ulthread *ulthread = nullptr;
+        state.cond.wait(lock, [&] {
+            return worker.runtime->exiting || (ulthread = take_ready(worker));
+        });
+        if (!ulthread)
+            break;
+
+        const SceUInt32 arg = prepare_resume(worker, *ulthread, halt_pc);
+        const CPUCalleeSavedContext ctx = ulthread->context;
+        lock.unlock();
+        const uint32_t returned = thread->run_guest_context(emuenv.kernel, ctx, arg);
+        lock.lock();
+
+        if (worker.current) {
+            finish_ulthread(emuenv.mem, state, *worker.current, static_cast<SceInt32>(returned));
+            worker.current = nullptr;
+        }
+    }
 }
 
-EXPORT(int, _sceUltUlthreadRuntimeCreate) {
-    return UNIMPLEMENTED();
+static SceInt32 init_opt_param(EmuEnvState &emuenv, const char *export_name, Ptr<void> opt_param) {
+    if (!opt_param)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    memset(opt_param.get(emuenv.mem), 0, SCE_ULT_OPT_PARAM_SIZE);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, _sceUltUlthreadRuntimeOptParamInitialize) {
-    return UNIMPLEMENTED();
+// Grants the semaphore resources to the waiters in the order they came
+static void grant_semaphore(UltState &state, UltSemaphore &semaphore) {
+    while (!semaphore.waiters.empty() && semaphore.waiters.front()->count <= semaphore.count) {
+        UltWaiter *waiter = semaphore.waiters.front();
+        semaphore.waiters.pop_front();
+        semaphore.count -= waiter->count;
+        wake(state, *waiter, SCE_ULT_OK);
+    }
 }
 
-EXPORT(int, _sceUltWaitingQueueResourcePoolCreate) {
-    return UNIMPLEMENTED();
+// Gives the mutex to the waiter, or queues it
+static void grant_mutex(UltState &state, UltMutex &mutex, UltWaiter &waiter) {
+    if (mutex.owner) {
+        mutex.waiters.push_back(&waiter);
+        return;
+    }
+    mutex.owner = waiter.owner;
+    wake(state, waiter, SCE_ULT_OK);
 }
 
-EXPORT(int, _sceUltWaitingQueueResourcePoolOptParamInitialize) {
-    return UNIMPLEMENTED();
+static void unlock_mutex(UltState &state, UltMutex &mutex) {
+    mutex.owner = 0;
+    if (mutex.waiters.empty())
+        return;
+    UltWaiter *waiter = mutex.waiters.front();
+    mutex.waiters.pop_front();
+    grant_mutex(state, mutex, *waiter);
 }
 
-EXPORT(int, sceUltConditionVariableDestroy) {
-    return UNIMPLEMENTED();
+// Grants the lock to the waiters in the order they came, the readers following each other get it together
+static void grant_rwlock(UltState &state, UltReaderWriterLock &rwlock) {
+    while (!rwlock.waiters.empty() && !rwlock.writer) {
+        UltWaiter *waiter = rwlock.waiters.front();
+        if (waiter->write) {
+            if (rwlock.readers)
+                break;
+            rwlock.writer = waiter->owner;
+        } else {
+            rwlock.readers++;
+        }
+        rwlock.waiters.pop_front();
+        wake(state, *waiter, SCE_ULT_OK);
+    }
 }
 
-EXPORT(int, sceUltConditionVariableSignal) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltConditionVariableCreate, Ptr<void> condition_variable, const char *name, Ptr<void> mutex, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltConditionVariableCreate, condition_variable, name, mutex, opt_param, build_version);
+    if (!condition_variable || !mutex)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->mutexes, mutex))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->condition_variables[condition_variable.address()] = UltConditionVariable{ mutex.address() };
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltConditionVariableSignalAll) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltConditionVariableOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltConditionVariableOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
 }
 
-EXPORT(int, sceUltConditionVariableWait) {
-    return UNIMPLEMENTED();
+EXPORT(int, _sceUltMutexCreate, Ptr<void> mutex, const char *name, Ptr<void> pool, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltMutexCreate, mutex, name, pool, opt_param, build_version);
+    if (!mutex || !pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->waiting_queue_pools, pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->mutexes[mutex.address()] = UltMutex{ pool.address() };
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltMutexOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltMutexOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltQueueCreate, Ptr<void> queue, const char *name, SceSize data_size, Ptr<void> pool, Ptr<void> data_pool, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltQueueCreate, queue, name, data_size, pool, data_pool, opt_param, build_version);
+    if (!queue || !pool || !data_pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltQueueDataPool *queue_data_pool = find_object(state->queue_data_pools, data_pool);
+    if (!find_object(state->waiting_queue_pools, pool) || !queue_data_pool)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (data_size == 0 || data_size > queue_data_pool->data_size)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    if (queue_data_pool->queues >= queue_data_pool->max_queues)
+        return RET_ERROR(SCE_ULT_ERROR_AGAIN);
+    queue_data_pool->queues++;
+    UltQueue &ult_queue = state->queues[queue.address()];
+    ult_queue = UltQueue{};
+    ult_queue.pool = pool.address();
+    ult_queue.data_pool = data_pool.address();
+    ult_queue.data_size = data_size;
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltQueueDataResourcePoolCreate, Ptr<void> data_pool, const char *name, SceUInt32 num_data, SceSize data_size, SceUInt32 num_queues, Ptr<void> pool, Ptr<void> work_area, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltQueueDataResourcePoolCreate, data_pool, name, num_data, data_size, num_queues, pool, work_area, opt_param, build_version);
+    if (!data_pool || !pool || !work_area)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    if (num_data == 0 || data_size == 0 || num_queues == 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->waiting_queue_pools, pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->queue_data_pools[data_pool.address()] = UltQueueDataPool{ data_size, num_data, num_queues, 0 };
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltQueueDataResourcePoolOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltQueueDataResourcePoolOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltQueueOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltQueueOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltReaderWriterLockCreate, Ptr<void> rwlock, const char *name, Ptr<void> pool, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltReaderWriterLockCreate, rwlock, name, pool, opt_param, build_version);
+    if (!rwlock || !pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->waiting_queue_pools, pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->rwlocks[rwlock.address()] = UltReaderWriterLock{ pool.address() };
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltReaderWriterLockOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltReaderWriterLockOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltSemaphoreCreate, Ptr<void> semaphore, const char *name, SceInt32 num_initial_resource, Ptr<void> pool, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltSemaphoreCreate, semaphore, name, num_initial_resource, pool, opt_param, build_version);
+    if (!semaphore || !pool)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    if (num_initial_resource < 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->waiting_queue_pools, pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->semaphores[semaphore.address()] = UltSemaphore{ pool.address(), num_initial_resource };
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltSemaphoreOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltSemaphoreOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltUlthreadCreate, Ptr<void> ulthread, const char *name, Address entry, SceUInt32 arg, Address context, SceSize size_context, Ptr<void> runtime, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltUlthreadCreate, ulthread, name, entry, arg, context, size_context, runtime, opt_param, build_version);
+    if (!ulthread || !entry || !context || !runtime)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::lock_guard<std::mutex> guard(state->mutex);
+    const auto runtime_it = state->runtimes.find(runtime.address());
+    if (runtime_it == state->runtimes.end())
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    UltRuntime &ult_runtime = *runtime_it->second;
+    if (ult_runtime.ulthread_count >= ult_runtime.max_ulthreads)
+        return RET_ERROR(SCE_ULT_ERROR_AGAIN);
+    auto &slot = state->ulthreads[ulthread.address()];
+    if (slot && slot->status != UlthreadStatus::finished)
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+
+    slot = std::make_unique<Ulthread>();
+    Ulthread &ult = *slot;
+    ult.name = name ? name : "";
+    ult.runtime = &ult_runtime;
+    ult.arg = arg;
+    // keep the floating point state of the creator, the stack of the ulthread is its context area
+    save_callee_saved_context(*emuenv.kernel.get_thread(thread_id)->cpu, ult.context);
+    ult.context.r4_r11.fill(0);
+    ult.context.sp = align_down(context + size_context, 8);
+    ult.context.set_pc(entry);
+    ult_runtime.ulthread_count++;
+
+    // a ulthread created by another one of the runtime starts on the same worker, the others can steal it
+    UltWorker *worker = find_worker(*state, thread_id);
+    if (!worker || worker->runtime != &ult_runtime)
+        worker = ult_runtime.workers[ult_runtime.next_worker++ % ult_runtime.workers.size()].get();
+    ult.worker = worker;
+    push_ready(*state, ult, *worker);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltUlthreadOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltUlthreadOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltUlthreadRuntimeCreate, Ptr<void> runtime, const char *name, SceUInt32 max_ulthreads, SceUInt32 num_worker_threads, Ptr<void> work_area, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltUlthreadRuntimeCreate, runtime, name, max_ulthreads, num_worker_threads, work_area, opt_param, build_version);
+    if (!runtime || !work_area)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    if (max_ulthreads == 0 || num_worker_threads == 0 || num_worker_threads > SCE_ULT_MAX_WORKER_THREADS)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (state->runtimes.contains(runtime.address()))
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+
+    auto ult_runtime = std::make_unique<UltRuntime>();
+    ult_runtime->name = name ? name : "";
+    ult_runtime->max_ulthreads = max_ulthreads;
+    for (SceUInt32 i = 0; i < num_worker_threads; i++) {
+        const std::string thread_name = fmt::format("SceUltWorker{}", i);
+        const ThreadStatePtr thread = emuenv.kernel.create_thread(emuenv.mem, thread_name.c_str(), Ptr<void>(0), SCE_KERNEL_DEFAULT_PRIORITY_USER, SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT, SCE_KERNEL_STACK_SIZE_USER_DEFAULT, nullptr);
+        if (!thread) {
+            for (const auto &worker : ult_runtime->workers)
+                worker->thread->exit_delete();
+            return RET_ERROR(SCE_ULT_ERROR_FATAL);
+        }
+        auto worker = std::make_unique<UltWorker>();
+        worker->runtime = ult_runtime.get();
+        worker->thread = thread;
+        ult_runtime->workers.push_back(std::move(worker));
+    }
+
+    for (const auto &worker : ult_runtime->workers) {
+        state->workers[worker->thread->id] = worker.get();
+        worker->host_thread = std::thread(run_worker, std::ref(emuenv), std::ref(*state), std::ref(*worker));
+    }
+    state->runtimes[runtime.address()] = std::move(ult_runtime);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltUlthreadRuntimeOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltUlthreadRuntimeOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, _sceUltWaitingQueueResourcePoolCreate, Ptr<void> pool, const char *name, SceUInt32 num_threads, SceUInt32 num_sync_objects, Ptr<void> work_area, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltWaitingQueueResourcePoolCreate, pool, name, num_threads, num_sync_objects, work_area, opt_param, build_version);
+    if (!pool || !work_area)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    if (num_threads == 0 || num_sync_objects == 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    state->waiting_queue_pools[pool.address()] = UltWaitingQueuePool{ num_threads, num_sync_objects };
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, _sceUltWaitingQueueResourcePoolOptParamInitialize, Ptr<void> opt_param, SceUInt32 build_version) {
+    TRACY_FUNC(_sceUltWaitingQueueResourcePoolOptParamInitialize, opt_param, build_version);
+    return init_opt_param(emuenv, export_name, opt_param);
+}
+
+EXPORT(int, sceUltConditionVariableDestroy, Ptr<void> condition_variable) {
+    TRACY_FUNC(sceUltConditionVariableDestroy, condition_variable);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltConditionVariable *cond = find_object(state->condition_variables, condition_variable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (!cond->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    state->condition_variables.erase(condition_variable.address());
+    return SCE_ULT_OK;
+}
+
+// Moves the first waiter of the condition variable to its mutex, it returns once it has the mutex back
+static SceInt32 signal_condition_variable(UltState &state, Ptr<void> condition_variable, bool all) {
+    UltConditionVariable *cond = find_object(state.condition_variables, condition_variable);
+    if (!cond)
+        return SCE_ULT_ERROR_INVALID;
+    UltMutex &mutex = state.mutexes[cond->mutex];
+    while (!cond->waiters.empty()) {
+        UltWaiter *waiter = cond->waiters.front();
+        cond->waiters.pop_front();
+        grant_mutex(state, mutex, *waiter);
+        if (!all)
+            break;
+    }
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableSignal, Ptr<void> condition_variable) {
+    TRACY_FUNC(sceUltConditionVariableSignal, condition_variable);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (const SceInt32 res = signal_condition_variable(*state, condition_variable, false))
+        return RET_ERROR(res);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableSignalAll, Ptr<void> condition_variable) {
+    TRACY_FUNC(sceUltConditionVariableSignalAll, condition_variable);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (const SceInt32 res = signal_condition_variable(*state, condition_variable, true))
+        return RET_ERROR(res);
+    return SCE_ULT_OK;
+}
+
+EXPORT(int, sceUltConditionVariableWait, Ptr<void> condition_variable) {
+    TRACY_FUNC(sceUltConditionVariableWait, condition_variable);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    UltConditionVariable *cond = find_object(state->condition_variables, condition_variable);
+    if (!cond)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    UltMutex &mutex = state->mutexes[cond->mutex];
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    if (mutex.owner != waiter.owner)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    unlock_mutex(*state, mutex);
+    cond->waiters.push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
 }
 
 EXPORT(int, sceUltGetConditionVariableInfo) {
@@ -141,128 +720,462 @@ EXPORT(int, sceUltGetWaitingQueueResourcePoolInfo) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceUltMutexDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexDestroy, Ptr<void> mutex) {
+    TRACY_FUNC(sceUltMutexDestroy, mutex);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltMutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (ult_mutex->owner || !ult_mutex->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    state->mutexes.erase(mutex.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltMutexLock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexLock, Ptr<void> mutex) {
+    TRACY_FUNC(sceUltMutexLock, mutex);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    UltMutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    if (ult_mutex->owner == waiter.owner)
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+    if (!ult_mutex->owner) {
+        ult_mutex->owner = waiter.owner;
+        return SCE_ULT_OK;
+    }
+
+    ult_mutex->waiters.push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
 }
 
-EXPORT(int, sceUltMutexTryLock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexTryLock, Ptr<void> mutex) {
+    TRACY_FUNC(sceUltMutexTryLock, mutex);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltMutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (ult_mutex->owner)
+        return SCE_ULT_ERROR_BUSY;
+    ult_mutex->owner = current_owner(*state, thread_id);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltMutexUnlock) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltMutexUnlock, Ptr<void> mutex) {
+    TRACY_FUNC(sceUltMutexUnlock, mutex);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltMutex *ult_mutex = find_object(state->mutexes, mutex);
+    if (!ult_mutex)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (ult_mutex->owner != current_owner(*state, thread_id))
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+    unlock_mutex(*state, *ult_mutex);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueueDataResourcePoolDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueDataResourcePoolDestroy, Ptr<void> data_pool) {
+    TRACY_FUNC(sceUltQueueDataResourcePoolDestroy, data_pool);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltQueueDataPool *pool = find_object(state->queue_data_pools, data_pool);
+    if (!pool)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (pool->queues)
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    state->queue_data_pools.erase(data_pool.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueueDataResourcePoolGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceUInt32, sceUltQueueDataResourcePoolGetWorkAreaSize, SceUInt32 num_data, SceSize data_size, SceUInt32 num_queues) {
+    TRACY_FUNC(sceUltQueueDataResourcePoolGetWorkAreaSize, num_data, data_size, num_queues);
+    // the data is kept on the host, the guest area only has to be allocated
+    return align(num_data * 8 + num_queues * 64, 8);
 }
 
-EXPORT(int, sceUltQueueDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueDestroy, Ptr<void> queue) {
+    TRACY_FUNC(sceUltQueueDestroy, queue);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltQueue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (!ult_queue->pushers.empty() || !ult_queue->poppers.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    UltQueueDataPool &data_pool = state->queue_data_pools[ult_queue->data_pool];
+    data_pool.free_data += static_cast<SceUInt32>(ult_queue->data.size());
+    data_pool.queues--;
+    state->queues.erase(queue.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltQueuePop) {
-    return UNIMPLEMENTED();
+// Pushes the data or gives it to a waiting popper, returns false when the pool has no slot left for it
+static bool push_queue(MemState &mem, UltState &state, UltQueue &queue, Address data) {
+    const uint8_t *src = Ptr<uint8_t>(data).get(mem);
+    if (!queue.poppers.empty()) {
+        UltWaiter *popper = queue.poppers.front();
+        queue.poppers.pop_front();
+        memcpy(Ptr<uint8_t>(popper->data).get(mem), src, queue.data_size);
+        wake(state, *popper, SCE_ULT_OK);
+        return true;
+    }
+    UltQueueDataPool &data_pool = state.queue_data_pools[queue.data_pool];
+    if (data_pool.free_data == 0)
+        return false;
+    data_pool.free_data--;
+    queue.data.emplace_back(src, src + queue.data_size);
+    return true;
 }
 
-EXPORT(int, sceUltQueuePush) {
-    return UNIMPLEMENTED();
+// Pops the oldest data, its slot is given to the first waiting pusher. Returns false when the queue is empty
+static bool pop_queue(MemState &mem, UltState &state, UltQueue &queue, Address data) {
+    if (queue.data.empty())
+        return false;
+    memcpy(Ptr<uint8_t>(data).get(mem), queue.data.front().data(), queue.data_size);
+    queue.data.pop_front();
+    if (queue.pushers.empty()) {
+        state.queue_data_pools[queue.data_pool].free_data++;
+        return true;
+    }
+    UltWaiter *pusher = queue.pushers.front();
+    queue.pushers.pop_front();
+    const uint8_t *src = Ptr<uint8_t>(pusher->data).get(mem);
+    queue.data.emplace_back(src, src + queue.data_size);
+    wake(state, *pusher, SCE_ULT_OK);
+    return true;
 }
 
-EXPORT(int, sceUltQueueTryPop) {
-    return UNIMPLEMENTED();
+static SceInt32 queue_call(EmuEnvState &emuenv, SceUID thread_id, const char *export_name, Ptr<void> queue, Ptr<void> data, bool push, bool try_only) {
+    if (!data)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    UltQueue *ult_queue = find_object(state->queues, queue);
+    if (!ult_queue)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (push ? push_queue(emuenv.mem, *state, *ult_queue, data.address()) : pop_queue(emuenv.mem, *state, *ult_queue, data.address()))
+        return SCE_ULT_OK;
+    if (try_only)
+        return SCE_ULT_ERROR_BUSY;
+
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    waiter.data = data.address();
+    (push ? ult_queue->pushers : ult_queue->poppers).push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
 }
 
-EXPORT(int, sceUltQueueTryPush) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueuePop, Ptr<void> queue, Ptr<void> data) {
+    TRACY_FUNC(sceUltQueuePop, queue, data);
+    return queue_call(emuenv, thread_id, export_name, queue, data, false, false);
 }
 
-EXPORT(int, sceUltReaderWriterLockDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueuePush, Ptr<void> queue, Ptr<void> data) {
+    TRACY_FUNC(sceUltQueuePush, queue, data);
+    return queue_call(emuenv, thread_id, export_name, queue, data, true, false);
 }
 
-EXPORT(int, sceUltReaderWriterLockLockRead) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueTryPop, Ptr<void> queue, Ptr<void> data) {
+    TRACY_FUNC(sceUltQueueTryPop, queue, data);
+    return queue_call(emuenv, thread_id, export_name, queue, data, false, true);
 }
 
-EXPORT(int, sceUltReaderWriterLockLockWrite) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltQueueTryPush, Ptr<void> queue, Ptr<void> data) {
+    TRACY_FUNC(sceUltQueueTryPush, queue, data);
+    return queue_call(emuenv, thread_id, export_name, queue, data, true, true);
 }
 
-EXPORT(int, sceUltReaderWriterLockTryLockRead) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockDestroy, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockDestroy, rwlock);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (ult_rwlock->readers || ult_rwlock->writer || !ult_rwlock->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    state->rwlocks.erase(rwlock.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltReaderWriterLockTryLockWrite) {
-    return UNIMPLEMENTED();
+static SceInt32 lock_rwlock(EmuEnvState &emuenv, SceUID thread_id, const char *export_name, Ptr<void> rwlock, bool write, bool try_only) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    UltReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    const uint64_t owner = current_owner(*state, thread_id);
+    if (ult_rwlock->writer == owner)
+        return RET_ERROR(SCE_ULT_ERROR_STATE);
+    // the queued writers go before the new readers
+    const bool free = !ult_rwlock->writer && ult_rwlock->waiters.empty() && (!write || !ult_rwlock->readers);
+    if (free) {
+        if (write)
+            ult_rwlock->writer = owner;
+        else
+            ult_rwlock->readers++;
+        return SCE_ULT_OK;
+    }
+    if (try_only)
+        return SCE_ULT_ERROR_BUSY;
+
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    waiter.write = write;
+    ult_rwlock->waiters.push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
 }
 
-EXPORT(int, sceUltReaderWriterLockUnlockRead) {
-    return UNIMPLEMENTED();
+static SceInt32 unlock_rwlock(EmuEnvState &emuenv, SceUID thread_id, const char *export_name, Ptr<void> rwlock, bool write) {
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltReaderWriterLock *ult_rwlock = find_object(state->rwlocks, rwlock);
+    if (!ult_rwlock)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (write) {
+        if (ult_rwlock->writer != current_owner(*state, thread_id))
+            return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+        ult_rwlock->writer = 0;
+    } else {
+        if (!ult_rwlock->readers)
+            return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+        ult_rwlock->readers--;
+    }
+    grant_rwlock(*state, *ult_rwlock);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltReaderWriterLockUnlockWrite) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockLockRead, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockLockRead, rwlock);
+    return lock_rwlock(emuenv, thread_id, export_name, rwlock, false, false);
 }
 
-EXPORT(int, sceUltSemaphoreAcquire) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockLockWrite, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockLockWrite, rwlock);
+    return lock_rwlock(emuenv, thread_id, export_name, rwlock, true, false);
 }
 
-EXPORT(int, sceUltSemaphoreDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockTryLockRead, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockTryLockRead, rwlock);
+    return lock_rwlock(emuenv, thread_id, export_name, rwlock, false, true);
 }
 
-EXPORT(int, sceUltSemaphoreRelease) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockTryLockWrite, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockTryLockWrite, rwlock);
+    return lock_rwlock(emuenv, thread_id, export_name, rwlock, true, true);
 }
 
-EXPORT(int, sceUltSemaphoreTryAcquire) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockUnlockRead, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockUnlockRead, rwlock);
+    return unlock_rwlock(emuenv, thread_id, export_name, rwlock, false);
 }
 
-EXPORT(int, sceUltUlthreadExit) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltReaderWriterLockUnlockWrite, Ptr<void> rwlock) {
+    TRACY_FUNC(sceUltReaderWriterLockUnlockWrite, rwlock);
+    return unlock_rwlock(emuenv, thread_id, export_name, rwlock, true);
 }
 
-EXPORT(int, sceUltUlthreadGetSelf) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreAcquire, Ptr<void> semaphore, SceInt32 num_resource) {
+    TRACY_FUNC(sceUltSemaphoreAcquire, semaphore, num_resource);
+    if (num_resource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    UltSemaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (ult_semaphore->waiters.empty() && ult_semaphore->count >= num_resource) {
+        ult_semaphore->count -= num_resource;
+        return SCE_ULT_OK;
+    }
+
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    waiter.count = num_resource;
+    ult_semaphore->waiters.push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
 }
 
-EXPORT(int, sceUltUlthreadJoin) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreDestroy, Ptr<void> semaphore) {
+    TRACY_FUNC(sceUltSemaphoreDestroy, semaphore);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const UltSemaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (!ult_semaphore->waiters.empty())
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    state->semaphores.erase(semaphore.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadRuntimeDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreRelease, Ptr<void> semaphore, SceInt32 num_resource) {
+    TRACY_FUNC(sceUltSemaphoreRelease, semaphore, num_resource);
+    if (num_resource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltSemaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    ult_semaphore->count += num_resource;
+    grant_semaphore(*state, *ult_semaphore);
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadRuntimeGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltSemaphoreTryAcquire, Ptr<void> semaphore, SceInt32 num_resource) {
+    TRACY_FUNC(sceUltSemaphoreTryAcquire, semaphore, num_resource);
+    if (num_resource <= 0)
+        return RET_ERROR(SCE_ULT_ERROR_RANGE);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltSemaphore *ult_semaphore = find_object(state->semaphores, semaphore);
+    if (!ult_semaphore)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    if (!ult_semaphore->waiters.empty() || ult_semaphore->count < num_resource)
+        return SCE_ULT_ERROR_BUSY;
+    ult_semaphore->count -= num_resource;
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltUlthreadTryJoin) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltUlthreadExit, SceInt32 status) {
+    TRACY_FUNC(sceUltUlthreadExit, status);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltWorker *worker = find_worker(*state, thread_id);
+    if (!worker || !worker->current)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+    finish_ulthread(emuenv.mem, *state, *worker->current, status);
+    worker->current = nullptr;
+    return switch_ulthread(*emuenv.kernel.get_thread(thread_id)->cpu, *worker);
+}
+
+EXPORT(int, sceUltUlthreadGetSelf, Ptr<Ptr<void>> ulthread) {
+    TRACY_FUNC(sceUltUlthreadGetSelf, ulthread);
+    if (!ulthread)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    const Ulthread *current = current_ulthread(*state, thread_id);
+    if (!current)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+    for (const auto &[address, ult] : state->ulthreads) {
+        if (ult.get() == current) {
+            *ulthread.get(emuenv.mem) = Ptr<void>(address);
+            return SCE_ULT_OK;
+        }
+    }
+    return RET_ERROR(SCE_ULT_ERROR_FATAL);
+}
+
+static SceInt32 join_ulthread(EmuEnvState &emuenv, SceUID thread_id, const char *export_name, Ptr<void> ulthread, Ptr<SceInt32> status, bool try_only) {
+    if (!ulthread)
+        return RET_ERROR(SCE_ULT_ERROR_NULL);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    const auto it = state->ulthreads.find(ulthread.address());
+    if (it == state->ulthreads.end() || it->second->joined)
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    Ulthread &ult = *it->second;
+    if (&ult == current_ulthread(*state, thread_id))
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+    if (ult.status == UlthreadStatus::finished) {
+        if (status)
+            *status.get(emuenv.mem) = ult.exit_status;
+        state->ulthreads.erase(it);
+        return SCE_ULT_OK;
+    }
+    if (try_only)
+        return SCE_ULT_ERROR_BUSY;
+
+    UltWaiter thread_waiter;
+    UltWaiter &waiter = init_waiter(*state, thread_id, thread_waiter);
+    waiter.data = status.address();
+    ult.joiners.push_back(&waiter);
+    return block(emuenv, thread_id, lock, *state, waiter);
+}
+
+EXPORT(int, sceUltUlthreadJoin, Ptr<void> ulthread, Ptr<SceInt32> status) {
+    TRACY_FUNC(sceUltUlthreadJoin, ulthread, status);
+    return join_ulthread(emuenv, thread_id, export_name, ulthread, status, false);
+}
+
+EXPORT(int, sceUltUlthreadRuntimeDestroy, Ptr<void> runtime) {
+    TRACY_FUNC(sceUltUlthreadRuntimeDestroy, runtime);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    const auto it = state->runtimes.find(runtime.address());
+    if (it == state->runtimes.end())
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    UltRuntime &ult_runtime = *it->second;
+    if (ult_runtime.ulthread_count)
+        return RET_ERROR(SCE_ULT_ERROR_BUSY);
+    if (find_worker(*state, thread_id) && find_worker(*state, thread_id)->runtime == &ult_runtime)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    ult_runtime.exiting = true;
+    state->cond.notify_all();
+    lock.unlock();
+    for (const auto &worker : ult_runtime.workers) {
+        worker->host_thread.join();
+        worker->thread->exit_delete();
+    }
+    lock.lock();
+
+    for (const auto &worker : ult_runtime.workers)
+        state->workers.erase(worker->thread->id);
+    std::erase_if(state->ulthreads, [&](const auto &ulthread) { return ulthread.second->runtime == &ult_runtime; });
+    state->runtimes.erase(runtime.address());
+    return SCE_ULT_OK;
+}
+
+EXPORT(SceUInt32, sceUltUlthreadRuntimeGetWorkAreaSize, SceUInt32 max_ulthreads, SceUInt32 num_worker_threads) {
+    TRACY_FUNC(sceUltUlthreadRuntimeGetWorkAreaSize, max_ulthreads, num_worker_threads);
+    // the runtime is kept on the host, the guest area only has to be allocated
+    return align(max_ulthreads * 16 + num_worker_threads * 64, 8);
+}
+
+EXPORT(int, sceUltUlthreadTryJoin, Ptr<void> ulthread, Ptr<SceInt32> status) {
+    TRACY_FUNC(sceUltUlthreadTryJoin, ulthread, status);
+    return join_ulthread(emuenv, thread_id, export_name, ulthread, status, true);
 }
 
 EXPORT(int, sceUltUlthreadYield) {
-    return UNIMPLEMENTED();
+    TRACY_FUNC(sceUltUlthreadYield);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    UltWorker *worker = find_worker(*state, thread_id);
+    if (!worker || !worker->current)
+        return RET_ERROR(SCE_ULT_ERROR_PERMISSION);
+
+    // the yielding ulthread goes behind the others of the worker
+    Ulthread &ulthread = *worker->current;
+    CPUState &cpu = *emuenv.kernel.get_thread(thread_id)->cpu;
+    save_callee_saved_context(cpu, ulthread.context);
+    ulthread.resume_value = SCE_ULT_OK;
+    push_ready(*state, ulthread, *worker, true);
+    return switch_ulthread(cpu, *worker);
 }
 
-EXPORT(int, sceUltWaitingQueueResourcePoolDestroy) {
-    return UNIMPLEMENTED();
+EXPORT(int, sceUltWaitingQueueResourcePoolDestroy, Ptr<void> pool) {
+    TRACY_FUNC(sceUltWaitingQueueResourcePoolDestroy, pool);
+    const auto state = emuenv.kernel.obj_store.get<UltState>();
+    const std::lock_guard<std::mutex> guard(state->mutex);
+    if (!find_object(state->waiting_queue_pools, pool))
+        return RET_ERROR(SCE_ULT_ERROR_INVALID);
+    state->waiting_queue_pools.erase(pool.address());
+    return SCE_ULT_OK;
 }
 
-EXPORT(int, sceUltWaitingQueueResourcePoolGetWorkAreaSize) {
-    return UNIMPLEMENTED();
+EXPORT(SceUInt32, sceUltWaitingQueueResourcePoolGetWorkAreaSize, SceUInt32 num_threads, SceUInt32 num_sync_objects) {
+    TRACY_FUNC(sceUltWaitingQueueResourcePoolGetWorkAreaSize, num_threads, num_sync_objects);
+    // the waiters are kept on the host, the guest area only has to be allocated
+    return align(num_threads * 16 + num_sync_objects * 16, 8);
 }
 
 BRIDGE_IMPL(_sceUltConditionVariableCreate)
@@ -0,0 +1,134 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Times the calls of a math import through the import dispatch, with the general bridge and with the leaf one.
+// The general bridge is called as the dispatch calls the other HLE functions, timed for the import stats.
+// Returns a non-zero value if the results differ.
+
+#include <cpu/common.h>
+#include <cpu/functions.h>
+#include <emuenv/state.h>
+#include <kernel/cpu_protocol.h>
+#include <mem/functions.h>
+#include <module/module.h>
+#include <modules/module_parent.h>
+#include <nids/import_stats.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+static constexpr int CALLS = 1000000;
+
+static constexpr uint32_t POWF_NID = 0x6DEA815A;
+
+static constexpr uint32_t import_nids[] = {
+#define VAR_NID(name, nid)
+#define NID(name, nid) nid,
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+};
+
+// The CPU is never run, only its registers are used
+struct BenchProtocol : CPUProtocolBase {
+    void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override {}
+    bool call_svc_inline(CPUState &cpu, uint32_t svc, Address pc) override {
+        return false;
+    }
+    Address get_watch_memory_addr(Address addr) override {
+        return addr;
+    }
+    void record_translated_block(Address pc, bool thumb) override {}
+    void record_dispatched_block(Address pc, bool thumb) override {}
+    ExclusiveMonitorPtr get_exlusive_monitor() override {
+        return nullptr;
+    }
+    JitInvalidationLog *get_jit_invalidation_log() override {
+        return nullptr;
+    }
+};
+
+// powf as it would be exported without the leaf bridge
+EXPORT(float, bench_powf, float x, float y) {
+    return powf(x, y);
+}
+
+static double time_ns(const std::function<void()> &call) {
+    call();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALLS; i++)
+        call();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+}
+
+int main() {
+    uint32_t powf_index = 0;
+    while (import_nids[powf_index] != POWF_NID)
+        powf_index++;
+
+    EmuEnvState emuenv;
+    if (!init(emuenv.mem)) {
+        std::printf("Could not init the memory\n");
+        return 1;
+    }
+
+    BenchProtocol protocol;
+    const CPUStatePtr cpu = init_cpu(CPUBackend::Dynarmic, false, false, false, 0, 0, 0, emuenv.mem, &protocol);
+    if (!cpu) {
+        std::printf("Could not init the CPU\n");
+        return 1;
+    }
+
+    const float x = 1.5f;
+    const float y = 2.25f;
+    const float expected = powf(x, y);
+
+    const ImportFn general_import = bridge(&export_bench_powf, "powf");
+    float general_result = 0;
+    const double general_time = time_ns([&]() {
+        write_float_reg(*cpu, 0, x);
+        write_float_reg(*cpu, 1, y);
+        const auto start = std::chrono::steady_clock::now();
+        general_import(emuenv, *cpu, 0);
+        const auto end = std::chrono::steady_clock::now();
+        record_import_call(powf_index, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        general_result = read_float_reg(*cpu, 0);
+    });
+
+    float leaf_result = 0;
+    const double leaf_time = time_ns([&]() {
+        write_float_reg(*cpu, 0, x);
+        write_float_reg(*cpu, 1, y);
+        call_import(emuenv, *cpu, IMPORT_DISPATCH_SVC_FLAG | powf_index, POWF_NID, 0);
+        leaf_result = read_float_reg(*cpu, 0);
+    });
+
+    volatile float sink = 0;
+    const double host_time = time_ns([&]() { sink = powf(x, y + sink * 0.0f); });
+
+    const bool same = (general_result == expected) && (leaf_result == expected);
+    std::printf("powf, %d calls\n", CALLS);
+    std::printf("general bridge: %8.2f ns per call\n", general_time);
+    std::printf("leaf bridge:    %8.2f ns per call%s\n", leaf_time, same ? "" : "  MISMATCH");
+    std::printf("host powf:      %8.2f ns per call\n", host_time);
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Times the host routines the SceLibc exports are implemented with against byte by byte loops like the ones
+// a guest libc runs when the exports are loaded from the title (LLE), and checks that they give the same result.
+// The guest comparator of qsort is replaced by a host one, the number of switches to the guest a sort costs
+// is reported for the batched merge sort and for a sort doing the comparisons one by one.
+// Returns a non-zero value if the results differ.
+
+#include <util/batched_sort.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <tuple>
+#include <vector>
+
+static constexpr int ITERATIONS = 200;
+
+static constexpr std::size_t SIZES[] = { 64, 1024, 16384 };
+static constexpr std::uint32_t SORT_COUNTS[] = { 64, 1024, 16384 };
+
+static int memcmp_basic(const std::uint8_t *a, const std::uint8_t *b, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static const std::uint8_t *memchr_basic(const std::uint8_t *str, std::uint8_t c, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        if (str[i] == c)
+            return str + i;
+    }
+    return nullptr;
+}
+
+static std::size_t strlen_basic(const char *str) {
+    std::size_t length = 0;
+    while (str[length])
+        length++;
+    return length;
+}
+
+static int strncmp_basic(const char *a, const char *b, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return static_cast<std::uint8_t>(a[i]) < static_cast<std::uint8_t>(b[i]) ? -1 : 1;
+        if (!a[i])
+            break;
+    }
+    return 0;
+}
+
+static const char *strchr_basic(const char *str, char c) {
+    for (;; str++) {
+        if (*str == c)
+            return str;
+        if (!*str)
+            return nullptr;
+    }
+}
+
+static int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static double time_us(const std::function<void()> &run) {
+    run();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        run();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / ITERATIONS;
+}
+
+// both functions return a value which is compared to check that they agree
+template <typename T>
+static bool bench(const char *name, std::size_t size, const std::function<T()> &basic, const std::function<T()> &fast) {
+    const bool same = basic() == fast();
+
+    // keep the results alive so the calls are not optimized out
+    volatile T sink{};
+    const double basic_time = time_us([&]() { sink = basic(); });
+    const double fast_time = time_us([&]() { sink = fast(); });
+    (void)sink;
+
+    std::printf("%-10s %8zu %10.3f us %10.3f us %7.2fx%s\n", name, size, basic_time, fast_time,
+        basic_time / fast_time, same ? "" : "  MISMATCH");
+    return same;
+}
+
+static bool bench_sort(std::uint32_t count, std::mt19937 &rng) {
+    std::vector<std::uint32_t> keys(count);
+    for (std::uint32_t &key : keys)
+        key = rng() % (count / 2 + 1);
+
+    // one by one, each comparison is a switch to the guest
+    std::size_t single_switches = 0;
+    std::vector<std::uint32_t> single_order;
+    const double single_time = time_us([&]() {
+        single_switches = 0;
+        single_order.resize(count);
+        for (std::uint32_t i = 0; i < count; i++)
+            single_order[i] = i;
+        std::stable_sort(single_order.begin(), single_order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            single_switches++;
+            return keys[a] < keys[b];
+        });
+    });
+
+    std::size_t batched_switches = 0;
+    std::vector<std::uint32_t> batched_order;
+    std::vector<std::tuple<std::uint32_t, std::uint32_t, std::int32_t *>> queue;
+    const double batched_time = time_us([&]() {
+        batched_switches = 0;
+        batched_order = util::batched_merge_sort(
+            count,
+            [&](std::uint32_t a, std::uint32_t b, std::int32_t *result) { queue.emplace_back(a, b, result); },
+            [&]() {
+                batched_switches++;
+                for (const auto &[a, b, result] : queue)
+                    *result = (keys[a] > keys[b]) - (keys[a] < keys[b]);
+                queue.clear();
+            });
+    });
+
+    const bool same = single_order == batched_order;
+    // the host time only covers the sort itself, the switches are what the guest comparisons cost
+    std::printf("%-10s %8u %10.3f us %10.3f us %10zu %10zu%s\n", "qsort", count, single_time, batched_time,
+        single_switches, batched_switches, same ? "" : "  MISMATCH");
+    return same;
+}
+
+int main() {
+    std::mt19937 rng(42);
+    bool success = true;
+
+    std::printf("%-10s %8s %13s %13s %8s\n", "function", "size", "lle", "hle", "speedup");
+    for (const std::size_t size : SIZES) {
+        // printable bytes, the searched ones and the difference are at the end
+        std::vector<std::uint8_t> a(size + 1);
+        for (std::uint8_t &byte : a)
+            byte = static_cast<std::uint8_t>('a' + rng() % 26);
+        a[size - 1] = '#';
+        a[size] = 0;
+        std::vector<std::uint8_t> b = a;
+        b[size - 1] = '$';
+        const char *str_a = reinterpret_cast<const char *>(a.data());
+        const char *str_b = reinterpret_cast<const char *>(b.data());
+
+        success &= bench<int>(
+            "memcmp", size, [&]() { return memcmp_basic(a.data(), b.data(), size); }, [&]() { return sign(std::memcmp(a.data(), b.data(), size)); });
+        success &= bench<const void *>(
+            "memchr", size, [&]() { return memchr_basic(a.data(), '#', size); }, [&]() { return std::memchr(a.data(), '#', size); });
+        success &= bench<std::size_t>(
+            "strlen", size, [&]() { return strlen_basic(str_a); }, [&]() { return std::strlen(str_a); });
+        success &= bench<int>(
+            "strncmp", size, [&]() { return strncmp_basic(str_a, str_b, size); }, [&]() { return sign(std::strncmp(str_a, str_b, size)); });
+        success &= bench<const char *>(
+            "strchr", size, [&]() { return strchr_basic(str_a, '#'); }, [&]() { return std::strchr(str_a, '#'); });
+    }
+
+    std::printf("\n%-10s %8s %13s %13s %10s %10s\n", "function", "count", "one by one", "batched", "switches", "batched");
+    for (const std::uint32_t count : SORT_COUNTS)
+        success &= bench_sort(count, rng);
+
+    return success ? 0 : 1;
+}
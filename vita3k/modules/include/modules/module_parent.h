@@ -26,7 +26,9 @@ struct EmuEnvState;
 struct KernelState;
 
 void init_libraries(EmuEnvState &emuenv);
-void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id);
+void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t svc, uint32_t nid, SceUID thread_id);
+// true if the svc calls a resolved HLE function which can run without stopping the JIT, see inline_import_list.inc
+bool is_inline_import(uint32_t svc);
 bool load_module(EmuEnvState &emuenv, SceUID thread_id, SceSysmoduleModuleId module_id);
 Address resolve_export(KernelState &kernel, uint32_t nid);
 uint32_t resolve_nid(KernelState &kernel, Address addr);
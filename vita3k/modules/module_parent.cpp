@@ -25,12 +25,19 @@
 #include <kernel/state.h>
 #include <module/load_module.h>
 #include <nids/functions.h>
+#include <nids/import_stats.h>
 #include <util/arm.h>
 #include <util/find.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
 
@@ -46,18 +53,88 @@ static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
 
 struct EmuEnvState;
 
-static ImportFn resolve_import(uint32_t nid) {
-    switch (nid) {
+struct HleImport {
+    uint32_t nid;
+    const ImportFn *fn;
+};
+
+// Flat dispatch table indexed by the svc of resolved import stubs
+static constexpr HleImport hle_imports[] = {
 #define VAR_NID(name, nid)
-#define NID(name, nid) \
-    case nid:          \
-        return import_##name;
+#define NID(name, nid) { nid, &import_##name },
 #include <nids/nids.inc>
 #undef NID
 #undef VAR_NID
+};
+
+static_assert(std::size(hle_imports) < IMPORT_DISPATCH_SVC_FLAG);
+static_assert(std::size(hle_imports) == import_function_count);
+
+#define LEAF_IMPORT(name) extern const LeafImportFn leaf_import_##name;
+#include <modules/leaf_import_list.inc>
+#undef LEAF_IMPORT
+
+// Leaf functions of hle_imports by index, null for the other ones
+static const std::array<LeafImportFn, std::size(hle_imports)> leaf_imports = [] {
+    static constexpr std::pair<const ImportFn *, const LeafImportFn *> leaves[] = {
+#define LEAF_IMPORT(name) { &import_##name, &leaf_import_##name },
+#include <modules/leaf_import_list.inc>
+#undef LEAF_IMPORT
+    };
+
+    std::array<LeafImportFn, std::size(hle_imports)> functions{};
+    for (uint32_t index = 0; index < std::size(hle_imports); ++index) {
+        for (const auto &[fn, leaf] : leaves) {
+            if (hle_imports[index].fn == fn)
+                functions[index] = *leaf;
+        }
     }
+    return functions;
+}();
+
+// Functions of hle_imports which can be called from inside the JIT, the leaf ones and the ones of inline_import_list.inc
+static const std::vector<bool> inline_imports = [] {
+    static constexpr const ImportFn *inlines[] = {
+#define INLINE_IMPORT(name) &import_##name,
+#include <modules/inline_import_list.inc>
+#undef INLINE_IMPORT
+    };
+
+    std::vector<bool> functions(std::size(hle_imports));
+    for (uint32_t index = 0; index < std::size(hle_imports); ++index) {
+        functions[index] = leaf_imports[index] || (std::find(std::begin(inlines), std::end(inlines), hle_imports[index].fn) != std::end(inlines));
+    }
+    return functions;
+}();
+
+bool is_inline_import(uint32_t svc) {
+    if (!(svc & IMPORT_DISPATCH_SVC_FLAG))
+        return false;
+
+    const uint32_t index = svc & ~IMPORT_DISPATCH_SVC_FLAG;
+    return (index < std::size(hle_imports)) && inline_imports[index];
+}
+
+/**
+ * \brief Finds the HLE function implementing an import.
+ * \param nid NID to resolve
+ * \return Index of the function in hle_imports, nullopt if it is not implemented
+ */
+static std::optional<uint32_t> resolve_import(uint32_t nid) {
+    static const std::unordered_map<uint32_t, uint32_t> import_indices = [] {
+        std::unordered_map<uint32_t, uint32_t> indices;
+        for (uint32_t index = 0; index < std::size(hle_imports); ++index) {
+            if (*hle_imports[index].fn)
+                indices.emplace(hle_imports[index].nid, index);
+        }
+        return indices;
+    }();
+
+    const auto index = import_indices.find(nid);
+    if (index == import_indices.end())
+        return std::nullopt;
 
-    return ImportFn();
+    return index->second;
 }
 
 const std::array<VarExport, var_exports_size> &get_var_exports() {
@@ -99,25 +176,77 @@ static void log_import_call(char emulation_level, uint32_t nid, SceUID thread_id
     }
 }
 
-void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id) {
+static void log_hle_import_call(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id) {
+    if (emuenv.kernel.debugger.watch_import_calls) {
+        const std::unordered_set<uint32_t> hle_nid_blacklist = {
+            0xB295EB61, // sceKernelGetTLSAddr
+            0x46E7BE7B, // sceKernelLockLwMutex
+            0x91FA6614, // sceKernelUnlockLwMutex
+        };
+        auto lr = read_lr(cpu);
+        log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
+    }
+}
+
+/**
+ * \brief Patches the svc of an import stub with the index of its HLE function, so later calls skip resolution.
+ * \param pc Address following the svc instruction
+ */
+static void link_hle_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, Address pc, uint32_t index) {
+    if (pc & 1)
+        return;
+
+    const Address stub_address = pc - 4;
+    uint32_t *const stub = Ptr<uint32_t>(stub_address).get(emuenv.mem);
+    {
+        const std::unique_lock<std::shared_mutex> lock(emuenv.kernel.export_nids_mutex);
+        // A module exporting it may have been loaded meanwhile, the stub must then be linked to it instead
+        if ((stub[0] != 0xef000000) || emuenv.kernel.export_nids.contains(nid))
+            return;
+
+        stub[0] = 0xef000000 | IMPORT_DISPATCH_SVC_FLAG | index; // svc #index - Call the HLE function directly.
+        emuenv.kernel.import_dispatch_stubs[nid].push_back(stub_address);
+    }
+
+    // Threads which didn't enter the JIT again yet keep resolving it, which is still correct
+    emuenv.kernel.invalidate_jit_cache(stub_address, 4);
+}
+
+// Calls the HLE function and records its latency in the import stats
+static void call_hle_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t index, SceUID thread_id) {
+    const auto start = std::chrono::steady_clock::now();
+    (*hle_imports[index].fn)(emuenv, cpu, thread_id);
+    const auto end = std::chrono::steady_clock::now();
+    record_import_call(index, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t svc, uint32_t nid, SceUID thread_id) {
+    if (svc & IMPORT_DISPATCH_SVC_FLAG) {
+        const uint32_t index = svc & ~IMPORT_DISPATCH_SVC_FLAG;
+        if (index < std::size(hle_imports)) {
+            // Leaf functions are too short for the logging and the stats
+            if (const LeafImportFn leaf = leaf_imports[index]) {
+                leaf(cpu);
+                return;
+            }
+
+            log_hle_import_call(emuenv, cpu, hle_imports[index].nid, thread_id);
+            call_hle_import(emuenv, cpu, index, thread_id);
+            return;
+        }
+    }
+
     Address export_pc = resolve_export(emuenv.kernel, nid);
 
     if (!export_pc) {
         // HLE - call our C++ function
-        if (emuenv.kernel.debugger.watch_import_calls) {
-            const std::unordered_set<uint32_t> hle_nid_blacklist = {
-                0xB295EB61, // sceKernelGetTLSAddr
-                0x46E7BE7B, // sceKernelLockLwMutex
-                0x91FA6614, // sceKernelUnlockLwMutex
-            };
-            auto lr = read_lr(cpu);
-            log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
-        }
-        const ImportFn fn = resolve_import(nid);
-        if (fn) {
-            fn(emuenv, cpu, thread_id);
+        log_hle_import_call(emuenv, cpu, nid, thread_id);
+        const std::optional<uint32_t> index = resolve_import(nid);
+        if (index) {
+            link_hle_import(emuenv, cpu, nid, read_pc(cpu), *index);
+            call_hle_import(emuenv, cpu, *index, thread_id);
         } else if (emuenv.missing_nids.count(nid) == 0 || LOG_UNK_NIDS_ALWAYS) {
-            const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
+            const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
             LOG_ERROR("Import function for NID {} not found (thread name: {}, thread ID: {})", log_hex(nid), thread->name, thread_id);
 
             if (!LOG_UNK_NIDS_ALWAYS)
@@ -146,8 +275,7 @@ void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread
         const std::unordered_set<uint32_t> lle_nid_blacklist = {};
         log_import_call('L', nid, thread_id, lle_nid_blacklist, pc);
         write_pc(cpu, export_pc);
-        // TODO: invalidate cache for all threads. Now invalidate_jit_cache is not thread safe.
-        invalidate_jit_cache(cpu, pc, 4 * 3);
+        emuenv.kernel.invalidate_jit_cache(pc, 4 * 3);
     }
 }
 
@@ -2,6 +2,9 @@
 
 #include <net/socket.h>
 
+#include <mutex>
+#include <vector>
+
 struct Epoll;
 
 typedef std::shared_ptr<Epoll> EpollPtr;
@@ -10,13 +13,34 @@ struct EpollSocket {
     unsigned int events;
     SceNetEpollData data;
     abs_socket sock;
+    // datagrams the socket already read from the host, they don't make the host socket readable
+    std::shared_ptr<const std::atomic<uint32_t>> datagrams_buffered;
 };
 
+// Backed by epoll on Linux, kqueue on macOS and WSAPoll on Windows, so a wait doesn't depend on the number of sockets registered
 struct Epoll {
+    Epoll();
+    ~Epoll();
+    Epoll(const Epoll &) = delete;
+    Epoll &operator=(const Epoll &) = delete;
+
     std::map<int, EpollSocket> eventEntries;
 
-    int add(int id, abs_socket sock, SceNetEpollEvent *ev);
+    int add(int id, const PosixSocket &socket, SceNetEpollEvent *ev);
     int del(int id, abs_socket sock, SceNetEpollEvent *ev);
     int mod(int id, abs_socket sock, SceNetEpollEvent *ev);
     int wait(SceNetEpollEvent *events, int maxevents, int timeout);
+
+private:
+    // guards eventEntries, the waits run without the lock
+    std::mutex mutex;
+#ifdef _WIN32
+    // sockets polled, rebuilt only when the registrations change
+    std::vector<WSAPOLLFD> poll_fds;
+    std::vector<int> poll_ids;
+    bool poll_fds_dirty = false;
+#else
+    // epoll or kqueue descriptor
+    int native_fd = -1;
+#endif
 };
@@ -19,7 +19,11 @@
 
 #include <net/types.h>
 
+#include <array>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -38,6 +42,7 @@ typedef int socklen_t;
 #include <netinet/tcp.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 typedef int abs_socket;
 #endif
@@ -46,11 +51,41 @@ struct Socket;
 
 typedef std::shared_ptr<Socket> SocketPtr;
 
+struct NetStatsSnapshot {
+    // packets per second
+    float packets_received = 0.f;
+    float packets_sent = 0.f;
+    // datagrams received by each call to the host, above 1 once the receptions are batched
+    float datagrams_per_reception = 0.f;
+    // time a datagram waited on average between its reception by the host and its read by the guest, in microseconds
+    float datagram_wait_us = 0.f;
+};
+
+// packets of all the sockets, they are used by several guest threads so the counters are atomics
+struct NetStats {
+    std::atomic<uint64_t> packets_received = 0;
+    std::atomic<uint64_t> packets_sent = 0;
+    std::atomic<uint64_t> datagrams_received = 0;
+    std::atomic<uint64_t> datagram_receptions = 0;
+    std::atomic<uint64_t> datagram_wait_ns = 0;
+
+    // the counters are turned into a new snapshot once a second has passed since the previous one
+    NetStatsSnapshot get_snapshot();
+
+private:
+    std::mutex snapshot_mutex;
+    uint64_t snapshot_time_ns = 0;
+    NetStatsSnapshot snapshot;
+};
+
 struct Socket {
     explicit Socket(int domain, int type, int protocol){};
 
     virtual ~Socket() = default;
 
+    // counters of the net state, null until the socket is given to the guest
+    NetStats *stats = nullptr;
+
     virtual int close() = 0;
     virtual int bind(const SceNetSockaddr *addr, unsigned int addrlen) = 0;
     virtual int send_packet(const void *msg, unsigned int len, int flags, const SceNetSockaddr *to, unsigned int tolen) = 0;
@@ -61,11 +96,35 @@ struct Socket {
     virtual SocketPtr accept(SceNetSockaddr *addr, unsigned int *addrlen) = 0;
     virtual int listen(int backlog) = 0;
     virtual int get_socket_address(SceNetSockaddr *name, unsigned int *namelen) = 0;
+    // wake up the calls blocked on the socket, they fail with SCE_NET_ERROR_EINTR
+    virtual int abort() = 0;
+};
+
+#ifdef __linux__
+// datagrams read from the host by a single recvmmsg, the next receptions of the guest are served from it without calling the host
+struct DatagramRing {
+    static constexpr int SIZE = 16;
+    // biggest UDP payload, the buffers are only backed by memory once the host writes a datagram in them
+    static constexpr size_t DATAGRAM_SIZE = 64 * 1024;
+
+    std::unique_ptr<uint8_t[]> data{ new uint8_t[SIZE * DATAGRAM_SIZE] };
+    std::array<mmsghdr, SIZE> headers{};
+    std::array<iovec, SIZE> iovecs{};
+    std::array<sockaddr_in, SIZE> addrs{};
+    // steady clock time of the recvmmsg, in nanoseconds
+    uint64_t received_ns = 0;
+    int next = 0;
+    int count = 0;
 };
+#endif
 
 // udp, tcp
 struct PosixSocket : public Socket {
     abs_socket sock;
+    // UDP socket, its receptions are batched
+    bool is_datagram = false;
+    // datagrams read from the host but not by the guest yet, an epoll reports the socket as readable while there are some
+    std::shared_ptr<std::atomic<uint32_t>> datagrams_buffered = std::make_shared<std::atomic<uint32_t>>(0);
 
     int sockopt_so_reuseport = 0;
     int sockopt_so_onesbcast = 0;
@@ -76,14 +135,36 @@ struct PosixSocket : public Socket {
     int sockopt_ip_ttlchk = 0;
     int sockopt_ip_maxttl = 0;
     int sockopt_tcp_mss_to_advertise = 0;
+    // in microseconds, 0 waits forever
+    int sockopt_so_sndtimeo = 0;
+    int sockopt_so_rcvtimeo = 0;
+
+    // the host socket is always non blocking, the blocking calls of the guest wait for it to be ready
+    // in wait_ready, so they can be aborted
+    std::atomic<uint32_t> abort_generation = 0;
+#ifndef WIN32
+    // written by abort to wake up wait_ready
+    int wake_fds[2] = { -1, -1 };
+#endif
+#ifdef __linux__
+    // created by the first reception of a UDP socket, guarded as several guest threads can read the same socket
+    std::unique_ptr<DatagramRing> datagram_ring;
+    std::mutex datagram_ring_mutex;
+#endif
 
     explicit PosixSocket(int domain, int type, int protocol)
         : Socket(domain, type, protocol)
-        , sock(socket(domain, type, protocol)){};
+        , sock(socket(domain, type, protocol)) {
+        init_non_blocking();
+    };
 
     explicit PosixSocket(abs_socket sock)
         : Socket(0, 0, 0)
-        , sock(sock){};
+        , sock(sock) {
+        init_non_blocking();
+    };
+
+    ~PosixSocket() override;
 
     int close() override;
     int bind(const SceNetSockaddr *addr, unsigned int addrlen) override;
@@ -95,6 +176,16 @@ struct PosixSocket : public Socket {
     SocketPtr accept(SceNetSockaddr *addr, unsigned int *addrlen) override;
     int listen(int backlog) override;
     int get_socket_address(SceNetSockaddr *name, unsigned int *namelen) override;
+    int abort() override;
+
+    // return 0 once the socket can be read or written, or an error when the wait timed out or was aborted
+    int wait_ready(bool write, int timeout_microseconds);
+
+private:
+    void init_non_blocking();
+#ifdef __linux__
+    int recv_datagram(void *buf, unsigned int len, bool peek, bool blocking, SceNetSockaddr *from, unsigned int *fromlen);
+#endif
 };
 
 struct P2PSocket : public Socket {
@@ -111,4 +202,5 @@ struct P2PSocket : public Socket {
     SocketPtr accept(SceNetSockaddr *addr, unsigned int *addrlen) override;
     int listen(int backlog) override;
     int get_socket_address(SceNetSockaddr *name, unsigned int *namelen) override;
+    int abort() override;
 };
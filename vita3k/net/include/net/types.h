@@ -294,6 +294,11 @@ enum SceNetErrorCode {
     SCE_NET_ERROR_RESOLVER_EALIGNMENT = 0x804101EA
 };
 
+enum SceNetMsgFlag {
+    SCE_NET_MSG_PEEK = 0x2,
+    SCE_NET_MSG_DONTWAIT = 0x80
+};
+
 enum SceNetEpollControlFlag : int32_t {
     SCE_NET_EPOLL_CTL_ADD = 1,
     SCE_NET_EPOLL_CTL_MOD,
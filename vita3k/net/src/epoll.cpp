@@ -1,96 +1,299 @@
 #include <net/epoll.h>
 
-int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev) {
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#endif
+
+// timeout of the waits in milliseconds, rounded up so a short wait doesn't become a poll, negative waits forever
+static int get_timeout_ms(const int timeout_microseconds) {
+    if (timeout_microseconds < 0)
+        return -1;
+    return (timeout_microseconds + 999) / 1000;
+}
+
+#ifdef __linux__
+static uint32_t translate_events(const unsigned int events) {
+    uint32_t native_events = 0;
+    if (events & SCE_NET_EPOLLIN)
+        native_events |= EPOLLIN;
+    if (events & SCE_NET_EPOLLOUT)
+        native_events |= EPOLLOUT;
+    // EPOLLERR is always reported
+    return native_events;
+}
+
+static unsigned int translate_native_events(const uint32_t native_events) {
+    unsigned int events = 0;
+    if (native_events & (EPOLLIN | EPOLLHUP))
+        events |= SCE_NET_EPOLLIN;
+    if (native_events & EPOLLOUT)
+        events |= SCE_NET_EPOLLOUT;
+    if (native_events & (EPOLLERR | EPOLLHUP))
+        events |= SCE_NET_EPOLLERR;
+    return events;
+}
+
+static int control_native(const int native_fd, const int op, const int id, const abs_socket sock, const unsigned int events) {
+    epoll_event native_event{};
+    native_event.events = translate_events(events);
+    native_event.data.fd = id;
+    return epoll_ctl(native_fd, op, sock, &native_event);
+}
+#elif defined(__APPLE__)
+// the read and write filters are registered separately, a filter is deleted when the event isn't wanted anymore
+static int control_native(const int native_fd, const int id, const abs_socket sock, const unsigned int events) {
+    struct kevent changes[2];
+    EV_SET(&changes[0], sock, EVFILT_READ, (events & SCE_NET_EPOLLIN) ? EV_ADD : EV_DELETE, 0, 0, reinterpret_cast<void *>(static_cast<intptr_t>(id)));
+    EV_SET(&changes[1], sock, EVFILT_WRITE, (events & SCE_NET_EPOLLOUT) ? EV_ADD : EV_DELETE, 0, 0, reinterpret_cast<void *>(static_cast<intptr_t>(id)));
+
+    int ret = 0;
+    for (struct kevent &change : changes) {
+        // deleting a filter which was never added fails with ENOENT
+        if ((kevent(native_fd, &change, 1, nullptr, 0, nullptr) < 0) && (change.flags & EV_ADD))
+            ret = -1;
+    }
+    return ret;
+}
+#endif
+
+Epoll::Epoll() {
+#ifdef __linux__
+    native_fd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(__APPLE__)
+    native_fd = kqueue();
+#endif
+}
+
+Epoll::~Epoll() {
+#ifndef _WIN32
+    if (native_fd >= 0)
+        ::close(native_fd);
+#endif
+}
+
+int Epoll::add(int id, const PosixSocket &socket, SceNetEpollEvent *ev) {
+    const abs_socket sock = socket.sock;
+    const std::lock_guard<std::mutex> lock(mutex);
     auto it = eventEntries.find(id);
     if (it != eventEntries.end()) {
         return SCE_NET_ERROR_EEXIST;
     }
 
-    eventEntries.emplace(id, EpollSocket{ ev->events, ev->data, sock });
+#ifdef __linux__
+    if (control_native(native_fd, EPOLL_CTL_ADD, id, sock, ev->events) < 0)
+        return SCE_NET_ERROR_EBADF;
+#elif defined(__APPLE__)
+    if (control_native(native_fd, id, sock, ev->events) < 0)
+        return SCE_NET_ERROR_EBADF;
+#else
+    poll_fds_dirty = true;
+#endif
+
+    eventEntries.emplace(id, EpollSocket{ ev->events, ev->data, sock, socket.datagrams_buffered });
 
     return 0;
 }
 
 int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
-    if (eventEntries.erase(id) == 0) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
         return SCE_NET_ERROR_ENOENT;
     }
 
+    // the socket may already be closed, which removes it from the native set
+#ifdef __linux__
+    epoll_ctl(native_fd, EPOLL_CTL_DEL, it->second.sock, nullptr);
+#elif defined(__APPLE__)
+    control_native(native_fd, id, it->second.sock, 0);
+#else
+    poll_fds_dirty = true;
+#endif
+
+    eventEntries.erase(it);
+
     return 0;
 }
 
 int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
     auto it = eventEntries.find(id);
     if (it == eventEntries.end()) {
         return SCE_NET_ERROR_ENOENT;
     }
 
+#ifdef __linux__
+    if (control_native(native_fd, EPOLL_CTL_MOD, id, it->second.sock, ev->events) < 0)
+        return SCE_NET_ERROR_EBADF;
+#elif defined(__APPLE__)
+    if (control_native(native_fd, id, it->second.sock, ev->events) < 0)
+        return SCE_NET_ERROR_EBADF;
+#else
+    poll_fds_dirty = true;
+#endif
+
     it->second.events = ev->events;
     it->second.data = ev->data;
     return 0;
 }
 
-static void add_event_fd_set(fd_set *set, int *maxFd, abs_socket sock) {
-    FD_SET(sock, set);
-#ifndef _WIN32
-    if (sock > *maxFd) {
-        *maxFd = sock;
+// store the events of a socket, which are only reported for the events it was registered with
+static void add_ready_event(Epoll &epoll, SceNetEpollEvent *events, int &eventCount, const int id, const unsigned int eventTypes) {
+    const auto it = epoll.eventEntries.find(id);
+    if (it == epoll.eventEntries.end())
+        return;
+
+    const unsigned int reported = eventTypes & it->second.events;
+    if (reported == 0)
+        return;
+
+    events[eventCount].events = reported;
+    events[eventCount].data = it->second.data;
+    eventCount++;
+}
+
+// the sockets which already read datagrams from the host are readable, even if the host socket is not
+static std::vector<int> get_buffered_sockets(const Epoll &epoll) {
+    std::vector<int> ids;
+    for (const auto &[id, epollSocket] : epoll.eventEntries) {
+        if ((epollSocket.events & SCE_NET_EPOLLIN) && epollSocket.datagrams_buffered && (epollSocket.datagrams_buffered->load() != 0))
+            ids.push_back(id);
+    }
+    return ids;
+}
+
+// return SCE_NET_EPOLLIN if the socket has buffered datagrams, it is then no longer reported by add_buffered_events
+static unsigned int take_buffered_socket(std::vector<int> &buffered, const int id) {
+    const auto it = std::find(buffered.begin(), buffered.end(), id);
+    if (it == buffered.end())
+        return 0;
+    buffered.erase(it);
+    return SCE_NET_EPOLLIN;
+}
+
+static void add_buffered_events(Epoll &epoll, SceNetEpollEvent *events, int &eventCount, const int maxevents, const std::vector<int> &buffered) {
+    for (const int id : buffered) {
+        if (eventCount >= maxevents)
+            break;
+        add_ready_event(epoll, events, eventCount, id, SCE_NET_EPOLLIN);
     }
-#endif
 }
 
 int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
-    fd_set readFds, writeFds, exceptFds;
-    FD_ZERO(&readFds);
-    FD_ZERO(&writeFds);
-    FD_ZERO(&exceptFds);
-    int maxFd = 0;
-
-    for (auto &pair : eventEntries) {
-        auto &epollSocket = pair.second;
-        if (pair.second.events & SCE_NET_EPOLLIN) {
-            add_event_fd_set(&readFds, &maxFd, pair.second.sock);
-        }
-        if (pair.second.events & SCE_NET_EPOLLOUT) {
-            add_event_fd_set(&writeFds, &maxFd, pair.second.sock);
-        }
-        if (pair.second.events & SCE_NET_EPOLLERR) {
-            add_event_fd_set(&exceptFds, &maxFd, pair.second.sock);
-        }
+    if (maxevents <= 0)
+        return 0;
+
+    std::vector<int> buffered;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        buffered = get_buffered_sockets(*this);
     }
+    // the events of the host are still gathered, without waiting
+    if (!buffered.empty())
+        timeout_microseconds = 0;
 
-    timeval timeout;
+    int eventCount = 0;
+#ifdef __linux__
+    std::vector<epoll_event> native_events(maxevents);
+    const int ret = epoll_wait(native_fd, native_events.data(), maxevents, get_timeout_ms(timeout_microseconds));
+    if (ret < 0) {
+        // TODO: translate error code
+        return -1;
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < ret; i++) {
+        const int id = native_events[i].data.fd;
+        add_ready_event(*this, events, eventCount, id, translate_native_events(native_events[i].events) | take_buffered_socket(buffered, id));
+    }
+#elif defined(__APPLE__)
+    timespec timeout;
     timeout.tv_sec = timeout_microseconds / 1000000;
-    timeout.tv_usec = timeout_microseconds % 1000000;
-    auto ret = select(maxFd, &readFds, &writeFds, &exceptFds, &timeout);
+    timeout.tv_nsec = (timeout_microseconds % 1000000) * 1000;
+    std::vector<struct kevent> native_events(maxevents);
+    const int ret = kevent(native_fd, nullptr, 0, native_events.data(), maxevents, (timeout_microseconds < 0) ? nullptr : &timeout);
     if (ret < 0) {
         // TODO: translate error code
         return -1;
     }
 
-    int eventCount = 0;
-    for (auto &pair : eventEntries) {
-        auto id = pair.first;
-        auto &epollSocket = pair.second;
+    const std::lock_guard<std::mutex> lock(mutex);
+    // the read and write filters of a socket are reported separately, they are merged in a single event
+    std::vector<std::pair<int, unsigned int>> ready;
+    for (int i = 0; i < ret; i++) {
+        const int id = static_cast<int>(reinterpret_cast<intptr_t>(native_events[i].udata));
+        unsigned int eventTypes = (native_events[i].filter == EVFILT_READ) ? SCE_NET_EPOLLIN : SCE_NET_EPOLLOUT;
+        if (native_events[i].flags & (EV_EOF | EV_ERROR))
+            eventTypes |= SCE_NET_EPOLLERR;
 
+        const auto it = std::find_if(ready.begin(), ready.end(), [id](const auto &event) { return event.first == id; });
+        if (it != ready.end())
+            it->second |= eventTypes;
+        else
+            ready.emplace_back(id, eventTypes);
+    }
+    for (const auto &[id, eventTypes] : ready)
+        add_ready_event(*this, events, eventCount, id, eventTypes | take_buffered_socket(buffered, id));
+#else
+    std::vector<WSAPOLLFD> fds;
+    std::vector<int> ids;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (poll_fds_dirty) {
+            poll_fds.clear();
+            poll_ids.clear();
+            for (const auto &[id, epollSocket] : eventEntries) {
+                WSAPOLLFD fd{};
+                fd.fd = epollSocket.sock;
+                if (epollSocket.events & SCE_NET_EPOLLIN)
+                    fd.events |= POLLRDNORM;
+                if (epollSocket.events & SCE_NET_EPOLLOUT)
+                    fd.events |= POLLWRNORM;
+                poll_fds.push_back(fd);
+                poll_ids.push_back(id);
+            }
+            poll_fds_dirty = false;
+        }
+        fds = poll_fds;
+        ids = poll_ids;
+    }
+
+    // WSAPoll fails without sockets
+    if (fds.empty()) {
+        if (timeout_microseconds > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(timeout_microseconds));
+        return 0;
+    }
+
+    const int ret = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), get_timeout_ms(timeout_microseconds));
+    if (ret < 0) {
+        // TODO: translate error code
+        return -1;
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; (i < fds.size()) && (eventCount < maxevents); i++) {
         unsigned int eventTypes = 0;
-        if (FD_ISSET(pair.second.sock, &readFds)) {
+        if (fds[i].revents & (POLLRDNORM | POLLHUP))
             eventTypes |= SCE_NET_EPOLLIN;
-        }
-        if (FD_ISSET(pair.second.sock, &writeFds)) {
+        if (fds[i].revents & POLLWRNORM)
             eventTypes |= SCE_NET_EPOLLOUT;
-        }
-        if (FD_ISSET(pair.second.sock, &exceptFds)) {
+        if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
             eventTypes |= SCE_NET_EPOLLERR;
-        }
-
-        if (eventTypes != 0 && eventCount < maxevents) {
-            auto i = eventCount++;
-
-            events[i].events = eventTypes;
-            events[i].data = pair.second.data;
-        }
+        eventTypes |= take_buffered_socket(buffered, ids[i]);
+        if (eventTypes != 0)
+            add_ready_event(*this, events, eventCount, ids[i], eventTypes);
     }
+#endif
+
+    // still under the lock of the platform
+    add_buffered_events(*this, events, eventCount, maxevents, buffered);
 
     return eventCount;
 }
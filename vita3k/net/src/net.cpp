@@ -18,6 +18,33 @@
 #include <net/functions.h>
 #include <net/state.h>
 
+#include <chrono>
+
 bool init(NetState &state) {
     return true;
 }
+
+NetStatsSnapshot NetStats::get_snapshot() {
+    const std::lock_guard<std::mutex> guard(snapshot_mutex);
+    const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (snapshot_time_ns == 0) {
+        snapshot_time_ns = now;
+        return snapshot;
+    }
+    if (now - snapshot_time_ns < 1'000'000'000)
+        return snapshot;
+
+    // scale the counters to one second
+    const float to_per_second = 1'000'000'000.f / static_cast<float>(now - snapshot_time_ns);
+    snapshot_time_ns = now;
+
+    snapshot.packets_received = packets_received.exchange(0, std::memory_order_relaxed) * to_per_second;
+    snapshot.packets_sent = packets_sent.exchange(0, std::memory_order_relaxed) * to_per_second;
+    const uint64_t datagrams = datagrams_received.exchange(0, std::memory_order_relaxed);
+    const uint64_t receptions = datagram_receptions.exchange(0, std::memory_order_relaxed);
+    const uint64_t wait = datagram_wait_ns.exchange(0, std::memory_order_relaxed);
+    snapshot.datagrams_per_reception = receptions ? static_cast<float>(datagrams) / static_cast<float>(receptions) : 0.f;
+    snapshot.datagram_wait_us = datagrams ? static_cast<float>(wait) / static_cast<float>(datagrams) / 1000.f : 0.f;
+
+    return snapshot;
+}
@@ -18,6 +18,14 @@
 #include <cstring>
 #include <net/socket.h>
 
+#include <algorithm>
+#include <chrono>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
 // NOTE: This should be SCE_NET_##errname but it causes vitaQuake to softlock in online games
 #ifdef WIN32
 #define ERROR_CASE(errname) \
@@ -142,10 +150,151 @@ static void convertPosixSockaddrToSce(struct sockaddr *src, struct SceNetSockadd
     memcpy(&dst_in->sin_addr, &src_in->sin_addr, 4);
 }
 
+static bool would_block() {
+#ifdef WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return (errno == EWOULDBLOCK) || (errno == EAGAIN);
+#endif
+}
+
+#ifdef WIN32
+// WSAPoll can't wait on anything else than sockets, so the blocked calls check for aborts between short waits
+constexpr int ABORT_CHECK_INTERVAL_MS = 100;
+#endif
+
+void PosixSocket::init_non_blocking() {
+    int type = 0;
+    socklen_t type_len = sizeof(type);
+    is_datagram = (getsockopt(sock, SOL_SOCKET, SO_TYPE, reinterpret_cast<char *>(&type), &type_len) == 0) && (type == SOCK_DGRAM);
+
+#ifdef WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(sock, FIONBIO, &non_blocking);
+#else
+    int non_blocking = 1;
+    ioctl(sock, FIONBIO, &non_blocking);
+    if (pipe(wake_fds) == 0) {
+        fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+    } else {
+        wake_fds[0] = wake_fds[1] = -1;
+    }
+#endif
+}
+
+PosixSocket::~PosixSocket() {
+#ifndef WIN32
+    for (const int fd : wake_fds) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+#endif
+}
+
+int PosixSocket::abort() {
+    abort_generation++;
+#ifndef WIN32
+    if (wake_fds[1] >= 0) {
+        const char wake = 1;
+        (void)!write(wake_fds[1], &wake, 1);
+    }
+#endif
+    return 0;
+}
+
+int PosixSocket::wait_ready(const bool write, const int timeout_microseconds) {
+    const uint32_t generation = abort_generation.load();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_microseconds);
+
+    while (true) {
+        if (abort_generation.load() != generation)
+            return SCE_NET_ERROR_EINTR;
+
+        int wait_ms = -1;
+        if (timeout_microseconds > 0) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0)
+                return SCE_NET_ERROR_EWOULDBLOCK;
+            wait_ms = static_cast<int>((remaining + 999) / 1000);
+        }
+
+#ifdef WIN32
+        wait_ms = (wait_ms < 0) ? ABORT_CHECK_INTERVAL_MS : std::min(wait_ms, ABORT_CHECK_INTERVAL_MS);
+        WSAPOLLFD fd{};
+        fd.fd = sock;
+        fd.events = write ? POLLWRNORM : POLLRDNORM;
+        const int ret = WSAPoll(&fd, 1, wait_ms);
+        if (ret < 0)
+            return translate_return_value(ret);
+        if (ret > 0)
+            return 0;
+#else
+        pollfd fds[2] = {
+            { sock, static_cast<short>(write ? POLLOUT : POLLIN), 0 },
+            { wake_fds[0], POLLIN, 0 },
+        };
+        const int ret = poll(fds, (wake_fds[0] >= 0) ? 2 : 1, wait_ms);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return translate_return_value(ret);
+        }
+        if (fds[0].revents != 0)
+            return 0;
+        if ((fds[1].revents & POLLIN) && (abort_generation.load() == generation)) {
+            // woken up by an abort of a previous call
+            char wake[16];
+            while (read(wake_fds[0], wake, sizeof(wake)) > 0) {
+            }
+        }
+#endif
+    }
+}
+
+// retry a call of a blocking socket each time the host socket is ready, until it no longer would block
+template <typename Call>
+static int call_blocking(PosixSocket &socket, const bool blocking, const bool write, const int timeout_microseconds, Call call) {
+    while (true) {
+        const int res = call();
+        if ((res >= 0) || !blocking || !would_block())
+            return translate_return_value(res);
+
+        const int wait_res = socket.wait_ready(write, timeout_microseconds);
+        if (wait_res < 0)
+            return wait_res;
+    }
+}
+
 int PosixSocket::connect(const SceNetSockaddr *addr, unsigned int namelen) {
     struct sockaddr addr2;
     convertSceSockaddrToPosix(addr, &addr2);
-    return translate_return_value(::connect(sock, &addr2, sizeof(struct sockaddr_in)));
+    const int res = ::connect(sock, &addr2, sizeof(struct sockaddr_in));
+#ifdef WIN32
+    const bool in_progress = (res < 0) && (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+    const bool in_progress = (res < 0) && (errno == EINPROGRESS);
+#endif
+    if (!in_progress || sockopt_so_nbio)
+        return translate_return_value(res);
+
+    // the connection is done once the socket is writable
+    const int wait_res = wait_ready(true, sockopt_so_sndtimeo);
+    if (wait_res < 0)
+        return wait_res;
+
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &error_len);
+    if (error == 0)
+        return 0;
+
+#ifdef WIN32
+    WSASetLastError(error);
+#else
+    errno = error;
+#endif
+    return translate_return_value(-1);
 }
 
 int PosixSocket::bind(const SceNetSockaddr *addr, unsigned int addrlen) {
@@ -173,6 +322,8 @@ int PosixSocket::get_socket_address(SceNetSockaddr *name, unsigned int *namelen)
 }
 
 int PosixSocket::close() {
+    // the calls blocked on the socket would never return otherwise
+    abort();
 #ifdef WIN32
     auto out = closesocket(sock);
 #else
@@ -183,11 +334,17 @@ int PosixSocket::close() {
 
 SocketPtr PosixSocket::accept(SceNetSockaddr *addr, unsigned int *addrlen) {
     struct sockaddr addr2;
-    abs_socket new_socket = ::accept(sock, &addr2, (socklen_t *)addrlen);
-    if (new_socket >= 0) {
+    abs_socket new_socket = -1;
+    const int res = call_blocking(*this, !sockopt_so_nbio, false, sockopt_so_rcvtimeo, [&]() {
+        new_socket = ::accept(sock, &addr2, (socklen_t *)addrlen);
+        return (new_socket >= 0) ? 0 : -1;
+    });
+    if ((res >= 0) && (new_socket >= 0)) {
         convertPosixSockaddrToSce(&addr2, addr);
         *addrlen = sizeof(SceNetSockaddrIn);
-        return std::make_shared<PosixSocket>(new_socket);
+        auto accepted = std::make_shared<PosixSocket>(new_socket);
+        accepted->stats = stats;
+        return accepted;
     }
     return nullptr;
 }
@@ -226,8 +383,8 @@ int PosixSocket::set_socket_options(int level, int optname, const void *optval,
             CASE_SETSOCKOPT(SO_RCVBUF);
             CASE_SETSOCKOPT(SO_SNDLOWAT);
             CASE_SETSOCKOPT(SO_RCVLOWAT);
-            CASE_SETSOCKOPT(SO_SNDTIMEO);
-            CASE_SETSOCKOPT(SO_RCVTIMEO);
+            CASE_SETSOCKOPT_VALUE(SCE_NET_SO_SNDTIMEO, &sockopt_so_sndtimeo);
+            CASE_SETSOCKOPT_VALUE(SCE_NET_SO_RCVTIMEO, &sockopt_so_rcvtimeo);
             CASE_SETSOCKOPT(SO_ERROR);
             CASE_SETSOCKOPT(SO_TYPE);
             CASE_SETSOCKOPT_VALUE(SCE_NET_SO_REUSEPORT, &sockopt_so_reuseport);
@@ -241,13 +398,9 @@ int PosixSocket::set_socket_options(int level, int optname, const void *optval,
             if (optlen != sizeof(sockopt_so_nbio)) {
                 return SCE_NET_ERROR_EFAULT;
             }
+            // the host socket stays non blocking, the blocking calls wait in wait_ready
             memcpy(&sockopt_so_nbio, optval, optlen);
-#ifdef WIN32
-            static_assert(sizeof(u_long) == sizeof(sockopt_so_nbio), "type used for ioctlsocket value does not have the expected size");
-            return translate_return_value(ioctlsocket(sock, FIONBIO, (u_long *)&sockopt_so_nbio));
-#else
-            return translate_return_value(ioctl(sock, FIONBIO, &sockopt_so_nbio));
-#endif
+            return 0;
         }
         }
     } else if (level == IPPROTO_IP) {
@@ -304,8 +457,8 @@ int PosixSocket::get_socket_options(int level, int optname, void *optval, unsign
             CASE_GETSOCKOPT(SO_RCVBUF);
             CASE_GETSOCKOPT(SO_SNDLOWAT);
             CASE_GETSOCKOPT(SO_RCVLOWAT);
-            CASE_GETSOCKOPT(SO_SNDTIMEO);
-            CASE_GETSOCKOPT(SO_RCVTIMEO);
+            CASE_GETSOCKOPT_VALUE(SCE_NET_SO_SNDTIMEO, sockopt_so_sndtimeo);
+            CASE_GETSOCKOPT_VALUE(SCE_NET_SO_RCVTIMEO, sockopt_so_rcvtimeo);
             CASE_GETSOCKOPT(SO_ERROR);
             CASE_GETSOCKOPT(SO_TYPE);
             CASE_GETSOCKOPT_VALUE(SCE_NET_SO_NBIO, sockopt_so_nbio);
@@ -339,25 +492,118 @@ int PosixSocket::get_socket_options(int level, int optname, void *optval, unsign
     return SCE_NET_ERROR_EINVAL;
 }
 
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+// an empty ring is filled with all the datagrams the host already queued in a single recvmmsg, the guest then gets them one by one
+int PosixSocket::recv_datagram(void *buf, unsigned int len, const bool peek, const bool blocking, SceNetSockaddr *from, unsigned int *fromlen) {
+    return call_blocking(*this, blocking, false, sockopt_so_rcvtimeo, [&]() {
+        const std::lock_guard<std::mutex> guard(datagram_ring_mutex);
+        if (!datagram_ring) {
+            datagram_ring = std::make_unique<DatagramRing>();
+            for (int i = 0; i < DatagramRing::SIZE; i++) {
+                datagram_ring->iovecs[i].iov_base = datagram_ring->data.get() + i * DatagramRing::DATAGRAM_SIZE;
+                datagram_ring->iovecs[i].iov_len = DatagramRing::DATAGRAM_SIZE;
+                datagram_ring->headers[i].msg_hdr.msg_iov = &datagram_ring->iovecs[i];
+                datagram_ring->headers[i].msg_hdr.msg_iovlen = 1;
+                datagram_ring->headers[i].msg_hdr.msg_name = &datagram_ring->addrs[i];
+            }
+        }
+
+        DatagramRing &ring = *datagram_ring;
+        if (ring.count == 0) {
+            // the lengths are written back by the host
+            for (auto &header : ring.headers)
+                header.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            const int res = recvmmsg(sock, ring.headers.data(), DatagramRing::SIZE, 0, nullptr);
+            if (res <= 0)
+                return res;
+
+            ring.received_ns = now_ns();
+            ring.next = 0;
+            ring.count = res;
+            datagrams_buffered->store(res);
+            if (stats) {
+                stats->datagrams_received += res;
+                stats->datagram_receptions++;
+            }
+        }
+
+        // the part of the datagram which doesn't fit in the buffer is dropped, like by recvfrom
+        const int index = ring.next;
+        const unsigned int size = std::min<unsigned int>(ring.headers[index].msg_len, len);
+        memcpy(buf, ring.iovecs[index].iov_base, size);
+        if (from != nullptr) {
+            convertPosixSockaddrToSce(reinterpret_cast<sockaddr *>(&ring.addrs[index]), from);
+            *fromlen = sizeof(SceNetSockaddrIn);
+        }
+
+        if (!peek) {
+            ring.next++;
+            ring.count--;
+            datagrams_buffered->store(ring.count);
+            if (stats) {
+                stats->packets_received++;
+                stats->datagram_wait_ns += now_ns() - ring.received_ns;
+            }
+        }
+
+        return static_cast<int>(size);
+    });
+}
+#endif
+
 int PosixSocket::recv_packet(void *buf, unsigned int len, int flags, SceNetSockaddr *from, unsigned int *fromlen) {
+    const bool blocking = !sockopt_so_nbio && !(flags & SCE_NET_MSG_DONTWAIT);
+    flags &= ~SCE_NET_MSG_DONTWAIT;
+
+#ifdef __linux__
+    // the datagrams already read must be served first, whatever the flags
+    if (is_datagram && (((flags & ~SCE_NET_MSG_PEEK) == 0) || (datagrams_buffered->load() != 0)))
+        return recv_datagram(buf, len, flags & SCE_NET_MSG_PEEK, blocking, from, fromlen);
+#endif
+
+    int res;
     if (from != nullptr) {
         struct sockaddr addr;
-        int res = recvfrom(sock, (char *)buf, len, flags, &addr, (socklen_t *)fromlen);
+        res = call_blocking(*this, blocking, false, sockopt_so_rcvtimeo, [&]() {
+            return recvfrom(sock, (char *)buf, len, flags, &addr, (socklen_t *)fromlen);
+        });
         convertPosixSockaddrToSce(&addr, from);
         *fromlen = sizeof(SceNetSockaddrIn);
-
-        return translate_return_value(res);
     } else {
-        return translate_return_value(recv(sock, (char *)buf, len, flags));
+        res = call_blocking(*this, blocking, false, sockopt_so_rcvtimeo, [&]() {
+            return recv(sock, (char *)buf, len, flags);
+        });
     }
+
+    if ((res >= 0) && stats)
+        stats->packets_received++;
+
+    return res;
 }
 
 int PosixSocket::send_packet(const void *msg, unsigned int len, int flags, const SceNetSockaddr *to, unsigned int tolen) {
+    const bool blocking = !sockopt_so_nbio && !(flags & SCE_NET_MSG_DONTWAIT);
+    flags &= ~SCE_NET_MSG_DONTWAIT;
+
+    int res;
     if (to != nullptr) {
         struct sockaddr addr;
         convertSceSockaddrToPosix((SceNetSockaddr *)to, &addr);
-        return translate_return_value(sendto(sock, (const char *)msg, len, flags, &addr, sizeof(struct sockaddr_in)));
+        res = call_blocking(*this, blocking, true, sockopt_so_sndtimeo, [&]() {
+            return sendto(sock, (const char *)msg, len, flags, &addr, sizeof(struct sockaddr_in));
+        });
     } else {
-        return translate_return_value(send(sock, (const char *)msg, len, flags));
+        res = call_blocking(*this, blocking, true, sockopt_so_sndtimeo, [&]() {
+            return send(sock, (const char *)msg, len, flags);
+        });
     }
+
+    if ((res >= 0) && stats)
+        stats->packets_sent++;
+
+    return res;
 }
@@ -0,0 +1,206 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Times the NGS sample kernels against their scalar references and checks that they give the same result,
+// then runs a synthetic rack graph (player voices patched to submix busses, patched to a master) with both of them
+// to report how many voices are mixed per millisecond. Last, the SAS mixer is timed with more and more voices playing.
+// Returns a non-zero value if the kernels differ.
+
+#include <ngs/mixing.h>
+#include <ngs/sas.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace ngs;
+
+static constexpr int ITERATIONS = 200;
+
+static constexpr std::size_t GRANULARITIES[] = { 64, 256, 512, 1024 };
+
+// synthetic graph, the voices are spread over the busses
+static constexpr std::size_t GRAPH_VOICES = 128;
+static constexpr std::size_t GRAPH_BUSSES = 8;
+static constexpr std::size_t GRAPH_GRANULARITY = 512;
+
+// SAS voices looping a PCM buffer, each one with its pitch
+static constexpr std::uint32_t SAS_VOICE_COUNTS[] = { 1, 4, 8, 16, 32 };
+static constexpr std::uint32_t SAS_GRAIN = 256;
+static constexpr std::size_t SAS_PCM_SAMPLES = 4096;
+
+struct Kernels {
+    void (*mix)(float *, const float *, const float[2][2], std::size_t);
+    void (*scale)(float *, float, std::size_t);
+    void (*convert)(std::int16_t *, const float *, std::size_t);
+};
+
+static constexpr Kernels BASIC_KERNELS = { mix_stereo_basic, scale_samples_basic, float_to_s16_basic };
+static constexpr Kernels FAST_KERNELS = { mix_stereo, scale_samples, float_to_s16 };
+
+static double time_us(const std::function<void()> &run) {
+    run();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        run();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / ITERATIONS;
+}
+
+template <typename T>
+static bool bench(const char *name, std::size_t granularity, const std::vector<T> &initial, const std::function<void(T *)> &basic, const std::function<void(T *)> &fast) {
+    std::vector<T> basic_dst = initial;
+    std::vector<T> fast_dst = initial;
+    // the kernels accumulate in place, only compare a single run
+    basic(basic_dst.data());
+    fast(fast_dst.data());
+    const bool same = std::memcmp(basic_dst.data(), fast_dst.data(), initial.size() * sizeof(T)) == 0;
+
+    const double basic_time = time_us([&]() { basic(basic_dst.data()); });
+    const double fast_time = time_us([&]() { fast(fast_dst.data()); });
+
+    std::printf("%-16s %6zu %10.2f us %10.2f us %6.2fx%s\n", name, granularity, basic_time, fast_time,
+        basic_time / fast_time, same ? "" : "  MISMATCH");
+    return same;
+}
+
+struct Graph {
+    std::vector<std::vector<float>> voices;
+    std::vector<float> volume_matrices;
+    std::vector<std::vector<float>> busses;
+    std::vector<float> master;
+    std::vector<std::int16_t> output;
+
+    void run(const Kernels &kernels) {
+        for (std::vector<float> &bus : busses)
+            std::fill(bus.begin(), bus.end(), 0.0f);
+        std::fill(master.begin(), master.end(), 0.0f);
+
+        for (std::size_t i = 0; i < voices.size(); i++) {
+            const auto *volume_matrix = reinterpret_cast<const float(*)[2]>(&volume_matrices[i * 4]);
+            kernels.mix(busses[i % busses.size()].data(), voices[i].data(), volume_matrix, GRAPH_GRANULARITY);
+        }
+
+        const float identity[2][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+        for (std::vector<float> &bus : busses) {
+            kernels.scale(bus.data(), 0.5f, bus.size());
+            kernels.mix(master.data(), bus.data(), identity, GRAPH_GRANULARITY);
+        }
+
+        kernels.convert(output.data(), master.data(), output.size());
+    }
+};
+
+int main() {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> sample_dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> gain_dist(0.0f, 1.0f);
+    bool success = true;
+
+    std::printf("Using %s kernels\n", get_mixing_isa());
+    std::printf("%-16s %6s %13s %13s %7s\n", "kernel", "frames", "basic", "fast", "speedup");
+    for (const std::size_t granularity : GRANULARITIES) {
+        std::vector<float> src(granularity * 2);
+        std::vector<float> dest(granularity * 2);
+        for (float &sample : src)
+            sample = sample_dist(rng);
+        for (float &sample : dest)
+            sample = sample_dist(rng);
+        const float volume_matrix[2][2] = { { gain_dist(rng), gain_dist(rng) }, { gain_dist(rng), gain_dist(rng) } };
+
+        success &= bench<float>("mix stereo", granularity, dest,
+            [&](float *dst) { mix_stereo_basic(dst, src.data(), volume_matrix, granularity); },
+            [&](float *dst) { mix_stereo(dst, src.data(), volume_matrix, granularity); });
+        std::vector<float> envelope(granularity);
+        for (float &gain : envelope)
+            gain = gain_dist(rng);
+        success &= bench<float>("mix mono", granularity, dest,
+            [&](float *dst) { mix_mono_to_stereo_basic(dst, src.data(), envelope.data(), volume_matrix[0][0], volume_matrix[0][1], granularity); },
+            [&](float *dst) { mix_mono_to_stereo(dst, src.data(), envelope.data(), volume_matrix[0][0], volume_matrix[0][1], granularity); });
+        // a pitch a bit higher than the source, the source has the samples after the last position
+        const std::uint32_t step = 0x1234;
+        std::vector<float> source(((granularity * step) >> RESAMPLE_FRACTION_BITS) + 2);
+        for (float &sample : source)
+            sample = sample_dist(rng);
+        success &= bench<float>("resample", granularity, std::vector<float>(granularity),
+            [&](float *dst) { resample_linear_basic(dst, source.data(), 0x123, step, granularity); },
+            [&](float *dst) { resample_linear(dst, source.data(), 0x123, step, granularity); });
+        success &= bench<float>("scale", granularity, dest,
+            [&](float *dst) { scale_samples_basic(dst, 0.999f, dest.size()); },
+            [&](float *dst) { scale_samples(dst, 0.999f, dest.size()); });
+
+        // go a bit out of [-1, 1] to check the clamping
+        for (float &sample : src)
+            sample *= 1.25f;
+        success &= bench<std::int16_t>("float to s16", granularity, std::vector<std::int16_t>(src.size()),
+            [&](std::int16_t *dst) { float_to_s16_basic(dst, src.data(), src.size()); },
+            [&](std::int16_t *dst) { float_to_s16(dst, src.data(), src.size()); });
+    }
+
+    Graph basic_graph;
+    basic_graph.voices.resize(GRAPH_VOICES, std::vector<float>(GRAPH_GRANULARITY * 2));
+    for (std::vector<float> &voice : basic_graph.voices)
+        for (float &sample : voice)
+            sample = sample_dist(rng) * 0.25f;
+    basic_graph.volume_matrices.resize(GRAPH_VOICES * 4);
+    for (float &gain : basic_graph.volume_matrices)
+        gain = gain_dist(rng);
+    basic_graph.busses.resize(GRAPH_BUSSES, std::vector<float>(GRAPH_GRANULARITY * 2));
+    basic_graph.master.resize(GRAPH_GRANULARITY * 2);
+    basic_graph.output.resize(GRAPH_GRANULARITY * 2);
+    Graph fast_graph = basic_graph;
+
+    const double basic_time = time_us([&]() { basic_graph.run(BASIC_KERNELS); });
+    const double fast_time = time_us([&]() { fast_graph.run(FAST_KERNELS); });
+    const bool same = basic_graph.output == fast_graph.output;
+    success &= same;
+
+    std::printf("\nrack graph: %zu voices, %zu busses, %zu frames\n", GRAPH_VOICES, GRAPH_BUSSES, GRAPH_GRANULARITY);
+    std::printf("basic: %10.2f us per update, %8.1f voices/ms\n", basic_time, GRAPH_VOICES * 1000.0 / basic_time);
+    std::printf("fast:  %10.2f us per update, %8.1f voices/ms%s\n", fast_time, GRAPH_VOICES * 1000.0 / fast_time, same ? "" : "  MISMATCH");
+
+    std::vector<std::int16_t> pcm(SAS_PCM_SAMPLES);
+    for (std::int16_t &sample : pcm)
+        sample = static_cast<std::int16_t>(sample_dist(rng) * 16384.0f);
+    std::uniform_int_distribution<std::int32_t> pitch_dist(sas::PITCH_BASE / 2, sas::PITCH_BASE * 2);
+    std::vector<std::int16_t> sas_output(SAS_GRAIN * 2);
+
+    // the real time budget of a grain at 48 kHz
+    const double grain_us = SAS_GRAIN * 1000000.0 / 48000.0;
+    std::printf("\nsas mixer: %u frames per grain, %.2f us of audio\n", SAS_GRAIN, grain_us);
+    std::printf("%6s %13s %13s %10s\n", "voices", "per grain", "per voice", "budget");
+    for (const std::uint32_t voice_count : SAS_VOICE_COUNTS) {
+        sas::Core core(voice_count, SAS_GRAIN);
+        for (sas::Voice &voice : core.voices) {
+            voice.type = sas::SourceType::PCM;
+            voice.data = reinterpret_cast<const std::uint8_t *>(pcm.data());
+            voice.size = static_cast<std::uint32_t>(pcm.size() * sizeof(std::int16_t));
+            voice.loop = true;
+            voice.pitch = pitch_dist(rng);
+            voice.volumes = { sas::VOLUME_MAX / 4, sas::VOLUME_MAX / 4, 0, 0 };
+            voice.key_on();
+        }
+
+        const double time = time_us([&]() { core.process(sas_output.data()); });
+        std::printf("%6u %10.2f us %10.2f us %9.2f%%\n", voice_count, time, time / voice_count, time * 100.0 / grain_us);
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The sample kernels of the modules and the patches have SIMD implementations, the one used is picked
+// at runtime according to what the host supports. The basic implementations are the scalar references.
+#if defined(__x86_64__) || defined(_M_X64)
+#define NGS_MIXING_X86
+// msvc allows to use any intrinsic independently of the architecture flags, other compilers need the target attribute
+#if defined(_MSC_VER) && !defined(__clang__)
+#define NGS_MIXING_TARGET(isa)
+#else
+#define NGS_MIXING_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NGS_MIXING_NEON
+#endif
+
+namespace ngs {
+
+// the resampling positions are fixed point numbers with this many bits for the fraction
+constexpr std::uint32_t RESAMPLE_FRACTION_BITS = 12;
+constexpr std::uint32_t RESAMPLE_FRACTION_MASK = (1 << RESAMPLE_FRACTION_BITS) - 1;
+
+// name of the instruction set used by the kernels, for the logs and the benchmark
+const char *get_mixing_isa();
+
+// add the interleaved stereo frames of src to dest through the volume matrix (source channel, dest channel), clamped to [-1, 1]
+void mix_stereo_basic(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count);
+void mix_stereo(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count);
+
+// add the mono samples of src multiplied by their gain to the interleaved stereo frames of dest, with a gain per channel
+// the result is not clamped, the conversion to S16 does it
+void mix_mono_to_stereo_basic(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count);
+void mix_mono_to_stereo(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count);
+
+// linear interpolation of the mono samples of src at position, position + step... (fixed point positions)
+// src must hold the sample after the last position
+void resample_linear_basic(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count);
+void resample_linear(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count);
+
+void scale_samples_basic(float *samples, float gain, std::size_t count);
+void scale_samples(float *samples, float gain, std::size_t count);
+
+// convert the samples to S16, the ones out of [-1, 1] are clamped
+void float_to_s16_basic(std::int16_t *dest, const float *src, std::size_t count);
+void float_to_s16(std::int16_t *dest, const float *src, std::size_t count);
+
+} // namespace ngs
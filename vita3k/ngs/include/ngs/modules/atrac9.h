@@ -87,15 +87,28 @@ private:
     std::unique_ptr<Atrac9DecoderState> decoder;
     std::uint32_t last_config;
     std::vector<uint8_t> temp_buffer;
-
-    static SwrContext *swr_mono_to_stereo;
-    static SwrContext *swr_stereo;
-
+    // decoded samples of the current frame and superframe, kept to not allocate them on each decoded superframe
+    std::vector<uint8_t> frame_samples;
+    std::vector<uint8_t> superframe_samples;
+
+    // the output of a superframe depends on the one decoded before it, so it is part of the decoded cache key
+    std::uint64_t last_superframe_hash = 0;
+    std::vector<uint8_t> last_superframe;
+    // set when the last superframe came from the decoded cache, the decoder must decode it before the next one
+    bool is_decoder_behind = false;
+
+    // owned by the module, as the voices of different racks can be processed at the same time
+    SwrContext *swr_mono_to_stereo = nullptr;
+    SwrContext *swr_stereo = nullptr;
+
+    // decode all the frames of the superframe as stereo float samples in output if it is not null, bytes_used is increased by the size of the frames decoded
+    bool decode_superframe(const uint8_t *input, uint8_t *output, uint32_t &bytes_used);
     // return false if data could not be decoded (error or no more data available)
     bool decode_more_data(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, const Parameters *params, State *state, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock);
 
 public:
     explicit Module();
+    ~Module() override;
 
     bool process(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) override;
     std::uint32_t module_id() const override { return 0x5CAA; }
@@ -104,5 +117,8 @@ public:
     void on_param_change(const MemState &mem, ModuleData &data) override;
 };
 
+// budget of the cache keeping the superframes decoded by all the atrac9 voices, so looped music is only decoded once, 0 disables it
+void set_decoded_cache_size(std::size_t size_in_bytes);
+
 void get_buffer_parameter(std::uint32_t start_sample, std::uint32_t num_samples, std::uint32_t info, SkipBufferInfo &parameter);
 } // namespace ngs::atrac9
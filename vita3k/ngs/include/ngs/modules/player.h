@@ -97,6 +97,8 @@ struct Parameters {
 struct Module : public ngs::Module {
 private:
     std::unique_ptr<PCMDecoderState> decoder;
+    // samples received from the decoder before being resampled, kept to not allocate it on each update
+    std::vector<std::uint8_t> decoded_samples;
 
 public:
     explicit Module();
@@ -0,0 +1,101 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <ngs/common.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace ngs {
+
+enum ProfileStage : std::uint32_t {
+    PROFILE_DECODE,
+    PROFILE_RESAMPLE,
+    PROFILE_MIX,
+    PROFILE_CALLBACK,
+    PROFILE_STAGE_COUNT
+};
+
+static constexpr std::size_t PROFILE_MODULE_TYPE_COUNT = static_cast<std::size_t>(BussType::BUSS_NORMAL_PLAYER) + 1;
+
+// figures of the last second of NGS updates, shown in the performance overlay
+struct ProfileSnapshot {
+    // milliseconds spent per second
+    std::array<float, PROFILE_STAGE_COUNT> stage_ms{};
+    std::array<float, PROFILE_MODULE_TYPE_COUNT> module_ms{};
+    float update_ms = 0.f;
+    // time of the updates over the duration of the audio they produced
+    float budget_usage = 0.f;
+    float voice_us = 0.f;
+    std::uint32_t updates = 0;
+};
+
+// time spent by the NGS updates, the voices can be processed on several threads so the counters are atomics
+struct Profile {
+    std::array<std::atomic<std::uint64_t>, PROFILE_STAGE_COUNT> stage_ns{};
+    std::array<std::atomic<std::uint64_t>, PROFILE_MODULE_TYPE_COUNT> module_ns{};
+    std::atomic<std::uint64_t> update_ns = 0;
+    std::atomic<std::uint64_t> budget_ns = 0;
+    std::atomic<std::uint64_t> voices_processed = 0;
+    std::atomic<std::uint32_t> updates = 0;
+
+    void add_stage(const ProfileStage stage, const std::uint64_t ns) {
+        stage_ns[stage].fetch_add(ns, std::memory_order_relaxed);
+    }
+    void add_module(const BussType type, const std::uint64_t ns) {
+        const auto index = static_cast<std::size_t>(type);
+        if (index < PROFILE_MODULE_TYPE_COUNT)
+            module_ns[index].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // the counters are turned into a new snapshot once a second has passed since the previous one
+    ProfileSnapshot get_snapshot();
+
+private:
+    std::mutex snapshot_mutex;
+    std::uint64_t snapshot_time_ns = 0;
+    ProfileSnapshot snapshot;
+};
+
+// steady clock in nanoseconds
+std::uint64_t profile_now_ns();
+const char *get_buss_type_name(BussType type);
+
+// adds the time of its scope to a stage, does nothing without a profile
+class ProfileScope {
+    Profile *profile;
+    ProfileStage stage;
+    std::uint64_t start;
+
+public:
+    ProfileScope(Profile *profile, const ProfileStage stage)
+        : profile(profile)
+        , stage(stage)
+        , start(profile ? profile_now_ns() : 0) {}
+    ~ProfileScope() {
+        if (profile)
+            profile->add_stage(stage, profile_now_ns() - start);
+    }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+} // namespace ngs
@@ -0,0 +1,161 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Software mixer of SceSas: up to 32 voices playing VAG (PS-ADPCM), 16-bit PCM or noise with their pitch and ADSR envelope,
+// mixed each grain with the NGS sample kernels
+namespace ngs::sas {
+
+constexpr std::uint32_t MAX_VOICES = 32;
+constexpr std::uint32_t MIN_GRAIN = 64;
+constexpr std::uint32_t MAX_GRAIN = 2048;
+constexpr std::uint32_t DEFAULT_GRAIN = 256;
+
+// 0x1000 plays the voice at its rate
+constexpr std::int32_t PITCH_BASE = 0x1000;
+constexpr std::int32_t PITCH_MAX = 0x4000;
+constexpr std::int32_t VOLUME_MAX = 0x1000;
+constexpr std::int32_t ENVELOPE_HEIGHT_MAX = 0x40000000;
+constexpr std::uint32_t NOISE_CLOCK_MAX = 63;
+
+enum class SourceType {
+    None,
+    ADPCM,
+    PCM,
+    Noise
+};
+
+enum class OutputMode : std::uint32_t {
+    Stereo = 0,
+    Mono = 1
+};
+
+enum class EnvelopeCurve : std::uint32_t {
+    LinearIncrease = 0,
+    LinearDecrease = 1,
+    LinearBent = 2,
+    ExponentDecrease = 3,
+    ExponentIncrease = 4,
+    Direct = 5
+};
+
+// the parameters of an ADSR call are set for the phases whose bit is in the flags
+enum EnvelopePhase : std::uint32_t {
+    ENVELOPE_ATTACK,
+    ENVELOPE_DECAY,
+    ENVELOPE_SUSTAIN,
+    ENVELOPE_RELEASE,
+    ENVELOPE_PHASE_COUNT,
+    ENVELOPE_OFF = ENVELOPE_PHASE_COUNT
+};
+
+struct Envelope {
+    // by default the voice starts at full height, keeps it and stops at the key off
+    std::array<EnvelopeCurve, ENVELOPE_PHASE_COUNT> curves = { EnvelopeCurve::Direct, EnvelopeCurve::LinearDecrease, EnvelopeCurve::LinearDecrease, EnvelopeCurve::Direct };
+    std::array<std::int32_t, ENVELOPE_PHASE_COUNT> rates = { ENVELOPE_HEIGHT_MAX, 0, 0, 0 };
+    std::int32_t sustain_level = ENVELOPE_HEIGHT_MAX;
+
+    std::int32_t height = 0;
+    EnvelopePhase phase = ENVELOPE_OFF;
+
+    void key_on();
+    void key_off();
+    // advance the envelope by a sample
+    void step();
+};
+
+// turn the 16-bit ADSR of the PSP SPU into the parameters of the envelope
+void set_simple_adsr(Envelope &envelope, std::uint16_t adsr1, std::uint16_t adsr2);
+
+struct Voice {
+    SourceType type = SourceType::None;
+    // source in host memory, the samples of PCM voices are signed 16-bit mono
+    const std::uint8_t *data = nullptr;
+    std::uint32_t size = 0;
+    bool loop = false;
+    // sample looped back to at the end of the PCM voices
+    std::uint32_t pcm_loop_start = 0;
+    std::uint32_t noise_clock = 0;
+
+    std::int32_t pitch = PITCH_BASE;
+    // left and right of the dry and wet paths
+    std::array<std::int32_t, 4> volumes = { VOLUME_MAX, VOLUME_MAX, 0, 0 };
+    std::int32_t distortion = 0;
+    bool paused = false;
+    // keyed on and not ended yet
+    bool playing = false;
+
+    Envelope envelope;
+
+    // decoding state, reset at the key on
+    std::uint32_t read_offset = 0;
+    std::uint32_t adpcm_loop_offset = 0;
+    std::int32_t adpcm_history[2] = {};
+    std::uint32_t noise_seed = 1;
+    std::uint32_t noise_hold = 0;
+    float noise_sample = 0.f;
+    bool source_ended = false;
+    // decoded samples, the first one is at the integer part of the position
+    std::vector<float> samples;
+    // silent samples added after the end of the source so the last ones can be interpolated
+    std::uint32_t padding = 0;
+    std::uint32_t position = 0;
+
+    void key_on();
+    void key_off();
+    bool is_ended() const {
+        return !playing;
+    }
+};
+
+struct Core {
+    std::uint32_t grain;
+    OutputMode output_mode = OutputMode::Stereo;
+    std::vector<Voice> voices;
+
+    // effect parameters, kept but not applied
+    bool dry_enabled = true;
+    bool wet_enabled = false;
+    std::int32_t effect_type = 0;
+    std::int32_t effect_delay = 0;
+    std::int32_t effect_feedback = 0;
+    std::int32_t effect_volumes[2] = {};
+
+    // peaks (in S16 scale) of the last grain, left and right
+    std::int32_t dry_peak[2] = {};
+    std::int32_t pre_master_peak[2] = {};
+
+    Core(std::uint32_t voice_count, std::uint32_t grain);
+
+    // mix a grain of the voices into out, interleaved S16 stereo frames or mono samples according to the output mode
+    // the samples of mix_in (same format) are added before with their volume if it is given
+    void process(std::int16_t *out, const std::int16_t *mix_in = nullptr, std::int32_t mix_left = 0, std::int32_t mix_right = 0);
+
+private:
+    std::vector<float> dry;
+    std::vector<float> resampled;
+    std::vector<float> gains;
+};
+
+} // namespace ngs::sas
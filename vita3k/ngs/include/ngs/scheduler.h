@@ -20,10 +20,13 @@
 #include <util/types.h>
 
 #include <mem/ptr.h>
+#include <threads/job_pool.h>
 
 #include <thread>
 
 #include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <vector>
@@ -38,6 +41,7 @@ struct Patch;
 struct Rack;
 struct System;
 struct State;
+struct Profile;
 
 enum class PendingType {
     ReleaseRack
@@ -66,6 +70,13 @@ struct VoiceScheduler {
     std::condition_variable_any condvar;
     bool is_updating = false;
 
+    // processes the independent voices of an update in parallel mode, created on its first use
+    std::unique_ptr<JobPool> voice_pool;
+
+    Profile *profile = nullptr;
+    // duration of the audio produced by an update
+    std::uint64_t update_budget_ns = 0;
+
 protected:
     bool deque_voice_impl(Voice *voice);
     void deque_insert(const MemState &mem, Voice *voice);
@@ -74,6 +85,15 @@ protected:
 
     std::int32_t get_position(Voice *v);
 
+    // run the modules of the voice, return true if one of them finished and set its id
+    bool process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, std::uint32_t &finished_module,
+        std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock);
+    // stop the voice if it finished and send its products to the voices it is patched to
+    void complete_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, const bool finished, const std::uint32_t finished_module,
+        std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock);
+    void update_parallel(KernelState &kern, const MemState &mem, const SceUID thread_id, const std::vector<Voice *> &voices,
+        std::unique_lock<std::recursive_mutex> &scheduler_lock);
+
 public:
     bool deque_voice(Voice *voice);
 
@@ -83,7 +103,8 @@ public:
     bool stop(Voice *voice);
     bool off(Voice *voice);
 
-    void update(KernelState &kern, const MemState &mem, const SceUID thread_id);
+    // with parallel set, the voices not patched to each other are processed at the same time by worker threads
+    void update(KernelState &kern, const MemState &mem, const SceUID thread_id, const bool parallel = false);
 
     Ptr<Patch> patch(const MemState &mem, PatchSetupInfo *info);
 };
@@ -24,6 +24,7 @@
 #include <mem/mempool.h>
 #include <mem/ptr.h>
 #include <ngs/common.h>
+#include <ngs/profile.h>
 
 struct MemState;
 
@@ -34,6 +35,8 @@ struct System;
 struct State : public MempoolObject {
     std::map<BussType, Ptr<VoiceDefinition>> definitions;
     std::vector<System *> systems;
+    // shared by all the systems, read by the performance overlay
+    Profile profile;
 };
 
 bool init(State &ngs, MemState &mem);
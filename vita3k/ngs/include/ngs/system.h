@@ -20,6 +20,7 @@
 #include <array>
 #include <cstdint>
 #include <mutex>
+#include <span>
 #include <vector>
 
 #include <mem/ptr.h>
@@ -27,6 +28,7 @@
 
 #include <mem/mempool.h>
 #include <ngs/common.h>
+#include <ngs/profile.h>
 #include <ngs/scheduler.h>
 
 struct MemState;
@@ -200,18 +202,34 @@ struct VoiceProduct {
 };
 
 struct VoiceInputManager {
-    using PCMInput = std::vector<std::uint8_t>;
+    // the buffers are views into the input arena of the rack
+    using PCMInput = std::span<std::uint8_t>;
     using PCMInputs = std::vector<PCMInput>;
 
+    static constexpr std::uint16_t VOICE_INPUT_COUNT = 1;
+
     PCMInputs inputs;
 
-    void init(const std::uint32_t granularity, const std::uint16_t total_input);
+    // size of the buffers of a voice, they are next to each other starting at the buffer given to init
+    static std::uint32_t get_buffer_size(const std::uint32_t granularity, const std::uint16_t total_input);
+
+    void init(std::uint8_t *buffer, const std::uint32_t granularity, const std::uint16_t total_input);
     void reset_inputs();
 
     PCMInput *get_input_buffer_queue(const std::int32_t index);
     std::int32_t receive(Patch *patch, const VoiceProduct &data);
 };
 
+// guest callback raised while the voice was processed on a worker thread
+struct DeferredCallback {
+    Ptr<void> callback;
+    Ptr<void> user_data;
+    std::uint32_t module_id;
+    std::uint32_t reason1;
+    std::uint32_t reason2;
+    Address reason_ptr;
+};
+
 struct Voice {
     Rack *rack;
 
@@ -234,7 +252,11 @@ struct Voice {
     Ptr<void> finished_callback;
     Ptr<void> finished_callback_user_data;
 
-    void init(Rack *mama);
+    // set while the voice is processed by a worker of the scheduler, the callbacks are then run later on the update thread
+    bool defer_callbacks = false;
+    std::vector<DeferredCallback> deferred_callbacks;
+
+    void init(Rack *mama, std::uint8_t *input_buffer);
 
     ModuleData *module_storage(const std::uint32_t index);
 
@@ -264,6 +286,10 @@ struct Rack : public MempoolObject {
     std::vector<Ptr<Voice>> voices;
     std::vector<std::unique_ptr<Module>> modules;
 
+    // input buffers of all the voices one after the other, sized once when the rack is created so the update
+    // mixes the voices into neighbouring memory and never allocates
+    std::vector<std::uint8_t> input_arena;
+
     explicit Rack(System *mama, const Ptr<void> memspace, const std::uint32_t memspace_size);
 
     static std::uint32_t get_required_memspace_size(MemState &mem, RackDescription *description);
@@ -276,6 +302,7 @@ struct System : public MempoolObject {
     std::int32_t sample_rate;
 
     VoiceScheduler voice_scheduler;
+    Profile *profile = nullptr;
 
     explicit System(const Ptr<void> memspace, const std::uint32_t memspace_size);
     static std::uint32_t get_required_memspace_size(SystemInitParameters *parameters);
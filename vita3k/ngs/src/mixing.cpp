@@ -0,0 +1,396 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <ngs/mixing.h>
+
+#include <algorithm>
+
+#if defined(NGS_MIXING_X86)
+#include <immintrin.h>
+#include <util/instrset_detect.h>
+#elif defined(NGS_MIXING_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ngs {
+
+void mix_stereo_basic(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count) {
+    for (std::size_t k = 0; k < frame_count; k++) {
+        dest[k * 2] = std::clamp(dest[k * 2] + src[k * 2] * volume_matrix[0][0] + src[k * 2 + 1] * volume_matrix[1][0], -1.0f, 1.0f);
+        dest[k * 2 + 1] = std::clamp(dest[k * 2 + 1] + src[k * 2] * volume_matrix[0][1] + src[k * 2 + 1] * volume_matrix[1][1], -1.0f, 1.0f);
+    }
+}
+
+void mix_mono_to_stereo_basic(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count) {
+    for (std::size_t k = 0; k < frame_count; k++) {
+        const float sample = src[k] * gains[k];
+        dest[k * 2] += sample * left;
+        dest[k * 2 + 1] += sample * right;
+    }
+}
+
+void resample_linear_basic(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        const std::uint32_t index = position >> RESAMPLE_FRACTION_BITS;
+        const float fraction = static_cast<float>(position & RESAMPLE_FRACTION_MASK) * (1.0f / (1 << RESAMPLE_FRACTION_BITS));
+        dest[i] = src[index] + (src[index + 1] - src[index]) * fraction;
+        position += step;
+    }
+}
+
+void scale_samples_basic(float *samples, float gain, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++)
+        samples[i] *= gain;
+}
+
+void float_to_s16_basic(std::int16_t *dest, const float *src, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++)
+        dest[i] = static_cast<std::int16_t>(std::clamp(src[i] * 32768.0f, -32768.0f, 32767.0f));
+}
+
+#if defined(NGS_MIXING_X86)
+// SSE2 is always there on x86-64
+static void mix_stereo_sse2(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count) {
+    // a vector holds two frames, both output channels get the left and the right input multiplied by their gain
+    const __m128 left_gains = _mm_setr_ps(volume_matrix[0][0], volume_matrix[0][1], volume_matrix[0][0], volume_matrix[0][1]);
+    const __m128 right_gains = _mm_setr_ps(volume_matrix[1][0], volume_matrix[1][1], volume_matrix[1][0], volume_matrix[1][1]);
+    const __m128 min = _mm_set1_ps(-1.0f);
+    const __m128 max = _mm_set1_ps(1.0f);
+
+    std::size_t k = 0;
+    for (; k + 2 <= frame_count; k += 2) {
+        const __m128 samples = _mm_loadu_ps(src + k * 2);
+        const __m128 left = _mm_shuffle_ps(samples, samples, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 right = _mm_shuffle_ps(samples, samples, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 mixed = _mm_add_ps(_mm_loadu_ps(dest + k * 2), _mm_mul_ps(left, left_gains));
+        mixed = _mm_add_ps(mixed, _mm_mul_ps(right, right_gains));
+        _mm_storeu_ps(dest + k * 2, _mm_min_ps(_mm_max_ps(mixed, min), max));
+    }
+
+    mix_stereo_basic(dest + k * 2, src + k * 2, volume_matrix, frame_count - k);
+}
+
+static void mix_mono_to_stereo_sse2(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count) {
+    const __m128 channel_gains = _mm_setr_ps(left, right, left, right);
+
+    std::size_t k = 0;
+    for (; k + 4 <= frame_count; k += 4) {
+        const __m128 samples = _mm_mul_ps(_mm_loadu_ps(src + k), _mm_loadu_ps(gains + k));
+        // each sample goes to both channels of its frame
+        const __m128 first = _mm_unpacklo_ps(samples, samples);
+        const __m128 second = _mm_unpackhi_ps(samples, samples);
+        _mm_storeu_ps(dest + k * 2, _mm_add_ps(_mm_loadu_ps(dest + k * 2), _mm_mul_ps(first, channel_gains)));
+        _mm_storeu_ps(dest + k * 2 + 4, _mm_add_ps(_mm_loadu_ps(dest + k * 2 + 4), _mm_mul_ps(second, channel_gains)));
+    }
+
+    mix_mono_to_stereo_basic(dest + k * 2, src + k, gains + k, left, right, frame_count - k);
+}
+
+// also used on the AVX hosts, the positions are integers and AVX has no 256-bit integer operations nor gathers
+static void resample_linear_sse2(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count) {
+    const __m128i steps = _mm_set1_epi32(static_cast<int>(step * 4));
+    const __m128i mask = _mm_set1_epi32(RESAMPLE_FRACTION_MASK);
+    const __m128 scale = _mm_set1_ps(1.0f / (1 << RESAMPLE_FRACTION_BITS));
+    __m128i positions = _mm_setr_epi32(static_cast<int>(position), static_cast<int>(position + step), static_cast<int>(position + step * 2), static_cast<int>(position + step * 3));
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // the samples around each position are loaded one by one
+        alignas(16) std::uint32_t indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(indices), _mm_srli_epi32(positions, RESAMPLE_FRACTION_BITS));
+        const __m128 first = _mm_setr_ps(src[indices[0]], src[indices[1]], src[indices[2]], src[indices[3]]);
+        const __m128 second = _mm_setr_ps(src[indices[0] + 1], src[indices[1] + 1], src[indices[2] + 1], src[indices[3] + 1]);
+        const __m128 fractions = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(positions, mask)), scale);
+        _mm_storeu_ps(dest + i, _mm_add_ps(first, _mm_mul_ps(_mm_sub_ps(second, first), fractions)));
+        positions = _mm_add_epi32(positions, steps);
+    }
+
+    resample_linear_basic(dest + i, src, position + static_cast<std::uint32_t>(i) * step, step, count - i);
+}
+
+static void scale_samples_sse2(float *samples, float gain, std::size_t count) {
+    const __m128 gains = _mm_set1_ps(gain);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), gains));
+
+    scale_samples_basic(samples + i, gain, count - i);
+}
+
+static void float_to_s16_sse2(std::int16_t *dest, const float *src, std::size_t count) {
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    const __m128 max = _mm_set1_ps(32767.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // truncate like the cast of the basic conversion
+        const __m128i low = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), min), max));
+        const __m128i high = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), min), max));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packs_epi32(low, high));
+    }
+
+    float_to_s16_basic(dest + i, src + i, count - i);
+}
+
+NGS_MIXING_TARGET("avx")
+static void mix_stereo_avx(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count) {
+    const __m256 left_gains = _mm256_setr_ps(volume_matrix[0][0], volume_matrix[0][1], volume_matrix[0][0], volume_matrix[0][1],
+        volume_matrix[0][0], volume_matrix[0][1], volume_matrix[0][0], volume_matrix[0][1]);
+    const __m256 right_gains = _mm256_setr_ps(volume_matrix[1][0], volume_matrix[1][1], volume_matrix[1][0], volume_matrix[1][1],
+        volume_matrix[1][0], volume_matrix[1][1], volume_matrix[1][0], volume_matrix[1][1]);
+    const __m256 min = _mm256_set1_ps(-1.0f);
+    const __m256 max = _mm256_set1_ps(1.0f);
+
+    std::size_t k = 0;
+    for (; k + 4 <= frame_count; k += 4) {
+        // the shuffles stay in each 128-bit lane, which holds two frames
+        const __m256 samples = _mm256_loadu_ps(src + k * 2);
+        const __m256 left = _mm256_shuffle_ps(samples, samples, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m256 right = _mm256_shuffle_ps(samples, samples, _MM_SHUFFLE(3, 3, 1, 1));
+        __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(dest + k * 2), _mm256_mul_ps(left, left_gains));
+        mixed = _mm256_add_ps(mixed, _mm256_mul_ps(right, right_gains));
+        _mm256_storeu_ps(dest + k * 2, _mm256_min_ps(_mm256_max_ps(mixed, min), max));
+    }
+
+    mix_stereo_sse2(dest + k * 2, src + k * 2, volume_matrix, frame_count - k);
+}
+
+NGS_MIXING_TARGET("avx")
+static void mix_mono_to_stereo_avx(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count) {
+    const __m256 channel_gains = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+
+    std::size_t k = 0;
+    for (; k + 8 <= frame_count; k += 8) {
+        const __m256 samples = _mm256_mul_ps(_mm256_loadu_ps(src + k), _mm256_loadu_ps(gains + k));
+        // the unpacks stay in each 128-bit lane, the permutes put the frames back in order
+        const __m256 low = _mm256_unpacklo_ps(samples, samples);
+        const __m256 high = _mm256_unpackhi_ps(samples, samples);
+        const __m256 first = _mm256_permute2f128_ps(low, high, 0x20);
+        const __m256 second = _mm256_permute2f128_ps(low, high, 0x31);
+        _mm256_storeu_ps(dest + k * 2, _mm256_add_ps(_mm256_loadu_ps(dest + k * 2), _mm256_mul_ps(first, channel_gains)));
+        _mm256_storeu_ps(dest + k * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(dest + k * 2 + 8), _mm256_mul_ps(second, channel_gains)));
+    }
+
+    mix_mono_to_stereo_sse2(dest + k * 2, src + k, gains + k, left, right, frame_count - k);
+}
+
+NGS_MIXING_TARGET("avx")
+static void scale_samples_avx(float *samples, float gain, std::size_t count) {
+    const __m256 gains = _mm256_set1_ps(gain);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), gains));
+
+    scale_samples_sse2(samples + i, gain, count - i);
+}
+
+NGS_MIXING_TARGET("avx")
+static void float_to_s16_avx(std::int16_t *dest, const float *src, std::size_t count) {
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    const __m256 max = _mm256_set1_ps(32767.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i values = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), min), max));
+        // the integer pack needs AVX2 on 256 bits, do it on the two halves
+        const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extractf128_si256(values, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), packed);
+    }
+
+    float_to_s16_basic(dest + i, src + i, count - i);
+}
+#elif defined(NGS_MIXING_NEON)
+static void mix_stereo_neon(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count) {
+    const float32x4_t min = vdupq_n_f32(-1.0f);
+    const float32x4_t max = vdupq_n_f32(1.0f);
+
+    std::size_t k = 0;
+    for (; k + 4 <= frame_count; k += 4) {
+        // the loads split the frames into the left and the right channels
+        const float32x4x2_t samples = vld2q_f32(src + k * 2);
+        float32x4x2_t mixed = vld2q_f32(dest + k * 2);
+        mixed.val[0] = vaddq_f32(vaddq_f32(mixed.val[0], vmulq_n_f32(samples.val[0], volume_matrix[0][0])), vmulq_n_f32(samples.val[1], volume_matrix[1][0]));
+        mixed.val[1] = vaddq_f32(vaddq_f32(mixed.val[1], vmulq_n_f32(samples.val[0], volume_matrix[0][1])), vmulq_n_f32(samples.val[1], volume_matrix[1][1]));
+        mixed.val[0] = vminq_f32(vmaxq_f32(mixed.val[0], min), max);
+        mixed.val[1] = vminq_f32(vmaxq_f32(mixed.val[1], min), max);
+        vst2q_f32(dest + k * 2, mixed);
+    }
+
+    mix_stereo_basic(dest + k * 2, src + k * 2, volume_matrix, frame_count - k);
+}
+
+static void mix_mono_to_stereo_neon(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count) {
+    std::size_t k = 0;
+    for (; k + 4 <= frame_count; k += 4) {
+        const float32x4_t samples = vmulq_f32(vld1q_f32(src + k), vld1q_f32(gains + k));
+        float32x4x2_t mixed = vld2q_f32(dest + k * 2);
+        mixed.val[0] = vaddq_f32(mixed.val[0], vmulq_n_f32(samples, left));
+        mixed.val[1] = vaddq_f32(mixed.val[1], vmulq_n_f32(samples, right));
+        vst2q_f32(dest + k * 2, mixed);
+    }
+
+    mix_mono_to_stereo_basic(dest + k * 2, src + k, gains + k, left, right, frame_count - k);
+}
+
+static void resample_linear_neon(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count) {
+    const uint32x4_t steps = vdupq_n_u32(step * 4);
+    const uint32x4_t mask = vdupq_n_u32(RESAMPLE_FRACTION_MASK);
+    const std::uint32_t initial_positions[4] = { position, position + step, position + step * 2, position + step * 3 };
+    uint32x4_t positions = vld1q_u32(initial_positions);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // the samples around each position are loaded one by one
+        std::uint32_t indices[4];
+        vst1q_u32(indices, vshrq_n_u32(positions, RESAMPLE_FRACTION_BITS));
+        const float first_samples[4] = { src[indices[0]], src[indices[1]], src[indices[2]], src[indices[3]] };
+        const float second_samples[4] = { src[indices[0] + 1], src[indices[1] + 1], src[indices[2] + 1], src[indices[3] + 1] };
+        const float32x4_t first = vld1q_f32(first_samples);
+        const float32x4_t second = vld1q_f32(second_samples);
+        const float32x4_t fractions = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(positions, mask)), 1.0f / (1 << RESAMPLE_FRACTION_BITS));
+        vst1q_f32(dest + i, vaddq_f32(first, vmulq_f32(vsubq_f32(second, first), fractions)));
+        positions = vaddq_u32(positions, steps);
+    }
+
+    resample_linear_basic(dest + i, src, position + static_cast<std::uint32_t>(i) * step, step, count - i);
+}
+
+static void scale_samples_neon(float *samples, float gain, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+
+    scale_samples_basic(samples + i, gain, count - i);
+}
+
+static void float_to_s16_neon(std::int16_t *dest, const float *src, std::size_t count) {
+    const float32x4_t min = vdupq_n_f32(-32768.0f);
+    const float32x4_t max = vdupq_n_f32(32767.0f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // the conversion rounds towards zero like the cast of the basic conversion
+        const int32x4_t low = vcvtq_s32_f32(vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f), min), max));
+        const int32x4_t high = vcvtq_s32_f32(vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f), min), max));
+        vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+
+    float_to_s16_basic(dest + i, src + i, count - i);
+}
+#endif
+
+void mix_stereo(float *dest, const float *src, const float volume_matrix[2][2], std::size_t frame_count) {
+    using MixFunc = void (*)(float *, const float *, const float[2][2], std::size_t);
+    static const MixFunc mix = []() -> MixFunc {
+#if defined(NGS_MIXING_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX)
+            return mix_stereo_avx;
+        return mix_stereo_sse2;
+#elif defined(NGS_MIXING_NEON)
+        return mix_stereo_neon;
+#else
+        return mix_stereo_basic;
+#endif
+    }();
+
+    mix(dest, src, volume_matrix, frame_count);
+}
+
+void mix_mono_to_stereo(float *dest, const float *src, const float *gains, float left, float right, std::size_t frame_count) {
+    using MixFunc = void (*)(float *, const float *, const float *, float, float, std::size_t);
+    static const MixFunc mix = []() -> MixFunc {
+#if defined(NGS_MIXING_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX)
+            return mix_mono_to_stereo_avx;
+        return mix_mono_to_stereo_sse2;
+#elif defined(NGS_MIXING_NEON)
+        return mix_mono_to_stereo_neon;
+#else
+        return mix_mono_to_stereo_basic;
+#endif
+    }();
+
+    mix(dest, src, gains, left, right, frame_count);
+}
+
+void resample_linear(float *dest, const float *src, std::uint32_t position, std::uint32_t step, std::size_t count) {
+    // without pitch change nor fraction, the interpolation gives the samples themselves
+    if ((step == (1 << RESAMPLE_FRACTION_BITS)) && ((position & RESAMPLE_FRACTION_MASK) == 0)) {
+        std::copy_n(src + (position >> RESAMPLE_FRACTION_BITS), count, dest);
+        return;
+    }
+
+#if defined(NGS_MIXING_X86)
+    resample_linear_sse2(dest, src, position, step, count);
+#elif defined(NGS_MIXING_NEON)
+    resample_linear_neon(dest, src, position, step, count);
+#else
+    resample_linear_basic(dest, src, position, step, count);
+#endif
+}
+
+void scale_samples(float *samples, float gain, std::size_t count) {
+    using ScaleFunc = void (*)(float *, float, std::size_t);
+    static const ScaleFunc scale = []() -> ScaleFunc {
+#if defined(NGS_MIXING_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX)
+            return scale_samples_avx;
+        return scale_samples_sse2;
+#elif defined(NGS_MIXING_NEON)
+        return scale_samples_neon;
+#else
+        return scale_samples_basic;
+#endif
+    }();
+
+    scale(samples, gain, count);
+}
+
+void float_to_s16(std::int16_t *dest, const float *src, std::size_t count) {
+    using ConvertFunc = void (*)(std::int16_t *, const float *, std::size_t);
+    static const ConvertFunc convert = []() -> ConvertFunc {
+#if defined(NGS_MIXING_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX)
+            return float_to_s16_avx;
+        return float_to_s16_sse2;
+#elif defined(NGS_MIXING_NEON)
+        return float_to_s16_neon;
+#else
+        return float_to_s16_basic;
+#endif
+    }();
+
+    convert(dest, src, count);
+}
+
+const char *get_mixing_isa() {
+#if defined(NGS_MIXING_X86)
+    if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX)
+        return "AVX";
+    return "SSE2";
+#elif defined(NGS_MIXING_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace ngs
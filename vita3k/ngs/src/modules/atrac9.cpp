@@ -23,15 +23,83 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <xxh3.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 namespace ngs::atrac9 {
 
-SwrContext *Module::swr_mono_to_stereo = nullptr;
-SwrContext *Module::swr_stereo = nullptr;
+// superframes decoded as stereo float samples, shared by the voices of all the racks and evicted in lru order
+class DecodedCache {
+    std::mutex mutex;
+    std::size_t budget = 0;
+    std::size_t used = 0;
+    // the most recently used superframe is first
+    std::list<std::pair<std::uint64_t, std::vector<uint8_t>>> entries;
+    std::unordered_map<std::uint64_t, decltype(entries)::iterator> lookup;
+
+public:
+    // only set before the voices are processed
+    void set_budget(const std::size_t size_in_bytes) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        budget = size_in_bytes;
+        entries.clear();
+        lookup.clear();
+        used = 0;
+    }
+
+    bool is_enabled() const {
+        return budget != 0;
+    }
+
+    bool find(const std::uint64_t key, std::vector<uint8_t> &samples) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const auto it = lookup.find(key);
+        if (it == lookup.end())
+            return false;
+
+        entries.splice(entries.begin(), entries, it->second);
+        samples = it->second->second;
+        return true;
+    }
+
+    void insert(const std::uint64_t key, const std::vector<uint8_t> &samples) {
+        if (samples.size() > budget)
+            return;
+
+        const std::lock_guard<std::mutex> guard(mutex);
+        if (lookup.contains(key))
+            return;
+
+        while (used + samples.size() > budget) {
+            used -= entries.back().second.size();
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+
+        entries.emplace_front(key, samples);
+        lookup.emplace(key, entries.begin());
+        used += samples.size();
+    }
+};
+
+static DecodedCache decoded_cache;
+
+void set_decoded_cache_size(const std::size_t size_in_bytes) {
+    decoded_cache.set_budget(size_in_bytes);
+}
 
 Module::Module()
     : ngs::Module(ngs::BussType::BUSS_ATRAC9)
     , last_config(0) {}
 
+Module::~Module() {
+    swr_free(&swr_mono_to_stereo);
+    swr_free(&swr_stereo);
+}
+
 void get_buffer_parameter(const std::uint32_t start_sample, const std::uint32_t num_samples, const std::uint32_t info, SkipBufferInfo &parameter) {
     const std::uint8_t sample_rate_index = ((info & (0b1111 << 12)) >> 12);
     const std::uint8_t block_rate_index = ((info & (0b111 << 9)) >> 9);
@@ -87,6 +155,57 @@ void Module::on_param_change(const MemState &mem, ModuleData &data) {
     }
 }
 
+bool Module::decode_superframe(const uint8_t *input, uint8_t *output, uint32_t &bytes_used) {
+    const uint32_t samples_per_frame = decoder->get(DecoderQuery::AT9_SAMPLE_PER_FRAME);
+    uint32_t decoded_superframe_pos = 0;
+    for (uint32_t frame = 0; frame < decoder->get(DecoderQuery::AT9_FRAMES_IN_SUPERFRAME); frame++) {
+        if (!decoder->send(input, 0))
+            return false;
+
+        // convert from int16 to float
+        uint32_t const channel_count = decoder->get(DecoderQuery::CHANNELS);
+        frame_samples.resize(samples_per_frame * sizeof(int16_t) * channel_count);
+        DecoderSize decoder_size;
+        decoder->receive(frame_samples.data(), &decoder_size);
+
+        input += decoder->get_es_size();
+        bytes_used += decoder->get_es_size();
+        if (!output)
+            continue;
+
+        SwrContext *swr;
+        if (channel_count == 1) {
+            if (!swr_mono_to_stereo) {
+                swr_mono_to_stereo = swr_alloc_set_opts(nullptr,
+                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 480000,
+                    AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_S16, 480000,
+                    0, nullptr);
+                swr_init(swr_mono_to_stereo);
+            }
+
+            swr = swr_mono_to_stereo;
+        } else {
+            if (!swr_stereo) {
+                swr_stereo = swr_alloc_set_opts(nullptr,
+                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 480000,
+                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, 480000,
+                    0, nullptr);
+                swr_init(swr_stereo);
+            }
+
+            swr = swr_stereo;
+        }
+
+        const uint8_t *swr_data_in = frame_samples.data();
+        uint8_t *swr_data_out = output + decoded_superframe_pos;
+        swr_convert(swr, &swr_data_out, decoder_size.samples, &swr_data_in, decoder_size.samples);
+
+        decoded_superframe_pos += decoder_size.samples * sizeof(float) * 2;
+    }
+
+    return true;
+}
+
 bool Module::decode_more_data(KernelState &kern, const MemState &mem, const SceUID thread_id, ModuleData &data, const Parameters *params, State *state, std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) {
     int current_buffer = state->current_buffer;
     const BufferParameters &bufparam = params->buffer_params[current_buffer];
@@ -172,7 +291,6 @@ bool Module::decode_more_data(KernelState &kern, const MemState &mem, const SceU
 
     std::size_t curr_pos = state->decoded_samples_pending * sizeof(float) * 2;
 
-    const uint32_t samples_per_frame = decoder->get(DecoderQuery::AT9_SAMPLE_PER_FRAME);
     const uint32_t samples_per_superframe = decoder->get(DecoderQuery::AT9_SAMPLE_PER_SUPERFRAME);
     // we need to account for sampled skipped at the beginning or the end of the buffer
     uint32_t decoded_size = samples_per_superframe;
@@ -217,52 +335,37 @@ bool Module::decode_more_data(KernelState &kern, const MemState &mem, const SceU
         }
     }
 
-    std::vector<uint8_t> decoded_superframe_samples(decoder->get(DecoderQuery::AT9_SAMPLE_PER_SUPERFRAME) * sizeof(float) * 2);
-    uint32_t decoded_superframe_pos = 0;
+    Profile *profile = data.parent->rack->system->profile;
+    superframe_samples.assign(samples_per_superframe * sizeof(float) * 2, 0);
     bool got_decode_error = false;
-    // decode a whole superframe at a time
-    for (uint32_t frame = 0; frame < decoder->get(DecoderQuery::AT9_FRAMES_IN_SUPERFRAME); frame++) {
-        if (!decoder->send(input, 0)) {
-            got_decode_error = true;
-            break;
-        }
-
-        // convert from int16 to float
-        uint32_t const channel_count = decoder->get(DecoderQuery::CHANNELS);
-        std::vector<uint8_t> temporary_bytes(samples_per_frame * sizeof(int16_t) * channel_count);
-        DecoderSize decoder_size;
-        decoder->receive(temporary_bytes.data(), &decoder_size);
-
-        SwrContext *swr;
-        if (channel_count == 1) {
-            if (!swr_mono_to_stereo) {
-                swr_mono_to_stereo = swr_alloc_set_opts(nullptr,
-                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 480000,
-                    AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_S16, 480000,
-                    0, nullptr);
-                swr_init(swr_mono_to_stereo);
-            }
-
-            swr = swr_mono_to_stereo;
+    if (decoded_cache.is_enabled()) {
+        const ProfileScope profile_scope(profile, PROFILE_DECODE);
+        // looped music decodes the same superframes after the same ones each time
+        const std::uint64_t superframe_hash = XXH_INLINE_XXH3_64bits_withSeed(input, superframe_size, last_superframe_hash ^ last_config);
+        if (decoded_cache.find(superframe_hash, superframe_samples)) {
+            is_decoder_behind = true;
+            state->current_byte_position_in_buffer += superframe_size;
         } else {
-            if (!swr_stereo) {
-                swr_stereo = swr_alloc_set_opts(nullptr,
-                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 480000,
-                    AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, 480000,
-                    0, nullptr);
-                swr_init(swr_stereo);
+            if (is_decoder_behind) {
+                // bring the decoder up to date through the superframe before this one, its samples are already known
+                uint32_t bytes_used = 0;
+                decode_superframe(last_superframe.data(), nullptr, bytes_used);
             }
-
-            swr = swr_stereo;
+            uint32_t bytes_used = 0;
+            got_decode_error = !decode_superframe(input, superframe_samples.data(), bytes_used);
+            state->current_byte_position_in_buffer += bytes_used;
+            if (!got_decode_error)
+                decoded_cache.insert(superframe_hash, superframe_samples);
+            is_decoder_behind = false;
         }
 
-        const uint8_t *swr_data_in = reinterpret_cast<uint8_t *>(temporary_bytes.data());
-        uint8_t *swr_data_out = reinterpret_cast<uint8_t *>(decoded_superframe_samples.data() + decoded_superframe_pos);
-        const int result = swr_convert(swr, &swr_data_out, decoder_size.samples, &swr_data_in, decoder_size.samples);
-
-        decoded_superframe_pos += decoder_size.samples * sizeof(float) * 2;
-        input += decoder->get_es_size();
-        state->current_byte_position_in_buffer += decoder->get_es_size();
+        last_superframe_hash = superframe_hash;
+        last_superframe.assign(input, input + superframe_size);
+    } else {
+        const ProfileScope profile_scope(profile, PROFILE_DECODE);
+        uint32_t bytes_used = 0;
+        got_decode_error = !decode_superframe(input, superframe_samples.data(), bytes_used);
+        state->current_byte_position_in_buffer += bytes_used;
     }
 
     const int32_t sample_rate = data.parent->rack->system->sample_rate;
@@ -270,6 +373,7 @@ bool Module::decode_more_data(KernelState &kern, const MemState &mem, const SceU
         static bool LOG_PLAYBACK_SCALING = true;
         LOG_INFO_IF(LOG_PLAYBACK_SCALING, "The currently running game requests playback rate scaling when decoding audio. Audio might crackle.");
         LOG_PLAYBACK_SCALING = false;
+        const ProfileScope profile_scope(profile, PROFILE_RESAMPLE);
 
         // resample the audio
         int src_sample_rate = static_cast<int>(params->playback_frequency);
@@ -286,24 +390,23 @@ bool Module::decode_more_data(KernelState &kern, const MemState &mem, const SceU
         }
         // assume the skipped samples happen before the scaling
         int scaled_samples_amount = swr_get_out_samples(state->swr, decoded_size);
-        std::vector<std::uint8_t> scaled_data(scaled_samples_amount * sizeof(float) * 2, 0);
 
-        uint8_t *scaled_dest_data = scaled_data.data();
-        const uint8_t *scaled_src_data = decoded_superframe_samples.data() + decoded_start_offset * sizeof(float) * 2;
+        // Make room for the result of the scaling process in the queue for the final audio buffer and resample into it
+        data.extra_storage.resize(curr_pos + scaled_samples_amount * sizeof(float) * 2);
+
+        uint8_t *scaled_dest_data = data.extra_storage.data() + curr_pos;
+        const uint8_t *scaled_src_data = superframe_samples.data() + decoded_start_offset * sizeof(float) * 2;
         scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, decoded_size);
         assert(scaled_samples_amount > 0);
 
-        // Allocate memory to accommodate the result of the scaling process into the queue for the final audio buffer
+        // Only keep the samples the resampler produced
         data.extra_storage.resize(curr_pos + scaled_samples_amount * sizeof(float) * 2);
-
-        // Pass scaled audio data into the queue for the final audio buffer
-        memcpy(data.extra_storage.data() + curr_pos, scaled_data.data(), scaled_samples_amount * sizeof(float) * 2);
         decoded_size = scaled_samples_amount;
 
     } else {
         data.extra_storage.resize(curr_pos + decoded_size * sizeof(float) * 2);
 
-        memcpy(data.extra_storage.data() + curr_pos, decoded_superframe_samples.data() + decoded_start_offset * sizeof(float) * 2, decoded_size * sizeof(float) * 2);
+        memcpy(data.extra_storage.data() + curr_pos, superframe_samples.data() + decoded_start_offset * sizeof(float) * 2, decoded_size * sizeof(float) * 2);
     }
 
     if (got_decode_error) {
@@ -344,10 +447,16 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
     if (!decoder || (params->config_data != last_config)) {
         decoder = std::make_unique<Atrac9DecoderState>(params->config_data);
         last_config = params->config_data;
+        last_superframe_hash = 0;
+        is_decoder_behind = false;
     }
 
+    // room for the pending samples and a new (maybe resampled) superframe, so the storage doesn't grow on each update
+    const std::int32_t granularity = data.parent->rack->system->granularity;
+    data.extra_storage.reserve((2 * granularity + decoder->get(DecoderQuery::AT9_SAMPLE_PER_SUPERFRAME)) * sizeof(float) * 2);
+
     // call decode more data until we either have an error or reached end of data
-    while (static_cast<std::int32_t>(state->decoded_samples_pending) < data.parent->rack->system->granularity) {
+    while (static_cast<std::int32_t>(state->decoded_samples_pending) < granularity) {
         if (!decode_more_data(kern, mem, thread_id, data, params, state, scheduler_lock, voice_lock)) {
             state->is_finished = true;
             break;
@@ -358,7 +467,7 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
     data.fill_to_fit_granularity();
 
     std::uint8_t *data_ptr = data.extra_storage.data() + 2 * sizeof(float) * state->decoded_passed;
-    std::uint32_t samples_to_be_passed = data.parent->rack->system->granularity;
+    std::uint32_t samples_to_be_passed = granularity;
 
     data.parent->products[0].data = data_ptr;
 
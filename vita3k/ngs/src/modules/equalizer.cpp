@@ -15,6 +15,7 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <ngs/mixing.h>
 #include <ngs/modules/equalizer.h>
 #include <util/log.h>
 
@@ -31,11 +32,8 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
         // TODO: Proper implement it, for now just lower volume lol
         float *product_before = reinterpret_cast<float *>(data.parent->products[0].data);
 
-        if (product_before) {
-            for (std::int32_t i = 0; i < data.parent->rack->system->granularity * 2; i++) {
-                product_before[i] *= 0.5f;
-            }
-        }
+        if (product_before)
+            scale_samples(product_before, 0.5f, data.parent->rack->system->granularity * 2);
     }
 
     // It should do some modifications to create 4 outputs, but I'm not sure what yet kkk
@@ -82,6 +82,9 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
         decoder = std::make_unique<PCMDecoderState>(sample_rate);
     }
 
+    // room for the pending samples and the ones decoded next (the resampling can add a few), so the storage doesn't grow on each update
+    data.extra_storage.reserve(4 * granularity * sizeof(float) * 2);
+
     // If the amount of samples already processed and pending to be passed is smaller than the amount of samples of the audio buffer
     if (static_cast<std::int32_t>(state->decoded_samples_pending) < granularity) {
         // Memory cleaning check
@@ -207,7 +210,10 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
                 bytes_to_send = std::min<uint32_t>(bytes_to_send, params->buffer_params[state->current_buffer].bytes_count - state->current_byte_position_in_buffer);
 
                 // Send buffered audio data to decoder
-                decoder->send(input + state->current_byte_position_in_buffer, bytes_to_send);
+                {
+                    const ProfileScope profile_scope(data.parent->rack->system->profile, PROFILE_DECODE);
+                    decoder->send(input + state->current_byte_position_in_buffer, bytes_to_send);
+                }
 
                 state->current_byte_position_in_buffer += bytes_to_send;
                 state->bytes_consumed_since_key_on += bytes_to_send;
@@ -225,13 +231,12 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
                     LOG_INFO_IF(LOG_PLAYBACK_SCALING, "The currently running game requests playback rate scaling when decoding audio. Audio might crackle.");
                     LOG_PLAYBACK_SCALING = false;
 
-                    // Received decoded samples from decoder
-                    std::vector<std::uint8_t> decoded_data(samples_count.samples * sizeof(float) * 2, 0);
-
                     // Receive the samples processed by the decoder
-                    decoder->receive(decoded_data.data(), nullptr);
+                    decoded_samples.resize(samples_count.samples * sizeof(float) * 2);
+                    decoder->receive(decoded_samples.data(), nullptr);
 
                     // resample the audio
+                    const ProfileScope profile_scope(data.parent->rack->system->profile, PROFILE_RESAMPLE);
                     int src_sample_rate = static_cast<int>(params->playback_frequency);
                     if (params->playback_scalar != 1.0)
                         src_sample_rate = static_cast<int>(src_sample_rate * params->playback_scalar);
@@ -249,21 +254,20 @@ bool Module::process(KernelState &kern, const MemState &mem, const SceUID thread
                         state->reset_swr = false;
                     }
                     int scaled_samples_amount = swr_get_out_samples(state->swr, samples_count.samples);
-                    std::vector<std::uint8_t> scaled_data(scaled_samples_amount * sizeof(float) * 2, 0);
-
-                    uint8_t *scaled_dest_data = scaled_data.data();
-                    const uint8_t *scaled_src_data = decoded_data.data();
-                    scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, samples_count.samples);
-                    assert(scaled_samples_amount > 0);
 
                     // Get current size of audio queue for processed samples in memory
                     const std::size_t current_count = state->decoded_samples_pending * sizeof(float) * 2;
 
-                    // Allocate memory to accommodate the result of the scaling process into the queue for the final audio buffer
+                    // Make room for the result of the scaling process in the queue for the final audio buffer and resample into it
                     data.extra_storage.resize(current_count + scaled_samples_amount * sizeof(float) * 2);
 
-                    // Pass scaled audio data into the queue for the final audio buffer
-                    memcpy(data.extra_storage.data() + current_count, scaled_data.data(), scaled_samples_amount * sizeof(float) * 2);
+                    uint8_t *scaled_dest_data = data.extra_storage.data() + current_count;
+                    const uint8_t *scaled_src_data = decoded_samples.data();
+                    scaled_samples_amount = swr_convert(state->swr, &scaled_dest_data, scaled_samples_amount, &scaled_src_data, samples_count.samples);
+                    assert(scaled_samples_amount > 0);
+
+                    // Only keep the samples the resampler produced
+                    data.extra_storage.resize(current_count + scaled_samples_amount * sizeof(float) * 2);
 
                 } else {
                     // Get current size of audio buffer for processed samples in memory
@@ -23,6 +23,7 @@
 #include <ngs/definitions/player.h>
 #include <ngs/definitions/scream.h>
 #include <ngs/definitions/simple.h>
+#include <ngs/mixing.h>
 #include <ngs/modules/atrac9.h>
 #include <ngs/modules/master.h>
 #include <ngs/modules/passthrough.h>
@@ -44,21 +45,27 @@ System::System(const Ptr<void> memspace, const std::uint32_t memspace_size)
     , granularity(0)
     , sample_rate(0) {}
 
-void VoiceInputManager::init(const std::uint32_t granularity, const std::uint16_t total_input) {
-    inputs.resize(total_input);
+std::uint32_t VoiceInputManager::get_buffer_size(const std::uint32_t granularity, const std::uint16_t total_input) {
+    // FLTP and maximum channel count
+    return granularity * 8 * total_input;
+}
 
-    for (auto &input : inputs) {
-        // FLTP and maximum channel count
-        input.resize(granularity * 8);
-    }
+void VoiceInputManager::init(std::uint8_t *buffer, const std::uint32_t granularity, const std::uint16_t total_input) {
+    const std::uint32_t input_size = get_buffer_size(granularity, 1);
+
+    inputs.resize(total_input);
+    for (std::uint16_t i = 0; i < total_input; i++)
+        inputs[i] = PCMInput(buffer + i * input_size, input_size);
 
     reset_inputs();
 }
 
 void VoiceInputManager::reset_inputs() {
-    for (auto &input : inputs) {
-        std::fill(input.begin(), input.end(), 0);
-    }
+    if (inputs.empty())
+        return;
+
+    // the buffers are contiguous, clear them at once
+    std::fill_n(inputs.front().data(), inputs.size() * inputs.front().size(), 0);
 }
 
 VoiceInputManager::PCMInput *VoiceInputManager::get_input_buffer_queue(const std::int32_t index) {
@@ -81,12 +88,7 @@ std::int32_t VoiceInputManager::receive(ngs::Patch *patch, const VoiceProduct &p
 
     // Try mixing, also with the use of this volume matrix
     // Dest is our voice to receive this data.
-    for (std::int32_t k = 0; k < patch->dest->rack->system->granularity; k++) {
-        dest_buffer[k * 2] = std::clamp(dest_buffer[k * 2] + data_to_mix_in[k * 2] * patch->volume_matrix[0][0]
-                + data_to_mix_in[k * 2 + 1] * patch->volume_matrix[1][0],
-            -1.0f, 1.0f);
-        dest_buffer[k * 2 + 1] = std::clamp(dest_buffer[k * 2 + 1] + data_to_mix_in[k * 2] * patch->volume_matrix[0][1] + data_to_mix_in[k * 2 + 1] * patch->volume_matrix[1][1], -1.0f, 1.0f);
-    }
+    mix_stereo(dest_buffer, data_to_mix_in, patch->volume_matrix, patch->dest->rack->system->granularity);
 
     return 0;
 }
@@ -145,7 +147,7 @@ void ModuleData::fill_to_fit_granularity() {
     }
 }
 
-void Voice::init(Rack *mama) {
+void Voice::init(Rack *mama, std::uint8_t *input_buffer) {
     rack = mama;
     state = VoiceState::VOICE_STATE_AVAILABLE;
     is_pending = false;
@@ -157,7 +159,7 @@ void Voice::init(Rack *mama) {
     for (std::uint32_t i = 0; i < MAX_OUTPUT_PORT; i++)
         patches[i].resize(mama->patches_per_output);
 
-    inputs.init(rack->system->granularity, 1);
+    inputs.init(input_buffer, rack->system->granularity, VoiceInputManager::VOICE_INPUT_COUNT);
     voice_mutex = std::make_unique<std::mutex>();
 }
 
@@ -328,7 +330,13 @@ void Voice::invoke_callback(KernelState &kernel, const MemState &mem, const SceU
         return;
     }
 
-    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    if (defer_callbacks) {
+        deferred_callbacks.push_back({ callback, user_data, module_id, reason1, reason2, reason_ptr });
+        return;
+    }
+
+    const ProfileScope profile_scope(rack->system->profile, PROFILE_CALLBACK);
+    const ThreadStatePtr thread = kernel.get_thread(thread_id);
     const Address callback_info_addr = stack_alloc(*thread->cpu, sizeof(CallbackInfo));
 
     CallbackInfo *info = Ptr<CallbackInfo>(callback_info_addr).get(mem);
@@ -383,6 +391,10 @@ bool init_system(State &ngs, const MemState &mem, SystemInitParameters *paramete
     sys->max_voices = parameters->max_voices;
     sys->granularity = parameters->granularity;
     sys->sample_rate = parameters->sample_rate;
+    sys->profile = &ngs.profile;
+    sys->voice_scheduler.profile = &ngs.profile;
+    if (sys->sample_rate > 0)
+        sys->voice_scheduler.update_budget_ns = static_cast<std::uint64_t>(sys->granularity) * 1'000'000'000 / sys->sample_rate;
 
     // Alloc first block for System struct
     if (!sys->alloc_raw(sizeof(System))) {
@@ -430,7 +442,11 @@ bool init_rack(State &ngs, const MemState &mem, System *system, BufferParamsInfo
     rack->voices.resize(description->voice_count);
     rack->vdef = description->definition.get(mem);
 
-    for (auto &voice : rack->voices) {
+    const std::uint32_t voice_input_size = VoiceInputManager::get_buffer_size(system->granularity, VoiceInputManager::VOICE_INPUT_COUNT);
+    rack->input_arena.assign(static_cast<std::size_t>(voice_input_size) * rack->voices.size(), 0);
+
+    for (std::size_t voice_index = 0; voice_index < rack->voices.size(); voice_index++) {
+        Ptr<Voice> &voice = rack->voices[voice_index];
         voice = rack->alloc<Voice>();
 
         if (!voice) {
@@ -439,7 +455,7 @@ bool init_rack(State &ngs, const MemState &mem, System *system, BufferParamsInfo
 
         Voice *v = voice.get(mem);
         new (v) Voice();
-        v->init(rack);
+        v->init(rack, rack->input_arena.data() + voice_index * voice_input_size);
 
         // Allocate parameter buffer info for each voice
         for (std::size_t i = 0; i < rack->modules.size(); i++) {
@@ -450,6 +466,8 @@ bool init_rack(State &ngs, const MemState &mem, System *system, BufferParamsInfo
             }
 
             v->datas[i].info.data = rack->alloc_raw(v->datas[i].info.size);
+            // the copy made when the parameters are locked then never allocates
+            v->datas[i].last_info.reserve(v->datas[i].info.size);
 
             v->datas[i].parent = v;
             v->datas[i].index = static_cast<std::uint32_t>(i);
@@ -0,0 +1,82 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <ngs/profile.h>
+
+#include <chrono>
+
+namespace ngs {
+
+std::uint64_t profile_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileSnapshot Profile::get_snapshot() {
+    const std::lock_guard<std::mutex> guard(snapshot_mutex);
+    const std::uint64_t now = profile_now_ns();
+    if (snapshot_time_ns == 0) {
+        snapshot_time_ns = now;
+        return snapshot;
+    }
+    if (now - snapshot_time_ns < 1'000'000'000)
+        return snapshot;
+
+    // scale the counters to one second
+    const float to_ms_per_second = 1000.f / static_cast<float>(now - snapshot_time_ns);
+    snapshot_time_ns = now;
+
+    for (std::size_t i = 0; i < PROFILE_STAGE_COUNT; i++)
+        snapshot.stage_ms[i] = stage_ns[i].exchange(0, std::memory_order_relaxed) * to_ms_per_second;
+    for (std::size_t i = 0; i < PROFILE_MODULE_TYPE_COUNT; i++)
+        snapshot.module_ms[i] = module_ns[i].exchange(0, std::memory_order_relaxed) * to_ms_per_second;
+
+    const std::uint64_t update = update_ns.exchange(0, std::memory_order_relaxed);
+    const std::uint64_t budget = budget_ns.exchange(0, std::memory_order_relaxed);
+    const std::uint64_t voices = voices_processed.exchange(0, std::memory_order_relaxed);
+    snapshot.update_ms = update * to_ms_per_second;
+    snapshot.budget_usage = budget ? static_cast<float>(update) / static_cast<float>(budget) : 0.f;
+    snapshot.voice_us = voices ? static_cast<float>(update) / static_cast<float>(voices) / 1000.f : 0.f;
+    snapshot.updates = updates.exchange(0, std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+const char *get_buss_type_name(const BussType type) {
+    switch (type) {
+    case BussType::BUSS_MASTER: return "Master";
+    case BussType::BUSS_COMPRESSOR: return "Compressor";
+    case BussType::BUSS_SIDE_CHAIN_COMPRESSOR: return "Side chain";
+    case BussType::BUSS_DELAY: return "Delay";
+    case BussType::BUSS_DISTORTION: return "Distortion";
+    case BussType::BUSS_ENVELOPE: return "Envelope";
+    case BussType::BUSS_EQUALIZATION: return "Equalizer";
+    case BussType::BUSS_MIXER: return "Mixer";
+    case BussType::BUSS_PAUSER: return "Pauser";
+    case BussType::BUSS_PITCH_SHIFT: return "Pitch shift";
+    case BussType::BUSS_REVERB: return "Reverb";
+    case BussType::BUSS_SAS_EMULATION: return "SAS";
+    case BussType::BUSS_SIMPLE: return "Simple";
+    case BussType::BUSS_ATRAC9: return "Atrac9";
+    case BussType::BUSS_SIMPLE_ATRAC9: return "Simple atrac9";
+    case BussType::BUSS_SCREAM: return "Scream";
+    case BussType::BUSS_SCREAM_ATRAC9: return "Scream atrac9";
+    case BussType::BUSS_NORMAL_PLAYER: return "Player";
+    default: return "Unknown";
+    }
+}
+
+} // namespace ngs
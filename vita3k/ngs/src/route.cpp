@@ -27,6 +27,8 @@ bool deliver_data(const MemState &mem, Voice *source, const std::uint8_t output_
         return false;
     }
 
+    const ProfileScope profile_scope(source->rack->system->profile, PROFILE_MIX);
+
     for (std::size_t i = 0; i < source->patches[output_port].size(); i++) {
         Patch *patch = source->patches[output_port][i].get(mem);
 
@@ -0,0 +1,335 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <ngs/mixing.h>
+#include <ngs/sas.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ngs::sas {
+
+// VAG blocks are a header of two bytes (predictor and shift, flags) followed by 28 samples of 4 bits
+static constexpr std::uint32_t ADPCM_BLOCK_SIZE = 16;
+static constexpr std::uint32_t ADPCM_BLOCK_SAMPLES = 28;
+
+enum AdpcmFlags : std::uint8_t {
+    ADPCM_FLAG_LOOP_END = 1 << 0,
+    ADPCM_FLAG_LOOP_REPEAT = 1 << 1,
+    ADPCM_FLAG_LOOP_START = 1 << 2,
+    // a block made of these flags ends the stream
+    ADPCM_FLAG_END = 7
+};
+
+static constexpr std::int32_t ADPCM_COEFS[5][2] = { { 0, 0 }, { 60, 0 }, { 115, -52 }, { 98, -55 }, { 122, -60 } };
+
+// the bent curves slow down in the last quarter
+static constexpr std::int32_t ENVELOPE_BENT_HEIGHT = 0x30000000;
+
+void Envelope::key_on() {
+    height = 0;
+    phase = ENVELOPE_ATTACK;
+}
+
+void Envelope::key_off() {
+    if (phase != ENVELOPE_OFF)
+        phase = ENVELOPE_RELEASE;
+}
+
+void Envelope::step() {
+    if (phase == ENVELOPE_OFF)
+        return;
+
+    const std::int64_t current = height;
+    const std::int64_t rate = rates[phase];
+    std::int64_t next = current;
+    switch (curves[phase]) {
+    case EnvelopeCurve::LinearIncrease:
+        next = current + rate;
+        break;
+    case EnvelopeCurve::LinearDecrease:
+        next = current - rate;
+        break;
+    case EnvelopeCurve::LinearBent:
+        next = current + ((current < ENVELOPE_BENT_HEIGHT) ? rate : rate / 4);
+        break;
+    case EnvelopeCurve::ExponentDecrease:
+        // the rate is the part of the height lost each sample in 1/2^31 units, it always moves by at least one
+        if (rate != 0)
+            next = current - std::max<std::int64_t>((current * rate) >> 31, 1);
+        break;
+    case EnvelopeCurve::ExponentIncrease:
+        if (rate != 0)
+            next = current + std::max<std::int64_t>(((ENVELOPE_HEIGHT_MAX - current) * rate) >> 31, 1);
+        break;
+    case EnvelopeCurve::Direct:
+        next = rate;
+        break;
+    }
+    height = static_cast<std::int32_t>(std::clamp<std::int64_t>(next, 0, ENVELOPE_HEIGHT_MAX));
+
+    switch (phase) {
+    case ENVELOPE_ATTACK:
+        if (height >= ENVELOPE_HEIGHT_MAX)
+            phase = ENVELOPE_DECAY;
+        break;
+    case ENVELOPE_DECAY:
+        if (height <= sustain_level) {
+            height = sustain_level;
+            phase = ENVELOPE_SUSTAIN;
+        }
+        break;
+    case ENVELOPE_RELEASE:
+        if (height <= 0)
+            phase = ENVELOPE_OFF;
+        break;
+    default:
+        break;
+    }
+}
+
+// rates of the SPU, 0x7F stops the envelope
+static std::int32_t get_simple_rate(std::uint32_t value) {
+    value &= 0x7F;
+    if (value == 0x7F)
+        return 0;
+    const std::int32_t rate = ((7 - static_cast<std::int32_t>(value & 3)) << 26) >> (value >> 2);
+    return std::max(rate, 1);
+}
+
+void set_simple_adsr(Envelope &envelope, std::uint16_t adsr1, std::uint16_t adsr2) {
+    envelope.curves[ENVELOPE_ATTACK] = (adsr1 & 0x8000) ? EnvelopeCurve::LinearBent : EnvelopeCurve::LinearIncrease;
+    envelope.rates[ENVELOPE_ATTACK] = get_simple_rate(adsr1 >> 8);
+    envelope.curves[ENVELOPE_DECAY] = EnvelopeCurve::ExponentDecrease;
+    envelope.rates[ENVELOPE_DECAY] = get_simple_rate(((adsr1 >> 4) & 0xF) << 2);
+    envelope.sustain_level = ((adsr1 & 0xF) + 1) << 26;
+
+    const bool sustain_exponent = adsr2 & 0x8000;
+    if (adsr2 & 0x4000)
+        envelope.curves[ENVELOPE_SUSTAIN] = sustain_exponent ? EnvelopeCurve::ExponentDecrease : EnvelopeCurve::LinearDecrease;
+    else
+        envelope.curves[ENVELOPE_SUSTAIN] = sustain_exponent ? EnvelopeCurve::LinearBent : EnvelopeCurve::LinearIncrease;
+    envelope.rates[ENVELOPE_SUSTAIN] = get_simple_rate(adsr2 >> 6);
+    envelope.curves[ENVELOPE_RELEASE] = (adsr2 & 0x20) ? EnvelopeCurve::ExponentDecrease : EnvelopeCurve::LinearDecrease;
+    envelope.rates[ENVELOPE_RELEASE] = get_simple_rate((adsr2 & 0x1F) << 2);
+}
+
+void Voice::key_on() {
+    read_offset = 0;
+    adpcm_loop_offset = 0;
+    adpcm_history[0] = 0;
+    adpcm_history[1] = 0;
+    noise_hold = 0;
+    source_ended = false;
+    samples.clear();
+    padding = 0;
+    position = 0;
+
+    playing = type != SourceType::None;
+    envelope.key_on();
+}
+
+void Voice::key_off() {
+    envelope.key_off();
+}
+
+static void decode_adpcm_block(Voice &voice) {
+    if (voice.read_offset + ADPCM_BLOCK_SIZE > voice.size) {
+        voice.source_ended = true;
+        return;
+    }
+
+    const std::uint8_t *block = voice.data + voice.read_offset;
+    const std::uint8_t shift = block[0] & 0xF;
+    const std::uint8_t predictor = std::min(block[0] >> 4, 4);
+    const std::uint8_t flags = block[1];
+    if (flags == ADPCM_FLAG_END) {
+        voice.source_ended = true;
+        return;
+    }
+    if (flags & ADPCM_FLAG_LOOP_START)
+        voice.adpcm_loop_offset = voice.read_offset;
+
+    std::int32_t hist1 = voice.adpcm_history[0];
+    std::int32_t hist2 = voice.adpcm_history[1];
+    for (std::uint32_t i = 0; i < ADPCM_BLOCK_SAMPLES; i++) {
+        // low nibble first, it is the top of a 16-bit sample scaled down by the shift
+        const std::uint8_t byte = block[2 + i / 2];
+        const std::int32_t nibble = (i & 1) ? (byte >> 4) : (byte & 0xF);
+        std::int32_t sample = static_cast<std::int16_t>(nibble << 12) >> shift;
+        sample += (hist1 * ADPCM_COEFS[predictor][0] + hist2 * ADPCM_COEFS[predictor][1]) >> 6;
+        sample = std::clamp(sample, -32768, 32767);
+
+        hist2 = hist1;
+        hist1 = sample;
+        voice.samples.push_back(static_cast<float>(sample) * (1.0f / 32768.0f));
+    }
+    voice.adpcm_history[0] = hist1;
+    voice.adpcm_history[1] = hist2;
+
+    voice.read_offset += ADPCM_BLOCK_SIZE;
+    if (flags & ADPCM_FLAG_LOOP_END) {
+        if (voice.loop)
+            voice.read_offset = voice.adpcm_loop_offset;
+        else
+            voice.source_ended = true;
+    }
+}
+
+static void decode_pcm(Voice &voice, std::size_t needed) {
+    const std::uint32_t sample_count = voice.size / sizeof(std::int16_t);
+    if (voice.read_offset >= sample_count) {
+        if (voice.loop && (voice.pcm_loop_start < sample_count))
+            voice.read_offset = voice.pcm_loop_start;
+        else
+            voice.source_ended = true;
+        return;
+    }
+
+    const std::uint32_t count = static_cast<std::uint32_t>(std::min<std::size_t>(needed - voice.samples.size(), sample_count - voice.read_offset));
+    for (std::uint32_t i = 0; i < count; i++) {
+        // the buffer of the guest may not be aligned
+        std::int16_t sample;
+        std::memcpy(&sample, voice.data + (voice.read_offset + i) * sizeof(std::int16_t), sizeof(sample));
+        voice.samples.push_back(static_cast<float>(sample) * (1.0f / 32768.0f));
+    }
+    voice.read_offset += count;
+}
+
+static void generate_noise(Voice &voice, std::size_t needed) {
+    // the clock sets how long a random value is held, from 128 samples to a new one each sample
+    const std::uint32_t hold = 1 << ((NOISE_CLOCK_MAX - voice.noise_clock) >> 3);
+    while (voice.samples.size() < needed) {
+        if (voice.noise_hold == 0) {
+            voice.noise_seed ^= voice.noise_seed << 13;
+            voice.noise_seed ^= voice.noise_seed >> 17;
+            voice.noise_seed ^= voice.noise_seed << 5;
+            voice.noise_sample = static_cast<float>(static_cast<std::int32_t>(voice.noise_seed)) * (1.0f / 2147483648.0f);
+            voice.noise_hold = hold;
+        }
+        voice.noise_hold--;
+        voice.samples.push_back(voice.noise_sample);
+    }
+}
+
+static void fill_samples(Voice &voice, std::size_t needed) {
+    while (voice.samples.size() < needed) {
+        if (voice.source_ended) {
+            voice.padding += static_cast<std::uint32_t>(needed - voice.samples.size());
+            voice.samples.resize(needed, 0.f);
+            return;
+        }
+
+        switch (voice.type) {
+        case SourceType::ADPCM:
+            decode_adpcm_block(voice);
+            break;
+        case SourceType::PCM:
+            decode_pcm(voice, needed);
+            break;
+        case SourceType::Noise:
+            generate_noise(voice, needed);
+            break;
+        case SourceType::None:
+            voice.source_ended = true;
+            break;
+        }
+    }
+}
+
+// write the resampled samples of the voice for the grain and the height of its envelope for each of them
+static void render_voice(Voice &voice, std::uint32_t grain, float *resampled, float *gains) {
+    for (std::uint32_t i = 0; i < grain; i++) {
+        voice.envelope.step();
+        gains[i] = static_cast<float>(voice.envelope.height) * (1.0f / ENVELOPE_HEIGHT_MAX);
+    }
+
+    const std::uint32_t step = static_cast<std::uint32_t>(voice.pitch);
+    const std::uint32_t end = voice.position + grain * step;
+    const std::uint32_t consumed = end >> RESAMPLE_FRACTION_BITS;
+    // the last position may need the sample after the ones consumed
+    fill_samples(voice, consumed + 2);
+    resample_linear(resampled, voice.samples.data(), voice.position, step, grain);
+    voice.position = end & RESAMPLE_FRACTION_MASK;
+
+    const std::size_t real_samples = voice.samples.size() - voice.padding;
+    voice.samples.erase(voice.samples.begin(), voice.samples.begin() + consumed);
+    if ((voice.source_ended && (consumed >= real_samples)) || (voice.envelope.phase == ENVELOPE_OFF)) {
+        voice.playing = false;
+        voice.envelope.phase = ENVELOPE_OFF;
+        voice.envelope.height = 0;
+    }
+}
+
+static std::int32_t get_peak(const float *samples, std::size_t count) {
+    float peak = 0.f;
+    for (std::size_t i = 0; i < count; i++)
+        peak = std::max(peak, std::abs(samples[i * 2]));
+    return static_cast<std::int32_t>(std::min(peak * 32768.0f, 32767.0f));
+}
+
+Core::Core(std::uint32_t voice_count, std::uint32_t grain)
+    : grain(grain)
+    , voices(voice_count) {
+}
+
+void Core::process(std::int16_t *out, const std::int16_t *mix_in, std::int32_t mix_left, std::int32_t mix_right) {
+    dry.assign(grain * 2, 0.f);
+    resampled.resize(grain);
+    gains.resize(grain);
+
+    // all the voices are mixed into the same block, one grain at a time
+    for (Voice &voice : voices) {
+        if (!voice.playing || voice.paused)
+            continue;
+
+        render_voice(voice, grain, resampled.data(), gains.data());
+        if (dry_enabled) {
+            const float left = static_cast<float>(voice.volumes[0]) / VOLUME_MAX;
+            const float right = static_cast<float>(voice.volumes[1]) / VOLUME_MAX;
+            mix_mono_to_stereo(dry.data(), resampled.data(), gains.data(), left, right, grain);
+        }
+    }
+
+    dry_peak[0] = get_peak(dry.data(), grain);
+    dry_peak[1] = get_peak(dry.data() + 1, grain);
+
+    if (mix_in) {
+        const float left = static_cast<float>(mix_left) / VOLUME_MAX * (1.0f / 32768.0f);
+        const float right = static_cast<float>(mix_right) / VOLUME_MAX * (1.0f / 32768.0f);
+        const bool stereo = output_mode == OutputMode::Stereo;
+        for (std::uint32_t k = 0; k < grain; k++) {
+            dry[k * 2] += static_cast<float>(mix_in[stereo ? k * 2 : k]) * left;
+            dry[k * 2 + 1] += static_cast<float>(mix_in[stereo ? k * 2 + 1 : k]) * right;
+        }
+    }
+
+    pre_master_peak[0] = get_peak(dry.data(), grain);
+    pre_master_peak[1] = get_peak(dry.data() + 1, grain);
+
+    if (output_mode == OutputMode::Stereo) {
+        float_to_s16(out, dry.data(), grain * 2);
+    } else {
+        for (std::uint32_t k = 0; k < grain; k++)
+            resampled[k] = (dry[k * 2] + dry[k * 2 + 1]) * 0.5f;
+        float_to_s16(out, resampled.data(), grain);
+    }
+}
+
+} // namespace ngs::sas
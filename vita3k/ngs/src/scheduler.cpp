@@ -22,8 +22,12 @@
 
 #include <algorithm>
 #include <cstring>
+#include <unordered_map>
 
 namespace ngs {
+// below this, dispatching the voices to the workers costs more than processing them
+static constexpr std::size_t PARALLEL_UPDATE_MIN_VOICES = 8;
+
 bool VoiceScheduler::deque_voice_impl(Voice *voice) {
     auto voice_in = std::find(queue.begin(), queue.end(), voice);
 
@@ -128,69 +132,201 @@ bool VoiceScheduler::off(Voice *voice) {
     return true;
 }
 
-void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID thread_id) {
-    std::unique_lock<std::recursive_mutex> scheduler_lock(mutex);
-    is_updating = true;
+bool VoiceScheduler::process_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, std::uint32_t &finished_module,
+    std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) {
+    // Modify the state, in peace....
+    std::memset(voice->products, 0, sizeof(voice->products));
 
-    // make a copy of the queue, this way we have no issue if it is modified in a callbck
-    std::vector<ngs::Voice *> queue_copy = queue;
+    bool finished = false;
 
-    // Do a first routine to clear inputs from previous update session
-    for (ngs::Voice *voice : queue_copy) {
-        voice->inputs.reset_inputs();
+    for (std::size_t i = 0; i < voice->rack->modules.size(); i++) {
+        if (voice->rack->modules[i]) {
+            const std::uint64_t start = profile ? profile_now_ns() : 0;
+            if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
+                finished = true;
+                finished_module = voice->rack->modules[i]->module_id();
+            }
+            if (profile)
+                profile->add_module(voice->rack->modules[i]->buss_type, profile_now_ns() - start);
+        }
     }
 
-    for (ngs::Voice *voice : queue_copy) {
-        // Modify the state, in peace....
-        std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
-        std::memset(voice->products, 0, sizeof(voice->products));
+    return finished;
+}
 
+void VoiceScheduler::complete_voice(KernelState &kern, const MemState &mem, const SceUID thread_id, Voice *voice, const bool finished, const std::uint32_t finished_module,
+    std::unique_lock<std::recursive_mutex> &scheduler_lock, std::unique_lock<std::mutex> &voice_lock) {
+    if (finished) {
+        voice->is_keyed_off = true;
+        voice->transition(VoiceState::VOICE_STATE_FINALIZING);
+        if (voice->finished_callback) {
+            voice_lock.unlock();
+            scheduler_lock.unlock();
+            voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, finished_module);
+            scheduler_lock.lock();
+            voice_lock.lock();
+        }
+        voice->is_keyed_off = false;
+
+        stop(voice);
+    }
+
+    for (std::size_t i = 0; i < voice->rack->vdef->output_count(); i++) {
+        if (voice->products[i].data)
+            deliver_data(mem, voice, static_cast<std::uint8_t>(i), voice->products[i]);
+    }
+
+    voice->frame_count++;
+}
+
+void VoiceScheduler::update_parallel(KernelState &kern, const MemState &mem, const SceUID thread_id, const std::vector<Voice *> &voices,
+    std::unique_lock<std::recursive_mutex> &scheduler_lock) {
+    if (!voice_pool) {
+        const uint32_t thread_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+        voice_pool = std::make_unique<JobPool>(thread_count);
+    }
+
+    std::unordered_map<Voice *, std::size_t> positions;
+    for (std::size_t i = 0; i < voices.size(); i++)
+        positions[voices[i]] = i;
+
+    // The queue already puts the sources before their destinations, so the level of a voice (the longest patch chain leading to it)
+    // is known once the voices before it are done. The voices of a same level don't feed each other and can be processed together.
+    std::vector<std::uint32_t> voice_levels(voices.size(), 0);
+    std::vector<std::vector<std::size_t>> levels;
+    for (std::size_t i = 0; i < voices.size(); i++) {
+        const std::uint32_t level = voice_levels[i];
+        if (level >= levels.size())
+            levels.resize(level + 1);
+        levels[level].push_back(i);
+
+        for (const auto &port_patches : voices[i]->patches) {
+            for (const auto &patch : port_patches) {
+                if (!patch || patch.get(mem)->output_sub_index == -1)
+                    continue;
+
+                const auto dest = positions.find(patch.get(mem)->dest);
+                // a destination placed before its source only gets the data on the next update, like in the serial update
+                if (dest == positions.end() || dest->second <= i)
+                    continue;
+
+                voice_levels[dest->second] = std::max(voice_levels[dest->second], level + 1);
+            }
+        }
+    }
+
+    struct VoiceResult {
         bool finished = false;
-        uint32_t finished_module = 0;
+        std::uint32_t finished_module = 0;
+    };
+    std::vector<VoiceResult> results(voices.size());
+
+    std::vector<std::vector<std::size_t>> rack_groups;
+    std::vector<JobPtr> jobs;
+    for (const std::vector<std::size_t> &level : levels) {
+        // the modules of a rack (and their decoders) are shared by its voices, so these voices are processed by the same job
+        rack_groups.clear();
+        for (const std::size_t index : level) {
+            const auto group = std::find_if(rack_groups.begin(), rack_groups.end(), [&](const std::vector<std::size_t> &group) {
+                return voices[group.front()]->rack == voices[index]->rack;
+            });
+            if (group == rack_groups.end())
+                rack_groups.push_back({ index });
+            else
+                group->push_back(index);
+        }
 
-        for (std::size_t i = 0; i < voice->rack->modules.size(); i++) {
-            if (voice->rack->modules[i]) {
-                if (voice->rack->modules[i]->process(kern, mem, thread_id, voice->datas[i], scheduler_lock, voice_lock)) {
-                    finished = true;
-                    finished_module = voice->rack->modules[i]->module_id();
+        for (const std::vector<std::size_t> &group : rack_groups) {
+            jobs.push_back(voice_pool->submit([&, this]() {
+                // the modules release the scheduler lock around their callbacks, give them one of their own
+                std::recursive_mutex job_mutex;
+                std::unique_lock<std::recursive_mutex> job_lock(job_mutex);
+
+                for (const std::size_t index : group) {
+                    Voice *voice = voices[index];
+                    std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
+                    voice->defer_callbacks = true;
+                    results[index].finished = process_voice(kern, mem, thread_id, voice, results[index].finished_module, job_lock, voice_lock);
+                    voice->defer_callbacks = false;
                 }
-            }
+            }));
         }
-        if (finished) {
-            voice->is_keyed_off = true;
-            voice->transition(VoiceState::VOICE_STATE_FINALIZING);
-            if (voice->finished_callback) {
+
+        for (const JobPtr &job : jobs)
+            job->wait();
+        jobs.clear();
+
+        // the guest callbacks and the deliveries are then done by this thread in the queue order
+        for (const std::size_t index : level) {
+            Voice *voice = voices[index];
+            std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
+
+            if (!voice->deferred_callbacks.empty()) {
+                const std::vector<DeferredCallback> callbacks = std::move(voice->deferred_callbacks);
+                voice->deferred_callbacks.clear();
+
                 voice_lock.unlock();
                 scheduler_lock.unlock();
-                voice->invoke_callback(kern, mem, thread_id, voice->finished_callback, voice->finished_callback_user_data, finished_module);
+                for (const DeferredCallback &callback : callbacks)
+                    voice->invoke_callback(kern, mem, thread_id, callback.callback, callback.user_data, callback.module_id,
+                        callback.reason1, callback.reason2, callback.reason_ptr);
                 scheduler_lock.lock();
                 voice_lock.lock();
             }
-            voice->is_keyed_off = false;
 
-            stop(voice);
+            complete_voice(kern, mem, thread_id, voice, results[index].finished, results[index].finished_module, scheduler_lock, voice_lock);
         }
+    }
+}
 
-        for (std::size_t i = 0; i < voice->rack->vdef->output_count(); i++) {
-            if (voice->products[i].data)
-                deliver_data(mem, voice, static_cast<std::uint8_t>(i), voice->products[i]);
-        }
+void VoiceScheduler::update(KernelState &kern, const MemState &mem, const SceUID thread_id, const bool parallel) {
+    std::unique_lock<std::recursive_mutex> scheduler_lock(mutex);
+    is_updating = true;
+    const std::uint64_t update_start = profile ? profile_now_ns() : 0;
 
-        voice->frame_count++;
+    // make a copy of the queue, this way we have no issue if it is modified in a callbck
+    std::vector<ngs::Voice *> queue_copy = queue;
+
+    // Do a first routine to clear inputs from previous update session
+    for (ngs::Voice *voice : queue_copy) {
+        voice->inputs.reset_inputs();
     }
 
-    while (!operations_pending.empty()) {
-        OperationPending &op = operations_pending.front();
+    if (parallel && queue_copy.size() >= PARALLEL_UPDATE_MIN_VOICES) {
+        update_parallel(kern, mem, thread_id, queue_copy, scheduler_lock);
+    } else {
+        for (ngs::Voice *voice : queue_copy) {
+            std::unique_lock<std::mutex> voice_lock(*voice->voice_mutex);
 
-        switch (op.type) {
-        case PendingType::ReleaseRack:
-            release_rack(*op.release_data.state, mem, op.system, op.release_data.rack);
-            // run callback (we know it is defined)
-            kern.get_thread(thread_id)->run_callback(op.release_data.callback, { Ptr<void>(op.release_data.rack, mem).address() });
-            break;
+            std::uint32_t finished_module = 0;
+            const bool finished = process_voice(kern, mem, thread_id, voice, finished_module, scheduler_lock, voice_lock);
+            complete_voice(kern, mem, thread_id, voice, finished, finished_module, scheduler_lock, voice_lock);
         }
+    }
+
+    if (!operations_pending.empty()) {
+        const ThreadStatePtr thread = kern.get_thread(thread_id);
+        while (!operations_pending.empty()) {
+            OperationPending &op = operations_pending.front();
+
+            switch (op.type) {
+            case PendingType::ReleaseRack:
+                release_rack(*op.release_data.state, mem, op.system, op.release_data.rack);
+                // queue callback (we know it is defined), the callbacks of all the released racks are run together
+                thread->queue_callback(op.release_data.callback, { Ptr<void>(op.release_data.rack, mem).address() });
+                break;
+            }
+
+            operations_pending.pop();
+        }
+        thread->run_queued_callbacks();
+    }
 
-        operations_pending.pop();
+    if (profile) {
+        profile->update_ns.fetch_add(profile_now_ns() - update_start, std::memory_order_relaxed);
+        profile->budget_ns.fetch_add(update_budget_ns, std::memory_order_relaxed);
+        profile->voices_processed.fetch_add(queue_copy.size(), std::memory_order_relaxed);
+        profile->updates.fetch_add(1, std::memory_order_relaxed);
     }
 
     is_updating = false;
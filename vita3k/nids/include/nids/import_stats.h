@@ -0,0 +1,61 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Number of functions in nids.inc, import indices are their position in it
+constexpr size_t import_function_count =
+#define VAR_NID(name, nid)
+#define NID(name, nid) 1 +
+#include <nids/nids.inc>
+    0;
+#undef NID
+#undef VAR_NID
+
+// Latencies are counted in buckets of 4 per power of two nanoseconds, the last one holding everything above 15s
+constexpr size_t IMPORT_LATENCY_SUB_BUCKETS = 4;
+constexpr size_t IMPORT_LATENCY_BUCKETS = 33 * IMPORT_LATENCY_SUB_BUCKETS;
+
+struct ImportStats {
+    uint32_t nid;
+    const char *name;
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    std::array<uint64_t, IMPORT_LATENCY_BUCKETS> histogram;
+
+    // Lower bound of the latency of the given fraction of the calls, in nanoseconds
+    uint64_t get_percentile(double fraction) const;
+};
+
+// Lock-free, can be called from every thread
+void record_import_call(size_t index, uint64_t latency_ns);
+
+// Stats of the functions called at least once
+std::vector<ImportStats> get_import_stats();
+void reset_import_stats();
+// Writes the stats as JSON, returns false if the file can't be written
+bool save_import_stats(const std::string &path);
+
+// Smallest latency counted in the bucket, in nanoseconds
+uint64_t get_import_latency_bucket_start(size_t bucket);
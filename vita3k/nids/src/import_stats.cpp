@@ -0,0 +1,158 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <nids/import_stats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <memory>
+
+struct ImportFunction {
+    uint32_t nid;
+    const char *name;
+};
+
+static constexpr ImportFunction import_functions[] = {
+#define VAR_NID(name, nid)
+#define NID(name, nid) { nid, #name },
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+};
+
+static_assert(std::size(import_functions) == import_function_count);
+
+// The number of calls is the sum of the histogram
+struct ImportCounters {
+    std::atomic<uint64_t> total_ns = 0;
+    std::atomic<uint64_t> max_ns = 0;
+    std::array<std::atomic<uint64_t>, IMPORT_LATENCY_BUCKETS> histogram{};
+};
+
+// Allocated on the first call of each function, most are never called
+static std::array<std::atomic<ImportCounters *>, import_function_count> import_counters{};
+
+static size_t get_latency_bucket(uint64_t latency_ns) {
+    if (latency_ns < IMPORT_LATENCY_SUB_BUCKETS)
+        return static_cast<size_t>(latency_ns);
+
+    // The highest bit gives the power of two, the next two bits the sub bucket
+    const size_t msb = std::bit_width(latency_ns) - 1;
+    const size_t sub_bucket = (latency_ns >> (msb - 2)) & (IMPORT_LATENCY_SUB_BUCKETS - 1);
+    return std::min((msb - 1) * IMPORT_LATENCY_SUB_BUCKETS + sub_bucket, IMPORT_LATENCY_BUCKETS - 1);
+}
+
+uint64_t get_import_latency_bucket_start(size_t bucket) {
+    if (bucket < IMPORT_LATENCY_SUB_BUCKETS)
+        return bucket;
+
+    const size_t msb = bucket / IMPORT_LATENCY_SUB_BUCKETS + 1;
+    return (IMPORT_LATENCY_SUB_BUCKETS + bucket % IMPORT_LATENCY_SUB_BUCKETS) << (msb - 2);
+}
+
+uint64_t ImportStats::get_percentile(double fraction) const {
+    const uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(calls));
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < histogram.size(); bucket++) {
+        count += histogram[bucket];
+        if (count > target)
+            return get_import_latency_bucket_start(bucket);
+    }
+
+    return max_ns;
+}
+
+void record_import_call(size_t index, uint64_t latency_ns) {
+    if (index >= import_function_count)
+        return;
+
+    ImportCounters *counters = import_counters[index].load(std::memory_order_acquire);
+    if (!counters) {
+        auto new_counters = std::make_unique<ImportCounters>();
+        if (import_counters[index].compare_exchange_strong(counters, new_counters.get(), std::memory_order_acq_rel))
+            counters = new_counters.release();
+    }
+
+    counters->total_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+    counters->histogram[get_latency_bucket(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max_ns = counters->max_ns.load(std::memory_order_relaxed);
+    while ((latency_ns > max_ns) && !counters->max_ns.compare_exchange_weak(max_ns, latency_ns, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<ImportStats> get_import_stats() {
+    std::vector<ImportStats> stats;
+    for (size_t index = 0; index < import_function_count; index++) {
+        const ImportCounters *counters = import_counters[index].load(std::memory_order_acquire);
+        if (!counters)
+            continue;
+
+        ImportStats &function_stats = stats.emplace_back();
+        function_stats.nid = import_functions[index].nid;
+        function_stats.name = import_functions[index].name;
+        function_stats.total_ns = counters->total_ns.load(std::memory_order_relaxed);
+        function_stats.max_ns = counters->max_ns.load(std::memory_order_relaxed);
+        function_stats.calls = 0;
+        for (size_t bucket = 0; bucket < IMPORT_LATENCY_BUCKETS; bucket++) {
+            function_stats.histogram[bucket] = counters->histogram[bucket].load(std::memory_order_relaxed);
+            function_stats.calls += function_stats.histogram[bucket];
+        }
+        if (function_stats.calls == 0)
+            stats.pop_back();
+    }
+
+    return stats;
+}
+
+void reset_import_stats() {
+    for (std::atomic<ImportCounters *> &function_counters : import_counters) {
+        ImportCounters *counters = function_counters.load(std::memory_order_acquire);
+        if (!counters)
+            continue;
+
+        counters->total_ns = 0;
+        counters->max_ns = 0;
+        for (std::atomic<uint64_t> &bucket : counters->histogram)
+            bucket = 0;
+    }
+}
+
+bool save_import_stats(const std::string &path) {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    const std::vector<ImportStats> stats = get_import_stats();
+    file << "{\n    \"bucket_start_ns\": [";
+    for (size_t bucket = 0; bucket < IMPORT_LATENCY_BUCKETS; bucket++)
+        file << (bucket ? ", " : "") << get_import_latency_bucket_start(bucket);
+    file << "],\n    \"functions\": [";
+    for (size_t i = 0; i < stats.size(); i++) {
+        const ImportStats &function_stats = stats[i];
+        file << (i ? "," : "") << "\n        { \"name\": \"" << function_stats.name << "\", \"nid\": " << function_stats.nid
+             << ", \"calls\": " << function_stats.calls << ", \"total_ns\": " << function_stats.total_ns << ", \"max_ns\": " << function_stats.max_ns
+             << ", \"p50_ns\": " << function_stats.get_percentile(0.5) << ", \"p99_ns\": " << function_stats.get_percentile(0.99) << ", \"histogram\": [";
+        for (size_t bucket = 0; bucket < IMPORT_LATENCY_BUCKETS; bucket++)
+            file << (bucket ? ", " : "") << function_stats.histogram[bucket];
+        file << "] }";
+    }
+    file << "\n    ]\n}\n";
+
+    return static_cast<bool>(file);
+}
@@ -23,6 +23,7 @@
 
 #include <array>
 #include <cstdint>
+#include <string>
 
 struct IOState;
 
@@ -38,6 +39,11 @@ static constexpr std::uint32_t MAX_GROUPS = 16;
 // 128 with 32, or 128 >> 5
 using TrophyFlagArray = std::uint32_t[MAX_TROPHIES >> 5];
 
+struct TrophyDetails {
+    std::string name;
+    std::string detail;
+};
+
 enum class SceNpTrophyGrade : SceInt32 {
     SCE_NP_TROPHY_GRADE_UNKNOWN = 0,
     SCE_NP_TROPHY_GRADE_PLATINUM = 1,
@@ -67,7 +73,10 @@ struct Context {
     std::int32_t platinum_trophy_id{ -1 };
 
     std::string trophy_progress_output_file_path;
-    std::string trophy_detail_xml;
+    // names and details of the set and of the trophies, parsed once from the TROP.SFM of the language
+    bool trophy_details_loaded{ false };
+    TrophyDetails trophy_set_details;
+    std::array<TrophyDetails, MAX_TROPHIES> trophy_details;
 
     std::uint32_t lang{ 1 };
 
@@ -85,6 +94,7 @@ struct Context {
     const bool is_trophy_hidden(const uint32_t &trophy_index);
     const bool is_trophy_unlocked(const uint32_t &trophy_index);
     const int total_trophy_unlocked();
+    bool load_trophy_details();
     bool get_trophy_details(const int32_t id, std::string &name, std::string &detail);
     bool get_trophy_set(std::string &name, std::string &detail);
 
@@ -294,18 +294,15 @@ const int Context::total_trophy_unlocked() {
     return total;
 }
 
-bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
-    if (id < 0 || id >= MAX_TROPHIES) {
-        return false;
-    }
-
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+bool Context::load_trophy_details() {
+    if (trophy_details_loaded)
+        return true;
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
+    std::string trophy_detail_xml;
+    const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+    if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
+        if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
+            return false;
         }
     }
 
@@ -317,41 +314,47 @@ bool Context::get_trophy_details(const int32_t id, std::string &name, std::strin
         return false;
     }
 
-    // Try to find the description for the id
-    for (const auto &trop : doc.child("trophyconf")) {
-        if ((trop.name() == std::string("trophy")) && (trop.attribute("id").as_uint() == id)) {
-            name = trop.child("name").text().as_string();
-            detail = trop.child("detail").text().as_string();
+    const auto trophy_conf = doc.child("trophyconf");
+    trophy_set_details.name = trophy_conf.child("title-name").text().as_string();
+    trophy_set_details.detail = trophy_conf.child("title-detail").text().as_string();
+
+    for (const auto &trop : trophy_conf) {
+        if (trop.name() != std::string("trophy"))
+            continue;
 
-            break;
+        const auto id = trop.attribute("id").as_uint();
+        if (id < MAX_TROPHIES) {
+            trophy_details[id].name = trop.child("name").text().as_string();
+            trophy_details[id].detail = trop.child("detail").text().as_string();
         }
     }
 
-    return !name.empty() && !detail.empty();
+    trophy_details_loaded = true;
+    return true;
 }
 
-bool Context::get_trophy_set(std::string &name, std::string &detail) {
-    if (trophy_detail_xml.empty()) {
-        const std::string fname = fmt::format("TROP_{:0>2d}.SFM", lang);
+bool Context::get_trophy_details(const int32_t id, std::string &name, std::string &detail) {
+    if (id < 0 || id >= MAX_TROPHIES) {
+        return false;
+    }
 
-        if (!read_trophy_entry_to_buffer(trophy_file, fname.c_str(), trophy_detail_xml)) {
-            if (!read_trophy_entry_to_buffer(trophy_file, "TROP.SFM", trophy_detail_xml)) {
-                return false;
-            }
-        }
+    if (!load_trophy_details()) {
+        return false;
     }
 
-    // Parse it
-    pugi::xml_document doc;
-    const auto result = doc.load_string(trophy_detail_xml.c_str());
+    name = trophy_details[id].name;
+    detail = trophy_details[id].detail;
 
-    if (!result) {
+    return !name.empty() && !detail.empty();
+}
+
+bool Context::get_trophy_set(std::string &name, std::string &detail) {
+    if (!load_trophy_details()) {
         return false;
     }
 
-    const auto trophy_conf = doc.child("trophyconf");
-    name = trophy_conf.child("title-name").text().as_string();
-    detail = trophy_conf.child("title-detail").text().as_string();
+    name = trophy_set_details.name;
+    detail = trophy_set_details.detail;
 
     return !name.empty() && !detail.empty();
 }
@@ -35,11 +35,21 @@
 #include <packages/pkg.h>
 #include <packages/sce_types.h>
 #include <packages/sfo.h>
+#include <threads/job_pool.h>
 
 #include <util/bytes.h>
 #include <util/log.h>
 #include <util/string_utils.h>
 
+#include <algorithm>
+#include <deque>
+#include <thread>
+
+// size of the parts of the files read, decrypted and written at once
+constexpr uint64_t PKG_CHUNK_SIZE = 1024 * 1024;
+// chunks not written yet before the reads wait for the writes
+constexpr size_t PKG_CHUNKS_IN_FLIGHT = 32;
+
 // Credits to mmozeiko https://github.com/mmozeiko/pkg2zip
 
 static void ctr_add(uint8_t *counter, uint64_t n) {
@@ -51,28 +61,16 @@ static void ctr_add(uint8_t *counter, uint64_t n) {
 }
 
 static void aes128_ctr_xor(aes_context *ctx, const uint8_t *iv, uint64_t block, uint8_t *input, size_t size) {
-    uint8_t tmp[16];
     uint8_t counter[16];
     for (uint32_t i = 0; i < 16; i++) {
         counter[i] = iv[i];
     }
     ctr_add(counter, block);
 
-    while (size >= 16) {
-        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
-        for (uint32_t i = 0; i < 16; i++) {
-            *input++ ^= tmp[i];
-        }
-        ctr_add(counter, 1);
-        size -= 16;
-    }
-
-    if (size != 0) {
-        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
-        for (size_t i = 0; i < size; i++) {
-            *input++ ^= tmp[i];
-        }
-    }
+    // done on whole buffers so the hardware AES can process several blocks at once
+    uint8_t stream_block[16];
+    size_t stream_offset = 0;
+    aes_crypt_ctr(ctx, size, &stream_offset, counter, stream_block, input, input);
 }
 
 bool decrypt_install_nonpdrm(EmuEnvState &emuenv, std::string &drmlicpath, const std::string &title_path) {
@@ -109,6 +107,9 @@ bool decrypt_install_nonpdrm(EmuEnvState &emuenv, std::string &drmlicpath, const
     return true;
 }
 
+// The files have to be extracted: once the pkg layer is decrypted, the files of the apps are still in the PFS format,
+// which psvpfsparser only decrypts as a whole tree, and the selfs are converted to fselfs afterwards.
+// So app0 can't be served from the pkg file directly without a PFS decryption of the requested ranges.
 bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRIF, const std::function<void(float)> &progress_callback) {
     std::wstring pkg_path = string_utils::utf_to_wide(pkg);
     fs::ifstream infile(pkg_path, std::ios::binary);
@@ -250,6 +251,11 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         break;
     }
 
+    // the entries are read in order, decrypted by several threads and written by another one
+    JobPool decrypt_pool(std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4));
+    JobPool write_pool(1);
+    std::deque<JobPtr> write_jobs;
+
     for (uint32_t i = 0; i < byte_swap(pkg_header.file_count); i++) {
         PkgEntry entry;
         uint64_t file_offset = items_offset + i * 32;
@@ -274,25 +280,44 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         if ((byte_swap(entry.type) & 0xFF) == 4 || (byte_swap(entry.type) & 0xFF) == 18) { // Directory
             fs::create_directories(path.string() + "/" + string_name);
         } else { // File
-            std::ofstream outfile(path.string() + "/" + string_name, std::ios::binary);
+            // the writes are done in order by the single write thread, once the decryption of their chunk is done
+            const auto outfile = std::make_shared<std::ofstream>();
+            const std::string out_path = path.string() + "/" + string_name;
+            write_jobs.push_back(write_pool.submit([outfile, out_path]() {
+                outfile->open(out_path, std::ios::binary);
+            }));
 
             auto offset = byte_swap(entry.data_offset);
             auto data_size = byte_swap(entry.data_size);
             while (data_size != 0) {
-                unsigned char buffer[0x10000];
-                auto size = data_size < sizeof(buffer) ? data_size : sizeof(buffer);
+                const auto size = data_size < PKG_CHUNK_SIZE ? data_size : PKG_CHUNK_SIZE;
+                const auto chunk = std::make_shared<std::vector<uint8_t>>(size);
                 infile.seekg(byte_swap(pkg_header.data_offset) + offset);
-                infile.read((char *)buffer, size);
-
-                aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, offset / 16, buffer, size);
+                infile.read(reinterpret_cast<char *>(chunk->data()), size);
+
+                // the counter of each chunk only depends on its offset, so they are decrypted in parallel
+                const JobPtr decrypt_job = decrypt_pool.submit([&aes_ctx, &pkg_header, chunk, offset]() {
+                    aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, offset / 16, chunk->data(), chunk->size());
+                });
+                write_jobs.push_back(write_pool.submit([outfile, chunk, decrypt_job]() {
+                    decrypt_job->wait();
+                    outfile->write(reinterpret_cast<const char *>(chunk->data()), chunk->size());
+                }));
+
+                // bound the memory used by the chunks in flight
+                while (write_jobs.size() > PKG_CHUNKS_IN_FLIGHT) {
+                    write_jobs.front()->wait();
+                    write_jobs.pop_front();
+                }
 
-                outfile.write((char *)buffer, size);
                 offset += size;
                 data_size -= size;
             }
-            outfile.close();
         }
     }
+    for (const JobPtr &job : write_jobs)
+        job->wait();
+    write_jobs.clear();
     infile.close();
 
     std::string title_id_src = path.string();
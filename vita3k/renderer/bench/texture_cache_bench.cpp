@@ -0,0 +1,139 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Times the texture cache binding the textures of a frame: the lookups which find a hashed texture, the ones
+// which find a texture tracked by the memory protection, and the misses which evict a texture and upload the new one.
+// The backend callbacks do nothing, so only the cache itself is timed. Returns a non-zero value if the hits are not counted.
+
+#include <renderer/functions.h>
+#include <renderer/texture_cache_state.h>
+#include <renderer/types.h>
+
+#include <gxm/types.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace renderer;
+using namespace renderer::texture;
+
+static constexpr int FRAMES = 200;
+
+struct Scenario {
+    const char *name;
+    // textures bound by each frame, in turn
+    uint32_t texture_count;
+    uint16_t size;
+    // size of the cache, lower than the texture count for the misses
+    size_t capacity;
+    bool use_protect;
+};
+
+static constexpr Scenario SCENARIOS[] = {
+    { "hit, hashed", 256, 64, TextureCacheSize, false },
+    { "hit, hashed", 256, 256, TextureCacheSize, false },
+    { "hit, protected", 256, 256, TextureCacheSize, true },
+    { "miss, evicted", 512, 64, 256, false },
+};
+
+static SceGxmTexture make_texture(Address data, uint16_t size) {
+    SceGxmTexture texture{};
+    texture.mip_count = 0;
+    texture.lod_bias = 31;
+    texture.uaddr_mode = texture.vaddr_mode = SCE_GXM_TEXTURE_ADDR_CLAMP;
+    texture.height = size - 1;
+    texture.width = size - 1;
+    texture.base_format = (SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR & 0x1F000000) >> 24;
+    texture.type = SCE_GXM_TEXTURE_LINEAR >> 29;
+    texture.data_addr = data >> 2;
+    texture.normalize_mode = 1;
+    return texture;
+}
+
+static bool bench(MemState &mem, const Scenario &scenario, std::mt19937 &rng) {
+    Backend backend = Backend::Vulkan;
+    TextureCacheState cache;
+    cache.backend = &backend;
+    cache.use_protect = scenario.use_protect;
+    cache.select_callback = [](std::size_t, const void *) {};
+    cache.configure_texture_callback = [](TextureCacheState &, const void *) {};
+    cache.upload_texture_callback = [](SceGxmTextureBaseFormat, uint32_t, uint32_t, uint32_t, const void *, int, bool, size_t, uint32_t) {};
+    cache.upload_done_callback = []() {};
+    set_cache_limits(cache, scenario.capacity, 0);
+
+    const size_t texture_bytes = static_cast<size_t>(scenario.size) * scenario.size * 4;
+    std::vector<Address> addresses;
+    std::vector<SceGxmTexture> textures;
+    for (uint32_t i = 0; i < scenario.texture_count; i++) {
+        const Address address = alloc(mem, texture_bytes, "texture", mem.page_size);
+        if (!address)
+            return false;
+        uint8_t *data = Ptr<uint8_t>(address).get(mem);
+        for (size_t j = 0; j < texture_bytes; j++)
+            data[j] = static_cast<uint8_t>(rng());
+        addresses.push_back(address);
+        textures.push_back(make_texture(address, scenario.size));
+    }
+
+    // the first frame caches the textures
+    for (const SceGxmTexture &texture : textures)
+        cache_and_bind_texture(cache, texture, mem);
+    cache.frame_stats = {};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (const SceGxmTexture &texture : textures)
+            cache_and_bind_texture(cache, texture, mem);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const uint32_t binds = scenario.texture_count * FRAMES;
+    const double bind_ns = std::chrono::duration<double, std::nano>(end - start).count() / binds;
+    const uint32_t hit_rate = cache.frame_stats.hits * 100 / cache.frame_stats.lookups;
+    std::printf("%-16s %8u %5ux%-5u %10.1f ns %5u%% %10.1f KB\n", scenario.name, scenario.texture_count, scenario.size, scenario.size,
+        bind_ns, hit_rate, cache.frame_stats.upload_bytes / 1024.0 / FRAMES);
+
+    for (const Address address : addresses)
+        free(mem, address);
+
+    // all the textures fit in the cache unless it is smaller, then the texture evicted is always the next one bound
+    const bool expect_hits = scenario.capacity >= scenario.texture_count;
+    return expect_hits ? (hit_rate == 100) : (cache.frame_stats.hits == 0);
+}
+
+int main() {
+    std::mt19937 rng(42);
+    bool success = true;
+
+    MemState mem;
+    if (!init(mem)) {
+        std::fprintf(stderr, "Failed to initialize the guest memory\n");
+        return 1;
+    }
+
+    // the uploads are per frame
+    std::printf("%-16s %8s %11s %13s %6s %13s\n", "lookup", "textures", "size", "per bind", "hits", "uploaded");
+    for (const Scenario &scenario : SCENARIOS)
+        success &= bench(mem, scenario, rng);
+
+    return success ? 0 : 1;
+}
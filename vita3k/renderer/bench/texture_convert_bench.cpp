@@ -0,0 +1,128 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Times the texture converters and the transfers against their scalar references on representative sizes,
+// and checks that they give the same result. Returns a non-zero value if one of them differs.
+
+#include <renderer/functions.h>
+#include <renderer/texture_convert.h>
+#include <renderer/transfer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace renderer::texture;
+namespace transfer = renderer::transfer;
+
+static constexpr int ITERATIONS = 20;
+
+struct Size {
+    uint16_t width;
+    uint16_t height;
+};
+
+static constexpr Size SIZES[] = { { 2, 16 }, { 16, 1 }, { 64, 64 }, { 256, 128 }, { 512, 512 }, { 1024, 1024 }, { 128, 2048 } };
+
+static double time_us(const std::function<void()> &convert) {
+    convert();
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        convert();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / ITERATIONS;
+}
+
+static bool bench(const char *name, const Size &size, size_t dst_size, const std::function<void(uint8_t *)> &basic, const std::function<void(uint8_t *)> &fast) {
+    std::vector<uint8_t> basic_dst(dst_size);
+    std::vector<uint8_t> fast_dst(dst_size);
+    const double basic_time = time_us([&]() { basic(basic_dst.data()); });
+    const double fast_time = time_us([&]() { fast(fast_dst.data()); });
+    const bool same = basic_dst == fast_dst;
+
+    std::printf("%-24s %5ux%-5u %10.1f us %10.1f us %6.2fx%s\n", name, size.width, size.height, basic_time, fast_time,
+        basic_time / fast_time, same ? "" : "  MISMATCH");
+    return same;
+}
+
+int main() {
+    std::mt19937 rng(42);
+    bool success = true;
+
+    std::vector<uint32_t> palette(256);
+    for (uint32_t &color : palette)
+        color = rng();
+
+    std::printf("Using %s converters\n", get_texture_convert_isa());
+    std::printf("%-24s %11s %13s %13s %7s\n", "converter", "size", "basic", "fast", "speedup");
+    for (const Size &size : SIZES) {
+        const size_t pixel_count = size.width * size.height;
+        // tiled textures are padded to 32x32 tiles
+        std::vector<uint8_t> src(((size.width + 31) & ~31) * ((size.height + 31) & ~31) * 16);
+        for (uint8_t &byte : src)
+            byte = static_cast<uint8_t>(rng());
+
+        for (const uint8_t bpp : { 8, 16, 32, 64 }) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "unswizzle %ubpp", bpp);
+            success &= bench(name, size, pixel_count * bpp / 8,
+                [&](uint8_t *dst) { swizzled_texture_to_linear_texture_basic(dst, src.data(), size.width, size.height, bpp); },
+                [&](uint8_t *dst) { swizzled_texture_to_linear_texture(dst, src.data(), size.width, size.height, bpp); });
+
+            std::snprintf(name, sizeof(name), "untile %ubpp", bpp);
+            success &= bench(name, size, pixel_count * bpp / 8,
+                [&](uint8_t *dst) { tiled_texture_to_linear_texture_basic(dst, src.data(), size.width, size.height, bpp); },
+                [&](uint8_t *dst) { tiled_texture_to_linear_texture(dst, src.data(), size.width, size.height, bpp); });
+        }
+
+        success &= bench("palette p4", size, pixel_count * 4,
+            [&](uint8_t *dst) { palette_texture_to_rgba_4_basic(reinterpret_cast<uint32_t *>(dst), src.data(), size.width, size.height, size.width / 2, palette.data()); },
+            [&](uint8_t *dst) { palette_texture_to_rgba_4(reinterpret_cast<uint32_t *>(dst), src.data(), size.width, size.height, size.width / 2, palette.data()); });
+        success &= bench("palette p8", size, pixel_count * 4,
+            [&](uint8_t *dst) { palette_texture_to_rgba_8_basic(reinterpret_cast<uint32_t *>(dst), src.data(), size.width, size.height, size.width, palette.data()); },
+            [&](uint8_t *dst) { palette_texture_to_rgba_8(reinterpret_cast<uint32_t *>(dst), src.data(), size.width, size.height, size.width, palette.data()); });
+        success &= bench("rgb to rgba", size, pixel_count * 4,
+            [&](uint8_t *dst) { rgb_texture_to_rgba_basic(dst, src.data(), pixel_count); },
+            [&](uint8_t *dst) { rgb_texture_to_rgba(dst, src.data(), pixel_count); });
+
+        // the transfers write a rectangle of the destination, which keeps the other pixels
+        const int32_t stride = size.width * 4;
+        const uint32_t half_width = size.width / 2;
+        const uint32_t half_height = size.height / 2;
+        success &= bench("transfer copy", size, pixel_count * 4,
+            [&](uint8_t *dst) { transfer::copy_basic(dst, stride, 4, src.data(), stride, 4, half_width, size.height, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0); },
+            [&](uint8_t *dst) { transfer::copy(dst, stride, 4, src.data(), stride, 4, half_width, size.height, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0); });
+        success &= bench("transfer copy key", size, pixel_count * 4,
+            [&](uint8_t *dst) { transfer::copy_basic(dst, stride, 4, src.data(), stride, 4, half_width, size.height, SCE_GXM_TRANSFER_COLORKEY_REJECT, 0x01, 0x03); },
+            [&](uint8_t *dst) { transfer::copy(dst, stride, 4, src.data(), stride, 4, half_width, size.height, SCE_GXM_TRANSFER_COLORKEY_REJECT, 0x01, 0x03); });
+        for (const uint32_t bytes_per_pixel : { 1, 2, 4 }) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "transfer fill %ubpp", bytes_per_pixel * 8);
+            success &= bench(name, size, pixel_count * bytes_per_pixel,
+                [&](uint8_t *dst) { transfer::fill_basic(dst, size.width * bytes_per_pixel, bytes_per_pixel, half_width, size.height, 0x11223344); },
+                [&](uint8_t *dst) { transfer::fill(dst, size.width * bytes_per_pixel, bytes_per_pixel, half_width, size.height, 0x11223344); });
+        }
+        success &= bench("transfer downscale", size, pixel_count,
+            [&](uint8_t *dst) { transfer::downscale_basic(dst, half_width * 4, src.data(), stride, 4, half_width, half_height); },
+            [&](uint8_t *dst) { transfer::downscale(dst, half_width * 4, src.data(), stride, 4, half_width, half_height); });
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <renderer/commands.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace renderer {
+
+constexpr std::size_t COMMAND_ARENA_CHUNK_SIZE = 4096;
+// Once this many chunks are in flight (the title does not go through the display queue),
+// commands are allocated on the heap instead
+constexpr std::size_t COMMAND_ARENA_MAX_CHUNKS = 64;
+
+// Linear allocator of the commands of the immediate context.
+// Commands are bump-allocated in chunks which are tagged with the last frame they were allocated in
+// and recycled all at once when the renderer is done with this frame, they are never freed one by one.
+// Allocation is done by the thread recording the immediate context only.
+class CommandArena {
+public:
+    CommandArena() = default;
+    CommandArena(const CommandArena &) = delete;
+    CommandArena &operator=(const CommandArena &) = delete;
+
+    Command *allocate();
+
+    // Called after a NewFrame command was submitted, from any thread
+    void end_frame() {
+        frames_submitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called by the renderer once it processed a NewFrame command
+    void retire_frame() {
+        frames_retired.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    struct UsedChunk {
+        uint64_t frame;
+        std::unique_ptr<Command[]> commands;
+    };
+
+    void next_chunk();
+
+    std::unique_ptr<Command[]> current_chunk;
+    std::size_t current_used = COMMAND_ARENA_CHUNK_SIZE;
+    uint64_t current_frame = 0;
+
+    std::deque<UsedChunk> used_chunks;
+    std::vector<std::unique_ptr<Command[]>> free_chunks;
+
+    std::atomic<uint64_t> frames_submitted = 0;
+    std::atomic<uint64_t> frames_retired = 0;
+};
+
+} // namespace renderer
@@ -31,7 +31,6 @@ namespace renderer {
 struct Command;
 
 using CommandAllocFunc = std::function<Command *()>;
-using CommandFreeFunc = std::function<void(Command *)>;
 
 struct Context;
 struct State;
@@ -96,7 +95,6 @@ constexpr std::size_t MAX_COMMAND_DATA_SIZE = 0x20;
 
 struct Command {
     enum {
-        FLAG_FROM_HOST = 1 << 0,
         FLAG_NO_FREE = 1 << 1
     };
 
@@ -171,10 +169,11 @@ bool do_command_push_data(CommandHelper &helper, Head arg1, Args... args2) {
     return true;
 }
 
-template <typename... Args>
-Command *make_command(CommandAllocFunc alloc_func, CommandFreeFunc free_func, const CommandOpcode opcode, int *status, Args... arguments) {
-    Command *new_command = alloc_func();
+// Frees a command unless it belongs to an arena or a deferred command list
+void free_command(Command *cmd);
 
+template <typename... Args>
+Command *make_command(Command *new_command, const CommandOpcode opcode, int *status, Args... arguments) {
     new_command->opcode = opcode;
     new_command->status = status;
     new_command->next = nullptr;
@@ -183,7 +182,7 @@ Command *make_command(CommandAllocFunc alloc_func, CommandFreeFunc free_func, co
 
     if constexpr (sizeof...(arguments) > 0) {
         if (!do_command_push_data(helper, arguments...)) {
-            free_func(new_command);
+            free_command(new_command);
             return nullptr;
         }
     }
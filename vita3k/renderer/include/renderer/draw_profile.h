@@ -0,0 +1,157 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace renderer {
+
+// phases of the commands processed by the render thread, the time of a phase done inside another one is only counted once
+enum DrawProfileStage : uint32_t {
+    DRAW_PROFILE_SET_STATE,
+    DRAW_PROFILE_TEXTURE_HASH,
+    DRAW_PROFILE_TEXTURE_DECODE,
+    DRAW_PROFILE_TEXTURE_UPLOAD,
+    DRAW_PROFILE_PIPELINE,
+    DRAW_PROFILE_DESCRIPTORS,
+    DRAW_PROFILE_VERTEX_INDEX,
+    // what is left of the draws once the other phases are taken out
+    DRAW_PROFILE_RECORD,
+    DRAW_PROFILE_STAGE_COUNT
+};
+
+// totals since the renderer started, the times are in microseconds
+struct DrawProfileTotals {
+    std::array<uint64_t, DRAW_PROFILE_STAGE_COUNT> stage_us{};
+    uint64_t frames = 0;
+    uint64_t draws = 0;
+    uint64_t state_changes = 0;
+    uint64_t texture_uploads = 0;
+    uint64_t upload_bytes = 0;
+};
+
+// averages per frame processed during the last second, shown in the performance overlay
+struct DrawProfileSnapshot {
+    std::array<float, DRAW_PROFILE_STAGE_COUNT> stage_us{};
+    float draws = 0.f;
+    float state_changes = 0.f;
+    float texture_uploads = 0.f;
+    float upload_bytes = 0.f;
+};
+
+// CPU time of the render thread by phase of the draws, measured with the cycle counter of the host
+// the counters are only written by the render thread, the other threads read them
+class DrawProfile {
+public:
+    // set by the benchmark mode and the performance overlay, nothing is measured otherwise
+    std::atomic<bool> enabled = false;
+
+    DrawProfile();
+
+    bool is_enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void add_stage(DrawProfileStage stage, uint64_t ticks) {
+        add(stage_ticks[stage], ticks);
+        attributed_ticks += ticks;
+    }
+    // ticks added to all the stages, a scope takes the ones added while it was open out of its own time
+    uint64_t get_attributed_ticks() const {
+        return attributed_ticks;
+    }
+
+    void count_frame() {
+        add(frames, 1);
+    }
+    void count_draw() {
+        if (is_enabled())
+            add(draws, 1);
+    }
+    void count_state_change() {
+        if (is_enabled())
+            add(state_changes, 1);
+    }
+    void count_texture_upload(uint64_t bytes) {
+        if (is_enabled()) {
+            add(texture_uploads, 1);
+            add(upload_bytes, bytes);
+        }
+    }
+
+    DrawProfileTotals get_totals() const;
+    // the totals are turned into a new snapshot once a second has passed since the previous one
+    DrawProfileSnapshot get_snapshot();
+
+private:
+    // there is a single writer, so the counters don't need an atomic addition
+    static void add(std::atomic<uint64_t> &counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, DRAW_PROFILE_STAGE_COUNT> stage_ticks{};
+    std::atomic<uint64_t> frames = 0;
+    std::atomic<uint64_t> draws = 0;
+    std::atomic<uint64_t> state_changes = 0;
+    std::atomic<uint64_t> texture_uploads = 0;
+    std::atomic<uint64_t> upload_bytes = 0;
+    uint64_t attributed_ticks = 0;
+
+    // the cycle counter and the steady clock when the profile was created, their ratio gives the counter frequency
+    uint64_t start_ticks;
+    uint64_t start_ns;
+
+    std::mutex snapshot_mutex;
+    uint64_t snapshot_time_ns = 0;
+    DrawProfileTotals snapshot_totals;
+    DrawProfileSnapshot snapshot;
+};
+
+// cycle counter of the host, the steady clock in nanoseconds if it has none
+uint64_t draw_profile_ticks();
+
+// adds the time of its scope to a stage without the time of the scopes opened inside it, does nothing without an enabled profile
+class DrawProfileScope {
+    DrawProfile *profile;
+    DrawProfileStage stage;
+    uint64_t start = 0;
+    uint64_t attributed_start = 0;
+
+public:
+    DrawProfileScope(DrawProfile *profile, const DrawProfileStage stage)
+        : profile(profile && profile->is_enabled() ? profile : nullptr)
+        , stage(stage) {
+        if (this->profile) {
+            attributed_start = this->profile->get_attributed_ticks();
+            start = draw_profile_ticks();
+        }
+    }
+    ~DrawProfileScope() {
+        if (profile) {
+            const uint64_t elapsed = draw_profile_ticks() - start;
+            const uint64_t nested = profile->get_attributed_ticks() - attributed_start;
+            profile->add_stage(stage, elapsed > nested ? elapsed - nested : 0);
+        }
+    }
+    DrawProfileScope(const DrawProfileScope &) = delete;
+    DrawProfileScope &operator=(const DrawProfileScope &) = delete;
+};
+
+} // namespace renderer
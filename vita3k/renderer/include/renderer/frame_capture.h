@@ -0,0 +1,196 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <renderer/commands.h>
+#include <renderer/gxm_types.h>
+
+#include <mem/ptr.h>
+#include <util/fs.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Config;
+struct MemState;
+
+namespace gxp {
+struct ProgramInfo;
+} // namespace gxp
+
+namespace renderer {
+struct Context;
+struct RenderTarget;
+struct State;
+
+// A guest memory range read by a command, saved with its content at that time
+struct CapturePatch {
+    Address addr;
+    std::vector<uint8_t> data;
+};
+
+// Host pointer in the data of a command, saved as what it points to
+enum class CaptureFixupKind : uint8_t {
+    // pointer in the guest memory, saved as its address
+    GuestPointer,
+    // render target, saved as its id in the capture
+    RenderTarget,
+    // objects allocated by the client and deleted by the command handler, saved as their content
+    ColorSurface,
+    DepthStencilSurface,
+    TransferImage,
+    TransferImages,
+    // color surface owned by the client, saved as its content
+    ColorSurfaceView,
+};
+
+struct CaptureFixup {
+    CaptureFixupKind kind;
+    // offset of the pointer in the command data
+    uint8_t offset;
+    // guest address or render target id, unused for the objects
+    uint32_t value;
+    std::vector<uint8_t> object;
+};
+
+struct CaptureCommand {
+    CommandOpcode opcode;
+    bool has_status;
+    uint16_t context_id;
+    std::uint8_t data[MAX_COMMAND_DATA_SIZE];
+    std::vector<CaptureFixup> fixups;
+    // written to the guest memory before the command is processed
+    std::vector<CapturePatch> patches;
+};
+
+// A shader program object of SceGxm, its host data is created again by the replay
+struct CaptureProgram {
+    Address addr;
+    bool is_fragment;
+    Address program;
+    bool is_maskupdate;
+    bool has_blend;
+    SceGxmBlendInfo blend;
+    std::vector<SceGxmVertexStream> streams;
+    std::vector<SceGxmVertexAttribute> attributes;
+};
+
+// Records the commands processed by the renderer during one frame with the guest memory they read, to replay them
+// without the CPU side with renderer-replay. The guest memory is saved as a snapshot when the frame starts, then the
+// ranges read by each command (indices, vertex streams, uniform buffers, textures, programs and transfer sources)
+// are saved again before it each time their content changed.
+// The render targets, memory mappings and states set before the frame are tracked from the moment it is created,
+// so it must exist before the app creates its render targets.
+class FrameCapture {
+public:
+    // the frame starts after the NewFrame command number frame
+    FrameCapture(uint64_t frame, const fs::path &path);
+
+    // called by process_batch before each command is processed, return true once the frame is written
+    bool record(State &state, MemState &mem, Context *context, const Command &cmd);
+
+    void add_render_target(const RenderTarget *render_target, const SceGxmRenderTargetParams &params);
+    void remove_render_target(const RenderTarget *render_target);
+    void add_memory_mapping(Address addr, uint32_t size);
+    void remove_memory_mapping(Address addr);
+
+private:
+    struct TrackedState {
+        uint64_t sequence;
+        Command cmd;
+    };
+
+    // last scene started by a context before the frame, it is started again by the replay if it was not ended
+    struct TrackedScene {
+        const RenderTarget *render_target = nullptr;
+        bool has_color_surface = false;
+        SceGxmColorSurface color_surface;
+        bool has_depth_stencil_surface = false;
+        SceGxmDepthStencilSurface depth_stencil_surface;
+        bool is_open = false;
+    };
+
+    void track(MemState &mem, Context *context, const Command &cmd);
+    void start(State &state, MemState &mem);
+    void add_command(MemState &mem, Context *context, const Command &cmd);
+    void add_patch(MemState &mem, CaptureCommand &command, Address addr, size_t size);
+    void add_program(MemState &mem, CaptureCommand &command, Address addr, bool is_fragment);
+    uint16_t get_context_id(Context *context);
+    uint32_t get_render_target_id(const RenderTarget *render_target);
+    bool write() const;
+
+    uint64_t frame;
+    fs::path path;
+    uint64_t frames_seen = 0;
+    bool is_capturing = false;
+
+    uint64_t state_sequence = 0;
+    std::map<std::pair<Context *, uint64_t>, TrackedState> states;
+    std::map<Context *, TrackedScene> scenes;
+    std::map<const RenderTarget *, SceGxmRenderTargetParams> render_targets;
+    std::map<Address, uint32_t> memory_mappings;
+
+    std::string snapshot;
+    std::map<const RenderTarget *, uint32_t> render_target_ids;
+    std::map<Context *, uint16_t> context_ids;
+    std::map<Address, CaptureProgram> programs;
+    // hash of the content of the ranges saved, by address and size
+    std::map<std::pair<Address, size_t>, uint64_t> saved_ranges;
+    std::vector<CaptureCommand> commands;
+    uint32_t skipped_commands = 0;
+};
+
+// Replays a frame written by FrameCapture with the commands of its scenes, the client side of the objects it uses is created
+// again: the render targets, the memory mappings, the contexts and the programs of SceGxm
+class FrameReplay {
+public:
+    // restore the guest memory of the capture and create its render targets, memory mappings and contexts
+    bool load(State &state, MemState &mem, Config &config, const fs::path &path);
+    // process every command of the frame once
+    void replay(State &state, MemState &mem, Config &config);
+    // destroy the objects created by load, the renderer must be idle
+    void destroy(State &state, MemState &mem, Config &config);
+
+    size_t get_command_count() const {
+        return commands.size();
+    }
+    uint64_t get_frame() const {
+        return frame;
+    }
+
+private:
+    void process(State &state, MemState &mem, Config &config, Command *cmd, Context *context);
+    void apply_patches(MemState &mem, const CaptureCommand &command);
+    void create_program(State &state, MemState &mem, Address addr);
+
+    uint64_t frame = 0;
+    std::vector<std::unique_ptr<RenderTarget>> render_targets;
+    std::vector<std::unique_ptr<Context>> contexts;
+    std::vector<std::pair<Address, uint32_t>> memory_mappings;
+    std::map<Address, CaptureProgram> programs;
+    std::map<Address, std::shared_ptr<const gxp::ProgramInfo>> program_infos;
+    std::vector<CaptureCommand> commands;
+    // the surfaces owned by the client are kept for the whole replay
+    std::vector<std::unique_ptr<SceGxmColorSurface>> surface_views;
+};
+
+} // namespace renderer
@@ -26,6 +26,10 @@ struct Config;
 
 typedef uint32_t TextureCacheHash;
 
+namespace gxp {
+struct ProgramInfo;
+} // namespace gxp
+
 namespace renderer {
 struct Context;
 struct FragmentProgram;
@@ -33,8 +37,8 @@ struct RenderTarget;
 struct State;
 struct VertexProgram;
 
-bool create(std::unique_ptr<FragmentProgram> &fp, State &state, const SceGxmProgram &program, const SceGxmBlendInfo *blend, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id);
-bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id);
+bool create(std::shared_ptr<FragmentProgram> &fp, State &state, const gxp::ProgramInfo &program_info, const SceGxmBlendInfo *blend, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id);
+bool create(std::shared_ptr<VertexProgram> &vp, State &state, const gxp::ProgramInfo &program_info, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id);
 void create(SceGxmSyncObject *sync, State &state);
 void destroy(SceGxmSyncObject *sync, State &state);
 void finish(State &state, Context *context);
@@ -57,9 +61,13 @@ int wait_for_status(State &state, int *status, int signal, bool wake_on_equal);
 void reset_command_list(CommandList &command_list);
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list);
 bool is_cmd_ready(MemState &mem, CommandList &command_list);
-void process_batch(State &state, MemState &mem, Config &config, CommandList &command_list);
+void process_batch(State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list);
 void process_batches(State &state, const FeatureState &features, MemState &mem, Config &config);
+// true if the last scenes drawing to this color surface were dropped by the frame skip
+bool is_surface_skipped(const State &state, Address surface);
 bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, const Config &config, const char *base_path);
+// Keep the decoded textures of the current title on disk, must be called once its base path and title id are set
+void open_texture_disk_cache(State &state);
 
 void set_depth_bias(State &state, Context *ctx, bool is_front, int factor, int units);
 void set_depth_func(State &state, Context *ctx, bool is_front, SceGxmDepthFunc depth_func);
@@ -91,15 +99,15 @@ void destroy_context(State &state, std::unique_ptr<Context> &context);
 bool create_render_target(State &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRenderTargetParams *params);
 void destroy_render_target(State &state, std::unique_ptr<RenderTarget> &rt);
 
-Command *generic_command_allocate();
-void generic_command_free(Command *cmd);
+// Allocates from the arena or the allocator of the context, or on the heap if there is none
+Command *allocate_command(Context *ctx);
 
 template <typename... Args>
 bool add_command(Context *ctx, const CommandOpcode opcode, int *status, Args... arguments) {
     if (!ctx) {
         return false;
     }
-    auto cmd_maked = make_command(ctx->alloc_func, ctx->free_func, opcode, status, arguments...);
+    auto cmd_maked = make_command(allocate_command(ctx), opcode, status, arguments...);
 
     if (!cmd_maked) {
         return false;
@@ -125,8 +133,7 @@ template <typename... Args>
 int send_single_command(State &state, Context *ctx, const CommandOpcode opcode, bool wait, Args... arguments) {
     // Make a temporary command list
     int status = CommandErrorCodePending; // Pending.
-    auto cmd = make_command(ctx ? ctx->alloc_func : generic_command_allocate, ctx ? ctx->free_func : generic_command_free,
-        opcode, wait ? &status : nullptr, arguments...);
+    auto cmd = make_command(allocate_command(ctx), opcode, wait ? &status : nullptr, arguments...);
 
     if (!cmd) {
         return CommandErrorArgumentsTooLarge;
@@ -145,13 +152,15 @@ int send_single_command(State &state, Context *ctx, const CommandOpcode opcode,
 }
 
 struct TextureCacheState;
+enum class PvrtcUploadMode : uint8_t;
 
 namespace texture {
 
 // Paletted textures.
 void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
 void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
-void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height);
+// convert a yuv420 texture with either three planes or the chroma interleaved in a second plane, V comes first if is_yvu is set
+void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height, const bool is_two_planes, const bool is_yvu);
 const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState &mem);
 
 /**
@@ -180,17 +189,55 @@ void decompress_bc_swizz_image(std::uint32_t width, std::uint32_t height, const
  */
 void resolve_z_order_compressed_image(std::uint32_t width, std::uint32_t height, const std::uint8_t *src, std::uint8_t *dest, const std::uint8_t bc_type);
 
+/**
+ * \brief Compresses a linear RGBA texture to BC3 (DXT5).
+ *
+ * \param dest      Pointer to the blocks, must be able to hold get_compressed_size(UBC3, width, height) bytes.
+ * \param src       Pointer to the RGBA texels, with each channel being 8 bits.
+ * \param width     Texture width.
+ * \param height    Texture height.
+ */
+/**
+ * \brief Compresses a linear RGBA texture to BC1 (DXT1), without its alpha.
+ *
+ * \param dest      Pointer to the blocks, must be able to hold get_compressed_size(UBC1, width, height) bytes.
+ * \param src       Pointer to the RGBA texels, with each channel being 8 bits.
+ * \param width     Texture width.
+ * \param height    Texture height.
+ */
+void rgba_texture_to_bc1(std::uint8_t *dest, const std::uint8_t *src, std::uint32_t width, std::uint32_t height);
+
+void rgba_texture_to_bc3(std::uint8_t *dest, const std::uint8_t *src, std::uint32_t width, std::uint32_t height);
+
+// the BC format a transcoded PVRTC texture is compressed to, BC1 when its alpha is not used and BC3 otherwise
+SceGxmTextureBaseFormat get_pvrtc_transcode_format(SceGxmTextureFormat format);
+
 void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
 void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
 
+// the mode used by this texture, only the swizzled PVRTC textures are decoded by the CPU path
+PvrtcUploadMode get_pvrtc_upload_mode(const TextureCacheState &cache, const SceGxmTexture &gxm_texture);
 uint16_t get_upload_mip(const uint16_t true_mip, const uint16_t width, const uint16_t height, const SceGxmTextureBaseFormat base_format);
 
 void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem);
 void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_texture, MemState &mem);
+// Evict the least recently used textures not bound since keep_since until size bytes are released, return the number of bytes released
+// the cache must have an evict_texture_callback
+size_t evict_textures(TextureCacheState &cache, uint64_t keep_since, size_t size);
+// Set the number of entries and the bytes of texture data cached, 0 for the maximum capacity or no byte limit
+void set_cache_limits(TextureCacheState &cache, size_t capacity, size_t byte_budget);
+// Called by each new frame, publish the counters of the frame in the renderer state and reset them
+void publish_frame_stats(TextureCacheState &cache, State &state);
+// Decode the textures on worker threads, the backend must then call flush_pending_texture_uploads before each draw
+void init_async_texture_decode(TextureCacheState &cache, const bool draw_previous_contents);
+// Upload the textures which are decoded, waiting for the ones the next draw depends on (or all of them with wait_all)
+void flush_pending_texture_uploads(TextureCacheState &cache, const bool wait_all = false);
 size_t bits_per_pixel(SceGxmTextureBaseFormat base_format);
 bool is_compressed_format(SceGxmTextureBaseFormat base_format);
 bool can_texture_be_unswizzled_without_decode(SceGxmTextureBaseFormat fmt, bool is_vulkan);
 size_t get_compressed_size(SceGxmTextureBaseFormat base_format, std::uint32_t width, std::uint32_t height);
+// Size in bytes of a region given to the upload callback
+size_t get_upload_size(SceGxmTextureBaseFormat base_format, std::uint32_t width, std::uint32_t height, bool is_compressed, size_t pixels_per_stride);
 TextureCacheHash hash_texture_data(const SceGxmTexture &texture, const MemState &mem);
 size_t texture_size(const SceGxmTexture &texture);
 bool convert_base_texture_format_to_base_color_format(SceGxmTextureBaseFormat format, SceGxmColorBaseFormat &color_format);
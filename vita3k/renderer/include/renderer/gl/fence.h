@@ -32,6 +32,10 @@ public:
 
     void insert();
     bool wait_for_signal();
+    // check without waiting if the GPU has reached the fence
+    bool is_signaled();
+    // drop the fence without waiting for it
+    void reset();
 
     bool empty() const {
         return !sync_;
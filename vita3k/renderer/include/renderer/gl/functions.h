@@ -21,6 +21,7 @@
 #include <crypto/hash.h>
 #include <glutil/object.h>
 #include <gxm/types.h>
+#include <util/fs.h>
 
 #include <renderer/gl/state.h>
 #include <renderer/gl/types.h>
@@ -36,11 +37,16 @@ struct FeatureState;
 namespace renderer::gl {
 
 // Compile program.
-SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmRecordState &state, const FeatureState &features, const MemState &mem, bool shader_cache, bool spirv, bool maskupdate, const char *base_path, const char *title_id, const char *self_name);
-void pre_compile_program(GLState &renderer, const char *base_path, const char *title_id, const char *self_name, const ShadersHash &hashs);
+SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmRecordState &state, const FeatureState &features, const MemState &mem, bool shader_cache, bool spirv, bool maskupdate);
+bool update_pre_compiled_programs(GLState &renderer);
+// the binaries made by another driver or for another shaders version are removed
+void open_program_binary_pack(GLState &renderer, const fs::path &shaders_path);
 
 // Uniforms.
 bool set_uniform_buffer(GLContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data);
+// Whether the staged uniform buffers must be uploaded before the next draw
+bool uniform_buffers_changed(const GLContext &context, const ShaderProgram &vertex_program, const ShaderProgram &fragment_program);
+bool upload_uniform_buffers(GLContext &context, const ShaderProgram &vertex_program, const ShaderProgram &fragment_program);
 
 bool create(SDL_Window *window, std::unique_ptr<renderer::State> &state, const char *base_path, const bool hashless_texture_cache);
 bool create(std::unique_ptr<Context> &context);
@@ -48,10 +54,16 @@ bool create(GLState &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRende
 bool create(std::unique_ptr<FragmentProgram> &fp, GLState &state, const SceGxmProgram &program, const SceGxmBlendInfo *blend);
 bool create(std::unique_ptr<VertexProgram> &vp, GLState &state, const SceGxmProgram &program);
 void set_context(GLState &state, GLContext &ctx, const MemState &mem, const GLRenderTarget *rt, const FeatureState &features);
+void new_frame(GLState &state, GLContext &context);
 void get_surface_data(GLState &renderer, GLContext &context, uint32_t *pixels, SceGxmColorSurface &surface);
 void lookup_and_get_surface_data(GLState &renderer, MemState &mem, SceGxmColorSurface &surface);
+// copy the surface to a pixel pack buffer, it is written to the guest memory by the readback thread once the copy is done
+// false if the surfaces can't be read back asynchronously
+bool request_surface_readback(GLState &renderer, GLContext &context, MemState &mem, SceGxmColorSurface &surface);
 void draw(GLState &renderer, GLContext &context, const FeatureState &features, SceGxmPrimitiveType type, SceGxmIndexFormat format,
     void *indices, size_t count, uint32_t instance_count, MemState &mem, const char *base_path, const char *title_id, const char *self_name, const Config &config);
+// Submit the draws batched since the last state change
+void flush_draw_batch(GLContext &context);
 
 // State
 void sync_viewport_flat(const GLState &state, GLContext &context);
@@ -72,9 +84,11 @@ void sync_depth_bias(const int factor, const int unit, const bool front);
 void sync_blending(const GxmRecordState &state, const MemState &mem);
 void sync_texture(GLState &state, GLContext &context, MemState &mem, std::size_t index, SceGxmTexture texture, const Config &config,
     const std::string &base_path, const std::string &title_id);
+bool can_reuse_vertex_streams(const GLContext &context, const GxmRecordState &state);
 void sync_vertex_streams_and_attributes(GLContext &context, GxmRecordState &state, const MemState &mem);
 void bind_fundamental(GLContext &context);
-void clear_previous_uniform_storage(GLContext &context);
+// Force the next draw to upload again its uniforms and vertex streams, after their ring buffers or bindings changed
+void invalidate_uploaded_data(GLContext &context);
 
 struct GLTextureCacheState;
 struct TextureCacheState;
@@ -89,7 +103,7 @@ namespace texture {
 void bind_texture(GLTextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem);
 void configure_bound_texture(const renderer::TextureCacheState &state, const SceGxmTexture &gxm_texture);
 void upload_bound_texture(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height,
-    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride);
+    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset);
 
 // Texture formats.
 const GLint *translate_swizzle(SceGxmTextureFormat fmt);
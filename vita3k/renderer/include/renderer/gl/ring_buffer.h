@@ -17,8 +17,9 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
-#include <glutil/object_array.h>
+#include <glutil/gl.h>
 #include <renderer/gl/fence.h>
 #include <tuple>
 
@@ -26,32 +27,58 @@ namespace renderer::gl {
 
 struct RingBuffer {
 private:
-    GLObjectArray<1> buffer_;
-    Fence safe_segment_consumed_fence_;
+    // the buffer is split in segments, each one has a fence inserted after the last draw using it
+    // so that only the segment about to be overwritten needs to be consumed by the GPU
+    static constexpr std::size_t SEGMENT_COUNT = 8;
+
+    GLuint buffer_;
+    std::array<Fence, SEGMENT_COUNT> segment_fences_;
 
     std::uint8_t *base_;
     std::size_t cursor_;
     std::size_t capacity_;
+    std::size_t segment_size_;
+    std::size_t current_segment_;
+    // bitmask of the segments left since the last draw call, their fence is inserted once this draw is done
+    std::uint32_t segments_to_fence_;
+
+    // the capacity is doubled at the next frame if a frame consumes more than half of it
+    std::size_t frame_consumption_;
+    std::size_t max_frame_consumption_;
+    std::size_t max_capacity_;
+
+    // number of times the render thread had to wait for the GPU to consume a segment
+    std::uint32_t stall_count_;
 
     GLenum purpose_;
 
     void create_and_map();
+    void destroy();
+    void enter_segment(const std::size_t segment);
 
 public:
-    explicit RingBuffer(GLenum purpose, const std::size_t capacity);
+    explicit RingBuffer(GLenum purpose, const std::size_t capacity, const std::size_t max_capacity = 0);
     ~RingBuffer();
 
     // Allocate new data from ring buffer, return offset of the data resided in the buffer
-    // In case the data is full, it will wait for fence to notify previous draw commands has finished on previous buffer part
-    // and then reset the cursor
+    // When the data reaches a new segment, it will wait for the fence of this segment to notify that the draw commands
+    // using its previous content have finished
     std::pair<std::uint8_t *, std::size_t> allocate(const std::size_t data_size);
 
-    // Notify the buffer that a draw call is done. This inserts a fence depends on the amount of data that has been consumed
-    // previously by push
+    // Notify the buffer that a draw call is done. This inserts a fence for each segment that has been left
+    // since the previous draw call
     void draw_call_done();
 
+    // Notify the buffer that a frame is done, the buffer is grown here if the frames use too much of it
+    // No allocation from the current buffer must be in use by a draw being recorded
+    void new_frame();
+
+    std::uint32_t stall_count() const {
+        return stall_count_;
+    }
+
     GLint handle() const {
-        return buffer_[0];
+        return buffer_;
     }
 };
 
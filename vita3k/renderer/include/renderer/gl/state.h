@@ -25,13 +25,20 @@
 
 #include "types.h"
 #include <features/state.h>
+#include <threads/queue.h>
 
 #include <SDL.h>
 
+#include <array>
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+struct MemState;
+
 namespace renderer::gl {
 struct GLState : public renderer::State {
     GLContextPtr context;
@@ -39,12 +46,33 @@ struct GLState : public renderer::State {
     ShaderCache fragment_shader_cache;
     ShaderCache vertex_shader_cache;
     ProgramCache program_cache;
+    // programs of the shaders cache waiting to be compiled, then being compiled
+    std::deque<ShadersHash> precompile_queue;
+    std::vector<PrecompilingProgram> precompiling_programs;
+    // linked programs given back by the driver, so the shaders cache doesn't have to be compiled again on the next boots
+    std::shared_ptr<ShaderPack> program_binary_pack;
+    // vendor, renderer and version of the driver, empty if it can't give the program binaries
+    std::string driver_id;
 
     GLTextureCacheState texture_cache;
     GLSurfaceCache surface_cache;
 
     ScreenRenderer screen_renderer;
 
+    // the synced color surfaces are copied in turn to these buffers, a scene only waits for a readback
+    // if it is still not written once all the buffers are used
+    static constexpr uint32_t SURFACE_READBACK_SLOTS = 4;
+    std::array<SurfaceReadbackSlot, SURFACE_READBACK_SLOTS> readback_slots;
+    uint32_t next_readback_slot = 0;
+    // context sharing its objects with the main one, the readback thread waits for the fences of the copies with it
+    // the surfaces are read synchronously if it couldn't be created
+    GLContextPtr readback_context;
+    SDL_Window *window = nullptr;
+    Queue<SurfaceReadbackPtr> readback_queue;
+    std::thread readback_thread;
+
+    void readback_thread_function(MemState &mem);
+
     bool init(const char *base_path, const bool hashless_texture_cache) override;
     void render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
         const GxmState &gxm, MemState &mem) override;
@@ -54,6 +82,7 @@ struct GLState : public renderer::State {
     void set_anisotropic_filtering(int anisotropic_filtering) override;
 
     void precompile_shader(const ShadersHash &hash) override;
+    bool update_precompiled_shaders() override;
     void preclose_action() override;
 };
 
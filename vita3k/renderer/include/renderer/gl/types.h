@@ -23,11 +23,14 @@
 #include <renderer/types.h>
 
 #include <renderer/gl/ring_buffer.h>
+#include <renderer/surface_readback.h>
 #include <renderer/texture_cache_state.h>
 #include <shader/usse_program_analyzer.h>
 
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <tuple>
 #include <vector>
@@ -59,6 +62,54 @@ struct GLTextureCacheState : public renderer::TextureCacheState {
 
 struct GLRenderTarget;
 
+// layout of the commands read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// Consecutive draws using the same program, state, uniforms and vertex streams, submitted together once a
+// command which can change them is processed
+struct DrawBatch {
+    GLuint program = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLenum index_type = GL_UNSIGNED_SHORT;
+    // size of the indices uploaded for the batch, kept small enough to never wrap around the index ring buffer
+    std::size_t index_bytes = 0;
+    std::vector<DrawElementsIndirectCommand> commands;
+};
+
+// Program of the shaders cache compiled at boot, its status is only checked once the driver is done with it
+struct PrecompilingProgram {
+    ProgramHashes hashes;
+    SharedGLObject frag_shader;
+    SharedGLObject vert_shader;
+    SharedGLObject program;
+};
+
+// color surface copied to a pixel pack buffer at the end of its scene, the readback thread writes it to the guest memory
+// once the fence of the copy is signaled
+struct SurfaceReadback : public renderer::SurfaceReadbackSync {
+    SceGxmColorSurface surface;
+    // size of the copy, upscaled by the resolution multiplier
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *data;
+    GLsync fence;
+};
+typedef std::shared_ptr<SurfaceReadback> SurfaceReadbackPtr;
+
+// pixel pack buffer mapped persistently, used again once its last readback is written
+struct SurfaceReadbackSlot {
+    GLuint buffer = 0;
+    uint8_t *mapped_data = nullptr;
+    size_t capacity = 0;
+    SurfaceReadbackPtr readback;
+};
+
 struct GLContext : public renderer::Context {
     GLObjectArray<1> vertex_array;
 
@@ -68,6 +119,7 @@ struct GLContext : public renderer::Context {
     RingBuffer fragment_uniform_stream_ring_buffer;
     RingBuffer vertex_info_uniform_buffer;
     RingBuffer fragment_info_uniform_buffer;
+    RingBuffer draw_indirect_buffer;
 
     const GLRenderTarget *render_target;
 
@@ -77,11 +129,24 @@ struct GLContext : public renderer::Context {
     GLuint current_color_attachment{ 0 };
     GLuint current_framebuffer_height{ 0 };
 
-    std::pair<std::uint8_t *, std::size_t> vertex_uniform_buffer_storage_ptr{ nullptr, 0 };
-    std::pair<std::uint8_t *, std::size_t> fragment_uniform_buffer_storage_ptr{ nullptr, 0 };
+    // The uniform buffers are staged here and only uploaded to their ring buffer by a draw if they changed
+    std::vector<std::uint8_t> vertex_uniform_staging;
+    std::vector<std::uint8_t> fragment_uniform_staging;
+    std::size_t vertex_uniform_uploaded_size = 0;
+    std::size_t fragment_uniform_uploaded_size = 0;
+    bool vertex_uniforms_dirty = true;
+    bool fragment_uniforms_dirty = true;
 
     shader::RenderVertUniformBlock previous_vert_info;
     shader::RenderFragUniformBlock previous_frag_info;
+    bool render_info_dirty = true;
+
+    // Vertex streams uploaded by the last draw, reused by the next one if it uses the same streams and vertex program
+    std::array<GXMStreamInfo, SCE_GXM_MAX_VERTEX_STREAMS> uploaded_vertex_streams;
+    Address uploaded_vertex_streams_program = 0;
+    bool uploaded_vertex_streams_valid = false;
+
+    DrawBatch draw_batch;
 
     shader::RenderVertUniformBlock current_vert_render_info;
     shader::RenderFragUniformBlock current_frag_render_info;
@@ -29,6 +29,10 @@
 #include <memory>
 #include <mutex>
 
+namespace gxp {
+struct ProgramInfo;
+} // namespace gxp
+
 namespace renderer {
 struct FragmentProgram;
 struct VertexProgram;
@@ -236,7 +240,10 @@ struct SceGxmFragmentProgram {
     size_t reference_count = 1;
     Ptr<const SceGxmProgram> program;
     bool is_maskupdate;
-    std::unique_ptr<renderer::FragmentProgram> renderer_data;
+    // shared by the fragment programs with the same GXP and blending, of all the shader patchers
+    std::shared_ptr<renderer::FragmentProgram> renderer_data;
+    // hash of the key of the program in the cache of the shader patcher
+    uint64_t key_hash = 0;
 };
 
 struct SceGxmNotification {
@@ -247,6 +254,7 @@ struct SceGxmNotification {
 struct SceGxmRegisteredProgram {
     // TODO This is an opaque type.
     Ptr<const SceGxmProgram> program;
+    std::shared_ptr<const gxp::ProgramInfo> info;
 };
 
 typedef Ptr<SceGxmRegisteredProgram> SceGxmShaderPatcherId;
@@ -283,7 +291,8 @@ struct SceGxmVertexProgram {
     Ptr<const SceGxmProgram> program;
     std::vector<SceGxmVertexStream> streams;
     std::vector<SceGxmVertexAttribute> attributes;
-    std::unique_ptr<renderer::VertexProgram> renderer_data;
+    // shared by the vertex programs with the same GXP, of all the shader patchers
+    std::shared_ptr<renderer::VertexProgram> renderer_data;
     uint64_t key_hash;
 };
 
@@ -19,8 +19,8 @@
 
 #ifdef TRACY_ENABLE
 
-#include "public/tracy/Tracy.hpp"
-#define R_PROFILE(name) ZoneNamedNC(___tracy_scoped_zone, name, 0x0055FF, false);
+#include <util/tracy_zones.h>
+#define R_PROFILE(name) TRACY_ZONE_C(RENDERER, name, 0x0055FF);
 
 #else
 
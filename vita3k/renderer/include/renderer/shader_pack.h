@@ -0,0 +1,94 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace renderer {
+
+class SharedShaderCache;
+
+// Single file holding the generated shaders of a title, keyed by the name their file had in the per-file cache.
+// The records are appended to the file followed by a sorted index of all of them, so only the index has to be read
+// at boot and the shaders are read from the mapping of the file.
+class ShaderPack {
+public:
+    explicit ShaderPack(const fs::path &path);
+    ~ShaderPack();
+
+    ShaderPack(const ShaderPack &) = delete;
+    ShaderPack &operator=(const ShaderPack &) = delete;
+
+    // return an empty span if the shader is not in the pack, the data stays valid as long as the pack exists
+    std::span<const uint8_t> read(const std::string &name);
+    // the shaders are written to the file by batches, can be called from any thread
+    void store(const std::string &name, const void *data, size_t size);
+    // write the shaders stored since the last flush followed by a new index
+    void flush();
+    // the shaders missing from the pack are then looked for in the shared cache, and the ones generated are added to it
+    void set_shared_cache(std::shared_ptr<SharedShaderCache> cache, const std::string &directory);
+
+private:
+    struct IndexEntry {
+        uint64_t name_hash;
+        uint64_t offset;
+    };
+
+    bool map_file();
+    void unmap_file();
+    bool read_index();
+    void scan_records();
+    void compact();
+    std::span<const uint8_t> read_record(uint64_t offset, const std::string &name) const;
+    void flush_locked();
+
+    fs::path path;
+
+    // mapping of the file as it was when it was opened, never modified afterward
+    const uint8_t *mapped_data = nullptr;
+    uint64_t mapped_size = 0;
+#ifdef WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#endif
+    // sorted by name hash, the offsets after the mapping are the records stored during this session
+    std::vector<IndexEntry> index;
+    // size of the records referenced by the index, the rest of the file is made of old indexes and replaced records
+    uint64_t live_size = 0;
+
+    std::mutex mutex;
+    fs::ofstream file;
+    uint64_t file_size = 0;
+    // shaders stored during this session, which are not part of the mapping
+    std::unordered_map<std::string, std::vector<uint8_t>> stored;
+    std::vector<const std::string *> pending;
+    bool index_dirty = false;
+
+    std::shared_ptr<SharedShaderCache> shared_cache;
+    std::string shared_directory;
+};
+
+} // namespace renderer
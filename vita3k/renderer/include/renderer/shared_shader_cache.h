@@ -0,0 +1,54 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <threads/job_pool.h>
+#include <util/fs.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FeatureState;
+
+namespace renderer {
+
+// Generated shaders and pipeline caches shared by several machines through a directory, like a network share.
+// The entries are files named after their content, so they never have to be replaced. They are written by a
+// worker thread to a temporary file which is then renamed, the other machines never read an incomplete one.
+class SharedShaderCache {
+public:
+    explicit SharedShaderCache(const fs::path &root);
+
+    SharedShaderCache(const SharedShaderCache &) = delete;
+    SharedShaderCache &operator=(const SharedShaderCache &) = delete;
+
+    // return an empty vector if the entry is not in the shared directory
+    std::vector<uint8_t> read(const fs::path &name) const;
+    // the data is copied and written in the background, an entry already in the directory is left as it is unless replace is set
+    void write(const fs::path &name, const void *data, size_t size, bool replace = false);
+
+private:
+    fs::path root;
+    JobPool writer{ 1 };
+};
+
+// directory of the generated shaders in the shared cache, the shaders only match the ones of a renderer with the same features
+std::string get_shared_shaders_dir(const char *backend_name, const FeatureState &features);
+
+} // namespace renderer
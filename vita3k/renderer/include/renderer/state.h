@@ -18,19 +18,30 @@
 #pragma once
 
 #include <features/state.h>
+#include <renderer/command_arena.h>
 #include <renderer/commands.h>
+#include <renderer/draw_profile.h>
+#include <renderer/frame_capture.h>
 #include <renderer/types.h>
-#include <threads/queue.h>
+#include <renderer/video_capture.h>
+#include <threads/job_pool.h>
+#include <threads/spsc_ring.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 
 struct SDL_Cursor;
 struct SDL_Window;
 struct DisplayState;
 struct GxmState;
+struct MemState;
 
 namespace renderer {
+class ShaderPack;
+class SharedShaderCache;
+
 struct State {
     const char *base_path;
     const char *title_id;
@@ -44,7 +55,9 @@ struct State {
     Context *context;
 
     GXPPtrMap gxp_ptr_map;
-    Queue<CommandList> command_buffer_queue;
+    ProgramRegistry program_registry;
+    SPSCRing<CommandList, 32> command_buffer_queue;
+    CommandArena command_arena;
     std::condition_variable command_finish_one;
     std::mutex command_finish_one_mutex;
 
@@ -53,13 +66,83 @@ struct State {
 
     std::vector<ShadersHash> shaders_cache_hashs;
     std::string shader_version;
+    // generated shaders of the current title, opened with the shaders cache hashs
+    std::shared_ptr<ShaderPack> shader_pack;
+    // shaders and pipeline caches shared with other machines, only exists when a shared shader cache path is set
+    std::shared_ptr<SharedShaderCache> shared_shader_cache;
+    // writes the shader dumps in the shaderlog folder, only exists when shader dumping is enabled
+    std::unique_ptr<JobPool> shader_dump_pool;
 
     int last_scene_id = 0;
 
     uint32_t shaders_count_compiled = 0;
+    // pipelines still compiled in the background, shown with the shaders compiled
+    uint32_t pipelines_count_pending = 0;
+    // pipelines compiled since the start, they can be compiled by other threads
+    std::atomic<uint32_t> pipelines_count_compiled = 0;
+    // pipelines whose key hash was already used by another one, shown in the performance overlay
+    uint32_t pipeline_key_collisions = 0;
+    // times the render thread waited for the GPU to consume a part of a ring buffer, shown in the performance overlay
+    uint32_t ring_buffer_stalls = 0;
+    // state set commands sent by the guest, and the ones dropped because they didn't change the state, shown in the performance overlay
+    std::atomic<uint32_t> state_set_commands_pushed = 0;
+    std::atomic<uint32_t> state_set_commands_filtered = 0;
     uint32_t programs_count_pre_compiled = 0;
 
+    // usage and budget of the GPU memory heaps holding the textures and surfaces, in bytes, only known by the Vulkan backend
+    // shown in the performance overlay with the memory of the textures, surfaces and staging buffers
+    std::atomic<uint64_t> gpu_memory_usage = 0;
+    std::atomic<uint64_t> gpu_memory_budget = 0;
+    std::atomic<uint64_t> gpu_memory_textures = 0;
+    std::atomic<uint64_t> gpu_memory_surfaces = 0;
+    std::atomic<uint64_t> gpu_memory_staging = 0;
+    // memory released by evicting textures and surfaces to stay under the budget, in bytes
+    std::atomic<uint64_t> gpu_memory_evicted = 0;
+    // part of the memory blocks not used by any allocation, in percent
+    std::atomic<uint32_t> gpu_memory_fragmentation = 0;
+
+    // texture cache lookups which found the texture in percent, bytes of texture data uploaded and textures evicted, during the last frame
+    std::atomic<uint32_t> texture_cache_hit_rate = 100;
+    std::atomic<uint64_t> texture_upload_bytes = 0;
+    std::atomic<uint32_t> texture_evictions = 0;
+    // samplers shared by the textures and the lookups of the sampler cache which found one in percent, only known by the Vulkan backend
+    std::atomic<uint32_t> sampler_count = 0;
+    std::atomic<uint32_t> sampler_cache_hit_rate = 100;
+
+    // set by the benchmark mode and the performance overlay, the GPU time of the scenes and of the presentation is then
+    // measured with timestamp queries if the backend supports it
+    std::atomic<bool> gpu_timing = false;
+    // GPU time of the scenes of the frames already done and count of these scenes, in nanoseconds
+    std::atomic<uint64_t> gpu_time_ns = 0;
+    std::atomic<uint64_t> gpu_scene_count = 0;
+    // GPU time during which at least one scene or a presentation was running, the overlapping scenes of a frame are counted once
+    std::atomic<uint64_t> gpu_busy_ns = 0;
+    // GPU time of the presentation of the frames already displayed (screen filter and GUI), in nanoseconds
+    std::atomic<uint64_t> gpu_present_time_ns = 0;
+
+    // CPU time of the render thread by phase of the draws, measured while gpu_timing is set
+    DrawProfile draw_profile;
+
+    // screenshots and video recording of the presented images, only supported by the Vulkan backend
+    std::unique_ptr<VideoCapture> video_capture;
+
+    // armed by --capture-frame, records the commands of a frame for the offline replay and is reset once it is written
+    std::unique_ptr<FrameCapture> frame_capture;
+
+    // frame skip: frames queued by the guest and processed by the renderer, the scenes of a frame are dropped when
+    // the guest had already queued the next one once the renderer gets to it
+    std::atomic<uint64_t> frames_queued = 0;
+    uint64_t frames_processed = 0;
+    bool is_skipping_frame = false;
+    uint32_t frames_skipped_in_row = 0;
+    std::atomic<uint32_t> frames_skipped = 0;
+    // color surfaces written by the dropped scenes and not drawn since, they are not presented
+    std::vector<Address> skipped_surfaces;
+
     bool should_display;
+    // steady clock time (in microseconds) at which a frame was last displayed by the host, 0 if it is unknown
+    // the vblank thread aligns the guest vblanks with it
+    std::atomic<int64_t> host_vblank_time_us = 0;
 
     virtual bool init(const char *base_path, const bool hashless_texture_cache) = 0;
     virtual void render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
@@ -69,15 +152,26 @@ struct State {
     virtual void set_fxaa(bool enable_fxaa) = 0;
     virtual int get_max_anisotropic_filtering() = 0;
     virtual void set_anisotropic_filtering(int anisotropic_filtering) = 0;
-    virtual bool map_memory(void *address, uint32_t size) {
+    virtual bool map_memory(MemState &mem, Ptr<void> address, uint32_t size) {
         return true;
     }
-    virtual void unmap_memory(void *address) {}
+    virtual void unmap_memory(MemState &mem, Ptr<void> address) {}
     virtual std::vector<std::string> get_gpu_list() {
         return { "Automatic" };
     }
+    // true if the GPU times are updated when gpu_timing is set
+    virtual bool supports_gpu_timing() const {
+        return false;
+    }
 
+    // start compiling a program of the shaders cache, it can be finished later or by other threads
     virtual void precompile_shader(const ShadersHash &hash) = 0;
+    // called each frame while the shaders cache is compiled, update programs_count_pre_compiled and return true once all the programs are done
+    virtual bool update_precompiled_shaders() {
+        return true;
+    }
+    // compile in the background the pipelines used by the previous sessions, once the shaders are precompiled
+    virtual void prewarm_pipelines() {}
     virtual void preclose_action() = 0;
 
     virtual ~State() = default;
@@ -0,0 +1,51 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/util.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace renderer {
+
+// Guest memory a color surface is copied back to once the GPU is done with it, shared by the backends.
+// The range is protected until the copy is written, a guest access in the meantime waits for it
+// after the protection locks are released, so the faults on the other pages are not held up.
+struct SurfaceReadbackSync {
+    Address address = 0;
+    uint32_t size = 0;
+
+    ProtectBlockPtr protect_block;
+    std::mutex mutex;
+    std::condition_variable done_condv;
+    bool done = false;
+
+    void wait();
+};
+
+// protect the range of the readback until it is written
+void protect_surface_readback(MemState &mem, const std::shared_ptr<SurfaceReadbackSync> &readback);
+// drop the protection of the readback, let the other blocks of the range see a write, write the range
+// through its host pointer and wake up the threads waiting for it
+void write_surface_readback(MemState &mem, SurfaceReadbackSync &readback, const std::function<void(uint8_t *)> &write);
+
+} // namespace renderer
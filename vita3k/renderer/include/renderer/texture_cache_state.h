@@ -20,15 +20,24 @@
 #include <glutil/object_array.h>
 
 #include <gxm/types.h>
+#include <threads/job_pool.h>
 
 #include <array>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
 
 struct MemState;
 
 namespace renderer {
-static constexpr size_t TextureCacheSize = 1024;
+// Maximum number of cached textures, the capacity of the cache can be lowered in the config
+static constexpr size_t TextureCacheSize = 4096;
+// Open addressing table from the texture control words to their cache entry, kept half empty for short probes
+static constexpr size_t TextureCacheLookupSize = TextureCacheSize * 2;
+static constexpr uint16_t TextureCacheNone = UINT16_MAX;
+// Granularity of the dirty tracking of the textures which can be re-uploaded partially
+static constexpr size_t TextureCachePageSize = 4096;
 typedef uint64_t TextureCacheTimestamp;
 typedef uint32_t TextureCacheHash;
 enum class Backend : uint32_t;
@@ -37,7 +46,11 @@ struct TextureCacheInfo {
     bool use_hash = false;
     bool dirty = false;
     TextureCacheHash hash = 0;
+    // hash of each page of the texture data, only used by the textures which can be re-uploaded partially
+    std::vector<TextureCacheHash> page_hashes;
     uint64_t timestamp = 0;
+    // bytes of texture data, weight of the entry when choosing the one to evict
+    uint32_t size = 0;
     SceGxmTexture texture;
 
     explicit TextureCacheInfo(SceGxmTexture texture)
@@ -46,24 +59,102 @@ struct TextureCacheInfo {
     TextureCacheInfo() = default;
 };
 
+// Upload of a texture done by a worker thread, replayed with the upload callback once done
+struct DecodedTextureRegion {
+    SceGxmTextureBaseFormat base_format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_index;
+    int face;
+    bool is_compressed;
+    size_t pixels_per_stride;
+    size_t offset;
+};
+
+struct DecodedTexture {
+    std::vector<uint8_t> data;
+    std::vector<DecodedTextureRegion> regions;
+};
+
+struct PendingTextureUpload {
+    size_t index;
+    SceGxmTexture texture;
+    // the next draw must wait for the upload, otherwise it is drawn with the previous content of the texture
+    bool wait_for_draw;
+    std::shared_ptr<DecodedTexture> decoded;
+    JobPtr job;
+};
+
+// How the PVRTC textures are given to the backend
+enum class PvrtcUploadMode : uint8_t {
+    // decoded to rgba8 on the CPU
+    Decode,
+    // uploaded as they are, the GPU can sample them
+    Native,
+    // decoded then compressed to BC1 (8 times less memory than rgba8) when the alpha is not used, or BC3 (4 times less)
+    TranscodeBC,
+};
+
+// Counted by cache_and_bind_texture during a frame, published in the renderer state by each new frame
+struct TextureCacheStats {
+    uint32_t lookups = 0;
+    uint32_t hits = 0;
+    uint64_t upload_bytes = 0;
+    uint32_t evictions = 0;
+};
+
+class DrawProfile;
 struct TextureCacheState;
+class TextureDiskCache;
 
 typedef std::array<TextureCacheInfo, TextureCacheSize> TextureCacheInfoes;
 typedef std::function<void(std::size_t, const void *)> TextureCacheStateSelectCallback;
 typedef std::function<void(TextureCacheState &, const void *)> TextureCacheStateConfigureTextureCallback;
-typedef std::function<void(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride)> TextureCacheStateUploadTextureCallback;
+typedef std::function<void(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset)> TextureCacheStateUploadTextureCallback;
 typedef std::function<void()> TextureCacheStateUploadDoneCallback;
+typedef std::function<bool(const SceGxmTexture &, const MemState &)> TextureCacheStateDecodeTextureCallback;
+typedef std::function<size_t(std::size_t)> TextureCacheStateEvictTextureCallback;
 
 struct TextureCacheState {
     Backend *backend;
+    // the time spent hashing, decoding and uploading the textures is added to it
+    DrawProfile *draw_profile = nullptr;
     bool use_protect = false;
+    PvrtcUploadMode pvrtc_upload_mode = PvrtcUploadMode::Decode;
     int anisotropic_filtering = 1;
     size_t used = 0;
+    // number of entries used before evicting, at most TextureCacheSize
+    size_t capacity = TextureCacheSize;
+    // bytes of texture data cached before evicting, 0 for no limit
+    size_t byte_budget = 0;
+    size_t used_bytes = 0;
+    TextureCacheStats frame_stats;
     TextureCacheTimestamp timestamp = 1;
     TextureCacheInfoes infoes;
+    // index + 1 of the entry of each slot, 0 for an empty slot
+    std::array<uint16_t, TextureCacheLookupSize> lookup{};
+    // doubly linked list of the used entries, from the least to the most recently used
+    std::array<uint16_t, TextureCacheSize> lru_prev;
+    std::array<uint16_t, TextureCacheSize> lru_next;
+    uint16_t lru_oldest = TextureCacheNone;
+    uint16_t lru_newest = TextureCacheNone;
+    // entries whose texture was evicted to lower the memory usage, they are reused before the least recently used one
+    std::vector<uint16_t> free_indices;
+    // swapped with the page hashes of an entry, to avoid allocating them on every bind
+    std::vector<TextureCacheHash> page_hashes;
+    // only set if the textures are decoded by worker threads, the uploads are then done by flush_pending_texture_uploads
+    std::unique_ptr<JobPool> decode_pool;
+    bool draw_previous_contents = false;
+    std::vector<PendingTextureUpload> pending_uploads;
+    // only set if the decoded textures are kept on disk between sessions, shared with the decode jobs which store in it
+    std::shared_ptr<TextureDiskCache> disk_cache;
     TextureCacheStateSelectCallback select_callback;
     TextureCacheStateConfigureTextureCallback configure_texture_callback;
     TextureCacheStateUploadTextureCallback upload_texture_callback;
     TextureCacheStateUploadDoneCallback upload_done_callback;
+    // optional, decode and upload the whole texture on the GPU, return false if it must be done on the CPU instead
+    TextureCacheStateDecodeTextureCallback decode_texture_callback;
+    // optional, release the backend texture of an entry evicted by evict_textures and return the number of bytes released
+    TextureCacheStateEvictTextureCallback evict_texture_callback;
 };
 } // namespace renderer
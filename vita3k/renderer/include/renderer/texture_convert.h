@@ -0,0 +1,51 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The hot texture converters have SIMD implementations, the one used is picked at runtime
+// according to what the host supports. The basic implementations are the scalar references.
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXTURE_CONVERT_X86
+// msvc allows to use any intrinsic independently of the architecture flags, other compilers need the target attribute
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TEXTURE_CONVERT_TARGET(isa)
+#else
+#define TEXTURE_CONVERT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TEXTURE_CONVERT_NEON
+#endif
+
+namespace renderer::texture {
+
+// name of the instruction set used by the converters, for the logs and the benchmark
+const char *get_texture_convert_isa();
+
+void swizzled_texture_to_linear_texture_basic(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
+void tiled_texture_to_linear_texture_basic(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel);
+void palette_texture_to_rgba_4_basic(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
+void palette_texture_to_rgba_8_basic(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
+void rgb_texture_to_rgba_basic(uint8_t *dst, const uint8_t *src, size_t pixel_count);
+
+// add an opaque alpha channel to u8u8u8 pixels
+void rgb_texture_to_rgba(uint8_t *dst, const uint8_t *src, size_t pixel_count);
+
+} // namespace renderer::texture
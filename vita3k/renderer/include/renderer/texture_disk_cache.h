@@ -0,0 +1,72 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <renderer/texture_cache_state.h>
+
+#include <util/fs.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace renderer {
+
+// Don't let the pack file of a title grow above this size
+static constexpr uint64_t TextureDiskCacheMaxSize = 1ULL << 30;
+
+// Pack file with the decoded textures of a title, keyed by a hash of their content and their control words.
+// The records written by the previous sessions are mapped in memory and uploaded from there, the new ones are appended to the file.
+class TextureDiskCache {
+public:
+    explicit TextureDiskCache(const fs::path &path);
+    ~TextureDiskCache();
+
+    TextureDiskCache(const TextureDiskCache &) = delete;
+    TextureDiskCache &operator=(const TextureDiskCache &) = delete;
+
+    // give the regions of the texture to the upload callback, return false if it is not in the pack file
+    bool upload(uint64_t key, const TextureCacheStateUploadTextureCallback &upload) const;
+    // append the texture to the pack file, can be called from any thread
+    void store(uint64_t key, const DecodedTexture &decoded);
+
+private:
+    void map_file();
+    void unmap_file();
+
+    fs::path path;
+
+    // mapping of the file as it was when it was opened, never modified afterward
+    const uint8_t *mapped_data = nullptr;
+    uint64_t mapped_size = 0;
+#ifdef WIN32
+    void *file_handle = nullptr;
+    void *mapping_handle = nullptr;
+#endif
+    // offset of the record of each texture in the mapping
+    std::unordered_map<uint64_t, uint64_t> records;
+
+    std::mutex store_mutex;
+    fs::ofstream file;
+    uint64_t file_size = 0;
+    // textures stored during this session, which are not part of the mapping
+    std::unordered_set<uint64_t> stored_keys;
+};
+
+} // namespace renderer
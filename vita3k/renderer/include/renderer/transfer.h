@@ -0,0 +1,47 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <gxm/types.h>
+
+#include <cstdint>
+
+// The GXM transfers done by the CPU, on the rectangles of the guest surfaces.
+// The basic implementations are the scalar references of the row-major, SIMD ones.
+// The strides are in bytes and can be negative to go up the surface.
+namespace renderer::transfer {
+
+void copy_basic(uint8_t *dst, int32_t dst_stride, uint32_t dst_bytes_per_pixel, const uint8_t *src, int32_t src_stride, uint32_t src_bytes_per_pixel,
+    uint32_t width, uint32_t height, SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask);
+void fill_basic(uint8_t *dst, int32_t stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height, uint32_t color);
+// 2x2 box filter of surfaces whose channels are all 8 bits, width and height are the ones of the destination
+void downscale_basic(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height);
+
+// copy the rectangle, only the source pixels matching the color key mode are written
+// the pixels are copied with memcpy per row when there is no color key and they have the same size
+void copy(uint8_t *dst, int32_t dst_stride, uint32_t dst_bytes_per_pixel, const uint8_t *src, int32_t src_stride, uint32_t src_bytes_per_pixel,
+    uint32_t width, uint32_t height, SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask);
+// fill the rectangle with the first bytes of the color, pixels larger than 4 bytes have their other bytes set to 0
+void fill(uint8_t *dst, int32_t stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height, uint32_t color);
+void downscale(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height);
+
+// true if the downscale of this format can average the bytes of the pixels, the other formats are point sampled
+bool can_box_filter(SceGxmTransferFormat format);
+
+} // namespace renderer::transfer
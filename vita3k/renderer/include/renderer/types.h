@@ -30,6 +30,8 @@
 #include <bit>
 #include <bitset>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <tuple>
@@ -83,6 +85,7 @@ enum class GXMState : std::uint16_t {
     TotalState
 };
 
+class CommandArena;
 struct RenderTarget;
 
 struct GXMStreamInfo {
@@ -166,8 +169,10 @@ struct Context {
     GxmRecordState record;
 
     CommandList command_list;
+    // Commands of the immediate context are allocated from the arena of the renderer,
+    // the ones of deferred contexts with alloc_func
+    CommandArena *command_arena = nullptr;
     CommandAllocFunc alloc_func;
-    CommandFreeFunc free_func;
 
     int render_finish_status = 0;
     int notification_finish_status = 0;
@@ -195,6 +200,8 @@ struct ShaderProgram {
 };
 
 struct FragmentProgram : ShaderProgram {
+    // blending the program was created with, kept for the frame capture
+    std::optional<SceGxmBlendInfo> blend;
 };
 
 struct VertexProgram : ShaderProgram {
@@ -203,6 +210,15 @@ struct VertexProgram : ShaderProgram {
     bool stripped_symbols_checked;
 };
 
+// program objects already created, the guest programs with the same GXP (and blending for the fragment ones) share them
+// even across shader patchers, they are kept by the registry as the guest programs are freed without being destroyed
+struct ProgramRegistry {
+    std::mutex mutex;
+    // the second part of the key is the blending, 0 if there is none
+    std::map<std::pair<Sha256Hash, uint64_t>, std::shared_ptr<FragmentProgram>> fragment_programs;
+    std::map<Sha256Hash, std::shared_ptr<VertexProgram>> vertex_programs;
+};
+
 struct ShadersHash {
     Sha256Hash frag;
     Sha256Hash vert;
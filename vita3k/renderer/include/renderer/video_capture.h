@@ -0,0 +1,130 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+struct SwsContext;
+
+namespace renderer {
+
+// Copy of a presented image, mapped in the host memory and read by the capture thread
+struct CaptureFrame {
+    const uint8_t *data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t pitch = 0;
+    bool bgra = false;
+    std::chrono::steady_clock::time_point time;
+    // called by the capture thread once it is done with the data
+    std::function<void()> release;
+};
+
+// Saves the presented images as screenshots and records them to a video.
+// The backend copies the presented image to a buffer and gives it to the capture thread once the GPU is done with the copy,
+// the capture thread converts and encodes it so the render thread never waits for the GPU or the encoder.
+class VideoCapture {
+public:
+    VideoCapture(const fs::path &output_path, const std::string &encoder, uint32_t bitrate_kbps, uint32_t fps);
+    ~VideoCapture();
+
+    VideoCapture(const VideoCapture &) = delete;
+    VideoCapture &operator=(const VideoCapture &) = delete;
+
+    // the next presented image is saved as a png
+    void request_screenshot();
+    void toggle_recording(const char *title_id);
+    bool is_recording() const {
+        return recording;
+    }
+    // true if the backend must copy the next presented image
+    bool wants_frame() const {
+        return recording || screenshot_requested;
+    }
+    // called by the render thread when it copies a frame, so a screenshot request is only given to one of them
+    bool take_screenshot_request() {
+        return screenshot_requested.exchange(false);
+    }
+
+    // called by the backend once the copy is done, the frame is then released by the capture thread
+    void submit_frame(CaptureFrame frame, bool screenshot);
+    // wait for the frames given to the capture thread to be released
+    void wait_idle();
+
+    // frames dropped because the backend had no free buffer or the capture thread was late
+    std::atomic<uint32_t> frames_dropped = 0;
+
+private:
+    struct QueuedFrame {
+        CaptureFrame frame;
+        bool screenshot;
+        bool record;
+    };
+
+    void thread_function();
+    void save_screenshot(const CaptureFrame &frame);
+    bool open_encoder(const CaptureFrame &frame);
+    void encode_frame(const CaptureFrame &frame);
+    void write_packets();
+    void close_encoder();
+
+    fs::path output_path;
+    std::string encoder_name;
+    uint32_t bitrate_kbps;
+    uint32_t fps;
+
+    std::atomic<bool> recording = false;
+    std::atomic<bool> screenshot_requested = false;
+    std::string title_id = "capture";
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable idle_cond;
+    std::deque<QueuedFrame> queue;
+    bool busy = false;
+    bool quit = false;
+    std::thread thread;
+
+    // only used by the capture thread
+    AVCodecContext *codec_context = nullptr;
+    AVFormatContext *format_context = nullptr;
+    AVStream *stream = nullptr;
+    AVFrame *yuv_frame = nullptr;
+    AVPacket *packet = nullptr;
+    SwsContext *sws_context = nullptr;
+    std::chrono::steady_clock::time_point start_time;
+    int64_t last_pts = -1;
+    bool encoder_failed = false;
+};
+
+} // namespace renderer
@@ -21,6 +21,7 @@
 
 struct Config;
 struct MemState;
+struct SceGxmTransferImage;
 
 namespace renderer::vulkan {
 
@@ -53,7 +54,15 @@ void sync_viewport_flat(VKContext &context);
 void sync_viewport_real(VKContext &context, const float xOffset, const float yOffset, const float zOffset,
     const float xScale, const float yScale, const float zScale);
 
+// do the transfer on the GPU if its source or destination is a cached color surface, return false if the CPU must do it instead
+// the guest memory of the destination is written once the GPU is done, the guest threads accessing it before wait for it
+bool transfer_copy(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest, SceGxmTransferColorKeyMode key_mode);
+bool transfer_downscale(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest);
+bool transfer_fill(VKContext &context, const SceGxmTransferImage &dest, uint32_t fill_color);
+
 void refresh_pipeline(VKContext &context);
+// for the state which is dynamic with extended dynamic state, refresh the pipeline otherwise
+void sync_extended_dynamic_state(VKContext &context);
 
 namespace texture {
 
@@ -62,9 +71,14 @@ bool init(VKTextureCacheState &cache, const bool hashless_texture_cache);
 void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gxm_texture);
 vk::Sampler create_sampler(VKState &state, const SceGxmTexture &gxm_texture, const uint16_t mip_count = 1);
 void upload_bound_texture(VKTextureCacheState &cache, SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height,
-    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride);
+    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset);
 void upload_done(VKTextureCacheState &cache);
 
+bool init_gpu_decode(VKTextureCacheState &cache, const char *base_path);
+bool can_texture_be_decoded_on_gpu(const VKTextureCacheState &cache, const SceGxmTexture &gxm_texture, const uint16_t mip_count);
+// decode the texture with the texture_decode compute shader, return false if it must be done on the CPU instead
+bool decode_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem);
+
 } // namespace texture
 
 } // namespace renderer::vulkan
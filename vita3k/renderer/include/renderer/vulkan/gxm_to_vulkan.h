@@ -27,6 +27,8 @@
 
 #include <util/log.h>
 
+struct GxmStencilStateOp;
+
 namespace renderer::vulkan {
 
 vk::Format translate_attribute_format(SceGxmAttributeFormat format, unsigned int component_count, bool is_integer, bool is_signed);
@@ -38,6 +40,7 @@ vk::PolygonMode translate_polygon_mode(SceGxmPolygonMode polygon_mode);
 vk::CullModeFlags translate_cull_mode(SceGxmCullMode cull_mode);
 vk::CompareOp translate_stencil_func(SceGxmStencilFunc stencil_func);
 vk::StencilOp translate_stencil_op(SceGxmStencilOp stencil_op);
+vk::StencilOpState translate_stencil_state(const GxmStencilStateOp &state);
 
 namespace color {
 vk::Format translate_format(SceGxmColorBaseFormat base_format);
@@ -0,0 +1,83 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <vkutil/objects.h>
+
+#include <array>
+
+namespace renderer::vulkan {
+struct VKState;
+
+// Kinds of GPU memory allocated from their own VMA pool, so their usage can be reported and kept under the budget
+enum class MemoryCategory : uint32_t {
+    Textures,
+    // color surfaces and their casted copies
+    Surfaces,
+    // depth-stencil surfaces and their sampled copies
+    DepthStencil,
+    // texture staging buffers
+    Staging,
+    Count
+};
+
+class MemoryBudget {
+private:
+    VKState &state;
+
+    static constexpr size_t CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::Count);
+    // textures and surfaces not used during this number of frames can be evicted when the budget is exceeded
+    static constexpr uint64_t EVICTION_AGE = 16;
+    // the staging buffers are compacted once every this number of frames
+    static constexpr uint64_t COMPACTION_PERIOD = 600;
+
+    std::array<vma::Pool, CATEGORY_COUNT> pools{};
+    // allocation infos using the pool of each category
+    std::array<vma::AllocationCreateInfo, CATEGORY_COUNT> alloc_infos{};
+    // device local heaps holding the pools, the budget is checked against their total
+    uint32_t local_heaps_mask = 0;
+
+    // texture cache timestamp and scene timestamp at the start of the last EVICTION_AGE frames
+    std::array<uint64_t, EVICTION_AGE> frame_texture_timestamps{};
+    std::array<uint64_t, EVICTION_AGE> frame_scene_timestamps{};
+    uint64_t last_eviction_frame = 0;
+
+    void create_pool(MemoryCategory category, uint32_t memory_type, const vma::AllocationCreateInfo &alloc_info);
+    // release the staging buffers unused since the last compaction
+    void compact(uint64_t frame_timestamp);
+
+public:
+    // VK_EXT_memory_budget is enabled, the budget and usage come from the driver instead of being estimated by vma
+    bool support_memory_budget = false;
+
+    explicit MemoryBudget(VKState &state);
+
+    // must be called once the texture cache is initialized, the staging pool depends on the GPU texture decoder
+    void init();
+    void cleanup();
+
+    const vma::AllocationCreateInfo &get_alloc_info(MemoryCategory category) const {
+        return alloc_infos[static_cast<size_t>(category)];
+    }
+
+    // called at the start of each frame, once the objects of the frame object were destroyed
+    // update the memory usage and evict the least recently used textures and surfaces if it is over the budget
+    void new_frame(uint64_t frame_timestamp, uint64_t scene_timestamp);
+};
+} // namespace renderer::vulkan
@@ -20,9 +20,14 @@
 #include <array>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include <threads/job_pool.h>
 #include <vkutil/objects.h>
 
 struct SceGxmProgram;
@@ -35,6 +40,52 @@ using Sha256Hash = std::array<uint8_t, 32>;
 namespace renderer::vulkan {
 struct VKState;
 struct VKContext;
+struct PipelineCompileInfo;
+
+// The part of a pipeline description with a fixed size, written as it is in the pipeline database
+struct PipelineStateDescription {
+    Sha256Hash vertex_hash;
+    Sha256Hash fragment_hash;
+    // the render pass is retrieved with them
+    vk::Format color_format;
+    uint32_t zls_control;
+    uint16_t vert_texture_count;
+    uint16_t frag_texture_count;
+    vk::PrimitiveTopology topology;
+    vk::PolygonMode polygon_mode;
+    vk::CullModeFlags cull_mode;
+    vk::Bool32 is_fragment_disabled;
+    vk::Bool32 depth_write;
+    vk::CompareOp depth_func;
+    vk::StencilOpState front_stencil;
+    vk::StencilOpState back_stencil;
+    vk::PipelineColorBlendAttachmentState blending;
+    uint32_t binding_count;
+    uint32_t attribute_count;
+};
+
+// Everything a pipeline is created from, saved for each new pipeline to create them again on the next boot
+struct PipelineDescription {
+    PipelineStateDescription state;
+    std::vector<vk::VertexInputBindingDescription> bindings;
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+};
+
+// Packed description of a pipeline, compared as a whole so two pipelines with the same hash are never mixed up
+struct PipelineKey {
+    uint64_t hash = 0;
+    std::vector<uint8_t> data;
+
+    bool operator==(const PipelineKey &other) const {
+        return hash == other.hash && data == other.data;
+    }
+};
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey &key) const {
+        return key.hash;
+    }
+};
 
 class PipelineCache {
 private:
@@ -49,13 +100,42 @@ private:
     // to update the disk-saved shader cache (in seconds)
     static constexpr int pipeline_cache_save_delay = 30;
 
+    // must be increased each time PipelineDescription changes
+    static constexpr uint32_t pipeline_database_version = 2;
+
     vk::PipelineCache pipeline_cache;
 
     // first index: 1 if depth-stencil is force loaded, 0 otherwise
     // second index: 1 if depth-stencil is force stored, 0 otherwise
     std::map<vk::Format, vk::RenderPass> render_passes[2][2];
     std::map<Sha256Hash, vk::ShaderModule> shaders;
-    std::unordered_map<uint64_t, vk::Pipeline> pipelines;
+    struct PrecompilingShader {
+        JobPtr job;
+        // null if the shader is not in the shaders cache
+        std::shared_ptr<vk::ShaderModule> shader;
+    };
+    // shaders loaded by the precompile pool, moved to shaders once done
+    std::map<Sha256Hash, PrecompilingShader> precompiling_shaders;
+    std::unordered_map<PipelineKey, vk::Pipeline, PipelineKeyHash> pipelines;
+    // hashes of the pipelines in the cache, only used to count the collisions
+    std::unordered_set<uint64_t> pipeline_hashes;
+    // reused by each lookup to avoid allocating its vectors
+    PipelineDescription lookup_description;
+    PipelineKey lookup_key;
+
+    struct PendingPipeline {
+        JobPtr job;
+        std::shared_ptr<PipelineCompileInfo> info;
+    };
+    // pipelines compiled by a worker thread, moved to pipelines once done
+    std::unordered_map<PipelineKey, PendingPipeline, PipelineKeyHash> pending_pipelines;
+
+    // only set if the GPU supports graphics pipeline libraries and they are enabled
+    bool use_pipeline_library = false;
+    // the parts of the pipelines, each one compiled once and linked into all the pipelines using it
+    // one map for each PipelineLibraryPart, they can be created by the worker threads so they are protected by a mutex
+    std::mutex libraries_mutex;
+    std::unordered_map<PipelineKey, vk::Pipeline, PipelineKeyHash> pipeline_libraries[4];
 
     // temp vars used to store the result computed by auxialiary functions before createPipeline is called
     std::vector<vk::VertexInputBindingDescription> binding_descr;
@@ -64,8 +144,20 @@ private:
     vk::PipelineShaderStageCreateInfo retrieve_shader(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, MemState &mem, const std::vector<SceGxmVertexAttribute> *hint_attributes);
     vk::PipelineLayout retrieve_pipeline_layout(const uint16_t vert_texture_count, const uint16_t frag_texture_count);
     vk::PipelineVertexInputStateCreateInfo get_vertex_input_state(MemState &mem);
+    std::shared_ptr<PipelineCompileInfo> get_compile_info(const PipelineDescription &description);
+    vk::Pipeline retrieve_pipeline_library(uint32_t part, const PipelineKey &key, const vk::GraphicsPipelineCreateInfo &library_info);
+    // can be called from any thread
+    vk::Pipeline compile_pipeline(PipelineCompileInfo &info);
+    void submit_pipeline(JobPool &pool, const PipelineDescription &description, const PipelineKey &key);
+    void collect_compiled_pipelines();
+    void save_pipeline_description(const PipelineDescription &description);
 
 public:
+    // does the GPU support VK_EXT_graphics_pipeline_library
+    bool support_pipeline_library = false;
+    // does the GPU support VK_EXT_extended_dynamic_state, the cull mode, depth and stencil ops are then not part of the pipelines
+    bool support_extended_dynamic_state = false;
+
     // if not 0, next time the pipeline cache should be saved (in seconds since epoch)
     uint64_t next_pipeline_cache_save = std::numeric_limits<uint64_t>::max();
 
@@ -79,6 +171,13 @@ public:
     // first index is vertex, second is fragment
     vk::PipelineLayout pipeline_layouts[17][17] = {};
 
+    // only set if the pipelines are compiled by worker threads, retrieve_pipeline then returns a null pipeline until it is ready
+    std::unique_ptr<JobPool> compile_pool;
+    // only used to compile the pipelines of the database when compile_pool is not set
+    std::unique_ptr<JobPool> prewarm_pool;
+    // loads the shaders of the shaders cache at boot on all the host threads, destroyed once they are loaded
+    std::unique_ptr<JobPool> precompile_pool;
+
     explicit PipelineCache(VKState &state);
     void init();
 
@@ -86,8 +185,18 @@ public:
     void save_pipeline_cache();
 
     vk::RenderPass retrieve_render_pass(vk::Format format, uint32_t zls_control);
+    // return a null pipeline if it is not compiled yet or failed to compile, the draw must then be skipped
     vk::Pipeline retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem);
 
     bool precompile_shader(const Sha256Hash &hash);
+    // load the shader from the shaders cache and create its module on the precompile pool
+    void precompile_shader_async(const Sha256Hash &hash);
+    // move the shaders loaded by the precompile pool to the cache
+    void collect_precompiled_shaders();
+    bool is_shader_precompiling(const Sha256Hash &hash) const {
+        return precompiling_shaders.contains(hash);
+    }
+    // compile on worker threads the pipelines saved by the previous sessions, their shaders must be in the shader cache
+    void prewarm_pipelines();
 };
 } // namespace renderer::vulkan
\ No newline at end of file
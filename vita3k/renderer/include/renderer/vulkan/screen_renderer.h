@@ -19,6 +19,11 @@
 
 #include <vkutil/objects.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+
 struct SDL_Window;
 struct SceFVector2;
 
@@ -45,6 +50,10 @@ public:
     std::vector<vk::Framebuffer> swapchain_framebuffers;
     std::vector<vk::CommandBuffer> command_buffers;
     std::vector<vk::Fence> fences;
+    // only created when the GPU time is measured, two timestamps for each image, written at the start and end of its command buffer
+    vk::QueryPool present_timestamp_pool;
+    // true if the timestamps of the image were written, they are read once its fence is waited for
+    std::vector<bool> present_timed;
 
     vk::ShaderModule shader_vertex;
     vk::ShaderModule shader_fragment;
@@ -58,6 +67,21 @@ public:
     vk::Pipeline pipeline;
     vk::Pipeline pipeline_fxaa;
 
+    // FSR 1.0 upscaling, the easu pass upscales the game surface to the viewport size then the rcas pass sharpens it
+    vk::ShaderModule shader_fsr_easu;
+    vk::ShaderModule shader_fsr_rcas;
+    vk::DescriptorSetLayout fsr_set_layout;
+    vk::DescriptorPool fsr_descriptor_pool;
+    // the input of the easu pass changes every frame, so there is one set for each swapchain image
+    std::vector<vk::DescriptorSet> fsr_easu_sets;
+    vk::DescriptorSet fsr_rcas_set;
+    vk::PipelineLayout fsr_pipeline_layout;
+    vk::Pipeline fsr_easu_pipeline;
+    vk::Pipeline fsr_rcas_pipeline;
+    // both have the size of the viewport and are re-created with the swapchain
+    vkutil::Image fsr_upscaled;
+    vkutil::Image fsr_sharpened;
+
     vk::Semaphore image_acquired_semaphore;
     vk::Semaphore image_ready_semaphore;
 
@@ -73,6 +97,27 @@ public:
 
     vk::CommandBuffer current_cmd_buffer;
 
+    enum class CaptureBufferState : uint8_t {
+        Free,
+        // the copy was recorded in the command buffer of image_idx, it is done once its fence is waited for
+        Copying,
+        // given to the capture thread, which frees it once it is done with it
+        Reading
+    };
+    // buffers the presented images are copied to when they are captured
+    struct CaptureBuffer {
+        vkutil::Buffer buffer;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t image_idx = 0;
+        bool screenshot = false;
+        std::chrono::steady_clock::time_point time;
+        std::atomic<CaptureBufferState> state = CaptureBufferState::Free;
+    };
+    std::array<CaptureBuffer, 3> capture_buffers;
+    // the swapchain images can be copied from and have 8-bit components
+    bool capture_supported = false;
+
     // these are used by the gui
     uint32_t swapchain_image_idx = ~0;
     // set to true after a window resize, in this case the pipeline needs to be rebuilt
@@ -80,6 +125,13 @@ public:
     // is fxaa used
     bool enable_fxaa = false;
 
+    // id of the last frame presented, only used with VK_KHR_present_wait
+    uint64_t present_id = 0;
+    // id of the first frame presented to the current swapchain
+    uint64_t first_present_id = 1;
+    // fences of the frames rendered and not waited for yet, to limit the frames in flight without VK_KHR_present_wait
+    std::deque<vk::Fence> frames_in_flight;
+
     ScreenRenderer(VKState &state);
 
     bool create(SDL_Window *window);
@@ -99,6 +151,16 @@ private:
     bool create_graphics_pipelines();
     void copy_to_vao(const void *data);
     void create_surface_image();
+    bool create_fsr_pipelines(const std::string &builtin_shaders_path);
+    void create_fsr_images();
+    void upscale_fsr(vk::ImageView image_view, vk::ImageLayout layout, const std::array<float, 4> &uvs, const SceFVector2 &texture_size);
+    void wait_frames_in_flight();
+    // add the GPU time of the previous presentation of the current image, once its fence is waited for
+    void read_present_gpu_time();
     void destroy_swapchain();
+    // copy the current image to a capture buffer, when the video capture wants it
+    void capture_frame();
+    // give the capture buffers copied by the command buffer of the image (or by all of them) to the capture thread
+    void release_capture_buffers(uint32_t image_idx, bool all);
 };
 } // namespace renderer::vulkan
@@ -20,12 +20,14 @@
 #include <renderer/state.h>
 #include <renderer/types.h>
 
+#include <renderer/vulkan/memory_budget.h>
 #include <renderer/vulkan/pipeline_cache.h>
 #include <renderer/vulkan/screen_renderer.h>
 #include <renderer/vulkan/surface_cache.h>
 #include <renderer/vulkan/types.h>
 
 typedef void *ImTextureID;
+struct DisplayFrameInfo;
 
 namespace renderer::vulkan {
 struct VKState : public renderer::State {
@@ -35,6 +37,8 @@ struct VKState : public renderer::State {
     VKSurfaceCache surface_cache;
     PipelineCache pipeline_cache;
     VKTextureCacheState texture_cache;
+    // pools of the textures, surfaces and staging buffers, kept under the GPU memory budget
+    MemoryBudget memory_budget;
 
     vk::Instance instance;
     vk::Device device;
@@ -64,10 +68,47 @@ struct VKState : public renderer::State {
 
     // only used when memory mapping is enabled
     std::map<uint64_t, MappedMemory, std::greater<uint64_t>> mapped_memories;
+    // mapped memory containing each 4KB page of the guest memory, null if the page is not mapped
+    // the host pointers are translated with it without searching mapped_memories
+    std::vector<const MappedMemory *> mapped_memory_pages;
+    const uint8_t *guest_memory_base = nullptr;
+    // can the framebuffers written by the CPU be sampled from the mapped memory without being uploaded
+    bool support_mapped_framebuffer = false;
+    std::vector<MappedFramebuffer> mapped_framebuffers;
 
     vkutil::Image default_image;
     vkutil::Buffer default_buffer;
 
+    // does the GPU support VK_KHR_timeline_semaphore, each scene then signals the next value of the context semaphore
+    bool support_timeline_semaphore = false;
+    // does the GPU support VK_KHR_present_id and VK_KHR_present_wait, the frames can then be paced with their present time
+    bool support_present_wait = false;
+
+    // submit the scenes from a dedicated thread
+    bool pipelined_submission = false;
+    // decode the swizzled, tiled and paletted textures with a compute shader, the yuv420 ones always are
+    bool gpu_texture_decode = false;
+    // compress the PVRTC textures to BC1 or BC3 if the GPU can't sample them
+    bool transcode_pvrtc = false;
+    // compile the pipelines on worker threads, the draws are skipped until their pipeline is ready
+    bool async_pipeline_compilation = false;
+    // link the pipelines from libraries shared with the other pipelines if the GPU supports it
+    bool pipeline_library = false;
+    // keep rendering in the same render pass when a scene is followed by another one on the same surfaces
+    bool merge_scenes = false;
+    // upload the new textures from a dedicated transfer queue if the GPU has one, they are then acquired by the general queue
+    bool transfer_queue_uploads = false;
+    // upscale the game surface to the window size with FSR 1.0 when presenting it, so a low resolution multiplier still looks sharp
+    bool fsr_upscale = false;
+    // host present mode: auto (depends on v_sync), mailbox, fifo, fifo-relaxed or immediate
+    std::string present_mode = "auto";
+    bool v_sync = true;
+    // maximum number of frames queued for presentation before the emulator waits, 0 for no limit other than the swapchain size
+    int max_frames_in_flight = 0;
+
+    // programs of the shaders cache whose shaders are still loaded by the precompile pool
+    std::vector<ShadersHash> precompiling_programs;
+
     VKState(int gpu_idx);
 
     bool init(const char *base_path, const bool hashless_texture_cache) override;
@@ -79,15 +120,20 @@ struct VKState : public renderer::State {
     void set_fxaa(bool enable_fxaa) override;
     int get_max_anisotropic_filtering() override;
     void set_anisotropic_filtering(int anisotropic_filtering) override;
-    bool map_memory(void *address, uint32_t size) override;
-    void unmap_memory(void *address) override;
+    bool map_memory(MemState &mem, Ptr<void> address, uint32_t size) override;
+    void unmap_memory(MemState &mem, Ptr<void> address) override;
     // return the matching buffer and offset for the memory location
     std::tuple<vk::Buffer, uint32_t> get_matching_mapping(const void *address);
     // return the GPU buffer device address matching this one
     uint64_t get_matching_device_address(const void *address);
+    // return the view of the linear image bound to the mapped memory holding this framebuffer, null if there is none
+    vk::ImageView get_mapped_framebuffer(const DisplayFrameInfo &frame, MemState &mem, std::array<float, 4> &uvs, SceFVector2 &texture_size);
     std::vector<std::string> get_gpu_list() override;
+    bool supports_gpu_timing() const override;
 
     void precompile_shader(const ShadersHash &hash) override;
+    bool update_precompiled_shaders() override;
+    void prewarm_pipelines() override;
     void preclose_action() override;
 };
 } // namespace renderer::vulkan
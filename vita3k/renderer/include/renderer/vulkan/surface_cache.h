@@ -21,6 +21,9 @@
 
 #include <vkutil/objects.h>
 
+#include <list>
+#include <unordered_map>
+
 namespace renderer::vulkan {
 
 struct VKRenderTarget;
@@ -49,6 +52,14 @@ struct CastedTexture {
     SceGxmColorBaseFormat format;
 };
 
+// view of a color surface with another format of the same size, reading it this way needs no copy
+struct AliasedView {
+    vk::Format format;
+    vk::ComponentMapping swizzle;
+    // share the image of the surface, only the view belongs to it
+    vkutil::Image image;
+};
+
 struct ColorSurfaceCacheInfo : public SurfaceCacheInfo {
     uint16_t width;
     uint16_t height;
@@ -64,11 +75,17 @@ struct ColorSurfaceCacheInfo : public SurfaceCacheInfo {
     std::vector<CastedTexture> casted_textures;
     // same image with a different view(swizzle) used for sampling
     vkutil::Image sampled_image;
+    std::vector<AliasedView> aliased_views;
+
+    // position of this surface in the list of the last used color surfaces
+    std::list<Address>::iterator last_use_position;
+    // scene timestamp of the last use, the surface can be evicted once it is old enough
+    uint64_t last_used_scene = 0;
 };
 
 struct DepthSurfaceView {
     vkutil::Image depth_view;
-    // used so that we copy the depth stencil at most once per scene
+    // scene during which the depth stencil was last copied, it is copied again only if it was rendered to since then
     uint64_t scene_timestamp;
 };
 
@@ -77,8 +94,16 @@ struct DepthStencilSurfaceCacheInfo : public SurfaceCacheInfo {
     int32_t width;
     int32_t height;
 
+    // last scene this depth stencil was the attachment of, the copies made for reading during or before that scene are outdated
+    uint64_t last_write_scene = 0;
+
     // used when reading from this depth stencil in a shader
     std::vector<DepthSurfaceView> read_surfaces;
+    // same image with a view of the depth only, sampled without a copy by the scenes which don't render to it
+    vkutil::Image sampled_image;
+
+    // position of this surface in the list of the last used depth stencil surfaces, only valid if it is not free
+    std::list<size_t>::iterator last_use_position;
 };
 
 class VKSurfaceCache : public SurfaceCache {
@@ -90,9 +115,15 @@ private:
     std::map<Address, ColorSurfaceCacheInfo> color_surface_textures;
     std::array<DepthStencilSurfaceCacheInfo, MAX_CACHE_SIZE_PER_CONTAINER> depth_stencil_textures;
     std::map<std::pair<vk::ImageView, vk::ImageView>, vk::Framebuffer> framebuffer_array;
+    // formats a color surface can be viewed as, the surface images are created with all of them allowed
+    std::map<vk::Format, std::vector<vk::Format>> compatible_formats;
 
-    std::vector<Address> last_use_color_surface_index;
-    std::vector<size_t> last_use_depth_stencil_surface_index;
+    // the least recently used surface is the first one, each surface knows its position to be moved in constant time
+    std::list<Address> last_use_color_surface_index;
+    std::list<size_t> last_use_depth_stencil_surface_index;
+    // index in depth_stencil_textures of the surfaces in use, with their depth data as the key
+    std::unordered_multimap<Address, size_t> depth_stencil_surface_indices;
+    std::vector<size_t> free_depth_stencil_surface_indices;
 
     VKRenderTarget *target = nullptr;
 
@@ -102,6 +133,15 @@ private:
     void destroy_surface(ColorSurfaceCacheInfo &info);
     void destroy_surface(DepthStencilSurfaceCacheInfo &info);
 
+    // also remove the surface from the list of the last used ones
+    std::map<Address, ColorSurfaceCacheInfo>::iterator erase_color_surface(std::map<Address, ColorSurfaceCacheInfo>::iterator ite);
+    // move the surface to the end of the list of the last used ones
+    void mark_color_surface_used(ColorSurfaceCacheInfo &info);
+    void free_depth_stencil_surface(size_t index);
+
+    const std::vector<vk::Format> &get_compatible_formats(vk::Format format);
+    vkutil::Image &retrieve_aliased_view(ColorSurfaceCacheInfo &info, vk::Format format, vk::ComponentMapping swizzle);
+
 public:
     // when creating a mutable image, can we pass as an argument
     // the possible format used for an image view to improve performance ?
@@ -125,8 +165,19 @@ public:
     // (meaning their color or depth-stencil surface is not backed by memory)
     void destroy_associated_framebuffers(const VKRenderTarget *render_target);
 
+    // color surface holding the rectangle of a transfer with the same pixel size and stride, nullptr if there is none
+    // x and y are set to the position of the rectangle in the surface, without the resolution multiplier
+    ColorSurfaceCacheInfo *retrieve_color_surface_for_transfer(Address address, int32_t stride, uint32_t bytes_per_pixel,
+        uint32_t width, uint32_t height, uint32_t &x, uint32_t &y);
+
     vk::ImageView sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t width, uint32_t height, const uint32_t pitch, std::array<float, 4> &uvs, const int res_multiplier, SceFVector2 &texture_size);
 
+    // destroy the casted copies not used since the scene keep_since, return the number of bytes released
+    size_t release_casted_textures(uint64_t keep_since);
+    // destroy the least recently used color surfaces not used since the scene keep_since until size bytes are released
+    // return the number of bytes released
+    size_t evict_color_surfaces(uint64_t keep_since, size_t size);
+
     void set_render_target(VKRenderTarget *new_target) {
         target = new_target;
     }
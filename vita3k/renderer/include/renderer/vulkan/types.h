@@ -17,12 +17,19 @@
 
 #pragma once
 
+#include <renderer/surface_readback.h>
 #include <renderer/texture_cache_state.h>
 #include <renderer/types.h>
 
 #include <threads/queue.h>
+#include <threads/spsc_ring.h>
 #include <vkutil/objects.h>
 
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
 struct MemState;
 
 namespace renderer::vulkan {
@@ -31,6 +38,8 @@ struct VKState;
 struct VKRenderTarget;
 
 constexpr int MAX_FRAMES_RENDERING = 3;
+// scenes of a frame whose GPU time can be measured, with the timestamps of their start and end
+constexpr uint32_t MAX_FRAME_TIMESTAMPS = 1024;
 constexpr int NB_TEXTURE_STAGING_BUFFERS = 16;
 
 struct TextureStagingBuffer {
@@ -39,6 +48,9 @@ struct TextureStagingBuffer {
     uint64_t scene_timestamp = ~0;
     uint64_t frame_timestamp = ~0;
     vk::Fence waiting_fence;
+    // only used if the textures are decoded on the GPU, must be updated when the buffer is re-created
+    vk::DescriptorSet decode_set;
+    bool is_decode_set_outdated = true;
 };
 
 struct TextureCacheEntry {
@@ -48,8 +60,19 @@ struct TextureCacheEntry {
     uint32_t memory_needed;
 };
 
+// samplers shared by all the textures sampled the same way, keyed by their packed sampling state
+// there are few distinct states so they are kept until the renderer is closed, the images only borrow them
+struct SamplerCache {
+    // the textures can be configured by the decoding threads
+    std::mutex mutex;
+    std::unordered_map<uint64_t, vk::Sampler> samplers;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
 struct VKTextureCacheState : public renderer::TextureCacheState {
     VKState &state;
+    SamplerCache sampler_cache;
 
     TextureStagingBuffer staging_buffers[NB_TEXTURE_STAGING_BUFFERS];
     uint32_t staging_idx = 0;
@@ -61,10 +84,37 @@ struct VKTextureCacheState : public renderer::TextureCacheState {
     const SceGxmTexture *gxm_texture = nullptr;
     vk::CommandBuffer cmd_buffer = nullptr;
     bool is_texture_transfer_ready = false;
+    // the current texture is uploaded from the transfer queue, cmd_buffer is then the transfer command buffer
+    bool is_transfer_upload = false;
+    bool support_pvrtc = false;
+
+    // created if the texture_decode compute shader could be loaded, it is then always used for the yuv420 videos
+    // and for the other formats it supports only if decode_all_formats is set (gpu-texture-decode)
+    bool decode_all_formats = false;
+    vk::DescriptorSetLayout decode_set_layout;
+    vk::DescriptorPool decode_descriptor_pool;
+    vk::PipelineLayout decode_pipeline_layout;
+    vk::Pipeline decode_pipeline;
 
     VKTextureCacheState(VKState &state);
     // get an available staging buffer, wait for one if all are busy
-    void prepare_staging_buffer(bool is_configure = false);
+    void prepare_staging_buffer(bool is_configure = false, bool keep_content = false);
+};
+
+// textures written in a descriptor set, with the layout it was allocated with
+struct TextureDescriptorKey {
+    vk::DescriptorSetLayout layout;
+    uint16_t texture_count;
+    std::array<vk::DescriptorImageInfo, 16> textures;
+
+    bool operator==(const TextureDescriptorKey &other) const {
+        return layout == other.layout && texture_count == other.texture_count
+            && std::equal(textures.begin(), textures.begin() + texture_count, other.textures.begin());
+    }
+};
+
+struct TextureDescriptorKeyHash {
+    size_t operator()(const TextureDescriptorKey &key) const;
 };
 
 struct FrameObject {
@@ -72,9 +122,19 @@ struct FrameObject {
     // we need to have a specif prerender pool because prerender command buffer
     // can be reset if we use too many new textures at once
     vk::CommandPool prerender_pool;
+    // only created if the textures are uploaded from the transfer queue
+    vk::CommandPool transfer_pool;
     vk::DescriptorPool descriptor_pool;
+    // texture descriptor sets allocated from descriptor_pool, the draws using the same textures share them
+    std::unordered_map<TextureDescriptorKey, vk::DescriptorSet, TextureDescriptorKeyHash> texture_descriptor_sets;
 
     std::vector<vk::Fence> rendered_fences;
+    // fences of the transfers done by the GPU outside of the scenes, they are also in rendered_fences once used
+    std::vector<vk::Fence> transfer_fences;
+    size_t transfer_fence_idx = 0;
+    // only created when the GPU time is measured, the scenes of the frame write their start and end timestamps in it
+    vk::QueryPool timestamp_pool;
+    uint32_t timestamp_count = 0;
     // equals to context.frame_timestamp when the frame object is used
     uint64_t frame_timestamp;
 
@@ -88,22 +148,105 @@ struct MappedMemory {
     vk::DeviceMemory memory;
     vk::Buffer buffer;
     uint64_t buffer_address;
+    uint32_t memory_type;
+};
+
+// framebuffer written by the CPU, sampled by the screen renderer as a linear image bound to the mapped memory holding it
+struct MappedFramebuffer {
+    Address address;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    const MappedMemory *memory;
+    // null if the image can't be bound to this part of the mapped memory, the framebuffer is then uploaded
+    vk::Image image;
+    vk::ImageView view;
+};
+
+// content of a color surface copied to a host visible buffer by a scene,
+// written to the guest memory by the wait thread once the scene is done
+struct SurfaceReadback : public renderer::SurfaceReadbackSync {
+    vkutil::Buffer buffer;
+};
+typedef std::shared_ptr<SurfaceReadback> SurfaceReadbackPtr;
+
+// guest data copied to a ring buffer, identified by its location and size
+struct StreamUploadKey {
+    const void *data;
+    uint32_t size;
+
+    bool operator==(const StreamUploadKey &other) const {
+        return data == other.data && size == other.size;
+    }
+};
+
+struct StreamUploadKeyHash {
+    size_t operator()(const StreamUploadKey &key) const {
+        return std::hash<const void *>()(key.data) ^ (static_cast<size_t>(key.size) << 1);
+    }
+};
+
+struct StreamUpload {
+    uint64_t content_hash;
+    uint32_t offset;
+    // wrap count of the ring buffer when it was copied, the copy has been overwritten if it changed
+    uint32_t wrap_count;
+};
+typedef std::unordered_map<StreamUploadKey, StreamUpload, StreamUploadKeyHash> StreamUploads;
+
+// indices of a triangle fan converted to a triangle list
+struct ConvertedIndices {
+    uint64_t source_hash;
+    std::vector<uint8_t> indices;
+};
+
+// scene waiting to be submitted by the submission thread
+struct SubmitRequest {
+    // the prerender cmd must be submitted before the render cmd
+    // the transfers done outside of the scenes only have the first one
+    std::array<vk::CommandBuffer, 2> cmd_buffers;
+    vk::Fence fence;
+    // value signaled by the scene on the context timeline semaphore, only used if it is supported
+    uint64_t timeline_value;
+    // if not 0, value of the transfer timeline semaphore to wait for before executing the scene
+    uint64_t transfer_wait_value;
+    SceGxmNotification notifications[2];
+    // only set if the scene copies its color surface, or if the transfer writes to a color surface
+    SurfaceReadbackPtr readback;
 };
 
 // request to trigger a notification after the fence has been waited for
 struct NotificationRequest {
     SceGxmNotification notifications[2];
     vk::Fence fence;
+    uint64_t timeline_value;
 };
 
 struct FrameDoneRequest {
     uint64_t frame_timestamp;
+    // value of the last scene of the frame
+    uint64_t timeline_value;
+};
+
+// request to write the surface content to the guest memory after the fence has been waited for
+struct SurfaceReadbackRequest {
+    SurfaceReadbackPtr readback;
+    vk::Fence fence;
+    uint64_t timeline_value;
 };
 
 // A parallel thread is handling these request and telling other waiting threads
 // when they are done
-// only used if memory mapping is enabled
-typedef std::variant<NotificationRequest, FrameDoneRequest> WaitThreadRequest;
+// the notification and frame done requests are only used if memory mapping is enabled
+typedef std::variant<NotificationRequest, FrameDoneRequest, SurfaceReadbackRequest> WaitThreadRequest;
+
+// last copy of a uniform staging buffer to its ring buffer, used again by the next draws until the content changes
+struct UniformUpload {
+    bool dirty = true;
+    uint32_t size = 0;
+    uint32_t offset = 0;
+    uint32_t wrap_count = 0;
+};
 
 struct VKContext : public renderer::Context {
     // GXM Context Info
@@ -124,11 +267,26 @@ struct VKContext : public renderer::Context {
     vkutil::HostRingBuffer vertex_info_uniform_buffer;
     vkutil::HostRingBuffer fragment_info_uniform_buffer;
 
+    // streams copied to the ring buffers during this frame, a stream with the same content is not copied again
+    // only used if memory mapping is not enabled
+    StreamUploads vertex_stream_uploads;
+    StreamUploads index_stream_uploads;
+#ifdef __APPLE__
+    // streams whose stride isn't a multiple of 4, copied to the vertex ring buffer with an aligned stride during this frame
+    StreamUploads restrided_stream_uploads;
+    // triangle fans converted to triangle lists, kept across the frames so the static meshes are not converted each time
+    std::unordered_map<StreamUploadKey, ConvertedIndices, StreamUploadKeyHash> triangle_fan_indices;
+#endif
+
     vk::DescriptorImageInfo vertex_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
     vk::DescriptorImageInfo fragment_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
 
-    bool vertex_uniform_storage_allocated = false;
-    bool fragment_uniform_storage_allocated = false;
+    // content of the uniform buffers of the next draw, only copied to the ring buffers when it changed
+    // only used if memory mapping is not enabled
+    std::vector<uint8_t> vertex_uniform_staging;
+    std::vector<uint8_t> fragment_uniform_staging;
+    UniformUpload vertex_uniform_upload;
+    UniformUpload fragment_uniform_upload;
 
     vk::Buffer vertex_stream_buffers[SCE_GXM_MAX_VERTEX_STREAMS];
     vk::DeviceSize vertex_stream_offsets[SCE_GXM_MAX_VERTEX_STREAMS] = {};
@@ -158,6 +316,9 @@ struct VKContext : public renderer::Context {
     SceGxmPrimitiveType last_primitive;
 
     vk::RenderPass current_render_pass;
+    // what current_render_pass was retrieved with
+    vk::Format current_render_pass_format;
+    uint32_t current_render_pass_zls_control;
     vk::Pipeline current_pipeline;
 
     vk::Framebuffer current_framebuffer;
@@ -166,7 +327,16 @@ struct VKContext : public renderer::Context {
     vkutil::Image *current_ds_attachment;
 
     bool is_recording = false;
+    // first of the two timestamp queries of the scene being recorded, ~0 if its GPU time is not measured
+    uint32_t scene_timestamp_query = ~0u;
     bool in_renderpass = false;
+    // only used if scene merging is enabled, the last scene ended without anything waiting for it
+    // it is still recording and only submitted when the next scene does not render to the same surfaces
+    bool scene_end_pending = false;
+    SceGxmColorSurface pending_color_surface;
+    SceGxmDepthStencilSurface pending_ds_surface;
+    // the current scene continues the render pass of the previous one
+    bool in_merged_scene = false;
     bool refresh_pipeline = false;
     // command buffer used to record the current scene
     vk::CommandBuffer render_cmd{};
@@ -182,6 +352,30 @@ struct VKContext : public renderer::Context {
     std::thread gpu_request_wait_thread;
     uint64_t last_frame_waited = 0;
 
+    // only created if timeline semaphores are supported, signaled by each scene with the next value
+    // the wait thread then waits for a single value instead of all the fences submitted until then
+    vk::Semaphore scene_timeline;
+    uint64_t scene_timeline_value = 0;
+
+    // only used if the textures are uploaded from the transfer queue
+    // the uploads of the current scene, submitted to the transfer queue before the scene itself
+    vk::CommandBuffer transfer_cmd;
+    vk::Semaphore transfer_timeline;
+    uint64_t transfer_timeline_value = 0;
+    // value the next submission to the general queue must wait for, 0 if there is none
+    uint64_t transfer_wait_value = 0;
+
+    // readback recorded in the current scene, sent to the wait thread with it
+    SurfaceReadbackPtr pending_readback;
+    // buffers of the readbacks which are done, reused by the next ones
+    std::mutex readback_buffers_mutex;
+    std::vector<vkutil::Buffer> readback_buffers;
+
+    // only used if pipelined submission is enabled, scenes are submitted by this thread
+    // while the render thread records the next ones
+    SPSCRing<SubmitRequest, 64> submit_queue;
+    std::thread submit_thread;
+
     inline FrameObject &frame() {
         return frames[current_frame_idx];
     }
@@ -194,15 +388,44 @@ struct VKContext : public renderer::Context {
     void start_render_pass();
     void stop_render_pass();
     void stop_recording(const SceGxmNotification &notif1, const SceGxmNotification &notif2);
+    // end the current scene, it is kept open if it may be merged with the next one
+    void end_scene(const SceGxmNotification &notif1, const SceGxmNotification &notif2);
+    // submit the scene kept open by end_scene, must be done before anything using its result or its resources
+    void flush_pending_scene();
+    // return the command buffer in which the copies and layout transitions needed by the next draw are recorded
+    // the prerender command buffer of a merged scene is executed before the draws of the previous scenes, so the render
+    // pass is ended instead and they are recorded in the render command buffer, the next draw starts the render pass again
+    vk::CommandBuffer get_prerender_cmd();
+    // copy the current color surface at the end of the scene, the guest memory is written asynchronously
+    // and the guest threads accessing it wait until it is
+    void request_surface_readback(const SceGxmColorSurface &surface);
+    // readback of size bytes to the guest memory at address, its buffer is one of the available ones if possible
+    SurfaceReadbackPtr create_readback(Address address, uint32_t size);
+    // make the guest threads accessing the memory of the readback wait until it is written
+    void protect_readback(const SurfaceReadbackPtr &readback);
+    // begin a command buffer for a GXM transfer done by the GPU, must not be called while a scene is recording
+    vk::CommandBuffer start_gpu_transfer();
+    // submit the transfer after the scenes before it, the readback if there is one is written once it is done
+    void submit_gpu_transfer(vk::CommandBuffer cmd, SurfaceReadbackPtr readback);
+    // wait for all the recorded scenes to be submitted, must be done before anything else is submitted to the general queue
+    void flush_submissions();
+    // return the transfer command buffer of the scene, begin it if it is not yet recording
+    vk::CommandBuffer get_transfer_cmd();
+    // submit the transfer commands recorded so far, the next submission to the general queue waits for them
+    void flush_transfer_cmd();
 
 private:
+    void submit(const SubmitRequest &request);
     void wait_thread_function();
+    void submit_thread_function();
 };
 
 struct VKRenderTarget : public renderer::RenderTarget {
     uint16_t width;
     uint16_t height;
     vkutil::Image mask;
+    // value of the whole mask since it was last cleared, negative once a mask update wrote another value in a part of it
+    float mask_value = -1.0f;
     vkutil::Image color;
     vkutil::Image depthstencil;
 
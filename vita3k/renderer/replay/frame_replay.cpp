@@ -0,0 +1,127 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+// Replays a frame written with --capture-frame without the emulated CPU and reports the time the renderer takes
+// to process its commands, to measure the changes of the renderer on the same frame.
+
+#include <renderer/frame_capture.h>
+#include <renderer/functions.h>
+#include <renderer/state.h>
+
+#include <config/state.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+// frames processed after the replays, the backends read the GPU times of the frames a few frames later
+static constexpr int FLUSH_FRAMES = 4;
+
+static void new_frame(renderer::State &state, MemState &mem, Config &config) {
+    CommandList command_list{};
+    command_list.first = command_list.last = make_command(new Command, CommandOpcode::NewFrame, nullptr);
+    renderer::process_batch(state, state.features, mem, config, command_list);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <capture> [iterations] [vulkan|opengl]\n", argv[0]);
+        return 2;
+    }
+
+    const fs::path capture_path = fs::path(argv[1]);
+    const int iterations = (argc > 2) ? std::atoi(argv[2]) : 100;
+    const bool is_opengl = (argc > 3) && (std::strcmp(argv[3], "opengl") == 0);
+    if (iterations <= 0) {
+        std::fprintf(stderr, "the number of iterations must be positive\n");
+        return 2;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        std::fprintf(stderr, "failed to initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    const uint32_t window_flags = SDL_WINDOW_HIDDEN | (is_opengl ? SDL_WINDOW_OPENGL : SDL_WINDOW_VULKAN);
+    SDL_Window *window = SDL_CreateWindow("renderer-replay", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 960, 544, window_flags);
+    if (!window) {
+        std::fprintf(stderr, "failed to create the window: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    MemState mem;
+    Config config;
+    std::unique_ptr<renderer::State> state;
+    const std::string base_path = SDL_GetBasePath() ? SDL_GetBasePath() : "";
+    if (!init(mem) || !renderer::init(window, state, is_opengl ? renderer::Backend::OpenGL : renderer::Backend::Vulkan, config, base_path.c_str())) {
+        std::fprintf(stderr, "failed to initialize the renderer\n");
+        return 1;
+    }
+    state->title_id = "";
+    state->self_name = "";
+    state->gpu_timing = true;
+
+    renderer::FrameReplay replay;
+    if (!replay.load(*state, mem, config, capture_path)) {
+        std::fprintf(stderr, "failed to load %s\n", capture_path.string().c_str());
+        return 1;
+    }
+    std::printf("Replaying the frame %llu of %s, %zu commands, %d times\n", static_cast<unsigned long long>(replay.get_frame()),
+        capture_path.string().c_str(), replay.get_command_count(), iterations);
+
+    // the first replay compiles the shaders and pipelines and uploads the textures
+    const auto warmup_start = std::chrono::steady_clock::now();
+    replay.replay(*state, mem, config);
+    const auto warmup_end = std::chrono::steady_clock::now();
+    const uint64_t warmup_gpu_time = state->gpu_time_ns;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 1; i < iterations; i++)
+        replay.replay(*state, mem, config);
+    const auto end = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < FLUSH_FRAMES; i++)
+        new_frame(*state, mem, config);
+
+    const double warmup_ms = std::chrono::duration<double, std::milli>(warmup_end - warmup_start).count();
+    std::printf("first replay: %10.3f ms\n", warmup_ms);
+    if (iterations > 1) {
+        const double cpu_ms = std::chrono::duration<double, std::milli>(end - start).count() / (iterations - 1);
+        std::printf("replay (cpu): %10.3f ms\n", cpu_ms);
+    }
+    if (state->supports_gpu_timing()) {
+        const double gpu_ms = static_cast<double>(state->gpu_time_ns - warmup_gpu_time) / 1e6 / std::max(iterations - 1, 1);
+        std::printf("replay (gpu): %10.3f ms, %llu scenes\n", gpu_ms, static_cast<unsigned long long>(state->gpu_scene_count.load()));
+    }
+
+    state->preclose_action();
+    replay.destroy(*state, mem, config);
+    state.reset();
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return 0;
+}
@@ -15,15 +15,19 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <renderer/command_arena.h>
 #include <renderer/commands.h>
 #include <renderer/driver_functions.h>
 #include <renderer/functions.h>
 #include <renderer/state.h>
 #include <renderer/types.h>
 
+#include <renderer/gl/functions.h>
+#include <renderer/gl/types.h>
 #include <renderer/vulkan/types.h>
 
 #include <config/state.h>
+#include <algorithm>
 #include <functional>
 #include <util/log.h>
 #include <util/string_utils.h>
@@ -31,12 +35,18 @@
 struct FeatureState;
 
 namespace renderer {
-Command *generic_command_allocate() {
+Command *allocate_command(Context *ctx) {
+    if (ctx && ctx->command_arena)
+        return ctx->command_arena->allocate();
+    if (ctx && ctx->alloc_func)
+        return ctx->alloc_func();
+
     return new Command;
 }
 
-void generic_command_free(Command *cmd) {
-    delete cmd;
+void free_command(Command *cmd) {
+    if (!(cmd->flags & Command::FLAG_NO_FREE))
+        delete cmd;
 }
 
 void complete_command(State &state, CommandHelper &helper, const int code) {
@@ -66,6 +76,97 @@ bool wait_cmd(MemState &mem, CommandList &command_list) {
     return renderer::wishlist(sync, timestamp, 500);
 }
 
+// The OpenGL draws are batched until a command other than a draw or the upload of the vertex streams and
+// uniform buffers of the next draw is processed, the draw itself checks that these didn't change
+static bool keeps_draw_batch(Command *cmd) {
+    if (cmd->opcode == CommandOpcode::Draw)
+        return true;
+
+    if (cmd->opcode != CommandOpcode::SetState)
+        return false;
+
+    CommandHelper helper(cmd);
+    const GXMState gxm_state = helper.pop<GXMState>();
+    return gxm_state == GXMState::VertexStream || gxm_state == GXMState::UniformBuffer;
+}
+
+// The frame skip drops the draws of the scenes of a frame. What these scenes send back to the client (notifications,
+// sync objects and completion of the surface syncs) and the states they set are still processed
+static bool skip_scene_command(State &state, MemState &mem, Command &cmd) {
+    CommandHelper helper(&cmd);
+    switch (cmd.opcode) {
+    case CommandOpcode::Draw:
+        return true;
+
+    case CommandOpcode::SetContext: {
+        helper.pop<RenderTarget *>();
+        const SceGxmColorSurface *color_surface = helper.pop<SceGxmColorSurface *>();
+        const SceGxmDepthStencilSurface *depth_stencil_surface = helper.pop<SceGxmDepthStencilSurface *>();
+        if (color_surface) {
+            const Address data = color_surface->data.address();
+            if (data && std::find(state.skipped_surfaces.begin(), state.skipped_surfaces.end(), data) == state.skipped_surfaces.end())
+                state.skipped_surfaces.push_back(data);
+        }
+        delete color_surface;
+        delete depth_stencil_surface;
+        return true;
+    }
+
+    case CommandOpcode::SyncSurfaceData: {
+        const SceGxmNotification vertex_notification = helper.pop<SceGxmNotification>();
+        const SceGxmNotification fragment_notification = helper.pop<SceGxmNotification>();
+        if (vertex_notification.address || fragment_notification.address) {
+            std::unique_lock<std::mutex> lock(state.notification_mutex);
+            if (vertex_notification.address)
+                *vertex_notification.address.get(mem) = vertex_notification.value;
+            if (fragment_notification.address)
+                *fragment_notification.address.get(mem) = fragment_notification.value;
+            lock.unlock();
+            state.notification_ready.notify_all();
+        }
+        if (cmd.status)
+            complete_command(state, helper, 0);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+// a color surface is drawn again, it can be presented
+static void forget_skipped_surface(State &state, Command &cmd) {
+    CommandHelper helper(&cmd);
+    helper.pop<RenderTarget *>();
+    const SceGxmColorSurface *color_surface = helper.pop<SceGxmColorSurface *>();
+    if (!color_surface)
+        return;
+
+    const auto skipped = std::find(state.skipped_surfaces.begin(), state.skipped_surfaces.end(), color_surface->data.address());
+    if (skipped != state.skipped_surfaces.end())
+        state.skipped_surfaces.erase(skipped);
+}
+
+// called for each frame processed, decide if the scenes of the next one are dropped
+static void update_frame_skip(State &state, const Config &config) {
+    state.frames_processed++;
+
+    // the guest has already queued the next frame, so it is waiting for the renderer
+    const bool is_behind = state.frames_queued > state.frames_processed;
+    const uint32_t max_frames_skipped = std::max(config.current_config.frame_skip, 0);
+    state.is_skipping_frame = is_behind && (state.frames_skipped_in_row < max_frames_skipped);
+    if (state.is_skipping_frame) {
+        state.frames_skipped_in_row++;
+        state.frames_skipped++;
+    } else {
+        state.frames_skipped_in_row = 0;
+    }
+}
+
+bool is_surface_skipped(const State &state, Address surface) {
+    return std::find(state.skipped_surfaces.begin(), state.skipped_surfaces.end(), surface) != state.skipped_surfaces.end();
+}
+
 void process_batch(renderer::State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list) {
     using CommandHandlerFunc = std::function<void(renderer::State &, MemState &, Config &,
         CommandHelper &, const FeatureState &, Context *, const char *, const char *, const char *)>;
@@ -92,6 +193,9 @@ void process_batch(renderer::State &state, const FeatureState &features, MemStat
     };
 
     Command *cmd = command_list.first;
+    // a scene is dropped as a whole, the NewFrame commands are sent without a context
+    const bool skip_scene = state.is_skipping_frame && command_list.context;
+    gl::GLContext *gl_context = (state.current_backend == Backend::OpenGL) ? reinterpret_cast<gl::GLContext *>(command_list.context) : nullptr;
 
     // Take a batch, and execute it. Hope it's not too large
     do {
@@ -99,29 +203,56 @@ void process_batch(renderer::State &state, const FeatureState &features, MemStat
             break;
         }
 
+        if (gl_context && !keeps_draw_batch(cmd))
+            gl::flush_draw_batch(*gl_context);
+
+        if (state.frame_capture && state.frame_capture->record(state, mem, command_list.context, *cmd))
+            state.frame_capture.reset();
+
+        if (!skip_scene && (cmd->opcode == CommandOpcode::SetContext) && !state.skipped_surfaces.empty())
+            forget_skipped_surface(state, *cmd);
+
         auto handler = handlers.find(cmd->opcode);
-        if (handler == handlers.end()) {
-            LOG_ERROR("Unimplemented command opcode {}", static_cast<int>(cmd->opcode));
+        if (skip_scene && skip_scene_command(state, mem, *cmd)) {
+            // dropped by the frame skip
+        } else if (handler == handlers.end()) {
+            LOG_ERROR_LIMITED("Unimplemented command opcode {}", static_cast<int>(cmd->opcode));
         } else {
+            // the time of a draw not spent in one of its phases is counted as the recording of its commands
+            const bool is_draw = cmd->opcode == CommandOpcode::Draw;
+            const bool is_set_state = cmd->opcode == CommandOpcode::SetState;
+            if (is_draw)
+                state.draw_profile.count_draw();
+            else if (is_set_state)
+                state.draw_profile.count_state_change();
+            const DrawProfileScope profile_scope((is_draw || is_set_state) ? &state.draw_profile : nullptr,
+                is_set_state ? DRAW_PROFILE_SET_STATE : DRAW_PROFILE_RECORD);
+
             CommandHelper helper(cmd);
             handler->second(state, mem, config, helper, features, command_list.context, state.base_path, state.title_id, state.self_name);
         }
 
+        if (cmd->opcode == CommandOpcode::DestroyContext)
+            gl_context = nullptr;
+        else if (cmd->opcode == CommandOpcode::NewFrame) {
+            update_frame_skip(state, config);
+            state.draw_profile.count_frame();
+        }
+
         Command *last_cmd = cmd;
         cmd = cmd->next;
 
-        if (command_list.context) {
-            command_list.context->free_func(last_cmd);
-        } else {
-            generic_command_free(last_cmd);
-        }
+        free_command(last_cmd);
     } while (true);
+
+    if (gl_context)
+        gl::flush_draw_batch(*gl_context);
 }
 
 void process_batches(renderer::State &state, const FeatureState &features, MemState &mem, Config &config) {
     while (!state.should_display) {
         // Try to wait for a batch (about 2 or 3ms, game should be fast for this)
-        auto cmd_list = state.command_buffer_queue.top(3);
+        CommandList *cmd_list = state.command_buffer_queue.top(std::chrono::microseconds(3));
 
         if (!cmd_list || !is_cmd_ready(mem, *cmd_list)) {
             // beginning of the game or homebrew not using gxm
@@ -137,8 +268,10 @@ void process_batches(renderer::State &state, const FeatureState &features, MemSt
                 continue;
         }
 
+        // Free the slot before processing so the guest can queue the next scene meanwhile
+        CommandList command_list = *cmd_list;
         state.command_buffer_queue.pop();
-        process_batch(state, features, mem, config, *cmd_list);
+        process_batch(state, features, mem, config, command_list);
     }
 }
 
@@ -0,0 +1,59 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/command_arena.h>
+
+namespace renderer {
+
+Command *CommandArena::allocate() {
+    current_frame = frames_submitted.load(std::memory_order_relaxed);
+    if (current_used == COMMAND_ARENA_CHUNK_SIZE) {
+        next_chunk();
+        if (!current_chunk)
+            return new Command;
+    }
+
+    Command *cmd = new (&current_chunk[current_used++]) Command;
+    cmd->flags = Command::FLAG_NO_FREE;
+    return cmd;
+}
+
+void CommandArena::next_chunk() {
+    if (current_chunk)
+        used_chunks.push_back({ current_frame, std::move(current_chunk) });
+
+    // A scene can be left open over a NewFrame, so the commands of a frame are only known to be
+    // processed once the NewFrame following the next one is
+    const uint64_t retired = frames_retired.load(std::memory_order_acquire);
+    while (!used_chunks.empty() && (used_chunks.front().frame + 2 <= retired)) {
+        free_chunks.push_back(std::move(used_chunks.front().commands));
+        used_chunks.pop_front();
+    }
+
+    if (!free_chunks.empty()) {
+        current_chunk = std::move(free_chunks.back());
+        free_chunks.pop_back();
+    } else if (used_chunks.size() < COMMAND_ARENA_MAX_CHUNKS) {
+        current_chunk = std::make_unique<Command[]>(COMMAND_ARENA_CHUNK_SIZE);
+    } else {
+        return;
+    }
+
+    current_used = 0;
+}
+
+} // namespace renderer
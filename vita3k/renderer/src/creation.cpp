@@ -18,8 +18,10 @@
 #include <gxm/types.h>
 #include <renderer/commands.h>
 #include <renderer/driver_functions.h>
+#include <renderer/shared_shader_cache.h>
 #include <renderer/state.h>
 #include <renderer/texture_cache_state.h>
+#include <renderer/texture_disk_cache.h>
 #include <renderer/types.h>
 
 #include <renderer/gl/functions.h>
@@ -34,6 +36,8 @@
 #include <util/string_utils.h>
 #include <util/tracy.h>
 
+#include <cstring>
+
 namespace renderer {
 
 static void layout_ssbo_offset_from_uniform_buffer_sizes(UniformBufferSizes &sizes, UniformBufferSizes &offsets, std::size_t &total_hold) {
@@ -116,6 +120,8 @@ COMMAND(handle_create_render_target) {
         break;
     }
     (*render_target)->multisample_mode = params->multisampleMode;
+    if (renderer.frame_capture && result)
+        renderer.frame_capture->add_render_target(render_target->get(), *params);
 
     complete_command(renderer, helper, result);
 }
@@ -124,6 +130,9 @@ COMMAND(handle_destroy_render_target) {
     TRACY_FUNC_COMMANDS(handle_destroy_render_target);
     std::unique_ptr<RenderTarget> *render_target = helper.pop<std::unique_ptr<RenderTarget> *>();
 
+    if (renderer.frame_capture)
+        renderer.frame_capture->remove_render_target(render_target->get());
+
     switch (renderer.current_backend) {
     case Backend::OpenGL:
         // nothing to do
@@ -148,8 +157,11 @@ COMMAND(handle_memory_map) {
     const Ptr<void> addr = helper.pop<Ptr<void>>();
     const uint32_t size = helper.pop<uint32_t>();
 
+    if (renderer.frame_capture)
+        renderer.frame_capture->add_memory_mapping(addr.address(), size);
+
     if (renderer.current_backend == Backend::Vulkan) {
-        dynamic_cast<vulkan::VKState &>(renderer).map_memory(addr.get(mem), size);
+        dynamic_cast<vulkan::VKState &>(renderer).map_memory(mem, addr, size);
     }
 
     complete_command(renderer, helper, 0);
@@ -160,49 +172,92 @@ COMMAND(handle_memory_unmap) {
 
     const Ptr<void> addr = helper.pop<Ptr<void>>();
 
+    if (renderer.frame_capture)
+        renderer.frame_capture->remove_memory_mapping(addr.address());
+
     if (renderer.current_backend == Backend::Vulkan) {
-        dynamic_cast<vulkan::VKState &>(renderer).unmap_memory(addr.get(mem));
+        dynamic_cast<vulkan::VKState &>(renderer).unmap_memory(mem, addr);
     }
 
     complete_command(renderer, helper, 0);
 }
 
 // Client
-bool create(std::unique_ptr<FragmentProgram> &fp, State &state, const SceGxmProgram &program, const SceGxmBlendInfo *blend, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id) {
+bool create(std::shared_ptr<FragmentProgram> &fp, State &state, const gxp::ProgramInfo &program_info, const SceGxmBlendInfo *blend, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id) {
+    const SceGxmProgram &program = *program_info.program;
+
+    // Try to hash this shader
+    const Sha256Hash hash = sha256(&program, program.size);
+    uint64_t blend_key = 0;
+    if (blend) {
+        uint32_t blend_bits;
+        std::memcpy(&blend_bits, blend, sizeof(blend_bits));
+        blend_key = (1ULL << 32) | blend_bits;
+    }
+    const auto key = std::make_pair(hash, blend_key);
+
+    const std::lock_guard<std::mutex> guard(state.program_registry.mutex);
+    auto &registered = state.program_registry.fragment_programs[key];
+    if (registered) {
+        // another program (maybe of a shader patcher already destroyed) was created from the same GXP and blending
+        fp = registered;
+        return true;
+    }
+
+    std::unique_ptr<FragmentProgram> created;
     switch (state.current_backend) {
     case Backend::OpenGL:
-        gl::create(fp, dynamic_cast<gl::GLState &>(state), program, blend);
+        gl::create(created, dynamic_cast<gl::GLState &>(state), program, blend);
         break;
 
     case Backend::Vulkan:
-        vulkan::create(fp, dynamic_cast<vulkan::VKState &>(state), program, blend);
+        vulkan::create(created, dynamic_cast<vulkan::VKState &>(state), program, blend);
         break;
 
     default:
         REPORT_MISSING(state.current_backend);
+        state.program_registry.fragment_programs.erase(key);
         return false;
     }
 
-    // Try to hash this shader
-    fp->hash = sha256(&program, program.size);
-    gxp_ptr_map.emplace(fp->hash, &program);
+    if (blend)
+        created->blend = *blend;
+
+    created->hash = hash;
+    gxp_ptr_map.emplace(created->hash, &program);
+
+    shader::usse::get_uniform_buffer_sizes(program, created->uniform_buffer_sizes);
+    layout_ssbo_offset_from_uniform_buffer_sizes(created->uniform_buffer_sizes, created->uniform_buffer_data_offsets, created->max_total_uniform_buffer_storage);
+    created->textures_used = program_info.textures_used;
+    created->texture_count = std::bit_width(created->textures_used.to_ulong());
 
-    shader::usse::get_uniform_buffer_sizes(program, fp->uniform_buffer_sizes);
-    layout_ssbo_offset_from_uniform_buffer_sizes(fp->uniform_buffer_sizes, fp->uniform_buffer_data_offsets, fp->max_total_uniform_buffer_storage);
-    fp->textures_used = gxp::get_textures_used(program);
-    fp->texture_count = std::bit_width(fp->textures_used.to_ulong());
+    registered = std::move(created);
+    fp = registered;
 
     return true;
 }
 
-bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgram &program, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id) {
+bool create(std::shared_ptr<VertexProgram> &vp, State &state, const gxp::ProgramInfo &program_info, GXPPtrMap &gxp_ptr_map, const char *base_path, const char *title_id) {
+    const SceGxmProgram &program = *program_info.program;
+
+    // Hash this shader
+    const Sha256Hash hash = sha256(&program, program.size);
+
+    const std::lock_guard<std::mutex> guard(state.program_registry.mutex);
+    const auto registered = state.program_registry.vertex_programs.find(hash);
+    if (registered != state.program_registry.vertex_programs.end()) {
+        vp = registered->second;
+        return true;
+    }
+
+    std::unique_ptr<VertexProgram> created;
     switch (state.current_backend) {
     case Backend::OpenGL:
-        gl::create(vp, dynamic_cast<gl::GLState &>(state), program);
+        gl::create(created, dynamic_cast<gl::GLState &>(state), program);
         break;
 
     case Backend::Vulkan:
-        vulkan::create(vp, dynamic_cast<vulkan::VKState &>(state), program);
+        vulkan::create(created, dynamic_cast<vulkan::VKState &>(state), program);
         break;
 
     default:
@@ -210,22 +265,26 @@ bool create(std::unique_ptr<VertexProgram> &vp, State &state, const SceGxmProgra
         return false;
     }
 
-    // Hash this shader
-    vp->hash = sha256(&program, program.size);
-    gxp_ptr_map.emplace(vp->hash, &program);
-
-    shader::usse::get_uniform_buffer_sizes(program, vp->uniform_buffer_sizes);
-    shader::usse::get_attribute_informations(program, vp->attribute_infos);
-    layout_ssbo_offset_from_uniform_buffer_sizes(vp->uniform_buffer_sizes, vp->uniform_buffer_data_offsets, vp->max_total_uniform_buffer_storage);
-    vp->textures_used = gxp::get_textures_used(program);
-    vp->texture_count = std::bit_width(vp->textures_used.to_ulong());
-
-    if (vp->attribute_infos.empty()) {
-        vp->stripped_symbols_checked = false;
-    } else {
-        vp->stripped_symbols_checked = true;
+    created->hash = hash;
+    gxp_ptr_map.emplace(created->hash, &program);
+
+    shader::usse::get_uniform_buffer_sizes(program, created->uniform_buffer_sizes);
+    shader::usse::get_attribute_informations(program, created->attribute_infos);
+    layout_ssbo_offset_from_uniform_buffer_sizes(created->uniform_buffer_sizes, created->uniform_buffer_data_offsets, created->max_total_uniform_buffer_storage);
+    created->textures_used = program_info.textures_used;
+    created->texture_count = std::bit_width(created->textures_used.to_ulong());
+
+    if (created->attribute_infos.empty()) {
+        created->stripped_symbols_checked = false;
+        // the attributes are then deduced from the ones of the guest program when it is first drawn, it can't be shared
+        vp = std::move(created);
+        return true;
     }
 
+    created->stripped_symbols_checked = true;
+    vp = std::move(created);
+    state.program_registry.vertex_programs.emplace(hash, vp);
+
     return true;
 }
 
@@ -245,14 +304,33 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     switch (backend) {
     case Backend::OpenGL:
         state = std::make_unique<gl::GLState>();
+        state->features.optimize_spirv = config.optimize_shaders;
         if (!gl::create(window, state, base_path, config.hashless_texture_cache))
             return false;
+        texture::set_cache_limits(reinterpret_cast<gl::GLState *>(state.get())->texture_cache, std::max(config.texture_cache_capacity, 0), static_cast<size_t>(std::max(config.texture_cache_budget, 0)) * MiB(1));
         break;
 
     case Backend::Vulkan:
         state = std::make_unique<vulkan::VKState>(config.gpu_idx);
+        state->features.optimize_spirv = config.optimize_shaders;
+        reinterpret_cast<vulkan::VKState *>(state.get())->pipelined_submission = config.pipelined_submission;
+        reinterpret_cast<vulkan::VKState *>(state.get())->gpu_texture_decode = config.gpu_texture_decode;
+        reinterpret_cast<vulkan::VKState *>(state.get())->transcode_pvrtc = config.transcode_pvrtc;
+        reinterpret_cast<vulkan::VKState *>(state.get())->async_pipeline_compilation = config.async_pipeline_compilation;
+        reinterpret_cast<vulkan::VKState *>(state.get())->pipeline_library = config.pipeline_library;
+        reinterpret_cast<vulkan::VKState *>(state.get())->merge_scenes = config.merge_scenes;
+        reinterpret_cast<vulkan::VKState *>(state.get())->transfer_queue_uploads = config.transfer_queue_uploads;
+        reinterpret_cast<vulkan::VKState *>(state.get())->fsr_upscale = config.fsr_upscale;
+        reinterpret_cast<vulkan::VKState *>(state.get())->present_mode = config.present_mode;
+        reinterpret_cast<vulkan::VKState *>(state.get())->v_sync = config.v_sync;
+        reinterpret_cast<vulkan::VKState *>(state.get())->max_frames_in_flight = config.max_frames_in_flight;
         if (!vulkan::create(window, state, base_path))
             return false;
+        texture::set_cache_limits(reinterpret_cast<vulkan::VKState *>(state.get())->texture_cache, std::max(config.texture_cache_capacity, 0), static_cast<size_t>(std::max(config.texture_cache_budget, 0)) * MiB(1));
+        if (config.async_texture_decode)
+            texture::init_async_texture_decode(reinterpret_cast<vulkan::VKState *>(state.get())->texture_cache, config.draw_previous_texture_contents);
+        state->video_capture = std::make_unique<VideoCapture>(fs::path(base_path) / "captures", config.video_capture_encoder,
+            static_cast<uint32_t>(std::max(config.video_capture_bitrate, 1)), static_cast<uint32_t>(std::max(config.video_capture_fps, 1)));
         break;
 
     default:
@@ -261,10 +339,32 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     }
 
     state->current_backend = backend;
-
-    // Can change this
-    state->command_buffer_queue.maxPendingCount_ = 30;
+    if (config.dump_shaders)
+        state->shader_dump_pool = std::make_unique<JobPool>(1);
+    if (!config.shared_shader_cache_path.empty())
+        state->shared_shader_cache = std::make_shared<SharedShaderCache>(fs::path(config.shared_shader_cache_path));
 
     return true;
 }
+
+void open_texture_disk_cache(State &state) {
+    TextureCacheState *texture_cache;
+    const char *backend_name;
+    switch (state.current_backend) {
+    case Backend::OpenGL:
+        texture_cache = &reinterpret_cast<gl::GLState &>(state).texture_cache;
+        backend_name = "gl";
+        break;
+    case Backend::Vulkan:
+        texture_cache = &reinterpret_cast<vulkan::VKState &>(state).texture_cache;
+        backend_name = "vk";
+        break;
+    default:
+        return;
+    }
+
+    // the decoded textures depend on the backend, each one has its own file
+    const auto path{ fs::path(state.base_path) / "cache/textures" / state.title_id / fmt::format("textures-{}.pack", backend_name) };
+    texture_cache->disk_cache = std::make_shared<TextureDiskCache>(path);
+}
 } // namespace renderer
@@ -0,0 +1,98 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <renderer/draw_profile.h>
+
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace renderer {
+
+static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t draw_profile_ticks() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return __rdtsc();
+#elif defined(_M_ARM64) && defined(_MSC_VER)
+    return _ReadStatusReg(ARM64_CNTVCT);
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0"
+                 : "=r"(ticks));
+    return ticks;
+#else
+    return steady_ns();
+#endif
+}
+
+// the times converted with a frequency measured a bit later can go back by a few microseconds
+static float get_delta(uint64_t value, uint64_t previous) {
+    return value > previous ? static_cast<float>(value - previous) : 0.f;
+}
+
+DrawProfile::DrawProfile()
+    : start_ticks(draw_profile_ticks())
+    , start_ns(steady_ns()) {
+}
+
+DrawProfileTotals DrawProfile::get_totals() const {
+    // the frequency gets more precise as the time since the start grows
+    const uint64_t elapsed_ticks = draw_profile_ticks() - start_ticks;
+    const uint64_t elapsed_ns = steady_ns() - start_ns;
+    const double us_per_tick = elapsed_ticks ? elapsed_ns / (elapsed_ticks * 1000.0) : 0.0;
+
+    DrawProfileTotals totals;
+    for (size_t i = 0; i < DRAW_PROFILE_STAGE_COUNT; i++)
+        totals.stage_us[i] = static_cast<uint64_t>(stage_ticks[i].load(std::memory_order_relaxed) * us_per_tick);
+    totals.frames = frames.load(std::memory_order_relaxed);
+    totals.draws = draws.load(std::memory_order_relaxed);
+    totals.state_changes = state_changes.load(std::memory_order_relaxed);
+    totals.texture_uploads = texture_uploads.load(std::memory_order_relaxed);
+    totals.upload_bytes = upload_bytes.load(std::memory_order_relaxed);
+    return totals;
+}
+
+DrawProfileSnapshot DrawProfile::get_snapshot() {
+    const std::lock_guard<std::mutex> guard(snapshot_mutex);
+    const uint64_t now = steady_ns();
+    if (snapshot_time_ns && (now - snapshot_time_ns < 1'000'000'000))
+        return snapshot;
+
+    const DrawProfileTotals totals = get_totals();
+    if (snapshot_time_ns) {
+        const uint64_t frames_count = totals.frames - snapshot_totals.frames;
+        const float per_frame = frames_count ? 1.f / frames_count : 0.f;
+        for (size_t i = 0; i < DRAW_PROFILE_STAGE_COUNT; i++)
+            snapshot.stage_us[i] = get_delta(totals.stage_us[i], snapshot_totals.stage_us[i]) * per_frame;
+        snapshot.draws = get_delta(totals.draws, snapshot_totals.draws) * per_frame;
+        snapshot.state_changes = get_delta(totals.state_changes, snapshot_totals.state_changes) * per_frame;
+        snapshot.texture_uploads = get_delta(totals.texture_uploads, snapshot_totals.texture_uploads) * per_frame;
+        snapshot.upload_bytes = get_delta(totals.upload_bytes, snapshot_totals.upload_bytes) * per_frame;
+    }
+    snapshot_time_ns = now;
+    snapshot_totals = totals;
+
+    return snapshot;
+}
+
+} // namespace renderer
@@ -0,0 +1,740 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/frame_capture.h>
+
+#include <renderer/functions.h>
+#include <renderer/state.h>
+#include <renderer/types.h>
+
+#include <gxm/functions.h>
+#include <mem/functions.h>
+#include <mem/snapshot.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <xxh3.h>
+
+namespace renderer {
+
+// 'V3KC'
+static constexpr uint32_t CAPTURE_MAGIC = 0x434B3356;
+// must be increased each time the layout of the file or of the data of a command changes
+static constexpr uint32_t CAPTURE_VERSION = 1;
+
+struct CaptureHeader {
+    uint32_t magic;
+    uint32_t version;
+    // the command data has host pointers, a capture can only be replayed by a build with the same pointer size
+    uint32_t pointer_size;
+    uint32_t render_target_count;
+    uint64_t frame;
+    uint64_t snapshot_size;
+    uint32_t memory_mapping_count;
+    uint32_t context_count;
+    uint32_t program_count;
+    uint32_t command_count;
+};
+
+template <typename T>
+static void write_value(fs::ofstream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static void write_vector(fs::ofstream &out, const std::vector<T> &values) {
+    write_value(out, static_cast<uint32_t>(values.size()));
+    out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+static bool read_value(fs::ifstream &in, T &value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template <typename T>
+static bool read_vector(fs::ifstream &in, std::vector<T> &values) {
+    uint32_t count = 0;
+    if (!read_value(in, count))
+        return false;
+    values.resize(count);
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(values.data()), count * sizeof(T)));
+}
+
+// key of the part of the state changed by a SetState command, the commands with the same key override each other
+static uint64_t get_state_key(const Command &cmd) {
+    Command copy = cmd;
+    CommandHelper helper(&copy);
+    const GXMState gxm_state = helper.pop<GXMState>();
+    uint64_t index = 0;
+    switch (gxm_state) {
+    case GXMState::Program:
+        helper.pop<Ptr<const void>>();
+        index = helper.pop<bool>();
+        break;
+    case GXMState::Texture:
+        index = helper.pop<uint32_t>();
+        break;
+    case GXMState::VertexStream:
+        helper.pop<Ptr<const void>>();
+        index = helper.pop<std::size_t>();
+        break;
+    case GXMState::UniformBuffer: {
+        helper.pop<Ptr<void>>();
+        const bool is_vertex = helper.pop<bool>();
+        index = (static_cast<uint64_t>(helper.pop<int>()) << 1) | is_vertex;
+        break;
+    }
+    case GXMState::Viewport:
+    case GXMState::DepthBias:
+    case GXMState::DepthFunc:
+    case GXMState::DepthWriteEnable:
+    case GXMState::PolygonMode:
+    case GXMState::PointLineWidth:
+    case GXMState::StencilFunc:
+    case GXMState::StencilRef:
+    case GXMState::FragmentProgramEnable:
+        // is_front, or the flat viewport
+        index = helper.pop<bool>();
+        break;
+    default:
+        break;
+    }
+
+    return (static_cast<uint64_t>(gxm_state) << 32) | index;
+}
+
+template <typename T>
+static void add_object_fixup(CaptureCommand &command, CaptureFixupKind kind, uint32_t offset, const T *object, size_t count = 1) {
+    if (!object)
+        return;
+
+    CaptureFixup &fixup = command.fixups.emplace_back();
+    fixup.kind = kind;
+    fixup.offset = static_cast<uint8_t>(offset);
+    fixup.value = static_cast<uint32_t>(count);
+    fixup.object.resize(count * sizeof(T));
+    std::memcpy(fixup.object.data(), object, fixup.object.size());
+}
+
+FrameCapture::FrameCapture(uint64_t frame, const fs::path &path)
+    : frame(frame)
+    , path(path) {
+}
+
+bool FrameCapture::record(State &state, MemState &mem, Context *context, const Command &cmd) {
+    if (!is_capturing) {
+        if ((cmd.opcode == CommandOpcode::NewFrame) && (++frames_seen == frame)) {
+            if (is_dirty_tracking(mem)) {
+                // the snapshot of the capture would be part of the chain of the incremental snapshots
+                LOG_ERROR("The frame can't be captured while the memory snapshots are incremental");
+                return true;
+            }
+            start(state, mem);
+            return false;
+        }
+
+        track(mem, context, cmd);
+        return false;
+    }
+
+    add_command(mem, context, cmd);
+    if (cmd.opcode != CommandOpcode::NewFrame)
+        return false;
+
+    if (write())
+        LOG_INFO("Frame {} captured in {}: {} commands, {} skipped", frame, path.string(), commands.size(), skipped_commands);
+    else
+        LOG_ERROR("Failed to write the frame capture {}", path.string());
+
+    return true;
+}
+
+void FrameCapture::track(MemState &mem, Context *context, const Command &cmd) {
+    switch (cmd.opcode) {
+    case CommandOpcode::SetState:
+        states[{ context, get_state_key(cmd) }] = { state_sequence++, cmd };
+        break;
+
+    case CommandOpcode::SetContext: {
+        Command copy = cmd;
+        CommandHelper helper(&copy);
+        TrackedScene &scene = scenes[context];
+        scene.render_target = helper.pop<RenderTarget *>();
+        const SceGxmColorSurface *color_surface = helper.pop<SceGxmColorSurface *>();
+        const SceGxmDepthStencilSurface *depth_stencil_surface = helper.pop<SceGxmDepthStencilSurface *>();
+        scene.has_color_surface = color_surface != nullptr;
+        if (color_surface)
+            scene.color_surface = *color_surface;
+        scene.has_depth_stencil_surface = depth_stencil_surface != nullptr;
+        if (depth_stencil_surface)
+            scene.depth_stencil_surface = *depth_stencil_surface;
+        scene.is_open = true;
+        break;
+    }
+
+    case CommandOpcode::SyncSurfaceData:
+        scenes[context].is_open = false;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void FrameCapture::start(State &state, MemState &mem) {
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    SnapshotStats stats;
+    save_snapshot(mem, out, SnapshotMode::Full, &stats);
+    snapshot = std::move(out).str();
+    LOG_INFO("Capturing the frame {}, memory snapshot of {} MiB", frame, stats.data_size >> 20);
+
+    uint32_t render_target_id = 0;
+    for (const auto &[render_target, _] : render_targets)
+        render_target_ids[render_target] = ++render_target_id;
+
+    is_capturing = true;
+
+    // set the states of the frame first, the programs are set before the other states which depend on them
+    std::vector<std::pair<Context *, const TrackedState *>> prologue;
+    std::map<std::pair<Context *, bool>, uint64_t> program_sequences;
+    for (const auto &[key, tracked] : states) {
+        prologue.emplace_back(key.first, &tracked);
+        if ((key.second >> 32) == static_cast<uint64_t>(GXMState::Program))
+            program_sequences[{ key.first, (key.second & 1) != 0 }] = tracked.sequence;
+    }
+    const auto is_program = [](const TrackedState *tracked) {
+        return tracked->cmd.data[0] == static_cast<uint8_t>(GXMState::Program);
+    };
+    std::sort(prologue.begin(), prologue.end(), [&](const auto &lhs, const auto &rhs) {
+        const bool lhs_program = is_program(lhs.second);
+        const bool rhs_program = is_program(rhs.second);
+        if (lhs_program != rhs_program)
+            return lhs_program;
+        return lhs.second->sequence < rhs.second->sequence;
+    });
+
+    for (const auto &[context, tracked] : prologue) {
+        if (tracked->cmd.data[0] == static_cast<uint8_t>(GXMState::UniformBuffer)) {
+            // the uniform buffers set before the current program was set are not used by it
+            Command copy = tracked->cmd;
+            CommandHelper helper(&copy);
+            helper.pop<GXMState>();
+            helper.pop<Ptr<void>>();
+            const bool is_vertex = helper.pop<bool>();
+            const auto program = program_sequences.find({ context, !is_vertex });
+            if ((program == program_sequences.end()) || (tracked->sequence < program->second))
+                continue;
+        }
+        add_command(mem, context, tracked->cmd);
+    }
+
+    // then start again the scenes which were not ended when the frame started
+    for (const auto &[context, scene] : scenes) {
+        if (!scene.is_open)
+            continue;
+
+        CaptureCommand &command = commands.emplace_back();
+        command.opcode = CommandOpcode::SetContext;
+        command.has_status = false;
+        command.context_id = get_context_id(context);
+        std::memset(command.data, 0, sizeof(command.data));
+        command.fixups.push_back({ CaptureFixupKind::RenderTarget, 0, get_render_target_id(scene.render_target), {} });
+        if (scene.has_color_surface)
+            add_object_fixup(command, CaptureFixupKind::ColorSurface, sizeof(void *), &scene.color_surface);
+        if (scene.has_depth_stencil_surface)
+            add_object_fixup(command, CaptureFixupKind::DepthStencilSurface, 2 * sizeof(void *), &scene.depth_stencil_surface);
+    }
+
+    states.clear();
+    scenes.clear();
+}
+
+void FrameCapture::add_command(MemState &mem, Context *context, const Command &cmd) {
+    switch (cmd.opcode) {
+    case CommandOpcode::CreateContext:
+    case CommandOpcode::DestroyContext:
+    case CommandOpcode::CreateRenderTarget:
+    case CommandOpcode::DestroyRenderTarget:
+    case CommandOpcode::MemoryMap:
+    case CommandOpcode::MemoryUnmap:
+    case CommandOpcode::Nop:
+    case CommandOpcode::WaitSyncObject:
+    case CommandOpcode::SignalSyncObject:
+        // the objects are created by the replay before the frame starts, and it doesn't synchronize with the client
+        skipped_commands++;
+        return;
+
+    default:
+        break;
+    }
+
+    CaptureCommand &command = commands.emplace_back();
+    command.opcode = cmd.opcode;
+    command.has_status = cmd.status != nullptr;
+    command.context_id = get_context_id(context);
+    std::memcpy(command.data, cmd.data, sizeof(command.data));
+
+    Command copy = cmd;
+    CommandHelper helper(&copy);
+    switch (cmd.opcode) {
+    case CommandOpcode::SetContext: {
+        const RenderTarget *render_target = helper.pop<RenderTarget *>();
+        if (render_target)
+            command.fixups.push_back({ CaptureFixupKind::RenderTarget, 0, get_render_target_id(render_target), {} });
+        const uint32_t color_offset = helper.point;
+        add_object_fixup(command, CaptureFixupKind::ColorSurface, color_offset, helper.pop<SceGxmColorSurface *>());
+        const uint32_t depth_stencil_offset = helper.point;
+        add_object_fixup(command, CaptureFixupKind::DepthStencilSurface, depth_stencil_offset, helper.pop<SceGxmDepthStencilSurface *>());
+        break;
+    }
+
+    case CommandOpcode::Draw: {
+        helper.pop<SceGxmPrimitiveType>();
+        const SceGxmIndexFormat format = helper.pop<SceGxmIndexFormat>();
+        const uint32_t indices_offset = helper.point;
+        const Address indices = Ptr<const void>(helper.pop<void *>(), mem).address();
+        const uint32_t count = helper.pop<uint32_t>();
+        command.fixups.push_back({ CaptureFixupKind::GuestPointer, static_cast<uint8_t>(indices_offset), indices, {} });
+        add_patch(mem, command, indices, count * ((format == SCE_GXM_INDEX_FORMAT_U16) ? sizeof(uint16_t) : sizeof(uint32_t)));
+        break;
+    }
+
+    case CommandOpcode::TransferCopy: {
+        helper.pop<uint32_t>();
+        helper.pop<uint32_t>();
+        helper.pop<SceGxmTransferColorKeyMode>();
+        const uint32_t images_offset = helper.point;
+        const SceGxmTransferImage *images = helper.pop<SceGxmTransferImage *>();
+        add_object_fixup(command, CaptureFixupKind::TransferImages, images_offset, images, 2);
+        if (images[0].stride > 0)
+            add_patch(mem, command, images[0].address.address(), static_cast<size_t>(images[0].stride) * (images[0].y + images[0].height));
+        break;
+    }
+
+    case CommandOpcode::TransferDownscale: {
+        const uint32_t src_offset = helper.point;
+        const SceGxmTransferImage *src = helper.pop<SceGxmTransferImage *>();
+        const uint32_t dest_offset = helper.point;
+        add_object_fixup(command, CaptureFixupKind::TransferImage, src_offset, src);
+        add_object_fixup(command, CaptureFixupKind::TransferImage, dest_offset, helper.pop<SceGxmTransferImage *>());
+        if (src->stride > 0)
+            add_patch(mem, command, src->address.address(), static_cast<size_t>(src->stride) * (src->y + src->height));
+        break;
+    }
+
+    case CommandOpcode::TransferFill: {
+        helper.pop<uint32_t>();
+        const uint32_t dest_offset = helper.point;
+        add_object_fixup(command, CaptureFixupKind::TransferImage, dest_offset, helper.pop<SceGxmTransferImage *>());
+        break;
+    }
+
+    case CommandOpcode::SyncSurfaceData:
+        if (command.has_status) {
+            helper.pop<SceGxmNotification>();
+            helper.pop<SceGxmNotification>();
+            const uint32_t surface_offset = helper.point;
+            add_object_fixup(command, CaptureFixupKind::ColorSurfaceView, surface_offset, helper.pop<SceGxmColorSurface *>());
+        }
+        break;
+
+    case CommandOpcode::SetState:
+        switch (helper.pop<GXMState>()) {
+        case GXMState::Program: {
+            const Address program = helper.pop<Ptr<const void>>().address();
+            add_program(mem, command, program, helper.pop<bool>());
+            break;
+        }
+        case GXMState::Texture: {
+            helper.pop<uint32_t>();
+            const SceGxmTexture texture = helper.pop<SceGxmTexture>();
+            add_patch(mem, command, texture.data_addr << 2, texture::texture_size(texture));
+            break;
+        }
+        case GXMState::VertexStream: {
+            const Address stream = helper.pop<Ptr<const void>>().address();
+            helper.pop<std::size_t>();
+            add_patch(mem, command, stream, helper.pop<std::size_t>());
+            break;
+        }
+        case GXMState::UniformBuffer: {
+            const Address buffer = helper.pop<Ptr<void>>().address();
+            helper.pop<bool>();
+            helper.pop<int>();
+            add_patch(mem, command, buffer, helper.pop<uint32_t>());
+            break;
+        }
+        default:
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void FrameCapture::add_patch(MemState &mem, CaptureCommand &command, Address addr, size_t size) {
+    if (!size || !is_valid_addr_range(mem, addr, addr + size))
+        return;
+
+    // only save the ranges whose content changed since they were last saved
+    const uint64_t hash = XXH_INLINE_XXH3_64bits(&mem.memory[addr], size);
+    const auto [range, inserted] = saved_ranges.try_emplace({ addr, size }, hash);
+    if (!inserted && (range->second == hash))
+        return;
+    range->second = hash;
+
+    CapturePatch &patch = command.patches.emplace_back();
+    patch.addr = addr;
+    patch.data.assign(&mem.memory[addr], &mem.memory[addr] + size);
+}
+
+void FrameCapture::add_program(MemState &mem, CaptureCommand &command, Address addr, bool is_fragment) {
+    if (!programs.contains(addr)) {
+        CaptureProgram &program = programs[addr];
+        program.addr = addr;
+        program.is_fragment = is_fragment;
+        program.has_blend = false;
+        if (is_fragment) {
+            const SceGxmFragmentProgram &fragment_program = *Ptr<const SceGxmFragmentProgram>(addr).get(mem);
+            program.program = fragment_program.program.address();
+            program.is_maskupdate = fragment_program.is_maskupdate;
+            if (fragment_program.renderer_data->blend) {
+                program.has_blend = true;
+                program.blend = *fragment_program.renderer_data->blend;
+            }
+        } else {
+            const SceGxmVertexProgram &vertex_program = *Ptr<const SceGxmVertexProgram>(addr).get(mem);
+            program.program = vertex_program.program.address();
+            program.is_maskupdate = false;
+            program.streams = vertex_program.streams;
+            program.attributes = vertex_program.attributes;
+        }
+    }
+
+    // the gxp program can be allocated after the snapshot
+    const Address gxp_program = programs[addr].program;
+    add_patch(mem, command, gxp_program, Ptr<const SceGxmProgram>(gxp_program).get(mem)->size);
+}
+
+uint16_t FrameCapture::get_context_id(Context *context) {
+    const auto [id, _] = context_ids.try_emplace(context, static_cast<uint16_t>(context_ids.size()));
+    return id->second;
+}
+
+uint32_t FrameCapture::get_render_target_id(const RenderTarget *render_target) {
+    const auto id = render_target_ids.find(render_target);
+    if (id == render_target_ids.end()) {
+        LOG_WARN_LIMITED("A render target used by the frame was created before the capture, it is not replayed");
+        return 0;
+    }
+
+    return id->second;
+}
+
+void FrameCapture::add_render_target(const RenderTarget *render_target, const SceGxmRenderTargetParams &params) {
+    render_targets[render_target] = params;
+}
+
+void FrameCapture::remove_render_target(const RenderTarget *render_target) {
+    render_targets.erase(render_target);
+}
+
+void FrameCapture::add_memory_mapping(Address addr, uint32_t size) {
+    memory_mappings[addr] = size;
+}
+
+void FrameCapture::remove_memory_mapping(Address addr) {
+    memory_mappings.erase(addr);
+}
+
+bool FrameCapture::write() const {
+    fs::create_directories(path.parent_path());
+    fs::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    const CaptureHeader header{
+        .magic = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+        .pointer_size = sizeof(void *),
+        .render_target_count = static_cast<uint32_t>(render_targets.size()),
+        .frame = frame,
+        .snapshot_size = snapshot.size(),
+        .memory_mapping_count = static_cast<uint32_t>(memory_mappings.size()),
+        .context_count = static_cast<uint32_t>(context_ids.size()),
+        .program_count = static_cast<uint32_t>(programs.size()),
+        .command_count = static_cast<uint32_t>(commands.size()),
+    };
+    write_value(out, header);
+    out.write(snapshot.data(), snapshot.size());
+
+    // in the order of their ids
+    for (const auto &[render_target, params] : render_targets)
+        write_value(out, params);
+
+    for (const auto &[addr, size] : memory_mappings) {
+        write_value(out, addr);
+        write_value(out, size);
+    }
+
+    for (const auto &[_, program] : programs) {
+        write_value(out, program.addr);
+        write_value(out, program.is_fragment);
+        write_value(out, program.program);
+        write_value(out, program.is_maskupdate);
+        write_value(out, program.has_blend);
+        write_value(out, program.blend);
+        write_vector(out, program.streams);
+        write_vector(out, program.attributes);
+    }
+
+    for (const CaptureCommand &command : commands) {
+        write_value(out, command.opcode);
+        write_value(out, command.has_status);
+        write_value(out, command.context_id);
+        write_value(out, command.data);
+        write_value(out, static_cast<uint32_t>(command.fixups.size()));
+        for (const CaptureFixup &fixup : command.fixups) {
+            write_value(out, fixup.kind);
+            write_value(out, fixup.offset);
+            write_value(out, fixup.value);
+            write_vector(out, fixup.object);
+        }
+        write_value(out, static_cast<uint32_t>(command.patches.size()));
+        for (const CapturePatch &patch : command.patches) {
+            write_value(out, patch.addr);
+            write_vector(out, patch.data);
+        }
+    }
+
+    return static_cast<bool>(out);
+}
+
+// the ranges allocated after the snapshot are allocated page by page when their content is restored
+static void allocate_range(MemState &mem, Address addr, size_t size) {
+    const size_t first_page = addr / mem.page_size;
+    const size_t last_page = (addr + size - 1) / mem.page_size;
+    for (size_t page = first_page; page <= last_page; page++) {
+        if (!is_valid_addr(mem, page * mem.page_size))
+            try_alloc_at(mem, page * mem.page_size, mem.page_size, "capture");
+    }
+}
+
+bool FrameReplay::load(State &state, MemState &mem, Config &config, const fs::path &path) {
+    fs::ifstream in(path, std::ios::in | std::ios::binary);
+    CaptureHeader header;
+    if (!in || !read_value(in, header) || (header.magic != CAPTURE_MAGIC)) {
+        LOG_ERROR("{} is not a frame capture", path.string());
+        return false;
+    }
+    if ((header.version != CAPTURE_VERSION) || (header.pointer_size != sizeof(void *))) {
+        LOG_ERROR("The frame capture {} was written by another version of Vita3K", path.string());
+        return false;
+    }
+    frame = header.frame;
+
+    std::string snapshot(header.snapshot_size, '\0');
+    if (!in.read(snapshot.data(), snapshot.size()))
+        return false;
+    std::istringstream snapshot_in(std::move(snapshot), std::ios::in | std::ios::binary);
+    if (!load_snapshot(mem, snapshot_in)) {
+        LOG_ERROR("Failed to restore the memory of the frame capture");
+        return false;
+    }
+
+    int status = 0;
+    render_targets.resize(header.render_target_count);
+    for (std::unique_ptr<RenderTarget> &render_target : render_targets) {
+        SceGxmRenderTargetParams params;
+        if (!read_value(in, params))
+            return false;
+        process(state, mem, config, make_command(new Command, CommandOpcode::CreateRenderTarget, &status, &render_target, &params), nullptr);
+    }
+
+    memory_mappings.resize(header.memory_mapping_count);
+    for (auto &[addr, size] : memory_mappings) {
+        if (!read_value(in, addr) || !read_value(in, size))
+            return false;
+        process(state, mem, config, make_command(new Command, CommandOpcode::MemoryMap, &status, Ptr<void>(addr), size), nullptr);
+    }
+
+    contexts.resize(header.context_count);
+    for (std::unique_ptr<Context> &context : contexts)
+        process(state, mem, config, make_command(new Command, CommandOpcode::CreateContext, &status, &context), nullptr);
+
+    for (uint32_t i = 0; i < header.program_count; i++) {
+        CaptureProgram program;
+        if (!read_value(in, program.addr) || !read_value(in, program.is_fragment) || !read_value(in, program.program)
+            || !read_value(in, program.is_maskupdate) || !read_value(in, program.has_blend) || !read_value(in, program.blend)
+            || !read_vector(in, program.streams) || !read_vector(in, program.attributes))
+            return false;
+        programs[program.addr] = std::move(program);
+    }
+
+    commands.resize(header.command_count);
+    for (CaptureCommand &command : commands) {
+        uint32_t fixup_count = 0;
+        if (!read_value(in, command.opcode) || !read_value(in, command.has_status) || !read_value(in, command.context_id)
+            || !read_value(in, command.data) || !read_value(in, fixup_count))
+            return false;
+        command.fixups.resize(fixup_count);
+        for (CaptureFixup &fixup : command.fixups) {
+            if (!read_value(in, fixup.kind) || !read_value(in, fixup.offset) || !read_value(in, fixup.value) || !read_vector(in, fixup.object))
+                return false;
+        }
+
+        uint32_t patch_count = 0;
+        if (!read_value(in, patch_count))
+            return false;
+        command.patches.resize(patch_count);
+        for (CapturePatch &patch : command.patches) {
+            if (!read_value(in, patch.addr) || !read_vector(in, patch.data))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+static T *copy_object(const CaptureFixup &fixup) {
+    T *object = new T[fixup.object.size() / sizeof(T)];
+    std::memcpy(object, fixup.object.data(), fixup.object.size());
+    return object;
+}
+
+void FrameReplay::replay(State &state, MemState &mem, Config &config) {
+    int status = 0;
+    for (const CaptureCommand &command : commands) {
+        apply_patches(mem, command);
+
+        Command *cmd = new Command;
+        cmd->opcode = command.opcode;
+        cmd->status = command.has_status ? &status : nullptr;
+        std::memcpy(cmd->data, command.data, sizeof(cmd->data));
+        for (const CaptureFixup &fixup : command.fixups) {
+            void *pointer = nullptr;
+            switch (fixup.kind) {
+            case CaptureFixupKind::GuestPointer:
+                pointer = fixup.value ? &mem.memory[fixup.value] : nullptr;
+                break;
+            case CaptureFixupKind::RenderTarget:
+                pointer = (fixup.value && (fixup.value <= render_targets.size())) ? render_targets[fixup.value - 1].get() : nullptr;
+                break;
+            // the handlers delete these objects, as the ones allocated by the client
+            case CaptureFixupKind::ColorSurface:
+                pointer = new SceGxmColorSurface(*reinterpret_cast<const SceGxmColorSurface *>(fixup.object.data()));
+                break;
+            case CaptureFixupKind::DepthStencilSurface:
+                pointer = new SceGxmDepthStencilSurface(*reinterpret_cast<const SceGxmDepthStencilSurface *>(fixup.object.data()));
+                break;
+            case CaptureFixupKind::TransferImage:
+                pointer = new SceGxmTransferImage(*reinterpret_cast<const SceGxmTransferImage *>(fixup.object.data()));
+                break;
+            case CaptureFixupKind::TransferImages:
+                pointer = copy_object<SceGxmTransferImage>(fixup);
+                break;
+            case CaptureFixupKind::ColorSurfaceView:
+                pointer = surface_views.emplace_back(std::make_unique<SceGxmColorSurface>(*reinterpret_cast<const SceGxmColorSurface *>(fixup.object.data()))).get();
+                break;
+            }
+            std::memcpy(cmd->data + fixup.offset, &pointer, sizeof(pointer));
+        }
+
+        // the host data of the programs of SceGxm is created the first time they are used
+        if (command.opcode == CommandOpcode::SetState) {
+            CommandHelper helper(cmd);
+            if (helper.pop<GXMState>() == GXMState::Program)
+                create_program(state, mem, helper.pop<Ptr<const void>>().address());
+        }
+
+        process(state, mem, config, cmd, (command.context_id < contexts.size()) ? contexts[command.context_id].get() : nullptr);
+    }
+}
+
+void FrameReplay::destroy(State &state, MemState &mem, Config &config) {
+    int status = 0;
+    for (const auto &[addr, _] : program_infos) {
+        if (programs[addr].is_fragment)
+            Ptr<SceGxmFragmentProgram>(addr).get(mem)->~SceGxmFragmentProgram();
+        else
+            Ptr<SceGxmVertexProgram>(addr).get(mem)->~SceGxmVertexProgram();
+    }
+    program_infos.clear();
+
+    for (std::unique_ptr<Context> &context : contexts)
+        process(state, mem, config, make_command(new Command, CommandOpcode::DestroyContext, &status, &context), nullptr);
+    for (std::unique_ptr<RenderTarget> &render_target : render_targets)
+        process(state, mem, config, make_command(new Command, CommandOpcode::DestroyRenderTarget, &status, &render_target), nullptr);
+    for (const auto &[addr, _] : memory_mappings)
+        process(state, mem, config, make_command(new Command, CommandOpcode::MemoryUnmap, &status, Ptr<void>(addr)), nullptr);
+
+    contexts.clear();
+    render_targets.clear();
+    memory_mappings.clear();
+    surface_views.clear();
+}
+
+void FrameReplay::process(State &state, MemState &mem, Config &config, Command *cmd, Context *context) {
+    CommandList command_list{ cmd, cmd, context };
+    process_batch(state, state.features, mem, config, command_list);
+}
+
+void FrameReplay::apply_patches(MemState &mem, const CaptureCommand &command) {
+    for (const CapturePatch &patch : command.patches) {
+        allocate_range(mem, patch.addr, patch.data.size());
+        // let the protections know the pages are written, the caches of their content get invalidated
+        prepare_host_access(mem, patch.addr, patch.data.size(), true);
+        std::memcpy(&mem.memory[patch.addr], patch.data.data(), patch.data.size());
+    }
+}
+
+void FrameReplay::create_program(State &state, MemState &mem, Address addr) {
+    const auto program = programs.find(addr);
+    if (program == programs.end() || program_infos.contains(addr))
+        return;
+
+    const CaptureProgram &captured = program->second;
+    const SceGxmProgram &gxp_program = *Ptr<const SceGxmProgram>(captured.program).get(mem);
+    std::shared_ptr<const gxp::ProgramInfo> info = gxp::parse_program_info(gxp_program);
+
+    // the objects in the guest memory have the host pointers of the captured session, they are created again in place
+    if (captured.is_fragment) {
+        allocate_range(mem, addr, sizeof(SceGxmFragmentProgram));
+        SceGxmFragmentProgram *fragment_program = new (Ptr<SceGxmFragmentProgram>(addr).get(mem)) SceGxmFragmentProgram;
+        fragment_program->program = Ptr<const SceGxmProgram>(captured.program);
+        fragment_program->is_maskupdate = captured.is_maskupdate;
+        renderer::create(fragment_program->renderer_data, state, *info, captured.has_blend ? &captured.blend : nullptr, state.gxp_ptr_map, state.base_path, state.title_id);
+    } else {
+        allocate_range(mem, addr, sizeof(SceGxmVertexProgram));
+        SceGxmVertexProgram *vertex_program = new (Ptr<SceGxmVertexProgram>(addr).get(mem)) SceGxmVertexProgram;
+        vertex_program->program = Ptr<const SceGxmProgram>(captured.program);
+        vertex_program->streams = captured.streams;
+        vertex_program->attributes = captured.attributes;
+        renderer::create(vertex_program->renderer_data, state, *info, state.gxp_ptr_map, state.base_path, state.title_id);
+    }
+
+    program_infos[addr] = std::move(info);
+}
+
+} // namespace renderer
@@ -16,6 +16,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <renderer/profile.h>
+#include <renderer/shader_pack.h>
 #include <renderer/shaders.h>
 #include <renderer/types.h>
 
@@ -28,12 +29,24 @@
 #include <shader/spirv_recompiler.h>
 
 #include <gxm/functions.h>
+#include <chrono>
+#include <cstring>
 #include <vector>
 
-namespace renderer::gl {
-static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
-    R_PROFILE(__func__);
+// not part of glad, from GL_ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_ARB
+#define GL_COMPLETION_STATUS_ARB 0x91B1
+#endif
 
+namespace renderer::gl {
+// number of programs given at the same time to a driver supporting parallel shader compile
+static constexpr size_t MAX_PRECOMPILING_PROGRAMS = 256;
+// time spent at most each frame on the programs of the shaders cache, so the progress can still be drawn
+static constexpr std::chrono::milliseconds PRECOMPILE_FRAME_BUDGET(12);
+// record of the program binary pack holding the driver id and the shaders version the binaries were made with
+static constexpr const char *PROGRAM_BINARY_DRIVER_RECORD = "driver";
+
+static SharedGLObject start_glsl_compile(GLenum type, const std::string &source) {
     const SharedGLObject shader = std::make_shared<GLObject>();
     if (!shader->init(glCreateShader(type), glDeleteShader)) {
         return SharedGLObject();
@@ -45,22 +58,34 @@ static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
 
     glCompileShader(shader->get());
 
+    return shader;
+}
+
+// wait for the shader to be compiled if the driver compiles it on another thread
+static bool check_shader_compiled(const GLObject &shader) {
     GLint log_length = 0;
-    glGetShaderiv(shader->get(), GL_INFO_LOG_LENGTH, &log_length);
+    glGetShaderiv(shader.get(), GL_INFO_LOG_LENGTH, &log_length);
 
     // Intel driver returns an info log length of at least 1 even if it is empty.
     if (log_length > 1) {
         std::vector<GLchar> log;
         log.resize(log_length);
-        glGetShaderInfoLog(shader->get(), log_length, nullptr, log.data());
+        glGetShaderInfoLog(shader.get(), log_length, nullptr, log.data());
 
         LOG_ERROR("{}", log.data());
     }
 
     GLint is_compiled = GL_FALSE;
-    glGetShaderiv(shader->get(), GL_COMPILE_STATUS, &is_compiled);
+    glGetShaderiv(shader.get(), GL_COMPILE_STATUS, &is_compiled);
     assert(is_compiled != GL_FALSE);
-    if (!is_compiled) {
+    return is_compiled != GL_FALSE;
+}
+
+static SharedGLObject compile_glsl(GLenum type, const std::string &source) {
+    R_PROFILE(__func__);
+
+    const SharedGLObject shader = start_glsl_compile(type, source);
+    if (!shader || !check_shader_compiled(*shader)) {
         return SharedGLObject();
     }
 
@@ -84,22 +109,7 @@ static SharedGLObject compile_spirv(GLenum type, const std::vector<std::uint32_t
     glShaderBinary(1, need_compile, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, source_glchar, length);
     glSpecializeShaderARB(need_compile[0], shader_entry, 0, nullptr, nullptr);
 
-    GLint log_length = 0;
-    glGetShaderiv(shader->get(), GL_INFO_LOG_LENGTH, &log_length);
-
-    // Intel driver returns an info log length of at least 1 even if it is empty.
-    if (log_length > 1) {
-        std::vector<GLchar> log;
-        log.resize(log_length);
-        glGetShaderInfoLog(shader->get(), log_length, nullptr, log.data());
-
-        LOG_ERROR("{}", log.data());
-    }
-
-    GLint is_compiled = GL_FALSE;
-    glGetShaderiv(shader->get(), GL_COMPILE_STATUS, &is_compiled);
-    assert(is_compiled != GL_FALSE);
-    if (!is_compiled) {
+    if (!check_shader_compiled(*shader)) {
         return SharedGLObject();
     }
 
@@ -116,16 +126,97 @@ static std::string convert_hash_to_hex(const Sha256Hash &hash) {
     return ss.str();
 }
 
-static SharedGLObject compile_program(ProgramCache &program_cache, const SharedGLObject frag_shader, const SharedGLObject vert_shader, const ProgramHashes &hashes) {
+static std::string get_program_binary_name(const ProgramHashes &hashes) {
+    return convert_hash_to_hex(std::get<0>(hashes)) + "-" + convert_hash_to_hex(std::get<1>(hashes));
+}
+
+void open_program_binary_pack(GLState &renderer, const fs::path &shaders_path) {
+    renderer.program_binary_pack.reset();
+    if (renderer.driver_id.empty())
+        return;
+
+    const std::string driver_id = renderer.shader_version + "|" + renderer.driver_id;
+    const fs::path pack_path = shaders_path / "programs-gl.pack";
+    renderer.program_binary_pack = std::make_shared<ShaderPack>(pack_path);
+
+    const std::span<const uint8_t> pack_driver_id = renderer.program_binary_pack->read(PROGRAM_BINARY_DRIVER_RECORD);
+    if (std::string(pack_driver_id.begin(), pack_driver_id.end()) == driver_id)
+        return;
+
+    if (!pack_driver_id.empty())
+        LOG_INFO("The graphics driver or the shaders changed, the program binaries will be made again");
+
+    renderer.program_binary_pack.reset();
+    fs::remove(pack_path);
+    renderer.program_binary_pack = std::make_shared<ShaderPack>(pack_path);
+    renderer.program_binary_pack->store(PROGRAM_BINARY_DRIVER_RECORD, driver_id.data(), driver_id.size());
+}
+
+// the record is made of the binary format followed by the binary
+static SharedGLObject load_program_binary(GLState &renderer, const ProgramHashes &hashes) {
+    if (!renderer.program_binary_pack)
+        return SharedGLObject();
+
+    const std::span<const uint8_t> record = renderer.program_binary_pack->read(get_program_binary_name(hashes));
+    if (record.size() <= sizeof(GLenum))
+        return SharedGLObject();
+
+    const SharedGLObject program = std::make_shared<GLObject>();
+    if (!program->init(glCreateProgram(), glDeleteProgram)) {
+        return SharedGLObject();
+    }
+
+    GLenum format;
+    std::memcpy(&format, record.data(), sizeof(format));
+    glProgramBinary(program->get(), format, record.data() + sizeof(format), static_cast<GLsizei>(record.size() - sizeof(format)));
+
+    // the driver can still refuse a binary it made, the program is then compiled from the shaders
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program->get(), GL_LINK_STATUS, &is_linked);
+    if (is_linked == GL_FALSE)
+        return SharedGLObject();
+
+    renderer.program_cache.emplace(hashes, program);
+
+    return program;
+}
+
+static void save_program_binary(GLState &renderer, const GLObject &program, const ProgramHashes &hashes) {
+    if (!renderer.program_binary_pack)
+        return;
+
+    GLint binary_size = 0;
+    glGetProgramiv(program.get(), GL_PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0)
+        return;
+
+    std::vector<uint8_t> record(sizeof(GLenum) + binary_size);
+    GLenum format = 0;
+    GLsizei written_size = 0;
+    glGetProgramBinary(program.get(), binary_size, &written_size, &format, record.data() + sizeof(GLenum));
+    if (written_size <= 0)
+        return;
+
+    std::memcpy(record.data(), &format, sizeof(format));
+    renderer.program_binary_pack->store(get_program_binary_name(hashes), record.data(), sizeof(GLenum) + written_size);
+}
+
+static SharedGLObject start_program_link(const SharedGLObject &frag_shader, const SharedGLObject &vert_shader) {
     const SharedGLObject program = std::make_shared<GLObject>();
     if (!program->init(glCreateProgram(), glDeleteProgram)) {
         return SharedGLObject();
     }
 
+    glProgramParameteri(program->get(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(program->get(), frag_shader->get());
     glAttachShader(program->get(), vert_shader->get());
     glLinkProgram(program->get());
 
+    return program;
+}
+
+// wait for the program to be linked if the driver links it on another thread
+static bool finish_program_link(GLState &renderer, const SharedGLObject &program, const SharedGLObject &frag_shader, const SharedGLObject &vert_shader, const ProgramHashes &hashes) {
     GLint log_length = 0;
     glGetProgramiv(program->get(), GL_INFO_LOG_LENGTH, &log_length);
 
@@ -142,31 +233,46 @@ static SharedGLObject compile_program(ProgramCache &program_cache, const SharedG
     glGetProgramiv(program->get(), GL_LINK_STATUS, &is_linked);
     assert(is_linked != GL_FALSE);
     if (is_linked == GL_FALSE) {
-        return SharedGLObject();
+        return false;
     }
 
     glDetachShader(program->get(), frag_shader->get());
     glDetachShader(program->get(), vert_shader->get());
 
-    program_cache.emplace(hashes, program);
+    renderer.program_cache.emplace(hashes, program);
+    save_program_binary(renderer, *program, hashes);
+
+    return true;
+}
+
+static SharedGLObject compile_program(GLState &renderer, const SharedGLObject frag_shader, const SharedGLObject vert_shader, const ProgramHashes &hashes) {
+    const SharedGLObject program = start_program_link(frag_shader, vert_shader);
+    if (!program || !finish_program_link(renderer, program, frag_shader, vert_shader, hashes)) {
+        return SharedGLObject();
+    }
 
     return program;
 }
 
-static SharedGLObject compile_shader(const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, const std::string &hash_hex,
-    const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash) {
+static SharedGLObject start_shader_compile(GLState &renderer, const std::string &hash_hex, const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash) {
+    // the shader may be used by a program precompiled before
+    const auto cached = cache.find(hash);
+    if (cached != cache.end()) {
+        return cached->second;
+    }
+
     // Set Shader version with hash
-    const std::string hash_hex_ver = shader_version + "-" + hash_hex;
+    const std::string hash_hex_ver = renderer.shader_version + "-" + hash_hex;
 
     // Load Shader
-    const std::string shader = pre_load_shader_glsl(hash_hex_ver.c_str(), type_str, base_path, title_id, self_name);
+    const std::string shader = pre_load_shader_glsl(hash_hex_ver.c_str(), type_str, renderer.base_path, renderer.title_id, renderer.self_name, renderer.shader_pack.get());
     if (shader.empty()) {
         LOG_WARN("{} shader is empty or not found:\n{}", type_str, hash_hex);
         return SharedGLObject();
     }
 
-    // Compile Shader
-    const SharedGLObject obj = compile_glsl(type, shader);
+    // Compile Shader, its status is checked with the one of the program
+    const SharedGLObject obj = start_glsl_compile(type, shader);
     if (!obj) {
         LOG_CRITICAL("Error in compile {} shader:\n{}", type_str, hash_hex);
         return SharedGLObject();
@@ -174,7 +280,6 @@ static SharedGLObject compile_shader(const char *base_path, const char *title_id
 
     // Push shader Compiled
     cache.emplace(hash, obj);
-    LOG_INFO("{} shader compiled: {}", type_str, hash_hex);
 
     return obj;
 }
@@ -187,49 +292,104 @@ static std::vector<ShadersHash>::iterator get_shaders_hash_index(std::vector<Sha
     return shader_hash_index;
 }
 
-void pre_compile_program(GLState &renderer, const char *base_path, const char *title_id, const char *self_name, const ShadersHash &hash) {
-    const auto shader_path{ fs::path(base_path) / "cache/shaders" / title_id / self_name };
-    if (fs::exists(shader_path) && !fs::is_empty(shader_path)) {
-        // Compile Fragment Shader
-        const auto frag_hash_hex = convert_hash_to_hex(hash.frag);
-        const SharedGLObject frag_shader = compile_shader(base_path, title_id, self_name, renderer.shader_version,
-            frag_hash_hex, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag);
-        if (!frag_shader) {
-            return;
-        }
-
-        // Compile Vertex Shader
-        const auto vert_hash_hex = convert_hash_to_hex(hash.vert);
-        const SharedGLObject vert_shader = compile_shader(base_path, title_id, self_name, renderer.shader_version,
-            vert_hash_hex, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert);
-        if (!vert_shader) {
-            return;
-        }
+static void start_pre_compile_program(GLState &renderer, const ShadersHash &hash) {
+    const auto shader_path{ fs::path(renderer.base_path) / "cache/shaders" / renderer.title_id / renderer.self_name };
+    if (!fs::exists(shader_path) || fs::is_empty(shader_path)) {
+        return;
+    }
 
-        // Compile Program
-        const ProgramHashes hashes(hash.frag, hash.vert);
-        compile_program(renderer.program_cache, frag_shader, vert_shader, hashes);
+    // the program was linked by this driver on a previous boot
+    if (load_program_binary(renderer, ProgramHashes(hash.frag, hash.vert))) {
         renderer.programs_count_pre_compiled++;
-        LOG_INFO("Program Compiled {}/{}", renderer.programs_count_pre_compiled, renderer.shaders_cache_hashs.size());
+        return;
+    }
+
+    // Compile Fragment Shader
+    const auto frag_hash_hex = convert_hash_to_hex(hash.frag);
+    const SharedGLObject frag_shader = start_shader_compile(renderer, frag_hash_hex, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag);
+    if (!frag_shader) {
+        return;
+    }
+
+    // Compile Vertex Shader
+    const auto vert_hash_hex = convert_hash_to_hex(hash.vert);
+    const SharedGLObject vert_shader = start_shader_compile(renderer, vert_hash_hex, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert);
+    if (!vert_shader) {
+        return;
+    }
+
+    // Compile Program
+    const SharedGLObject program = start_program_link(frag_shader, vert_shader);
+    if (!program) {
+        return;
+    }
+
+    renderer.precompiling_programs.push_back({ ProgramHashes(hash.frag, hash.vert), frag_shader, vert_shader, program });
+}
+
+static void finish_pre_compile_program(GLState &renderer, const PrecompilingProgram &precompiling) {
+    const bool is_compiled = check_shader_compiled(*precompiling.frag_shader) && check_shader_compiled(*precompiling.vert_shader)
+        && finish_program_link(renderer, precompiling.program, precompiling.frag_shader, precompiling.vert_shader, precompiling.hashes);
+    if (!is_compiled) {
+        // the shaders must not be used by the programs compiled later
+        renderer.fragment_shader_cache.erase(std::get<0>(precompiling.hashes));
+        renderer.vertex_shader_cache.erase(std::get<1>(precompiling.hashes));
+        LOG_CRITICAL("Error in compile program:\n{}", convert_hash_to_hex(std::get<0>(precompiling.hashes)));
+        return;
     }
+
+    renderer.programs_count_pre_compiled++;
+    LOG_INFO("Program Compiled {}/{}", renderer.programs_count_pre_compiled, renderer.shaders_cache_hashs.size());
+}
+
+bool update_pre_compiled_programs(GLState &renderer) {
+    const auto deadline = std::chrono::steady_clock::now() + PRECOMPILE_FRAME_BUDGET;
+    const bool is_parallel = renderer.features.support_parallel_shader_compile;
+    // without parallel shader compile the driver does all the work when the status is checked, so the programs are done one by one
+    const size_t max_precompiling = is_parallel ? MAX_PRECOMPILING_PROGRAMS : 1;
+
+    do {
+        while (!renderer.precompile_queue.empty() && renderer.precompiling_programs.size() < max_precompiling) {
+            start_pre_compile_program(renderer, renderer.precompile_queue.front());
+            renderer.precompile_queue.pop_front();
+        }
+
+        const size_t finished_count = std::erase_if(renderer.precompiling_programs, [&](const PrecompilingProgram &precompiling) {
+            if (is_parallel) {
+                GLint is_completed = GL_FALSE;
+                glGetProgramiv(precompiling.program->get(), GL_COMPLETION_STATUS_ARB, &is_completed);
+                if (is_completed == GL_FALSE)
+                    return false;
+            }
+
+            finish_pre_compile_program(renderer, precompiling);
+            return true;
+        });
+
+        // the driver is still busy with all the programs given to it
+        if (finished_count == 0)
+            break;
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    return renderer.precompile_queue.empty() && renderer.precompiling_programs.empty();
 }
 
-static SharedGLObject get_or_compile_shader(const SceGxmProgram *program, const FeatureState &features, const Sha256Hash &hash,
-    ShaderCache &cache, const GLenum type, const shader::Hints &hints, bool shader_cache, bool spirv, bool maskupdate, const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, uint32_t &shaders_count_compiled) {
+static SharedGLObject get_or_compile_shader(GLState &renderer, const SceGxmProgram *program, const FeatureState &features, const Sha256Hash &hash,
+    ShaderCache &cache, const GLenum type, const shader::Hints &hints, bool shader_cache, bool spirv, bool maskupdate) {
     const auto cached = cache.find(hash);
     if (cached == cache.end()) {
         SharedGLObject obj = nullptr;
 
         // Need to compile new one and add it to cache
         if (features.spirv_shader && spirv) {
-            obj = compile_spirv(type, load_spirv_shader(*program, features, false, hints, maskupdate, base_path, title_id, self_name, shader_version + "spv", shader_cache));
+            obj = compile_spirv(type, load_spirv_shader(renderer, *program, hash, features, false, hints, maskupdate, renderer.shader_version + "spv", shader_cache));
         } else {
-            obj = compile_glsl(type, load_glsl_shader(*program, features, hints, maskupdate, base_path, title_id, self_name, shader_version, shader_cache));
+            obj = compile_glsl(type, load_glsl_shader(renderer, *program, hash, features, hints, maskupdate, renderer.shader_version, shader_cache));
         }
 
         cache.emplace(hash, obj);
 
-        shaders_count_compiled++;
+        renderer.shaders_count_compiled++;
 
         return obj;
     }
@@ -238,7 +398,7 @@ static SharedGLObject get_or_compile_shader(const SceGxmProgram *program, const
 }
 
 SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmRecordState &state, const FeatureState &features, const MemState &mem,
-    bool shader_cache, bool spirv, bool maskupdate, const char *base_path, const char *title_id, const char *self_name) {
+    bool shader_cache, bool spirv, bool maskupdate) {
     R_PROFILE(__func__);
 
     assert(state.fragment_program);
@@ -261,6 +421,12 @@ SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmR
         return cached->second;
     }
 
+    // it may have been linked on a previous boot without being in the shaders cache
+    if (shader_cache) {
+        if (const SharedGLObject program = load_program_binary(renderer, hashes))
+            return program;
+    }
+
     // No... It doesn't exist. Now we try to find each object. If it doesn't exist then we can kind
     // of compile it again.
 
@@ -268,23 +434,23 @@ SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmR
     context.shader_hints.color_format = state.color_surface.colorFormat;
     context.shader_hints.attributes = &vertex_program_gxm.attributes;
 
-    const SharedGLObject fragment_shader = get_or_compile_shader(fragment_program_gxm.program.get(mem), features, fragment_program.hash, renderer.fragment_shader_cache,
-        GL_FRAGMENT_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, base_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled);
+    const SharedGLObject fragment_shader = get_or_compile_shader(renderer, fragment_program_gxm.program.get(mem), features, fragment_program.hash, renderer.fragment_shader_cache,
+        GL_FRAGMENT_SHADER, context.shader_hints, shader_cache, spirv, maskupdate);
 
     if (!fragment_shader) {
         LOG_CRITICAL("Error in get/compile fragment vertex shader:\n{}", hex_string(fragment_program.hash));
         return SharedGLObject();
     }
 
-    const SharedGLObject vertex_shader = get_or_compile_shader(vertex_program_gxm.program.get(mem), features, vertex_program.hash, renderer.vertex_shader_cache,
-        GL_VERTEX_SHADER, context.shader_hints, shader_cache, spirv, maskupdate, base_path, title_id, self_name, renderer.shader_version, renderer.shaders_count_compiled);
+    const SharedGLObject vertex_shader = get_or_compile_shader(renderer, vertex_program_gxm.program.get(mem), features, vertex_program.hash, renderer.vertex_shader_cache,
+        GL_VERTEX_SHADER, context.shader_hints, shader_cache, spirv, maskupdate);
 
     if (!vertex_shader) {
         LOG_CRITICAL("Error in get/compiled vertex shader:\n{}", hex_string(vertex_program.hash));
         return SharedGLObject();
     }
 
-    const SharedGLObject program = compile_program(renderer.program_cache, fragment_shader, vertex_shader, hashes);
+    const SharedGLObject program = compile_program(renderer, fragment_shader, vertex_shader, hashes);
 
     // Save shader cache haches
     const auto shader_cache_hash_index = get_shaders_hash_index(renderer.shaders_cache_hashs, fragment_program.hash, vertex_program.hash);
@@ -27,6 +27,7 @@
 #include <sstream>
 
 #include <gxm/types.h>
+#include <mem/util.h>
 #include <util/log.h>
 
 #include <shader/spirv_recompiler.h>
@@ -58,6 +59,53 @@ static GLenum translate_primitive(SceGxmPrimitiveType primType) {
     return GL_TRIANGLES;
 }
 
+// keeps a batch well under a segment of the index ring buffer so that it never waits for draws it contains
+static constexpr std::size_t MAX_BATCH_INDEX_BYTES = MiB(1);
+
+static void ring_buffers_draw_call_done(GLContext &context) {
+    context.vertex_stream_ring_buffer.draw_call_done();
+    context.index_stream_ring_buffer.draw_call_done();
+    context.vertex_uniform_stream_ring_buffer.draw_call_done();
+    context.fragment_uniform_stream_ring_buffer.draw_call_done();
+    context.vertex_info_uniform_buffer.draw_call_done();
+    context.fragment_info_uniform_buffer.draw_call_done();
+}
+
+void flush_draw_batch(GLContext &context) {
+    DrawBatch &batch = context.draw_batch;
+    if (batch.commands.empty())
+        return;
+
+    const std::size_t index_size = (batch.index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+    const std::size_t commands_size = batch.commands.size() * sizeof(DrawElementsIndirectCommand);
+
+    // compiling the program of the draw which ends the batch may have changed these
+    glUseProgram(batch.program);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_stream_ring_buffer.handle());
+
+    std::pair<std::uint8_t *, std::size_t> indirect_ptr{ nullptr, 0 };
+    if (batch.commands.size() > 1) {
+        indirect_ptr = context.draw_indirect_buffer.allocate(commands_size);
+        LOG_ERROR_IF(!indirect_ptr.first, "Failed to allocate draw indirect ring buffer data from GPU!");
+    }
+
+    if (indirect_ptr.first) {
+        std::memcpy(indirect_ptr.first, batch.commands.data(), commands_size);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, context.draw_indirect_buffer.handle());
+        glMultiDrawElementsIndirect(batch.mode, batch.index_type, reinterpret_cast<const void *>(indirect_ptr.second), static_cast<GLsizei>(batch.commands.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        context.draw_indirect_buffer.draw_call_done();
+    } else {
+        for (const DrawElementsIndirectCommand &command : batch.commands)
+            glDrawElements(batch.mode, static_cast<GLsizei>(command.count), batch.index_type, reinterpret_cast<const void *>(command.first_index * index_size));
+    }
+
+    ring_buffers_draw_call_done(context);
+
+    batch.commands.clear();
+    batch.index_bytes = 0;
+}
+
 void draw(GLState &renderer, GLContext &context, const FeatureState &features, SceGxmPrimitiveType type, SceGxmIndexFormat format, void *indices, size_t count, uint32_t instance_count,
     MemState &mem, const char *base_path, const char *title_id, const char *self_name, const Config &config) {
     R_PROFILE(__func__);
@@ -67,12 +115,14 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
     const SceGxmFragmentProgram &gxm_fragment_program = *context.record.fragment_program.get(mem);
     const SceGxmProgram &fragment_program_gxp = *gxm_fragment_program.program.get(mem);
     const auto &gl_frag_program = reinterpret_cast<gl::GLFragmentProgram *>(gxm_fragment_program.renderer_data.get());
+    const auto &gl_vert_program = reinterpret_cast<gl::GLVertexProgram *>(context.record.vertex_program.get(mem)->renderer_data.get());
 
     // Trying to cache: the last time vs this time shader pair. Does it different somehow?
     // If it's different, we need to switch. Else just stick to it.
     if (context.record.vertex_program.get(mem)->renderer_data->hash != context.last_draw_vertex_program_hash || context.record.fragment_program.get(mem)->renderer_data->hash != context.last_draw_fragment_program_hash) {
         // Need to recompile!
-        SharedGLObject program = gl::compile_program(renderer, context, context.record, features, mem, config.shader_cache, config.spirv_shader, gxm_fragment_program.is_maskupdate, base_path, title_id, self_name);
+        const DrawProfileScope profile_scope(&renderer.draw_profile, DRAW_PROFILE_PIPELINE);
+        SharedGLObject program = gl::compile_program(renderer, context, context.record, features, mem, config.shader_cache, config.spirv_shader, gxm_fragment_program.is_maskupdate);
 
         LOG_ERROR_IF(!program, "Fail to get program!");
 
@@ -97,13 +147,59 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
         glGetIntegerv(GL_CURRENT_PROGRAM, reinterpret_cast<GLint *>(&program_id));
     }
 
-    glUseProgram(program_id);
-
     const bool use_raw_image = renderer.features.preserve_f16_nan_as_u16 && color::is_write_surface_stored_rawly(gxm::get_base_format(context.record.color_surface.colorFormat));
 
     const SceGxmColorBaseFormat base_format = gxm::get_base_format(context.record.color_surface.colorFormat);
     const GLenum surface_format = color::translate_internal_format(base_format);
 
+    shader::RenderVertUniformBlock &vert_ublock = context.current_vert_render_info;
+    vert_ublock.viewport_flip = context.record.viewport_flip;
+    vert_ublock.viewport_flag = (context.record.viewport_flat) ? 0.0f : 1.0f;
+    vert_ublock.z_offset = context.record.z_offset;
+    vert_ublock.z_scale = context.record.z_scale;
+    vert_ublock.screen_width = static_cast<float>(context.record.color_surface.width);
+    vert_ublock.screen_height = static_cast<float>(context.record.color_surface.height);
+
+    shader::RenderFragUniformBlock &frag_ublock = context.current_frag_render_info;
+    const bool both_side_fragment_program_disabled = (context.record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED)
+        && ((context.record.back_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) || (context.record.two_sided == SCE_GXM_TWO_SIDED_DISABLED));
+    if (both_side_fragment_program_disabled) {
+        frag_ublock.front_disabled = 0.0f;
+        frag_ublock.back_disabled = 0.0f;
+    } else {
+        frag_ublock.front_disabled = (context.record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) ? 1.0f : 0.0f;
+        if (context.record.two_sided == SCE_GXM_TWO_SIDED_DISABLED)
+            frag_ublock.back_disabled = frag_ublock.front_disabled;
+        else
+            frag_ublock.back_disabled = (context.record.back_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) ? 1.0f : 0.0f;
+    }
+    frag_ublock.writing_mask = context.record.writing_mask;
+    frag_ublock.use_raw_image = static_cast<float>(use_raw_image);
+    frag_ublock.res_multiplier = renderer.res_multiplier;
+
+    const bool vert_info_changed = context.render_info_dirty || memcmp(&context.previous_vert_info, &vert_ublock, sizeof(shader::RenderVertUniformBlock)) != 0;
+    const bool frag_info_changed = context.render_info_dirty || memcmp(&context.previous_frag_info, &frag_ublock, sizeof(shader::RenderFragUniformBlock)) != 0;
+
+    const GLenum mode = translate_primitive(type);
+    const GLenum gl_type = format == SCE_GXM_INDEX_FORMAT_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const GLsizeiptr index_size = (format == SCE_GXM_INDEX_FORMAT_U16) ? 2 : 4;
+    const std::size_t index_buffer_size = index_size * count;
+
+    // Draws which change the GL state or need a barrier are submitted on their own
+    const bool can_batch = (instance_count == 1) && !context.record.is_maskupdate && !both_side_fragment_program_disabled
+        && !fragment_program_gxp.is_native_color() && context.self_sampling_indices.empty() && (index_buffer_size <= MAX_BATCH_INDEX_BYTES);
+
+    // All the state set by a batched draw is the same as the one of the batch, the commands changing it flush the batch first
+    DrawBatch &batch = context.draw_batch;
+    const bool append_to_batch = can_batch && !batch.commands.empty() && (batch.program == program_id) && (batch.mode == mode) && (batch.index_type == gl_type)
+        && (batch.index_bytes + index_buffer_size <= MAX_BATCH_INDEX_BYTES) && !vert_info_changed && !frag_info_changed
+        && !uniform_buffers_changed(context, *gl_vert_program, *gl_frag_program) && can_reuse_vertex_streams(context, context.record);
+
+    if (!append_to_batch)
+        flush_draw_batch(context);
+
+    glUseProgram(program_id);
+
     if (fragment_program_gxp.is_frag_color_used() && features.is_programmable_blending_need_to_bind_color_attachment()) {
         if (use_raw_image) {
             glBindImageTexture(shader::COLOR_ATTACHMENT_RAW_TEXTURE_SLOT_IMAGE, context.current_color_attachment, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16UI);
@@ -115,15 +211,7 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
     }
     glBindImageTexture(shader::MASK_TEXTURE_SLOT_IMAGE, context.render_target->masktexture[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
 
-    shader::RenderVertUniformBlock &vert_ublock = context.current_vert_render_info;
-    vert_ublock.viewport_flip = context.record.viewport_flip;
-    vert_ublock.viewport_flag = (context.record.viewport_flat) ? 0.0f : 1.0f;
-    vert_ublock.z_offset = context.record.z_offset;
-    vert_ublock.z_scale = context.record.z_scale;
-    vert_ublock.screen_width = static_cast<float>(context.record.color_surface.width);
-    vert_ublock.screen_height = static_cast<float>(context.record.color_surface.height);
-
-    if (memcmp(&context.previous_vert_info, &vert_ublock, sizeof(shader::RenderVertUniformBlock)) != 0) {
+    if (vert_info_changed) {
         std::pair<std::uint8_t *, std::size_t> allocated_buffer = context.vertex_info_uniform_buffer.allocate(sizeof(shader::RenderVertUniformBlock));
         std::memcpy(allocated_buffer.first, &vert_ublock, sizeof(shader::RenderVertUniformBlock));
 
@@ -132,19 +220,8 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
         glBindBufferRange(GL_UNIFORM_BUFFER, 2, context.vertex_info_uniform_buffer.handle(), allocated_buffer.second, sizeof(shader::RenderVertUniformBlock));
     }
 
-    shader::RenderFragUniformBlock &frag_ublock = context.current_frag_render_info;
-    const bool both_side_fragment_program_disabled = (context.record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED)
-        && ((context.record.back_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) || (context.record.two_sided == SCE_GXM_TWO_SIDED_DISABLED));
     if (both_side_fragment_program_disabled) {
-        frag_ublock.front_disabled = 0.0f;
-        frag_ublock.back_disabled = 0.0f;
         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-    } else {
-        frag_ublock.front_disabled = (context.record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) ? 1.0f : 0.0f;
-        if (context.record.two_sided == SCE_GXM_TWO_SIDED_DISABLED)
-            frag_ublock.back_disabled = frag_ublock.front_disabled;
-        else
-            frag_ublock.back_disabled = (context.record.back_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED) ? 1.0f : 0.0f;
     }
 
     if (context.record.is_maskupdate) {
@@ -154,11 +231,8 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
 
         glBindFramebuffer(GL_FRAMEBUFFER, context.render_target->maskbuffer[0]);
     }
-    frag_ublock.writing_mask = context.record.writing_mask;
-    frag_ublock.use_raw_image = static_cast<float>(use_raw_image);
-    frag_ublock.res_multiplier = renderer.res_multiplier;
 
-    if (memcmp(&context.previous_frag_info, &frag_ublock, sizeof(shader::RenderFragUniformBlock)) != 0) {
+    if (frag_info_changed) {
         std::pair<std::uint8_t *, std::size_t> allocated_buffer = context.fragment_info_uniform_buffer.allocate(sizeof(shader::RenderFragUniformBlock));
         std::memcpy(allocated_buffer.first, &frag_ublock, sizeof(shader::RenderFragUniformBlock));
 
@@ -166,23 +240,30 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
 
         glBindBufferRange(GL_UNIFORM_BUFFER, 3, context.fragment_info_uniform_buffer.handle(), allocated_buffer.second, sizeof(shader::RenderFragUniformBlock));
     }
+    context.render_info_dirty = false;
 
-    // Upload vertex stream
-    sync_vertex_streams_and_attributes(context, context.record, mem);
+    {
+        const DrawProfileScope profile_scope(&renderer.draw_profile, DRAW_PROFILE_DESCRIPTORS);
+        upload_uniform_buffers(context, *gl_vert_program, *gl_frag_program);
+    }
 
-    // Upload index data.
-    const GLsizeiptr index_size = (format == SCE_GXM_INDEX_FORMAT_U16) ? 2 : 4;
-    const std::size_t index_buffer_size = index_size * count;
+    std::pair<std::uint8_t *, std::size_t> index_gpu_ptr;
+    {
+        const DrawProfileScope profile_scope(&renderer.draw_profile, DRAW_PROFILE_VERTEX_INDEX);
+        // Upload vertex stream
+        sync_vertex_streams_and_attributes(context, context.record, mem);
+
+        // Upload index data.
+        index_gpu_ptr = context.index_stream_ring_buffer.allocate(index_buffer_size);
+        if (!index_gpu_ptr.first) {
+            LOG_ERROR("Failed to allocate index stream ring buffer data from GPU!");
+            return;
+        }
 
-    std::pair<std::uint8_t *, std::size_t> index_gpu_ptr = context.index_stream_ring_buffer.allocate(index_buffer_size);
-    if (!index_gpu_ptr.first) {
-        LOG_ERROR("Failed to allocate index stream ring buffer data from GPU!");
-        return;
+        std::memcpy(index_gpu_ptr.first, indices, index_buffer_size);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_stream_ring_buffer.handle());
     }
 
-    std::memcpy(index_gpu_ptr.first, indices, index_buffer_size);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.index_stream_ring_buffer.handle());
-
     if (fragment_program_gxp.is_native_color()) {
         if (features.should_use_shader_interlock() && !config.spirv_shader) {
             glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
@@ -204,9 +285,22 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
         }
     }
 
+    context.last_draw_vertex_program_hash = context.record.vertex_program.get(mem)->renderer_data->hash;
+    context.last_draw_fragment_program_hash = context.record.fragment_program.get(mem)->renderer_data->hash;
+
     // Draw.
-    const GLenum mode = translate_primitive(type);
-    const GLenum gl_type = format == SCE_GXM_INDEX_FORMAT_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (can_batch) {
+        // the draw is submitted with the next ones using the same state
+        if (batch.commands.empty()) {
+            batch.program = program_id;
+            batch.mode = mode;
+            batch.index_type = gl_type;
+        }
+
+        batch.commands.push_back({ static_cast<GLuint>(count), 1, static_cast<GLuint>(index_gpu_ptr.second / static_cast<std::size_t>(index_size)), 0, 0 });
+        batch.index_bytes += index_buffer_size;
+        return;
+    }
 
     if (instance_count == 1) {
         glDrawElements(mode, static_cast<GLsizei>(count), gl_type, reinterpret_cast<const void *>(index_gpu_ptr.second));
@@ -225,16 +319,6 @@ void draw(GLState &renderer, GLContext &context, const FeatureState &features, S
         sync_blending(context.record, mem);
     }
 
-    context.last_draw_vertex_program_hash = context.record.vertex_program.get(mem)->renderer_data->hash;
-    context.last_draw_fragment_program_hash = context.record.fragment_program.get(mem)->renderer_data->hash;
-
-    context.vertex_stream_ring_buffer.draw_call_done();
-    context.index_stream_ring_buffer.draw_call_done();
-    context.vertex_uniform_stream_ring_buffer.draw_call_done();
-    context.fragment_uniform_stream_ring_buffer.draw_call_done();
-    context.vertex_info_uniform_buffer.draw_call_done();
-    context.fragment_info_uniform_buffer.draw_call_done();
-
-    clear_previous_uniform_storage(context);
+    ring_buffers_draw_call_done(context);
 }
 } // namespace renderer::gl
@@ -43,6 +43,7 @@ void Fence::insert() {
     }
 
     sync_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    signaled_ = false;
     if (!sync_) {
         LOG_ERROR("Unable to create fence sync object!");
     }
@@ -102,4 +103,23 @@ bool Fence::wait_for_signal() {
     return signaled_;
 }
 
+bool Fence::is_signaled() {
+    if (signaled_ || !sync_)
+        return true;
+
+    GLint length = 0;
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(sync_, GL_SYNC_STATUS, 1, &length, &status);
+
+    return status == GL_SIGNALED;
+}
+
+void Fence::reset() {
+    if (sync_) {
+        glDeleteSync(sync_);
+        sync_ = nullptr;
+    }
+    signaled_ = false;
+}
+
 } // namespace renderer::gl
@@ -43,12 +43,13 @@
 namespace renderer::gl {
 
 GLContext::GLContext()
-    : vertex_stream_ring_buffer(GL_ARRAY_BUFFER, MiB(128))
-    , index_stream_ring_buffer(GL_ELEMENT_ARRAY_BUFFER, MiB(64))
-    , vertex_uniform_stream_ring_buffer(GL_SHADER_STORAGE_BUFFER, MiB(256))
-    , fragment_uniform_stream_ring_buffer(GL_SHADER_STORAGE_BUFFER, MiB(256))
-    , vertex_info_uniform_buffer(GL_UNIFORM_BUFFER, MiB(8))
-    , fragment_info_uniform_buffer(GL_UNIFORM_BUFFER, MiB(8)) {
+    : vertex_stream_ring_buffer(GL_ARRAY_BUFFER, MiB(64), MiB(512))
+    , index_stream_ring_buffer(GL_ELEMENT_ARRAY_BUFFER, MiB(32), MiB(256))
+    , vertex_uniform_stream_ring_buffer(GL_SHADER_STORAGE_BUFFER, MiB(128), MiB(1024))
+    , fragment_uniform_stream_ring_buffer(GL_SHADER_STORAGE_BUFFER, MiB(128), MiB(1024))
+    , vertex_info_uniform_buffer(GL_UNIFORM_BUFFER, MiB(4), MiB(32))
+    , fragment_info_uniform_buffer(GL_UNIFORM_BUFFER, MiB(4), MiB(32))
+    , draw_indirect_buffer(GL_DRAW_INDIRECT_BUFFER, MiB(1), MiB(8)) {
     std::memset(&previous_vert_info, 0, sizeof(shader::RenderVertUniformBlock));
     std::memset(&previous_frag_info, 0, sizeof(shader::RenderFragUniformBlock));
 }
@@ -131,6 +132,9 @@ static GLenum translate_blend_factor(SceGxmBlendFactor src) {
 void bind_fundamental(GLContext &context) {
     // Bind the vertex array and element buffer.
     glBindVertexArray(context.vertex_array[0]);
+
+    // the buffer bindings may point to the data of another context
+    invalidate_uploaded_data(context);
 }
 
 static void after_callback(const char *name, void *funcptr, int len_args, ...) {
@@ -221,6 +225,14 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const char *base_
     gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress);
     glad_set_post_callback(after_callback);
 
+    // the synced surfaces are written to the guest memory by another thread, which needs its own context to wait for the copies
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    gl_state.readback_context = GLContextPtr(SDL_GL_CreateContext(window), SDL_GL_DeleteContext);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(window, gl_state.context.get());
+    gl_state.window = window;
+    LOG_WARN_IF(!gl_state.readback_context, "Could not create the surface readback context, the surfaces will be synced synchronously: {}", SDL_GetError());
+
     // Detect GPU and features
     const std::string gpu_name = reinterpret_cast<const GLchar *>(glGetString(GL_RENDERER));
     const std::string version = reinterpret_cast<const GLchar *>(glGetString(GL_SHADING_LANGUAGE_VERSION));
@@ -244,7 +256,9 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const char *base_
         { "GL_EXT_shader_framebuffer_fetch", &gl_state.features.direct_fragcolor },
         { "GL_ARB_gl_spirv", &gl_state.features.spirv_shader },
         { "GL_ARB_get_texture_sub_image", &gl_state.features.support_get_texture_sub_image },
-        { "GL_EXT_shader_image_load_formatted", &gl_state.features.support_unknown_format }
+        { "GL_EXT_shader_image_load_formatted", &gl_state.features.support_unknown_format },
+        { "GL_ARB_parallel_shader_compile", &gl_state.features.support_parallel_shader_compile },
+        { "GL_KHR_parallel_shader_compile", &gl_state.features.support_parallel_shader_compile }
     };
 
     for (int i = 0; i < total_extensions; i++) {
@@ -269,6 +283,22 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const char *base_
         LOG_WARN("Consider updating your graphics drivers or upgrading your GPU.");
     }
 
+    if (gl_state.features.support_parallel_shader_compile) {
+        // glad was generated without this extension, let the driver choose how many threads it uses
+        typedef void(APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+        auto max_shader_compiler_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSPROC>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB"));
+        if (!max_shader_compiler_threads)
+            max_shader_compiler_threads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSPROC>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if (max_shader_compiler_threads)
+            max_shader_compiler_threads(0xFFFFFFFF);
+        LOG_INFO("Your GPU supports parallel shader compile, the shaders cache will be compiled on multiple threads.");
+    }
+
+    GLint program_binary_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &program_binary_formats);
+    if (program_binary_formats > 0)
+        gl_state.driver_id = fmt::format("{}|{}|{}", reinterpret_cast<const char *>(glGetString(GL_VENDOR)), gpu_name, reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+
     // always enabled in the opengl renderer
     gl_state.features.use_mask_bit = true;
 
@@ -277,6 +307,7 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const char *base_
 
 bool GLState::init(const char *base_path, const bool hashless_texture_cache) {
     texture_cache.backend = &current_backend;
+    texture_cache.draw_profile = &draw_profile;
     if (!texture::init(texture_cache, hashless_texture_cache)) {
         LOG_ERROR("Failed to initialize texture cache!");
         return false;
@@ -287,7 +318,7 @@ bool GLState::init(const char *base_path, const bool hashless_texture_cache) {
         return false;
     }
 
-    shader_version = fmt::format("v{}", shader::CURRENT_VERSION);
+    shader_version = fmt::format("v{}{}", shader::CURRENT_VERSION, features.optimize_spirv ? "-opt" : "");
 
     return true;
 }
@@ -458,7 +489,8 @@ static std::map<SceGxmColorFormat, std::pair<GLenum, GLenum>> GXM_COLOR_FORMAT_T
     { SCE_GXM_COLOR_FORMAT_SE5M9M9M9_RGB, { GL_BGR, GL_HALF_FLOAT } }
 };
 
-static bool format_need_temp_storage(const GLState &state, SceGxmColorSurface &surface, std::vector<std::uint8_t> &storage, const std::uint32_t width, const std::uint32_t height) {
+// size of the storage the surface must be read to before being written to the guest memory, 0 if it can be read there directly
+static size_t get_temp_storage_size(const GLState &state, const SceGxmColorSurface &surface, const std::uint32_t width, const std::uint32_t height) {
     size_t needed_pixels;
     if (state.res_multiplier == 1) {
         needed_pixels = surface.strideInPixels * height;
@@ -467,17 +499,22 @@ static bool format_need_temp_storage(const GLState &state, SceGxmColorSurface &s
         needed_pixels = width * height;
     }
 
-    if ((surface.colorFormat == SCE_GXM_COLOR_FORMAT_SE5M9M9M9_BGR) || (surface.colorFormat == SCE_GXM_COLOR_FORMAT_SE5M9M9M9_RGB)) {
-        storage.resize(needed_pixels * 3 * 2); // RGB and half float
-        return true;
-    }
+    if ((surface.colorFormat == SCE_GXM_COLOR_FORMAT_SE5M9M9M9_BGR) || (surface.colorFormat == SCE_GXM_COLOR_FORMAT_SE5M9M9M9_RGB))
+        return needed_pixels * 3 * 2; // RGB and half float
 
-    if (state.res_multiplier > 1) {
-        storage.resize(needed_pixels * gxm::bits_per_pixel(gxm::get_base_format(surface.colorFormat)) >> 3);
-        return true;
-    }
+    if (state.res_multiplier > 1)
+        return needed_pixels * gxm::bits_per_pixel(gxm::get_base_format(surface.colorFormat)) >> 3;
 
-    return false;
+    return 0;
+}
+
+static bool format_need_temp_storage(const GLState &state, SceGxmColorSurface &surface, std::vector<std::uint8_t> &storage, const std::uint32_t width, const std::uint32_t height) {
+    const size_t size = get_temp_storage_size(state, surface, width, height);
+    if (size == 0)
+        return false;
+
+    storage.resize(size);
+    return true;
 }
 
 static void post_process_pixels_data(GLState &renderer, std::uint32_t *pixels, std::uint8_t *source, std::uint32_t width, std::uint32_t height, const std::uint32_t stride,
@@ -546,8 +583,23 @@ static void post_process_pixels_data(GLState &renderer, std::uint32_t *pixels, s
     }
 }
 
+static void wait_for_readback(SurfaceReadbackSlot &slot) {
+    if (!slot.readback)
+        return;
+
+    slot.readback->wait();
+    slot.readback = nullptr;
+}
+
+// the readbacks still pending would overwrite the surfaces synced synchronously with older content
+static void wait_for_all_readbacks(GLState &renderer) {
+    for (SurfaceReadbackSlot &slot : renderer.readback_slots)
+        wait_for_readback(slot);
+}
+
 void lookup_and_get_surface_data(GLState &renderer, MemState &mem, SceGxmColorSurface &surface) {
     std::uint32_t swizzle = 0;
+    wait_for_all_readbacks(renderer);
 
     GLint tex_handle = static_cast<GLint>(renderer.surface_cache.retrieve_color_surface_texture_handle(renderer, static_cast<std::uint16_t>(surface.width),
         static_cast<std::uint16_t>(surface.height), static_cast<std::uint16_t>(surface.strideInPixels),
@@ -620,6 +672,7 @@ void get_surface_data(GLState &renderer, GLContext &context, uint32_t *pixels, S
     if (pixels == nullptr) {
         return;
     }
+    wait_for_all_readbacks(renderer);
 
     SceGxmColorFormat format = surface.colorFormat;
     uint32_t width = surface.width;
@@ -667,6 +720,122 @@ void get_surface_data(GLState &renderer, GLContext &context, uint32_t *pixels, S
     ++renderer.texture_cache.timestamp;
 }
 
+bool request_surface_readback(GLState &renderer, GLContext &context, MemState &mem, SceGxmColorSurface &surface) {
+    R_PROFILE(__func__);
+
+    if (!renderer.readback_context || !surface.data)
+        return false;
+
+    const auto format_gl = GXM_COLOR_FORMAT_TO_GL_FORMAT.find(surface.colorFormat);
+    if (format_gl == GXM_COLOR_FORMAT_TO_GL_FORMAT.end()) {
+        LOG_ERROR("Color format not implemented: {}, report this to developer", surface.colorFormat);
+        return true;
+    }
+
+    const uint32_t width = surface.width * renderer.res_multiplier;
+    const uint32_t height = surface.height * renderer.res_multiplier;
+    const uint32_t row_length = (renderer.res_multiplier == 1) ? surface.strideInPixels : width;
+    const uint32_t guest_size = static_cast<uint32_t>(height / renderer.res_multiplier * gxm::get_stride_in_bytes(surface.colorFormat, surface.strideInPixels));
+    const size_t temp_size = get_temp_storage_size(renderer, surface, width, height);
+    const size_t buffer_size = temp_size ? temp_size : gxm::get_stride_in_bytes(surface.colorFormat, row_length) * height;
+
+    // the oldest readback must be written before its buffer is used again
+    SurfaceReadbackSlot &slot = renderer.readback_slots[renderer.next_readback_slot];
+    renderer.next_readback_slot = (renderer.next_readback_slot + 1) % GLState::SURFACE_READBACK_SLOTS;
+    wait_for_readback(slot);
+
+    if (slot.capacity < buffer_size) {
+        if (slot.buffer) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, buffer_size, nullptr, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        slot.mapped_data = reinterpret_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer_size, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+        slot.capacity = slot.mapped_data ? buffer_size : 0;
+        if (!slot.mapped_data) {
+            LOG_ERROR("Failed to map the surface readback buffer to host!");
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            return false;
+        }
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    }
+
+    // the copy is written to the buffer bound to GL_PIXEL_PACK_BUFFER, at its start
+    glPixelStorei(GL_PACK_ROW_LENGTH, static_cast<GLint>(row_length));
+    const SceGxmColorBaseFormat base_format = gxm::get_base_format(surface.colorFormat);
+    if (renderer.features.preserve_f16_nan_as_u16 && color::is_write_surface_stored_rawly(base_format)) {
+        // we can't get the content of raw textures with glReadPixels
+        GLint last_texture = 0;
+
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+        glBindTexture(GL_TEXTURE_2D, context.current_color_attachment);
+        glGetTexImage(GL_TEXTURE_2D, 0, color::get_raw_store_upload_format_type(base_format), color::get_raw_store_upload_data_type(base_format), nullptr);
+        glBindTexture(GL_TEXTURE_2D, last_texture);
+    } else {
+        glReadPixels(0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height), format_gl->second.first, format_gl->second.second, nullptr);
+    }
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    auto readback = std::make_shared<SurfaceReadback>();
+    readback->surface = surface;
+    readback->width = width;
+    readback->height = height;
+    readback->address = surface.data.address();
+    readback->size = guest_size;
+    readback->data = slot.mapped_data;
+    readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // the readback thread can't flush the commands of this context
+    glFlush();
+
+    // the guest only has to wait for the readback if it accesses the surface before it is written
+    protect_surface_readback(mem, readback);
+
+    if (!renderer.readback_thread.joinable())
+        renderer.readback_thread = std::thread(&GLState::readback_thread_function, &renderer, std::ref(mem));
+    slot.readback = readback;
+    renderer.readback_queue.push(std::move(readback));
+
+    ++renderer.texture_cache.timestamp;
+    return true;
+}
+
+void GLState::readback_thread_function(MemState &mem) {
+    SDL_GL_MakeCurrent(window, readback_context.get());
+
+    while (true) {
+        auto request = readback_queue.pop();
+        if (!request)
+            break;
+
+        SurfaceReadback &readback = **request;
+        if (readback.fence) {
+            // wait by steps of a millisecond, the driver may not wake up a thread waiting without a timeout
+            while (glClientWaitSync(readback.fence, 0, 1'000'000) == GL_TIMEOUT_EXPIRED) {
+            }
+            glDeleteSync(readback.fence);
+        }
+
+        write_surface_readback(mem, readback, [&](uint8_t *dest) {
+            uint32_t *pixels = reinterpret_cast<uint32_t *>(dest);
+            std::vector<std::uint8_t> storage_v;
+            if (format_need_temp_storage(*this, readback.surface, storage_v, readback.width, readback.height)) {
+                memcpy(storage_v.data(), readback.data, storage_v.size());
+                post_process_pixels_data(*this, pixels, storage_v.data(), readback.width, readback.height, readback.surface.strideInPixels, readback.surface);
+            } else {
+                memcpy(pixels, readback.data, readback.size);
+                post_process_pixels_data(*this, pixels, reinterpret_cast<uint8_t *>(pixels), readback.width, readback.height, readback.surface.strideInPixels, readback.surface);
+            }
+        });
+    }
+
+    SDL_GL_MakeCurrent(window, nullptr);
+}
+
 void GLState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
     const GxmState &gxm, MemState &mem) {
     should_display = false;
@@ -742,6 +911,27 @@ void GLState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
     screen_renderer.render(viewport_pos, viewport_size, need_uv ? uvs : nullptr, static_cast<GLuint>(surface_handle), texture_size);
 }
 
+void new_frame(GLState &state, GLContext &context) {
+    flush_draw_batch(context);
+
+    context.vertex_stream_ring_buffer.new_frame();
+    context.index_stream_ring_buffer.new_frame();
+    context.vertex_uniform_stream_ring_buffer.new_frame();
+    context.fragment_uniform_stream_ring_buffer.new_frame();
+    context.vertex_info_uniform_buffer.new_frame();
+    context.fragment_info_uniform_buffer.new_frame();
+    context.draw_indirect_buffer.new_frame();
+
+    // the ring buffers may have been re-created, the next draw can't use the data uploaded before
+    invalidate_uploaded_data(context);
+
+    state.ring_buffer_stalls = context.vertex_stream_ring_buffer.stall_count() + context.index_stream_ring_buffer.stall_count()
+        + context.vertex_uniform_stream_ring_buffer.stall_count() + context.fragment_uniform_stream_ring_buffer.stall_count()
+        + context.vertex_info_uniform_buffer.stall_count() + context.fragment_info_uniform_buffer.stall_count()
+        + context.draw_indirect_buffer.stall_count();
+    renderer::texture::publish_frame_stats(state.texture_cache, state);
+}
+
 void GLState::swap_window(SDL_Window *window) {
     SDL_GL_SwapWindow(window);
 }
@@ -761,9 +951,27 @@ void GLState::set_anisotropic_filtering(int anisotropic_filtering) {
 }
 
 void GLState::precompile_shader(const ShadersHash &hash) {
-    pre_compile_program(*this, base_path, title_id, self_name, hash);
+    precompile_queue.push_back(hash);
+}
+
+bool GLState::update_precompiled_shaders() {
+    return update_pre_compiled_programs(*this);
 }
 
-void GLState::preclose_action() {}
+void GLState::preclose_action() {
+    readback_queue.abort();
+    if (readback_thread.joinable())
+        readback_thread.join();
+
+    for (SurfaceReadbackSlot &slot : readback_slots) {
+        if (slot.buffer) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glDeleteBuffers(1, &slot.buffer);
+            slot = {};
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
 } // namespace renderer::gl
@@ -19,28 +19,38 @@
 // I (pent0) mostly rewritten to understand it, other contributors in future can see the rpcs3 code.
 
 #include <renderer/gl/ring_buffer.h>
+#include <mem/util.h>
 #include <util/align.h>
 #include <util/log.h>
 
+#include <algorithm>
+
 namespace renderer::gl {
 
-RingBuffer::RingBuffer(GLenum purpose, const std::size_t capacity)
-    : base_(nullptr)
+RingBuffer::RingBuffer(GLenum purpose, const std::size_t capacity, const std::size_t max_capacity)
+    : buffer_(0)
+    , base_(nullptr)
     , cursor_(0)
     , capacity_(capacity)
+    , segment_size_(capacity / SEGMENT_COUNT)
+    , current_segment_(0)
+    , segments_to_fence_(0)
+    , frame_consumption_(0)
+    , max_frame_consumption_(0)
+    , max_capacity_(std::max(capacity, max_capacity))
+    , stall_count_(0)
     , purpose_(purpose) {
-    buffer_.init(reinterpret_cast<renderer::Generator *>(glGenBuffers), reinterpret_cast<renderer::Deleter *>(glDeleteBuffers));
 }
 
 RingBuffer::~RingBuffer() {
-    if (base_) {
-        glBindBuffer(purpose_, buffer_[0]);
-        glUnmapBuffer(purpose_);
-    }
+    destroy();
 }
 
 void RingBuffer::create_and_map() {
-    glBindBuffer(purpose_, buffer_[0]);
+    if (!buffer_)
+        glGenBuffers(1, &buffer_);
+
+    glBindBuffer(purpose_, buffer_);
     glBufferStorage(purpose_, capacity_, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
 
     base_ = reinterpret_cast<std::uint8_t *>(glMapBufferRange(purpose_, 0, capacity_, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
@@ -50,6 +60,46 @@ void RingBuffer::create_and_map() {
     }
 }
 
+void RingBuffer::destroy() {
+    if (base_) {
+        glBindBuffer(purpose_, buffer_);
+        glUnmapBuffer(purpose_);
+        base_ = nullptr;
+    }
+
+    if (buffer_) {
+        // the storage is kept by the driver until the draws using it are done
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+
+    for (Fence &fence : segment_fences_)
+        fence.reset();
+
+    cursor_ = 0;
+    current_segment_ = 0;
+    segments_to_fence_ = 0;
+}
+
+void RingBuffer::enter_segment(const std::size_t segment) {
+    const std::uint32_t segment_bit = 1U << segment;
+    if (segments_to_fence_ & segment_bit) {
+        // the draw being recorded is using the whole ring buffer
+        LOG_ERROR("The ring buffer is too small for a single draw call!");
+        glFinish();
+        segments_to_fence_ &= ~segment_bit;
+        return;
+    }
+
+    Fence &fence = segment_fences_[segment];
+    if (fence.empty())
+        return;
+
+    if (!fence.is_signaled())
+        stall_count_++;
+    fence.wait_for_signal();
+}
+
 std::pair<std::uint8_t *, std::size_t> RingBuffer::allocate(const std::size_t data_size) {
     if (!base_) {
         create_and_map();
@@ -59,28 +109,48 @@ std::pair<std::uint8_t *, std::size_t> RingBuffer::allocate(const std::size_t da
     }
 
     std::size_t offset = align(cursor_, 256);
-
-    if ((offset + data_size) >= capacity_) {
-        if (!safe_segment_consumed_fence_.empty()) {
-            safe_segment_consumed_fence_.wait_for_signal();
-        } else {
-            LOG_ERROR("Sync fence has not been inserted but the size of the ring buffer has already reached full!");
-            glFinish();
-        }
-
+    const bool wrap = (offset + data_size) > capacity_;
+    if (wrap)
         offset = 0;
-        cursor_ = 0;
+
+    // wait for the segments the data is about to overwrite
+    const std::size_t last_segment = std::min((offset + std::max<std::size_t>(data_size, 1) - 1) / segment_size_, SEGMENT_COUNT - 1);
+    if (wrap || current_segment_ != last_segment) {
+        do {
+            segments_to_fence_ |= 1U << current_segment_;
+            current_segment_ = (current_segment_ + 1) % SEGMENT_COUNT;
+            enter_segment(current_segment_);
+        } while (current_segment_ != last_segment);
     }
 
     cursor_ = align(offset + data_size, 256);
+    frame_consumption_ += cursor_ - offset;
     return std::make_pair(base_ + offset, offset);
 }
 
 void RingBuffer::draw_call_done() {
-    // Insert a fence when the buffer has been consumed about 25% (same as RPCS3)
-    if (safe_segment_consumed_fence_.empty() && (cursor_ >= (capacity_ >> 2))) {
-        safe_segment_consumed_fence_.insert();
+    for (std::size_t segment = 0; segment < SEGMENT_COUNT; segment++) {
+        if (segments_to_fence_ & (1U << segment))
+            segment_fences_[segment].insert();
     }
+    segments_to_fence_ = 0;
+}
+
+void RingBuffer::new_frame() {
+    max_frame_consumption_ = std::max(max_frame_consumption_, frame_consumption_);
+
+    // if a frame uses more than half of the buffer, the segments written by the previous frame will
+    // be overwritten by the next one while the GPU is likely still using them
+    if (frame_consumption_ > capacity_ / 2 && capacity_ < max_capacity_) {
+        const std::size_t new_capacity = std::min(capacity_ * 2, max_capacity_);
+        LOG_INFO("A frame used {} MiB of a {} MiB ring buffer, growing it to {} MiB", frame_consumption_ / MiB(1), capacity_ / MiB(1), new_capacity / MiB(1));
+
+        destroy();
+        capacity_ = new_capacity;
+        segment_size_ = capacity_ / SEGMENT_COUNT;
+    }
+
+    frame_consumption_ = 0;
 }
 
 } // namespace renderer::gl
@@ -278,14 +278,14 @@ void sync_texture(GLState &state, GLContext &context, MemState &mem, std::size_t
 
     const size_t texture_size = renderer::texture::texture_size(texture);
     if (!is_valid_addr_range(mem, data_addr, data_addr + texture_size)) {
-        LOG_WARN("Texture has freed data.");
+        LOG_WARN_LIMITED("Texture has freed data.");
         return;
     }
 
     const SceGxmTextureFormat format = gxm::get_format(&texture);
     const SceGxmTextureBaseFormat base_format = gxm::get_base_format(format);
     if (gxm::is_paletted_format(base_format) && texture.palette_addr == 0) {
-        LOG_WARN("Ignoring null palette texture");
+        LOG_WARN_LIMITED("Ignoring null palette texture");
         return;
     }
 
@@ -443,11 +443,23 @@ void sync_blending(const GxmRecordState &state, const MemState &mem) {
     }
 }
 
-void clear_previous_uniform_storage(GLContext &context) {
-    context.vertex_uniform_buffer_storage_ptr.first = nullptr;
-    context.vertex_uniform_buffer_storage_ptr.second = 0;
-    context.fragment_uniform_buffer_storage_ptr.first = nullptr;
-    context.fragment_uniform_buffer_storage_ptr.second = 0;
+void invalidate_uploaded_data(GLContext &context) {
+    context.vertex_uniforms_dirty = true;
+    context.fragment_uniforms_dirty = true;
+    context.render_info_dirty = true;
+    context.uploaded_vertex_streams_valid = false;
+}
+
+bool can_reuse_vertex_streams(const GLContext &context, const GxmRecordState &state) {
+    if (!context.uploaded_vertex_streams_valid || context.uploaded_vertex_streams_program != state.vertex_program.address())
+        return false;
+
+    for (std::size_t i = 0; i < SCE_GXM_MAX_VERTEX_STREAMS; i++) {
+        if (state.vertex_streams[i].data != context.uploaded_vertex_streams[i].data || state.vertex_streams[i].size != context.uploaded_vertex_streams[i].size)
+            return false;
+    }
+
+    return true;
 }
 
 void sync_vertex_streams_and_attributes(GLContext &context, GxmRecordState &state, const MemState &mem) {
@@ -467,6 +479,16 @@ void sync_vertex_streams_and_attributes(GLContext &context, GxmRecordState &stat
         glvert->stripped_symbols_checked = true;
     }
 
+    if (can_reuse_vertex_streams(context, state)) {
+        // The attribute pointers of the previous draw still point to the same data
+        state.vertex_streams.fill({});
+        return;
+    }
+
+    context.uploaded_vertex_streams = state.vertex_streams;
+    context.uploaded_vertex_streams_program = state.vertex_program.address();
+    context.uploaded_vertex_streams_valid = true;
+
     // Each draw will upload the stream data. Assuming that, we can just bind buffer, upload data
     // The GXM submit side should already submit used buffer, but we just delete all just in case
     std::array<std::size_t, SCE_GXM_MAX_VERTEX_STREAMS> offset_in_buffer;
@@ -475,6 +497,7 @@ void sync_vertex_streams_and_attributes(GLContext &context, GxmRecordState &stat
             std::pair<std::uint8_t *, std::size_t> result = context.vertex_stream_ring_buffer.allocate(state.vertex_streams[i].size);
             if (!result.first) {
                 LOG_ERROR("Failed to allocate vertex stream data from GPU!");
+                context.uploaded_vertex_streams_valid = false;
             } else {
                 std::memcpy(result.first, state.vertex_streams[i].data, state.vertex_streams[i].size);
                 offset_in_buffer[i] = result.second;
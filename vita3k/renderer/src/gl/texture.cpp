@@ -141,7 +141,7 @@ void configure_bound_texture(const renderer::TextureCacheState &state, const Sce
     }
 }
 
-void upload_bound_texture(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride) {
+void upload_bound_texture(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset) {
     R_PROFILE(__func__);
 
     GLenum upload_type = GL_TEXTURE_2D;
@@ -154,13 +154,13 @@ void upload_bound_texture(SceGxmTextureBaseFormat base_format, uint32_t width, u
 
         const GLenum format = translate_format(base_format);
         size_t compressed_size = renderer::texture::get_compressed_size(base_format, width, height);
-        glCompressedTexSubImage2D(upload_type, mip_index, 0, 0, width, height, format, static_cast<GLsizei>(compressed_size), pixels);
+        glCompressedTexSubImage2D(upload_type, mip_index, 0, row_offset, width, height, format, static_cast<GLsizei>(compressed_size), pixels);
     } else {
         glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(pixels_per_stride));
 
         const GLenum format = translate_format(base_format);
         const GLenum type = translate_type(base_format);
-        glTexSubImage2D(upload_type, mip_index, 0, 0, width, height, format, type, pixels);
+        glTexSubImage2D(upload_type, mip_index, 0, row_offset, width, height, format, type, pixels);
 
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     }
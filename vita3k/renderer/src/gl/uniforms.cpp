@@ -33,36 +33,61 @@ bool set_uniform_buffer(GLContext &context, const ShaderProgram *program, const
     const size_t data_size_upload = std::min<size_t>(size, program->uniform_buffer_sizes.at(block_num) * 4);
     const size_t offset_start_upload = offset * 4;
 
-    if (vertex_shader) {
-        if (!context.vertex_uniform_buffer_storage_ptr.first) {
-            // Allocate a region for it. Don't worry though, when the shader program is changed
-            context.vertex_uniform_buffer_storage_ptr = context.vertex_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-
-            if (!context.vertex_uniform_buffer_storage_ptr.first) {
-                LOG_ERROR("Unable to allocate vertex SSBO from persistent mapped buffer");
-                return false;
-            }
-
-            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, context.vertex_uniform_stream_ring_buffer.handle(), context.vertex_uniform_buffer_storage_ptr.second, program->max_total_uniform_buffer_storage * 4);
-        }
-
-        std::memcpy(context.vertex_uniform_buffer_storage_ptr.first + offset_start_upload, data, data_size_upload);
-    } else {
-        if (!context.fragment_uniform_buffer_storage_ptr.first) {
-            // Allocate a region for it. Don't worry though, when the shader program is changed
-            context.fragment_uniform_buffer_storage_ptr = context.fragment_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-
-            if (!context.fragment_uniform_buffer_storage_ptr.first) {
-                LOG_ERROR("Unable to allocate fragment SSBO from persistent mapped buffer");
-                return false;
-            }
-
-            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, context.fragment_uniform_stream_ring_buffer.handle(), context.fragment_uniform_buffer_storage_ptr.second, program->max_total_uniform_buffer_storage * 4);
-        }
-
-        std::memcpy(context.fragment_uniform_buffer_storage_ptr.first + offset_start_upload, data, data_size_upload);
+    std::vector<std::uint8_t> &staging = vertex_shader ? context.vertex_uniform_staging : context.fragment_uniform_staging;
+    const size_t staging_size = std::max<size_t>(program->max_total_uniform_buffer_storage * 4, offset_start_upload + data_size_upload);
+    if (staging.size() < staging_size)
+        staging.resize(staging_size);
+
+    // The game sets its uniform buffers before each draw, most of the time with the same content
+    if (std::memcmp(staging.data() + offset_start_upload, data, data_size_upload) != 0) {
+        std::memcpy(staging.data() + offset_start_upload, data, data_size_upload);
+
+        if (vertex_shader)
+            context.vertex_uniforms_dirty = true;
+        else
+            context.fragment_uniforms_dirty = true;
+    }
+
+    return true;
+}
+
+static bool is_upload_needed(const bool dirty, const std::size_t uploaded_size, const std::size_t size) {
+    return size != 0 && (dirty || uploaded_size != size);
+}
+
+bool uniform_buffers_changed(const GLContext &context, const ShaderProgram &vertex_program, const ShaderProgram &fragment_program) {
+    return is_upload_needed(context.vertex_uniforms_dirty, context.vertex_uniform_uploaded_size, vertex_program.max_total_uniform_buffer_storage * 4)
+        || is_upload_needed(context.fragment_uniforms_dirty, context.fragment_uniform_uploaded_size, fragment_program.max_total_uniform_buffer_storage * 4);
+}
+
+static bool upload_uniform_staging(RingBuffer &ring_buffer, std::vector<std::uint8_t> &staging, bool &dirty, std::size_t &uploaded_size,
+    const std::size_t size, const GLuint binding) {
+    if (!is_upload_needed(dirty, uploaded_size, size))
+        return true;
+
+    if (staging.size() < size)
+        staging.resize(size);
+
+    const std::pair<std::uint8_t *, std::size_t> storage = ring_buffer.allocate(size);
+    if (!storage.first) {
+        LOG_ERROR("Unable to allocate {} SSBO from persistent mapped buffer", binding == 0 ? "vertex" : "fragment");
+        return false;
     }
 
+    std::memcpy(storage.first, staging.data(), size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, ring_buffer.handle(), storage.second, size);
+
+    dirty = false;
+    uploaded_size = size;
     return true;
 }
+
+bool upload_uniform_buffers(GLContext &context, const ShaderProgram &vertex_program, const ShaderProgram &fragment_program) {
+    const bool vertex_uploaded = upload_uniform_staging(context.vertex_uniform_stream_ring_buffer, context.vertex_uniform_staging, context.vertex_uniforms_dirty,
+        context.vertex_uniform_uploaded_size, vertex_program.max_total_uniform_buffer_storage * 4, 0);
+    const bool fragment_uploaded = upload_uniform_staging(context.fragment_uniform_stream_ring_buffer, context.fragment_uniform_staging, context.fragment_uniforms_dirty,
+        context.fragment_uniform_uploaded_size, fragment_program.max_total_uniform_buffer_storage * 4, 1);
+
+    return vertex_uploaded && fragment_uploaded;
+}
 } // namespace renderer::gl
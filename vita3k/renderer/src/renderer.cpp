@@ -24,65 +24,71 @@
 #include <cstring>
 
 namespace renderer {
+template <typename... Args>
+static bool push_state_set_command(State &state, Context *ctx, const GXMState gxm_state, Args... arguments) {
+    state.state_set_commands_pushed++;
+    return add_state_set_command(ctx, gxm_state, arguments...);
+}
+
 void set_depth_bias(State &state, Context *ctx, bool is_front, int factor, int units) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::DepthBias, is_front, factor, units);
+    push_state_set_command(state, ctx, renderer::GXMState::DepthBias, is_front, factor, units);
 }
 
 void set_depth_func(State &state, Context *ctx, bool is_front, SceGxmDepthFunc depth_func) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::DepthFunc, is_front, depth_func);
+    push_state_set_command(state, ctx, renderer::GXMState::DepthFunc, is_front, depth_func);
 }
 
 void set_depth_write_enable_mode(State &state, Context *ctx, bool is_front, SceGxmDepthWriteMode enable) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::DepthWriteEnable, is_front, enable);
+    push_state_set_command(state, ctx, renderer::GXMState::DepthWriteEnable, is_front, enable);
 }
 
 void set_point_line_width(State &state, Context *ctx, bool is_front, unsigned int width) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::PointLineWidth, is_front, width);
+    push_state_set_command(state, ctx, renderer::GXMState::PointLineWidth, is_front, width);
 }
 
 void set_polygon_mode(State &state, Context *ctx, bool is_front, SceGxmPolygonMode mode) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::PolygonMode, is_front, mode);
+    push_state_set_command(state, ctx, renderer::GXMState::PolygonMode, is_front, mode);
 }
 
 void set_stencil_func(State &state, Context *ctx, bool is_front, SceGxmStencilFunc func, SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass, unsigned char compareMask, unsigned char writeMask) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::StencilFunc, is_front, func, stencilFail, depthFail, depthPass, compareMask, writeMask);
+    push_state_set_command(state, ctx, renderer::GXMState::StencilFunc, is_front, func, stencilFail, depthFail, depthPass, compareMask, writeMask);
 }
 
 void set_stencil_ref(State &state, Context *ctx, bool is_front, unsigned char sref) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::StencilRef, is_front, sref);
+    push_state_set_command(state, ctx, renderer::GXMState::StencilRef, is_front, sref);
 }
 
 void set_program(State &state, Context *ctx, Ptr<const void> program, const bool is_fragment) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::Program, program, is_fragment);
+    push_state_set_command(state, ctx, renderer::GXMState::Program, program, is_fragment);
 }
 
 void set_cull_mode(State &state, Context *ctx, SceGxmCullMode cull) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::CullMode, cull);
+    push_state_set_command(state, ctx, renderer::GXMState::CullMode, cull);
 }
 
 void set_texture(State &state, Context *ctx, const std::uint32_t tex_index, const SceGxmTexture tex) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::Texture, tex_index, tex);
+    push_state_set_command(state, ctx, renderer::GXMState::Texture, tex_index, tex);
 }
 
 void set_viewport_real(State &state, Context *ctx, float xOffset, float yOffset, float zOffset, float xScale, float yScale, float zScale) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::Viewport, false, xOffset, yOffset,
+    push_state_set_command(state, ctx, renderer::GXMState::Viewport, false, xOffset, yOffset,
         zOffset, xScale, yScale, zScale);
 }
 
 void set_viewport_flat(State &state, Context *ctx) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::Viewport, true);
+    push_state_set_command(state, ctx, renderer::GXMState::Viewport, true);
 }
 
 void set_region_clip(State &state, Context *ctx, SceGxmRegionClipMode mode, unsigned int xMin, unsigned int xMax, unsigned int yMin, unsigned int yMax) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::RegionClip, mode, xMin, xMax, yMin, yMax);
+    push_state_set_command(state, ctx, renderer::GXMState::RegionClip, mode, xMin, xMax, yMin, yMax);
 }
 
 void set_two_sided_enable(State &state, Context *ctx, SceGxmTwoSidedMode mode) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::TwoSided, mode);
+    push_state_set_command(state, ctx, renderer::GXMState::TwoSided, mode);
 }
 
 void set_side_fragment_program_enable(State &state, Context *ctx, const bool is_front, SceGxmFragmentProgramMode mode) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::FragmentProgramEnable, is_front, mode);
+    push_state_set_command(state, ctx, renderer::GXMState::FragmentProgramEnable, is_front, mode);
 }
 
 void set_context(State &state, Context *ctx, RenderTarget *target, SceGxmColorSurface *color_surface, SceGxmDepthStencilSurface *depth_stencil_surface) {
@@ -90,7 +96,7 @@ void set_context(State &state, Context *ctx, RenderTarget *target, SceGxmColorSu
 }
 
 void set_vertex_stream(State &state, Context *ctx, const std::size_t index, const std::size_t data_len, const Ptr<const void> stream) {
-    renderer::add_state_set_command(ctx, renderer::GXMState::VertexStream, stream, index, data_len);
+    push_state_set_command(state, ctx, renderer::GXMState::VertexStream, stream, index, data_len);
 }
 
 void draw(State &state, Context *ctx, SceGxmPrimitiveType prim_type, SceGxmIndexFormat index_type, const void *index_data, const std::uint32_t index_count, const std::uint32_t instance_count) {
@@ -133,7 +139,7 @@ void set_uniform_buffer(State &state, Context *ctx, const bool is_vertex_uniform
     // Calculate the number of bytes
     std::uint32_t bytes_to_copy_and_pad = (((block_size + 15) / 16)) * 16;
 
-    renderer::add_state_set_command(ctx, renderer::GXMState::UniformBuffer, buffer, is_vertex_uniform, block_number, bytes_to_copy_and_pad);
+    push_state_set_command(state, ctx, renderer::GXMState::UniformBuffer, buffer, is_vertex_uniform, block_number, bytes_to_copy_and_pad);
 }
 
 } // namespace renderer
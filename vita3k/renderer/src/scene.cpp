@@ -20,6 +20,7 @@
 #include <renderer/commands.h>
 #include <renderer/driver_functions.h>
 #include <renderer/state.h>
+#include <renderer/transfer.h>
 #include <renderer/types.h>
 
 #include <renderer/gl/functions.h>
@@ -112,8 +113,12 @@ COMMAND(handle_sync_surface_data) {
     if (renderer.current_backend == Backend::Vulkan) {
         // TODO: put this in a function
         vulkan::VKContext *context = reinterpret_cast<vulkan::VKContext *>(renderer.context);
-        if (context->is_recording)
-            context->stop_recording(vertex_notification, fragment_notification);
+        if (context->is_recording) {
+            // the copy is done by the scene itself, its content is written to the guest memory once it is done
+            if (!helper.cmd->status && !renderer.disable_surface_sync)
+                context->request_surface_readback(render_context->record.color_surface);
+            context->end_scene(vertex_notification, fragment_notification);
+        }
     }
 
     SceGxmColorSurface *surface = &render_context->record.color_surface;
@@ -125,12 +130,18 @@ COMMAND(handle_sync_surface_data) {
         }
     }
 
-    if (renderer.disable_surface_sync) {
+    // the vulkan readback is asynchronous and already requested
+    if (renderer.disable_surface_sync || renderer.current_backend == Backend::Vulkan) {
         if (helper.cmd->status)
             complete_command(renderer, helper, 0);
         return;
     }
 
+    // the opengl one is too when it's done at the end of a scene, only the explicit syncs wait for the content
+    if (renderer.current_backend == Backend::OpenGL && !helper.cmd->status
+        && gl::request_surface_readback(static_cast<gl::GLState &>(renderer), *reinterpret_cast<gl::GLContext *>(render_context), mem, *surface))
+        return;
+
     const size_t width = surface->width;
     const size_t height = surface->height;
     const size_t stride_in_pixels = surface->strideInPixels;
@@ -153,10 +164,6 @@ COMMAND(handle_sync_surface_data) {
         }
         break;
 
-    case Backend::Vulkan:
-        // not implemented for now
-        break;
-
     default:
         REPORT_MISSING(renderer.current_backend);
         break;
@@ -213,6 +220,14 @@ COMMAND(handle_draw) {
     }
 }
 
+// context doing the transfers on the GPU, nullptr if they are all done by the CPU
+static vulkan::VKContext *get_gpu_transfer_context(State &renderer) {
+    if (renderer.current_backend != Backend::Vulkan)
+        return nullptr;
+
+    return reinterpret_cast<vulkan::VKContext *>(renderer.context);
+}
+
 COMMAND(handle_transfer_copy) {
     TRACY_FUNC_COMMANDS(handle_transfer_copy);
     const uint32_t colorKeyValue = helper.pop<uint32_t>();
@@ -230,40 +245,20 @@ COMMAND(handle_transfer_copy) {
         const uint32_t src_bytes_per_pixel = (src_bpp + 7) >> 3;
         const uint32_t dest_bytes_per_pixel = (dest_bpp + 7) >> 3;
 
-        for (uint32_t x = 0; x < src->width; x++) {
-            for (uint32_t y = 0; y < src->height; y++) {
-                // Set offset of source and destination
-                const auto src_offset = ((x + src->x) * src_bytes_per_pixel) + ((y + src->y) * src->stride);
-                const auto dest_offset = ((x + dest->x) * dest_bytes_per_pixel) + ((y + dest->y) * dest->stride);
-
-                // Set pointer of source and destination
-                const auto src_ptr = (uint8_t *)src->address.get(mem) + src_offset;
-                auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
-
-                // Set color of source
-                const auto src_color = *(uint32_t *)src_ptr;
-
-                // Copy result in destination depending color Key
-                switch (colorKeyMode) {
-                case SCE_GXM_TRANSFER_COLORKEY_NONE:
-                    memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                case SCE_GXM_TRANSFER_COLORKEY_PASS:
-                    if ((src_color & colorKeyMask) == colorKeyValue)
-                        memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                case SCE_GXM_TRANSFER_COLORKEY_REJECT:
-                    if ((src_color & colorKeyMask) != colorKeyValue)
-                        memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                default: break;
-                }
-            }
-        }
+        // Set pointer of source and destination at the start of their rectangle
+        const auto src_ptr = (const uint8_t *)src->address.get(mem) + src->x * src_bytes_per_pixel + static_cast<int64_t>(src->y) * src->stride;
+        auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest->x * dest_bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
+
+        // the copies from or to a cached surface are done by the GPU, it writes the guest memory later
+        vulkan::VKContext *gpu_context = get_gpu_transfer_context(renderer);
+        const bool done_by_gpu = gpu_context && vulkan::transfer_copy(*gpu_context, *src, *dest, colorKeyMode);
+        if (!done_by_gpu)
+            transfer::copy(dest_ptr, dest->stride, dest_bytes_per_pixel, src_ptr, src->stride, src_bytes_per_pixel,
+                src->width, src->height, colorKeyMode, colorKeyValue, colorKeyMask);
     } else
         LOG_WARN("No convertion of SceGxmTransferType support yet");
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface with the OpenGL renderer
 
     delete[] images;
 }
@@ -278,22 +273,24 @@ COMMAND(handle_transfer_downscale) {
     const uint32_t src_bytes_per_pixel = (src_bpp + 7) >> 3;
     const uint32_t dest_bytes_per_pixel = (dest_bpp + 7) >> 3;
 
-    for (uint32_t y = 0; y < src->height; y += 2) {
-        for (uint32_t x = 0; x < src->width; x += 2) {
-            // Set offset of source and destination
-            const auto src_offset = ((x + src->x) * src_bytes_per_pixel) + ((y + src->y) * src->stride);
-            const auto dest_offset = (x / 2 + dest->x) * dest_bytes_per_pixel + (y / 2 + dest->y) * dest->stride;
-
-            // Set pointer of source and destination
-            const auto src_ptr = (uint8_t *)src->address.get(mem) + src_offset;
-            auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
+    // Set pointer of source and destination at the start of their rectangle
+    const auto src_ptr = (const uint8_t *)src->address.get(mem) + src->x * src_bytes_per_pixel + static_cast<int64_t>(src->y) * src->stride;
+    auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest->x * dest_bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
 
-            // Copy result in destination
-            memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
+    // the downscales between cached surfaces are done by the GPU, it writes the guest memory later
+    vulkan::VKContext *gpu_context = get_gpu_transfer_context(renderer);
+    const bool done_by_gpu = gpu_context && vulkan::transfer_downscale(*gpu_context, *src, *dest);
+    if (!done_by_gpu) {
+        if ((src->format == dest->format) && transfer::can_box_filter(src->format)) {
+            transfer::downscale(dest_ptr, dest->stride, src_ptr, src->stride, src_bytes_per_pixel, src->width / 2, src->height / 2);
+        } else {
+            // Keep the top left pixel of each 2x2 block, it is a copy skipping every other pixel and row
+            transfer::copy(dest_ptr, dest->stride, dest_bytes_per_pixel, src_ptr, src->stride * 2, src_bytes_per_pixel * 2,
+                (src->width + 1) / 2, (src->height + 1) / 2, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0);
         }
     }
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface with the OpenGL renderer
 
     delete src;
     delete dest;
@@ -307,20 +304,16 @@ COMMAND(handle_transfer_fill) {
     const auto bpp = gxm::get_bits_per_pixel(dest->format);
 
     const uint32_t bytes_per_pixel = (bpp + 7) >> 3;
-    for (uint32_t y = 0; y < dest->height; y++) {
-        for (uint32_t x = 0; x < dest->width; x++) {
-            // Set offset of destination
-            const auto dest_offset = ((x + dest->x) * bytes_per_pixel) + ((y + dest->y) * dest->stride);
 
-            // Set pointer of destination
-            auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
+    // Set pointer of destination at the start of its rectangle
+    auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest->x * bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
 
-            // Fill color in destination
-            memcpy(dest_ptr, &fill_color, bytes_per_pixel);
-        }
-    }
+    vulkan::VKContext *gpu_context = get_gpu_transfer_context(renderer);
+    const bool done_by_gpu = gpu_context && vulkan::transfer_fill(*gpu_context, *dest, fill_color);
+    if (!done_by_gpu)
+        transfer::fill(dest_ptr, dest->stride, bytes_per_pixel, dest->width, dest->height, fill_color);
 
-    // TODO: handle case where dest is a cached surface
+    // TODO: handle case where dest is a cached surface with the OpenGL renderer
 
     delete dest;
 }
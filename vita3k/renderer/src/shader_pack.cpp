@@ -0,0 +1,468 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/shader_pack.h>
+#include <renderer/shared_shader_cache.h>
+
+#include <mem/util.h>
+#include <util/align.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace renderer {
+
+// 'V3KS'
+static constexpr uint32_t PACK_MAGIC = 0x534B3356;
+// must be increased each time the layout of the blocks changes
+static constexpr uint32_t PACK_VERSION = 1;
+static constexpr uint32_t RECORD_MAGIC = 0x52444853;
+static constexpr uint32_t INDEX_MAGIC = 0x58444E49;
+static constexpr uint32_t FOOTER_MAGIC = 0x544F4F46;
+
+// number of shaders stored before they are written to the file
+static constexpr size_t FLUSH_BATCH_SIZE = 32;
+// the file is compacted when opened if it contains more unused data than shaders, and at least this much
+static constexpr uint64_t COMPACT_MIN_UNUSED_SIZE = MiB(1);
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+// the file is made of blocks, each one is its header followed by the name of the shader and its data, its whole size is a multiple of 16
+// an index block contains the sorted entries of all the records and ends with the footer, the last index of the file is the valid one
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t name_size;
+    uint64_t data_size;
+};
+
+struct IndexFooter {
+    uint64_t index_offset;
+    uint32_t entry_count;
+    uint32_t magic;
+};
+
+static uint64_t get_block_size(uint64_t name_size, uint64_t data_size) {
+    return align(sizeof(BlockHeader) + name_size + data_size, 16);
+}
+
+static uint64_t get_index_data_size(uint64_t entry_count) {
+    return entry_count * 2 * sizeof(uint64_t) + sizeof(IndexFooter);
+}
+
+// FNV-1a
+static uint64_t hash_name(const std::string &name) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+ShaderPack::ShaderPack(const fs::path &path)
+    : path(path) {
+    fs::create_directories(path.parent_path());
+
+    if (map_file() && !read_index())
+        // the last index was not completely written, find the records again
+        scan_records();
+
+    if (mapped_size == 0 && fs::exists(path))
+        // wrong version or a file too damaged to be used
+        fs::remove(path);
+
+    if (fs::exists(path) && fs::file_size(path) != file_size) {
+        // remove the incomplete block at the end before appending the new ones
+        unmap_file();
+        fs::resize_file(path, file_size);
+        map_file();
+    }
+
+    const uint64_t index_size = index_dirty ? 0 : get_block_size(0, get_index_data_size(index.size()));
+    const uint64_t unused_size = file_size > sizeof(PackHeader) ? (file_size - sizeof(PackHeader) - live_size - index_size) : 0;
+    if (unused_size > live_size && unused_size >= COMPACT_MIN_UNUSED_SIZE)
+        compact();
+
+    file.open(path, std::ios::out | std::ios::binary | std::ios::app);
+    if (!file) {
+        LOG_ERROR("Could not open the shader pack file {}", path.string());
+        return;
+    }
+
+    if (file_size == 0) {
+        const PackHeader header{ PACK_MAGIC, PACK_VERSION };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.flush();
+        file_size = sizeof(header);
+    }
+
+    if (index_dirty) {
+        const std::lock_guard<std::mutex> guard(mutex);
+        flush_locked();
+    }
+
+    LOG_INFO("Loaded {} shaders from the shader pack file {}", index.size(), path.string());
+}
+
+ShaderPack::~ShaderPack() {
+    flush();
+    unmap_file();
+}
+
+bool ShaderPack::map_file() {
+    if (!fs::exists(path) || fs::file_size(path) < sizeof(PackHeader))
+        return false;
+
+    const uint64_t size = fs::file_size(path);
+#ifdef WIN32
+    file_handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        LOG_ERROR("CreateFileW failed: {}", log_hex(GetLastError()));
+        return false;
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle) {
+        LOG_ERROR("CreateFileMappingW failed: {}", log_hex(GetLastError()));
+        unmap_file();
+        return false;
+    }
+
+    mapped_data = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped_data) {
+        LOG_ERROR("MapViewOfFile failed: {}", log_hex(GetLastError()));
+        unmap_file();
+        return false;
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Could not open the shader pack file {}", path.string());
+        return false;
+    }
+
+    void *const data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid once the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("mmap failed");
+        return false;
+    }
+    mapped_data = static_cast<const uint8_t *>(data);
+#endif
+    mapped_size = size;
+
+    PackHeader header;
+    memcpy(&header, mapped_data, sizeof(header));
+    if (header.magic != PACK_MAGIC || header.version != PACK_VERSION) {
+        LOG_INFO("Shader pack file {} was made by another version, it will be recreated", path.string());
+        unmap_file();
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderPack::unmap_file() {
+#ifdef WIN32
+    if (mapped_data)
+        UnmapViewOfFile(mapped_data);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (mapped_data)
+        munmap(const_cast<uint8_t *>(mapped_data), mapped_size);
+#endif
+    mapped_data = nullptr;
+    mapped_size = 0;
+}
+
+bool ShaderPack::read_index() {
+    if (mapped_size < sizeof(PackHeader) + get_block_size(0, get_index_data_size(0)))
+        return false;
+
+    IndexFooter footer;
+    memcpy(&footer, mapped_data + mapped_size - sizeof(footer), sizeof(footer));
+    if (footer.magic != FOOTER_MAGIC || footer.index_offset < sizeof(PackHeader)
+        || footer.index_offset + get_block_size(0, get_index_data_size(footer.entry_count)) != mapped_size)
+        return false;
+
+    BlockHeader header;
+    memcpy(&header, mapped_data + footer.index_offset, sizeof(header));
+    if (header.magic != INDEX_MAGIC || header.data_size != get_index_data_size(footer.entry_count))
+        return false;
+
+    index.resize(footer.entry_count);
+    memcpy(index.data(), mapped_data + footer.index_offset + sizeof(BlockHeader), footer.entry_count * sizeof(IndexEntry));
+
+    // check the entries before using them, the file may have been modified by something else
+    live_size = 0;
+    for (size_t i = 0; i < index.size(); i++) {
+        const IndexEntry &entry = index[i];
+        bool is_valid = (i == 0 || index[i - 1].name_hash <= entry.name_hash) && entry.offset + sizeof(BlockHeader) <= footer.index_offset;
+        if (is_valid) {
+            BlockHeader record;
+            memcpy(&record, mapped_data + entry.offset, sizeof(record));
+            const uint64_t record_size = get_block_size(record.name_size, record.data_size);
+            is_valid = record.magic == RECORD_MAGIC && record.data_size <= mapped_size && entry.offset + record_size <= footer.index_offset;
+            live_size += record_size;
+        }
+
+        if (!is_valid) {
+            index.clear();
+            live_size = 0;
+            return false;
+        }
+    }
+
+    file_size = mapped_size;
+    return true;
+}
+
+void ShaderPack::scan_records() {
+    index.clear();
+    live_size = 0;
+
+    // the last record of each shader is the one used, the index blocks are skipped
+    std::unordered_map<std::string, uint64_t> records;
+    uint64_t offset = sizeof(PackHeader);
+    while (offset + sizeof(BlockHeader) <= mapped_size) {
+        BlockHeader header;
+        memcpy(&header, mapped_data + offset, sizeof(header));
+        if ((header.magic != RECORD_MAGIC && header.magic != INDEX_MAGIC) || header.name_size > mapped_size || header.data_size > mapped_size)
+            break;
+
+        const uint64_t block_size = get_block_size(header.name_size, header.data_size);
+        if (offset + block_size > mapped_size)
+            break;
+
+        if (header.magic == RECORD_MAGIC)
+            records[std::string(reinterpret_cast<const char *>(mapped_data + offset + sizeof(BlockHeader)), header.name_size)] = offset;
+
+        offset += block_size;
+    }
+
+    for (const auto &[name, record_offset] : records) {
+        BlockHeader header;
+        memcpy(&header, mapped_data + record_offset, sizeof(header));
+        index.push_back({ hash_name(name), record_offset });
+        live_size += get_block_size(header.name_size, header.data_size);
+    }
+    std::sort(index.begin(), index.end(), [](const IndexEntry &lhs, const IndexEntry &rhs) {
+        return lhs.name_hash < rhs.name_hash;
+    });
+
+    file_size = offset;
+    index_dirty = true;
+}
+
+void ShaderPack::compact() {
+    fs::path compact_path = path;
+    compact_path += ".tmp";
+
+    std::vector<IndexEntry> compact_index;
+    compact_index.reserve(index.size());
+    {
+        fs::ofstream compact_file(compact_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        const PackHeader header{ PACK_MAGIC, PACK_VERSION };
+        compact_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        uint64_t offset = sizeof(PackHeader);
+        for (const IndexEntry &entry : index) {
+            BlockHeader record;
+            memcpy(&record, mapped_data + entry.offset, sizeof(record));
+            const uint64_t record_size = get_block_size(record.name_size, record.data_size);
+            compact_file.write(reinterpret_cast<const char *>(mapped_data + entry.offset), record_size);
+
+            compact_index.push_back({ entry.name_hash, offset });
+            offset += record_size;
+        }
+
+        const BlockHeader index_header{ INDEX_MAGIC, 0, get_index_data_size(compact_index.size()) };
+        const IndexFooter footer{ offset, static_cast<uint32_t>(compact_index.size()), FOOTER_MAGIC };
+        compact_file.write(reinterpret_cast<const char *>(&index_header), sizeof(index_header));
+        compact_file.write(reinterpret_cast<const char *>(compact_index.data()), compact_index.size() * sizeof(IndexEntry));
+        compact_file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+
+        if (!compact_file) {
+            LOG_ERROR("Could not write the compacted shader pack file {}", compact_path.string());
+            compact_file.close();
+            fs::remove(compact_path);
+            return;
+        }
+    }
+
+    const uint64_t previous_size = file_size;
+    unmap_file();
+    fs::rename(compact_path, path);
+    map_file();
+
+    index = std::move(compact_index);
+    file_size = mapped_size;
+    index_dirty = false;
+    LOG_INFO("Compacted the shader pack file {} from {} to {} KiB", path.string(), previous_size / KiB(1), file_size / KiB(1));
+}
+
+std::span<const uint8_t> ShaderPack::read_record(uint64_t offset, const std::string &name) const {
+    if (offset + sizeof(BlockHeader) > mapped_size)
+        return {};
+
+    BlockHeader record;
+    memcpy(&record, mapped_data + offset, sizeof(record));
+    const uint8_t *record_name = mapped_data + offset + sizeof(BlockHeader);
+    if (record.magic != RECORD_MAGIC || record.name_size != name.size() || memcmp(record_name, name.data(), name.size()) != 0)
+        return {};
+
+    return { record_name + record.name_size, static_cast<size_t>(record.data_size) };
+}
+
+std::span<const uint8_t> ShaderPack::read(const std::string &name) {
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+
+        const auto stored_it = stored.find(name);
+        if (stored_it != stored.end())
+            return stored_it->second;
+
+        const IndexEntry key{ hash_name(name), 0 };
+        const auto [first, last] = std::equal_range(index.begin(), index.end(), key, [](const IndexEntry &lhs, const IndexEntry &rhs) {
+            return lhs.name_hash < rhs.name_hash;
+        });
+        for (auto it = first; it != last; ++it) {
+            const std::span<const uint8_t> data = read_record(it->offset, name);
+            if (!data.empty())
+                return data;
+        }
+
+        if (!shared_cache)
+            return {};
+    }
+
+    // the shared cache can be on a slow network share, the other shaders can still be read meanwhile
+    std::vector<uint8_t> data = shared_cache->read(fs::path(shared_directory) / name);
+    if (data.empty())
+        return {};
+
+    const std::lock_guard<std::mutex> guard(mutex);
+    const auto [it, inserted] = stored.emplace(name, std::move(data));
+    if (inserted) {
+        pending.push_back(&it->first);
+        if (pending.size() >= FLUSH_BATCH_SIZE)
+            flush_locked();
+    }
+
+    return it->second;
+}
+
+void ShaderPack::store(const std::string &name, const void *data, size_t size) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    if (stored.contains(name))
+        return;
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    const auto it = stored.emplace(name, std::vector<uint8_t>(bytes, bytes + size)).first;
+    pending.push_back(&it->first);
+    if (shared_cache)
+        shared_cache->write(fs::path(shared_directory) / name, data, size);
+
+    if (pending.size() >= FLUSH_BATCH_SIZE)
+        flush_locked();
+}
+
+void ShaderPack::set_shared_cache(std::shared_ptr<SharedShaderCache> cache, const std::string &directory) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    shared_cache = std::move(cache);
+    shared_directory = directory;
+}
+
+void ShaderPack::flush() {
+    const std::lock_guard<std::mutex> guard(mutex);
+    flush_locked();
+}
+
+void ShaderPack::flush_locked() {
+    if (!file || (pending.empty() && !index_dirty))
+        return;
+
+    static constexpr char padding[16] = {};
+    for (const std::string *name : pending) {
+        const std::vector<uint8_t> &data = stored.at(*name);
+        const BlockHeader record{ RECORD_MAGIC, static_cast<uint32_t>(name->size()), data.size() };
+        const uint64_t record_size = get_block_size(name->size(), data.size());
+        file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        file.write(name->data(), name->size());
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        file.write(padding, record_size - (sizeof(record) + name->size() + data.size()));
+
+        // a shader generated again while the cache is disabled replaces its previous record
+        const IndexEntry entry{ hash_name(*name), file_size };
+        const auto compare = [](const IndexEntry &lhs, const IndexEntry &rhs) {
+            return lhs.name_hash < rhs.name_hash;
+        };
+        const auto [first, last] = std::equal_range(index.begin(), index.end(), entry, compare);
+        auto previous = std::find_if(first, last, [&](const IndexEntry &other) {
+            return !read_record(other.offset, *name).empty();
+        });
+        if (previous != last) {
+            BlockHeader previous_record;
+            memcpy(&previous_record, mapped_data + previous->offset, sizeof(previous_record));
+            live_size -= get_block_size(previous_record.name_size, previous_record.data_size);
+            previous->offset = entry.offset;
+        } else {
+            index.insert(last, entry);
+        }
+
+        live_size += record_size;
+        file_size += record_size;
+    }
+    pending.clear();
+
+    const BlockHeader index_header{ INDEX_MAGIC, 0, get_index_data_size(index.size()) };
+    const IndexFooter footer{ file_size, static_cast<uint32_t>(index.size()), FOOTER_MAGIC };
+    file.write(reinterpret_cast<const char *>(&index_header), sizeof(index_header));
+    file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(IndexEntry));
+    file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    file.flush();
+
+    if (!file) {
+        LOG_ERROR("Could not write to the shader pack file {}", path.string());
+        return;
+    }
+
+    file_size += get_block_size(0, index_header.data_size);
+    index_dirty = false;
+}
+
+} // namespace renderer
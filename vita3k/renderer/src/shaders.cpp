@@ -18,7 +18,10 @@
 #include <renderer/shaders.h>
 
 #include <renderer/profile.h>
+#include <renderer/shader_pack.h>
+#include <renderer/shared_shader_cache.h>
 
+#include <renderer/gl/functions.h>
 #include <renderer/vulkan/state.h>
 
 #include <gxm/types.h>
@@ -28,19 +31,14 @@
 #include <util/fs.h>
 #include <util/log.h>
 
+#include <cstring>
 #include <utility>
 
 namespace renderer {
 
-bool get_shaders_cache_hashs(State &renderer) {
-    const auto shaders_path{ fs::path(renderer.base_path) / "cache/shaders" / renderer.title_id / renderer.self_name };
+static bool read_shaders_cache_hashs(State &renderer, const fs::path &shaders_path) {
     const std::string hash_file_name = fmt::format("hashs-{}.dat", (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk");
 
-    if (renderer.current_backend == Backend::Vulkan) {
-        // try to read pipeline cache
-        dynamic_cast<vulkan::VKState &>(renderer).pipeline_cache.read_pipeline_cache();
-    }
-
     fs::ifstream shaders_hashs(shaders_path / hash_file_name, std::ios::in | std::ios::binary);
     if (shaders_hashs.is_open()) {
         renderer.shaders_cache_hashs.clear();
@@ -82,6 +80,32 @@ bool get_shaders_cache_hashs(State &renderer) {
     return !renderer.shaders_cache_hashs.empty();
 }
 
+bool get_shaders_cache_hashs(State &renderer) {
+    const auto shaders_path{ fs::path(renderer.base_path) / "cache/shaders" / renderer.title_id / renderer.self_name };
+
+    if (renderer.current_backend == Backend::Vulkan) {
+        // try to read pipeline cache
+        dynamic_cast<vulkan::VKState &>(renderer).pipeline_cache.read_pipeline_cache();
+    }
+
+    // the packs must be closed before an outdated cache is removed
+    renderer.shader_pack.reset();
+    if (renderer.current_backend == Backend::OpenGL)
+        dynamic_cast<gl::GLState &>(renderer).program_binary_pack.reset();
+    const bool has_hashs = read_shaders_cache_hashs(renderer, shaders_path);
+
+    const std::string pack_file_name = fmt::format("shaders-{}.pack", (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk");
+    renderer.shader_pack = std::make_shared<ShaderPack>(shaders_path / pack_file_name);
+    if (renderer.shared_shader_cache) {
+        const char *backend_name = (renderer.current_backend == Backend::OpenGL) ? "gl" : "vk";
+        renderer.shader_pack->set_shared_cache(renderer.shared_shader_cache, get_shared_shaders_dir(backend_name, renderer.features));
+    }
+    if (renderer.current_backend == Backend::OpenGL)
+        gl::open_program_binary_pack(dynamic_cast<gl::GLState &>(renderer), shaders_path);
+
+    return has_hashs;
+}
+
 void save_shaders_cache_hashs(State &renderer, std::vector<ShadersHash> &shaders_cache_hashs) {
     const auto shaders_path{ fs::path(renderer.base_path) / "cache/shaders" / renderer.title_id / renderer.self_name };
     if (!fs::exists(shaders_path))
@@ -134,91 +158,116 @@ static bool load_shader(const char *hash, const char *extension, const char *bas
     return true;
 }
 
-static const Sha256Hash get_shader_hash(const SceGxmProgram &program) {
-    const Sha256Hash hash_bytes = sha256(&program, program.size);
-    return hash_bytes;
+// name of the shader in the pack, which is the name of its file in the per-file cache
+static std::string get_shader_pack_name(const char *hash_text, const char *extension) {
+    return fs::path(hash_text).replace_extension(extension).string();
 }
 
 template <typename R>
-R load_shader_generic(const char *hash_text, const char *base_path, const char *title_id, const char *self_name, const char *shader_type_str) {
+R load_shader_generic(const char *hash_text, const char *base_path, const char *title_id, const char *self_name, ShaderPack *shader_pack, const char *shader_type_str) {
     std::size_t read_size = 0;
     R source;
 
+    const std::string pack_name = get_shader_pack_name(hash_text, shader_type_str);
+    if (shader_pack) {
+        const std::span<const uint8_t> data = shader_pack->read(pack_name);
+        if (!data.empty()) {
+            source.resize((data.size() + sizeof(typename R::value_type) - 1) / sizeof(typename R::value_type));
+            memcpy(source.data(), data.data(), data.size());
+            return source;
+        }
+    }
+
     if (load_shader(hash_text, shader_type_str, base_path, title_id, self_name, nullptr, read_size)) {
         source.resize((read_size + sizeof(typename R::value_type) - 1) / sizeof(typename R::value_type));
 
         char *dest_pointer = reinterpret_cast<char *>(source.data());
         load_shader(hash_text, shader_type_str, base_path, title_id, self_name, &dest_pointer, read_size);
+
+        // import the shaders of the per-file cache, the files are left as they are
+        if (shader_pack)
+            shader_pack->store(pack_name, source.data(), read_size);
     }
 
     return source;
 }
 
-shader::GeneratedShader load_shader_generic(shader::Target target, const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *base_path, const char *title_id, const char *self_name, const char *shader_type_str, const std::string &shader_version, bool shader_cache) {
-    // TODO: no need to recompute the hash here
-    const std::string hash_text = hex_string(get_shader_hash(program));
+static shader::GeneratedShader load_shader_generic(State &renderer, shader::Target target, const SceGxmProgram &program, const Sha256Hash &hash, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *shader_type_str, const std::string &shader_version, bool shader_cache) {
+    const char *base_path = renderer.base_path;
+    const char *title_id = renderer.title_id;
+    const char *self_name = renderer.self_name;
+    ShaderPack *shader_pack = renderer.shader_pack.get();
+
+    const std::string hash_text = hex_string(hash);
     // Set Shader Hash with Version
-    const std::string hash_hex_ver = shader_version + "-" + static_cast<std::string>(hash_text.data());
+    const std::string hash_hex_ver = shader_version + "-" + hash_text;
 
     if (shader_cache) {
         if (target == shader::Target::GLSLOpenGL) {
-            std::string source = load_shader_generic<std::string>(hash_hex_ver.c_str(), base_path, title_id, self_name, shader_type_str);
+            std::string source = load_shader_generic<std::string>(hash_hex_ver.c_str(), base_path, title_id, self_name, shader_pack, shader_type_str);
             if (!source.empty()) {
                 return { source, std::vector<uint32_t>() };
             }
         } else {
-            std::vector<uint32_t> source = load_shader_generic<std::vector<uint32_t>>(hash_hex_ver.c_str(), base_path, title_id, self_name, shader_type_str);
+            std::vector<uint32_t> source = load_shader_generic<std::vector<uint32_t>>(hash_hex_ver.c_str(), base_path, title_id, self_name, shader_pack, shader_type_str);
             if (!source.empty())
                 return { "", source };
         }
     }
 
-    LOG_INFO("Generating {} shader {}", shader_type_str, hash_text.data());
-
-    std::string spirv_dump;
-    std::string disasm_dump;
+    LOG_INFO("Generating {} shader {}", shader_type_str, hash_text);
+
+    // the dumps are written by the dump thread, so the render thread only translates the shader
+    std::function<bool(const std::string &, const std::string &)> write_data_with_ext;
+    if (renderer.shader_dump_pool) {
+        const fs::path shader_base_dir{ fs::path("shaderlog") / title_id / self_name };
+        const fs::path shader_base_path = fs_utils::construct_file_name(base_path, shader_base_dir, hash_hex_ver.c_str(), ".gxp");
+        const auto write_dump = [&renderer, shader_base_path](const std::string &ext, std::string data, fs::ofstream::openmode mode) {
+            renderer.shader_dump_pool->submit([shader_base_path, ext, data = std::move(data), mode]() {
+                fs::path out_path{ shader_base_path };
+                out_path.replace_extension(ext);
+                if (!fs::exists(out_path.parent_path()))
+                    fs::create_directories(out_path.parent_path());
+
+                fs::ofstream of{ out_path, mode };
+                if (!of.fail()) {
+                    of.write(data.data(), data.size());
+                    of.close();
+                }
+            });
+        };
+
+        // Dump gxp binary
+        write_dump(".gxp", std::string(reinterpret_cast<const char *>(&program), program.size), fs::ofstream::out | fs::ofstream::binary);
+
+        write_data_with_ext = [write_dump](const std::string &ext, const std::string &data) {
+            write_dump(ext, data, fs::ofstream::out);
+            return true;
+        };
+    }
 
-    const fs::path shader_base_dir{ fs::path("shaderlog") / title_id / self_name };
-    if (!fs::exists(base_path / shader_base_dir))
-        fs::create_directories(base_path / shader_base_dir);
+    shader::GeneratedShader source = shader::convert_gxp(program, hash_text, features, target, hints, maskupdate, false, write_data_with_ext);
 
-    auto shader_base_path = fs_utils::construct_file_name(base_path, shader_base_dir, hash_hex_ver.c_str(), ".gxp");
+    if (shader_pack) {
+        if (target == shader::Target::GLSLOpenGL)
+            shader_pack->store(get_shader_pack_name(hash_hex_ver.c_str(), shader_type_str), source.glsl.data(), source.glsl.size());
+        else
+            shader_pack->store(get_shader_pack_name(hash_hex_ver.c_str(), "spv"), source.spirv.data(), sizeof(uint32_t) * source.spirv.size());
 
-    // Dump gxp binary
-    fs::ofstream of{ shader_base_path, fs::ofstream::binary };
-    if (!of.fail()) {
-        of.write(reinterpret_cast<const char *>(&program), program.size);
-        of.close();
+        return source;
     }
 
-    const auto write_data_with_ext = [&](const std::string &ext, const std::string &data) {
-        fs::path out_path{ shader_base_path };
-        out_path.replace_extension(ext);
-        fs::ofstream of{ out_path };
-        if (!of.fail()) {
-            of << data;
-            of.close();
-        }
-        return true;
-    };
-
-    shader::GeneratedShader source = shader::convert_gxp(program, hash_text.data(), features, target, hints, maskupdate, false, write_data_with_ext);
-
     // Copy shader generate to shaders cache
     const auto shaders_cache_path = fs::path("cache/shaders") / title_id / self_name;
     if (!fs::exists(base_path / shaders_cache_path))
         fs::create_directories(base_path / shaders_cache_path);
 
     if (target == shader::Target::GLSLOpenGL) {
-        shader_base_path.replace_extension(shader_type_str);
-        if (fs::exists(shader_base_path)) {
-            try {
-                const auto shader_dst_path = fs_utils::construct_file_name(base_path, shaders_cache_path, hash_hex_ver.c_str(), shader_type_str);
-                fs::copy_file(shader_base_path, shader_dst_path, fs::copy_option::overwrite_if_exists);
-                fs::remove(shader_base_path);
-            } catch (std::exception &e) {
-                LOG_ERROR("Failed to moved shaders file: \n{}", e.what());
-            }
+        const auto shader_dst_path = fs_utils::construct_file_name(base_path, shaders_cache_path, hash_hex_ver.c_str(), shader_type_str);
+        fs::ofstream of{ shader_dst_path };
+        if (!of.fail()) {
+            of << source.glsl;
+            of.close();
         }
     } else {
         const auto shader_dst_path = fs_utils::construct_file_name(base_path, shaders_cache_path, hash_hex_ver.c_str(), "spv");
@@ -232,7 +281,7 @@ shader::GeneratedShader load_shader_generic(shader::Target target, const SceGxmP
     return source;
 }
 
-std::string load_glsl_shader(const SceGxmProgram &program, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
+std::string load_glsl_shader(State &renderer, const SceGxmProgram &program, const Sha256Hash &hash, const FeatureState &features, const shader::Hints &hints, bool maskupdate, const std::string &shader_version, bool shader_cache) {
     SceGxmProgramType program_type = program.get_type();
 
     auto shader_type_to_str = [](SceGxmProgramType type) {
@@ -240,25 +289,25 @@ std::string load_glsl_shader(const SceGxmProgram &program, const FeatureState &f
     };
 
     const char *shader_type_str = shader_type_to_str(program_type);
-    return load_shader_generic(shader::Target::GLSLOpenGL, program, features, hints, maskupdate, base_path, title_id, self_name, shader_type_str, shader_version, shader_cache).glsl;
+    return load_shader_generic(renderer, shader::Target::GLSLOpenGL, program, hash, features, hints, maskupdate, shader_type_str, shader_version, shader_cache).glsl;
 }
 
-std::vector<uint32_t> load_spirv_shader(const SceGxmProgram &program, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, bool shader_cache) {
+std::vector<uint32_t> load_spirv_shader(State &renderer, const SceGxmProgram &program, const Sha256Hash &hash, const FeatureState &features, bool is_vulkan, const shader::Hints &hints, bool maskupdate, const std::string &shader_version, bool shader_cache) {
     const shader::Target target = is_vulkan ? shader::Target::SpirVVulkan : shader::Target::SpirVOpenGL;
     auto shader_type_to_str = [](SceGxmProgramType type) {
         return (type == SceGxmProgramType::Vertex) ? "vert.spv.txt" : ((type == SceGxmProgramType::Fragment) ? "frag.spv.txt" : "unknown.spv.txt");
     };
     const char *shader_type_str = shader_type_to_str(program.get_type());
 
-    return load_shader_generic(target, program, features, hints, maskupdate, base_path, title_id, self_name, shader_type_str, shader_version, shader_cache).spirv;
+    return load_shader_generic(renderer, target, program, hash, features, hints, maskupdate, shader_type_str, shader_version, shader_cache).spirv;
 }
 
-std::string pre_load_shader_glsl(const char *hash_text, const char *shader_type_str, const char *base_path, const char *title_id, const char *self_name) {
-    return load_shader_generic<std::string>(hash_text, base_path, title_id, self_name, shader_type_str);
+std::string pre_load_shader_glsl(const char *hash_text, const char *shader_type_str, const char *base_path, const char *title_id, const char *self_name, ShaderPack *shader_pack) {
+    return load_shader_generic<std::string>(hash_text, base_path, title_id, self_name, shader_pack, shader_type_str);
 }
 
-std::vector<uint32_t> pre_load_shader_spirv(const char *hash_text, const char *shader_type_str, const char *base_path, const char *title_id, const char *self_name) {
-    return load_shader_generic<std::vector<uint32_t>>(hash_text, base_path, title_id, self_name, shader_type_str);
+std::vector<uint32_t> pre_load_shader_spirv(const char *hash_text, const char *shader_type_str, const char *base_path, const char *title_id, const char *self_name, ShaderPack *shader_pack) {
+    return load_shader_generic<std::vector<uint32_t>>(hash_text, base_path, title_id, self_name, shader_pack, shader_type_str);
 }
 
 } // namespace renderer
@@ -0,0 +1,98 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/shared_shader_cache.h>
+
+#include <features/state.h>
+#include <util/log.h>
+
+#include <fmt/format.h>
+
+#include <random>
+
+namespace renderer {
+
+SharedShaderCache::SharedShaderCache(const fs::path &root)
+    : root(root) {
+    LOG_INFO("Using the shared shader cache in {}", root.string());
+}
+
+std::vector<uint8_t> SharedShaderCache::read(const fs::path &name) const {
+    std::vector<uint8_t> data;
+    fs::ifstream file(root / name, std::ios::in | std::ios::binary);
+    if (!file)
+        return data;
+
+    file.seekg(0, fs::ifstream::end);
+    const std::streamoff size = file.tellg();
+    if (size <= 0)
+        return data;
+
+    file.seekg(0);
+    data.resize(static_cast<size_t>(size));
+    if (!file.read(reinterpret_cast<char *>(data.data()), size))
+        data.clear();
+
+    return data;
+}
+
+void SharedShaderCache::write(const fs::path &name, const void *data, size_t size, bool replace) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    writer.submit([path = root / name, contents = std::vector<uint8_t>(bytes, bytes + size), replace]() {
+        boost::system::error_code error;
+        if (!replace && fs::exists(path, error))
+            return;
+
+        fs::create_directories(path.parent_path(), error);
+        // several machines can write the same entry, each one uses its own temporary file
+        const fs::path tmp_path = fs::path(path).concat(fmt::format(".{:08x}.tmp", std::random_device{}()));
+        {
+            fs::ofstream file(tmp_path, std::ios::out | std::ios::binary);
+            if (!file || !file.write(reinterpret_cast<const char *>(contents.data()), contents.size())) {
+                LOG_WARN("Could not write {} to the shared shader cache", path.string());
+                file.close();
+                fs::remove(tmp_path, error);
+                return;
+            }
+        }
+
+        fs::rename(tmp_path, path, error);
+        if (error)
+            fs::remove(tmp_path, error);
+    });
+}
+
+std::string get_shared_shaders_dir(const char *backend_name, const FeatureState &features) {
+    const bool flags[] = {
+        features.support_shader_interlock,
+        features.support_texture_barrier,
+        features.direct_fragcolor,
+        features.spirv_shader,
+        features.preserve_f16_nan_as_u16,
+        features.support_unknown_format,
+        features.support_rgb_attributes,
+        features.use_mask_bit,
+        features.support_memory_mapping,
+    };
+    uint32_t mask = 0;
+    for (size_t i = 0; i < std::size(flags); i++)
+        mask |= static_cast<uint32_t>(flags[i]) << i;
+
+    return fmt::format("shaders-{}-{:03x}", backend_name, mask);
+}
+
+} // namespace renderer
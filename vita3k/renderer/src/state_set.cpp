@@ -272,7 +272,7 @@ COMMAND_SET_STATE(depth_func) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_extended_dynamic_state(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
@@ -297,7 +297,7 @@ COMMAND_SET_STATE(depth_write_enable) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_extended_dynamic_state(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
@@ -383,7 +383,7 @@ COMMAND_SET_STATE(stencil_func) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(dynamic_cast<vulkan::VKContext &>(*render_context));
+        vulkan::sync_extended_dynamic_state(dynamic_cast<vulkan::VKContext &>(*render_context));
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), !is_front);
         break;
 
@@ -451,7 +451,7 @@ COMMAND_SET_STATE(two_sided) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_extended_dynamic_state(*reinterpret_cast<vulkan::VKContext *>(render_context));
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), false);
         // this second call is useless if two_sided is disabled
         vulkan::sync_stencil_func(dynamic_cast<vulkan::VKContext &>(*render_context), true);
@@ -473,7 +473,7 @@ COMMAND_SET_STATE(cull_mode) {
         break;
 
     case Backend::Vulkan:
-        vulkan::refresh_pipeline(*reinterpret_cast<vulkan::VKContext *>(render_context));
+        vulkan::sync_extended_dynamic_state(*reinterpret_cast<vulkan::VKContext *>(render_context));
         break;
 
     default:
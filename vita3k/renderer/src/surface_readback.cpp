@@ -0,0 +1,61 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/surface_readback.h>
+
+#include <mem/functions.h>
+#include <mem/ptr.h>
+
+namespace renderer {
+
+// set while this thread writes a readback, it can't wait for the readbacks queued after it
+static thread_local bool is_writing_readback = false;
+
+void SurfaceReadbackSync::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condv.wait(lock, [&] { return done; });
+}
+
+void protect_surface_readback(MemState &mem, const std::shared_ptr<SurfaceReadbackSync> &readback) {
+    // the block doesn't keep the readback alive, the readback holds the block until it is written
+    readback->protect_block = add_protect_block(mem, readback->address, readback->size, MEM_PERM_NONE,
+        [weak_readback = std::weak_ptr<SurfaceReadbackSync>(readback)](Address, bool) {
+            const std::shared_ptr<SurfaceReadbackSync> readback = weak_readback.lock();
+            // a later readback of the same memory is overwriting this one anyway
+            if (!readback || is_writing_readback)
+                return true;
+
+            defer_protect_wait([readback]() { readback->wait(); });
+            return false;
+        });
+}
+
+void write_surface_readback(MemState &mem, SurfaceReadbackSync &readback, const std::function<void(uint8_t *)> &write) {
+    is_writing_readback = true;
+    remove_protect(mem, readback.protect_block);
+    readback.protect_block = nullptr;
+    prepare_host_access(mem, readback.address, readback.size, true);
+    write(Ptr<uint8_t>(readback.address).get(mem));
+    is_writing_readback = false;
+
+    std::unique_lock<std::mutex> lock(readback.mutex);
+    readback.done = true;
+    lock.unlock();
+    readback.done_condv.notify_all();
+}
+
+} // namespace renderer
@@ -73,7 +73,10 @@ COMMAND(new_frame) {
     TRACY_FUNC_COMMANDS(new_frame);
     if (renderer.current_backend == Backend::Vulkan) {
         vulkan::new_frame(*reinterpret_cast<vulkan::VKContext *>(renderer.context));
+    } else if (renderer.context) {
+        gl::new_frame(dynamic_cast<gl::GLState &>(renderer), *reinterpret_cast<gl::GLContext *>(renderer.context));
     }
+    renderer.command_arena.retire_frame();
 }
 
 // Client side function
@@ -123,6 +126,6 @@ void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp) {
 
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list) {
     command_list.context = context;
-    state.command_buffer_queue.push(std::move(command_list));
+    state.command_buffer_queue.push(command_list);
 }
 } // namespace renderer
@@ -15,11 +15,14 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <renderer/draw_profile.h>
 #include <renderer/functions.h>
 
 #include <renderer/profile.h>
 #include <renderer/pvrt-dec.h>
+#include <renderer/state.h>
 #include <renderer/texture_cache_state.h>
+#include <renderer/texture_disk_cache.h>
 
 #include <gxm/functions.h>
 #include <mem/ptr.h>
@@ -29,6 +32,8 @@
 #include <algorithm> // find
 #include <cstring> // memcmp
 #include <numeric> // accumulate, reduce
+#include <thread>
+#include <utility>
 #include <xxh3.h>
 #ifdef WIN32
 #include <execution>
@@ -70,21 +75,81 @@ TextureCacheHash hash_texture_data(const SceGxmTexture &texture, const MemState
     }
 }
 
-static size_t find_lru(const TextureCacheState &cache, TextureCacheTimestamp current_time) {
-    R_PROFILE(__func__);
+static size_t get_lookup_slot(const SceGxmTexture &texture) {
+    return XXH_INLINE_XXH3_64bits(&texture, sizeof(SceGxmTexture)) & (TextureCacheLookupSize - 1);
+}
+
+static int find_cached_texture(const TextureCacheState &cache, const SceGxmTexture &texture) {
+    for (size_t slot = get_lookup_slot(texture); cache.lookup[slot]; slot = (slot + 1) & (TextureCacheLookupSize - 1)) {
+        const size_t index = cache.lookup[slot] - 1;
+        if (memcmp(&cache.infoes[index].texture, &texture, sizeof(SceGxmTexture)) == 0)
+            return static_cast<int>(index);
+    }
+
+    return -1;
+}
+
+static void insert_cached_texture(TextureCacheState &cache, size_t index) {
+    size_t slot = get_lookup_slot(cache.infoes[index].texture);
+    while (cache.lookup[slot])
+        slot = (slot + 1) & (TextureCacheLookupSize - 1);
+
+    cache.lookup[slot] = static_cast<uint16_t>(index + 1);
+}
+
+static void erase_cached_texture(TextureCacheState &cache, size_t index) {
+    constexpr size_t mask = TextureCacheLookupSize - 1;
+
+    size_t hole = get_lookup_slot(cache.infoes[index].texture);
+    while (cache.lookup[hole] != index + 1)
+        hole = (hole + 1) & mask;
+
+    // Shift back the following entries of the probe sequence which are allowed to fill the hole,
+    // so that lookups never need tombstones
+    for (size_t slot = (hole + 1) & mask; cache.lookup[slot]; slot = (slot + 1) & mask) {
+        const size_t home = get_lookup_slot(cache.infoes[cache.lookup[slot] - 1].texture);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            cache.lookup[hole] = cache.lookup[slot];
+            hole = slot;
+        }
+    }
+
+    cache.lookup[hole] = 0;
+}
+
+static void lru_unlink(TextureCacheState &cache, uint16_t index) {
+    const uint16_t prev = cache.lru_prev[index];
+    const uint16_t next = cache.lru_next[index];
+    (prev == TextureCacheNone ? cache.lru_oldest : cache.lru_next[prev]) = next;
+    (next == TextureCacheNone ? cache.lru_newest : cache.lru_prev[next]) = prev;
+}
 
-    uint64_t oldest_age = current_time - cache.infoes.front().timestamp;
-    size_t oldest_index = 0;
+static void lru_push_newest(TextureCacheState &cache, uint16_t index) {
+    cache.lru_prev[index] = cache.lru_newest;
+    cache.lru_next[index] = TextureCacheNone;
+    (cache.lru_newest == TextureCacheNone ? cache.lru_oldest : cache.lru_next[cache.lru_newest]) = index;
+    cache.lru_newest = index;
+}
 
-    for (size_t index = 1; index < cache.infoes.size(); ++index) {
-        const uint64_t age = current_time - cache.infoes[index].timestamp;
-        if (age > oldest_age) {
-            oldest_age = age;
-            oldest_index = index;
+// Number of the least recently used entries looked at when choosing the one to evict
+static constexpr size_t EvictionCandidates = 8;
+
+// Pick among the least recently used entries the one whose data took the most room for the longest time,
+// so a big texture left unused goes before several small ones which were bound about as long ago
+static uint16_t pick_eviction_victim(const TextureCacheState &cache) {
+    uint16_t victim = cache.lru_oldest;
+    uint64_t victim_cost = 0;
+    uint16_t index = cache.lru_oldest;
+    for (size_t i = 0; i < EvictionCandidates && index != TextureCacheNone; i++, index = cache.lru_next[index]) {
+        const TextureCacheInfo &info = cache.infoes[index];
+        const uint64_t cost = (cache.timestamp - info.timestamp) * std::max<uint64_t>(info.size, 1);
+        if (cost > victim_cost) {
+            victim = index;
+            victim_cost = cost;
         }
     }
 
-    return oldest_index;
+    return victim;
 }
 
 bool can_texture_be_unswizzled_without_decode(SceGxmTextureBaseFormat fmt, bool is_vulkan) {
@@ -417,18 +482,32 @@ uint16_t get_upload_mip(const uint16_t true_mip, const uint16_t width, const uin
     return std::min(true_mip, max_mip_text);
 }
 
-void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
-    R_PROFILE(__func__);
+PvrtcUploadMode get_pvrtc_upload_mode(const TextureCacheState &cache, const SceGxmTexture &gxm_texture) {
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(&gxm_texture));
+    if ((base_format < SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) || (base_format > SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP))
+        return PvrtcUploadMode::Decode;
 
-    bool is_vulkan = (*cache.backend == Backend::Vulkan);
+    const auto texture_type = gxm_texture.texture_type();
+    if ((texture_type != SCE_GXM_TEXTURE_SWIZZLED) && (texture_type != SCE_GXM_TEXTURE_CUBE))
+        return PvrtcUploadMode::Decode;
+
+    return cache.pvrtc_upload_mode;
+}
+
+// Decode the texture data and give each face and mip to the upload function, can be called from any thread
+static void decode_texture(const SceGxmTexture &gxm_texture, const MemState &mem, const bool is_vulkan, const PvrtcUploadMode pvrtc_mode, const TextureCacheStateUploadTextureCallback &upload) {
+    R_PROFILE(__func__);
 
     const SceGxmTextureFormat fmt = gxm::get_format(&gxm_texture);
     const SceGxmTextureBaseFormat base_format = gxm::get_base_format(fmt);
 
     const bool block_compressed = renderer::texture::is_compressed_format(base_format);
+    // the PVRTC blocks are uploaded as they are, like the BC ones
+    const bool native_pvrtc = (pvrtc_mode == PvrtcUploadMode::Native);
+    const bool compressed_upload = block_compressed || native_pvrtc || (pvrtc_mode == PvrtcUploadMode::TranscodeBC);
     auto width = static_cast<uint32_t>(gxm::get_width(&gxm_texture));
     auto height = static_cast<uint32_t>(gxm::get_height(&gxm_texture));
-    if (block_compressed) {
+    if (block_compressed || native_pvrtc) {
         // align width and height to block size
         width = (width + 3) & ~3;
         height = (height + 3) & ~3;
@@ -455,7 +534,7 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
     const auto texture_type = gxm_texture.texture_type();
     const bool is_swizzled = (texture_type == SCE_GXM_TEXTURE_SWIZZLED) || (texture_type == SCE_GXM_TEXTURE_CUBE) || (texture_type == SCE_GXM_TEXTURE_SWIZZLED_ARBITRARY) || (texture_type == SCE_GXM_TEXTURE_CUBE_ARBITRARY);
     const bool need_unswizzle = is_swizzled && block_compressed;
-    const bool need_decompress_and_unswizzle_on_cpu = is_swizzled && !block_compressed && !can_texture_be_unswizzled_without_decode(base_format, is_vulkan);
+    const bool need_decompress_and_unswizzle_on_cpu = is_swizzled && !block_compressed && !native_pvrtc && !can_texture_be_unswizzled_without_decode(base_format, is_vulkan);
 
     uint32_t mip_index = 0;
     uint32_t total_mip = get_upload_mip(gxm_texture.true_mip_count(), width, height, base_format);
@@ -557,6 +636,23 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
         case SCE_GXM_TEXTURE_BASE_FORMAT_PVRT4BPP:
         case SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP:
         case SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP:
+            if (native_pvrtc) {
+                source_size = renderer::texture::get_compressed_size(base_format, width, height);
+                // the row length must be a multiple of the block width, which is 8 for 2bpp textures
+                pixels_per_stride = align(width, 8);
+            } else if (pvrtc_mode == PvrtcUploadMode::TranscodeBC) {
+                // the decompressed texels are compressed again, the image size is a multiple of the block size
+                upload_format = renderer::texture::get_pvrtc_transcode_format(fmt);
+                texture_pixels_lineared.resize(renderer::texture::get_compressed_size(upload_format, width, height));
+                if (upload_format == SCE_GXM_TEXTURE_BASE_FORMAT_UBC1)
+                    renderer::texture::rgba_texture_to_bc1(texture_pixels_lineared.data(), reinterpret_cast<const uint8_t *>(pixels), width, height);
+                else
+                    renderer::texture::rgba_texture_to_bc3(texture_pixels_lineared.data(), reinterpret_cast<const uint8_t *>(pixels), width, height);
+                pixels = texture_pixels_lineared.data();
+                width = align(width, 4);
+                height = align(height, 4);
+                pixels_per_stride = width;
+            }
             break;
         case SCE_GXM_TEXTURE_BASE_FORMAT_SE5M9M9M9:
             // this format is supported on all GPUs with vulkan
@@ -660,8 +756,11 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
             case SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC1:
             case SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC1: {
                 yuv_texture_pixels.resize(width * height * 3);
+                const bool is_two_planes = base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2;
+                const bool is_yvu = fmt == SCE_GXM_TEXTURE_FORMAT_YVU420P2_CSC0 || fmt == SCE_GXM_TEXTURE_FORMAT_YVU420P2_CSC1
+                    || fmt == SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC0 || fmt == SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC1;
                 renderer::texture::yuv420_texture_to_rgb(yuv_texture_pixels.data(),
-                    reinterpret_cast<const uint8_t *>(pixels), width, height);
+                    reinterpret_cast<const uint8_t *>(pixels), width, height, is_two_planes, is_yvu);
                 pixels = yuv_texture_pixels.data();
                 pixels_per_stride = width;
                 bpp = 24;
@@ -684,11 +783,11 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
             }
         }
 
-        if (!block_compressed && !need_decompress_and_unswizzle_on_cpu) {
+        if (!compressed_upload && !need_decompress_and_unswizzle_on_cpu) {
             source_size = (pixels_per_stride * height * ((bpp + 7) >> 3));
         }
 
-        cache.upload_texture_callback(upload_format, width, height, mip_index, pixels, upload_type, block_compressed, pixels_per_stride);
+        upload(upload_format, width, height, mip_index, pixels, upload_type, compressed_upload, pixels_per_stride, 0);
 
         mip_index++;
         org_width /= 2;
@@ -714,6 +813,273 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
     }
 }
 
+// the upload callback of the backend, its time is counted apart from the decoding which calls it
+static TextureCacheStateUploadTextureCallback get_profiled_upload_callback(const TextureCacheState &cache) {
+    return [&cache](SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset) {
+        const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_UPLOAD);
+        cache.upload_texture_callback(base_format, width, height, mip_index, pixels, face, is_compressed, pixels_per_stride, row_offset);
+    };
+}
+
+void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
+    decode_texture(gxm_texture, mem, *cache.backend == Backend::Vulkan, get_pvrtc_upload_mode(cache, gxm_texture), get_profiled_upload_callback(cache));
+}
+
+// Keep all the regions given by decode_texture, to upload them later
+static void decode_texture_to_memory(const SceGxmTexture &gxm_texture, const MemState &mem, const bool is_vulkan, const PvrtcUploadMode pvrtc_mode, DecodedTexture &decoded) {
+    decode_texture(gxm_texture, mem, is_vulkan, pvrtc_mode, [&](SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t) {
+        const size_t size = get_upload_size(base_format, width, height, is_compressed, pixels_per_stride);
+        const size_t offset = decoded.data.size();
+        decoded.data.resize(offset + size);
+        memcpy(decoded.data.data() + offset, pixels, size);
+        decoded.regions.push_back({ base_format, width, height, mip_index, face, is_compressed, pixels_per_stride, offset });
+    });
+}
+
+static void upload_decoded_texture(const TextureCacheState &cache, const DecodedTexture &decoded) {
+    const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_UPLOAD);
+    for (const DecodedTextureRegion &region : decoded.regions)
+        cache.upload_texture_callback(region.base_format, region.width, region.height, region.mip_index, decoded.data.data() + region.offset,
+            region.face, region.is_compressed, region.pixels_per_stride, 0);
+}
+
+void init_async_texture_decode(TextureCacheState &cache, const bool draw_previous_contents) {
+    const uint32_t thread_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+    cache.decode_pool = std::make_unique<JobPool>(thread_count);
+    cache.draw_previous_contents = draw_previous_contents;
+}
+
+static void cancel_pending_upload(TextureCacheState &cache, size_t index);
+
+// Drop the entry from the cache, its index can then be given to another texture
+static void remove_cached_texture(TextureCacheState &cache, uint16_t index) {
+    erase_cached_texture(cache, index);
+    lru_unlink(cache, index);
+    cancel_pending_upload(cache, index);
+    cache.used_bytes -= cache.infoes[index].size;
+    cache.infoes[index].size = 0;
+    cache.frame_stats.evictions++;
+}
+
+static void cancel_pending_upload(TextureCacheState &cache, size_t index) {
+    // the job can keep running, its result is just ignored
+    std::erase_if(cache.pending_uploads, [&](const PendingTextureUpload &pending) { return pending.index == index; });
+}
+
+static bool has_pending_upload(const TextureCacheState &cache, size_t index) {
+    return std::any_of(cache.pending_uploads.begin(), cache.pending_uploads.end(), [&](const PendingTextureUpload &pending) { return pending.index == index; });
+}
+
+static void upload_bound_texture_async(TextureCacheState &cache, size_t index, const SceGxmTexture &gxm_texture, const MemState &mem, const bool wait_for_draw, const bool store_on_disk, const uint64_t disk_cache_key) {
+    cancel_pending_upload(cache, index);
+
+    auto decoded = std::make_shared<DecodedTexture>();
+    const bool is_vulkan = *cache.backend == Backend::Vulkan;
+    const PvrtcUploadMode pvrtc_mode = get_pvrtc_upload_mode(cache, gxm_texture);
+    // the disk cache is given to the job, the texture cache may not have it anymore once it is done
+    std::shared_ptr<TextureDiskCache> disk_cache = store_on_disk ? cache.disk_cache : nullptr;
+    JobPtr job = cache.decode_pool->submit([decoded, gxm_texture, &mem, is_vulkan, pvrtc_mode, disk_cache, disk_cache_key]() {
+        decode_texture_to_memory(gxm_texture, mem, is_vulkan, pvrtc_mode, *decoded);
+        if (disk_cache)
+            disk_cache->store(disk_cache_key, *decoded);
+    });
+
+    cache.pending_uploads.push_back({ index, gxm_texture, wait_for_draw, std::move(decoded), std::move(job) });
+}
+
+void flush_pending_texture_uploads(TextureCacheState &cache, const bool wait_all) {
+    R_PROFILE(__func__);
+
+    std::erase_if(cache.pending_uploads, [&](const PendingTextureUpload &pending) {
+        if (!pending.wait_for_draw && !wait_all && !pending.job->is_done())
+            return false;
+
+        pending.job->wait();
+        cache.select_callback(pending.index, &pending.texture);
+        upload_decoded_texture(cache, *pending.decoded);
+        cache.upload_done_callback();
+        return true;
+    });
+}
+
+// Only single mip linear textures uploaded without any conversion can have a part of their rows uploaded alone
+static bool can_texture_be_partially_uploaded(const SceGxmTexture &gxm_texture, const bool is_vulkan) {
+    const auto texture_type = gxm_texture.texture_type();
+    if (texture_type != SCE_GXM_TEXTURE_LINEAR && texture_type != SCE_GXM_TEXTURE_LINEAR_STRIDED)
+        return false;
+
+    const SceGxmTextureFormat fmt = gxm::get_format(&gxm_texture);
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(fmt);
+    if (is_compressed_format(base_format) || gxm::is_paletted_format(base_format) || gxm::is_yuv_format(base_format))
+        return false;
+
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_X8U24:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_F32M:
+        return false;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_SE5M9M9M9:
+        if (!is_vulkan)
+            return false;
+        break;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_U2F10F10F10:
+        if (is_vulkan)
+            return false;
+        break;
+    default:
+        break;
+    }
+
+    if (texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED)
+        return true;
+
+    const auto width = static_cast<uint16_t>(gxm::get_width(&gxm_texture));
+    const auto height = static_cast<uint16_t>(gxm::get_height(&gxm_texture));
+    return get_upload_mip(gxm_texture.true_mip_count(), width, height, base_format) == 1;
+}
+
+static void hash_texture_pages(const SceGxmTexture &gxm_texture, const MemState &mem, std::vector<TextureCacheHash> &page_hashes) {
+    R_PROFILE(__func__);
+    const size_t size = texture_size(gxm_texture);
+    const uint8_t *data = Ptr<const uint8_t>(gxm_texture.data_addr << 2).get(mem);
+
+    page_hashes.resize((size + TextureCachePageSize - 1) / TextureCachePageSize);
+    for (size_t page = 0; page < page_hashes.size(); page++) {
+        const size_t offset = page * TextureCachePageSize;
+        page_hashes[page] = hash_data(data + offset, std::min(TextureCachePageSize, size - offset));
+    }
+}
+
+// Returns false if no page changed, otherwise the byte range [dirty_begin, dirty_end) covers all the pages that changed
+static bool get_dirty_range(const std::vector<TextureCacheHash> &old_hashes, const std::vector<TextureCacheHash> &new_hashes, size_t &dirty_begin, size_t &dirty_end) {
+    const auto first_dirty = std::mismatch(old_hashes.begin(), old_hashes.end(), new_hashes.begin()).first;
+    if (first_dirty == old_hashes.end())
+        return false;
+
+    const auto last_dirty = std::mismatch(old_hashes.rbegin(), old_hashes.rend(), new_hashes.rbegin()).first;
+    dirty_begin = (first_dirty - old_hashes.begin()) * TextureCachePageSize;
+    dirty_end = (old_hashes.rend() - last_dirty) * TextureCachePageSize;
+    return true;
+}
+
+// Upload the rows of a texture which can be partially uploaded containing the byte range [dirty_begin, dirty_end)
+static void upload_bound_texture_rows(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem, size_t dirty_begin, size_t dirty_end) {
+    R_PROFILE(__func__);
+
+    const SceGxmTextureFormat fmt = gxm::get_format(&gxm_texture);
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(fmt);
+    const auto width = static_cast<uint32_t>(gxm::get_width(&gxm_texture));
+    const auto height = static_cast<uint32_t>(gxm::get_height(&gxm_texture));
+    const size_t bytes_per_pixel = (bits_per_pixel(base_format) + 7) >> 3;
+
+    size_t pixels_per_stride;
+    if (gxm_texture.texture_type() == SCE_GXM_TEXTURE_LINEAR_STRIDED)
+        pixels_per_stride = gxm::get_stride_in_bytes(&gxm_texture) / bytes_per_pixel;
+    else
+        pixels_per_stride = static_cast<size_t>((width + 7) & ~7);
+    const size_t stride = pixels_per_stride * bytes_per_pixel;
+
+    const uint32_t first_row = static_cast<uint32_t>(dirty_begin / stride);
+    const uint32_t end_row = std::min(height, static_cast<uint32_t>((dirty_end + stride - 1) / stride));
+    if (first_row >= end_row)
+        return;
+
+    const uint8_t *pixels = Ptr<const uint8_t>(gxm_texture.data_addr << 2).get(mem) + first_row * stride;
+    const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_UPLOAD);
+    cache.upload_texture_callback(base_format, width, end_row - first_row, 0, pixels, 0, false, pixels_per_stride, first_row);
+}
+
+// The disk cache only keeps the textures which take time to decode and which are not changed on every frame like the videos.
+// The data read by decode_texture must be hashed, the cube and the paletted textures with mips are not kept as their layout is harder to follow.
+static bool can_texture_be_stored_on_disk(const SceGxmTexture &gxm_texture) {
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(&gxm_texture));
+    if (gxm::is_yuv_format(base_format))
+        return false;
+
+    const auto texture_type = gxm_texture.texture_type();
+    if (texture_type == SCE_GXM_TEXTURE_CUBE || texture_type == SCE_GXM_TEXTURE_CUBE_ARBITRARY)
+        return false;
+
+    const bool is_linear = (texture_type == SCE_GXM_TEXTURE_LINEAR) || (texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED);
+    if (!gxm::is_paletted_format(base_format))
+        return !is_linear;
+
+    if (texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED)
+        return true;
+
+    const auto width = static_cast<uint16_t>(gxm::get_width(&gxm_texture));
+    const auto height = static_cast<uint16_t>(gxm::get_height(&gxm_texture));
+    return get_upload_mip(gxm_texture.true_mip_count(), width, height, base_format) == 1;
+}
+
+// Size of the data read by decode_texture for a texture which can be stored on disk
+static size_t get_texture_source_size(const SceGxmTexture &gxm_texture) {
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(&gxm_texture));
+    const auto texture_type = gxm_texture.texture_type();
+    const size_t bpp = bits_per_pixel(base_format);
+    if (texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED)
+        return gxm::get_stride_in_bytes(&gxm_texture) * gxm::get_height(&gxm_texture);
+
+    const bool block_compressed = is_block_compressed_format(base_format);
+    auto width = static_cast<uint32_t>(gxm::get_width(&gxm_texture));
+    auto height = static_cast<uint32_t>(gxm::get_height(&gxm_texture));
+    if (block_compressed) {
+        width = align(width, 4);
+        height = align(height, 4);
+    }
+
+    const uint32_t mip_count = get_upload_mip(gxm_texture.true_mip_count(), width, height, base_format);
+    size_t size = 0;
+    for (uint32_t mip = 0; mip < mip_count && (width >> mip) && (height >> mip); mip++) {
+        uint32_t mip_width = width >> mip;
+        uint32_t mip_height = height >> mip;
+        if (texture_type == SCE_GXM_TEXTURE_SWIZZLED_ARBITRARY) {
+            mip_width = next_power_of_two(mip_width);
+            mip_height = next_power_of_two(mip_height);
+        }
+
+        if (block_compressed)
+            size += get_compressed_size(base_format, mip_width, mip_height);
+        else if (texture_type == SCE_GXM_TEXTURE_LINEAR)
+            size += (align(mip_width, 8) * mip_height * bpp) / 8;
+        else
+            size += (static_cast<size_t>(mip_width) * mip_height * bpp + 7) / 8;
+    }
+
+    return size;
+}
+
+// The decoded texture depends on its data, its palette and its control words (but not on the addresses), and on how the backend wants it
+static uint64_t get_disk_cache_key(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
+    struct DiskCacheKeyInfo {
+        SceGxmTexture texture;
+        uint32_t is_vulkan;
+        uint32_t pvrtc_mode;
+    };
+    DiskCacheKeyInfo key_info{ gxm_texture, *cache.backend == Backend::Vulkan, static_cast<uint32_t>(get_pvrtc_upload_mode(cache, gxm_texture)) };
+    key_info.texture.data_addr = 0;
+    key_info.texture.palette_addr = 0;
+
+    const uint64_t seed = XXH_INLINE_XXH3_64bits(&key_info, sizeof(key_info));
+    const uint8_t *data = Ptr<const uint8_t>(gxm_texture.data_addr << 2).get(mem);
+    uint64_t key = XXH_INLINE_XXH3_64bits_withSeed(data, get_texture_source_size(gxm_texture), seed);
+
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(&gxm_texture));
+    if (gxm::is_paletted_format(base_format)) {
+        const size_t palette_size = (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_P4 ? 16 : 256) * sizeof(uint32_t);
+        key = XXH_INLINE_XXH3_64bits_withSeed(get_texture_palette(gxm_texture, mem), palette_size, key);
+    }
+
+    return key;
+}
+
+// Decode the texture in memory to upload it and keep it on disk for the next sessions
+static void upload_and_store_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem, const uint64_t disk_cache_key) {
+    DecodedTexture decoded;
+    decode_texture_to_memory(gxm_texture, mem, *cache.backend == Backend::Vulkan, get_pvrtc_upload_mode(cache, gxm_texture), decoded);
+    upload_decoded_texture(cache, decoded);
+    cache.disk_cache->store(disk_cache_key, decoded);
+}
+
 void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_texture, MemState &mem) {
     R_PROFILE(__func__);
 
@@ -723,13 +1089,11 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
     const size_t size = texture_size(gxm_texture);
 
     // Try to find GXM texture in cache.
-    int cached_gxm_texture_index = -1;
-    for (size_t a = 0; a < cache.used; a++) {
-        if (memcmp(&cache.infoes[a].texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
-            cached_gxm_texture_index = a;
-            break;
-        }
-    }
+    const int cached_gxm_texture_index = find_cached_texture(cache, gxm_texture);
+    const bool can_partially_upload = can_texture_be_partially_uploaded(gxm_texture, *cache.backend == Backend::Vulkan);
+    bool partial_upload = false;
+    size_t dirty_begin = 0;
+    size_t dirty_end = 0;
 
     Address range_protect_begin = 0;
     Address range_protect_end = 0;
@@ -748,32 +1112,65 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
         }
     }
 
+    cache.frame_stats.lookups++;
     TextureCacheInfo *info;
     if (cached_gxm_texture_index == -1) {
         // Texture not found in cache.
-        if (cache.used < TextureCacheSize) {
+        // Make room for it if the cached textures would go over the byte budget, their backend textures are released
+        while (cache.byte_budget && (cache.used_bytes + size > cache.byte_budget) && (cache.lru_oldest != TextureCacheNone)) {
+            const uint16_t victim = pick_eviction_victim(cache);
+            LOG_DEBUG("Evicting texture {} ({} bytes) to stay under the texture cache budget.", victim, cache.infoes[victim].size);
+            remove_cached_texture(cache, victim);
+            if (cache.evict_texture_callback)
+                cache.evict_texture_callback(victim);
+            cache.free_indices.push_back(victim);
+        }
+
+        if (!cache.free_indices.empty()) {
+            // Reuse an entry whose texture was evicted.
+            index = cache.free_indices.back();
+            cache.free_indices.pop_back();
+        } else if (cache.used < cache.capacity) {
             // Cache is not full. Add texture to cache.
             index = cache.used;
             ++cache.used;
         } else {
-            // Cache is full. Find least recently used texture.
-            index = find_lru(cache, cache.timestamp);
+            // Cache is full. Evict one of the least recently used textures.
+            index = pick_eviction_victim(cache);
             LOG_DEBUG("Evicting texture {} (t = {}) from cache. Current t = {}.", index, cache.infoes[index].timestamp, cache.timestamp);
+            remove_cached_texture(cache, static_cast<uint16_t>(index));
         }
         configure = true;
         upload = true;
         cache.infoes[index] = TextureCacheInfo(gxm_texture);
+        insert_cached_texture(cache, index);
+        lru_push_newest(cache, static_cast<uint16_t>(index));
         info = &cache.infoes[index];
+        info->size = static_cast<uint32_t>(size);
+        cache.used_bytes += size;
         info->use_hash = should_use_hash;
-        if (info->use_hash) {
+        const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_HASH);
+        if (can_partially_upload && gxm_texture.data_addr != 0) {
+            hash_texture_pages(gxm_texture, mem, info->page_hashes);
+        } else if (info->use_hash) {
             info->hash = hash_texture_data(gxm_texture, mem);
         }
     } else {
         // Texture is cached.
+        cache.frame_stats.hits++;
         index = cached_gxm_texture_index;
         info = &cache.infoes[index];
+        lru_unlink(cache, static_cast<uint16_t>(index));
+        lru_push_newest(cache, static_cast<uint16_t>(index));
         configure = false;
-        if (info->use_hash) {
+        const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_HASH);
+        if (!info->page_hashes.empty() && (info->use_hash || info->dirty)) {
+            // Only upload the rows of the pages which changed
+            hash_texture_pages(gxm_texture, mem, cache.page_hashes);
+            upload = get_dirty_range(info->page_hashes, cache.page_hashes, dirty_begin, dirty_end);
+            partial_upload = upload && (dirty_end - dirty_begin < size);
+            std::swap(info->page_hashes, cache.page_hashes);
+        } else if (info->use_hash) {
             const TextureCacheHash hash = hash_texture_data(gxm_texture, mem);
             upload = info->hash != hash;
             info->hash = hash;
@@ -786,6 +1183,18 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
         upload = false;
     }
 
+    // A partial upload must not be overwritten later by an older pending upload
+    const bool async_upload = upload && cache.decode_pool;
+    if (async_upload && has_pending_upload(cache, index))
+        partial_upload = false;
+
+    if (upload) {
+        const size_t upload_bytes = partial_upload ? dirty_end - dirty_begin : size;
+        cache.frame_stats.upload_bytes += upload_bytes;
+        if (cache.draw_profile)
+            cache.draw_profile->count_texture_upload(upload_bytes);
+    }
+
 // Fix memory access error in the condition check for texture cache method
 // (hashed vs hashless) in Clang compilers due to compiler optimizations
 #ifdef __clang__
@@ -799,23 +1208,77 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
     if (configure) {
         cache.configure_texture_callback(cache, &gxm_texture);
     }
-    if (upload) {
-        upload_bound_texture(cache, gxm_texture, mem);
-        if (!info->use_hash) {
-            info->dirty = false;
-            add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MEM_PERM_READONLY, [info, gxm_texture](Address, bool) {
-                if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
-                    info->dirty = true;
-                }
-
-                return true;
-            });
-        }
+    // only the new textures are looked for on disk, the ones which are updated are likely to be rendered by the game
+    const bool use_disk_cache = configure && upload && cache.disk_cache && can_texture_be_stored_on_disk(gxm_texture);
+    const uint64_t disk_cache_key = use_disk_cache ? get_disk_cache_key(cache, gxm_texture, mem) : 0;
+
+    // the decoding and the uploads it does, the textures decoded by the worker threads are uploaded later
+    const DrawProfileScope profile_scope(cache.draw_profile, DRAW_PROFILE_TEXTURE_DECODE);
+    if (use_disk_cache && cache.disk_cache->upload(disk_cache_key, get_profiled_upload_callback(cache))) {
+        cancel_pending_upload(cache, index);
+        cache.upload_done_callback();
+    } else if (upload && !partial_upload && cache.decode_texture_callback && cache.decode_texture_callback(gxm_texture, mem)) {
+        // a pending upload would overwrite it with older data
+        cancel_pending_upload(cache, index);
+        cache.upload_done_callback();
+    } else if (async_upload && !partial_upload) {
+        // the upload is done once decoded, before the next draw for new textures or the ones which can't use their previous content
+        if (configure)
+            cache.upload_done_callback();
+        upload_bound_texture_async(cache, index, gxm_texture, mem, configure || !cache.draw_previous_contents, use_disk_cache, disk_cache_key);
+    } else if (upload) {
+        if (partial_upload)
+            upload_bound_texture_rows(cache, gxm_texture, mem, dirty_begin, dirty_end);
+        else if (use_disk_cache)
+            upload_and_store_bound_texture(cache, gxm_texture, mem, disk_cache_key);
+        else
+            upload_bound_texture(cache, gxm_texture, mem);
         cache.upload_done_callback();
     }
 
+    // The texture may also have been written with the same data, it still needs to be protected again
+    if (!info->use_hash && (upload || info->dirty)) {
+        info->dirty = false;
+        add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MEM_PERM_READONLY, [info, gxm_texture](Address, bool) {
+            if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
+                info->dirty = true;
+            }
+
+            return true;
+        });
+    }
+
     info->timestamp = cache.timestamp++;
 }
 
+size_t evict_textures(TextureCacheState &cache, uint64_t keep_since, size_t size) {
+    size_t released = 0;
+    while (released < size && cache.lru_oldest != TextureCacheNone) {
+        const uint16_t index = cache.lru_oldest;
+        if (cache.infoes[index].timestamp >= keep_since)
+            // all the other textures were bound more recently
+            break;
+
+        remove_cached_texture(cache, index);
+        released += cache.evict_texture_callback(index);
+        cache.free_indices.push_back(index);
+    }
+
+    return released;
+}
+
+void set_cache_limits(TextureCacheState &cache, size_t capacity, size_t byte_budget) {
+    // the entries already used above the capacity stay cached until they get evicted
+    cache.capacity = capacity ? std::min(capacity, TextureCacheSize) : TextureCacheSize;
+    cache.byte_budget = byte_budget;
+}
+
+void publish_frame_stats(TextureCacheState &cache, State &state) {
+    const TextureCacheStats stats = std::exchange(cache.frame_stats, {});
+    state.texture_cache_hit_rate = stats.lookups ? (stats.hits * 100ULL) / stats.lookups : 100;
+    state.texture_upload_bytes = stats.upload_bytes;
+    state.texture_evictions = stats.evictions;
+}
+
 } // namespace texture
 } // namespace renderer
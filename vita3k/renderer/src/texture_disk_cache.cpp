@@ -0,0 +1,284 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/texture_disk_cache.h>
+
+#include <renderer/functions.h>
+
+#include <util/align.h>
+#include <util/log.h>
+
+#include <cstring>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace renderer {
+
+// 'V3KT'
+static constexpr uint32_t PACK_MAGIC = 0x544B3356;
+// must be increased each time the layout of the records or the way the textures are decoded changes
+static constexpr uint32_t PACK_VERSION = 2;
+static constexpr uint32_t RECORD_MAGIC = 0x43455254;
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+// a record is its header, followed by its regions and the decoded data, its whole size is a multiple of 16
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t region_count;
+    uint64_t key;
+    uint64_t data_size;
+};
+
+struct RecordRegion {
+    uint32_t base_format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_index;
+    int32_t face;
+    uint32_t is_compressed;
+    uint64_t pixels_per_stride;
+    uint64_t offset;
+};
+
+// the largest side of a Vita texture
+static constexpr uint32_t MAX_TEXTURE_SIDE = 4096;
+
+// the region must be entirely inside the data of its record, with the bounds checked first so its size can't overflow
+static bool is_region_valid(const RecordRegion &region, uint64_t data_size) {
+    if (region.width > MAX_TEXTURE_SIDE || region.height > MAX_TEXTURE_SIDE || region.pixels_per_stride > data_size)
+        return false;
+
+    const uint64_t size = texture::get_upload_size(static_cast<SceGxmTextureBaseFormat>(region.base_format), region.width, region.height,
+        region.is_compressed != 0, region.pixels_per_stride);
+    return size != 0 && region.offset <= data_size && size <= data_size - region.offset;
+}
+
+static uint64_t get_record_size(uint64_t region_count, uint64_t data_size) {
+    return align(sizeof(RecordHeader) + region_count * sizeof(RecordRegion) + data_size, 16);
+}
+
+TextureDiskCache::TextureDiskCache(const fs::path &path)
+    : path(path) {
+    fs::create_directories(path.parent_path());
+
+    map_file();
+    if (mapped_size == 0 && fs::exists(path))
+        // wrong version or a file too damaged to be used
+        fs::remove(path);
+
+    if (fs::exists(path) && fs::file_size(path) != file_size) {
+        // the last record was not completely written, remove it before appending the new ones
+        unmap_file();
+        fs::resize_file(path, file_size);
+        map_file();
+    }
+
+    file.open(path, std::ios::out | std::ios::binary | std::ios::app);
+    if (!file) {
+        LOG_ERROR("Could not open the texture cache file {}", path.string());
+        return;
+    }
+
+    if (file_size == 0) {
+        const PackHeader header{ PACK_MAGIC, PACK_VERSION };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.flush();
+        file_size = sizeof(header);
+    }
+
+    LOG_INFO("Loaded {} textures from the texture cache file {}", records.size(), path.string());
+}
+
+TextureDiskCache::~TextureDiskCache() {
+    unmap_file();
+}
+
+void TextureDiskCache::map_file() {
+    records.clear();
+    file_size = 0;
+
+    if (!fs::exists(path) || fs::file_size(path) < sizeof(PackHeader))
+        return;
+
+    const uint64_t size = fs::file_size(path);
+#ifdef WIN32
+    file_handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        LOG_ERROR("CreateFileW failed: {}", log_hex(GetLastError()));
+        return;
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle) {
+        LOG_ERROR("CreateFileMappingW failed: {}", log_hex(GetLastError()));
+        unmap_file();
+        return;
+    }
+
+    mapped_data = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped_data) {
+        LOG_ERROR("MapViewOfFile failed: {}", log_hex(GetLastError()));
+        unmap_file();
+        return;
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("Could not open the texture cache file {}", path.string());
+        return;
+    }
+
+    void *const data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid once the file is closed
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("mmap failed");
+        return;
+    }
+    mapped_data = static_cast<const uint8_t *>(data);
+#endif
+    mapped_size = size;
+
+    PackHeader header;
+    memcpy(&header, mapped_data, sizeof(header));
+    if (header.magic != PACK_MAGIC || header.version != PACK_VERSION) {
+        LOG_INFO("Texture cache file {} was made by another version, it will be recreated", path.string());
+        unmap_file();
+        return;
+    }
+
+    // only keep the records until the first one which is incomplete or damaged
+    uint64_t offset = sizeof(PackHeader);
+    while (offset + sizeof(RecordHeader) <= mapped_size) {
+        RecordHeader record;
+        memcpy(&record, mapped_data + offset, sizeof(record));
+        if (record.magic != RECORD_MAGIC || record.data_size > mapped_size || record.region_count > mapped_size)
+            break;
+
+        const uint64_t record_size = get_record_size(record.region_count, record.data_size);
+        if (offset + record_size > mapped_size)
+            break;
+
+        bool is_valid = true;
+        const uint8_t *regions = mapped_data + offset + sizeof(RecordHeader);
+        for (uint32_t i = 0; i < record.region_count; i++) {
+            RecordRegion region;
+            memcpy(&region, regions + i * sizeof(RecordRegion), sizeof(region));
+            is_valid &= is_region_valid(region, record.data_size);
+        }
+        if (!is_valid)
+            break;
+
+        records.emplace(record.key, offset);
+        offset += record_size;
+    }
+    file_size = offset;
+}
+
+void TextureDiskCache::unmap_file() {
+#ifdef WIN32
+    if (mapped_data)
+        UnmapViewOfFile(mapped_data);
+    if (mapping_handle)
+        CloseHandle(mapping_handle);
+    if (file_handle)
+        CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (mapped_data)
+        munmap(const_cast<uint8_t *>(mapped_data), mapped_size);
+#endif
+    mapped_data = nullptr;
+    mapped_size = 0;
+    records.clear();
+}
+
+bool TextureDiskCache::upload(uint64_t key, const TextureCacheStateUploadTextureCallback &upload) const {
+    const auto it = records.find(key);
+    if (it == records.end())
+        return false;
+
+    const uint8_t *record_data = mapped_data + it->second;
+    RecordHeader record;
+    memcpy(&record, record_data, sizeof(record));
+
+    const uint8_t *regions = record_data + sizeof(RecordHeader);
+    const uint8_t *data = regions + record.region_count * sizeof(RecordRegion);
+    for (uint32_t i = 0; i < record.region_count; i++) {
+        RecordRegion region;
+        memcpy(&region, regions + i * sizeof(RecordRegion), sizeof(region));
+        upload(static_cast<SceGxmTextureBaseFormat>(region.base_format), region.width, region.height, region.mip_index, data + region.offset,
+            region.face, region.is_compressed != 0, region.pixels_per_stride, 0);
+    }
+
+    return true;
+}
+
+void TextureDiskCache::store(uint64_t key, const DecodedTexture &decoded) {
+    const std::lock_guard<std::mutex> guard(store_mutex);
+    if (!file || records.contains(key) || stored_keys.contains(key))
+        return;
+
+    const uint64_t record_size = get_record_size(decoded.regions.size(), decoded.data.size());
+    if (file_size + record_size > TextureDiskCacheMaxSize)
+        return;
+
+    const RecordHeader record{ RECORD_MAGIC, static_cast<uint32_t>(decoded.regions.size()), key, decoded.data.size() };
+    file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    for (const DecodedTextureRegion &decoded_region : decoded.regions) {
+        const RecordRegion region{
+            static_cast<uint32_t>(decoded_region.base_format),
+            decoded_region.width,
+            decoded_region.height,
+            decoded_region.mip_index,
+            decoded_region.face,
+            decoded_region.is_compressed,
+            decoded_region.pixels_per_stride,
+            decoded_region.offset,
+        };
+        file.write(reinterpret_cast<const char *>(&region), sizeof(region));
+    }
+    file.write(reinterpret_cast<const char *>(decoded.data.data()), decoded.data.size());
+
+    static constexpr char padding[16] = {};
+    const uint64_t written_size = sizeof(RecordHeader) + decoded.regions.size() * sizeof(RecordRegion) + decoded.data.size();
+    file.write(padding, record_size - written_size);
+    file.flush();
+
+    if (!file) {
+        LOG_ERROR("Could not write to the texture cache file {}", path.string());
+        return;
+    }
+
+    file_size += record_size;
+    stored_keys.insert(key);
+}
+
+} // namespace renderer
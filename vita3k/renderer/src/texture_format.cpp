@@ -16,15 +16,27 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <renderer/texture_convert.h>
+
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <shader/spirv_recompiler.h>
 #include <util/log.h>
 
+#if defined(TEXTURE_CONVERT_X86)
+#include <immintrin.h>
+#include <util/instrset_detect.h>
+#elif defined(TEXTURE_CONVERT_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace renderer::texture {
 
 size_t bits_per_pixel(SceGxmTextureBaseFormat base_format) {
@@ -177,12 +189,198 @@ static uint32_t decode_morton2_y(uint32_t code) {
     return compact_one_by_one(code >> 1);
 }
 
+// Spread the 16 lower bits of x to the even bits
+static uint32_t spread_bits(uint32_t x) {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+// Copy the 4x4 block of 32-bit texels starting at src, whose texel index is y0 | x0 << 1 | y1 << 2 | x1 << 3
+static void unswizzle_block_32(uint8_t *dest, const uint8_t *src, size_t dest_stride) {
+#if defined(TEXTURE_CONVERT_X86)
+    const __m128 a = _mm_loadu_ps(reinterpret_cast<const float *>(src));
+    const __m128 b = _mm_loadu_ps(reinterpret_cast<const float *>(src + 16));
+    const __m128 c = _mm_loadu_ps(reinterpret_cast<const float *>(src + 32));
+    const __m128 d = _mm_loadu_ps(reinterpret_cast<const float *>(src + 48));
+    _mm_storeu_ps(reinterpret_cast<float *>(dest), _mm_shuffle_ps(a, c, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(reinterpret_cast<float *>(dest + dest_stride), _mm_shuffle_ps(a, c, _MM_SHUFFLE(3, 1, 3, 1)));
+    _mm_storeu_ps(reinterpret_cast<float *>(dest + 2 * dest_stride), _mm_shuffle_ps(b, d, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(reinterpret_cast<float *>(dest + 3 * dest_stride), _mm_shuffle_ps(b, d, _MM_SHUFFLE(3, 1, 3, 1)));
+#elif defined(TEXTURE_CONVERT_NEON)
+    const uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t *>(src));
+    const uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t *>(src + 16));
+    const uint32x4_t c = vld1q_u32(reinterpret_cast<const uint32_t *>(src + 32));
+    const uint32x4_t d = vld1q_u32(reinterpret_cast<const uint32_t *>(src + 48));
+    vst1q_u32(reinterpret_cast<uint32_t *>(dest), vuzp1q_u32(a, c));
+    vst1q_u32(reinterpret_cast<uint32_t *>(dest + dest_stride), vuzp2q_u32(a, c));
+    vst1q_u32(reinterpret_cast<uint32_t *>(dest + 2 * dest_stride), vuzp1q_u32(b, d));
+    vst1q_u32(reinterpret_cast<uint32_t *>(dest + 3 * dest_stride), vuzp2q_u32(b, d));
+#else
+    static constexpr uint8_t texel_index[4][4] = { { 0, 2, 8, 10 }, { 1, 3, 9, 11 }, { 4, 6, 12, 14 }, { 5, 7, 13, 15 } };
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            std::memcpy(dest + y * dest_stride + x * 4, src + texel_index[y][x] * 4, 4);
+#endif
+}
+
+template <size_t bytes_per_pixel>
+static void unswizzle_rows(uint8_t *dest, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *x_bits, const uint32_t *y_bits) {
+    uint32_t y = 0;
+    if constexpr (bytes_per_pixel == 4) {
+        if (width >= 4 && height >= 4) {
+            for (; y < height; y += 4) {
+                for (uint32_t x = 0; x < width; x += 4)
+                    unswizzle_block_32(dest + (y * width + x) * 4, src + (x_bits[x] | y_bits[y]) * 4, width * 4);
+            }
+        }
+    }
+
+    for (; y < height; y++) {
+        uint8_t *dest_row = dest + y * width * bytes_per_pixel;
+        for (uint32_t x = 0; x < width; x++)
+            std::memcpy(dest_row + x * bytes_per_pixel, src + (x_bits[x] | y_bits[y]) * bytes_per_pixel, bytes_per_pixel);
+    }
+}
+
 void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
     if (bits_per_pixel % 8 != 0) {
         // Don't support yet
         return;
     }
 
+    if (!std::has_single_bit(width) || !std::has_single_bit(height)) {
+        swizzled_texture_to_linear_texture_basic(dest, src, width, height, bits_per_pixel);
+        return;
+    }
+
+    // The texture is made of squares of min x min texels along its longest side, with the y coordinate
+    // of a texel in the even bits of its index in the square and its x coordinate in the odd bits
+    const uint32_t min = std::min(width, height);
+    const uint32_t k = std::countr_zero(min);
+    std::vector<uint32_t> x_bits(width);
+    std::vector<uint32_t> y_bits(height);
+    for (uint32_t x = 0; x < width; x++)
+        x_bits[x] = (spread_bits(x & (min - 1)) << 1) | ((height < width) ? ((x >> k) << (2 * k)) : 0);
+    for (uint32_t y = 0; y < height; y++)
+        y_bits[y] = spread_bits(y & (min - 1)) | ((height < width) ? 0 : ((y >> k) << (2 * k)));
+
+    switch (bits_per_pixel >> 3) {
+    case 1: unswizzle_rows<1>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    case 2: unswizzle_rows<2>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    case 3: unswizzle_rows<3>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    case 4: unswizzle_rows<4>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    case 8: unswizzle_rows<8>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    case 16: unswizzle_rows<16>(dest, src, width, height, x_bits.data(), y_bits.data()); break;
+    default:
+        swizzled_texture_to_linear_texture_basic(dest, src, width, height, bits_per_pixel);
+        break;
+    }
+}
+
+void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
+    // 32x32 block is assembled to tiled.
+    if (bits_per_pixel % 8 != 0) {
+        // Don't support yet
+        return;
+    }
+
+    // Each row of a tile is contiguous, copy them at once
+    const uint32_t bpp = bits_per_pixel >> 3;
+    const uint32_t width_in_tiles = (width + 31) >> 5;
+
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t tile_x = 0; tile_x < width_in_tiles; tile_x++) {
+            const uint32_t tile_address = tile_x + width_in_tiles * (y >> 5);
+            const uint32_t offset = ((tile_address << 10) | ((y & 0b11111) << 5)) * bpp;
+            const uint32_t x = tile_x << 5;
+            const uint32_t texel_count = std::min<uint32_t>(32, width - x);
+
+            memcpy(dest + ((y * width) + x) * bpp, src + offset, texel_count * bpp);
+        }
+    }
+}
+
+void rgb_texture_to_rgba_basic(uint8_t *dst, const uint8_t *src, size_t pixel_count) {
+    for (size_t i = 0; i < pixel_count; i++) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        // set 1.0 as the alpha channel
+        dst[3] = 255;
+
+        src += 3;
+        dst += 4;
+    }
+}
+
+#if defined(TEXTURE_CONVERT_X86)
+TEXTURE_CONVERT_TARGET("ssse3")
+static void rgb_texture_to_rgba_ssse3(uint8_t *dst, const uint8_t *src, size_t pixel_count) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    size_t i = 0;
+    // 16 bytes are loaded to convert 4 pixels, don't read past the end
+    for (; i + 6 <= pixel_count; i += 4) {
+        const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+
+    rgb_texture_to_rgba_basic(dst + i * 4, src + i * 3, pixel_count - i);
+}
+#elif defined(TEXTURE_CONVERT_NEON)
+static void rgb_texture_to_rgba_neon(uint8_t *dst, const uint8_t *src, size_t pixel_count) {
+    size_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        const uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        const uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) } };
+        vst4q_u8(dst + i * 4, rgba);
+    }
+
+    rgb_texture_to_rgba_basic(dst + i * 4, src + i * 3, pixel_count - i);
+}
+#endif
+
+void rgb_texture_to_rgba(uint8_t *dst, const uint8_t *src, size_t pixel_count) {
+    using ConvertFunc = void (*)(uint8_t *, const uint8_t *, size_t);
+    static const ConvertFunc convert = []() -> ConvertFunc {
+#if defined(TEXTURE_CONVERT_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_SSSE3)
+            return rgb_texture_to_rgba_ssse3;
+#elif defined(TEXTURE_CONVERT_NEON)
+        return rgb_texture_to_rgba_neon;
+#endif
+        return rgb_texture_to_rgba_basic;
+    }();
+
+    convert(dst, src, pixel_count);
+}
+
+const char *get_texture_convert_isa() {
+#if defined(TEXTURE_CONVERT_X86)
+    const int instrset = util::instrset::instrset_detect();
+    if (instrset >= util::instrset::instrset_AVX2)
+        return "AVX2";
+    if (instrset >= util::instrset::instrset_SSSE3)
+        return "SSSE3";
+    return "SSE2";
+#elif defined(TEXTURE_CONVERT_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+void swizzled_texture_to_linear_texture_basic(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
+    if (bits_per_pixel % 8 != 0) {
+        // Don't support yet
+        return;
+    }
+
     uint8_t bytes_per_pixel = (bits_per_pixel + 7) >> 3;
 
     for (uint32_t i = 0; i < static_cast<uint32_t>(width * height); i++) {
@@ -213,7 +411,7 @@ void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint1
     }
 }
 
-void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
+void tiled_texture_to_linear_texture_basic(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
     // 32x32 block is assembled to tiled.
     if (bits_per_pixel % 8 != 0) {
         // Don't support yet
@@ -265,12 +463,25 @@ size_t get_compressed_size(SceGxmTextureBaseFormat base_format, std::uint32_t wi
     case SCE_GXM_TEXTURE_BASE_FORMAT_UBC5:
     case SCE_GXM_TEXTURE_BASE_FORMAT_SBC5:
         return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP:
+        return ((width + 7) / 8) * ((height + 3) / 4) * 8;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRT4BPP:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP:
+        return ((width + 3) / 4) * ((height + 3) / 4) * 8;
     default:
         LOG_ERROR("Invalid block compressed texture format: {}", base_format);
         return 0;
     }
 }
 
+size_t get_upload_size(SceGxmTextureBaseFormat base_format, std::uint32_t width, std::uint32_t height, bool is_compressed, size_t pixels_per_stride) {
+    if (is_compressed)
+        return get_compressed_size(base_format, width, height);
+
+    return pixels_per_stride * height * ((bits_per_pixel(base_format) + 7) >> 3);
+}
+
 // =========================== COMPRESSION ============================
 // Some texture has block compression, when uncompressed will have swizzled layout. Since on some backend, no
 // option is provided to make the GPU driver not try to translate the layout to linear, we have to do uncompress
@@ -666,4 +877,158 @@ void resolve_z_order_compressed_image(std::uint32_t width, std::uint32_t height,
     }
 }
 
+static std::uint16_t encode_rgb565(const std::uint8_t *color) {
+    return static_cast<std::uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void decode_rgb565(std::uint16_t value, int *color) {
+    const int r = (value >> 11) & 0x1f;
+    const int g = (value >> 5) & 0x3f;
+    const int b = value & 0x1f;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * \brief Computes the bounding box of the colors and alphas of a block of 4x4 RGBA texels.
+ *
+ * \param texels    The 16 texels of the block, in rows.
+ * \param min_color Where the smallest value of each channel will be stored.
+ * \param max_color Where the largest value of each channel will be stored.
+ **/
+static void get_block_bounding_box(const std::uint8_t texels[16][4], std::uint8_t min_color[4], std::uint8_t max_color[4]) {
+    for (int c = 0; c < 4; c++) {
+        min_color[c] = 255;
+        max_color[c] = 0;
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            min_color[c] = std::min(min_color[c], texels[i][c]);
+            max_color[c] = std::max(max_color[c], texels[i][c]);
+        }
+    }
+}
+
+/**
+ * \brief Compresses the colors of one block of 4x4 texels, the layout is the same for BC1 and the color part of BC3.
+ *
+ * \param texels    The 16 texels of the block, in rows.
+ * \param min_color The smallest value of each channel of the block.
+ * \param max_color The largest value of each channel of the block.
+ * \param block     Pointer to the 8 bytes where the color block will be stored.
+ **/
+static void compress_color_block(const std::uint8_t texels[16][4], const std::uint8_t min_color[4], const std::uint8_t max_color[4], std::uint8_t *block) {
+    // each channel of max_color is at least the one of min_color, so color0 >= color1
+    // and the BC1 blocks are in 4 colors mode, they are equal only when all the indices are 0
+    const std::uint16_t color0 = encode_rgb565(max_color);
+    const std::uint16_t color1 = encode_rgb565(min_color);
+    block[0] = static_cast<std::uint8_t>(color0);
+    block[1] = static_cast<std::uint8_t>(color0 >> 8);
+    block[2] = static_cast<std::uint8_t>(color1);
+    block[3] = static_cast<std::uint8_t>(color1 >> 8);
+
+    int endpoint0[3];
+    int endpoint1[3];
+    decode_rgb565(color0, endpoint0);
+    decode_rgb565(color1, endpoint1);
+    const int dir[3] = { endpoint1[0] - endpoint0[0], endpoint1[1] - endpoint0[1], endpoint1[2] - endpoint0[2] };
+    const int length = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+    std::uint32_t color_indices = 0;
+    if (length != 0) {
+        for (int i = 0; i < 16; i++) {
+            // position of the texel on the endpoint0 -> endpoint1 line, in 6ths
+            const int dot = (texels[i][0] - endpoint0[0]) * dir[0] + (texels[i][1] - endpoint0[1]) * dir[1] + (texels[i][2] - endpoint0[2]) * dir[2];
+            const int position = std::clamp((dot * 6) / length, 0, 6);
+            // palette order is endpoint0, endpoint1, 2/3 endpoint0 + 1/3 endpoint1, 1/3 endpoint0 + 2/3 endpoint1
+            static const std::uint32_t position_to_index[7] = { 0, 2, 2, 3, 3, 1, 1 };
+            color_indices |= position_to_index[position] << (2 * i);
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = static_cast<std::uint8_t>(color_indices >> (8 * i));
+}
+
+/**
+ * \brief Compresses one block of 4x4 RGBA texels to BC1, using the bounding box of the colors as endpoints. The alpha is dropped.
+ *
+ * \param texels    The 16 texels of the block, in rows.
+ * \param block     Pointer to the 8 bytes where the block will be stored.
+ **/
+static void compress_block_bc1(const std::uint8_t texels[16][4], std::uint8_t *block) {
+    std::uint8_t min_color[4];
+    std::uint8_t max_color[4];
+    get_block_bounding_box(texels, min_color, max_color);
+    compress_color_block(texels, min_color, max_color, block);
+}
+
+/**
+ * \brief Compresses one block of 4x4 RGBA texels to BC3, using the bounding box of the colors and alphas as endpoints.
+ *
+ * \param texels    The 16 texels of the block, in rows.
+ * \param block     Pointer to the 16 bytes where the block will be stored.
+ **/
+static void compress_block_bc3(const std::uint8_t texels[16][4], std::uint8_t *block) {
+    std::uint8_t min_color[4];
+    std::uint8_t max_color[4];
+    get_block_bounding_box(texels, min_color, max_color);
+
+    // alpha block, 8 interpolated values between alpha0 > alpha1
+    const int alpha0 = max_color[3];
+    const int alpha1 = min_color[3];
+    block[0] = static_cast<std::uint8_t>(alpha0);
+    block[1] = static_cast<std::uint8_t>(alpha1);
+    std::uint64_t alpha_indices = 0;
+    if (alpha0 != alpha1) {
+        for (int i = 0; i < 16; i++) {
+            // weight of alpha0 in 7ths, index 0 is alpha0, 1 is alpha1 and 2-7 go from alpha0 to alpha1
+            const int weight = ((texels[i][3] - alpha1) * 7 + (alpha0 - alpha1) / 2) / (alpha0 - alpha1);
+            const std::uint64_t index = (weight == 7) ? 0 : ((weight == 0) ? 1 : 8 - weight);
+            alpha_indices |= index << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = static_cast<std::uint8_t>(alpha_indices >> (8 * i));
+
+    compress_color_block(texels, min_color, max_color, block + 8);
+}
+
+template <size_t block_size, void (*compress_block)(const std::uint8_t[16][4], std::uint8_t *)>
+static void rgba_texture_to_bc(std::uint8_t *dest, const std::uint8_t *src, std::uint32_t width, std::uint32_t height) {
+    const std::uint32_t block_count_x = (width + 3) / 4;
+    const std::uint32_t block_count_y = (height + 3) / 4;
+
+    std::uint8_t texels[16][4];
+    for (std::uint32_t block_y = 0; block_y < block_count_y; block_y++) {
+        for (std::uint32_t block_x = 0; block_x < block_count_x; block_x++) {
+            // the texels outside the texture repeat its last row and column
+            for (std::uint32_t i = 0; i < 16; i++) {
+                const std::uint32_t x = std::min(block_x * 4 + (i & 3), width - 1);
+                const std::uint32_t y = std::min(block_y * 4 + (i >> 2), height - 1);
+                std::memcpy(texels[i], src + (y * width + x) * 4, 4);
+            }
+
+            compress_block(texels, dest);
+            dest += block_size;
+        }
+    }
+}
+
+void rgba_texture_to_bc1(std::uint8_t *dest, const std::uint8_t *src, std::uint32_t width, std::uint32_t height) {
+    rgba_texture_to_bc<8, compress_block_bc1>(dest, src, width, height);
+}
+
+void rgba_texture_to_bc3(std::uint8_t *dest, const std::uint8_t *src, std::uint32_t width, std::uint32_t height) {
+    rgba_texture_to_bc<16, compress_block_bc3>(dest, src, width, height);
+}
+
+SceGxmTextureBaseFormat get_pvrtc_transcode_format(SceGxmTextureFormat format) {
+    // the alpha of the texture is never read with the 1BGR swizzle
+    if ((format & SCE_GXM_TEXTURE_SWIZZLE_MASK) == SCE_GXM_TEXTURE_SWIZZLE4_1BGR)
+        return SCE_GXM_TEXTURE_BASE_FORMAT_UBC1;
+
+    return SCE_GXM_TEXTURE_BASE_FORMAT_UBC3;
+}
+
 } // namespace renderer::texture
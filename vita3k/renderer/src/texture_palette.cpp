@@ -17,17 +17,23 @@
 
 #include <renderer/functions.h>
 #include <renderer/profile.h>
+#include <renderer/texture_convert.h>
 
 #include <gxm/types.h>
 #include <mem/ptr.h>
 #include <util/log.h>
 
+#include <cstring>
+
+#if defined(TEXTURE_CONVERT_X86)
+#include <immintrin.h>
+#include <util/instrset_detect.h>
+#endif
+
 namespace renderer {
 namespace texture {
 
-void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
-    R_PROFILE(__func__);
-
+void palette_texture_to_rgba_4_basic(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
     for (size_t y = 0; y < height; ++y) {
         uint32_t *const dst_row = &dst[y * width];
         const uint8_t *const src_row = &src[y * stride];
@@ -41,9 +47,7 @@ void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, size_t width,
     }
 }
 
-void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
-    R_PROFILE(__func__);
-
+void palette_texture_to_rgba_8_basic(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
     for (size_t y = 0; y < height; ++y) {
         uint32_t *const dst_row = &dst[y * width];
         const uint8_t *const src_row = &src[y * stride];
@@ -53,6 +57,82 @@ void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, size_t width,
     }
 }
 
+#if defined(TEXTURE_CONVERT_X86)
+TEXTURE_CONVERT_TARGET("avx2")
+static void palette_texture_to_rgba_4_avx2(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
+    const __m128i low_mask = _mm_set1_epi8(0xf);
+    const int *const palette_data = reinterpret_cast<const int *>(palette);
+
+    for (size_t y = 0; y < height; ++y) {
+        uint32_t *const dst_row = &dst[y * width];
+        const uint8_t *const src_row = &src[y * stride];
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            uint32_t packed;
+            std::memcpy(&packed, &src_row[x / 2], sizeof(packed));
+            const __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(packed));
+            const __m128i lo = _mm_and_si128(bytes, low_mask);
+            const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask);
+            const __m256i indices = _mm256_cvtepu8_epi32(_mm_unpacklo_epi8(lo, hi));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(&dst_row[x]), _mm256_i32gather_epi32(palette_data, indices, 4));
+        }
+        for (; x < width; x += 2) {
+            const uint8_t lohi = src_row[x / 2];
+            dst_row[x + 0] = palette[lohi & 0xf];
+            dst_row[x + 1] = palette[lohi >> 4];
+        }
+    }
+}
+
+TEXTURE_CONVERT_TARGET("avx2")
+static void palette_texture_to_rgba_8_avx2(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
+    const int *const palette_data = reinterpret_cast<const int *>(palette);
+
+    for (size_t y = 0; y < height; ++y) {
+        uint32_t *const dst_row = &dst[y * width];
+        const uint8_t *const src_row = &src[y * stride];
+        size_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(&src_row[x])));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(&dst_row[x]), _mm256_i32gather_epi32(palette_data, indices, 4));
+        }
+        for (; x < width; ++x) {
+            dst_row[x] = palette[src_row[x]];
+        }
+    }
+}
+#endif
+
+using PaletteConvertFunc = void (*)(uint32_t *, const uint8_t *, size_t, size_t, const size_t, const uint32_t *);
+
+void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
+    R_PROFILE(__func__);
+
+    static const PaletteConvertFunc convert = []() -> PaletteConvertFunc {
+#if defined(TEXTURE_CONVERT_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX2)
+            return palette_texture_to_rgba_4_avx2;
+#endif
+        return palette_texture_to_rgba_4_basic;
+    }();
+
+    convert(dst, src, width, height, stride, palette);
+}
+
+void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette) {
+    R_PROFILE(__func__);
+
+    static const PaletteConvertFunc convert = []() -> PaletteConvertFunc {
+#if defined(TEXTURE_CONVERT_X86)
+        if (util::instrset::instrset_detect() >= util::instrset::instrset_AVX2)
+            return palette_texture_to_rgba_8_avx2;
+#endif
+        return palette_texture_to_rgba_8_basic;
+    }();
+
+    convert(dst, src, width, height, stride, palette);
+}
+
 const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState &mem) {
     const Ptr<const uint32_t> palette_ptr(texture.palette_addr << 6);
     return palette_ptr.get(mem);
@@ -20,6 +20,7 @@
 #include <util/log.h>
 
 #include <algorithm>
+#include <utility>
 
 extern "C" {
 #include <libswscale/swscale.h>
@@ -29,12 +30,14 @@ namespace renderer::texture {
 
 static SwsContext *s_render_sws_context{};
 static size_t res[2] = { 0, 0 };
-SwsContext *get_sws_context(size_t width, size_t height) {
+static AVPixelFormat s_render_src_format = AV_PIX_FMT_NONE;
+SwsContext *get_sws_context(size_t width, size_t height, AVPixelFormat src_format) {
     bool recreate = false;
-    if (res[0] != width || res[1] != height) {
+    if (res[0] != width || res[1] != height || s_render_src_format != src_format) {
         recreate = true;
         res[0] = width;
         res[1] = height;
+        s_render_src_format = src_format;
     } else if (s_render_sws_context == nullptr) {
         recreate = true;
     }
@@ -44,27 +47,35 @@ SwsContext *get_sws_context(size_t width, size_t height) {
             sws_freeContext(s_render_sws_context);
             s_render_sws_context = nullptr;
         }
-        s_render_sws_context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_RGB24,
+        s_render_sws_context = sws_getContext(width, height, src_format, width, height, AV_PIX_FMT_RGB24,
             0, nullptr, nullptr, nullptr);
     }
     return s_render_sws_context;
 }
 
-void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height) {
-    SwsContext *context = get_sws_context(width, height);
+void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height, const bool is_two_planes, const bool is_yvu) {
+    // the two planes textures interleave the chroma in a single plane, like NV12 (or NV21 with V first)
+    const AVPixelFormat src_format = is_two_planes ? (is_yvu ? AV_PIX_FMT_NV21 : AV_PIX_FMT_NV12) : AV_PIX_FMT_YUV420P;
+    SwsContext *context = get_sws_context(width, height, src_format);
     assert(context);
 
-    const uint8_t *slices[] = {
+    const uint8_t *slices[3] = {
         &src[0], // Y Slice
-        &src[width * height], // U Slice
-        &src[width * height + width * height / 4], // V Slice
+        &src[width * height], // U (or UV) Slice
+        nullptr,
     };
-
-    int strides[] = {
+    int strides[3] = {
         static_cast<int>(width),
-        static_cast<int>(width / 2),
-        static_cast<int>(width / 2),
+        static_cast<int>(is_two_planes ? width : width / 2),
+        0,
     };
+    if (!is_two_planes) {
+        // V Slice
+        slices[2] = &src[width * height + width * height / 4];
+        strides[2] = static_cast<int>(width / 2);
+        if (is_yvu)
+            std::swap(slices[1], slices[2]);
+    }
 
     uint8_t *dst_slices[] = {
         dst,
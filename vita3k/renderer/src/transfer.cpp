@@ -0,0 +1,287 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/profile.h>
+#include <renderer/texture_convert.h>
+#include <renderer/transfer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(TEXTURE_CONVERT_X86)
+#include <emmintrin.h>
+#elif defined(TEXTURE_CONVERT_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace renderer::transfer {
+
+// the strides can be negative, don't compute the offsets with unsigned integers
+static uint8_t *row_ptr(uint8_t *base, int32_t stride, uint32_t y) {
+    return base + static_cast<int64_t>(stride) * y;
+}
+
+static const uint8_t *row_ptr(const uint8_t *base, int32_t stride, uint32_t y) {
+    return base + static_cast<int64_t>(stride) * y;
+}
+
+// average of two bytes rounded up, the same as the rounding of the SIMD average instructions
+static uint8_t average(uint8_t a, uint8_t b) {
+    return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+
+void copy_basic(uint8_t *dst, int32_t dst_stride, uint32_t dst_bytes_per_pixel, const uint8_t *src, int32_t src_stride, uint32_t src_bytes_per_pixel,
+    uint32_t width, uint32_t height, SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask) {
+    // don't read past the source pixel if the destination ones are larger
+    const uint32_t copy_size = std::min(dst_bytes_per_pixel, src_bytes_per_pixel);
+    const uint32_t key_size = std::min(src_bytes_per_pixel, 4U);
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const src_row = row_ptr(src, src_stride, y);
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t *const src_pixel = src_row + x * src_bytes_per_pixel;
+            if (key_mode != SCE_GXM_TRANSFER_COLORKEY_NONE) {
+                uint32_t color = 0;
+                memcpy(&color, src_pixel, key_size);
+                const bool match = (color & key_mask) == key_value;
+                if (match != (key_mode == SCE_GXM_TRANSFER_COLORKEY_PASS))
+                    continue;
+            }
+
+            memcpy(dst_row + x * dst_bytes_per_pixel, src_pixel, copy_size);
+        }
+    }
+}
+
+void fill_basic(uint8_t *dst, int32_t stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height, uint32_t color) {
+    uint8_t pixel[16] = {};
+    bytes_per_pixel = std::min<uint32_t>(bytes_per_pixel, sizeof(pixel));
+    memcpy(pixel, &color, std::min<uint32_t>(bytes_per_pixel, sizeof(color)));
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, stride, y);
+        for (uint32_t x = 0; x < width; x++)
+            memcpy(dst_row + x * bytes_per_pixel, pixel, bytes_per_pixel);
+    }
+}
+
+void downscale_basic(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height) {
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const top_row = row_ptr(src, src_stride, y * 2);
+        const uint8_t *const bottom_row = row_ptr(top_row, src_stride, 1);
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t left = x * 2 * bytes_per_pixel;
+            const uint32_t right = left + bytes_per_pixel;
+            for (uint32_t c = 0; c < bytes_per_pixel; c++) {
+                const uint8_t top = average(top_row[left + c], top_row[right + c]);
+                const uint8_t bottom = average(bottom_row[left + c], bottom_row[right + c]);
+                dst_row[x * bytes_per_pixel + c] = average(top, bottom);
+            }
+        }
+    }
+}
+
+#if defined(TEXTURE_CONVERT_X86)
+static void copy_color_key_32_sse2(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t width, uint32_t height,
+    SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask) {
+    const __m128i value = _mm_set1_epi32(static_cast<int>(key_value));
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(key_mask));
+    // the pixels matching the key are the ones rejected, invert the comparison
+    const __m128i invert = key_mode == SCE_GXM_TRANSFER_COLORKEY_REJECT ? _mm_set1_epi32(-1) : _mm_setzero_si128();
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const src_row = row_ptr(src, src_stride, y);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            const __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_row + x * 4));
+            const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst_row + x * 4));
+            const __m128i selected = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(color, mask), value), invert);
+            const __m128i result = _mm_or_si128(_mm_and_si128(selected, color), _mm_andnot_si128(selected, previous));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst_row + x * 4), result);
+        }
+
+        copy_basic(dst_row + x * 4, dst_stride, 4, src_row + x * 4, src_stride, 4, width - x, 1, key_mode, key_value, key_mask);
+    }
+}
+
+static void downscale_32_sse2(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t width, uint32_t height) {
+    const auto split = [](const uint8_t *pixels, __m128i &even, __m128i &odd) {
+        const __m128 first = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels)));
+        const __m128 second = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + 16)));
+        even = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+        odd = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+    };
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const top_row = row_ptr(src, src_stride, y * 2);
+        const uint8_t *const bottom_row = row_ptr(top_row, src_stride, 1);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128i top_left, top_right, bottom_left, bottom_right;
+            split(top_row + x * 8, top_left, top_right);
+            split(bottom_row + x * 8, bottom_left, bottom_right);
+            const __m128i top = _mm_avg_epu8(top_left, top_right);
+            const __m128i bottom = _mm_avg_epu8(bottom_left, bottom_right);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst_row + x * 4), _mm_avg_epu8(top, bottom));
+        }
+
+        downscale_basic(dst_row + x * 4, dst_stride, top_row + x * 8, src_stride, 4, width - x, 1);
+    }
+}
+
+static void store_16(uint8_t *dst, const uint8_t *pattern) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern)));
+}
+#elif defined(TEXTURE_CONVERT_NEON)
+static void copy_color_key_32_neon(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t width, uint32_t height,
+    SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask) {
+    const uint32x4_t value = vdupq_n_u32(key_value);
+    const uint32x4_t mask = vdupq_n_u32(key_mask);
+    // the pixels matching the key are the ones rejected, invert the comparison
+    const uint32x4_t invert = vdupq_n_u32(key_mode == SCE_GXM_TRANSFER_COLORKEY_REJECT ? ~0U : 0U);
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const src_row = row_ptr(src, src_stride, y);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            const uint32x4_t color = vreinterpretq_u32_u8(vld1q_u8(src_row + x * 4));
+            const uint32x4_t previous = vreinterpretq_u32_u8(vld1q_u8(dst_row + x * 4));
+            const uint32x4_t selected = veorq_u32(vceqq_u32(vandq_u32(color, mask), value), invert);
+            vst1q_u8(dst_row + x * 4, vreinterpretq_u8_u32(vbslq_u32(selected, color, previous)));
+        }
+
+        copy_basic(dst_row + x * 4, dst_stride, 4, src_row + x * 4, src_stride, 4, width - x, 1, key_mode, key_value, key_mask);
+    }
+}
+
+static void downscale_32_neon(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t width, uint32_t height) {
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, dst_stride, y);
+        const uint8_t *const top_row = row_ptr(src, src_stride, y * 2);
+        const uint8_t *const bottom_row = row_ptr(top_row, src_stride, 1);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            // split the even and odd pixels
+            const uint32x4x2_t top_pixels = vld2q_u32(reinterpret_cast<const uint32_t *>(top_row + x * 8));
+            const uint32x4x2_t bottom_pixels = vld2q_u32(reinterpret_cast<const uint32_t *>(bottom_row + x * 8));
+            const uint8x16_t top = vrhaddq_u8(vreinterpretq_u8_u32(top_pixels.val[0]), vreinterpretq_u8_u32(top_pixels.val[1]));
+            const uint8x16_t bottom = vrhaddq_u8(vreinterpretq_u8_u32(bottom_pixels.val[0]), vreinterpretq_u8_u32(bottom_pixels.val[1]));
+            vst1q_u8(dst_row + x * 4, vrhaddq_u8(top, bottom));
+        }
+
+        downscale_basic(dst_row + x * 4, dst_stride, top_row + x * 8, src_stride, 4, width - x, 1);
+    }
+}
+
+static void store_16(uint8_t *dst, const uint8_t *pattern) {
+    vst1q_u8(dst, vld1q_u8(pattern));
+}
+#else
+static void store_16(uint8_t *dst, const uint8_t *pattern) {
+    memcpy(dst, pattern, 16);
+}
+#endif
+
+void copy(uint8_t *dst, int32_t dst_stride, uint32_t dst_bytes_per_pixel, const uint8_t *src, int32_t src_stride, uint32_t src_bytes_per_pixel,
+    uint32_t width, uint32_t height, SceGxmTransferColorKeyMode key_mode, uint32_t key_value, uint32_t key_mask) {
+    R_PROFILE(__func__);
+
+    if ((key_mode == SCE_GXM_TRANSFER_COLORKEY_NONE) && (dst_bytes_per_pixel == src_bytes_per_pixel)) {
+        const size_t row_size = static_cast<size_t>(width) * dst_bytes_per_pixel;
+        if ((dst_stride == src_stride) && (static_cast<size_t>(dst_stride) == row_size)) {
+            // both rectangles are contiguous
+            memcpy(dst, src, row_size * height);
+            return;
+        }
+
+        for (uint32_t y = 0; y < height; y++)
+            memcpy(row_ptr(dst, dst_stride, y), row_ptr(src, src_stride, y), row_size);
+        return;
+    }
+
+    if ((key_mode != SCE_GXM_TRANSFER_COLORKEY_NONE) && (dst_bytes_per_pixel == 4) && (src_bytes_per_pixel == 4)) {
+#if defined(TEXTURE_CONVERT_X86)
+        copy_color_key_32_sse2(dst, dst_stride, src, src_stride, width, height, key_mode, key_value, key_mask);
+        return;
+#elif defined(TEXTURE_CONVERT_NEON)
+        copy_color_key_32_neon(dst, dst_stride, src, src_stride, width, height, key_mode, key_value, key_mask);
+        return;
+#endif
+    }
+
+    copy_basic(dst, dst_stride, dst_bytes_per_pixel, src, src_stride, src_bytes_per_pixel, width, height, key_mode, key_value, key_mask);
+}
+
+void fill(uint8_t *dst, int32_t stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height, uint32_t color) {
+    R_PROFILE(__func__);
+
+    // the pixels of 3 bytes don't repeat every 16 bytes
+    if ((bytes_per_pixel == 0) || (16 % bytes_per_pixel != 0)) {
+        fill_basic(dst, stride, bytes_per_pixel, width, height, color);
+        return;
+    }
+
+    uint8_t pattern[16] = {};
+    memcpy(pattern, &color, std::min<uint32_t>(bytes_per_pixel, sizeof(color)));
+    for (uint32_t i = bytes_per_pixel; i < sizeof(pattern); i += bytes_per_pixel)
+        memcpy(pattern + i, pattern, bytes_per_pixel);
+
+    const size_t row_size = static_cast<size_t>(width) * bytes_per_pixel;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *const dst_row = row_ptr(dst, stride, y);
+        size_t i = 0;
+        for (; i + 16 <= row_size; i += 16)
+            store_16(dst_row + i, pattern);
+        memcpy(dst_row + i, pattern, row_size - i);
+    }
+}
+
+void downscale(uint8_t *dst, int32_t dst_stride, const uint8_t *src, int32_t src_stride, uint32_t bytes_per_pixel, uint32_t width, uint32_t height) {
+    R_PROFILE(__func__);
+
+    if (bytes_per_pixel == 4) {
+#if defined(TEXTURE_CONVERT_X86)
+        downscale_32_sse2(dst, dst_stride, src, src_stride, width, height);
+        return;
+#elif defined(TEXTURE_CONVERT_NEON)
+        downscale_32_neon(dst, dst_stride, src, src_stride, width, height);
+        return;
+#endif
+    }
+
+    downscale_basic(dst, dst_stride, src, src_stride, bytes_per_pixel, width, height);
+}
+
+bool can_box_filter(SceGxmTransferFormat format) {
+    switch (format) {
+    case SCE_GXM_TRANSFER_FORMAT_U8_R:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8_GR:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8_BGR:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace renderer::transfer
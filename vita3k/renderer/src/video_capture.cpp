@@ -0,0 +1,335 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/video_capture.h>
+
+#include <util/log.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <fmt/chrono.h>
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+namespace renderer {
+
+// tried in this order when the encoder is automatic, the hardware ones all take frames from the host memory
+static const char *const AUTO_ENCODERS[] = {
+    "h264_nvenc",
+    "h264_amf",
+    "h264_videotoolbox",
+    "h264_qsv",
+    "h264_mf",
+    "libx264",
+    "libopenh264",
+    "mpeg4",
+};
+
+// frames waiting for the capture thread, the next ones are dropped until it catches up
+static constexpr size_t MAX_QUEUED_FRAMES = 2;
+
+static std::string get_capture_file_name(const std::string &title_id, const char *extension) {
+    const std::time_t now = std::time(nullptr);
+    return fmt::format("{}-{:%Y%m%d-%H%M%S}.{}", title_id, fmt::localtime(now), extension);
+}
+
+VideoCapture::VideoCapture(const fs::path &output_path, const std::string &encoder, uint32_t bitrate_kbps, uint32_t fps)
+    : output_path(output_path)
+    , encoder_name(encoder)
+    , bitrate_kbps(bitrate_kbps)
+    , fps(std::max(fps, 1U)) {
+    thread = std::thread([this]() { thread_function(); });
+}
+
+VideoCapture::~VideoCapture() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    cond.notify_one();
+    thread.join();
+}
+
+void VideoCapture::request_screenshot() {
+    screenshot_requested = true;
+}
+
+void VideoCapture::toggle_recording(const char *title_id) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (recording) {
+        recording = false;
+        // the encoder is closed by the capture thread once it gets there
+        queue.push_back({ CaptureFrame{}, false, false });
+        cond.notify_one();
+        return;
+    }
+
+    this->title_id = (title_id && title_id[0]) ? title_id : "capture";
+    recording = true;
+}
+
+void VideoCapture::submit_frame(CaptureFrame frame, bool screenshot) {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const bool record = recording;
+        if (screenshot || (record && queue.size() < MAX_QUEUED_FRAMES)) {
+            queue.push_back({ std::move(frame), screenshot, record });
+            cond.notify_one();
+            return;
+        }
+    }
+
+    if (recording)
+        frames_dropped++;
+    if (frame.release)
+        frame.release();
+}
+
+void VideoCapture::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cond.wait(lock, [this]() { return queue.empty() && !busy; });
+}
+
+void VideoCapture::thread_function() {
+    while (true) {
+        QueuedFrame queued;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            busy = false;
+            if (queue.empty())
+                idle_cond.notify_all();
+            cond.wait(lock, [this]() { return quit || !queue.empty(); });
+            if (queue.empty())
+                break;
+
+            queued = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+        }
+
+        if (queued.screenshot)
+            save_screenshot(queued.frame);
+        if (queued.record)
+            encode_frame(queued.frame);
+        else if (!queued.frame.data) {
+            close_encoder();
+            encoder_failed = false;
+        }
+
+        if (queued.frame.release)
+            queued.frame.release();
+    }
+
+    close_encoder();
+    const std::lock_guard<std::mutex> lock(mutex);
+    busy = false;
+    idle_cond.notify_all();
+}
+
+void VideoCapture::save_screenshot(const CaptureFrame &frame) {
+    // the alpha of the presented image is not meaningful
+    std::vector<uint8_t> pixels(static_cast<size_t>(frame.width) * frame.height * 4);
+    for (uint32_t y = 0; y < frame.height; y++) {
+        const uint8_t *src = frame.data + static_cast<size_t>(y) * frame.pitch;
+        uint8_t *dst = pixels.data() + static_cast<size_t>(y) * frame.width * 4;
+        for (uint32_t x = 0; x < frame.width; x++, src += 4, dst += 4) {
+            dst[0] = frame.bgra ? src[2] : src[0];
+            dst[1] = src[1];
+            dst[2] = frame.bgra ? src[0] : src[2];
+            dst[3] = 0xFF;
+        }
+    }
+
+    std::string current_title_id;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        current_title_id = title_id;
+    }
+    fs::create_directories(output_path);
+    const fs::path path = output_path / get_capture_file_name(current_title_id, "png");
+    if (stbi_write_png(path.string().c_str(), static_cast<int>(frame.width), static_cast<int>(frame.height), 4, pixels.data(), static_cast<int>(frame.width * 4)))
+        LOG_INFO("Screenshot saved to {}", path.string());
+    else
+        LOG_ERROR("Could not save the screenshot to {}", path.string());
+}
+
+static AVPixelFormat get_encoder_format(const AVCodec *codec) {
+    // the hardware encoders prefer nv12, yuv420p is supported by all the others
+    AVPixelFormat format = AV_PIX_FMT_NONE;
+    for (const AVPixelFormat *it = codec->pix_fmts; it && *it != AV_PIX_FMT_NONE; it++) {
+        if (*it == AV_PIX_FMT_NV12)
+            return AV_PIX_FMT_NV12;
+        if (*it == AV_PIX_FMT_YUV420P)
+            format = AV_PIX_FMT_YUV420P;
+    }
+    return format;
+}
+
+bool VideoCapture::open_encoder(const CaptureFrame &frame) {
+    std::string current_title_id;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        current_title_id = title_id;
+    }
+    fs::create_directories(output_path);
+    const fs::path path = output_path / get_capture_file_name(current_title_id, "mp4");
+    if (avformat_alloc_output_context2(&format_context, nullptr, nullptr, path.string().c_str()) < 0) {
+        LOG_ERROR("Could not create the video file {}", path.string());
+        return false;
+    }
+
+    std::vector<const char *> names;
+    if (encoder_name.empty() || encoder_name == "auto")
+        names.assign(std::begin(AUTO_ENCODERS), std::end(AUTO_ENCODERS));
+    else
+        names.push_back(encoder_name.c_str());
+
+    for (const char *name : names) {
+        const AVCodec *codec = avcodec_find_encoder_by_name(name);
+        if (!codec)
+            continue;
+        const AVPixelFormat format = get_encoder_format(codec);
+        if (format == AV_PIX_FMT_NONE)
+            continue;
+
+        codec_context = avcodec_alloc_context3(codec);
+        // the yuv 4:2:0 formats need an even size
+        codec_context->width = frame.width & ~1U;
+        codec_context->height = frame.height & ~1U;
+        codec_context->pix_fmt = format;
+        codec_context->time_base = { 1, static_cast<int>(fps) };
+        codec_context->framerate = { static_cast<int>(fps), 1 };
+        codec_context->bit_rate = static_cast<int64_t>(bitrate_kbps) * 1000;
+        codec_context->gop_size = static_cast<int>(fps) * 2;
+        codec_context->max_b_frames = 0;
+        if (format_context->oformat->flags & AVFMT_GLOBALHEADER)
+            codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        // favor the speed of the encoder, the frames must be encoded in real time
+        if (std::string_view(name) == "libx264")
+            av_opt_set(codec_context->priv_data, "preset", "veryfast", 0);
+        else if (std::string_view(name) == "h264_nvenc")
+            av_opt_set(codec_context->priv_data, "preset", "p4", 0);
+
+        if (avcodec_open2(codec_context, codec, nullptr) == 0) {
+            LOG_INFO("Recording {}x{} at {} kbps with the encoder {} to {}", codec_context->width, codec_context->height, bitrate_kbps, name, path.string());
+            break;
+        }
+        avcodec_free_context(&codec_context);
+    }
+
+    if (!codec_context) {
+        LOG_ERROR("No video encoder could be opened, the recording is stopped");
+        avformat_free_context(format_context);
+        format_context = nullptr;
+        return false;
+    }
+
+    stream = avformat_new_stream(format_context, nullptr);
+    avcodec_parameters_from_context(stream->codecpar, codec_context);
+    stream->time_base = codec_context->time_base;
+    if (avio_open(&format_context->pb, path.string().c_str(), AVIO_FLAG_WRITE) < 0 || avformat_write_header(format_context, nullptr) < 0) {
+        LOG_ERROR("Could not write the video file {}", path.string());
+        close_encoder();
+        return false;
+    }
+
+    yuv_frame = av_frame_alloc();
+    yuv_frame->format = codec_context->pix_fmt;
+    yuv_frame->width = codec_context->width;
+    yuv_frame->height = codec_context->height;
+    av_frame_get_buffer(yuv_frame, 0);
+    packet = av_packet_alloc();
+    start_time = frame.time;
+    last_pts = -1;
+    return true;
+}
+
+void VideoCapture::encode_frame(const CaptureFrame &frame) {
+    if (encoder_failed)
+        return;
+
+    // a new file is started when the window is resized
+    if (codec_context && (codec_context->width != static_cast<int>(frame.width & ~1U) || codec_context->height != static_cast<int>(frame.height & ~1U)))
+        close_encoder();
+    if (!codec_context && !open_encoder(frame)) {
+        encoder_failed = true;
+        return;
+    }
+
+    // the frames are placed at the time they were presented, the ones presented faster than the frame rate are dropped
+    const auto elapsed = std::chrono::duration<double>(frame.time - start_time).count();
+    const int64_t pts = static_cast<int64_t>(elapsed * fps + 0.5);
+    if (pts <= last_pts)
+        return;
+    last_pts = pts;
+
+    const AVPixelFormat src_format = frame.bgra ? AV_PIX_FMT_BGRA : AV_PIX_FMT_RGBA;
+    sws_context = sws_getCachedContext(sws_context, codec_context->width, codec_context->height, src_format,
+        codec_context->width, codec_context->height, codec_context->pix_fmt, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_context)
+        return;
+
+    av_frame_make_writable(yuv_frame);
+    const uint8_t *src_data[] = { frame.data };
+    const int src_pitch[] = { static_cast<int>(frame.pitch) };
+    sws_scale(sws_context, src_data, src_pitch, 0, codec_context->height, yuv_frame->data, yuv_frame->linesize);
+    yuv_frame->pts = pts;
+
+    if (avcodec_send_frame(codec_context, yuv_frame) == 0)
+        write_packets();
+}
+
+void VideoCapture::write_packets() {
+    while (avcodec_receive_packet(codec_context, packet) == 0) {
+        av_packet_rescale_ts(packet, codec_context->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        av_interleaved_write_frame(format_context, packet);
+    }
+}
+
+void VideoCapture::close_encoder() {
+    if (codec_context && format_context && format_context->pb) {
+        // drain the frames still in the encoder
+        avcodec_send_frame(codec_context, nullptr);
+        write_packets();
+        av_write_trailer(format_context);
+        LOG_INFO("Recording stopped");
+    }
+
+    if (format_context) {
+        if (format_context->pb)
+            avio_closep(&format_context->pb);
+        avformat_free_context(format_context);
+        format_context = nullptr;
+        stream = nullptr;
+    }
+    avcodec_free_context(&codec_context);
+    av_frame_free(&yuv_frame);
+    av_packet_free(&packet);
+    sws_freeContext(sws_context);
+    sws_context = nullptr;
+}
+
+} // namespace renderer
@@ -22,16 +22,32 @@
 #include <renderer/vulkan/state.h>
 
 #include <gxm/functions.h>
+#include <mem/functions.h>
 
 #include <util/log.h>
 #include <util/overloaded.h>
 
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include <algorithm>
+
 namespace renderer::vulkan {
 
 void VKContext::wait_thread_function() {
     // try to wait for multiple fences at the same time if possible
     std::vector<vk::Fence> fences;
 
+    // the scenes signal increasing values, waiting for one value is enough for it and all the previous scenes
+    const auto wait_timeline = [&](uint64_t value) {
+        const vk::SemaphoreWaitInfo wait_info{
+            .semaphoreCount = 1,
+            .pSemaphores = &scene_timeline,
+            .pValues = &value
+        };
+        if (state.device.waitSemaphoresKHR(wait_info, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+            LOG_ERROR("Could not wait for the scene timeline semaphore");
+    };
+
     while (true) {
         auto wait_request = request_queue.pop();
 
@@ -40,12 +56,17 @@ void VKContext::wait_thread_function() {
 
         std::visit(overloaded{
                        [&](NotificationRequest &request) {
-                           fences.push_back(request.fence);
+                           if (!scene_timeline)
+                               fences.push_back(request.fence);
 
                            if (request.notifications[0].address || request.notifications[1].address) {
-                               state.device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max());
-                               // don't reset them
-                               fences.clear();
+                               if (scene_timeline) {
+                                   wait_timeline(request.timeline_value);
+                               } else {
+                                   state.device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max());
+                                   // don't reset them
+                                   fences.clear();
+                               }
 
                                // same as in handle_sync_surface_data
                                std::unique_lock<std::mutex> lock(state.notification_mutex);
@@ -61,7 +82,9 @@ void VKContext::wait_thread_function() {
                            }
                        },
                        [&](FrameDoneRequest &request) {
-                           if (!fences.empty()) {
+                           if (scene_timeline) {
+                               wait_timeline(request.timeline_value);
+                           } else if (!fences.empty()) {
                                state.device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max());
                                fences.clear();
                            }
@@ -72,19 +95,173 @@ void VKContext::wait_thread_function() {
                            last_frame_waited = request.frame_timestamp;
                            lock.unlock();
                            new_frame_condv.notify_one();
+                       },
+                       [&](SurfaceReadbackRequest &request) {
+                           if (scene_timeline)
+                               wait_timeline(request.timeline_value);
+                           else
+                               state.device.waitForFences(request.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+                           SurfaceReadback &readback = *request.readback;
+                           state.allocator.invalidateAllocation(readback.buffer.allocation, 0, readback.size);
+                           write_surface_readback(mem, readback, [&](uint8_t *dest) {
+                               memcpy(dest, readback.buffer.mapped_data, readback.size);
+                           });
+
+                           const std::lock_guard<std::mutex> guard(readback_buffers_mutex);
+                           readback_buffers.push_back(std::move(readback.buffer));
                        } },
             *wait_request);
     }
 }
 
+void VKContext::submit_thread_function() {
+    while (true) {
+        // the request is only removed once submitted so that flush_submissions can wait for it
+        const SubmitRequest *request = submit_queue.top();
+        submit(*request);
+        submit_queue.pop();
+    }
+}
+
+void VKContext::flush_submissions() {
+    if (!submit_thread.joinable())
+        return;
+
+    while (submit_queue.size() > 0)
+        std::this_thread::yield();
+}
+
+vk::CommandBuffer VKContext::get_transfer_cmd() {
+    if (!transfer_cmd) {
+        vk::CommandBufferAllocateInfo cmd_buffer_info{
+            .commandPool = frame().transfer_pool,
+            .commandBufferCount = 1
+        };
+        transfer_cmd = state.device.allocateCommandBuffers(cmd_buffer_info)[0];
+
+        vk::CommandBufferBeginInfo begin_info{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+        };
+        transfer_cmd.begin(begin_info);
+    }
+
+    return transfer_cmd;
+}
+
+void VKContext::flush_transfer_cmd() {
+    if (!transfer_cmd)
+        return;
+
+    transfer_cmd.end();
+    transfer_timeline_value++;
+
+    const vk::TimelineSemaphoreSubmitInfo timeline_info{
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &transfer_timeline_value
+    };
+    vk::SubmitInfo submit_info{
+        .pNext = &timeline_info
+    };
+    submit_info.setCommandBuffers(transfer_cmd);
+    submit_info.setSignalSemaphores(transfer_timeline);
+    // only the render thread submits to the transfer queue
+    state.transfer_queue.submit(submit_info);
+
+    transfer_wait_value = transfer_timeline_value;
+    transfer_cmd = nullptr;
+}
+
+void VKContext::submit(const SubmitRequest &request) {
+    vk::SubmitInfo submit_info{};
+    // the prerender cmd must be submitted before the render cmd, the pipeline barriers do the rest
+    submit_info.setCommandBufferCount(request.cmd_buffers[1] ? 2 : 1);
+    submit_info.setPCommandBuffers(request.cmd_buffers.data());
+
+    // the fence is still signaled, it is used to know when the command buffers and the resources of the frame can be reused
+    vk::TimelineSemaphoreSubmitInfo timeline_info{};
+    if (scene_timeline) {
+        timeline_info.setSignalSemaphoreValues(request.timeline_value);
+        submit_info.setSignalSemaphores(scene_timeline);
+        submit_info.pNext = &timeline_info;
+    }
+    // the textures uploaded by the transfer queue are acquired at the beginning of the prerender command buffer
+    const vk::PipelineStageFlags transfer_wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+    if (request.transfer_wait_value) {
+        timeline_info.setWaitSemaphoreValues(request.transfer_wait_value);
+        submit_info.setWaitSemaphores(transfer_timeline);
+        submit_info.setWaitDstStageMask(transfer_wait_stage);
+        submit_info.pNext = &timeline_info;
+    }
+
+    state.general_queue.submit(submit_info, request.fence);
+
+    if (state.features.support_memory_mapping) {
+        // send it to the wait queue
+        NotificationRequest notification_request = {
+            .notifications = { request.notifications[0], request.notifications[1] },
+            .fence = request.fence,
+            .timeline_value = request.timeline_value
+        };
+        request_queue.push(notification_request);
+    }
+
+    if (request.readback) {
+        // pushed after the submission for the fence not to be waited for before it is reset and used
+        request_queue.push(SurfaceReadbackRequest{ request.readback, request.fence, request.timeline_value });
+    }
+}
+
 void set_context(VKContext &context, const MemState &mem, VKRenderTarget *rt, const FeatureState &features) {
-    if (rt) {
-        context.render_target = rt;
-    } else {
+    VKRenderTarget *new_render_target = rt;
+    if (!new_render_target) {
         // TODO: make context.current_render_target non-const instead of doing this
-        context.render_target = const_cast<VKRenderTarget *>(reinterpret_cast<const VKRenderTarget *>(context.current_render_target));
+        new_render_target = const_cast<VKRenderTarget *>(reinterpret_cast<const VKRenderTarget *>(context.current_render_target));
     }
 
+    if (context.scene_end_pending) {
+        const SceGxmDepthStencilSurface &ds_surface = context.record.depth_stencil_surface;
+        const SceGxmDepthStencilSurface &pending_ds = context.pending_ds_surface;
+        const bool same_surfaces = (context.render_target == new_render_target)
+            && (memcmp(&context.record.color_surface, &context.pending_color_surface, sizeof(SceGxmColorSurface)) == 0)
+            && (ds_surface.depthData.address() == pending_ds.depthData.address()) && (ds_surface.stencilData.address() == pending_ds.stencilData.address())
+            && ((ds_surface.zlsControl & SCE_GXM_DEPTH_STENCIL_FORCE_STORE_ENABLED) == (pending_ds.zlsControl & SCE_GXM_DEPTH_STENCIL_FORCE_STORE_ENABLED))
+            // the render pass may have to be ended and started again by get_prerender_cmd, the depth-stencil must be kept
+            && ((ds_surface.zlsControl & SCE_GXM_DEPTH_STENCIL_FORCE_STORE_ENABLED) || ((ds_surface.depthData.address() == 0) && (ds_surface.stencilData.address() == 0)));
+
+        if (same_surfaces) {
+            // keep going in the render pass of the previous scene, only its depth-stencil clear must be done
+            context.scene_end_pending = false;
+            context.in_merged_scene = true;
+            if (!(ds_surface.zlsControl & SCE_GXM_DEPTH_STENCIL_FORCE_LOAD_ENABLED)) {
+                const vk::ClearAttachment clear_attachment{
+                    .aspectMask = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil,
+                    .clearValue = vk::ClearDepthStencilValue{
+                        .depth = ds_surface.backgroundDepth,
+                        .stencil = ds_surface.control.content & SceGxmDepthStencilControl::stencil_bits }
+                };
+                const vk::ClearRect clear_rect{
+                    .rect = { .offset = { 0, 0 }, .extent = { new_render_target->width, new_render_target->height } },
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                };
+                context.render_cmd.clearAttachments(clear_attachment, clear_rect);
+            }
+            // same as in start_render_pass, don't keep the textures of the previous scene
+            context.last_vert_texture_count = ~0;
+            context.last_frag_texture_count = ~0;
+            for (int i = 0; i < 16; i++) {
+                context.vertex_textures[i].sampler = nullptr;
+                context.fragment_textures[i].sampler = nullptr;
+            }
+            context.refresh_pipeline = true;
+            return;
+        }
+
+        context.flush_pending_scene();
+    }
+
+    context.render_target = new_render_target;
     context.scene_timestamp++;
 
     SceGxmColorSurface *color_surface_fin = &context.record.color_surface;
@@ -112,6 +289,8 @@ void set_context(VKContext &context, const MemState &mem, VKRenderTarget *rt, co
     context.start_recording();
 
     context.current_render_pass = context.state.pipeline_cache.retrieve_render_pass(vk_format, context.record.depth_stencil_surface.zlsControl);
+    context.current_render_pass_format = vk_format;
+    context.current_render_pass_zls_control = context.record.depth_stencil_surface.zlsControl;
 
     context.current_framebuffer = state.surface_cache.retrieve_framebuffer_handle(
         mem, color_surface_fin, ds_surface_fin, context.current_render_pass, &context.current_color_attachment, &context.current_ds_attachment,
@@ -171,6 +350,24 @@ void VKContext::start_recording() {
     render_cmd.begin(begin_info);
     prerender_cmd.begin(begin_info);
 
+    // the GPU time of the scene goes from the start of its uploads to the end of its draws
+    scene_timestamp_query = ~0u;
+    FrameObject &frame_object = frame();
+    if (state.gpu_timing && state.supports_gpu_timing() && (frame_object.timestamp_count + 2 <= MAX_FRAME_TIMESTAMPS)) {
+        if (!frame_object.timestamp_pool) {
+            vk::QueryPoolCreateInfo query_pool_info{
+                .queryType = vk::QueryType::eTimestamp,
+                .queryCount = MAX_FRAME_TIMESTAMPS
+            };
+            frame_object.timestamp_pool = state.device.createQueryPool(query_pool_info);
+        }
+
+        scene_timestamp_query = frame_object.timestamp_count;
+        frame_object.timestamp_count += 2;
+        prerender_cmd.resetQueryPool(frame_object.timestamp_pool, scene_timestamp_query, 2);
+        prerender_cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame_object.timestamp_pool, scene_timestamp_query);
+    }
+
     is_recording = true;
 
     // set all the dynamic state here
@@ -182,6 +379,7 @@ void VKContext::start_recording() {
     if (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED) {
         sync_stencil_func(*this, true);
     }
+    sync_extended_dynamic_state(*this);
 }
 
 void VKContext::start_render_pass() {
@@ -270,6 +468,165 @@ void VKContext::stop_render_pass() {
     in_renderpass = false;
 }
 
+void VKContext::end_scene(const SceGxmNotification &notif1, const SceGxmNotification &notif2) {
+    // the scene can't be kept open if the guest is waiting for it, the mask is also synced at the beginning of each scene
+    const bool has_notification = state.features.support_memory_mapping && (notif1.address || notif2.address);
+    if (state.merge_scenes && !has_notification && !pending_readback && in_renderpass && !state.features.use_mask_bit) {
+        scene_end_pending = true;
+        pending_color_surface = record.color_surface;
+        pending_ds_surface = record.depth_stencil_surface;
+        return;
+    }
+
+    stop_recording(notif1, notif2);
+}
+
+void VKContext::flush_pending_scene() {
+    if (!scene_end_pending)
+        return;
+
+    scene_end_pending = false;
+    stop_recording(SceGxmNotification{}, SceGxmNotification{});
+}
+
+vk::CommandBuffer VKContext::get_prerender_cmd() {
+    if (!in_merged_scene)
+        return prerender_cmd;
+
+    if (in_renderpass) {
+        stop_render_pass();
+        // the depth-stencil is stored by the merged scenes, load it along with the color when the render pass starts again
+        current_render_pass = state.pipeline_cache.retrieve_render_pass(current_render_pass_format,
+            current_render_pass_zls_control | SCE_GXM_DEPTH_STENCIL_FORCE_LOAD_ENABLED);
+    }
+
+    return render_cmd;
+}
+
+void VKContext::request_surface_readback(const SceGxmColorSurface &surface) {
+    if (!is_recording || !current_color_attachment || !surface.data)
+        return;
+
+    // only copy the surfaces which have the same layout in the guest memory and on the GPU
+    const SceGxmColorBaseFormat base_format = gxm::get_base_format(surface.colorFormat);
+    const vk::Format format = current_color_attachment->format;
+    const vk::Format surface_format = color::translate_format(base_format);
+    const bool same_format = (format == surface_format) || (surface_format == vk::Format::eR8G8B8A8Unorm && format == vk::Format::eR8G8B8A8Srgb);
+    if (state.res_multiplier != 1 || surface.surfaceType != SCE_GXM_COLOR_SURFACE_LINEAR || !same_format
+        || gxm::bits_per_pixel(base_format) != vk::blockSize(format) * 8) {
+        static bool has_happened = false;
+        LOG_WARN_IF(!has_happened, "Surface sync is not supported for format {} with this resolution", vk::to_string(format));
+        has_happened = true;
+        return;
+    }
+
+    const uint32_t stride = static_cast<uint32_t>(gxm::get_stride_in_bytes(surface.colorFormat, surface.strideInPixels));
+    const uint32_t size = stride * (surface.height - 1) + surface.width * static_cast<uint32_t>(vk::blockSize(format));
+
+    SurfaceReadbackPtr readback = create_readback(surface.data.address(), size);
+
+    // the copy can't be done during a render pass, it ends the scene anyway
+    if (in_renderpass)
+        stop_render_pass();
+
+    current_color_attachment->transition_to(render_cmd, vkutil::ImageLayout::TransferSrc);
+    const vk::BufferImageCopy copy{
+        .bufferOffset = 0,
+        .bufferRowLength = surface.strideInPixels,
+        .bufferImageHeight = surface.height,
+        .imageSubresource = vkutil::color_subresource_layer,
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { surface.width, surface.height, 1 }
+    };
+    render_cmd.copyImageToBuffer(current_color_attachment->image, vk::ImageLayout::eTransferSrcOptimal, readback->buffer.buffer, copy);
+    current_color_attachment->transition_to(render_cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+
+    const vk::BufferMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readback->buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    render_cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), {}, barrier, {});
+
+    protect_readback(readback);
+    pending_readback = std::move(readback);
+}
+
+SurfaceReadbackPtr VKContext::create_readback(Address address, uint32_t size) {
+    auto readback = std::make_shared<SurfaceReadback>();
+    readback->address = address;
+    readback->size = size;
+    {
+        const std::lock_guard<std::mutex> guard(readback_buffers_mutex);
+        auto it = std::find_if(readback_buffers.begin(), readback_buffers.end(), [&](const vkutil::Buffer &buffer) {
+            return buffer.size >= size;
+        });
+        if (it != readback_buffers.end()) {
+            readback->buffer = std::move(*it);
+            readback_buffers.erase(it);
+        }
+    }
+    if (!readback->buffer.buffer) {
+        readback->buffer = vkutil::Buffer(state.allocator, size);
+        readback->buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst, vkutil::vma_readback_alloc);
+    }
+
+    return readback;
+}
+
+void VKContext::protect_readback(const SurfaceReadbackPtr &readback) {
+    // the guest only has to wait for the readback if it accesses the surface before it is written
+    protect_surface_readback(mem, readback);
+}
+
+vk::CommandBuffer VKContext::start_gpu_transfer() {
+    // the transfer must be done after the scene kept open
+    flush_pending_scene();
+
+    const vk::CommandBufferAllocateInfo cmd_buffer_info{
+        .commandPool = frame().render_pool,
+        .commandBufferCount = 1
+    };
+    // freed with the pool once the frame object is used again
+    vk::CommandBuffer cmd = state.device.allocateCommandBuffers(cmd_buffer_info)[0];
+
+    const vk::CommandBufferBeginInfo begin_info{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    };
+    cmd.begin(begin_info);
+
+    return cmd;
+}
+
+void VKContext::submit_gpu_transfer(vk::CommandBuffer cmd, SurfaceReadbackPtr readback) {
+    cmd.end();
+
+    FrameObject &frame_object = frame();
+    if (frame_object.transfer_fence_idx == frame_object.transfer_fences.size())
+        frame_object.transfer_fences.push_back(state.device.createFence(vk::FenceCreateInfo{}));
+    const vk::Fence fence = frame_object.transfer_fences[frame_object.transfer_fence_idx++];
+    // reset with the fences of the scenes once the frame object is used again
+    frame_object.rendered_fences.push_back(fence);
+
+    const SubmitRequest request = {
+        .cmd_buffers = { cmd, nullptr },
+        .fence = fence,
+        .timeline_value = ++scene_timeline_value,
+        .transfer_wait_value = 0,
+        .notifications = {},
+        .readback = std::move(readback)
+    };
+
+    if (submit_thread.joinable())
+        submit_queue.push(request);
+    else
+        submit(request);
+}
+
 void VKContext::stop_recording(const SceGxmNotification &notif1, const SceGxmNotification &notif2) {
     if (!is_recording) {
         LOG_ERROR("Stopping recording while not recording");
@@ -278,34 +635,51 @@ void VKContext::stop_recording(const SceGxmNotification &notif1, const SceGxmNot
 
     if (in_renderpass)
         stop_render_pass();
+    if (scene_timestamp_query != ~0u) {
+        render_cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame().timestamp_pool, scene_timestamp_query + 1);
+        scene_timestamp_query = ~0u;
+    }
     render_cmd.end();
     prerender_cmd.end();
 
+    // the uniforms and streams are written directly in the ring buffers, make them visible before the submission
+    vertex_stream_ring_buffer.flush();
+    index_stream_ring_buffer.flush();
+    vertex_uniform_stream_ring_buffer.flush();
+    fragment_uniform_stream_ring_buffer.flush();
+    vertex_info_uniform_buffer.flush();
+    fragment_info_uniform_buffer.flush();
+
+    // the uploads of the scene must be submitted before it
+    flush_transfer_cmd();
+
     vk::Fence fence = render_target->fences[render_target->fence_idx];
     render_target->fence_idx++;
     if (render_target->fence_idx == render_target->fences.size())
         render_target->fence_idx = 0;
 
-    vk::SubmitInfo submit_info{};
-    // the prerender cmd must be submitted before the render cmd, the pipeline barriers do the rest
-    std::array<vk::CommandBuffer, 2> cmd_buffers = { prerender_cmd, render_cmd };
-    submit_info.setCommandBuffers(cmd_buffers);
-
-    state.general_queue.submit(submit_info, fence);
+    const SubmitRequest request = {
+        .cmd_buffers = { prerender_cmd, render_cmd },
+        .fence = fence,
+        .timeline_value = ++scene_timeline_value,
+        .transfer_wait_value = transfer_wait_value,
+        .notifications = { notif1, notif2 },
+        .readback = std::move(pending_readback)
+    };
+    pending_readback = nullptr;
+    transfer_wait_value = 0;
+    // waiting for a fence which is not submitted yet is fine, the wait ends once it is submitted and signaled
     frame().rendered_fences.push_back(fence);
 
-    if (state.features.support_memory_mapping) {
-        // send it to the wait queue
-        NotificationRequest request = {
-            .notifications = { notif1, notif2 },
-            .fence = fence
-        };
-        request_queue.push(request);
-    }
+    if (submit_thread.joinable())
+        submit_queue.push(request);
+    else
+        submit(request);
 
     render_cmd = nullptr;
     prerender_cmd = nullptr;
     is_recording = false;
+    in_merged_scene = false;
 }
 
 } // namespace renderer::vulkan
\ No newline at end of file
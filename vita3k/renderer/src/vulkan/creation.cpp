@@ -46,9 +46,6 @@ VKContext::VKContext(VKState &state, MemState &mem)
     if (state.features.support_memory_mapping) {
         // use the default buffer
         std::fill_n(vertex_stream_buffers, SCE_GXM_MAX_VERTEX_STREAMS, state.default_buffer.buffer);
-
-        // also initialize the gpu wait thread
-        gpu_request_wait_thread = std::thread(&VKContext::wait_thread_function, this);
     } else {
         // these are not needed when using memory mapping
         vertex_stream_ring_buffer.create();
@@ -59,6 +56,24 @@ VKContext::VKContext(VKState &state, MemState &mem)
         std::fill_n(vertex_stream_buffers, SCE_GXM_MAX_VERTEX_STREAMS, vertex_stream_ring_buffer.handle());
     }
 
+    if (state.support_timeline_semaphore) {
+        vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> semaphore_info{
+            vk::SemaphoreCreateInfo{},
+            vk::SemaphoreTypeCreateInfo{
+                .semaphoreType = vk::SemaphoreType::eTimeline,
+                .initialValue = 0 }
+        };
+        scene_timeline = state.device.createSemaphore(semaphore_info.get());
+        if (state.transfer_queue_uploads)
+            transfer_timeline = state.device.createSemaphore(semaphore_info.get());
+    }
+
+    // the gpu wait thread also writes the surface readbacks to the guest memory
+    gpu_request_wait_thread = std::thread(&VKContext::wait_thread_function, this);
+
+    if (state.pipelined_submission)
+        submit_thread = std::thread(&VKContext::submit_thread_function, this);
+
     vertex_info_uniform_buffer.create();
     fragment_info_uniform_buffer.create();
 
@@ -145,6 +160,14 @@ VKContext::VKContext(VKState &state, MemState &mem)
         pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
         frame.prerender_pool = state.device.createCommandPool(pool_info);
 
+        if (state.transfer_queue_uploads) {
+            vk::CommandPoolCreateInfo transfer_pool_info{
+                .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = state.transfer_family_index
+            };
+            frame.transfer_pool = state.device.createCommandPool(transfer_pool_info);
+        }
+
         std::array<vk::DescriptorPoolSize, 3> pool_sizes = {
             vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, 256 },
             vk::DescriptorPoolSize{ vk::DescriptorType::eInputAttachment, 256 },
@@ -195,6 +218,7 @@ VKRenderTarget::VKRenderTarget(VKState &state, vma::Allocator allocator, uint16_
         cmd_buffer.clearDepthStencilImage(depthstencil.image, vk::ImageLayout::eTransferDstOptimal, clear_value, vkutil::ds_subresource_range);
         depthstencil.transition_to(cmd_buffer, vkutil::ImageLayout::DepthStencilAttachment, vkutil::ds_subresource_range);
     }
+    reinterpret_cast<VKContext *>(state.context)->flush_submissions();
     vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
 
     constexpr uint16_t SCE_GXM_MAX_SCENES_PER_RENDERTARGET = 8;
@@ -234,6 +258,7 @@ bool create(VKState &state, std::unique_ptr<RenderTarget> &rt, const SceGxmRende
         // transition it to general
         vk::CommandBuffer cmd_buffer = vkutil::create_single_time_command(state.device, state.general_command_pool);
         mask.transition_to(cmd_buffer, vkutil::ImageLayout::StorageImage);
+        reinterpret_cast<VKContext *>(state.context)->flush_submissions();
         vkutil::end_single_time_command(state.device, state.general_queue, state.general_command_pool, cmd_buffer);
     }
     return true;
@@ -243,6 +268,9 @@ void destroy(VKState &state, std::unique_ptr<RenderTarget> &rt) {
     VKContext &context = *reinterpret_cast<VKContext *>(state.context);
     VKRenderTarget &render_target = *reinterpret_cast<VKRenderTarget *>(rt.get());
 
+    if (context.render_target == &render_target)
+        context.flush_pending_scene();
+
     // don't forget to destroy the framebuffers
     state.surface_cache.destroy_associated_framebuffers(&render_target);
 
@@ -17,6 +17,8 @@
 
 #include <renderer/vulkan/gxm_to_vulkan.h>
 
+#include <renderer/types.h>
+
 #include <gxm/functions.h>
 
 namespace renderer::vulkan {
@@ -243,6 +245,15 @@ vk::StencilOp translate_stencil_op(SceGxmStencilOp stencil_op) {
     }
 }
 
+vk::StencilOpState translate_stencil_state(const GxmStencilStateOp &state) {
+    return vk::StencilOpState{
+        .failOp = translate_stencil_op(state.depth_fail),
+        .passOp = translate_stencil_op(state.depth_pass),
+        .depthFailOp = translate_stencil_op(state.depth_fail),
+        .compareOp = translate_stencil_func(state.func)
+    };
+}
+
 using Swizzle = vk::ComponentSwizzle;
 
 static constexpr vk::ComponentMapping swizzle_identity = { Swizzle::eIdentity, Swizzle::eIdentity, Swizzle::eIdentity, Swizzle::eIdentity };
@@ -0,0 +1,176 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/vulkan/memory_budget.h>
+
+#include <renderer/functions.h>
+#include <renderer/vulkan/state.h>
+
+#include <mem/util.h>
+#include <util/log.h>
+
+namespace renderer::vulkan {
+
+// eviction starts once the usage is above this part of the budget, and tries to go down to the target
+static constexpr double EVICTION_THRESHOLD = 0.9;
+static constexpr double EVICTION_TARGET = 0.8;
+
+MemoryBudget::MemoryBudget(VKState &state)
+    : state(state) {}
+
+void MemoryBudget::create_pool(MemoryCategory category, uint32_t memory_type, const vma::AllocationCreateInfo &alloc_info) {
+    const size_t idx = static_cast<size_t>(category);
+    const vma::PoolCreateInfo pool_info{
+        .memoryTypeIndex = memory_type
+    };
+    pools[idx] = state.allocator.createPool(pool_info);
+
+    alloc_infos[idx] = alloc_info;
+    alloc_infos[idx].pool = pools[idx];
+
+    const uint32_t heap = state.physical_device_memory.memoryTypes[memory_type].heapIndex;
+    if (state.physical_device_memory.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+        local_heaps_mask |= 1U << heap;
+}
+
+void MemoryBudget::init() {
+    // For the color formats, the memory types an optimal image can use only depend on create flags and usages we never set
+    // (Vulkan specification, Resource Memory Association), so the type found for one image is valid for all the textures and color surfaces.
+    // The depth-stencil surfaces all have the same format, which gives them the same guarantee.
+    vk::ImageCreateInfo image_info{
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .extent = vk::Extent3D{
+            .width = 64,
+            .height = 64,
+            .depth = 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+    create_pool(MemoryCategory::Textures, state.allocator.findMemoryTypeIndexForImageInfo(image_info, vkutil::vma_auto_alloc), vkutil::vma_auto_alloc);
+
+    image_info.usage |= vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment;
+    create_pool(MemoryCategory::Surfaces, state.allocator.findMemoryTypeIndexForImageInfo(image_info, vkutil::vma_auto_alloc), vkutil::vma_auto_alloc);
+
+    image_info.format = vk::Format::eD32SfloatS8Uint;
+    image_info.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+    create_pool(MemoryCategory::DepthStencil, state.allocator.findMemoryTypeIndexForImageInfo(image_info, vkutil::vma_auto_alloc), vkutil::vma_auto_alloc);
+
+    // the buffers with the same usage can all use the same memory types
+    vk::BufferCreateInfo buffer_info{
+        .size = KiB(64),
+        .usage = vk::BufferUsageFlagBits::eTransferSrc,
+        .sharingMode = vk::SharingMode::eExclusive
+    };
+    if (state.texture_cache.decode_pipeline)
+        buffer_info.usage |= vk::BufferUsageFlagBits::eStorageBuffer;
+    create_pool(MemoryCategory::Staging, state.allocator.findMemoryTypeIndexForBufferInfo(buffer_info, vkutil::vma_mapped_alloc), vkutil::vma_mapped_alloc);
+
+    LOG_INFO("GPU memory budget {}", support_memory_budget ? "reported by the driver" : "estimated from the heap sizes");
+}
+
+void MemoryBudget::cleanup() {
+    for (vma::Pool &pool : pools) {
+        if (pool)
+            state.allocator.destroyPool(pool);
+        pool = nullptr;
+    }
+}
+
+void MemoryBudget::compact(uint64_t frame_timestamp) {
+    // the staging buffers only grow with the biggest texture uploaded, give the memory back once the uploads are done
+    for (TextureStagingBuffer &staging : state.texture_cache.staging_buffers) {
+        const bool is_unused = staging.frame_timestamp == ~0ULL || staging.frame_timestamp + COMPACTION_PERIOD < frame_timestamp;
+        if (!staging.buffer.buffer || !is_unused)
+            continue;
+
+        staging.buffer.destroy();
+        staging.buffer.size = 0;
+        staging.used_so_far = 0;
+        staging.is_decode_set_outdated = true;
+    }
+}
+
+void MemoryBudget::new_frame(uint64_t frame_timestamp, uint64_t scene_timestamp) {
+    // the textures and surfaces last used before the start of the frame EVICTION_AGE frames ago can be evicted
+    uint64_t &frame_texture_timestamp = frame_texture_timestamps[frame_timestamp % EVICTION_AGE];
+    uint64_t &frame_scene_timestamp = frame_scene_timestamps[frame_timestamp % EVICTION_AGE];
+    const uint64_t keep_textures_since = frame_texture_timestamp;
+    const uint64_t keep_surfaces_since = frame_scene_timestamp;
+    frame_texture_timestamp = state.texture_cache.timestamp;
+    frame_scene_timestamp = scene_timestamp;
+
+    // lets vma fetch the budget again
+    state.allocator.setCurrentFrameIndex(static_cast<uint32_t>(frame_timestamp));
+    std::array<vma::Budget, VK_MAX_MEMORY_HEAPS> budgets;
+    state.allocator.getHeapBudgets(budgets.data());
+
+    vk::DeviceSize usage = 0;
+    vk::DeviceSize budget = 0;
+    for (uint32_t heap = 0; heap < state.physical_device_memory.memoryHeapCount; heap++) {
+        if (local_heaps_mask & (1U << heap)) {
+            usage += budgets[heap].usage;
+            budget += budgets[heap].budget;
+        }
+    }
+
+    std::array<vma::Statistics, CATEGORY_COUNT> stats;
+    vk::DeviceSize block_bytes = 0;
+    vk::DeviceSize allocation_bytes = 0;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        stats[i] = state.allocator.getPoolStatistics(pools[i]);
+        block_bytes += stats[i].blockBytes;
+        allocation_bytes += stats[i].allocationBytes;
+    }
+
+    state.gpu_memory_usage = usage;
+    state.gpu_memory_budget = budget;
+    state.gpu_memory_textures = stats[static_cast<size_t>(MemoryCategory::Textures)].blockBytes;
+    state.gpu_memory_surfaces = stats[static_cast<size_t>(MemoryCategory::Surfaces)].blockBytes + stats[static_cast<size_t>(MemoryCategory::DepthStencil)].blockBytes;
+    state.gpu_memory_staging = stats[static_cast<size_t>(MemoryCategory::Staging)].blockBytes;
+    state.gpu_memory_fragmentation = block_bytes ? static_cast<uint32_t>((block_bytes - allocation_bytes) * 100 / block_bytes) : 0;
+
+    // what is evicted is only destroyed once the frames which can still use it are done, wait for it before looking at the usage again
+    const bool is_eviction_pending = frame_timestamp - last_eviction_frame <= MAX_FRAMES_RENDERING;
+    if (usage > budget * EVICTION_THRESHOLD && !is_eviction_pending) {
+        const size_t to_release = usage - static_cast<vk::DeviceSize>(budget * EVICTION_TARGET);
+
+        // the casted copies of the surfaces are the cheapest to re-create, then the textures which are uploaded again from the guest memory
+        // and last the surfaces, whose content is lost if it was not synced back
+        size_t released = state.surface_cache.release_casted_textures(keep_surfaces_since);
+        if (released < to_release)
+            released += renderer::texture::evict_textures(state.texture_cache, keep_textures_since, to_release - released);
+        if (released < to_release)
+            released += state.surface_cache.evict_color_surfaces(keep_surfaces_since, to_release - released);
+
+        if (released > 0) {
+            LOG_DEBUG("GPU memory usage {} MiB over {} MiB of budget, evicted {} MiB", usage / MiB(1), budget / MiB(1), released / MiB(1));
+            state.gpu_memory_evicted += released;
+            last_eviction_frame = frame_timestamp;
+        }
+    }
+
+    if (frame_timestamp % COMPACTION_PERIOD == 0)
+        compact(frame_timestamp);
+}
+} // namespace renderer::vulkan
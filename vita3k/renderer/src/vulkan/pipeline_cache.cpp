@@ -26,12 +26,16 @@
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <renderer/shaders.h>
+#include <renderer/shared_shader_cache.h>
 #include <shader/spirv_recompiler.h>
 
 #include <util/align.h>
 #include <util/fs.h>
 #include <util/log.h>
 
+#include <algorithm>
+#include <thread>
+
 namespace renderer::vulkan {
 PipelineCache::PipelineCache(VKState &state)
     : state(state) {
@@ -41,6 +45,17 @@ void PipelineCache::init() {
     vk::PipelineCacheCreateInfo pipeline_info{};
     pipeline_cache = state.device.createPipelineCache(pipeline_info);
 
+    if (state.async_pipeline_compilation) {
+        const uint32_t thread_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+        compile_pool = std::make_unique<JobPool>(thread_count);
+    }
+
+    use_pipeline_library = state.pipeline_library && support_pipeline_library;
+    if (use_pipeline_library)
+        LOG_INFO("Pipelines are linked from graphics pipeline libraries");
+    else if (state.pipeline_library)
+        LOG_WARN("Graphics pipeline libraries are not supported by the GPU, full pipelines will be compiled");
+
     // the layout for uniforms buffer can be made here as it will always be the same
     {
         std::array<vk::DescriptorSetLayoutBinding, 4> layout_bindings;
@@ -151,33 +166,58 @@ void PipelineCache::init() {
     }
 }
 
+// the pipeline caches can only be used by the drivers with the same pipeline cache UUID
+static fs::path get_shared_pipeline_cache_name(const VKState &state) {
+    std::string uuid;
+    for (const uint8_t byte : state.physical_device_properties.pipelineCacheUUID)
+        uuid += fmt::format("{:02x}", byte);
+
+    return fs::path(state.title_id) / state.self_name / fmt::format("pipeline-cache-vk{}-{}.dat", shader::CURRENT_VERSION, uuid);
+}
+
 void PipelineCache::read_pipeline_cache() {
     const auto shaders_path{ fs::path(state.base_path) / "cache/shaders" / state.title_id / state.self_name };
     const std::string pipeline_cache_name = fmt::format("pipeline-cache-vk{}.dat", shader::CURRENT_VERSION);
     const fs::path path = shaders_path / pipeline_cache_name;
 
     fs::ifstream pipeline_cache_file(path, std::ios::in | std::ios::binary);
-    if (!pipeline_cache_file.is_open())
-        return;
+    if (pipeline_cache_file.is_open()) {
+        LOG_INFO("Found pipeline cache, reading...");
 
-    LOG_INFO("Found pipeline cache, reading...");
+        pipeline_cache_file.seekg(0, fs::ifstream::end);
+        const size_t pipeline_size = pipeline_cache_file.tellg();
+        pipeline_cache_file.seekg(0);
 
-    pipeline_cache_file.seekg(0, fs::ifstream::end);
-    const size_t pipeline_size = pipeline_cache_file.tellg();
-    pipeline_cache_file.seekg(0);
+        std::vector<char> pipeline_data(pipeline_size);
+        pipeline_cache_file.read(pipeline_data.data(), pipeline_size);
+        pipeline_cache_file.close();
 
-    std::vector<char> pipeline_data(pipeline_size);
-    pipeline_cache_file.read(pipeline_data.data(), pipeline_size);
-    pipeline_cache_file.close();
+        vk::PipelineCacheCreateInfo cache_info{
+            .initialDataSize = pipeline_size,
+            .pInitialData = pipeline_data.data()
+        };
 
-    vk::PipelineCacheCreateInfo cache_info{
-        .initialDataSize = pipeline_size,
-        .pInitialData = pipeline_data.data()
-    };
+        state.device.destroyPipelineCache(pipeline_cache);
+        pipeline_cache = state.device.createPipelineCache(cache_info);
+        LOG_INFO("Pipeline cache read and loaded");
+    }
+
+    if (!state.shared_shader_cache)
+        return;
+
+    // the pipelines compiled by the other machines are merged with the local ones
+    const std::vector<uint8_t> shared_data = state.shared_shader_cache->read(get_shared_pipeline_cache_name(state));
+    if (shared_data.empty())
+        return;
 
-    state.device.destroyPipelineCache(pipeline_cache);
-    pipeline_cache = state.device.createPipelineCache(cache_info);
-    LOG_INFO("Pipeline cache read and loaded");
+    vk::PipelineCacheCreateInfo shared_info{
+        .initialDataSize = shared_data.size(),
+        .pInitialData = shared_data.data()
+    };
+    const vk::PipelineCache shared_cache = state.device.createPipelineCache(shared_info);
+    state.device.mergePipelineCaches(pipeline_cache, shared_cache);
+    state.device.destroyPipelineCache(shared_cache);
+    LOG_INFO("Shared pipeline cache merged");
 }
 
 void PipelineCache::save_pipeline_cache() {
@@ -212,6 +252,10 @@ void PipelineCache::save_pipeline_cache() {
     pipeline_cache_file.write(pipeline_data.data(), pipeline_size);
     pipeline_cache_file.close();
     LOG_INFO("Pipeline cache saved");
+
+    // it holds the pipelines of the shared cache merged at boot, so it replaces it
+    if (state.shared_shader_cache)
+        state.shared_shader_cache->write(get_shared_pipeline_cache_name(state), pipeline_data.data(), pipeline_size, true);
 }
 
 static const Sha256Hash get_shader_hash(const SceGxmProgram &program) {
@@ -240,20 +284,16 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
         return shader_stage_info;
     }
 
-    const char *base_path = state.base_path;
-    const char *title_id = state.title_id;
-    const char *self_name = state.self_name;
-
     const std::string hash_text = hex_string(hash);
 
     LOG_INFO("Generating vulkan spv shader {}", hash_text.data());
-    const std::string shader_version = fmt::format("vk{}", shader::CURRENT_VERSION);
+    const std::string shader_version = fmt::format("vk{}{}", shader::CURRENT_VERSION, state.features.optimize_spirv ? "-opt" : "");
 
     // update shader hints
     current_context->shader_hints.color_format = current_context->record.color_surface.colorFormat;
     current_context->shader_hints.attributes = hint_attributes;
 
-    shader::usse::SpirvCode source = load_spirv_shader(*program, state.features, true, current_context->shader_hints, maskupdate, base_path, title_id, self_name, shader_version, true);
+    shader::usse::SpirvCode source = load_spirv_shader(state, *program, hash, state.features, true, current_context->shader_hints, maskupdate, shader_version, true);
 
     vk::ShaderModuleCreateInfo shader_info{
         .codeSize = sizeof(uint32_t) * source.size(),
@@ -419,6 +459,9 @@ vk::PipelineVertexInputStateCreateInfo PipelineCache::get_vertex_input_state(Mem
     attr_descr.clear();
 
     uint32_t used_streams = 0;
+    // given to the vertex shader with each draw, so it doesn't depend on the attribute formats
+    uint32_t &rgb_attributes_mask = current_context->current_vert_render_info.rgb_attributes_mask;
+    rgb_attributes_mask = 0;
 
     for (const SceGxmVertexAttribute &attribute : vertex_program.attributes) {
         if (vkvert->attribute_infos.find(attribute.regIndex) == vkvert->attribute_infos.end())
@@ -461,6 +504,8 @@ vk::PipelineVertexInputStateCreateInfo PipelineCache::get_vertex_input_state(Mem
             if (component_count == 3 && unsupported_rgb_vertex_attribute_formats.contains(format)) {
                 component_count = 4;
                 format = translate_attribute_format(attribute_format, component_count, info.is_integer, info.is_signed);
+                if (info.location() < 32)
+                    rgb_attributes_mask |= 1U << info.location();
             }
         }
 
@@ -498,93 +543,263 @@ vk::PipelineVertexInputStateCreateInfo PipelineCache::get_vertex_input_state(Mem
     return vertex_input;
 }
 
-static vk::StencilOpState convert_op_state(const GxmStencilStateOp &state) {
-    return vk::StencilOpState{
-        .failOp = translate_stencil_op(state.depth_fail),
-        .passOp = translate_stencil_op(state.depth_pass),
-        .depthFailOp = translate_stencil_op(state.depth_fail),
-        .compareOp = translate_stencil_func(state.func)
-    };
+// Everything read by createGraphicsPipeline, kept alive until a worker thread is done with it
+struct PipelineCompileInfo {
+    std::vector<vk::VertexInputBindingDescription> binding_descr;
+    std::vector<vk::VertexInputAttributeDescription> attr_descr;
+    vk::PipelineVertexInputStateCreateInfo vertex_input;
+    std::array<vk::PipelineShaderStageCreateInfo, 2> shader_stages;
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+    vk::PipelineRasterizationStateCreateInfo rasterizer;
+    vk::PipelineMultisampleStateCreateInfo multisampling;
+    vk::PipelineDepthStencilStateCreateInfo ds_info;
+    vk::PipelineColorBlendAttachmentState blending;
+    vk::PipelineColorBlendStateCreateInfo color_blending;
+    vk::PipelineDynamicStateCreateInfo dynamic_info;
+    vk::PipelineViewportStateCreateInfo viewport;
+    vk::GraphicsPipelineCreateInfo pipeline_info;
+    // only filled when the pipeline is linked from libraries, one for each PipelineLibraryPart
+    std::array<PipelineKey, 4> library_keys;
+    std::array<vk::GraphicsPipelineLibraryCreateInfoEXT, 4> library_types;
+    std::array<vk::GraphicsPipelineCreateInfo, 4> library_infos;
+    // set once compiled
+    vk::Pipeline pipeline;
+};
+
+// the parts a pipeline is linked from when graphics pipeline libraries are used
+enum PipelineLibraryPart : uint32_t {
+    VertexInputPart,
+    PreRasterizationPart,
+    FragmentShaderPart,
+    FragmentOutputPart,
+    PipelineLibraryPartCount
+};
+
+static vk::Pipeline create_pipeline(vk::Device device, vk::PipelineCache pipeline_cache, const vk::GraphicsPipelineCreateInfo &pipeline_info) {
+    const auto result = device.createGraphicsPipeline(pipeline_cache, pipeline_info);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_CRITICAL("Failed to create pipeline.");
+        return nullptr;
+    }
+
+    return result.value;
+}
+
+// The key holds the whole description to be compared on lookup, its hash is only used to find it
+static void pack_pipeline_key(const PipelineDescription &description, PipelineKey &key) {
+    const size_t bindings_size = description.bindings.size() * sizeof(vk::VertexInputBindingDescription);
+    const size_t attributes_size = description.attributes.size() * sizeof(vk::VertexInputAttributeDescription);
+    key.data.resize(sizeof(PipelineStateDescription) + bindings_size + attributes_size);
+
+    uint8_t *data = key.data.data();
+    memcpy(data, &description.state, sizeof(PipelineStateDescription));
+    memcpy(data + sizeof(PipelineStateDescription), description.bindings.data(), bindings_size);
+    memcpy(data + sizeof(PipelineStateDescription) + bindings_size, description.attributes.data(), attributes_size);
+    key.hash = XXH_INLINE_XXH3_64bits(key.data.data(), key.data.size());
+}
+
+static void append_to_key(PipelineKey &key, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    key.data.insert(key.data.end(), bytes, bytes + size);
+}
+
+// each library is only identified by the part of the description it is created from
+static void pack_library_keys(const PipelineDescription &description, std::array<PipelineKey, 4> &keys) {
+    const PipelineStateDescription &desc = description.state;
+    for (PipelineKey &key : keys)
+        key.data.clear();
+
+    PipelineKey &vertex_input = keys[VertexInputPart];
+    append_to_key(vertex_input, &desc.topology, sizeof(desc.topology));
+    append_to_key(vertex_input, description.bindings.data(), description.bindings.size() * sizeof(vk::VertexInputBindingDescription));
+    append_to_key(vertex_input, description.attributes.data(), description.attributes.size() * sizeof(vk::VertexInputAttributeDescription));
+
+    PipelineKey &pre_rasterization = keys[PreRasterizationPart];
+    append_to_key(pre_rasterization, &desc.vertex_hash, sizeof(desc.vertex_hash));
+    append_to_key(pre_rasterization, &desc.polygon_mode, sizeof(desc.polygon_mode));
+    append_to_key(pre_rasterization, &desc.cull_mode, sizeof(desc.cull_mode));
+
+    PipelineKey &fragment_shader = keys[FragmentShaderPart];
+    append_to_key(fragment_shader, &desc.fragment_hash, sizeof(desc.fragment_hash));
+    append_to_key(fragment_shader, &desc.is_fragment_disabled, sizeof(desc.is_fragment_disabled));
+    append_to_key(fragment_shader, &desc.depth_write, sizeof(desc.depth_write));
+    append_to_key(fragment_shader, &desc.depth_func, sizeof(desc.depth_func));
+    append_to_key(fragment_shader, &desc.front_stencil, sizeof(desc.front_stencil));
+    append_to_key(fragment_shader, &desc.back_stencil, sizeof(desc.back_stencil));
+
+    PipelineKey &fragment_output = keys[FragmentOutputPart];
+    append_to_key(fragment_output, &desc.blending, sizeof(desc.blending));
+
+    // both shader parts use the full pipeline layout, and all the parts but the vertex input depend on the render pass
+    for (uint32_t part = PreRasterizationPart; part <= FragmentShaderPart; part++) {
+        append_to_key(keys[part], &desc.vert_texture_count, sizeof(desc.vert_texture_count));
+        append_to_key(keys[part], &desc.frag_texture_count, sizeof(desc.frag_texture_count));
+    }
+    for (uint32_t part = PreRasterizationPart; part < PipelineLibraryPartCount; part++) {
+        append_to_key(keys[part], &desc.color_format, sizeof(desc.color_format));
+        append_to_key(keys[part], &desc.zls_control, sizeof(desc.zls_control));
+    }
+
+    for (PipelineKey &key : keys)
+        key.hash = XXH_INLINE_XXH3_64bits(key.data.data(), key.data.size());
 }
 
 vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem) {
     current_context = &context;
     const GxmRecordState &record = context.record;
-    // get the hash of the current context
-    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
-    uint64_t key = XXH_INLINE_XXH3_64bits(&record, record_pipeline_len);
-
-    // add the hash of the blending
     const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
     const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
         fragment_program_gxm.renderer_data.get());
-    key ^= fragment_program.blending_hash;
-
-    // add the hash of the attribute and stream layout
     const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
-    key ^= vertex_program_gxm.key_hash;
-
-    // and also add the primitive type
-    key ^= static_cast<uint64_t>(type);
-    auto it = pipelines.find(key);
-    if (it != pipelines.end())
-        return it->second;
-
     const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
         vertex_program_gxm.renderer_data.get());
 
+    // the pipeline is identified by everything it is created from
+    PipelineDescription &description = lookup_description;
+    PipelineStateDescription &desc = description.state;
+
     // the vertex input state must be computed before shader are retrieved in case symbols are stripped
-    const vk::PipelineVertexInputStateCreateInfo vertex_input = get_vertex_input_state(mem);
+    get_vertex_input_state(mem);
+    description.bindings = binding_descr;
+    description.attributes = attr_descr;
+    desc.binding_count = static_cast<uint32_t>(binding_descr.size());
+    desc.attribute_count = static_cast<uint32_t>(attr_descr.size());
+
+    desc.vertex_hash = vertex_program.hash;
+    desc.fragment_hash = fragment_program.hash;
+
+    desc.color_format = context.current_render_pass_format;
+    // only the force load and store bits change the render pass
+    desc.zls_control = context.current_render_pass_zls_control & (SCE_GXM_DEPTH_STENCIL_FORCE_LOAD_ENABLED | SCE_GXM_DEPTH_STENCIL_FORCE_STORE_ENABLED);
+    desc.vert_texture_count = vertex_program.texture_count;
+    desc.frag_texture_count = fragment_program.texture_count;
+
+    desc.topology = translate_primitive(type);
+    desc.polygon_mode = translate_polygon_mode(record.front_polygon_mode);
 
-    const vk::PipelineShaderStageCreateInfo vertex_shader = retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
-    const vk::PipelineShaderStageCreateInfo fragment_shader = retrieve_shader(fragment_program_gxm.program.get(mem), fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
-    const vk::PipelineShaderStageCreateInfo shader_stages[] = { vertex_shader, fragment_shader };
     // disable the fragment shader if gxm asks us to
-    const bool is_fragment_disabled = record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED;
-    const uint32_t shader_stage_count = is_fragment_disabled ? 1U : 2U;
+    desc.is_fragment_disabled = record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED;
+
+    if (support_extended_dynamic_state) {
+        // set on the command buffer instead, all the pipelines only differing by them are the same
+        desc.cull_mode = vk::CullModeFlagBits::eNone;
+        desc.depth_write = VK_FALSE;
+        desc.depth_func = vk::CompareOp::eAlways;
+        desc.front_stencil = vk::StencilOpState{};
+        desc.back_stencil = vk::StencilOpState{};
+    } else {
+        const bool two_sided = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED);
+        desc.cull_mode = translate_cull_mode(record.cull_mode);
+        desc.depth_write = (record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED);
+        desc.depth_func = translate_depth_func(record.front_depth_func);
+        desc.front_stencil = translate_stencil_state(record.front_stencil_state_op);
+        desc.back_stencil = translate_stencil_state(two_sided ? record.back_stencil_state_op : record.front_stencil_state_op);
+    }
 
-    const vk::PipelineInputAssemblyStateCreateInfo input_assembly{
-        .topology = translate_primitive(type)
-    };
+    if (desc.is_fragment_disabled) {
+        // The write mask must be empty as the lack of a fragment shader results in undefined values
+        desc.blending = vk::PipelineColorBlendAttachmentState{
+            .blendEnable = VK_FALSE,
+            .colorWriteMask = vk::ColorComponentFlags()
+        };
+    } else {
+        desc.blending = fragment_program.blending;
+    }
+
+    pack_pipeline_key(description, lookup_key);
+
+    if (!pending_pipelines.empty())
+        collect_compiled_pipelines();
 
-    const bool two_sided = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED);
+    auto it = pipelines.find(lookup_key);
+    if (it != pipelines.end())
+        return it->second;
 
-    const vk::PipelineRasterizationStateCreateInfo rasterizer{
-        .polygonMode = translate_polygon_mode(record.front_polygon_mode),
-        .cullMode = translate_cull_mode(record.cull_mode),
+    const auto pending = pending_pipelines.find(lookup_key);
+    if (pending != pending_pipelines.end()) {
+        // still compiled by a worker thread, only wait for it if the draws must not be skipped
+        if (compile_pool)
+            return nullptr;
+
+        pending->second.job->wait();
+        collect_compiled_pipelines();
+        return pipelines[lookup_key];
+    }
+
+    // another pipeline has the same hash, it would have been reused with a key made of the hash alone
+    if (pipeline_hashes.contains(lookup_key.hash))
+        state.pipeline_key_collisions++;
+
+    // the shader modules are then found with their hash
+    retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
+    retrieve_shader(fragment_program_gxm.program.get(mem), fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
+
+    save_pipeline_description(description);
+
+    if (compile_pool) {
+        // the draws using this pipeline are skipped until it is compiled
+        submit_pipeline(*compile_pool, description, lookup_key);
+        return nullptr;
+    }
+
+    const vk::Pipeline pipeline = compile_pipeline(*get_compile_info(description));
+    if (pipeline) {
+        pipelines[lookup_key] = pipeline;
+        pipeline_hashes.insert(lookup_key.hash);
+    }
+
+    return pipeline;
+}
+
+std::shared_ptr<PipelineCompileInfo> PipelineCache::get_compile_info(const PipelineDescription &description) {
+    const PipelineStateDescription &desc = description.state;
+    // the pointers of the create info point to its own members, it must not be moved once filled
+    const auto info = std::make_shared<PipelineCompileInfo>();
+
+    info->binding_descr = description.bindings;
+    info->attr_descr = description.attributes;
+    info->vertex_input.setVertexBindingDescriptions(info->binding_descr);
+    info->vertex_input.setVertexAttributeDescriptions(info->attr_descr);
+
+    info->shader_stages[0] = vk::PipelineShaderStageCreateInfo{
+        .stage = vk::ShaderStageFlagBits::eVertex,
+        .module = shaders.at(desc.vertex_hash),
+        .pName = "main_vs"
+    };
+    info->shader_stages[1] = vk::PipelineShaderStageCreateInfo{
+        .stage = vk::ShaderStageFlagBits::eFragment,
+        .module = shaders.at(desc.fragment_hash),
+        .pName = "main_fs"
+    };
+    const uint32_t shader_stage_count = desc.is_fragment_disabled ? 1U : 2U;
+
+    info->input_assembly = vk::PipelineInputAssemblyStateCreateInfo{
+        .topology = desc.topology
+    };
+    info->rasterizer = vk::PipelineRasterizationStateCreateInfo{
+        .polygonMode = desc.polygon_mode,
+        .cullMode = desc.cull_mode,
         // front face is always counter clockwise
         .frontFace = vk::FrontFace::eCounterClockwise,
         .depthBiasEnable = VK_TRUE
     };
-    const vk::PipelineMultisampleStateCreateInfo multisampling{
+    info->multisampling = vk::PipelineMultisampleStateCreateInfo{
         .rasterizationSamples = vk::SampleCountFlagBits::e1
     };
     // depth and stencil tests are always enabled on the ps vita as there is almost no cost in doing so
     // on a tiled renderer
-    const vk::PipelineDepthStencilStateCreateInfo ds_info{
+    info->ds_info = vk::PipelineDepthStencilStateCreateInfo{
         .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = (record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED),
-        .depthCompareOp = translate_depth_func(record.front_depth_func),
+        .depthWriteEnable = desc.depth_write,
+        .depthCompareOp = desc.depth_func,
         .depthBoundsTestEnable = VK_FALSE,
         .stencilTestEnable = VK_TRUE,
-        .front = convert_op_state(record.front_stencil_state_op),
-        .back = convert_op_state(two_sided ? record.back_stencil_state_op : record.front_stencil_state_op)
+        .front = desc.front_stencil,
+        .back = desc.back_stencil
     };
 
-    vk::PipelineColorBlendStateCreateInfo color_blending{};
-    if (is_fragment_disabled) {
-        // The write mask must be empty as the lack of a fragment shader results in undefined values
-        static const vk::PipelineColorBlendAttachmentState blending = {
-            .blendEnable = VK_FALSE,
-            .colorWriteMask = vk::ColorComponentFlags()
-        };
-        color_blending.setAttachments(blending);
-    } else {
-        const vk::PipelineColorBlendAttachmentState &blending = fragment_program.blending;
-        color_blending.setAttachments(blending);
-    }
-
-    vk::PipelineLayout pipeline_layout = retrieve_pipeline_layout(vertex_program.texture_count, fragment_program.texture_count);
+    info->blending = desc.blending;
+    info->color_blending.setAttachments(info->blending);
 
     // all of these can be changed at any time using the vita graphics api (like opengl)
     // Because each one can take a lot of different values, it's better to set them as dynamic
@@ -595,47 +810,239 @@ vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiv
         vk::DynamicState::eStencilCompareMask,
         vk::DynamicState::eStencilReference,
         vk::DynamicState::eStencilWriteMask,
-        vk::DynamicState::eDepthBias
+        vk::DynamicState::eDepthBias,
+        // only used with extended dynamic state, they are then set by sync_extended_dynamic_state
+        vk::DynamicState::eCullModeEXT,
+        vk::DynamicState::eDepthWriteEnableEXT,
+        vk::DynamicState::eDepthCompareOpEXT,
+        vk::DynamicState::eStencilOpEXT
+    };
+    constexpr uint32_t extended_dynamic_state_count = 4;
+    info->dynamic_info = vk::PipelineDynamicStateCreateInfo{
+        .dynamicStateCount = static_cast<uint32_t>(std::size(dynamic_states)) - (support_extended_dynamic_state ? 0 : extended_dynamic_state_count),
+        .pDynamicStates = dynamic_states
     };
-    vk::PipelineDynamicStateCreateInfo dynamic_info{};
-    dynamic_info.setDynamicStates(dynamic_states);
 
     // we still need to specifiy the viewport and scissor count even though they are dynamic
-    vk::PipelineViewportStateCreateInfo viewport{
+    info->viewport = vk::PipelineViewportStateCreateInfo{
         .viewportCount = 1,
         .scissorCount = 1
     };
 
-    vk::GraphicsPipelineCreateInfo pipeline_info{
+    info->pipeline_info = vk::GraphicsPipelineCreateInfo{
         .stageCount = shader_stage_count,
-        .pStages = shader_stages,
-        .pVertexInputState = &vertex_input,
-        .pInputAssemblyState = &input_assembly,
-        .pViewportState = &viewport,
-        .pRasterizationState = &rasterizer,
-        .pMultisampleState = &multisampling,
-        .pDepthStencilState = &ds_info,
-        .pColorBlendState = &color_blending,
-        .pDynamicState = &dynamic_info,
-        .layout = pipeline_layout,
-        .renderPass = context.current_render_pass,
+        .pStages = info->shader_stages.data(),
+        .pVertexInputState = &info->vertex_input,
+        .pInputAssemblyState = &info->input_assembly,
+        .pViewportState = &info->viewport,
+        .pRasterizationState = &info->rasterizer,
+        .pMultisampleState = &info->multisampling,
+        .pDepthStencilState = &info->ds_info,
+        .pColorBlendState = &info->color_blending,
+        .pDynamicState = &info->dynamic_info,
+        .layout = retrieve_pipeline_layout(desc.vert_texture_count, desc.frag_texture_count),
+        .renderPass = retrieve_render_pass(desc.color_format, desc.zls_control),
         .subpass = 0
     };
 
-    const auto result = state.device.createGraphicsPipeline(pipeline_cache, pipeline_info);
-    if (result.result != vk::Result::eSuccess) {
-        LOG_CRITICAL("Failed to create pipeline.");
-        return nullptr;
+    if (use_pipeline_library) {
+        pack_library_keys(description, info->library_keys);
+
+        info->library_types[VertexInputPart].flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface;
+        info->library_infos[VertexInputPart] = vk::GraphicsPipelineCreateInfo{
+            .pVertexInputState = &info->vertex_input,
+            .pInputAssemblyState = &info->input_assembly
+        };
+
+        info->library_types[PreRasterizationPart].flags = vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders;
+        info->library_infos[PreRasterizationPart] = vk::GraphicsPipelineCreateInfo{
+            .stageCount = 1,
+            .pStages = &info->shader_stages[0],
+            .pViewportState = &info->viewport,
+            .pRasterizationState = &info->rasterizer,
+            .pDynamicState = &info->dynamic_info,
+            .layout = info->pipeline_info.layout,
+            .renderPass = info->pipeline_info.renderPass
+        };
+
+        info->library_types[FragmentShaderPart].flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader;
+        info->library_infos[FragmentShaderPart] = vk::GraphicsPipelineCreateInfo{
+            .stageCount = shader_stage_count - 1,
+            .pStages = &info->shader_stages[1],
+            .pMultisampleState = &info->multisampling,
+            .pDepthStencilState = &info->ds_info,
+            .pDynamicState = &info->dynamic_info,
+            .layout = info->pipeline_info.layout,
+            .renderPass = info->pipeline_info.renderPass
+        };
+
+        info->library_types[FragmentOutputPart].flags = vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+        info->library_infos[FragmentOutputPart] = vk::GraphicsPipelineCreateInfo{
+            .pMultisampleState = &info->multisampling,
+            .pColorBlendState = &info->color_blending,
+            .renderPass = info->pipeline_info.renderPass
+        };
+
+        for (uint32_t part = 0; part < PipelineLibraryPartCount; part++) {
+            info->library_infos[part].pNext = &info->library_types[part];
+            info->library_infos[part].flags = vk::PipelineCreateFlagBits::eLibraryKHR;
+        }
     }
 
-    pipelines[key] = result.value;
+    return info;
+}
 
-    return result.value;
+vk::Pipeline PipelineCache::retrieve_pipeline_library(uint32_t part, const PipelineKey &key, const vk::GraphicsPipelineCreateInfo &library_info) {
+    {
+        const std::lock_guard<std::mutex> guard(libraries_mutex);
+        const auto it = pipeline_libraries[part].find(key);
+        if (it != pipeline_libraries[part].end())
+            return it->second;
+    }
+
+    // compiled without holding the lock, another thread may create the same library in the meantime
+    const vk::Pipeline library = create_pipeline(state.device, pipeline_cache, library_info);
+
+    const std::lock_guard<std::mutex> guard(libraries_mutex);
+    const auto [it, inserted] = pipeline_libraries[part].emplace(key, library);
+    if (!inserted && library)
+        state.device.destroyPipeline(library);
+
+    return it->second;
+}
+
+vk::Pipeline PipelineCache::compile_pipeline(PipelineCompileInfo &info) {
+    state.pipelines_count_compiled++;
+    if (!use_pipeline_library)
+        return create_pipeline(state.device, pipeline_cache, info.pipeline_info);
+
+    // only the parts which are not used by another pipeline yet are compiled, linking them is fast
+    std::array<vk::Pipeline, PipelineLibraryPartCount> libraries;
+    for (uint32_t part = 0; part < PipelineLibraryPartCount; part++) {
+        libraries[part] = retrieve_pipeline_library(part, info.library_keys[part], info.library_infos[part]);
+        if (!libraries[part])
+            return nullptr;
+    }
+
+    vk::PipelineLibraryCreateInfoKHR link_info{};
+    link_info.setLibraries(libraries);
+    const vk::GraphicsPipelineCreateInfo linked_info{
+        .pNext = &link_info,
+        .layout = info.pipeline_info.layout
+    };
+
+    return create_pipeline(state.device, pipeline_cache, linked_info);
+}
+
+void PipelineCache::submit_pipeline(JobPool &pool, const PipelineDescription &description, const PipelineKey &key) {
+    const std::shared_ptr<PipelineCompileInfo> info = get_compile_info(description);
+    JobPtr job = pool.submit([this, info]() {
+        info->pipeline = compile_pipeline(*info);
+    });
+    pending_pipelines.emplace(key, PendingPipeline{ std::move(job), info });
+    pipeline_hashes.insert(key.hash);
+    state.pipelines_count_pending = static_cast<uint32_t>(pending_pipelines.size());
+}
+
+void PipelineCache::collect_compiled_pipelines() {
+    std::erase_if(pending_pipelines, [&](const auto &pending) {
+        if (!pending.second.job->is_done())
+            return false;
+
+        // a pipeline which failed to compile is kept as a null handle, its draws are always skipped
+        pipelines[pending.first] = pending.second.info->pipeline;
+        return true;
+    });
+    state.pipelines_count_pending = static_cast<uint32_t>(pending_pipelines.size());
+}
+
+static fs::path get_pipeline_database_path(const VKState &state) {
+    const auto shaders_path{ fs::path(state.base_path) / "cache/shaders" / state.title_id / state.self_name };
+    return shaders_path / fmt::format("pipelines-vk{}.dat", shader::CURRENT_VERSION);
+}
+
+void PipelineCache::save_pipeline_description(const PipelineDescription &description) {
+    const fs::path path = get_pipeline_database_path(state);
+    if (!fs::exists(path.parent_path()))
+        fs::create_directories(path.parent_path());
+
+    const bool is_new = !fs::exists(path);
+    fs::ofstream database(path, std::ios::out | std::ios::binary | std::ios::app);
+    if (!database.is_open())
+        return;
+
+    if (is_new)
+        database.write(reinterpret_cast<const char *>(&pipeline_database_version), sizeof(uint32_t));
+
+    database.write(reinterpret_cast<const char *>(&description.state), sizeof(PipelineStateDescription));
+    database.write(reinterpret_cast<const char *>(description.bindings.data()), description.bindings.size() * sizeof(vk::VertexInputBindingDescription));
+    database.write(reinterpret_cast<const char *>(description.attributes.data()), description.attributes.size() * sizeof(vk::VertexInputAttributeDescription));
+}
+
+void PipelineCache::prewarm_pipelines() {
+    const fs::path path = get_pipeline_database_path(state);
+    fs::ifstream database(path, std::ios::in | std::ios::binary);
+    if (!database.is_open())
+        return;
+
+    uint32_t version = 0;
+    database.read(reinterpret_cast<char *>(&version), sizeof(uint32_t));
+    if (!database || version != pipeline_database_version) {
+        database.close();
+        LOG_WARN("Pipeline database version {} is outdated, recreate it.", version);
+        fs::remove(path);
+        return;
+    }
+
+    if (!compile_pool && !prewarm_pool) {
+        const uint32_t thread_count = std::clamp<uint32_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+        prewarm_pool = std::make_unique<JobPool>(thread_count);
+    }
+    JobPool &pool = compile_pool ? *compile_pool : *prewarm_pool;
+
+    size_t pipeline_count = 0;
+    PipelineDescription description;
+    PipelineKey key;
+    while (database.read(reinterpret_cast<char *>(&description.state), sizeof(PipelineStateDescription))) {
+        const PipelineStateDescription &desc = description.state;
+        // stop at the first damaged entry, a vertex program has at most 16 streams and 16 attributes, which can be matrices
+        if (desc.binding_count > SCE_GXM_MAX_VERTEX_STREAMS || desc.attribute_count > 16 * 4)
+            break;
+
+        description.bindings.resize(desc.binding_count);
+        description.attributes.resize(desc.attribute_count);
+        database.read(reinterpret_cast<char *>(description.bindings.data()), desc.binding_count * sizeof(vk::VertexInputBindingDescription));
+        database.read(reinterpret_cast<char *>(description.attributes.data()), desc.attribute_count * sizeof(vk::VertexInputAttributeDescription));
+        if (!database)
+            break;
+
+        // the same pipeline may be saved twice if its shaders were missing from the cache last time
+        pack_pipeline_key(description, key);
+        if (pipelines.contains(key) || pending_pipelines.contains(key))
+            continue;
+
+        if (!precompile_shader(desc.vertex_hash) || !precompile_shader(desc.fragment_hash))
+            continue;
+
+        submit_pipeline(pool, description, key);
+        pipeline_count++;
+    }
+
+    LOG_INFO("Compiling {} pipelines from the pipeline database", pipeline_count);
 }
 
 bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
     const auto shader_path{ fs::path(state.base_path) / "cache/shaders" / state.title_id / state.self_name };
 
+    // it may still be loaded by the precompile pool
+    const auto precompiling = precompiling_shaders.find(hash);
+    if (precompiling != precompiling_shaders.end()) {
+        precompiling->second.job->wait();
+        if (*precompiling->second.shader)
+            shaders[hash] = *precompiling->second.shader;
+        precompiling_shaders.erase(precompiling);
+    }
+
     auto it = shaders.find(hash);
     if (it != shaders.end())
         return true;
@@ -647,7 +1054,7 @@ bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
     memcpy(shader_hash.data(), hash.data(), sizeof(Sha256Hash));
     const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(shader_hash));
 
-    const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.base_path, state.title_id, state.self_name);
+    const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.base_path, state.title_id, state.self_name, state.shader_pack.get());
 
     if (source.empty())
         return false;
@@ -662,4 +1069,46 @@ bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
 
     return true;
 }
+
+void PipelineCache::precompile_shader_async(const Sha256Hash &hash) {
+    if (shaders.contains(hash) || precompiling_shaders.contains(hash))
+        return;
+
+    if (!precompile_pool) {
+        // reading and creating the shader modules is not limited by the GPU, use all the host threads
+        const uint32_t thread_count = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+        precompile_pool = std::make_unique<JobPool>(thread_count);
+    }
+
+    const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(hash));
+    auto shader = std::make_shared<vk::ShaderModule>();
+    JobPtr job = precompile_pool->submit([this, hash_ver, shader]() {
+        const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.base_path, state.title_id, state.self_name, state.shader_pack.get());
+        if (source.empty())
+            return;
+
+        vk::ShaderModuleCreateInfo shader_info{
+            .codeSize = sizeof(uint32_t) * source.size(),
+            .pCode = source.data()
+        };
+        *shader = state.device.createShaderModule(shader_info);
+    });
+
+    precompiling_shaders.emplace(hash, PrecompilingShader{ job, shader });
+}
+
+void PipelineCache::collect_precompiled_shaders() {
+    std::erase_if(precompiling_shaders, [&](const auto &item) {
+        const auto &[hash, precompiling] = item;
+        if (!precompiling.job->is_done())
+            return false;
+
+        if (*precompiling.shader)
+            shaders[hash] = *precompiling.shader;
+        return true;
+    });
+
+    if (precompiling_shaders.empty())
+        precompile_pool.reset();
+}
 } // namespace renderer::vulkan
\ No newline at end of file
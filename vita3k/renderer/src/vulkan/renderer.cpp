@@ -22,6 +22,7 @@
 
 #include <config/version.h>
 #include <display/state.h>
+#include <mem/state.h>
 #include <shader/spirv_recompiler.h>
 #include <util/float_to_half.h>
 #include <util/log.h>
@@ -100,12 +101,10 @@ static bool select_queues(VKState &vk_state,
             };
             queue_infos.emplace_back(std::move(queue_create_info));
             vk_state.general_family_index = i;
-            vk_state.transfer_family_index = i;
             found_graphics = true;
-            found_transfer = true;
-        }
-        // for now use the same queue for graphics and transfer, to be improved on later
-        /* else if (!found_transfer && queue_family.queueFlags & vk::QueueFlagBits::eTransfer) {
+        } else if (vk_state.transfer_queue_uploads && !found_transfer && (queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
+            && !(queue_family.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            // only a dedicated transfer queue (usually backed by a DMA engine) can run concurrently with the rendering
             vk::DeviceQueueCreateInfo queue_create_info{
                 .queueFamilyIndex = i,
                 .queueCount = queue_family.queueCount,
@@ -115,13 +114,16 @@ static bool select_queues(VKState &vk_state,
             vk_state.transfer_family_index = i;
             found_transfer = true;
         }
-        */
 
-        if (found_graphics && found_transfer)
+        if (found_graphics && (found_transfer || !vk_state.transfer_queue_uploads))
             break;
     }
 
-    return found_graphics && found_transfer;
+    // otherwise use the same queue for graphics and transfer
+    if (!found_transfer)
+        vk_state.transfer_family_index = vk_state.general_family_index;
+
+    return found_graphics;
 }
 
 // Adapted from https://github.com/SaschaWillems/vulkan.gpuinfo.org/blob/master/includes/functions.php
@@ -151,11 +153,12 @@ VKState::VKState(int gpu_idx)
     , surface_cache(*this)
     , pipeline_cache(*this)
     , texture_cache(*this)
+    , memory_budget(*this)
     , screen_renderer(*this) {
 }
 
 bool VKState::init(const char *base_path, const bool hashless_texture_cache) {
-    shader_version = fmt::format("v{}", shader::CURRENT_VERSION);
+    shader_version = fmt::format("v{}{}", shader::CURRENT_VERSION, features.optimize_spirv ? "-opt" : "");
     return true;
 }
 
@@ -299,6 +302,7 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             .fillModeNonSolid = physical_device_features.fillModeNonSolid,
             .wideLines = physical_device_features.wideLines,
             .samplerAnisotropy = physical_device_features.samplerAnisotropy,
+            .textureCompressionBC = physical_device_features.textureCompressionBC,
         };
 
         // look for optional extensions
@@ -307,6 +311,8 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         bool support_global_priority = false;
         bool support_buffer_device_address = false;
         bool support_standard_layout = false;
+        bool support_present_id = false;
+        bool support_pipeline_library = false;
         const std::map<std::string, bool *> optional_extensions = {
             { VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, &temp_bool },
             // can be used by vma to improve performance
@@ -321,7 +327,21 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             // also needed for reading mapped memory in the shader
             { VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME, &support_buffer_device_address },
             // needed for uniform uvec2 arrays not to take twice the size
-            { VK_KHR_UNIFORM_BUFFER_STANDARD_LAYOUT_EXTENSION_NAME, &support_standard_layout }
+            { VK_KHR_UNIFORM_BUFFER_STANDARD_LAYOUT_EXTENSION_NAME, &support_standard_layout },
+            // PowerVR GPUs can sample the vita PVRTC textures without decoding them
+            { VK_IMG_FORMAT_PVRTC_EXTENSION_NAME, &texture_cache.support_pvrtc },
+            // the pipelines can be linked from parts compiled once for all the pipelines sharing them
+            { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, &support_pipeline_library },
+            { VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, &pipeline_cache.support_pipeline_library },
+            // the cull mode, depth and stencil ops can be changed without switching to another pipeline
+            { VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, &pipeline_cache.support_extended_dynamic_state },
+            // the wait thread can wait for the scenes with a single semaphore instead of their fences
+            { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, &support_timeline_semaphore },
+            // the screen renderer can wait for a frame to be displayed to limit the latency and pace the vblanks
+            { VK_KHR_PRESENT_ID_EXTENSION_NAME, &support_present_id },
+            { VK_KHR_PRESENT_WAIT_EXTENSION_NAME, &support_present_wait },
+            // vma can then keep the allocations under the budget given by the driver instead of estimating it
+            { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, &memory_budget.support_memory_budget }
         };
 
         for (const vk::ExtensionProperties &ext : physical_device.enumerateDeviceExtensionProperties()) {
@@ -345,6 +365,29 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         }
         features.support_memory_mapping &= support_standard_layout;
 
+        if (pipeline_cache.support_pipeline_library) {
+            auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+            pipeline_cache.support_pipeline_library = support_pipeline_library && features.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+        }
+
+        if (pipeline_cache.support_extended_dynamic_state) {
+            auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+            pipeline_cache.support_extended_dynamic_state = features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
+        }
+        if (pipeline_cache.support_extended_dynamic_state)
+            LOG_INFO("Extended dynamic state is enabled");
+
+        if (support_timeline_semaphore) {
+            auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+            support_timeline_semaphore = features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore;
+        }
+
+        if (support_present_wait) {
+            auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+            support_present_wait = support_present_id && features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+                && features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+        }
+
         if (features.support_memory_mapping) {
             // disable memory mapping on GPUs with an alignment requirement higher than 4096 (should only
             // concern a few intel iGPUs)
@@ -357,9 +400,27 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         features.support_memory_mapping = false;
 #endif
 
-        if (features.support_memory_mapping)
+        if (features.support_memory_mapping) {
             LOG_INFO("Memory mapping is enabled");
 
+            // the framebuffers can then be sampled from the mapped memory if the GPU can import it into linear images
+            const vk::FormatProperties format_props = physical_device.getFormatProperties(vk::Format::eR8G8B8A8Unorm);
+            vk::StructureChain<vk::PhysicalDeviceImageFormatInfo2, vk::PhysicalDeviceExternalImageFormatInfo> image_format_info{
+                vk::PhysicalDeviceImageFormatInfo2{
+                    .format = vk::Format::eR8G8B8A8Unorm,
+                    .type = vk::ImageType::e2D,
+                    .tiling = vk::ImageTiling::eLinear,
+                    .usage = vk::ImageUsageFlagBits::eSampled },
+                vk::PhysicalDeviceExternalImageFormatInfo{
+                    .handleType = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT }
+            };
+            vk::StructureChain<vk::ImageFormatProperties2, vk::ExternalImageFormatProperties> image_format_props;
+            const vk::Result result = physical_device.getImageFormatProperties2(&image_format_info.get(), &image_format_props.get());
+            support_mapped_framebuffer = (result == vk::Result::eSuccess)
+                && (format_props.linearTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage)
+                && (image_format_props.get<vk::ExternalImageFormatProperties>().externalMemoryProperties.externalMemoryFeatures & vk::ExternalMemoryFeatureFlagBits::eImportable);
+        }
+
         if (physical_device_properties.vendorID == 4318) {
             // Nvidia does not allow us to set the device priority higher than normal
             // no need to remove the priority extension
@@ -379,13 +440,23 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
         // We use subpass input to get something similar to direct fragcolor access (there is no difference for the shader)
         features.direct_fragcolor = true;
 
-        vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceBufferAddressFeaturesEXT, vk::PhysicalDeviceUniformBufferStandardLayoutFeatures> device_info{
+        vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceBufferAddressFeaturesEXT, vk::PhysicalDeviceUniformBufferStandardLayoutFeatures, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT, vk::PhysicalDeviceTimelineSemaphoreFeatures, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR> device_info{
             vk::DeviceCreateInfo{
                 .pEnabledFeatures = &enabled_features },
             vk::PhysicalDeviceBufferAddressFeaturesEXT{
                 .bufferDeviceAddress = VK_TRUE },
             vk::PhysicalDeviceUniformBufferStandardLayoutFeatures{
-                .uniformBufferStandardLayout = VK_TRUE }
+                .uniformBufferStandardLayout = VK_TRUE },
+            vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT{
+                .graphicsPipelineLibrary = VK_TRUE },
+            vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT{
+                .extendedDynamicState = VK_TRUE },
+            vk::PhysicalDeviceTimelineSemaphoreFeatures{
+                .timelineSemaphore = VK_TRUE },
+            vk::PhysicalDevicePresentIdFeaturesKHR{
+                .presentId = VK_TRUE },
+            vk::PhysicalDevicePresentWaitFeaturesKHR{
+                .presentWait = VK_TRUE }
         };
         device_info.get().setQueueCreateInfos(queue_infos);
         device_info.get().setPEnabledExtensionNames(device_extensions);
@@ -394,6 +465,16 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
             device_info.unlink<vk::PhysicalDeviceBufferAddressFeaturesEXT>();
             device_info.unlink<vk::PhysicalDeviceUniformBufferStandardLayoutFeatures>();
         }
+        if (!pipeline_cache.support_pipeline_library)
+            device_info.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+        if (!pipeline_cache.support_extended_dynamic_state)
+            device_info.unlink<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+        if (!support_timeline_semaphore)
+            device_info.unlink<vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+        if (!support_present_wait) {
+            device_info.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+            device_info.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        }
 
         try {
             device = physical_device.createDevice(device_info.get());
@@ -413,6 +494,11 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
     general_queue = device.getQueue(general_family_index, 0);
     transfer_queue = device.getQueue(transfer_family_index, 0);
 
+    // the general queue waits for the uploads of the transfer queue with a timeline semaphore
+    transfer_queue_uploads &= (transfer_family_index != general_family_index) && support_timeline_semaphore;
+    if (transfer_queue_uploads)
+        LOG_INFO("New textures are uploaded from a dedicated transfer queue");
+
     // Create Command Pools
     {
         vk::CommandPoolCreateInfo general_pool_info{
@@ -446,6 +532,8 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
 
         if (support_dedicated_allocations)
             allocator_info.flags |= vma::AllocatorCreateFlagBits::eKhrDedicatedAllocation;
+        if (memory_budget.support_memory_budget)
+            allocator_info.flags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
 
         allocator = vma::createAllocator(allocator_info);
     }
@@ -488,16 +576,34 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
 
     pipeline_cache.init();
     texture_cache.backend = &current_backend;
+    texture_cache.draw_profile = &draw_profile;
     texture::init(texture_cache, false);
+    texture_cache.decode_all_formats = gpu_texture_decode;
+    texture::init_gpu_decode(texture_cache, base_path);
+    memory_budget.init();
 
     return true;
 }
 
 void VKState::cleanup() {
+    // the pipelines left to compile still use the device
+    pipeline_cache.compile_pool.reset();
+    pipeline_cache.prewarm_pool.reset();
     device.waitIdle();
 
     screen_renderer.cleanup();
 
+    for (const MappedFramebuffer &framebuffer : mapped_framebuffers) {
+        device.destroy(framebuffer.view);
+        device.destroy(framebuffer.image);
+    }
+    mapped_framebuffers.clear();
+
+    for (const auto &[key, sampler] : texture_cache.sampler_cache.samplers)
+        device.destroy(sampler);
+    texture_cache.sampler_cache.samplers.clear();
+
+    memory_budget.cleanup();
     allocator.destroy();
 
     device.destroy(general_command_pool);
@@ -526,6 +632,10 @@ void VKState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
     vk::ImageView surface_handle = surface_cache.sourcing_color_surface_for_presentation(
         display.frame.base, display.frame.image_size.x, display.frame.image_size.y, display.frame.pitch, uvs, this->res_multiplier, texture_size);
 
+    // the framebuffer was written by the CPU, sample it where it is if it is in a mapped memory
+    if (!surface_handle && support_mapped_framebuffer)
+        surface_handle = get_mapped_framebuffer(display.frame, mem, uvs, texture_size);
+
     if (!surface_handle) {
         vkutil::Image &vita_surface = screen_renderer.vita_surface[screen_renderer.swapchain_image_idx];
         if (display.frame.image_size.x != vita_surface.width || display.frame.image_size.y != vita_surface.height) {
@@ -578,8 +688,12 @@ void VKState::set_fxaa(bool enable_fxaa) {
     screen_renderer.enable_fxaa = enable_fxaa;
 }
 
-bool VKState::map_memory(void *address, uint32_t size) {
+// granularity of mapped_memory_pages, the mapped memories are aligned to it
+static constexpr uint32_t MAPPED_PAGE_BITS = 12;
+
+bool VKState::map_memory(MemState &mem, Ptr<void> guest_address, uint32_t size) {
     assert(features.support_memory_mapping);
+    void *address = guest_address.get(mem);
     // the adress should be 4K aligned
     assert(((uint64_t)address & 4095) == 0);
 
@@ -623,13 +737,22 @@ bool VKState::map_memory(void *address, uint32_t size) {
     };
     const uint64_t buffer_address = device.getBufferAddress(address_info);
 
-    mapped_memories[std::bit_cast<uint64_t>(address)] = { address, size, device_memory, mapped_buffer, buffer_address };
+    const MappedMemory &mapped_memory = mapped_memories[std::bit_cast<uint64_t>(address)] = { address, size, device_memory, mapped_buffer, buffer_address, mapped_memory_type };
+
+    if (mapped_memory_pages.empty()) {
+        mapped_memory_pages.resize(1ULL << (32 - MAPPED_PAGE_BITS), nullptr);
+        guest_memory_base = mem.memory.get();
+    }
+    const uint32_t first_page = guest_address.address() >> MAPPED_PAGE_BITS;
+    const uint32_t last_page = (guest_address.address() + size - 1) >> MAPPED_PAGE_BITS;
+    std::fill(mapped_memory_pages.begin() + first_page, mapped_memory_pages.begin() + last_page + 1, &mapped_memory);
 
     return true;
 }
 
-void VKState::unmap_memory(void *address) {
+void VKState::unmap_memory(MemState &mem, Ptr<void> guest_address) {
     assert(features.support_memory_mapping);
+    void *address = guest_address.get(mem);
 
     auto ite = mapped_memories.find(std::bit_cast<uint64_t>(address));
     if (ite == mapped_memories.end()) {
@@ -638,42 +761,165 @@ void VKState::unmap_memory(void *address) {
     }
 
     // we need to wait in case the buffer is being used
+    if (context) {
+        reinterpret_cast<VKContext *>(context)->flush_pending_scene();
+        reinterpret_cast<VKContext *>(context)->flush_submissions();
+    }
     device.waitIdle();
 
+    std::erase_if(mapped_framebuffers, [&](const MappedFramebuffer &framebuffer) {
+        if (framebuffer.memory != &ite->second)
+            return false;
+
+        device.destroy(framebuffer.view);
+        device.destroy(framebuffer.image);
+        return true;
+    });
+
     // deferred destory it instead
     device.destroyBuffer(ite->second.buffer);
     device.freeMemory(ite->second.memory);
+
+    const uint32_t first_page = guest_address.address() >> MAPPED_PAGE_BITS;
+    const uint32_t last_page = (guest_address.address() + ite->second.size - 1) >> MAPPED_PAGE_BITS;
+    std::fill(mapped_memory_pages.begin() + first_page, mapped_memory_pages.begin() + last_page + 1, nullptr);
     mapped_memories.erase(ite);
 }
 
+static const MappedMemory *find_mapped_memory(const VKState &state, const void *address) {
+    const uint64_t guest_offset = static_cast<const uint8_t *>(address) - state.guest_memory_base;
+    if ((guest_offset >> MAPPED_PAGE_BITS) >= state.mapped_memory_pages.size())
+        return nullptr;
+
+    return state.mapped_memory_pages[guest_offset >> MAPPED_PAGE_BITS];
+}
+
 std::tuple<vk::Buffer, uint32_t> VKState::get_matching_mapping(const void *address) {
-    uint64_t address_value = std::bit_cast<uint64_t>(address);
-    auto mapped_memory = mapped_memories.lower_bound(address_value);
-    if (mapped_memory == mapped_memories.end()
-        || mapped_memory->first + mapped_memory->second.size < address_value) {
+    const MappedMemory *mapped_memory = find_mapped_memory(*this, address);
+    if (!mapped_memory) {
         LOG_ERROR("Could not find matching mapped buffer for vertex stream");
         return { nullptr, 0 };
     }
 
-    return std::make_tuple(mapped_memory->second.buffer, static_cast<uint32_t>(address_value - mapped_memory->first));
+    return std::make_tuple(mapped_memory->buffer, static_cast<uint32_t>(static_cast<const uint8_t *>(address) - static_cast<const uint8_t *>(mapped_memory->address)));
 }
 
 uint64_t VKState::get_matching_device_address(const void *address) {
-    uint64_t address_value = std::bit_cast<uint64_t>(address);
-    auto mapped_memory = mapped_memories.lower_bound(address_value);
-    if (mapped_memory == mapped_memories.end()
-        || mapped_memory->first + mapped_memory->second.size < address_value) {
+    const MappedMemory *mapped_memory = find_mapped_memory(*this, address);
+    if (!mapped_memory) {
         LOG_ERROR("Could not find matching mapped buffer for vertex stream");
         return 0;
     }
 
-    return mapped_memory->second.buffer_address + address_value - mapped_memory->first;
+    return mapped_memory->buffer_address + (static_cast<const uint8_t *>(address) - static_cast<const uint8_t *>(mapped_memory->address));
+}
+
+// framebuffers kept bound to the mapped memory, the oldest one is destroyed past this
+static constexpr size_t MAX_MAPPED_FRAMEBUFFERS = 8;
+
+vk::ImageView VKState::get_mapped_framebuffer(const DisplayFrameInfo &frame, MemState &mem, std::array<float, 4> &uvs, SceFVector2 &texture_size) {
+    const uint32_t width = frame.image_size.x;
+    const uint32_t height = frame.image_size.y;
+    const uint8_t *address = static_cast<const uint8_t *>(frame.base.get(mem));
+    const MappedMemory *mapped_memory = find_mapped_memory(*this, address);
+    if (!mapped_memory || frame.pitch < width)
+        return nullptr;
+
+    const uint64_t offset = address - static_cast<const uint8_t *>(mapped_memory->address);
+    const uint64_t size = static_cast<uint64_t>(frame.pitch) * height * 4;
+    if (offset + size > mapped_memory->size)
+        return nullptr;
+
+    auto framebuffer = std::find_if(mapped_framebuffers.begin(), mapped_framebuffers.end(), [&](const MappedFramebuffer &framebuffer) {
+        return framebuffer.address == frame.base.address() && framebuffer.width == width && framebuffer.height == height
+            && framebuffer.pitch == frame.pitch && framebuffer.memory == mapped_memory;
+    });
+
+    if (framebuffer == mapped_framebuffers.end()) {
+        if (mapped_framebuffers.size() >= MAX_MAPPED_FRAMEBUFFERS) {
+            // this barely happens, so waiting for the frames using it is fine
+            device.waitIdle();
+            device.destroy(mapped_framebuffers.front().view);
+            device.destroy(mapped_framebuffers.front().image);
+            mapped_framebuffers.erase(mapped_framebuffers.begin());
+        }
+
+        MappedFramebuffer &created = mapped_framebuffers.emplace_back(MappedFramebuffer{ frame.base.address(), width, height, frame.pitch, mapped_memory, nullptr, nullptr });
+        framebuffer = mapped_framebuffers.end() - 1;
+
+        // the image is as wide as the pitch so its rows match the ones of the framebuffer, the padding is cropped with the uvs
+        vk::StructureChain<vk::ImageCreateInfo, vk::ExternalMemoryImageCreateInfo> image_info{
+            vk::ImageCreateInfo{
+                .imageType = vk::ImageType::e2D,
+                .format = vk::Format::eR8G8B8A8Unorm,
+                .extent = vk::Extent3D{ frame.pitch, height, 1 },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = vk::SampleCountFlagBits::e1,
+                .tiling = vk::ImageTiling::eLinear,
+                .usage = vk::ImageUsageFlagBits::eSampled,
+                .sharingMode = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::ePreinitialized },
+            vk::ExternalMemoryImageCreateInfo{
+                .handleTypes = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT }
+        };
+        vk::Image image = device.createImage(image_info.get());
+
+        const vk::SubresourceLayout layout = device.getImageSubresourceLayout(image, vk::ImageSubresource{ .aspectMask = vk::ImageAspectFlagBits::eColor });
+        const vk::MemoryRequirements requirements = device.getImageMemoryRequirements(image);
+        const bool can_bind = (layout.offset == 0) && (layout.rowPitch == frame.pitch * 4)
+            && (requirements.memoryTypeBits & (1 << mapped_memory->memory_type))
+            && (offset % requirements.alignment == 0) && (offset + requirements.size <= mapped_memory->size);
+        if (!can_bind) {
+            LOG_INFO("The framebuffer at {} can't be sampled from the mapped memory, it is uploaded instead", log_hex(frame.base.address()));
+            device.destroy(image);
+            return nullptr;
+        }
+
+        device.bindImageMemory(image, mapped_memory->memory, offset);
+
+        vk::ImageViewCreateInfo view_info{
+            .image = image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .components = vkutil::default_comp_mapping,
+            .subresourceRange = vkutil::color_subresource_range
+        };
+        created.image = image;
+        created.view = device.createImageView(view_info);
+
+        // the image is only ever in the general layout, the content written by the CPU is made visible by each submission
+        vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eHostWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = vk::ImageLayout::ePreinitialized,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = vkutil::color_subresource_range
+        };
+        screen_renderer.current_cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eHost,
+            vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barrier);
+    }
+
+    if (!framebuffer->view)
+        return nullptr;
+
+    uvs = { 0.0f, 0.0f, static_cast<float>(width) / frame.pitch, 1.0f };
+    texture_size = { static_cast<float>(frame.pitch), static_cast<float>(height) };
+    return framebuffer->view;
 }
 
 int VKState::get_max_anisotropic_filtering() {
     return static_cast<int>(physical_device_properties.limits.maxSamplerAnisotropy);
 }
 
+bool VKState::supports_gpu_timing() const {
+    // the timestamps are written on the general queue
+    return physical_device_properties.limits.timestampComputeAndGraphics;
+}
+
 void VKState::set_anisotropic_filtering(int anisotropic_filtering) {
     texture_cache.anisotropic_filtering = anisotropic_filtering;
 }
@@ -693,14 +939,32 @@ std::vector<std::string> VKState::get_gpu_list() {
 void VKState::precompile_shader(const ShadersHash &hash) {
     Sha256Hash empty_hash{};
     if (hash.vert != empty_hash) {
-        pipeline_cache.precompile_shader(hash.vert);
+        pipeline_cache.precompile_shader_async(hash.vert);
     }
     if (hash.frag != empty_hash) {
-        pipeline_cache.precompile_shader(hash.frag);
+        pipeline_cache.precompile_shader_async(hash.frag);
     }
 
-    programs_count_pre_compiled++;
-    LOG_INFO("Program Compiled {}/{}", programs_count_pre_compiled, shaders_cache_hashs.size());
+    precompiling_programs.push_back(hash);
+}
+
+bool VKState::update_precompiled_shaders() {
+    pipeline_cache.collect_precompiled_shaders();
+
+    std::erase_if(precompiling_programs, [&](const ShadersHash &hash) {
+        if (pipeline_cache.is_shader_precompiling(hash.vert) || pipeline_cache.is_shader_precompiling(hash.frag))
+            return false;
+
+        programs_count_pre_compiled++;
+        LOG_INFO("Program Compiled {}/{}", programs_count_pre_compiled, shaders_cache_hashs.size());
+        return true;
+    });
+
+    return precompiling_programs.empty();
+}
+
+void VKState::prewarm_pipelines() {
+    pipeline_cache.prewarm_pipelines();
 }
 
 void VKState::preclose_action() {
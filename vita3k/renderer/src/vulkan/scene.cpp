@@ -18,6 +18,7 @@
 #include <renderer/vulkan/functions.h>
 
 #include <gxm/functions.h>
+#include <renderer/functions.h>
 #include <renderer/vulkan/gxm_to_vulkan.h>
 
 #include <config/state.h>
@@ -26,6 +27,11 @@
 #include <util/align.h>
 #include <util/log.h>
 
+#include <xxh3.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace renderer::vulkan {
 
 void set_uniform_buffer(VKContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data) {
@@ -45,29 +51,88 @@ void set_uniform_buffer(VKContext &context, const ShaderProgram *program, const
         const uint32_t data_size_upload = std::min<uint32_t>(size, program->uniform_buffer_sizes.at(block_num) * 4);
         const uint32_t offset_start_upload = offset * 4;
 
-        if (vertex_shader) {
-            if (!context.vertex_uniform_storage_allocated) {
-                // Allocate a region for it. Don't worry though, when the shader program is changed
-                context.vertex_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-                context.vertex_uniform_storage_allocated = true;
-            }
+        std::vector<uint8_t> &staging = vertex_shader ? context.vertex_uniform_staging : context.fragment_uniform_staging;
+        const size_t staging_size = std::max<size_t>(program->max_total_uniform_buffer_storage * 4, offset_start_upload + data_size_upload);
+        if (staging.size() < staging_size)
+            staging.resize(staging_size);
 
-            context.vertex_uniform_stream_ring_buffer.copy(context.prerender_cmd, data_size_upload, data, offset_start_upload);
-        } else {
-            if (!context.fragment_uniform_storage_allocated) {
-                // Allocate a region for it. Don't worry though, when the shader program is changed
-                context.fragment_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-                context.fragment_uniform_storage_allocated = true;
-            }
+        // The game sets its uniform buffers before each draw, most of the time with the same content
+        if (std::memcmp(staging.data() + offset_start_upload, data, data_size_upload) != 0) {
+            std::memcpy(staging.data() + offset_start_upload, data, data_size_upload);
+
+            if (vertex_shader)
+                context.vertex_uniform_upload.dirty = true;
+            else
+                context.fragment_uniform_upload.dirty = true;
+        }
+    }
+}
+
+// copy the staged uniforms to the ring buffer, unless the previous copy has the same content and is still in the ring buffer
+static void upload_uniform_staging(vkutil::HostRingBuffer &ring_buffer, std::vector<uint8_t> &staging, UniformUpload &upload, vk::CommandBuffer cmd_buffer, const uint32_t size) {
+    if (size == 0)
+        return;
+
+    if (upload.dirty || upload.size != size || upload.wrap_count != ring_buffer.wrap_count) {
+        if (staging.size() < size)
+            staging.resize(size);
+
+        ring_buffer.allocate(cmd_buffer, size, staging.data());
+        upload = UniformUpload{
+            .dirty = false,
+            .size = size,
+            .offset = ring_buffer.data_offset,
+            .wrap_count = ring_buffer.wrap_count
+        };
+    }
+
+    // the descriptors are bound with the offset of the last allocation
+    ring_buffer.data_offset = upload.offset;
+}
 
-            context.fragment_uniform_stream_ring_buffer.copy(context.prerender_cmd, data_size_upload, data, offset_start_upload);
+// add the GPU time of the scenes of a frame which is done to the total
+static void read_frame_gpu_time(VKContext &context, FrameObject &frame) {
+    std::vector<uint64_t> timestamps(frame.timestamp_count);
+    const vk::Result result = context.state.device.getQueryPoolResults(frame.timestamp_pool, 0, frame.timestamp_count,
+        timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    frame.timestamp_count = 0;
+    if (result != vk::Result::eSuccess)
+        return;
+
+    uint64_t ticks = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> intervals;
+    intervals.reserve(timestamps.size() / 2);
+    for (size_t i = 0; i + 1 < timestamps.size(); i += 2) {
+        if (timestamps[i + 1] > timestamps[i]) {
+            ticks += timestamps[i + 1] - timestamps[i];
+            intervals.emplace_back(timestamps[i], timestamps[i + 1]);
         }
     }
+
+    // the scenes can run at the same time on the GPU, the busy time is the one of the union of their intervals
+    std::sort(intervals.begin(), intervals.end());
+    uint64_t busy_ticks = 0;
+    uint64_t busy_end = 0;
+    for (const auto &[start, end] : intervals) {
+        if (end <= busy_end)
+            continue;
+        busy_ticks += end - std::max(start, busy_end);
+        busy_end = end;
+    }
+
+    const double period = context.state.physical_device_properties.limits.timestampPeriod;
+    context.state.gpu_time_ns += static_cast<uint64_t>(static_cast<double>(ticks) * period);
+    context.state.gpu_busy_ns += static_cast<uint64_t>(static_cast<double>(busy_ticks) * period);
+    context.state.gpu_scene_count += timestamps.size() / 2;
 }
 
 void new_frame(VKContext &context) {
+    context.flush_pending_scene();
+    // the wait thread must get the notifications of this frame before it is done
+    context.flush_submissions();
+
     if (context.state.features.support_memory_mapping) {
-        FrameDoneRequest request = { context.frame_timestamp };
+        FrameDoneRequest request = { context.frame_timestamp, context.scene_timeline_value };
         context.request_queue.push(request);
     }
 
@@ -104,36 +169,101 @@ void new_frame(VKContext &context) {
         device.resetFences(frame.rendered_fences);
         frame.rendered_fences.clear();
     }
+    frame.transfer_fence_idx = 0;
+
+    // the scenes of the previous use of this frame object are done
+    if (frame.timestamp_count > 0)
+        read_frame_gpu_time(context, frame);
 
     device.resetCommandPool(frame.prerender_pool);
     device.resetCommandPool(frame.render_pool);
+    if (frame.transfer_pool)
+        device.resetCommandPool(frame.transfer_pool);
     device.resetDescriptorPool(frame.descriptor_pool);
+    frame.texture_descriptor_sets.clear();
 
     // deferred destruction of the objects
     frame.destroy_queue.destroy_objects();
+    // the memory released by the destruction is now part of the usage, evictions are added to the queue of this frame
+    context.state.memory_budget.new_frame(context.frame_timestamp, context.scene_timestamp);
+    renderer::texture::publish_frame_stats(context.state.texture_cache, context.state);
 
     context.last_vert_texture_count = ~0;
     context.last_frag_texture_count = ~0;
 
+    context.vertex_stream_uploads.clear();
+#ifdef __APPLE__
+    context.restrided_stream_uploads.clear();
+#endif
+    context.index_stream_uploads.clear();
+#ifdef __APPLE__
+    // only keep the conversions of a few frames worth of draws
+    if (context.triangle_fan_indices.size() > 4096)
+        context.triangle_fan_indices.clear();
+#endif
+
     frame.frame_timestamp = context.frame_timestamp;
 }
 
-#ifdef __APPLE__
-// restride vertex attribute binding strides to multiple of 4
-// needed for metal because it only allows multiples of 4.
-void restride_stream(GXMStreamInfo &stream, uint32_t old_stride) {
-    const uint32_t new_stride = align(old_stride, 4);
-    const uint32_t nb_vertex_input = ((stream.size + old_stride - 1) / old_stride);
-
-    uint8_t *new_data = new uint8_t[nb_vertex_input * new_stride];
-    for (uint32_t i = 0; i < nb_vertex_input; i++) {
-        memcpy(new_data + new_stride * i, stream.data + old_stride * i, old_stride);
+size_t TextureDescriptorKeyHash::operator()(const TextureDescriptorKey &key) const {
+    std::array<uint64_t, 1 + 2 * 16> handles;
+    vk::DescriptorSetLayout layout = key.layout;
+    handles[0] = vkutil::to_u64(layout);
+    for (uint16_t i = 0; i < key.texture_count; i++) {
+        vk::Sampler sampler = key.textures[i].sampler;
+        vk::ImageView view = key.textures[i].imageView;
+        handles[1 + 2 * i] = vkutil::to_u64(sampler);
+        handles[2 + 2 * i] = vkutil::to_u64(view);
     }
 
-    stream.size = nb_vertex_input * new_stride;
-    stream.data = new_data;
+    return XXH_INLINE_XXH3_64bits(handles.data(), (1 + 2 * key.texture_count) * sizeof(uint64_t));
+}
+
+// return a descriptor set with these textures, it is only allocated and written the first time they are used in the frame
+static vk::DescriptorSet get_texture_descriptor_set(VKContext &context, vk::DescriptorSetLayout layout, const vk::DescriptorImageInfo *textures, const uint16_t texture_count) {
+    VKState &state = context.state;
+
+    TextureDescriptorKey key{
+        .layout = layout,
+        .texture_count = texture_count
+    };
+    // some default sampler in case a slot has never been set and we read a slot with higher idx
+    const vk::DescriptorImageInfo default_image_info{
+        .sampler = state.default_image.sampler,
+        .imageView = state.default_image.view,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+    };
+    for (uint16_t i = 0; i < texture_count; i++)
+        key.textures[i] = textures[i].sampler ? textures[i] : default_image_info;
+
+    FrameObject &frame = context.frame();
+    auto it = frame.texture_descriptor_sets.find(key);
+    if (it != frame.texture_descriptor_sets.end())
+        return it->second;
+
+    const vk::DescriptorSetAllocateInfo descr_set_info{
+        .descriptorPool = frame.descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout
+    };
+    const vk::DescriptorSet descriptor_set = state.device.allocateDescriptorSets(descr_set_info)[0];
+
+    // bind textures
+    std::array<vk::WriteDescriptorSet, 16> write_descrs;
+    for (uint32_t i = 0; i < texture_count; i++) {
+        write_descrs[i] = vk::WriteDescriptorSet{
+            .dstSet = descriptor_set,
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        };
+        write_descrs[i].setImageInfo(key.textures[i]);
+    }
+    state.device.updateDescriptorSets(texture_count, write_descrs.data(), 0, nullptr);
+
+    frame.texture_descriptor_sets.emplace(key, descriptor_set);
+    return descriptor_set;
 }
-#endif
 
 static void draw_bind_descriptors(VKContext &context, MemState &mem) {
     VKState &state = context.state;
@@ -158,70 +288,15 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
     context.last_vert_texture_count = vertex_textures_count;
     context.last_frag_texture_count = fragment_texture_count;
 
-    {
-        vk::DescriptorSetAllocateInfo descr_set_info{
-            .descriptorPool = context.frame().descriptor_pool
-        };
-        std::vector<vk::DescriptorSetLayout> layouts;
-        if (need_vert_descr)
-            layouts.push_back(state.pipeline_cache.vertex_textures_layout[vertex_textures_count]);
-        if (need_frag_descr)
-            layouts.push_back(state.pipeline_cache.fragment_textures_layout[fragment_texture_count]);
-
-        std::vector<vk::DescriptorSet> sets;
-        if (!layouts.empty()) {
-            descr_set_info.setSetLayouts(layouts);
-            sets = state.device.allocateDescriptorSets(descr_set_info);
-        }
+    if (need_vert_descr)
+        context.last_vert_texture_descriptor = get_texture_descriptor_set(context, state.pipeline_cache.vertex_textures_layout[vertex_textures_count],
+            context.vertex_textures, vertex_textures_count);
+    descriptors[2] = context.last_vert_texture_descriptor;
 
-        int set_idx = 0;
-        if (need_vert_descr) {
-            context.last_vert_texture_descriptor = sets[set_idx++];
-        }
-        descriptors[2] = context.last_vert_texture_descriptor;
-
-        if (need_frag_descr) {
-            context.last_frag_texture_descriptor = sets[set_idx++];
-        }
-        descriptors[3] = context.last_frag_texture_descriptor;
-    }
-
-    // bind textures
-    std::array<vk::WriteDescriptorSet, 16> write_descrs;
-    // some default sampler in case a slot has never been set and we read a slot with higher idx
-    vk::DescriptorImageInfo default_image_info{
-        .sampler = context.state.default_image.sampler,
-        .imageView = context.state.default_image.view,
-        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
-    };
-
-    // vertex
-    if (need_vert_descr) {
-        for (uint32_t i = 0; i < vertex_textures_count; i++) {
-            write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[2],
-                .dstBinding = i,
-                .dstArrayElement = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            };
-            write_descrs[i].setImageInfo(context.vertex_textures[i].sampler ? context.vertex_textures[i] : default_image_info);
-        }
-        state.device.updateDescriptorSets(vertex_textures_count, write_descrs.data(), 0, nullptr);
-    }
-
-    // fragment
-    if (need_frag_descr) {
-        for (uint32_t i = 0; i < fragment_texture_count; i++) {
-            write_descrs[i] = vk::WriteDescriptorSet{
-                .dstSet = descriptors[3],
-                .dstBinding = i,
-                .dstArrayElement = 0,
-                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            };
-            write_descrs[i].setImageInfo(context.fragment_textures[i].sampler ? context.fragment_textures[i] : default_image_info);
-        }
-        state.device.updateDescriptorSets(fragment_texture_count, write_descrs.data(), 0, nullptr);
-    }
+    if (need_frag_descr)
+        context.last_frag_texture_descriptor = get_texture_descriptor_set(context, state.pipeline_cache.fragment_textures_layout[fragment_texture_count],
+            context.fragment_textures, fragment_texture_count);
+    descriptors[3] = context.last_frag_texture_descriptor;
 
     const uint32_t dynamic_offset_count = state.features.support_memory_mapping ? 2U : 4U;
     const uint32_t dynamic_offsets[] = {
@@ -239,6 +314,53 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
         descriptors.size(), descriptors.data(), dynamic_offset_count, dynamic_offsets);
 }
 
+// copy the stream to the ring buffer and return its offset, unless the same content at the same location
+// has already been copied during this frame and is still in the ring buffer
+static uint32_t upload_stream(vkutil::HostRingBuffer &ring_buffer, StreamUploads &uploads, vk::CommandBuffer cmd_buffer, const void *data, const uint32_t size) {
+    const uint64_t content_hash = XXH_INLINE_XXH3_64bits(data, size);
+    auto [it, inserted] = uploads.try_emplace(StreamUploadKey{ data, size });
+    StreamUpload &upload = it->second;
+
+    if (inserted || upload.content_hash != content_hash || upload.wrap_count != ring_buffer.wrap_count) {
+        ring_buffer.allocate(cmd_buffer, size, data);
+        upload = StreamUpload{
+            .content_hash = content_hash,
+            .offset = ring_buffer.data_offset,
+            .wrap_count = ring_buffer.wrap_count
+        };
+    }
+
+    return upload.offset;
+}
+
+#ifdef __APPLE__
+// copy the stream to the ring buffer with its stride aligned to 4 bytes and return its offset, needed for metal because it
+// only allows multiples of 4. The vertices are written straight to the ring buffer and only if the stream changed during this frame
+static uint32_t upload_restrided_stream(vkutil::HostRingBuffer &ring_buffer, StreamUploads &uploads, vk::CommandBuffer cmd_buffer, const uint8_t *data, const uint32_t size, const uint32_t old_stride) {
+    const uint64_t content_hash = XXH_INLINE_XXH3_64bits_withSeed(data, size, old_stride);
+    auto [it, inserted] = uploads.try_emplace(StreamUploadKey{ data, size });
+    StreamUpload &upload = it->second;
+
+    if (inserted || upload.content_hash != content_hash || upload.wrap_count != ring_buffer.wrap_count) {
+        const uint32_t new_stride = align(old_stride, 4);
+        const uint32_t vertex_count = (size + old_stride - 1) / old_stride;
+        ring_buffer.allocate(vertex_count * new_stride);
+        for (uint32_t i = 0; i < vertex_count; i++) {
+            const uint32_t vertex_size = std::min(old_stride, size - i * old_stride);
+            ring_buffer.copy(cmd_buffer, vertex_size, data + i * old_stride, i * new_stride);
+        }
+
+        upload = StreamUpload{
+            .content_hash = content_hash,
+            .offset = ring_buffer.data_offset,
+            .wrap_count = ring_buffer.wrap_count
+        };
+    }
+
+    return upload.offset;
+}
+#endif
+
 static void bind_vertex_streams(VKContext &context, MemState &mem) {
     GxmRecordState &state = context.record;
     const SceGxmVertexProgram &vertex_program = *state.vertex_program.get(mem);
@@ -273,29 +395,22 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
 
     for (int i = 0; i < max_stream_idx; i++) {
         if (state.vertex_streams[i].data) {
-#ifdef __APPLE__
-            // Vulkan allows any stride, but Metal only allows multiples of 4.
-            const bool restride = vertex_program.streams[i].stride % 4 != 0;
-            if (restride) {
-                restride_stream(state.vertex_streams[i], vertex_program.streams[i].stride);
-            }
-#endif
-
             if (context.state.features.support_memory_mapping) {
                 auto [buffer, offset] = context.state.get_matching_mapping(state.vertex_streams[i].data);
 
                 context.vertex_stream_offsets[i] = offset;
                 context.vertex_stream_buffers[i] = buffer;
+#ifdef __APPLE__
+            } else if (vertex_program.streams[i].stride % 4 != 0) {
+                // Vulkan allows any stride, but Metal only allows multiples of 4.
+                context.vertex_stream_offsets[i] = upload_restrided_stream(context.vertex_stream_ring_buffer, context.restrided_stream_uploads,
+                    context.prerender_cmd, state.vertex_streams[i].data, state.vertex_streams[i].size, vertex_program.streams[i].stride);
+#endif
             } else {
-                context.vertex_stream_ring_buffer.allocate(context.prerender_cmd, state.vertex_streams[i].size, state.vertex_streams[i].data);
-                context.vertex_stream_offsets[i] = context.vertex_stream_ring_buffer.data_offset;
+                context.vertex_stream_offsets[i] = upload_stream(context.vertex_stream_ring_buffer, context.vertex_stream_uploads,
+                    context.prerender_cmd, state.vertex_streams[i].data, state.vertex_streams[i].size);
             }
 
-#ifdef __APPLE__
-            if (restride) {
-                delete[] state.vertex_streams[i].data;
-            }
-#endif
             state.vertex_streams[i].data = nullptr;
             state.vertex_streams[i].size = 0;
         }
@@ -307,26 +422,36 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
 #ifdef __APPLE__
 // convert indices for triangle fans to indices for a triangle list
 // needed for metal because it does not support a triangle fan implementation
+// the converted indices are cached by source range, they stay valid until the next conversion of the same range
 template <typename T>
-void triangle_fan_to_triangle_list(void *&indices, size_t &count) {
+void triangle_fan_to_triangle_list(VKContext &context, void *&indices, size_t &count) {
     // if N is the number of faces, there are N + 2 indices for triangle fans and 3N indices for triangle list
     if (count < 3)
         // safety check
         return;
 
     const uint32_t nb_triangle = count - 2;
-
-    T *old_indices = reinterpret_cast<T *>(indices);
-    indices = new uint8_t[3 * nb_triangle * sizeof(T)];
-    T *curr_indices = reinterpret_cast<T *>(indices);
-
-    for (uint32_t triangle = 0; triangle < nb_triangle; triangle++) {
-        curr_indices[0] = old_indices[0];
-        curr_indices[1] = old_indices[triangle + 1];
-        curr_indices[2] = old_indices[triangle + 2];
-        curr_indices += 3;
+    const uint32_t source_size = count * sizeof(T);
+    const uint64_t source_hash = XXH_INLINE_XXH3_64bits(indices, source_size);
+
+    auto [it, inserted] = context.triangle_fan_indices.try_emplace(StreamUploadKey{ indices, source_size });
+    ConvertedIndices &converted = it->second;
+    if (inserted || converted.source_hash != source_hash) {
+        converted.source_hash = source_hash;
+        converted.indices.resize(3 * nb_triangle * sizeof(T));
+
+        const T *old_indices = reinterpret_cast<const T *>(indices);
+        T *curr_indices = reinterpret_cast<T *>(converted.indices.data());
+
+        for (uint32_t triangle = 0; triangle < nb_triangle; triangle++) {
+            curr_indices[0] = old_indices[0];
+            curr_indices[1] = old_indices[triangle + 1];
+            curr_indices[2] = old_indices[triangle + 2];
+            curr_indices += 3;
+        }
     }
 
+    indices = converted.indices.data();
     count = 3 * nb_triangle;
 }
 #endif
@@ -334,25 +459,39 @@ void triangle_fan_to_triangle_list(void *&indices, size_t &count) {
 void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format,
     void *indices, size_t count, uint32_t instance_count, MemState &mem, const Config &config) {
 #ifdef __APPLE__
-    bool replaced_indices = (type == SCE_GXM_PRIMITIVE_TRIANGLE_FAN);
     // metal does not support triangle fans
-    if (replaced_indices) {
+    if (type == SCE_GXM_PRIMITIVE_TRIANGLE_FAN) {
         if (format == SCE_GXM_INDEX_FORMAT_U16) {
-            triangle_fan_to_triangle_list<uint16_t>(indices, count);
+            triangle_fan_to_triangle_list<uint16_t>(context, indices, count);
         } else {
-            triangle_fan_to_triangle_list<uint32_t>(indices, count);
+            triangle_fan_to_triangle_list<uint32_t>(context, indices, count);
         }
         type = SCE_GXM_PRIMITIVE_TRIANGLES;
     }
-#else
-    constexpr bool replaced_indices = false;
 #endif
 
+    // the textures of this draw may still be decoded by the worker threads
+    if (context.state.texture_cache.decode_pool)
+        renderer::texture::flush_pending_texture_uploads(context.state.texture_cache);
+
     // do we need to check for a pipeline change?
     if (context.refresh_pipeline || !context.in_renderpass || type != context.last_primitive) {
         context.refresh_pipeline = false;
         context.last_primitive = type;
-        vk::Pipeline new_pipeline = context.state.pipeline_cache.retrieve_pipeline(context, type, mem);
+        vk::Pipeline new_pipeline;
+        {
+            const DrawProfileScope profile_scope(&context.state.draw_profile, DRAW_PROFILE_PIPELINE);
+            new_pipeline = context.state.pipeline_cache.retrieve_pipeline(context, type, mem);
+        }
+
+        if (!new_pipeline) {
+            // the pipeline is still being compiled, skip this draw and look for it again on the next one
+            context.refresh_pipeline = true;
+            context.current_pipeline = nullptr;
+            if (!context.in_renderpass)
+                context.start_render_pass();
+            return;
+        }
 
         if (!context.in_renderpass || new_pipeline != context.current_pipeline) {
             context.current_pipeline = new_pipeline;
@@ -409,6 +548,9 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     shader::RenderFragUniformBlockWithMapping &frag_ublock = context.current_frag_render_info;
 
     frag_ublock.writing_mask = context.record.writing_mask;
+    // the next scenes have to clear the mask again if this draw wrote another value in it
+    if (context.record.is_maskupdate && context.record.writing_mask != context.render_target->mask_value)
+        context.render_target->mask_value = -1.0f;
     frag_ublock.use_raw_image = 0;
     frag_ublock.res_multiplier = context.state.res_multiplier;
     const size_t frag_ublock_size = use_memory_mapping ? sizeof(shader::RenderFragUniformBlockWithMapping) : sizeof(shader::RenderFragUniformBlock);
@@ -418,8 +560,22 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
         memcpy(&context.previous_frag_info, &frag_ublock, frag_ublock_size);
     }
 
-    // create, update and bind descriptors (uniforms and textures)
-    draw_bind_descriptors(context, mem);
+    {
+        const DrawProfileScope profile_scope(&context.state.draw_profile, DRAW_PROFILE_DESCRIPTORS);
+        if (!use_memory_mapping) {
+            const ShaderProgram &vertex_program = *context.record.vertex_program.get(mem)->renderer_data;
+            const ShaderProgram &fragment_program = *context.record.fragment_program.get(mem)->renderer_data;
+            upload_uniform_staging(context.vertex_uniform_stream_ring_buffer, context.vertex_uniform_staging, context.vertex_uniform_upload,
+                context.prerender_cmd, vertex_program.max_total_uniform_buffer_storage * 4);
+            upload_uniform_staging(context.fragment_uniform_stream_ring_buffer, context.fragment_uniform_staging, context.fragment_uniform_upload,
+                context.prerender_cmd, fragment_program.max_total_uniform_buffer_storage * 4);
+        }
+
+        // create, update and bind descriptors (uniforms and textures)
+        draw_bind_descriptors(context, mem);
+    }
+
+    const DrawProfileScope vertex_index_scope(&context.state.draw_profile, DRAW_PROFILE_VERTEX_INDEX);
     // bind the vertex streams
     bind_vertex_streams(context, mem);
 
@@ -433,18 +589,17 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     } else {
         const size_t index_buffer_size = index_size * count;
 
-        context.index_stream_ring_buffer.allocate(context.prerender_cmd, index_buffer_size, indices);
+        const uint32_t index_offset = upload_stream(context.index_stream_ring_buffer, context.index_stream_uploads,
+            context.prerender_cmd, indices, index_buffer_size);
 
-        context.render_cmd.bindIndexBuffer(context.index_stream_ring_buffer.handle(), context.index_stream_ring_buffer.data_offset, index_type);
+        context.render_cmd.bindIndexBuffer(context.index_stream_ring_buffer.handle(), index_offset, index_type);
     }
 
-    context.render_cmd.drawIndexed(count, instance_count, 0, 0, 0);
-
-    if (replaced_indices)
-        delete[] reinterpret_cast<uint8_t *>(indices);
+    // the render pass of a merged scene is ended to upload the textures and transition the surfaces used by this draw
+    if (!context.in_renderpass)
+        context.start_render_pass();
 
-    context.vertex_uniform_storage_allocated = false;
-    context.fragment_uniform_storage_allocated = false;
+    context.render_cmd.drawIndexed(count, instance_count, 0, 0, 0);
 }
 
 } // namespace renderer::vulkan
@@ -19,10 +19,16 @@
 
 #include <SDL_vulkan.h>
 
+#include "renderer/video_capture.h"
 #include "renderer/vulkan/state.h"
 #include "util/log.h"
 #include "vkutil/vkutil.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+
 namespace renderer::vulkan {
 
 struct screen_vertex {
@@ -35,6 +41,44 @@ static constexpr uint32_t screen_vertex_count = 4;
 
 using screen_vertices_t = screen_vertex[screen_vertex_count];
 
+// push constants of fsr_easu.comp and fsr_rcas.comp (which only uses the first one)
+struct FsrConstants {
+    std::array<float, 4> con0;
+    std::array<float, 4> con1;
+    std::array<float, 4> con2;
+    std::array<float, 4> con3;
+};
+
+// same default sharpness as the FSR samples (0 is the sharpest)
+static constexpr float fsr_sharpness = 0.2f;
+// workgroup size of both fsr shaders
+static constexpr uint32_t fsr_group_size = 8;
+
+// viewport with the vita aspect ratio fitting in the window
+static vk::Viewport get_screen_viewport(const vk::Extent2D &extent) {
+    vk::Viewport viewport{
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    const float window_aspect = static_cast<float>(extent.width) / extent.height;
+    const float vita_aspect = static_cast<float>(DEFAULT_RES_WIDTH) / DEFAULT_RES_HEIGHT;
+    if (window_aspect > vita_aspect) {
+        // Window is wide. Pin top and bottom.
+        viewport.width = extent.height * vita_aspect;
+        viewport.height = static_cast<float>(extent.height);
+        viewport.x = (extent.width - viewport.width) / 2.0f;
+        viewport.y = 0.0f;
+    } else {
+        // Window is tall. Pin left and right.
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = extent.width / vita_aspect;
+        viewport.x = 0.0f;
+        viewport.y = (extent.height - viewport.height) / 2;
+    }
+
+    return viewport;
+}
+
 ScreenRenderer::ScreenRenderer(VKState &state)
     : state(state) {
 }
@@ -73,29 +117,44 @@ bool ScreenRenderer::setup(const char *base_path) {
     if (!surface_format_found)
         surface_format = surface_formats[0];
 
-    // preferred order : mailbox > fifo_relaxed > fifo > whatever
-    // the only drawback for mailbox is that it draws more power, so maybe on a portable device use something else
     const auto present_modes = state.physical_device.getSurfacePresentModesKHR(surface);
-    // this one should always be available
-    present_mode = vk::PresentModeKHR::eImmediate;
-    for (const auto &mode : present_modes) {
-        if (mode == vk::PresentModeKHR::eMailbox) {
-            present_mode = mode;
-            break;
-        }
-
-        if (mode == vk::PresentModeKHR::eFifoRelaxed) {
-            present_mode = mode;
-        }
-        if (present_mode == vk::PresentModeKHR::eFifoRelaxed)
-            continue;
+    const auto is_mode_supported = [&](vk::PresentModeKHR mode) {
+        return std::find(present_modes.begin(), present_modes.end(), mode) != present_modes.end();
+    };
 
-        if (mode == vk::PresentModeKHR::eFifo) {
-            present_mode = mode;
+    // fifo is the only one that must be supported
+    present_mode = vk::PresentModeKHR::eFifo;
+    const std::map<std::string, vk::PresentModeKHR> present_mode_names = {
+        { "mailbox", vk::PresentModeKHR::eMailbox },
+        { "fifo", vk::PresentModeKHR::eFifo },
+        { "fifo-relaxed", vk::PresentModeKHR::eFifoRelaxed },
+        { "immediate", vk::PresentModeKHR::eImmediate },
+    };
+    const auto requested_mode = present_mode_names.find(state.present_mode);
+    if (requested_mode != present_mode_names.end() && is_mode_supported(requested_mode->second)) {
+        present_mode = requested_mode->second;
+    } else {
+        if (state.present_mode != "auto")
+            LOG_WARN("Present mode {} is not supported, using the default one", state.present_mode);
+
+        // with v-sync the preferred order is mailbox > fifo_relaxed > fifo
+        // the only drawback for mailbox is that it draws more power, so maybe on a portable device use something else
+        // without v-sync it is immediate > mailbox > fifo
+        const std::array<vk::PresentModeKHR, 3> preferred_modes = state.v_sync
+            ? std::array<vk::PresentModeKHR, 3>{ vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eFifo }
+            : std::array<vk::PresentModeKHR, 3>{ vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+        for (vk::PresentModeKHR mode : preferred_modes) {
+            if (is_mode_supported(mode)) {
+                present_mode = mode;
+                break;
+            }
         }
     }
     LOG_INFO("Present mode: {}", vk::to_string(present_mode));
 
+    if (state.max_frames_in_flight > 0)
+        LOG_INFO("Maximum frames in flight: {}, waiting for their {}", state.max_frames_in_flight, state.support_present_wait ? "presentation" : "rendering");
+
     // part of the swapchain that does not need to be rebuilt every time
     const auto builtin_shaders_path = std::string(base_path) + "shaders-builtin/vulkan/";
     shader_vertex = vkutil::load_shader(state.device, builtin_shaders_path + "render_main.vert.spv");
@@ -112,6 +171,9 @@ bool ScreenRenderer::setup(const char *base_path) {
     if (!create_graphics_pipelines())
         return false;
 
+    if (state.fsr_upscale && !create_fsr_pipelines(builtin_shaders_path))
+        state.fsr_upscale = false;
+
     return true;
 }
 
@@ -128,6 +190,11 @@ void ScreenRenderer::create_swapchain() {
         extent.height = std::clamp<uint32_t>(height, surface_capabilities.minImageExtent.height, surface_capabilities.maxImageExtent.height);
     }
 
+    // the presented images are copied to the capture buffers as they are, only the formats the capture thread reads can be used
+    const bool capture_format = (surface_format.format == vk::Format::eB8G8R8A8Unorm) || (surface_format.format == vk::Format::eB8G8R8A8Srgb)
+        || (surface_format.format == vk::Format::eR8G8B8A8Unorm) || (surface_format.format == vk::Format::eR8G8B8A8Srgb);
+    capture_supported = capture_format && (surface_capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+
     swapchain_size = surface_capabilities.minImageCount + 1;
     if (surface_capabilities.maxImageCount != 0)
         swapchain_size = std::min(swapchain_size, surface_capabilities.maxImageCount);
@@ -141,7 +208,7 @@ void ScreenRenderer::create_swapchain() {
             .imageColorSpace = surface_format.colorSpace,
             .imageExtent = extent,
             .imageArrayLayers = 1,
-            .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+            .imageUsage = capture_supported ? (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc) : vk::ImageUsageFlagBits::eColorAttachment,
             .imageSharingMode = vk::SharingMode::eExclusive,
             .preTransform = surface_capabilities.currentTransform,
             .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
@@ -150,6 +217,8 @@ void ScreenRenderer::create_swapchain() {
         };
 
         swapchain = state.device.createSwapchainKHR(swapchain_info);
+        // the present ids are per swapchain, do not wait for the ones presented to the previous one
+        first_present_id = present_id + 1;
     }
 
     // Get Swapchain Images
@@ -182,9 +251,16 @@ void ScreenRenderer::create_swapchain() {
 
         swapchain_framebuffers[i] = state.device.createFramebuffer(fb_info);
     }
+
+    // nothing to do if this is the first swapchain, create_fsr_pipelines will create them
+    if (fsr_easu_pipeline)
+        create_fsr_images();
 }
 
 void ScreenRenderer::destroy_swapchain() {
+    // the device is idle, all the copies are done
+    release_capture_buffers(0, true);
+
     if (pipeline) {
         state.device.destroy(pipeline);
         pipeline = nullptr;
@@ -202,9 +278,19 @@ void ScreenRenderer::destroy_swapchain() {
         state.device.destroySwapchainKHR(swapchain);
         swapchain = nullptr;
     }
+
+    fsr_upscaled.destroy();
+    fsr_sharpened.destroy();
 }
 
 void ScreenRenderer::cleanup() {
+    if (state.video_capture) {
+        release_capture_buffers(0, true);
+        state.video_capture->wait_idle();
+    }
+    for (CaptureBuffer &capture_buffer : capture_buffers)
+        capture_buffer.buffer.destroy();
+
     for (vk::Framebuffer fb : swapchain_framebuffers)
         state.device.destroy(fb);
 
@@ -214,17 +300,30 @@ void ScreenRenderer::cleanup() {
     state.device.destroy(shader_vertex);
     state.device.destroy(render_pass);
 
+    fsr_upscaled.destroy();
+    fsr_sharpened.destroy();
+    state.device.destroy(fsr_easu_pipeline);
+    state.device.destroy(fsr_rcas_pipeline);
+    state.device.destroy(fsr_pipeline_layout);
+    state.device.destroy(fsr_descriptor_pool);
+    state.device.destroy(fsr_set_layout);
+    state.device.destroy(shader_fsr_easu);
+    state.device.destroy(shader_fsr_rcas);
+
     for (vk::ImageView view : swapchain_views)
         state.device.destroy(view);
     state.device.destroy(swapchain);
 
     state.device.destroy(image_acquired_semaphore);
+    state.device.destroy(present_timestamp_pool);
     state.allocator.destroyBuffer(vao, vao_allocation);
 
     state.instance.destroy(surface);
 }
 
 static constexpr uint64_t next_image_timeout = std::numeric_limits<uint64_t>::max();
+// do not block forever if the presentation engine never displays the frame (the window can be hidden)
+static constexpr uint64_t present_wait_timeout = 100'000'000;
 
 bool ScreenRenderer::acquire_swapchain_image(bool start_render_pass) {
     vk::Result acquire_result = vk::Result::eErrorOutOfDateKHR;
@@ -262,6 +361,8 @@ bool ScreenRenderer::acquire_swapchain_image(bool start_render_pass) {
         return false;
     }
     state.device.resetFences(fences[swapchain_image_idx]);
+    read_present_gpu_time();
+    release_capture_buffers(swapchain_image_idx, false);
 
     // begin the render command
     current_cmd_buffer = command_buffers[swapchain_image_idx];
@@ -274,6 +375,21 @@ bool ScreenRenderer::acquire_swapchain_image(bool start_render_pass) {
         current_cmd_buffer.begin(begin_info);
     }
 
+    if (state.gpu_timing && state.supports_gpu_timing()) {
+        if (!present_timestamp_pool) {
+            vk::QueryPoolCreateInfo query_pool_info{
+                .queryType = vk::QueryType::eTimestamp,
+                .queryCount = static_cast<uint32_t>(2 * fences.size())
+            };
+            present_timestamp_pool = state.device.createQueryPool(query_pool_info);
+            present_timed.assign(fences.size(), false);
+        }
+
+        current_cmd_buffer.resetQueryPool(present_timestamp_pool, 2 * swapchain_image_idx, 2);
+        current_cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, present_timestamp_pool, 2 * swapchain_image_idx);
+        present_timed[swapchain_image_idx] = true;
+    }
+
     if (start_render_pass) {
         vk::RenderPassBeginInfo pass_info{
             .renderPass = render_pass,
@@ -296,29 +412,43 @@ void ScreenRenderer::render(vk::ImageView image_view, vk::ImageLayout layout, st
     if (swapchain_image_idx == ~0 && !acquire_swapchain_image())
         return;
 
+    // only upscale with FSR if the game surface is smaller than the viewport
+    const bool use_fsr = state.fsr_upscale && fsr_upscaled.image
+        && (fsr_upscaled.width > (uvs[2] - uvs[0]) * texture_size.x || fsr_upscaled.height > (uvs[3] - uvs[1]) * texture_size.y);
+    std::array<float, 4> screen_uvs = uvs;
+    if (use_fsr) {
+        upscale_fsr(image_view, layout, uvs, texture_size);
+
+        // render the upscaled image instead
+        image_view = fsr_sharpened.view;
+        layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        screen_uvs = { 0.0f, 0.0f, 1.0f, 1.0f };
+    }
+    const bool use_fxaa = enable_fxaa && !use_fsr;
+
     {
         // if necessary update vao (should not happen often)
-        if (uvs != last_uvs[swapchain_image_idx]) {
+        if (screen_uvs != last_uvs[swapchain_image_idx]) {
             screen_vertices_t vertex_buffer_data = {
                 { { 1.f, -1.f, 0.0f }, { 1.f, 0.f } },
                 { { -1.f, -1.f, 0.0f }, { 0.f, 0.f } },
                 { { 1.f, 1.f, 0.0f }, { 1.f, 1.f } },
                 { { -1.f, 1.f, 0.0f }, { 0.f, 1.f } },
             };
-            vertex_buffer_data[0].uv[0] = uvs[2];
-            vertex_buffer_data[0].uv[1] = uvs[1];
+            vertex_buffer_data[0].uv[0] = screen_uvs[2];
+            vertex_buffer_data[0].uv[1] = screen_uvs[1];
 
-            vertex_buffer_data[1].uv[0] = uvs[0];
-            vertex_buffer_data[1].uv[1] = uvs[1];
+            vertex_buffer_data[1].uv[0] = screen_uvs[0];
+            vertex_buffer_data[1].uv[1] = screen_uvs[1];
 
-            vertex_buffer_data[2].uv[0] = uvs[2];
-            vertex_buffer_data[2].uv[1] = uvs[3];
+            vertex_buffer_data[2].uv[0] = screen_uvs[2];
+            vertex_buffer_data[2].uv[1] = screen_uvs[3];
 
-            vertex_buffer_data[3].uv[0] = uvs[0];
-            vertex_buffer_data[3].uv[1] = uvs[3];
+            vertex_buffer_data[3].uv[0] = screen_uvs[0];
+            vertex_buffer_data[3].uv[1] = screen_uvs[3];
 
             current_cmd_buffer.updateBuffer(vao, swapchain_image_idx * sizeof(screen_vertices_t), sizeof(screen_vertices_t), &vertex_buffer_data);
-            last_uvs[swapchain_image_idx] = uvs;
+            last_uvs[swapchain_image_idx] = screen_uvs;
         }
     }
 
@@ -356,10 +486,10 @@ void ScreenRenderer::render(vk::ImageView image_view, vk::ImageLayout layout, st
         vk::DeviceSize offset = swapchain_image_idx * sizeof(screen_vertices_t);
         current_cmd_buffer.bindVertexBuffers(0, vao, offset);
 
-        current_cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, enable_fxaa ? pipeline_fxaa : pipeline);
+        current_cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, use_fxaa ? pipeline_fxaa : pipeline);
         current_cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, descriptor_sets[swapchain_image_idx], {});
 
-        if (enable_fxaa) {
+        if (use_fxaa) {
             std::array<float, 2> inv_size = { 1 / texture_size.x, 1 / texture_size.y };
             current_cmd_buffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0, 2 * sizeof(float), inv_size.data());
         }
@@ -374,8 +504,15 @@ void ScreenRenderer::swap_window() {
         return;
     }
 
+    // the scenes displayed must be submitted first
+    if (state.context)
+        reinterpret_cast<VKContext *>(state.context)->flush_submissions();
+
     // first submit the command buffer
     current_cmd_buffer.endRenderPass();
+    capture_frame();
+    if (present_timestamp_pool && present_timed[swapchain_image_idx])
+        current_cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, present_timestamp_pool, 2 * swapchain_image_idx + 1);
     current_cmd_buffer.end();
     vk::SubmitInfo submit_info{};
     std::array<vk::Semaphore, 1> wait_semaphores = { image_acquired_semaphore };
@@ -386,6 +523,12 @@ void ScreenRenderer::swap_window() {
     submit_info.setSignalSemaphores(image_ready_semaphore);
     submit_info.setCommandBuffers(current_cmd_buffer);
     state.general_queue.submit(submit_info, fences[swapchain_image_idx]);
+    if (!state.support_present_wait && state.max_frames_in_flight > 0) {
+        // the fence of this image may still be in the list from a previous use
+        const vk::Fence fence = fences[swapchain_image_idx];
+        std::erase(frames_in_flight, fence);
+        frames_in_flight.push_back(fence);
+    }
 
     // then present the surface
     vk::PresentInfoKHR present_info{
@@ -395,6 +538,14 @@ void ScreenRenderer::swap_window() {
         .pSwapchains = &swapchain,
         .pImageIndices = &swapchain_image_idx,
     };
+    vk::PresentIdKHR present_id_info{
+        .swapchainCount = 1,
+        .pPresentIds = &present_id
+    };
+    if (state.support_present_wait) {
+        present_id++;
+        present_info.pNext = &present_id_info;
+    }
     try {
         auto result = state.general_queue.presentKHR(present_info);
         if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR) {
@@ -402,6 +553,8 @@ void ScreenRenderer::swap_window() {
             assert(false);
             return;
         }
+
+        wait_frames_in_flight();
     } catch (vk::OutOfDateKHRError) {
         state.device.waitIdle();
         destroy_swapchain();
@@ -419,6 +572,136 @@ void ScreenRenderer::swap_window() {
     current_cmd_buffer = nullptr;
 }
 
+void ScreenRenderer::capture_frame() {
+    VideoCapture *capture = state.video_capture.get();
+    if (!capture || !capture->wants_frame())
+        return;
+    if (!capture_supported) {
+        LOG_WARN_LIMITED("The swapchain images can't be captured with the format {}", vk::to_string(surface_format.format));
+        return;
+    }
+
+    const auto free_buffer = std::find_if(capture_buffers.begin(), capture_buffers.end(), [](const CaptureBuffer &capture_buffer) {
+        return capture_buffer.state == CaptureBufferState::Free;
+    });
+    if (free_buffer == capture_buffers.end()) {
+        // all the buffers are waiting for the GPU or the encoder
+        if (capture->is_recording())
+            capture->frames_dropped++;
+        return;
+    }
+
+    CaptureBuffer &capture_buffer = *free_buffer;
+    const vk::DeviceSize size = static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+    if (capture_buffer.buffer.size < size || !capture_buffer.buffer.buffer) {
+        capture_buffer.buffer.destroy();
+        capture_buffer.buffer = vkutil::Buffer(state.allocator, size);
+        capture_buffer.buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst, vkutil::vma_readback_alloc);
+    }
+
+    const vk::Image image = swapchain_images[swapchain_image_idx];
+    vk::ImageMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .oldLayout = vk::ImageLayout::ePresentSrcKHR,
+        .newLayout = vk::ImageLayout::eTransferSrcOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    current_cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+    const vk::BufferImageCopy region{
+        .bufferOffset = 0,
+        .bufferRowLength = extent.width,
+        .bufferImageHeight = extent.height,
+        .imageSubresource = vkutil::color_subresource_layer,
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { extent.width, extent.height, 1 }
+    };
+    current_cmd_buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, capture_buffer.buffer.buffer, region);
+
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+    barrier.dstAccessMask = vk::AccessFlags();
+    barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+    current_cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+
+    capture_buffer.width = extent.width;
+    capture_buffer.height = extent.height;
+    capture_buffer.image_idx = swapchain_image_idx;
+    capture_buffer.screenshot = capture->take_screenshot_request();
+    capture_buffer.time = std::chrono::steady_clock::now();
+    capture_buffer.state = CaptureBufferState::Copying;
+}
+
+void ScreenRenderer::release_capture_buffers(uint32_t image_idx, bool all) {
+    for (CaptureBuffer &capture_buffer : capture_buffers) {
+        if (capture_buffer.state != CaptureBufferState::Copying || (!all && capture_buffer.image_idx != image_idx))
+            continue;
+
+        state.allocator.invalidateAllocation(capture_buffer.buffer.allocation, 0, VK_WHOLE_SIZE);
+        capture_buffer.state = CaptureBufferState::Reading;
+        const bool bgra = (surface_format.format == vk::Format::eB8G8R8A8Unorm) || (surface_format.format == vk::Format::eB8G8R8A8Srgb);
+        CaptureFrame frame{
+            .data = static_cast<const uint8_t *>(capture_buffer.buffer.mapped_data),
+            .width = capture_buffer.width,
+            .height = capture_buffer.height,
+            .pitch = capture_buffer.width * 4,
+            .bgra = bgra,
+            .time = capture_buffer.time,
+            .release = [&capture_buffer]() { capture_buffer.state = CaptureBufferState::Free; }
+        };
+        state.video_capture->submit_frame(std::move(frame), capture_buffer.screenshot);
+    }
+}
+
+void ScreenRenderer::read_present_gpu_time() {
+    if (!present_timestamp_pool || !present_timed[swapchain_image_idx])
+        return;
+
+    // the fence of the image was waited for, so the previous frame using it is done
+    present_timed[swapchain_image_idx] = false;
+    std::array<uint64_t, 2> timestamps;
+    const vk::Result result = state.device.getQueryPoolResults(present_timestamp_pool, 2 * swapchain_image_idx, 2,
+        sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess || timestamps[1] <= timestamps[0])
+        return;
+
+    const uint64_t ticks = timestamps[1] - timestamps[0];
+    const uint64_t time_ns = static_cast<uint64_t>(static_cast<double>(ticks) * state.physical_device_properties.limits.timestampPeriod);
+    state.gpu_present_time_ns += time_ns;
+    state.gpu_busy_ns += time_ns;
+}
+
+void ScreenRenderer::wait_frames_in_flight() {
+    const uint64_t max_frames = std::max(state.max_frames_in_flight, 0);
+    if (max_frames == 0)
+        return;
+
+    if (!state.support_present_wait) {
+        // wait for the rendering of the oldest frames, this is the best we can do without knowing when they are displayed
+        while (frames_in_flight.size() > max_frames) {
+            const auto result = state.device.waitForFences(frames_in_flight.front(), VK_TRUE, next_image_timeout);
+            if (result != vk::Result::eSuccess)
+                LOG_ERROR("Could not wait for fences.");
+            frames_in_flight.pop_front();
+        }
+        return;
+    }
+
+    if (present_id < first_present_id + max_frames)
+        return;
+
+    // wait until only max_frames frames are queued for presentation
+    const auto result = state.device.waitForPresentKHR(swapchain, present_id - max_frames, present_wait_timeout);
+    if (result == vk::Result::eSuccess) {
+        // the frame was just displayed, the guest vblanks can be aligned with this time
+        state.host_vblank_time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
 void ScreenRenderer::create_layout_sync() {
     vk::DescriptorSetLayoutBinding sampler_layout_binding{
         .binding = 0,
@@ -551,28 +834,7 @@ vk::Pipeline ScreenRenderer::create_graphics_pipeline_impl(std::array<vk::Pipeli
     vk::PipelineInputAssemblyStateCreateInfo input_assembly{
         .topology = vk::PrimitiveTopology::eTriangleStrip
     };
-    vk::Viewport viewport{
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-    {
-        // compute viewport now
-        const float window_aspect = static_cast<float>(extent.width) / extent.height;
-        const float vita_aspect = static_cast<float>(DEFAULT_RES_WIDTH) / DEFAULT_RES_HEIGHT;
-        if (window_aspect > vita_aspect) {
-            // Window is wide. Pin top and bottom.
-            viewport.width = extent.height * vita_aspect;
-            viewport.height = static_cast<float>(extent.height);
-            viewport.x = (extent.width - viewport.width) / 2.0f;
-            viewport.y = 0.0f;
-        } else {
-            // Window is tall. Pin left and right.
-            viewport.width = static_cast<float>(extent.width);
-            viewport.height = extent.width / vita_aspect;
-            viewport.x = 0.0f;
-            viewport.y = (extent.height - viewport.height) / 2;
-        }
-    }
+    const vk::Viewport viewport = get_screen_viewport(extent);
     vk::Rect2D scissor{
         .offset = { 0, 0 },
         .extent = extent
@@ -665,4 +927,256 @@ void ScreenRenderer::create_surface_image() {
     std::tie(vita_surface_staging, vita_surface_staging_alloc) = state.allocator.createBuffer(buffer_info, vkutil::vma_mapped_alloc, vita_surface_staging_info);
 }
 
-} // namespace renderer::vulkan
\ No newline at end of file
+bool ScreenRenderer::create_fsr_pipelines(const std::string &builtin_shaders_path) {
+    shader_fsr_easu = vkutil::load_shader(state.device, builtin_shaders_path + "fsr_easu.comp.spv");
+    shader_fsr_rcas = vkutil::load_shader(state.device, builtin_shaders_path + "fsr_rcas.comp.spv");
+    if (!shader_fsr_easu || !shader_fsr_rcas) {
+        LOG_WARN("Could not load the FSR shaders, the game surface will not be upscaled");
+        state.device.destroy(shader_fsr_easu);
+        state.device.destroy(shader_fsr_rcas);
+        shader_fsr_easu = nullptr;
+        shader_fsr_rcas = nullptr;
+        return false;
+    }
+
+    // binding 0: input of the pass, binding 1: output of the pass
+    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+        vk::DescriptorSetLayoutBinding{
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+        vk::DescriptorSetLayoutBinding{
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        }
+    };
+    vk::DescriptorSetLayoutCreateInfo descriptor_info{};
+    descriptor_info.setBindings(bindings);
+    fsr_set_layout = state.device.createDescriptorSetLayout(descriptor_info);
+
+    // one easu set for each swapchain image and one rcas set
+    const uint32_t nb_sets = swapchain_size + 1;
+    std::array<vk::DescriptorPoolSize, 2> pool_sizes = {
+        vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, nb_sets },
+        vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, nb_sets }
+    };
+    vk::DescriptorPoolCreateInfo pool_info{
+        .maxSets = nb_sets,
+    };
+    pool_info.setPoolSizes(pool_sizes);
+    fsr_descriptor_pool = state.device.createDescriptorPool(pool_info);
+
+    vk::DescriptorSetAllocateInfo descr_set_info{
+        .descriptorPool = fsr_descriptor_pool,
+    };
+    std::vector<vk::DescriptorSetLayout> descr_set_layouts(nb_sets, fsr_set_layout);
+    descr_set_info.setSetLayouts(descr_set_layouts);
+    fsr_easu_sets = state.device.allocateDescriptorSets(descr_set_info);
+    fsr_rcas_set = fsr_easu_sets.back();
+    fsr_easu_sets.pop_back();
+
+    vk::PushConstantRange push_constant{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(FsrConstants),
+    };
+    vk::PipelineLayoutCreateInfo layout_info{};
+    layout_info.setSetLayouts(fsr_set_layout);
+    layout_info.setPushConstantRanges(push_constant);
+    fsr_pipeline_layout = state.device.createPipelineLayout(layout_info);
+
+    vk::ComputePipelineCreateInfo pipeline_info{
+        .stage = vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eCompute,
+            .module = shader_fsr_easu,
+            .pName = "main" },
+        .layout = fsr_pipeline_layout
+    };
+    auto result = state.device.createComputePipeline(VK_NULL_HANDLE, pipeline_info);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create the FSR easu pipeline.");
+        return false;
+    }
+    fsr_easu_pipeline = result.value;
+
+    pipeline_info.stage.module = shader_fsr_rcas;
+    result = state.device.createComputePipeline(VK_NULL_HANDLE, pipeline_info);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create the FSR rcas pipeline.");
+        return false;
+    }
+    fsr_rcas_pipeline = result.value;
+
+    create_fsr_images();
+
+    LOG_INFO("The game surface will be upscaled with FSR");
+    return true;
+}
+
+void ScreenRenderer::create_fsr_images() {
+    const vk::Viewport viewport = get_screen_viewport(extent);
+    const uint32_t width = std::max(static_cast<uint32_t>(viewport.width + 0.5f), 1U);
+    const uint32_t height = std::max(static_cast<uint32_t>(viewport.height + 0.5f), 1U);
+
+    fsr_upscaled = vkutil::Image(state.allocator, width, height, vk::Format::eR8G8B8A8Unorm);
+    fsr_upscaled.init_image(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+    fsr_sharpened = vkutil::Image(state.allocator, width, height, vk::Format::eR8G8B8A8Unorm);
+    fsr_sharpened.init_image(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+
+    // the output of the easu pass and both bindings of the rcas pass never change
+    vk::DescriptorImageInfo upscaled_storage{
+        .imageView = fsr_upscaled.view,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+    vk::DescriptorImageInfo upscaled_sampled{
+        .sampler = vita_surface_sampler,
+        .imageView = fsr_upscaled.view,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+    vk::DescriptorImageInfo sharpened_storage{
+        .imageView = fsr_sharpened.view,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (vk::DescriptorSet set : fsr_easu_sets) {
+        writes.push_back(vk::WriteDescriptorSet{
+            .dstSet = set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .pImageInfo = &upscaled_storage,
+        });
+    }
+    writes.push_back(vk::WriteDescriptorSet{
+        .dstSet = fsr_rcas_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        .pImageInfo = &upscaled_sampled,
+    });
+    writes.push_back(vk::WriteDescriptorSet{
+        .dstSet = fsr_rcas_set,
+        .dstBinding = 1,
+        .descriptorCount = 1,
+        .descriptorType = vk::DescriptorType::eStorageImage,
+        .pImageInfo = &sharpened_storage,
+    });
+    state.device.updateDescriptorSets(writes, {});
+}
+
+void ScreenRenderer::upscale_fsr(vk::ImageView image_view, vk::ImageLayout layout, const std::array<float, 4> &uvs, const SceFVector2 &texture_size) {
+    vk::CommandBuffer cmd = current_cmd_buffer;
+
+    {
+        vk::DescriptorImageInfo descr_image_info{
+            .sampler = vita_surface_sampler,
+            .imageView = image_view,
+            .imageLayout = layout,
+        };
+        vk::WriteDescriptorSet write_descr{
+            .dstSet = fsr_easu_sets[swapchain_image_idx],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        };
+        write_descr.setImageInfo(descr_image_info);
+        state.device.updateDescriptorSets(write_descr, {});
+    }
+
+    const uint32_t width = fsr_upscaled.width;
+    const uint32_t height = fsr_upscaled.height;
+    const uint32_t group_x = (width + fsr_group_size - 1) / fsr_group_size;
+    const uint32_t group_y = (height + fsr_group_size - 1) / fsr_group_size;
+
+    // the game surface was written by a render pass or a copy, the intermediate images may still
+    // be read by the previous frame and their content can be discarded
+    vk::MemoryBarrier surface_barrier{
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead
+    };
+    vk::ImageMemoryBarrier upscaled_barrier{
+        .srcAccessMask = vk::AccessFlags(),
+        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .oldLayout = vk::ImageLayout::eUndefined,
+        .newLayout = vk::ImageLayout::eGeneral,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = fsr_upscaled.image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), surface_barrier, {}, upscaled_barrier);
+
+    // see FsrEasuConOffset in ffx_fsr1.h, the game surface can be only a part of the texture
+    const float input_width = (uvs[2] - uvs[0]) * texture_size.x;
+    const float input_height = (uvs[3] - uvs[1]) * texture_size.y;
+    const float inv_texture_width = 1.0f / texture_size.x;
+    const float inv_texture_height = 1.0f / texture_size.y;
+    const FsrConstants easu_constants{
+        .con0 = { input_width / width, input_height / height,
+            0.5f * input_width / width - 0.5f + uvs[0] * texture_size.x,
+            0.5f * input_height / height - 0.5f + uvs[1] * texture_size.y },
+        .con1 = { inv_texture_width, inv_texture_height, inv_texture_width, -inv_texture_height },
+        .con2 = { -inv_texture_width, 2.0f * inv_texture_height, inv_texture_width, 2.0f * inv_texture_height },
+        .con3 = { 0.0f, 4.0f * inv_texture_height, 0.0f, 0.0f }
+    };
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, fsr_easu_pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, fsr_pipeline_layout, 0, fsr_easu_sets[swapchain_image_idx], {});
+    cmd.pushConstants(fsr_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(FsrConstants), &easu_constants);
+    cmd.dispatch(group_x, group_y, 1);
+
+    std::array<vk::ImageMemoryBarrier, 2> rcas_barriers;
+    rcas_barriers[0] = vk::ImageMemoryBarrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+        .oldLayout = vk::ImageLayout::eGeneral,
+        .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = fsr_upscaled.image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    rcas_barriers[1] = vk::ImageMemoryBarrier{
+        .srcAccessMask = vk::AccessFlags(),
+        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .oldLayout = vk::ImageLayout::eUndefined,
+        .newLayout = vk::ImageLayout::eGeneral,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = fsr_sharpened.image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+        vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), {}, {}, rcas_barriers);
+
+    // see FsrRcasCon in ffx_fsr1.h
+    const FsrConstants rcas_constants{
+        .con0 = { std::exp2(-fsr_sharpness), 0.0f, 0.0f, 0.0f }
+    };
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, fsr_rcas_pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, fsr_pipeline_layout, 0, fsr_rcas_set, {});
+    cmd.pushConstants(fsr_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(FsrConstants), &rcas_constants);
+    cmd.dispatch(group_x, group_y, 1);
+
+    vk::ImageMemoryBarrier sharpened_barrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+        .oldLayout = vk::ImageLayout::eGeneral,
+        .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = fsr_sharpened.image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+        vk::DependencyFlags(), {}, {}, sharpened_barrier);
+}
+
+} // namespace renderer::vulkan
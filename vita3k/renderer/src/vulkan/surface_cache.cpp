@@ -56,6 +56,12 @@ void VKSurfaceCache::destroy_surface(ColorSurfaceCacheInfo &info) {
     // make sure it is not destroyed twice (if set info.sampled_image.image is the same as info.texture.image)
     info.sampled_image.image = nullptr;
     destroy_queue.add_image(info.sampled_image);
+
+    for (auto &aliased : info.aliased_views) {
+        aliased.image.image = nullptr;
+        destroy_queue.add_image(aliased.image);
+    }
+    info.aliased_views.clear();
     destroy_framebuffers(info.texture.view);
     destroy_queue.add_image(info.texture);
 }
@@ -66,16 +72,124 @@ void VKSurfaceCache::destroy_surface(DepthStencilSurfaceCacheInfo &info) {
 
     for (auto &read_only : info.read_surfaces)
         destroy_queue.add_image(read_only.depth_view);
+    info.read_surfaces.clear();
+
+    // make sure it is not destroyed twice (info.sampled_image.image is the same as info.texture.image)
+    info.sampled_image.image = nullptr;
+    destroy_queue.add_image(info.sampled_image);
 
     destroy_framebuffers(info.texture.view);
     destroy_queue.add_image(info.texture);
 }
 
+// all the formats which can be used by a color surface
+static constexpr vk::Format surface_formats[] = {
+    vk::Format::eR8Unorm,
+    vk::Format::eR8Snorm,
+    vk::Format::eR16Unorm,
+    vk::Format::eR16Snorm,
+    vk::Format::eR16Sfloat,
+    vk::Format::eR32Sfloat,
+    vk::Format::eR8G8Unorm,
+    vk::Format::eR8G8Snorm,
+    vk::Format::eR16G16Unorm,
+    vk::Format::eR16G16Snorm,
+    vk::Format::eR16G16Sfloat,
+    vk::Format::eR32G32Sfloat,
+    vk::Format::eR8G8B8A8Unorm,
+    vk::Format::eR8G8B8A8Srgb,
+    vk::Format::eR8G8B8A8Snorm,
+    vk::Format::eR16G16B16A16Sfloat,
+    vk::Format::eR5G6B5UnormPack16,
+    vk::Format::eB10G11R11UfloatPack32,
+    vk::Format::eE5B9G9R9UfloatPack32,
+    vk::Format::eA1R5G5B5UnormPack16,
+    vk::Format::eR4G4B4A4UnormPack16,
+    vk::Format::eA2R10G10B10UnormPack32,
+};
+
+const std::vector<vk::Format> &VKSurfaceCache::get_compatible_formats(vk::Format format) {
+    auto it = compatible_formats.find(format);
+    if (it != compatible_formats.end())
+        return it->second;
+
+    // uncompressed formats with the same size are in the same compatibility class
+    // the views inherit the usage of the surface, so only keep the formats which support it
+    constexpr vk::FormatFeatureFlags needed_features = vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+    std::vector<vk::Format> formats = { format };
+    for (const vk::Format surface_format : surface_formats) {
+        if (surface_format == format || vk::blockSize(surface_format) != vk::blockSize(format))
+            continue;
+
+        const vk::FormatProperties properties = state.physical_device.getFormatProperties(surface_format);
+        if ((properties.optimalTilingFeatures & needed_features) == needed_features)
+            formats.push_back(surface_format);
+    }
+
+    return compatible_formats.emplace(format, std::move(formats)).first->second;
+}
+
+vkutil::Image &VKSurfaceCache::retrieve_aliased_view(ColorSurfaceCacheInfo &info, vk::Format format, vk::ComponentMapping swizzle) {
+    for (auto &aliased : info.aliased_views) {
+        if (aliased.format == format && aliased.swizzle == swizzle)
+            return aliased.image;
+    }
+
+    AliasedView &aliased = info.aliased_views.emplace_back(AliasedView{
+        .format = format,
+        .swizzle = swizzle,
+        .image = vkutil::Image(state.allocator, info.texture.width, info.texture.height, format) });
+    // the image belongs to the surface
+    aliased.image.destroy_on_deletion = false;
+    // needed in order not to sample from this image during rendering
+    aliased.image.image = info.texture.image;
+
+    vk::ImageViewCreateInfo view_info{
+        .image = info.texture.image,
+        .viewType = vk::ImageViewType::e2D,
+        .format = format,
+        .components = swizzle,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    aliased.image.view = state.device.createImageView(view_info);
+
+    return aliased.image;
+}
+
+std::map<Address, ColorSurfaceCacheInfo>::iterator VKSurfaceCache::erase_color_surface(std::map<Address, ColorSurfaceCacheInfo>::iterator ite) {
+    last_use_color_surface_index.erase(ite->second.last_use_position);
+    return color_surface_textures.erase(ite);
+}
+
+void VKSurfaceCache::mark_color_surface_used(ColorSurfaceCacheInfo &info) {
+    last_use_color_surface_index.splice(last_use_color_surface_index.end(), last_use_color_surface_index, info.last_use_position);
+    info.last_used_scene = reinterpret_cast<VKContext *>(state.context)->scene_timestamp;
+}
+
+void VKSurfaceCache::free_depth_stencil_surface(size_t index) {
+    DepthStencilSurfaceCacheInfo &info = depth_stencil_textures[index];
+    last_use_depth_stencil_surface_index.erase(info.last_use_position);
+
+    auto [begin, end] = depth_stencil_surface_indices.equal_range(info.surface.depthData.address());
+    for (auto it = begin; it != end; ++it) {
+        if (it->second == index) {
+            depth_stencil_surface_indices.erase(it);
+            break;
+        }
+    }
+
+    info.flags = SurfaceCacheInfo::FLAG_FREE;
+    free_depth_stencil_surface_indices.push_back(index);
+}
+
 VKSurfaceCache::VKSurfaceCache(VKState &state)
     : state(state) {
     for (int i = 0; i < MAX_CACHE_SIZE_PER_CONTAINER; i++) {
         depth_stencil_textures[i].flags = SurfaceCacheInfo::FLAG_FREE;
     }
+    // the first free slots are used first
+    for (size_t i = MAX_CACHE_SIZE_PER_CONTAINER; i > 0; i--)
+        free_depth_stencil_surface_indices.push_back(i - 1);
 }
 
 vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t width, uint16_t height, const uint16_t pixel_stride,
@@ -124,7 +238,6 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
 
     if (overlap) {
         ColorSurfaceCacheInfo &info = ite->second;
-        auto used_iterator = std::find(last_use_color_surface_index.begin(), last_use_color_surface_index.end(), ite->first);
 
         if (stored_width) {
             *stored_width = info.original_width;
@@ -159,21 +272,17 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
             // Clear out. We will recreate later
 
             destroy_surface(ite->second);
-            color_surface_textures.erase(ite);
+            erase_color_surface(ite);
             invalidated = true;
         } else if (!addr_in_range_of_cache) {
             if (purpose == SurfaceTextureRetrievePurpose::WRITING) {
                 destroy_surface(ite->second);
-                color_surface_textures.erase(ite);
+                erase_color_surface(ite);
                 invalidated = true;
             }
         } else if (purpose == SurfaceTextureRetrievePurpose::READING) {
             // If we read and it's still in range
-            if (used_iterator != last_use_color_surface_index.end()) {
-                last_use_color_surface_index.erase(used_iterator);
-            }
-
-            last_use_color_surface_index.push_back(ite->first);
+            mark_color_surface_used(info);
 
             if (info.flags & SurfaceCacheInfo::FLAG_DIRTY) {
                 // We can't use this texture sadly :( If it uses for writing of course it will be gud gud
@@ -220,8 +329,12 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
                 }
 
                 const vk::Image color_handle = reinterpret_cast<VKContext *>(state.context)->current_color_attachment->image;
-                // TODO: we can read an srgb image as linear (or the opposite) without having to do a copy
-                if (info.texture.image == color_handle || (start_sourced_line != 0) || (start_x != 0) || (info.width != width) || (info.height != height) || (info.format != base_format)) {
+                const bool is_cropped = (start_sourced_line != 0) || (start_x != 0) || (info.width != width) || (info.height != height);
+                // a surface read with another format of the same size is only viewed with this format
+                const std::vector<vk::Format> &surface_view_formats = get_compatible_formats(info.texture.format);
+                const bool can_alias = (bytes_per_pixel_requested == bytes_per_pixel_in_store)
+                    && std::find(surface_view_formats.begin(), surface_view_formats.end(), vk_format) != surface_view_formats.end();
+                if (info.texture.image == color_handle || is_cropped || (info.format != base_format && !can_alias)) {
                     uint64_t current_time = std::chrono::duration_cast<std::chrono::seconds>(
                         std::chrono::steady_clock::now().time_since_epoch())
                                                 .count();
@@ -253,7 +366,7 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
 
                     // use prerender cmd as we can't copy an image or use pipeline barriers in a render pass
                     VKContext *context = reinterpret_cast<VKContext *>(state.context);
-                    vk::CommandBuffer cmd_buffer = context->prerender_cmd;
+                    vk::CommandBuffer cmd_buffer = context->get_prerender_cmd();
 
                     if (casted == nullptr) {
                         // Try to crop + cast
@@ -283,7 +396,7 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
                         else
                             resulting_swizzle = swizzle;
 
-                        casted->texture.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, resulting_swizzle);
+                        casted->texture.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, resulting_swizzle, vk::ImageCreateFlags(), nullptr, state.memory_budget.get_alloc_info(MemoryCategory::Surfaces));
                         casted->texture.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst);
                     } else {
                         casted->texture.transition_to_discard(cmd_buffer, vkutil::ImageLayout::TransferDst);
@@ -347,7 +460,7 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
                 } else {
                     // we must insert a barrier before reading from the texture
                     VKContext *context = reinterpret_cast<VKContext *>(state.context);
-                    vk::CommandBuffer cmd_buffer = context->prerender_cmd;
+                    vk::CommandBuffer cmd_buffer = context->get_prerender_cmd();
                     vk::ImageMemoryBarrier barrier{
                         .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
                         .dstAccessMask = vk::AccessFlagBits::eShaderRead,
@@ -361,6 +474,13 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
 
                     cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), {}, {}, barrier);
 
+                    if (info.format != base_format) {
+                        // same as for the casted textures, the current swizzle is only taken into consideration when it makes sense
+                        const bool same_components = vk::componentCount(info.texture.format) == vk::componentCount(vk_format);
+                        const vk::ComponentMapping resulting_swizzle = same_components ? vkutil::color_to_texture_swizzle(info.swizzle, swizzle) : swizzle;
+                        return &retrieve_aliased_view(info, vk_format, resulting_swizzle);
+                    }
+
                     if (swizzle == info.swizzle && vk_format == info.texture.format)
                         // we can use the same texture view
                         return &info.texture;
@@ -386,11 +506,7 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
 
         if (!invalidated) {
             if (purpose == SurfaceTextureRetrievePurpose::WRITING) {
-                if (used_iterator != last_use_color_surface_index.end()) {
-                    last_use_color_surface_index.erase(used_iterator);
-                }
-
-                last_use_color_surface_index.push_back(ite->first);
+                mark_color_surface_used(info);
 
                 if (vk_format == info.texture.format) {
                     return &info.texture;
@@ -415,13 +531,15 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
             } else {
                 return nullptr;
             }
-        } else if (used_iterator != last_use_color_surface_index.end()) {
-            last_use_color_surface_index.erase(used_iterator);
         }
     }
 
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
-    ColorSurfaceCacheInfo &info_added = color_surface_textures[key];
+    const auto [added_ite, is_new] = color_surface_textures.try_emplace(key);
+    ColorSurfaceCacheInfo &info_added = added_ite->second;
+    if (is_new)
+        info_added.last_use_position = last_use_color_surface_index.insert(last_use_color_surface_index.end(), key);
+    mark_color_surface_used(info_added);
 
     if (info_added.texture.image) {
         // deferred destruction of the existing surface
@@ -447,22 +565,21 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
     image.format = vk_format;
     image.layout = vkutil::ImageLayout::Undefined;
 
-    // we might have to create a non-srgb/linear view later if this surface is used for presentation
-    const bool need_mutable = (vk_format == vk::Format::eR8G8B8A8Unorm || vk_format == vk::Format::eR8G8B8A8Srgb);
+    // we might have to create a non-srgb/linear view later if this surface is used for presentation,
+    // or a view with another format of the same size if it is read with a different format
+    const std::vector<vk::Format> &view_formats = get_compatible_formats(vk_format);
+    const bool need_mutable = view_formats.size() > 1;
     const vk::ImageCreateFlags image_create_flags = need_mutable ? vk::ImageCreateFlagBits::eMutableFormat : vk::ImageCreateFlags();
     const void *image_info_pNext = nullptr;
+    vk::ImageFormatListCreateInfoKHR image_info_formats{};
     if (support_image_format_specifier && need_mutable) {
-        static const vk::Format view_formats[] = { vk::Format::eR8G8B8A8Unorm, vk::Format::eR8G8B8A8Srgb };
-        static const vk::ImageFormatListCreateInfoKHR image_info_formats{
-            .viewFormatCount = 2,
-            .pViewFormats = view_formats
-        };
+        image_info_formats.setViewFormats(view_formats);
         image_info_pNext = &image_info_formats;
     }
-    image.init_image(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eInputAttachment, vkutil::default_comp_mapping, image_create_flags, image_info_pNext);
+    image.init_image(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eInputAttachment, vkutil::default_comp_mapping, image_create_flags, image_info_pNext, state.memory_budget.get_alloc_info(MemoryCategory::Surfaces));
 
     // do it in the prerender if we read from this texture in the same scene (although this would be useless)
-    vk::CommandBuffer cmd_buffer = context->prerender_cmd;
+    vk::CommandBuffer cmd_buffer = context->get_prerender_cmd();
     // must do a first transition to draw the placeholder color
     image.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst);
 
@@ -471,20 +588,14 @@ vkutil::Image *VKSurfaceCache::retrieve_color_surface_texture_handle(uint16_t wi
     image.transition_to(cmd_buffer, vkutil::ImageLayout::ColorAttachmentReadWrite);
 
     // Now that everything goes well, we can start rearranging
-    if (last_use_color_surface_index.size() >= MAX_CACHE_SIZE_PER_CONTAINER) {
+    if (last_use_color_surface_index.size() > MAX_CACHE_SIZE_PER_CONTAINER) {
         // We have to purge a cache along with framebuffer
-        // So choose the one that is last used
-        const std::uint64_t first_key = last_use_color_surface_index.front();
-        if (first_key != key) {
-            destroy_surface(color_surface_textures[first_key]);
-            color_surface_textures.erase(first_key);
-        }
-
-        last_use_color_surface_index.erase(last_use_color_surface_index.begin());
+        // So choose the one that is last used, the one just added is at the back of the list
+        const auto first_ite = color_surface_textures.find(last_use_color_surface_index.front());
+        destroy_surface(first_ite->second);
+        erase_color_surface(first_ite);
     }
 
-    last_use_color_surface_index.push_back(key);
-
     if (stored_height) {
         *stored_height = height;
     }
@@ -509,21 +620,18 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
     size_t found_index = -1;
 
     // The whole depth stencil struct is reserved for future use
-    for (size_t i = 0; i < depth_stencil_textures.size(); i++) {
-        if ((depth_stencil_textures[i].surface.depthData == surface.depthData) && (packed_ds || depth_stencil_textures[i].surface.stencilData == surface.stencilData)) {
-            found_index = i;
+    auto [begin, end] = depth_stencil_surface_indices.equal_range(surface.depthData.address());
+    for (auto it = begin; it != end; ++it) {
+        if (packed_ds || depth_stencil_textures[it->second].surface.stencilData == surface.stencilData) {
+            found_index = it->second;
             break;
         }
     }
 
     if (found_index != static_cast<std::size_t>(-1)) {
-        auto ite = std::find(last_use_depth_stencil_surface_index.begin(), last_use_depth_stencil_surface_index.end(), found_index);
-        if (ite != last_use_depth_stencil_surface_index.end()) {
-            last_use_depth_stencil_surface_index.erase(ite);
-            last_use_depth_stencil_surface_index.push_back(found_index);
-        }
-
         DepthStencilSurfaceCacheInfo &cached_info = depth_stencil_textures[found_index];
+        last_use_depth_stencil_surface_index.splice(last_use_depth_stencil_surface_index.end(), last_use_depth_stencil_surface_index, cached_info.last_use_position);
+
         bool need_remake = false;
         if (cached_info.width < width) {
             if (is_reading)
@@ -540,10 +648,47 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
         }
 
         if (!need_remake) {
-            if (!is_reading)
+            VKContext *context = reinterpret_cast<VKContext *>(state.context);
+            const uint64_t scene_timestamp = context->scene_timestamp;
+
+            if (!is_reading) {
+                // it was sampled directly by a previous scene
+                if (cached_info.texture.layout != vkutil::ImageLayout::DepthStencilAttachment)
+                    cached_info.texture.transition_to(context->get_prerender_cmd(), vkutil::ImageLayout::DepthStencilAttachment, vkutil::ds_subresource_range);
+                cached_info.last_write_scene = scene_timestamp;
                 return &cached_info.texture;
+            }
 
-            const uint64_t scene_timestamp = reinterpret_cast<VKContext *>(state.context)->scene_timestamp;
+            // the scene doesn't render to this depth stencil, it can be sampled as it is
+            // otherwise the copy keeps the content from before the scene, like the memory read by the shaders on the Vita
+            if (cached_info.last_write_scene != scene_timestamp && cached_info.width == width && cached_info.height == height) {
+                vkutil::Image &sampled_image = cached_info.sampled_image;
+                if (!sampled_image.view) {
+                    vk::ImageSubresourceRange range = vkutil::ds_subresource_range;
+                    range.aspectMask = vk::ImageAspectFlagBits::eDepth;
+
+                    // do not destroy multiple times
+                    sampled_image.destroy_on_deletion = false;
+                    sampled_image.image = cached_info.texture.image;
+                    sampled_image.width = width;
+                    sampled_image.height = height;
+                    sampled_image.format = vk::Format::eD32SfloatS8Uint;
+                    vk::ImageViewCreateInfo view_info{
+                        .image = cached_info.texture.image,
+                        .viewType = vk::ImageViewType::e2D,
+                        .format = vk::Format::eD32SfloatS8Uint,
+                        .components = {},
+                        .subresourceRange = range
+                    };
+                    sampled_image.view = state.device.createImageView(view_info);
+                }
+
+                // use prerender cmd as we can't use pipeline barriers in a render pass
+                if (cached_info.texture.layout != vkutil::ImageLayout::DepthReadOnly)
+                    cached_info.texture.transition_to(context->get_prerender_cmd(), vkutil::ImageLayout::DepthReadOnly, vkutil::ds_subresource_range);
+                sampled_image.layout = cached_info.texture.layout;
+                return &sampled_image;
+            }
 
             int read_surface_idx = -1;
             for (int i = 0; i < cached_info.read_surfaces.size(); i++) {
@@ -562,7 +707,7 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
                     .depth_view = vkutil::Image(state.allocator, width, height, vk::Format::eD32SfloatS8Uint),
                     .scene_timestamp = 0
                 };
-                read_only.depth_view.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+                read_only.depth_view.init_image(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vkutil::default_comp_mapping, vk::ImageCreateFlags(), nullptr, state.memory_budget.get_alloc_info(MemoryCategory::DepthStencil));
                 // we want a texture view with only the depth aspect bit
                 // TODO: not efficient
                 state.device.destroy(read_only.depth_view.view);
@@ -580,15 +725,15 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
 
             DepthSurfaceView &read_only = cached_info.read_surfaces[read_surface_idx];
 
-            // copy the depth stencil only once per scene
-            if (read_only.scene_timestamp == scene_timestamp)
+            // copy the depth stencil at most once per scene, and only if it was rendered to since the last copy
+            const bool copied = read_only.scene_timestamp != 0;
+            if (read_only.scene_timestamp == scene_timestamp || (copied && cached_info.last_write_scene < read_only.scene_timestamp))
                 return &read_only.depth_view;
 
             read_only.scene_timestamp = scene_timestamp;
 
             // use prerender cmd as we can't copy an image or use pipeline barriers in a render pass
-            VKContext *context = reinterpret_cast<VKContext *>(state.context);
-            vk::CommandBuffer cmd_buffer = context->prerender_cmd;
+            vk::CommandBuffer cmd_buffer = context->get_prerender_cmd();
 
             read_only.depth_view.transition_to_discard(cmd_buffer, vkutil::ImageLayout::TransferDst, vkutil::ds_subresource_range);
 
@@ -617,30 +762,18 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
 
     // Now that everything goes well, we can start rearranging
     // Almost carbon copy but still too specific
-    if (last_use_depth_stencil_surface_index.size() >= MAX_CACHE_SIZE_PER_CONTAINER) {
-        // We have to purge a cache along with framebuffer
-        // So choose the one that is last used
-        const std::size_t index = last_use_depth_stencil_surface_index.front();
-
-        last_use_depth_stencil_surface_index.erase(last_use_depth_stencil_surface_index.begin());
-        depth_stencil_textures[index].flags = SurfaceCacheInfo::FLAG_FREE;
-
-        found_index = index;
-    }
-
     if (found_index == static_cast<std::size_t>(-1)) {
-        // Still nowhere to found a free slot? We can search maybe
-        for (std::size_t i = 0; i < depth_stencil_textures.size(); i++) {
-            if (depth_stencil_textures[i].flags & SurfaceCacheInfo::FLAG_FREE) {
-                found_index = i;
-                break;
-            }
+        if (free_depth_stencil_surface_indices.empty()) {
+            // We have to purge a cache along with framebuffer
+            // So choose the one that is last used
+            free_depth_stencil_surface(last_use_depth_stencil_surface_index.front());
         }
-    }
 
-    if (found_index == -1) {
-        LOG_ERROR("No free depth stencil texture cache slot!");
-        return nullptr;
+        found_index = free_depth_stencil_surface_indices.back();
+        free_depth_stencil_surface_indices.pop_back();
+
+        depth_stencil_textures[found_index].last_use_position = last_use_depth_stencil_surface_index.insert(last_use_depth_stencil_surface_index.end(), found_index);
+        depth_stencil_surface_indices.emplace(surface.depthData.address(), found_index);
     }
 
     if (depth_stencil_textures[found_index].texture.image) {
@@ -648,24 +781,24 @@ vkutil::Image *VKSurfaceCache::retrieve_depth_stencil_texture_handle(const MemSt
         destroy_surface(depth_stencil_textures[found_index]);
     }
 
-    last_use_depth_stencil_surface_index.push_back(found_index);
     depth_stencil_textures[found_index].flags = 0;
     depth_stencil_textures[found_index].surface = surface;
     depth_stencil_textures[found_index].width = width;
     depth_stencil_textures[found_index].height = height;
+    depth_stencil_textures[found_index].last_write_scene = reinterpret_cast<VKContext *>(state.context)->scene_timestamp;
 
     vkutil::Image &image = depth_stencil_textures[found_index].texture;
 
     // use prerender cmd in case we read from the depth buffer (although I really doubt this could happen)
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
-    vk::CommandBuffer cmd_buffer = context->prerender_cmd;
+    vk::CommandBuffer cmd_buffer = context->get_prerender_cmd();
 
     image.allocator = state.allocator;
     image.width = width;
     image.height = height;
     image.format = vk::Format::eD32SfloatS8Uint;
     image.layout = vkutil::ImageLayout::Undefined;
-    image.init_image(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc);
+    image.init_image(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc, vkutil::default_comp_mapping, vk::ImageCreateFlags(), nullptr, state.memory_budget.get_alloc_info(MemoryCategory::DepthStencil));
 
     image.transition_to(cmd_buffer, vkutil::ImageLayout::TransferDst, vkutil::ds_subresource_range);
     vk::ClearDepthStencilValue clear_value{
@@ -748,6 +881,79 @@ void VKSurfaceCache::destroy_associated_framebuffers(const VKRenderTarget *rende
     destroy_framebuffers(render_target->depthstencil.view);
 }
 
+ColorSurfaceCacheInfo *VKSurfaceCache::retrieve_color_surface_for_transfer(Address address, int32_t stride, uint32_t bytes_per_pixel,
+    uint32_t width, uint32_t height, uint32_t &x, uint32_t &y) {
+    // get closest surface with an address below address
+    auto ite = color_surface_textures.upper_bound(address);
+    if (ite == color_surface_textures.begin())
+        return nullptr;
+    ite--;
+
+    ColorSurfaceCacheInfo &info = ite->second;
+    if (info.data.address() + info.total_bytes <= address)
+        // they do not overlap
+        return nullptr;
+
+    // the transfer must see the memory the same way as the surface
+    const uint32_t surface_bytes_per_pixel = static_cast<uint32_t>(gxm::bits_per_pixel(info.format) >> 3);
+    const int32_t surface_stride = static_cast<int32_t>(info.pixel_stride * surface_bytes_per_pixel);
+    if (surface_bytes_per_pixel != bytes_per_pixel || surface_stride != stride || vk::blockSize(info.texture.format) != bytes_per_pixel)
+        return nullptr;
+
+    const uint32_t data_delta = address - ite->first;
+    const uint32_t row_delta = data_delta % surface_stride;
+    if (row_delta % bytes_per_pixel != 0)
+        return nullptr;
+
+    x = row_delta / bytes_per_pixel;
+    y = data_delta / surface_stride;
+    if (x + width > info.original_width || y + height > info.original_height)
+        return nullptr;
+
+    mark_color_surface_used(info);
+    return &info;
+}
+
+size_t VKSurfaceCache::release_casted_textures(uint64_t keep_since) {
+    VKContext *context = reinterpret_cast<VKContext *>(state.context);
+    vkutil::DestroyQueue &destroy_queue = context->frame().destroy_queue;
+
+    size_t released = 0;
+    for (auto &[address, info] : color_surface_textures) {
+        std::erase_if(info.casted_textures, [&](CastedTexture &casted) {
+            if (casted.scene_timestamp >= keep_since)
+                return false;
+
+            released += state.allocator.getAllocationInfo(casted.texture.allocation).size;
+            destroy_queue.add_buffer(casted.transition_buffer);
+            destroy_queue.add_image(casted.texture);
+            return true;
+        });
+    }
+
+    return released;
+}
+
+size_t VKSurfaceCache::evict_color_surfaces(uint64_t keep_since, size_t size) {
+    size_t released = 0;
+    while (released < size && !last_use_color_surface_index.empty()) {
+        const auto ite = color_surface_textures.find(last_use_color_surface_index.front());
+        ColorSurfaceCacheInfo &info = ite->second;
+        if (info.last_used_scene >= keep_since)
+            // all the other surfaces were used more recently
+            break;
+
+        released += state.allocator.getAllocationInfo(info.texture.allocation).size;
+        for (const auto &casted : info.casted_textures)
+            released += state.allocator.getAllocationInfo(casted.texture.allocation).size;
+
+        destroy_surface(info);
+        erase_color_surface(ite);
+    }
+
+    return released;
+}
+
 vk::ImageView VKSurfaceCache::sourcing_color_surface_for_presentation(Ptr<const void> address, uint32_t width, uint32_t height, const std::uint32_t pitch, std::array<float, 4> &uvs, const int res_multiplier, SceFVector2 &texture_size) {
     // get closest surface with an address below address
     auto ite = color_surface_textures.upper_bound(address.address());
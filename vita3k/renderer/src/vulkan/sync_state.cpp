@@ -106,11 +106,16 @@ void sync_mask(VKContext &context, const MemState &mem) {
     auto control = context.record.depth_stencil_surface.control.content;
     float initial_val = (control & SceGxmDepthStencilControl::mask_bit) ? 1.0f : 0.0f;
 
+    // no mask update changed it since it was cleared with this value
+    if (context.render_target->mask_value == initial_val)
+        return;
+
     std::array<float, 4> clear_bytes = { initial_val, initial_val, initial_val, initial_val };
     vk::ClearColorValue clear_color{ clear_bytes };
     context.render_target->mask.transition_to_discard(context.render_cmd, vkutil::ImageLayout::TransferDst);
     context.render_cmd.clearColorImage(context.render_target->mask.image, vk::ImageLayout::eTransferDstOptimal, clear_color, vkutil::color_subresource_range);
     context.render_target->mask.transition_to(context.render_cmd, vkutil::ImageLayout::StorageImage);
+    context.render_target->mask_value = initial_val;
 }
 
 void sync_depth_bias(VKContext &context) {
@@ -221,4 +226,25 @@ void refresh_pipeline(VKContext &context) {
     context.refresh_pipeline = true;
 }
 
+void sync_extended_dynamic_state(VKContext &context) {
+    if (!context.state.pipeline_cache.support_extended_dynamic_state) {
+        context.refresh_pipeline = true;
+        return;
+    }
+
+    if (!context.is_recording)
+        return;
+
+    const GxmRecordState &record = context.record;
+    context.render_cmd.setCullModeEXT(translate_cull_mode(record.cull_mode));
+    context.render_cmd.setDepthWriteEnableEXT(record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED);
+    context.render_cmd.setDepthCompareOpEXT(translate_depth_func(record.front_depth_func));
+
+    // same as the stencil state of the pipelines, the back state is only used when two sided is enabled
+    const vk::StencilOpState front = translate_stencil_state(record.front_stencil_state_op);
+    const vk::StencilOpState back = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED) ? translate_stencil_state(record.back_stencil_state_op) : front;
+    context.render_cmd.setStencilOpEXT(vk::StencilFaceFlagBits::eFront, front.failOp, front.passOp, front.depthFailOp, front.compareOp);
+    context.render_cmd.setStencilOpEXT(vk::StencilFaceFlagBits::eBack, back.failOp, back.passOp, back.depthFailOp, back.compareOp);
+}
+
 } // namespace renderer::vulkan
\ No newline at end of file
@@ -23,6 +23,7 @@
 
 #include <gxm/functions.h>
 #include <renderer/functions.h>
+#include <renderer/texture_convert.h>
 #include <util/align.h>
 #include <vkutil/vkutil.h>
 
@@ -40,7 +41,7 @@ void sync_texture(VKContext &context, MemState &mem, std::size_t index, SceGxmTe
     const SceGxmTextureFormat format = gxm::get_format(&texture);
     const SceGxmTextureBaseFormat base_format = gxm::get_base_format(format);
     if (gxm::is_paletted_format(base_format) && texture.palette_addr == 0) {
-        LOG_WARN("Ignoring null palette texture");
+        LOG_WARN_LIMITED("Ignoring null palette texture");
         return;
     }
 
@@ -95,11 +96,13 @@ void sync_texture(VKContext &context, MemState &mem, std::size_t index, SceGxmTe
     }
 
     if (image) {
-        if (!image->sampler)
+        if (!image->sampler) {
             image->sampler = texture::create_sampler(context.state, texture);
+            image->owns_sampler = false;
+        }
     } else {
         if (!is_valid_addr_range(mem, data_addr, data_addr + texture_size)) {
-            LOG_WARN("Texture has freed data.");
+            LOG_WARN_LIMITED("Texture has freed data.");
             return;
         }
         renderer::texture::cache_and_bind_texture(context.state.texture_cache, texture, mem);
@@ -123,7 +126,7 @@ void sync_texture(VKContext &context, MemState &mem, std::size_t index, SceGxmTe
     }
 }
 
-void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
+void VKTextureCacheState::prepare_staging_buffer(bool is_configure, bool keep_content) {
     assert(!is_texture_transfer_ready);
     VKContext *context = reinterpret_cast<VKContext *>(state.context);
 
@@ -152,9 +155,23 @@ void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
             // special case, all the staging buffer are occupied by the current scene
             // submit the command buffer and wait for it
             context->prerender_cmd.end();
+            context->flush_submissions();
+            context->flush_transfer_cmd();
             vk::SubmitInfo submit_info{};
             submit_info.setCommandBuffers(context->prerender_cmd);
+            // the textures uploaded from the transfer queue are acquired by this command buffer
+            const vk::TimelineSemaphoreSubmitInfo timeline_info{
+                .waitSemaphoreValueCount = 1,
+                .pWaitSemaphoreValues = &context->transfer_wait_value
+            };
+            const vk::PipelineStageFlags transfer_wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+            if (context->transfer_wait_value) {
+                submit_info.setWaitSemaphores(context->transfer_timeline);
+                submit_info.setWaitDstStageMask(transfer_wait_stage);
+                submit_info.pNext = &timeline_info;
+            }
             state.general_queue.submit(submit_info, current_fence);
+            context->transfer_wait_value = 0;
             state.device.waitForFences(current_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
             state.device.resetFences(current_fence);
 
@@ -177,7 +194,9 @@ void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
     }
 
     // then we can use the buffer
-    cmd_buffer = context->prerender_cmd;
+    // the new textures can be uploaded from the transfer queue, the GPU decoder needs the compute support of the general queue
+    is_transfer_upload = is_configure && state.transfer_queue_uploads && !decode_pipeline;
+    cmd_buffer = is_transfer_upload ? context->get_transfer_cmd() : context->get_prerender_cmd();
     if (!use_previous_buffer) {
         staging_buffer->scene_timestamp = context->scene_timestamp;
         staging_buffer->frame_timestamp = context->frame_timestamp;
@@ -190,7 +209,12 @@ void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
             staging_buffer->buffer.destroy();
 
             staging_buffer->buffer.size = current_texture->memory_needed;
-            staging_buffer->buffer.init_buffer(vk::BufferUsageFlagBits::eTransferSrc, vkutil::vma_mapped_alloc);
+            vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eTransferSrc;
+            if (decode_pipeline)
+                // the texture decode shader reads and writes the staging buffer
+                usage |= vk::BufferUsageFlagBits::eStorageBuffer;
+            staging_buffer->buffer.init_buffer(usage, state.memory_budget.get_alloc_info(MemoryCategory::Staging));
+            staging_buffer->is_decode_set_outdated = true;
         }
     }
 
@@ -204,8 +228,11 @@ void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
     };
 
     // if this is done during configure, layout is undefined, otherwise it is shader read only
+    // the content must only be kept if just a part of the texture is uploaded
     if (is_configure)
         vkutil::transition_image_layout(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::Undefined, vkutil::ImageLayout::TransferDst, range);
+    else if (keep_content)
+        vkutil::transition_image_layout(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::SampledImage, vkutil::ImageLayout::TransferDst, range);
     else
         vkutil::transition_image_layout_discard(cmd_buffer, current_texture->texture.image, vkutil::ImageLayout::SampledImage, vkutil::ImageLayout::TransferDst, range);
 
@@ -224,16 +251,37 @@ bool init(VKTextureCacheState &cache, const bool hashless_texture_cache) {
         configure_bound_texture(cache, *reinterpret_cast<const SceGxmTexture *>(texture));
     };
 
-    cache.upload_texture_callback = [&cache](SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride) {
-        upload_bound_texture(cache, base_format, width, height, mip_index, pixels, face, is_compressed, pixels_per_stride);
+    cache.upload_texture_callback = [&cache](SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset) {
+        upload_bound_texture(cache, base_format, width, height, mip_index, pixels, face, is_compressed, pixels_per_stride, row_offset);
     };
 
     cache.upload_done_callback = [&cache]() {
         upload_done(cache);
     };
 
+    cache.evict_texture_callback = [&cache](const std::size_t index) -> size_t {
+        vkutil::Image &image = cache.textures[index].texture;
+        if (!image.image)
+            return 0;
+
+        const size_t size = cache.state.allocator.getAllocationInfo(image.allocation).size;
+        VKContext *context = reinterpret_cast<VKContext *>(cache.state.context);
+        context->frame().destroy_queue.add_image(image);
+        return size;
+    };
+
     cache.use_protect = hashless_texture_cache;
 
+    if (cache.support_pvrtc) {
+        cache.pvrtc_upload_mode = PvrtcUploadMode::Native;
+        LOG_INFO("PVRTC textures are uploaded without being decoded");
+    } else if (cache.state.transcode_pvrtc) {
+        if (cache.state.physical_device_features.textureCompressionBC)
+            cache.pvrtc_upload_mode = PvrtcUploadMode::TranscodeBC;
+        else
+            LOG_WARN("The GPU does not support BC textures, PVRTC textures will be decoded to RGBA8");
+    }
+
     // don't forget to specify the allocator for all the staging buffers
     for (int i = 0; i < NB_TEXTURE_STAGING_BUFFERS; i++)
         cache.staging_buffers[i].buffer.allocator = cache.state.allocator;
@@ -255,6 +303,14 @@ static vk::Format linear_to_srgb(const vk::Format format) {
         return vk::Format::eBc2SrgbBlock;
     case vk::Format::eBc3UnormBlock:
         return vk::Format::eBc3SrgbBlock;
+    case vk::Format::ePvrtc12BppUnormBlockIMG:
+        return vk::Format::ePvrtc12BppSrgbBlockIMG;
+    case vk::Format::ePvrtc14BppUnormBlockIMG:
+        return vk::Format::ePvrtc14BppSrgbBlockIMG;
+    case vk::Format::ePvrtc22BppUnormBlockIMG:
+        return vk::Format::ePvrtc22BppSrgbBlockIMG;
+    case vk::Format::ePvrtc24BppUnormBlockIMG:
+        return vk::Format::ePvrtc24BppSrgbBlockIMG;
     default: {
         static bool has_happened = false;
         LOG_WARN_IF(!has_happened, "Trying to use gamma correction with non-compatible format {}", vk::to_string(format));
@@ -264,6 +320,23 @@ static vk::Format linear_to_srgb(const vk::Format format) {
     }
 }
 
+// format of the image of a PVRTC texture which is not decoded to rgba8
+static vk::Format get_pvrtc_image_format(const SceGxmTextureFormat format, const PvrtcUploadMode pvrtc_mode) {
+    if (pvrtc_mode == PvrtcUploadMode::TranscodeBC)
+        return translate_format(renderer::texture::get_pvrtc_transcode_format(format));
+
+    switch (gxm::get_base_format(format)) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP:
+        return vk::Format::ePvrtc12BppUnormBlockIMG;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRT4BPP:
+        return vk::Format::ePvrtc14BppUnormBlockIMG;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP:
+        return vk::Format::ePvrtc22BppUnormBlockIMG;
+    default:
+        return vk::Format::ePvrtc24BppUnormBlockIMG;
+    }
+}
+
 // get an upper bound on the amount of memory needed to upload this texture
 // the bound is only for one face and the base mip
 static uint32_t get_image_memory_upper_bound(const SceGxmTexture &gxm_texture, const vk::Format vk_format, const SceGxmTextureBaseFormat base_format) {
@@ -300,6 +373,9 @@ void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gx
     const uint16_t mip_count = renderer::texture::get_upload_mip(gxm_texture.true_mip_count(), width, height, base_format);
 
     vk::Format vk_format = translate_format(base_format);
+    const PvrtcUploadMode pvrtc_mode = renderer::texture::get_pvrtc_upload_mode(cache, gxm_texture);
+    if (pvrtc_mode != PvrtcUploadMode::Decode)
+        vk_format = get_pvrtc_image_format(format, pvrtc_mode);
     if (gxm_texture.gamma_mode) {
         vk_format = linear_to_srgb(vk_format);
     }
@@ -313,8 +389,16 @@ void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gx
         memory_needed += memory_needed / 2;
     if (is_cube)
         memory_needed *= 6;
+    if (can_texture_be_decoded_on_gpu(cache, gxm_texture, mip_count))
+        // the raw texture and its palette are also copied to the staging buffer
+        memory_needed = memory_needed * 2 + 2048;
     cache.current_texture->memory_needed = align(memory_needed, 16);
     vkutil::Image &image = cache.current_texture->texture;
+    if (image.image) {
+        // the entry held another texture, the previous frames can still be using it
+        VKContext *context = reinterpret_cast<VKContext *>(cache.state.context);
+        context->frame().destroy_queue.add_image(image);
+    }
 
     // manually initialize the image
     image.allocator = cache.state.allocator;
@@ -340,7 +424,7 @@ void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gx
         .initialLayout = vk::ImageLayout::eUndefined,
     };
 
-    std::tie(image.image, image.allocation) = image.allocator.createImage(image_info, vkutil::vma_auto_alloc);
+    std::tie(image.image, image.allocation) = image.allocator.createImage(image_info, cache.state.memory_budget.get_alloc_info(MemoryCategory::Textures));
 
     // create image view
     vk::ImageSubresourceRange range{
@@ -361,6 +445,7 @@ void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gx
     image.view = cache.state.device.createImageView(view_info);
 
     image.sampler = create_sampler(cache.state, gxm_texture, mip_count);
+    image.owns_sampler = false;
 
     cache.prepare_staging_buffer(true);
 }
@@ -371,6 +456,28 @@ vk::Sampler create_sampler(VKState &state, const SceGxmTexture &gxm_texture, con
     const SceGxmTextureFilter min_filter = static_cast<SceGxmTextureFilter>(gxm_texture.min_filter);
     const SceGxmTextureFilter mag_filter = static_cast<SceGxmTextureFilter>(gxm_texture.mag_filter);
     const bool mipmap_enabled = static_cast<bool>(gxm_texture.mip_filter);
+    const uint32_t lod_min = gxm_texture.lod_min0 | (gxm_texture.lod_min1 << 2);
+    const int anisotropic_filtering = state.texture_cache.anisotropic_filtering;
+
+    // everything the sampler is made from, the other fields of the texture don't change it
+    const uint64_t key = static_cast<uint64_t>(uaddr)
+        | (static_cast<uint64_t>(vaddr) << 3)
+        | (static_cast<uint64_t>(min_filter) << 6)
+        | (static_cast<uint64_t>(mag_filter) << 8)
+        | (static_cast<uint64_t>(mipmap_enabled) << 10)
+        | (static_cast<uint64_t>(gxm_texture.lod_bias) << 11)
+        | (static_cast<uint64_t>(lod_min) << 17)
+        | (static_cast<uint64_t>(mip_count) << 21)
+        | (static_cast<uint64_t>(anisotropic_filtering & 0xFF) << 37);
+
+    SamplerCache &sampler_cache = state.texture_cache.sampler_cache;
+    const std::lock_guard<std::mutex> guard(sampler_cache.mutex);
+    const auto cached = sampler_cache.samplers.find(key);
+    if (cached != sampler_cache.samplers.end()) {
+        sampler_cache.hits++;
+        state.sampler_cache_hit_rate = (sampler_cache.hits * 100ULL) / (sampler_cache.hits + sampler_cache.misses);
+        return cached->second;
+    }
 
     // create sampler
     vk::SamplerCreateInfo sampler_info{
@@ -381,9 +488,9 @@ vk::Sampler create_sampler(VKState &state, const SceGxmTexture &gxm_texture, con
         .addressModeV = translate_address_mode(vaddr),
         .addressModeW = vk::SamplerAddressMode::eRepeat,
         .mipLodBias = (static_cast<float>(gxm_texture.lod_bias) - 31.f) / 8.f,
-        .maxAnisotropy = static_cast<float>(state.texture_cache.anisotropic_filtering),
+        .maxAnisotropy = static_cast<float>(anisotropic_filtering),
         .compareEnable = VK_FALSE,
-        .minLod = mipmap_enabled ? static_cast<float>(std::min<uint16_t>(mip_count, gxm_texture.lod_min0 | (gxm_texture.lod_min1 << 2))) : 0.f,
+        .minLod = mipmap_enabled ? static_cast<float>(std::min<uint32_t>(mip_count, lod_min)) : 0.f,
         // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkSamplerCreateInfo.html
         // if there is no mipmap, set maxLod to 0.25 so it uses both the magnification or minification filter when needed
         .maxLod = mipmap_enabled ? static_cast<float>(mip_count) : 0.25f,
@@ -391,39 +498,31 @@ vk::Sampler create_sampler(VKState &state, const SceGxmTexture &gxm_texture, con
     };
 
     // when using nearest filter, disable anisotropy as the pixels can contain data other than color
-    sampler_info.anisotropyEnable = (state.texture_cache.anisotropic_filtering > 1) && (sampler_info.magFilter != vk::Filter::eNearest || sampler_info.minFilter != vk::Filter::eNearest);
+    sampler_info.anisotropyEnable = (anisotropic_filtering > 1) && (sampler_info.magFilter != vk::Filter::eNearest || sampler_info.minFilter != vk::Filter::eNearest);
+
+    const vk::Sampler sampler = state.device.createSampler(sampler_info);
+    sampler_cache.samplers.emplace(key, sampler);
+    sampler_cache.misses++;
+    state.sampler_count = static_cast<uint32_t>(sampler_cache.samplers.size());
+    state.sampler_cache_hit_rate = (sampler_cache.hits * 100ULL) / (sampler_cache.hits + sampler_cache.misses);
 
-    return state.device.createSampler(sampler_info);
+    return sampler;
 }
 
 // add an alpha channel to u8u8u8 textures
 static void *add_alpha_channel(const void *pixels, const uint32_t width, const uint32_t height, std::vector<uint8_t> &data) {
     data.resize(width * height * 4);
-
-    const uint8_t *src = reinterpret_cast<const uint8_t *>(pixels);
-    uint8_t *dst = data.data();
-    for (uint32_t y = 0; y < height; y++) {
-        for (uint32_t x = 0; x < width; x++) {
-            dst[0] = src[0];
-            dst[1] = src[1];
-            dst[2] = src[2];
-            // set 1.0 as the alpha channel
-            dst[3] = 255;
-
-            src += 3;
-            dst += 4;
-        }
-    }
+    renderer::texture::rgb_texture_to_rgba(data.data(), reinterpret_cast<const uint8_t *>(pixels), width * height);
 
     return data.data();
 }
 
 void upload_bound_texture(VKTextureCacheState &cache, SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height,
-    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride) {
+    uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride, uint32_t row_offset) {
+    vkutil::Image &image = cache.current_texture->texture;
     if (!cache.is_texture_transfer_ready)
-        cache.prepare_staging_buffer();
+        cache.prepare_staging_buffer(false, (row_offset != 0) || (height < image.height));
 
-    vkutil::Image &image = cache.current_texture->texture;
     TextureStagingBuffer &staging_buffer = cache.staging_buffers[cache.staging_idx];
 
     if (face > 0)
@@ -466,7 +565,7 @@ void upload_bound_texture(VKTextureCacheState &cache, SceGxmTextureBaseFormat ba
         .bufferRowLength = static_cast<uint32_t>(pixels_per_stride),
         .bufferImageHeight = height,
         .imageSubresource = layer,
-        .imageOffset = { 0, 0, 0 },
+        .imageOffset = { 0, static_cast<int32_t>(row_offset), 0 },
         .imageExtent = { width, height, 1 }
     };
     cache.cmd_buffer.copyBufferToImage(staging_buffer.buffer.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, region);
@@ -482,7 +581,29 @@ void upload_done(VKTextureCacheState &cache) {
         .baseArrayLayer = 0,
         .layerCount = cache.current_texture->is_cube ? 6U : 1U
     };
-    vkutil::transition_image_layout(cache.cmd_buffer, cache.current_texture->texture.image, vkutil::ImageLayout::TransferDst, vkutil::ImageLayout::SampledImage, range);
+    if (cache.is_transfer_upload) {
+        // release the texture from the transfer queue, the general queue acquires it before the scene
+        VKContext *context = reinterpret_cast<VKContext *>(cache.state.context);
+        vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlags(),
+            .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = cache.state.transfer_family_index,
+            .dstQueueFamilyIndex = cache.state.general_family_index,
+            .image = cache.current_texture->texture.image,
+            .subresourceRange = range
+        };
+        cache.cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), {}, {}, barrier);
+
+        barrier.srcAccessMask = vk::AccessFlags();
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        context->get_prerender_cmd().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+            vk::DependencyFlags(), {}, {}, barrier);
+        cache.is_transfer_upload = false;
+    } else {
+        vkutil::transition_image_layout(cache.cmd_buffer, cache.current_texture->texture.image, vkutil::ImageLayout::TransferDst, vkutil::ImageLayout::SampledImage, range);
+    }
     // this should not be necessary
     cache.cmd_buffer = nullptr;
     cache.is_texture_transfer_ready = false;
@@ -0,0 +1,357 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/vulkan/functions.h>
+
+#include <gxm/functions.h>
+#include <mem/ptr.h>
+#include <renderer/functions.h>
+#include <util/align.h>
+#include <util/log.h>
+#include <vkutil/vkutil.h>
+
+namespace renderer::vulkan {
+
+namespace texture {
+
+enum TextureDecodeLayout : uint32_t {
+    DECODE_LAYOUT_SWIZZLED = 0,
+    DECODE_LAYOUT_TILED = 1,
+    DECODE_LAYOUT_LINEAR = 2,
+};
+
+enum TextureDecodeFormat : uint32_t {
+    DECODE_FORMAT_COPY = 0,
+    DECODE_FORMAT_P4 = 1,
+    DECODE_FORMAT_P8 = 2,
+    DECODE_FORMAT_YUV420 = 3,
+};
+
+enum TextureDecodeYUVLayout : uint32_t {
+    DECODE_YUV_TWO_PLANES = 1 << 0,
+    DECODE_YUV_SWAP_CHROMA = 1 << 1,
+};
+
+// push constants of texture_decode.comp, all offsets are in words
+struct TextureDecodeInfo {
+    uint32_t layout_mode;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t src_offset;
+    uint32_t dst_offset;
+    uint32_t palette_offset;
+    uint32_t src_stride;
+    uint32_t words_per_texel;
+    uint32_t yuv_layout;
+};
+
+static TextureDecodeLayout get_decode_layout(const uint32_t texture_type) {
+    switch (texture_type) {
+    case SCE_GXM_TEXTURE_SWIZZLED:
+        return DECODE_LAYOUT_SWIZZLED;
+    case SCE_GXM_TEXTURE_TILED:
+        return DECODE_LAYOUT_TILED;
+    default:
+        return DECODE_LAYOUT_LINEAR;
+    }
+}
+
+static uint32_t get_decode_yuv_layout(const SceGxmTextureFormat fmt) {
+    uint32_t yuv_layout = 0;
+    if (gxm::get_base_format(fmt) == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2)
+        yuv_layout |= DECODE_YUV_TWO_PLANES;
+    const auto swizzle = static_cast<SceGxmTextureSwizzleYUV420Mode>(fmt & SCE_GXM_TEXTURE_SWIZZLE_MASK);
+    if (swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC0 || swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC1)
+        yuv_layout |= DECODE_YUV_SWAP_CHROMA;
+    return yuv_layout;
+}
+
+static TextureDecodeFormat get_decode_format(const SceGxmTextureBaseFormat base_format) {
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
+        return DECODE_FORMAT_P4;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
+        return DECODE_FORMAT_P8;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3:
+        return DECODE_FORMAT_YUV420;
+    default:
+        return DECODE_FORMAT_COPY;
+    }
+}
+
+bool init_gpu_decode(VKTextureCacheState &cache, const char *base_path) {
+    VKState &state = cache.state;
+
+    const std::string shader_path = std::string(base_path) + "shaders-builtin/vulkan/texture_decode.comp.spv";
+    const vk::ShaderModule shader = vkutil::load_shader(state.device, shader_path);
+    if (!shader) {
+        LOG_WARN("Could not load {}, textures and yuv420 videos will be decoded on the CPU", shader_path);
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding buffer_binding{
+        .binding = 0,
+        .descriptorType = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 1,
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+    };
+    vk::DescriptorSetLayoutCreateInfo descriptor_info{};
+    descriptor_info.setBindings(buffer_binding);
+    cache.decode_set_layout = state.device.createDescriptorSetLayout(descriptor_info);
+
+    // one set for each staging buffer
+    vk::DescriptorPoolSize pool_size{
+        .type = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = NB_TEXTURE_STAGING_BUFFERS
+    };
+    vk::DescriptorPoolCreateInfo pool_info{
+        .maxSets = NB_TEXTURE_STAGING_BUFFERS,
+    };
+    pool_info.setPoolSizes(pool_size);
+    cache.decode_descriptor_pool = state.device.createDescriptorPool(pool_info);
+
+    vk::DescriptorSetAllocateInfo descr_set_info{
+        .descriptorPool = cache.decode_descriptor_pool,
+    };
+    std::vector<vk::DescriptorSetLayout> descr_set_layouts(NB_TEXTURE_STAGING_BUFFERS, cache.decode_set_layout);
+    descr_set_info.setSetLayouts(descr_set_layouts);
+    const std::vector<vk::DescriptorSet> descr_sets = state.device.allocateDescriptorSets(descr_set_info);
+    for (int i = 0; i < NB_TEXTURE_STAGING_BUFFERS; i++)
+        cache.staging_buffers[i].decode_set = descr_sets[i];
+
+    vk::PushConstantRange push_constant{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset = 0,
+        .size = sizeof(TextureDecodeInfo),
+    };
+    vk::PipelineLayoutCreateInfo layout_info{};
+    layout_info.setSetLayouts(cache.decode_set_layout);
+    layout_info.setPushConstantRanges(push_constant);
+    cache.decode_pipeline_layout = state.device.createPipelineLayout(layout_info);
+
+    vk::ComputePipelineCreateInfo pipeline_info{
+        .stage = vk::PipelineShaderStageCreateInfo{
+            .stage = vk::ShaderStageFlagBits::eCompute,
+            .module = shader,
+            .pName = "main" },
+        .layout = cache.decode_pipeline_layout,
+    };
+    const auto result = state.device.createComputePipeline(vk::PipelineCache(), pipeline_info);
+    state.device.destroyShaderModule(shader);
+    if (result.result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create the texture decode pipeline: {}", vk::to_string(result.result));
+        return false;
+    }
+    cache.decode_pipeline = result.value;
+
+    cache.decode_texture_callback = [&cache](const SceGxmTexture &gxm_texture, const MemState &mem) {
+        return decode_bound_texture(cache, gxm_texture, mem);
+    };
+
+    return true;
+}
+
+bool can_texture_be_decoded_on_gpu(const VKTextureCacheState &cache, const SceGxmTexture &gxm_texture, const uint16_t mip_count) {
+    if (!cache.decode_pipeline)
+        return false;
+
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(gxm::get_format(&gxm_texture));
+    const auto texture_type = gxm_texture.texture_type();
+    const bool is_linear = (texture_type == SCE_GXM_TEXTURE_LINEAR || texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED);
+
+    // the videos are always converted on the GPU, the other formats only with gpu-texture-decode
+    if (!cache.decode_all_formats && !gxm::is_yuv_format(base_format))
+        return false;
+
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
+        // only the swizzled textures are decoded with their mip chain
+        if (texture_type == SCE_GXM_TEXTURE_SWIZZLED)
+            return true;
+        return (is_linear || texture_type == SCE_GXM_TEXTURE_TILED) && mip_count == 1;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_F16F16F16F16:
+        // linear textures are uploaded without any conversion
+        if (texture_type == SCE_GXM_TEXTURE_SWIZZLED)
+            return true;
+        return texture_type == SCE_GXM_TEXTURE_TILED && mip_count == 1;
+    case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2:
+    case SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P3:
+        return is_linear && mip_count == 1;
+    default:
+        return false;
+    }
+}
+
+bool decode_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
+    const uint16_t mip_count = cache.current_texture->mip_count;
+    if (!can_texture_be_decoded_on_gpu(cache, gxm_texture, mip_count))
+        return false;
+
+    const uint8_t *texture_data = Ptr<const uint8_t>(gxm_texture.data_addr << 2).get(mem);
+    if (!texture_data)
+        return false;
+
+    const SceGxmTextureFormat fmt = gxm::get_format(&gxm_texture);
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(fmt);
+    const auto texture_type = gxm_texture.texture_type();
+    const TextureDecodeLayout layout_mode = get_decode_layout(texture_type);
+    const TextureDecodeFormat format = get_decode_format(base_format);
+    const bool is_paletted = gxm::is_paletted_format(base_format);
+
+    const uint32_t *palette = nullptr;
+    if (is_paletted) {
+        palette = renderer::texture::get_texture_palette(gxm_texture, mem);
+        if (!palette)
+            return false;
+    }
+
+    const uint32_t bpp = renderer::texture::bits_per_pixel(base_format);
+    // the decoded textures are either rgba8 or a copy of the source texels
+    const uint32_t words_per_texel = (format == DECODE_FORMAT_COPY) ? bpp / 32 : 1;
+
+    if (!cache.is_texture_transfer_ready)
+        cache.prepare_staging_buffer();
+    TextureStagingBuffer &staging_buffer = cache.staging_buffers[cache.staging_idx];
+
+    // layout the mips the same way the CPU decoder reads them
+    std::array<TextureDecodeInfo, 16> mips;
+    uint32_t width = gxm::get_width(&gxm_texture);
+    uint32_t height = gxm::get_height(&gxm_texture);
+    uint32_t source_size = 0;
+    uint32_t source_end = 0;
+    uint32_t decoded_size = 0;
+    uint16_t mip_index = 0;
+    for (; mip_index < mip_count && mip_index < mips.size() && width && height; mip_index++) {
+        uint32_t src_stride = width;
+        if (texture_type == SCE_GXM_TEXTURE_LINEAR)
+            src_stride = align(width, 8);
+        else if (texture_type == SCE_GXM_TEXTURE_LINEAR_STRIDED) {
+            src_stride = gxm::get_stride_in_bytes(&gxm_texture) / ((bpp + 7) >> 3);
+            if (format == DECODE_FORMAT_P4)
+                src_stride *= 2;
+        }
+
+        uint32_t read_size;
+        if (format == DECODE_FORMAT_YUV420)
+            read_size = width * height + width * height / 2;
+        else
+            read_size = (src_stride * height * bpp + 7) / 8;
+
+        mips[mip_index] = {
+            .layout_mode = layout_mode,
+            .format = format,
+            .width = width,
+            .height = height,
+            .src_offset = source_size,
+            .dst_offset = decoded_size,
+            .src_stride = src_stride,
+            .words_per_texel = words_per_texel,
+            .yuv_layout = (format == DECODE_FORMAT_YUV420) ? get_decode_yuv_layout(fmt) : 0,
+        };
+        source_end = source_size + read_size;
+        decoded_size += align(width * height * words_per_texel * 4, 16);
+        // the CPU decoder advances by the size of the converted mip for paletted textures
+        source_size += is_paletted ? width * height * 4 : read_size;
+
+        width /= 2;
+        height /= 2;
+    }
+    const uint16_t decoded_mip_count = mip_index;
+
+    const uint32_t palette_size = (format == DECODE_FORMAT_P4) ? 16 * 4 : ((format == DECODE_FORMAT_P8) ? 256 * 4 : 0);
+    const uint32_t src_offset = align(staging_buffer.used_so_far, 16);
+    const uint32_t palette_offset = align(src_offset + source_end, 16);
+    const uint32_t dst_offset = align(palette_offset + palette_size, 16);
+    if (dst_offset + decoded_size > staging_buffer.buffer.size)
+        return false;
+
+    uint8_t *staging_data = reinterpret_cast<uint8_t *>(staging_buffer.buffer.mapped_data);
+    memcpy(staging_data + src_offset, texture_data, source_end);
+    if (palette)
+        memcpy(staging_data + palette_offset, palette, palette_size);
+
+    if (staging_buffer.is_decode_set_outdated) {
+        // no command using this set can be pending, the buffer has just been re-created
+        vk::DescriptorBufferInfo buffer_info{
+            .buffer = staging_buffer.buffer.buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+        vk::WriteDescriptorSet write_descr{
+            .dstSet = staging_buffer.decode_set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &buffer_info
+        };
+        cache.state.device.updateDescriptorSets(write_descr, {});
+        staging_buffer.is_decode_set_outdated = false;
+    }
+
+    vk::CommandBuffer cmd_buffer = cache.cmd_buffer;
+    cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, cache.decode_pipeline);
+    cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cache.decode_pipeline_layout, 0, staging_buffer.decode_set, {});
+    for (uint16_t mip = 0; mip < decoded_mip_count; mip++) {
+        TextureDecodeInfo &info = mips[mip];
+        info.src_offset = (src_offset + info.src_offset) / 4;
+        info.dst_offset = (dst_offset + info.dst_offset) / 4;
+        info.palette_offset = palette_offset / 4;
+
+        cmd_buffer.pushConstants(cache.decode_pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(TextureDecodeInfo), &info);
+        cmd_buffer.dispatch((info.width + 7) / 8, (info.height + 7) / 8, 1);
+    }
+
+    // the decoded texels are then copied to the image
+    vk::BufferMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = staging_buffer.buffer.buffer,
+        .offset = dst_offset,
+        .size = decoded_size
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, barrier, {});
+
+    for (uint16_t mip = 0; mip < decoded_mip_count; mip++) {
+        const TextureDecodeInfo &info = mips[mip];
+        vk::BufferImageCopy region{
+            .bufferOffset = info.dst_offset * 4,
+            .bufferRowLength = info.width,
+            .bufferImageHeight = info.height,
+            .imageSubresource = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = mip,
+                .baseArrayLayer = 0,
+                .layerCount = 1 },
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = { info.width, info.height, 1 }
+        };
+        cmd_buffer.copyBufferToImage(staging_buffer.buffer.buffer, cache.current_texture->texture.image, vk::ImageLayout::eTransferDstOptimal, region);
+    }
+
+    staging_buffer.used_so_far = dst_offset + decoded_size;
+    return true;
+}
+
+} // namespace texture
+
+} // namespace renderer::vulkan
@@ -0,0 +1,330 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <renderer/vulkan/functions.h>
+#include <renderer/vulkan/state.h>
+#include <renderer/vulkan/types.h>
+
+#include <gxm/functions.h>
+#include <renderer/gxm_types.h>
+#include <renderer/transfer.h>
+#include <util/log.h>
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+namespace renderer::vulkan {
+
+// rectangle of a transfer in a cached color surface
+struct TransferSurface {
+    ColorSurfaceCacheInfo *info = nullptr;
+    uint32_t x = 0;
+    uint32_t y = 0;
+};
+
+static uint32_t get_bytes_per_pixel(const SceGxmTransferImage &image) {
+    return (gxm::get_bits_per_pixel(image.format) + 7) >> 3;
+}
+
+static Address get_rect_address(const SceGxmTransferImage &image) {
+    return image.address.address() + image.x * get_bytes_per_pixel(image) + image.y * image.stride;
+}
+
+static TransferSurface find_surface(VKState &state, const SceGxmTransferImage &image, uint32_t width, uint32_t height) {
+    TransferSurface surface;
+    // the surfaces are never read upside down
+    if (image.stride <= 0)
+        return surface;
+
+    surface.info = state.surface_cache.retrieve_color_surface_for_transfer(get_rect_address(image), image.stride, get_bytes_per_pixel(image),
+        width, height, surface.x, surface.y);
+    return surface;
+}
+
+// the transfers are done between the scenes, a scene kept open to be merged is submitted before them
+static bool can_use_gpu(const VKContext &context) {
+    return !context.is_recording || context.scene_end_pending;
+}
+
+// the guest memory of the destination can be written with a copy of the surface
+static bool can_readback(const VKState &state, const SceGxmTransferImage &dest) {
+    if (state.disable_surface_sync)
+        return false;
+
+    if (state.res_multiplier != 1) {
+        static bool has_happened = false;
+        LOG_WARN_IF(!has_happened, "The guest memory is not written by the GPU transfers with this resolution");
+        has_happened = true;
+        return false;
+    }
+
+    return dest.stride > 0 && (dest.stride % get_bytes_per_pixel(dest)) == 0;
+}
+
+// copy the rectangle of the image to a readback, written to the guest memory of the destination once the transfer is done
+static SurfaceReadbackPtr readback_rect(VKContext &context, vk::CommandBuffer cmd, vkutil::Image &image, uint32_t x, uint32_t y,
+    const SceGxmTransferImage &dest, uint32_t width, uint32_t height) {
+    const uint32_t bytes_per_pixel = get_bytes_per_pixel(dest);
+    const Address address = get_rect_address(dest);
+    const uint32_t row_size = width * bytes_per_pixel;
+    const uint32_t size = dest.stride * (height - 1) + row_size;
+
+    SurfaceReadbackPtr readback = context.create_readback(address, size);
+    if (row_size != static_cast<uint32_t>(dest.stride)) {
+        // the bytes between the rows are written back too, keep their content
+        memcpy(readback->buffer.mapped_data, Ptr<uint8_t>(address).get(context.mem), size);
+        context.state.allocator.flushAllocation(readback->buffer.allocation, 0, size);
+    }
+
+    image.transition_to(cmd, vkutil::ImageLayout::TransferSrc);
+    const vk::BufferImageCopy copy{
+        .bufferOffset = 0,
+        .bufferRowLength = dest.stride / bytes_per_pixel,
+        .bufferImageHeight = height,
+        .imageSubresource = vkutil::color_subresource_layer,
+        .imageOffset = { static_cast<int32_t>(x), static_cast<int32_t>(y), 0 },
+        .imageExtent = { width, height, 1 }
+    };
+    cmd.copyImageToBuffer(image.image, vk::ImageLayout::eTransferSrcOptimal, readback->buffer.buffer, copy);
+    image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+
+    const vk::BufferMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readback->buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), {}, barrier, {});
+
+    context.protect_readback(readback);
+    return readback;
+}
+
+// copy a buffer holding the rectangle to the surface, with the resolution multiplier already applied
+static void upload_rect(vk::CommandBuffer cmd, vk::Buffer buffer, const TransferSurface &surface, uint32_t width, uint32_t height, uint32_t res_multiplier) {
+    vkutil::Image &image = surface.info->texture;
+    image.transition_to(cmd, vkutil::ImageLayout::TransferDst);
+    const vk::BufferImageCopy copy{
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = vkutil::color_subresource_layer,
+        .imageOffset = { static_cast<int32_t>(surface.x * res_multiplier), static_cast<int32_t>(surface.y * res_multiplier), 0 },
+        .imageExtent = { width * res_multiplier, height * res_multiplier, 1 }
+    };
+    cmd.copyBufferToImage(buffer, image.image, vk::ImageLayout::eTransferDstOptimal, copy);
+    image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+}
+
+bool transfer_copy(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest, SceGxmTransferColorKeyMode key_mode) {
+    VKState &state = context.state;
+    const uint32_t bytes_per_pixel = get_bytes_per_pixel(src);
+    if (key_mode != SCE_GXM_TRANSFER_COLORKEY_NONE || bytes_per_pixel != get_bytes_per_pixel(dest) || !can_use_gpu(context))
+        return false;
+
+    const uint32_t width = src.width;
+    const uint32_t height = src.height;
+    const TransferSurface src_surface = find_surface(state, src, width, height);
+    const TransferSurface dest_surface = find_surface(state, dest, width, height);
+    // the copies inside a surface may overlap, the CPU does them
+    if ((!src_surface.info && !dest_surface.info) || src_surface.info == dest_surface.info)
+        return false;
+
+    const uint32_t res_multiplier = state.res_multiplier;
+    if (!dest_surface.info) {
+        // a surface copied to the guest memory, it is only written by the readback
+        if (!can_readback(state, dest))
+            return false;
+
+        vk::CommandBuffer cmd = context.start_gpu_transfer();
+        SurfaceReadbackPtr readback = readback_rect(context, cmd, src_surface.info->texture, src_surface.x, src_surface.y, dest, width, height);
+        context.submit_gpu_transfer(cmd, std::move(readback));
+        return true;
+    }
+
+    vk::CommandBuffer cmd;
+    if (src_surface.info) {
+        vkutil::Image &src_image = src_surface.info->texture;
+        vkutil::Image &dest_image = dest_surface.info->texture;
+
+        cmd = context.start_gpu_transfer();
+        src_image.transition_to(cmd, vkutil::ImageLayout::TransferSrc);
+        dest_image.transition_to(cmd, vkutil::ImageLayout::TransferDst);
+        const vk::ImageCopy image_copy{
+            .srcSubresource = vkutil::color_subresource_layer,
+            .srcOffset = { static_cast<int32_t>(src_surface.x * res_multiplier), static_cast<int32_t>(src_surface.y * res_multiplier), 0 },
+            .dstSubresource = vkutil::color_subresource_layer,
+            .dstOffset = { static_cast<int32_t>(dest_surface.x * res_multiplier), static_cast<int32_t>(dest_surface.y * res_multiplier), 0 },
+            .extent = { width * res_multiplier, height * res_multiplier, 1 }
+        };
+        cmd.copyImage(src_image.image, vk::ImageLayout::eTransferSrcOptimal, dest_image.image, vk::ImageLayout::eTransferDstOptimal, image_copy);
+        src_image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+        dest_image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    } else {
+        // the guest memory to a surface, it can't be scaled by the copy
+        if (res_multiplier != 1 || src.stride <= 0)
+            return false;
+
+        const uint32_t row_size = width * bytes_per_pixel;
+        vkutil::Buffer staging(state.allocator, static_cast<vk::DeviceSize>(row_size) * height);
+        staging.init_buffer(vk::BufferUsageFlagBits::eTransferSrc, vkutil::vma_mapped_alloc);
+        const uint8_t *src_ptr = Ptr<const uint8_t>(get_rect_address(src)).get(context.mem);
+        transfer::copy(static_cast<uint8_t *>(staging.mapped_data), row_size, bytes_per_pixel, src_ptr, src.stride, bytes_per_pixel,
+            width, height, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0);
+        state.allocator.flushAllocation(staging.allocation, 0, staging.size);
+
+        cmd = context.start_gpu_transfer();
+        upload_rect(cmd, staging.buffer, dest_surface, width, height, 1);
+        context.frame().destroy_queue.add_buffer(staging);
+    }
+
+    SurfaceReadbackPtr readback;
+    if (can_readback(state, dest))
+        readback = readback_rect(context, cmd, dest_surface.info->texture, dest_surface.x, dest_surface.y, dest, width, height);
+    context.submit_gpu_transfer(cmd, readback);
+
+    if (!readback) {
+        // as before, the guest memory of the destination gets the one of the source
+        const uint8_t *src_ptr = Ptr<const uint8_t>(get_rect_address(src)).get(context.mem);
+        uint8_t *dest_ptr = Ptr<uint8_t>(get_rect_address(dest)).get(context.mem);
+        transfer::copy(dest_ptr, dest.stride, bytes_per_pixel, src_ptr, src.stride, bytes_per_pixel, width, height, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0);
+    }
+
+    return true;
+}
+
+bool transfer_downscale(VKContext &context, const SceGxmTransferImage &src, const SceGxmTransferImage &dest) {
+    VKState &state = context.state;
+    // the blit needs both images, and can only average the pixels of the same format
+    if (src.format != dest.format || (src.width % 2) != 0 || (src.height % 2) != 0 || !can_use_gpu(context))
+        return false;
+
+    const uint32_t width = src.width / 2;
+    const uint32_t height = src.height / 2;
+    const TransferSurface src_surface = find_surface(state, src, src.width, src.height);
+    if (!src_surface.info)
+        return false;
+    const TransferSurface dest_surface = find_surface(state, dest, width, height);
+    if (!dest_surface.info || dest_surface.info == src_surface.info)
+        return false;
+
+    vkutil::Image &src_image = src_surface.info->texture;
+    vkutil::Image &dest_image = dest_surface.info->texture;
+    const vk::FormatFeatureFlags src_features = state.physical_device.getFormatProperties(src_image.format).optimalTilingFeatures;
+    const vk::FormatFeatureFlags dest_features = state.physical_device.getFormatProperties(dest_image.format).optimalTilingFeatures;
+    if (!(src_features & vk::FormatFeatureFlagBits::eBlitSrc) || !(dest_features & vk::FormatFeatureFlagBits::eBlitDst))
+        return false;
+
+    // halving the size with a linear filter averages each 2x2 block, the other formats are point sampled like on the CPU
+    vk::Filter filter = vk::Filter::eNearest;
+    if (transfer::can_box_filter(src.format) && (src_features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
+        filter = vk::Filter::eLinear;
+
+    const int32_t res_multiplier = static_cast<int32_t>(state.res_multiplier);
+    const int32_t src_x = static_cast<int32_t>(src_surface.x) * res_multiplier;
+    const int32_t src_y = static_cast<int32_t>(src_surface.y) * res_multiplier;
+    const int32_t dest_x = static_cast<int32_t>(dest_surface.x) * res_multiplier;
+    const int32_t dest_y = static_cast<int32_t>(dest_surface.y) * res_multiplier;
+    vk::ImageBlit blit{
+        .srcSubresource = vkutil::color_subresource_layer,
+        .dstSubresource = vkutil::color_subresource_layer
+    };
+    blit.srcOffsets[0] = vk::Offset3D{ src_x, src_y, 0 };
+    blit.srcOffsets[1] = vk::Offset3D{ src_x + static_cast<int32_t>(src.width) * res_multiplier, src_y + static_cast<int32_t>(src.height) * res_multiplier, 1 };
+    blit.dstOffsets[0] = vk::Offset3D{ dest_x, dest_y, 0 };
+    blit.dstOffsets[1] = vk::Offset3D{ dest_x + static_cast<int32_t>(width) * res_multiplier, dest_y + static_cast<int32_t>(height) * res_multiplier, 1 };
+
+    vk::CommandBuffer cmd = context.start_gpu_transfer();
+    src_image.transition_to(cmd, vkutil::ImageLayout::TransferSrc);
+    dest_image.transition_to(cmd, vkutil::ImageLayout::TransferDst);
+    cmd.blitImage(src_image.image, vk::ImageLayout::eTransferSrcOptimal, dest_image.image, vk::ImageLayout::eTransferDstOptimal, blit, filter);
+    src_image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+    dest_image.transition_to(cmd, vkutil::ImageLayout::ColorAttachmentReadWrite);
+
+    SurfaceReadbackPtr readback;
+    if (can_readback(state, dest))
+        readback = readback_rect(context, cmd, dest_image, dest_surface.x, dest_surface.y, dest, width, height);
+    context.submit_gpu_transfer(cmd, readback);
+
+    if (!readback) {
+        const uint32_t bytes_per_pixel = get_bytes_per_pixel(src);
+        const uint8_t *src_ptr = Ptr<const uint8_t>(get_rect_address(src)).get(context.mem);
+        uint8_t *dest_ptr = Ptr<uint8_t>(get_rect_address(dest)).get(context.mem);
+        if (transfer::can_box_filter(src.format))
+            transfer::downscale(dest_ptr, dest.stride, src_ptr, src.stride, bytes_per_pixel, width, height);
+        else
+            transfer::copy(dest_ptr, dest.stride, bytes_per_pixel, src_ptr, src.stride * 2, bytes_per_pixel * 2, width, height, SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0);
+    }
+
+    return true;
+}
+
+bool transfer_fill(VKContext &context, const SceGxmTransferImage &dest, uint32_t fill_color) {
+    VKState &state = context.state;
+    // the buffer is filled with 32-bit values
+    const uint32_t bytes_per_pixel = get_bytes_per_pixel(dest);
+    uint32_t pattern;
+    switch (bytes_per_pixel) {
+    case 1: pattern = (fill_color & 0xFF) * 0x01010101U; break;
+    case 2: pattern = (fill_color & 0xFFFF) * 0x00010001U; break;
+    case 4: pattern = fill_color; break;
+    default: return false;
+    }
+
+    if (!can_use_gpu(context))
+        return false;
+
+    const TransferSurface dest_surface = find_surface(state, dest, dest.width, dest.height);
+    if (!dest_surface.info)
+        return false;
+
+    // the raw bits of the color are written, a clear would need them converted to the format of the surface
+    const uint32_t res_multiplier = state.res_multiplier;
+    const vk::DeviceSize size = static_cast<vk::DeviceSize>(dest.width) * res_multiplier * dest.height * res_multiplier * bytes_per_pixel;
+    vkutil::Buffer fill_buffer(state.allocator, (size + 3) & ~3);
+    fill_buffer.init_buffer(vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst);
+
+    vk::CommandBuffer cmd = context.start_gpu_transfer();
+    cmd.fillBuffer(fill_buffer.buffer, 0, VK_WHOLE_SIZE, pattern);
+    const vk::BufferMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = fill_buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, barrier, {});
+    upload_rect(cmd, fill_buffer.buffer, dest_surface, dest.width, dest.height, res_multiplier);
+    context.frame().destroy_queue.add_buffer(fill_buffer);
+
+    SurfaceReadbackPtr readback;
+    if (can_readback(state, dest))
+        readback = readback_rect(context, cmd, dest_surface.info->texture, dest_surface.x, dest_surface.y, dest, dest.width, dest.height);
+    context.submit_gpu_transfer(cmd, readback);
+
+    if (!readback)
+        transfer::fill(Ptr<uint8_t>(get_rect_address(dest)).get(context.mem), dest.stride, bytes_per_pixel, dest.width, dest.height, fill_color);
+
+    return true;
+}
+
+} // namespace renderer::vulkan
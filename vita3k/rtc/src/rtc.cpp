@@ -19,12 +19,186 @@
 
 #include <util/log.h>
 
-std::uint64_t rtc_ticks_since_epoch() {
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define RTC_CYCLE_COUNTER_X64
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define RTC_CYCLE_COUNTER_ARM64
+#endif
+
+// Guest ticks are read from the cycle counter of the host cpu by a multiply and a shift, with the conversion
+// computed once and only read afterwards, like the clock page of a vDSO.
+// The counter must be invariant, i.e. run at a constant rate on every core, otherwise chrono is used
+enum class CycleClockState : std::uint32_t {
+    Uninitialized,
+    // The first read is checking the counter
+    Starting,
+    // Guest time is read from chrono until the calibration time has passed
+    Calibrating,
+    // A read is computing the conversion
+    Finishing,
+    Enabled,
+    Disabled,
+};
+
+struct CycleClock {
+    static constexpr uint32_t SHIFT = 48;
+    // The counter frequency is measured by the reads themselves, so nothing waits for it
+    static constexpr std::chrono::milliseconds CALIBRATION_TIME{ 100 };
+
+    // The other fields are published by the release store of the state
+    std::atomic<CycleClockState> state = CycleClockState::Uninitialized;
+    std::chrono::steady_clock::time_point calibration_time;
+    std::uint64_t calibration_cycles = 0;
+
+    std::uint64_t base_cycles = 0;
+    std::uint64_t base_ticks = 0;
+    // Guest ticks per cycle, fixed point with SHIFT fractional bits
+    std::uint64_t multiplier = 0;
+};
+
+static CycleClock cycle_clock;
+
+static std::uint64_t chrono_ticks_since_epoch() {
     const auto now = std::chrono::high_resolution_clock::now();
     const auto now_timepoint = std::chrono::time_point_cast<VitaClocks>(now);
     return now_timepoint.time_since_epoch().count();
 }
 
+static std::uint64_t read_cycle_counter() {
+#if defined(RTC_CYCLE_COUNTER_X64)
+    return __rdtsc();
+#elif defined(RTC_CYCLE_COUNTER_ARM64) && defined(_MSC_VER)
+    return _ReadStatusReg(ARM64_CNTVCT);
+#elif defined(RTC_CYCLE_COUNTER_ARM64)
+    std::uint64_t cycles;
+    asm volatile("mrs %0, cntvct_el0"
+                 : "=r"(cycles));
+    return cycles;
+#else
+    return 0;
+#endif
+}
+
+static std::uint64_t multiply_shift(std::uint64_t a, std::uint64_t b) {
+#ifdef _MSC_VER
+    const std::uint64_t high = __umulh(a, b);
+    return (high << (64 - CycleClock::SHIFT)) | ((a * b) >> CycleClock::SHIFT);
+#else
+    return static_cast<std::uint64_t>((static_cast<unsigned __int128>(a) * b) >> CycleClock::SHIFT);
+#endif
+}
+
+// Must only be called by the read owning the initialization, frequency is in Hz and 0 if the counter can't be used
+static void enable_cycle_clock(CycleClock &clock, std::uint64_t frequency) {
+    // The multiplier must fit in 64 bits
+    if (frequency < VITA_CLOCKS_PER_SEC) {
+        LOG_INFO("No invariant cycle counter found, guest time is read from the system clock");
+        clock.state.store(CycleClockState::Disabled, std::memory_order_release);
+        return;
+    }
+
+    clock.multiplier = static_cast<std::uint64_t>((static_cast<long double>(VITA_CLOCKS_PER_SEC) * (1ULL << CycleClock::SHIFT)) / frequency);
+    clock.base_cycles = read_cycle_counter();
+    clock.base_ticks = chrono_ticks_since_epoch();
+    LOG_INFO("Guest time is read from the cycle counter of the cpu, running at {} MHz", frequency / 1'000'000);
+    clock.state.store(CycleClockState::Enabled, std::memory_order_release);
+}
+
+#if defined(RTC_CYCLE_COUNTER_X64)
+// Reads the steady clock and the counter at the same time, keeping the closest pair of reads
+static void sample_cycle_counter(std::chrono::steady_clock::time_point &time, std::uint64_t &cycles) {
+    auto best = std::chrono::steady_clock::duration::max();
+    for (int i = 0; i < 16; i++) {
+        const auto before = std::chrono::steady_clock::now();
+        const std::uint64_t counter = read_cycle_counter();
+        const auto after = std::chrono::steady_clock::now();
+        if (after - before < best) {
+            best = after - before;
+            time = before + (after - before) / 2;
+            cycles = counter;
+        }
+    }
+}
+
+static bool has_invariant_tsc() {
+    // Invariant TSC flag of the advanced power management leaf
+    unsigned int regs[4] = {};
+#ifdef _MSC_VER
+    __cpuid(reinterpret_cast<int *>(regs), 0x80000000);
+    if (regs[0] < 0x80000007)
+        return false;
+    __cpuid(reinterpret_cast<int *>(regs), 0x80000007);
+#else
+    if (!__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]))
+        return false;
+#endif
+    return regs[3] & (1 << 8);
+}
+
+// Calibrate the TSC against the steady clock, between the first read and the first one after CALIBRATION_TIME
+static void finish_cycle_clock_calibration(CycleClock &clock) {
+    std::chrono::steady_clock::time_point end_time;
+    std::uint64_t end_cycles;
+    sample_cycle_counter(end_time, end_cycles);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - clock.calibration_time).count();
+    if ((elapsed <= 0) || (end_cycles <= clock.calibration_cycles)) {
+        enable_cycle_clock(clock, 0);
+        return;
+    }
+    enable_cycle_clock(clock, static_cast<std::uint64_t>(static_cast<double>(end_cycles - clock.calibration_cycles) * 1e9 / static_cast<double>(elapsed)));
+}
+#endif
+
+static void start_cycle_clock(CycleClock &clock) {
+#if defined(RTC_CYCLE_COUNTER_X64)
+    if (!has_invariant_tsc()) {
+        enable_cycle_clock(clock, 0);
+        return;
+    }
+    sample_cycle_counter(clock.calibration_time, clock.calibration_cycles);
+    clock.state.store(CycleClockState::Calibrating, std::memory_order_release);
+#elif defined(RTC_CYCLE_COUNTER_ARM64) && defined(_MSC_VER)
+    enable_cycle_clock(clock, _ReadStatusReg(ARM64_CNTFRQ));
+#elif defined(RTC_CYCLE_COUNTER_ARM64)
+    std::uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0"
+                 : "=r"(frequency));
+    enable_cycle_clock(clock, frequency);
+#else
+    enable_cycle_clock(clock, 0);
+#endif
+}
+
+std::uint64_t rtc_ticks_since_epoch() {
+    CycleClockState state = cycle_clock.state.load(std::memory_order_acquire);
+    if (state != CycleClockState::Enabled) {
+        if ((state == CycleClockState::Uninitialized) && cycle_clock.state.compare_exchange_strong(state, CycleClockState::Starting, std::memory_order_acquire))
+            start_cycle_clock(cycle_clock);
+#if defined(RTC_CYCLE_COUNTER_X64)
+        else if ((state == CycleClockState::Calibrating) && (std::chrono::steady_clock::now() - cycle_clock.calibration_time >= CycleClock::CALIBRATION_TIME)
+            && cycle_clock.state.compare_exchange_strong(state, CycleClockState::Finishing, std::memory_order_acquire))
+            finish_cycle_clock_calibration(cycle_clock);
+#endif
+
+        // The clock may have just been enabled by this read, the next ones then can't go back in time
+        if (cycle_clock.state.load(std::memory_order_acquire) != CycleClockState::Enabled)
+            return chrono_ticks_since_epoch();
+    }
+
+    return cycle_clock.base_ticks + multiply_shift(read_cycle_counter() - cycle_clock.base_cycles, cycle_clock.multiplier);
+}
+
 std::uint64_t rtc_base_ticks() {
     return RTC_OFFSET + std::time(nullptr) * VITA_CLOCKS_PER_SEC - rtc_ticks_since_epoch();
 }
@@ -0,0 +1,61 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Decodes random instructions with the usse decoder and reports how many are decoded per second.
+// Returns a non-zero value if too few of them match an instruction format.
+
+#include <shader/usse_translator_entry.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace shader;
+
+static constexpr size_t INSTRUCTION_COUNT = 1 << 20;
+
+int main() {
+    std::mt19937_64 random(0x55AA55AA);
+    std::vector<uint64_t> instructions(INSTRUCTION_COUNT);
+    for (uint64_t &instruction : instructions)
+        instruction = random();
+
+    // decode everything once so the tables are built before timing
+    size_t matched_count = 0;
+    for (const uint64_t instruction : instructions)
+        matched_count += usse::get_instruction_name(instruction) != nullptr;
+    if (matched_count <= INSTRUCTION_COUNT / 2) {
+        std::fprintf(stderr, "Only %zu of %zu instructions were decoded\n", matched_count, INSTRUCTION_COUNT);
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t name_length = 0;
+    for (const uint64_t instruction : instructions) {
+        const char *name = usse::get_instruction_name(instruction);
+        if (name)
+            name_length += std::strlen(name);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // the names are used so the decoding is not optimized out
+    std::printf("Decoded %zu instructions in %.2f ms (%.1f M/s), %zu name bytes\n", INSTRUCTION_COUNT, elapsed.count() * 1000.0,
+        INSTRUCTION_COUNT / elapsed.count() / 1e6, name_length);
+    return 0;
+}
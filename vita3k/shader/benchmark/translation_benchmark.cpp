@@ -0,0 +1,177 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+// Translates all the gxp files of a directory (like the shaderlog dumps) with the recompiler
+// and reports the time spent in each step, so the regressions of the translator are noticed.
+// Usage: shader-benchmark <gxp directory>
+
+#include <gxm/functions.h>
+#include <shader/gxp_parser.h>
+#include <shader/spirv_recompiler.h>
+#include <shader/usse_program_analyzer.h>
+#include <shader/usse_translator_entry.h>
+#include <util/fs.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace shader;
+
+static constexpr uint32_t GXP_MAGIC = 0x00505847; // "GXP\0"
+
+struct BenchmarkResult {
+    std::string name;
+    bool is_fragment;
+    std::chrono::nanoseconds analyze;
+    std::chrono::nanoseconds decode;
+    std::chrono::nanoseconds spirv_generation;
+    std::chrono::nanoseconds glsl_generation;
+    std::chrono::nanoseconds glsl_conversion;
+    size_t spirv_size;
+};
+
+static double to_us(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+static bool read_program(const fs::path &path, std::vector<uint64_t> &storage) {
+    fs::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const size_t file_size = fs::file_size(path);
+    if (file_size < sizeof(SceGxmProgram))
+        return false;
+
+    // the instructions are read as 64-bit words
+    storage.assign((file_size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    file.read(reinterpret_cast<char *>(storage.data()), file_size);
+
+    const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(storage.data());
+    return program.magic == GXP_MAGIC && program.size <= file_size;
+}
+
+static bool benchmark_program(const SceGxmProgram &program, const std::string &name, BenchmarkResult &result) {
+    using clock = std::chrono::steady_clock;
+
+    // use some default hints, the ones of the draws are not known
+    Hints hints{
+        .attributes = nullptr,
+        .color_format = SCE_GXM_COLOR_FORMAT_U8U8U8U8_ABGR,
+    };
+    std::fill_n(hints.vertex_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+    std::fill_n(hints.fragment_textures, SCE_GXM_MAX_TEXTURE_UNITS, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR);
+
+    result.name = name;
+    result.is_fragment = program.is_fragment();
+
+    // what the renderer does when the program is created
+    auto start = clock::now();
+    [[maybe_unused]] const usse::ProgramInput input = get_program_input(program);
+    usse::AttributeInformationMap attribute_infos;
+    UniformBufferSizes uniform_buffer_sizes;
+    if (program.is_vertex())
+        usse::get_attribute_informations(program, attribute_infos);
+    usse::get_uniform_buffer_sizes(program, uniform_buffer_sizes);
+    result.analyze = clock::now() - start;
+
+    // the translations below reuse this decoding
+    start = clock::now();
+    usse::predecode_program(program, name);
+    result.decode = clock::now() - start;
+
+    const FeatureState vulkan_features;
+    TranslationTimings timings;
+    const GeneratedShader vulkan_shader = convert_gxp(program, name, vulkan_features, Target::SpirVVulkan, hints, false, false, nullptr, &timings);
+    result.spirv_generation = timings.spirv_generation;
+    result.spirv_size = vulkan_shader.spirv.size() * sizeof(uint32_t);
+
+    FeatureState opengl_features;
+    opengl_features.support_shader_interlock = true;
+    const GeneratedShader opengl_shader = convert_gxp(program, name, opengl_features, Target::GLSLOpenGL, hints, false, false, nullptr, &timings);
+    result.glsl_generation = timings.spirv_generation;
+    result.glsl_conversion = timings.glsl_conversion;
+
+    return !vulkan_shader.spirv.empty() && !opengl_shader.glsl.empty();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <gxp directory>\n", argv[0]);
+        return 2;
+    }
+
+    const fs::path corpus_path{ argv[1] };
+    if (!fs::is_directory(corpus_path)) {
+        std::fprintf(stderr, "%s is not a directory\n", argv[1]);
+        return 2;
+    }
+
+    std::vector<fs::path> gxp_paths;
+    for (const auto &entry : fs::recursive_directory_iterator(corpus_path)) {
+        if (fs::is_regular_file(entry.path()) && entry.path().extension() == ".gxp")
+            gxp_paths.push_back(entry.path());
+    }
+    std::sort(gxp_paths.begin(), gxp_paths.end());
+
+    if (gxp_paths.empty()) {
+        std::fprintf(stderr, "No gxp file found in %s\n", argv[1]);
+        return 2;
+    }
+
+    // times are in microseconds, the glsl target generates its own spir-v before converting it
+    std::printf("shader,type,analyze,decode,spirv_vk,spirv_size,spirv_gl,glsl\n");
+
+    std::vector<uint64_t> storage;
+    BenchmarkResult total{};
+    size_t translated_count = 0;
+    size_t failed_count = 0;
+    for (const fs::path &path : gxp_paths) {
+        const std::string name = path.stem().string();
+        BenchmarkResult result{};
+        if (!read_program(path, storage)) {
+            std::fprintf(stderr, "%s is not a valid gxp file\n", name.c_str());
+            failed_count++;
+            continue;
+        }
+
+        if (!benchmark_program(*reinterpret_cast<const SceGxmProgram *>(storage.data()), name, result)) {
+            std::fprintf(stderr, "Failed to translate %s\n", name.c_str());
+            failed_count++;
+        }
+
+        std::printf("%s,%s,%.1f,%.1f,%.1f,%zu,%.1f,%.1f\n", name.c_str(), result.is_fragment ? "frag" : "vert", to_us(result.analyze), to_us(result.decode),
+            to_us(result.spirv_generation), result.spirv_size, to_us(result.glsl_generation), to_us(result.glsl_conversion));
+
+        total.analyze += result.analyze;
+        total.decode += result.decode;
+        total.spirv_generation += result.spirv_generation;
+        total.spirv_size += result.spirv_size;
+        total.glsl_generation += result.glsl_generation;
+        total.glsl_conversion += result.glsl_conversion;
+        translated_count++;
+    }
+
+    std::printf("total (%zu shaders),,%.1f,%.1f,%.1f,%zu,%.1f,%.1f\n", translated_count, to_us(total.analyze), to_us(total.decode),
+        to_us(total.spirv_generation), total.spirv_size, to_us(total.glsl_generation), to_us(total.glsl_conversion));
+
+    // so a test running the benchmark fails when a shader can not be translated anymore
+    return failed_count == 0 ? 0 : 1;
+}
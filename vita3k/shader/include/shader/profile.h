@@ -19,8 +19,8 @@
 
 #ifdef TRACY_ENABLE
 
-#include "public/tracy/Tracy.hpp"
-#define SHADER_PROFILE(name) ZoneNamedNC(___tracy_scoped_zone, name, 0x000035, false);
+#include <util/tracy_zones.h>
+#define SHADER_PROFILE(name) TRACY_ZONE_C(RENDERER, name, 0x000035);
 
 #else
 
@@ -23,6 +23,8 @@
 
 #include <features/state.h>
 
+#include <chrono>
+#include <functional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -36,7 +38,7 @@ namespace shader {
 static constexpr int COLOR_ATTACHMENT_TEXTURE_SLOT_IMAGE = 0;
 static constexpr int MASK_TEXTURE_SLOT_IMAGE = 1;
 static constexpr int COLOR_ATTACHMENT_RAW_TEXTURE_SLOT_IMAGE = 3;
-static constexpr uint32_t CURRENT_VERSION = 8;
+static constexpr uint32_t CURRENT_VERSION = 9;
 
 struct RenderVertUniformBlock {
     std::array<float, 4> viewport_flip;
@@ -45,6 +47,8 @@ struct RenderVertUniformBlock {
     float screen_height;
     float z_offset;
     float z_scale;
+    // bit i is set if the attribute at location i is rgb but fetched as rgba, its 4th component must then be 1
+    uint32_t rgb_attributes_mask;
 };
 
 struct RenderVertUniformBlockWithMapping : public RenderVertUniformBlock {
@@ -60,6 +64,7 @@ enum VertUniformFieldId : uint32_t {
     VERT_UNIFORM_screen_height,
     VERT_UNIFORM_z_offset,
     VERT_UNIFORM_z_scale,
+    VERT_UNIFORM_rgb_attributes_mask,
     VERT_UNIFORM_buffer_addresses
 };
 
@@ -112,12 +117,19 @@ struct GeneratedShader {
     usse::SpirvCode spirv;
 };
 
+// time spent in the steps of a translation, used to benchmark the recompiler
+struct TranslationTimings {
+    std::chrono::nanoseconds spirv_generation{};
+    // only for the glsl target
+    std::chrono::nanoseconds glsl_conversion{};
+};
+
 // Dump generated SPIR-V disassembly up to this point
 void spirv_disasm_print(const usse::SpirvCode &spirv_binary, std::string *spirv_dump = nullptr);
 
 // the returned object will only have its glsl or spirv field non-empty depending on the target
 GeneratedShader convert_gxp(const SceGxmProgram &program, const std::string &shader_hash, const FeatureState &features, const Target target, const Hints &hints, bool maskupdate = false,
-    bool force_shader_debug = false, std::function<bool(const std::string &ext, const std::string &dump)> dumper = nullptr);
+    bool force_shader_debug = false, std::function<bool(const std::string &ext, const std::string &dump)> dumper = nullptr, TranslationTimings *timings = nullptr);
 
 void convert_gxp_to_glsl_from_filepath(const std::string &shader_filepath);
 
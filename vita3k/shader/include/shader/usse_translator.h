@@ -18,6 +18,7 @@
 #pragma once
 
 #include <gxm/types.h>
+#include <shader/matcher.h>
 #include <shader/spirv_recompiler.h>
 #include <shader/usse_program_analyzer.h>
 #include <shader/usse_translator_types.h>
@@ -827,6 +828,23 @@ private:
 
 constexpr int sgx543_pc_bits = 20;
 
+template <typename Visitor>
+using USSEMatcher = shader::decoder::Matcher<Visitor, uint64_t>;
+
+// Part of the translation only depending on the instructions of a program, kept for each program so the variants
+// translated with other hints, features or for the mask update only have to emit their SPIR-V
+struct DecodedProgram {
+    struct Phase {
+        std::size_t count = 0;
+        USSEBlockNode tree_block_node{ nullptr, 0 };
+        // handler of each instruction, null if it is not matched
+        std::vector<const USSEMatcher<USSETranslatorVisitor> *> decoders;
+    };
+
+    std::uint32_t program_size = 0;
+    std::array<Phase, static_cast<std::size_t>(ShaderPhase::Max)> phases;
+};
+
 struct USSERecompiler final {
     const std::uint64_t *inst;
     std::size_t count;
@@ -838,13 +856,14 @@ struct USSERecompiler final {
     const SceGxmProgram *program;
     spv::Function *end_hook_func;
 
-    USSEBlockNode tree_block_node;
+    // set by reset, owned by the decoded program
+    const DecodedProgram::Phase *phase;
 
     explicit USSERecompiler(spv::Builder &b, const SceGxmProgram &program, const FeatureState &features,
         const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils, spv::Function *end_hook_func,
         const NonDependentTextureQueryCallInfos &queries, const spv::Id render_info_id);
 
-    void reset(const std::uint64_t *inst, const std::size_t count);
+    void reset(const std::uint64_t *inst, const DecodedProgram::Phase &phase);
 
     void compile_code_node(const usse::USSECodeNode &code);
     void compile_break_node(const usse::USSEBreakNode &node);
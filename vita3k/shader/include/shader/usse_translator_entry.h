@@ -22,6 +22,7 @@
 //
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 struct SceGxmProgram;
@@ -43,7 +44,14 @@ struct SpirvUtilFunctions;
 
 using NonDependentTextureQueryCallInfos = std::vector<NonDependentTextureQueryCallInfo>;
 
-void convert_gxp_usse_to_spirv(spv::Builder &b, const SceGxmProgram &program, const FeatureState &features, const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils,
+// name of the first instruction format matching this instruction, or nullptr if none matches it
+const char *get_instruction_name(uint64_t instruction);
+
+// decode the program ahead of its translations, which then reuse this decoding
+void predecode_program(const SceGxmProgram &program, const std::string &shader_hash);
+
+// the decoding of the program is kept with its hash and reused by its other variants
+void convert_gxp_usse_to_spirv(spv::Builder &b, const SceGxmProgram &program, const std::string &shader_hash, const FeatureState &features, const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils,
     spv::Function *begin_hook_func, spv::Function *end_hook_func, const NonDependentTextureQueryCallInfos &queries, const uint32_t render_info_id);
 
 } // namespace usse
@@ -35,8 +35,12 @@
 #include <SPIRV/SpvBuilder.h>
 #include <SPIRV/disassemble.h>
 #include <spirv_glsl.hpp>
+#ifdef USE_SPIRV_OPT
+#include <spirv-tools/optimizer.hpp>
+#endif
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <functional>
 #include <iterator>
@@ -98,6 +102,7 @@ struct VarToReg {
     uint32_t size;
     DataType dtype;
     bool pa; // otherwise sa
+    std::int32_t location;
 };
 
 struct TranslationState {
@@ -259,7 +264,7 @@ static spv::Id create_param_sampler(spv::Builder &b, const std::string &name, co
     return b.createVariable(spv::NoPrecision, spv::StorageClassUniformConstant, sampled_image_type, name.c_str());
 }
 
-static spv::Id create_input_variable(spv::Builder &b, SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils, const FeatureState &features, const TranslationState &translation_state, const char *name, const RegisterBank bank, const std::uint32_t offset, spv::Id type, const std::uint32_t size, spv::Id force_id = spv::NoResult, DataType dtype = DataType::F32) {
+static spv::Id create_input_variable(spv::Builder &b, SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils, const FeatureState &features, const TranslationState &translation_state, const char *name, const RegisterBank bank, const std::uint32_t offset, spv::Id type, const std::uint32_t size, spv::Id force_id = spv::NoResult, DataType dtype = DataType::F32, std::int32_t location = -1) {
     std::uint32_t total_var_comp = size / 4;
     spv::Id var = !force_id ? (b.createVariable(spv::NoPrecision, reg_type_to_spv_storage_class(bank), type, name)) : force_id;
     Operand dest;
@@ -288,7 +293,8 @@ static spv::Id create_input_variable(spv::Builder &b, SpirvShaderParameters &par
         }
     };
 
-    bool is_4th_component_1 = false;
+    // the formats of the attributes are only known at draw time, so this is a condition and not a constant
+    spv::Id is_4th_component_1 = spv::NoResult;
 
     if (total_var_comp != 1 && b.isArrayType(b.getContainedTypeId(b.getTypeId(var)))) {
         spv::Id arr_type = b.getContainedTypeId(b.getTypeId(var));
@@ -310,26 +316,27 @@ static spv::Id create_input_variable(spv::Builder &b, SpirvShaderParameters &par
             var = b.createLoad(var, spv::NoPrecision);
             var = utils::finalize(b, var, var, SWIZZLE_CHANNEL_4_DEFAULT, 0, dest_mask);
 
-            if (!features.support_rgb_attributes && !translation_state.is_fragment && dest_mask == 0b1111) {
+            if (!features.support_rgb_attributes && !translation_state.is_fragment && dest_mask == 0b1111 && location >= 0 && location < 32) {
                 // if the vertex input was rgb, the alpha component must be set to 1,
                 // however it will be set to whatever is in memory after the blue component
-                for (const auto &attribute : *translation_state.hints->attributes) {
-                    if (attribute.regIndex == offset) {
-                        is_4th_component_1 = (attribute.componentCount == 3);
-                        break;
-                    }
-                }
+                const spv::Id u32 = b.makeUintType(32);
+                spv::Id rgb_mask = utils::create_access_chain(b, spv::StorageClassUniform, translation_state.render_info_id, { b.makeIntConstant(VERT_UNIFORM_rgb_attributes_mask) });
+                rgb_mask = b.createLoad(rgb_mask, spv::NoPrecision);
+                rgb_mask = b.createBinOp(spv::OpBitwiseAnd, u32, rgb_mask, b.makeUintConstant(1U << location));
+                is_4th_component_1 = b.createBinOp(spv::OpINotEqual, b.makeBoolType(), rgb_mask, b.makeUintConstant(0));
             }
         }
 
         if (is_integer_data_type(dest.type) && b.isFloatType(utils::unwrap_type(b, b.getTypeId(var))))
             var = utils::convert_to_int(b, var, dest.type, true);
 
-        if (is_4th_component_1) {
+        if (is_4th_component_1 != spv::NoResult) {
             // set the 4th component to 1, because it's what the shader is expecting it to be
             const spv::Id comp_type = utils::unwrap_type(b, b.getTypeId(var));
             const spv::Id one = utils::make_uniform_vector_from_type(b, comp_type, 1);
-            var = b.createVectorInsertDynamic(var, b.getTypeId(var), one, b.makeUintConstant(3));
+            spv::Id fourth_comp = b.createCompositeExtract(var, comp_type, 3);
+            fourth_comp = b.createTriOp(spv::OpSelect, comp_type, is_4th_component_1, one, fourth_comp);
+            var = b.createVectorInsertDynamic(var, b.getTypeId(var), fourth_comp, b.makeUintConstant(3));
         }
 
         utils::store(b, parameters, utils, features, dest, var, dest_mask, 0);
@@ -955,7 +962,7 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
 
     if (program_type == SceGxmProgramType::Vertex) {
         // Create the default reg uniform buffer
-        std::vector<spv::Id> uniform_composition = { v4, f32, f32, f32, f32, f32 };
+        std::vector<spv::Id> uniform_composition = { v4, f32, f32, f32, f32, f32, b.makeUintType(32) };
         if (features.support_memory_mapping)
             uniform_composition.push_back(buffer_addresses_type);
 
@@ -974,6 +981,7 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
         ADD_VERT_UNIFORM_MEMBER(screen_height);
         ADD_VERT_UNIFORM_MEMBER(z_offset);
         ADD_VERT_UNIFORM_MEMBER(z_scale);
+        ADD_VERT_UNIFORM_MEMBER(rgb_attributes_mask);
         if (features.support_memory_mapping) {
             ADD_VERT_UNIFORM_MEMBER(buffer_addresses);
         }
@@ -1062,6 +1070,7 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
             var_to_reg.offset = input.offset;
             var_to_reg.size = num_comp * 4;
             var_to_reg.dtype = DataType::INT32;
+            var_to_reg.location = location;
             translation_state.var_to_regs.push_back(var_to_reg);
         } else {
             var = b.createVariable(spv::NoPrecision, spv::StorageClassInput, param_type, name.c_str());
@@ -1072,6 +1081,7 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
             var_to_reg.offset = input.offset;
             var_to_reg.size = input.array_size * input.component_count * 4;
             var_to_reg.dtype = input.type;
+            var_to_reg.location = location;
             translation_state.var_to_regs.push_back(var_to_reg);
         }
 
@@ -1251,9 +1261,9 @@ static SpirvShaderParameters create_parameters(spv::Builder &b, const SceGxmProg
 
 static void generate_shader_body(spv::Builder &b, const SpirvShaderParameters &parameters, const SceGxmProgram &program,
     const FeatureState &features, utils::SpirvUtilFunctions &utils, spv::Function *begin_hook_func, spv::Function *end_hook_func,
-    const NonDependentTextureQueryCallInfos &texture_queries, const spv::Id render_info_id) {
+    const NonDependentTextureQueryCallInfos &texture_queries, const TranslationState &translation_state) {
     // Do texture queries
-    usse::convert_gxp_usse_to_spirv(b, program, features, parameters, utils, begin_hook_func, end_hook_func, texture_queries, render_info_id);
+    usse::convert_gxp_usse_to_spirv(b, program, translation_state.hash, features, parameters, utils, begin_hook_func, end_hook_func, texture_queries, translation_state.render_info_id);
 }
 
 static spv::Function *make_frag_finalize_function(spv::Builder &b, const SpirvShaderParameters &parameters,
@@ -1622,6 +1632,43 @@ static void generate_update_mask_body(spv::Builder &b, utils::SpirvUtilFunctions
     b.createStore(mask_v, out);
 }
 
+// The register banks are emulated with private arrays, most of their loads and stores can be removed once they are local to the shader
+static void optimize_spirv(SpirvCode &spirv, const std::string &shader_hash) {
+#ifdef USE_SPIRV_OPT
+    spvtools::Optimizer optimizer(SPV_ENV_UNIVERSAL_1_5);
+    optimizer.SetMessageConsumer([&](spv_message_level_t level, const char *, const spv_position_t &position, const char *message) {
+        if (level <= SPV_MSG_ERROR)
+            LOG_ERROR("SPIR-V optimizer error in shader {} at {}: {}", shader_hash, position.index, message);
+    });
+
+    // the ids are kept, the translation state refers to some of them for the glsl conversion
+    optimizer.RegisterPass(spvtools::CreateWrapOpKillPass())
+        .RegisterPass(spvtools::CreateInlineExhaustivePass())
+        .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+        .RegisterPass(spvtools::CreatePrivateToLocalPass())
+        .RegisterPass(spvtools::CreateScalarReplacementPass())
+        .RegisterPass(spvtools::CreateLocalAccessChainConvertPass())
+        .RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass())
+        .RegisterPass(spvtools::CreateLocalSingleStoreElimPass())
+        .RegisterPass(spvtools::CreateSSARewritePass())
+        .RegisterPass(spvtools::CreateCCPPass())
+        .RegisterPass(spvtools::CreateCopyPropagateArraysPass())
+        .RegisterPass(spvtools::CreateRedundancyEliminationPass())
+        .RegisterPass(spvtools::CreateAggressiveDCEPass())
+        .RegisterPass(spvtools::CreateCFGCleanupPass());
+
+    spvtools::OptimizerOptions options;
+    // the generated shaders are not always valid for the validator even though the drivers accept them
+    options.set_run_validator(false);
+
+    SpirvCode optimized;
+    if (optimizer.Run(spirv.data(), spirv.size(), &optimized, options))
+        spirv = std::move(optimized);
+    else
+        LOG_ERROR("Failed to optimize shader {}, using it as is", shader_hash);
+#endif
+}
+
 static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const std::string &shader_hash, const FeatureState &features, TranslationState &translation_state, bool force_shader_debug, std::function<bool(const std::string &ext, const std::string &dump)> dumper) {
     SpirvCode spirv;
 
@@ -1723,7 +1770,7 @@ static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const s
 
         for (auto &var_to_reg : translation_state.var_to_regs) {
             create_input_variable(b, parameters, utils, features, translation_state, "", var_to_reg.pa ? RegisterBank::PRIMATTR : RegisterBank::SECATTR,
-                var_to_reg.offset, spv::NoResult, var_to_reg.size, var_to_reg.var, var_to_reg.dtype);
+                var_to_reg.offset, spv::NoResult, var_to_reg.size, var_to_reg.var, var_to_reg.dtype, var_to_reg.location);
         }
 
         // Initialize vertex output to 0
@@ -1740,7 +1787,7 @@ static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const s
             });
         }
 
-        generate_shader_body(b, parameters, program, features, utils, begin_hook_func, end_hook_func, texture_queries, translation_state.render_info_id);
+        generate_shader_body(b, parameters, program, features, utils, begin_hook_func, end_hook_func, texture_queries, translation_state);
     } else {
         generate_update_mask_body(b, utils, features, translation_state);
     }
@@ -1762,6 +1809,9 @@ static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const s
 
     b.dump(spirv);
 
+    if (features.optimize_spirv)
+        optimize_spirv(spirv, shader_hash);
+
     if (LOG_SHADER_CODE || force_shader_debug) {
         std::string spirv_dump;
         spirv_disasm_print(spirv, &spirv_dump);
@@ -1860,7 +1910,7 @@ static spv::ImageFormat translate_color_format(const SceGxmColorBaseFormat forma
 // ***************************
 
 GeneratedShader convert_gxp(const SceGxmProgram &program, const std::string &shader_hash, const FeatureState &features, const Target target, const Hints &hints, bool maskupdate,
-    bool force_shader_debug, std::function<bool(const std::string &ext, const std::string &dump)> dumper) {
+    bool force_shader_debug, std::function<bool(const std::string &ext, const std::string &dump)> dumper, TranslationTimings *timings) {
     TranslationState translation_state;
     translation_state.is_fragment = program.is_fragment();
     translation_state.is_maskupdate = maskupdate;
@@ -1874,12 +1924,18 @@ GeneratedShader convert_gxp(const SceGxmProgram &program, const std::string &sha
     }
 
     GeneratedShader shader{};
+    const auto generation_start = std::chrono::steady_clock::now();
     shader.spirv = convert_gxp_to_spirv_impl(program, shader_hash, features, translation_state, force_shader_debug, dumper);
+    const auto generation_end = std::chrono::steady_clock::now();
+    if (timings)
+        timings->spirv_generation = generation_end - generation_start;
 
     if (translation_state.is_target_glsl) {
         // also generate the glsl file
         // this destroys shader.spirv
         shader.glsl = convert_spirv_to_glsl(shader_hash, shader.spirv, features, translation_state, program.is_frag_color_used());
+        if (timings)
+            timings->glsl_conversion = std::chrono::steady_clock::now() - generation_end;
 
         if (LOG_SHADER_CODE || force_shader_debug) {
             LOG_INFO("Generated GLSL:\n{}", shader.glsl);
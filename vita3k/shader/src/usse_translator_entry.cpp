@@ -25,16 +25,41 @@
 #include <shader/usse_translator_types.h>
 #include <util/log.h>
 
+#include <array>
 #include <map>
-#include <optional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace shader::usse {
 
-template <typename Visitor>
-using USSEMatcher = shader::decoder::Matcher<Visitor, uint64_t>;
+// number of high bits of the instructions used to index the dispatch table, the opcode is in the 5 highest ones
+static constexpr int USSE_DISPATCH_BITS = 8;
 
 template <typename V>
-static std::optional<const USSEMatcher<V>> DecodeUSSE(uint64_t instruction) {
+using USSEDispatchTable = std::array<std::vector<const USSEMatcher<V> *>, 1 << USSE_DISPATCH_BITS>;
+
+// list for each value of the high bits the matchers which can match an instruction starting with them
+template <typename V>
+static USSEDispatchTable<V> build_usse_dispatch(const std::vector<USSEMatcher<V>> &table) {
+    constexpr uint64_t high_bits_mask = ~0ULL << (64 - USSE_DISPATCH_BITS);
+
+    USSEDispatchTable<V> dispatch;
+    for (uint64_t high_bits = 0; high_bits < dispatch.size(); high_bits++) {
+        const uint64_t instruction_bits = high_bits << (64 - USSE_DISPATCH_BITS);
+        for (const USSEMatcher<V> &matcher : table) {
+            const uint64_t mask = matcher.GetMask() & high_bits_mask;
+            if ((instruction_bits & mask) == (matcher.GetExpected() & mask))
+                dispatch[high_bits].push_back(&matcher);
+        }
+    }
+
+    return dispatch;
+}
+
+template <typename V>
+static const USSEMatcher<V> *DecodeUSSE(uint64_t instruction) {
     static const std::vector<USSEMatcher<V>> table = {
 #define INST(fn, name, bitstring) shader::decoder::detail::detail<USSEMatcher<V>>::GetMatcher(fn, name, bitstring)
         // clang-format off
@@ -819,10 +844,20 @@ static std::optional<const USSEMatcher<V>> DecodeUSSE(uint64_t instruction) {
     };
 #undef INST
 
-    const auto matches_instruction = [instruction](const auto &matcher) { return matcher.Matches(instruction); };
+    static const auto dispatch = build_usse_dispatch(table);
+
+    // only the matchers which can match the opcode bits of the instruction are tested, in the order of the table
+    for (const USSEMatcher<V> *matcher : dispatch[instruction >> (64 - USSE_DISPATCH_BITS)]) {
+        if (matcher->Matches(instruction))
+            return matcher;
+    }
+
+    return nullptr;
+}
 
-    auto iter = std::find_if(table.begin(), table.end(), matches_instruction);
-    return iter != table.end() ? std::optional<const USSEMatcher<V>>(*iter) : std::nullopt;
+const char *get_instruction_name(uint64_t instruction) {
+    const USSEMatcher<USSETranslatorVisitor> *matcher = DecodeUSSE<USSETranslatorVisitor>(instruction);
+    return matcher ? matcher->GetName() : nullptr;
 }
 
 //
@@ -836,16 +871,14 @@ USSERecompiler::USSERecompiler(spv::Builder &b, const SceGxmProgram &program, co
     , b(b)
     , visitor(b, *this, program, features, utils, cur_instr, parameters, queries, true)
     , end_hook_func(end_hook_func)
-    , tree_block_node(nullptr, 0) {
+    , phase(nullptr) {
 }
 
-void USSERecompiler::reset(const std::uint64_t *_inst, const std::size_t _count) {
+void USSERecompiler::reset(const std::uint64_t *_inst, const DecodedProgram::Phase &_phase) {
     inst = _inst;
-    count = _count;
+    count = _phase.count;
+    phase = &_phase;
     visitor.reset_for_new_session();
-
-    usse::analyze(tree_block_node, static_cast<shader::usse::USSEOffset>(_count - 1),
-        [&](usse::USSEOffset off) -> std::uint64_t { return inst[off]; });
 }
 
 spv::Id USSERecompiler::get_condition_value(const std::uint8_t pred, const bool neg) {
@@ -898,8 +931,8 @@ void USSERecompiler::compile_code_node(const usse::USSECodeNode &code) {
         cur_instr = inst[pc];
 
         // Recompile the instruction, to the current block
-        auto decoder = usse::DecodeUSSE<usse::USSETranslatorVisitor>(cur_instr);
-        if (decoder.has_value())
+        const USSEMatcher<USSETranslatorVisitor> *decoder = phase->decoders[pc];
+        if (decoder)
             decoder->call(visitor, cur_instr);
         else
             LOG_DISASM("{:016x}: error: instruction unmatched", cur_instr);
@@ -1020,7 +1053,7 @@ spv::Function *USSERecompiler::compile_program_function() {
     spv::Function *ret_func = b.makeFunctionEntry(spv::NoPrecision, b.makeVoidType(), sub_name.c_str(), {}, {}, {},
         &new_sub_block);
 
-    compile_block(tree_block_node);
+    compile_block(phase->tree_block_node);
 
     b.leaveFunction();
     b.setBuildPoint(last_build_point);
@@ -1028,43 +1061,83 @@ spv::Function *USSERecompiler::compile_program_function() {
     return ret_func;
 }
 
-void convert_gxp_usse_to_spirv(spv::Builder &b, const SceGxmProgram &program, const FeatureState &features, const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils,
-    spv::Function *begin_hook_func, spv::Function *end_hook_func, const NonDependentTextureQueryCallInfos &queries, const spv::Id render_info_id) {
-    const uint64_t *primary_program = program.primary_program_start();
-    const uint64_t primary_program_instr_count = program.primary_program_instr_count;
+// the decoded programs are never removed, unless there are too many of them
+static constexpr size_t MAX_DECODED_PROGRAMS = 4096;
+
+static std::mutex decoded_programs_mutex;
+static std::unordered_map<std::string, std::shared_ptr<const DecodedProgram>> decoded_programs;
+
+static std::shared_ptr<const DecodedProgram> decode_program(const SceGxmProgram &program, const std::string &shader_hash) {
+    {
+        const std::lock_guard<std::mutex> guard(decoded_programs_mutex);
+        const auto it = decoded_programs.find(shader_hash);
+        if (it != decoded_programs.end() && it->second->program_size == program.size)
+            return it->second;
+    }
 
-    const uint64_t *secondary_program_start = program.secondary_program_start();
-    const uint64_t *secondary_program_end = program.secondary_program_end();
+    auto decoded = std::make_shared<DecodedProgram>();
+    decoded->program_size = program.size;
 
-    std::map<ShaderPhase, std::pair<const std::uint64_t *, std::uint64_t>> shader_code;
+    const std::pair<const std::uint64_t *, std::size_t> shader_code[] = {
+        // Collect instructions of Pixel (primary) phase
+        { program.primary_program_start(), program.primary_program_instr_count },
+        // Collect instructions of Sample rate (secondary) phase
+        { program.secondary_program_start(), program.secondary_program_end() - program.secondary_program_start() }
+    };
+    for (auto phase = 0; phase < (uint32_t)ShaderPhase::Max; ++phase) {
+        const auto [inst, count] = shader_code[phase];
+        DecodedProgram::Phase &decoded_phase = decoded->phases[phase];
+        decoded_phase.count = count;
+        if (count == 0)
+            continue;
+
+        usse::analyze(decoded_phase.tree_block_node, static_cast<shader::usse::USSEOffset>(count - 1),
+            [&](usse::USSEOffset off) -> std::uint64_t { return inst[off]; });
+
+        decoded_phase.decoders.resize(count);
+        for (std::size_t pc = 0; pc < count; pc++)
+            decoded_phase.decoders[pc] = usse::DecodeUSSE<usse::USSETranslatorVisitor>(inst[pc]);
+    }
 
-    // Collect instructions of Pixel (primary) phase
-    shader_code[ShaderPhase::Pixel] = std::make_pair(primary_program, primary_program_instr_count);
+    const std::lock_guard<std::mutex> guard(decoded_programs_mutex);
+    if (decoded_programs.size() >= MAX_DECODED_PROGRAMS)
+        decoded_programs.clear();
+    decoded_programs[shader_hash] = decoded;
+
+    return decoded;
+}
+
+void predecode_program(const SceGxmProgram &program, const std::string &shader_hash) {
+    decode_program(program, shader_hash);
+}
+
+void convert_gxp_usse_to_spirv(spv::Builder &b, const SceGxmProgram &program, const std::string &shader_hash, const FeatureState &features, const SpirvShaderParameters &parameters, utils::SpirvUtilFunctions &utils,
+    spv::Function *begin_hook_func, spv::Function *end_hook_func, const NonDependentTextureQueryCallInfos &queries, const spv::Id render_info_id) {
+    const std::uint64_t *phase_start[] = { program.primary_program_start(), program.secondary_program_start() };
 
-    // Collect instructions of Sample rate (secondary) phase
-    shader_code[ShaderPhase::SampleRate] = std::make_pair(secondary_program_start, secondary_program_end - secondary_program_start);
+    // Decode, or reuse the decoding of another variant of this program
+    const std::shared_ptr<const DecodedProgram> decoded = decode_program(program, shader_hash);
 
     if (begin_hook_func)
         b.createFunctionCall(begin_hook_func, {});
 
-    // Decode and recompile
-    // TODO: Reuse this
+    // Recompile
     usse::USSERecompiler recomp(b, program, features, parameters, utils, end_hook_func, queries, render_info_id);
 
     // Set the program
     recomp.program = &program;
 
     for (auto phase = 0; phase < (uint32_t)ShaderPhase::Max; ++phase) {
-        const auto cur_phase_code = shader_code[(ShaderPhase)phase];
+        const DecodedProgram::Phase &cur_phase = decoded->phases[phase];
 
-        if (cur_phase_code.second != 0) {
+        if (cur_phase.count != 0) {
             if (static_cast<ShaderPhase>(phase) == ShaderPhase::SampleRate) {
                 recomp.visitor.set_secondary_program(true);
             } else {
                 recomp.visitor.set_secondary_program(false);
             }
 
-            recomp.reset(cur_phase_code.first, cur_phase_code.second);
+            recomp.reset(phase_start[phase], cur_phase);
             b.createFunctionCall(recomp.compile_program_function(), {});
         }
     }
@@ -0,0 +1,34 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gtest/gtest.h>
+#include <shader/usse_translator_entry.h>
+
+using namespace shader;
+
+TEST(usse_decoder, first_matching_format) {
+    // the high bits are not enough to decode these, the other formats starting with the same opcode are tested in the order of the table
+    EXPECT_STREQ(usse::get_instruction_name(0xF800000000000000ULL | (0b101ULL << 38)), "NOP ()");
+    EXPECT_STREQ(usse::get_instruction_name(0xF800000000000000ULL), "BR ()");
+    EXPECT_STREQ(usse::get_instruction_name(0xE000000000000000ULL), "SMP ()");
+    // VLDST only has 3 bits of opcode
+    EXPECT_STREQ(usse::get_instruction_name(0xE800000000000000ULL), "VLDST ()");
+    EXPECT_STREQ(usse::get_instruction_name(0xB000000000000000ULL), "ILLEGAL22 ()");
+    // I32MAD expects some bits to be 0
+    EXPECT_STREQ(usse::get_instruction_name(0xA800000000000000ULL), "I32MAD ()");
+    EXPECT_EQ(usse::get_instruction_name(0xA800000000000000ULL | (1ULL << 47)), nullptr);
+}
@@ -0,0 +1,112 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Job run by a JobPool, the submitter keeps it to know when it is done
+class Job {
+public:
+    explicit Job(std::function<void()> func)
+        : func(std::move(func)) {}
+
+    bool is_done() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+    void wait() const {
+        while (!done.load(std::memory_order_acquire))
+            done.wait(false);
+    }
+
+private:
+    friend class JobPool;
+
+    std::function<void()> func;
+    std::atomic<bool> done = false;
+};
+
+typedef std::shared_ptr<Job> JobPtr;
+
+// Fixed set of worker threads running the submitted jobs in order.
+// The remaining jobs are still run before the pool is destroyed
+class JobPool {
+public:
+    explicit JobPool(uint32_t thread_count) {
+        for (uint32_t i = 0; i < thread_count; i++)
+            workers.emplace_back([this]() { worker_function(); });
+    }
+
+    JobPool(const JobPool &) = delete;
+    JobPool &operator=(const JobPool &) = delete;
+
+    ~JobPool() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    JobPtr submit(std::function<void()> func) {
+        JobPtr job = std::make_shared<Job>(std::move(func));
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        cond.notify_one();
+        return job;
+    }
+
+private:
+    void worker_function() {
+        while (true) {
+            JobPtr job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job->func();
+            job->func = nullptr;
+            job->done.store(true, std::memory_order_release);
+            job->done.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<JobPtr> jobs;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
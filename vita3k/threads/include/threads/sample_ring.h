@@ -0,0 +1,63 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Last samples of an input, pushed by a single sampling thread and read without lock by the guest threads.
+// The oldest samples are overwritten once the ring is full, a reader never blocks the sampling thread.
+template <typename Sample, uint32_t Capacity>
+struct SampleRing {
+    static constexpr uint32_t CAPACITY = Capacity;
+
+    std::array<Sample, CAPACITY> samples;
+    // number of samples pushed, the slot of a sample is its index modulo the capacity
+    std::atomic<uint64_t> head = 0;
+    // index of the next sample returned by the reads which consume the samples
+    std::atomic<uint64_t> read_head = 0;
+
+    // Sampling thread only
+    void push(const Sample &sample) {
+        const uint64_t index = head.load(std::memory_order_relaxed);
+        samples[index % CAPACITY] = sample;
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    // Copies the newest samples pushed from the index first, at most count of them, oldest first.
+    // The slots can be overwritten while they are copied, the samples that may have been are dropped
+    int copy(uint64_t first, int count, Sample *out, uint64_t &copied_head) const {
+        copied_head = head.load(std::memory_order_acquire);
+        first = std::max<uint64_t>(first, copied_head - std::min<uint64_t>(copied_head, count));
+
+        for (uint64_t index = first; index < copied_head; index++)
+            out[index - first] = samples[index % CAPACITY];
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t new_head = head.load(std::memory_order_relaxed);
+        const uint64_t oldest_valid = new_head - std::min<uint64_t>(new_head, CAPACITY - 1);
+        if (first >= oldest_valid)
+            return static_cast<int>(copied_head - first);
+
+        const uint64_t dropped = std::min(oldest_valid, copied_head) - first;
+        std::copy(out + dropped, out + (copied_head - first), out);
+        return static_cast<int>(copied_head - std::min(oldest_valid, copied_head));
+    }
+};
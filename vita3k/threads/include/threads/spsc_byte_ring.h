@@ -0,0 +1,95 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+// Bounded lock-free byte queue between exactly one producer thread and one consumer thread.
+// The storage is allocated once, write and read never allocate, lock nor wait: they move as many bytes as they can.
+class SPSCByteRing {
+public:
+    explicit SPSCByteRing(size_t capacity)
+        : storage(std::make_unique<uint8_t[]>(capacity))
+        , capacity(capacity) {}
+
+    SPSCByteRing(const SPSCByteRing &) = delete;
+    SPSCByteRing &operator=(const SPSCByteRing &) = delete;
+
+    // Producer only, returns the number of bytes written
+    size_t write(const void *data, size_t size) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        size = std::min(size, capacity - (head - tail));
+
+        const size_t offset = head % capacity;
+        const size_t first_part = std::min(size, capacity - offset);
+        std::memcpy(&storage[offset], data, first_part);
+        std::memcpy(&storage[0], static_cast<const uint8_t *>(data) + first_part, size - first_part);
+
+        head_.store(head + size, std::memory_order_release);
+        return size;
+    }
+
+    // Consumer only, returns the number of bytes read
+    size_t read(void *data, size_t size) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        size = std::min(size, head - tail);
+
+        const size_t offset = tail % capacity;
+        const size_t first_part = std::min(size, capacity - offset);
+        std::memcpy(data, &storage[offset], first_part);
+        std::memcpy(static_cast<uint8_t *>(data) + first_part, &storage[0], size - first_part);
+
+        tail_.store(tail + size, std::memory_order_release);
+        return size;
+    }
+
+    // Consumer only, drops the oldest bytes without copying them, returns the number of bytes dropped
+    size_t discard(size_t size) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        size = std::min(size, head - tail);
+
+        tail_.store(tail + size, std::memory_order_release);
+        return size;
+    }
+
+    // Can be called from any thread, the result may be outdated as soon as it is returned
+    size_t size() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return head_.load(std::memory_order_acquire) - tail;
+    }
+
+    size_t free_space() const {
+        return capacity - size();
+    }
+
+private:
+    std::unique_ptr<uint8_t[]> storage;
+    const size_t capacity;
+
+    // Written by the producer, the total number of bytes written
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    // Written by the consumer, the total number of bytes read
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+};
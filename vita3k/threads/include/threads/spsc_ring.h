@@ -0,0 +1,107 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+// Items are stored in place, push and pop never allocate nor lock. A side only parks
+// (with an atomic wait) when the ring is full for the producer or empty for the consumer.
+template <typename T, uint32_t Capacity>
+class SPSCRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+    SPSCRing() = default;
+    SPSCRing(const SPSCRing &) = delete;
+    SPSCRing &operator=(const SPSCRing &) = delete;
+
+    // Producer only, waits as long as the ring is full
+    void push(const T &item) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail == Capacity) {
+            producer_waiting_.store(true);
+            while ((tail = tail_.load()) + Capacity == head)
+                tail_.wait(tail);
+            producer_waiting_.store(false, std::memory_order_relaxed);
+        }
+
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1);
+        if (consumer_waiting_.load())
+            head_.notify_one();
+    }
+
+    // Consumer only, waits for an item as long as the ring is empty.
+    // The item stays valid until pop is called
+    T *top() {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (head == tail) {
+            consumer_waiting_.store(true);
+            while ((head = head_.load()) == tail)
+                head_.wait(head);
+            consumer_waiting_.store(false, std::memory_order_relaxed);
+        }
+
+        return &items_[tail & (Capacity - 1)];
+    }
+
+    // Consumer only, returns null if no item was pushed before the timeout.
+    // Atomic waits can't time out, so this one polls
+    T *top(const std::chrono::microseconds timeout) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            do {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return nullptr;
+                std::this_thread::yield();
+            } while (head_.load(std::memory_order_acquire) == tail);
+        }
+
+        return &items_[tail & (Capacity - 1)];
+    }
+
+    // Consumer only, removes the item returned by top
+    void pop() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1);
+        if (producer_waiting_.load())
+            tail_.notify_one();
+    }
+
+    // Can be called from any thread, the result may be outdated as soon as it is returned
+    uint32_t size() const {
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        return head_.load(std::memory_order_acquire) - tail;
+    }
+
+private:
+    // Written by the producer, the index of the next item to push
+    alignas(64) std::atomic<uint32_t> head_{ 0 };
+    std::atomic<bool> consumer_waiting_{ false };
+    // Written by the consumer, the index of the next item to pop
+    alignas(64) std::atomic<uint32_t> tail_{ 0 };
+    std::atomic<bool> producer_waiting_{ false };
+    alignas(64) std::array<T, Capacity> items_{};
+};
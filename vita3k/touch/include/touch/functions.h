@@ -3,7 +3,9 @@
 #include <emuenv/state.h>
 #include <touch/touch.h>
 
-void touch_vsync_update(const EmuEnvState &emuenv);
+void touch_vsync_update(EmuEnvState &emuenv);
+// samples both panels, called by the controllers sampling thread once it sets the sampling period of the touch state
+void touch_sample(EmuEnvState &emuenv);
 int handle_touch_event(SDL_TouchFingerEvent &finger);
 int toggle_touchscreen();
 int touch_get(const SceUID thread_id, EmuEnvState &emuenv, const SceUInt32 &port, SceTouchData *pData, SceUInt32 count, bool is_peek);
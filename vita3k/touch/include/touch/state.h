@@ -1,7 +1,17 @@
 #pragma once
 
+#include <threads/sample_ring.h>
 #include <touch/touch.h>
 
+#include <array>
+#include <atomic>
+
+// last data of a panel, pushed at each vblank or by the controllers sampling thread and read without lock by the guest threads
+typedef SampleRing<SceTouchData, 64> TouchSampleRing;
+
 struct TouchState {
     SceTouchSamplingState touch_mode[2] = { SCE_TOUCH_SAMPLING_STATE_STOP, SCE_TOUCH_SAMPLING_STATE_STOP };
+    std::array<TouchSampleRing, SCE_TOUCH_PORT_MAX_NUM> samples;
+    // period of the controllers sampling thread, 0 while the panels are sampled at each vblank instead
+    std::atomic<uint32_t> sampling_period_us = 0;
 };
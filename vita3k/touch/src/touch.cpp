@@ -25,12 +25,10 @@
 
 #include <SDL_events.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
-
-constexpr int MAX_TOUCH_BUFFER_SAVED = 64;
-
-static SceTouchData touch_buffers[MAX_TOUCH_BUFFER_SAVED][2];
-int touch_buffer_idx = 0;
+#include <thread>
 
 static uint64_t timestamp;
 static SDL_TouchFingerEvent finger_buffer[8];
@@ -39,7 +37,6 @@ static long int finger_id_ref;
 static auto touchscreen_port = SCE_TOUCH_PORT_FRONT;
 static bool is_touched[2] = { false, false };
 static int curr_touch_id[2] = { 0, 0 };
-static uint64_t last_vcount[2] = { 0, 0 };
 static bool forceTouchEnabled[2] = { false, false };
 
 static SceTouchData recover_touch_events() {
@@ -63,7 +60,7 @@ static SceTouchData recover_touch_events() {
     return touch_data;
 }
 
-void touch_vsync_update(const EmuEnvState &emuenv) {
+static void sample_touch(EmuEnvState &emuenv) {
     SceIVector2 touch_pos_window = { 0, 0 };
     const uint32_t buttons = SDL_GetMouseState(&touch_pos_window.x, &touch_pos_window.y);
 
@@ -72,7 +69,8 @@ void touch_vsync_update(const EmuEnvState &emuenv) {
 
     for (int port = 0; port < 2; port++) {
         // do it for both the front and the back touchscreen
-        SceTouchData *data = &touch_buffers[(touch_buffer_idx + 1) % MAX_TOUCH_BUFFER_SAVED][port];
+        SceTouchData sample;
+        SceTouchData *data = &sample;
         memset(data, 0, sizeof(SceTouchData));
         data->timeStamp = timestamp;
 
@@ -122,10 +120,19 @@ void touch_vsync_update(const EmuEnvState &emuenv) {
         } else {
             is_touched[port] = false;
         }
+
+        emuenv.touch.samples[port].push(sample);
     }
+}
+
+void touch_vsync_update(EmuEnvState &emuenv) {
+    // the panels are sampled more often by the controllers sampling thread when it runs
+    if (emuenv.touch.sampling_period_us == 0)
+        sample_touch(emuenv);
+}
 
-    touch_buffer_idx++;
-    touch_buffer_idx %= MAX_TOUCH_BUFFER_SAVED;
+void touch_sample(EmuEnvState &emuenv) {
+    sample_touch(emuenv);
 }
 
 int handle_touch_event(SDL_TouchFingerEvent &finger) {
@@ -187,25 +194,41 @@ int toggle_touchscreen() {
 int touch_get(const SceUID thread_id, EmuEnvState &emuenv, const SceUInt32 &port, SceTouchData *pData, SceUInt32 count, bool is_peek) {
     memset(pData, 0, sizeof(SceTouchData) * count);
     const int port_idx = static_cast<int>(port);
-
-    int nb_returned_data = 1;
-    if (is_peek) {
-        if (emuenv.touch.touch_mode[port])
-            nb_returned_data = count;
-        else
-            nb_returned_data = 0;
-    } else {
-        uint64_t vblank_count = emuenv.display.vblank_count;
-        if (vblank_count <= last_vcount[port_idx]) {
-            // sceTouchRead is blocking, wait for the next vsync for the buffer to be updated
-            auto thread = emuenv.kernel.get_thread(thread_id);
-
-            wait_vblank(emuenv.display, emuenv.kernel, thread, last_vcount[port_idx] + 1, false);
-            vblank_count = emuenv.display.vblank_count;
+    if (count == 0)
+        return 0;
+
+    TouchState &state = emuenv.touch;
+    TouchSampleRing &ring = state.samples[port_idx];
+    const int max_count = std::clamp<int>(count, 1, TouchSampleRing::CAPACITY - 1);
+    if (is_peek && !state.touch_mode[port])
+        return 0;
+
+    uint64_t head = 0;
+    int nb_returned_data = 0;
+    if (!is_peek) {
+        // sceTouchRead is blocking, wait for the next sample if all of them were read
+        const uint64_t first = ring.read_head.load();
+        if (ring.head.load(std::memory_order_acquire) <= first) {
+            const uint32_t sampling_period_us = state.sampling_period_us;
+            if (sampling_period_us == 0) {
+                auto thread = emuenv.kernel.get_thread(thread_id);
+                wait_vblank(emuenv.display, emuenv.kernel, thread, emuenv.display.vblank_count + 1, false);
+            } else {
+                // don't wait longer than two periods to not stall the guest on a stalled thread
+                const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(sampling_period_us * 2);
+                while ((ring.head.load(std::memory_order_acquire) <= first) && (std::chrono::steady_clock::now() < deadline))
+                    std::this_thread::sleep_for(std::chrono::microseconds(sampling_period_us / 4 + 1));
+            }
         }
-        nb_returned_data = std::min<int>(count, emuenv.display.vblank_count - last_vcount[port_idx]);
-        last_vcount[port_idx] = emuenv.display.vblank_count;
+        nb_returned_data = ring.copy(first, max_count, pData, head);
+        ring.read_head.store(head);
     }
+    // peeking gives the newest samples, as does a read finding none after its wait
+    if (nb_returned_data == 0)
+        nb_returned_data = ring.copy(0, is_peek ? max_count : 1, pData, head);
+    // nothing was sampled yet
+    if (nb_returned_data == 0)
+        return is_peek ? 0 : 1;
 
     if (registered_touch() && port == touchscreen_port) {
         // less accurate implementation, but which is able to take a real touchscreen as the input
@@ -218,26 +241,10 @@ int touch_get(const SceUID thread_id, EmuEnvState &emuenv, const SceUInt32 &port
                 }
             }
         }
-    } else {
-        int corr_buffer_idx;
-        if (is_peek) {
-            corr_buffer_idx = touch_buffer_idx;
-        } else {
-            // give the oldest buffer first
-            corr_buffer_idx = (touch_buffer_idx - nb_returned_data + 1 + MAX_TOUCH_BUFFER_SAVED) % MAX_TOUCH_BUFFER_SAVED;
-        }
+    } else if (forceTouchEnabled[port_idx]) {
         for (int32_t i = 0; i < nb_returned_data; i++) {
-            memcpy(&pData[i], &touch_buffers[corr_buffer_idx][port_idx], sizeof(SceTouchData));
-            if (forceTouchEnabled[port_idx]) {
-                for (int32_t j = 0; j < pData[i].reportNum; j++) {
-                    pData[i].report[j].force = 128;
-                }
-            }
-            // if peek, repeat the last buffer
-            if (!is_peek) {
-                corr_buffer_idx++;
-                corr_buffer_idx %= MAX_TOUCH_BUFFER_SAVED;
-            }
+            for (uint32_t j = 0; j < pData[i].reportNum; j++)
+                pData[i].report[j].force = 128;
         }
     }
 
@@ -0,0 +1,94 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace util {
+
+// Stable merge sort of count elements seen through their index, for comparisons that are much cheaper when
+// many of them are done together (like guest callbacks). compare(a, b, result) queues the comparison of the
+// elements a and b, writing a value less than, equal to or greater than zero in result as strcmp does,
+// and flush() runs the queued comparisons. The results are only read after a flush.
+// The merges of the same width are advanced together, each pass queues one comparison for each of them,
+// so the elements are sorted with about 2 * count flushes. Returns the indices of the elements in order.
+template <typename Compare, typename Flush>
+std::vector<uint32_t> batched_merge_sort(uint32_t count, Compare &&compare, Flush &&flush) {
+    struct Merge {
+        uint32_t left;
+        uint32_t left_end;
+        uint32_t right;
+        uint32_t right_end;
+        uint32_t out;
+        int32_t result;
+    };
+
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint32_t> merged(count);
+    std::vector<Merge> merges;
+    std::vector<uint32_t> active;
+
+    for (uint64_t width = 1; width < count; width *= 2) {
+        merges.clear();
+        active.clear();
+        for (uint64_t start = 0; start < count; start += width * 2) {
+            const auto middle = static_cast<uint32_t>(std::min<uint64_t>(start + width, count));
+            const auto end = static_cast<uint32_t>(std::min<uint64_t>(start + width * 2, count));
+            active.push_back(static_cast<uint32_t>(merges.size()));
+            merges.push_back({ static_cast<uint32_t>(start), middle, middle, end, static_cast<uint32_t>(start), 0 });
+        }
+
+        while (true) {
+            // the merges with a side done only have to copy the other one
+            std::erase_if(active, [&](uint32_t index) {
+                Merge &merge = merges[index];
+                if ((merge.left == merge.left_end) || (merge.right == merge.right_end)) {
+                    const auto out = std::copy(order.begin() + merge.left, order.begin() + merge.left_end, merged.begin() + merge.out);
+                    std::copy(order.begin() + merge.right, order.begin() + merge.right_end, out);
+                    return true;
+                }
+
+                compare(order[merge.left], order[merge.right], &merge.result);
+                return false;
+            });
+            if (active.empty())
+                break;
+
+            flush();
+            for (const uint32_t index : active) {
+                Merge &merge = merges[index];
+                // equal elements are taken from the left side first to keep the sort stable
+                if (merge.result <= 0)
+                    merged[merge.out++] = order[merge.left++];
+                else
+                    merged[merge.out++] = order[merge.right++];
+            }
+        }
+
+        std::swap(order, merged);
+    }
+
+    return order;
+}
+
+} // namespace util
@@ -0,0 +1,60 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+#include <threads/job_pool.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace util {
+
+// Stages of the emulator startup, each one is timed and logged once it is done.
+// With fast boot, the stages started with run are run on other threads at the same time,
+// otherwise every stage is run right away by the calling thread
+class BootStages {
+public:
+    explicit BootStages(bool fast_boot);
+    // Waits for the stages still running
+    ~BootStages();
+
+    BootStages(const BootStages &) = delete;
+    BootStages &operator=(const BootStages &) = delete;
+
+    // Start a stage which doesn't need the calling thread, it must only use what the other stages don't modify
+    void run(const char *name, std::function<void()> stage);
+    // Run a stage on the calling thread, used for the ones touching the window or the renderer
+    void run_here(const char *name, const std::function<void()> &stage);
+    // Wait for all the stages started with run
+    void wait();
+
+    bool is_parallel() const {
+        return pool != nullptr;
+    }
+
+private:
+    // time at which the first of the stages running was started
+    std::chrono::steady_clock::time_point start;
+    std::unique_ptr<JobPool> pool;
+    std::vector<JobPtr> jobs;
+};
+
+} // namespace util
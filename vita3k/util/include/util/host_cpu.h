@@ -0,0 +1,79 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace util {
+
+// Logical cpu of the host
+struct HostCpu {
+    uint32_t index;
+    // Logical cpus of the same physical core (SMT siblings) have the same core
+    uint32_t core;
+    // Efficiency cores of hybrid cpus have a lower performance class than performance cores
+    uint32_t performance_class;
+};
+
+std::vector<HostCpu> get_host_cpus();
+
+// Pins the calling thread to the logical cpus set in mask (bit i for the cpu of index i).
+// Returns false if it failed or is not supported by the host
+bool set_current_thread_affinity(uint64_t mask);
+
+// Clock of the CPU time used by a host thread, got by the thread itself and read from any thread
+class ThreadCpuClock {
+public:
+    ThreadCpuClock() = default;
+    ~ThreadCpuClock();
+
+    ThreadCpuClock(ThreadCpuClock &&other) noexcept;
+    ThreadCpuClock &operator=(ThreadCpuClock &&other) noexcept;
+    ThreadCpuClock(const ThreadCpuClock &) = delete;
+    ThreadCpuClock &operator=(const ThreadCpuClock &) = delete;
+
+    // Clock of the calling thread
+    static ThreadCpuClock current();
+
+    // CPU time used by the thread in microseconds (user and kernel),
+    // 0 if the clock is not supported by the host or the thread has exited
+    uint64_t get_time_us() const;
+
+private:
+    // clock id, thread port or thread handle depending on the host
+    uint64_t handle = 0;
+    bool valid = false;
+};
+
+constexpr size_t GUEST_CORE_COUNT = 4;
+
+// Logical cpus each kind of thread is pinned to. A null mask leaves the threads to the OS scheduler
+struct HostCorePinning {
+    std::array<uint64_t, GUEST_CORE_COUNT> guest_cores{};
+    uint64_t renderer = 0;
+    uint64_t audio = 0;
+};
+
+// policy is "off", "auto", or the host cpus of the guest cores 0 to 3, of the renderer then of the audio threads,
+// separated by commas, where each entry can join several cpus with '+' (ex: "2,4,6,8,10+11,1")
+HostCorePinning get_host_core_pinning(const std::string &policy, const std::vector<HostCpu> &cpus);
+
+} // namespace util
@@ -17,12 +17,16 @@
 
 #pragma once
 
+// The levels below this one are removed at compile time, the build sets it with VITA3K_LOG_ACTIVE_LEVEL
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 
 #include <spdlog/spdlog.h>
 #include <util/exit_code.h>
 #include <util/fs.h>
 
+#include <atomic>
 #include <type_traits>
 
 #include <iomanip>
@@ -36,11 +40,77 @@ ExitCode init(const Root &root_paths, bool use_stdout);
 void set_level(spdlog::level::level_enum log_level);
 ExitCode add_sink(const fs::path &log_path);
 
-#define LOG_TRACE SPDLOG_TRACE
-#define LOG_DEBUG SPDLOG_DEBUG
-#define LOG_INFO SPDLOG_INFO
-#define LOG_WARN SPDLOG_WARN
-#define LOG_ERROR SPDLOG_ERROR
+// Lets a burst of messages through each second, used by the LOG_*_LIMITED macros so that a call site can't flood the log
+class RateLimiter {
+    std::atomic<int64_t> window_start = 0;
+    std::atomic<uint32_t> count = 0;
+    std::atomic<uint32_t> dropped = 0;
+
+public:
+    // true if the message can be logged, dropped_count is then the number of messages dropped since the last one logged
+    bool allow(uint32_t &dropped_count);
+};
+
+// The arguments are only evaluated if the level is enabled, they often build strings
+#define LOG_IF_ENABLED(level, log_macro, ...)                \
+    do {                                                     \
+        if (spdlog::default_logger_raw()->should_log(level)) \
+            log_macro(__VA_ARGS__);                          \
+    } while (0)
+
+#define LOG_LIMITED(level, log_macro, ...)                                                  \
+    do {                                                                                    \
+        if (!spdlog::default_logger_raw()->should_log(level))                               \
+            break;                                                                          \
+        static logging::RateLimiter log_rate_limiter;                                       \
+        uint32_t log_dropped_count;                                                         \
+        if (log_rate_limiter.allow(log_dropped_count)) {                                    \
+            if (log_dropped_count)                                                          \
+                log_macro("{} messages were dropped by the rate limit", log_dropped_count); \
+            log_macro(__VA_ARGS__);                                                         \
+        }                                                                                   \
+    } while (0)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_IF_ENABLED(spdlog::level::trace, SPDLOG_TRACE, __VA_ARGS__)
+#define LOG_TRACE_LIMITED(...) LOG_LIMITED(spdlog::level::trace, SPDLOG_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) (void)0
+#define LOG_TRACE_LIMITED(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_IF_ENABLED(spdlog::level::debug, SPDLOG_DEBUG, __VA_ARGS__)
+#define LOG_DEBUG_LIMITED(...) LOG_LIMITED(spdlog::level::debug, SPDLOG_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) (void)0
+#define LOG_DEBUG_LIMITED(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_IF_ENABLED(spdlog::level::info, SPDLOG_INFO, __VA_ARGS__)
+#define LOG_INFO_LIMITED(...) LOG_LIMITED(spdlog::level::info, SPDLOG_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) (void)0
+#define LOG_INFO_LIMITED(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_IF_ENABLED(spdlog::level::warn, SPDLOG_WARN, __VA_ARGS__)
+#define LOG_WARN_LIMITED(...) LOG_LIMITED(spdlog::level::warn, SPDLOG_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) (void)0
+#define LOG_WARN_LIMITED(...) (void)0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_IF_ENABLED(spdlog::level::err, SPDLOG_ERROR, __VA_ARGS__)
+#define LOG_ERROR_LIMITED(...) LOG_LIMITED(spdlog::level::err, SPDLOG_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) (void)0
+#define LOG_ERROR_LIMITED(...) (void)0
+#endif
+
 #define LOG_CRITICAL SPDLOG_CRITICAL
 
 #define LOG_TRACE_IF(flag, ...) \
@@ -0,0 +1,107 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#pragma once
+
+// Tracy zones which can be switched at runtime by subsystem. When the subsystem of a zone is not enabled, the zone is
+// reduced to the test of one bit of a global mask, so the builds made with Tracy can keep their instrumentation
+// without slowing down the users who are not profiling.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum TracySubsystem : uint32_t {
+    TRACY_SUBSYSTEM_KERNEL = 1 << 0,
+    TRACY_SUBSYSTEM_GXM = 1 << 1,
+    TRACY_SUBSYSTEM_NGS = 1 << 2,
+    TRACY_SUBSYSTEM_IO = 1 << 3,
+    TRACY_SUBSYSTEM_RENDERER = 1 << 4,
+    // the other HLE modules
+    TRACY_SUBSYSTEM_OTHER = 1 << 5,
+};
+
+struct TracySubsystemName {
+    TracySubsystem subsystem;
+    const char *name;
+};
+
+// names of the subsystems in the config and the settings
+inline constexpr TracySubsystemName tracy_subsystem_names[] = {
+    { TRACY_SUBSYSTEM_KERNEL, "kernel" },
+    { TRACY_SUBSYSTEM_GXM, "gxm" },
+    { TRACY_SUBSYSTEM_NGS, "ngs" },
+    { TRACY_SUBSYSTEM_IO, "io" },
+    { TRACY_SUBSYSTEM_RENDERER, "renderer" },
+    { TRACY_SUBSYSTEM_OTHER, "other" },
+};
+
+// subsystems whose zones are recorded, read with a relaxed load by every zone
+inline std::atomic<uint32_t> tracy_enabled_subsystems = 0;
+
+inline bool is_tracy_subsystem_enabled(uint32_t subsystem) {
+    return (tracy_enabled_subsystems.load(std::memory_order_relaxed) & subsystem) != 0;
+}
+
+// subsystem of a module available for advanced profiling
+inline TracySubsystem get_tracy_module_subsystem(std::string_view module) {
+    if (module == "Renderer commands")
+        return TRACY_SUBSYSTEM_RENDERER;
+    if (module == "SceGxm")
+        return TRACY_SUBSYSTEM_GXM;
+    if (module == "SceNgs")
+        return TRACY_SUBSYSTEM_NGS;
+    if ((module == "SceIofilemgr") || module.starts_with("SceFios2"))
+        return TRACY_SUBSYSTEM_IO;
+    if (module.starts_with("SceKernel") || module.starts_with("SceThreadmgr") || (module == "SceLibKernel") || (module == "SceSysmem")
+        || (module == "SceModulemgr") || (module == "SceProcessmgr") || (module == "SceDmacmgr"))
+        return TRACY_SUBSYSTEM_KERNEL;
+    return TRACY_SUBSYSTEM_OTHER;
+}
+
+// enable the subsystems listed by name and the ones of the modules enabled for advanced profiling, which would not log
+// their calls otherwise
+inline void update_tracy_subsystems(const std::vector<std::string> &subsystems, const std::vector<std::string> &advanced_profiling_modules) {
+    uint32_t mask = 0;
+    for (const TracySubsystemName &subsystem : tracy_subsystem_names) {
+        if (std::find(subsystems.begin(), subsystems.end(), subsystem.name) != subsystems.end())
+            mask |= subsystem.subsystem;
+    }
+    for (const std::string &module : advanced_profiling_modules)
+        mask |= get_tracy_module_subsystem(module);
+
+    tracy_enabled_subsystems.store(mask, std::memory_order_relaxed);
+}
+
+#ifdef TRACY_ENABLE
+
+#include "public/tracy/Tracy.hpp"
+
+// scoped zone recorded only when its subsystem (TRACY_SUBSYSTEM_<subsystem>) is enabled
+#define TRACY_ZONE(subsystem, name) ZoneNamedN(___tracy_scoped_zone, name, is_tracy_subsystem_enabled(TRACY_SUBSYSTEM_##subsystem))
+#define TRACY_ZONE_C(subsystem, name, color) ZoneNamedNC(___tracy_scoped_zone, name, color, is_tracy_subsystem_enabled(TRACY_SUBSYSTEM_##subsystem))
+
+#else
+
+#define TRACY_ZONE(subsystem, name)
+#define TRACY_ZONE_C(subsystem, name, color)
+
+#endif // TRACY_ENABLE
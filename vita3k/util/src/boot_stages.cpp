@@ -0,0 +1,72 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+
+#include <util/boot_stages.h>
+#include <util/log.h>
+
+#include <algorithm>
+
+namespace util {
+
+static void run_timed(const char *name, const std::function<void()> &stage) {
+    const auto stage_start = std::chrono::steady_clock::now();
+    stage();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stage_start);
+    LOG_INFO("Boot stage {} done in {:.2f} ms", name, elapsed.count() / 1000.0);
+}
+
+BootStages::BootStages(bool fast_boot) {
+    // the stages are mostly waiting for the disk, a few threads are enough to overlap them
+    if (fast_boot)
+        pool = std::make_unique<JobPool>(std::clamp(std::thread::hardware_concurrency() / 2, 2u, 4u));
+}
+
+BootStages::~BootStages() {
+    wait();
+}
+
+void BootStages::run(const char *name, std::function<void()> stage) {
+    if (!pool) {
+        run_timed(name, stage);
+        return;
+    }
+
+    if (jobs.empty())
+        start = std::chrono::steady_clock::now();
+    jobs.push_back(pool->submit([name, stage = std::move(stage)]() {
+        run_timed(name, stage);
+    }));
+}
+
+void BootStages::run_here(const char *name, const std::function<void()> &stage) {
+    run_timed(name, stage);
+}
+
+void BootStages::wait() {
+    if (jobs.empty())
+        return;
+
+    for (const JobPtr &job : jobs)
+        job->wait();
+    jobs.clear();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    LOG_INFO("Boot stages finished {:.2f} ms after they were started", elapsed.count() / 1000.0);
+}
+
+} // namespace util
@@ -0,0 +1,299 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/host_cpu.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+namespace util {
+
+#ifdef __linux__
+static std::string read_cpu_file(const std::string &path) {
+    std::ifstream file(path);
+    std::string content;
+    std::getline(file, content);
+    return content;
+}
+
+// Parses a cpu list of sysfs, like "0-7,16"
+static std::vector<uint32_t> parse_cpu_list(const std::string &list) {
+    std::vector<uint32_t> cpus;
+    for (const std::string &range : string_utils::split_string(list, ',')) {
+        const size_t dash = range.find('-');
+        try {
+            const uint32_t first = std::stoul(range.substr(0, dash));
+            const uint32_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (uint32_t cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } catch (...) {
+            break;
+        }
+    }
+    return cpus;
+}
+#endif
+
+std::vector<HostCpu> get_host_cpus() {
+    std::vector<HostCpu> cpus;
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+    std::vector<uint8_t> buffer(length);
+    if (!GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+        return cpus;
+
+    uint32_t core = 0;
+    for (size_t offset = 0; offset < length; core++) {
+        const auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(&buffer[offset]);
+        // Only the cpus of the first processor group can be pinned with a thread affinity mask
+        if (info->Processor.GroupMask[0].Group == 0) {
+            const KAFFINITY mask = info->Processor.GroupMask[0].Mask;
+            for (uint32_t index = 0; index < sizeof(KAFFINITY) * 8; index++) {
+                if (mask & (static_cast<KAFFINITY>(1) << index))
+                    cpus.push_back({ index, core, info->Processor.EfficiencyClass });
+            }
+        }
+        offset += info->Size;
+    }
+#elif defined(__linux__)
+    // Intel hybrid cpus list their performance cores in cpu_core, other hybrid cpus give a capacity to every cpu
+    const std::vector<uint32_t> performance_cpus = parse_cpu_list(read_cpu_file("/sys/devices/cpu_core/cpus"));
+    std::map<std::pair<std::string, std::string>, uint32_t> cores;
+    const long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+    for (uint32_t index = 0; index < static_cast<uint32_t>(std::max(cpu_count, 0L)); index++) {
+        const std::string cpu_path = "/sys/devices/system/cpu/cpu" + std::to_string(index);
+        const std::string package_id = read_cpu_file(cpu_path + "/topology/physical_package_id");
+        const std::string core_id = read_cpu_file(cpu_path + "/topology/core_id");
+        const auto core = cores.emplace(std::make_pair(package_id, core_id.empty() ? std::to_string(index) : core_id), static_cast<uint32_t>(cores.size())).first->second;
+
+        uint32_t performance_class = 0;
+        if (!performance_cpus.empty()) {
+            performance_class = std::find(performance_cpus.begin(), performance_cpus.end(), index) != performance_cpus.end();
+        } else {
+            const std::string capacity = read_cpu_file(cpu_path + "/cpu_capacity");
+            if (!capacity.empty())
+                performance_class = static_cast<uint32_t>(std::strtoul(capacity.c_str(), nullptr, 10));
+        }
+
+        cpus.push_back({ index, core, performance_class });
+    }
+#else
+    for (uint32_t index = 0; index < std::thread::hardware_concurrency(); index++)
+        cpus.push_back({ index, index, 0 });
+#endif
+
+    return cpus;
+}
+
+bool set_current_thread_affinity(uint64_t mask) {
+    if (mask == 0)
+        return false;
+
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask)) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t index = 0; index < 64; index++) {
+        if (mask & (1ULL << index))
+            CPU_SET(index, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    // macOS has no way to pin a thread
+    return false;
+#endif
+}
+
+ThreadCpuClock::~ThreadCpuClock() {
+#ifdef _WIN32
+    if (valid)
+        CloseHandle(reinterpret_cast<HANDLE>(handle));
+#endif
+}
+
+ThreadCpuClock::ThreadCpuClock(ThreadCpuClock &&other) noexcept
+    : handle(other.handle)
+    , valid(other.valid) {
+    other.valid = false;
+}
+
+ThreadCpuClock &ThreadCpuClock::operator=(ThreadCpuClock &&other) noexcept {
+    if (this != &other) {
+        this->~ThreadCpuClock();
+        handle = other.handle;
+        valid = other.valid;
+        other.valid = false;
+    }
+    return *this;
+}
+
+ThreadCpuClock ThreadCpuClock::current() {
+    ThreadCpuClock clock;
+#ifdef _WIN32
+    // GetCurrentThread is a pseudo handle only valid in the thread itself
+    HANDLE thread;
+    if (DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread, THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0)) {
+        clock.handle = reinterpret_cast<uint64_t>(thread);
+        clock.valid = true;
+    }
+#elif defined(__linux__)
+    clockid_t id;
+    if (pthread_getcpuclockid(pthread_self(), &id) == 0) {
+        clock.handle = static_cast<uint64_t>(static_cast<uint32_t>(id));
+        clock.valid = true;
+    }
+#elif defined(__APPLE__)
+    clock.handle = pthread_mach_thread_np(pthread_self());
+    clock.valid = true;
+#endif
+    return clock;
+}
+
+uint64_t ThreadCpuClock::get_time_us() const {
+    if (!valid)
+        return 0;
+
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(reinterpret_cast<HANDLE>(handle), &creation, &exit, &kernel, &user))
+        return 0;
+    // the times are in units of 100 ns
+    const auto to_u64 = [](const FILETIME &time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (to_u64(kernel) + to_u64(user)) / 10;
+#elif defined(__linux__)
+    timespec time;
+    if (clock_gettime(static_cast<clockid_t>(static_cast<uint32_t>(handle)), &time) != 0)
+        return 0;
+    return static_cast<uint64_t>(time.tv_sec) * 1'000'000 + time.tv_nsec / 1'000;
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(static_cast<thread_act_t>(handle), THREAD_BASIC_INFO, reinterpret_cast<thread_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return (static_cast<uint64_t>(info.user_time.seconds) + info.system_time.seconds) * 1'000'000 + info.user_time.microseconds + info.system_time.microseconds;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t get_core_mask(const std::vector<HostCpu> &cpus, uint32_t core) {
+    uint64_t mask = 0;
+    for (const HostCpu &cpu : cpus) {
+        if ((cpu.core == core) && (cpu.index < 64))
+            mask |= 1ULL << cpu.index;
+    }
+    return mask;
+}
+
+static HostCorePinning get_auto_pinning(const std::vector<HostCpu> &cpus) {
+    HostCorePinning pinning;
+    if (cpus.empty())
+        return pinning;
+
+    // Performance class of every physical core
+    std::map<uint32_t, uint32_t> core_classes;
+    for (const HostCpu &cpu : cpus) {
+        if (cpu.index < 64)
+            core_classes[cpu.core] = cpu.performance_class;
+    }
+    const uint32_t best_class = std::max_element(core_classes.begin(), core_classes.end(), [](const auto &a, const auto &b) { return a.second < b.second; })->second;
+    std::vector<uint64_t> fast_cores;
+    uint64_t fast_mask = 0;
+    uint64_t slow_mask = 0;
+    for (const auto &[core, performance_class] : core_classes) {
+        const uint64_t mask = get_core_mask(cpus, core);
+        if (performance_class == best_class) {
+            fast_cores.push_back(mask);
+            fast_mask |= mask;
+        } else {
+            slow_mask |= mask;
+        }
+    }
+
+    if (fast_cores.size() > GUEST_CORE_COUNT) {
+        // A performance core for each guest core and for the renderer, audio on an efficiency core if there is one
+        for (size_t i = 0; i < GUEST_CORE_COUNT; i++)
+            pinning.guest_cores[i] = fast_cores[i];
+        pinning.renderer = fast_cores[GUEST_CORE_COUNT];
+        if (slow_mask)
+            pinning.audio = slow_mask;
+        else if (fast_cores.size() > GUEST_CORE_COUNT + 1)
+            pinning.audio = fast_cores[GUEST_CORE_COUNT + 1];
+        else
+            pinning.audio = pinning.renderer;
+    } else if (slow_mask) {
+        // Too few cores to give one to each guest core, but keep the emulation on the performance cluster
+        pinning.guest_cores.fill(fast_mask);
+        pinning.renderer = fast_mask;
+        pinning.audio = slow_mask;
+    }
+
+    return pinning;
+}
+
+HostCorePinning get_host_core_pinning(const std::string &policy, const std::vector<HostCpu> &cpus) {
+    if (policy.empty() || (policy == "off"))
+        return {};
+    if (policy == "auto")
+        return get_auto_pinning(cpus);
+
+    HostCorePinning pinning;
+    const std::vector<std::string> entries = string_utils::split_string(policy, ',');
+    for (size_t i = 0; i < std::min<size_t>(entries.size(), GUEST_CORE_COUNT + 2); i++) {
+        uint64_t mask = 0;
+        for (const std::string &cpu : string_utils::split_string(entries[i], '+')) {
+            const int index = std::atoi(cpu.c_str());
+            if ((index < 0) || (index >= 64) || std::none_of(cpus.begin(), cpus.end(), [&](const HostCpu &c) { return c.index == static_cast<uint32_t>(index); })) {
+                LOG_WARN("Invalid host cpu {} in host core pinning \"{}\", threads won't be pinned", cpu, policy);
+                return {};
+            }
+            mask |= 1ULL << index;
+        }
+
+        if (i < GUEST_CORE_COUNT)
+            pinning.guest_cores[i] = mask;
+        else if (i == GUEST_CORE_COUNT)
+            pinning.renderer = mask;
+        else
+            pinning.audio = mask;
+    }
+
+    return pinning;
+}
+
+} // namespace util
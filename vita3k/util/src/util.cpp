@@ -21,6 +21,7 @@
 #include <util/net_utils.h>
 #include <util/string_utils.h>
 
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
@@ -32,6 +33,7 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
 #include <codecvt> // std::codecvt_utf8
 #include <iostream>
 #include <locale> // std::wstring_convert
@@ -49,8 +51,21 @@ namespace logging {
 
 static const fs::path &LOG_FILE_NAME = "vita3k.log";
 static const char *LOG_PATTERN = "%^[%H:%M:%S.%e] |%L| [%!]: %v%$";
+// messages waiting for the logging thread, the oldest ones are dropped once it is full so the guest threads never wait for the sinks
+static constexpr size_t LOG_QUEUE_SIZE = 8192;
+// messages a rate limited call site can log each second
+static constexpr uint32_t LOG_RATE_LIMIT = 10;
 std::vector<spdlog::sink_ptr> sinks;
 
+static void shutdown() {
+    if (const auto pool = spdlog::thread_pool()) {
+        if (const size_t overrun = pool->overrun_counter())
+            LOG_WARN("{} log messages were dropped because the log queue was full", overrun);
+    }
+    // write the queued messages before the sinks are destroyed
+    spdlog::shutdown();
+}
+
 ExitCode init(const Root &root_paths, bool use_stdout) {
     sinks.clear();
     if (use_stdout)
@@ -64,6 +79,12 @@ ExitCode init(const Root &root_paths, bool use_stdout) {
         assert(0);
     });
 
+    static bool is_shutdown_registered = false;
+    if (!is_shutdown_registered) {
+        std::atexit(shutdown);
+        is_shutdown_registered = true;
+    }
+
     return Success;
 }
 
@@ -89,11 +110,34 @@ ExitCode add_sink(const fs::path &log_path) {
     }
 #endif
 
-    spdlog::set_default_logger(std::make_shared<spdlog::logger>("vita3k logger", begin(sinks), end(sinks)));
+    // the messages are formatted by the threads logging them, then written to the sinks by a single logging thread
+    if (!spdlog::thread_pool())
+        spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+    const auto logger = std::make_shared<spdlog::async_logger>("vita3k logger", begin(sinks), end(sinks), spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
+    // the errors are often followed by a crash, don't keep them in the file buffer
+    logger->flush_on(spdlog::level::err);
+    spdlog::set_default_logger(logger);
     spdlog::set_pattern(LOG_PATTERN);
+    spdlog::flush_every(std::chrono::seconds(1));
     return Success;
 }
 
+bool RateLimiter::allow(uint32_t &dropped_count) {
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t start = window_start.load(std::memory_order_relaxed);
+    // a single thread starts the new window
+    if (now - start >= 1000 && window_start.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        count.store(0, std::memory_order_relaxed);
+
+    if (count.fetch_add(1, std::memory_order_relaxed) >= LOG_RATE_LIMIT) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    dropped_count = dropped.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
 typedef std::set<std::string> NameSet;
 static std::mutex mutex;
 static NameSet logged;
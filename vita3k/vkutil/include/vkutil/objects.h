@@ -36,6 +36,8 @@ struct Image {
 
     // should the existing image, view, sampler be destroyed when this image is destroyed?
     bool destroy_on_deletion = true;
+    // false if the sampler is shared with other images, it is then left alive when this image is destroyed
+    bool owns_sampler = true;
 
     Image();
     Image(vma::Allocator allocator, uint32_t width, uint32_t height, vk::Format format);
@@ -49,7 +51,7 @@ struct Image {
     Image(const Image &) = delete;
     Image &operator=(Image const &) = delete;
 
-    void init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping = default_comp_mapping, const vk::ImageCreateFlags image_create_flags = vk::ImageCreateFlags(), const void *pNext = nullptr);
+    void init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping = default_comp_mapping, const vk::ImageCreateFlags image_create_flags = vk::ImageCreateFlags(), const void *pNext = nullptr, const vma::AllocationCreateInfo &alloc_create_info = vma_auto_alloc);
     // called by ~Image
     void destroy();
 
@@ -98,6 +100,8 @@ protected:
 
 public:
     uint32_t data_offset = 0;
+    // incremented each time the end is reached, the data allocated before is then overwritten
+    uint32_t wrap_count = 0;
 
     explicit RingBuffer(vma::Allocator allocator, vk::BufferUsageFlags usage, const size_t capacity);
     virtual void create() = 0;
@@ -138,6 +142,9 @@ public:
 class HostRingBuffer : public RingBuffer {
 protected:
     bool is_coherent;
+    // range written since the last flush, only used if the memory is not coherent
+    uint32_t dirty_begin = ~0;
+    uint32_t dirty_end = 0;
 
 public:
     explicit HostRingBuffer(vma::Allocator allocator, vk::BufferUsageFlags usage, const size_t capacity)
@@ -146,6 +153,9 @@ public:
     void create() override;
 
     void copy(vk::CommandBuffer cmd_buffer, const uint32_t size, const void *data, const uint32_t offset = 0) override;
+    // make the content copied since the last flush visible to the GPU
+    // must be called before submitting the commands reading it
+    void flush();
 };
 
 // Queue that contains GPU objects that are planned to be destroyed (deferred destruction)
@@ -81,6 +81,18 @@ static constexpr vma::AllocationCreateInfo vma_mapped_alloc = {
     .usage = vma::MemoryUsage::eAuto,
 };
 
+// same as vma_mapped_alloc, but prefer coherent memory so the writes don't need to be flushed
+static constexpr vma::AllocationCreateInfo vma_mapped_coherent_alloc = {
+    .flags = vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped,
+    .usage = vma::MemoryUsage::eAuto,
+    .preferredFlags = vk::MemoryPropertyFlagBits::eHostCoherent,
+};
+
+static constexpr vma::AllocationCreateInfo vma_readback_alloc = {
+    .flags = vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped,
+    .usage = vma::MemoryUsage::eAuto,
+};
+
 static constexpr vma::AllocationCreateInfo vma_host_visible = {
     .flags = vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
     .usage = vma::MemoryUsage::eAuto,
@@ -21,6 +21,8 @@
 
 #include <util/log.h>
 
+#include <algorithm>
+
 namespace vkutil {
 Image::Image() = default;
 
@@ -53,7 +55,8 @@ void Image::destroy() {
 
     vk::Device device = allocator.getAllocatorInfo().device;
     if (sampler) {
-        device.destroySampler(sampler);
+        if (owns_sampler)
+            device.destroySampler(sampler);
         sampler = nullptr;
     }
     if (view) {
@@ -70,7 +73,7 @@ Image::~Image() {
     destroy();
 }
 
-void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping, const vk::ImageCreateFlags image_create_flags, const void *pNext) {
+void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping, const vk::ImageCreateFlags image_create_flags, const void *pNext, const vma::AllocationCreateInfo &alloc_create_info) {
     vk::ImageCreateInfo image_info{
         .pNext = pNext,
         .flags = image_create_flags,
@@ -89,7 +92,7 @@ void Image::init_image(vk::ImageUsageFlags usage, vk::ComponentMapping mapping,
         .initialLayout = vk::ImageLayout::eUndefined,
     };
 
-    std::tie(image, allocation) = allocator.createImage(image_info, vma_auto_alloc);
+    std::tie(image, allocation) = allocator.createImage(image_info, alloc_create_info);
 
     vk::ImageSubresourceRange range = (format == vk::Format::eD32SfloatS8Uint) ? vkutil::ds_subresource_range : vkutil::color_subresource_range;
     vk::ImageViewCreateInfo view_info{
@@ -139,8 +142,11 @@ void Buffer::destroy() {
     if (!destroy_on_deletion || !allocator)
         return;
 
-    if (buffer)
+    if (buffer) {
         allocator.destroyBuffer(buffer, allocation);
+        buffer = nullptr;
+        mapped_data = nullptr;
+    }
 }
 
 Buffer::~Buffer() {
@@ -176,6 +182,7 @@ void RingBuffer::allocate(const uint32_t data_size) {
     if (cursor + data_size > capacity) {
         // LOG_WARNING("End of buffer reached");
         cursor = 0;
+        wrap_count++;
     }
 
     data_offset = cursor;
@@ -186,7 +193,7 @@ void RingBuffer::allocate(const uint32_t data_size) {
 }
 
 void HostRingBuffer::create() {
-    buffer.init_buffer(usage, vma_mapped_alloc);
+    buffer.init_buffer(usage, vma_mapped_coherent_alloc);
 
     vk::MemoryPropertyFlags memory_properties = buffer.allocator.getAllocationMemoryProperties(buffer.allocation);
     is_coherent = static_cast<bool>(memory_properties & vk::MemoryPropertyFlagBits::eHostCoherent);
@@ -197,8 +204,20 @@ void HostRingBuffer::create() {
 void HostRingBuffer::copy(vk::CommandBuffer cmd_buffer, const uint32_t size, const void *data, const uint32_t offset) {
     memcpy(reinterpret_cast<uint8_t *>(buffer.mapped_data) + data_offset + offset, data, size);
 
-    if (!is_coherent)
-        buffer.allocator.flushAllocation(buffer.allocation, data_offset + offset, size);
+    if (!is_coherent) {
+        // the flush is done once for all the copies of the scene
+        dirty_begin = std::min(dirty_begin, data_offset + offset);
+        dirty_end = std::max(dirty_end, data_offset + offset + size);
+    }
+}
+
+void HostRingBuffer::flush() {
+    if (dirty_begin >= dirty_end)
+        return;
+
+    buffer.allocator.flushAllocation(buffer.allocation, dirty_begin, dirty_end - dirty_begin);
+    dirty_begin = ~0;
+    dirty_end = 0;
 }
 
 void LocalRingBuffer::create() {
@@ -219,7 +238,8 @@ void DestroyQueue::init(vk::Device device, vma::Allocator allocator) {
 
 void DestroyQueue::add_image(Image &image) {
     if (image.sampler) {
-        add(image.sampler);
+        if (image.owns_sampler)
+            add(image.sampler);
         image.sampler = nullptr;
     }
     if (image.view) {